@@ -17,14 +17,19 @@
 namespace {
 
 template <typename Stream, typename Data>
-bool SerializeDB(Stream& stream, const Data& data)
+bool SerializeDB(Stream& stream, const Data& data, uint256* phash = nullptr) // VELES
 {
     // Write and commit header, data
     try {
         CHashWriter hasher(SER_DISK, CLIENT_VERSION);
         stream << Params().MessageStart() << data;
         hasher << Params().MessageStart() << data;
-        stream << hasher.GetHash();
+        // VELES BEGIN
+        // stream << hasher.GetHash();
+        const uint256 hash = hasher.GetHash();
+        stream << hash;
+        if (phash) *phash = hash;
+        // VELES END
     } catch (const std::exception& e) {
         return error("%s: Serialize or I/O error - %s", __func__, e.what());
     }
@@ -32,8 +37,9 @@ bool SerializeDB(Stream& stream, const Data& data)
     return true;
 }
 
-template <typename Data>
-bool SerializeFileDB(const std::string& prefix, const fs::path& path, const Data& data)
+// VELES BEGIN
+/** Replace the file at path with the data serialized by SerializeDB() */
+bool WriteFileDB(const std::string& prefix, const fs::path& path, const CDataStream& ssData)
 {
     // Generate random temporary filename
     unsigned short randv = 0;
@@ -47,8 +53,11 @@ bool SerializeFileDB(const std::string& prefix, const fs::path& path, const Data
     if (fileout.IsNull())
         return error("%s: Failed to open file %s", __func__, pathTmp.string());
 
-    // Serialize
-    if (!SerializeDB(fileout, data)) return false;
+    try {
+        fileout << ssData;
+    } catch (const std::exception& e) {
+        return error("%s: I/O error - %s", __func__, e.what());
+    }
     if (!FileCommit(fileout.Get()))
         return error("%s: Failed to flush file %s", __func__, pathTmp.string());
     fileout.fclose();
@@ -60,8 +69,18 @@ bool SerializeFileDB(const std::string& prefix, const fs::path& path, const Data
     return true;
 }
 
+/** The data is serialized in memory, so that its locks are not held while writing to disk */
+template <typename Data>
+bool SerializeFileDB(const std::string& prefix, const fs::path& path, const Data& data)
+{
+    CDataStream ssData(SER_DISK, CLIENT_VERSION);
+    if (!SerializeDB(ssData, data)) return false;
+    return WriteFileDB(prefix, path, ssData);
+}
+// VELES END
+
 template <typename Stream, typename Data>
-bool DeserializeDB(Stream& stream, Data& data, bool fCheckSum = true)
+bool DeserializeDB(Stream& stream, Data& data, bool fCheckSum = true, uint256* phash = nullptr) // VELES
 {
     try {
         CHashVerifier<Stream> verifier(&stream);
@@ -82,6 +101,7 @@ bool DeserializeDB(Stream& stream, Data& data, bool fCheckSum = true)
             if (hashTmp != verifier.GetHash()) {
                 return error("%s: Checksum mismatch, data corrupted", __func__);
             }
+            if (phash) *phash = hashTmp; // VELES
         }
     }
     catch (const std::exception& e) {
@@ -92,7 +112,7 @@ bool DeserializeDB(Stream& stream, Data& data, bool fCheckSum = true)
 }
 
 template <typename Data>
-bool DeserializeFileDB(const fs::path& path, Data& data)
+bool DeserializeFileDB(const fs::path& path, Data& data, uint256* phash = nullptr) // VELES
 {
     // open input file, and associate with CAutoFile
     FILE *file = fsbridge::fopen(path, "rb");
@@ -100,8 +120,65 @@ bool DeserializeFileDB(const fs::path& path, Data& data)
     if (filein.IsNull())
         return error("%s: Failed to open file %s", __func__, path.string());
 
-    return DeserializeDB(filein, data);
+    return DeserializeDB(filein, data, true, phash); // VELES
+}
+
+// VELES BEGIN
+/**
+ * The journal of peers.dat starts with the network magic and the checksum of the
+ * peers.dat it applies to, and goes on with batches of changes of the addrman,
+ * each of them followed by its hash.
+ */
+bool WriteJournalHeader(const fs::path& path, const uint256& hashBase)
+{
+    CAutoFile fileout(fsbridge::fopen(path, "wb"), SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull())
+        return error("%s: Failed to open file %s", __func__, path.string());
+    try {
+        fileout << Params().MessageStart() << hashBase;
+    } catch (const std::exception& e) {
+        return error("%s: Serialize or I/O error - %s", __func__, e.what());
+    }
+    if (!FileCommit(fileout.Get()))
+        return error("%s: Failed to flush file %s", __func__, path.string());
+    return true;
+}
+
+/** Apply the batches of a journal to addr, read from the peers.dat of checksum hashBase */
+bool ReadJournal(const fs::path& path, CAddrMan& addr, const uint256& hashBase)
+{
+    CAutoFile filein(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return false;
+
+    int nBatches = 0;
+    try {
+        unsigned char pchMsgTmp[4];
+        uint256 hashTmp;
+        filein >> pchMsgTmp >> hashTmp;
+        if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)) || hashTmp != hashBase)
+            return error("%s: Journal of another peers.dat", __func__);
+
+        while (true) {
+            const int c = fgetc(filein.Get());
+            if (c == EOF)
+                return true;
+            ungetc(c, filein.Get());
+
+            std::string strBatch;
+            uint256 hashBatch;
+            filein >> strBatch >> hashBatch;
+            if (hashBatch != Hash(strBatch.begin(), strBatch.end()))
+                return error("%s: Checksum mismatch in batch %d", __func__, nBatches);
+            CDataStream ssBatch(strBatch.data(), strBatch.data() + strBatch.size(), SER_DISK, CLIENT_VERSION);
+            addr.UnserializeChanges(ssBatch);
+            nBatches++;
+        }
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error in batch %d - %s", __func__, nBatches, e.what());
+    }
 }
+// VELES END
 
 }
 
@@ -122,17 +199,72 @@ bool CBanDB::Read(banmap_t& banSet)
 CAddrDB::CAddrDB()
 {
     pathAddr = GetDataDir() / "peers.dat";
+    pathJournal = GetDataDir() / "peers.journal"; // VELES
 }
 
 bool CAddrDB::Write(const CAddrMan& addr)
 {
-    return SerializeFileDB("peers", pathAddr, addr);
+    // VELES BEGIN
+    // return SerializeFileDB("peers", pathAddr, addr);
+    // The tables are serialized in memory under the lock of addrman, and written to disk without it
+    CDataStream ssPeers(SER_DISK, CLIENT_VERSION);
+    uint256 hashBase;
+    if (!SerializeDB(ssPeers, addr, &hashBase)) return false;
+
+    // The changes journaled so far are in the new peers.dat
+    boost::system::error_code ec;
+    fs::remove(pathJournal, ec);
+    if (!WriteFileDB("peers", pathAddr, ssPeers)) return false;
+    WriteJournalHeader(pathJournal, hashBase);
+    return true;
+    // VELES END
 }
 
 bool CAddrDB::Read(CAddrMan& addr)
 {
-    return DeserializeFileDB(pathAddr, addr);
+    // VELES BEGIN
+    // return DeserializeFileDB(pathAddr, addr);
+    uint256 hashBase;
+    if (!DeserializeFileDB(pathAddr, addr, &hashBase)) return false;
+
+    // Once a journal can't be replayed to its end, later changes can't be appended to it
+    if (fs::exists(pathJournal) && !ReadJournal(pathJournal, addr, hashBase)) {
+        LogPrintf("Invalid peers.journal, discarding it\n");
+        boost::system::error_code ec;
+        fs::remove(pathJournal, ec);
+    }
+    return true;
+    // VELES END
+}
+
+// VELES BEGIN
+bool CAddrDB::WriteChanges(CAddrMan& addr)
+{
+    // The journal is compacted into peers.dat once it has grown to half its size
+    boost::system::error_code ec;
+    const uintmax_t nJournalSize = fs::file_size(pathJournal, ec);
+    if (ec) return false;
+    const uintmax_t nAddrSize = fs::file_size(pathAddr, ec);
+    if (ec || nJournalSize > nAddrSize / 2) return false;
+
+    CDataStream ssChanges(SER_DISK, CLIENT_VERSION);
+    if (!addr.SerializeChanges(ssChanges)) return false;
+
+    // The changes are appended without the lock of addrman. If that fails they are lost
+    // to the journal, and the caller writes the whole peers.dat instead.
+    CAutoFile fileout(fsbridge::fopen(pathJournal, "ab"), SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull())
+        return error("%s: Failed to open file %s", __func__, pathJournal.string());
+    try {
+        fileout << ssChanges.str() << Hash(ssChanges.begin(), ssChanges.end());
+    } catch (const std::exception& e) {
+        return error("%s: Serialize or I/O error - %s", __func__, e.what());
+    }
+    if (!FileCommit(fileout.Get()))
+        return error("%s: Failed to flush file %s", __func__, pathJournal.string());
+    return true;
 }
+// VELES END
 
 bool CAddrDB::Read(CAddrMan& addr, CDataStream& ssPeers)
 {
@@ -86,11 +86,16 @@ class CAddrDB
 {
 private:
     fs::path pathAddr;
+    fs::path pathJournal; // VELES
 public:
     CAddrDB();
     bool Write(const CAddrMan& addr);
     bool Read(CAddrMan& addr);
     static bool Read(CAddrMan& addr, CDataStream& ssPeers);
+    // VELES BEGIN
+    //! Append the changes of addr to the journal of peers.dat, false if the whole of it must be written instead
+    bool WriteChanges(CAddrMan& addr);
+    // VELES END
 };
 
 /** Access to the banlist database (banlist.dat) */
@@ -83,6 +83,7 @@ CAddrInfo* CAddrMan::Create(const CAddress& addr, const CNetAddr& addrSource, in
     int nId = nIdCount++;
     mapInfo[nId] = CAddrInfo(addr, addrSource);
     mapAddr[addr] = nId;
+    setJournal.insert(addr); // VELES
     mapInfo[nId].nRandomPos = vRandom.size();
     vRandom.push_back(nId);
     if (pnId)
@@ -119,6 +120,7 @@ void CAddrMan::Delete(int nId)
 
     SwapRandom(info.nRandomPos, vRandom.size() - 1);
     vRandom.pop_back();
+    setJournal.insert(info); // VELES
     mapAddr.erase(info);
     mapInfo.erase(nId);
     nNew--;
@@ -133,6 +135,7 @@ void CAddrMan::ClearNew(int nUBucket, int nUBucketPos)
         assert(infoDelete.nRefCount > 0);
         infoDelete.nRefCount--;
         vvNew[nUBucket][nUBucketPos] = -1;
+        setJournal.insert(infoDelete); // VELES
         if (infoDelete.nRefCount == 0) {
             Delete(nIdDelete);
         }
@@ -179,12 +182,14 @@ void CAddrMan::MakeTried(CAddrInfo& info, int nId)
         infoOld.nRefCount = 1;
         vvNew[nUBucket][nUBucketPos] = nIdEvict;
         nNew++;
+        setJournal.insert(infoOld); // VELES
     }
     assert(vvTried[nKBucket][nKBucketPos] == -1);
 
     vvTried[nKBucket][nKBucketPos] = nId;
     nTried++;
     info.fInTried = true;
+    setJournal.insert(info); // VELES
 }
 
 void CAddrMan::Good_(const CService& addr, bool test_before_evict, int64_t nTime)
@@ -209,6 +214,7 @@ void CAddrMan::Good_(const CService& addr, bool test_before_evict, int64_t nTime
     info.nLastSuccess = nTime;
     info.nLastTry = nTime;
     info.nAttempts = 0;
+    setJournal.insert(info); // VELES
     // nTime is not updated here, to avoid leaking information about
     // currently-connected peers.
 
@@ -268,6 +274,11 @@ bool CAddrMan::Add_(const CAddress& addr, const CNetAddr& source, int64_t nTimeP
     }
 
     if (pinfo) {
+        // VELES BEGIN
+        const uint32_t nTimeOld = pinfo->nTime;
+        const ServiceFlags nServicesOld = pinfo->nServices;
+        // VELES END
+
         // periodically update nTime
         bool fCurrentlyOnline = (GetAdjustedTime() - addr.nTime < 24 * 60 * 60);
         int64_t nUpdateInterval = (fCurrentlyOnline ? 60 * 60 : 24 * 60 * 60);
@@ -276,6 +287,8 @@ bool CAddrMan::Add_(const CAddress& addr, const CNetAddr& source, int64_t nTimeP
 
         // add services
         pinfo->nServices = ServiceFlags(pinfo->nServices | addr.nServices);
+        if (pinfo->nTime != nTimeOld || pinfo->nServices != nServicesOld)
+            setJournal.insert(*pinfo); // VELES
 
         // do not update if no new information is present
         if (!addr.nTime || (pinfo->nTime && addr.nTime <= pinfo->nTime))
@@ -317,6 +330,7 @@ bool CAddrMan::Add_(const CAddress& addr, const CNetAddr& source, int64_t nTimeP
             ClearNew(nUBucket, nUBucketPos);
             pinfo->nRefCount++;
             vvNew[nUBucket][nUBucketPos] = nId;
+            setJournal.insert(*pinfo); // VELES
         } else {
             if (pinfo->nRefCount == 0) {
                 Delete(nId);
@@ -328,6 +342,17 @@ bool CAddrMan::Add_(const CAddress& addr, const CNetAddr& source, int64_t nTimeP
 
 void CAddrMan::Attempt_(const CService& addr, bool fCountFailure, int64_t nTime)
 {
+    // VELES BEGIN
+    // masternode tier entries need not be in the tables, track their attempts there too
+    auto itTier = mapMasternodeTier.find(addr);
+    if (itTier != mapMasternodeTier.end() && static_cast<const CService&>(vMasternodeTier[itTier->second]) == addr) {
+        CAddrInfo& infoTier = vMasternodeTier[itTier->second];
+        infoTier.nLastTry = nTime;
+        if (fCountFailure)
+            infoTier.nAttempts++;
+    }
+    // VELES END
+
     CAddrInfo* pinfo = Find(addr);
 
     // if not found, bail out
@@ -345,9 +370,43 @@ void CAddrMan::Attempt_(const CService& addr, bool fCountFailure, int64_t nTime)
     if (fCountFailure && info.nLastCountAttempt < nLastGood) {
         info.nLastCountAttempt = nTime;
         info.nAttempts++;
+        setJournal.insert(info); // VELES
     }
 }
 
+// VELES BEGIN
+void CAddrMan::SetMasternodeAddresses_(const std::vector<CAddress>& vAddr)
+{
+    std::vector<CAddrInfo> vTier;
+    std::map<CNetAddr, size_t> mapTier;
+    vTier.reserve(vAddr.size());
+    for (const CAddress& addr : vAddr) {
+        if (!addr.IsRoutable() || mapTier.count(addr))
+            continue;
+        CAddrInfo info(addr, addr);
+        auto it = mapMasternodeTier.find(addr);
+        if (it != mapMasternodeTier.end()) {
+            info.nLastTry = vMasternodeTier[it->second].nLastTry;
+            info.nAttempts = vMasternodeTier[it->second].nAttempts;
+        } else if (const CAddrInfo* pinfo = Find(addr)) {
+            info.nLastTry = pinfo->nLastTry;
+            info.nAttempts = pinfo->nAttempts;
+        }
+        mapTier.emplace(addr, vTier.size());
+        vTier.push_back(info);
+    }
+    vMasternodeTier.swap(vTier);
+    mapMasternodeTier.swap(mapTier);
+}
+
+CAddrInfo CAddrMan::SelectMasternode_()
+{
+    if (vMasternodeTier.empty())
+        return CAddrInfo();
+    return vMasternodeTier[insecure_rand.randrange(vMasternodeTier.size())];
+}
+// VELES END
+
 CAddrInfo CAddrMan::Select_(bool newOnly)
 {
     if (size() == 0)
@@ -510,8 +569,10 @@ void CAddrMan::Connected_(const CService& addr, int64_t nTime)
 
     // update info
     int64_t nUpdateInterval = 20 * 60;
-    if (nTime - info.nTime > nUpdateInterval)
+    if (nTime - info.nTime > nUpdateInterval) {
         info.nTime = nTime;
+        setJournal.insert(info); // VELES
+    }
 }
 
 void CAddrMan::SetServices_(const CService& addr, ServiceFlags nServices)
@@ -530,6 +591,7 @@ void CAddrMan::SetServices_(const CService& addr, ServiceFlags nServices)
 
     // update info
     info.nServices = nServices;
+    setJournal.insert(info); // VELES
 }
 
 void CAddrMan::ResolveCollisions_()
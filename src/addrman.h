@@ -209,6 +209,19 @@ private:
     //! Holds addrs inserted into tried table that collide with existing entries. Test-before-evict discipline used to resolve these collisions.
     std::set<int> m_tried_collisions;
 
+    // VELES BEGIN
+    //! addresses of the known masternodes, kept apart from the buckets (memory only):
+    //! a compact vector for O(1) random selection and an index by address
+    std::vector<CAddrInfo> vMasternodeTier GUARDED_BY(cs);
+    std::map<CNetAddr, size_t> mapMasternodeTier GUARDED_BY(cs);
+
+    //! addresses whose entries changed since the tables or their changes were last serialized (memory only)
+    mutable std::set<CNetAddr> setJournal GUARDED_BY(cs);
+
+    //! whether the tables were cleared since they were last serialized, so that changes can't be journaled (memory only)
+    mutable bool fJournalReset GUARDED_BY(cs);
+    // VELES END
+
 protected:
     //! secret key to randomize bucket select with
     uint256 nKey;
@@ -253,6 +266,14 @@ protected:
     //! Return a random to-be-evicted tried table address.
     CAddrInfo SelectTriedCollision_() EXCLUSIVE_LOCKS_REQUIRED(cs);
 
+    // VELES BEGIN
+    //! Replace the masternode tier, keeping the connection attempts known for its addresses.
+    void SetMasternodeAddresses_(const std::vector<CAddress>& vAddr) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+    //! Select a random address of the masternode tier.
+    CAddrInfo SelectMasternode_() EXCLUSIVE_LOCKS_REQUIRED(cs);
+    // VELES END
+
 #ifdef DEBUG_ADDRMAN
     //! Perform consistency check. Returns an error code or zero.
     int Check_() EXCLUSIVE_LOCKS_REQUIRED(cs);
@@ -345,6 +366,12 @@ public:
                 }
             }
         }
+
+        // VELES BEGIN
+        // the changes journaled from now on apply to these tables
+        setJournal.clear();
+        fJournalReset = false;
+        // VELES END
     }
 
     template<typename Stream>
@@ -450,8 +477,187 @@ public:
             LogPrint(BCLog::ADDRMAN, "addrman lost %i new and %i tried addresses due to collisions\n", nLostUnk, nLost);
         }
 
+        // VELES BEGIN
+        setJournal.clear();
+        fJournalReset = false;
+        // VELES END
+
+        Check();
+    }
+
+    // VELES BEGIN
+    /**
+     * Serialize the entries changed since the tables or their changes were last serialized,
+     * and forget them. The changes are appended to the journal of peers.dat, and only apply
+     * to the tables they were made to: false is returned without serializing anything if
+     * the tables were cleared since they were serialized.
+     *
+     * serialized format:
+     * * number of changed addresses
+     * * for each of them:
+     *   * the address
+     *   * whether it is still in the tables, and if so:
+     *     * its addrinfo
+     *     * whether it is in the "tried" table
+     *     * if not, the "new" buckets it is in
+     *
+     * The positions in the buckets are not encoded, they follow from the address and nKey.
+     */
+    template<typename Stream>
+    bool SerializeChanges(Stream& s)
+    {
+        LOCK(cs);
+        if (fJournalReset)
+            return false;
+
+        // Find the "new" buckets of the changed entries in a single pass over the table
+        std::map<int, std::vector<int> > mapBuckets;
+        for (const CNetAddr& addr : setJournal) {
+            int nId;
+            const CAddrInfo* pinfo = Find(addr, &nId);
+            if (pinfo && !pinfo->fInTried)
+                mapBuckets[nId];
+        }
+        if (!mapBuckets.empty()) {
+            for (int bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT; bucket++) {
+                for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
+                    auto it = mapBuckets.find(vvNew[bucket][i]);
+                    if (it != mapBuckets.end())
+                        it->second.push_back(bucket);
+                }
+            }
+        }
+
+        WriteCompactSize(s, setJournal.size());
+        for (const CNetAddr& addr : setJournal) {
+            int nId;
+            const CAddrInfo* pinfo = Find(addr, &nId);
+            s << addr << (pinfo != nullptr);
+            if (pinfo) {
+                s << *pinfo << pinfo->fInTried;
+                if (!pinfo->fInTried)
+                    s << mapBuckets[nId];
+            }
+        }
+        setJournal.clear();
+        return true;
+    }
+
+    //! Apply changes serialized by SerializeChanges() to the tables they were made to.
+    template<typename Stream>
+    void UnserializeChanges(Stream& s)
+    {
+        LOCK(cs);
+
+        struct Change {
+            CNetAddr addr;
+            bool fPresent = false;
+            CAddrInfo info;
+            bool fInTried = false;
+            std::vector<int> vBuckets;
+        };
+
+        // Parse all the changes first, so that a corrupt batch leaves the tables alone
+        const uint64_t nChanges = ReadCompactSize(s);
+        if (nChanges > ADDRMAN_NEW_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE + ADDRMAN_TRIED_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE)
+            throw std::ios_base::failure("Corrupt CAddrMan changes, too many changes.");
+        std::vector<Change> vChanges(nChanges);
+        for (Change& change : vChanges) {
+            s >> change.addr >> change.fPresent;
+            if (!change.fPresent)
+                continue;
+            s >> change.info >> change.fInTried;
+            if (static_cast<const CNetAddr&>(change.info) != change.addr)
+                throw std::ios_base::failure("Corrupt CAddrMan changes, address mismatch.");
+            if (change.fInTried)
+                continue;
+            s >> change.vBuckets;
+            if (change.vBuckets.size() > ADDRMAN_NEW_BUCKETS_PER_ADDRESS)
+                throw std::ios_base::failure("Corrupt CAddrMan changes, too many buckets.");
+            for (int bucket : change.vBuckets) {
+                if (bucket < 0 || bucket >= ADDRMAN_NEW_BUCKET_COUNT)
+                    throw std::ios_base::failure("Corrupt CAddrMan changes, bucket out of range.");
+            }
+        }
+
+        // Take the changed entries out of the tables
+        std::set<int> setRemove;
+        for (const Change& change : vChanges) {
+            int nId;
+            CAddrInfo* pinfo = Find(change.addr, &nId);
+            if (!pinfo)
+                continue;
+            if (pinfo->fInTried) {
+                int nKBucket = pinfo->GetTriedBucket(nKey);
+                int nKBucketPos = pinfo->GetBucketPosition(nKey, false, nKBucket);
+                if (vvTried[nKBucket][nKBucketPos] == nId)
+                    vvTried[nKBucket][nKBucketPos] = -1;
+                pinfo->fInTried = false;
+                nTried--;
+                nNew++;
+            }
+            setRemove.insert(nId);
+        }
+        if (!setRemove.empty()) {
+            for (int bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT; bucket++) {
+                for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
+                    if (vvNew[bucket][i] != -1 && setRemove.count(vvNew[bucket][i]))
+                        ClearNew(bucket, i);
+                }
+            }
+            // entries which were in no bucket at all
+            for (int nId : setRemove) {
+                if (mapInfo.count(nId))
+                    Delete(nId);
+            }
+        }
+
+        // Put them back as they were when serialized, dropping those whose positions were taken
+        int nLost = 0;
+        for (const Change& change : vChanges) {
+            if (!change.fPresent || mapAddr.count(change.addr))
+                continue;
+            int nId;
+            CAddrInfo* pinfo = Create(change.info, change.info.source, &nId);
+            const int nRandomPos = pinfo->nRandomPos;
+            *pinfo = change.info;
+            pinfo->nRandomPos = nRandomPos;
+            pinfo->nRefCount = 0;
+            pinfo->fInTried = false;
+            nNew++;
+            if (change.fInTried) {
+                int nKBucket = pinfo->GetTriedBucket(nKey);
+                int nKBucketPos = pinfo->GetBucketPosition(nKey, false, nKBucket);
+                if (vvTried[nKBucket][nKBucketPos] == -1) {
+                    vvTried[nKBucket][nKBucketPos] = nId;
+                    pinfo->fInTried = true;
+                    nTried++;
+                    nNew--;
+                }
+            } else {
+                for (int bucket : change.vBuckets) {
+                    int nUBucketPos = pinfo->GetBucketPosition(nKey, true, bucket);
+                    if (vvNew[bucket][nUBucketPos] == -1 && pinfo->nRefCount < ADDRMAN_NEW_BUCKETS_PER_ADDRESS) {
+                        vvNew[bucket][nUBucketPos] = nId;
+                        pinfo->nRefCount++;
+                    }
+                }
+            }
+            if (!pinfo->fInTried && pinfo->nRefCount == 0) {
+                Delete(nId);
+                nLost++;
+            }
+        }
+        if (nLost > 0) {
+            LogPrint(BCLog::ADDRMAN, "addrman lost %i changed addresses due to collisions\n", nLost);
+        }
+
+        // The tables are now as on disk
+        setJournal.clear();
+
         Check();
     }
+    // VELES END
 
     void Clear()
     {
@@ -475,6 +681,12 @@ public:
         nLastGood = 1; //Initially at 1 so that "never" is strictly worse.
         mapInfo.clear();
         mapAddr.clear();
+        // VELES BEGIN
+        vMasternodeTier.clear();
+        mapMasternodeTier.clear();
+        setJournal.clear();
+        fJournalReset = true;
+        // VELES END
     }
 
     CAddrMan()
@@ -591,6 +803,35 @@ public:
         return addrRet;
     }
 
+    // VELES BEGIN
+    //! Set the addresses of the known masternodes, preferred for a share of the outbound connections.
+    void SetMasternodeAddresses(const std::vector<CAddress>& vAddr)
+    {
+        LOCK(cs);
+        SetMasternodeAddresses_(vAddr);
+    }
+
+    //! Choose a masternode address to connect to, invalid if no masternode is known.
+    CAddrInfo SelectMasternode()
+    {
+        LOCK(cs);
+        return SelectMasternode_();
+    }
+
+    //! Whether addr belongs to a known masternode.
+    bool IsMasternodeAddress(const CNetAddr& addr) const
+    {
+        LOCK(cs);
+        return mapMasternodeTier.count(addr) != 0;
+    }
+
+    size_t MasternodeTierSize() const
+    {
+        LOCK(cs);
+        return vMasternodeTier.size();
+    }
+    // VELES END
+
     //! Return a bunch of addresses, selected at random.
     std::vector<CAddress> GetAddr()
     {
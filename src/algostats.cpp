@@ -0,0 +1,162 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <algostats.h>
+
+#include <chain.h>
+#include <chainparams.h>
+#include <primitives/block.h>
+#include <validation.h>
+
+#include <vector>
+
+CAlgoStats algoStats;
+
+CAlgoStats::CAlgoStats(int nWindow24hIn, int nWindow7dIn) :
+    nWindow24hArg(nWindow24hIn), nWindow7dArg(nWindow7dIn)
+{
+}
+
+CAlgoStats::Entry CAlgoStats::MakeEntry(const CBlockIndex* pindex) const
+{
+    return Entry{pindex, pindex->GetAlgo(), GetBlockSubsidy(pindex->nHeight, pindex->GetBlockHeader(), Params().GetConsensus(), false)};
+}
+
+void CAlgoStats::Add24h(const Entry& entry, int nSign)
+{
+    Totals& totals = mapTotals[entry.nAlgo];
+    totals.nBlocks24h += nSign;
+    totals.nRewards24h += nSign * entry.nReward;
+}
+
+void CAlgoStats::Add7d(const Entry& entry, int nSign)
+{
+    Totals& totals = mapTotals[entry.nAlgo];
+    totals.nBlocks7d += nSign;
+    totals.nRewards7d += nSign * entry.nReward;
+}
+
+void CAlgoStats::PushBack(const CBlockIndex* pindex)
+{
+    vWindow.push_back(MakeEntry(pindex));
+    Add24h(vWindow.back(), 1);
+    Add7d(vWindow.back(), 1);
+
+    if ((int)vWindow.size() > nWindow24h)
+        Add24h(vWindow[vWindow.size() - 1 - nWindow24h], -1);
+    if ((int)vWindow.size() > nWindow7d) {
+        Add7d(vWindow.front(), -1);
+        vWindow.pop_front();
+    }
+
+    mapLastBlock[vWindow.back().nAlgo] = pindex;
+    pindexTip = pindex;
+}
+
+void CAlgoStats::PopBack()
+{
+    const Entry entry = vWindow.back();
+    Add24h(entry, -1);
+    Add7d(entry, -1);
+    vWindow.pop_back();
+
+    if ((int)vWindow.size() >= nWindow24h)
+        Add24h(vWindow[vWindow.size() - nWindow24h], 1);
+
+    // The window grows back by one block at its old end
+    const CBlockIndex* pindexFront = vWindow.empty() ? entry.pindex->pprev : vWindow.front().pindex->pprev;
+    if (pindexFront && pindexFront->nHeight > 0 && (int)vWindow.size() < nWindow7d) {
+        vWindow.push_front(MakeEntry(pindexFront));
+        Add7d(vWindow.front(), 1);
+        if ((int)vWindow.size() <= nWindow24h)
+            Add24h(vWindow.front(), 1);
+    }
+
+    auto it = mapLastBlock.find(entry.nAlgo);
+    if (it != mapLastBlock.end() && it->second == entry.pindex) {
+        if (entry.pindex->pprevAlgo)
+            it->second = entry.pindex->pprevAlgo;
+        else
+            mapLastBlock.erase(it);
+    }
+    pindexTip = entry.pindex->pprev;
+}
+
+void CAlgoStats::Reset(const CBlockIndex* pindex)
+{
+    const int nSpacing = Params().GetConsensus().nPowTargetSpacing;
+    nWindow24h = nWindow24hArg > 0 ? nWindow24hArg : (24 * 3600) / nSpacing;
+    nWindow7d = nWindow7dArg > 0 ? nWindow7dArg : (7 * 24 * 3600) / nSpacing;
+
+    vWindow.clear();
+    mapTotals.clear();
+    mapLastBlock.clear();
+    pindexTip = pindex;
+
+    std::vector<const CBlockIndex*> vConnect;
+    for (const CBlockIndex* pb = pindex; pb && pb->nHeight > 0 && (int)vConnect.size() < nWindow7d; pb = pb->pprev)
+        vConnect.push_back(pb);
+    for (auto it = vConnect.rbegin(); it != vConnect.rend(); ++it)
+        PushBack(*it);
+}
+
+void CAlgoStats::SetTip(const CBlockIndex* pindexNew)
+{
+    AssertLockHeld(cs_main);
+    LOCK(cs);
+
+    if (pindexNew == pindexTip)
+        return;
+
+    // Rebuild from scratch after a jump longer than the window or onto an unrelated chain
+    const CBlockIndex* pindexFork = pindexTip && pindexNew ? LastCommonAncestor(pindexTip, pindexNew) : nullptr;
+    if (!pindexFork || pindexTip->nHeight - pindexFork->nHeight > nWindow7d || pindexNew->nHeight - pindexFork->nHeight > nWindow7d) {
+        Reset(pindexNew);
+        return;
+    }
+
+    while (pindexTip != pindexFork && !vWindow.empty())
+        PopBack();
+    pindexTip = pindexFork;
+
+    std::vector<const CBlockIndex*> vConnect;
+    for (const CBlockIndex* pb = pindexNew; pb != pindexFork; pb = pb->pprev)
+        vConnect.push_back(pb);
+    for (auto it = vConnect.rbegin(); it != vConnect.rend(); ++it)
+        PushBack(*it);
+}
+
+CAlgoStats::Totals CAlgoStats::GetTotals(int32_t nAlgo) const
+{
+    LOCK(cs);
+    auto it = mapTotals.find(nAlgo);
+    return it == mapTotals.end() ? Totals() : it->second;
+}
+
+const CBlockIndex* CAlgoStats::GetLastBlock(int32_t nAlgo)
+{
+    LOCK(cs);
+    auto it = mapLastBlock.find(nAlgo);
+    if (it != mapLastBlock.end())
+        return it->second;
+    if (!pindexTip)
+        return nullptr;
+
+    // Not mined within the window, look further back once and remember it
+    const CBlockIndex* pb = pindexTip;
+    while (pb->GetAlgo() != nAlgo && pb->pprev)
+        pb = pb->pprev;
+    mapLastBlock[nAlgo] = pb;
+    return pb;
+}
+
+void CAlgoStats::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    // The RPCs catch up with the tip on their own, skip the subsidy computations during IBD
+    if (fInitialDownload)
+        return;
+
+    LOCK(cs_main);
+    SetTip(pindexNew);
+}
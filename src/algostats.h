@@ -0,0 +1,77 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef VELES_ALGOSTATS_H
+#define VELES_ALGOSTATS_H
+
+#include <amount.h>
+#include <sync.h>
+#include <validationinterface.h>
+
+#include <deque>
+#include <map>
+
+class CBlockIndex;
+
+/**
+ * Rolling per-algo mining statistics over the last 24 hours and 7 days worth
+ * of blocks of the active chain. The window follows the chain tip one block at
+ * a time, so the getminingstats and getmultialgoinfo RPCs don't have to walk
+ * the chain and recompute block subsidies on every call.
+ */
+class CAlgoStats : public CValidationInterface
+{
+public:
+    struct Totals {
+        int nBlocks24h = 0;
+        int nBlocks7d = 0;
+        CAmount nRewards24h = 0;
+        CAmount nRewards7d = 0;
+    };
+
+    /** Windows of nWindow24hIn and nWindow7dIn blocks, zero derives them from the PoW target spacing */
+    explicit CAlgoStats(int nWindow24hIn = 0, int nWindow7dIn = 0);
+
+    /** Move the window to end at pindexTip, connecting and disconnecting the blocks in between. Requires cs_main. */
+    void SetTip(const CBlockIndex* pindexTip);
+
+    /** Return the block and reward totals of nAlgo within the window */
+    Totals GetTotals(int32_t nAlgo) const;
+
+    /** Return the last block mined by nAlgo, or the genesis block when there is none */
+    const CBlockIndex* GetLastBlock(int32_t nAlgo);
+
+protected:
+    // CValidationInterface
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+
+private:
+    struct Entry {
+        const CBlockIndex* pindex;
+        int32_t nAlgo;
+        CAmount nReward;
+    };
+
+    mutable CCriticalSection cs;
+    const CBlockIndex* pindexTip = nullptr;
+    //! Blocks of the 7 day window, oldest first, the last nWindow24h of them form the 24 hour window
+    std::deque<Entry> vWindow;
+    const int nWindow24hArg;
+    const int nWindow7dArg;
+    int nWindow24h = 0;
+    int nWindow7d = 0;
+    std::map<int32_t, Totals> mapTotals;
+    std::map<int32_t, const CBlockIndex*> mapLastBlock;
+
+    Entry MakeEntry(const CBlockIndex* pindex) const;
+    void Add24h(const Entry& entry, int nSign);
+    void Add7d(const Entry& entry, int nSign);
+    void Reset(const CBlockIndex* pindex);
+    void PushBack(const CBlockIndex* pindex);
+    void PopBack();
+};
+
+extern CAlgoStats algoStats;
+
+#endif // VELES_ALGOSTATS_H
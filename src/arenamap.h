@@ -0,0 +1,285 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef VELES_ARENAMAP_H
+#define VELES_ARENAMAP_H
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/* Hash map with open addressing, for many small entries.
+ *
+ * Entries are stored in chunks of an arena and never move, so there is no
+ * allocation per entry. The table itself is a flat array of slots holding the
+ * arena index of an entry and the low 32 bits of its hash, probed linearly.
+ * The stored hash bits let lookups skip most foreign entries without touching
+ * the arena, and let the table grow without hashing the keys again.
+ *
+ * Differs from std::unordered_map in that erasing an entry leaves a tombstone
+ * in its slot, so iterators to other entries stay valid, including while every
+ * entry is erased from a loop. Tombstones at the end of a probe run are cleared
+ * right away, the others are dropped when the table is rebuilt. Like with
+ * std::unordered_map, references stay valid until the entry is erased, while
+ * iterators are invalidated by an insertion.
+ */
+template <class K, class T, class Hash>
+class arenamap {
+public:
+    typedef K key_type;
+    typedef T mapped_type;
+    typedef std::pair<const K, T> value_type;
+    typedef size_t size_type;
+
+private:
+    static const uint32_t EMPTY = 0xffffffff;
+    static const uint32_t DELETED = 0xfffffffe;
+    //! Arena indexes are the chunk number followed by this many bits of offset
+    static const unsigned int CHUNK_BITS = 12;
+    static const uint32_t CHUNK_MASK = (1 << CHUNK_BITS) - 1;
+    //! The first chunk holds this many entries, each next one twice as many up to 1 << CHUNK_BITS
+    static const size_t MIN_CHUNK_SIZE = 8;
+    static const size_t MIN_SLOTS = 8;
+
+    struct Slot {
+        uint32_t hash;
+        uint32_t index;
+    };
+
+    typedef typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type Storage;
+
+    std::vector<std::unique_ptr<Storage[]>> m_chunks;
+    //! Arena indexes of erased entries, to be reused first
+    std::vector<uint32_t> m_free;
+    //! Next arena index never handed out
+    uint32_t m_next = 0;
+    std::vector<Slot> m_slots;
+    size_t m_size = 0;
+    size_t m_deleted = 0;
+    Hash m_hash;
+
+    static bool IsLive(const Slot& slot) { return slot.index < DELETED; }
+
+    value_type& Value(uint32_t index) { return *reinterpret_cast<value_type*>(&m_chunks[index >> CHUNK_BITS][index & CHUNK_MASK]); }
+    const value_type& Value(uint32_t index) const { return *reinterpret_cast<const value_type*>(&m_chunks[index >> CHUNK_BITS][index & CHUNK_MASK]); }
+
+    size_t NextLive(size_t pos) const
+    {
+        while (pos < m_slots.size() && !IsLive(m_slots[pos])) ++pos;
+        return pos;
+    }
+
+    uint32_t Allocate()
+    {
+        if (!m_free.empty()) {
+            uint32_t index = m_free.back();
+            m_free.pop_back();
+            return index;
+        }
+        const uint32_t index = m_next;
+        assert(index < DELETED);
+        const size_t chunk = index >> CHUNK_BITS;
+        if (chunk == m_chunks.size()) {
+            m_chunks.emplace_back(new Storage[chunk_size(chunk)]);
+        }
+        m_next = (index & CHUNK_MASK) + 1 == chunk_size(chunk) ? (chunk + 1) << CHUNK_BITS : index + 1;
+        return index;
+    }
+
+    //! Position of the slot holding key, or m_slots.size()
+    size_t Lookup(const K& key) const
+    {
+        if (m_size == 0) return m_slots.size();
+        const uint32_t hash = m_hash(key);
+        const size_t mask = m_slots.size() - 1;
+        for (size_t pos = hash & mask;; pos = (pos + 1) & mask) {
+            const Slot& slot = m_slots[pos];
+            if (slot.index == EMPTY) return m_slots.size();
+            if (slot.index != DELETED && slot.hash == hash && Value(slot.index).first == key) return pos;
+        }
+    }
+
+    //! Position of the first free slot for hash, which is not present
+    size_t FreeSlot(uint32_t hash) const
+    {
+        const size_t mask = m_slots.size() - 1;
+        size_t pos = hash & mask;
+        while (IsLive(m_slots[pos])) pos = (pos + 1) & mask;
+        return pos;
+    }
+
+    void Rehash(size_t count)
+    {
+        std::vector<Slot> old(count, Slot{0, EMPTY});
+        old.swap(m_slots);
+        for (const Slot& slot : old) {
+            if (IsLive(slot)) m_slots[FreeSlot(slot.hash)] = slot;
+        }
+        m_deleted = 0;
+    }
+
+    void Destroy()
+    {
+        for (const Slot& slot : m_slots) {
+            if (IsLive(slot)) Value(slot.index).~value_type();
+        }
+    }
+
+public:
+    template <bool Const>
+    class Iterator {
+        friend class arenamap;
+        friend class Iterator<!Const>;
+        typedef typename std::conditional<Const, const arenamap, arenamap>::type Map;
+        Map* map;
+        size_t pos;
+        Iterator(Map* mapIn, size_t posIn) : map(mapIn), pos(posIn) {}
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef typename arenamap::value_type value_type;
+        typedef ptrdiff_t difference_type;
+        typedef typename std::conditional<Const, const value_type*, value_type*>::type pointer;
+        typedef typename std::conditional<Const, const value_type&, value_type&>::type reference;
+
+        Iterator() : map(nullptr), pos(0) {}
+        Iterator(const Iterator<false>& it) : map(it.map), pos(it.pos) {}
+
+        reference operator*() const { return map->Value(map->m_slots[pos].index); }
+        pointer operator->() const { return &map->Value(map->m_slots[pos].index); }
+        Iterator& operator++() { pos = map->NextLive(pos + 1); return *this; }
+        Iterator operator++(int) { Iterator ret = *this; ++*this; return ret; }
+
+        friend bool operator==(const Iterator& a, const Iterator& b) { return a.pos == b.pos && a.map == b.map; }
+        friend bool operator!=(const Iterator& a, const Iterator& b) { return !(a == b); }
+    };
+
+    typedef Iterator<false> iterator;
+    typedef Iterator<true> const_iterator;
+
+    arenamap() {}
+    arenamap(const arenamap&) = delete;
+    arenamap& operator=(const arenamap&) = delete;
+    ~arenamap() { Destroy(); }
+
+    iterator begin() { return iterator(this, NextLive(0)); }
+    const_iterator begin() const { return const_iterator(this, NextLive(0)); }
+    iterator end() { return iterator(this, m_slots.size()); }
+    const_iterator end() const { return const_iterator(this, m_slots.size()); }
+
+    size_type size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    iterator find(const K& key) { return iterator(this, Lookup(key)); }
+    const_iterator find(const K& key) const { return const_iterator(this, Lookup(key)); }
+    size_type count(const K& key) const { return Lookup(key) != m_slots.size(); }
+
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args)
+    {
+        const uint32_t index = Allocate();
+        try {
+            new (&Value(index)) value_type(std::forward<Args>(args)...);
+        } catch (...) {
+            m_free.push_back(index);
+            throw;
+        }
+        const size_t found = Lookup(Value(index).first);
+        if (found != m_slots.size()) {
+            Value(index).~value_type();
+            m_free.push_back(index);
+            return std::make_pair(iterator(this, found), false);
+        }
+        if ((m_size + m_deleted + 1) * 4 > m_slots.size() * 3) {
+            // Grow when more than half of the slots are in use, otherwise only drop the tombstones
+            size_t slots = m_slots.empty() ? MIN_SLOTS : m_slots.size();
+            while ((m_size + 1) * 2 > slots) slots *= 2;
+            Rehash(slots);
+        }
+        const uint32_t hash = m_hash(Value(index).first);
+        const size_t pos = FreeSlot(hash);
+        if (m_slots[pos].index == DELETED) --m_deleted;
+        m_slots[pos] = Slot{hash, index};
+        ++m_size;
+        return std::make_pair(iterator(this, pos), true);
+    }
+
+    T& operator[](const K& key)
+    {
+        return emplace(std::piecewise_construct, std::forward_as_tuple(key), std::tuple<>()).first->second;
+    }
+
+    iterator erase(const_iterator it)
+    {
+        Slot& slot = m_slots[it.pos];
+        Value(slot.index).~value_type();
+        m_free.push_back(slot.index);
+        --m_size;
+        const size_t mask = m_slots.size() - 1;
+        if (m_slots[(it.pos + 1) & mask].index == EMPTY) {
+            // Nothing probes past this slot, so it and the tombstones before it can be emptied
+            slot.index = EMPTY;
+            for (size_t pos = (it.pos - 1) & mask; m_slots[pos].index == DELETED; pos = (pos - 1) & mask) {
+                m_slots[pos].index = EMPTY;
+                --m_deleted;
+            }
+        } else {
+            slot.index = DELETED;
+            ++m_deleted;
+        }
+        if (m_size == 0) {
+            // All entries are gone, hand out the arena from its start again
+            m_free.clear();
+            m_next = 0;
+        }
+        return iterator(this, NextLive(it.pos + 1));
+    }
+
+    size_type erase(const K& key)
+    {
+        const size_t pos = Lookup(key);
+        if (pos == m_slots.size()) return 0;
+        erase(const_iterator(this, pos));
+        return 1;
+    }
+
+    void clear()
+    {
+        Destroy();
+        std::vector<std::unique_ptr<Storage[]>>().swap(m_chunks);
+        std::vector<uint32_t>().swap(m_free);
+        std::vector<Slot>().swap(m_slots);
+        m_next = 0;
+        m_size = 0;
+        m_deleted = 0;
+    }
+
+    void swap(arenamap& other)
+    {
+        m_chunks.swap(other.m_chunks);
+        m_free.swap(other.m_free);
+        std::swap(m_next, other.m_next);
+        m_slots.swap(other.m_slots);
+        std::swap(m_size, other.m_size);
+        std::swap(m_deleted, other.m_deleted);
+        std::swap(m_hash, other.m_hash);
+    }
+
+    //! Number of entries the arena chunk with the given number holds
+    static size_t chunk_size(size_t chunk) { return chunk < CHUNK_BITS ? std::min<size_t>(MIN_CHUNK_SIZE << chunk, CHUNK_MASK + 1) : CHUNK_MASK + 1; }
+    static size_t entry_bytes() { return sizeof(Storage); }
+    size_t chunk_count() const { return m_chunks.size(); }
+    size_t slot_bytes() const { return m_slots.capacity() * sizeof(Slot); }
+    size_t free_list_bytes() const { return m_free.capacity() * sizeof(uint32_t); }
+};
+
+#endif // VELES_ARENAMAP_H
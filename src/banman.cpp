@@ -61,6 +61,7 @@ void BanMan::ClearBanned()
     {
         LOCK(m_cs_banned);
         m_banned.clear();
+        ReindexBanned(); // VELES
         m_is_dirty = true;
     }
     DumpBanlist(); //store banlist to disk
@@ -76,15 +77,27 @@ int BanMan::IsBannedLevel(CNetAddr net_addr)
     int level = 0;
     auto current_time = GetTime();
     LOCK(m_cs_banned);
-    for (const auto& it : m_banned) {
-        CSubNet sub_net = it.first;
-        CBanEntry ban_entry = it.second;
-
-        if (current_time < ban_entry.nBanUntil && sub_net.Match(net_addr)) {
-            if (ban_entry.banReason != BanReasonNodeMisbehaving) return 2;
+    // VELES BEGIN
+    //for (const auto& it : m_banned) {
+    //    CSubNet sub_net = it.first;
+    //    CBanEntry ban_entry = it.second;
+    //
+    //    if (current_time < ban_entry.nBanUntil && sub_net.Match(net_addr)) {
+    //        if (ban_entry.banReason != BanReasonNodeMisbehaving) return 2;
+    //        level = 1;
+    //    }
+    //}
+    ForEachMatchingBan(net_addr, [&](const CBanEntry& ban_entry) {
+        if (current_time < ban_entry.nBanUntil) {
+            if (ban_entry.banReason != BanReasonNodeMisbehaving) {
+                level = 2;
+                return false;
+            }
             level = 1;
         }
-    }
+        return true;
+    });
+    // VELES END
     return level;
 }
 
@@ -92,15 +105,23 @@ bool BanMan::IsBanned(CNetAddr net_addr)
 {
     auto current_time = GetTime();
     LOCK(m_cs_banned);
-    for (const auto& it : m_banned) {
-        CSubNet sub_net = it.first;
-        CBanEntry ban_entry = it.second;
-
-        if (current_time < ban_entry.nBanUntil && sub_net.Match(net_addr)) {
-            return true;
-        }
-    }
-    return false;
+    // VELES BEGIN
+    //for (const auto& it : m_banned) {
+    //    CSubNet sub_net = it.first;
+    //    CBanEntry ban_entry = it.second;
+    //
+    //    if (current_time < ban_entry.nBanUntil && sub_net.Match(net_addr)) {
+    //        return true;
+    //    }
+    //}
+    //return false;
+    bool banned = false;
+    ForEachMatchingBan(net_addr, [&](const CBanEntry& ban_entry) {
+        banned = current_time < ban_entry.nBanUntil;
+        return !banned;
+    });
+    return banned;
+    // VELES END
 }
 
 bool BanMan::IsBanned(CSubNet sub_net)
@@ -137,6 +158,7 @@ void BanMan::Ban(const CSubNet& sub_net, const BanReason& ban_reason, int64_t ba
 
     {
         LOCK(m_cs_banned);
+        if (!m_banned.count(sub_net)) IndexBanned(sub_net, true); // VELES
         if (m_banned[sub_net].nBanUntil < ban_entry.nBanUntil) {
             m_banned[sub_net] = ban_entry;
             m_is_dirty = true;
@@ -160,6 +182,7 @@ bool BanMan::Unban(const CSubNet& sub_net)
     {
         LOCK(m_cs_banned);
         if (m_banned.erase(sub_net) == 0) return false;
+        IndexBanned(sub_net, false); // VELES
         m_is_dirty = true;
     }
     if (m_client_interface) m_client_interface->BannedListChanged();
@@ -179,6 +202,7 @@ void BanMan::SetBanned(const banmap_t& banmap)
 {
     LOCK(m_cs_banned);
     m_banned = banmap;
+    ReindexBanned(); // VELES
     m_is_dirty = true;
 }
 
@@ -194,6 +218,7 @@ void BanMan::SweepBanned()
             CBanEntry ban_entry = (*it).second;
             if (now > ban_entry.nBanUntil) {
                 m_banned.erase(it++);
+                IndexBanned(sub_net, false); // VELES
                 m_is_dirty = true;
                 notify_ui = true;
                 LogPrint(BCLog::NET, "%s: Removed banned node ip/subnet from banlist.dat: %s\n", __func__, sub_net.ToString());
@@ -218,3 +243,50 @@ void BanMan::SetBannedSetDirty(bool dirty)
     LOCK(m_cs_banned); //reuse m_banned lock for the m_is_dirty flag
     m_is_dirty = dirty;
 }
+
+// VELES BEGIN
+void BanMan::IndexBanned(const CSubNet& sub_net, bool add)
+{
+    AssertLockHeld(m_cs_banned);
+    const int prefix_length = sub_net.GetPrefixLength();
+    if (prefix_length < 0) {
+        if (add) {
+            m_banned_other.insert(sub_net);
+        } else {
+            m_banned_other.erase(sub_net);
+        }
+    } else if (add) {
+        ++m_banned_prefix_lengths[prefix_length];
+    } else {
+        auto it = m_banned_prefix_lengths.find(prefix_length);
+        if (it != m_banned_prefix_lengths.end() && --it->second == 0) m_banned_prefix_lengths.erase(it);
+    }
+}
+
+void BanMan::ReindexBanned()
+{
+    AssertLockHeld(m_cs_banned);
+    m_banned_prefix_lengths.clear();
+    m_banned_other.clear();
+    for (const auto& it : m_banned) {
+        IndexBanned(it.first, true);
+    }
+}
+
+template <typename Callable>
+void BanMan::ForEachMatchingBan(const CNetAddr& net_addr, Callable fn)
+{
+    AssertLockHeld(m_cs_banned);
+    if (!net_addr.IsValid()) return;
+    // The subnets of a prefix length matching net_addr are all equal to the one
+    // of net_addr masked to that length, a single lookup finds any of them
+    for (const auto& length : m_banned_prefix_lengths) {
+        auto it = m_banned.find(CSubNet::FromPrefix(net_addr, length.first));
+        if (it != m_banned.end() && it->first.IsValid() && !fn(it->second)) return;
+    }
+    for (const CSubNet& sub_net : m_banned_other) {
+        auto it = m_banned.find(sub_net);
+        if (it != m_banned.end() && sub_net.Match(net_addr) && !fn(it->second)) return;
+    }
+}
+// VELES END
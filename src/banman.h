@@ -6,7 +6,9 @@
 #define BITCOIN_BANMAN_H
 
 #include <cstdint>
+#include <map> // VELES
 #include <memory>
+#include <set> // VELES
 
 #include <addrdb.h>
 #include <fs.h>
@@ -57,9 +59,24 @@ private:
     void SetBannedSetDirty(bool dirty = true);
     //!clean unused entries (if bantime has expired)
     void SweepBanned();
+    // VELES BEGIN
+    //!add a subnet to or remove it from the indexes of m_banned
+    void IndexBanned(const CSubNet& sub_net, bool add) EXCLUSIVE_LOCKS_REQUIRED(m_cs_banned);
+    //!rebuild the indexes of m_banned
+    void ReindexBanned() EXCLUSIVE_LOCKS_REQUIRED(m_cs_banned);
+    //!call fn with the ban entries of the subnets matching net_addr until it returns false
+    template <typename Callable>
+    void ForEachMatchingBan(const CNetAddr& net_addr, Callable fn) EXCLUSIVE_LOCKS_REQUIRED(m_cs_banned);
+    // VELES END
 
     CCriticalSection m_cs_banned;
     banmap_t m_banned GUARDED_BY(m_cs_banned);
+    // VELES BEGIN
+    //! Number of banned subnets by netmask prefix length, an address is looked up in m_banned once per length
+    std::map<int, size_t> m_banned_prefix_lengths GUARDED_BY(m_cs_banned);
+    //! Banned subnets whose netmask isn't a prefix, matched one by one
+    std::set<CSubNet> m_banned_other GUARDED_BY(m_cs_banned);
+    // VELES END
     bool m_is_dirty GUARDED_BY(m_cs_banned);
     CClientUIInterface* m_client_interface = nullptr;
     CBanDB m_ban_db;
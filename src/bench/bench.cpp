@@ -4,12 +4,18 @@
 
 #include <bench/bench.h>
 
+// VELES BEGIN
+#include <tinyformat.h>
+#include <univalue.h>
+// VELES END
+
 #include <assert.h>
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
 #include <regex>
 #include <numeric>
+#include <cmath> // VELES
 
 void benchmark::ConsolePrinter::header()
 {
@@ -81,6 +87,192 @@ void benchmark::PlotlyPrinter::footer()
               << "</script></body></html>";
 }
 
+// VELES BEGIN
+namespace {
+struct Summary {
+    double total = 0;
+    double min = 0;
+    double max = 0;
+    double median = 0;
+
+    explicit Summary(const benchmark::State& state)
+    {
+        std::vector<double> results = state.m_elapsed_results;
+        if (results.empty()) return;
+        std::sort(results.begin(), results.end());
+        total = state.m_num_iters * std::accumulate(results.begin(), results.end(), 0.0);
+        min = results.front();
+        max = results.back();
+        size_t mid = results.size() / 2;
+        median = results.size() % 2 ? results[mid] : (results[mid - 1] + results[mid]) / 2;
+    }
+};
+
+double Median(std::vector<double> values)
+{
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    size_t mid = values.size() / 2;
+    return values.size() % 2 ? values[mid] : (values[mid - 1] + values[mid]) / 2;
+}
+
+// Two-sided p-value of the Mann-Whitney U test, from the exact distribution of U
+// under the null hypothesis: the number of orderings of the samples giving U = u
+// is the coefficient of q^u in the Gaussian binomial [n1 + n2, n1]_q.
+double MannWhitneyPValue(const std::vector<double>& a, const std::vector<double>& b)
+{
+    const size_t n1 = a.size(), n2 = b.size();
+    if (n1 == 0 || n2 == 0) return 1;
+
+    double u = 0;
+    for (double x : a) {
+        for (double y : b) {
+            u += x < y ? 1 : x == y ? 0.5 : 0;
+        }
+    }
+
+    std::vector<double> count(1, 1.0);
+    for (size_t i = 1; i <= n1; i++) {
+        // multiply by 1 - q^(n2 + i), then divide by 1 - q^i
+        const size_t m = n2 + i;
+        count.resize(count.size() + m, 0.0);
+        for (size_t j = count.size() - 1; j >= m; j--) {
+            count[j] -= count[j - m];
+        }
+        for (size_t j = i; j < count.size(); j++) {
+            count[j] += count[j - i];
+        }
+    }
+    count.resize(n1 * n2 + 1);
+
+    const double total = std::accumulate(count.begin(), count.end(), 0.0);
+    double below = 0, above = 0;
+    for (size_t j = 0; j < count.size(); j++) {
+        if (j <= std::floor(u)) below += count[j];
+        if (j >= std::ceil(u)) above += count[j];
+    }
+    return std::min(1.0, 2 * std::min(below, above) / total);
+}
+}
+
+void benchmark::JsonPrinter::header()
+{
+    std::cout << "[" << std::endl;
+}
+
+void benchmark::JsonPrinter::result(const State& state)
+{
+    const Summary summary(state);
+    UniValue results(UniValue::VARR);
+    for (double e : state.m_elapsed_results) {
+        results.push_back(e);
+    }
+
+    UniValue entry(UniValue::VOBJ);
+    entry.pushKV("name", state.m_name);
+    entry.pushKV("evals", state.m_num_evals);
+    entry.pushKV("iterations", state.m_num_iters);
+    entry.pushKV("total", summary.total);
+    entry.pushKV("min", summary.min);
+    entry.pushKV("max", summary.max);
+    entry.pushKV("median", summary.median);
+    entry.pushKV("ns_per_op", summary.median * 1e9);
+    entry.pushKV("results", results);
+
+    std::cout << (m_first ? "" : ",\n") << entry.write(2, 2);
+    m_first = false;
+}
+
+void benchmark::JsonPrinter::footer()
+{
+    std::cout << std::endl << "]" << std::endl;
+}
+
+void benchmark::CsvPrinter::header()
+{
+    std::cout << "name,evals,iterations,total,min,max,median,ns_per_op" << std::endl;
+}
+
+void benchmark::CsvPrinter::result(const State& state)
+{
+    const Summary summary(state);
+    std::cout << std::setprecision(6);
+    std::cout << state.m_name << "," << state.m_num_evals << "," << state.m_num_iters << "," << summary.total << ","
+              << summary.min << "," << summary.max << "," << summary.median << "," << summary.median * 1e9 << std::endl;
+}
+
+void benchmark::CsvPrinter::footer() {}
+
+bool benchmark::ReadBaseline(const std::string& json, BaselineMap& baseline, std::string& error)
+{
+    UniValue entries;
+    if (!entries.read(json) || !entries.isArray()) {
+        error = "not a JSON array";
+        return false;
+    }
+    for (const UniValue& entry : entries.getValues()) {
+        const UniValue& name = find_value(entry, "name");
+        const UniValue& results = find_value(entry, "results");
+        if (!name.isStr() || !results.isArray()) {
+            error = "benchmark without name or results";
+            return false;
+        }
+        std::vector<double>& values = baseline[name.get_str()];
+        for (const UniValue& result : results.getValues()) {
+            if (!result.isNum()) {
+                error = strprintf("invalid result of %s", name.get_str());
+                return false;
+            }
+            values.push_back(result.get_real());
+        }
+    }
+    return true;
+}
+
+benchmark::ComparePrinter::ComparePrinter(BaselineMap baseline, double significance)
+    : m_baseline(std::move(baseline)), m_significance(significance), m_regressions(0)
+{
+}
+
+void benchmark::ComparePrinter::header()
+{
+    std::cout << "# Benchmark, baseline median, median, change, p-value, result" << std::endl;
+}
+
+void benchmark::ComparePrinter::result(const State& state)
+{
+    const double median = Median(state.m_elapsed_results);
+    std::cout << std::setprecision(6);
+
+    auto it = m_baseline.find(state.m_name);
+    if (it == m_baseline.end() || it->second.empty() || state.m_elapsed_results.empty()) {
+        std::cout << state.m_name << ", -, " << median << ", -, -, no baseline" << std::endl;
+        return;
+    }
+
+    const double baseline_median = Median(it->second);
+    const double change = baseline_median > 0 ? 100 * (median - baseline_median) / baseline_median : 0;
+    const double p_value = MannWhitneyPValue(it->second, state.m_elapsed_results);
+
+    const char* verdict = "unchanged";
+    if (p_value < m_significance) {
+        if (median > baseline_median) {
+            verdict = "REGRESSION";
+            m_regressions++;
+        } else if (median < baseline_median) {
+            verdict = "improvement";
+        }
+    }
+    std::cout << state.m_name << ", " << baseline_median << ", " << median << ", " << std::showpos << change << std::noshowpos
+              << "%, " << p_value << ", " << verdict << std::endl;
+}
+
+void benchmark::ComparePrinter::footer()
+{
+    std::cout << "# " << m_regressions << " significant regression(s) at p < " << m_significance << std::endl;
+}
+// VELES END
+
 
 benchmark::BenchRunner::BenchmarkMap& benchmark::BenchRunner::benchmarks()
 {
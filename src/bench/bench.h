@@ -130,6 +130,54 @@ private:
     int64_t m_width;
     int64_t m_height;
 };
+
+// VELES BEGIN
+// prints the results as a JSON array, with the time of every evaluation so that
+// later runs can be compared against them.
+class JsonPrinter : public Printer
+{
+public:
+    void header() override;
+    void result(const State& state) override;
+    void footer() override;
+
+private:
+    bool m_first = true;
+};
+
+// prints the results as CSV, with the time per iteration in nanoseconds.
+class CsvPrinter : public Printer
+{
+public:
+    void header() override;
+    void result(const State& state) override;
+    void footer() override;
+};
+
+// time per iteration of every evaluation, by benchmark name
+typedef std::map<std::string, std::vector<double>> BaselineMap;
+
+// reads a baseline from the output of JsonPrinter.
+bool ReadBaseline(const std::string& json, BaselineMap& baseline, std::string& error);
+
+// compares the results with those of a baseline run, using a Mann-Whitney U
+// test on the times of the evaluations.
+class ComparePrinter : public Printer
+{
+public:
+    ComparePrinter(BaselineMap baseline, double significance);
+    void header() override;
+    void result(const State& state) override;
+    void footer() override;
+
+    int GetRegressions() const { return m_regressions; }
+
+private:
+    BaselineMap m_baseline;
+    double m_significance;
+    int m_regressions;
+};
+// VELES END
 }
 
 
@@ -4,12 +4,15 @@
 
 #include <bench/bench.h>
 
+#include <crypto/scrypt.h>
 #include <crypto/sha256.h>
+#include <crypto/sph_hw.h> // VELES
 #include <key.h>
 #include <util/system.h>
 #include <util/strencodings.h>
 #include <validation.h>
 
+#include <iterator> // VELES
 #include <memory>
 
 const std::function<std::string(const char*)> G_TRANSLATION_FUN = nullptr;
@@ -21,6 +24,7 @@ static const char* DEFAULT_BENCH_PRINTER = "console";
 static const char* DEFAULT_PLOT_PLOTLYURL = "https://cdn.plot.ly/plotly-latest.min.js";
 static const int64_t DEFAULT_PLOT_WIDTH = 1024;
 static const int64_t DEFAULT_PLOT_HEIGHT = 768;
+static const char* DEFAULT_BENCH_SIGNIFICANCE = "0.05"; // VELES
 
 static void SetupBenchArgs()
 {
@@ -30,7 +34,14 @@ static void SetupBenchArgs()
     gArgs.AddArg("-evals=<n>", strprintf("Number of measurement evaluations to perform. (default: %u)", DEFAULT_BENCH_EVALUATIONS), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-filter=<regex>", strprintf("Regular expression filter to select benchmark by name (default: %s)", DEFAULT_BENCH_FILTER), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-scaling=<n>", strprintf("Scaling factor for benchmark's runtime (default: %u)", DEFAULT_BENCH_SCALING), false, OptionsCategory::OPTIONS);
-    gArgs.AddArg("-printer=(console|plot)", strprintf("Choose printer format. console: print data to console. plot: Print results as HTML graph (default: %s)", DEFAULT_BENCH_PRINTER), false, OptionsCategory::OPTIONS);
+    //gArgs.AddArg("-printer=(console|plot)", strprintf("Choose printer format. console: print data to console. plot: Print results as HTML graph (default: %s)", DEFAULT_BENCH_PRINTER), false, OptionsCategory::OPTIONS);
+    // VELES BEGIN
+    gArgs.AddArg("-printer=(console|plot|json|csv)", strprintf("Choose printer format. console: print data to console. plot: Print results as HTML graph. json: Print results as JSON, usable as a baseline for -compare. csv: Print results as CSV (default: %s)", DEFAULT_BENCH_PRINTER), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-compare=<file>", "Print a comparison of the results with a baseline printed by -printer=json instead of the results, and exit with an error on a significant regression", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-significance=<p>", strprintf("Largest p-value of a change reported by -compare (default: %s)", DEFAULT_BENCH_SIGNIFICANCE), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-replay-blocks=<file>", "Mainnet blocks replayed by ConnectBlockReplay, in the format of -loadblock", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-replay-from=<n>", "Height of the first block timed by ConnectBlockReplay, the blocks below it are only connected once (default: 1)", false, OptionsCategory::OPTIONS);
+    // VELES END
     gArgs.AddArg("-plot-plotlyurl=<uri>", strprintf("URL to use for plotly.js (default: %s)", DEFAULT_PLOT_PLOTLYURL), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-plot-width=<x>", strprintf("Plot width in pixel (default: %u)", DEFAULT_PLOT_WIDTH), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-plot-height=<x>", strprintf("Plot height in pixel (default: %u)", DEFAULT_PLOT_HEIGHT), false, OptionsCategory::OPTIONS);
@@ -63,6 +74,10 @@ int main(int argc, char** argv)
     const fs::path bench_datadir{SetDataDir()};
 
     SHA256AutoDetect();
+    // VELES BEGIN
+    scrypt_detect();
+    SphAutoDetect();
+    // VELES END
     ECC_Start();
     SetupEnvironment();
 
@@ -85,6 +100,38 @@ int main(int argc, char** argv)
             gArgs.GetArg("-plot-width", DEFAULT_PLOT_WIDTH),
             gArgs.GetArg("-plot-height", DEFAULT_PLOT_HEIGHT)));
     }
+    // VELES BEGIN
+    else if ("json" == printer_arg) {
+        printer.reset(new benchmark::JsonPrinter());
+    } else if ("csv" == printer_arg) {
+        printer.reset(new benchmark::CsvPrinter());
+    }
+
+    benchmark::ComparePrinter* compare_printer = nullptr;
+    if (gArgs.IsArgSet("-compare")) {
+        double significance;
+        std::string significance_str = gArgs.GetArg("-significance", DEFAULT_BENCH_SIGNIFICANCE);
+        if (!ParseDouble(significance_str, &significance)) {
+            tfm::format(std::cerr, "Error parsing significance as double: %s\n", significance_str.c_str());
+            return EXIT_FAILURE;
+        }
+
+        std::string compare_file = gArgs.GetArg("-compare", "");
+        fsbridge::ifstream file(compare_file);
+        if (!file) {
+            tfm::format(std::cerr, "Error reading baseline %s\n", compare_file.c_str());
+            return EXIT_FAILURE;
+        }
+        std::string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        benchmark::BaselineMap baseline;
+        if (!benchmark::ReadBaseline(json, baseline, error)) {
+            tfm::format(std::cerr, "Error parsing baseline %s: %s\n", compare_file.c_str(), error.c_str());
+            return EXIT_FAILURE;
+        }
+        compare_printer = new benchmark::ComparePrinter(std::move(baseline), significance);
+        printer.reset(compare_printer);
+    }
+    // VELES END
 
     benchmark::BenchRunner::RunAll(*printer, evaluations, scaling_factor, regex_filter, is_list_only);
 
@@ -92,5 +139,11 @@ int main(int argc, char** argv)
 
     ECC_Stop();
 
+    // VELES BEGIN
+    if (compare_printer && compare_printer->GetRegressions() > 0) {
+        return EXIT_FAILURE;
+    }
+    // VELES END
+
     return EXIT_SUCCESS;
 }
@@ -4,7 +4,9 @@
 
 #include <bench/bench.h>
 #include <coins.h>
+#include <crypto/common.h> // VELES
 #include <policy/policy.h>
+#include <random.h> // VELES
 #include <wallet/crypter.h>
 
 #include <vector>
@@ -86,3 +88,56 @@ static void CCoinsCaching(benchmark::State& state)
 }
 
 BENCHMARK(CCoinsCaching, 170 * 1000);
+
+// VELES BEGIN
+static const size_t CACHE_BENCH_COINS = 100000;
+
+static COutPoint CacheBenchOutPoint(size_t i)
+{
+    uint256 hash;
+    WriteLE64(hash.begin(), i);
+    return COutPoint(hash, i % 3);
+}
+
+static void FillCache(CCoinsViewCache& coins)
+{
+    CTxOut txout(COIN, CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 1) << OP_EQUALVERIFY << OP_CHECKSIG);
+    for (size_t i = 0; i < CACHE_BENCH_COINS; ++i) {
+        coins.AddCoin(CacheBenchOutPoint(i), Coin(txout, 1, false), false);
+    }
+}
+
+// Fill a cache the way blocks fill the coins tip, then flush it into a parent
+// cache, which erases every entry while iterating over them.
+static void CCoinsCacheFill(benchmark::State& state)
+{
+    while (state.KeepRunning()) {
+        CCoinsView coinsDummy;
+        CCoinsViewCache base(&coinsDummy);
+        CCoinsViewCache coins(&base);
+        FillCache(coins);
+        assert(coins.GetCacheSize() == CACHE_BENCH_COINS);
+        bool success = coins.Flush();
+        assert(success);
+    }
+}
+
+// Look up cached coins in a random order, half of them hits and half misses.
+static void CCoinsCacheAccess(benchmark::State& state)
+{
+    CCoinsView coinsDummy;
+    CCoinsViewCache coins(&coinsDummy);
+    FillCache(coins);
+    FastRandomContext rng(true);
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < 1000; ++i) {
+            const size_t n = rng.randrange(2 * CACHE_BENCH_COINS);
+            bool spent = coins.AccessCoin(CacheBenchOutPoint(n)).IsSpent();
+            assert(spent == (n >= CACHE_BENCH_COINS));
+        }
+    }
+}
+
+BENCHMARK(CCoinsCacheFill, 10);
+BENCHMARK(CCoinsCacheAccess, 1000);
+// VELES END
@@ -33,6 +33,29 @@ static void DeserializeBlockTest(benchmark::State& state)
     }
 }
 
+// VELES BEGIN
+static void DeserializeBlockArenaTest(benchmark::State& state)
+{
+    CDataStream stream((const char*)block_bench::block413567,
+            (const char*)block_bench::block413567 + sizeof(block_bench::block413567),
+            SER_NETWORK, PROTOCOL_VERSION);
+    char a = '\0';
+    stream.write(&a, 1); // Prevent compaction
+
+    CMonotonicArena arena;
+    while (state.KeepRunning()) {
+        {
+            CBlock block;
+            CTxArenaScope scope(arena);
+            stream >> block;
+            bool rewound = stream.Rewind(sizeof(block_bench::block413567));
+            assert(rewound);
+        }
+        arena.Clear();
+    }
+}
+// VELES END
+
 static void DeserializeAndCheckBlockTest(benchmark::State& state)
 {
     CDataStream stream((const char*)block_bench::block413567,
@@ -57,3 +80,4 @@ static void DeserializeAndCheckBlockTest(benchmark::State& state)
 
 BENCHMARK(DeserializeBlockTest, 130);
 BENCHMARK(DeserializeAndCheckBlockTest, 160);
+BENCHMARK(DeserializeBlockArenaTest, 130); // VELES
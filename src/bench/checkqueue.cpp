@@ -21,22 +21,27 @@ static const unsigned int QUEUE_BATCH_SIZE = 128;
 // This Benchmark tests the CheckQueue with a slightly realistic workload,
 // where checks all contain a prevector that is indirect 50% of the time
 // and there is a little bit of work done between calls to Add.
-static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
+// VELES BEGIN
+struct PrevectorJob {
+    prevector<PREVECTOR_SIZE, uint8_t> p;
+    PrevectorJob(){
+    }
+    explicit PrevectorJob(FastRandomContext& insecure_rand){
+        p.resize(insecure_rand.randrange(PREVECTOR_SIZE*2));
+    }
+    bool operator()()
+    {
+        return true;
+    }
+    void swap(PrevectorJob& x){p.swap(x.p);};
+};
+
+//static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
+template <typename Q>
+static void CheckQueueSpeedPrevectorJob(benchmark::State& state)
 {
-    struct PrevectorJob {
-        prevector<PREVECTOR_SIZE, uint8_t> p;
-        PrevectorJob(){
-        }
-        explicit PrevectorJob(FastRandomContext& insecure_rand){
-            p.resize(insecure_rand.randrange(PREVECTOR_SIZE*2));
-        }
-        bool operator()()
-        {
-            return true;
-        }
-        void swap(PrevectorJob& x){p.swap(x.p);};
-    };
-    CCheckQueue<PrevectorJob> queue {QUEUE_BATCH_SIZE};
+    Q queue {QUEUE_BATCH_SIZE};
+// VELES END
     boost::thread_group tg;
     for (auto x = 0; x < std::max(MIN_CORES, GetNumCores()); ++x) {
        tg.create_thread([&]{queue.Thread();});
@@ -44,7 +49,7 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
     while (state.KeepRunning()) {
         // Make insecure_rand here so that each iteration is identical.
         FastRandomContext insecure_rand(true);
-        CCheckQueueControl<PrevectorJob> control(&queue);
+        CCheckQueueControl<PrevectorJob, Q> control(&queue); // VELES
         std::vector<std::vector<PrevectorJob>> vBatches(BATCHES);
         for (auto& vChecks : vBatches) {
             vChecks.reserve(BATCH_SIZE);
@@ -59,4 +64,15 @@ static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
     tg.interrupt_all();
     tg.join_all();
 }
+// VELES BEGIN
+static void CCheckQueueSpeedPrevectorJob(benchmark::State& state)
+{
+    CheckQueueSpeedPrevectorJob<CCheckQueue<PrevectorJob>>(state);
+}
+static void CWorkStealingCheckQueueSpeedPrevectorJob(benchmark::State& state)
+{
+    CheckQueueSpeedPrevectorJob<CWorkStealingCheckQueue<PrevectorJob>>(state);
+}
+// VELES END
 BENCHMARK(CCheckQueueSpeedPrevectorJob, 1400);
+BENCHMARK(CWorkStealingCheckQueueSpeedPrevectorJob, 1400); // VELES
@@ -61,6 +61,18 @@ static void SHA256D64_1024(benchmark::State& state)
     }
 }
 
+// VELES BEGIN
+// The 100 byte messages of the scores of 1024 masternodes
+static void SHA256DN_100b_1024(benchmark::State& state)
+{
+    std::vector<uint8_t> in(100 * 1024, 0);
+    std::vector<uint8_t> out(32 * 1024);
+    while (state.KeepRunning()) {
+        SHA256DN(out.data(), in.data(), 100, 1024);
+    }
+}
+// VELES END
+
 static void SHA512(benchmark::State& state)
 {
     uint8_t hash[CSHA512::OUTPUT_SIZE];
@@ -102,5 +114,6 @@ BENCHMARK(SHA512, 330);
 BENCHMARK(SHA256_32b, 4700 * 1000);
 BENCHMARK(SipHash_32b, 40 * 1000 * 1000);
 BENCHMARK(SHA256D64_1024, 7400);
+BENCHMARK(SHA256DN_100b_1024, 4900); // VELES
 BENCHMARK(FastRandom_32bit, 110 * 1000 * 1000);
 BENCHMARK(FastRandom_1bit, 440 * 1000 * 1000);
@@ -0,0 +1,298 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <clientversion.h>
+#include <coins.h>
+#include <governance/governance.h>
+#include <governance/object.h>
+#include <governance/vote.h>
+#include <governance/votedb.h>
+#include <instantx.h>
+#include <masternode/activemasternode.h>
+#include <masternode/manager.h>
+#include <masternode/masternode.h>
+#include <masternode/sync.h>
+#include <net.h>
+#include <netbase.h>
+#include <protocol.h>
+#include <random.h>
+#include <scheduler.h>
+#include <script/standard.h>
+#include <streams.h>
+#include <util/memory.h>
+#include <util/strencodings.h>
+#include <validation.h>
+#include <validationinterface.h>
+#include <version.h>
+
+#include <boost/thread.hpp>
+
+#include <map>
+#include <vector>
+
+// Benchmarks of the masternode list, payment queue, governance and InstantSend
+// code paths whose cost grows with the number of masternodes of the network.
+
+/** Chain, UTXO set and synced masternode list of nMasternodes enabled masternodes */
+class MasternodeBenchSetup
+{
+public:
+    explicit MasternodeBenchSetup(int nMasternodes);
+    ~MasternodeBenchSetup();
+
+    CConnman connman{0x1337, 0x1337};
+    std::vector<COutPoint> vOutpoints;
+    int nHeight;
+
+private:
+    boost::thread_group threadGroup;
+    CScheduler scheduler;
+    std::vector<uint256> vHash;
+    std::vector<CBlockIndex> vIndex;
+    CCoinsView viewDummy;
+};
+
+MasternodeBenchSetup::MasternodeBenchSetup(int nMasternodes)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+
+    // Masternode list changes are signalled through the scheduler
+    threadGroup.create_thread(std::bind(&CScheduler::serviceQueue, &scheduler));
+    GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
+
+    // Collaterals need as many confirmations as there are masternodes to be paid
+    nHeight = nMasternodes + 200;
+    vHash.resize(nHeight + 1);
+    vIndex.resize(nHeight + 1);
+    for (int i = 0; i <= nHeight; i++) {
+        vHash[i] = GetRandHash();
+        vIndex[i].nHeight = i;
+        vIndex[i].pprev = i ? &vIndex[i - 1] : nullptr;
+        vIndex[i].phashBlock = &vHash[i];
+    }
+    {
+        LOCK(cs_main);
+        chainActive.SetTip(&vIndex.back());
+        pcoinsTip.reset(new CCoinsViewCache(&viewDummy));
+    }
+
+    // All masternodes share one key, so votes can be signed for any of them
+    CKey keyMasternode;
+    keyMasternode.MakeNewKey(true);
+    activeMasternode.keyMasternode = keyMasternode;
+    activeMasternode.pubKeyMasternode = keyMasternode.GetPubKey();
+
+    const int64_t nNow = GetAdjustedTime();
+    for (int i = 0; i < nMasternodes; i++) {
+        const COutPoint outpoint(GetRandHash(), 0);
+
+        // Collateral addresses are only hashed, they need not be valid points
+        std::vector<unsigned char> vchPubKey(CPubKey::COMPRESSED_PUBLIC_KEY_SIZE);
+        vchPubKey[0] = 0x02;
+        GetRandBytes(vchPubKey.data() + 1, vchPubKey.size() - 1);
+        const CPubKey pubKeyCollateral(vchPubKey.begin(), vchPubKey.end());
+
+        in_addr ip;
+        ip.s_addr = htonl(0x0a000000 | i);
+        CMasternode mn(CService(CNetAddr(ip), 9999), outpoint, pubKeyCollateral, activeMasternode.pubKeyMasternode, PROTOCOL_VERSION);
+        mn.sigTime = nNow - 30 * 24 * 60 * 60;
+        mn.lastPing = CMasternodePing(outpoint);
+        mn.nTimeLastPing = mn.lastPing.sigTime;
+        mn.nCollateralMinConfBlockHash = vHash[1];
+        mn.nBlockLastPaid = (i * 7) % nHeight;
+
+        {
+            LOCK(cs_main);
+            pcoinsTip->AddCoin(outpoint, Coin(CTxOut(CMasternode::CollateralValue(1), GetScriptForDestination(pubKeyCollateral.GetID())), 1, false), false);
+        }
+        mnodeman.Add(mn);
+        vOutpoints.push_back(outpoint);
+    }
+
+    // Skip the sync of the masternode list and of the payment votes
+    masternodeSync.SetCachesLoaded();
+    while (!masternodeSync.IsWinnersListSynced()) {
+        masternodeSync.SwitchToNextAsset(connman);
+    }
+}
+
+MasternodeBenchSetup::~MasternodeBenchSetup()
+{
+    masternodeSync.Reset();
+    mnodeman.Clear();
+    activeMasternode.keyMasternode = CKey();
+    activeMasternode.pubKeyMasternode = CPubKey();
+    {
+        LOCK(cs_main);
+        chainActive.SetTip(nullptr);
+        pcoinsTip.reset();
+    }
+
+    GetMainSignals().FlushBackgroundCallbacks();
+    GetMainSignals().UnregisterBackgroundSignalScheduler();
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
+// More blocks than the score cache of the manager holds are ranked in turn
+static const int RANKED_BLOCKS = 32;
+
+static void MasternodeRanks(benchmark::State& state, int nMasternodes)
+{
+    MasternodeBenchSetup setup(nMasternodes);
+    CMasternodeMan::rank_pair_vec_t vecRanks;
+    int n = 0;
+    while (state.KeepRunning()) {
+        mnodeman.GetMasternodeRanks(vecRanks, setup.nHeight - (n++ % RANKED_BLOCKS));
+    }
+}
+
+static void MasternodeNextInQueue(benchmark::State& state, int nMasternodes)
+{
+    MasternodeBenchSetup setup(nMasternodes);
+    int nCount;
+    masternode_info_t info;
+    int n = 0;
+    while (state.KeepRunning()) {
+        mnodeman.GetNextMasternodeInQueueForPayment(setup.nHeight - (n++ % RANKED_BLOCKS), true, nCount, info);
+    }
+}
+
+// Only the first run checks every masternode, the later ones walk the list
+// while the checks are throttled
+static void MasternodeCheckAndRemove(benchmark::State& state, int nMasternodes)
+{
+    MasternodeBenchSetup setup(nMasternodes);
+    while (state.KeepRunning()) {
+        mnodeman.CheckAndRemove(setup.connman);
+    }
+}
+
+static void MasternodeFindRandom(benchmark::State& state, int nMasternodes)
+{
+    MasternodeBenchSetup setup(nMasternodes);
+    const std::vector<COutPoint> vecExclude(setup.vOutpoints.begin(), setup.vOutpoints.begin() + nMasternodes / 10);
+    while (state.KeepRunning()) {
+        mnodeman.FindRandomNotInVec(vecExclude);
+    }
+}
+
+static void MasternodeRanks_5k(benchmark::State& state) { MasternodeRanks(state, 5000); }
+static void MasternodeRanks_20k(benchmark::State& state) { MasternodeRanks(state, 20000); }
+static void MasternodeNextInQueue_5k(benchmark::State& state) { MasternodeNextInQueue(state, 5000); }
+static void MasternodeNextInQueue_20k(benchmark::State& state) { MasternodeNextInQueue(state, 20000); }
+static void MasternodeCheckAndRemove_5k(benchmark::State& state) { MasternodeCheckAndRemove(state, 5000); }
+static void MasternodeCheckAndRemove_20k(benchmark::State& state) { MasternodeCheckAndRemove(state, 20000); }
+static void MasternodeFindRandom_5k(benchmark::State& state) { MasternodeFindRandom(state, 5000); }
+static void MasternodeFindRandom_20k(benchmark::State& state) { MasternodeFindRandom(state, 20000); }
+
+// Every masternode votes on every proposal, and all proposals are flagged
+// dirty before each update as when masternodes leave the list
+static void GovernanceUpdateCaches(benchmark::State& state)
+{
+    MasternodeBenchSetup setup(5000);
+    const int nProposals = 20;
+    const int64_t nNow = GetAdjustedTime();
+
+    // The manager is loaded from its cache format, which carries the votes
+    std::string strVersion;
+    {
+        CDataStream ssEmpty(SER_DISK, CLIENT_VERSION);
+        ssEmpty << CGovernanceManager();
+        ssEmpty >> strVersion;
+    }
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << strVersion << std::map<uint256, int64_t>();
+    ss << CGovernanceManager::vote_cache_t() << CGovernanceManager::vote_mcache_t();
+
+    std::vector<uint256> vHashes;
+    WriteCompactSize(ss, nProposals);
+    for (int i = 0; i < nProposals; i++) {
+        const std::string strProposal = strprintf("[[\"proposal\",{\"end_epoch\":%d,\"name\":\"bench-%d\",\"payment_address\":\"\",\"payment_amount\":10,\"start_epoch\":%d,\"type\":1,\"url\":\"https://veles.network\"}]]",
+                                                  nNow + 30 * 24 * 60 * 60, i, nNow);
+        const CGovernanceObject govobj(uint256(), 1, nNow, uint256(), HexStr(strProposal.begin(), strProposal.end()));
+        const uint256 nHash = govobj.GetHash();
+        vHashes.push_back(nHash);
+
+        CGovernanceObject::vote_m_t mapVotes;
+        CGovernanceObjectVoteFile fileVotes;
+        for (const COutPoint& outpoint : setup.vOutpoints) {
+            mapVotes[outpoint].mapInstances[VOTE_SIGNAL_FUNDING] = vote_instance_t(VOTE_OUTCOME_YES, nNow, nNow);
+            fileVotes.AddVote(CGovernanceVote(outpoint, nHash, VOTE_SIGNAL_FUNDING, VOTE_OUTCOME_YES));
+        }
+
+        // The object itself is written as on the network, its votes as on disk
+        CDataStream ssObject(SER_NETWORK, PROTOCOL_VERSION);
+        ssObject << govobj;
+        ss << nHash;
+        ss.write(ssObject.data(), ssObject.size());
+        ss << int64_t(0) << false << mapVotes << fileVotes;
+    }
+    ss << std::map<uint256, int64_t>() << uint256() << int64_t(0) << CGovernanceManager::txout_m_t();
+
+    CGovernanceManager govman;
+    ss >> govman;
+    govman.InitOnLoad();
+
+    while (state.KeepRunning()) {
+        for (const uint256& nHash : vHashes) {
+            mnodeman.AddDirtyGovernanceObjectHash(nHash);
+        }
+        govman.UpdateCachesAndClean();
+    }
+}
+
+// Votes of the top ranked masternodes for the inputs of transactions not seen
+// yet, checked and stored as orphan votes by a fresh InstantSend manager
+static void InstantSendLockVotes(benchmark::State& state)
+{
+    MasternodeBenchSetup setup(5000);
+    in_addr ip;
+    ip.s_addr = htonl(0x7f000001);
+    CNode node(0, NODE_NETWORK, 0, INVALID_SOCKET, CAddress(CService(CNetAddr(ip), 9999), NODE_NETWORK), 0, 0, CAddress(), "", false);
+    node.nVersion = PROTOCOL_VERSION;
+
+    std::vector<CDataStream> vVotes;
+    for (int i = 0; i < 100; i++) {
+        const uint256 txHash = GetRandHash();
+        const COutPoint outpoint(GetRandHash(), 0);
+        const int nCoinHeight = 100 + i;
+        {
+            LOCK(cs_main);
+            pcoinsTip->AddCoin(outpoint, Coin(CTxOut(COIN, CScript() << OP_TRUE), nCoinHeight, false), false);
+        }
+
+        // Only the masternodes ranked at the lock height may vote for the input
+        CMasternodeMan::rank_pair_vec_t vecRanks;
+        mnodeman.GetMasternodeRanks(vecRanks, nCoinHeight + 4, MIN_INSTANTSEND_PROTO_VERSION);
+        for (int j = 0; j < COutPointLock::SIGNATURES_TOTAL && j < (int)vecRanks.size(); j++) {
+            CTxLockVote vote(txHash, outpoint, vecRanks[j].second.vin.prevout);
+            vote.Sign();
+            vVotes.emplace_back(SER_NETWORK, PROTOCOL_VERSION);
+            vVotes.back() << vote;
+        }
+    }
+
+    while (state.KeepRunning()) {
+        std::unique_ptr<CInstantSend> pinstantsend = MakeUnique<CInstantSend>();
+        for (const CDataStream& ssVote : vVotes) {
+            CDataStream ss(ssVote);
+            pinstantsend->ProcessMessage(&node, NetMsgType::TXLOCKVOTE, ss, setup.connman);
+        }
+    }
+}
+
+BENCHMARK(MasternodeRanks_5k, 200);
+BENCHMARK(MasternodeRanks_20k, 50);
+BENCHMARK(MasternodeNextInQueue_5k, 500);
+BENCHMARK(MasternodeNextInQueue_20k, 100);
+BENCHMARK(MasternodeCheckAndRemove_5k, 50);
+BENCHMARK(MasternodeCheckAndRemove_20k, 10);
+BENCHMARK(MasternodeFindRandom_5k, 5000);
+BENCHMARK(MasternodeFindRandom_20k, 1000);
+BENCHMARK(GovernanceUpdateCaches, 20);
+BENCHMARK(InstantSendLockVotes, 10);
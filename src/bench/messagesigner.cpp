@@ -0,0 +1,63 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <key.h>
+#include <messagesigner.h>
+#include <pubkey.h>
+
+#include <secp256k1.h>
+
+#include <cassert>
+#include <string>
+#include <vector>
+
+// Signing and verification of the masternode and governance messages, and the
+// creation of the libsecp256k1 contexts they go through.
+
+static const std::string strBenchMessage = "CTxIn(COutPoint(5a4f3e2d1c0b5a4f3e2d1c0b5a4f3e2d1c0b5a4f3e2d1c0b5a4f3e2d1c0b5a4f, 1), scriptSig=)1571097600";
+
+static void MessageSignerSign(benchmark::State& state)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    std::vector<unsigned char> vchSig;
+
+    while (state.KeepRunning()) {
+        bool fSigned = CMessageSigner::SignMessage(strBenchMessage, vchSig, key);
+        assert(fSigned);
+    }
+}
+
+// The work of CHashSigner::VerifyHash for a signature missing from its cache
+static void MessageSignerVerify(benchmark::State& state)
+{
+    const ECCVerifyHandle verify_handle;
+    CKey key;
+    key.MakeNewKey(true);
+    const CPubKey pubkey = key.GetPubKey();
+    std::vector<unsigned char> vchSig;
+    bool fSigned = CMessageSigner::SignMessage(strBenchMessage, vchSig, key);
+    assert(fSigned);
+
+    while (state.KeepRunning()) {
+        CPubKey pubkeyFromSig;
+        bool fRecovered = pubkeyFromSig.RecoverCompact(CMessageSigner::GetMessageHash(strBenchMessage), vchSig);
+        assert(fRecovered && pubkeyFromSig.GetID() == pubkey.GetID());
+    }
+}
+
+// Built from the static precomputed tables, this is the startup cost of ECC_Start and ECCVerifyHandle
+static void Secp256k1ContextCreate(benchmark::State& state)
+{
+    while (state.KeepRunning()) {
+        secp256k1_context* ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
+        assert(ctx != nullptr);
+        secp256k1_context_destroy(ctx);
+    }
+}
+
+BENCHMARK(MessageSignerSign, 2000);
+BENCHMARK(MessageSignerVerify, 2000);
+BENCHMARK(Secp256k1ContextCreate, 100);
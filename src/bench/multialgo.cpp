@@ -0,0 +1,210 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <arith_uint256.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <pow.h>
+#include <primitives/block.h>
+#include <random.h>
+#include <sync.h>
+#include <uint256.h>
+#include <util/memory.h>
+#include <validation.h>
+#include <versionbits.h>
+
+#include <assert.h>
+#include <memory>
+#include <vector>
+
+// Benchmarks of the multi-algo difficulty retargeting, the block subsidy and the
+// halving schedule over a synthetic chain of a million blocks. The _Walk variants
+// do the same work by walking the chain block by block, as before the blocks
+// linked their same-algo predecessors and cached their cumulative subsidy.
+
+static const int SYNTHETIC_CHAIN_HEIGHT = 1000000;
+
+/** Blocks of every algo, NIST5 is rarely mined */
+static int32_t SyntheticAlgo(FastRandomContext& rng)
+{
+    static const int32_t algos[] = {ALGO_SHA256D, ALGO_SCRYPT, ALGO_LYRA2Z, ALGO_X11, ALGO_X16R};
+    const uint64_t r = rng.randrange(100);
+    return r < 2 ? ALGO_NIST5 : algos[r % 5];
+}
+
+/** Chain shared by all benchmarks of this file, built on first use and kept to the end */
+class SyntheticChain
+{
+public:
+    SyntheticChain()
+    {
+        const Consensus::Params& consensus = Params().GetConsensus();
+        const arith_uint256 bnPowLimit = UintToArith256(consensus.powLimit);
+        FastRandomContext rng(true);
+
+        vHash.resize(SYNTHETIC_CHAIN_HEIGHT + 1);
+        vIndex.resize(SYNTHETIC_CHAIN_HEIGHT + 1);
+        uint32_t nTime = Params().GenesisBlock().nTime;
+        for (int i = 0; i <= SYNTHETIC_CHAIN_HEIGHT; i++) {
+            CBlockIndex& index = vIndex[i];
+            vHash[i] = rng.rand256();
+            index.phashBlock = &vHash[i];
+            index.pprev = i ? &vIndex[i - 1] : nullptr;
+            index.nHeight = i;
+            index.nVersion = VERSIONBITS_TOP_BITS | SyntheticAlgo(rng);
+            index.nBits = arith_uint256(bnPowLimit >> rng.randrange(12)).GetCompact();
+            nTime += 1 + rng.randrange(2 * consensus.nPowTargetSpacing);
+            index.nTime = nTime;
+            index.BuildSkip();
+            index.BuildPrevAlgo();
+        }
+    }
+
+    const CBlockIndex* Tip() const { return &vIndex.back(); }
+
+private:
+    std::vector<uint256> vHash;
+    std::vector<CBlockIndex> vIndex;
+};
+
+/** Makes the synthetic chain the active one while in scope */
+class ActiveSyntheticChain
+{
+public:
+    ActiveSyntheticChain()
+    {
+        SelectParams(CBaseChainParams::MAIN);
+        static std::unique_ptr<SyntheticChain> chain;
+        if (!chain) chain = MakeUnique<SyntheticChain>();
+        pchain = chain.get();
+
+        LOCK(cs_main);
+        chainActive.SetTip(const_cast<CBlockIndex*>(pchain->Tip()));
+    }
+
+    ~ActiveSyntheticChain()
+    {
+        LOCK(cs_main);
+        chainActive.SetTip(nullptr);
+    }
+
+    const CBlockIndex* Tip() const { return pchain->Tip(); }
+
+private:
+    const SyntheticChain* pchain;
+};
+
+// Headers of every algo on top of the recent blocks, some late enough for the
+// dead-lock protection to halve their work
+static void MultiAlgoNextWorkRequired(benchmark::State& state)
+{
+    ActiveSyntheticChain chain;
+    const Consensus::Params& consensus = Params().GetConsensus();
+    static const int32_t algos[] = {ALGO_SHA256D, ALGO_SCRYPT, ALGO_NIST5, ALGO_LYRA2Z, ALGO_X11, ALGO_X16R};
+    static const int64_t gaps[] = {30, 120, 600, 1800};
+    CBlockHeader header;
+    int n = 0;
+    while (state.KeepRunning()) {
+        const CBlockIndex* pindexLast = chain.Tip()->GetAncestor(SYNTHETIC_CHAIN_HEIGHT - n % 10000);
+        header.nVersion = VERSIONBITS_TOP_BITS | algos[n % 6];
+        header.nTime = pindexLast->nTime + gaps[n % 4];
+        GetNextWorkRequired(pindexLast, &header, consensus);
+        n++;
+    }
+}
+
+// The 1000th last block of every algo
+static void MultiAlgoPrevAlgo(benchmark::State& state)
+{
+    ActiveSyntheticChain chain;
+    static const int32_t algos[] = {ALGO_SHA256D, ALGO_SCRYPT, ALGO_NIST5, ALGO_LYRA2Z, ALGO_X11, ALGO_X16R};
+    while (state.KeepRunning()) {
+        for (int32_t nAlgo : algos) {
+            const CBlockIndex* pindex = chain.Tip();
+            while (pindex && pindex->GetAlgo() != nAlgo)
+                pindex = pindex->pprev;
+            for (int i = 1; pindex && i < 1000; i++)
+                pindex = pindex->pprevAlgo;
+        }
+    }
+}
+
+static void MultiAlgoPrevAlgo_Walk(benchmark::State& state)
+{
+    ActiveSyntheticChain chain;
+    static const int32_t algos[] = {ALGO_SHA256D, ALGO_SCRYPT, ALGO_NIST5, ALGO_LYRA2Z, ALGO_X11, ALGO_X16R};
+    while (state.KeepRunning()) {
+        for (int32_t nAlgo : algos) {
+            int nCount = 0;
+            for (const CBlockIndex* pindex = chain.Tip(); pindex; pindex = pindex->pprev) {
+                if (pindex->GetAlgo() == nAlgo && ++nCount == 1000)
+                    break;
+            }
+        }
+    }
+}
+
+static void SubsidyBlockSubsidy(benchmark::State& state)
+{
+    ActiveSyntheticChain chain;
+    const Consensus::Params& consensus = Params().GetConsensus();
+    LOCK(cs_main);
+    int n = 0;
+    while (state.KeepRunning()) {
+        const CBlockIndex* pindex = chainActive[1 + (n++ * 7919) % SYNTHETIC_CHAIN_HEIGHT];
+        GetBlockSubsidy(pindex->nHeight, pindex->GetBlockHeader(), consensus);
+    }
+}
+
+// Supply of the chain up to a block, from the cumulative subsidies of the block index
+static void SubsidyChainSupply(benchmark::State& state)
+{
+    ActiveSyntheticChain chain;
+    LOCK(cs_main);
+    GetTotalSupply();
+    int n = 0;
+    while (state.KeepRunning()) {
+        GetTotalSupply(1 + (n++ * 7919) % SYNTHETIC_CHAIN_HEIGHT);
+    }
+}
+
+static void SubsidyChainSupply_Walk(benchmark::State& state)
+{
+    ActiveSyntheticChain chain;
+    const Consensus::Params& consensus = Params().GetConsensus();
+    LOCK(cs_main);
+    GetTotalSupply();
+    int n = 0;
+    while (state.KeepRunning()) {
+        CAmount nSupply = 0;
+        for (const CBlockIndex* pindex = chainActive[1 + (n++ * 7919) % SYNTHETIC_CHAIN_HEIGHT]; pindex && pindex->nHeight > 0; pindex = pindex->pprev)
+            nSupply += GetBlockSubsidy(pindex->nHeight, pindex->GetBlockHeader(), consensus);
+        assert(nSupply > 0);
+    }
+}
+
+// The halving schedule and epoch supplies reported by gethalvinginfo
+static void SubsidyHalvingInfo(benchmark::State& state)
+{
+    ActiveSyntheticChain chain;
+    LOCK(cs_main);
+    GetTotalSupply();
+    while (state.KeepRunning()) {
+        std::shared_ptr<const HalvingParameters> halvingParams = GetSubsidyHalvingParameters();
+        CAmount nSupply = 0;
+        for (const HalvingEpoch& epoch : halvingParams->epochs) {
+            nSupply += epoch.fHasEnded ? epoch.nEndSupply - epoch.nStartSupply : CountBlockRewards(epoch.nStartBlock, chainActive.Height());
+        }
+        assert(nSupply > 0);
+    }
+}
+
+BENCHMARK(MultiAlgoNextWorkRequired, 20000);
+BENCHMARK(MultiAlgoPrevAlgo, 2000);
+BENCHMARK(MultiAlgoPrevAlgo_Walk, 100);
+BENCHMARK(SubsidyBlockSubsidy, 500000);
+BENCHMARK(SubsidyChainSupply, 5000000);
+BENCHMARK(SubsidyChainSupply_Walk, 1);
+BENCHMARK(SubsidyHalvingInfo, 200000);
@@ -0,0 +1,191 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <primitives/block.h>
+#include <uint256.h>
+#include <util/strencodings.h>
+#include <versionbits.h>
+#include <crypto/scrypt.h>
+#include <crypto/x16r.h>
+
+#include <string.h>
+#include <vector>
+
+// Benchmarks of the proof-of-work hash of an 80 byte block header for every
+// algorithm used by the Veles consensus rules.
+
+static CBlockHeader PoWHashHeader(int32_t nAlgo)
+{
+    CBlockHeader header;
+    header.nVersion = VERSIONBITS_TOP_BITS | nAlgo;
+    header.hashPrevBlock = uint256S("7dfeab8f971393e0e0a2ed1f2415b44ba554a6ec8e8bec1d4da8e8bd4268fe1e");
+    header.hashMerkleRoot = uint256S("cc2bb606c64c5bfc07a4e7e236ebf05a28aa0d9ee15fb0b6fd4a21e22d479b10");
+    header.nTime = 1546300800;
+    header.nBits = 0x1e0ffff0;
+    header.nNonce = 0;
+    return header;
+}
+
+static void PoWHash(benchmark::State& state, int32_t nAlgo)
+{
+    CBlockHeader header = PoWHashHeader(nAlgo);
+    while (state.KeepRunning()) {
+        header.nNonce++;
+        header.GetPoWHash();
+    }
+}
+
+static void PoWHash_SHA256D(benchmark::State& state) { PoWHash(state, ALGO_SHA256D); }
+static void PoWHash_Scrypt(benchmark::State& state) { PoWHash(state, ALGO_SCRYPT); }
+static void PoWHash_NIST5(benchmark::State& state) { PoWHash(state, ALGO_NIST5); }
+static void PoWHash_Lyra2Z(benchmark::State& state) { PoWHash(state, ALGO_LYRA2Z); }
+static void PoWHash_X11(benchmark::State& state) { PoWHash(state, ALGO_X11); }
+static void PoWHash_X16R(benchmark::State& state) { PoWHash(state, ALGO_X16R); }
+
+// All nonces of one template share the X16R chain resolved in a CX16RPlan
+static void PoWHash_X16R_Plan(benchmark::State& state)
+{
+    CBlockHeader header = PoWHashHeader(ALGO_X16R);
+    const CX16RPlan plan(header.hashPrevBlock);
+    while (state.KeepRunning()) {
+        header.nNonce++;
+        header.GetPoWHash(&plan);
+    }
+}
+
+// Headers of blocks before the VersionBits era are always hashed with scrypt
+static void PoWHash_Legacy(benchmark::State& state)
+{
+    CBlockHeader header = PoWHashHeader(ALGO_SHA256D);
+    header.nVersion = 2;
+    while (state.KeepRunning()) {
+        header.nNonce++;
+        header.GetPoWHash();
+    }
+}
+
+// X16R chains the algorithms selected by the last 16 nibbles of hashPrevBlock,
+// a hashPrevBlock made of a single repeated nibble runs one algorithm 16 times.
+static void PoWHash_X16R_Selection(benchmark::State& state, int nSelection)
+{
+    CBlockHeader header = PoWHashHeader(ALGO_X16R);
+    memset(header.hashPrevBlock.begin(), (nSelection << 4) | nSelection, header.hashPrevBlock.size());
+    while (state.KeepRunning()) {
+        header.nNonce++;
+        header.GetPoWHash();
+    }
+}
+
+static void PoWHash_X16R_0_Blake(benchmark::State& state) { PoWHash_X16R_Selection(state, 0); }
+static void PoWHash_X16R_1_BMW(benchmark::State& state) { PoWHash_X16R_Selection(state, 1); }
+static void PoWHash_X16R_2_Groestl(benchmark::State& state) { PoWHash_X16R_Selection(state, 2); }
+static void PoWHash_X16R_3_JH(benchmark::State& state) { PoWHash_X16R_Selection(state, 3); }
+static void PoWHash_X16R_4_Keccak(benchmark::State& state) { PoWHash_X16R_Selection(state, 4); }
+static void PoWHash_X16R_5_Skein(benchmark::State& state) { PoWHash_X16R_Selection(state, 5); }
+static void PoWHash_X16R_6_Luffa(benchmark::State& state) { PoWHash_X16R_Selection(state, 6); }
+static void PoWHash_X16R_7_Cubehash(benchmark::State& state) { PoWHash_X16R_Selection(state, 7); }
+static void PoWHash_X16R_8_Shavite(benchmark::State& state) { PoWHash_X16R_Selection(state, 8); }
+static void PoWHash_X16R_9_SIMD(benchmark::State& state) { PoWHash_X16R_Selection(state, 9); }
+static void PoWHash_X16R_A_Echo(benchmark::State& state) { PoWHash_X16R_Selection(state, 10); }
+static void PoWHash_X16R_B_Hamsi(benchmark::State& state) { PoWHash_X16R_Selection(state, 11); }
+static void PoWHash_X16R_C_Fugue(benchmark::State& state) { PoWHash_X16R_Selection(state, 12); }
+static void PoWHash_X16R_D_Shabal(benchmark::State& state) { PoWHash_X16R_Selection(state, 13); }
+static void PoWHash_X16R_E_Whirlpool(benchmark::State& state) { PoWHash_X16R_Selection(state, 14); }
+static void PoWHash_X16R_F_SHA512(benchmark::State& state) { PoWHash_X16R_Selection(state, 15); }
+
+// Eight nonces of one template per iteration through the batch kernels
+static void PoWHash_Batch(benchmark::State& state, int32_t nAlgo)
+{
+    std::vector<CBlockHeader> headers(8, PoWHashHeader(nAlgo));
+    std::vector<uint256> hashes(headers.size());
+    std::vector<const CBlockHeader*> pheaders;
+    std::vector<uint256*> phashes;
+    for (size_t i = 0; i < headers.size(); i++) {
+        headers[i].nNonce = i;
+        pheaders.push_back(&headers[i]);
+        phashes.push_back(&hashes[i]);
+    }
+    while (state.KeepRunning()) {
+        for (CBlockHeader& header : headers)
+            header.nNonce += headers.size();
+        CBlockHeader::GetPoWHashes(pheaders.data(), phashes.data(), headers.size());
+    }
+}
+
+// Eight nonces of one template per iteration from the SHA256 midstate of the header
+static void PoWHash_SHA256D_Midstate8(benchmark::State& state)
+{
+    const CBlockHeaderMidstate midstate(PoWHashHeader(ALGO_SHA256D));
+    uint256 hashes[8];
+    uint32_t nNonce = 0;
+    while (state.KeepRunning()) {
+        midstate.GetHashes(nNonce, 8, hashes);
+        nNonce += 8;
+    }
+}
+
+static void PoWHash_Scrypt_Batch8(benchmark::State& state) { PoWHash_Batch(state, ALGO_SCRYPT); }
+static void PoWHash_X11_Batch8(benchmark::State& state) { PoWHash_Batch(state, ALGO_X11); }
+static void PoWHash_X16R_Batch8(benchmark::State& state) { PoWHash_Batch(state, ALGO_X16R); }
+
+static void Scrypt_Generic(benchmark::State& state)
+{
+    CBlockHeader header = PoWHashHeader(ALGO_SCRYPT);
+    char scratchpad[SCRYPT_SCRATCHPAD_SIZE];
+    uint256 hash;
+    while (state.KeepRunning()) {
+        header.nNonce++;
+        scrypt_1024_1_1_256_sp_generic(BEGIN(header.nVersion), BEGIN(hash), scratchpad);
+    }
+}
+
+#if defined(USE_SSE2)
+static void Scrypt_SSE2(benchmark::State& state)
+{
+    CBlockHeader header = PoWHashHeader(ALGO_SCRYPT);
+    char scratchpad[SCRYPT_SCRATCHPAD_SIZE];
+    uint256 hash;
+    while (state.KeepRunning()) {
+        header.nNonce++;
+        scrypt_1024_1_1_256_sp_sse2(BEGIN(header.nVersion), BEGIN(hash), scratchpad);
+    }
+}
+#endif
+
+BENCHMARK(PoWHash_SHA256D, 1400 * 1000);
+BENCHMARK(PoWHash_Scrypt, 9300);
+BENCHMARK(PoWHash_NIST5, 110 * 1000);
+BENCHMARK(PoWHash_Lyra2Z, 240);
+BENCHMARK(PoWHash_X11, 60 * 1000);
+BENCHMARK(PoWHash_X16R, 30 * 1000);
+BENCHMARK(PoWHash_X16R_Plan, 30 * 1000);
+BENCHMARK(PoWHash_Legacy, 9300);
+
+BENCHMARK(PoWHash_SHA256D_Midstate8, 1400 * 1000 / 4);
+BENCHMARK(PoWHash_Scrypt_Batch8, 9300 / 8);
+BENCHMARK(PoWHash_X11_Batch8, 60 * 1000 / 8);
+BENCHMARK(PoWHash_X16R_Batch8, 30 * 1000 / 8);
+
+BENCHMARK(PoWHash_X16R_0_Blake, 120 * 1000);
+BENCHMARK(PoWHash_X16R_1_BMW, 130 * 1000);
+BENCHMARK(PoWHash_X16R_2_Groestl, 25 * 1000);
+BENCHMARK(PoWHash_X16R_3_JH, 60 * 1000);
+BENCHMARK(PoWHash_X16R_4_Keccak, 120 * 1000);
+BENCHMARK(PoWHash_X16R_5_Skein, 110 * 1000);
+BENCHMARK(PoWHash_X16R_6_Luffa, 60 * 1000);
+BENCHMARK(PoWHash_X16R_7_Cubehash, 50 * 1000);
+BENCHMARK(PoWHash_X16R_8_Shavite, 40 * 1000);
+BENCHMARK(PoWHash_X16R_9_SIMD, 20 * 1000);
+BENCHMARK(PoWHash_X16R_A_Echo, 25 * 1000);
+BENCHMARK(PoWHash_X16R_B_Hamsi, 40 * 1000);
+BENCHMARK(PoWHash_X16R_C_Fugue, 40 * 1000);
+BENCHMARK(PoWHash_X16R_D_Shabal, 130 * 1000);
+BENCHMARK(PoWHash_X16R_E_Whirlpool, 20 * 1000);
+BENCHMARK(PoWHash_X16R_F_SHA512, 100 * 1000);
+
+BENCHMARK(Scrypt_Generic, 9300);
+#if defined(USE_SSE2)
+BENCHMARK(Scrypt_SSE2, 12 * 1000);
+#endif
@@ -0,0 +1,125 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <fs.h>
+#include <scheduler.h>
+#include <script/sigcache.h>
+#include <sync.h>
+#include <txdb.h>
+#include <util/system.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <iostream>
+
+// Replay of real mainnet blocks read from -replay-blocks, a file of blocks as
+// written by -loadblock or to blk?????.dat. Every iteration disconnects the
+// blocks from -replay-from on and connects them back from the block files,
+// with the coins flushed to the chainstate database in between, and the time
+// spent in each phase of ConnectBlock() is printed to stderr at the end. As in
+// an initial block download the masternode list is not synced, so the payee
+// checks accept every block. The benchmark does nothing without -replay-blocks.
+
+static void PrintPhase(const char* name, int64_t nTime, const ConnectBlockTimings& timings)
+{
+    tfm::format(std::cerr, "  %-12s %10.2fms %8.3fms/blk %5.1f%%\n", name, nTime * 0.001,
+        nTime * 0.001 / timings.nBlocks, timings.nTotal ? 100.0 * nTime / timings.nTotal : 0.0);
+}
+
+static void ConnectBlockReplay(benchmark::State& state)
+{
+    const std::string strFile = gArgs.GetArg("-replay-blocks", "");
+    FILE* file = strFile.empty() ? nullptr : fsbridge::fopen(strFile, "rb");
+    if (!file) {
+        if (!strFile.empty()) tfm::format(std::cerr, "Error reading blocks %s\n", strFile.c_str());
+        while (state.KeepRunning()) {}
+        return;
+    }
+
+    SelectParams(CBaseChainParams::MAIN);
+    const CChainParams& chainparams = Params();
+    InitScriptExecutionCache();
+
+    boost::thread_group threadGroup;
+    CScheduler scheduler;
+    threadGroup.create_thread(std::bind(&CScheduler::serviceQueue, &scheduler));
+    GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
+
+    // Start from an empty chainstate on disk, whatever the other benchmarks left
+    UnloadBlockIndex();
+    {
+        LOCK(cs_main);
+        ::pblocktree.reset(new CBlockTreeDB(1 << 20, false, true));
+        ::pcoinsdbview.reset(new CCoinsViewDB(1 << 23, false, true));
+        ::pcoinsTip.reset(new CCoinsViewCache(pcoinsdbview.get()));
+    }
+    LoadGenesisBlock(chainparams);
+
+    LoadExternalBlockFile(chainparams, file);
+
+    CBlockIndex* pindexFrom;
+    {
+        LOCK(cs_main);
+        const int nFrom = std::max(1, std::min<int>(gArgs.GetArg("-replay-from", 1), chainActive.Height()));
+        pindexFrom = chainActive[nFrom];
+        assert(pindexFrom);
+    }
+
+    ConnectBlockTimings replay;
+    while (state.KeepRunning()) {
+        CValidationState valstate;
+        InvalidateBlock(valstate, chainparams, pindexFrom);
+        FlushStateToDisk();
+
+        ConnectBlockTimings before;
+        {
+            LOCK(cs_main);
+            ResetBlockFailureFlags(pindexFrom);
+            before = GetConnectBlockTimings();
+        }
+        ActivateBestChain(valstate, chainparams);
+        {
+            LOCK(cs_main);
+            const ConnectBlockTimings after = GetConnectBlockTimings();
+            replay.nBlocks += after.nBlocks - before.nBlocks;
+            replay.nCoinFetch += after.nCoinFetch - before.nCoinFetch;
+            replay.nScriptCheck += after.nScriptCheck - before.nScriptCheck;
+            replay.nSubsidy += after.nSubsidy - before.nSubsidy;
+            replay.nPayments += after.nPayments - before.nPayments;
+            replay.nTotal += after.nTotal - before.nTotal;
+        }
+    }
+
+    if (replay.nBlocks > 0) {
+        tfm::format(std::cerr, "ConnectBlock() of %d blocks from height %d:\n", replay.nBlocks, pindexFrom->nHeight);
+        PrintPhase("coins", replay.nCoinFetch, replay);
+        PrintPhase("scripts", replay.nScriptCheck, replay);
+        PrintPhase("subsidy", replay.nSubsidy, replay);
+        PrintPhase("payments", replay.nPayments, replay);
+        PrintPhase("other", replay.nTotal - replay.nCoinFetch - replay.nScriptCheck - replay.nSubsidy - replay.nPayments, replay);
+        PrintPhase("total", replay.nTotal, replay);
+    }
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+    GetMainSignals().FlushBackgroundCallbacks();
+    GetMainSignals().UnregisterBackgroundSignalScheduler();
+
+    UnloadBlockIndex();
+    {
+        LOCK(cs_main);
+        ::pcoinsTip.reset();
+        ::pcoinsdbview.reset();
+        ::pblocktree.reset();
+    }
+}
+
+BENCHMARK(ConnectBlockReplay, 1);
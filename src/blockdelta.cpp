@@ -0,0 +1,87 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockdelta.h>
+
+#include <chain.h>
+#include <chainparams.h>
+#include <governance/classes.h>
+#include <key_io.h>
+#include <undo.h>
+#include <validation.h>
+
+#include <assert.h>
+
+std::string PayeeRoleToString(PayeeRole role)
+{
+    switch (role) {
+    case PayeeRole::NONE: return "";
+    case PayeeRole::MASTERNODE: return "masternode";
+    case PayeeRole::SUPERBLOCK: return "superblock";
+    case PayeeRole::FOUNDER: return "founder";
+    }
+    assert(false);
+}
+
+/** The role of the output n of the coinbase, by the rules the miner fills the coinbase with */
+static PayeeRole GetCoinbasePayeeRole(const CTransaction& coinbase, uint32_t n, int nHeight, const CScript& scriptFounder)
+{
+    // The first output is the miner's
+    if (n == 0)
+        return PayeeRole::NONE;
+    const CTxOut& txout = coinbase.vout[n];
+    if (!scriptFounder.empty() && txout.scriptPubKey == scriptFounder)
+        return PayeeRole::FOUNDER;
+    // Same rule as the payee index, the output must carry the exact masternode reward
+    if (txout.nValue == GetMasternodePayment(nHeight, coinbase.GetValueOut()))
+        return PayeeRole::MASTERNODE;
+    // Superblocks pay the proposals instead of a masternode
+    if (CSuperblock::IsValidBlockHeight(nHeight))
+        return PayeeRole::SUPERBLOCK;
+    return PayeeRole::NONE;
+}
+
+bool GetBlockDelta(const CBlock& block, const CBlockIndex* pindex, bool fConnected, CBlockDelta& delta)
+{
+    // The genesis block has no undo data, nothing it creates can be spent
+    CBlockUndo blockundo;
+    if (pindex->nHeight > 0) {
+        if (!UndoReadFromDisk(blockundo, pindex) || blockundo.vtxundo.size() + 1 != block.vtx.size())
+            return false;
+    }
+
+    CScript scriptFounder;
+    const CTxDestination destFounder = DecodeDestination(Params().FounderAddress());
+    if (IsValidDestination(destFounder))
+        scriptFounder = GetScriptForDestination(destFounder);
+
+    delta.hash = pindex->GetBlockHash();
+    delta.nHeight = pindex->nHeight;
+    delta.fConnected = fConnected;
+    delta.vtx.clear();
+    delta.vtx.reserve(block.vtx.size());
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+        CTxDelta txdelta;
+        txdelta.txid = tx.GetHash();
+        if (i > 0) {
+            const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+            if (txundo.vprevout.size() != tx.vin.size())
+                return false;
+            txdelta.vSpent.reserve(tx.vin.size());
+            for (size_t j = 0; j < tx.vin.size(); j++) {
+                txdelta.vSpent.push_back(CSpentOutputDelta{tx.vin[j].prevout, txundo.vprevout[j].out});
+            }
+        }
+        for (uint32_t n = 0; n < tx.vout.size(); n++) {
+            // Not added to the coins, like in AddCoins()
+            if (tx.vout[n].scriptPubKey.IsUnspendable())
+                continue;
+            const PayeeRole role = i == 0 ? GetCoinbasePayeeRole(tx, n, pindex->nHeight, scriptFounder) : PayeeRole::NONE;
+            txdelta.vCreated.push_back(CCreatedOutputDelta{n, tx.vout[n], role});
+        }
+        delta.vtx.push_back(std::move(txdelta));
+    }
+    return true;
+}
@@ -0,0 +1,109 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef VELES_BLOCKDELTA_H
+#define VELES_BLOCKDELTA_H
+
+#include <primitives/transaction.h>
+#include <serialize.h>
+#include <uint256.h>
+
+#include <string>
+#include <vector>
+
+class CBlock;
+class CBlockIndex;
+
+/** What a coinbase output pays for, the other outputs have no role */
+enum class PayeeRole : uint8_t {
+    NONE = 0,
+    MASTERNODE = 1,
+    SUPERBLOCK = 2,
+    FOUNDER = 3,
+};
+
+std::string PayeeRoleToString(PayeeRole role);
+
+/** An output spent by a transaction, as found in the undo data */
+struct CSpentOutputDelta
+{
+    COutPoint prevout;
+    CTxOut out;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(prevout);
+        READWRITE(out);
+    }
+};
+
+/** A spendable output created by a transaction */
+struct CCreatedOutputDelta
+{
+    uint32_t n;
+    CTxOut out;
+    PayeeRole role;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(n);
+        READWRITE(out);
+        uint8_t nRole = static_cast<uint8_t>(role);
+        READWRITE(nRole);
+        role = static_cast<PayeeRole>(nRole);
+    }
+};
+
+struct CTxDelta
+{
+    uint256 txid;
+    //! Empty for the coinbase
+    std::vector<CSpentOutputDelta> vSpent;
+    std::vector<CCreatedOutputDelta> vCreated;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(txid);
+        READWRITE(vSpent);
+        READWRITE(vCreated);
+    }
+};
+
+/**
+ * The outputs a block spends and creates, transaction by transaction, so
+ * indexers can follow the balances of the scripts without decoding the
+ * block and looking up the spent coins. fConnected tells whether the block
+ * was connected or disconnected, in which case its effects are reverted.
+ */
+struct CBlockDelta
+{
+    uint256 hash;
+    int32_t nHeight {0};
+    bool fConnected {true};
+    std::vector<CTxDelta> vtx;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(hash);
+        READWRITE(nHeight);
+        READWRITE(fConnected);
+        READWRITE(vtx);
+    }
+};
+
+/**
+ * Fill delta from block, connected at pindex, and the undo data of the block.
+ * Fails when the undo data can't be read, it must not have been pruned.
+ */
+bool GetBlockDelta(const CBlock& block, const CBlockIndex* pindex, bool fConnected, CBlockDelta& delta);
+
+#endif // VELES_BLOCKDELTA_H
@@ -46,7 +46,11 @@ uint64_t CBlockHeaderAndShortTxIDs::GetShortID(const uint256& txhash) const {
 
 
 
-ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn) {
+//ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn) {
+// VELES BEGIN
+ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn,
+                                              const std::vector<std::pair<uint256, CTransactionRef>>& locked_txn) {
+// VELES END
     if (cmpctblock.header.IsNull() || (cmpctblock.shorttxids.empty() && cmpctblock.prefilledtxn.empty()))
         return READ_STATUS_INVALID;
     if (cmpctblock.shorttxids.size() + cmpctblock.prefilledtxn.size() > MAX_BLOCK_WEIGHT / MIN_SERIALIZABLE_TRANSACTION_WEIGHT)
@@ -103,7 +107,32 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
         return READ_STATUS_FAILED; // Short ID collision
 
     std::vector<bool> have_txn(txn_available.size());
-    {
+    // VELES BEGIN
+    for (size_t i = 0; i < locked_txn.size(); i++) {
+        uint64_t shortid = cmpctblock.GetShortID(locked_txn[i].first);
+        std::unordered_map<uint64_t, uint16_t>::iterator idit = shorttxids.find(shortid);
+        if (idit != shorttxids.end()) {
+            if (!have_txn[idit->second]) {
+                txn_available[idit->second] = locked_txn[i].second;
+                have_txn[idit->second]  = true;
+                mempool_count++;
+                locked_count++;
+            } else if (txn_available[idit->second] &&
+                    txn_available[idit->second]->GetWitnessHash() != locked_txn[i].first) {
+                // Two locked txn matching the short id, request it
+                txn_available[idit->second].reset();
+                mempool_count--;
+                locked_count--;
+            }
+        }
+    }
+    // VELES END
+
+    //{
+    // VELES BEGIN
+    // All short ids matched from the locked set, the block is complete without looking at the mempool
+    if (mempool_count < shorttxids.size()) {
+    // VELES END
     LOCK(pool->cs);
     const std::vector<std::pair<uint256, CTxMemPool::txiter> >& vTxHashes = pool->vTxHashes;
     for (size_t i = 0; i < vTxHashes.size(); i++) {
@@ -118,7 +147,13 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
                 // If we find two mempool txn that match the short id, just request it.
                 // This should be rare enough that the extra bandwidth doesn't matter,
                 // but eating a round-trip due to FillBlock failure would be annoying
-                if (txn_available[idit->second]) {
+                //if (txn_available[idit->second]) {
+                // VELES BEGIN
+                // Locked txn are in the mempool as well, only a different
+                // transaction is a collision
+                if (txn_available[idit->second] &&
+                        txn_available[idit->second]->GetWitnessHash() != vTxHashes[i].first) {
+                // VELES END
                     txn_available[idit->second].reset();
                     mempool_count--;
                 }
@@ -163,7 +198,11 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
             break;
     }
 
-    LogPrint(BCLog::CMPCTBLOCK, "Initialized PartiallyDownloadedBlock for block %s using a cmpctblock of size %lu\n", cmpctblock.header.GetHash().ToString(), GetSerializeSize(cmpctblock, PROTOCOL_VERSION));
+    //LogPrint(BCLog::CMPCTBLOCK, "Initialized PartiallyDownloadedBlock for block %s using a cmpctblock of size %lu\n", cmpctblock.header.GetHash().ToString(), GetSerializeSize(cmpctblock, PROTOCOL_VERSION));
+    // VELES BEGIN
+    LogPrint(BCLog::CMPCTBLOCK, "Initialized PartiallyDownloadedBlock for block %s using a cmpctblock of size %lu (%lu of %lu short ids from locked txn)\n", cmpctblock.header.GetHash().ToString(),
+        GetSerializeSize(cmpctblock, PROTOCOL_VERSION), locked_count, shorttxids.size());
+    // VELES END
 
     return READ_STATUS_OK;
 }
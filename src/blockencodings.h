@@ -7,6 +7,7 @@
 
 #include <primitives/block.h>
 
+#include <map> // VELES
 #include <memory>
 
 class CTxMemPool;
@@ -198,15 +199,131 @@ class PartiallyDownloadedBlock {
 protected:
     std::vector<CTransactionRef> txn_available;
     size_t prefilled_count = 0, mempool_count = 0, extra_count = 0;
+    size_t locked_count = 0; // VELES
     CTxMemPool* pool;
 public:
     CBlockHeader header;
     explicit PartiallyDownloadedBlock(CTxMemPool* poolIn) : pool(poolIn) {}
 
     // extra_txn is a list of extra transactions to look at, in <witness hash, reference> form
-    ReadStatus InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn);
+    //ReadStatus InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn);
+    // VELES BEGIN
+    // locked_txn are transactions expected in the block (InstantSend locked ones), in the same form,
+    // they are looked at first and the mempool is not scanned when they fill all missing slots
+    ReadStatus InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn,
+                        const std::vector<std::pair<uint256, CTransactionRef>>& locked_txn = std::vector<std::pair<uint256, CTransactionRef>>());
+    // VELES END
     bool IsTxAvailable(size_t index) const;
     ReadStatus FillBlock(CBlock& block, const std::vector<CTransactionRef>& vtx_missing);
 };
 
+// VELES BEGIN
+/** Headers as sent in a "cmpheaders" message. A header doesn't repeat the
+ *  hash of the header before it, the version and bits are only sent when
+ *  they differ from the last header of the same algo and the time is sent
+ *  as the difference to the time of the header before it. Each header
+ *  starts with a byte of the flags below, with the algo of the header in
+ *  the upper bits when its version is left out.
+ */
+class CompressedHeaders {
+public:
+    static const uint8_t HEADER_PREV_HASH = 1 << 0;
+    static const uint8_t HEADER_VERSION = 1 << 1;
+    static const uint8_t HEADER_BITS = 1 << 2;
+    static const int HEADER_ALGO_SHIFT = 3;
+    static const unsigned int HEADER_ALGO_SLOTS = 1 << (8 - HEADER_ALGO_SHIFT);
+
+    std::vector<CBlockHeader> headers;
+
+    CompressedHeaders() {}
+    explicit CompressedHeaders(std::vector<CBlockHeader> headersIn) : headers(std::move(headersIn)) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const {
+        std::map<unsigned int, const CBlockHeader*> mapLastByAlgo;
+        WriteCompactSize(s, headers.size());
+        for (size_t i = 0; i < headers.size(); i++) {
+            const CBlockHeader& header = headers[i];
+            const unsigned int nAlgo = GetAlgoSlot(header.nVersion);
+            const CBlockHeader* plast = mapLastByAlgo.count(nAlgo) ? mapLastByAlgo[nAlgo] : nullptr;
+
+            uint8_t nFlags = 0;
+            if (i == 0 || header.hashPrevBlock != headers[i - 1].GetHash())
+                nFlags |= HEADER_PREV_HASH;
+            if (!plast || header.nVersion != plast->nVersion || nAlgo >= HEADER_ALGO_SLOTS)
+                nFlags |= HEADER_VERSION;
+            else
+                nFlags |= nAlgo << HEADER_ALGO_SHIFT;
+            if (!plast || header.nBits != plast->nBits)
+                nFlags |= HEADER_BITS;
+
+            ser_writedata8(s, nFlags);
+            if (nFlags & HEADER_VERSION)
+                s << header.nVersion;
+            if (nFlags & HEADER_PREV_HASH)
+                s << header.hashPrevBlock;
+            s << header.hashMerkleRoot;
+            const int64_t nTimeDiff = int64_t(header.nTime) - (i == 0 ? 0 : headers[i - 1].nTime);
+            s << VARINT(uint64_t(nTimeDiff < 0 ? ((-nTimeDiff) << 1) - 1 : nTimeDiff << 1));
+            if (nFlags & HEADER_BITS)
+                s << header.nBits;
+            s << header.nNonce;
+
+            mapLastByAlgo[nAlgo] = &header;
+        }
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s) {
+        // Headers are added as they are read, the size of the message bounds the memory used
+        std::map<unsigned int, CBlockHeader> mapLastByAlgo;
+        const uint64_t nCount = ReadCompactSize(s);
+        headers.clear();
+        for (uint64_t i = 0; i < nCount; i++) {
+            CBlockHeader header;
+            const uint8_t nFlags = ser_readdata8(s);
+            if (nFlags & HEADER_VERSION) {
+                if (nFlags >> HEADER_ALGO_SHIFT)
+                    throw std::ios_base::failure("algo of a compressed header with a version");
+                s >> header.nVersion;
+            }
+            const unsigned int nAlgo = (nFlags & HEADER_VERSION) ? GetAlgoSlot(header.nVersion) : (nFlags >> HEADER_ALGO_SHIFT);
+            auto itLast = mapLastByAlgo.find(nAlgo);
+            if ((!(nFlags & HEADER_VERSION) || !(nFlags & HEADER_BITS)) && itLast == mapLastByAlgo.end())
+                throw std::ios_base::failure("compressed header of an algo not seen before");
+            if (!(nFlags & HEADER_VERSION))
+                header.nVersion = itLast->second.nVersion;
+
+            if (nFlags & HEADER_PREV_HASH)
+                s >> header.hashPrevBlock;
+            else if (i == 0)
+                throw std::ios_base::failure("first compressed header without a previous block hash");
+            else
+                header.hashPrevBlock = headers.back().GetHash();
+            s >> header.hashMerkleRoot;
+            uint64_t nTimeDiff = 0;
+            s >> VARINT(nTimeDiff);
+            if (nTimeDiff > (uint64_t(std::numeric_limits<uint32_t>::max()) << 1))
+                throw std::ios_base::failure("compressed header time out of range");
+            const int64_t nTime = (i == 0 ? 0 : int64_t(headers.back().nTime)) +
+                ((nTimeDiff & 1) ? -int64_t((nTimeDiff + 1) >> 1) : int64_t(nTimeDiff >> 1));
+            if (nTime < 0 || nTime > std::numeric_limits<uint32_t>::max())
+                throw std::ios_base::failure("compressed header time out of range");
+            header.nTime = nTime;
+            if (nFlags & HEADER_BITS)
+                s >> header.nBits;
+            else
+                header.nBits = itLast->second.nBits;
+            s >> header.nNonce;
+
+            headers.push_back(header);
+            mapLastByAlgo[nAlgo] = header;
+        }
+    }
+
+private:
+    static unsigned int GetAlgoSlot(int32_t nVersion) { return (nVersion & ALGO_VERSION_MASK) >> 8; }
+};
+// VELES END
+
 #endif // BITCOIN_BLOCKENCODINGS_H
@@ -6,6 +6,9 @@
 #define BITCOIN_BLOCKFILTER_H
 
 #include <stdint.h>
+// VELES BEGIN
+#include <string>
+// VELES END
 #include <unordered_set>
 #include <vector>
 
@@ -86,8 +89,23 @@ constexpr uint32_t BASIC_FILTER_M = 784931;
 enum BlockFilterType : uint8_t
 {
     BASIC = 0,
+    INVALID = 255, // VELES
 };
 
+// VELES BEGIN
+/** Get the human-readable name for a filter type. Returns empty string for unknown types. */
+const std::string& BlockFilterTypeName(BlockFilterType filter_type);
+
+/** Find a filter type by its human-readable name. */
+bool BlockFilterTypeByName(const std::string& name, BlockFilterType& filter_type);
+
+/** Get a list of known filter types. */
+const std::vector<BlockFilterType>& AllBlockFilterTypes();
+
+/** Get a comma-separated list of known filter type names. */
+const std::string& ListBlockFilterTypes();
+// VELES END
+
 /**
  * Complete block filter struct as defined in BIP 157. Serialization matches
  * payload of "cfilter" messages.
@@ -0,0 +1,250 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockimport.h>
+
+#include <chainparams.h>
+#include <clientversion.h>
+#include <consensus/consensus.h>
+#include <protocol.h>
+#include <streams.h>
+#include <util/system.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string.h>
+
+#include <boost/thread.hpp>
+
+/** Serialized size of the blocks a thread parses before handing them out for hashing */
+static const size_t IMPORT_CHUNK_SIZE = 1 << 20;
+/** Maximum serialized size of the blocks buffered for the file being imported, and for the files after it */
+static const size_t IMPORT_BUFFER_SIZE = 64 << 20;
+
+/** Blocks parsed together, all members are guarded by CBlockFileParser::cs */
+struct CBlockFileParser::Chunk {
+    std::vector<CImportedBlock> vBlocks;
+    size_t nSize = 0;
+    bool fHashing = false;
+    bool fHashed = false;
+};
+
+/** A file of the import, the reading state is used by the thread parsing it only */
+struct CBlockFileParser::File {
+    const Source source;
+
+    std::unique_ptr<CBufferedFile> blkdat;
+    uint64_t nRewind = 0;
+
+    //! Guarded by CBlockFileParser::cs
+    bool fParsing = false;
+    bool fOpened = false;
+    bool fEnd = false;
+    bool fFinished = false;
+    std::string strError;
+    std::deque<std::shared_ptr<Chunk>> deqChunks;
+    size_t nBuffered = 0;
+
+    explicit File(const Source& sourceIn) : source(sourceIn) {}
+};
+
+CBlockFileParser::CBlockFileParser(const CChainParams& chainparamsIn, const std::vector<Source>& vSources, int nThreads) :
+    chainparams(chainparamsIn), nMaxAhead(std::max(nThreads, 1))
+{
+    for (const Source& source : vSources) {
+        vFiles.emplace_back(new File(source));
+    }
+    for (int i = 0; i < std::max(nThreads, 1); ++i) {
+        vThreads.emplace_back(&TraceThread<std::function<void()>>, "importparse",
+                              std::bind(&CBlockFileParser::ThreadParse, this));
+    }
+}
+
+CBlockFileParser::~CBlockFileParser()
+{
+    {
+        LOCK(cs);
+        fStop = true;
+    }
+    cond.notify_all();
+    for (std::thread& thread : vThreads) {
+        thread.join();
+    }
+}
+
+/** Parse the blocks of file up to a chunk, true once the end of the file is reached */
+bool CBlockFileParser::ParseChunk(File& file, Chunk& chunk)
+{
+    try {
+        if (!file.blkdat) {
+            FILE* fileIn = fsbridge::fopen(file.source.path, "rb");
+            if (!fileIn) {
+                throw std::runtime_error(strprintf("Unable to open file %s", file.source.path.string()));
+            }
+            file.blkdat.reset(new CBufferedFile(fileIn, 2*MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE+8, SER_DISK, CLIENT_VERSION));
+            file.nRewind = file.blkdat->GetPos();
+        }
+        CBufferedFile& blkdat = *file.blkdat;
+        while (!blkdat.eof() && chunk.nSize < IMPORT_CHUNK_SIZE) {
+            blkdat.SetPos(file.nRewind);
+            file.nRewind++; // start one byte further next time, in case of failure
+            blkdat.SetLimit(); // remove former limit
+            unsigned int nSize = 0;
+            try {
+                // locate a header
+                unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
+                blkdat.FindByte(chainparams.MessageStart()[0]);
+                file.nRewind = blkdat.GetPos()+1;
+                blkdat >> buf;
+                if (memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
+                    continue;
+                // read size
+                blkdat >> nSize;
+                if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE)
+                    continue;
+            } catch (const std::exception&) {
+                // no valid block header found; don't complain
+                return true;
+            }
+            try {
+                // read block
+                uint64_t nBlockPos = blkdat.GetPos();
+                blkdat.SetLimit(nBlockPos + nSize);
+                blkdat.SetPos(nBlockPos);
+                CImportedBlock block;
+                block.pblock = std::make_shared<CBlock>();
+                blkdat >> *block.pblock;
+                file.nRewind = blkdat.GetPos();
+                if (file.source.nFile >= 0)
+                    block.pos = CDiskBlockPos(file.source.nFile, nBlockPos);
+                chunk.vBlocks.push_back(std::move(block));
+                chunk.nSize += nSize;
+            } catch (const std::exception& e) {
+                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+            }
+        }
+        return blkdat.eof();
+    } catch (const std::runtime_error& e) {
+        LOCK(cs);
+        file.strError = e.what();
+        return true;
+    }
+}
+
+void CBlockFileParser::ThreadParse()
+{
+    WAIT_LOCK(cs, lock);
+    while (!fStop) {
+        // Hash the chunks the import needs first
+        std::shared_ptr<Chunk> chunk;
+        for (size_t i = nCurrent; i < vFiles.size() && !chunk; ++i) {
+            for (const std::shared_ptr<Chunk>& chunkIter : vFiles[i]->deqChunks) {
+                if (!chunkIter->fHashed && !chunkIter->fHashing) {
+                    chunk = chunkIter;
+                    break;
+                }
+            }
+        }
+        if (chunk) {
+            chunk->fHashing = true;
+            lock.unlock();
+            std::vector<const CBlockHeader*> vHeaders;
+            std::vector<uint256*> vHashPoW;
+            for (CImportedBlock& block : chunk->vBlocks) {
+                block.hash = block.pblock->GetHash();
+                vHeaders.push_back(block.pblock.get());
+                vHashPoW.push_back(&block.hashPoW);
+            }
+            CBlockHeader::GetPoWHashes(vHeaders.data(), vHashPoW.data(), vHeaders.size());
+            lock.lock();
+            chunk->fHashed = true;
+            cond.notify_all();
+            continue;
+        }
+
+        // Otherwise parse ahead, within the buffer size and a file per thread after the current one
+        File* file = nullptr;
+        for (size_t i = nCurrent; i < vFiles.size() && i <= nCurrent + nMaxAhead; ++i) {
+            File& fileIter = *vFiles[i];
+            if (fileIter.fParsing || fileIter.fEnd || fileIter.fFinished) continue;
+            if (i == nCurrent ? fileIter.nBuffered >= IMPORT_BUFFER_SIZE : nBuffered - vFiles[nCurrent]->nBuffered >= IMPORT_BUFFER_SIZE) continue;
+            file = &fileIter;
+            break;
+        }
+        if (!file) {
+            cond.wait(lock);
+            continue;
+        }
+
+        file->fParsing = true;
+        chunk = std::make_shared<Chunk>();
+        lock.unlock();
+        bool fEnd = ParseChunk(*file, *chunk);
+        lock.lock();
+        file->fParsing = false;
+        file->fOpened = file->fOpened || file->blkdat != nullptr;
+        file->fEnd = fEnd;
+        if (!file->fFinished && !chunk->vBlocks.empty()) {
+            file->deqChunks.push_back(chunk);
+            file->nBuffered += chunk->nSize;
+            nBuffered += chunk->nSize;
+        }
+        if (file->fEnd || file->fFinished) {
+            file->blkdat.reset();
+        }
+        cond.notify_all();
+    }
+}
+
+bool CBlockFileParser::WaitOpened(size_t nSource)
+{
+    File& file = *vFiles[nSource];
+    WAIT_LOCK(cs, lock);
+    while (!file.fOpened && !file.fEnd) {
+        cond.wait_for(lock, std::chrono::milliseconds(100));
+        boost::this_thread::interruption_point();
+    }
+    return file.fOpened;
+}
+
+bool CBlockFileParser::Next(size_t nSource, std::vector<CImportedBlock>& vBlocks, std::string& strError)
+{
+    File& file = *vFiles[nSource];
+    WAIT_LOCK(cs, lock);
+    while (true) {
+        if (!file.deqChunks.empty() && file.deqChunks.front()->fHashed) {
+            std::shared_ptr<Chunk> chunk = file.deqChunks.front();
+            file.deqChunks.pop_front();
+            file.nBuffered -= chunk->nSize;
+            nBuffered -= chunk->nSize;
+            vBlocks = std::move(chunk->vBlocks);
+            cond.notify_all();
+            return true;
+        }
+        if (file.deqChunks.empty() && file.fEnd && !file.fParsing) {
+            strError = file.strError;
+            return false;
+        }
+        cond.wait_for(lock, std::chrono::milliseconds(100));
+        boost::this_thread::interruption_point();
+    }
+}
+
+void CBlockFileParser::Finish(size_t nSource)
+{
+    File& file = *vFiles[nSource];
+    {
+        LOCK(cs);
+        file.fFinished = true;
+        for (const std::shared_ptr<Chunk>& chunk : file.deqChunks) {
+            nBuffered -= chunk->nSize;
+        }
+        file.deqChunks.clear();
+        file.nBuffered = 0;
+        if (!file.fParsing) file.blkdat.reset();
+        nCurrent = nSource + 1;
+    }
+    cond.notify_all();
+}
@@ -0,0 +1,91 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef VELES_BLOCKIMPORT_H
+#define VELES_BLOCKIMPORT_H
+
+#include <chain.h>
+#include <fs.h>
+#include <primitives/block.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+class CChainParams;
+
+/** Default number of threads parsing and hashing blocks for -reindex and -loadblock */
+static const int DEFAULT_IMPORT_THREADS = 4;
+/** Maximum number of threads parsing and hashing blocks for -reindex and -loadblock */
+static const int MAX_IMPORT_THREADS = 16;
+
+/** A block read from a file being imported, with its hashes computed ahead of the import */
+struct CImportedBlock {
+    std::shared_ptr<CBlock> pblock;
+    uint256 hash;
+    //! Null when the PoW hash is left to the import
+    uint256 hashPoW;
+    //! Position of the block data when importing the block files themselves (reindex), null otherwise
+    CDiskBlockPos pos;
+};
+
+/**
+ * Reads the files of an import on a pool of threads and hands their blocks to the single
+ * importing thread in file order. Every file is parsed from start to end by one thread at a
+ * time, in chunks, while the PoW hashes of the parsed chunks are computed by any thread, so
+ * the multi-algo hashing no longer holds up the import. Files after the one being imported
+ * are parsed ahead as long as the blocks buffered for them stay within a fixed size.
+ */
+class CBlockFileParser
+{
+public:
+    /** A file to import, nFile is the number of the block file for a reindex and -1 for an external file */
+    struct Source {
+        fs::path path;
+        int nFile;
+    };
+
+private:
+    struct Chunk;
+    struct File;
+
+    const CChainParams& chainparams;
+    Mutex cs;
+    std::condition_variable cond;
+    std::vector<std::unique_ptr<File>> vFiles;
+    //! The file being imported, files before it are done with
+    size_t nCurrent GUARDED_BY(cs) = 0;
+    //! Serialized size of the blocks parsed and not taken by the import yet
+    size_t nBuffered GUARDED_BY(cs) = 0;
+    size_t nMaxAhead;
+    bool fStop GUARDED_BY(cs) = false;
+    std::vector<std::thread> vThreads;
+
+    void ThreadParse();
+    bool ParseChunk(File& file, Chunk& chunk);
+
+public:
+    CBlockFileParser(const CChainParams& chainparamsIn, const std::vector<Source>& vSources, int nThreads);
+    ~CBlockFileParser();
+
+    /** Wait until the file nSource is opened, false if it cannot be read */
+    bool WaitOpened(size_t nSource);
+
+    /**
+     * Take the next blocks of the file nSource, waiting for them to be parsed and hashed.
+     * Returns false once the file has no blocks left, with strError set when reading it
+     * stopped on a system error.
+     */
+    bool Next(size_t nSource, std::vector<CImportedBlock>& vBlocks, std::string& strError);
+
+    /** Done with the file nSource, its remaining blocks are dropped and the next file is imported */
+    void Finish(size_t nSource);
+};
+
+#endif // VELES_BLOCKIMPORT_H
@@ -0,0 +1,217 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockreadcache.h>
+
+#include <clientversion.h>
+#include <core_memusage.h>
+#include <crypto/common.h>
+#include <memusage.h>
+#include <serialize.h>
+#include <streams.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <errno.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/** Maximum number of block files mapped at the same time */
+static const size_t MAX_MAPPED_FILES = 8;
+
+CBlockReadCache g_block_read_cache;
+
+/** A read-only mapping of a block file, released when the last reader is done with it */
+class CBlockReadCache::MappedFile
+{
+public:
+    const unsigned char* data = nullptr;
+    size_t length = 0;
+
+    MappedFile() {}
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile()
+    {
+#ifndef WIN32
+        if (data) munmap((void*)data, length);
+#endif
+    }
+};
+
+void CBlockReadCache::Evict()
+{
+    while (m_usage > m_limit && !m_blocks.empty()) {
+        const Entry& entry = m_blocks.back();
+        m_usage -= entry.usage;
+        m_index.erase(entry.key);
+        m_blocks.pop_back();
+    }
+}
+
+void CBlockReadCache::SetLimit(size_t nLimit)
+{
+    LOCK(cs);
+    m_limit = nLimit;
+    Evict();
+}
+
+bool CBlockReadCache::SetMmap(bool fMmap)
+{
+    LOCK(cs);
+#ifdef WIN32
+    m_mmap = false;
+    return !fMmap;
+#else
+    // Mappings of several block files do not fit the address space of 32-bit systems
+    if (fMmap && sizeof(void*) < 8) return false;
+    m_mmap = fMmap;
+    if (!fMmap) m_mapped.clear();
+    return true;
+#endif
+}
+
+std::shared_ptr<const CBlock> CBlockReadCache::Get(const CDiskBlockPos& pos)
+{
+    LOCK(cs);
+    if (m_limit == 0) return nullptr;
+    auto it = m_index.find(Key(pos.nFile, pos.nPos));
+    if (it == m_index.end()) {
+        ++m_misses;
+        return nullptr;
+    }
+    ++m_hits;
+    m_blocks.splice(m_blocks.begin(), m_blocks, it->second);
+    return it->second->block;
+}
+
+void CBlockReadCache::Insert(const CDiskBlockPos& pos, const std::shared_ptr<const CBlock>& block)
+{
+    size_t usage = memusage::MallocUsage(sizeof(CBlock)) + RecursiveDynamicUsage(*block);
+
+    LOCK(cs);
+    const Key key(pos.nFile, pos.nPos);
+    if (usage > m_limit || m_index.count(key)) return;
+    m_blocks.push_front(Entry{key, block, usage});
+    m_index.emplace(key, m_blocks.begin());
+    m_usage += usage;
+    Evict();
+}
+
+std::shared_ptr<const CBlockReadCache::MappedFile> CBlockReadCache::GetMapping(int nFile, size_t nMinLength)
+{
+#ifdef WIN32
+    return nullptr;
+#else
+    for (auto it = m_mapped.begin(); it != m_mapped.end(); ++it) {
+        if (it->first != nFile) continue;
+        if (it->second->length >= nMinLength) {
+            m_mapped.splice(m_mapped.begin(), m_mapped, it);
+            return it->second;
+        }
+        // The file grew since it was mapped, map it again
+        m_mapped.erase(it);
+        break;
+    }
+
+    fs::path path = GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk");
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd == -1) return nullptr;
+    struct stat st;
+    std::shared_ptr<MappedFile> file;
+    if (fstat(fd, &st) == 0 && st.st_size > 0 && (size_t)st.st_size >= nMinLength) {
+        void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data != MAP_FAILED) {
+            file = std::make_shared<MappedFile>();
+            file->data = (const unsigned char*)data;
+            file->length = st.st_size;
+        } else {
+            LogPrintf("%s: mmap of %s failed: %s\n", __func__, path.string(), strerror(errno));
+        }
+    }
+    close(fd);
+    if (!file) return nullptr;
+
+    m_mapped.emplace_front(nFile, file);
+    if (m_mapped.size() > MAX_MAPPED_FILES) m_mapped.pop_back();
+    return file;
+#endif
+}
+
+bool CBlockReadCache::ReadMapped(const CDiskBlockPos& pos, CBlock& block)
+{
+    // The block is preceded by the message start and its size
+    if (pos.nPos < 8) return false;
+
+    std::shared_ptr<const MappedFile> file;
+    uint32_t nSize;
+    {
+        LOCK(cs);
+        if (!m_mmap) return false;
+        file = GetMapping(pos.nFile, pos.nPos);
+        if (!file) return false;
+        nSize = ReadLE32(file->data + pos.nPos - 4);
+        if (file->length - pos.nPos < nSize) {
+            file = GetMapping(pos.nFile, (size_t)pos.nPos + nSize);
+            if (!file) return false;
+        }
+    }
+
+    // The mapping stays valid while file is held, even when it is replaced in the meantime
+    SpanReader reader(SER_DISK, CLIENT_VERSION, Span<const unsigned char>(file->data + pos.nPos, nSize));
+    reader >> block;
+    return true;
+}
+
+void CBlockReadCache::EraseFile(int nFile)
+{
+    LOCK(cs);
+    for (auto it = m_blocks.begin(); it != m_blocks.end();) {
+        if (it->key.first == nFile) {
+            m_usage -= it->usage;
+            m_index.erase(it->key);
+            it = m_blocks.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = m_mapped.begin(); it != m_mapped.end(); ++it) {
+        if (it->first == nFile) {
+            m_mapped.erase(it);
+            break;
+        }
+    }
+}
+
+void CBlockReadCache::Clear()
+{
+    LOCK(cs);
+    m_blocks.clear();
+    m_index.clear();
+    m_usage = 0;
+    m_mapped.clear();
+}
+
+CBlockReadCache::Stats CBlockReadCache::GetStats() const
+{
+    LOCK(cs);
+    Stats stats;
+    stats.usage = m_usage;
+    stats.limit = m_limit;
+    stats.entries = m_blocks.size();
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    stats.mapped_files = m_mapped.size();
+    stats.mapped_bytes = 0;
+    for (const auto& mapped : m_mapped) {
+        stats.mapped_bytes += mapped.second->length;
+    }
+    return stats;
+}
@@ -0,0 +1,104 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef VELES_BLOCKREADCACHE_H
+#define VELES_BLOCKREADCACHE_H
+
+#include <chain.h>
+#include <primitives/block.h>
+#include <sync.h>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <utility>
+
+/** Default size of the cache of blocks read from disk in MiB, 0 disables the cache */
+static const int64_t DEFAULT_BLOCK_READ_CACHE = 16;
+/** Maximum size of the cache of blocks read from disk in MiB */
+static const int64_t MAX_BLOCK_READ_CACHE = 1024;
+/** Whether blocks are read from memory mappings of the block files by default */
+static const bool DEFAULT_BLOCK_MMAP = false;
+
+/**
+ * Keeps the blocks most recently read from the block files, so a block served to several
+ * peers, or read again by the indexes and RPC right after being connected, is deserialized
+ * once. The cache is bounded by the memory use of the blocks and evicts the least recently
+ * used one first. Blocks are shared, a hit costs a copy of the header and the transaction
+ * references only.
+ *
+ * Optionally the block files are mapped into memory and blocks deserialized from the
+ * mappings, which saves a read into a stdio buffer for every block. Only a few files stay
+ * mapped, the least recently used mapping is released first.
+ */
+class CBlockReadCache
+{
+public:
+    struct Stats {
+        size_t usage;
+        size_t limit;
+        size_t entries;
+        uint64_t hits;
+        uint64_t misses;
+        size_t mapped_files;
+        size_t mapped_bytes;
+    };
+
+private:
+    class MappedFile;
+    //! Key of a block: file number and position of the block data in the file
+    typedef std::pair<int, unsigned int> Key;
+    struct Entry {
+        Key key;
+        std::shared_ptr<const CBlock> block;
+        //! Memory use of the block, counted in m_usage
+        size_t usage;
+    };
+    typedef std::list<Entry> List;
+
+    mutable Mutex cs;
+    //! Blocks, the most recently used first
+    List m_blocks GUARDED_BY(cs);
+    std::map<Key, List::iterator> m_index GUARDED_BY(cs);
+    size_t m_usage GUARDED_BY(cs) = 0;
+    size_t m_limit GUARDED_BY(cs) = 0;
+    uint64_t m_hits GUARDED_BY(cs) = 0;
+    uint64_t m_misses GUARDED_BY(cs) = 0;
+
+    bool m_mmap GUARDED_BY(cs) = false;
+    //! Mapped block files, the most recently used first
+    std::list<std::pair<int, std::shared_ptr<const MappedFile>>> m_mapped GUARDED_BY(cs);
+
+    void Evict() EXCLUSIVE_LOCKS_REQUIRED(cs);
+    std::shared_ptr<const MappedFile> GetMapping(int nFile, size_t nMinLength) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+public:
+    /** Set the maximum memory use of the cached blocks in bytes, 0 disables the cache */
+    void SetLimit(size_t nLimit);
+    /** Enable or disable reading blocks from memory mapped block files, false if not supported */
+    bool SetMmap(bool fMmap);
+
+    /** The block at pos, null if it is not cached. Counts a hit or a miss. */
+    std::shared_ptr<const CBlock> Get(const CDiskBlockPos& pos);
+    /** Add the block read from pos */
+    void Insert(const CDiskBlockPos& pos, const std::shared_ptr<const CBlock>& block);
+
+    /**
+     * Deserialize the block at pos from a mapping of its block file. Returns false, leaving
+     * block unchanged, when mapping is disabled or the file cannot be mapped, the caller
+     * reads the file then. Throws when the mapped data does not hold a block.
+     */
+    bool ReadMapped(const CDiskBlockPos& pos, CBlock& block);
+
+    /** Drop the blocks and the mapping of a block file, which is about to be deleted */
+    void EraseFile(int nFile);
+    void Clear();
+
+    Stats GetStats() const;
+};
+
+extern CBlockReadCache g_block_read_cache;
+
+#endif // VELES_BLOCKREADCACHE_H
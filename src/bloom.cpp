@@ -6,6 +6,7 @@
 
 #include <primitives/transaction.h>
 #include <hash.h>
+#include <memusage.h> // VELES
 #include <script/script.h>
 #include <script/standard.h>
 #include <random.h>
@@ -189,6 +190,95 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
     return false;
 }
 
+// VELES BEGIN
+CBloomTxElements::CBloomTxElements(const CTransaction& tx) : hash(tx.GetHash())
+{
+    for (unsigned int i = 0; i < tx.vout.size(); i++) {
+        const CScript& scriptPubKey = tx.vout[i].scriptPubKey;
+        Output output;
+        CScript::const_iterator pc = scriptPubKey.begin();
+        std::vector<unsigned char> data;
+        while (pc < scriptPubKey.end()) {
+            opcodetype opcode;
+            if (!scriptPubKey.GetOp(pc, opcode, data))
+                break;
+            if (data.size() != 0)
+                output.vData.push_back(data);
+        }
+        if (output.vData.empty())
+            continue;
+        std::vector<std::vector<unsigned char> > vSolutions;
+        txnouttype type = Solver(scriptPubKey, vSolutions);
+        output.n = i;
+        output.fPubKeyOrMultisig = type == TX_PUBKEY || type == TX_MULTISIG;
+        vOutputs.push_back(std::move(output));
+    }
+
+    vPrevouts.reserve(tx.vin.size());
+    for (const CTxIn& txin : tx.vin) {
+        vPrevouts.push_back(txin.prevout);
+        CScript::const_iterator pc = txin.scriptSig.begin();
+        std::vector<unsigned char> data;
+        while (pc < txin.scriptSig.end()) {
+            opcodetype opcode;
+            if (!txin.scriptSig.GetOp(pc, opcode, data))
+                break;
+            if (data.size() != 0)
+                vScriptSigData.push_back(data);
+        }
+    }
+}
+
+size_t CBloomTxElements::DynamicMemoryUsage() const
+{
+    size_t nUsage = memusage::DynamicUsage(vOutputs) + memusage::DynamicUsage(vPrevouts) + memusage::DynamicUsage(vScriptSigData);
+    for (const Output& output : vOutputs) {
+        nUsage += memusage::DynamicUsage(output.vData);
+        for (const std::vector<unsigned char>& data : output.vData)
+            nUsage += memusage::DynamicUsage(data);
+    }
+    for (const std::vector<unsigned char>& data : vScriptSigData)
+        nUsage += memusage::DynamicUsage(data);
+    return nUsage;
+}
+
+bool CBloomFilter::IsRelevantAndUpdate(const CBloomTxElements& elements)
+{
+    // Same matches and updates as IsRelevantAndUpdate(const CTransaction&)
+    if (isFull)
+        return true;
+    if (isEmpty)
+        return false;
+    bool fFound = contains(elements.hash);
+
+    for (const CBloomTxElements::Output& output : elements.vOutputs) {
+        for (const std::vector<unsigned char>& data : output.vData) {
+            if (contains(data)) {
+                fFound = true;
+                if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_ALL ||
+                    ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_P2PUBKEY_ONLY && output.fPubKeyOrMultisig))
+                    insert(COutPoint(elements.hash, output.n));
+                break;
+            }
+        }
+    }
+
+    if (fFound)
+        return true;
+
+    for (const COutPoint& prevout : elements.vPrevouts) {
+        if (contains(prevout))
+            return true;
+    }
+    for (const std::vector<unsigned char>& data : elements.vScriptSigData) {
+        if (contains(data))
+            return true;
+    }
+
+    return false;
+}
+// VELES END
+
 void CBloomFilter::UpdateEmptyFull()
 {
     bool full = true;
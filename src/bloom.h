@@ -5,6 +5,7 @@
 #ifndef BITCOIN_BLOOM_H
 #define BITCOIN_BLOOM_H
 
+#include <primitives/transaction.h> // VELES
 #include <serialize.h>
 
 #include <vector>
@@ -30,6 +31,36 @@ enum bloomflags
     BLOOM_UPDATE_MASK = 3,
 };
 
+// VELES BEGIN
+/**
+ * The data elements of a transaction a bloom filter is matched against: the
+ * txid, the data pushes of the scriptPubKeys and scriptSigs and the spent
+ * outpoints. Extracted once from a block, they are matched against the filter
+ * of every peer without deserializing and parsing the block again.
+ */
+struct CBloomTxElements
+{
+    struct Output
+    {
+        uint32_t n;
+        //! Pay-to-pubkey or bare multisig, added to BLOOM_UPDATE_P2PUBKEY_ONLY filters
+        bool fPubKeyOrMultisig;
+        std::vector<std::vector<unsigned char>> vData;
+    };
+
+    uint256 hash;
+    //! Outputs with at least one data push, in order
+    std::vector<Output> vOutputs;
+    std::vector<COutPoint> vPrevouts;
+    //! Data pushes of all the scriptSigs
+    std::vector<std::vector<unsigned char>> vScriptSigData;
+
+    explicit CBloomTxElements(const CTransaction& tx);
+
+    size_t DynamicMemoryUsage() const;
+};
+// VELES END
+
 /**
  * BloomFilter is a probabilistic filter which SPV clients provide
  * so that we can filter the transactions we send them.
@@ -93,6 +124,8 @@ public:
 
     //! Also adds any outputs which match the filter to the filter (to match their spending txes)
     bool IsRelevantAndUpdate(const CTransaction& tx);
+    //! Same as above, from the elements extracted from the transaction
+    bool IsRelevantAndUpdate(const CBloomTxElements& elements); // VELES
 
     //! Checks for empty and full filters to avoid wasting cpu
     void UpdateEmptyFull();
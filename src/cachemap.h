@@ -6,11 +6,20 @@
 #ifndef DASH_CACHEMAP_H
 #define DASH_CACHEMAP_H
 
-#include <map>
-#include <list>
+#include <assert.h>
 #include <cstddef>
-
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+#include <crypto/siphash.h>
+#include <memusage.h>
+#include <primitives/transaction.h>
+#include <random.h>
 #include <serialize.h>
+#include <uint256.h>
 
 /**
  * Serializable structure for key/value items
@@ -39,6 +48,401 @@ struct CacheItem
     }
 };
 
+/**
+ * Salted SipHash of cache keys. uint256 and COutPoint keys are hashed directly,
+ * other keys through their serialization.
+ */
+class CacheKeyHasher
+{
+private:
+    uint64_t k0;
+    uint64_t k1;
+
+    class Writer
+    {
+    private:
+        CSipHasher hasher;
+
+    public:
+        Writer(uint64_t k0In, uint64_t k1In) : hasher(k0In, k1In) {}
+
+        int GetType() const { return SER_GETHASH; }
+        int GetVersion() const { return 0; }
+
+        void write(const char* pch, size_t size)
+        {
+            hasher.Write((const unsigned char*)pch, size);
+        }
+
+        uint64_t Finalize() const { return hasher.Finalize(); }
+    };
+
+public:
+    CacheKeyHasher(uint64_t k0In = 0, uint64_t k1In = 0)
+        : k0(k0In),
+          k1(k1In)
+    {}
+
+    uint64_t operator()(const uint256& key) const
+    {
+        return SipHashUint256(k0, k1, key);
+    }
+
+    uint64_t operator()(const COutPoint& key) const
+    {
+        return SipHashUint256Extra(k0, k1, key.hash, key.n);
+    }
+
+    template<typename T>
+    uint64_t operator()(const T& key) const
+    {
+        Writer writer(k0, k1);
+        ::Serialize(writer, key);
+        return writer.Finalize();
+    }
+};
+
+/**
+ * Items of CacheMap and CacheMultiMap, most recently added first.
+ *
+ * The items live in nodes allocated in chunks that are never moved, freed nodes are reused,
+ * so adding an item allocates nothing once the cache is full and references to items stay
+ * valid until they are removed, as with std::list. The nodes are linked in order of addition,
+ * and those holding the same key are linked from the first one added, which an open addressing
+ * index with a per-instance salt finds by key. The index is salted when first used.
+ */
+template<typename K, typename V, typename Hasher = CacheKeyHasher>
+class CacheItemList
+{
+public:
+    typedef CacheItem<K,V> item_t;
+
+    static const uint32_t NONE = 0xffffffff;
+
+private:
+    static const int CHUNK_BITS = 6;
+    static const uint32_t CHUNK_SIZE = 1 << CHUNK_BITS;
+
+    struct Node
+    {
+        item_t item;
+        uint32_t nHash = 0;
+        //! Order of addition, nNext also links the free nodes
+        uint32_t nPrev = NONE;
+        uint32_t nNext = NONE;
+        //! Nodes holding the same key
+        uint32_t nPrevKey = NONE;
+        uint32_t nNextKey = NONE;
+    };
+
+    std::vector<std::unique_ptr<Node[]>> vChunks;
+    uint32_t nAllocated = 0;
+    uint32_t nFree = NONE;
+    uint32_t nFront = NONE;
+    uint32_t nBack = NONE;
+    size_t nItems = 0;
+
+    //! First node of every key, NONE for empty slots
+    std::vector<uint32_t> vSlots;
+    size_t nKeys = 0;
+    Hasher hasher;
+
+public:
+    class const_iterator : public std::iterator<std::forward_iterator_tag, const item_t>
+    {
+    private:
+        const CacheItemList* list;
+        uint32_t nIndex;
+
+    public:
+        const_iterator(const CacheItemList* listIn = nullptr, uint32_t nIndexIn = NONE)
+            : list(listIn),
+              nIndex(nIndexIn)
+        {}
+
+        const item_t& operator*() const { return list->GetItem(nIndex); }
+        const item_t* operator->() const { return &list->GetItem(nIndex); }
+
+        const_iterator& operator++()
+        {
+            nIndex = list->Next(nIndex);
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator ret = *this;
+            ++(*this);
+            return ret;
+        }
+
+        bool operator==(const const_iterator& other) const { return nIndex == other.nIndex; }
+        bool operator!=(const const_iterator& other) const { return nIndex != other.nIndex; }
+    };
+
+    CacheItemList() {}
+
+    CacheItemList(const CacheItemList& other)
+    {
+        Append(other);
+    }
+
+    CacheItemList& operator=(const CacheItemList& other)
+    {
+        if(this != &other) {
+            Clear();
+            Append(other);
+        }
+        return *this;
+    }
+
+    const_iterator begin() const { return const_iterator(this, nFront); }
+    const_iterator end() const { return const_iterator(this, NONE); }
+    size_t size() const { return nItems; }
+    bool empty() const { return nItems == 0; }
+
+    /** Memory taken by every item with its share of the index, not counting what it points to */
+    static size_t ItemUsage() { return sizeof(Node) + 2 * sizeof(uint32_t); }
+
+    /** Memory held by the nodes and the index, not counting what the items point to */
+    size_t DynamicMemoryUsage() const
+    {
+        return vChunks.size() * memusage::MallocUsage(sizeof(Node) * CHUNK_SIZE) + memusage::DynamicUsage(vChunks) + memusage::DynamicUsage(vSlots);
+    }
+
+    void Clear()
+    {
+        vChunks.clear();
+        nAllocated = 0;
+        nFree = NONE;
+        nFront = NONE;
+        nBack = NONE;
+        nItems = 0;
+        vSlots.clear();
+        nKeys = 0;
+    }
+
+    const item_t& GetItem(uint32_t nIndex) const { return GetNode(nIndex).item; }
+    item_t& GetItem(uint32_t nIndex) { return GetNode(nIndex).item; }
+
+    uint32_t Front() const { return nFront; }
+    uint32_t Back() const { return nBack; }
+    uint32_t Next(uint32_t nIndex) const { return GetNode(nIndex).nNext; }
+
+    /** The first node added with key, NONE when there is none */
+    uint32_t Find(const K& key) const
+    {
+        if(vSlots.empty()) {
+            return NONE;
+        }
+        const uint32_t nHash = hasher(key);
+        const size_t nMask = vSlots.size() - 1;
+        for(size_t i = nHash & nMask; vSlots[i] != NONE; i = (i + 1) & nMask) {
+            const Node& node = GetNode(vSlots[i]);
+            if(node.nHash == nHash && node.item.key == key) {
+                return vSlots[i];
+            }
+        }
+        return NONE;
+    }
+
+    /** The next node added with the key of nIndex, NONE after the last one */
+    uint32_t NextSameKey(uint32_t nIndex) const { return GetNode(nIndex).nNextKey; }
+
+    bool IsFirstOfKey(uint32_t nIndex) const { return GetNode(nIndex).nPrevKey == NONE; }
+
+    /** Add an item as the most recent one */
+    uint32_t Add(const K& key, const V& value)
+    {
+        // Grow before hashing, the index is salted when first allocated
+        if((nKeys + 1) * 4 > vSlots.size() * 3) {
+            Rehash(vSlots.empty() ? 16 : vSlots.size() * 2);
+        }
+
+        const uint32_t nIndex = Allocate();
+        Node& node = GetNode(nIndex);
+        node.item.key = key;
+        node.item.value = value;
+        node.nHash = hasher(key);
+
+        node.nPrev = NONE;
+        node.nNext = nFront;
+        if(nFront != NONE) {
+            GetNode(nFront).nPrev = nIndex;
+        } else {
+            nBack = nIndex;
+        }
+        nFront = nIndex;
+        ++nItems;
+
+        uint32_t nLast = Find(key);
+        if(nLast == NONE) {
+            InsertSlot(nIndex);
+            ++nKeys;
+        } else {
+            while(GetNode(nLast).nNextKey != NONE) {
+                nLast = GetNode(nLast).nNextKey;
+            }
+            GetNode(nLast).nNextKey = nIndex;
+            node.nPrevKey = nLast;
+        }
+        return nIndex;
+    }
+
+    void Remove(uint32_t nIndex)
+    {
+        Node& node = GetNode(nIndex);
+
+        if(node.nPrev != NONE) {
+            GetNode(node.nPrev).nNext = node.nNext;
+        } else {
+            nFront = node.nNext;
+        }
+        if(node.nNext != NONE) {
+            GetNode(node.nNext).nPrev = node.nPrev;
+        } else {
+            nBack = node.nPrev;
+        }
+
+        if(node.nPrevKey != NONE) {
+            GetNode(node.nPrevKey).nNextKey = node.nNextKey;
+            if(node.nNextKey != NONE) {
+                GetNode(node.nNextKey).nPrevKey = node.nPrevKey;
+            }
+        } else {
+            const size_t nSlot = FindSlot(nIndex);
+            if(node.nNextKey != NONE) {
+                vSlots[nSlot] = node.nNextKey;
+                GetNode(node.nNextKey).nPrevKey = NONE;
+            } else {
+                EraseSlot(nSlot);
+                --nKeys;
+            }
+        }
+
+        // Release what the item holds, the node is kept for reuse
+        node.item = item_t();
+        node.nPrev = NONE;
+        node.nNext = nFree;
+        node.nPrevKey = NONE;
+        node.nNextKey = NONE;
+        nFree = nIndex;
+        --nItems;
+    }
+
+    /** Same format as std::list<item_t>, most recent item first */
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        WriteCompactSize(s, nItems);
+        for(const item_t& item : *this) {
+            s << item;
+        }
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        Clear();
+        std::vector<item_t> vecItems;
+        s >> vecItems;
+        // Added oldest first so the items of a key are linked in the order they were added
+        for(auto it = vecItems.rbegin(); it != vecItems.rend(); ++it) {
+            Add(it->key, it->value);
+        }
+    }
+
+private:
+    const Node& GetNode(uint32_t nIndex) const
+    {
+        return vChunks[nIndex >> CHUNK_BITS][nIndex & (CHUNK_SIZE - 1)];
+    }
+
+    Node& GetNode(uint32_t nIndex)
+    {
+        return vChunks[nIndex >> CHUNK_BITS][nIndex & (CHUNK_SIZE - 1)];
+    }
+
+    uint32_t Allocate()
+    {
+        if(nFree != NONE) {
+            const uint32_t nIndex = nFree;
+            nFree = GetNode(nIndex).nNext;
+            return nIndex;
+        }
+        if(nAllocated % CHUNK_SIZE == 0) {
+            vChunks.emplace_back(new Node[CHUNK_SIZE]);
+        }
+        return nAllocated++;
+    }
+
+    void Append(const CacheItemList& other)
+    {
+        for(uint32_t nIndex = other.nBack; nIndex != NONE; nIndex = other.GetNode(nIndex).nPrev) {
+            const item_t& item = other.GetItem(nIndex);
+            Add(item.key, item.value);
+        }
+    }
+
+    void Rehash(size_t nSlots)
+    {
+        if(vSlots.empty()) {
+            // Only an empty list has no index
+            hasher = Hasher(GetRand(std::numeric_limits<uint64_t>::max()), GetRand(std::numeric_limits<uint64_t>::max()));
+        }
+        vSlots.assign(nSlots, NONE);
+        for(uint32_t nIndex = nFront; nIndex != NONE; nIndex = GetNode(nIndex).nNext) {
+            if(GetNode(nIndex).nPrevKey == NONE) {
+                InsertSlot(nIndex);
+            }
+        }
+    }
+
+    void InsertSlot(uint32_t nIndex)
+    {
+        const size_t nMask = vSlots.size() - 1;
+        size_t i = GetNode(nIndex).nHash & nMask;
+        while(vSlots[i] != NONE) {
+            i = (i + 1) & nMask;
+        }
+        vSlots[i] = nIndex;
+    }
+
+    size_t FindSlot(uint32_t nIndex) const
+    {
+        const size_t nMask = vSlots.size() - 1;
+        size_t i = GetNode(nIndex).nHash & nMask;
+        while(vSlots[i] != nIndex) {
+            assert(vSlots[i] != NONE);
+            i = (i + 1) & nMask;
+        }
+        return i;
+    }
+
+    /** Empty a slot, moving back the following entries so no probe sequence is broken */
+    void EraseSlot(size_t i)
+    {
+        const size_t nMask = vSlots.size() - 1;
+        size_t j = i;
+        while(true) {
+            j = (j + 1) & nMask;
+            if(vSlots[j] == NONE) {
+                break;
+            }
+            // Entries whose home slot lies cyclically in (i, j] stay where they are
+            const size_t k = GetNode(vSlots[j]).nHash & nMask;
+            if((i <= j) ? (i < k && k <= j) : (i < k || k <= j)) {
+                continue;
+            }
+            vSlots[i] = vSlots[j];
+            i = j;
+        }
+        vSlots[i] = NONE;
+    }
+};
+
+template<typename K, typename V, typename Hasher>
+const uint32_t CacheItemList<K,V,Hasher>::NONE;
 
 /**
  * Map like container that keeps the N most recently added items
@@ -51,49 +455,26 @@ public:
 
     typedef CacheItem<K,V> item_t;
 
-    typedef std::list<item_t> list_t;
+    typedef CacheItemList<K,V> list_t;
 
-    typedef typename list_t::iterator list_it;
+    typedef typename list_t::const_iterator list_it;
 
     typedef typename list_t::const_iterator list_cit;
 
-    typedef std::map<K, list_it> map_t;
-
-    typedef typename map_t::iterator map_it;
-
-    typedef typename map_t::const_iterator map_cit;
-
 private:
     size_type nMaxSize;
 
-    size_type nCurrentSize;
-
     list_t listItems;
 
-    map_t mapIndex;
-
 public:
     CacheMap(size_type nMaxSizeIn = 0)
         : nMaxSize(nMaxSizeIn),
-          nCurrentSize(0),
-          listItems(),
-          mapIndex()
+          listItems()
     {}
 
-    CacheMap(const CacheMap<K,V>& other)
-        : nMaxSize(other.nMaxSize),
-          nCurrentSize(other.nCurrentSize),
-          listItems(other.listItems),
-          mapIndex()
-    {
-        RebuildIndex();
-    }
-
     void Clear()
     {
-        mapIndex.clear();
-        listItems.clear();
-        nCurrentSize = 0;
+        listItems.Clear();
     }
 
     void SetMaxSize(size_type nMaxSizeIn)
@@ -106,64 +487,62 @@ public:
     }
 
     size_type GetSize() const {
-        return nCurrentSize;
+        return listItems.size();
     }
 
     void Insert(const K& key, const V& value)
     {
-        map_it it = mapIndex.find(key);
-        if(it != mapIndex.end()) {
-            item_t& item = *(it->second);
+        uint32_t nIndex = listItems.Find(key);
+        if(nIndex != list_t::NONE) {
+            item_t& item = listItems.GetItem(nIndex);
             item.value = value;
             return;
         }
-        if(nCurrentSize == nMaxSize) {
+        if(GetSize() == nMaxSize) {
             PruneLast();
         }
-        listItems.push_front(item_t(key, value));
-        mapIndex[key] = listItems.begin();
-        ++nCurrentSize;
+        listItems.Add(key, value);
     }
 
     bool HasKey(const K& key) const
     {
-        map_cit it = mapIndex.find(key);
-        return (it != mapIndex.end());
+        return listItems.Find(key) != list_t::NONE;
     }
 
     bool Get(const K& key, V& value) const
     {
-        map_cit it = mapIndex.find(key);
-        if(it == mapIndex.end()) {
+        uint32_t nIndex = listItems.Find(key);
+        if(nIndex == list_t::NONE) {
             return false;
         }
-        item_t& item = *(it->second);
-        value = item.value;
+        value = listItems.GetItem(nIndex).value;
         return true;
     }
 
     void Erase(const K& key)
     {
-        map_it it = mapIndex.find(key);
-        if(it == mapIndex.end()) {
+        uint32_t nIndex = listItems.Find(key);
+        if(nIndex == list_t::NONE) {
             return;
         }
-        listItems.erase(it->second);
-        mapIndex.erase(it);
-        --nCurrentSize;
+        listItems.Remove(nIndex);
     }
 
     const list_t& GetItemList() const {
         return listItems;
     }
 
-    CacheMap<K,V>& operator=(const CacheMap<K,V>& other)
+    size_t DynamicMemoryUsage() const {
+        return listItems.DynamicMemoryUsage();
+    }
+
+    /** Remove the oldest item */
+    void PruneLast()
     {
-        nMaxSize = other.nMaxSize;
-        nCurrentSize = other.nCurrentSize;
-        listItems = other.listItems;
-        RebuildIndex();
-        return *this;
+        if(listItems.empty()) {
+            return;
+        }
+        listItems.Remove(listItems.Back());
     }
 
     ADD_SERIALIZE_METHODS;
@@ -171,32 +550,10 @@ public:
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action)
     {
+        size_type nCurrentSize = GetSize();
         READWRITE(nMaxSize);
         READWRITE(nCurrentSize);
         READWRITE(listItems);
-        if(ser_action.ForRead()) {
-            RebuildIndex();
-        }
-    }
-
-private:
-    void PruneLast()
-    {
-        if(nCurrentSize < 1) {
-            return;
-        }
-        item_t& item = listItems.back();
-        mapIndex.erase(item.key);
-        listItems.pop_back();
-        --nCurrentSize;
-    }
-
-    void RebuildIndex()
-    {
-        mapIndex.clear();
-        for(list_it it = listItems.begin(); it != listItems.end(); ++it) {
-            mapIndex[it->key] = it;
-        }
     }
 };
 
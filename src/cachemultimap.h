@@ -7,9 +7,7 @@
 #define DASH_CACHEMULTIMAP_H
 
 #include <cstddef>
-#include <map>
-#include <list>
-#include <set>
+#include <vector>
 
 #include <serialize.h>
 
@@ -26,55 +24,26 @@ public:
 
     typedef CacheItem<K,V> item_t;
 
-    typedef std::list<item_t> list_t;
+    typedef CacheItemList<K,V> list_t;
 
-    typedef typename list_t::iterator list_it;
+    typedef typename list_t::const_iterator list_it;
 
     typedef typename list_t::const_iterator list_cit;
 
-    typedef std::map<V,list_it> it_map_t;
-
-    typedef typename it_map_t::iterator it_map_it;
-
-    typedef typename it_map_t::const_iterator it_map_cit;
-
-    typedef std::map<K, it_map_t> map_t;
-
-    typedef typename map_t::iterator map_it;
-
-    typedef typename map_t::const_iterator map_cit;
-
 private:
     size_type nMaxSize;
 
-    size_type nCurrentSize;
-
     list_t listItems;
 
-    map_t mapIndex;
-
 public:
     CacheMultiMap(size_type nMaxSizeIn = 0)
         : nMaxSize(nMaxSizeIn),
-          nCurrentSize(0),
-          listItems(),
-          mapIndex()
+          listItems()
     {}
 
-    CacheMultiMap(const CacheMap<K,V>& other)
-        : nMaxSize(other.nMaxSize),
-          nCurrentSize(other.nCurrentSize),
-          listItems(other.listItems),
-          mapIndex()
-    {
-        RebuildIndex();
-    }
-
     void Clear()
     {
-        mapIndex.clear();
-        listItems.clear();
-        nCurrentSize = 0;
+        listItems.Clear();
     }
 
     void SetMaxSize(size_type nMaxSizeIn)
@@ -87,122 +56,95 @@ public:
     }
 
     size_type GetSize() const {
-        return nCurrentSize;
+        return listItems.size();
     }
 
     bool Insert(const K& key, const V& value)
     {
-        if(nCurrentSize == nMaxSize) {
+        if(GetSize() == nMaxSize) {
             PruneLast();
         }
-        map_it mit = mapIndex.find(key);
-        if(mit == mapIndex.end()) {
-            mit = mapIndex.insert(std::pair<K,it_map_t>(key, it_map_t())).first;
-        }
-        it_map_t& mapIt = mit->second;
-
-        if(mapIt.count(value) > 0) {
+        if(Find(key, value) != list_t::NONE) {
             // Don't insert duplicates
             return false;
         }
-
-        listItems.push_front(item_t(key, value));
-        list_it lit = listItems.begin();
-
-        mapIt[value] = lit;
-        ++nCurrentSize;
+        listItems.Add(key, value);
         return true;
     }
 
     bool HasKey(const K& key) const
     {
-        map_cit it = mapIndex.find(key);
-        return (it != mapIndex.end());
+        return listItems.Find(key) != list_t::NONE;
     }
 
+    /** The value added first with key */
     bool Get(const K& key, V& value) const
     {
-        map_cit it = mapIndex.find(key);
-        if(it == mapIndex.end()) {
+        uint32_t nIndex = listItems.Find(key);
+        if(nIndex == list_t::NONE) {
             return false;
         }
-        const it_map_t& mapIt = it->second;
-        const item_t& item = *(mapIt.begin()->second);
-        value = item.value;
+        value = listItems.GetItem(nIndex).value;
         return true;
     }
 
-    bool GetAll(const K& key, std::vector<V>& vecValues)
+    /** The values of key in the order they were added */
+    bool GetAll(const K& key, std::vector<V>& vecValues) const
     {
-        map_cit mit = mapIndex.find(key);
-        if(mit == mapIndex.end()) {
+        uint32_t nIndex = listItems.Find(key);
+        if(nIndex == list_t::NONE) {
             return false;
         }
-        const it_map_t& mapIt = mit->second;
-
-        for(it_map_cit it = mapIt.begin(); it != mapIt.end(); ++it) {
-            const item_t& item = *(it->second);
-            vecValues.push_back(item.value);
+        for(; nIndex != list_t::NONE; nIndex = listItems.NextSameKey(nIndex)) {
+            vecValues.push_back(listItems.GetItem(nIndex).value);
         }
         return true;
     }
 
-    void GetKeys(std::vector<K>& vecKeys)
+    void GetKeys(std::vector<K>& vecKeys) const
     {
-        for(map_cit it = mapIndex.begin(); it != mapIndex.end(); ++it) {
-            vecKeys.push_back(it->first);
+        for(uint32_t nIndex = listItems.Front(); nIndex != list_t::NONE; nIndex = listItems.Next(nIndex)) {
+            if(listItems.IsFirstOfKey(nIndex)) {
+                vecKeys.push_back(listItems.GetItem(nIndex).key);
+            }
         }
     }
 
     void Erase(const K& key)
     {
-        map_it mit = mapIndex.find(key);
-        if(mit == mapIndex.end()) {
-            return;
+        uint32_t nIndex = listItems.Find(key);
+        while(nIndex != list_t::NONE) {
+            uint32_t nNext = listItems.NextSameKey(nIndex);
+            listItems.Remove(nIndex);
+            nIndex = nNext;
         }
-        it_map_t& mapIt = mit->second;
-
-        for(it_map_it it = mapIt.begin(); it != mapIt.end(); ++it) {
-            listItems.erase(it->second);
-            --nCurrentSize;
-        }
-
-        mapIndex.erase(mit);
     }
 
     void Erase(const K& key, const V& value)
     {
-        map_it mit = mapIndex.find(key);
-        if(mit == mapIndex.end()) {
-            return;
-        }
-        it_map_t& mapIt = mit->second;
-
-        it_map_it it = mapIt.find(value);
-        if(it == mapIt.end()) {
+        uint32_t nIndex = Find(key, value);
+        if(nIndex == list_t::NONE) {
             return;
         }
-
-        listItems.erase(it->second);
-        --nCurrentSize;
-        mapIt.erase(it);
-
-        if(mapIt.size() < 1) {
-            mapIndex.erase(mit);
-        }
+        // key and value may refer to the item removed, they are not used past this point
+        listItems.Remove(nIndex);
     }
 
     const list_t& GetItemList() const {
         return listItems;
     }
 
-    CacheMap<K,V>& operator=(const CacheMap<K,V>& other)
+    size_t DynamicMemoryUsage() const {
+        return listItems.DynamicMemoryUsage();
+    }
+
+    /** Remove the oldest item */
+    void PruneLast()
     {
-        nMaxSize = other.nMaxSize;
-        nCurrentSize = other.nCurrentSize;
-        listItems = other.listItems;
-        RebuildIndex();
-        return *this;
+        if(listItems.empty()) {
+            return;
+        }
+        listItems.Remove(listItems.Back());
     }
 
     ADD_SERIALIZE_METHODS;
@@ -210,53 +152,22 @@ public:
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action)
     {
+        size_type nCurrentSize = GetSize();
         READWRITE(nMaxSize);
         READWRITE(nCurrentSize);
         READWRITE(listItems);
-        if(ser_action.ForRead()) {
-            RebuildIndex();
-        }
     }
 
 private:
-    void PruneLast()
-    {
-        if(nCurrentSize < 1) {
-            return;
-        }
-
-        list_it lit = listItems.end();
-        --lit;
-        item_t& item = *lit;
-
-        map_it mit = mapIndex.find(item.key);
-
-        if(mit != mapIndex.end()) {
-            it_map_t& mapIt = mit->second;
-
-            mapIt.erase(item.value);
-
-            if(mapIt.size() < 1) {
-                mapIndex.erase(item.key);
-            }
-        }
-
-        listItems.pop_back();
-        --nCurrentSize;
-    }
-
-    void RebuildIndex()
+    /** Values of a key are few, they are compared one by one */
+    uint32_t Find(const K& key, const V& value) const
     {
-        mapIndex.clear();
-        for(list_it lit = listItems.begin(); lit != listItems.end(); ++lit) {
-            item_t& item = *lit;
-            map_it mit = mapIndex.find(item.key);
-            if(mit == mapIndex.end()) {
-                mit = mapIndex.insert(std::pair<K,it_map_t>(item.key, it_map_t())).first;
+        for(uint32_t nIndex = listItems.Find(key); nIndex != list_t::NONE; nIndex = listItems.NextSameKey(nIndex)) {
+            if(listItems.GetItem(nIndex).value == value) {
+                return nIndex;
             }
-            it_map_t& mapIt = mit->second;
-            mapIt[item.value] = lit;
         }
+        return list_t::NONE;
     }
 };
 
@@ -119,6 +119,25 @@ void CBlockIndex::BuildSkip()
         pskip = pprev->GetAncestor(GetSkipHeight(nHeight));
 }
 
+// VELES BEGIN
+void CBlockIndex::BuildPrevAlgo()
+{
+    // Blocks of the active algos are interleaved, the walk usually stops after a few steps
+    pprevAlgo = pprev;
+    while (pprevAlgo && pprevAlgo->GetAlgo() != GetAlgo())
+        pprevAlgo = pprevAlgo->pprev;
+    GetAlgoTarget();
+}
+
+const arith_uint256& CBlockIndex::GetAlgoTarget() const
+{
+    // The efficiency only depends on the algo bits of nVersion, so the result never changes
+    if (bnAlgoTarget == 0)
+        bnAlgoTarget = arith_uint256().SetCompact(nBits) / GetBlockHeader().GetAlgoEfficiency(nHeight);
+    return bnAlgoTarget;
+}
+// VELES END
+
 arith_uint256 GetBlockProof(const CBlockIndex& block)
 {
     arith_uint256 bnTarget;
@@ -6,6 +6,7 @@
 #ifndef BITCOIN_CHAIN_H
 #define BITCOIN_CHAIN_H
 
+#include <amount.h>
 #include <arith_uint256.h>
 #include <consensus/params.h>
 #include <primitives/block.h>
@@ -168,6 +169,12 @@ enum BlockStatus: uint32_t {
     BLOCK_FAILED_MASK        =   BLOCK_FAILED_VALID | BLOCK_FAILED_CHILD,
 
     BLOCK_OPT_WITNESS       =   128, //!< block data in blk*.data was received with a witness-enforcing client
+
+    // VELES BEGIN
+    //! chain state was loaded from a UTXO snapshot at this block, which has no data, nor may its ancestors;
+    //! nTx holds the number of transactions of the chain up to and including it
+    BLOCK_SNAPSHOT           =   256,
+    // VELES END
 };
 
 /** The block chain is a tree shaped structure starting with the
@@ -232,6 +239,25 @@ public:
     //! (memory only) Maximum nTime in the chain up to and including this block.
     unsigned int nTimeMax;
 
+    // VELES BEGIN
+    //! (memory only) Proof-of-work hash of this block's header, computed at most once.
+    //! Persisted separately by CBlockTreeDB so that it does not need to be recomputed on startup.
+    mutable uint256 hashPoW;
+
+    //! (memory only) Total block subsidy of the chain from block 1 up to and including this block,
+    //! -1 until GetChainSubsidy() computed it.
+    mutable CAmount nChainSubsidy;
+
+    //! (memory only) Closest predecessor of this block mined by the same algo, set by BuildPrevAlgo()
+    CBlockIndex* pprevAlgo;
+
+    //! (memory only) Target of this block normalized by its algo efficiency, zero until GetAlgoTarget() computed it.
+    mutable arith_uint256 bnAlgoTarget;
+
+    // The work of the block alone is only kept by CDiskBlockIndex while loading, see GetBlockProof()
+    //arith_uint256 nBlockWork;
+    // VELES END
+
     void SetNull()
     {
         phashBlock = nullptr;
@@ -250,6 +276,13 @@ public:
         nStatus = 0;
         nSequenceId = 0;
         nTimeMax = 0;
+        // VELES BEGIN
+        hashPoW.SetNull();
+        nChainSubsidy = -1;
+        pprevAlgo = nullptr;
+        bnAlgoTarget = arith_uint256();
+        //nBlockWork = arith_uint256();
+        // VELES END
 
         nVersion       = 0;
         hashMerkleRoot = uint256();
@@ -313,10 +346,24 @@ public:
     // FXTC BEGIN
     uint256 GetBlockPoWHash() const
     {
-        return GetBlockHeader().GetPoWHash();
+        // VELES BEGIN
+        if (hashPoW.IsNull())
+            hashPoW = GetBlockHeader().GetPoWHash();
+        return hashPoW;
+        // VELES END
     }
     // FXTC END
 
+    // VELES BEGIN
+    int32_t GetAlgo() const
+    {
+        return nVersion & ALGO_VERSION_MASK;
+    }
+
+    //! Target of this block divided by the efficiency of its algo, as averaged by the retargeting
+    const arith_uint256& GetAlgoTarget() const;
+    // VELES END
+
     /**
      * Check whether this block's and all previous blocks' transactions have been
      * downloaded (and stored to disk) at some point.
@@ -386,6 +433,11 @@ public:
     //! Build the skiplist pointer for this entry.
     void BuildSkip();
 
+    // VELES BEGIN
+    //! Link this entry to the closest predecessor mined by the same algo and cache its algo target, once pprev is set.
+    void BuildPrevAlgo();
+    // VELES END
+
     //! Efficiently find an ancestor of this block.
     CBlockIndex* GetAncestor(int height);
     const CBlockIndex* GetAncestor(int height) const;
@@ -408,6 +460,11 @@ class CDiskBlockIndex : public CBlockIndex
 public:
     uint256 hashPrev;
 
+    // VELES BEGIN
+    //! (memory only) Work of this block alone, computed in parallel while loading the block index
+    arith_uint256 nBlockWork;
+    // VELES END
+
     CDiskBlockIndex() {
         hashPrev = uint256();
     }
@@ -13,6 +13,7 @@
 #include <primitives/block.h>
 #include <protocol.h>
 
+#include <map>
 #include <memory>
 #include <vector>
 
@@ -39,6 +40,16 @@ struct ChainTxData {
     double dTxRate;   //!< estimated number of transactions per second after that timestamp
 };
 
+// VELES BEGIN
+/** A UTXO set snapshot nodes may start from instead of validating the chain up to its block */
+struct AssumeutxoData {
+    uint256 hashSerialized; //!< hash_serialized_2 of gettxoutsetinfo at the block
+    uint64_t nChainTx;      //!< number of transactions of the chain up to and including the block
+};
+
+typedef std::map<uint256, AssumeutxoData> MapAssumeutxo;
+// VELES END
+
 /**
  * CChainParams defines various tweakable parameters of a given instance of the
  * Bitcoin system. There are three: the main network on which people trade goods
@@ -90,6 +101,10 @@ public:
     int FulfilledRequestExpireTime() const { return nFulfilledRequestExpireTime; }
     //
     const ChainTxData& TxData() const { return chainTxData; }
+    // VELES BEGIN
+    /** UTXO set snapshots accepted by loadtxoutset, by block hash */
+    const MapAssumeutxo& Assumeutxo() const { return m_assumeutxo_data; }
+    // VELES END
     // Dash
     std::string SporkPubKey() const { return strSporkPubKey; }
     //
@@ -120,6 +135,7 @@ protected:
     int nFulfilledRequestExpireTime;
     //
     ChainTxData chainTxData;
+    MapAssumeutxo m_assumeutxo_data; // VELES
     bool m_fallback_fee_enabled;
     // Dash
     std::string strSporkPubKey;
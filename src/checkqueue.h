@@ -8,13 +8,38 @@
 #include <sync.h>
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
 #include <vector>
 
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
 
 template <typename T>
+class CCheckQueue;
+// VELES BEGIN
+//template <typename T>
+//class CCheckQueueControl;
+template <typename T, typename Q = CCheckQueue<T>>
 class CCheckQueueControl;
+// VELES END
+
+// VELES BEGIN
+/**
+ * Run a batch of verifications taken off the queue, stopping at the first failure.
+ * Check types that verify faster together overload it, the overload is found through
+ * argument dependent lookup.
+ */
+template <typename T>
+bool RunChecks(std::vector<T>& vChecks)
+{
+    for (T& check : vChecks)
+        if (!check())
+            return false;
+    return true;
+}
+// VELES END
 
 /**
  * Queue for verifications that have to be performed.
@@ -116,9 +141,13 @@ private:
                 fOk = fAllOk;
             }
             // execute work
-            for (T& check : vChecks)
-                if (fOk)
-                    fOk = check();
+            // VELES BEGIN
+            //for (T& check : vChecks)
+            //    if (fOk)
+            //        fOk = check();
+            if (fOk)
+                fOk = RunChecks(vChecks);
+            // VELES END
             vChecks.clear();
         } while (true);
     }
@@ -163,22 +192,199 @@ public:
 
 };
 
+// VELES BEGIN
+/**
+ * Queue for verifications like CCheckQueue, where every worker thread takes the
+ * verifications from a deque of its own instead of one shared queue.
+ *
+ * Add spreads the verifications over the deques of the workers. A worker runs
+ * down its own deque from the back and steals from the front of the others once
+ * it is empty, the master only steals. Every deque has a lock of its own, so the
+ * workers share a lock only to go to sleep when there is nothing left to steal
+ * and for the last verification of a batch.
+ */
+template <typename T>
+class CWorkStealingCheckQueue
+{
+private:
+    struct WorkerDeque {
+        boost::mutex mutex;
+        std::deque<T> checks;
+    };
+
+    //! The deques of the workers, workers beyond their number share them
+    std::vector<std::unique_ptr<WorkerDeque>> vDeques;
+
+    //! The number of workers that took a deque
+    std::atomic<unsigned int> nWorkers;
+
+    //! The deque the next verifications are added to
+    std::atomic<unsigned int> nNextDeque;
+
+    //! Mutex the threads sleep on
+    boost::mutex mutex;
+
+    //! Worker threads block on this when out of work
+    boost::condition_variable condWorker;
+
+    //! Master thread blocks on this when out of work
+    boost::condition_variable condMaster;
+
+    //! The number of verifications in the deques
+    std::atomic<unsigned int> nQueued;
+
+    //! Number of verifications that haven't completed yet, including the ones taken by the workers
+    std::atomic<unsigned int> nTodo;
+
+    //! The temporary evaluation result.
+    std::atomic<bool> fAllOk;
+
+    //! The maximum number of elements to be processed in one batch
+    unsigned int nBatchSize;
+
+    //! Take a batch off the back of a deque, or off the front when stealing. Half of it is left for the other workers.
+    bool Take(WorkerDeque& deque, bool fSteal, std::vector<T>& vChecks)
+    {
+        boost::unique_lock<boost::mutex> lock(deque.mutex);
+        if (deque.checks.empty())
+            return false;
+        size_t nNow = std::max<size_t>(1, std::min<size_t>(nBatchSize, deque.checks.size() / 2));
+        vChecks.resize(nNow);
+        for (size_t i = 0; i < nNow; i++) {
+            if (fSteal) {
+                vChecks[i].swap(deque.checks.front());
+                deque.checks.pop_front();
+            } else {
+                vChecks[i].swap(deque.checks.back());
+                deque.checks.pop_back();
+            }
+        }
+        nQueued -= nNow;
+        return true;
+    }
+
+    //! Take a batch off the own deque, or steal one from the next deque that is not empty
+    bool TakeAny(size_t nOwn, std::vector<T>& vChecks)
+    {
+        if (nOwn < vDeques.size() && Take(*vDeques[nOwn], false, vChecks))
+            return true;
+        for (size_t i = 1; i <= vDeques.size(); i++) {
+            size_t nVictim = (nOwn + i) % vDeques.size();
+            if (nVictim != nOwn && Take(*vDeques[nVictim], true, vChecks))
+                return true;
+        }
+        return false;
+    }
+
+    /** Internal function that does bulk of the verification work. */
+    bool Loop(bool fMaster, size_t nOwn)
+    {
+        boost::condition_variable& cond = fMaster ? condMaster : condWorker;
+        std::vector<T> vChecks;
+        vChecks.reserve(nBatchSize);
+        while (true) {
+            if (TakeAny(nOwn, vChecks)) {
+                // Check whether we need to do work at all
+                bool fOk = fAllOk;
+                if (fOk)
+                    fOk = RunChecks(vChecks);
+                const unsigned int nNow = vChecks.size();
+                vChecks.clear();
+                if (!fOk)
+                    fAllOk = false;
+                if ((nTodo -= nNow) == 0) {
+                    // We processed the last element; inform the master it can exit and return the result
+                    boost::unique_lock<boost::mutex> lock(mutex);
+                    condMaster.notify_one();
+                }
+                continue;
+            }
+
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (fMaster && nTodo == 0) {
+                bool fRet = fAllOk;
+                // reset the status for new work later
+                fAllOk = true;
+                return fRet;
+            }
+            if (nQueued == 0)
+                cond.wait(lock);
+        }
+    }
+
+public:
+    //! Mutex to ensure only one concurrent CCheckQueueControl
+    boost::mutex ControlMutex;
+
+    //! Create a new check queue with a deque for each of up to nMaxWorkers workers
+    explicit CWorkStealingCheckQueue(unsigned int nBatchSizeIn, unsigned int nMaxWorkers = 64) :
+        nWorkers(0), nNextDeque(0), nQueued(0), nTodo(0), fAllOk(true), nBatchSize(nBatchSizeIn)
+    {
+        for (unsigned int i = 0; i < std::max(1U, nMaxWorkers); i++)
+            vDeques.emplace_back(new WorkerDeque());
+    }
+
+    //! Worker thread
+    void Thread()
+    {
+        Loop(false, nWorkers++ % vDeques.size());
+    }
+
+    //! Wait until execution finishes, and return whether all evaluations were successful.
+    bool Wait()
+    {
+        return Loop(true, vDeques.size());
+    }
+
+    //! Add a batch of checks to the queue
+    void Add(std::vector<T>& vChecks)
+    {
+        if (vChecks.empty())
+            return;
+        nTodo += vChecks.size();
+        nQueued += vChecks.size();
+        // Spread the checks in runs over the deques of the workers
+        const size_t nDeques = std::max<size_t>(1, std::min<size_t>(nWorkers, vDeques.size()));
+        const size_t nRun = (vChecks.size() + nDeques - 1) / nDeques;
+        for (size_t i = 0; i < vChecks.size(); i += nRun) {
+            WorkerDeque& deque = *vDeques[nNextDeque++ % nDeques];
+            boost::unique_lock<boost::mutex> lock(deque.mutex);
+            for (size_t j = i; j < std::min(vChecks.size(), i + nRun); j++) {
+                deque.checks.emplace_back();
+                vChecks[j].swap(deque.checks.back());
+            }
+        }
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (vChecks.size() == 1)
+            condWorker.notify_one();
+        else
+            condWorker.notify_all();
+    }
+};
+// VELES END
+
 /**
  * RAII-style controller object for a CCheckQueue that guarantees the passed
  * queue is finished before continuing.
  */
-template <typename T>
+// VELES BEGIN
+//template <typename T>
+template <typename T, typename Q>
+// VELES END
 class CCheckQueueControl
 {
 private:
-    CCheckQueue<T> * const pqueue;
+    // VELES BEGIN
+    //CCheckQueue<T> * const pqueue;
+    Q * const pqueue;
+    // VELES END
     bool fDone;
 
 public:
     CCheckQueueControl() = delete;
     CCheckQueueControl(const CCheckQueueControl&) = delete;
     CCheckQueueControl& operator=(const CCheckQueueControl&) = delete;
-    explicit CCheckQueueControl(CCheckQueue<T> * const pqueueIn) : pqueue(pqueueIn), fDone(false)
+    explicit CCheckQueueControl(Q * const pqueueIn) : pqueue(pqueueIn), fDone(false) // VELES
     {
         // passed queue is supposed to be unused, or nullptr
         if (pqueue != nullptr) {
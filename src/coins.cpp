@@ -217,6 +217,20 @@ void CCoinsViewCache::Uncache(const COutPoint& hash)
     }
 }
 
+// VELES BEGIN
+bool CCoinsViewCache::AddUncachedCoin(const COutPoint& outpoint, Coin&& coin)
+{
+    assert(!coin.IsSpent());
+    std::pair<CCoinsMap::iterator, bool> ret = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::forward_as_tuple());
+    if (!ret.second) {
+        return false;
+    }
+    ret.first->second.coin = std::move(coin);
+    cachedCoinsUsage += ret.first->second.coin.DynamicMemoryUsage();
+    return true;
+}
+// VELES END
+
 unsigned int CCoinsViewCache::GetCacheSize() const {
     return cacheCoins.size();
 }
@@ -6,6 +6,7 @@
 #ifndef BITCOIN_COINS_H
 #define BITCOIN_COINS_H
 
+#include <arenamap.h> // VELES
 #include <primitives/transaction.h>
 #include <compressor.h>
 #include <core_memusage.h>
@@ -17,8 +18,6 @@
 #include <assert.h>
 #include <stdint.h>
 
-#include <unordered_map>
-
 /**
  * A UTXO entry.
  *
@@ -85,7 +84,7 @@ class SaltedOutpointHasher
 {
 private:
     /** Salt */
-    const uint64_t k0, k1;
+    uint64_t k0, k1;
 
 public:
     SaltedOutpointHasher();
@@ -119,7 +118,7 @@ struct CCoinsCacheEntry
     explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+typedef arenamap<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap; // VELES
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -274,6 +273,15 @@ public:
      */
     void Uncache(const COutPoint &outpoint);
 
+    // VELES BEGIN
+    /**
+     * Add an unspent coin read from the backing view as an unmodified entry, unless the
+     * cache has an entry for outpoint already. The coin has to match the current state
+     * of the backing view.
+     */
+    bool AddUncachedCoin(const COutPoint& outpoint, Coin&& coin);
+    // VELES END
+
     //! Calculate the size of the cache (in number of transaction outputs)
     unsigned int GetCacheSize() const;
 
@@ -0,0 +1,255 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <coinsprefetch.h>
+
+#include <clientversion.h>
+#include <streams.h>
+#include <txdb.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <functional>
+#include <set>
+
+/** Number of coins a thread reads before handing out the next batch */
+static const size_t PREFETCH_BATCH_SIZE = 16;
+/** Maximum number of blocks scheduled and not connected yet */
+static const size_t MAX_SCHEDULED_JOBS = 2;
+
+CCoinsPrefetcher g_coins_prefetcher;
+
+/** The reads for one block, all members are guarded by CCoinsPrefetcher::cs */
+struct CCoinsPrefetcher::Job {
+    const uint256 hash;
+    const CCoinsViewDB* const pcoinsdb;
+    //! Write count of the database when the job was created
+    const uint64_t nWriteCount;
+    //! Position of the block on disk, for a scheduled job
+    CDiskBlockPos pos;
+    //! The block being connected waits for the job
+    bool fApplying = false;
+    bool fLoading = false;
+    bool fLoaded = false;
+    bool fFailed = false;
+    //! The outpoints to read, unchanged once loaded
+    std::vector<COutPoint> vOutpoints;
+    //! Next outpoint to hand out to a thread
+    size_t nNext = 0;
+    //! Number of outpoints read
+    size_t nDone = 0;
+    std::vector<std::pair<COutPoint, Coin>> vCoins;
+
+    Job(const uint256& hashIn, const CCoinsViewDB* pcoinsdbIn) :
+        hash(hashIn), pcoinsdb(pcoinsdbIn), nWriteCount(pcoinsdbIn->GetWriteCount()) {}
+
+    bool IsComplete() const { return fFailed || (fLoaded && nDone == vOutpoints.size()); }
+};
+
+/** The outpoints spent by block that are not created by the block itself */
+static void GetSpentOutpoints(const CBlock& block, std::vector<COutPoint>& vOutpoints)
+{
+    std::set<uint256> setTxids;
+    for (const CTransactionRef& tx : block.vtx) {
+        setTxids.insert(tx->GetHash());
+    }
+    for (const CTransactionRef& tx : block.vtx) {
+        if (tx->IsCoinBase()) continue;
+        for (const CTxIn& txin : tx->vin) {
+            if (!setTxids.count(txin.prevout.hash)) {
+                vOutpoints.push_back(txin.prevout);
+            }
+        }
+    }
+}
+
+/** Read the block at pos without checking its proof of work, the block is checked when it is connected */
+static bool ReadSpentOutpoints(const CDiskBlockPos& pos, const uint256& hash, std::vector<COutPoint>& vOutpoints)
+{
+    CBlock block;
+    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        return false;
+    }
+    try {
+        filein >> block;
+    } catch (const std::exception&) {
+        return false;
+    }
+    if (block.GetHash() != hash) {
+        return false;
+    }
+    GetSpentOutpoints(block, vOutpoints);
+    return true;
+}
+
+void CCoinsPrefetcher::ThreadPrefetch()
+{
+    WAIT_LOCK(cs, lock);
+    while (!fStop) {
+        std::shared_ptr<Job> job;
+        for (const std::shared_ptr<Job>& jobIter : deqJobs) {
+            if (jobIter->fFailed || jobIter->fLoading) continue;
+            if (!jobIter->fLoaded || jobIter->nNext < jobIter->vOutpoints.size()) {
+                job = jobIter;
+                break;
+            }
+        }
+        if (!job) {
+            cond.wait(lock);
+            continue;
+        }
+
+        if (!job->fLoaded) {
+            job->fLoading = true;
+            const CDiskBlockPos pos = job->pos;
+            std::vector<COutPoint> vOutpoints;
+            lock.unlock();
+            bool fRead = ReadSpentOutpoints(pos, job->hash, vOutpoints);
+            lock.lock();
+            job->fLoading = false;
+            job->fLoaded = true;
+            job->fFailed = !fRead;
+            job->vOutpoints = std::move(vOutpoints);
+            cond.notify_all();
+            continue;
+        }
+
+        const size_t nBegin = job->nNext;
+        const size_t nEnd = std::min(nBegin + PREFETCH_BATCH_SIZE, job->vOutpoints.size());
+        job->nNext = nEnd;
+        std::vector<std::pair<COutPoint, Coin>> vCoins;
+        bool fRead = true;
+        lock.unlock();
+        try {
+            for (size_t i = nBegin; i < nEnd; ++i) {
+                Coin coin;
+                if (job->pcoinsdb->GetCoin(job->vOutpoints[i], coin)) {
+                    vCoins.emplace_back(job->vOutpoints[i], std::move(coin));
+                }
+            }
+        } catch (const std::exception& e) {
+            LogPrintf("%s: error reading coins of block %s: %s\n", __func__, job->hash.ToString(), e.what());
+            fRead = false;
+        }
+        lock.lock();
+        job->nDone += nEnd - nBegin;
+        if (!fRead) job->fFailed = true;
+        for (auto& coin : vCoins) {
+            job->vCoins.push_back(std::move(coin));
+        }
+        if (job->IsComplete()) {
+            cond.notify_all();
+        }
+    }
+}
+
+std::shared_ptr<CCoinsPrefetcher::Job> CCoinsPrefetcher::TakeJob(const uint256& hash)
+{
+    for (auto it = deqJobs.begin(); it != deqJobs.end(); ++it) {
+        if ((*it)->hash == hash) {
+            std::shared_ptr<Job> job = *it;
+            deqJobs.erase(it);
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+void CCoinsPrefetcher::Start(int nThreads)
+{
+    assert(vThreads.empty());
+    {
+        LOCK(cs);
+        fStop = false;
+    }
+    for (int i = 0; i < nThreads; ++i) {
+        vThreads.emplace_back(&TraceThread<std::function<void()>>, "coinsprefetch",
+                              std::bind(&CCoinsPrefetcher::ThreadPrefetch, this));
+    }
+}
+
+void CCoinsPrefetcher::Stop()
+{
+    {
+        LOCK(cs);
+        fStop = true;
+        for (const std::shared_ptr<Job>& job : deqJobs) {
+            job->fFailed = true;
+        }
+        deqJobs.clear();
+    }
+    cond.notify_all();
+    for (std::thread& thread : vThreads) {
+        thread.join();
+    }
+    vThreads.clear();
+}
+
+void CCoinsPrefetcher::Schedule(const CBlockIndex* pindex, const CCoinsViewDB* pcoinsdb)
+{
+    AssertLockHeld(cs_main);
+    if (vThreads.empty()) return;
+
+    LOCK(cs);
+    size_t nScheduled = 0;
+    for (const std::shared_ptr<Job>& job : deqJobs) {
+        if (job->hash == pindex->GetBlockHash()) return;
+        if (!job->fApplying) ++nScheduled;
+    }
+    if (nScheduled >= MAX_SCHEDULED_JOBS) {
+        // The oldest scheduled block was not connected, most likely it will not be
+        for (auto it = deqJobs.begin(); it != deqJobs.end(); ++it) {
+            if (!(*it)->fApplying) {
+                deqJobs.erase(it);
+                break;
+            }
+        }
+    }
+
+    std::shared_ptr<Job> job = std::make_shared<Job>(pindex->GetBlockHash(), pcoinsdb);
+    job->pos = pindex->GetBlockPos();
+    deqJobs.push_back(job);
+    cond.notify_one();
+}
+
+size_t CCoinsPrefetcher::Apply(const CBlock& block, const CCoinsViewDB* pcoinsdb, CCoinsViewCache& cache)
+{
+    if (vThreads.empty()) return 0;
+
+    const uint256 hash = block.GetHash();
+    WAIT_LOCK(cs, lock);
+    std::shared_ptr<Job> job = TakeJob(hash);
+    if (!job || job->pcoinsdb != pcoinsdb) {
+        // Nothing scheduled, read the coins missing from the cache now
+        job = std::make_shared<Job>(hash, pcoinsdb);
+        std::vector<COutPoint> vOutpoints;
+        GetSpentOutpoints(block, vOutpoints);
+        for (const COutPoint& outpoint : vOutpoints) {
+            if (!cache.HaveCoinInCache(outpoint)) {
+                job->vOutpoints.push_back(outpoint);
+            }
+        }
+        job->fLoaded = true;
+        if (job->vOutpoints.empty()) return 0;
+    }
+
+    // Readers take the block being connected before any scheduled one
+    job->fApplying = true;
+    deqJobs.push_front(job);
+    cond.notify_all();
+    cond.wait(lock, [&job]() { return job->IsComplete(); });
+    TakeJob(hash);
+
+    if (job->fFailed || job->nWriteCount != pcoinsdb->GetWriteCount()) {
+        return 0;
+    }
+    size_t nAdded = 0;
+    for (auto& coin : job->vCoins) {
+        if (cache.AddUncachedCoin(coin.first, std::move(coin.second))) {
+            ++nAdded;
+        }
+    }
+    return nAdded;
+}
@@ -0,0 +1,67 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef VELES_COINSPREFETCH_H
+#define VELES_COINSPREFETCH_H
+
+#include <chain.h>
+#include <coins.h>
+#include <primitives/block.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+
+class CCoinsViewDB;
+
+/** Default number of threads reading coins ahead of block validation, 0 disables the prefetch */
+static const int DEFAULT_COINS_PREFETCH_THREADS = 4;
+/** Maximum number of threads reading coins ahead of block validation */
+static const int MAX_COINS_PREFETCH_THREADS = 16;
+
+/**
+ * Reads the coins spent by a block from the coins database on a pool of threads, so the
+ * database misses of ConnectBlock are served in parallel instead of one at a time. A block
+ * can be scheduled while the previous one is validated, its coins are moved into the coins
+ * cache right before the block is connected. Reads are dropped when the database was written
+ * to since they were started, as they may no longer match the state the cache is based on.
+ */
+class CCoinsPrefetcher
+{
+private:
+    struct Job;
+
+    Mutex cs;
+    std::condition_variable cond;
+    //! Jobs in the order workers take them, the block being connected first
+    std::deque<std::shared_ptr<Job>> deqJobs GUARDED_BY(cs);
+    std::vector<std::thread> vThreads;
+    bool fStop GUARDED_BY(cs) = false;
+
+    void ThreadPrefetch();
+    std::shared_ptr<Job> TakeJob(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+public:
+    void Start(int nThreads);
+    void Stop();
+    bool IsRunning() const { return !vThreads.empty(); }
+
+    /** Start reading the coins spent by the block at pindex, which has its data on disk */
+    void Schedule(const CBlockIndex* pindex, const CCoinsViewDB* pcoinsdb);
+
+    /**
+     * Add the coins spent by block and present in pcoinsdb to the cache based on it, using the
+     * reads scheduled for the block or reading the inputs missing from the cache now. Returns
+     * the number of coins added.
+     */
+    size_t Apply(const CBlock& block, const CCoinsViewDB* pcoinsdb, CCoinsViewCache& cache);
+};
+
+extern CCoinsPrefetcher g_coins_prefetcher;
+
+#endif // VELES_COINSPREFETCH_H
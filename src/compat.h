@@ -93,6 +93,7 @@ typedef char* sockopt_arg_type;
 // __APPLE__ poll is broke https://github.com/bitcoin/bitcoin/pull/14336#issuecomment-437384408
 #if defined(__linux__)
 #define USE_POLL
+#define USE_EPOLL // VELES
 #endif
 
 bool static inline IsSelectableSocket(const SOCKET& s) {
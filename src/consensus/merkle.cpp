@@ -84,3 +84,27 @@ uint256 BlockWitnessMerkleRoot(const CBlock& block, bool* mutated)
     return ComputeMerkleRoot(std::move(leaves), mutated);
 }
 
+// VELES BEGIN
+std::vector<uint256> BlockCoinbaseMerkleBranch(const CBlock& block)
+{
+    std::vector<uint256> hashes;
+    hashes.resize(block.vtx.size());
+    for (size_t s = 0; s < block.vtx.size(); s++) {
+        hashes[s] = block.vtx[s]->GetHash();
+    }
+
+    // The coinbase stays on the left of every level, its sibling is the second entry
+    std::vector<uint256> branch;
+    while (hashes.size() > 1) {
+        branch.push_back(hashes[1]);
+        if (hashes.size() & 1) {
+            hashes.push_back(hashes.back());
+        }
+        for (size_t i = 0; i < hashes.size() / 2; i++) {
+            hashes[i] = Hash(hashes[2 * i].begin(), hashes[2 * i].end(), hashes[2 * i + 1].begin(), hashes[2 * i + 1].end());
+        }
+        hashes.resize(hashes.size() / 2);
+    }
+    return branch;
+}
+// VELES END
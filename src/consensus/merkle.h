@@ -26,4 +26,12 @@ uint256 BlockMerkleRoot(const CBlock& block, bool* mutated = nullptr);
  */
 uint256 BlockWitnessMerkleRoot(const CBlock& block, bool* mutated = nullptr);
 
+// VELES BEGIN
+/*
+ * Compute the Merkle branch of the coinbase transaction of a block, the hashes
+ * a miner combines with the coinbase txid to obtain the Merkle root.
+ */
+std::vector<uint256> BlockCoinbaseMerkleBranch(const CBlock& block);
+// VELES END
+
 #endif // BITCOIN_CONSENSUS_MERKLE_H
@@ -73,6 +73,11 @@ extern "C"{
 #define AES_BIG_ENDIAN   0
 #include <crypto/aes_helper.c>
 
+/* VELES BEGIN */
+/* see sph_echo.h */
+void (*sph_echo_big_compress_hw)(sph_echo_big_context *sc) = NULL;
+/* VELES END */
+
 #if SPH_ECHO_64
 
 #define DECL_STATE_SMALL   \
@@ -724,6 +729,13 @@ echo_big_compress(sph_echo_big_context *sc)
 {
 	DECL_STATE_BIG
 
+	/* VELES BEGIN */
+	if (sph_echo_big_compress_hw) {
+		sph_echo_big_compress_hw(sc);
+		return;
+	}
+	/* VELES END */
+
 	COMPRESS_BIG(sc);
 }
 
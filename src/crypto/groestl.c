@@ -2734,6 +2734,13 @@ static const sph_u32 T3dn[] = {
 
 #endif
 
+/* VELES BEGIN */
+/* see sph_groestl.h */
+void (*sph_groestl_big_compress_hw)(unsigned char *state,
+	const unsigned char *buf) = NULL;
+void (*sph_groestl_big_final_hw)(unsigned char *state) = NULL;
+/* VELES END */
+
 static void
 groestl_small_init(sph_groestl_small_context *sc, unsigned out_size)
 {
@@ -2931,7 +2938,13 @@ groestl_big_core(sph_groestl_big_context *sc, const void *data, size_t len)
 		data = (const unsigned char *)data + clen;
 		len -= clen;
 		if (ptr == sizeof sc->buf) {
-			COMPRESS_BIG;
+			/* VELES BEGIN */
+			if (sph_groestl_big_compress_hw) {
+				sph_groestl_big_compress_hw((unsigned char *)H, buf);
+			} else {
+				COMPRESS_BIG;
+			}
+			/* VELES END */
 #if SPH_64
 			sc->count ++;
 #else
@@ -2994,7 +3007,13 @@ groestl_big_close(sph_groestl_big_context *sc,
 #endif
 	groestl_big_core(sc, pad, pad_len);
 	READ_STATE_BIG(sc);
-	FINAL_BIG;
+	/* VELES BEGIN */
+	if (sph_groestl_big_final_hw) {
+		sph_groestl_big_final_hw((unsigned char *)H);
+	} else {
+		FINAL_BIG;
+	}
+	/* VELES END */
 #if SPH_GROESTL_64
 	for (u = 0; u < 8; u ++)
 		enc64e(pad + (u << 3), H[u + 8]);
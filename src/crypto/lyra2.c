@@ -44,6 +44,26 @@
 * @return 0 if the key is generated correctly; -1 if there is an error (usually due to lack of memory for allocation)
 */
 int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols) {
+	//Tries to allocate enough space for the whole memory matrix
+	void *scratchpad = malloc(LYRA2_SCRATCHPAD_SIZE(nRows, nCols));
+	if (scratchpad == NULL) {
+		return -1;
+	}
+
+	int result = LYRA2_sp(K, kLen, pwd, pwdlen, salt, saltlen, timeCost, nRows, nCols, scratchpad);
+
+	free(scratchpad);
+	return result;
+}
+
+/**
+* Same as LYRA2(), working in the caller provided scratchpad instead of allocating memory.
+*
+* @param scratchpad At least LYRA2_SCRATCHPAD_SIZE(nRows, nCols) bytes, aligned to 8 bytes
+*
+* @return 0
+*/
+int LYRA2_sp(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols, void *scratchpad) {
 
 	//============================= Basic variables ============================//
 	int64_t row = 2; //index of row to be processed
@@ -63,18 +83,13 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
 	const int64_t ROW_LEN_INT64 = BLOCK_LEN_INT64 * nCols;
 	const int64_t ROW_LEN_BYTES = ROW_LEN_INT64 * 8;
 
+	//The caller provided scratchpad holds the matrix, the row pointers and the sponge state
 	i = (int64_t)((int64_t)nRows * (int64_t)ROW_LEN_BYTES);
-	uint64_t *wholeMatrix = malloc(i);
-	if (wholeMatrix == NULL) {
-		return -1;
-	}
+	uint64_t *wholeMatrix = (uint64_t*)scratchpad;
 	memset(wholeMatrix, 0, i);
 
-	//Allocates pointers to each row of the matrix
-	uint64_t **memMatrix = malloc(nRows * sizeof(uint64_t*));
-	if (memMatrix == NULL) {
-		return -1;
-	}
+	//Places the pointers to each row of the matrix after it
+	uint64_t **memMatrix = (uint64_t**)((byte*)scratchpad + i);
 	//Places the pointers in the correct positions
 	uint64_t *ptrWord = wholeMatrix;
 	for (i = 0; i < nRows; i++) {
@@ -123,10 +138,7 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
 
 					  //======================= Initializing the Sponge State ====================//
 					  //Sponge state: 16 uint64_t, BLOCK_LEN_INT64 words of them for the bitrate (b) and the remainder for the capacity (c)
-	uint64_t *state = malloc(16 * sizeof(uint64_t));
-	if (state == NULL) {
-		return -1;
-	}
+	uint64_t *state = (uint64_t*)((byte*)memMatrix + nRows * sizeof(uint64_t*));
 	initState(state);
 	//==========================================================================/
 
@@ -200,14 +212,8 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
 	squeeze(state, K, kLen);
 	//==========================================================================/
 
-	//========================= Freeing the memory =============================//
-	free(memMatrix);
-	free(wholeMatrix);
-
-	//Wiping out the sponge's internal state before freeing it
+	//Wiping out the sponge's internal state, the scratchpad is reused by the caller
 	memset(state, 0, 16 * sizeof(uint64_t));
-	free(state);
-	//==========================================================================/
 
 	return 0;
 }
@@ -37,11 +37,15 @@ typedef unsigned char byte;
 #define BLOCK_LEN_BYTES (BLOCK_LEN_INT64 * 8)    //Block length, in bytes
 #endif
 
+//Memory required by LYRA2_sp(): the matrix, the pointers to its rows and the sponge state
+#define LYRA2_SCRATCHPAD_SIZE(nRows, nCols) ((nRows) * (nCols) * BLOCK_LEN_BYTES + (nRows) * sizeof(uint64_t*) + 16 * sizeof(uint64_t))
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 	int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols);
+	int LYRA2_sp(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols, void *scratchpad);
 
 #ifdef __cplusplus
 }
@@ -36,17 +36,26 @@
 #include <crypto/lyra2.h>
 
 void lyra2z_hash(const char* input, char* output)
+{
+	char scratchpad[LYRA2Z_SCRATCHPAD_SIZE];
+
+	lyra2z_hash_sp(input, output, scratchpad);
+}
+
+void lyra2z_hash_sp(const char* input, char* output, char* scratchpad)
 {
 	sph_blake256_context     ctx_blake;
 
 	uint32_t hashA[8], hashB[8];
 
+	// Align the sponge matrix to a cache line
+	void *matrix = (void*)(((uintptr_t)scratchpad + 63) & ~(uintptr_t)63);
+
 	sph_blake256_init(&ctx_blake);
 	sph_blake256(&ctx_blake, input, 80);
 	sph_blake256_close(&ctx_blake, hashA);
 
-	LYRA2(hashB, 32, hashA, 32, hashA, 32, 8, 8, 8);
+	LYRA2_sp(hashB, 32, hashA, 32, hashA, 32, 8, 8, 8, matrix);
 
 	memcpy(output, hashB, 32);
 }
-
@@ -1,11 +1,18 @@
 #ifndef ZCOIN_CRYPTO_LYRA2Z_H
 #define ZCOIN_CRYPTO_LYRA2Z_H
 
+#include <crypto/lyra2.h>
+
+// Memory used by lyra2z_hash_sp(), 8 x 8 sponge matrix plus room for cache line alignment
+#define LYRA2Z_SCRATCHPAD_SIZE (LYRA2_SCRATCHPAD_SIZE(8, 8) + 63)
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 	void lyra2z_hash(const char* input, char* output);
+	// Same as lyra2z_hash() in a caller provided scratchpad of LYRA2Z_SCRATCHPAD_SIZE bytes
+	void lyra2z_hash_sp(const char* input, char* output, char* scratchpad);
 
 #ifdef __cplusplus
 }
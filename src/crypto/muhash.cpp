@@ -0,0 +1,269 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crypto/muhash.h>
+
+#include <crypto/chacha20.h>
+#include <crypto/common.h>
+#include <crypto/sha256.h>
+
+#include <assert.h>
+#include <limits>
+#include <string.h>
+
+namespace {
+
+typedef Num3072::limb_t limb_t;
+typedef Num3072::double_limb_t double_limb_t;
+constexpr int LIMB_SIZE = Num3072::LIMB_SIZE;
+constexpr int LIMBS = Num3072::LIMBS;
+/** The modulus is 2^3072 - MAX_PRIME_DIFF, so 2^3072 is congruent to MAX_PRIME_DIFF */
+constexpr limb_t MAX_PRIME_DIFF = 1103717;
+
+/** Extract the lowest limb of [c0,c1,c2] into n, and shift the number right by one limb. */
+inline void extract3(limb_t& c0, limb_t& c1, limb_t& c2, limb_t& n)
+{
+    n = c0;
+    c0 = c1;
+    c1 = c2;
+    c2 = 0;
+}
+
+/** [c0,c1] = a * b */
+inline void mul(limb_t& c0, limb_t& c1, const limb_t& a, const limb_t& b)
+{
+    double_limb_t t = (double_limb_t)a * b;
+    c1 = t >> LIMB_SIZE;
+    c0 = t;
+}
+
+/** [c0,c1,c2] += n * [d0,d1,d2], where c2 is 0 initially */
+inline void mulnadd3(limb_t& c0, limb_t& c1, limb_t& c2, const limb_t& d0, const limb_t& d1, const limb_t& d2, const limb_t& n)
+{
+    double_limb_t t = (double_limb_t)d0 * n + c0;
+    c0 = t;
+    t >>= LIMB_SIZE;
+    t += (double_limb_t)d1 * n + c1;
+    c1 = t;
+    t >>= LIMB_SIZE;
+    c2 = t + d2 * n;
+}
+
+/** [c0,c1] *= n */
+inline void muln2(limb_t& c0, limb_t& c1, const limb_t& n)
+{
+    double_limb_t t = (double_limb_t)c0 * n;
+    c0 = t;
+    t >>= LIMB_SIZE;
+    t += (double_limb_t)c1 * n;
+    c1 = t;
+}
+
+/** [c0,c1,c2] += a * b */
+inline void muladd3(limb_t& c0, limb_t& c1, limb_t& c2, const limb_t& a, const limb_t& b)
+{
+    double_limb_t t = (double_limb_t)a * b;
+    limb_t th = t >> LIMB_SIZE;
+    limb_t tl = t;
+
+    c0 += tl;
+    th += (c0 < tl) ? 1 : 0;
+    c1 += th;
+    c2 += (c1 < th) ? 1 : 0;
+}
+
+/** [c0,c1] += a, then extract the lowest limb of [c0,c1] into n and shift the number right by one limb. */
+inline void addnextract2(limb_t& c0, limb_t& c1, const limb_t& a, limb_t& n)
+{
+    limb_t c2 = 0;
+    c0 += a;
+    if (c0 < a) {
+        c1 += 1;
+        if (c1 == 0) c2 = 1;
+    }
+    n = c0;
+    c0 = c1;
+    c1 = c2;
+}
+
+/** in_out = in_out^(2^sq) * mul */
+inline void square_n_mul(Num3072& in_out, const int sq, const Num3072& mul)
+{
+    for (int j = 0; j < sq; ++j) in_out.Multiply(in_out);
+    in_out.Multiply(mul);
+}
+
+} // namespace
+
+Num3072::Num3072(const unsigned char (&data)[BYTE_SIZE])
+{
+    for (int i = 0; i < LIMBS; ++i) {
+        if (sizeof(limb_t) == 4) {
+            limbs[i] = ReadLE32(data + 4 * i);
+        } else {
+            limbs[i] = ReadLE64(data + 8 * i);
+        }
+    }
+}
+
+void Num3072::SetToOne()
+{
+    limbs[0] = 1;
+    for (int i = 1; i < LIMBS; ++i) limbs[i] = 0;
+}
+
+/** Whether the number is not smaller than the modulus */
+bool Num3072::IsOverflow() const
+{
+    if (limbs[0] <= std::numeric_limits<limb_t>::max() - MAX_PRIME_DIFF) return false;
+    for (int i = 1; i < LIMBS; ++i) {
+        if (limbs[i] != std::numeric_limits<limb_t>::max()) return false;
+    }
+    return true;
+}
+
+/** Subtract the modulus, that is add MAX_PRIME_DIFF and drop the carry out of the top limb */
+void Num3072::FullReduce()
+{
+    limb_t c0 = MAX_PRIME_DIFF;
+    limb_t c1 = 0;
+    for (int i = 0; i < LIMBS; ++i) {
+        addnextract2(c0, c1, limbs[i], limbs[i]);
+    }
+}
+
+void Num3072::Multiply(const Num3072& a)
+{
+    limb_t c0 = 0, c1 = 0, c2 = 0;
+    Num3072 tmp;
+
+    // Limbs 0..LIMBS-2 of the product, with the limbs above LIMBS folded in by multiplying them with MAX_PRIME_DIFF
+    for (int j = 0; j < LIMBS - 1; ++j) {
+        limb_t d0 = 0, d1 = 0, d2 = 0;
+        mul(d0, d1, limbs[1 + j], a.limbs[LIMBS + j - (1 + j)]);
+        for (int i = 2 + j; i < LIMBS; ++i) muladd3(d0, d1, d2, limbs[i], a.limbs[LIMBS + j - i]);
+        mulnadd3(c0, c1, c2, d0, d1, d2, MAX_PRIME_DIFF);
+        for (int i = 0; i < j + 1; ++i) muladd3(c0, c1, c2, limbs[i], a.limbs[j - i]);
+        extract3(c0, c1, c2, tmp.limbs[j]);
+    }
+
+    // Limb LIMBS-1 of the product, which has nothing above it to fold in
+    assert(c2 == 0);
+    for (int i = 0; i < LIMBS; ++i) muladd3(c0, c1, c2, limbs[i], a.limbs[LIMBS - 1 - i]);
+    extract3(c0, c1, c2, tmp.limbs[LIMBS - 1]);
+
+    // Fold the carry out of the top limb in as well
+    muln2(c0, c1, MAX_PRIME_DIFF);
+    for (int j = 0; j < LIMBS; ++j) {
+        addnextract2(c0, c1, tmp.limbs[j], limbs[j]);
+    }
+
+    assert(c1 == 0);
+    assert(c0 == 0 || c0 == 1);
+
+    // At most two more subtractions of the modulus bring the result below it
+    if (IsOverflow()) FullReduce();
+    if (c0) FullReduce();
+}
+
+Num3072 Num3072::GetInverse() const
+{
+    // Raise to the power of the modulus minus 2, which is 3051 one bits followed
+    // by the 21 bits of INV_EXP_TAIL. The ones use an addition chain of repunits,
+    // p[i] = this^(2^(2^i)-1).
+    static constexpr int INV_EXP_TAIL_BITS = 21;
+    static constexpr uint32_t INV_EXP_TAIL = (1 << INV_EXP_TAIL_BITS) - 1 - (MAX_PRIME_DIFF + 1);
+
+    Num3072 p[12];
+    p[0] = *this;
+    for (int i = 0; i < 11; ++i) {
+        p[i + 1] = p[i];
+        for (int j = 0; j < (1 << i); ++j) p[i + 1].Multiply(p[i + 1]);
+        p[i + 1].Multiply(p[i]);
+    }
+
+    // 3051 = 2048 + 512 + 256 + 128 + 64 + 32 + 8 + 2 + 1
+    Num3072 out = p[11];
+    square_n_mul(out, 512, p[9]);
+    square_n_mul(out, 256, p[8]);
+    square_n_mul(out, 128, p[7]);
+    square_n_mul(out, 64, p[6]);
+    square_n_mul(out, 32, p[5]);
+    square_n_mul(out, 8, p[3]);
+    square_n_mul(out, 2, p[1]);
+    square_n_mul(out, 1, p[0]);
+
+    for (int i = INV_EXP_TAIL_BITS - 1; i >= 0; --i) {
+        out.Multiply(out);
+        if ((INV_EXP_TAIL >> i) & 1) out.Multiply(*this);
+    }
+    return out;
+}
+
+void Num3072::Divide(const Num3072& a)
+{
+    Multiply(a.GetInverse());
+}
+
+void Num3072::ToBytes(unsigned char (&out)[BYTE_SIZE]) const
+{
+    Num3072 reduced = *this;
+    if (reduced.IsOverflow()) reduced.FullReduce();
+    for (int i = 0; i < LIMBS; ++i) {
+        if (sizeof(limb_t) == 4) {
+            WriteLE32(out + 4 * i, reduced.limbs[i]);
+        } else {
+            WriteLE64(out + 8 * i, reduced.limbs[i]);
+        }
+    }
+}
+
+Num3072 MuHash3072::ToNum3072(const std::vector<unsigned char>& in)
+{
+    unsigned char key[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(in.data(), in.size()).Finalize(key);
+    unsigned char data[Num3072::BYTE_SIZE];
+    ChaCha20(key, sizeof(key)).Output(data, sizeof(data));
+    return Num3072(data);
+}
+
+MuHash3072::MuHash3072(const std::vector<unsigned char>& in) : m_numerator(ToNum3072(in))
+{
+}
+
+MuHash3072& MuHash3072::Insert(const std::vector<unsigned char>& in)
+{
+    m_numerator.Multiply(ToNum3072(in));
+    return *this;
+}
+
+MuHash3072& MuHash3072::Remove(const std::vector<unsigned char>& in)
+{
+    m_denominator.Multiply(ToNum3072(in));
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator*=(const MuHash3072& mul)
+{
+    m_numerator.Multiply(mul.m_numerator);
+    m_denominator.Multiply(mul.m_denominator);
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator/=(const MuHash3072& div)
+{
+    m_numerator.Multiply(div.m_denominator);
+    m_denominator.Multiply(div.m_numerator);
+    return *this;
+}
+
+void MuHash3072::Finalize(uint256& out)
+{
+    m_numerator.Divide(m_denominator);
+    m_denominator.SetToOne();
+
+    unsigned char data[Num3072::BYTE_SIZE];
+    m_numerator.ToBytes(data);
+    CSHA256().Write(data, sizeof(data)).Finalize(out.begin());
+}
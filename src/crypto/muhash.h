@@ -0,0 +1,105 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef VELES_CRYPTO_MUHASH_H
+#define VELES_CRYPTO_MUHASH_H
+
+#include <serialize.h>
+#include <uint256.h>
+
+#include <stdint.h>
+#include <vector>
+
+/** A number modulo 2^3072 - 1103717, the largest 3072-bit safe prime. */
+class Num3072
+{
+private:
+    void FullReduce();
+    bool IsOverflow() const;
+    Num3072 GetInverse() const;
+
+public:
+    static constexpr size_t BYTE_SIZE = 384;
+
+#ifdef __SIZEOF_INT128__
+    typedef unsigned __int128 double_limb_t;
+    typedef uint64_t limb_t;
+    static constexpr int LIMBS = 48;
+    static constexpr int LIMB_SIZE = 64;
+#else
+    typedef uint64_t double_limb_t;
+    typedef uint32_t limb_t;
+    static constexpr int LIMBS = 96;
+    static constexpr int LIMB_SIZE = 32;
+#endif
+    limb_t limbs[LIMBS];
+
+    //! Constructs the number 1
+    Num3072() { SetToOne(); }
+    //! Constructs the number from BYTE_SIZE little-endian bytes, which may exceed the modulus
+    explicit Num3072(const unsigned char (&data)[BYTE_SIZE]);
+
+    void SetToOne();
+    void Multiply(const Num3072& a);
+    void Divide(const Num3072& a);
+    //! Writes the number, reduced modulo the prime, as BYTE_SIZE little-endian bytes
+    void ToBytes(unsigned char (&out)[BYTE_SIZE]) const;
+};
+
+/**
+ * A hash of a set of byte strings that can be updated as strings are added and
+ * removed, in any order. Each string is hashed to a number modulo a 3072-bit
+ * prime with SHA256 and ChaCha20, the set hash is the product of the numbers of
+ * the added strings divided by the product of those of the removed ones, which
+ * are kept apart so that removing costs no inversion until Finalize.
+ *
+ * The same string must not be added twice without being removed in between,
+ * as the set hash of a multiset is not what users of a set hash expect.
+ */
+class MuHash3072
+{
+private:
+    Num3072 m_numerator;
+    Num3072 m_denominator;
+
+    static Num3072 ToNum3072(const std::vector<unsigned char>& in);
+
+public:
+    /** Hash of the empty set */
+    MuHash3072() {}
+    /** Hash of the set holding just in */
+    explicit MuHash3072(const std::vector<unsigned char>& in);
+
+    MuHash3072& Insert(const std::vector<unsigned char>& in);
+    MuHash3072& Remove(const std::vector<unsigned char>& in);
+
+    /** Add, resp. remove, all elements of another set */
+    MuHash3072& operator*=(const MuHash3072& mul);
+    MuHash3072& operator/=(const MuHash3072& div);
+
+    /** Write the 256-bit hash of the set to out. This does the inversion, the set can still be updated after. */
+    void Finalize(uint256& out);
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        unsigned char data[Num3072::BYTE_SIZE];
+        m_numerator.ToBytes(data);
+        s.write((const char*)data, sizeof(data));
+        m_denominator.ToBytes(data);
+        s.write((const char*)data, sizeof(data));
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        unsigned char data[Num3072::BYTE_SIZE];
+        s.read((char*)data, sizeof(data));
+        m_numerator = Num3072(data);
+        s.read((char*)data, sizeof(data));
+        m_denominator = Num3072(data);
+    }
+};
+
+#endif // VELES_CRYPTO_MUHASH_H
@@ -35,6 +35,20 @@
 #include <string.h>
 #include <openssl/sha.h>
 
+// VELES BEGIN
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
+
+namespace scrypt_avx2
+{
+void ROMix_8way(uint32_t* X, void* scratchpad);
+}
+
+// Set by scrypt_detect(), the batch entry point hashes one input at a time while unset
+static void (*ROMix_8way)(uint32_t* X, void* scratchpad) = nullptr;
+// VELES END
+
 #if defined(USE_SSE2) && !defined(USE_SSE2_ALWAYS)
 #ifdef _MSC_VER
 // MSVC 64bit is unable to use inline asm
@@ -331,3 +345,84 @@ void scrypt_1024_1_1_256(const char *input, char *output)
 	char scratchpad[SCRYPT_SCRATCHPAD_SIZE];
     scrypt_1024_1_1_256_sp(input, output, scratchpad);
 }
+
+// VELES BEGIN
+void scrypt_1024_1_1_256_batch(const char *const inputs[], char *const outputs[], size_t nCount)
+{
+	if (ROMix_8way && nCount >= 8) {
+		char *scratchpad = (char *)malloc(SCRYPT_8WAY_SCRATCHPAD_SIZE);
+		if (scratchpad) {
+			scrypt_1024_1_1_256_batch_sp(inputs, outputs, nCount, scratchpad);
+			free(scratchpad);
+			return;
+		}
+	}
+
+	for (size_t n = 0; n < nCount; n++)
+		scrypt_1024_1_1_256(inputs[n], outputs[n]);
+}
+
+void scrypt_1024_1_1_256_batch_sp(const char *const inputs[], char *const outputs[], size_t nCount, char *scratchpad)
+{
+	size_t n = 0;
+
+	if (ROMix_8way) {
+		uint8_t B[8][128];
+		uint32_t X[32 * 8];
+		for (; n + 8 <= nCount; n += 8) {
+			for (int l = 0; l < 8; l++) {
+				PBKDF2_SHA256((const uint8_t *)inputs[n + l], 80, (const uint8_t *)inputs[n + l], 80, 1, B[l], 128);
+				for (int k = 0; k < 32; k++)
+					X[8 * k + l] = le32dec(&B[l][4 * k]);
+			}
+			ROMix_8way(X, scratchpad);
+			for (int l = 0; l < 8; l++) {
+				for (int k = 0; k < 32; k++)
+					le32enc(&B[l][4 * k], X[8 * k + l]);
+				PBKDF2_SHA256((const uint8_t *)inputs[n + l], 80, B[l], 128, 1, (uint8_t *)outputs[n + l], 32);
+			}
+		}
+	}
+
+	for (; n < nCount; n++)
+		scrypt_1024_1_1_256_sp(inputs[n], outputs[n], scratchpad);
+}
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+/** Check whether the OS has enabled AVX registers. */
+static bool ScryptAVXEnabled()
+{
+	uint32_t a, d;
+	__asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+	return (a & 6) == 6;
+}
+#endif
+
+std::string scrypt_detect()
+{
+	std::string ret = "generic";
+	ROMix_8way = nullptr;
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+	uint32_t eax, ebx, ecx, edx;
+	bool have_avx2 = false;
+	bool enabled_avx = false;
+
+	__cpuid_count(1, 0, eax, ebx, ecx, edx);
+	if (((ecx >> 27) & 1) && ((ecx >> 28) & 1)) {
+		enabled_avx = ScryptAVXEnabled();
+		__cpuid_count(7, 0, eax, ebx, ecx, edx);
+		have_avx2 = (ebx >> 5) & 1;
+	}
+	(void)have_avx2;
+	(void)enabled_avx;
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+	if (have_avx2 && enabled_avx) {
+		ROMix_8way = scrypt_avx2::ROMix_8way;
+		ret += ",avx2(8way)";
+	}
+#endif
+#endif
+	return ret;
+}
+// VELES END
@@ -3,12 +3,28 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+// VELES BEGIN
+#include <string>
+// VELES END
 
 static const int SCRYPT_SCRATCHPAD_SIZE = 131072 + 63;
 
 void scrypt_1024_1_1_256(const char *input, char *output);
 void scrypt_1024_1_1_256_sp_generic(const char *input, char *output, char *scratchpad);
 
+// VELES BEGIN
+/** Scratchpad of the 8-way ROMix, eight interleaved 128 KiB rows plus alignment */
+static const size_t SCRYPT_8WAY_SCRATCHPAD_SIZE = 8 * 131072 + 63;
+
+/** Hash nCount 80 byte inputs, eight at a time with the multi-buffer kernel picked by scrypt_detect() */
+void scrypt_1024_1_1_256_batch(const char *const inputs[], char *const outputs[], size_t nCount);
+/** Same as scrypt_1024_1_1_256_batch() in a caller provided scratchpad of SCRYPT_8WAY_SCRATCHPAD_SIZE bytes */
+void scrypt_1024_1_1_256_batch_sp(const char *const inputs[], char *const outputs[], size_t nCount, char *scratchpad);
+
+/** Select the scrypt kernels supported by this CPU and return a description of the choice */
+std::string scrypt_detect();
+// VELES END
+
 #if defined(USE_SSE2)
 #include <string>
 #if defined(_M_X64) || defined(__x86_64__) || defined(_M_AMD64) || (defined(MAC_OSX) && defined(__i386__))
@@ -0,0 +1,86 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <crypto/scrypt.h>
+
+// 8-way scrypt(N=1024, r=1, p=1) ROMix. The state is word sliced, X[k] holds
+// word k of all eight lanes, so salsa20/8 runs on eight hashes at once. The
+// scratchpad is interleaved the same way, one row of every lane per 1 KiB.
+
+namespace scrypt_avx2 {
+namespace {
+
+__m256i inline Add(__m256i x, __m256i y) { return _mm256_add_epi32(x, y); }
+__m256i inline Xor(__m256i x, __m256i y) { return _mm256_xor_si256(x, y); }
+__m256i inline RotL(__m256i x, int n) { return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n)); }
+
+#define QUARTER(a, b, c, d) \
+    x[b] = Xor(x[b], RotL(Add(x[a], x[d]), 7)); \
+    x[c] = Xor(x[c], RotL(Add(x[b], x[a]), 9)); \
+    x[d] = Xor(x[d], RotL(Add(x[c], x[b]), 13)); \
+    x[a] = Xor(x[a], RotL(Add(x[d], x[c]), 18));
+
+void inline __attribute__((always_inline)) XorSalsa8(__m256i B[16], const __m256i Bx[16])
+{
+    __m256i x[16];
+    for (int i = 0; i < 16; i++)
+        x[i] = B[i] = Xor(B[i], Bx[i]);
+    for (int i = 0; i < 8; i += 2) {
+        /* Operate on columns. */
+        QUARTER( 0,  4,  8, 12);
+        QUARTER( 5,  9, 13,  1);
+        QUARTER(10, 14,  2,  6);
+        QUARTER(15,  3,  7, 11);
+        /* Operate on rows. */
+        QUARTER( 0,  1,  2,  3);
+        QUARTER( 5,  6,  7,  4);
+        QUARTER(10, 11,  8,  9);
+        QUARTER(15, 12, 13, 14);
+    }
+    for (int i = 0; i < 16; i++)
+        B[i] = Add(B[i], x[i]);
+}
+
+#undef QUARTER
+
+}
+
+void ROMix_8way(uint32_t* X, void* scratchpad)
+{
+    __m256i* V = (__m256i*)(((uintptr_t)(scratchpad) + 63) & ~(uintptr_t)(63));
+    __m256i S[32];
+
+    for (int k = 0; k < 32; k++)
+        S[k] = _mm256_loadu_si256((const __m256i*)(X + 8 * k));
+
+    for (int i = 0; i < 1024; i++) {
+        for (int k = 0; k < 32; k++)
+            _mm256_store_si256(&V[i * 32 + k], S[k]);
+        XorSalsa8(&S[0], &S[16]);
+        XorSalsa8(&S[16], &S[0]);
+    }
+
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i mask = _mm256_set1_epi32(1023);
+    for (int i = 0; i < 1024; i++) {
+        // Word k of row j of a lane lives at 256 * j + 8 * k + lane
+        __m256i idx = Add(_mm256_slli_epi32(_mm256_and_si256(S[16], mask), 8), lanes);
+        for (int k = 0; k < 32; k++)
+            S[k] = Xor(S[k], _mm256_i32gather_epi32((const int*)V, Add(idx, _mm256_set1_epi32(8 * k)), 4));
+        XorSalsa8(&S[0], &S[16]);
+        XorSalsa8(&S[16], &S[0]);
+    }
+
+    for (int k = 0; k < 32; k++)
+        _mm256_storeu_si256((__m256i*)(X + 8 * k), S[k]);
+}
+
+}
+
+#endif
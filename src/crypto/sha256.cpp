@@ -22,11 +22,19 @@ void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks);
 namespace sha256d64_sse41
 {
 void Transform_4way(unsigned char* out, const unsigned char* in);
+// VELES BEGIN
+void TransformD80_4way(unsigned char* out, const uint32_t* midstate, const unsigned char* tails);
+void TransformDN_4way(unsigned char* out, const unsigned char* in, size_t len);
+// VELES END
 }
 
 namespace sha256d64_avx2
 {
 void Transform_8way(unsigned char* out, const unsigned char* in);
+// VELES BEGIN
+void TransformD80_8way(unsigned char* out, const uint32_t* midstate, const unsigned char* tails);
+void TransformDN_8way(unsigned char* out, const unsigned char* in, size_t len);
+// VELES END
 }
 
 namespace sha256d64_shani
@@ -462,6 +470,47 @@ TransformD64Type TransformD64_2way = nullptr;
 TransformD64Type TransformD64_4way = nullptr;
 TransformD64Type TransformD64_8way = nullptr;
 
+// VELES BEGIN
+typedef void (*TransformD80Type)(unsigned char*, const uint32_t*, const unsigned char*);
+
+/** Double SHA256 of one 80 byte blob from the midstate of its first 64 bytes, with the best 1-way Transform */
+void TransformD80(unsigned char* out, const uint32_t* midstate, const unsigned char* tail)
+{
+    unsigned char buffer[64] = {0};
+    uint32_t s[8];
+    std::copy(midstate, midstate + 8, s);
+    memcpy(buffer, tail, 16);
+    buffer[16] = 0x80;
+    WriteBE64(buffer + 56, 80 << 3);
+    Transform(s, buffer, 1);
+
+    memset(buffer, 0, sizeof(buffer));
+    for (int i = 0; i < 8; i++)
+        WriteBE32(buffer + 4 * i, s[i]);
+    buffer[32] = 0x80;
+    WriteBE64(buffer + 56, 32 << 3);
+    sha256::Initialize(s);
+    Transform(s, buffer, 1);
+    for (int i = 0; i < 8; i++)
+        WriteBE32(out + 4 * i, s[i]);
+}
+
+TransformD80Type TransformD80_4way = nullptr;
+TransformD80Type TransformD80_8way = nullptr;
+
+typedef void (*TransformDNType)(unsigned char*, const unsigned char*, size_t);
+
+/** Double SHA256 of one len byte blob, with the best 1-way Transform */
+void TransformDN(unsigned char* out, const unsigned char* in, size_t len)
+{
+    CSHA256().Write(in, len).Finalize(out);
+    CSHA256().Write(out, 32).Finalize(out);
+}
+
+TransformDNType TransformDN_4way = nullptr;
+TransformDNType TransformDN_8way = nullptr;
+// VELES END
+
 bool SelfTest() {
     // Input state (equal to the initial SHA256 state)
     static const uint32_t init[8] = {
@@ -544,6 +593,52 @@ bool SelfTest() {
         if (!std::equal(out, out + 256, result_d64)) return false;
     }
 
+    // VELES BEGIN
+    // Test TransformD80 on the first 80 input bytes, against the double SHA256 of the tested Transform()
+    uint32_t midstate[8];
+    std::copy(result[1], result[1] + 8, midstate);
+    unsigned char out_d80[32];
+    {
+        CSHA256 sha;
+        sha.Write(data + 1, 80).Finalize(out);
+        sha.Reset().Write(out, 32).Finalize(out);
+    }
+    TransformD80(out_d80, midstate, data + 65);
+    if (!std::equal(out, out + 32, out_d80)) return false;
+
+    // Test TransformD80_4way and TransformD80_8way, if available, on tails at every 16 input bytes
+    unsigned char out_d80_1way[256];
+    for (int i = 0; i < 8; i++)
+        TransformD80(out_d80_1way + 32 * i, midstate, data + 65 + 16 * i);
+    if (TransformD80_4way) {
+        unsigned char out[128];
+        TransformD80_4way(out, midstate, data + 65);
+        if (!std::equal(out, out + 128, out_d80_1way)) return false;
+    }
+    if (TransformD80_8way) {
+        unsigned char out[256];
+        TransformD80_8way(out, midstate, data + 65);
+        if (!std::equal(out, out + 256, out_d80_1way)) return false;
+    }
+
+    // Test TransformDN_4way and TransformDN_8way, if available, on blobs of one and two blocks
+    for (size_t len : {55, 56, 80}) {
+        unsigned char out_dn_1way[256];
+        for (int i = 0; i < 8; i++)
+            TransformDN(out_dn_1way + 32 * i, data + 1 + len * i, len);
+        if (TransformDN_4way) {
+            unsigned char out[128];
+            TransformDN_4way(out, data + 1, len);
+            if (!std::equal(out, out + 128, out_dn_1way)) return false;
+        }
+        if (TransformDN_8way) {
+            unsigned char out[256];
+            TransformDN_8way(out, data + 1, len);
+            if (!std::equal(out, out + 256, out_dn_1way)) return false;
+        }
+    }
+    // VELES END
+
     return true;
 }
 
@@ -622,6 +717,10 @@ std::string SHA256AutoDetect()
 #endif
 #if defined(ENABLE_SSE41) && !defined(BUILD_BITCOIN_INTERNAL)
         TransformD64_4way = sha256d64_sse41::Transform_4way;
+        // VELES BEGIN
+        TransformD80_4way = sha256d64_sse41::TransformD80_4way;
+        TransformDN_4way = sha256d64_sse41::TransformDN_4way;
+        // VELES END
         ret += ",sse41(4way)";
 #endif
     }
@@ -629,6 +728,10 @@ std::string SHA256AutoDetect()
 #if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
     if (have_avx2 && have_avx && enabled_avx) {
         TransformD64_8way = sha256d64_avx2::Transform_8way;
+        // VELES BEGIN
+        TransformD80_8way = sha256d64_avx2::TransformD80_8way;
+        TransformDN_8way = sha256d64_avx2::TransformDN_8way;
+        // VELES END
         ret += ",avx2(8way)";
     }
 #endif
@@ -728,3 +831,63 @@ void SHA256D64(unsigned char* out, const unsigned char* in, size_t blocks)
         --blocks;
     }
 }
+
+// VELES BEGIN
+void SHA256Midstate(uint32_t midstate[8], const unsigned char* data)
+{
+    sha256::Initialize(midstate);
+    Transform(midstate, data, 1);
+}
+
+void SHA256D80(unsigned char* out, const uint32_t midstate[8], const unsigned char* tails, size_t blocks)
+{
+    if (TransformD80_8way) {
+        while (blocks >= 8) {
+            TransformD80_8way(out, midstate, tails);
+            out += 256;
+            tails += 128;
+            blocks -= 8;
+        }
+    }
+    if (TransformD80_4way) {
+        while (blocks >= 4) {
+            TransformD80_4way(out, midstate, tails);
+            out += 128;
+            tails += 64;
+            blocks -= 4;
+        }
+    }
+    while (blocks) {
+        TransformD80(out, midstate, tails);
+        out += 32;
+        tails += 16;
+        --blocks;
+    }
+}
+
+void SHA256DN(unsigned char* out, const unsigned char* in, size_t len, size_t blocks)
+{
+    if (TransformDN_8way) {
+        while (blocks >= 8) {
+            TransformDN_8way(out, in, len);
+            out += 256;
+            in += 8 * len;
+            blocks -= 8;
+        }
+    }
+    if (TransformDN_4way) {
+        while (blocks >= 4) {
+            TransformDN_4way(out, in, len);
+            out += 128;
+            in += 4 * len;
+            blocks -= 4;
+        }
+    }
+    while (blocks) {
+        TransformDN(out, in, len);
+        out += 32;
+        in += len;
+        --blocks;
+    }
+}
+// VELES END
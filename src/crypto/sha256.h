@@ -38,4 +38,27 @@ std::string SHA256AutoDetect();
  */
 void SHA256D64(unsigned char* output, const unsigned char* input, size_t blocks);
 
+// VELES BEGIN
+/** Compute the SHA256 state after the first 64 bytes of data, the midstate of SHA256D80(). */
+void SHA256Midstate(uint32_t midstate[8], const unsigned char* data);
+
+/** Compute multiple double-SHA256's of 80-byte blobs that share their first 64 bytes,
+ *  like the headers of a block template with different nonces.
+ *  output:   pointer to a blocks*32 byte output buffer
+ *  midstate: SHA256Midstate() of the shared first 64 bytes
+ *  tails:    pointer to a blocks*16 byte buffer with the last 16 bytes of every blob
+ *  blocks:   the number of hashes to compute.
+ */
+void SHA256D80(unsigned char* output, const uint32_t midstate[8], const unsigned char* tails, size_t blocks);
+
+/** Compute multiple double-SHA256's of blobs of the same length, like the messages of the
+ *  masternode scores, with the multi-way implementations when available.
+ *  output: pointer to a blocks*32 byte output buffer
+ *  input:  pointer to a blocks*len byte input buffer
+ *  len:    the length in bytes of every blob
+ *  blocks: the number of hashes to compute.
+ */
+void SHA256DN(unsigned char* output, const unsigned char* input, size_t len, size_t blocks);
+// VELES END
+
 #endif // BITCOIN_CRYPTO_SHA256_H
@@ -2,6 +2,9 @@
 
 #include <stdint.h>
 #include <immintrin.h>
+#include <string.h> // VELES
+
+#include <algorithm> // VELES
 
 #include <crypto/sha256.h>
 #include <crypto/common.h>
@@ -320,6 +323,147 @@ void Transform_8way(unsigned char* out, const unsigned char* in)
     Write8(out, 28, Add(h, K(0x5be0cd19ul)));
 }
 
+
+// VELES BEGIN
+namespace {
+
+const uint32_t ROUND_CONSTANTS[64] = {
+    0x428a2f98ul, 0x71374491ul, 0xb5c0fbcful, 0xe9b5dba5ul, 0x3956c25bul, 0x59f111f1ul, 0x923f82a4ul, 0xab1c5ed5ul,
+    0xd807aa98ul, 0x12835b01ul, 0x243185beul, 0x550c7dc3ul, 0x72be5d74ul, 0x80deb1feul, 0x9bdc06a7ul, 0xc19bf174ul,
+    0xe49b69c1ul, 0xefbe4786ul, 0x0fc19dc6ul, 0x240ca1ccul, 0x2de92c6ful, 0x4a7484aaul, 0x5cb0a9dcul, 0x76f988daul,
+    0x983e5152ul, 0xa831c66dul, 0xb00327c8ul, 0xbf597fc7ul, 0xc6e00bf3ul, 0xd5a79147ul, 0x06ca6351ul, 0x14292967ul,
+    0x27b70a85ul, 0x2e1b2138ul, 0x4d2c6dfcul, 0x53380d13ul, 0x650a7354ul, 0x766a0abbul, 0x81c2c92eul, 0x92722c85ul,
+    0xa2bfe8a1ul, 0xa81a664bul, 0xc24b8b70ul, 0xc76c51a3ul, 0xd192e819ul, 0xd6990624ul, 0xf40e3585ul, 0x106aa070ul,
+    0x19a4c116ul, 0x1e376c08ul, 0x2748774cul, 0x34b0bcb5ul, 0x391c0cb3ul, 0x4ed8aa4aul, 0x5b9cca4ful, 0x682e6ff3ul,
+    0x748f82eeul, 0x78a5636ful, 0x84c87814ul, 0x8cc70208ul, 0x90befffaul, 0xa4506cebul, 0xbef9a3f7ul, 0xc67178f2ul,
+};
+
+const uint32_t INITIAL_STATE[8] = {
+    0x6a09e667ul, 0xbb67ae85ul, 0x3c6ef372ul, 0xa54ff53aul, 0x510e527ful, 0x9b05688cul, 0x1f83d9abul, 0x5be0cd19ul
+};
+
+/** Read the word at offset of each of the 8 16 byte tails into its lane */
+__m256i inline ReadTails(const unsigned char* tails, int offset) {
+    return _mm256_setr_epi32(ReadBE32(tails + 0 + offset), ReadBE32(tails + 16 + offset), ReadBE32(tails + 32 + offset), ReadBE32(tails + 48 + offset), ReadBE32(tails + 64 + offset), ReadBE32(tails + 80 + offset), ReadBE32(tails + 96 + offset), ReadBE32(tails + 112 + offset));
+}
+
+/** Extend the first 16 words of w to the whole message schedule */
+void inline Expand(__m256i* w)
+{
+    for (int i = 16; i < 64; i++)
+        w[i] = Add(sigma1(w[i - 2]), w[i - 7], sigma0(w[i - 15]), w[i - 16]);
+}
+
+/** The 64 rounds over the message schedule w, added to the state s */
+void inline Rounds(__m256i* s, const __m256i* w)
+{
+    __m256i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int i = 0; i < 64; i += 8) {
+        Round(a, b, c, d, e, f, g, h, Add(K(ROUND_CONSTANTS[i]), w[i]));
+        Round(h, a, b, c, d, e, f, g, Add(K(ROUND_CONSTANTS[i + 1]), w[i + 1]));
+        Round(g, h, a, b, c, d, e, f, Add(K(ROUND_CONSTANTS[i + 2]), w[i + 2]));
+        Round(f, g, h, a, b, c, d, e, Add(K(ROUND_CONSTANTS[i + 3]), w[i + 3]));
+        Round(e, f, g, h, a, b, c, d, Add(K(ROUND_CONSTANTS[i + 4]), w[i + 4]));
+        Round(d, e, f, g, h, a, b, c, Add(K(ROUND_CONSTANTS[i + 5]), w[i + 5]));
+        Round(c, d, e, f, g, h, a, b, Add(K(ROUND_CONSTANTS[i + 6]), w[i + 6]));
+        Round(b, c, d, e, f, g, h, a, Add(K(ROUND_CONSTANTS[i + 7]), w[i + 7]));
+    }
+    Inc(s[0], a); Inc(s[1], b); Inc(s[2], c); Inc(s[3], d);
+    Inc(s[4], e); Inc(s[5], f); Inc(s[6], g); Inc(s[7], h);
+}
+
+/** Read the words of block b of the padded message of each of the 8 len byte blobs into its lane */
+void inline ReadPadded(__m256i* w, const unsigned char* in, size_t len, size_t b)
+{
+    unsigned char buf[8][64];
+    const size_t pos = 64 * b;
+    const size_t n = pos < len ? std::min<size_t>(64, len - pos) : 0;
+    for (int l = 0; l < 8; l++) {
+        if (n) memcpy(buf[l], in + len * l + pos, n);
+        memset(buf[l] + n, 0, 64 - n);
+        if (len / 64 == b) buf[l][len % 64] = 0x80;
+        if ((len + 72) / 64 == b + 1) WriteBE64(buf[l] + 56, (uint64_t)len << 3);
+    }
+    for (int i = 0; i < 16; i++)
+        w[i] = _mm256_setr_epi32(ReadBE32(buf[0] + 4 * i), ReadBE32(buf[1] + 4 * i), ReadBE32(buf[2] + 4 * i), ReadBE32(buf[3] + 4 * i), ReadBE32(buf[4] + 4 * i), ReadBE32(buf[5] + 4 * i), ReadBE32(buf[6] + 4 * i), ReadBE32(buf[7] + 4 * i));
+}
+
+}
+
+void TransformD80_8way(unsigned char* out, const uint32_t* midstate, const unsigned char* tails)
+{
+    __m256i w[64];
+    __m256i s[8];
+
+    // Transform 1: the last 16 bytes of every header and the padding of 80 bytes, from the shared midstate
+    for (int i = 0; i < 4; i++)
+        w[i] = ReadTails(tails, 4 * i);
+    w[4] = K(0x80000000ul);
+    for (int i = 5; i < 15; i++)
+        w[i] = K(0);
+    w[15] = K(640);
+    Expand(w);
+    for (int i = 0; i < 8; i++)
+        s[i] = K(midstate[i]);
+    Rounds(s, w);
+
+    // Transform 2: the 32 byte hash and its padding
+    for (int i = 0; i < 8; i++)
+        w[i] = s[i];
+    w[8] = K(0x80000000ul);
+    for (int i = 9; i < 15; i++)
+        w[i] = K(0);
+    w[15] = K(256);
+    Expand(w);
+    for (int i = 0; i < 8; i++)
+        s[i] = K(INITIAL_STATE[i]);
+    Rounds(s, w);
+
+    // Output
+    uint32_t lanes[8];
+    for (int i = 0; i < 8; i++) {
+        _mm256_storeu_si256((__m256i*)lanes, s[i]);
+        for (int l = 0; l < 8; l++)
+            WriteBE32(out + 32 * l + 4 * i, lanes[l]);
+    }
+}
+
+void TransformDN_8way(unsigned char* out, const unsigned char* in, size_t len)
+{
+    __m256i w[64];
+    __m256i s[8];
+
+    // Transform 1: every block of the padded blobs, from the initial state
+    for (int i = 0; i < 8; i++)
+        s[i] = K(INITIAL_STATE[i]);
+    for (size_t b = 0; b < (len + 72) / 64; b++) {
+        ReadPadded(w, in, len, b);
+        Expand(w);
+        Rounds(s, w);
+    }
+
+    // Transform 2: the 32 byte hash and its padding
+    for (int i = 0; i < 8; i++)
+        w[i] = s[i];
+    w[8] = K(0x80000000ul);
+    for (int i = 9; i < 15; i++)
+        w[i] = K(0);
+    w[15] = K(256);
+    Expand(w);
+    for (int i = 0; i < 8; i++)
+        s[i] = K(INITIAL_STATE[i]);
+    Rounds(s, w);
+
+    // Output
+    uint32_t lanes[8];
+    for (int i = 0; i < 8; i++) {
+        _mm256_storeu_si256((__m256i*)lanes, s[i]);
+        for (int l = 0; l < 8; l++)
+            WriteBE32(out + 32 * l + 4 * i, lanes[l]);
+    }
+}
+// VELES END
+
 }
 
 #endif
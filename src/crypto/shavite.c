@@ -721,6 +721,12 @@ c256(sph_shavite_small_context *sc, const void *msg)
 
 #endif
 
+/* VELES BEGIN */
+/* see sph_shavite.h */
+void (*sph_shavite_big_compress_hw)(sph_shavite_big_context *sc,
+	const void *msg) = NULL;
+/* VELES END */
+
 #if SPH_SMALL_FOOTPRINT_SHAVITE
 
 /*
@@ -735,6 +741,13 @@ c512(sph_shavite_big_context *sc, const void *msg)
 	size_t u;
 	int r, s;
 
+	/* VELES BEGIN */
+	if (sph_shavite_big_compress_hw) {
+		sph_shavite_big_compress_hw(sc, msg);
+		return;
+	}
+	/* VELES END */
+
 #if SPH_LITTLE_ENDIAN
 	memcpy(rk, msg, 128);
 #else
@@ -909,6 +922,13 @@ c512(sph_shavite_big_context *sc, const void *msg)
 	sph_u32 rk18, rk19, rk1A, rk1B, rk1C, rk1D, rk1E, rk1F;
 	int r;
 
+	/* VELES BEGIN */
+	if (sph_shavite_big_compress_hw) {
+		sph_shavite_big_compress_hw(sc, msg);
+		return;
+	}
+	/* VELES END */
+
 	p0 = sc->h[0x0];
 	p1 = sc->h[0x1];
 	p2 = sc->h[0x2];
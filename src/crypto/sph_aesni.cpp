@@ -0,0 +1,313 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_AESNI
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <limits>
+
+#include <crypto/sph_echo.h>
+#include <crypto/sph_shavite.h>
+
+// ECHO-512, Groestl-512 and SHAvite-512 compression functions on the AES-NI
+// round instructions. They replace the table based rounds of the sph code
+// they hook into and work on the same contexts, so both can be mixed freely.
+
+namespace sph_aesni {
+namespace {
+
+__m128i inline Load(const void* p) { return _mm_loadu_si128((const __m128i*)p); }
+void inline Store(void* p, __m128i x) { _mm_storeu_si128((__m128i*)p, x); }
+__m128i inline Xor(__m128i x, __m128i y) { return _mm_xor_si128(x, y); }
+
+/** Multiplication by 2 in GF(2^8) modulo x^8 + x^4 + x^3 + x + 1, on every byte */
+__m128i inline XTime(__m128i x)
+{
+    const __m128i poly = _mm_set1_epi8(0x1b);
+    return Xor(_mm_add_epi8(x, x), _mm_and_si128(_mm_cmpgt_epi8(_mm_setzero_si128(), x), poly));
+}
+
+/** ECHO BigShiftRows and BigMixColumns on the sixteen 128-bit words */
+void inline __attribute__((always_inline)) EchoShiftMix(__m128i W[16])
+{
+    __m128i t;
+    t = W[1]; W[1] = W[5]; W[5] = W[9]; W[9] = W[13]; W[13] = t;
+    t = W[2]; W[2] = W[10]; W[10] = t;
+    t = W[6]; W[6] = W[14]; W[14] = t;
+    t = W[15]; W[15] = W[11]; W[11] = W[7]; W[7] = W[3]; W[3] = t;
+
+    for (int i = 0; i < 16; i += 4) {
+        const __m128i a = W[i], b = W[i + 1], c = W[i + 2], d = W[i + 3];
+        const __m128i ab = Xor(a, b), bc = Xor(b, c), cd = Xor(c, d);
+        const __m128i abx = XTime(ab), bcx = XTime(bc), cdx = XTime(cd);
+        W[i] = Xor(abx, Xor(bc, d));
+        W[i + 1] = Xor(bcx, Xor(a, cd));
+        W[i + 2] = Xor(cdx, Xor(ab, d));
+        W[i + 3] = Xor(Xor(abx, bcx), Xor(Xor(cdx, ab), c));
+    }
+}
+
+/**
+ * The ten rounds of ECHO-512. The salt is the 128-bit counter, incremented
+ * once per AES double round; CARRY selects the slow increment for the rare
+ * blocks where its low 64 bits wrap around.
+ */
+template <bool CARRY>
+void inline __attribute__((always_inline)) EchoRounds(__m128i W[16], uint64_t lo, uint64_t hi)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set_epi64x(0, 1);
+    __m128i K = _mm_set_epi64x(hi, lo);
+    for (int r = 0; r < 10; r++) {
+        for (int n = 0; n < 16; n++) {
+            W[n] = _mm_aesenc_si128(_mm_aesenc_si128(W[n], K), zero);
+            if (CARRY) {
+                if (++lo == 0) hi++;
+                K = _mm_set_epi64x(hi, lo);
+            } else {
+                K = _mm_add_epi64(K, one);
+            }
+        }
+        EchoShiftMix(W);
+    }
+}
+
+// Groestl-512 works on 8 rows of 16 bytes. The state in memory is column
+// major, so it is transposed to one register per row on the way in and back
+// on the way out.
+const __m128i TRANSPOSE_IN = _mm_set_epi8(15, 7, 14, 6, 13, 5, 12, 4, 11, 3, 10, 2, 9, 1, 8, 0);
+const __m128i TRANSPOSE_OUT = _mm_set_epi8(15, 13, 11, 9, 7, 5, 3, 1, 14, 12, 10, 8, 6, 4, 2, 0);
+
+/** 8x8 transpose of 16-bit words */
+void inline __attribute__((always_inline)) Transpose16(__m128i x[8])
+{
+    const __m128i t0 = _mm_unpacklo_epi16(x[0], x[1]), t1 = _mm_unpackhi_epi16(x[0], x[1]);
+    const __m128i t2 = _mm_unpacklo_epi16(x[2], x[3]), t3 = _mm_unpackhi_epi16(x[2], x[3]);
+    const __m128i t4 = _mm_unpacklo_epi16(x[4], x[5]), t5 = _mm_unpackhi_epi16(x[4], x[5]);
+    const __m128i t6 = _mm_unpacklo_epi16(x[6], x[7]), t7 = _mm_unpackhi_epi16(x[6], x[7]);
+    const __m128i u0 = _mm_unpacklo_epi32(t0, t2), u1 = _mm_unpackhi_epi32(t0, t2);
+    const __m128i u2 = _mm_unpacklo_epi32(t1, t3), u3 = _mm_unpackhi_epi32(t1, t3);
+    const __m128i u4 = _mm_unpacklo_epi32(t4, t6), u5 = _mm_unpackhi_epi32(t4, t6);
+    const __m128i u6 = _mm_unpacklo_epi32(t5, t7), u7 = _mm_unpackhi_epi32(t5, t7);
+    x[0] = _mm_unpacklo_epi64(u0, u4); x[1] = _mm_unpackhi_epi64(u0, u4);
+    x[2] = _mm_unpacklo_epi64(u1, u5); x[3] = _mm_unpackhi_epi64(u1, u5);
+    x[4] = _mm_unpacklo_epi64(u2, u6); x[5] = _mm_unpackhi_epi64(u2, u6);
+    x[6] = _mm_unpacklo_epi64(u3, u7); x[7] = _mm_unpackhi_epi64(u3, u7);
+}
+
+void inline __attribute__((always_inline)) LoadRows(__m128i x[8], const unsigned char* p)
+{
+    for (int i = 0; i < 8; i++)
+        x[i] = _mm_shuffle_epi8(Load(p + 16 * i), TRANSPOSE_IN);
+    Transpose16(x);
+}
+
+void inline __attribute__((always_inline)) StoreRows(unsigned char* p, __m128i x[8])
+{
+    Transpose16(x);
+    for (int i = 0; i < 8; i++)
+        Store(p + 16 * i, _mm_shuffle_epi8(x[i], TRANSPOSE_OUT));
+}
+
+// ShiftBytes rotates row i of P left by 0, 1, 2, 3, 4, 5, 6, 11 bytes and
+// row i of Q by 1, 3, 5, 11, 0, 2, 4, 6. AESENCLAST applies SubBytes and the
+// AES ShiftRows, so every row is first shuffled by the shift it needs composed
+// with the inverse of ShiftRows.
+alignas(16) const unsigned char SHIFT_P[8][16] = {
+    {0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03},
+    {0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04},
+    {0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05},
+    {0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06},
+    {0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07},
+    {0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08},
+    {0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09},
+    {0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e},
+};
+alignas(16) const unsigned char SHIFT_Q[8][16] = {
+    {0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04},
+    {0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06},
+    {0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08},
+    {0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e},
+    {0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03},
+    {0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05},
+    {0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07},
+    {0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09},
+};
+
+/** Column numbers in the high nibbles, the round constants without the round */
+const __m128i COLUMNS = _mm_set_epi8(0xf0, 0xe0, 0xd0, 0xc0, 0xb0, 0xa0, 0x90, 0x80, 0x70, 0x60, 0x50, 0x40, 0x30, 0x20, 0x10, 0x00);
+
+/** Row i of Groestl MixBytes from the rows a_i and their sums t_i = a_i ^ a_(i+1) */
+__m128i inline MixRow(__m128i t0, __m128i a2, __m128i a5, __m128i a7, __m128i t3, __m128i t4, __m128i t6)
+{
+    const __m128i x = Xor(a2, Xor(t4, t6));
+    const __m128i y = Xor(Xor(t0, a2), Xor(a5, a7));
+    const __m128i z = Xor(t3, t6);
+    return Xor(x, XTime(Xor(y, XTime(z))));
+}
+
+/** Groestl MixBytes, b_i = x_i ^ 2 (y_i ^ 2 z_i) with the indices of a taken modulo 8 */
+void inline __attribute__((always_inline)) MixBytes(__m128i a[8])
+{
+    const __m128i t0 = Xor(a[0], a[1]), t1 = Xor(a[1], a[2]), t2 = Xor(a[2], a[3]), t3 = Xor(a[3], a[4]);
+    const __m128i t4 = Xor(a[4], a[5]), t5 = Xor(a[5], a[6]), t6 = Xor(a[6], a[7]), t7 = Xor(a[7], a[0]);
+    const __m128i b0 = MixRow(t0, a[2], a[5], a[7], t3, t4, t6);
+    const __m128i b1 = MixRow(t1, a[3], a[6], a[0], t4, t5, t7);
+    const __m128i b2 = MixRow(t2, a[4], a[7], a[1], t5, t6, t0);
+    const __m128i b3 = MixRow(t3, a[5], a[0], a[2], t6, t7, t1);
+    const __m128i b4 = MixRow(t4, a[6], a[1], a[3], t7, t0, t2);
+    const __m128i b5 = MixRow(t5, a[7], a[2], a[4], t0, t1, t3);
+    const __m128i b6 = MixRow(t6, a[0], a[3], a[5], t1, t2, t4);
+    const __m128i b7 = MixRow(t7, a[1], a[4], a[6], t2, t3, t5);
+    a[0] = b0; a[1] = b1; a[2] = b2; a[3] = b3;
+    a[4] = b4; a[5] = b5; a[6] = b6; a[7] = b7;
+}
+
+__m128i inline SubShift(__m128i x, const unsigned char* shift)
+{
+    return _mm_aesenclast_si128(_mm_shuffle_epi8(x, _mm_load_si128((const __m128i*)shift)), _mm_setzero_si128());
+}
+
+void inline __attribute__((always_inline)) SubShiftBytes(__m128i a[8], const unsigned char (*shift)[16])
+{
+    a[0] = SubShift(a[0], shift[0]); a[1] = SubShift(a[1], shift[1]);
+    a[2] = SubShift(a[2], shift[2]); a[3] = SubShift(a[3], shift[3]);
+    a[4] = SubShift(a[4], shift[4]); a[5] = SubShift(a[5], shift[5]);
+    a[6] = SubShift(a[6], shift[6]); a[7] = SubShift(a[7], shift[7]);
+}
+
+void inline __attribute__((always_inline)) RoundP(__m128i a[8], int r)
+{
+    a[0] = Xor(a[0], Xor(COLUMNS, _mm_set1_epi8(r)));
+    SubShiftBytes(a, SHIFT_P);
+    MixBytes(a);
+}
+
+void inline __attribute__((always_inline)) RoundQ(__m128i a[8], int r)
+{
+    const __m128i ones = _mm_set1_epi8(-1);
+    a[0] = Xor(a[0], ones); a[1] = Xor(a[1], ones); a[2] = Xor(a[2], ones); a[3] = Xor(a[3], ones);
+    a[4] = Xor(a[4], ones); a[5] = Xor(a[5], ones); a[6] = Xor(a[6], ones);
+    a[7] = Xor(a[7], Xor(_mm_andnot_si128(COLUMNS, ones), _mm_set1_epi8(r)));
+    SubShiftBytes(a, SHIFT_Q);
+    MixBytes(a);
+}
+
+} // namespace
+
+void EchoBigCompress(sph_echo_big_context* sc)
+{
+    __m128i W[16];
+    for (int i = 0; i < 8; i++) {
+        W[i] = Load(sc->u.Vs[i]);
+        W[i + 8] = Load(sc->buf + 16 * i);
+    }
+
+    const uint64_t lo = (uint64_t)sc->C1 << 32 | sc->C0;
+    const uint64_t hi = (uint64_t)sc->C3 << 32 | sc->C2;
+    if (lo > std::numeric_limits<uint64_t>::max() - 160) {
+        EchoRounds<true>(W, lo, hi);
+    } else {
+        EchoRounds<false>(W, lo, hi);
+    }
+
+    for (int i = 0; i < 8; i++)
+        Store(sc->u.Vs[i], Xor(Load(sc->u.Vs[i]), Xor(Load(sc->buf + 16 * i), Xor(W[i], W[i + 8]))));
+}
+
+void GroestlBigCompress(unsigned char* state, const unsigned char* buf)
+{
+    __m128i h[8], p[8], q[8];
+    LoadRows(h, state);
+    LoadRows(q, buf);
+    for (int i = 0; i < 8; i++)
+        p[i] = Xor(h[i], q[i]);
+    for (int r = 0; r < 14; r++) {
+        RoundP(p, r);
+        RoundQ(q, r);
+    }
+    for (int i = 0; i < 8; i++)
+        h[i] = Xor(h[i], Xor(p[i], q[i]));
+    StoreRows(state, h);
+}
+
+void GroestlBigFinal(unsigned char* state)
+{
+    __m128i h[8], p[8];
+    LoadRows(h, state);
+    for (int i = 0; i < 8; i++)
+        p[i] = h[i];
+    for (int r = 0; r < 14; r++)
+        RoundP(p, r);
+    for (int i = 0; i < 8; i++)
+        h[i] = Xor(h[i], p[i]);
+    StoreRows(state, h);
+}
+
+void ShaviteBigCompress(sph_shavite_big_context* sc, const void* msg)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i counter = _mm_set_epi32(sc->count3, sc->count2, sc->count1, sc->count0);
+    __m128i rk[112];
+
+    // Message expansion, in 4 word steps: eight from the message, then
+    // alternately eight nonlinear ones through one AES round and eight
+    // linear ones, with the counter mixed into four of the nonlinear steps
+    for (int i = 0; i < 8; i++)
+        rk[i] = Load((const unsigned char*)msg + 16 * i);
+    const uint32_t* rkw = (const uint32_t*)rk;
+    int u = 8;
+    for (;;) {
+        for (int s = 0; s < 8; s++, u++) {
+            __m128i x = _mm_aesenc_si128(_mm_shuffle_epi32(rk[u - 8], 0x39), zero);
+            x = Xor(x, rk[u - 1]);
+            if (u == 8) {
+                x = Xor(x, Xor(counter, _mm_set_epi32(-1, 0, 0, 0)));
+            } else if (u == 41) {
+                x = Xor(x, Xor(_mm_shuffle_epi32(counter, 0x1b), _mm_set_epi32(-1, 0, 0, 0)));
+            } else if (u == 79) {
+                x = Xor(x, Xor(_mm_shuffle_epi32(counter, 0x4e), _mm_set_epi32(-1, 0, 0, 0)));
+            } else if (u == 110) {
+                x = Xor(x, Xor(_mm_shuffle_epi32(counter, 0xb1), _mm_set_epi32(-1, 0, 0, 0)));
+            }
+            rk[u] = x;
+        }
+        if (u == 112)
+            break;
+        for (int s = 0; s < 8; s++, u++)
+            rk[u] = Xor(rk[u - 8], Load(rkw + 4 * u - 7));
+    }
+
+    __m128i p0 = Load(sc->h), p1 = Load(sc->h + 4), p2 = Load(sc->h + 8), p3 = Load(sc->h + 12);
+    const __m128i* k = rk;
+    for (int r = 0; r < 14; r++) {
+        __m128i x = Xor(p1, k[0]);
+        x = _mm_aesenc_si128(x, k[1]);
+        x = _mm_aesenc_si128(x, k[2]);
+        x = _mm_aesenc_si128(x, k[3]);
+        p0 = Xor(p0, _mm_aesenc_si128(x, zero));
+        __m128i y = Xor(p3, k[4]);
+        y = _mm_aesenc_si128(y, k[5]);
+        y = _mm_aesenc_si128(y, k[6]);
+        y = _mm_aesenc_si128(y, k[7]);
+        p2 = Xor(p2, _mm_aesenc_si128(y, zero));
+        k += 8;
+
+        const __m128i t = p3;
+        p3 = p2;
+        p2 = p1;
+        p1 = p0;
+        p0 = t;
+    }
+    Store(sc->h, Xor(Load(sc->h), p0));
+    Store(sc->h + 4, Xor(Load(sc->h + 4), p1));
+    Store(sc->h + 8, Xor(Load(sc->h + 8), p2));
+    Store(sc->h + 12, Xor(Load(sc->h + 12), p3));
+}
+
+} // namespace sph_aesni
+
+#endif
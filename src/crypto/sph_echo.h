@@ -314,6 +314,16 @@ void sph_echo512_close(void *cc, void *dst);
 void sph_echo512_addbits_and_close(
 	void *cc, unsigned ub, unsigned n, void *dst);
 
+/* VELES BEGIN */
+/**
+ * Replacement of the ECHO-384/512 compression function, set by
+ * SphAutoDetect() when the CPU has faster instructions for it. It
+ * compresses the block in the buffer of the context into its chaining
+ * value, with the counter of the context as salt.
+ */
+extern void (*sph_echo_big_compress_hw)(sph_echo_big_context *sc);
+/* VELES END */
+
 #ifdef __cplusplus
 }
 #endif
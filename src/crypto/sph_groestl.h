@@ -323,6 +323,18 @@ void sph_groestl512_close(void *cc, void *dst);
 void sph_groestl512_addbits_and_close(
 	void *cc, unsigned ub, unsigned n, void *dst);
 
+/* VELES BEGIN */
+/**
+ * Replacements of the Groestl-384/512 compression and output
+ * transformation, set by SphAutoDetect() when the CPU has faster
+ * instructions for them. The state is the 128 bytes of the chaining
+ * value, column by column as in the specification.
+ */
+extern void (*sph_groestl_big_compress_hw)(unsigned char *state,
+	const unsigned char *buf);
+extern void (*sph_groestl_big_final_hw)(unsigned char *state);
+/* VELES END */
+
 #ifdef __cplusplus
 }
 #endif
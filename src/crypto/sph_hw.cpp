@@ -0,0 +1,82 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crypto/sph_hw.h>
+
+#include <crypto/sph_echo.h>
+#include <crypto/sph_groestl.h>
+#include <crypto/sph_shavite.h>
+
+#include <stdint.h>
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
+
+namespace sph_aesni
+{
+void EchoBigCompress(sph_echo_big_context* sc);
+void GroestlBigCompress(unsigned char* state, const unsigned char* buf);
+void GroestlBigFinal(unsigned char* state);
+void ShaviteBigCompress(sph_shavite_big_context* sc, const void* msg);
+}
+
+namespace sph_vaes
+{
+void EchoBigCompress(sph_echo_big_context* sc);
+void GroestlBigCompress(unsigned char* state, const unsigned char* buf);
+}
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+/** Check whether the OS has enabled AVX registers. */
+static bool SphAVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
+
+std::string SphAutoDetect()
+{
+    std::string ret = "standard";
+    sph_echo_big_compress_hw = nullptr;
+    sph_groestl_big_compress_hw = nullptr;
+    sph_groestl_big_final_hw = nullptr;
+    sph_shavite_big_compress_hw = nullptr;
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+    uint32_t eax, ebx, ecx, edx;
+    bool have_aesni = false;
+    bool have_vaes = false;
+
+    __cpuid_count(1, 0, eax, ebx, ecx, edx);
+    // AES-NI, with the SSSE3 byte shuffles of the Groestl kernel
+    have_aesni = ((ecx >> 25) & 1) && ((ecx >> 9) & 1);
+    if (have_aesni && ((ecx >> 27) & 1) && ((ecx >> 28) & 1) && SphAVXEnabled()) {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        have_vaes = ((ebx >> 5) & 1) && ((ecx >> 9) & 1);
+    }
+    (void)have_aesni;
+    (void)have_vaes;
+
+#if defined(ENABLE_AESNI) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_aesni) {
+        sph_echo_big_compress_hw = sph_aesni::EchoBigCompress;
+        sph_groestl_big_compress_hw = sph_aesni::GroestlBigCompress;
+        sph_groestl_big_final_hw = sph_aesni::GroestlBigFinal;
+        sph_shavite_big_compress_hw = sph_aesni::ShaviteBigCompress;
+        ret = "aesni(echo,groestl,shavite)";
+    }
+#endif
+
+#if defined(ENABLE_AESNI) && defined(ENABLE_VAES) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (have_aesni && have_vaes) {
+        sph_echo_big_compress_hw = sph_vaes::EchoBigCompress;
+        sph_groestl_big_compress_hw = sph_vaes::GroestlBigCompress;
+        ret = "vaes(echo,groestl),aesni(groestl-final,shavite)";
+    }
+#endif
+#endif
+    return ret;
+}
@@ -0,0 +1,17 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef VELES_CRYPTO_SPH_HW_H
+#define VELES_CRYPTO_SPH_HW_H
+
+#include <string>
+
+/** Autodetect the best available implementations of the AES based sph
+ *  functions of X11 and X16R (ECHO, Groestl and SHAvite) and install them
+ *  into their compression hooks.
+ *  Returns the name of the implementations.
+ */
+std::string SphAutoDetect();
+
+#endif // VELES_CRYPTO_SPH_HW_H
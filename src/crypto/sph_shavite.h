@@ -308,6 +308,17 @@ void sph_shavite512_close(void *cc, void *dst);
 void sph_shavite512_addbits_and_close(
 	void *cc, unsigned ub, unsigned n, void *dst);
 
+/* VELES BEGIN */
+/**
+ * Replacement of the SHAvite-384/512 compression function, set by
+ * SphAutoDetect() when the CPU has faster instructions for it. It
+ * compresses the 128 byte block msg into the chaining value of the
+ * context, with the counter of the context.
+ */
+extern void (*sph_shavite_big_compress_hw)(sph_shavite_big_context *sc,
+	const void *msg);
+/* VELES END */
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,218 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_VAES
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <limits>
+
+#include <crypto/sph_echo.h>
+
+// ECHO-512 and Groestl-512 compression functions with the AES rounds on two
+// 128-bit lanes at once. ECHO pairs the words of the chaining value with the
+// words of the message, Groestl runs its P and Q permutations side by side.
+
+namespace sph_aesni
+{
+void EchoBigCompress(sph_echo_big_context* sc);
+}
+
+namespace sph_vaes {
+namespace {
+
+__m128i inline Load(const void* p) { return _mm_loadu_si128((const __m128i*)p); }
+void inline Store(void* p, __m128i x) { _mm_storeu_si128((__m128i*)p, x); }
+__m256i inline Xor(__m256i x, __m256i y) { return _mm256_xor_si256(x, y); }
+__m256i inline Combine(__m128i lo, __m128i hi) { return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1); }
+__m256i inline Swap(__m256i x) { return _mm256_permute4x64_epi64(x, 0x4e); }
+
+/** Multiplication by 2 in GF(2^8) modulo x^8 + x^4 + x^3 + x + 1, on every byte */
+__m256i inline XTime(__m256i x)
+{
+    const __m256i poly = _mm256_set1_epi8(0x1b);
+    return Xor(_mm256_add_epi8(x, x), _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_setzero_si256(), x), poly));
+}
+
+// Groestl-512 works on 8 rows of 16 bytes. The state in memory is column
+// major, so it is transposed to one register per row on the way in and back
+// on the way out.
+const __m128i TRANSPOSE_IN = _mm_set_epi8(15, 7, 14, 6, 13, 5, 12, 4, 11, 3, 10, 2, 9, 1, 8, 0);
+const __m128i TRANSPOSE_OUT = _mm_set_epi8(15, 13, 11, 9, 7, 5, 3, 1, 14, 12, 10, 8, 6, 4, 2, 0);
+
+/** 8x8 transpose of 16-bit words */
+void inline __attribute__((always_inline)) Transpose16(__m128i x[8])
+{
+    const __m128i t0 = _mm_unpacklo_epi16(x[0], x[1]), t1 = _mm_unpackhi_epi16(x[0], x[1]);
+    const __m128i t2 = _mm_unpacklo_epi16(x[2], x[3]), t3 = _mm_unpackhi_epi16(x[2], x[3]);
+    const __m128i t4 = _mm_unpacklo_epi16(x[4], x[5]), t5 = _mm_unpackhi_epi16(x[4], x[5]);
+    const __m128i t6 = _mm_unpacklo_epi16(x[6], x[7]), t7 = _mm_unpackhi_epi16(x[6], x[7]);
+    const __m128i u0 = _mm_unpacklo_epi32(t0, t2), u1 = _mm_unpackhi_epi32(t0, t2);
+    const __m128i u2 = _mm_unpacklo_epi32(t1, t3), u3 = _mm_unpackhi_epi32(t1, t3);
+    const __m128i u4 = _mm_unpacklo_epi32(t4, t6), u5 = _mm_unpackhi_epi32(t4, t6);
+    const __m128i u6 = _mm_unpacklo_epi32(t5, t7), u7 = _mm_unpackhi_epi32(t5, t7);
+    x[0] = _mm_unpacklo_epi64(u0, u4); x[1] = _mm_unpackhi_epi64(u0, u4);
+    x[2] = _mm_unpacklo_epi64(u1, u5); x[3] = _mm_unpackhi_epi64(u1, u5);
+    x[4] = _mm_unpacklo_epi64(u2, u6); x[5] = _mm_unpackhi_epi64(u2, u6);
+    x[6] = _mm_unpacklo_epi64(u3, u7); x[7] = _mm_unpackhi_epi64(u3, u7);
+}
+
+// The byte shuffles of ShiftBytes for P in the low and Q in the high lane,
+// composed with the inverse of the AES ShiftRows done by AESENCLAST
+alignas(32) const unsigned char SHIFT_PQ[8][32] = {
+    {0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03,
+     0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04},
+    {0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04,
+     0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06},
+    {0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05,
+     0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08},
+    {0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06,
+     0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e},
+    {0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07,
+     0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03},
+    {0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08,
+     0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05},
+    {0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09,
+     0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07},
+    {0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e,
+     0x06, 0x03, 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09},
+};
+
+/** Column numbers in the high nibbles, the round constants without the round */
+const __m128i COLUMNS = _mm_set_epi8(0xf0, 0xe0, 0xd0, 0xc0, 0xb0, 0xa0, 0x90, 0x80, 0x70, 0x60, 0x50, 0x40, 0x30, 0x20, 0x10, 0x00);
+
+__m256i inline SubShift(__m256i x, const unsigned char* shift)
+{
+    return _mm256_aesenclast_epi128(_mm256_shuffle_epi8(x, _mm256_load_si256((const __m256i*)shift)), _mm256_setzero_si256());
+}
+
+/** Row i of Groestl MixBytes from the rows a_i and their sums t_i = a_i ^ a_(i+1) */
+__m256i inline MixRow(__m256i t0, __m256i a2, __m256i a5, __m256i a7, __m256i t3, __m256i t4, __m256i t6)
+{
+    const __m256i x = Xor(a2, Xor(t4, t6));
+    const __m256i y = Xor(Xor(t0, a2), Xor(a5, a7));
+    const __m256i z = Xor(t3, t6);
+    return Xor(x, XTime(Xor(y, XTime(z))));
+}
+
+/** Groestl MixBytes, b_i = x_i ^ 2 (y_i ^ 2 z_i) with the indices of a taken modulo 8 */
+void inline __attribute__((always_inline)) MixBytes(__m256i a[8])
+{
+    const __m256i t0 = Xor(a[0], a[1]), t1 = Xor(a[1], a[2]), t2 = Xor(a[2], a[3]), t3 = Xor(a[3], a[4]);
+    const __m256i t4 = Xor(a[4], a[5]), t5 = Xor(a[5], a[6]), t6 = Xor(a[6], a[7]), t7 = Xor(a[7], a[0]);
+    const __m256i b0 = MixRow(t0, a[2], a[5], a[7], t3, t4, t6);
+    const __m256i b1 = MixRow(t1, a[3], a[6], a[0], t4, t5, t7);
+    const __m256i b2 = MixRow(t2, a[4], a[7], a[1], t5, t6, t0);
+    const __m256i b3 = MixRow(t3, a[5], a[0], a[2], t6, t7, t1);
+    const __m256i b4 = MixRow(t4, a[6], a[1], a[3], t7, t0, t2);
+    const __m256i b5 = MixRow(t5, a[7], a[2], a[4], t0, t1, t3);
+    const __m256i b6 = MixRow(t6, a[0], a[3], a[5], t1, t2, t4);
+    const __m256i b7 = MixRow(t7, a[1], a[4], a[6], t2, t3, t5);
+    a[0] = b0; a[1] = b1; a[2] = b2; a[3] = b3;
+    a[4] = b4; a[5] = b5; a[6] = b6; a[7] = b7;
+}
+
+} // namespace
+
+void EchoBigCompress(sph_echo_big_context* sc)
+{
+    // The salt of word n is the counter plus n, the vector increments below
+    // only carry within the low 64 bits of each lane
+    const uint64_t lo = (uint64_t)sc->C1 << 32 | sc->C0;
+    const uint64_t hi = (uint64_t)sc->C3 << 32 | sc->C2;
+    if (lo > std::numeric_limits<uint64_t>::max() - 160) {
+        sph_aesni::EchoBigCompress(sc);
+        return;
+    }
+
+    // Register j holds word j of the chaining value and word j of the
+    // message, that is the words j and j + 8 of the state: both lanes are
+    // in the same row, two columns apart
+    __m256i R[8];
+    for (int j = 0; j < 8; j++)
+        R[j] = Combine(Load(sc->u.Vs[j]), Load(sc->buf + 16 * j));
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set_epi64x(0, 1, 0, 1);
+    const __m256i eight = _mm256_set_epi64x(0, 8, 0, 8);
+    __m256i K = _mm256_set_epi64x(hi, lo + 8, hi, lo);
+    for (int r = 0; r < 10; r++) {
+        for (int j = 0; j < 8; j++) {
+            R[j] = _mm256_aesenc_epi128(_mm256_aesenc_epi128(R[j], K), zero);
+            K = _mm256_add_epi64(K, one);
+        }
+        K = _mm256_add_epi64(K, eight);
+
+        // BigShiftRows, rows 1 to 3 rotate by 1 to 3 columns
+        const __m256i r1 = R[1];
+        R[1] = R[5];
+        R[5] = Swap(r1);
+        R[2] = Swap(R[2]);
+        R[6] = Swap(R[6]);
+        const __m256i r3 = R[3];
+        R[3] = Swap(R[7]);
+        R[7] = r3;
+
+        // BigMixColumns, on two columns per register
+        for (int i = 0; i < 8; i += 4) {
+            const __m256i a = R[i], b = R[i + 1], c = R[i + 2], d = R[i + 3];
+            const __m256i ab = Xor(a, b), bc = Xor(b, c), cd = Xor(c, d);
+            const __m256i abx = XTime(ab), bcx = XTime(bc), cdx = XTime(cd);
+            R[i] = Xor(abx, Xor(bc, d));
+            R[i + 1] = Xor(bcx, Xor(a, cd));
+            R[i + 2] = Xor(cdx, Xor(ab, d));
+            R[i + 3] = Xor(Xor(abx, bcx), Xor(Xor(cdx, ab), c));
+        }
+    }
+
+    for (int j = 0; j < 8; j++) {
+        const __m128i w = _mm_xor_si128(_mm256_castsi256_si128(R[j]), _mm256_extracti128_si256(R[j], 1));
+        Store(sc->u.Vs[j], _mm_xor_si128(Load(sc->u.Vs[j]), _mm_xor_si128(Load(sc->buf + 16 * j), w)));
+    }
+}
+
+void GroestlBigCompress(unsigned char* state, const unsigned char* buf)
+{
+    __m128i h[8], m[8];
+    for (int i = 0; i < 8; i++) {
+        h[i] = _mm_shuffle_epi8(Load(state + 16 * i), TRANSPOSE_IN);
+        m[i] = _mm_shuffle_epi8(Load(buf + 16 * i), TRANSPOSE_IN);
+    }
+    Transpose16(h);
+    Transpose16(m);
+
+    // Row i of P(h ^ m) in the low lane, row i of Q(m) in the high lane
+    __m256i a[8];
+    for (int i = 0; i < 8; i++)
+        a[i] = Combine(_mm_xor_si128(h[i], m[i]), m[i]);
+
+    const __m128i ones = _mm_set1_epi8(-1);
+    const __m256i lanep = Combine(ones, _mm_setzero_si128());
+    const __m256i c0 = Combine(COLUMNS, ones);
+    const __m256i c1 = Combine(_mm_setzero_si128(), ones);
+    const __m256i c7 = Combine(_mm_setzero_si128(), _mm_andnot_si128(COLUMNS, ones));
+    for (int r = 0; r < 14; r++) {
+        const __m256i round = _mm256_set1_epi8(r);
+        a[0] = Xor(a[0], Xor(c0, _mm256_and_si256(round, lanep)));
+        a[1] = Xor(a[1], c1); a[2] = Xor(a[2], c1); a[3] = Xor(a[3], c1);
+        a[4] = Xor(a[4], c1); a[5] = Xor(a[5], c1); a[6] = Xor(a[6], c1);
+        a[7] = Xor(a[7], Xor(c7, _mm256_andnot_si256(lanep, round)));
+        a[0] = SubShift(a[0], SHIFT_PQ[0]); a[1] = SubShift(a[1], SHIFT_PQ[1]);
+        a[2] = SubShift(a[2], SHIFT_PQ[2]); a[3] = SubShift(a[3], SHIFT_PQ[3]);
+        a[4] = SubShift(a[4], SHIFT_PQ[4]); a[5] = SubShift(a[5], SHIFT_PQ[5]);
+        a[6] = SubShift(a[6], SHIFT_PQ[6]); a[7] = SubShift(a[7], SHIFT_PQ[7]);
+        MixBytes(a);
+    }
+
+    for (int i = 0; i < 8; i++)
+        h[i] = _mm_xor_si128(h[i], _mm_xor_si128(_mm256_castsi256_si128(a[i]), _mm256_extracti128_si256(a[i], 1)));
+    Transpose16(h);
+    for (int i = 0; i < 8; i++)
+        Store(state + 16 * i, _mm_shuffle_epi8(h[i], TRANSPOSE_OUT));
+}
+
+} // namespace sph_vaes
+
+#endif
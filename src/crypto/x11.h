@@ -10,6 +10,10 @@
 
 #include <uint256.h>
 
+// VELES BEGIN
+#include <algorithm>
+// VELES END
+
 #include <crypto/sph_blake.h>
 #include <crypto/sph_bmw.h>
 #include <crypto/sph_groestl.h>
@@ -91,4 +95,55 @@ inline uint256 HashX11(const T1 pbegin, const T1 pend)
     return hash[10].trim256();
 }
 
+// VELES BEGIN
+/** Maximum number of inputs HashX11Batch() pushes through one algorithm before moving on to the next */
+static const size_t X11_BATCH_LANES = 8;
+
+/* Run one algorithm of the chain in place over the 64 byte intermediate hashes of all lanes */
+#define X11_BATCH_ROUND(algo, lanes, hash) \
+    for (size_t nLane = 0; nLane < (lanes); nLane++) { \
+        sph_##algo##_context ctx; \
+        sph_##algo##_init(&ctx); \
+        sph_##algo(&ctx, static_cast<const void*>(&(hash)[nLane]), 64); \
+        sph_##algo##_close(&ctx, static_cast<void*>(&(hash)[nLane])); \
+    }
+
+/**
+ * Hash nCount inputs of nLen bytes each, same result as HashX11() per input.
+ * Inputs are processed in groups of X11_BATCH_LANES and every algorithm is run
+ * over the whole group before the next one, so that the code and lookup tables
+ * of each of the eleven kernels stay hot in the CPU caches.
+ */
+inline void HashX11Batch(const unsigned char* const pinputs[], size_t nLen, uint256 poutputs[], size_t nCount)
+{
+    static unsigned char pblank[1];
+
+    uint512 hash[X11_BATCH_LANES];
+
+    for (size_t nFirst = 0; nFirst < nCount; nFirst += X11_BATCH_LANES) {
+        const size_t nLanes = std::min(X11_BATCH_LANES, nCount - nFirst);
+
+        for (size_t nLane = 0; nLane < nLanes; nLane++) {
+            sph_blake512_context ctx_blake;
+            sph_blake512_init(&ctx_blake);
+            sph_blake512 (&ctx_blake, (nLen == 0 ? pblank : pinputs[nFirst + nLane]), nLen);
+            sph_blake512_close(&ctx_blake, static_cast<void*>(&hash[nLane]));
+        }
+        X11_BATCH_ROUND(bmw512, nLanes, hash)
+        X11_BATCH_ROUND(groestl512, nLanes, hash)
+        X11_BATCH_ROUND(skein512, nLanes, hash)
+        X11_BATCH_ROUND(jh512, nLanes, hash)
+        X11_BATCH_ROUND(keccak512, nLanes, hash)
+        X11_BATCH_ROUND(luffa512, nLanes, hash)
+        X11_BATCH_ROUND(cubehash512, nLanes, hash)
+        X11_BATCH_ROUND(shavite512, nLanes, hash)
+        X11_BATCH_ROUND(simd512, nLanes, hash)
+        X11_BATCH_ROUND(echo512, nLanes, hash)
+
+        for (size_t nLane = 0; nLane < nLanes; nLane++)
+            poutputs[nFirst + nLane] = hash[nLane].trim256();
+    }
+}
+// VELES END
+
 #endif // DASH_CRYPTO_X11_H
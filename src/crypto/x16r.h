@@ -10,6 +10,10 @@
 
 #include <uint256.h>
 
+// VELES BEGIN
+#include <algorithm>
+// VELES END
+
 #include <crypto/sph_blake.h>
 #include <crypto/sph_bmw.h>
 #include <crypto/sph_groestl.h>
@@ -170,4 +174,120 @@ inline uint256 HashX16R(const T1 pbegin, const T1 pend, const uint256 PrevBlockH
     return hash[15].trim256();
 }
 
+// VELES BEGIN
+/* One X16R round, hashing len bytes at in into the 64 byte output at out */
+typedef void (*X16RRoundFn)(const void *in, size_t len, void *out);
+
+#define X16R_DEFINE_ROUND(algo) \
+    inline void X16RRound_##algo(const void *in, size_t len, void *out) \
+    { \
+        sph_##algo##_context ctx; \
+        sph_##algo##_init(&ctx); \
+        sph_##algo(&ctx, in, len); \
+        sph_##algo##_close(&ctx, out); \
+    }
+
+X16R_DEFINE_ROUND(blake512)
+X16R_DEFINE_ROUND(bmw512)
+X16R_DEFINE_ROUND(groestl512)
+X16R_DEFINE_ROUND(jh512)
+X16R_DEFINE_ROUND(keccak512)
+X16R_DEFINE_ROUND(skein512)
+X16R_DEFINE_ROUND(luffa512)
+X16R_DEFINE_ROUND(cubehash512)
+X16R_DEFINE_ROUND(shavite512)
+X16R_DEFINE_ROUND(simd512)
+X16R_DEFINE_ROUND(echo512)
+X16R_DEFINE_ROUND(hamsi512)
+X16R_DEFINE_ROUND(fugue512)
+X16R_DEFINE_ROUND(shabal512)
+X16R_DEFINE_ROUND(whirlpool)
+X16R_DEFINE_ROUND(sha512)
+
+#undef X16R_DEFINE_ROUND
+
+/** X16R rounds indexed by hash selection */
+static const X16RRoundFn X16R_ROUNDS[16] = {
+    X16RRound_blake512, X16RRound_bmw512, X16RRound_groestl512, X16RRound_jh512,
+    X16RRound_keccak512, X16RRound_skein512, X16RRound_luffa512, X16RRound_cubehash512,
+    X16RRound_shavite512, X16RRound_simd512, X16RRound_echo512, X16RRound_hamsi512,
+    X16RRound_fugue512, X16RRound_shabal512, X16RRound_whirlpool, X16RRound_sha512
+};
+
+/**
+ * The X16R algorithm chain selected by one hashPrevBlock, resolved once.
+ * A plan can be reused to hash any number of headers (e.g. all nonces of
+ * a block template) building on that hashPrevBlock, without decoding the
+ * nibble selection and dispatching through a switch in every round.
+ */
+class CX16RPlan
+{
+private:
+    uint256 hashPrevBlock;
+    X16RRoundFn rounds[16];
+
+public:
+    explicit CX16RPlan(const uint256& PrevBlockHash) : hashPrevBlock(PrevBlockHash)
+    {
+        for (int i = 0; i < 16; i++)
+            rounds[i] = X16R_ROUNDS[GetHashSelection(PrevBlockHash, i)];
+    }
+
+    const uint256& GetPrevBlockHash() const { return hashPrevBlock; }
+
+    /** Same result as HashX16R(pbegin, pend, GetPrevBlockHash()) */
+    template<typename T1>
+    uint256 Hash(const T1 pbegin, const T1 pend) const
+    {
+        static unsigned char pblank[1];
+
+        uint512 hash;
+        rounds[0]((pbegin == pend ? pblank : static_cast<const void*>(&pbegin[0])), (pend - pbegin) * sizeof(pbegin[0]), static_cast<void*>(&hash));
+        for (int i = 1; i < 16; i++)
+            rounds[i](static_cast<const void*>(&hash), 64, static_cast<void*>(&hash));
+
+        return hash.trim256();
+    }
+};
+
+/** Maximum number of inputs HashX16RBatch() pushes through one round before moving on to the next */
+static const size_t X16R_BATCH_LANES = 8;
+
+/**
+ * Hash nCount inputs of nLen bytes each, input i chained by PrevBlockHashes[i].
+ * Same result as HashX16R() per input. Inputs are processed in groups of
+ * X16R_BATCH_LANES and each of the 16 rounds is run over the whole group before
+ * the next one. Lanes sharing a hashPrevBlock (e.g. nonces of one template) run
+ * the same kernel back to back, keeping its code and tables hot in the CPU caches.
+ */
+inline void HashX16RBatch(const unsigned char* const pinputs[], size_t nLen, const uint256 PrevBlockHashes[], uint256 poutputs[], size_t nCount)
+{
+    static unsigned char pblank[1];
+
+    uint512 hash[X16R_BATCH_LANES];
+
+    for (size_t nFirst = 0; nFirst < nCount; nFirst += X16R_BATCH_LANES) {
+        const size_t nLanes = std::min(X16R_BATCH_LANES, nCount - nFirst);
+
+        for (int i = 0; i < 16; i++) {
+            for (size_t nLane = 0; nLane < nLanes; nLane++) {
+                const void *toHash;
+                size_t lenToHash;
+                if (i == 0) {
+                    toHash = (nLen == 0 ? pblank : pinputs[nFirst + nLane]);
+                    lenToHash = nLen;
+                } else {
+                    toHash = static_cast<const void*>(&hash[nLane]);
+                    lenToHash = 64;
+                }
+                X16R_ROUNDS[GetHashSelection(PrevBlockHashes[nFirst + nLane], i)](toHash, lenToHash, static_cast<void*>(&hash[nLane]));
+            }
+        }
+
+        for (size_t nLane = 0; nLane < nLanes; nLane++)
+            poutputs[nFirst + nLane] = hash[nLane].trim256();
+    }
+}
+// VELES END
+
 #endif // TALKCOIN_CRYPTO_X16R_H
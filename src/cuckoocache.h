@@ -439,6 +439,35 @@ public:
         }
     }
 
+    // VELES BEGIN
+    /** for_each calls f with every element that is not garbage collected, in
+     * the order of the table.
+     *
+     * @param f callable taking a const Element&
+     */
+    template <typename F>
+    void for_each(F f) const
+    {
+        for (uint32_t i = 0; i < size; ++i)
+            if (!collection_flags.bit_is_set(i))
+                f(table[i]);
+    }
+
+    /** count returns the number of elements that are not garbage collected */
+    uint32_t count() const
+    {
+        uint32_t n = 0;
+        for_each([&n](const Element&) { ++n; });
+        return n;
+    }
+
+    /** capacity returns the number of elements the table has room for */
+    uint32_t capacity() const
+    {
+        return size;
+    }
+    // VELES END
+
     /* contains iterates through the hash locations for a given element
      * and checks to see if it is present.
      *
@@ -13,6 +13,11 @@
 #include <memenv.h>
 #include <stdint.h>
 #include <algorithm>
+// VELES BEGIN
+#include <set>
+#include <sstream>
+#include <stdio.h>
+// VELES END
 
 class CBitcoinLevelDBLogger : public leveldb::Logger {
 public:
@@ -97,13 +102,73 @@ static void SetMaxOpenFiles(leveldb::Options *options) {
              options->max_open_files, default_open_files);
 }
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+// VELES BEGIN
+bool DBProfile::Set(const std::string& setting)
+{
+    size_t nSep = setting.find('=');
+    if (nSep == std::string::npos) return false;
+    const std::string option = setting.substr(0, nSep);
+    int64_t value;
+    if (!ParseInt64(setting.substr(nSep + 1), &value)) return false;
+    if (option == "block_size" && value >= 1024 && value <= (4 << 20)) {
+        block_size = value;
+    } else if (option == "compression" && (value == 0 || value == 1)) {
+        compression = value;
+    } else if (option == "bloom_bits" && value >= 0 && value <= 64) {
+        bloom_bits = value;
+    } else if (option == "max_open_files" && value >= 0 && value <= 50000) {
+        max_open_files = value;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool CheckDBOptions(std::string& error)
+{
+    for (const std::string& arg : gArgs.GetArgs("-dboption")) {
+        size_t nSep = arg.find('.');
+        if (nSep == 0 || nSep == std::string::npos || !DBProfile().Set(arg.substr(nSep + 1))) {
+            error = strprintf("Invalid -dboption setting '%s'", arg);
+            return false;
+        }
+    }
+    return true;
+}
+
+/** The profile of the database name, the defaults with the -dboption settings for the database applied */
+static DBProfile GetDBProfile(const std::string& name, const DBProfile& defaults)
+{
+    DBProfile profile = defaults;
+    for (const std::string& arg : gArgs.GetArgs("-dboption")) {
+        if (arg.compare(0, name.size() + 1, name + ".") != 0) continue;
+        if (!profile.Set(arg.substr(name.size() + 1))) {
+            LogPrintf("Ignoring invalid -dboption setting '%s'\n", arg);
+        }
+    }
+    return profile;
+}
+
+static Mutex g_dbwrappers_mutex;
+//! The open databases, for ForEachDBWrapper
+static std::set<const CDBWrapper*> g_dbwrappers GUARDED_BY(g_dbwrappers_mutex);
+// VELES END
+
+// VELES BEGIN
+//static leveldb::Options GetOptions(size_t nCacheSize)
+static leveldb::Options GetOptions(size_t nCacheSize, const DBProfile& profile)
+// VELES END
 {
     leveldb::Options options;
     options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
     options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
-    options.compression = leveldb::kNoCompression;
+    // VELES BEGIN
+    //options.filter_policy = leveldb::NewBloomFilterPolicy(10);
+    //options.compression = leveldb::kNoCompression;
+    options.block_size = profile.block_size;
+    options.filter_policy = profile.bloom_bits > 0 ? leveldb::NewBloomFilterPolicy(profile.bloom_bits) : nullptr;
+    options.compression = profile.compression ? leveldb::kSnappyCompression : leveldb::kNoCompression;
+    // VELES END
     options.info_log = new CBitcoinLevelDBLogger();
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
@@ -111,18 +176,32 @@ static leveldb::Options GetOptions(size_t nCacheSize)
         options.paranoid_checks = true;
     }
     SetMaxOpenFiles(&options);
+    // VELES BEGIN
+    if (profile.max_open_files > 0) {
+        options.max_open_files = profile.max_open_files;
+    }
+    // VELES END
     return options;
 }
 
-CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
-    : m_name(fs::basename(path))
+// VELES BEGIN
+//CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
+//    : m_name(fs::basename(path))
+CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate, const DBProfile& profile)
+    : m_name(fs::basename(path)), m_profile(GetDBProfile(m_name, profile))
+// VELES END
 {
     penv = nullptr;
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    // VELES BEGIN
+    //options = GetOptions(nCacheSize);
+    options = GetOptions(nCacheSize, m_profile);
+    LogPrint(BCLog::LEVELDB, "LevelDB %s using block_size=%u compression=%d bloom_bits=%d\n",
+             m_name, m_profile.block_size, m_profile.compression, m_profile.bloom_bits);
+    // VELES END
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -164,10 +243,21 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
     }
 
     LogPrintf("Using obfuscation key for %s: %s\n", path.string(), HexStr(obfuscate_key));
+
+    // VELES BEGIN
+    LOCK(g_dbwrappers_mutex);
+    g_dbwrappers.insert(this);
+    // VELES END
 }
 
 CDBWrapper::~CDBWrapper()
 {
+    // VELES BEGIN
+    {
+        LOCK(g_dbwrappers_mutex);
+        g_dbwrappers.erase(this);
+    }
+    // VELES END
     delete pdb;
     pdb = nullptr;
     delete options.filter_policy;
@@ -206,6 +296,39 @@ size_t CDBWrapper::DynamicMemoryUsage() const {
     return stoul(memory);
 }
 
+// VELES BEGIN
+DBStats CDBWrapper::GetStats() const
+{
+    DBStats stats;
+    stats.memory_usage = DynamicMemoryUsage();
+    if (!pdb->GetProperty("leveldb.stats", &stats.text)) {
+        LogPrint(BCLog::LEVELDB, "Failed to get stats property\n");
+        return stats;
+    }
+    // Rows of level, files, size (MB), compaction time (sec), read (MB) and written (MB) follow three header lines
+    std::istringstream lines(stats.text);
+    std::string line;
+    for (int i = 0; std::getline(lines, line); ++i) {
+        if (i < 3) continue;
+        DBStats::Level level;
+        if (sscanf(line.c_str(), "%d %d %lf %lf %lf %lf", &level.level, &level.files, &level.size_mb,
+                   &level.time, &level.read_mb, &level.write_mb) == 6) {
+            stats.compaction_time += level.time;
+            stats.levels.push_back(level);
+        }
+    }
+    return stats;
+}
+
+void ForEachDBWrapper(const std::function<void(const CDBWrapper&)>& func)
+{
+    LOCK(g_dbwrappers_mutex);
+    for (const CDBWrapper* db : g_dbwrappers) {
+        func(*db);
+    }
+}
+// VELES END
+
 // Prefixed with null character to avoid collisions with other keys
 //
 // We must use a string constructor which specifies length so that we copy
@@ -238,6 +361,24 @@ bool CDBIterator::Valid() const { return piter->Valid(); }
 void CDBIterator::SeekToFirst() { piter->SeekToFirst(); }
 void CDBIterator::Next() { piter->Next(); }
 
+// VELES BEGIN
+Span<const unsigned char> CDBIterator::GetValueSpan()
+{
+    leveldb::Slice slValue = piter->value();
+    const std::vector<unsigned char>& obfuscate_key = dbwrapper_private::GetObfuscateKey(parent);
+    if (obfuscate_key.empty() || std::all_of(obfuscate_key.begin(), obfuscate_key.end(), [](unsigned char c) { return c == 0; })) {
+        return Span<const unsigned char>((const unsigned char*)slValue.data(), slValue.size());
+    }
+    m_value_buf.assign(slValue.data(), slValue.data() + slValue.size());
+    for (size_t i = 0, j = 0; i != m_value_buf.size(); i++) {
+        m_value_buf[i] ^= obfuscate_key[j++];
+        if (j == obfuscate_key.size())
+            j = 0;
+    }
+    return Span<const unsigned char>(m_value_buf.data(), m_value_buf.size());
+}
+// VELES END
+
 namespace dbwrapper_private {
 
 void HandleError(const leveldb::Status& status)
@@ -13,6 +13,11 @@
 #include <util/strencodings.h>
 #include <version.h>
 
+// VELES BEGIN
+#include <functional>
+#include <limits>
+// VELES END
+
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
 
@@ -27,6 +32,50 @@ public:
 
 class CDBWrapper;
 
+// VELES BEGIN
+/**
+ * LevelDB settings of a database besides its cache size. Each database passes the defaults
+ * suiting its access pattern, -dboption=<name>.<option>=<value> overrides them by the name
+ * of the database directory.
+ */
+struct DBProfile {
+    //! Approximate size of the user data packed per block
+    size_t block_size = 4 * 1024;
+    //! Snappy compression of blocks, only takes effect when LevelDB is built with Snappy
+    bool compression = false;
+    //! Bits per key of the bloom filter, 0 disables the filter
+    int bloom_bits = 10;
+    //! Maximum number of open files, 0 for the default of the platform
+    int max_open_files = 0;
+
+    /** Apply a setting of the form <option>=<value>, false if it is not valid */
+    bool Set(const std::string& setting);
+};
+
+/** Check the syntax of all -dboption settings */
+bool CheckDBOptions(std::string& error);
+
+/** Statistics of a database as reported by LevelDB */
+struct DBStats {
+    struct Level {
+        int level;
+        int files;
+        double size_mb;
+        //! Seconds spent compacting into the level
+        double time;
+        double read_mb;
+        double write_mb;
+    };
+
+    size_t memory_usage = 0;
+    //! Seconds spent compacting, over all levels
+    double compaction_time = 0;
+    std::vector<Level> levels;
+    //! The leveldb.stats property the levels are read from
+    std::string text;
+};
+// VELES END
+
 /** These should be considered an implementation detail of the specific database.
  */
 namespace dbwrapper_private {
@@ -119,6 +168,10 @@ class CDBIterator
 private:
     const CDBWrapper &parent;
     leveldb::Iterator *piter;
+    // VELES BEGIN
+    //! Buffer the current value is de-obfuscated into, reused for every entry
+    std::vector<unsigned char> m_value_buf;
+    // VELES END
 
 public:
 
@@ -144,26 +197,56 @@ public:
 
     void Next();
 
-    template<typename K> bool GetKey(K& key) {
+    // VELES BEGIN
+    /** The bytes of the current key, valid until the iterator moves */
+    Span<const unsigned char> GetKeySpan() const {
         leveldb::Slice slKey = piter->key();
+        return Span<const unsigned char>((const unsigned char*)slKey.data(), slKey.size());
+    }
+
+    /** The bytes of the current value, de-obfuscated, valid until the iterator moves */
+    Span<const unsigned char> GetValueSpan();
+
+    /**
+     * Visit the entries from the current one on while their keys start with prefix, at most
+     * nMax of them. The keys and values are passed as spans valid during the call only, so a
+     * scan does not allocate per entry. func returns false to stop the scan, the iterator is
+     * left on the first entry not visited. Returns the number of entries visited.
+     */
+    template<typename F> size_t ForEachWithPrefix(Span<const unsigned char> prefix, F func, size_t nMax = std::numeric_limits<size_t>::max()) {
+        size_t nVisited = 0;
+        for (; nVisited < nMax && piter->Valid(); piter->Next()) {
+            Span<const unsigned char> key = GetKeySpan();
+            if (key.size() < prefix.size() || key.first(prefix.size()) != prefix) break;
+            if (!func(key, GetValueSpan())) break;
+            ++nVisited;
+        }
+        return nVisited;
+    }
+    // VELES END
+
+    template<typename K> bool GetKey(K& key) {
+        // VELES BEGIN
+        // Read straight from the key of the iterator instead of a copy
         try {
-            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            SpanReader ssKey(SER_DISK, CLIENT_VERSION, GetKeySpan());
             ssKey >> key;
         } catch (const std::exception&) {
             return false;
         }
+        // VELES END
         return true;
     }
 
     template<typename V> bool GetValue(V& value) {
-        leveldb::Slice slValue = piter->value();
+        // VELES BEGIN
         try {
-            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
-            ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
+            SpanReader ssValue(SER_DISK, CLIENT_VERSION, GetValueSpan());
             ssValue >> value;
         } catch (const std::exception&) {
             return false;
         }
+        // VELES END
         return true;
     }
 
@@ -173,6 +256,36 @@ public:
 
 };
 
+// VELES BEGIN
+/**
+ * Decoder of keys that serialize to a fixed number of bytes, such as a prefix character
+ * followed by hashes and integers. Keys of another size are rejected before being read,
+ * the fields are read straight from the key bytes.
+ */
+template <typename K>
+class CDBFixedKeyDecoder
+{
+private:
+    const size_t m_size;
+
+public:
+    explicit CDBFixedKeyDecoder(const K& key = K()) : m_size(::GetSerializeSize(key, CLIENT_VERSION)) {}
+
+    size_t size() const { return m_size; }
+
+    bool operator()(Span<const unsigned char> bytes, K& key) const {
+        if ((size_t)bytes.size() != m_size) return false;
+        try {
+            SpanReader ssKey(SER_DISK, CLIENT_VERSION, bytes);
+            ssKey >> key;
+        } catch (const std::exception&) {
+            return false;
+        }
+        return true;
+    }
+};
+// VELES END
+
 class CDBWrapper
 {
     friend const std::vector<unsigned char>& dbwrapper_private::GetObfuscateKey(const CDBWrapper &w);
@@ -201,6 +314,9 @@ private:
     //! the name of this database
     std::string m_name;
 
+    //! LevelDB settings of this database
+    DBProfile m_profile; // VELES
+
     //! a key used for optional XOR-obfuscation of the database
     std::vector<unsigned char> obfuscate_key;
 
@@ -220,8 +336,9 @@ public:
      * @param[in] fWipe       If true, remove all existing data.
      * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If false, XOR
      *                        with a zero'd byte array.
+     * @param[in] profile     Default LevelDB settings, overridden by -dboption.
      */
-    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false, const DBProfile& profile = DBProfile()); // VELES
     ~CDBWrapper();
 
     CDBWrapper(const CDBWrapper&) = delete;
@@ -293,6 +410,12 @@ public:
     // Get an estimate of LevelDB memory usage (in bytes).
     size_t DynamicMemoryUsage() const;
 
+    // VELES BEGIN
+    const std::string& GetName() const { return m_name; }
+    const DBProfile& GetProfile() const { return m_profile; }
+    DBStats GetStats() const;
+    // VELES END
+
     // not available for LevelDB; provide for compatibility with BDB
     bool Flush()
     {
@@ -349,4 +472,9 @@ public:
 
 };
 
+// VELES BEGIN
+/** Call func for every open database, which stays open during the call */
+void ForEachDBWrapper(const std::function<void(const CDBWrapper&)>& func);
+// VELES END
+
 #endif // BITCOIN_DBWRAPPER_H
@@ -11,6 +11,8 @@
 #include <masternode/payments.h>
 #include <masternode/sync.h>
 #include <privatesend.h>
+#include <scheduler.h> // VELES
+#include <validation.h> // VELES
 #ifdef ENABLE_WALLET
 #include <privatesend-client.h>
 #endif // ENABLE_WALLET
@@ -18,7 +20,11 @@
 void CDSNotificationInterface::InitializeCurrentBlockTip()
 {
     LOCK(cs_main);
-    UpdatedBlockTip(chainActive.Tip(), NULL, IsInitialBlockDownload());
+    // VELES BEGIN
+    // Managers taking cs_main on the scheduler threads would wait for this one, so they are all updated here
+    //UpdatedBlockTip(chainActive.Tip(), NULL, IsInitialBlockDownload());
+    UpdatedBlockTip(chainActive.Tip(), NULL, IsInitialBlockDownload(), nullptr);
+    // VELES END
 }
 
 void CDSNotificationInterface::AcceptedBlockHeader(const CBlockIndex *pindexNew)
@@ -31,16 +37,38 @@ void CDSNotificationInterface::NotifyHeaderTip(const CBlockIndex *pindexNew, boo
     masternodeSync.NotifyHeaderTip(pindexNew, fInitialDownload, connman);
 }
 
+// VELES BEGIN
+/** func, recording its time as phase */
+static std::function<void ()> Timed(ValidationPhase phase, std::function<void ()> func)
+{
+    return [phase, func] {
+        int64_t nTimeStart = GetTimeMicros();
+        func();
+        RecordValidationPhase(phase, GetTimeMicros() - nTimeStart);
+    };
+}
+
 void CDSNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload, pscheduler);
+}
+
+//void CDSNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+void CDSNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload, CScheduler* pschedulerIn)
+// VELES END
 {
     if (pindexNew == pindexFork) // blocks were disconnected without any new ones
         return;
 
+    int64_t nTime1 = GetTimeMicros(); // VELES
     masternodeSync.UpdatedBlockTip(pindexNew, fInitialDownload, connman);
+    int64_t nTime2 = GetTimeMicros(); RecordValidationPhase(ValidationPhase::TIP_MASTERNODE_SYNC, nTime2 - nTime1); // VELES
 
     if (fInitialDownload)
         return;
 
+    // VELES BEGIN
+    /*
     mnodeman.UpdatedBlockTip(pindexNew);
     CPrivateSend::UpdatedBlockTip(pindexNew);
 #ifdef ENABLE_WALLET
@@ -49,6 +77,22 @@ void CDSNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, con
     instantsend.UpdatedBlockTip(pindexNew);
     mnpayments.UpdatedBlockTip(pindexNew, connman);
     governance.UpdatedBlockTip(pindexNew, connman);
+    */
+    // The managers only share their own locks and cs_main, the payments alone need the masternode
+    // list, with its last paid blocks, updated first. The calling thread takes the masternode list.
+    CSchedulerTaskGroup tasks(pschedulerIn);
+    size_t nMnodeman = tasks.Add(Timed(ValidationPhase::TIP_MNODEMAN, [pindexNew] { mnodeman.UpdatedBlockTip(pindexNew); }));
+    tasks.Add(Timed(ValidationPhase::TIP_PRIVATESEND, [pindexNew] {
+        CPrivateSend::UpdatedBlockTip(pindexNew);
+#ifdef ENABLE_WALLET
+        privateSendClient.UpdatedBlockTip(pindexNew);
+#endif // ENABLE_WALLET
+    }));
+    tasks.Add(Timed(ValidationPhase::TIP_INSTANTSEND, [pindexNew] { instantsend.UpdatedBlockTip(pindexNew); }));
+    tasks.Add(Timed(ValidationPhase::TIP_MNPAYMENTS, [this, pindexNew] { mnpayments.UpdatedBlockTip(pindexNew, connman); }), {nMnodeman});
+    tasks.Add(Timed(ValidationPhase::TIP_GOVERNANCE, [this, pindexNew] { governance.UpdatedBlockTip(pindexNew, connman); }));
+    tasks.Run();
+    // VELES END
 }
 
 void CDSNotificationInterface::SyncTransaction(const CTransaction &tx, const CBlock *pblock)
@@ -56,3 +100,15 @@ void CDSNotificationInterface::SyncTransaction(const CTransaction &tx, const CBl
     instantsend.SyncTransaction(tx, pblock);
     CPrivateSend::SyncTransaction(tx, pblock);
 }
+
+// VELES BEGIN
+void CDSNotificationInterface::BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex, const std::vector<CTransactionRef> &txnConflicted)
+{
+    mnodeman.BlockConnected(*block);
+}
+
+void CDSNotificationInterface::BlockDisconnected(const std::shared_ptr<const CBlock> &block)
+{
+    mnodeman.BlockDisconnected(*block);
+}
+// VELES END
@@ -8,10 +8,16 @@
 
 #include <validationinterface.h>
 
+class CScheduler; // VELES
+
 class CDSNotificationInterface : public CValidationInterface
 {
 public:
-    CDSNotificationInterface(CConnman& connmanIn): connman(connmanIn) {}
+    // VELES BEGIN
+    //CDSNotificationInterface(CConnman& connmanIn): connman(connmanIn) {}
+    /** The managers follow a new tip concurrently on the threads of pschedulerIn, if not null */
+    CDSNotificationInterface(CConnman& connmanIn, CScheduler* pschedulerIn = nullptr): connman(connmanIn), pscheduler(pschedulerIn) {}
+    // VELES END
     virtual ~CDSNotificationInterface() = default;
 
     // a small helper to initialize current block height in sub-modules on startup
@@ -23,9 +29,18 @@ protected:
     void NotifyHeaderTip(const CBlockIndex *pindexNew, bool fInitialDownload) override;
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
     void SyncTransaction(const CTransaction &tx, const CBlock *pblock) override;
+    // VELES BEGIN
+    void BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex, const std::vector<CTransactionRef> &txnConflicted) override;
+    void BlockDisconnected(const std::shared_ptr<const CBlock> &block) override;
+    // VELES END
 
 private:
     CConnman& connman;
+    // VELES BEGIN
+    CScheduler* pscheduler;
+
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload, CScheduler* pschedulerIn);
+    // VELES END
 };
 
 #endif // BITCOIN_DSNOTIFICATIONINTERFACE_H
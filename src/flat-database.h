@@ -37,6 +37,10 @@ private:
     boost::filesystem::path pathDB;
     std::string strFilename;
     std::string strMagicMessage;
+    // VELES BEGIN
+    //! Checksum stored at the end of the file on disk
+    uint256 hashOnDisk;
+    // VELES END
 
     bool Write(const T& objToSave)
     {
@@ -52,20 +56,44 @@ private:
         uint256 hash = Hash(ssObj.begin(), ssObj.end());
         ssObj << hash;
 
+        // VELES BEGIN
+        // Nothing changed since the file was written, leave it alone
+        if (hash == hashOnDisk) {
+            LogPrintf("Unchanged info in %s  %dms\n", strFilename, GetTimeMillis() - nStart);
+            return true;
+        }
+
+        // Write a new file and move it over the old one, a crash while
+        // writing can't leave a truncated file behind
+        boost::filesystem::path pathTmp = pathDB;
+        pathTmp += ".new";
+        // VELES END
+
         // open output file, and associate with CAutoFile
-        FILE *file = fopen(pathDB.string().c_str(), "wb");
+        //FILE *file = fopen(pathDB.string().c_str(), "wb");
+        FILE *file = fopen(pathTmp.string().c_str(), "wb"); // VELES
         CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
         if (fileout.IsNull())
-            return error("%s: Failed to open file %s", __func__, pathDB.string());
+            //return error("%s: Failed to open file %s", __func__, pathDB.string());
+            return error("%s: Failed to open file %s", __func__, pathTmp.string()); // VELES
 
         // Write and commit header, data
         try {
             fileout << ssObj;
+            // VELES BEGIN
+            if (!FileCommit(fileout.Get()))
+                throw std::runtime_error("FileCommit failed");
+            // VELES END
         }
         catch (std::exception &e) {
             return error("%s: Serialize or I/O error - %s", __func__, e.what());
         }
         fileout.fclose();
+        // VELES BEGIN
+        if (!RenameOver(pathTmp, pathDB))
+            return error("%s: Failed to rename %s to %s", __func__, pathTmp.string(), pathDB.string());
+        hashOnDisk = hash;
+        // VELES END
 
         LogPrintf("Written info to %s  %dms\n", strFilename, GetTimeMillis() - nStart);
         LogPrintf("     %s\n", objToSave.ToString());
@@ -73,6 +101,50 @@ private:
         return true;
     }
 
+    // VELES BEGIN
+    /**
+     * Check the magic message and the network magic number at the start of
+     * the file and read the checksum at its end, without reading the data.
+     */
+    ReadResult ReadHeader()
+    {
+        hashOnDisk.SetNull();
+
+        FILE *file = fopen(pathDB.string().c_str(), "rb");
+        CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return FileError;
+
+        unsigned char pchMsgTmp[4];
+        std::string strMagicMessageTmp;
+        try {
+            filein >> strMagicMessageTmp;
+            if (strMagicMessage != strMagicMessageTmp)
+            {
+                error("%s: Invalid magic message", __func__);
+                return IncorrectMagicMessage;
+            }
+
+            filein >> pchMsgTmp;
+            if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
+            {
+                error("%s: Invalid network magic number", __func__);
+                return IncorrectMagicNumber;
+            }
+
+            if (fseek(filein.Get(), -(long)sizeof(uint256), SEEK_END) != 0)
+                throw std::runtime_error("fseek failed");
+            filein >> hashOnDisk;
+        }
+        catch (std::exception &e) {
+            error("%s: Deserialize or I/O error - %s", __func__, e.what());
+            return HashReadError;
+        }
+
+        return Ok;
+    }
+    // VELES END
+
     ReadResult Read(T& objToLoad, bool fDryRun = false)
     {
         //LOCK(objToLoad.cs);
@@ -117,6 +189,7 @@ private:
             error("%s: Checksum mismatch, data corrupted", __func__);
             return IncorrectHash;
         }
+        hashOnDisk = hashIn; // VELES
 
 
         unsigned char pchMsgTmp[4];
@@ -172,10 +245,15 @@ public:
         strMagicMessage = strMagicMessageIn;
     }
 
-    bool Load(T& objToLoad)
+    // VELES BEGIN
+    //bool Load(T& objToLoad)
+    /** Load objToLoad, with fDryRun the caller cleans up the loaded entries later */
+    bool Load(T& objToLoad, bool fDryRun = false)
+    // VELES END
     {
         LogPrintf("Reading info from %s...\n", strFilename);
-        ReadResult readResult = Read(objToLoad);
+        //ReadResult readResult = Read(objToLoad);
+        ReadResult readResult = Read(objToLoad, fDryRun); // VELES
         if (readResult == FileError)
             LogPrintf("Missing file %s, will try to recreate\n", strFilename);
         else if (readResult != Ok)
@@ -199,8 +277,15 @@ public:
         int64_t nStart = GetTimeMillis();
 
         LogPrintf("Verifying %s format...\n", strFilename);
-        T tmpObjToLoad;
-        ReadResult readResult = Read(tmpObjToLoad, true);
+        //T tmpObjToLoad;
+        //ReadResult readResult = Read(tmpObjToLoad, true);
+        // VELES BEGIN
+        // Loading the whole old file only to validate it was as slow as the
+        // dump itself, its header tells whether it is ours to overwrite
+        //ReadResult readResult = ReadHeader();
+        // The file written by the previous dump is known to be ours
+        ReadResult readResult = hashOnDisk.IsNull() ? ReadHeader() : Ok;
+        // VELES END
 
         // there was an error and it was not an error on file opening => do not proceed
         if (readResult == FileError)
@@ -139,6 +139,7 @@ bool CGovernanceTriggerManager::AddNewTrigger(uint256 nHash)
 
     DBG( cout << "CGovernanceTriggerManager::AddNewTrigger: Inserting trigger" << endl; );
     mapTrigger.insert(std::make_pair(nHash, pSuperblock));
+    InvalidateBestSuperblocks(); // VELES
 
     DBG( cout << "CGovernanceTriggerManager::AddNewTrigger: End" << endl; );
 
@@ -209,6 +210,7 @@ void CGovernanceTriggerManager::CleanAndRemove()
                             LogPrint(BCLog::GOBJECT, "CGovernanceTriggerManager::CleanAndRemove -- Expiring outdated object: %s\n", pgovobj->GetHash().ToString());
                             pgovobj->fExpired = true;
                             pgovobj->nDeletionTime = GetAdjustedTime();
+                            governance.ScheduleDeletion(pgovobj->GetHash(), pgovobj->nDeletionTime); // VELES
                         }
                     }
                 }
@@ -231,6 +233,7 @@ void CGovernanceTriggerManager::CleanAndRemove()
                );
             LogPrint(BCLog::GOBJECT, "CGovernanceTriggerManager::CleanAndRemove -- Removing trigger object\n");
             mapTrigger.erase(it++);
+            InvalidateBestSuperblocks(); // VELES
         }
         else  {
             ++it;
@@ -350,6 +353,23 @@ bool CSuperblockManager::GetBestSuperblock(CSuperblock_sptr& pSuperblockRet, int
     }
 
     AssertLockHeld(governance.cs);
+
+    // VELES BEGIN
+    // Resolved once per height until the triggers or their votes change
+    CGovernanceTriggerManager::height_superblock_m_t::const_iterator itBest = triggerman.mapBestSuperblocks.find(nBlockHeight);
+    if(itBest != triggerman.mapBestSuperblocks.end()) {
+        const CSuperblock_sptr& pSuperblockBest = itBest->second;
+        if(!pSuperblockBest) {
+            return false;
+        }
+        // the object of the trigger may have been erased since
+        if(pSuperblockBest->GetGovernanceObject()) {
+            pSuperblockRet = pSuperblockBest;
+            return true;
+        }
+    }
+    // VELES END
+
     std::vector<CSuperblock_sptr> vecTriggers = triggerman.GetActiveTriggers();
     int nYesCount = 0;
 
@@ -382,6 +402,8 @@ bool CSuperblockManager::GetBestSuperblock(CSuperblock_sptr& pSuperblockRet, int
         }
     }
 
+    triggerman.mapBestSuperblocks[nBlockHeight] = nYesCount > 0 ? pSuperblockRet : CSuperblock_sptr(); // VELES
+
     return nYesCount > 0;
 }
 
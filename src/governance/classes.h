@@ -51,12 +51,25 @@ private:
 
     trigger_m_t mapTrigger;
 
+    // VELES BEGIN
+    typedef std::map<int, CSuperblock_sptr> height_superblock_m_t;
+
+    /// Best superblock found for each superblock height, null when there was none
+    height_superblock_m_t mapBestSuperblocks;
+    // VELES END
+
     std::vector<CSuperblock_sptr> GetActiveTriggers();
     bool AddNewTrigger(uint256 nHash);
     void CleanAndRemove();
 
 public:
-    CGovernanceTriggerManager() : mapTrigger() {}
+    //CGovernanceTriggerManager() : mapTrigger() {}
+    CGovernanceTriggerManager() : mapTrigger(), mapBestSuperblocks() {} // VELES
+
+    // VELES BEGIN
+    /// Forget the best superblocks found so far, called when a trigger or its votes change
+    void InvalidateBestSuperblocks() { mapBestSuperblocks.clear(); }
+    // VELES END
 };
 
 /**
@@ -3,6 +3,7 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <core_memusage.h> // VELES
 #include <governance/governance.h>
 #include <governance/object.h>
 #include <governance/vote.h>
@@ -15,6 +16,7 @@
 #include <netfulfilledman.h>
 #include <netmessagemaker.h>
 #include <util/system.h>
+#include <validationinterface.h> // VELES
 
 // FXTC BEGIN
 extern void Misbehaving(NodeId nodeid, int howmuch, const std::string& message="");
@@ -43,6 +45,7 @@ CGovernanceManager::CGovernanceManager()
       mapLastMasternodeObject(),
       setRequestedObjects(),
       fRateChecksEnabled(true),
+      nMaxVoteCacheUsage(0), // VELES
       cs()
 {}
 
@@ -135,13 +138,14 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, const std::string& strComm
         }
 
         if(nProp == uint256()) {
-            if(netfulfilledman.HasFulfilledRequest(pfrom->addr, NetMsgType::MNGOVERNANCESYNC)) {
+            if(netfulfilledman.HasFulfilledRequest(pfrom->addr, FULFILLED_MNGOVERNANCESYNC)) {
                 // Asking for the whole list multiple times in a short period of time is no good
                 LogPrint(BCLog::GOBJECT, "MNGOVERNANCESYNC -- peer already asked me for the list\n");
+                LOCK(cs_main); // VELES
                 Misbehaving(pfrom->GetId(), 20);
                 return;
             }
-            netfulfilledman.AddFulfilledRequest(pfrom->addr, NetMsgType::MNGOVERNANCESYNC);
+            netfulfilledman.AddFulfilledRequest(pfrom->addr, FULFILLED_MNGOVERNANCESYNC);
         }
 
         Sync(pfrom, nProp, filter, connman);
@@ -159,7 +163,8 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, const std::string& strComm
 
         uint256 nHash = govobj.GetHash();
 
-        pfrom->setAskFor.erase(nHash);
+        //pfrom->setAskFor.erase(nHash);
+        pfrom->RemoveAskFor(nHash); // VELES
 
         if(!masternodeSync.IsMasternodeListSynced()) {
             LogPrint(BCLog::GOBJECT, "MNGOVERNANCEOBJECT -- masternode list not synced\n");
@@ -243,7 +248,8 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, const std::string& strComm
 
         uint256 nHash = vote.GetHash();
 
-        pfrom->setAskFor.erase(nHash);
+        //pfrom->setAskFor.erase(nHash);
+        pfrom->RemoveAskFor(nHash); // VELES
 
         // Ignore such messages until masternode list is synced
         if(!masternodeSync.IsMasternodeListSynced()) {
@@ -270,6 +276,7 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, const std::string& strComm
         else {
             LogPrint(BCLog::GOBJECT, "MNGOVERNANCEOBJECTVOTE -- Rejected vote, error = %s\n", exception.what());
             if((exception.GetNodePenalty() != 0) && masternodeSync.IsSynced()) {
+                LOCK(cs_main); // VELES
                 Misbehaving(pfrom->GetId(), exception.GetNodePenalty());
             }
             return;
@@ -298,6 +305,7 @@ void CGovernanceManager::CheckOrphanVotes(CGovernanceObject& govobj, CGovernance
         else if(govobj.ProcessVote(NULL, vote, exception, connman)) {
             vote.Relay(connman);
             fRemove = true;
+            setDirtyObjects.insert(nHash); // VELES
         }
         if(fRemove) {
             mapOrphanVotes.Erase(nHash, pairVote);
@@ -357,6 +365,11 @@ void CGovernanceManager::AddGovernanceObject(CGovernanceObject& govobj, CConnman
 
     // INSERT INTO OUR GOVERNANCE OBJECT MEMORY
     mapObjects.insert(std::make_pair(nHash, govobj));
+    //mapObjectsByType[govobj.GetObjectType()].insert(std::make_pair(govobj.GetCreationTime(), nHash)); // VELES
+    // VELES BEGIN
+    mapObjectsByType[govobj.GetObjectType()].insert(std::make_pair(govobj.GetCreationTime(), nHash));
+    setDirtyObjects.insert(nHash);
+    // VELES END
 
     // SHOULD WE ADD THIS OBJECT TO ANY OTHER MANANGERS?
 
@@ -381,6 +394,7 @@ void CGovernanceManager::AddGovernanceObject(CGovernanceObject& govobj, CConnman
 
     LogPrintf("AddGovernanceObject -- %s new, received form %s\n", strHash, pfrom? pfrom->GetAddrName() : "NULL");
     govobj.Relay(connman);
+    GetMainSignals().NotifyGovernanceObject(nHash); // VELES
 
     // Update the rate buffer
     MasternodeRateUpdate(govobj);
@@ -418,6 +432,7 @@ bool CGovernanceManager::UpdateCurrentWatchdog(CGovernanceObject& watchdogNew)
             if(it->second.nDeletionTime == 0) {
                 it->second.nDeletionTime = nNow;
             }
+            ScheduleDeletion(it->first, it->second.nDeletionTime); // VELES
         }
         nHashWatchdogCurrent = watchdogNew.GetHash();
         nTimeWatchdogCurrent = watchdogNew.GetCreationTime();
@@ -429,6 +444,86 @@ bool CGovernanceManager::UpdateCurrentWatchdog(CGovernanceObject& watchdogNew)
     return fAccept;
 }
 
+// VELES BEGIN
+void CGovernanceManager::ScheduleDeletion(const uint256& nHash, int64_t nDeletionTime)
+{
+    LOCK(cs);
+    setObjectsToDelete.insert(std::make_pair(nDeletionTime + GOVERNANCE_DELETION_DELAY, nHash));
+}
+// VELES END
+
+size_t CGovernanceManager::DynamicMemoryUsage() const
+{
+    LOCK(cs);
+
+    size_t nUsage = memusage::DynamicUsage(mapObjects);
+    for (const auto& pair : mapObjects) {
+        nUsage += pair.second.DynamicMemoryUsage();
+    }
+    nUsage += memusage::DynamicUsage(mapObjectsByType);
+    for (const auto& pair : mapObjectsByType) {
+        nUsage += memusage::DynamicUsage(pair.second);
+    }
+    nUsage += memusage::DynamicUsage(setDirtyObjects) + memusage::DynamicUsage(setObjectsToDelete);
+    nUsage += memusage::DynamicUsage(mapErasedGovernanceObjects);
+    nUsage += memusage::DynamicUsage(mapMasternodeOrphanObjects);
+    for (const auto& pair : mapMasternodeOrphanObjects) {
+        nUsage += pair.second.first.DynamicMemoryUsage();
+    }
+    nUsage += memusage::DynamicUsage(mapMasternodeOrphanCounter);
+    nUsage += memusage::DynamicUsage(mapPostponedObjects);
+    for (const auto& pair : mapPostponedObjects) {
+        nUsage += pair.second.DynamicMemoryUsage();
+    }
+    nUsage += memusage::DynamicUsage(setAdditionalRelayObjects) + memusage::DynamicUsage(mapWatchdogObjects);
+    nUsage += mapVoteToObject.DynamicMemoryUsage();
+    nUsage += mapInvalidVotes.DynamicMemoryUsage();
+    for (const auto& item : mapInvalidVotes.GetItemList()) {
+        nUsage += item.value.DynamicMemoryUsage();
+    }
+    nUsage += mapOrphanVotes.DynamicMemoryUsage();
+    for (const auto& item : mapOrphanVotes.GetItemList()) {
+        nUsage += item.value.first.DynamicMemoryUsage();
+    }
+    nUsage += memusage::DynamicUsage(mapLastMasternodeObject);
+    nUsage += memusage::DynamicUsage(setRequestedObjects) + memusage::DynamicUsage(setRequestedVotes);
+    return nUsage;
+}
+
+void CGovernanceManager::SetMaxVoteCacheUsage(size_t nMaxVoteCacheUsageIn)
+{
+    LOCK(cs);
+    nMaxVoteCacheUsage = nMaxVoteCacheUsageIn;
+    LimitVoteCaches();
+}
+
+void CGovernanceManager::LimitVoteCaches()
+{
+    AssertLockHeld(cs);
+
+    // The invalid and orphan votes share the limit, every vote takes a cache item and a signature.
+    // The caches drop their oldest votes as new ones come in once they hold as many as they may.
+    static const size_t nVoteUsage = vote_mcache_t::list_t::ItemUsage() + memusage::MallocUsage(CPubKey::COMPACT_SIGNATURE_SIZE);
+    size_t nMaxVotes = MAX_CACHE_SIZE;
+    if(nMaxVoteCacheUsage != 0) {
+        nMaxVotes = std::max<size_t>(1, std::min<size_t>(MAX_CACHE_SIZE, nMaxVoteCacheUsage / 2 / nVoteUsage));
+    }
+    mapInvalidVotes.SetMaxSize(nMaxVotes);
+    mapOrphanVotes.SetMaxSize(nMaxVotes);
+    size_t nEvicted = 0;
+    while(mapInvalidVotes.GetSize() > nMaxVotes) {
+        mapInvalidVotes.PruneLast();
+        nEvicted++;
+    }
+    while(mapOrphanVotes.GetSize() > nMaxVotes) {
+        mapOrphanVotes.PruneLast();
+        nEvicted++;
+    }
+    if(nEvicted > 0) {
+        LogPrint(BCLog::GOBJECT, "CGovernanceManager::LimitVoteCaches -- Evicted %d oldest invalid and orphan votes\n", nEvicted);
+    }
+}
+
 void CGovernanceManager::UpdateCachesAndClean()
 {
     LogPrint(BCLog::GOBJECT, "CGovernanceManager::UpdateCachesAndClean\n");
@@ -453,6 +548,7 @@ void CGovernanceManager::UpdateCachesAndClean()
                     if(it2->second.nDeletionTime == 0) {
                         it2->second.nDeletionTime = nNow;
                     }
+                    ScheduleDeletion(it2->first, it2->second.nDeletionTime); // VELES
                 }
                 if(it->first == nHashWatchdogCurrent) {
                     nHashWatchdogCurrent = uint256();
@@ -472,30 +568,110 @@ void CGovernanceManager::UpdateCachesAndClean()
         }
         it->second.ClearMasternodeVotes();
         it->second.fDirtyCache = true;
+        setDirtyObjects.insert(it->first); // VELES
     }
 
     ScopedLockBool guard(cs, fRateChecksEnabled, false);
 
+//    // UPDATE CACHE FOR EACH OBJECT THAT IS FLAGGED DIRTYCACHE=TRUE
+//
+//    object_m_it it = mapObjects.begin();
+//
+//    // Clean up any expired or invalid triggers
+//    triggerman.CleanAndRemove();
+//
+//    while(it != mapObjects.end())
+//    {
+//        CGovernanceObject* pObj = &((*it).second);
+//
+//        if(!pObj) {
+//            ++it;
+//            continue;
+//        }
+//
+//        uint256 nHash = it->first;
+//        std::string strHash = nHash.ToString();
+//
+//        // IF CACHE IS NOT DIRTY, WHY DO THIS?
+//        if(pObj->IsSetDirtyCache()) {
+//            // UPDATE LOCAL VALIDITY AGAINST CRYPTO DATA
+//            pObj->UpdateLocalValidity();
+//
+//            // UPDATE SENTINEL SIGNALING VARIABLES
+//            pObj->UpdateSentinelVariables();
+//        }
+//
+//        if(pObj->IsSetCachedDelete() && (nHash == nHashWatchdogCurrent)) {
+//            nHashWatchdogCurrent = uint256();
+//        }
+//
+//        // IF DELETE=TRUE, THEN CLEAN THE MESS UP!
+//
+//        int64_t nTimeSinceDeletion = GetAdjustedTime() - pObj->GetDeletionTime();
+//
+//        LogPrint(BCLog::GOBJECT, "CGovernanceManager::UpdateCachesAndClean -- Checking object for deletion: %s, deletion time = %d, time since deletion = %d, delete flag = %d, expired flag = %d\n",
+//                 strHash, pObj->GetDeletionTime(), nTimeSinceDeletion, pObj->IsSetCachedDelete(), pObj->IsSetExpired());
+//
+//        if((pObj->IsSetCachedDelete() || pObj->IsSetExpired()) &&
+//           (nTimeSinceDeletion >= GOVERNANCE_DELETION_DELAY)) {
+//            LogPrintf("CGovernanceManager::UpdateCachesAndClean -- erase obj %s\n", (*it).first.ToString());
+//            mnodeman.RemoveGovernanceObject(pObj->GetHash());
+//
+//            // Remove vote references
+//            const object_ref_cache_t::list_t& listItems = mapVoteToObject.GetItemList();
+//            object_ref_cache_t::list_cit lit = listItems.begin();
+//            while(lit != listItems.end()) {
+//                if(lit->value == pObj) {
+//                    uint256 nKey = lit->key;
+//                    ++lit;
+//                    mapVoteToObject.Erase(nKey);
+//                }
+//                else {
+//                    ++lit;
+//                }
+//            }
+//
+//            int64_t nSuperblockCycleSeconds = Params().GetConsensus().nSuperblockCycle * Params().GetConsensus().nPowTargetSpacing;
+//            int64_t nTimeExpired = pObj->GetCreationTime() + 2 * nSuperblockCycleSeconds + GOVERNANCE_DELETION_DELAY;
+//
+//            if(pObj->GetObjectType() == GOVERNANCE_OBJECT_WATCHDOG) {
+//                mapWatchdogObjects.erase(nHash);
+//            } else if(pObj->GetObjectType() != GOVERNANCE_OBJECT_TRIGGER) {
+//                // keep hashes of deleted proposals forever
+//                nTimeExpired = std::numeric_limits<int64_t>::max();
+//            }
+//
+//            mapErasedGovernanceObjects.insert(std::make_pair(nHash, nTimeExpired));
+//            // VELES BEGIN
+//            object_type_time_m_t::iterator itType = mapObjectsByType.find(pObj->GetObjectType());
+//            if(itType != mapObjectsByType.end()) {
+//                itType->second.erase(std::make_pair(pObj->GetCreationTime(), nHash));
+//                if(itType->second.empty()) {
+//                    mapObjectsByType.erase(itType);
+//                }
+//            }
+//            // VELES END
+//            mapObjects.erase(it++);
+//        } else {
+//            ++it;
+//        }
+//    }
+    // VELES BEGIN
     // UPDATE CACHE FOR EACH OBJECT THAT IS FLAGGED DIRTYCACHE=TRUE
 
-    object_m_it it = mapObjects.begin();
-
     // Clean up any expired or invalid triggers
     triggerman.CleanAndRemove();
 
-    while(it != mapObjects.end())
-    {
-        CGovernanceObject* pObj = &((*it).second);
-
-        if(!pObj) {
-            ++it;
+    // Only objects that got votes, lost masternode votes or were just added can have changed flags
+    hash_s_t setStillDirty;
+    for(hash_s_it itDirty = setDirtyObjects.begin(); itDirty != setDirtyObjects.end(); ++itDirty) {
+        object_m_it it = mapObjects.find(*itDirty);
+        if(it == mapObjects.end()) {
             continue;
         }
 
-        uint256 nHash = it->first;
-        std::string strHash = nHash.ToString();
+        CGovernanceObject* pObj = &((*it).second);
 
-        // IF CACHE IS NOT DIRTY, WHY DO THIS?
         if(pObj->IsSetDirtyCache()) {
             // UPDATE LOCAL VALIDITY AGAINST CRYPTO DATA
             pObj->UpdateLocalValidity();
@@ -504,52 +680,88 @@ void CGovernanceManager::UpdateCachesAndClean()
             pObj->UpdateSentinelVariables();
         }
 
-        if(pObj->IsSetCachedDelete() && (nHash == nHashWatchdogCurrent)) {
+        if(pObj->IsSetCachedDelete() && (it->first == nHashWatchdogCurrent)) {
             nHashWatchdogCurrent = uint256();
         }
 
-        // IF DELETE=TRUE, THEN CLEAN THE MESS UP!
+        // sentinel variables are not updated while no masternode is enabled
+        if(pObj->IsSetDirtyCache()) {
+            setStillDirty.insert(it->first);
+        }
+    }
+    setDirtyObjects.swap(setStillDirty);
+
+    // IF DELETE=TRUE, THEN CLEAN THE MESS UP!
+
+    // Only the objects whose deletion delay has passed are looked at
+    while(!setObjectsToDelete.empty() && setObjectsToDelete.begin()->first <= nNow) {
+        uint256 nHash = setObjectsToDelete.begin()->second;
+        setObjectsToDelete.erase(setObjectsToDelete.begin());
+
+        object_m_it it = mapObjects.find(nHash);
+        if(it == mapObjects.end()) {
+            continue;
+        }
+
+        CGovernanceObject* pObj = &((*it).second);
 
-        int64_t nTimeSinceDeletion = GetAdjustedTime() - pObj->GetDeletionTime();
+        int64_t nTimeSinceDeletion = nNow - pObj->GetDeletionTime();
 
         LogPrint(BCLog::GOBJECT, "CGovernanceManager::UpdateCachesAndClean -- Checking object for deletion: %s, deletion time = %d, time since deletion = %d, delete flag = %d, expired flag = %d\n",
-                 strHash, pObj->GetDeletionTime(), nTimeSinceDeletion, pObj->IsSetCachedDelete(), pObj->IsSetExpired());
-
-        if((pObj->IsSetCachedDelete() || pObj->IsSetExpired()) &&
-           (nTimeSinceDeletion >= GOVERNANCE_DELETION_DELAY)) {
-            LogPrintf("CGovernanceManager::UpdateCachesAndClean -- erase obj %s\n", (*it).first.ToString());
-            mnodeman.RemoveGovernanceObject(pObj->GetHash());
-
-            // Remove vote references
-            const object_ref_cache_t::list_t& listItems = mapVoteToObject.GetItemList();
-            object_ref_cache_t::list_cit lit = listItems.begin();
-            while(lit != listItems.end()) {
-                if(lit->value == pObj) {
-                    uint256 nKey = lit->key;
-                    ++lit;
-                    mapVoteToObject.Erase(nKey);
-                }
-                else {
-                    ++lit;
-                }
-            }
+                 nHash.ToString(), pObj->GetDeletionTime(), nTimeSinceDeletion, pObj->IsSetCachedDelete(), pObj->IsSetExpired());
+
+        if(!pObj->IsSetCachedDelete() && !pObj->IsSetExpired()) {
+            continue;
+        }
+
+        if(nTimeSinceDeletion < GOVERNANCE_DELETION_DELAY) {
+            // the deletion time was moved forward after the object was queued
+            setObjectsToDelete.insert(std::make_pair(pObj->GetDeletionTime() + GOVERNANCE_DELETION_DELAY, nHash));
+            continue;
+        }
 
-            int64_t nSuperblockCycleSeconds = Params().GetConsensus().nSuperblockCycle * Params().GetConsensus().nPowTargetSpacing;
-            int64_t nTimeExpired = pObj->GetCreationTime() + 2 * nSuperblockCycleSeconds + GOVERNANCE_DELETION_DELAY;
+        LogPrintf("CGovernanceManager::UpdateCachesAndClean -- erase obj %s\n", nHash.ToString());
+        mnodeman.RemoveGovernanceObject(pObj->GetHash());
 
-            if(pObj->GetObjectType() == GOVERNANCE_OBJECT_WATCHDOG) {
-                mapWatchdogObjects.erase(nHash);
-            } else if(pObj->GetObjectType() != GOVERNANCE_OBJECT_TRIGGER) {
-                // keep hashes of deleted proposals forever
-                nTimeExpired = std::numeric_limits<int64_t>::max();
+        if(nHash == nHashWatchdogCurrent) {
+            nHashWatchdogCurrent = uint256();
+        }
+
+        // Remove vote references
+        const object_ref_cache_t::list_t& listItems = mapVoteToObject.GetItemList();
+        object_ref_cache_t::list_cit lit = listItems.begin();
+        while(lit != listItems.end()) {
+            if(lit->value == pObj) {
+                uint256 nKey = lit->key;
+                ++lit;
+                mapVoteToObject.Erase(nKey);
+            }
+            else {
+                ++lit;
             }
+        }
 
-            mapErasedGovernanceObjects.insert(std::make_pair(nHash, nTimeExpired));
-            mapObjects.erase(it++);
-        } else {
-            ++it;
+        int64_t nSuperblockCycleSeconds = Params().GetConsensus().nSuperblockCycle * Params().GetConsensus().nPowTargetSpacing;
+        int64_t nTimeExpired = pObj->GetCreationTime() + 2 * nSuperblockCycleSeconds + GOVERNANCE_DELETION_DELAY;
+
+        if(pObj->GetObjectType() == GOVERNANCE_OBJECT_WATCHDOG) {
+            mapWatchdogObjects.erase(nHash);
+        } else if(pObj->GetObjectType() != GOVERNANCE_OBJECT_TRIGGER) {
+            // keep hashes of deleted proposals forever
+            nTimeExpired = std::numeric_limits<int64_t>::max();
+        }
+
+        mapErasedGovernanceObjects.insert(std::make_pair(nHash, nTimeExpired));
+        object_type_time_m_t::iterator itType = mapObjectsByType.find(pObj->GetObjectType());
+        if(itType != mapObjectsByType.end()) {
+            itType->second.erase(std::make_pair(pObj->GetCreationTime(), nHash));
+            if(itType->second.empty()) {
+                mapObjectsByType.erase(itType);
+            }
         }
+        mapObjects.erase(it);
     }
+    // VELES END
 
     // forget about expired deleted objects
     hash_time_m_it s_it = mapErasedGovernanceObjects.begin();
@@ -560,6 +772,9 @@ void CGovernanceManager::UpdateCachesAndClean()
             ++s_it;
     }
 
+    // the limits of the caches loaded from disk are replaced
+    LimitVoteCaches(); // VELES
+
     LogPrintf("CGovernanceManager::UpdateCachesAndClean -- %s\n", ToString());
 }
 
@@ -627,34 +842,67 @@ std::vector<CGovernanceVote> CGovernanceManager::GetCurrentVotes(const uint256&
     return vecResult;
 }
 
-std::vector<CGovernanceObject*> CGovernanceManager::GetAllNewerThan(int64_t nMoreThanTime)
+//std::vector<CGovernanceObject*> CGovernanceManager::GetAllNewerThan(int64_t nMoreThanTime)
+//{
+//    LOCK(cs);
+//
+//    std::vector<CGovernanceObject*> vGovObjs;
+//
+//    object_m_it it = mapObjects.begin();
+//    while(it != mapObjects.end())
+//    {
+//        // IF THIS OBJECT IS OLDER THAN TIME, CONTINUE
+//
+//        if((*it).second.GetCreationTime() < nMoreThanTime) {
+//            ++it;
+//            continue;
+//        }
+//
+//        // ADD GOVERNANCE OBJECT TO LIST
+//
+//        CGovernanceObject* pGovObj = &((*it).second);
+//        vGovObjs.push_back(pGovObj);
+//
+//        // NEXT
+//
+//        ++it;
+//    }
+//
+//    return vGovObjs;
+//}
+
+// VELES BEGIN
+std::vector<CGovernanceObject*> CGovernanceManager::GetAllNewerThan(int64_t nMoreThanTime, int nObjectType)
 {
     LOCK(cs);
 
-    std::vector<CGovernanceObject*> vGovObjs;
-
-    object_m_it it = mapObjects.begin();
-    while(it != mapObjects.end())
-    {
-        // IF THIS OBJECT IS OLDER THAN TIME, CONTINUE
-
-        if((*it).second.GetCreationTime() < nMoreThanTime) {
-            ++it;
+    // Walk the creation time index of the requested types only
+    std::vector<std::pair<uint256, CGovernanceObject*> > vecFound;
+    for(object_type_time_m_t::iterator itType = mapObjectsByType.begin(); itType != mapObjectsByType.end(); ++itType) {
+        if(nObjectType != -1 && itType->first != nObjectType) {
             continue;
         }
+        object_time_s_t::const_iterator it = itType->second.lower_bound(std::make_pair(nMoreThanTime, uint256()));
+        for(; it != itType->second.end(); ++it) {
+            object_m_it itObj = mapObjects.find(it->second);
+            if(itObj != mapObjects.end()) {
+                vecFound.push_back(std::make_pair(it->second, &itObj->second));
+            }
+        }
+    }
 
-        // ADD GOVERNANCE OBJECT TO LIST
-
-        CGovernanceObject* pGovObj = &((*it).second);
-        vGovObjs.push_back(pGovObj);
-
-        // NEXT
+    // same order as the walk of mapObjects used to return
+    std::sort(vecFound.begin(), vecFound.end());
 
-        ++it;
+    std::vector<CGovernanceObject*> vGovObjs;
+    vGovObjs.reserve(vecFound.size());
+    for(size_t i = 0; i < vecFound.size(); ++i) {
+        vGovObjs.push_back(vecFound[i].second);
     }
 
     return vGovObjs;
 }
+// VELES END
 
 //
 // Sort by votes, if there's a tie sort by their feeHash TX
@@ -755,8 +1003,17 @@ void CGovernanceManager::Sync(CNode* pfrom, const uint256& nProp, const CBloomFi
 
     LogPrint(BCLog::GOBJECT, "CGovernanceManager::Sync -- syncing to peer=%d, nProp = %s\n", pfrom->GetId(), nProp.ToString());
 
+    // VELES BEGIN
+    // Only a snapshot of the hashes and candidate votes is taken under cs.
+    // The vote checks run without cs_main, and the inventory is trickled
+    // to the peer from vInventoryToSend by SendMessages.
+    std::vector<uint256> vecObjHashes;
+    std::vector<std::pair<uint256, CGovernanceVote> > vecVoteCandidates;
+    // VELES END
+
     {
-        LOCK2(cs_main, cs);
+        //LOCK2(cs_main, cs);
+        LOCK(cs); // VELES
 
         if(nProp == uint256()) {
             // all valid objects, no votes
@@ -774,8 +1031,9 @@ void CGovernanceManager::Sync(CNode* pfrom, const uint256& nProp, const CBloomFi
 
                 // Push the inventory budget proposal message over to the other client
                 LogPrint(BCLog::GOBJECT, "CGovernanceManager::Sync -- syncing govobj: %s, peer=%d\n", strHash, pfrom->GetId());
-                pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT, it->first));
-                ++nObjCount;
+                //pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT, it->first));
+                //++nObjCount;
+                vecObjHashes.push_back(it->first); // VELES
             }
         } else {
             // single valid object and its valid votes
@@ -797,23 +1055,47 @@ void CGovernanceManager::Sync(CNode* pfrom, const uint256& nProp, const CBloomFi
 
             // Push the inventory budget proposal message over to the other client
             LogPrint(BCLog::GOBJECT, "CGovernanceManager::Sync -- syncing govobj: %s, peer=%d\n", strHash, pfrom->GetId());
-            pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT, it->first));
-            ++nObjCount;
+            //pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT, it->first));
+            //++nObjCount;
+            vecObjHashes.push_back(it->first); // VELES
 
-            std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
+            //std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
+            const std::vector<CGovernanceVote>& vecVotes = govobj.GetVoteFile().GetVotes(); // VELES
             for(size_t i = 0; i < vecVotes.size(); ++i) {
-                if(filter.contains(vecVotes[i].GetHash())) {
-                    continue;
-                }
-                if(!vecVotes[i].IsValid(true)) {
+                //if(filter.contains(vecVotes[i].GetHash())) {
+                //    continue;
+                //}
+                //if(!vecVotes[i].IsValid(true)) {
+                //    continue;
+                //}
+                //pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT_VOTE, vecVotes[i].GetHash()));
+                //++nVoteCount;
+                // VELES BEGIN
+                uint256 nVoteHash = vecVotes[i].GetHash();
+                if(filter.contains(nVoteHash)) {
                     continue;
                 }
-                pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT_VOTE, vecVotes[i].GetHash()));
-                ++nVoteCount;
+                vecVoteCandidates.push_back(std::make_pair(nVoteHash, vecVotes[i]));
+                // VELES END
             }
         }
     }
 
+    // VELES BEGIN
+    for(const uint256& nHash : vecObjHashes) {
+        pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT, nHash));
+        ++nObjCount;
+    }
+
+    for(const auto& pairVote : vecVoteCandidates) {
+        if(!pairVote.second.IsValid(true)) {
+            continue;
+        }
+        pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT_VOTE, pairVote.first));
+        ++nVoteCount;
+    }
+    // VELES END
+
     connman.PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_GOVOBJ, nObjCount));
     connman.PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_GOVOBJ_VOTE, nVoteCount));
     LogPrintf("CGovernanceManager::Sync -- sent %d objects and %d votes to peer=%d\n", nObjCount, nVoteCount, pfrom->GetId());
@@ -979,6 +1261,7 @@ bool CGovernanceManager::ProcessVote(CNode* pfrom, const CGovernanceVote& vote,
     bool fOk = govobj.ProcessVote(pfrom, vote, exception, connman);
     if(fOk) {
         mapVoteToObject.Insert(nHashVote, &govobj);
+        setDirtyObjects.insert(nHashGovobj); // VELES
 
         if(govobj.GetObjectType() == GOVERNANCE_OBJECT_WATCHDOG) {
             mnodeman.UpdateWatchdogVoteTime(vote.GetMasternodeOutpoint());
@@ -1127,7 +1410,8 @@ void CGovernanceManager::RequestGovernanceObject(CNode* pfrom, const uint256& nH
 
         if(pObj) {
             filter = CBloomFilter(Params().GetConsensus().nGovernanceFilterElements, GOVERNANCE_FILTER_FP_RATE, GetRandInt(999999), BLOOM_UPDATE_ALL);
-            std::vector<CGovernanceVote> vecVotes = pObj->GetVoteFile().GetVotes();
+            //std::vector<CGovernanceVote> vecVotes = pObj->GetVoteFile().GetVotes();
+            const std::vector<CGovernanceVote>& vecVotes = pObj->GetVoteFile().GetVotes(); // VELES
             nVoteCount = vecVotes.size();
             for(size_t i = 0; i < vecVotes.size(); ++i) {
                 filter.insert(vecVotes[i].GetHash());
@@ -1147,18 +1431,118 @@ int CGovernanceManager::RequestGovernanceObjectVotes(CNode* pnode, CConnman& con
     return RequestGovernanceObjectVotes(vNodesCopy, connman);
 }
 
+//int CGovernanceManager::RequestGovernanceObjectVotes(const std::vector<CNode*>& vNodesCopy, CConnman& connman)
+//{
+//    static std::map<uint256, std::map<CService, int64_t> > mapAskedRecently;
+//
+//    if(vNodesCopy.empty()) return -1;
+//
+//    int64_t nNow = GetTime();
+//    int nTimeout = 60 * 60;
+//    size_t nPeersPerHashMax = 3;
+//
+//    std::vector<CGovernanceObject*> vpGovObjsTmp;
+//    std::vector<CGovernanceObject*> vpGovObjsTriggersTmp;
+//
+//    // This should help us to get some idea about an impact this can bring once deployed on mainnet.
+//    // Testnet is ~40 times smaller in masternode count, but only ~1000 masternodes usually vote,
+//    // so 1 obj on mainnet == ~10 objs or ~1000 votes on testnet. However we want to test a higher
+//    // number of votes to make sure it's robust enough, so aim at 2000 votes per masternode per request.
+//    // On mainnet nMaxObjRequestsPerNode is always set to 1.
+//    int nMaxObjRequestsPerNode = 1;
+//    size_t nProjectedVotes = 2000;
+//    if(Params().NetworkIDString() != CBaseChainParams::MAIN) {
+//        nMaxObjRequestsPerNode = std::max(1, int(nProjectedVotes / std::max(1, mnodeman.size())));
+//    }
+//
+//    {
+//        LOCK2(cs_main, cs);
+//
+//        if(mapObjects.empty()) return -2;
+//
+//        for(object_m_it it = mapObjects.begin(); it != mapObjects.end(); ++it) {
+//            if(mapAskedRecently.count(it->first)) {
+//                std::map<CService, int64_t>::iterator it1 = mapAskedRecently[it->first].begin();
+//                while(it1 != mapAskedRecently[it->first].end()) {
+//                    if(it1->second < nNow) {
+//                        mapAskedRecently[it->first].erase(it1++);
+//                    } else {
+//                        ++it1;
+//                    }
+//                }
+//                if(mapAskedRecently[it->first].size() >= nPeersPerHashMax) continue;
+//            }
+//            if(it->second.nObjectType == GOVERNANCE_OBJECT_TRIGGER) {
+//                vpGovObjsTriggersTmp.push_back(&(it->second));
+//            } else {
+//                vpGovObjsTmp.push_back(&(it->second));
+//            }
+//        }
+//    }
+//
+//    LogPrint(BCLog::GOBJECT, "CGovernanceManager::RequestGovernanceObjectVotes -- start: vpGovObjsTriggersTmp %d vpGovObjsTmp %d mapAskedRecently %d\n",
+//                vpGovObjsTriggersTmp.size(), vpGovObjsTmp.size(), mapAskedRecently.size());
+//
+//    InsecureRand insecureRand;
+//    // shuffle pointers
+//    std::random_shuffle(vpGovObjsTriggersTmp.begin(), vpGovObjsTriggersTmp.end(), insecureRand);
+//    std::random_shuffle(vpGovObjsTmp.begin(), vpGovObjsTmp.end(), insecureRand);
+//
+//    for (int i = 0; i < nMaxObjRequestsPerNode; ++i) {
+//        uint256 nHashGovobj;
+//
+//        // ask for triggers first
+//        if(vpGovObjsTriggersTmp.size()) {
+//            nHashGovobj = vpGovObjsTriggersTmp.back()->GetHash();
+//        } else {
+//            if(vpGovObjsTmp.empty()) break;
+//            nHashGovobj = vpGovObjsTmp.back()->GetHash();
+//        }
+//        bool fAsked = false;
+//        for (auto* pnode : vNodesCopy) {
+//            // Only use regular peers, don't try to ask from outbound "masternode" connections -
+//            // they stay connected for a short period of time and it's possible that we won't get everything we should.
+//            // Only use outbound connections - inbound connection could be a "masternode" connection
+//            // initiated from another node, so skip it too.
+//            if(pnode->fMasternode || (fMasterNode && pnode->fInbound)) continue;
+//            // only use up to date peers
+//            if(pnode->nVersion < MIN_GOVERNANCE_PEER_PROTO_VERSION) continue;
+//            // stop early to prevent setAskFor overflow
+//            //size_t nProjectedSize = pnode->setAskFor.size() + nProjectedVotes;
+//            size_t nProjectedSize = pnode->GetAskForCount() + nProjectedVotes; // VELES
+//            if(nProjectedSize > SETASKFOR_MAX_SZ/2) continue;
+//            // to early to ask the same node
+//            if(mapAskedRecently[nHashGovobj].count(pnode->addr)) continue;
+//
+//            RequestGovernanceObject(pnode, nHashGovobj, connman, true);
+//            mapAskedRecently[nHashGovobj][pnode->addr] = nNow + nTimeout;
+//            fAsked = true;
+//            // stop loop if max number of peers per obj was asked
+//            if(mapAskedRecently[nHashGovobj].size() >= nPeersPerHashMax) break;
+//        }
+//        // NOTE: this should match `if` above (the one before `while`)
+//        if(vpGovObjsTriggersTmp.size()) {
+//            vpGovObjsTriggersTmp.pop_back();
+//        } else {
+//            vpGovObjsTmp.pop_back();
+//        }
+//        if(!fAsked) i--;
+//    }
+//    LogPrint(BCLog::GOBJECT, "CGovernanceManager::RequestGovernanceObjectVotes -- end: vpGovObjsTriggersTmp %d vpGovObjsTmp %d mapAskedRecently %d\n",
+//                vpGovObjsTriggersTmp.size(), vpGovObjsTmp.size(), mapAskedRecently.size());
+//
+//    return int(vpGovObjsTriggersTmp.size() + vpGovObjsTmp.size());
+//}
+
+// VELES BEGIN
+// Every peer is asked for the votes of the objects it was not asked for yet, in the order of the
+// plan, so repeated calls go on where they stopped instead of scanning all the objects again.
+// Returns the most objects left to ask any of the peers for.
 int CGovernanceManager::RequestGovernanceObjectVotes(const std::vector<CNode*>& vNodesCopy, CConnman& connman)
 {
-    static std::map<uint256, std::map<CService, int64_t> > mapAskedRecently;
-
     if(vNodesCopy.empty()) return -1;
 
     int64_t nNow = GetTime();
-    int nTimeout = 60 * 60;
-    size_t nPeersPerHashMax = 3;
-
-    std::vector<CGovernanceObject*> vpGovObjsTmp;
-    std::vector<CGovernanceObject*> vpGovObjsTriggersTmp;
 
     // This should help us to get some idea about an impact this can bring once deployed on mainnet.
     // Testnet is ~40 times smaller in masternode count, but only ~1000 masternodes usually vote,
@@ -1170,85 +1554,144 @@ int CGovernanceManager::RequestGovernanceObjectVotes(const std::vector<CNode*>&
     if(Params().NetworkIDString() != CBaseChainParams::MAIN) {
         nMaxObjRequestsPerNode = std::max(1, int(nProjectedVotes / std::max(1, mnodeman.size())));
     }
+    // as many requests per call as when each object was asked from all its peers at once
+    int nMaxRequests = nMaxObjRequestsPerNode * CGovernanceVoteSyncPlanner::PEERS_PER_OBJECT;
 
-    {
-        LOCK2(cs_main, cs);
+    LOCK2(cs_main, cs);
 
-        if(mapObjects.empty()) return -2;
+    if(mapObjects.empty()) return -2;
 
+    if(voteSyncPlanner.NeedsRebuild(nNow)) {
+        // triggers first, the objects of each type in random order
+        std::vector<uint256> vecTriggers;
+        std::vector<uint256> vecObjects;
         for(object_m_it it = mapObjects.begin(); it != mapObjects.end(); ++it) {
-            if(mapAskedRecently.count(it->first)) {
-                std::map<CService, int64_t>::iterator it1 = mapAskedRecently[it->first].begin();
-                while(it1 != mapAskedRecently[it->first].end()) {
-                    if(it1->second < nNow) {
-                        mapAskedRecently[it->first].erase(it1++);
-                    } else {
-                        ++it1;
-                    }
-                }
-                if(mapAskedRecently[it->first].size() >= nPeersPerHashMax) continue;
-            }
-            if(it->second.nObjectType == GOVERNANCE_OBJECT_TRIGGER) {
-                vpGovObjsTriggersTmp.push_back(&(it->second));
-            } else {
-                vpGovObjsTmp.push_back(&(it->second));
-            }
+            (it->second.nObjectType == GOVERNANCE_OBJECT_TRIGGER ? vecTriggers : vecObjects).push_back(it->first);
         }
+        InsecureRand insecureRand;
+        std::random_shuffle(vecTriggers.begin(), vecTriggers.end(), insecureRand);
+        std::random_shuffle(vecObjects.begin(), vecObjects.end(), insecureRand);
+        vecTriggers.insert(vecTriggers.end(), vecObjects.begin(), vecObjects.end());
+        voteSyncPlanner.Rebuild(vecTriggers, nNow);
     }
 
-    LogPrint(BCLog::GOBJECT, "CGovernanceManager::RequestGovernanceObjectVotes -- start: vpGovObjsTriggersTmp %d vpGovObjsTmp %d mapAskedRecently %d\n",
-                vpGovObjsTriggersTmp.size(), vpGovObjsTmp.size(), mapAskedRecently.size());
-
-    InsecureRand insecureRand;
-    // shuffle pointers
-    std::random_shuffle(vpGovObjsTriggersTmp.begin(), vpGovObjsTriggersTmp.end(), insecureRand);
-    std::random_shuffle(vpGovObjsTmp.begin(), vpGovObjsTmp.end(), insecureRand);
-
-    for (int i = 0; i < nMaxObjRequestsPerNode; ++i) {
+    size_t nObjectsLeft = 0;
+    int nRequests = 0;
+    for (auto* pnode : vNodesCopy) {
+        // Only use regular peers, don't try to ask from outbound "masternode" connections -
+        // they stay connected for a short period of time and it's possible that we won't get everything we should.
+        // Only use outbound connections - inbound connection could be a "masternode" connection
+        // initiated from another node, so skip it too.
+        // Only use up to date peers.
+        bool fEligible = !pnode->fMasternode && !(fMasterNode && pnode->fInbound) &&
+                pnode->nVersion >= MIN_GOVERNANCE_PEER_PROTO_VERSION;
+
+        int nPeerRequests = 0;
         uint256 nHashGovobj;
-
-        // ask for triggers first
-        if(vpGovObjsTriggersTmp.size()) {
-            nHashGovobj = vpGovObjsTriggersTmp.back()->GetHash();
-        } else {
-            if(vpGovObjsTmp.empty()) break;
-            nHashGovobj = vpGovObjsTmp.back()->GetHash();
-        }
-        bool fAsked = false;
-        for (auto* pnode : vNodesCopy) {
-            // Only use regular peers, don't try to ask from outbound "masternode" connections -
-            // they stay connected for a short period of time and it's possible that we won't get everything we should.
-            // Only use outbound connections - inbound connection could be a "masternode" connection
-            // initiated from another node, so skip it too.
-            if(pnode->fMasternode || (fMasterNode && pnode->fInbound)) continue;
-            // only use up to date peers
-            if(pnode->nVersion < MIN_GOVERNANCE_PEER_PROTO_VERSION) continue;
+        while(fEligible && nPeerRequests < nMaxObjRequestsPerNode && nRequests < nMaxRequests) {
             // stop early to prevent setAskFor overflow
-            size_t nProjectedSize = pnode->setAskFor.size() + nProjectedVotes;
-            if(nProjectedSize > SETASKFOR_MAX_SZ/2) continue;
-            // to early to ask the same node
-            if(mapAskedRecently[nHashGovobj].count(pnode->addr)) continue;
+            size_t nProjectedSize = pnode->GetAskForCount() + nProjectedVotes;
+            if(nProjectedSize > SETASKFOR_MAX_SZ/2) break;
+            if(!voteSyncPlanner.NextObject(pnode->addr, nHashGovobj)) break;
+            // erased since the plan was built
+            if(!mapObjects.count(nHashGovobj)) continue;
 
             RequestGovernanceObject(pnode, nHashGovobj, connman, true);
-            mapAskedRecently[nHashGovobj][pnode->addr] = nNow + nTimeout;
-            fAsked = true;
-            // stop loop if max number of peers per obj was asked
-            if(mapAskedRecently[nHashGovobj].size() >= nPeersPerHashMax) break;
+            voteSyncPlanner.Asked(nHashGovobj, pnode->addr, nNow);
+            nPeerRequests++;
+            nRequests++;
         }
-        // NOTE: this should match `if` above (the one before `while`)
-        if(vpGovObjsTriggersTmp.size()) {
-            vpGovObjsTriggersTmp.pop_back();
-        } else {
-            vpGovObjsTmp.pop_back();
+        // the peers not used are never through the plan
+        nObjectsLeft = std::max(nObjectsLeft, voteSyncPlanner.GetObjectsLeft(pnode->addr));
+    }
+    LogPrint(BCLog::GOBJECT, "CGovernanceManager::RequestGovernanceObjectVotes -- peers %d requests %d objects left %d\n",
+                vNodesCopy.size(), nRequests, nObjectsLeft);
+
+    return int(nObjectsLeft);
+}
+
+void CGovernanceVoteSyncPlanner::Rebuild(const std::vector<uint256>& vecObjects, int64_t nNow)
+{
+    vecPlan = vecObjects;
+    mapPeerPositions.clear();
+    nTimePlanExpires = nNow + ASK_TIMEOUT;
+
+    // the peers asked recently are still not asked again
+    std::map<uint256, ObjectEntry> mapEntriesOld;
+    mapEntriesOld.swap(mapEntries);
+    for (const uint256& nHash : vecPlan) {
+        ObjectEntry& entry = mapEntries[nHash];
+        auto itOld = mapEntriesOld.find(nHash);
+        if (itOld == mapEntriesOld.end())
+            continue;
+        for (const auto& asked : itOld->second.mapAsked) {
+            if (asked.second > nNow)
+                entry.mapAsked.insert(asked);
         }
-        if(!fAsked) i--;
     }
-    LogPrint(BCLog::GOBJECT, "CGovernanceManager::RequestGovernanceObjectVotes -- end: vpGovObjsTriggersTmp %d vpGovObjsTmp %d mapAskedRecently %d\n",
-                vpGovObjsTriggersTmp.size(), vpGovObjsTmp.size(), mapAskedRecently.size());
+}
+
+void CGovernanceVoteSyncPlanner::AddObject(const uint256& nHash)
+{
+    // before the first build the object is planned with the others
+    if (vecPlan.empty() || !mapEntries.emplace(nHash, ObjectEntry()).second)
+        return;
+    vecPlan.push_back(nHash);
+}
+
+bool CGovernanceVoteSyncPlanner::NextObject(const CService& addr, uint256& nHashRet)
+{
+    size_t& nPosition = mapPeerPositions[addr];
+    while (nPosition < vecPlan.size()) {
+        const uint256& nHash = vecPlan[nPosition++];
+        const ObjectEntry& entry = mapEntries[nHash];
+        if (entry.mapAsked.size() >= PEERS_PER_OBJECT || entry.mapAsked.count(addr))
+            continue;
+        nHashRet = nHash;
+        return true;
+    }
+    return false;
+}
+
+void CGovernanceVoteSyncPlanner::Asked(const uint256& nHash, const CService& addr, int64_t nNow)
+{
+    ObjectEntry& entry = mapEntries[nHash];
+    entry.mapAsked[addr] = nNow + ASK_TIMEOUT;
+    if (entry.mapAsked.size() >= PEERS_PER_OBJECT) {
+        // no other peer is asked in this pass
+        entry.filter.reset();
+    }
+}
 
-    return int(vpGovObjsTriggersTmp.size() + vpGovObjsTmp.size());
+size_t CGovernanceVoteSyncPlanner::GetObjectsLeft(const CService& addr) const
+{
+    auto it = mapPeerPositions.find(addr);
+    return vecPlan.size() - (it == mapPeerPositions.end() ? 0 : it->second);
 }
 
+const CBloomFilter& CGovernanceVoteSyncPlanner::GetVoteFilter(const uint256& nHash, CGovernanceObject& govobj)
+{
+    ObjectEntry& entry = mapEntries[nHash];
+    const int nVoteCount = govobj.GetVoteFile().GetVoteCount();
+    if (!entry.filter || nVoteCount > entry.nFilterVotes + std::max(10, entry.nFilterVotes / 10)) {
+        entry.filter.reset(new CBloomFilter(Params().GetConsensus().nGovernanceFilterElements, GOVERNANCE_FILTER_FP_RATE, GetRandInt(999999), BLOOM_UPDATE_ALL));
+        for (const CGovernanceVote& vote : govobj.GetVoteFile().GetVotes()) {
+            entry.filter->insert(vote.GetHash());
+        }
+        entry.nFilterVotes = nVoteCount;
+    }
+    return *entry.filter;
+}
+
+void CGovernanceVoteSyncPlanner::Clear()
+{
+    vecPlan.clear();
+    mapEntries.clear();
+    mapPeerPositions.clear();
+    nTimePlanExpires = 0;
+}
+// VELES END
+
 bool CGovernanceManager::AcceptObjectMessage(const uint256& nHash)
 {
     LOCK(cs);
@@ -1276,9 +1719,25 @@ bool CGovernanceManager::AcceptMessage(const uint256& nHash, hash_s_t& setHash)
 void CGovernanceManager::RebuildIndexes()
 {
     mapVoteToObject.Clear();
+    //mapObjectsByType.clear(); // VELES
+    // VELES BEGIN
+    mapObjectsByType.clear();
+    setDirtyObjects.clear();
+    setObjectsToDelete.clear();
+    // VELES END
     for(object_m_it it = mapObjects.begin(); it != mapObjects.end(); ++it) {
         CGovernanceObject& govobj = it->second;
-        std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
+        //mapObjectsByType[govobj.GetObjectType()].insert(std::make_pair(govobj.GetCreationTime(), it->first)); // VELES
+        // VELES BEGIN
+        mapObjectsByType[govobj.GetObjectType()].insert(std::make_pair(govobj.GetCreationTime(), it->first));
+        // loaded objects get their flags recomputed on the first clean
+        setDirtyObjects.insert(it->first);
+        if(govobj.IsSetCachedDelete() || govobj.IsSetExpired()) {
+            setObjectsToDelete.insert(std::make_pair(govobj.GetDeletionTime() + GOVERNANCE_DELETION_DELAY, it->first));
+        }
+        // VELES END
+        //std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
+        const std::vector<CGovernanceVote>& vecVotes = govobj.GetVoteFile().GetVotes(); // VELES
         for(size_t i = 0; i < vecVotes.size(); ++i) {
             mapVoteToObject.Insert(vecVotes[i].GetHash(), &govobj);
         }
@@ -1320,31 +1779,62 @@ std::string CGovernanceManager::ToString() const
     int nWatchdogCount = 0;
     int nOtherCount = 0;
 
-    object_m_cit it = mapObjects.begin();
+    //object_m_cit it = mapObjects.begin();
+
+    //while(it != mapObjects.end()) {
+    //    switch(it->second.GetObjectType()) {
+    //        case GOVERNANCE_OBJECT_PROPOSAL:
+    //            nProposalCount++;
+    //            break;
+    //        case GOVERNANCE_OBJECT_TRIGGER:
+    //            nTriggerCount++;
+    //            break;
+    //        case GOVERNANCE_OBJECT_WATCHDOG:
+    //            nWatchdogCount++;
+    //            break;
+    //        default:
+    //            nOtherCount++;
+    //            break;
+    //    }
+    //    ++it;
+    //}
+    // VELES BEGIN
+    CountObjects(nProposalCount, nTriggerCount, nWatchdogCount, nOtherCount);
+    // VELES END
 
-    while(it != mapObjects.end()) {
-        switch(it->second.GetObjectType()) {
+    return strprintf("Governance Objects: %d (Proposals: %d, Triggers: %d, Watchdogs: %d/%d, Other: %d; Erased: %d), Votes: %d",
+                    (int)mapObjects.size(),
+                    nProposalCount, nTriggerCount, nWatchdogCount, mapWatchdogObjects.size(), nOtherCount, (int)mapErasedGovernanceObjects.size(),
+                    (int)mapVoteToObject.GetSize());
+}
+
+// VELES BEGIN
+void CGovernanceManager::CountObjects(int& nProposalCountRet, int& nTriggerCountRet, int& nWatchdogCountRet, int& nOtherCountRet) const
+{
+    LOCK(cs);
+
+    nProposalCountRet = 0;
+    nTriggerCountRet = 0;
+    nWatchdogCountRet = 0;
+    nOtherCountRet = 0;
+    for(object_type_time_m_t::const_iterator itType = mapObjectsByType.begin(); itType != mapObjectsByType.end(); ++itType) {
+        switch(itType->first) {
             case GOVERNANCE_OBJECT_PROPOSAL:
-                nProposalCount++;
+                nProposalCountRet += itType->second.size();
                 break;
             case GOVERNANCE_OBJECT_TRIGGER:
-                nTriggerCount++;
+                nTriggerCountRet += itType->second.size();
                 break;
             case GOVERNANCE_OBJECT_WATCHDOG:
-                nWatchdogCount++;
+                nWatchdogCountRet += itType->second.size();
                 break;
             default:
-                nOtherCount++;
+                nOtherCountRet += itType->second.size();
                 break;
         }
-        ++it;
     }
-
-    return strprintf("Governance Objects: %d (Proposals: %d, Triggers: %d, Watchdogs: %d/%d, Other: %d; Erased: %d), Votes: %d",
-                    (int)mapObjects.size(),
-                    nProposalCount, nTriggerCount, nWatchdogCount, mapWatchdogObjects.size(), nOtherCount, (int)mapErasedGovernanceObjects.size(),
-                    (int)mapVoteToObject.GetSize());
 }
+// VELES END
 
 void CGovernanceManager::UpdatedBlockTip(const CBlockIndex *pindex, CConnman& connman)
 {
@@ -20,6 +20,8 @@
 #include <timedata.h>
 #include <util/system.h>
 
+#include <memory> // VELES
+
 class CGovernanceManager;
 class CGovernanceTriggerManager;
 class CGovernanceObject;
@@ -142,6 +144,63 @@ public:
     }
 };
 
+// VELES BEGIN
+//
+// Governance Vote Sync Planner : Decides which peers the votes of the governance objects are asked from
+//
+// The objects are put in asking order once, the triggers first, and every
+// peer walks through them from its own position, skipping the objects that
+// were asked from enough peers or from itself already. A sync is then one
+// pass over the objects however often the peers are asked for more. The plan
+// is rebuilt once the peers may be asked for the same objects again.
+//
+class CGovernanceVoteSyncPlanner
+{
+public:
+    /// Number of peers the votes of an object are asked from
+    static const size_t PEERS_PER_OBJECT = 3;
+    /// Time before a peer may be asked for the votes of the same object again
+    static const int64_t ASK_TIMEOUT = 60 * 60;
+
+private:
+    struct ObjectEntry {
+        /// Peers asked for the votes of the object and when they may be asked again
+        std::map<CService, int64_t> mapAsked;
+        /// Filter of our votes of the object sent to the peers asked, while some are left to ask
+        std::unique_ptr<CBloomFilter> filter;
+        /// Number of votes in the filter
+        int nFilterVotes = 0;
+    };
+
+    std::vector<uint256> vecPlan;
+    std::map<uint256, ObjectEntry> mapEntries;
+    /// Position of the peers in vecPlan
+    std::map<CService, size_t> mapPeerPositions;
+    int64_t nTimePlanExpires = 0;
+
+public:
+    bool NeedsRebuild(int64_t nNow) const { return vecPlan.empty() || nTimePlanExpires <= nNow; }
+    /// Start a new pass over the objects, in order
+    void Rebuild(const std::vector<uint256>& vecObjects, int64_t nNow);
+    /// Plan a new object, asked for after the planned ones
+    void AddObject(const uint256& nHash);
+
+    /// Next object to ask the peer for the votes of, false once it is through the plan
+    bool NextObject(const CService& addr, uint256& nHashRet);
+    void Asked(const uint256& nHash, const CService& addr, int64_t nNow);
+    /// Number of planned objects the peer is not through yet
+    size_t GetObjectsLeft(const CService& addr) const;
+
+    /**
+     * The filter of our votes of an object, built again only when we got
+     * significantly more votes since, the peers asked send us the rest
+     */
+    const CBloomFilter& GetVoteFilter(const uint256& nHash, CGovernanceObject& govobj);
+
+    void Clear();
+};
+// VELES END
+
 //
 // Governance Manager : Contains all proposals for the budget
 //
@@ -213,6 +272,12 @@ public: // Types
 
     typedef object_info_m_t::const_iterator object_info_m_cit;
 
+    // VELES BEGIN
+    typedef std::set<std::pair<int64_t, uint256> > object_time_s_t;
+
+    typedef std::map<int, object_time_s_t> object_type_time_m_t;
+    // VELES END
+
     typedef std::map<uint256, int64_t> hash_time_m_t;
 
     typedef hash_time_m_t::iterator hash_time_m_it;
@@ -235,6 +300,17 @@ private:
     // keep track of the scanning errors
     object_m_t mapObjects;
 
+    // VELES BEGIN
+    // creation times and hashes of mapObjects by object type
+    object_type_time_m_t mapObjectsByType;
+
+    // objects whose cached flags must be recomputed on the next clean
+    hash_s_t setDirtyObjects;
+
+    // objects flagged for deletion by the time they can be erased
+    object_time_s_t setObjectsToDelete;
+    // VELES END
+
     // mapErasedGovernanceObjects contains key-value pairs, where
     //   key   - governance object's hash
     //   value - expiration time for deleted objects
@@ -266,6 +342,15 @@ private:
 
     bool fRateChecksEnabled;
 
+    // VELES BEGIN
+    CGovernanceVoteSyncPlanner voteSyncPlanner;
+
+    // memory the invalid and orphan votes may use before the oldest ones are evicted, 0 for no limit
+    size_t nMaxVoteCacheUsage;
+
+    void LimitVoteCaches();
+    // VELES END
+
     class ScopedLockBool
     {
         bool& ref;
@@ -310,7 +395,11 @@ public:
 
     std::vector<CGovernanceVote> GetMatchingVotes(const uint256& nParentHash);
     std::vector<CGovernanceVote> GetCurrentVotes(const uint256& nParentHash, const COutPoint& mnCollateralOutpointFilter);
-    std::vector<CGovernanceObject*> GetAllNewerThan(int64_t nMoreThanTime);
+    //std::vector<CGovernanceObject*> GetAllNewerThan(int64_t nMoreThanTime);
+    // VELES BEGIN
+    /// Objects created at or after nMoreThanTime ordered by hash, only of nObjectType unless it is -1
+    std::vector<CGovernanceObject*> GetAllNewerThan(int64_t nMoreThanTime, int nObjectType = -1);
+    // VELES END
 
     bool IsBudgetPaymentBlock(int nBlockHeight);
     void AddGovernanceObject(CGovernanceObject& govobj, CConnman& connman, CNode* pfrom = NULL);
@@ -321,12 +410,24 @@ public:
 
     void CheckAndRemove() {UpdateCachesAndClean();}
 
+    // VELES BEGIN
+    /// Queue an object flagged for deletion or expired at nDeletionTime for erasing
+    void ScheduleDeletion(const uint256& nHash, int64_t nDeletionTime);
+    // VELES END
+
     void Clear()
     {
         LOCK(cs);
 
         LogPrint(BCLog::GOBJECT, "Governance object manager was cleared\n");
         mapObjects.clear();
+        //mapObjectsByType.clear(); // VELES
+        // VELES BEGIN
+        mapObjectsByType.clear();
+        setDirtyObjects.clear();
+        setObjectsToDelete.clear();
+        voteSyncPlanner.Clear();
+        // VELES END
         mapErasedGovernanceObjects.clear();
         mapWatchdogObjects.clear();
         nHashWatchdogCurrent = uint256();
@@ -338,6 +439,13 @@ public:
     }
 
     std::string ToString() const;
+    // VELES BEGIN
+    /** Count the objects of each type */
+    void CountObjects(int& nProposalCountRet, int& nTriggerCountRet, int& nWatchdogCountRet, int& nOtherCountRet) const;
+    /** Memory used by the objects, their votes and the vote caches */
+    size_t DynamicMemoryUsage() const;
+    void SetMaxVoteCacheUsage(size_t nMaxVoteCacheUsageIn);
+    // VELES END
 
     ADD_SERIALIZE_METHODS;
 
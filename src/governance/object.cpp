@@ -4,18 +4,26 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <core_io.h>
+#include <core_memusage.h> // VELES
 #include <governance/governance.h>
 #include <governance/classes.h>
 #include <governance/object.h>
+#include <governance/validators.h> // VELES
 #include <governance/vote.h>
+#include <index/collateralindex.h> // VELES
 #include <instantx.h>
 #include <masternode/sync.h>
 #include <masternode/manager.h>
 #include <messagesigner.h>
 #include <util/system.h>
+#include <validationinterface.h> // VELES
 
 #include <univalue.h>
 
+// VELES BEGIN
+#include <algorithm>
+// VELES END
+
 CGovernanceObject::CGovernanceObject()
 : cs(),
   nObjectType(GOVERNANCE_OBJECT_UNKNOWN),
@@ -37,6 +45,7 @@ CGovernanceObject::CGovernanceObject()
   fExpired(false),
   fUnparsable(false),
   mapCurrentMNVotes(),
+  nVoteCounts(), // VELES
   mapOrphanVotes(),
   fileVotes()
 {
@@ -65,6 +74,7 @@ CGovernanceObject::CGovernanceObject(uint256 nHashParentIn, int nRevisionIn, int
   fExpired(false),
   fUnparsable(false),
   mapCurrentMNVotes(),
+  nVoteCounts(), // VELES
   mapOrphanVotes(),
   fileVotes()
 {
@@ -81,6 +91,7 @@ CGovernanceObject::CGovernanceObject(const CGovernanceObject& other)
   nDeletionTime(other.nDeletionTime),
   nCollateralHash(other.nCollateralHash),
   strData(other.strData),
+  pPayload(other.pPayload), // VELES
   vinMasternode(other.vinMasternode),
   vchSig(other.vchSig),
   fCachedLocalValidity(other.fCachedLocalValidity),
@@ -93,9 +104,15 @@ CGovernanceObject::CGovernanceObject(const CGovernanceObject& other)
   fExpired(other.fExpired),
   fUnparsable(other.fUnparsable),
   mapCurrentMNVotes(other.mapCurrentMNVotes),
+  nVoteCounts(), // VELES
   mapOrphanVotes(other.mapOrphanVotes),
   fileVotes(other.fileVotes)
-{}
+//{}
+// VELES BEGIN
+{
+    std::copy(&other.nVoteCounts[0][0], &other.nVoteCounts[0][0] + sizeof(nVoteCounts) / sizeof(int), &nVoteCounts[0][0]);
+}
+// VELES END
 
 bool CGovernanceObject::ProcessVote(CNode* pfrom,
                                     const CGovernanceVote& vote,
@@ -141,6 +158,7 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
     vote_instance_m_it it2 = recVote.mapInstances.find(int(eSignal));
     if(it2 == recVote.mapInstances.end()) {
         it2 = recVote.mapInstances.insert(vote_instance_m_t::value_type(int(eSignal), vote_instance_t())).first;
+        UpdateVoteCount(eSignal, VOTE_OUTCOME_NONE, 1); // VELES
     }
     vote_instance_t& voteInstance = it2->second;
 
@@ -190,11 +208,19 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
         exception = CGovernanceException(ostr.str(), GOVERNANCE_EXCEPTION_PERMANENT_ERROR);
         return false;
     }
+    UpdateVoteCount(eSignal, voteInstance.eOutcome, -1); // VELES
     voteInstance = vote_instance_t(vote.GetOutcome(), nVoteTimeUpdate, vote.GetTimestamp());
+    UpdateVoteCount(eSignal, voteInstance.eOutcome, 1); // VELES
     if(!fileVotes.HasVote(vote.GetHash())) {
         fileVotes.AddVote(vote);
     }
     fDirtyCache = true;
+    // VELES BEGIN
+    if(nObjectType == GOVERNANCE_OBJECT_TRIGGER) {
+        triggerman.InvalidateBestSuperblocks();
+    }
+    GetMainSignals().NotifyGovernanceVote(vote.GetHash());
+    // VELES END
     return true;
 }
 
@@ -204,6 +230,14 @@ void CGovernanceObject::ClearMasternodeVotes()
     while(it != mapCurrentMNVotes.end()) {
         if(!mnodeman.Has(it->first)) {
             fileVotes.RemoveVotesFromMasternode(it->first);
+            // VELES BEGIN
+            for(vote_instance_m_cit it2 = it->second.mapInstances.begin(); it2 != it->second.mapInstances.end(); ++it2) {
+                UpdateVoteCount(it2->first, it2->second.eOutcome, -1);
+            }
+            if(nObjectType == GOVERNANCE_OBJECT_TRIGGER) {
+                triggerman.InvalidateBestSuperblocks();
+            }
+            // VELES END
             mapCurrentMNVotes.erase(it++);
         }
         else {
@@ -212,6 +246,27 @@ void CGovernanceObject::ClearMasternodeVotes()
     }
 }
 
+// VELES BEGIN
+void CGovernanceObject::UpdateVoteCount(int nSignal, vote_outcome_enum_t eOutcome, int nDelta)
+{
+    if(nSignal < 0 || nSignal > MAX_SUPPORTED_VOTE_SIGNAL || eOutcome < VOTE_OUTCOME_NONE || eOutcome > VOTE_OUTCOME_ABSTAIN) {
+        return;
+    }
+    nVoteCounts[nSignal][eOutcome] += nDelta;
+}
+
+void CGovernanceObject::RebuildVoteCounts()
+{
+    std::fill(&nVoteCounts[0][0], &nVoteCounts[0][0] + sizeof(nVoteCounts) / sizeof(int), 0);
+    for(vote_m_cit it = mapCurrentMNVotes.begin(); it != mapCurrentMNVotes.end(); ++it) {
+        const vote_rec_t& recVote = it->second;
+        for(vote_instance_m_cit it2 = recVote.mapInstances.begin(); it2 != recVote.mapInstances.end(); ++it2) {
+            UpdateVoteCount(it2->first, it2->second.eOutcome, 1);
+        }
+    }
+}
+// VELES END
+
 std::string CGovernanceObject::GetSignatureMessage() const
 {
     LOCK(cs);
@@ -297,6 +352,31 @@ uint256 CGovernanceObject::GetHash() const
     return h1;
 }
 
+// VELES BEGIN
+static size_t StringDynamicUsage(const std::string& str)
+{
+    // short strings are kept in the string itself
+    return str.capacity() > 15 ? memusage::MallocUsage(str.capacity() + 1) : 0;
+}
+
+size_t CGovernanceObject::DynamicMemoryUsage() const
+{
+    LOCK(cs);
+
+    size_t nUsage = StringDynamicUsage(strData) + RecursiveDynamicUsage(vinMasternode) + memusage::DynamicUsage(vchSig);
+    nUsage += memusage::DynamicUsage(pPayload) + StringDynamicUsage(pPayload->strPlain);
+    nUsage += StringDynamicUsage(strLocalValidityError) + memusage::DynamicUsage(mapCurrentMNVotes);
+    for(const auto& pair : mapCurrentMNVotes) {
+        nUsage += memusage::DynamicUsage(pair.second.mapInstances);
+    }
+    nUsage += mapOrphanVotes.DynamicMemoryUsage();
+    for(const auto& item : mapOrphanVotes.GetItemList()) {
+        nUsage += item.value.first.DynamicMemoryUsage();
+    }
+    return nUsage + fileVotes.DynamicMemoryUsage();
+}
+// VELES END
+
 /**
    Return the actual object from the strData JSON structure.
 
@@ -309,12 +389,19 @@ UniValue CGovernanceObject::GetJSONObject()
         return obj;
     }
 
-    UniValue objResult(UniValue::VOBJ);
-    GetData(objResult);
-
-    std::vector<UniValue> arr1 = objResult.getValues();
-    std::vector<UniValue> arr2 = arr1.at( 0 ).getValues();
-    obj = arr2.at( 1 );
+    // VELES BEGIN
+    // The data was parsed once with the object
+    //UniValue objResult(UniValue::VOBJ);
+    //GetData(objResult);
+    //
+    //std::vector<UniValue> arr1 = objResult.getValues();
+    //std::vector<UniValue> arr2 = arr1.at( 0 ).getValues();
+    //obj = arr2.at( 1 );
+    if(!pPayload->fParsed) {
+        throw std::runtime_error(pPayload->strParseError);
+    }
+    obj = pPayload->obj;
+    // VELES END
 
     return obj;
 }
@@ -332,14 +419,19 @@ void CGovernanceObject::LoadData()
     // todo : 12.1 - resolved
     //return;
 
+    pPayload = std::make_shared<const CGovernanceObjectPayload>(strData); // VELES
+
     if(strData.empty()) {
         return;
     }
 
     try  {
         // ATTEMPT TO LOAD JSON STRING FROM STRDATA
-        UniValue objResult(UniValue::VOBJ);
-        GetData(objResult);
+        // VELES BEGIN
+        // Parsed with the payload
+        //UniValue objResult(UniValue::VOBJ);
+        //GetData(objResult);
+        // VELES END
 
         DBG( cout << "CGovernanceObject::LoadData strData = "
              << GetDataAsString()
@@ -394,13 +486,50 @@ std::string CGovernanceObject::GetDataAsHex()
     return strData;
 }
 
-std::string CGovernanceObject::GetDataAsString()
+// VELES BEGIN
+// Decoded with the payload
+//std::string CGovernanceObject::GetDataAsString()
+//{
+//    std::vector<unsigned char> v = ParseHex(strData);
+//    std::string s(v.begin(), v.end());
+//
+//    return s;
+//}
+
+CGovernanceObjectPayload::CGovernanceObjectPayload(const std::string& strDataHex)
+    : obj(UniValue::VOBJ),
+      fParsed(false),
+      fValidProposal(false)
 {
-    std::vector<unsigned char> v = ParseHex(strData);
-    std::string s(v.begin(), v.end());
+    std::vector<unsigned char> v = ParseHex(strDataHex);
+    strPlain.assign(v.begin(), v.end());
+    if(strPlain.empty()) {
+        return;
+    }
 
-    return s;
+    // The same JSON structure as GetData() and GetJSONObject() used to parse every time
+    try {
+        UniValue objResult(UniValue::VOBJ);
+        objResult.read(strPlain);
+        std::vector<UniValue> arr1 = objResult.getValues();
+        std::vector<UniValue> arr2 = arr1.at(0).getValues();
+        obj = arr2.at(1);
+        fParsed = true;
+    }
+    catch(std::exception& e) {
+        strParseError = e.what();
+        return;
+    }
+
+    const UniValue& type = find_value(obj, "type");
+    if(type.isNum() && type.get_int() == GOVERNANCE_OBJECT_PROPOSAL) {
+        CProposalValidator validator;
+        validator.SetJSONData(obj);
+        fValidProposal = validator.Validate();
+        strProposalErrors = validator.GetErrorMessages();
+    }
 }
+// VELES END
 
 void CGovernanceObject::UpdateLocalValidity()
 {
@@ -508,19 +637,36 @@ bool CGovernanceObject::IsCollateralValid(std::string& strError, bool& fMissingC
     CAmount nMinFee = GetMinCollateralFee();
     uint256 nExpectedHash = GetHash();
 
-    CTransactionRef txCollateral;
+    // VELES BEGIN
+    //CTransactionRef txCollateral;
+    std::vector<CTxOut> voutCollateral;
+    // VELES END
     uint256 nBlockHash;
 
     // RETRIEVE TRANSACTION IN QUESTION
 
-    if(!GetTransaction(nCollateralHash, txCollateral, Params().GetConsensus(), nBlockHash)){
-        strError = strprintf("Can't find collateral tx %s", txCollateral->ToString());
-        LogPrintf("CGovernanceObject::IsCollateralValid -- %s\n", strError);
-        return false;
+    // VELES BEGIN
+    // The outputs of the mined collaterals are a single lookup in the collateral index, only the
+    // unconfirmed ones are loaded from the mempool, or the transaction index when there is one
+    //if(!GetTransaction(nCollateralHash, txCollateral, Params().GetConsensus(), nBlockHash)){
+    //    strError = strprintf("Can't find collateral tx %s", txCollateral->ToString());
+    if(!g_collateral_index.GetCollateral(nCollateralHash, voutCollateral, nBlockHash)) {
+        CTransactionRef txCollateral;
+        if(!GetTransaction(nCollateralHash, txCollateral, Params().GetConsensus(), nBlockHash)) {
+            strError = strprintf("Can't find collateral tx %s", nCollateralHash.ToString());
+            LogPrintf("CGovernanceObject::IsCollateralValid -- %s\n", strError);
+            return false;
+        }
+        voutCollateral = txCollateral->vout;
     }
+    // VELES END
 
-    if(txCollateral->vout.size() < 1) {
-        strError = strprintf("tx vout size less than 1 | %d", txCollateral->vout.size());
+    // VELES BEGIN
+    //if(txCollateral->vout.size() < 1) {
+    //    strError = strprintf("tx vout size less than 1 | %d", txCollateral->vout.size());
+    if(voutCollateral.size() < 1) {
+        strError = strprintf("tx vout size less than 1 | %d", voutCollateral.size());
+    // VELES END
         LogPrintf("CGovernanceObject::IsCollateralValid -- %s\n", strError);
         return false;
     }
@@ -530,7 +676,7 @@ bool CGovernanceObject::IsCollateralValid(std::string& strError, bool& fMissingC
     CScript findScript;
     findScript << OP_RETURN << ToByteVector(nExpectedHash);
 
-    DBG( cout << "IsCollateralValid: txCollateral->vout.size() = " << txCollateral->vout.size() << endl; );
+    DBG( cout << "IsCollateralValid: voutCollateral.size() = " << voutCollateral.size() << endl; ); // VELES
 
     DBG( cout << "IsCollateralValid: findScript = " << ScriptToAsmStr( findScript, false ) << endl; );
 
@@ -538,13 +684,15 @@ bool CGovernanceObject::IsCollateralValid(std::string& strError, bool& fMissingC
 
 
     bool foundOpReturn = false;
-    for (const auto o : txCollateral->vout) {
+    //for (const auto o : txCollateral->vout) {
+    for (const auto& o : voutCollateral) { // VELES
         DBG( cout << "IsCollateralValid txout : " << o.ToString()
              << ", o.nValue = " << o.nValue
              << ", o.scriptPubKey = " << ScriptToAsmStr( o.scriptPubKey, false )
              << endl; );
         if(!o.scriptPubKey.IsPayToPublicKeyHash() && !o.scriptPubKey.IsUnspendable()) {
-            strError = strprintf("Invalid Script %s", txCollateral->ToString());
+            //strError = strprintf("Invalid Script %s", txCollateral->ToString());
+            strError = strprintf("Invalid Script %s in %s", o.ToString(), nCollateralHash.ToString()); // VELES
             LogPrintf ("CGovernanceObject::IsCollateralValid -- %s\n", strError);
             return false;
         }
@@ -559,7 +707,8 @@ bool CGovernanceObject::IsCollateralValid(std::string& strError, bool& fMissingC
     }
 
     if(!foundOpReturn){
-        strError = strprintf("Couldn't find opReturn %s in %s", nExpectedHash.ToString(), txCollateral->ToString());
+        //strError = strprintf("Couldn't find opReturn %s in %s", nExpectedHash.ToString(), txCollateral->ToString());
+        strError = strprintf("Couldn't find opReturn %s in %s", nExpectedHash.ToString(), nCollateralHash.ToString()); // VELES
         LogPrintf ("CGovernanceObject::IsCollateralValid -- %s\n", strError);
         return false;
     }
@@ -597,19 +746,26 @@ bool CGovernanceObject::IsCollateralValid(std::string& strError, bool& fMissingC
 
 int CGovernanceObject::CountMatchingVotes(vote_signal_enum_t eVoteSignalIn, vote_outcome_enum_t eVoteOutcomeIn) const
 {
-    int nCount = 0;
-    for(vote_m_cit it = mapCurrentMNVotes.begin(); it != mapCurrentMNVotes.end(); ++it) {
-        const vote_rec_t& recVote = it->second;
-        vote_instance_m_cit it2 = recVote.mapInstances.find(eVoteSignalIn);
-        if(it2 == recVote.mapInstances.end()) {
-            continue;
-        }
-        const vote_instance_t& voteInstance = it2->second;
-        if(voteInstance.eOutcome == eVoteOutcomeIn) {
-            ++nCount;
-        }
-    }
-    return nCount;
+    //int nCount = 0;
+    //for(vote_m_cit it = mapCurrentMNVotes.begin(); it != mapCurrentMNVotes.end(); ++it) {
+    //    const vote_rec_t& recVote = it->second;
+    //    vote_instance_m_cit it2 = recVote.mapInstances.find(eVoteSignalIn);
+    //    if(it2 == recVote.mapInstances.end()) {
+    //        continue;
+    //    }
+    //    const vote_instance_t& voteInstance = it2->second;
+    //    if(voteInstance.eOutcome == eVoteOutcomeIn) {
+    //        ++nCount;
+    //    }
+    //}
+    //return nCount;
+    // VELES BEGIN
+    // Votes with other signals or outcomes are never accepted
+    if(eVoteSignalIn < 0 || eVoteSignalIn > MAX_SUPPORTED_VOTE_SIGNAL || eVoteOutcomeIn < VOTE_OUTCOME_NONE || eVoteOutcomeIn > VOTE_OUTCOME_ABSTAIN) {
+        return 0;
+    }
+    return nVoteCounts[eVoteSignalIn][eVoteOutcomeIn];
+    // VELES END
 }
 
 /**
@@ -694,6 +850,7 @@ void CGovernanceObject::UpdateSentinelVariables()
         if(nDeletionTime == 0) {
             nDeletionTime = GetAdjustedTime();
         }
+        governance.ScheduleDeletion(GetHash(), nDeletionTime); // VELES
     }
     if(GetAbsoluteYesCount(VOTE_SIGNAL_ENDORSED) >= nAbsVoteReq) fCachedEndorsed = true;
 
@@ -713,6 +870,7 @@ void CGovernanceObject::swap(CGovernanceObject& first, CGovernanceObject& second
     swap(first.nDeletionTime, second.nDeletionTime);
     swap(first.nCollateralHash, second.nCollateralHash);
     swap(first.strData, second.strData);
+    swap(first.pPayload, second.pPayload); // VELES
     swap(first.nObjectType, second.nObjectType);
 
     // swap all cached valid flags
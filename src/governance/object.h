@@ -19,6 +19,8 @@
 
 #include <univalue.h>
 
+#include <memory> // VELES
+
 class CGovernanceManager;
 class CGovernanceTriggerManager;
 class CGovernanceObject;
@@ -110,6 +112,28 @@ struct vote_rec_t {
 *
 */
 
+// VELES BEGIN
+/**
+ * The data of a governance object, hex decoded and parsed once when the object
+ * is created or received. It is never modified and the copies of the object
+ * share it.
+ */
+struct CGovernanceObjectPayload
+{
+    /// The hex decoded data
+    std::string strPlain;
+    /// The object of the JSON data, an empty object when it can't be parsed
+    UniValue obj;
+    bool fParsed;
+    std::string strParseError;
+    /// The proposal checks of CProposalValidator, for the data of proposals
+    bool fValidProposal;
+    std::string strProposalErrors;
+
+    explicit CGovernanceObjectPayload(const std::string& strDataHex);
+};
+// VELES END
+
 class CGovernanceObject
 {
     friend class CGovernanceManager;
@@ -150,6 +174,11 @@ private:
     /// Data field - can be used for anything
     std::string strData;
 
+    // VELES BEGIN
+    /// strData decoded and parsed
+    std::shared_ptr<const CGovernanceObjectPayload> pPayload;
+    // VELES END
+
     /// Masternode info for signed objects
     CTxIn vinMasternode;
     std::vector<unsigned char> vchSig;
@@ -185,6 +214,11 @@ private:
 
     vote_m_t mapCurrentMNVotes;
 
+    // VELES BEGIN
+    /// Number of records in mapCurrentMNVotes by signal and outcome
+    int nVoteCounts[MAX_SUPPORTED_VOTE_SIGNAL + 1][VOTE_OUTCOME_ABSTAIN + 1];
+    // VELES END
+
     /// Limited map of votes orphaned by MN
     vote_mcache_t mapOrphanVotes;
 
@@ -284,6 +318,8 @@ public:
 
     uint256 GetHash() const;
 
+    size_t DynamicMemoryUsage() const; // VELES
+
     // GET VOTE COUNT FOR SIGNAL
 
     int CountMatchingVotes(vote_signal_enum_t eVoteSignalIn, vote_outcome_enum_t eVoteOutcomeIn) const;
@@ -299,7 +335,11 @@ public:
     // FUNCTIONS FOR DEALING WITH DATA STRING
 
     std::string GetDataAsHex();
-    std::string GetDataAsString();
+    // VELES BEGIN
+    //std::string GetDataAsString();
+    const std::string& GetDataAsString() const { return pPayload->strPlain; }
+    const CGovernanceObjectPayload& GetPayload() const { return *pPayload; }
+    // VELES END
 
     // SERIALIZER
 
@@ -315,6 +355,11 @@ public:
         READWRITE(nTime);
         READWRITE(nCollateralHash);
         READWRITE(LIMITED_STRING(strData, MAX_GOVERNANCE_OBJECT_DATA_SIZE));
+        // VELES BEGIN
+        if(ser_action.ForRead()) {
+            pPayload = std::make_shared<const CGovernanceObjectPayload>(strData);
+        }
+        // VELES END
         READWRITE(nObjectType);
         READWRITE(vinMasternode);
         READWRITE(vchSig);
@@ -324,6 +369,11 @@ public:
             READWRITE(nDeletionTime);
             READWRITE(fExpired);
             READWRITE(mapCurrentMNVotes);
+            // VELES BEGIN
+            if(ser_action.ForRead()) {
+                RebuildVoteCounts();
+            }
+            // VELES END
             READWRITE(fileVotes);
             LogPrint(BCLog::GOBJECT, "CGovernanceObject::SerializationOp hash = %s, vote count = %d\n", GetHash().ToString(), fileVotes.GetVoteCount());
         }
@@ -350,6 +400,14 @@ private:
     /// Called when MN's which have voted on this object have been removed
     void ClearMasternodeVotes();
 
+    // VELES BEGIN
+    /// Add nDelta to the number of current votes with this signal and outcome
+    void UpdateVoteCount(int nSignal, vote_outcome_enum_t eOutcome, int nDelta);
+
+    /// Recount the current votes from mapCurrentMNVotes
+    void RebuildVoteCounts();
+    // VELES END
+
     void CheckOrphanVotes(CConnman& connman);
 
 };
@@ -36,6 +36,14 @@ void CProposalValidator::SetHexData(const std::string& strDataHexIn)
     ParseJSONData();
 }
 
+// VELES BEGIN
+void CProposalValidator::SetJSONData(const UniValue& objJSONIn)
+{
+    objJSON = objJSONIn;
+    fJSONValid = true;
+}
+// VELES END
+
 bool CProposalValidator::Validate()
 {
     if(!ValidateJSON()) {
@@ -18,6 +18,11 @@ public:
 
     void SetHexData(const std::string& strDataHexIn);
 
+    // VELES BEGIN
+    /// Validate JSON data already parsed, like the payload of a governance object
+    void SetJSONData(const UniValue& objJSONIn);
+    // VELES END
+
     bool Validate();
 
     bool ValidateJSON();
@@ -3,6 +3,7 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <core_memusage.h> // VELES
 #include <governance/vote.h>
 #include <governance/object.h>
 #include <masternode/sync.h>
@@ -235,9 +236,22 @@ void CGovernanceVote::Relay(CConnman& connman) const
     }
 
     CInv inv(MSG_GOVERNANCE_OBJECT_VOTE, GetHash());
-    connman.RelayInv(inv, MIN_GOVERNANCE_PEER_PROTO_VERSION);
+    //connman.RelayInv(inv, MIN_GOVERNANCE_PEER_PROTO_VERSION);
+    // VELES BEGIN
+    CScratchDataStream ss(SER_NETWORK, PROTOCOL_VERSION); // VELES
+    ss.reserve(1000);
+    ss << *this;
+    connman.RelayInv(inv, ss, MIN_GOVERNANCE_PEER_PROTO_VERSION);
+    // VELES END
 }
 
+// VELES BEGIN
+size_t CGovernanceVote::DynamicMemoryUsage() const
+{
+    return RecursiveDynamicUsage(vinMasternode) + memusage::DynamicUsage(vchSig);
+}
+// VELES END
+
 bool CGovernanceVote::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
 {
     // Choose coins to use
@@ -133,6 +133,8 @@ public:
 
     const COutPoint& GetMasternodeOutpoint() const { return vinMasternode.prevout; }
 
+    size_t DynamicMemoryUsage() const; // VELES
+
     /**
     *   GetHash()
     *
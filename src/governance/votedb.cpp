@@ -5,24 +5,38 @@
 
 #include <governance/votedb.h>
 
+// VELES BEGIN
+#include <memusage.h>
+
+#include <algorithm>
+// VELES END
+
 CGovernanceObjectVoteFile::CGovernanceObjectVoteFile()
     : nMemoryVotes(0),
-      listVotes(),
+      //listVotes(),
+      vecVotes(), // VELES
       mapVoteIndex()
 {}
 
 CGovernanceObjectVoteFile::CGovernanceObjectVoteFile(const CGovernanceObjectVoteFile& other)
     : nMemoryVotes(other.nMemoryVotes),
-      listVotes(other.listVotes),
-      mapVoteIndex()
+      //listVotes(other.listVotes),
+      vecVotes(other.vecVotes), // VELES
+      mapVoteIndex(other.mapVoteIndex),
+      mapMasternodeVotes(other.mapMasternodeVotes) // VELES
 {
-    RebuildIndex();
+    //RebuildIndex();
 }
 
 void CGovernanceObjectVoteFile::AddVote(const CGovernanceVote& vote)
 {
-    listVotes.push_front(vote);
-    mapVoteIndex[vote.GetHash()] = listVotes.begin();
+    //listVotes.push_front(vote);
+    //mapVoteIndex[vote.GetHash()] = listVotes.begin();
+    // VELES BEGIN
+    mapVoteIndex[vote.GetHash()] = vecVotes.size();
+    mapMasternodeVotes[vote.GetMasternodeOutpoint()].push_back(vecVotes.size());
+    vecVotes.push_back(vote);
+    // VELES END
     ++nMemoryVotes;
 }
 
@@ -41,39 +55,96 @@ bool CGovernanceObjectVoteFile::GetVote(const uint256& nHash, CGovernanceVote& v
     if(it == mapVoteIndex.end()) {
         return false;
     }
-    vote = *(it->second);
+    //vote = *(it->second);
+    vote = vecVotes[it->second]; // VELES
     return true;
 }
 
-std::vector<CGovernanceVote> CGovernanceObjectVoteFile::GetVotes() const
+//std::vector<CGovernanceVote> CGovernanceObjectVoteFile::GetVotes() const
+//{
+//    std::vector<CGovernanceVote> vecResult;
+//    for(vote_l_cit it = listVotes.begin(); it != listVotes.end(); ++it) {
+//        vecResult.push_back(*it);
+//    }
+//    return vecResult;
+//}
+
+void CGovernanceObjectVoteFile::RemoveVotesFromMasternode(const COutPoint& outpointMasternode)
 {
-    std::vector<CGovernanceVote> vecResult;
-    for(vote_l_cit it = listVotes.begin(); it != listVotes.end(); ++it) {
-        vecResult.push_back(*it);
+    //vote_l_it it = listVotes.begin();
+    //while(it != listVotes.end()) {
+    //    if(it->GetMasternodeOutpoint() == outpointMasternode) {
+    //        --nMemoryVotes;
+    //        mapVoteIndex.erase(it->GetHash());
+    //        listVotes.erase(it++);
+    //    }
+    //    else {
+    //        ++it;
+    //    }
+    //}
+    // VELES BEGIN
+    vote_mn_m_t::iterator it = mapMasternodeVotes.find(outpointMasternode);
+    if(it == mapMasternodeVotes.end()) {
+        return;
+    }
+    // Highest positions first, removing a vote moves the last one into its place
+    std::vector<size_t> vecPos = it->second;
+    std::sort(vecPos.rbegin(), vecPos.rend());
+    for(size_t nPos : vecPos) {
+        RemoveVote(nPos);
     }
-    return vecResult;
+    // VELES END
 }
 
-void CGovernanceObjectVoteFile::RemoveVotesFromMasternode(const COutPoint& outpointMasternode)
+// VELES BEGIN
+size_t CGovernanceObjectVoteFile::DynamicMemoryUsage() const
 {
-    vote_l_it it = listVotes.begin();
-    while(it != listVotes.end()) {
-        if(it->GetMasternodeOutpoint() == outpointMasternode) {
-            --nMemoryVotes;
-            mapVoteIndex.erase(it->GetHash());
-            listVotes.erase(it++);
-        }
-        else {
-            ++it;
-        }
+    size_t nUsage = memusage::DynamicUsage(vecVotes);
+    for(const CGovernanceVote& vote : vecVotes) {
+        nUsage += vote.DynamicMemoryUsage();
+    }
+    nUsage += memusage::DynamicUsage(mapVoteIndex) + memusage::DynamicUsage(mapMasternodeVotes);
+    for(const auto& pair : mapMasternodeVotes) {
+        nUsage += memusage::DynamicUsage(pair.second);
+    }
+    return nUsage;
+}
+// VELES END
+
+// VELES BEGIN
+void CGovernanceObjectVoteFile::RemoveVote(size_t nPos)
+{
+    const CGovernanceVote& vote = vecVotes[nPos];
+    mapVoteIndex.erase(vote.GetHash());
+    vote_mn_m_t::iterator itMn = mapMasternodeVotes.find(vote.GetMasternodeOutpoint());
+    itMn->second.erase(std::find(itMn->second.begin(), itMn->second.end(), nPos));
+    if(itMn->second.empty()) {
+        mapMasternodeVotes.erase(itMn);
+    }
+
+    size_t nLast = vecVotes.size() - 1;
+    if(nPos != nLast) {
+        vecVotes[nPos] = std::move(vecVotes[nLast]);
+        const CGovernanceVote& voteMoved = vecVotes[nPos];
+        mapVoteIndex[voteMoved.GetHash()] = nPos;
+        std::vector<size_t>& vecMoved = mapMasternodeVotes[voteMoved.GetMasternodeOutpoint()];
+        *std::find(vecMoved.begin(), vecMoved.end(), nLast) = nPos;
     }
+    vecVotes.pop_back();
+    --nMemoryVotes;
 }
+// VELES END
 
 CGovernanceObjectVoteFile& CGovernanceObjectVoteFile::operator=(const CGovernanceObjectVoteFile& other)
 {
     nMemoryVotes = other.nMemoryVotes;
-    listVotes = other.listVotes;
-    RebuildIndex();
+    //listVotes = other.listVotes;
+    //RebuildIndex();
+    // VELES BEGIN
+    vecVotes = other.vecVotes;
+    mapVoteIndex = other.mapVoteIndex;
+    mapMasternodeVotes = other.mapMasternodeVotes;
+    // VELES END
     return *this;
 }
 
@@ -81,17 +152,37 @@ void CGovernanceObjectVoteFile::RebuildIndex()
 {
     mapVoteIndex.clear();
     nMemoryVotes = 0;
-    vote_l_it it = listVotes.begin();
-    while(it != listVotes.end()) {
-        CGovernanceVote& vote = *it;
-        uint256 nHash = vote.GetHash();
-        if(mapVoteIndex.find(nHash) == mapVoteIndex.end()) {
-            mapVoteIndex[nHash] = it;
-            ++nMemoryVotes;
-            ++it;
+    //vote_l_it it = listVotes.begin();
+    //while(it != listVotes.end()) {
+    //    CGovernanceVote& vote = *it;
+    //    uint256 nHash = vote.GetHash();
+    //    if(mapVoteIndex.find(nHash) == mapVoteIndex.end()) {
+    //        mapVoteIndex[nHash] = it;
+    //        ++nMemoryVotes;
+    //        ++it;
+    //    }
+    //    else {
+    //        listVotes.erase(it++);
+    //    }
+    //}
+    // VELES BEGIN
+    mapMasternodeVotes.clear();
+    // Compact the vector in place, dropping duplicate votes
+    size_t nKept = 0;
+    for(size_t i = 0; i < vecVotes.size(); ++i) {
+        uint256 nHash = vecVotes[i].GetHash();
+        if(mapVoteIndex.find(nHash) != mapVoteIndex.end()) {
+            continue;
         }
-        else {
-            listVotes.erase(it++);
+        if(nKept != i) {
+            vecVotes[nKept] = std::move(vecVotes[i]);
         }
+        mapVoteIndex[nHash] = nKept;
+        mapMasternodeVotes[vecVotes[nKept].GetMasternodeOutpoint()].push_back(nKept);
+        ++nMemoryVotes;
+        ++nKept;
     }
+    vecVotes.resize(nKept);
+    vecVotes.shrink_to_fit();
+    // VELES END
 }
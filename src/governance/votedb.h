@@ -8,6 +8,9 @@
 
 #include <list>
 #include <map>
+// VELES BEGIN
+#include <vector>
+// VELES END
 
 #include <governance/vote.h>
 #include <serialize.h>
@@ -24,13 +27,21 @@
 class CGovernanceObjectVoteFile
 {
 public: // Types
-    typedef std::list<CGovernanceVote> vote_l_t;
+    //typedef std::list<CGovernanceVote> vote_l_t;
 
-    typedef vote_l_t::iterator vote_l_it;
+    //typedef vote_l_t::iterator vote_l_it;
 
-    typedef vote_l_t::const_iterator vote_l_cit;
+    //typedef vote_l_t::const_iterator vote_l_cit;
 
-    typedef std::map<uint256,vote_l_it> vote_m_t;
+    //typedef std::map<uint256,vote_l_it> vote_m_t;
+    // VELES BEGIN
+    // Votes are kept in one contiguous vector, the indexes hold positions in it
+    typedef std::vector<CGovernanceVote> vote_v_t;
+
+    typedef std::map<uint256,size_t> vote_m_t;
+
+    typedef std::map<COutPoint,std::vector<size_t> > vote_mn_m_t;
+    // VELES END
 
     typedef vote_m_t::iterator vote_m_it;
 
@@ -41,10 +52,18 @@ private:
 
     int nMemoryVotes;
 
-    vote_l_t listVotes;
+    //vote_l_t listVotes;
+    // VELES BEGIN
+    vote_v_t vecVotes;
+    // VELES END
 
     vote_m_t mapVoteIndex;
 
+    // VELES BEGIN
+    //! Positions of the votes of each masternode
+    vote_mn_m_t mapMasternodeVotes;
+    // VELES END
+
 public:
     CGovernanceObjectVoteFile();
 
@@ -69,25 +88,32 @@ public:
         return nMemoryVotes;
     }
 
-    std::vector<CGovernanceVote> GetVotes() const;
+    //std::vector<CGovernanceVote> GetVotes() const;
+    const std::vector<CGovernanceVote>& GetVotes() const { return vecVotes; } // VELES
 
     CGovernanceObjectVoteFile& operator=(const CGovernanceObjectVoteFile& other);
 
     void RemoveVotesFromMasternode(const COutPoint& outpointMasternode);
 
+    size_t DynamicMemoryUsage() const; // VELES
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action)
     {
         READWRITE(nMemoryVotes);
-        READWRITE(listVotes);
+        //READWRITE(listVotes);
+        READWRITE(vecVotes); // VELES: same encoding as the list
         if(ser_action.ForRead()) {
             RebuildIndex();
         }
     }
 private:
     void RebuildIndex();
+    // VELES BEGIN
+    void RemoveVote(size_t nPos);
+    // VELES END
 
 };
 
@@ -7,6 +7,7 @@
 #include <chainparams.h>
 #include <httpserver.h>
 #include <key_io.h>
+#include <rpc/jsonstream.h> // VELES
 #include <rpc/protocol.h>
 #include <rpc/server.h>
 #include <random.h>
@@ -145,6 +146,38 @@ static bool RPCAuthorized(const std::string& strAuth, std::string& strAuthUserna
     return multiUserAuthorized(strUserPass);
 }
 
+// VELES BEGIN
+/**
+ * Reply to the calls that stream their result, false when the call does not stream. Errors
+ * before the result was written are thrown for the usual error reply, later ones cut the
+ * reply short.
+ */
+static bool StreamJSONRPC(HTTPRequest* req, const JSONRPCRequest& jreq)
+{
+    HTTPStreamedReply reply(req, HTTP_OK, "application/json");
+    JSONStreamWriter writer([&reply](const std::string& strChunk) { reply.Write(strChunk); });
+    // The members of JSONRPCReplyObj, in its order
+    writer.BeginObject();
+    writer.Key("result");
+    try {
+        if (!tableRPC.executeStream(jreq, writer)) return false;
+    } catch (...) {
+        if (!reply.Started()) throw;
+        LogPrintf("%s: %s failed while its reply was sent, the reply is cut short\n", __func__, jreq.strMethod);
+        reply.End("");
+        return true;
+    }
+    writer.Key("error");
+    writer.Value(NullUniValue);
+    writer.Key("id");
+    writer.Value(jreq.id);
+    writer.EndObject();
+    writer.WriteRaw("\n");
+    reply.End(writer.TakeBuffer());
+    return true;
+}
+// VELES END
+
 static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 {
     // JSONRPC handles only POST
@@ -189,6 +222,9 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
+            // VELES BEGIN
+            if (StreamJSONRPC(req, jreq)) return true;
+            // VELES END
             UniValue result = tableRPC.execute(jreq);
 
             // Send reply
@@ -32,6 +32,10 @@
 
 #include <support/events.h>
 #include <deque>
+// VELES BEGIN
+#include <atomic>
+#include <map>
+// VELES END
 
 #ifdef EVENT__HAVE_NETINET_IN_H
 #include <netinet/in.h>
@@ -73,9 +77,20 @@ private:
     /** Mutex protects entire object */
     Mutex cs;
     std::condition_variable cond;
-    std::deque<std::unique_ptr<WorkItem>> queue;
+    // VELES BEGIN
+    //std::deque<std::unique_ptr<WorkItem>> queue;
+    /** The items with the time they were queued at */
+    std::deque<std::pair<int64_t, std::unique_ptr<WorkItem>>> queue;
+    // VELES END
     bool running;
     size_t maxDepth;
+    // VELES BEGIN
+    size_t peakDepth = 0;
+    uint64_t processed = 0;
+    uint64_t rejected = 0;
+    int64_t waitMicrosTotal = 0;
+    int64_t waitMicrosMax = 0;
+    // VELES END
 
 public:
     explicit WorkQueue(size_t _maxDepth) : running(true),
@@ -92,9 +107,14 @@ public:
     {
         LOCK(cs);
         if (queue.size() >= maxDepth) {
+            ++rejected; // VELES
             return false;
         }
-        queue.emplace_back(std::unique_ptr<WorkItem>(item));
+        // VELES BEGIN
+        //queue.emplace_back(std::unique_ptr<WorkItem>(item));
+        queue.emplace_back(GetTimeMicros(), std::unique_ptr<WorkItem>(item));
+        peakDepth = std::max(peakDepth, queue.size());
+        // VELES END
         cond.notify_one();
         return true;
     }
@@ -109,7 +129,14 @@ public:
                     cond.wait(lock);
                 if (!running)
                     break;
-                i = std::move(queue.front());
+                // VELES BEGIN
+                //i = std::move(queue.front());
+                const int64_t waitMicros = GetTimeMicros() - queue.front().first;
+                i = std::move(queue.front().second);
+                ++processed;
+                waitMicrosTotal += waitMicros;
+                waitMicrosMax = std::max(waitMicrosMax, waitMicros);
+                // VELES END
                 queue.pop_front();
             }
             (*i)();
@@ -122,19 +149,52 @@ public:
         running = false;
         cond.notify_all();
     }
+    // VELES BEGIN
+    /** Fill in the depths and the counters of the queue */
+    void GetStats(HTTPWorkQueueStats& stats)
+    {
+        LOCK(cs);
+        stats.nMaxDepth = maxDepth;
+        stats.nDepth = queue.size();
+        stats.nPeakDepth = peakDepth;
+        stats.nProcessed = processed;
+        stats.nRejected = rejected;
+        stats.nWaitMicrosTotal = waitMicrosTotal;
+        stats.nWaitMicrosMax = waitMicrosMax;
+    }
+    // VELES END
 };
 
 struct HTTPPathHandler
 {
-    HTTPPathHandler(std::string _prefix, bool _exactMatch, HTTPRequestHandler _handler):
-        prefix(_prefix), exactMatch(_exactMatch), handler(_handler)
+    // VELES BEGIN
+    //HTTPPathHandler(std::string _prefix, bool _exactMatch, HTTPRequestHandler _handler):
+    //    prefix(_prefix), exactMatch(_exactMatch), handler(_handler)
+    HTTPPathHandler(std::string _prefix, bool _exactMatch, HTTPRequestHandler _handler, HTTPWorkQueueClass _queueClass):
+        prefix(_prefix), exactMatch(_exactMatch), handler(_handler), queueClass(_queueClass)
+    // VELES END
     {
     }
     std::string prefix;
     bool exactMatch;
     HTTPRequestHandler handler;
+    HTTPWorkQueueClass queueClass; // VELES
 };
 
+// VELES BEGIN
+/** Settings of the work queue of an endpoint class */
+static const struct {
+    const char* name;
+    const char* threadsArg;
+    int defaultThreads;
+    const char* depthArg;
+    int defaultDepth;
+} http_work_queue_params[HTTP_WORK_QUEUE_CLASSES] = {
+    {"rpc", "-rpcthreads", DEFAULT_HTTP_THREADS, "-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE},
+    {"rest", "-restthreads", DEFAULT_HTTP_REST_THREADS, "-restworkqueue", DEFAULT_HTTP_REST_WORKQUEUE},
+};
+// VELES END
+
 /** HTTP module state */
 
 //! libevent event loop
@@ -143,8 +203,20 @@ static struct event_base* eventBase = nullptr;
 struct evhttp* eventHTTP = nullptr;
 //! List of subnets to allow RPC connections from
 static std::vector<CSubNet> rpc_allow_subnets;
+// VELES BEGIN
 //! Work queue for handling longer requests off the event loop thread
-static WorkQueue<HTTPClosure>* workQueue = nullptr;
+//static WorkQueue<HTTPClosure>* workQueue = nullptr;
+//! Work queues for handling longer requests off the event loop thread, one per endpoint class
+static WorkQueue<HTTPClosure>* workQueues[HTTP_WORK_QUEUE_CLASSES] = {};
+//! Number of worker threads of each work queue
+static int workQueueThreads[HTTP_WORK_QUEUE_CLASSES] = {};
+//! Requests received on each open connection, only used from the event loop thread
+static std::map<evhttp_connection*, uint64_t> g_http_connections;
+static std::atomic<uint64_t> g_http_connections_total{0};
+static std::atomic<uint64_t> g_http_connections_open{0};
+static std::atomic<uint64_t> g_http_requests{0};
+static std::atomic<uint64_t> g_http_requests_reused{0};
+// VELES END
 //! Handlers for (sub)paths
 std::vector<HTTPPathHandler> pathHandlers;
 //! Bound listening sockets
@@ -210,9 +282,38 @@ static std::string RequestMethodString(HTTPRequest::RequestMethod m)
     }
 }
 
+// VELES BEGIN
+/** Connection close callback, the connection may be freed after this */
+static void http_connection_close_cb(struct evhttp_connection* conn, void*)
+{
+    if (g_http_connections.erase(conn)) {
+        --g_http_connections_open;
+    }
+}
+
+/** Count the request, and the connection when it is a new one rather than one kept alive */
+static void CountHTTPRequest(struct evhttp_request* req)
+{
+    ++g_http_requests;
+    evhttp_connection* conn = evhttp_request_get_connection(req);
+    if (!conn) return;
+    auto it = g_http_connections.find(conn);
+    if (it == g_http_connections.end()) {
+        g_http_connections.emplace(conn, 1);
+        ++g_http_connections_total;
+        ++g_http_connections_open;
+        evhttp_connection_set_closecb(conn, http_connection_close_cb, nullptr);
+    } else {
+        ++it->second;
+        ++g_http_requests_reused;
+    }
+}
+// VELES END
+
 /** HTTP request callback */
 static void http_request_cb(struct evhttp_request* req, void* arg)
 {
+    CountHTTPRequest(req); // VELES
     // Disable reading to work around a libevent bug, fixed in 2.2.0.
     if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
         evhttp_connection* conn = evhttp_request_get_connection(req);
@@ -264,11 +365,21 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
     // Dispatch to worker thread
     if (i != iend) {
         std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(std::move(hreq), path, i->handler));
+        // VELES BEGIN
+        //assert(workQueue);
+        //if (workQueue->Enqueue(item.get()))
+        const int queueClass = static_cast<int>(i->queueClass);
+        WorkQueue<HTTPClosure>* workQueue = workQueues[queueClass];
         assert(workQueue);
         if (workQueue->Enqueue(item.get()))
+        // VELES END
             item.release(); /* if true, queue took ownership */
         else {
-            LogPrintf("WARNING: request rejected because http work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n");
+            // VELES BEGIN
+            //LogPrintf("WARNING: request rejected because http work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n");
+            LogPrintf("WARNING: request rejected because http %s work queue depth exceeded, it can be increased with the %s= setting\n",
+                      http_work_queue_params[queueClass].name, http_work_queue_params[queueClass].depthArg);
+            // VELES END
             item->req->WriteReply(HTTP_INTERNAL, "Work queue depth exceeded");
         }
     } else {
@@ -397,10 +508,17 @@ bool InitHTTPServer()
     }
 
     LogPrint(BCLog::HTTP, "Initialized HTTP server\n");
-    int workQueueDepth = std::max((long)gArgs.GetArg("-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE), 1L);
-    LogPrintf("HTTP: creating work queue of depth %d\n", workQueueDepth);
-
-    workQueue = new WorkQueue<HTTPClosure>(workQueueDepth);
+    // VELES BEGIN
+    //int workQueueDepth = std::max((long)gArgs.GetArg("-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE), 1L);
+    //LogPrintf("HTTP: creating work queue of depth %d\n", workQueueDepth);
+    //
+    //workQueue = new WorkQueue<HTTPClosure>(workQueueDepth);
+    for (int i = 0; i < HTTP_WORK_QUEUE_CLASSES; i++) {
+        int workQueueDepth = std::max((long)gArgs.GetArg(http_work_queue_params[i].depthArg, http_work_queue_params[i].defaultDepth), 1L);
+        LogPrintf("HTTP: creating %s work queue of depth %d\n", http_work_queue_params[i].name, workQueueDepth);
+        workQueues[i] = new WorkQueue<HTTPClosure>(workQueueDepth);
+    }
+    // VELES END
     // transfer ownership to eventBase/HTTP via .release()
     eventBase = base_ctr.release();
     eventHTTP = http_ctr.release();
@@ -427,13 +545,23 @@ static std::vector<std::thread> g_thread_http_workers;
 void StartHTTPServer()
 {
     LogPrint(BCLog::HTTP, "Starting HTTP server\n");
-    int rpcThreads = std::max((long)gArgs.GetArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1L);
-    LogPrintf("HTTP: starting %d worker threads\n", rpcThreads);
+    // VELES BEGIN
+    //int rpcThreads = std::max((long)gArgs.GetArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1L);
+    //LogPrintf("HTTP: starting %d worker threads\n", rpcThreads);
     threadHTTP = std::thread(ThreadHTTP, eventBase);
 
-    for (int i = 0; i < rpcThreads; i++) {
-        g_thread_http_workers.emplace_back(HTTPWorkQueueRun, workQueue);
+    //for (int i = 0; i < rpcThreads; i++) {
+    //    g_thread_http_workers.emplace_back(HTTPWorkQueueRun, workQueue);
+    //}
+    for (int i = 0; i < HTTP_WORK_QUEUE_CLASSES; i++) {
+        int threads = std::max((long)gArgs.GetArg(http_work_queue_params[i].threadsArg, http_work_queue_params[i].defaultThreads), 1L);
+        LogPrintf("HTTP: starting %d %s worker threads\n", threads, http_work_queue_params[i].name);
+        workQueueThreads[i] = threads;
+        for (int j = 0; j < threads; j++) {
+            g_thread_http_workers.emplace_back(HTTPWorkQueueRun, workQueues[i]);
+        }
     }
+    // VELES END
 }
 
 void InterruptHTTPServer()
@@ -443,21 +571,37 @@ void InterruptHTTPServer()
         // Reject requests on current connections
         evhttp_set_gencb(eventHTTP, http_reject_request_cb, nullptr);
     }
-    if (workQueue)
-        workQueue->Interrupt();
+    // VELES BEGIN
+    //if (workQueue)
+    //    workQueue->Interrupt();
+    for (WorkQueue<HTTPClosure>* workQueue : workQueues) {
+        if (workQueue)
+            workQueue->Interrupt();
+    }
+    // VELES END
 }
 
 void StopHTTPServer()
 {
     LogPrint(BCLog::HTTP, "Stopping HTTP server\n");
-    if (workQueue) {
+    // VELES BEGIN
+    //if (workQueue) {
+    if (workQueues[0]) {
+    // VELES END
         LogPrint(BCLog::HTTP, "Waiting for HTTP worker threads to exit\n");
         for (auto& thread: g_thread_http_workers) {
             thread.join();
         }
         g_thread_http_workers.clear();
-        delete workQueue;
-        workQueue = nullptr;
+        // VELES BEGIN
+        //delete workQueue;
+        //workQueue = nullptr;
+        for (int i = 0; i < HTTP_WORK_QUEUE_CLASSES; i++) {
+            delete workQueues[i];
+            workQueues[i] = nullptr;
+            workQueueThreads[i] = 0;
+        }
+        // VELES END
     }
     // Unlisten sockets, these are what make the event loop running, which means
     // that after this and all connections are closed the event loop will quit.
@@ -517,6 +661,12 @@ HTTPRequest::HTTPRequest(struct evhttp_request* _req) : req(_req),
 }
 HTTPRequest::~HTTPRequest()
 {
+    // VELES BEGIN
+    if (chunkedReply && !replySent) {
+        LogPrintf("%s: Unfinished chunked reply\n", __func__);
+        EndChunkedReply();
+    }
+    // VELES END
     if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
@@ -598,6 +748,85 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     req = nullptr; // transferred back to main thread
 }
 
+// VELES BEGIN
+void HTTPRequest::StartChunkedReply(int nStatus)
+{
+    assert(!replySent && !chunkedReply && req);
+    if (ShutdownRequested()) {
+        WriteHeader("Connection", "close");
+    }
+    auto req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, nStatus]{
+        evhttp_send_reply_start(req_copy, nStatus, nullptr);
+    });
+    ev->trigger(nullptr);
+    chunkedReply = true;
+}
+
+void HTTPRequest::WriteReplyChunk(const std::string& strChunk)
+{
+    assert(chunkedReply && !replySent && req);
+    if (strChunk.empty()) return;
+    // The chunk is handed over in its own buffer, the output buffer of the request belongs to the main thread now
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, strChunk.data(), strChunk.size());
+    auto req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, evb]{
+        evhttp_send_reply_chunk(req_copy, evb);
+        evbuffer_free(evb);
+    });
+    ev->trigger(nullptr);
+}
+
+void HTTPRequest::EndChunkedReply()
+{
+    assert(chunkedReply && !replySent && req);
+    auto req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy]{
+        evhttp_send_reply_end(req_copy);
+        // Re-enable reading from the socket, as WriteReply does
+        if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
+            evhttp_connection* conn = evhttp_request_get_connection(req_copy);
+            if (conn) {
+                bufferevent* bev = evhttp_connection_get_bufferevent(conn);
+                if (bev) {
+                    bufferevent_enable(bev, EV_READ | EV_WRITE);
+                }
+            }
+        }
+    });
+    ev->trigger(nullptr);
+    replySent = true;
+    req = nullptr; // transferred back to main thread
+}
+
+HTTPStreamedReply::HTTPStreamedReply(HTTPRequest* _req, int _nStatus, const std::string& _strContentType) :
+    req(_req), nStatus(_nStatus), strContentType(_strContentType)
+{
+}
+
+void HTTPStreamedReply::Write(const std::string& strChunk)
+{
+    if (!req->ChunkedReplyStarted()) {
+        req->WriteHeader("Content-Type", strContentType);
+        req->StartChunkedReply(nStatus);
+    }
+    req->WriteReplyChunk(strChunk);
+}
+
+void HTTPStreamedReply::End(const std::string& strRest)
+{
+    if (req->ChunkedReplyStarted()) {
+        req->WriteReplyChunk(strRest);
+        req->EndChunkedReply();
+    } else {
+        req->WriteHeader("Content-Type", strContentType);
+        req->WriteReply(nStatus, strRest);
+    }
+}
+// VELES END
+
 CService HTTPRequest::GetPeer() const
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
@@ -638,10 +867,16 @@ HTTPRequest::RequestMethod HTTPRequest::GetRequestMethod() const
     }
 }
 
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler)
+// VELES BEGIN
+//void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler)
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler, HTTPWorkQueueClass queueClass)
+// VELES END
 {
     LogPrint(BCLog::HTTP, "Registering HTTP handler for %s (exactmatch %d)\n", prefix, exactMatch);
-    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler));
+    // VELES BEGIN
+    //pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler));
+    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler, queueClass));
+    // VELES END
 }
 
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch)
@@ -658,6 +893,32 @@ void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch)
     }
 }
 
+// VELES BEGIN
+std::vector<HTTPWorkQueueStats> GetHTTPWorkQueueStats()
+{
+    std::vector<HTTPWorkQueueStats> vStats;
+    for (int i = 0; i < HTTP_WORK_QUEUE_CLASSES; i++) {
+        HTTPWorkQueueStats stats;
+        stats.name = http_work_queue_params[i].name;
+        stats.nThreads = workQueueThreads[i];
+        if (workQueues[i])
+            workQueues[i]->GetStats(stats);
+        vStats.push_back(stats);
+    }
+    return vStats;
+}
+
+HTTPConnectionStats GetHTTPConnectionStats()
+{
+    HTTPConnectionStats stats;
+    stats.nConnections = g_http_connections_total;
+    stats.nRequests = g_http_requests;
+    stats.nReused = g_http_requests_reused;
+    stats.nOpen = g_http_connections_open;
+    return stats;
+}
+// VELES END
+
 std::string urlDecode(const std::string &urlEncoded) {
     std::string res;
     if (!urlEncoded.empty()) {
@@ -8,10 +8,49 @@
 #include <string>
 #include <stdint.h>
 #include <functional>
+#include <vector> // VELES
 
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
+// VELES BEGIN
+static const int DEFAULT_HTTP_REST_THREADS=2;
+static const int DEFAULT_HTTP_REST_WORKQUEUE=16;
+
+/**
+ * Classes of endpoints, each served by a work queue and worker threads of its own so that a
+ * flood of requests to one class does not get the requests to the others rejected.
+ */
+enum class HTTPWorkQueueClass {
+    RPC = 0,    //!< JSON-RPC and the wallet endpoints, sized by -rpcthreads and -rpcworkqueue
+    REST = 1,   //!< The REST interface, sized by -restthreads and -restworkqueue
+};
+static const int HTTP_WORK_QUEUE_CLASSES = 2;
+
+/** Counters of a work queue, the wait is the time requests spent queued before a worker took them */
+struct HTTPWorkQueueStats {
+    std::string name;
+    int nThreads = 0;
+    size_t nMaxDepth = 0;
+    size_t nDepth = 0;
+    size_t nPeakDepth = 0;
+    uint64_t nProcessed = 0;
+    uint64_t nRejected = 0;
+    int64_t nWaitMicrosTotal = 0;
+    int64_t nWaitMicrosMax = 0;
+};
+
+/** Counters of the HTTP connections, a reused connection is one kept alive for another request */
+struct HTTPConnectionStats {
+    uint64_t nConnections = 0;
+    uint64_t nRequests = 0;
+    uint64_t nReused = 0;
+    uint64_t nOpen = 0;
+};
+
+std::vector<HTTPWorkQueueStats> GetHTTPWorkQueueStats();
+HTTPConnectionStats GetHTTPConnectionStats();
+// VELES END
 
 struct evhttp_request;
 struct event_base;
@@ -42,7 +81,10 @@ typedef std::function<bool(HTTPRequest* req, const std::string &)> HTTPRequestHa
  * If multiple handlers match a prefix, the first-registered one will
  * be invoked.
  */
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler);
+// VELES BEGIN
+//void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler);
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler, HTTPWorkQueueClass queueClass = HTTPWorkQueueClass::RPC);
+// VELES END
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
@@ -59,6 +101,7 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    bool chunkedReply = false; // VELES
 
 public:
     explicit HTTPRequest(struct evhttp_request* req);
@@ -114,7 +157,43 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    // VELES BEGIN
+    /**
+     * Start a reply sent in chunks, for replies too large to build before sending them. Write
+     * the body with WriteReplyChunk and finish with EndChunkedReply, the other methods must not
+     * be called in between. Clients speaking HTTP/1.0 get the body as it is written and the
+     * connection closed at the end.
+     */
+    void StartChunkedReply(int nStatus);
+    void WriteReplyChunk(const std::string& strChunk);
+    /** Give the request back to the main thread, like WriteReply */
+    void EndChunkedReply();
+    bool ChunkedReplyStarted() const { return chunkedReply; }
+    // VELES END
+};
+
+// VELES BEGIN
+/**
+ * Reply body produced in pieces. The pieces are sent as a chunked reply, started with the
+ * first piece, and a body that is complete before any piece was written is sent at once.
+ */
+class HTTPStreamedReply
+{
+private:
+    HTTPRequest* req;
+    int nStatus;
+    std::string strContentType;
+
+public:
+    HTTPStreamedReply(HTTPRequest* req, int nStatus, const std::string& strContentType);
+    void Write(const std::string& strChunk);
+    /** Send the rest of the body and give the request back */
+    void End(const std::string& strRest);
+    /** Whether pieces were sent, so an error can no longer be replied */
+    bool Started() const { return req->ChunkedReplyStarted(); }
 };
+// VELES END
 
 /** Event handler closure.
  */
@@ -0,0 +1,298 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/addressindex.h>
+
+#include <chainparams.h>
+#include <hash.h>
+#include <undo.h>
+#include <util/system.h>
+#include <validation.h>
+
+/* The index database stores two kinds of entries per output script, both keyed by the Hash160 of
+ * the script so that every range scan for an address is a prefix scan:
+ *
+ * Keys for the deltas have the type [DB_ADDRESS_DELTA, uint160, uint32 height (BE), uint256 txid,
+ * uint32 index (BE), uint8 spending] and the signed amount as value, which lists the history of an
+ * address in height order.
+ * Keys for the unspent outputs have the type [DB_ADDRESS_UNSPENT, uint160, uint256 txid,
+ * uint32 index (BE)] and the amount, script and height of the output as value.
+ */
+constexpr char DB_ADDRESS_DELTA = 'a';
+constexpr char DB_ADDRESS_UNSPENT = 'u';
+
+std::unique_ptr<AddressIndex> g_addressindex;
+
+namespace {
+
+struct DBDeltaKey {
+    uint160 address_hash;
+    int height;
+    uint256 txhash;
+    uint32_t index;
+    bool spending;
+
+    DBDeltaKey() : height(0), index(0), spending(false) {}
+    DBDeltaKey(const uint160& address_hash_in, int height_in, const uint256& txhash_in, uint32_t index_in, bool spending_in) :
+        address_hash(address_hash_in), height(height_in), txhash(txhash_in), index(index_in), spending(spending_in) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_ADDRESS_DELTA);
+        s << address_hash;
+        ser_writedata32be(s, height);
+        s << txhash;
+        ser_writedata32be(s, index);
+        ser_writedata8(s, spending);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char prefix = ser_readdata8(s);
+        if (prefix != DB_ADDRESS_DELTA) {
+            throw std::ios_base::failure("Invalid format for address index DB delta key");
+        }
+        s >> address_hash;
+        height = ser_readdata32be(s);
+        s >> txhash;
+        index = ser_readdata32be(s);
+        spending = ser_readdata8(s) != 0;
+    }
+};
+
+struct DBUnspentKey {
+    uint160 address_hash;
+    uint256 txhash;
+    uint32_t index;
+
+    DBUnspentKey() : index(0) {}
+    DBUnspentKey(const uint160& address_hash_in, const uint256& txhash_in, uint32_t index_in) :
+        address_hash(address_hash_in), txhash(txhash_in), index(index_in) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_ADDRESS_UNSPENT);
+        s << address_hash;
+        s << txhash;
+        ser_writedata32be(s, index);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char prefix = ser_readdata8(s);
+        if (prefix != DB_ADDRESS_UNSPENT) {
+            throw std::ios_base::failure("Invalid format for address index DB unspent key");
+        }
+        s >> address_hash;
+        s >> txhash;
+        index = ser_readdata32be(s);
+    }
+};
+
+struct DBUnspentVal {
+    CAmount amount;
+    CScript script;
+    int height;
+
+    DBUnspentVal() : amount(0), height(0) {}
+    DBUnspentVal(CAmount amount_in, const CScript& script_in, int height_in) :
+        amount(amount_in), script(script_in), height(height_in) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(amount);
+        READWRITE(script);
+        READWRITE(height);
+    }
+};
+
+} // namespace
+
+/** Serialized key prefix of all the entries of one kind for an address */
+static std::vector<unsigned char> AddressPrefix(char type, const uint160& address_hash)
+{
+    std::vector<unsigned char> prefix;
+    prefix.reserve(1 + address_hash.size());
+    prefix.push_back(type);
+    prefix.insert(prefix.end(), address_hash.begin(), address_hash.end());
+    return prefix;
+}
+
+/** Outputs that can never be spent or carry no script are not worth indexing */
+static bool IsIndexedScript(const CScript& script)
+{
+    return !script.empty() && !script.IsUnspendable();
+}
+
+uint160 GetAddressIndexHash(const CScript& script)
+{
+    return Hash160(script.begin(), script.end());
+}
+
+AddressIndex::AddressIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<BaseIndex::DB>(GetDataDir() / "indexes" / "addressindex", n_cache_size, f_memory, f_wipe))
+{}
+
+bool AddressIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    // The outputs of the genesis block are not spendable
+    if (pindex->nHeight == 0) return true;
+
+    CBlockUndo block_undo;
+    if (!UndoReadFromDisk(block_undo, pindex)) {
+        return false;
+    }
+    if (block_undo.vtxundo.size() + 1 != block.vtx.size()) {
+        return error("%s: undo data of block %s does not match the block", __func__, pindex->GetBlockHash().ToString());
+    }
+
+    CDBBatch batch(*m_db);
+    for (size_t i = 0; i < block.vtx.size(); ++i) {
+        const CTransaction& tx = *block.vtx[i];
+        const uint256& txhash = tx.GetHash();
+
+        if (!tx.IsCoinBase()) {
+            const CTxUndo& tx_undo = block_undo.vtxundo[i - 1];
+            if (tx_undo.vprevout.size() != tx.vin.size()) {
+                return error("%s: undo data of tx %s does not match the tx", __func__, txhash.ToString());
+            }
+            for (size_t j = 0; j < tx.vin.size(); ++j) {
+                const CTxOut& prevout = tx_undo.vprevout[j].out;
+                if (!IsIndexedScript(prevout.scriptPubKey)) continue;
+                const uint160 address_hash = GetAddressIndexHash(prevout.scriptPubKey);
+                batch.Write(DBDeltaKey(address_hash, pindex->nHeight, txhash, j, true), -prevout.nValue);
+                batch.Erase(DBUnspentKey(address_hash, tx.vin[j].prevout.hash, tx.vin[j].prevout.n));
+            }
+        }
+
+        for (size_t j = 0; j < tx.vout.size(); ++j) {
+            const CTxOut& out = tx.vout[j];
+            if (!IsIndexedScript(out.scriptPubKey)) continue;
+            const uint160 address_hash = GetAddressIndexHash(out.scriptPubKey);
+            batch.Write(DBDeltaKey(address_hash, pindex->nHeight, txhash, j, false), out.nValue);
+            batch.Write(DBUnspentKey(address_hash, txhash, j), DBUnspentVal(out.nValue, out.scriptPubKey, pindex->nHeight));
+        }
+    }
+    return m_db->WriteBatch(batch);
+}
+
+bool AddressIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    // Undo the disconnected blocks from the tip down and their transactions in reverse order, so an
+    // output created and spent within the range ends up erased after it was restored.
+    CDBBatch batch(*m_db);
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+            return error("%s: Failed to read block %s from disk", __func__, pindex->GetBlockHash().ToString());
+        }
+        CBlockUndo block_undo;
+        if (!UndoReadFromDisk(block_undo, pindex) || block_undo.vtxundo.size() + 1 != block.vtx.size()) {
+            return error("%s: Failed to read undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+        }
+
+        for (size_t i = block.vtx.size(); i-- > 0;) {
+            const CTransaction& tx = *block.vtx[i];
+            const uint256& txhash = tx.GetHash();
+
+            for (size_t j = 0; j < tx.vout.size(); ++j) {
+                const CTxOut& out = tx.vout[j];
+                if (!IsIndexedScript(out.scriptPubKey)) continue;
+                const uint160 address_hash = GetAddressIndexHash(out.scriptPubKey);
+                batch.Erase(DBDeltaKey(address_hash, pindex->nHeight, txhash, j, false));
+                batch.Erase(DBUnspentKey(address_hash, txhash, j));
+            }
+
+            if (tx.IsCoinBase()) continue;
+            const CTxUndo& tx_undo = block_undo.vtxundo[i - 1];
+            if (tx_undo.vprevout.size() != tx.vin.size()) {
+                return error("%s: undo data of tx %s does not match the tx", __func__, txhash.ToString());
+            }
+            for (size_t j = 0; j < tx.vin.size(); ++j) {
+                const Coin& coin = tx_undo.vprevout[j];
+                if (!IsIndexedScript(coin.out.scriptPubKey)) continue;
+                const uint160 address_hash = GetAddressIndexHash(coin.out.scriptPubKey);
+                batch.Erase(DBDeltaKey(address_hash, pindex->nHeight, txhash, j, true));
+                batch.Write(DBUnspentKey(address_hash, tx.vin[j].prevout.hash, tx.vin[j].prevout.n),
+                            DBUnspentVal(coin.out.nValue, coin.out.scriptPubKey, coin.nHeight));
+            }
+        }
+    }
+    if (!m_db->WriteBatch(batch)) return false;
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+bool AddressIndex::FindAddressDeltas(const uint160& address_hash, int start_height, int end_height,
+                                     std::vector<AddressDelta>& deltas_out) const
+{
+    std::unique_ptr<CDBIterator> db_it(m_db->NewIterator());
+    db_it->Seek(DBDeltaKey(address_hash, std::max(start_height, 0), uint256(), 0, false));
+
+    // Keys and values are decoded in place from the iterator, an address with a long history
+    // is scanned without copying every entry into a stream first
+    const std::vector<unsigned char> prefix = AddressPrefix(DB_ADDRESS_DELTA, address_hash);
+    const CDBFixedKeyDecoder<DBDeltaKey> decode_key;
+    DBDeltaKey key;
+    bool corrupt = false;
+    db_it->ForEachWithPrefix(MakeSpan(prefix), [&](Span<const unsigned char> key_span, Span<const unsigned char> value_span) {
+        if (!decode_key(key_span, key) || key.height > end_height) {
+            return false;
+        }
+        CAmount amount;
+        try {
+            SpanReader value_reader(SER_DISK, CLIENT_VERSION, value_span);
+            value_reader >> amount;
+        } catch (const std::exception&) {
+            corrupt = true;
+            return false;
+        }
+        deltas_out.push_back({key.txhash, key.index, key.height, key.spending, amount});
+        return true;
+    });
+    if (corrupt) {
+        return error("%s: unable to read value in %s at key (%c, %s)",
+                     __func__, GetName(), DB_ADDRESS_DELTA, address_hash.ToString());
+    }
+    return true;
+}
+
+bool AddressIndex::FindAddressUnspent(const uint160& address_hash, std::vector<AddressUnspent>& unspent_out) const
+{
+    std::unique_ptr<CDBIterator> db_it(m_db->NewIterator());
+    db_it->Seek(DBUnspentKey(address_hash, uint256(), 0));
+
+    const std::vector<unsigned char> prefix = AddressPrefix(DB_ADDRESS_UNSPENT, address_hash);
+    const CDBFixedKeyDecoder<DBUnspentKey> decode_key;
+    DBUnspentKey key;
+    bool corrupt = false;
+    db_it->ForEachWithPrefix(MakeSpan(prefix), [&](Span<const unsigned char> key_span, Span<const unsigned char> value_span) {
+        if (!decode_key(key_span, key)) {
+            return false;
+        }
+        DBUnspentVal value;
+        try {
+            SpanReader value_reader(SER_DISK, CLIENT_VERSION, value_span);
+            value_reader >> value;
+        } catch (const std::exception&) {
+            corrupt = true;
+            return false;
+        }
+        unspent_out.push_back({key.txhash, key.index, value.amount, value.script, value.height});
+        return true;
+    });
+    if (corrupt) {
+        return error("%s: unable to read value in %s at key (%c, %s)",
+                     __func__, GetName(), DB_ADDRESS_UNSPENT, address_hash.ToString());
+    }
+    return true;
+}
@@ -0,0 +1,73 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef VELES_INDEX_ADDRESSINDEX_H
+#define VELES_INDEX_ADDRESSINDEX_H
+
+#include <amount.h>
+#include <chain.h>
+#include <index/base.h>
+#include <script/script.h>
+#include <uint256.h>
+
+#include <vector>
+
+/** A change of the funds paid to an address by one transaction output or input. */
+struct AddressDelta {
+    uint256 txhash;
+    //! Output index, or input index of a spending delta
+    uint32_t index;
+    int height;
+    bool spending;
+    //! Satoshis received, negative when spent
+    CAmount amount;
+};
+
+/** An output paid to an address that is not spent in the active chain. */
+struct AddressUnspent {
+    uint256 txhash;
+    uint32_t index;
+    CAmount amount;
+    CScript script;
+    int height;
+};
+
+/** Key the address index uses for an output script, the same for all encodings of an address. */
+uint160 GetAddressIndexHash(const CScript& script);
+
+/**
+ * AddressIndex records, for every output script, the outputs paying to it and the inputs spending
+ * them in the active chain, ordered by height, as well as the outputs that are still unspent.
+ * Entries of blocks that get disconnected are removed again using the block undo data.
+ */
+class AddressIndex final : public BaseIndex
+{
+private:
+    std::unique_ptr<BaseIndex::DB> m_db;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    BaseIndex::DB& GetDB() const override { return *m_db; }
+
+    const char* GetName() const override { return "addressindex"; }
+
+public:
+    /** Constructs the index, which becomes available to be queried. */
+    explicit AddressIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    /** Get the deltas of an address between two heights, inclusive, in height order. */
+    bool FindAddressDeltas(const uint160& address_hash, int start_height, int end_height,
+                           std::vector<AddressDelta>& deltas_out) const;
+
+    /** Get the unspent outputs of an address. */
+    bool FindAddressUnspent(const uint160& address_hash, std::vector<AddressUnspent>& unspent_out) const;
+};
+
+/// The global address index. May be null.
+extern std::unique_ptr<AddressIndex> g_addressindex;
+
+#endif // VELES_INDEX_ADDRESSINDEX_H
@@ -11,10 +11,18 @@
 #include <validation.h>
 #include <warnings.h>
 
+#include <algorithm> // VELES
+#include <atomic> // VELES
+#include <thread> // VELES
+
 constexpr char DB_BEST_BLOCK = 'B';
 
 constexpr int64_t SYNC_LOG_INTERVAL = 30; // seconds
 constexpr int64_t SYNC_LOCATOR_WRITE_INTERVAL = 30; // seconds
+// VELES BEGIN
+constexpr size_t SYNC_BATCH_BLOCKS = 64; // blocks read and written together
+constexpr int MAX_SYNC_READ_THREADS = 8;
+// VELES END
 
 template<typename... Args>
 static void FatalError(const char* fmt, const Args&... args)
@@ -46,6 +54,13 @@ bool BaseIndex::DB::WriteBestBlock(const CBlockLocator& locator)
     return Write(DB_BEST_BLOCK, locator);
 }
 
+// VELES BEGIN
+void BaseIndex::DB::WriteBestBlock(CDBBatch& batch, const CBlockLocator& locator)
+{
+    batch.Write(DB_BEST_BLOCK, locator);
+}
+// VELES END
+
 BaseIndex::~BaseIndex()
 {
     Interrupt();
@@ -69,6 +84,49 @@ bool BaseIndex::Init()
     return true;
 }
 
+// VELES BEGIN
+/**
+ * Read and check blocks from disk on several threads, the PoW hashes being the bulk of the work.
+ * The transactions of the blocks are allocated from one arena per thread, reused for every batch.
+ */
+static bool ReadBlocksFromDisk(const std::vector<const CBlockIndex*>& pindexes, std::vector<CBlock>& blocks, std::vector<std::unique_ptr<CMonotonicArena>>& arenas, const Consensus::Params& consensus_params)
+{
+    blocks.clear();
+    for (auto& arena : arenas) {
+        arena->Clear();
+    }
+    blocks.resize(pindexes.size());
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+    auto read = [&](CMonotonicArena& arena) {
+        for (size_t i = next++; i < pindexes.size() && !failed; i = next++) {
+            if (!ReadBlockFromDisk(blocks[i], pindexes[i], consensus_params, arena)) {
+                error("%s: Failed to read block %s from disk", __func__, pindexes[i]->GetBlockHash().ToString());
+                failed = true;
+            }
+        }
+    };
+
+    const int n_threads = std::max(1, std::min<int>({GetNumCores(), MAX_SYNC_READ_THREADS, (int)pindexes.size()}));
+    while ((int)arenas.size() < n_threads) {
+        arenas.push_back(MakeUnique<CMonotonicArena>());
+    }
+    if (n_threads == 1) {
+        read(*arenas[0]);
+    } else {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < n_threads; i++) {
+            CMonotonicArena& arena = *arenas[i];
+            threads.emplace_back(&TraceThread<std::function<void()>>, "idxread", [&read, &arena]() { read(arena); });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+    return !failed;
+}
+// VELES END
+
 static const CBlockIndex* NextSyncBlock(const CBlockIndex* pindex_prev) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     AssertLockHeld(cs_main);
@@ -93,9 +151,23 @@ void BaseIndex::ThreadSync()
 
         int64_t last_log_time = 0;
         int64_t last_locator_write_time = 0;
+        // VELES BEGIN
+        const int64_t sync_start_time = GetTimeMillis();
+        std::vector<const CBlockIndex*> pindexes;
+        // the arenas are declared first to outlive the blocks allocated from them
+        std::vector<std::unique_ptr<CMonotonicArena>> arenas;
+        std::vector<CBlock> blocks;
+        // VELES END
         while (true) {
             if (m_interrupt) {
-                WriteBestBlock(pindex);
+                //WriteBestBlock(pindex);
+                // VELES BEGIN
+                m_best_block_index = pindex;
+                // No need to handle errors in Commit. If it fails, the error will be already be
+                // logged. The best way to recover is to continue, as index cannot be corrupted by
+                // a missed commit to disk for an advanced index state.
+                Commit();
+                // VELES END
                 return;
             }
 
@@ -103,37 +175,91 @@ void BaseIndex::ThreadSync()
                 LOCK(cs_main);
                 const CBlockIndex* pindex_next = NextSyncBlock(pindex);
                 if (!pindex_next) {
-                    WriteBestBlock(pindex);
+                    //WriteBestBlock(pindex);
                     m_best_block_index = pindex;
                     m_synced = true;
+                    // VELES BEGIN
+                    // No need to handle errors in Commit. See rationale above.
+                    Commit();
+                    // VELES END
                     break;
                 }
-                pindex = pindex_next;
+                // VELES BEGIN
+                if (pindex_next->pprev != pindex && !Rewind(pindex, pindex_next->pprev)) {
+                    FatalError("%s: Failed to rewind index %s to a previous chain tip",
+                               __func__, GetName());
+                    return;
+                }
+                // VELES END
+                //pindex = pindex_next;
+                // VELES BEGIN
+                // The next blocks of the active chain are read and written together
+                pindexes.assign(1, pindex_next);
+                while (pindexes.size() < SYNC_BATCH_BLOCKS && (pindex_next = chainActive.Next(pindexes.back()))) {
+                    pindexes.push_back(pindex_next);
+                }
+                // VELES END
             }
 
             int64_t current_time = GetTime();
             if (last_log_time + SYNC_LOG_INTERVAL < current_time) {
-                LogPrintf("Syncing %s with block chain from height %d\n",
-                          GetName(), pindex->nHeight);
+                //LogPrintf("Syncing %s with block chain from height %d\n",
+                //          GetName(), pindex->nHeight);
+                // VELES BEGIN
+                const int64_t sync_time_ms = std::max<int64_t>(m_sync_time_ms, 1);
+                LogPrintf("Syncing %s with block chain from height %d (%.1f blocks/s, %.1f tx/s)\n",
+                          GetName(), pindexes.front()->nHeight,
+                          m_sync_blocks * 1000.0 / sync_time_ms, m_sync_transactions * 1000.0 / sync_time_ms);
+                // VELES END
                 last_log_time = current_time;
             }
 
-            if (last_locator_write_time + SYNC_LOCATOR_WRITE_INTERVAL < current_time) {
-                WriteBestBlock(pindex);
-                last_locator_write_time = current_time;
-            }
-
-            CBlock block;
-            if (!ReadBlockFromDisk(block, pindex, consensus_params)) {
-                FatalError("%s: Failed to read block %s from disk",
-                           __func__, pindex->GetBlockHash().ToString());
+            //if (last_locator_write_time + SYNC_LOCATOR_WRITE_INTERVAL < current_time) {
+            //    WriteBestBlock(pindex);
+            //    last_locator_write_time = current_time;
+            //}
+
+            //CBlock block;
+            //if (!ReadBlockFromDisk(block, pindex, consensus_params)) {
+            //    FatalError("%s: Failed to read block %s from disk",
+            //               __func__, pindex->GetBlockHash().ToString());
+            //    return;
+            //}
+            //if (!WriteBlock(block, pindex)) {
+            //    FatalError("%s: Failed to write block %s to index database",
+            //               __func__, pindex->GetBlockHash().ToString());
+            //    return;
+            //}
+            // VELES BEGIN
+            if (!ReadBlocksFromDisk(pindexes, blocks, arenas, consensus_params)) {
+                FatalError("%s: Failed to read blocks %d-%d from disk",
+                           __func__, pindexes.front()->nHeight, pindexes.back()->nHeight);
                 return;
             }
-            if (!WriteBlock(block, pindex)) {
-                FatalError("%s: Failed to write block %s to index database",
-                           __func__, pindex->GetBlockHash().ToString());
+            if (!WriteBlocks(blocks, pindexes)) {
+                FatalError("%s: Failed to write blocks %d-%d to index database",
+                           __func__, pindexes.front()->nHeight, pindexes.back()->nHeight);
                 return;
             }
+            pindex = pindexes.back();
+
+            m_sync_blocks += blocks.size();
+            for (const CBlock& block : blocks) {
+                m_sync_transactions += block.vtx.size();
+            }
+            m_sync_time_ms = GetTimeMillis() - sync_start_time;
+            // VELES END
+
+            // VELES BEGIN
+            // The locator may only point at a block once its entries are written,
+            // otherwise the index would resume past a block it never stored
+            m_best_block_index = pindex;
+            if (last_locator_write_time + SYNC_LOCATOR_WRITE_INTERVAL < current_time) {
+                last_locator_write_time = current_time;
+                // No need to handle errors in Commit. See rationale above.
+                Commit();
+            }
+            // VELES END
         }
     }
 
@@ -144,6 +270,18 @@ void BaseIndex::ThreadSync()
     }
 }
 
+// VELES BEGIN
+bool BaseIndex::WriteBlocks(const std::vector<CBlock>& blocks, const std::vector<const CBlockIndex*>& pindexes)
+{
+    for (size_t i = 0; i < blocks.size(); i++) {
+        if (!WriteBlock(blocks[i], pindexes[i])) {
+            return error("%s: Failed to write block %s to %s", __func__, pindexes[i]->GetBlockHash().ToString(), GetName());
+        }
+    }
+    return true;
+}
+// VELES END
+
 bool BaseIndex::WriteBestBlock(const CBlockIndex* block_index)
 {
     LOCK(cs_main);
@@ -153,6 +291,40 @@ bool BaseIndex::WriteBestBlock(const CBlockIndex* block_index)
     return true;
 }
 
+// VELES BEGIN
+bool BaseIndex::Commit()
+{
+    CDBBatch batch(GetDB());
+    if (!CommitInternal(batch) || !GetDB().WriteBatch(batch)) {
+        return error("%s: Failed to commit latest %s state", __func__, GetName());
+    }
+    return true;
+}
+
+bool BaseIndex::CommitInternal(CDBBatch& batch)
+{
+    LOCK(cs_main);
+    GetDB().WriteBestBlock(batch, chainActive.GetLocator(m_best_block_index));
+    return true;
+}
+
+bool BaseIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip == m_best_block_index);
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    // In the case of a reorg, ensure persisted block locator is not stale.
+    m_best_block_index = new_tip;
+    if (!Commit()) {
+        // If commit fails, revert the best block index to avoid corruption.
+        m_best_block_index = current_tip;
+        return false;
+    }
+
+    return true;
+}
+// VELES END
+
 void BaseIndex::BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex,
                                const std::vector<CTransactionRef>& txn_conflicted)
 {
@@ -180,6 +352,13 @@ void BaseIndex::BlockConnected(const std::shared_ptr<const CBlock>& block, const
                       best_block_index->GetBlockHash().ToString());
             return;
         }
+        // VELES BEGIN
+        if (best_block_index != pindex->pprev && !Rewind(best_block_index, pindex->pprev)) {
+            FatalError("%s: Failed to rewind index %s to a previous chain tip",
+                       __func__, GetName());
+            return;
+        }
+        // VELES END
     }
 
     if (WriteBlock(*block, pindex)) {
@@ -224,9 +403,15 @@ void BaseIndex::ChainStateFlushed(const CBlockLocator& locator)
         return;
     }
 
-    if (!GetDB().WriteBestBlock(locator)) {
-        error("%s: Failed to write locator to disk", __func__);
-    }
+    //if (!GetDB().WriteBestBlock(locator)) {
+    //    error("%s: Failed to write locator to disk", __func__);
+    //}
+    // VELES BEGIN
+    // No need to handle errors in Commit. If it fails, the error will be already be logged. The
+    // best way to recover is to continue, as index cannot be corrupted by a missed commit to disk
+    // for an advanced index state.
+    Commit();
+    // VELES END
 }
 
 bool BaseIndex::BlockUntilSyncedToCurrentChain()
@@ -280,3 +465,18 @@ void BaseIndex::Stop()
         m_thread_sync.join();
     }
 }
+
+// VELES BEGIN
+IndexSummary BaseIndex::GetSummary() const
+{
+    IndexSummary summary;
+    summary.name = GetName();
+    summary.synced = m_synced;
+    const CBlockIndex* pindex = m_best_block_index.load();
+    summary.best_block_height = pindex ? pindex->nHeight : -1;
+    summary.sync_blocks = m_sync_blocks;
+    summary.sync_transactions = m_sync_transactions;
+    summary.sync_time_ms = m_sync_time_ms;
+    return summary;
+}
+// VELES END
@@ -12,8 +12,25 @@
 #include <uint256.h>
 #include <validationinterface.h>
 
+#include <string> // VELES
+#include <vector> // VELES
+
 class CBlockIndex;
 
+// VELES BEGIN
+/** State of an index and throughput of its background sync */
+struct IndexSummary
+{
+    std::string name;
+    bool synced{false};
+    int best_block_height{-1};
+    /// Blocks and transactions written by the background sync, and the time it took
+    int64_t sync_blocks{0};
+    int64_t sync_transactions{0};
+    int64_t sync_time_ms{0};
+};
+// VELES END
+
 /**
  * Base class for indices of blockchain data. This implements
  * CValidationInterface and ensures blocks are indexed sequentially according
@@ -33,6 +50,11 @@ protected:
 
         /// Write block locator of the chain that the txindex is in sync with.
         bool WriteBestBlock(const CBlockLocator& locator);
+
+        // VELES BEGIN
+        /// Write block locator of the chain that the index is in sync with into a batch.
+        void WriteBestBlock(CDBBatch& batch, const CBlockLocator& locator);
+        // VELES END
     };
 
 private:
@@ -47,6 +69,13 @@ private:
     std::thread m_thread_sync;
     CThreadInterrupt m_interrupt;
 
+    // VELES BEGIN
+    /// Progress of the background sync, see GetSummary
+    std::atomic<int64_t> m_sync_blocks{0};
+    std::atomic<int64_t> m_sync_transactions{0};
+    std::atomic<int64_t> m_sync_time_ms{0};
+    // VELES END
+
     /// Sync the index with the block index starting from the current best block.
     /// Intended to be run in its own thread, m_thread_sync, and can be
     /// interrupted with m_interrupt. Once the index gets in sync, the m_synced
@@ -57,6 +86,18 @@ private:
     /// Write the current chain block locator to the DB.
     bool WriteBestBlock(const CBlockIndex* block_index);
 
+    // VELES BEGIN
+    /// Write the current index state (eg. chain block locator and subclass-specific items) to disk.
+    ///
+    /// Recommendations for error handling:
+    /// If called on a successor of the previous committed best block in the index, the index can
+    /// continue processing without risk of corruption, though the index state will need to catch up
+    /// from further behind on reboot. If the new state is not a successor of the previous state (due
+    /// to a chain reorganization), the index must halt until Commit succeeds or else it could end up
+    /// getting corrupted.
+    bool Commit();
+    // VELES END
+
 protected:
     void BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex,
                         const std::vector<CTransactionRef>& txn_conflicted) override;
@@ -69,6 +110,27 @@ protected:
     /// Write update index entries for a newly connected block.
     virtual bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) { return true; }
 
+    // VELES BEGIN
+    /// Write update index entries for consecutive blocks of the chain read by the background
+    /// sync, one block at a time unless overridden to write them together.
+    virtual bool WriteBlocks(const std::vector<CBlock>& blocks, const std::vector<const CBlockIndex*>& pindexes);
+    // VELES END
+
+    // VELES BEGIN
+    /// Virtual method called internally by Commit that can be overridden to atomically
+    /// commit more index state.
+    virtual bool CommitInternal(CDBBatch& batch);
+
+    /// Rewind index to an earlier chain tip during a chain reorg. The tip must
+    /// be an ancestor of the current best block.
+    virtual bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip);
+    // VELES END
+
+    // VELES BEGIN
+    /// The last block in the chain that the index is in sync with, null if there is none yet.
+    const CBlockIndex* CurrentIndex() const { return m_best_block_index.load(); }
+    // VELES END
+
     virtual DB& GetDB() const = 0;
 
     /// Get the name of the index for display in logs.
@@ -93,6 +155,11 @@ public:
 
     /// Stops the instance from staying in sync with blockchain updates.
     void Stop();
+
+    // VELES BEGIN
+    /// Get the state of the index and the throughput of its background sync.
+    IndexSummary GetSummary() const;
+    // VELES END
 };
 
 #endif // BITCOIN_INDEX_BASE_H
@@ -0,0 +1,349 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/coinstatsindex.h>
+
+#include <chainparams.h>
+#include <coins.h>
+#include <undo.h>
+#include <util/system.h>
+#include <validation.h>
+
+/* The index database stores the statistics of the UTXO set after each block. Those of blocks on
+ * the active chain are indexed by height, those of blocks that have been reorganized out of the
+ * active chain by block hash, like in the block filter index.
+ *
+ * Keys for the height index have the type [DB_BLOCK_HEIGHT, uint32 (BE)], their values are the
+ * block hash and the statistics. Keys for the hash index have the type [DB_BLOCK_HASH, uint256].
+ * The MuHash3072 state at the best block, which can't be recovered from the finalized hashes, is
+ * stored under DB_MUHASH and committed together with the best block locator.
+ */
+constexpr char DB_BLOCK_HASH = 's';
+constexpr char DB_BLOCK_HEIGHT = 't';
+constexpr char DB_MUHASH = 'M';
+
+std::unique_ptr<CoinStatsIndex> g_coinstatsindex;
+
+namespace {
+
+struct DBVal {
+    uint256 muhash;
+    uint64_t transaction_output_count;
+    uint64_t bogo_size;
+    CAmount total_amount;
+
+    DBVal() : transaction_output_count(0), bogo_size(0), total_amount(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(muhash);
+        READWRITE(transaction_output_count);
+        READWRITE(bogo_size);
+        READWRITE(total_amount);
+    }
+};
+
+struct DBHeightKey {
+    int height;
+
+    DBHeightKey() : height(0) {}
+    explicit DBHeightKey(int height_in) : height(height_in) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_BLOCK_HEIGHT);
+        ser_writedata32be(s, height);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char prefix = ser_readdata8(s);
+        if (prefix != DB_BLOCK_HEIGHT) {
+            throw std::ios_base::failure("Invalid format for coin stats index DB height key");
+        }
+        height = ser_readdata32be(s);
+    }
+};
+
+struct DBHashKey {
+    uint256 hash;
+
+    explicit DBHashKey(const uint256& hash_in) : hash(hash_in) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        char prefix = DB_BLOCK_HASH;
+        READWRITE(prefix);
+        if (prefix != DB_BLOCK_HASH) {
+            throw std::ios_base::failure("Invalid format for coin stats index DB hash key");
+        }
+
+        READWRITE(hash);
+    }
+};
+
+//! Bytes an unspent output counts for in the bogosize, see gettxoutsetinfo
+uint64_t GetBogoSize(const CScript& script_pub_key)
+{
+    return 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
+           2 /* scriptPubKey len */ + script_pub_key.size() /* scriptPubKey */;
+}
+
+} // namespace
+
+static std::vector<unsigned char> TxOutSer(const COutPoint& outpoint, const Coin& coin)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    ss << outpoint;
+    ss << static_cast<uint32_t>(coin.nHeight * 2 + coin.fCoinBase);
+    ss << coin.out;
+    return std::vector<unsigned char>(ss.begin(), ss.end());
+}
+
+void ApplyCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin)
+{
+    muhash.Insert(TxOutSer(outpoint, coin));
+}
+
+void RemoveCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin)
+{
+    muhash.Remove(TxOutSer(outpoint, coin));
+}
+
+static bool LookupOne(const CDBWrapper& db, const CBlockIndex* block_index, DBVal& result)
+{
+    // The entries of blocks on the active chain are in the height index, the others in the hash index.
+    std::pair<uint256, DBVal> read_out;
+    if (!db.Read(DBHeightKey(block_index->nHeight), read_out)) {
+        return false;
+    }
+    if (read_out.first == block_index->GetBlockHash()) {
+        result = std::move(read_out.second);
+        return true;
+    }
+    return db.Read(DBHashKey(block_index->GetBlockHash()), result);
+}
+
+CoinStatsIndex::CoinStatsIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<BaseIndex::DB>(GetDataDir() / "indexes" / "coinstats", n_cache_size, f_memory, f_wipe))
+{}
+
+bool CoinStatsIndex::Init()
+{
+    if (!m_db->Read(DB_MUHASH, m_muhash)) {
+        // Check that the cause of the read failure is that the key does not exist. Any other errors
+        // indicate database corruption or a disk failure, and starting the index would cause
+        // further corruption.
+        if (m_db->Exists(DB_MUHASH)) {
+            return error("%s: Cannot read current %s state; index may be corrupted",
+                         __func__, GetName());
+        }
+    }
+
+    // The state is that after the block of the stored locator, which may be on a branch that was
+    // reorganized away while the index was not running.
+    CBlockLocator locator;
+    const CBlockIndex* locator_tip = nullptr;
+    if (m_db->ReadBestBlock(locator) && !locator.IsNull()) {
+        LOCK(cs_main);
+        locator_tip = LookupBlockIndex(locator.vHave.front());
+    }
+
+    if (!BaseIndex::Init()) return false;
+
+    const CBlockIndex* pindex = CurrentIndex();
+    if (!pindex) return true;
+    if (!locator_tip || locator_tip->GetAncestor(pindex->nHeight) != pindex) {
+        return error("%s: best block of %s is not a descendant of the block it resumes from", __func__, GetName());
+    }
+
+    DBVal entry;
+    if (!LookupOne(*m_db, locator_tip, entry)) {
+        return error("%s: Cannot read current %s state; index may be corrupted",
+                     __func__, GetName());
+    }
+    uint256 out;
+    m_muhash.Finalize(out);
+    if (entry.muhash != out) {
+        return error("%s: %s state does not match its best block; index may be corrupted",
+                     __func__, GetName());
+    }
+    m_transaction_output_count = entry.transaction_output_count;
+    m_bogo_size = entry.bogo_size;
+    m_total_amount = entry.total_amount;
+
+    for (const CBlockIndex* block_index = locator_tip; block_index != pindex; block_index = block_index->pprev) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, block_index, Params().GetConsensus())) {
+            return error("%s: Failed to read block %s from disk", __func__, block_index->GetBlockHash().ToString());
+        }
+        if (!ReverseBlock(block, block_index)) return false;
+    }
+    return true;
+}
+
+bool CoinStatsIndex::CommitInternal(CDBBatch& batch)
+{
+    batch.Write(DB_MUHASH, m_muhash);
+    return BaseIndex::CommitInternal(batch);
+}
+
+bool CoinStatsIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    // The outputs of the genesis block never enter the UTXO set
+    if (pindex->nHeight > 0) {
+        CBlockUndo block_undo;
+        if (!UndoReadFromDisk(block_undo, pindex)) {
+            return false;
+        }
+        if (block_undo.vtxundo.size() + 1 != block.vtx.size()) {
+            return error("%s: undo data of block %s does not match the block", __func__, pindex->GetBlockHash().ToString());
+        }
+
+        std::pair<uint256, DBVal> read_out;
+        if (!m_db->Read(DBHeightKey(pindex->nHeight - 1), read_out)) {
+            return false;
+        }
+        uint256 expected_block_hash = pindex->pprev->GetBlockHash();
+        if (read_out.first != expected_block_hash) {
+            return error("%s: previous block statistics belong to unexpected block %s; expected %s",
+                         __func__, read_out.first.ToString(), expected_block_hash.ToString());
+        }
+
+        for (size_t i = 0; i < block.vtx.size(); ++i) {
+            const CTransaction& tx = *block.vtx[i];
+            for (uint32_t j = 0; j < tx.vout.size(); ++j) {
+                const CTxOut& out = tx.vout[j];
+                if (out.scriptPubKey.IsUnspendable()) continue;
+                ApplyCoinHash(m_muhash, COutPoint(tx.GetHash(), j), Coin(out, pindex->nHeight, tx.IsCoinBase()));
+                ++m_transaction_output_count;
+                m_bogo_size += GetBogoSize(out.scriptPubKey);
+                m_total_amount += out.nValue;
+            }
+
+            if (tx.IsCoinBase()) continue;
+            const CTxUndo& tx_undo = block_undo.vtxundo[i - 1];
+            if (tx_undo.vprevout.size() != tx.vin.size()) {
+                return error("%s: undo data of tx %s does not match the tx", __func__, tx.GetHash().ToString());
+            }
+            for (size_t j = 0; j < tx.vin.size(); ++j) {
+                const Coin& coin = tx_undo.vprevout[j];
+                RemoveCoinHash(m_muhash, tx.vin[j].prevout, coin);
+                --m_transaction_output_count;
+                m_bogo_size -= GetBogoSize(coin.out.scriptPubKey);
+                m_total_amount -= coin.out.nValue;
+            }
+        }
+    }
+
+    std::pair<uint256, DBVal> value;
+    value.first = pindex->GetBlockHash();
+    m_muhash.Finalize(value.second.muhash);
+    value.second.transaction_output_count = m_transaction_output_count;
+    value.second.bogo_size = m_bogo_size;
+    value.second.total_amount = m_total_amount;
+    return m_db->Write(DBHeightKey(pindex->nHeight), value);
+}
+
+bool CoinStatsIndex::ReverseBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    CBlockUndo block_undo;
+    if (!UndoReadFromDisk(block_undo, pindex)) {
+        return false;
+    }
+    if (block_undo.vtxundo.size() + 1 != block.vtx.size()) {
+        return error("%s: undo data of block %s does not match the block", __func__, pindex->GetBlockHash().ToString());
+    }
+
+    for (size_t i = 0; i < block.vtx.size(); ++i) {
+        const CTransaction& tx = *block.vtx[i];
+        for (uint32_t j = 0; j < tx.vout.size(); ++j) {
+            const CTxOut& out = tx.vout[j];
+            if (out.scriptPubKey.IsUnspendable()) continue;
+            RemoveCoinHash(m_muhash, COutPoint(tx.GetHash(), j), Coin(out, pindex->nHeight, tx.IsCoinBase()));
+            --m_transaction_output_count;
+            m_bogo_size -= GetBogoSize(out.scriptPubKey);
+            m_total_amount -= out.nValue;
+        }
+
+        if (tx.IsCoinBase()) continue;
+        const CTxUndo& tx_undo = block_undo.vtxundo[i - 1];
+        if (tx_undo.vprevout.size() != tx.vin.size()) {
+            return error("%s: undo data of tx %s does not match the tx", __func__, tx.GetHash().ToString());
+        }
+        for (size_t j = 0; j < tx.vin.size(); ++j) {
+            const Coin& coin = tx_undo.vprevout[j];
+            ApplyCoinHash(m_muhash, tx.vin[j].prevout, coin);
+            ++m_transaction_output_count;
+            m_bogo_size += GetBogoSize(coin.out.scriptPubKey);
+            m_total_amount += coin.out.nValue;
+        }
+    }
+
+    // The result must be what was stored for the previous block
+    DBVal entry;
+    if (!LookupOne(*m_db, pindex->pprev, entry)) {
+        return error("%s: unable to read the statistics of block %s", __func__, pindex->pprev->GetBlockHash().ToString());
+    }
+    uint256 out;
+    m_muhash.Finalize(out);
+    if (entry.muhash != out || entry.transaction_output_count != m_transaction_output_count ||
+        entry.bogo_size != m_bogo_size || entry.total_amount != m_total_amount) {
+        return error("%s: statistics after reverting block %s do not match those stored for its parent",
+                     __func__, pindex->GetBlockHash().ToString());
+    }
+    return true;
+}
+
+bool CoinStatsIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    // Keep the entries of the disconnected blocks under their hashes, as the height index
+    // entries get overwritten by the new branch.
+    CDBBatch batch(*m_db);
+    std::unique_ptr<CDBIterator> db_it(m_db->NewIterator());
+    DBHeightKey key(new_tip->nHeight + 1);
+    db_it->Seek(key);
+    for (int height = new_tip->nHeight + 1; height <= current_tip->nHeight; ++height) {
+        if (!db_it->Valid() || !db_it->GetKey(key) || key.height != height) {
+            return error("%s: unexpected key in %s: expected (%c, %d)",
+                         __func__, GetName(), DB_BLOCK_HEIGHT, height);
+        }
+        std::pair<uint256, DBVal> value;
+        if (!db_it->GetValue(value)) {
+            return error("%s: unable to read value in %s at key (%c, %d)",
+                         __func__, GetName(), DB_BLOCK_HEIGHT, height);
+        }
+        batch.Write(DBHashKey(value.first), std::move(value.second));
+        db_it->Next();
+    }
+    if (!m_db->WriteBatch(batch)) return false;
+
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+            return error("%s: Failed to read block %s from disk", __func__, pindex->GetBlockHash().ToString());
+        }
+        if (!ReverseBlock(block, pindex)) return false;
+    }
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+bool CoinStatsIndex::LookUpStats(const CBlockIndex* block_index, CoinStatsEntry& stats_out) const
+{
+    DBVal entry;
+    if (!LookupOne(*m_db, block_index, entry)) {
+        return false;
+    }
+    stats_out = {entry.muhash, entry.transaction_output_count, entry.bogo_size, entry.total_amount};
+    return true;
+}
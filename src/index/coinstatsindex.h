@@ -0,0 +1,75 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef VELES_INDEX_COINSTATSINDEX_H
+#define VELES_INDEX_COINSTATSINDEX_H
+
+#include <amount.h>
+#include <chain.h>
+#include <crypto/muhash.h>
+#include <index/base.h>
+#include <uint256.h>
+
+class Coin;
+class COutPoint;
+
+/** Add an unspent output to the MuHash3072 of a UTXO set. */
+void ApplyCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin);
+/** Remove an unspent output from the MuHash3072 of a UTXO set. */
+void RemoveCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin);
+
+/** Statistics of the UTXO set after a block. */
+struct CoinStatsEntry {
+    //! MuHash3072 of the unspent outputs, see ApplyCoinHash
+    uint256 muhash;
+    uint64_t transaction_output_count;
+    //! The bogosize of gettxoutsetinfo
+    uint64_t bogo_size;
+    CAmount total_amount;
+};
+
+/**
+ * CoinStatsIndex keeps statistics of the UTXO set after every block of the active chain, so they
+ * are available without reading the whole coin database. The set hash is MuHash3072, which is
+ * updated with the outputs a block creates and spends regardless of their order. Entries of
+ * blocks that get disconnected are kept by block hash.
+ */
+class CoinStatsIndex final : public BaseIndex
+{
+private:
+    std::unique_ptr<BaseIndex::DB> m_db;
+
+    //! Statistics after the block the index is in sync with
+    MuHash3072 m_muhash;
+    uint64_t m_transaction_output_count = 0;
+    uint64_t m_bogo_size = 0;
+    CAmount m_total_amount = 0;
+
+    bool ReverseBlock(const CBlock& block, const CBlockIndex* pindex);
+
+protected:
+    bool Init() override;
+
+    bool CommitInternal(CDBBatch& batch) override;
+
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    BaseIndex::DB& GetDB() const override { return *m_db; }
+
+    const char* GetName() const override { return "coinstatsindex"; }
+
+public:
+    /** Constructs the index, which becomes available to be queried. */
+    explicit CoinStatsIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    /** Look up the statistics of the UTXO set after block_index, false if the block is not indexed. */
+    bool LookUpStats(const CBlockIndex* block_index, CoinStatsEntry& stats_out) const;
+};
+
+/// The global coin stats index. May be null.
+extern std::unique_ptr<CoinStatsIndex> g_coinstatsindex;
+
+#endif // VELES_INDEX_COINSTATSINDEX_H
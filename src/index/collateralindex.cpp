@@ -0,0 +1,69 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/collateralindex.h>
+
+#include <primitives/block.h>
+#include <script/script.h>
+#include <tinyformat.h>
+
+CollateralIndex g_collateral_index;
+
+const std::string CollateralIndex::SERIALIZATION_VERSION_STRING = "CollateralIndex-Version-2";
+const std::string CollateralIndex::SERIALIZATION_VERSION_STRING_V1 = "CollateralIndex-Version-1";
+
+bool CollateralIndex::IsCollateral(const CTransaction& tx)
+{
+    for (const CTxOut& txout : tx.vout) {
+        // OP_RETURN followed by the push of a 32 byte hash
+        const CScript& script = txout.scriptPubKey;
+        if (txout.nValue > 0 && script.size() == 34 && script[0] == OP_RETURN && script[1] == 32)
+            return true;
+    }
+    return false;
+}
+
+void CollateralIndex::BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex, const std::vector<CTransactionRef>& txnConflicted)
+{
+    LOCK(cs);
+    const uint256 hash = block->GetHash();
+    for (const CTransactionRef& tx : block->vtx) {
+        if (!tx->IsCoinBase() && IsCollateral(*tx))
+            mapCollaterals[tx->GetHash()] = Collateral{hash, tx->vout};
+    }
+}
+
+void CollateralIndex::BlockDisconnected(const std::shared_ptr<const CBlock>& block)
+{
+    LOCK(cs);
+    const uint256 hash = block->GetHash();
+    for (const CTransactionRef& tx : block->vtx) {
+        auto it = mapCollaterals.find(tx->GetHash());
+        if (it != mapCollaterals.end() && it->second.hashBlock == hash)
+            mapCollaterals.erase(it);
+    }
+}
+
+bool CollateralIndex::GetCollateral(const uint256& txid, std::vector<CTxOut>& voutRet, uint256& hashBlockRet) const
+{
+    LOCK(cs);
+    auto it = mapCollaterals.find(txid);
+    if (it == mapCollaterals.end())
+        return false;
+    voutRet = it->second.vout;
+    hashBlockRet = it->second.hashBlock;
+    return true;
+}
+
+void CollateralIndex::Clear()
+{
+    LOCK(cs);
+    mapCollaterals.clear();
+}
+
+std::string CollateralIndex::ToString() const
+{
+    LOCK(cs);
+    return strprintf("Collaterals: %d", mapCollaterals.size());
+}
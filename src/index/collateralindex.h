@@ -0,0 +1,110 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef VELES_INDEX_COLLATERALINDEX_H
+#define VELES_INDEX_COLLATERALINDEX_H
+
+#include <primitives/transaction.h>
+#include <serialize.h>
+#include <sync.h>
+#include <uint256.h>
+#include <validationinterface.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+class CBlock;
+class CBlockIndex;
+
+/**
+ * CollateralIndex keeps the outputs of the transactions that can be the
+ * collateral of a governance object, the ones burning coins to an OP_RETURN
+ * of a hash, along with their blocks. Checking a collateral is then a single
+ * lookup, without loading the transaction from the transaction index, which
+ * pruned nodes don't have. The collaterals of masternodes are unspent and
+ * checked against their coins instead. The index follows the connected
+ * blocks and is saved to collateralindex.dat at shutdown.
+ */
+class CollateralIndex final : public CValidationInterface
+{
+private:
+    static const std::string SERIALIZATION_VERSION_STRING;
+    //! The first version kept the whole transactions
+    static const std::string SERIALIZATION_VERSION_STRING_V1;
+
+    struct Collateral {
+        uint256 hashBlock;
+        std::vector<CTxOut> vout;
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action) {
+            READWRITE(hashBlock);
+            READWRITE(vout);
+        }
+    };
+
+    //! A collateral as kept by the first version
+    struct CollateralTx {
+        uint256 hashBlock;
+        CTransactionRef tx;
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action) {
+            READWRITE(hashBlock);
+            READWRITE(tx);
+        }
+    };
+
+    mutable CCriticalSection cs;
+    //! Collateral transactions by txid
+    std::map<uint256, Collateral> mapCollaterals;
+
+protected:
+    void BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex, const std::vector<CTransactionRef>& txnConflicted) override;
+    void BlockDisconnected(const std::shared_ptr<const CBlock>& block) override;
+
+public:
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        LOCK(cs);
+        std::string strVersion = SERIALIZATION_VERSION_STRING;
+        READWRITE(strVersion);
+        if (ser_action.ForRead() && strVersion == SERIALIZATION_VERSION_STRING_V1) {
+            std::map<uint256, CollateralTx> mapTxs;
+            READWRITE(mapTxs);
+            mapCollaterals.clear();
+            for (const auto& entry : mapTxs) {
+                mapCollaterals.emplace(entry.first, Collateral{entry.second.hashBlock, entry.second.tx->vout});
+            }
+            return;
+        }
+        READWRITE(mapCollaterals);
+        if (ser_action.ForRead() && strVersion != SERIALIZATION_VERSION_STRING) {
+            mapCollaterals.clear();
+        }
+    }
+
+    /// Whether tx burns coins to an OP_RETURN of a hash, as governance collaterals do
+    static bool IsCollateral(const CTransaction& tx);
+
+    /// Find the outputs of a mined collateral transaction and the hash of its block
+    bool GetCollateral(const uint256& txid, std::vector<CTxOut>& voutRet, uint256& hashBlockRet) const;
+
+    /// Used by CFlatDB
+    void Clear();
+    void CheckAndRemove() {}
+    std::string ToString() const;
+};
+
+/// The global collateral index, used by the governance objects when there is no transaction index.
+extern CollateralIndex g_collateral_index;
+
+#endif // VELES_INDEX_COLLATERALINDEX_H
@@ -0,0 +1,157 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/payeeindex.h>
+
+#include <chain.h>
+#include <chainparams.h>
+#include <primitives/block.h>
+#include <tinyformat.h>
+#include <validation.h>
+
+#include <algorithm>
+
+PayeeIndex g_payee_index;
+
+const std::string PayeeIndex::SERIALIZATION_VERSION_STRING = "PayeeIndex-Version-1";
+
+void PayeeIndex::AddBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    auto it = mapBlocks.find(pindex->nHeight);
+    if (it != mapBlocks.end()) {
+        if (it->second.hash == pindex->GetBlockHash())
+            return;
+        RemoveBlock(it);
+    }
+
+    BlockPayees& entry = mapBlocks[pindex->nHeight];
+    entry.hash = pindex->GetBlockHash();
+
+    // Same rule as the masternode payment check, the output must carry the exact masternode reward
+    const CAmount nMasternodePayment = GetMasternodePayment(pindex->nHeight, block.vtx[0]->GetValueOut());
+    for (const CTxOut& txout : block.vtx[0]->vout) {
+        if (txout.nValue != nMasternodePayment)
+            continue;
+        if (std::find(entry.vPayees.begin(), entry.vPayees.end(), txout.scriptPubKey) != entry.vPayees.end())
+            continue;
+        entry.vPayees.push_back(txout.scriptPubKey);
+        mapPayments[txout.scriptPubKey].insert(pindex->nHeight);
+    }
+}
+
+void PayeeIndex::RemoveBlock(std::map<int, BlockPayees>::iterator it)
+{
+    for (const CScript& payee : it->second.vPayees) {
+        auto itPayee = mapPayments.find(payee);
+        if (itPayee == mapPayments.end())
+            continue;
+        itPayee->second.erase(it->first);
+        if (itPayee->second.empty())
+            mapPayments.erase(itPayee);
+    }
+    mapBlocks.erase(it);
+}
+
+void PayeeIndex::Prune(int nTipHeight)
+{
+    while (!mapBlocks.empty() && mapBlocks.begin()->first <= nTipHeight - nKeepBlocks)
+        RemoveBlock(mapBlocks.begin());
+}
+
+void PayeeIndex::BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex, const std::vector<CTransactionRef>& txnConflicted)
+{
+    LOCK(cs);
+    // Nothing has asked for payments yet, Sync() reads the missed blocks on first use
+    if (nKeepBlocks == 0)
+        return;
+
+    AddBlock(*block, pindex);
+    Prune(pindex->nHeight);
+}
+
+void PayeeIndex::BlockDisconnected(const std::shared_ptr<const CBlock>& block)
+{
+    LOCK(cs);
+    const uint256 hash = block->GetHash();
+    // Disconnected blocks are at the top of the index
+    for (auto it = mapBlocks.rbegin(); it != mapBlocks.rend(); ++it) {
+        if (it->second.hash == hash) {
+            RemoveBlock(std::next(it).base());
+            return;
+        }
+    }
+}
+
+void PayeeIndex::Sync(const CBlockIndex* pindex, int nDepth)
+{
+    AssertLockHeld(cs_main);
+    LOCK(cs);
+
+    nKeepBlocks = std::max(nKeepBlocks, nDepth);
+
+    // Only the coinbase outputs are looked at, the transactions of every block read go back to the arena
+    CMonotonicArena arena;
+    for (const CBlockIndex* pb = pindex; pb && pb->nHeight > 0 && pindex->nHeight - pb->nHeight < nDepth; pb = pb->pprev) {
+        auto it = mapBlocks.find(pb->nHeight);
+        if (it != mapBlocks.end() && it->second.hash == pb->GetBlockHash())
+            continue;
+        // Pruned while the node was down, the payments of the block are missed
+        if (!(pb->nStatus & BLOCK_HAVE_DATA))
+            continue;
+
+        arena.Clear();
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pb, Params().GetConsensus(), arena)) // shouldn't really happen
+            continue;
+        AddBlock(block, pb);
+    }
+
+    if (pindex)
+        Prune(pindex->nHeight);
+}
+
+std::vector<int> PayeeIndex::GetPayments(const CScript& payee, const CBlockIndex* pindex, int nMinHeight) const
+{
+    AssertLockHeld(cs_main);
+    LOCK(cs);
+
+    std::vector<int> vHeights;
+    auto itPayee = mapPayments.find(payee);
+    if (!pindex || itPayee == mapPayments.end())
+        return vHeights;
+
+    for (auto it = itPayee->second.rbegin(); it != itPayee->second.rend() && *it > nMinHeight; ++it) {
+        if (*it > pindex->nHeight)
+            continue;
+        // Skip blocks of another branch that was not disconnected yet
+        auto itBlock = mapBlocks.find(*it);
+        if (itBlock->second.hash != pindex->GetAncestor(*it)->GetBlockHash())
+            continue;
+        vHeights.push_back(*it);
+    }
+    return vHeights;
+}
+
+std::vector<CScript> PayeeIndex::GetBlockPayees(const CBlockIndex* pindex) const
+{
+    LOCK(cs);
+    auto it = mapBlocks.find(pindex->nHeight);
+    if (it == mapBlocks.end() || it->second.hash != pindex->GetBlockHash())
+        return std::vector<CScript>();
+    return it->second.vPayees;
+}
+
+void PayeeIndex::Clear()
+{
+    LOCK(cs);
+    mapBlocks.clear();
+    mapPayments.clear();
+    nKeepBlocks = 0;
+}
+
+std::string PayeeIndex::ToString() const
+{
+    LOCK(cs);
+    return strprintf("Blocks: %d, payees: %d, blocks kept: %d", mapBlocks.size(), mapPayments.size(), nKeepBlocks);
+}
@@ -0,0 +1,105 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef VELES_INDEX_PAYEEINDEX_H
+#define VELES_INDEX_PAYEEINDEX_H
+
+#include <script/script.h>
+#include <serialize.h>
+#include <sync.h>
+#include <uint256.h>
+#include <validationinterface.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+class CBlock;
+class CBlockIndex;
+
+/**
+ * PayeeIndex keeps the heights of the recent blocks whose coinbase paid the
+ * masternode reward to a script, so the last payment of a masternode can be
+ * found without reading the blocks from disk. The index follows the connected
+ * blocks and reads the blocks it missed once in Sync(). It is saved to
+ * payeeindex.dat at shutdown, so that pruned nodes keep the payments of the
+ * blocks they no longer have.
+ */
+class PayeeIndex final : public CValidationInterface
+{
+private:
+    static const std::string SERIALIZATION_VERSION_STRING;
+
+    struct BlockPayees {
+        uint256 hash;
+        std::vector<CScript> vPayees;
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action) {
+            READWRITE(hash);
+            READWRITE(vPayees);
+        }
+    };
+
+    mutable CCriticalSection cs;
+    //! Indexed blocks by height
+    std::map<int, BlockPayees> mapBlocks;
+    //! Heights of the indexed blocks paying each script
+    std::map<CScript, std::set<int> > mapPayments;
+    //! Number of blocks below the tip kept in the index
+    int nKeepBlocks = 0;
+
+    void AddBlock(const CBlock& block, const CBlockIndex* pindex);
+    void RemoveBlock(std::map<int, BlockPayees>::iterator it);
+    void Prune(int nTipHeight);
+
+protected:
+    void BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex, const std::vector<CTransactionRef>& txnConflicted) override;
+    void BlockDisconnected(const std::shared_ptr<const CBlock>& block) override;
+
+public:
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        LOCK(cs);
+        std::string strVersion = SERIALIZATION_VERSION_STRING;
+        READWRITE(strVersion);
+        READWRITE(mapBlocks);
+        READWRITE(nKeepBlocks);
+        if (ser_action.ForRead()) {
+            if (strVersion != SERIALIZATION_VERSION_STRING) {
+                mapBlocks.clear();
+                nKeepBlocks = 0;
+            }
+            mapPayments.clear();
+            for (const auto& entry : mapBlocks) {
+                for (const CScript& payee : entry.second.vPayees)
+                    mapPayments[payee].insert(entry.first);
+            }
+        }
+    }
+
+    /// Index the last nDepth blocks of the chain ending at pindex that aren't indexed yet. Requires cs_main.
+    void Sync(const CBlockIndex* pindex, int nDepth);
+
+    /// Heights above nMinHeight of the blocks of the chain ending at pindex paying payee, highest first. Requires cs_main.
+    std::vector<int> GetPayments(const CScript& payee, const CBlockIndex* pindex, int nMinHeight) const;
+
+    /// Scripts paid the masternode reward by the block pindex, empty when it isn't indexed.
+    std::vector<CScript> GetBlockPayees(const CBlockIndex* pindex) const;
+
+    /// Used by CFlatDB
+    void Clear();
+    void CheckAndRemove() {}
+    std::string ToString() const;
+};
+
+/// The global payee index, used by the masternode manager to track the last paid blocks.
+extern PayeeIndex g_payee_index;
+
+#endif // VELES_INDEX_PAYEEINDEX_H
@@ -0,0 +1,139 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/spentindex.h>
+
+#include <chainparams.h>
+#include <index/addressindex.h>
+#include <undo.h>
+#include <util/system.h>
+#include <validation.h>
+
+/* The index database stores one entry per spent output. Keys have the type [DB_SPENT, uint256 txid,
+ * uint32 index (BE)], the value is the spending txid, input index and height, plus the amount and
+ * address index hash of the spent output.
+ */
+constexpr char DB_SPENT = 's';
+
+std::unique_ptr<SpentIndex> g_spentindex;
+
+namespace {
+
+struct DBSpentKey {
+    uint256 txid;
+    uint32_t index;
+
+    DBSpentKey() : index(0) {}
+    explicit DBSpentKey(const COutPoint& outpoint) : txid(outpoint.hash), index(outpoint.n) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_SPENT);
+        s << txid;
+        ser_writedata32be(s, index);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char prefix = ser_readdata8(s);
+        if (prefix != DB_SPENT) {
+            throw std::ios_base::failure("Invalid format for spent index DB key");
+        }
+        s >> txid;
+        index = ser_readdata32be(s);
+    }
+};
+
+struct DBSpentVal {
+    uint256 txid;
+    uint32_t input_index;
+    int height;
+    CAmount amount;
+    uint160 address_hash;
+
+    DBSpentVal() : input_index(0), height(0), amount(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(txid);
+        READWRITE(input_index);
+        READWRITE(height);
+        READWRITE(amount);
+        READWRITE(address_hash);
+    }
+};
+
+} // namespace
+
+SpentIndex::SpentIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<BaseIndex::DB>(GetDataDir() / "indexes" / "spentindex", n_cache_size, f_memory, f_wipe))
+{}
+
+bool SpentIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    if (pindex->nHeight == 0) return true;
+
+    CBlockUndo block_undo;
+    if (!UndoReadFromDisk(block_undo, pindex)) {
+        return false;
+    }
+    if (block_undo.vtxundo.size() + 1 != block.vtx.size()) {
+        return error("%s: undo data of block %s does not match the block", __func__, pindex->GetBlockHash().ToString());
+    }
+
+    CDBBatch batch(*m_db);
+    for (size_t i = 1; i < block.vtx.size(); ++i) {
+        const CTransaction& tx = *block.vtx[i];
+        const CTxUndo& tx_undo = block_undo.vtxundo[i - 1];
+        if (tx_undo.vprevout.size() != tx.vin.size()) {
+            return error("%s: undo data of tx %s does not match the tx", __func__, tx.GetHash().ToString());
+        }
+        for (size_t j = 0; j < tx.vin.size(); ++j) {
+            const CTxOut& prevout = tx_undo.vprevout[j].out;
+            DBSpentVal value;
+            value.txid = tx.GetHash();
+            value.input_index = j;
+            value.height = pindex->nHeight;
+            value.amount = prevout.nValue;
+            value.address_hash = GetAddressIndexHash(prevout.scriptPubKey);
+            batch.Write(DBSpentKey(tx.vin[j].prevout), value);
+        }
+    }
+    return m_db->WriteBatch(batch);
+}
+
+bool SpentIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    CDBBatch batch(*m_db);
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+            return error("%s: Failed to read block %s from disk", __func__, pindex->GetBlockHash().ToString());
+        }
+        for (size_t i = 1; i < block.vtx.size(); ++i) {
+            for (const CTxIn& txin : block.vtx[i]->vin) {
+                batch.Erase(DBSpentKey(txin.prevout));
+            }
+        }
+    }
+    if (!m_db->WriteBatch(batch)) return false;
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+bool SpentIndex::FindSpent(const COutPoint& outpoint, SpentInfo& info_out) const
+{
+    DBSpentVal value;
+    if (!m_db->Read(DBSpentKey(outpoint), value)) {
+        return false;
+    }
+    info_out = {value.txid, value.input_index, value.height, value.amount, value.address_hash};
+    return true;
+}
@@ -0,0 +1,53 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef VELES_INDEX_SPENTINDEX_H
+#define VELES_INDEX_SPENTINDEX_H
+
+#include <amount.h>
+#include <chain.h>
+#include <index/base.h>
+#include <primitives/transaction.h>
+#include <uint256.h>
+
+/** The input spending an output in the active chain. */
+struct SpentInfo {
+    uint256 txid;
+    uint32_t input_index;
+    int height;
+    //! Amount and address index hash (see GetAddressIndexHash) of the spent output
+    CAmount amount;
+    uint160 address_hash;
+};
+
+/**
+ * SpentIndex records which transaction input spent each output in the active chain. The entries of
+ * blocks that get disconnected are removed again.
+ */
+class SpentIndex final : public BaseIndex
+{
+private:
+    std::unique_ptr<BaseIndex::DB> m_db;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    BaseIndex::DB& GetDB() const override { return *m_db; }
+
+    const char* GetName() const override { return "spentindex"; }
+
+public:
+    /** Constructs the index, which becomes available to be queried. */
+    explicit SpentIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    /** Look up the input spending outpoint, false if it is unspent or unknown. */
+    bool FindSpent(const COutPoint& outpoint, SpentInfo& info_out) const;
+};
+
+/// The global spent index. May be null.
+extern std::unique_ptr<SpentIndex> g_spentindex;
+
+#endif // VELES_INDEX_SPENTINDEX_H
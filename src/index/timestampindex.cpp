@@ -0,0 +1,83 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/timestampindex.h>
+
+#include <util/system.h>
+
+/* The index database stores one entry per block of the active chain. Keys have the type
+ * [DB_TIMESTAMP, uint32 timestamp (BE), uint256 block hash] so that the blocks are ordered by
+ * timestamp, the value is the block height.
+ */
+constexpr char DB_TIMESTAMP = 't';
+
+std::unique_ptr<TimestampIndex> g_timestampindex;
+
+namespace {
+
+struct DBTimestampKey {
+    unsigned int timestamp;
+    uint256 hash;
+
+    DBTimestampKey() : timestamp(0) {}
+    DBTimestampKey(unsigned int timestamp_in, const uint256& hash_in) : timestamp(timestamp_in), hash(hash_in) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_TIMESTAMP);
+        ser_writedata32be(s, timestamp);
+        s << hash;
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char prefix = ser_readdata8(s);
+        if (prefix != DB_TIMESTAMP) {
+            throw std::ios_base::failure("Invalid format for timestamp index DB key");
+        }
+        timestamp = ser_readdata32be(s);
+        s >> hash;
+    }
+};
+
+} // namespace
+
+TimestampIndex::TimestampIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<BaseIndex::DB>(GetDataDir() / "indexes" / "timestampindex", n_cache_size, f_memory, f_wipe))
+{}
+
+bool TimestampIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    return m_db->Write(DBTimestampKey(pindex->nTime, pindex->GetBlockHash()), pindex->nHeight);
+}
+
+bool TimestampIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    CDBBatch batch(*m_db);
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        batch.Erase(DBTimestampKey(pindex->nTime, pindex->GetBlockHash()));
+    }
+    if (!m_db->WriteBatch(batch)) return false;
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+bool TimestampIndex::FindBlockHashes(unsigned int low, unsigned int high, std::vector<uint256>& hashes_out) const
+{
+    std::unique_ptr<CDBIterator> db_it(m_db->NewIterator());
+    db_it->Seek(DBTimestampKey(low, uint256()));
+
+    DBTimestampKey key;
+    for (; db_it->Valid(); db_it->Next()) {
+        if (!db_it->GetKey(key) || key.timestamp > high) {
+            break;
+        }
+        hashes_out.push_back(key.hash);
+    }
+    return true;
+}
@@ -0,0 +1,44 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef VELES_INDEX_TIMESTAMPINDEX_H
+#define VELES_INDEX_TIMESTAMPINDEX_H
+
+#include <chain.h>
+#include <index/base.h>
+#include <uint256.h>
+
+#include <vector>
+
+/**
+ * TimestampIndex lists the blocks of the active chain by their header timestamp, so the blocks of a
+ * time range are found with one range scan. Block times are not monotonic, the index does not
+ * rely on them being so.
+ */
+class TimestampIndex final : public BaseIndex
+{
+private:
+    std::unique_ptr<BaseIndex::DB> m_db;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    BaseIndex::DB& GetDB() const override { return *m_db; }
+
+    const char* GetName() const override { return "timestampindex"; }
+
+public:
+    /** Constructs the index, which becomes available to be queried. */
+    explicit TimestampIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    /** Get the hashes of the blocks with a timestamp between low and high, inclusive, in timestamp order. */
+    bool FindBlockHashes(unsigned int low, unsigned int high, std::vector<uint256>& hashes_out) const;
+};
+
+/// The global timestamp index. May be null.
+extern std::unique_ptr<TimestampIndex> g_timestampindex;
+
+#endif // VELES_INDEX_TIMESTAMPINDEX_H
@@ -258,6 +258,25 @@ bool TxIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
     return m_db->WriteTxs(vPos);
 }
 
+// VELES BEGIN
+bool TxIndex::WriteBlocks(const std::vector<CBlock>& blocks, const std::vector<const CBlockIndex*>& pindexes)
+{
+    // The positions of all the blocks go to the database in a single batch
+    std::vector<std::pair<uint256, CDiskTxPos>> vPos;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        // Exclude genesis block transaction because outputs are not spendable.
+        if (pindexes[i]->nHeight == 0) continue;
+
+        CDiskTxPos pos(pindexes[i]->GetBlockPos(), GetSizeOfCompactSize(blocks[i].vtx.size()));
+        for (const auto& tx : blocks[i].vtx) {
+            vPos.emplace_back(tx->GetHash(), pos);
+            pos.nTxOffset += ::GetSerializeSize(*tx, CLIENT_VERSION);
+        }
+    }
+    return m_db->WriteTxs(vPos);
+}
+// VELES END
+
 BaseIndex::DB& TxIndex::GetDB() const { return *m_db; }
 
 bool TxIndex::FindTx(const uint256& tx_hash, uint256& block_hash, CTransactionRef& tx) const
@@ -13,21 +13,38 @@
 #include <init.h>
 
 #include <addrman.h>
+#include <algostats.h>
 #include <amount.h>
 #include <banman.h>
+#include <blockimport.h> // VELES
+#include <blockreadcache.h> // VELES
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
+#include <coinsprefetch.h> // VELES
 #include <compat/sanity.h>
 #include <consensus/validation.h>
+#include <crypto/scrypt.h>
+#include <crypto/sph_hw.h> // VELES
 #include <fs.h>
 #include <httpserver.h>
 #include <httprpc.h>
 #include <interfaces/chain.h>
+#include <index/blockfilterindex.h> // VELES
+// VELES BEGIN
+#include <index/addressindex.h>
+#include <index/coinstatsindex.h>
+#include <index/collateralindex.h>
+#include <index/spentindex.h>
+#include <index/timestampindex.h>
+// VELES END
+#include <index/payeeindex.h>
 #include <index/txindex.h>
 #include <key.h>
 #include <key_io.h>
 #include <validation.h>
+#include <mempooljournal.h> // VELES
+#include <metrics.h> // VELES
 #include <miner.h>
 #include <netbase.h>
 #include <net.h>
@@ -38,11 +55,13 @@
 #include <rpc/server.h>
 #include <rpc/register.h>
 #include <rpc/blockchain.h>
+#include <rpc/mining.h> // VELES
 #include <rpc/util.h>
 #include <script/standard.h>
 #include <script/sigcache.h>
 #include <scheduler.h>
 #include <shutdown.h>
+#include <startuptimings.h> // VELES
 #include <timedata.h>
 #include <txdb.h>
 #include <txmempool.h>
@@ -73,6 +92,7 @@
 #include <netfulfilledman.h>
 #ifdef ENABLE_WALLET
 #include <privatesend-client.h>
+#include <wallet/wallet.h> // VELES
 #endif // ENABLE_WALLET
 #include <privatesend-server.h>
 #include <spork.h>
@@ -88,10 +108,14 @@
 #ifndef WIN32
 #include <attributes.h>
 #include <cerrno>
+#include <set> // VELES
 #include <signal.h>
 #include <sys/stat.h>
 #endif
 
+#include <future> // VELES
+#include <thread> // VELES
+
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/split.hpp>
@@ -101,6 +125,7 @@
 #if ENABLE_ZMQ
 #include <zmq/zmqabstractnotifier.h>
 #include <zmq/zmqnotificationinterface.h>
+#include <zmq/zmqpublishnotifier.h>
 #include <zmq/zmqrpc.h>
 #endif
 
@@ -115,11 +140,19 @@ const static std::string DEFAULT_MINING_ALGO = "scrypt";
 
 // Dump addresses to banlist.dat every 15 minutes (900s)
 static constexpr int DUMP_BANS_INTERVAL = 60 * 15;
+// VELES BEGIN
+// Dump the masternode, governance and index caches every 15 minutes
+static constexpr int DUMP_DASH_CACHES_INTERVAL = 60 * 15;
+// VELES END
 
 std::unique_ptr<CConnman> g_connman;
 std::unique_ptr<PeerLogicValidation> peerLogic;
 std::unique_ptr<BanMan> g_banman;
 
+// VELES BEGIN
+static std::set<BlockFilterType> g_enabled_filter_types;
+// VELES END
+
 // Dash
 static CDSNotificationInterface* pdsNotificationInterface = NULL;
 //
@@ -226,11 +259,85 @@ void Interrupt()
     InterruptMapPort();
     if (g_connman)
         g_connman->Interrupt();
+    InterruptDashMessageQueues(); // VELES
     if (g_txindex) {
         g_txindex->Interrupt();
     }
+    ForEachBlockFilterIndex([](BlockFilterIndex& index) { index.Interrupt(); }); // VELES
+    // VELES BEGIN
+    if (g_addressindex) g_addressindex->Interrupt();
+    if (g_spentindex) g_spentindex->Interrupt();
+    if (g_timestampindex) g_timestampindex->Interrupt();
+    if (g_coinstatsindex) g_coinstatsindex->Interrupt();
+    // VELES END
+}
+
+// VELES BEGIN
+/**
+ * The files of the Dash caches. They live from one dump to the next, so a
+ * cache unchanged since the last dump is not written again.
+ */
+struct DashCacheFiles
+{
+    CFlatDB<CMasternodeMan> masternodes{"mncache.dat", "magicMasternodeCache"};
+    CFlatDB<CMasternodePayments> payments{"mnpayments.dat", "magicMasternodePaymentsCache"};
+    CFlatDB<CGovernanceManager> governance{"governance.dat", "magicGovernanceCache"};
+    CFlatDB<CNetFulfilledRequestManager> fulfilled{"netfulfilled.dat", "magicFulfilledCache"};
+    CFlatDB<PayeeIndex> payees{"payeeindex.dat", "magicPayeeIndex"};
+    CFlatDB<CollateralIndex> collaterals{"collateralindex.dat", "magicCollateralIndex"};
+};
+
+static DashCacheFiles& GetDashCacheFiles()
+{
+    static DashCacheFiles files;
+    return files;
+}
+
+/** The dumps of the Dash caches, independent of each other */
+static std::vector<std::function<void()>> GetDashCacheDumps()
+{
+    DashCacheFiles& files = GetDashCacheFiles();
+    std::vector<std::function<void()>> dumps;
+    // The masternode caches still loading in the background are left as they are on disk
+    if (masternodeSync.IsCachesLoaded()) {
+        dumps.emplace_back([&files]{ files.masternodes.Dump(mnodeman); });
+        dumps.emplace_back([&files]{ files.payments.Dump(mnpayments); });
+        dumps.emplace_back([&files]{ files.governance.Dump(governance); });
+    }
+    dumps.emplace_back([&files]{ files.fulfilled.Dump(netfulfilledman); });
+    dumps.emplace_back([&files]{ files.payees.Dump(g_payee_index); });
+    dumps.emplace_back([&files]{ files.collaterals.Dump(g_collateral_index); });
+    return dumps;
 }
 
+/**
+ * Total database cache in bytes for -dbcache=auto, once synced or during the
+ * initial block download. The Dash caches are still loading at that point,
+ * their memory is estimated from the size of their files.
+ */
+static int64_t GetAutoDbCache(bool fInitialDownload)
+{
+    const int64_t nSystemMemory = GetTotalSystemMemory();
+    if (nSystemMemory <= 0)
+        return nDefaultDbCache << 20;
+
+    int64_t nDashMemory = 0;
+    for (const char* pszFile : {"mncache.dat", "mnpayments.dat", "governance.dat", "netfulfilled.dat", "payeeindex.dat", "collateralindex.dat"}) {
+        boost::system::error_code ec;
+        const uintmax_t nSize = fs::file_size(GetDataDir() / pszFile, ec);
+        if (!ec)
+            nDashMemory += 2 * nSize;
+    }
+    // the seen pings and the orphan or invalid votes kept up to -maxdashcache each
+    nDashMemory += 4 * (std::max((int64_t)0, gArgs.GetArg("-maxdashcache", DEFAULT_MAX_DASH_CACHE)) << 20);
+    const int64_t nMempoolMemory = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
+
+    int64_t nCache = std::max<int64_t>(nSystemMemory - nMempoolMemory - nDashMemory, 0) / 100 *
+                     (fInitialDownload ? nAutoDbCacheIBDPercent : nAutoDbCacheSteadyPercent);
+    return std::max(nMinDbCache << 20, std::min(nCache, nMaxDbCache << 20));
+}
+// VELES END
+
 void Shutdown(InitInterfaces& interfaces)
 {
     LogPrintf("%s: In progress...\n", __func__);
@@ -248,6 +355,7 @@ void Shutdown(InitInterfaces& interfaces)
 
     StopHTTPRPC();
     StopREST();
+    StopMetricsServer(); // VELES
     StopRPC();
     StopHTTPServer();
     for (const auto& client : interfaces.chain_clients) {
@@ -258,8 +366,16 @@ void Shutdown(InitInterfaces& interfaces)
     // Because these depend on each-other, we make sure that neither can be
     // using the other before destroying them.
     if (peerLogic) UnregisterValidationInterface(peerLogic.get());
+    StopDashMessageQueues(); // VELES
     if (g_connman) g_connman->Stop();
     if (g_txindex) g_txindex->Stop();
+    ForEachBlockFilterIndex([](BlockFilterIndex& index) { index.Stop(); }); // VELES
+    // VELES BEGIN
+    if (g_addressindex) g_addressindex->Stop();
+    if (g_spentindex) g_spentindex->Stop();
+    if (g_timestampindex) g_timestampindex->Stop();
+    if (g_coinstatsindex) g_coinstatsindex->Stop();
+    // VELES END
 
     StopTorControl();
 
@@ -267,6 +383,11 @@ void Shutdown(InitInterfaces& interfaces)
     // CScheduler/checkqueue threadGroup
     threadGroup.interrupt_all();
     threadGroup.join_all();
+    // VELES BEGIN
+    g_coins_prefetcher.Stop();
+    g_template_precomputer.Stop();
+    g_block_read_cache.Clear();
+    // VELES END
 
     // After the threads that potentially access these pointers have been stopped,
     // destruct and reset all to nullptr.
@@ -274,25 +395,65 @@ void Shutdown(InitInterfaces& interfaces)
     g_connman.reset();
     g_banman.reset();
     g_txindex.reset();
+    DestroyAllBlockFilterIndexes(); // VELES
+    // VELES BEGIN
+    g_addressindex.reset();
+    g_spentindex.reset();
+    g_timestampindex.reset();
+    g_coinstatsindex.reset();
+    // VELES END
 
+    // VELES BEGIN
+    // The files below don't depend on each other nor on the chainstate, they
+    // are written on their own threads while the chainstate is flushed
+    std::vector<std::function<void()>> dumps;
+    // VELES END
     if (g_is_mempool_loaded && gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
-        DumpMempool();
+        // VELES BEGIN
+        //DumpMempool();
+        // The journal holds the mempool already, dump it only when the journal could not be kept
+        dumps.emplace_back([]{
+            if (!g_mempool_journal.Close()) {
+                DumpMempool();
+            }
+        });
+        // VELES END
+    }
+    // VELES BEGIN
+    if (gArgs.GetBoolArg("-persistvalidationcaches", DEFAULT_PERSIST_VALIDATION_CACHES)) {
+        dumps.emplace_back(&DumpValidationCaches);
     }
+    if (g_lock_stats) {
+        dumps.emplace_back([]{ DumpLockStats((GetDataDir() / LOCK_STATS_FILENAME).string()); });
+    }
+    // VELES END
 
     // Dash
     // STORE DATA CACHES INTO SERIALIZED DAT FILES
-    CFlatDB<CMasternodeMan> flatdb1("mncache.dat", "magicMasternodeCache");
-    flatdb1.Dump(mnodeman);
-    CFlatDB<CMasternodePayments> flatdb2("mnpayments.dat", "magicMasternodePaymentsCache");
-    flatdb2.Dump(mnpayments);
-    CFlatDB<CGovernanceManager> flatdb3("governance.dat", "magicGovernanceCache");
-    flatdb3.Dump(governance);
-    CFlatDB<CNetFulfilledRequestManager> flatdb4("netfulfilled.dat", "magicFulfilledCache");
-    flatdb4.Dump(netfulfilledman);
+    //CFlatDB<CMasternodeMan> flatdb1("mncache.dat", "magicMasternodeCache");
+    //flatdb1.Dump(mnodeman);
+    //CFlatDB<CMasternodePayments> flatdb2("mnpayments.dat", "magicMasternodePaymentsCache");
+    //flatdb2.Dump(mnpayments);
+    //CFlatDB<CGovernanceManager> flatdb3("governance.dat", "magicGovernanceCache");
+    //flatdb3.Dump(governance);
+    //CFlatDB<CNetFulfilledRequestManager> flatdb4("netfulfilled.dat", "magicFulfilledCache");
+    //flatdb4.Dump(netfulfilledman);
     //
+    // VELES BEGIN
+    //CFlatDB<PayeeIndex> flatdbPayees("payeeindex.dat", "magicPayeeIndex");
+    //flatdbPayees.Dump(g_payee_index);
+    //CFlatDB<CollateralIndex> flatdbCollaterals("collateralindex.dat", "magicCollateralIndex");
+    //flatdbCollaterals.Dump(g_collateral_index);
+    for (std::function<void()>& dump : GetDashCacheDumps()) {
+        dumps.push_back(std::move(dump));
+    }
+    // VELES END
 
     if (fFeeEstimatesInitialized)
     {
+        // VELES BEGIN
+        dumps.emplace_back([]{
+        // VELES END
         ::feeEstimator.FlushUnconfirmed();
         fs::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
         CAutoFile est_fileout(fsbridge::fopen(est_path, "wb"), SER_DISK, CLIENT_VERSION);
@@ -300,14 +461,28 @@ void Shutdown(InitInterfaces& interfaces)
             ::feeEstimator.Write(est_fileout);
         else
             LogPrintf("%s: Failed to write fee estimates to %s\n", __func__, est_path.string());
+        }); // VELES
         fFeeEstimatesInitialized = false;
     }
 
+    // VELES BEGIN
+    std::vector<std::thread> dump_threads;
+    for (std::function<void()>& dump : dumps) {
+        dump_threads.emplace_back(&TraceThread<std::function<void()>>, "shutoff-dump", std::move(dump));
+    }
+    // VELES END
+
     // FlushStateToDisk generates a ChainStateFlushed callback, which we should avoid missing
     if (pcoinsTip != nullptr) {
         FlushStateToDisk();
     }
 
+    // VELES BEGIN
+    for (std::thread& thread : dump_threads) {
+        thread.join();
+    }
+    // VELES END
+
     // After there are no more peers/RPC left to give us new data which may generate
     // CValidationInterface callbacks, flush them...
     GetMainSignals().FlushBackgroundCallbacks();
@@ -328,6 +503,7 @@ void Shutdown(InitInterfaces& interfaces)
         pcoinsdbview.reset();
         pblocktree.reset();
         // FXTC START
+        sporkManager.FlushSporksToDB(); // VELES
         pSporkDB.reset();
         // FXTC END
     }
@@ -351,6 +527,14 @@ void Shutdown(InitInterfaces& interfaces)
     }
     //
 
+    // VELES BEGIN
+    UnregisterValidationInterface(&algoStats);
+    UnregisterValidationInterface(&g_payee_index);
+    UnregisterValidationInterface(&g_collateral_index);
+    UnregisterValidationInterface(&g_metrics);
+    UnregisterValidationInterface(&g_template_precomputer);
+    // VELES END
+
     try {
         if (!fs::remove(GetPidFile())) {
             LogPrintf("%s: Unable to remove PID file: File does not exist\n", __func__);
@@ -362,9 +546,11 @@ void Shutdown(InitInterfaces& interfaces)
     UnregisterAllValidationInterfaces();
     GetMainSignals().UnregisterBackgroundSignalScheduler();
     GetMainSignals().UnregisterWithMempoolSignals(mempool);
+    g_block_selection.UnregisterWithMempoolSignals(mempool); // VELES
     globalVerifyHandle.reset();
     ECC_Stop();
     LogPrintf("%s: done\n", __func__);
+    LogInstance().StopAsync(); // VELES
 }
 
 /**
@@ -441,25 +627,61 @@ void SetupServerArgs()
     gArgs.AddArg("-version", "Print version and exit", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-alertnotify=<cmd>", "Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-assumevalid=<hex>", strprintf("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script verification (0 to verify all, default: %s, testnet: %s)", defaultChainParams->GetConsensus().defaultAssumeValid.GetHex(), testnetChainParams->GetConsensus().defaultAssumeValid.GetHex()), false, OptionsCategory::OPTIONS);
+    // VELES BEGIN
+    gArgs.AddArg("-asyncflush", strprintf("Write the coins cache to the coin database on a background thread while validation continues. A cache being written stays in memory next to the new one, which can briefly double the memory used for it (default: %u)", DEFAULT_ASYNC_FLUSH), false, OptionsCategory::OPTIONS);
+    // VELES END
     gArgs.AddArg("-blocksdir=<dir>", "Specify blocks directory (default: <datadir>/blocks)", false, OptionsCategory::OPTIONS);
+    // VELES BEGIN
+    gArgs.AddArg("-blockmmap", strprintf("Read blocks from memory mapped block files (default: %u)", DEFAULT_BLOCK_MMAP), false, OptionsCategory::OPTIONS);
+    // VELES END
     gArgs.AddArg("-blocknotify=<cmd>", "Execute command when the best block changes (%s in cmd is replaced by block hash)", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blockreconstructionextratxn=<n>", strprintf("Extra transactions to keep in memory for compact block reconstructions (default: %u)", DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN), false, OptionsCategory::OPTIONS);
+    // VELES BEGIN
+    gArgs.AddArg("-blockreadcache=<n>", strprintf("Keep the blocks most recently read from disk in <n> MiB of memory (0 to %d, default: %d)",
+        MAX_BLOCK_READ_CACHE, DEFAULT_BLOCK_READ_CACHE), false, OptionsCategory::OPTIONS);
+    // VELES END
     gArgs.AddArg("-blocksonly", strprintf("Whether to reject transactions from network peers. Transactions from the wallet or RPC are not affected. (default: %u)", DEFAULT_BLOCKSONLY), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-conf=<file>", strprintf("Specify configuration file. Relative paths will be prefixed by datadir location. (default: %s)", BITCOIN_CONF_FILENAME), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-datadir=<dir>", "Specify data directory", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize), true, OptionsCategory::OPTIONS);
-    gArgs.AddArg("-dbcache=<n>", strprintf("Maximum database cache size <n> MiB (%d to %d, default: %d). In addition, unused mempool memory is shared for this cache (see -maxmempool).", nMinDbCache, nMaxDbCache, nDefaultDbCache), false, OptionsCategory::OPTIONS);
+    //gArgs.AddArg("-dbcache=<n>", strprintf("Maximum database cache size <n> MiB (%d to %d, default: %d). In addition, unused mempool memory is shared for this cache (see -maxmempool).", nMinDbCache, nMaxDbCache, nDefaultDbCache), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-dbcache=<n>", strprintf("Maximum database cache size <n> MiB (%d to %d, default: %d). In addition, unused mempool memory is shared for this cache (see -maxmempool). \"auto\" sizes it from the system memory left by the mempool and the masternode data, with a larger coins cache during the initial block download", nMinDbCache, nMaxDbCache, nDefaultDbCache), false, OptionsCategory::OPTIONS); // VELES
+    // VELES BEGIN
+    gArgs.AddArg("-dboption=<db>.<option>=<n>", "Override a LevelDB setting of the database in the <db> directory: block_size (bytes), compression (0 or 1, needs LevelDB built with Snappy), bloom_bits (0 disables the filter) or max_open_files. Can be specified multiple times. See the getdbstats rpc call for the databases and their settings.", true, OptionsCategory::OPTIONS);
+    // VELES END
     gArgs.AddArg("-debuglogfile=<file>", strprintf("Specify location of debug log file. Relative paths will be prefixed by a net-specific datadir location. (-nodebuglogfile to disable; default: %s)", DEFAULT_DEBUGLOGFILE), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER), true, OptionsCategory::OPTIONS);
     gArgs.AddArg("-includeconf=<file>", "Specify additional configuration file, relative to the -datadir path (only useable from configuration file, not command line)", false, OptionsCategory::OPTIONS);
+    // VELES BEGIN
+    gArgs.AddArg("-importthreads=<n>", strprintf("Set the number of threads parsing and hashing blocks for -reindex and -loadblock, and the block index on startup (1 to %d, default: %d)",
+        MAX_IMPORT_THREADS, DEFAULT_IMPORT_THREADS), false, OptionsCategory::OPTIONS);
+    // VELES END
     gArgs.AddArg("-loadblock=<file>", "Imports blocks from external blk000??.dat file on startup", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-maxdashcache=<n>", strprintf("Keep each of the seen masternode pings, the invalid and orphan governance votes and the orphan InstantSend votes below <n> MiB, evicting the oldest first (0 for no limit, default: %u)", DEFAULT_MAX_DASH_CACHE), false, OptionsCategory::OPTIONS); // VELES
     gArgs.AddArg("-maxmempool=<n>", strprintf("Keep the transaction memory pool below <n> megabytes (default: %u)", DEFAULT_MAX_MEMPOOL_SIZE), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxorphantx=<n>", strprintf("Keep at most <n> unconnectable transactions in memory (default: %u)", DEFAULT_MAX_ORPHAN_TRANSACTIONS), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-maxvalidationqueue=<n>", strprintf("Wait for the validation interface notifications once more than <n> are pending while connecting blocks (2 to 1000000, default: %u)", DEFAULT_MAX_VALIDATION_QUEUE), true, OptionsCategory::OPTIONS); // VELES
     gArgs.AddArg("-mempoolexpiry=<n>", strprintf("Do not keep transactions in the mempool longer than <n> hours (default: %u)", DEFAULT_MEMPOOL_EXPIRY), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-minimumchainwork=<hex>", strprintf("Minimum work assumed to exist on a valid chain in hex (default: %s, testnet: %s)", defaultChainParams->GetConsensus().nMinimumChainWork.GetHex(), testnetChainParams->GetConsensus().nMinimumChainWork.GetHex()), true, OptionsCategory::OPTIONS);
     gArgs.AddArg("-par=<n>", strprintf("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)",
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS), false, OptionsCategory::OPTIONS);
+    // VELES BEGIN
+    gArgs.AddArg("-parpin=<policy>", strprintf("Pin the script verification threads to cores: none, or cores for one thread per core from the second core on (default: %s)",
+        DEFAULT_SCRIPTCHECK_PINNING), false, OptionsCategory::OPTIONS);
+    // VELES END
+    // VELES BEGIN
+    gArgs.AddArg("-schedulerthreads=<n>", strprintf("Set the number of threads running the notifications and the maintenance tasks, maintenance is kept off one of them (1 to %d, default: %d)",
+        MAX_SCHEDULER_THREADS, DEFAULT_SCHEDULER_THREADS), false, OptionsCategory::OPTIONS);
+    // VELES END
     gArgs.AddArg("-persistmempool", strprintf("Whether to save the mempool on shutdown and load on restart (default: %u)", DEFAULT_PERSIST_MEMPOOL), false, OptionsCategory::OPTIONS);
+    // VELES BEGIN
+    gArgs.AddArg("-persistvalidationcaches", strprintf("Whether to save the signature cache and the script execution cache on shutdown and load them on restart, "
+        "the scripts of the cached transactions are not verified again (default: %u)", DEFAULT_PERSIST_VALIDATION_CACHES), false, OptionsCategory::OPTIONS);
+    // VELES END
+    // VELES BEGIN
+    gArgs.AddArg("-prefetchthreads=<n>", strprintf("Set the number of threads reading the coins spent by a block before it is validated (0 to %d, default: %d)",
+        MAX_COINS_PREFETCH_THREADS, DEFAULT_COINS_PREFETCH_THREADS), false, OptionsCategory::OPTIONS);
+    // VELES END
     gArgs.AddArg("-pid=<file>", strprintf("Specify pid file. Relative paths will be prefixed by a net-specific datadir location. (default: %s)", BITCOIN_PID_FILENAME), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-prune=<n>", strprintf("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks, and enables automatic pruning of old blocks if a target size in MiB is provided. This mode is incompatible with -txindex and -rescan. "
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
@@ -472,6 +694,16 @@ void SetupServerArgs()
     hidden_args.emplace_back("-sysperms");
 #endif
     gArgs.AddArg("-txindex", strprintf("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)", DEFAULT_TXINDEX), false, OptionsCategory::OPTIONS);
+    // VELES BEGIN
+    gArgs.AddArg("-blockfilterindex=<type>",
+                 strprintf("Maintain an index of compact filters by block (default: %s, values: %s).", DEFAULT_BLOCKFILTERINDEX, ListBlockFilterTypes()) +
+                 " If <type> is not supplied or if <type> = 1, indexes for all known types are enabled. The index speeds up wallet rescans.",
+                 false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-addressindex", strprintf("Maintain an index of the transaction outputs and inputs of every address, used by the getaddress* rpc calls (default: %u)", DEFAULT_ADDRESSINDEX), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-spentindex", strprintf("Maintain an index of the inputs spending every output, used by the getspentinfo rpc call (default: %u)", DEFAULT_SPENTINDEX), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-timestampindex", strprintf("Maintain an index of blocks by timestamp, used by the getblockhashes rpc call (default: %u)", DEFAULT_TIMESTAMPINDEX), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-coinstatsindex", strprintf("Maintain the UTXO set statistics after every block, used by the gettxoutsetinfo rpc call (default: %u)", DEFAULT_COINSTATSINDEX), false, OptionsCategory::OPTIONS);
+    // VELES END
 
     gArgs.AddArg("-addnode=<ip>", "Add a node to connect to and attempt to keep the connection open (see the `addnode` RPC command help for more info). This option can be specified multiple times to add multiple nodes.", false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-banscore=<n>", strprintf("Threshold for disconnecting misbehaving peers (default: %u)", DEFAULT_BANSCORE_THRESHOLD), false, OptionsCategory::CONNECTION);
@@ -482,17 +714,20 @@ void SetupServerArgs()
     gArgs.AddArg("-dns", strprintf("Allow DNS lookups for -addnode, -seednode and -connect (default: %u)", DEFAULT_NAME_LOOKUP), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-dnsseed", "Query for peer addresses via DNS lookup, if low on addresses (default: 1 unless -connect used)", false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-enablebip61", strprintf("Send reject messages per BIP61 (default: %u)", DEFAULT_ENABLE_BIP61), false, OptionsCategory::CONNECTION);
+    gArgs.AddArg("-dashmsgqueues", strprintf("Handle the masternode, governance, InstantSend and PrivateSend messages on a thread per subsystem instead of the message handler thread (default: %u)", DEFAULT_DASH_MESSAGE_QUEUES), false, OptionsCategory::CONNECTION); // VELES
     gArgs.AddArg("-externalip=<ip>", "Specify your own public address", false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-forcednsseed", strprintf("Always query for peer addresses via DNS lookup (default: %u)", DEFAULT_FORCEDNSSEED), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-listen", "Accept connections from outside (default: 1 if no -proxy or -connect)", false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-listenonion", strprintf("Automatically create Tor hidden service (default: %d)", DEFAULT_LISTEN_ONION), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-maxconnections=<n>", strprintf("Maintain at most <n> connections to peers (default: %u)", DEFAULT_MAX_PEER_CONNECTIONS), false, OptionsCategory::CONNECTION);
+    gArgs.AddArg("-socketevents=<mode>", strprintf("Socket events mode, which must be one of: %s (default: %s)", GetSupportedSocketEventsStr(), DEFAULT_SOCKETEVENTS), false, OptionsCategory::CONNECTION); // VELES
     gArgs.AddArg("-maxreceivebuffer=<n>", strprintf("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)", DEFAULT_MAXRECEIVEBUFFER), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-maxsendbuffer=<n>", strprintf("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)", DEFAULT_MAXSENDBUFFER), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-maxtimeadjustment", strprintf("Maximum allowed median peer time offset adjustment. Local perspective of time may be influenced by peers forward or backward by this amount. (default: %u seconds)", DEFAULT_MAX_TIME_ADJUSTMENT), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-maxuploadtarget=<n>", strprintf("Tries to keep outbound traffic under the given target (in MiB per 24h), 0 = no limit (default: %d)", DEFAULT_MAX_UPLOAD_TARGET), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-onion=<ip:port>", "Use separate SOCKS5 proxy to reach peers via Tor hidden services, set -noonion to disable (default: -proxy)", false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-onlynet=<net>", "Make outgoing connections only through network <net> (ipv4, ipv6 or onion). Incoming connections are not affected by this option. This option can be specified multiple times to allow multiple networks.", false, OptionsCategory::CONNECTION);
+    gArgs.AddArg("-peerblockfilters", strprintf("Serve compact block filters to peers per BIP 157 (default: %u)", DEFAULT_PEERBLOCKFILTERS), false, OptionsCategory::CONNECTION); // VELES
     gArgs.AddArg("-peerbloomfilters", strprintf("Support filtering of blocks and transaction with bloom filters (default: %u)", DEFAULT_PEERBLOOMFILTERS), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-permitbaremultisig", strprintf("Relay non-P2SH multisig (default: %u)", DEFAULT_PERMIT_BAREMULTISIG), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-port=<port>", strprintf("Listen for connections on <port> (default: %u, testnet: %u, regtest: %u)", defaultChainParams->GetDefaultPort(), testnetChainParams->GetDefaultPort(), regtestChainParams->GetDefaultPort()), false, OptionsCategory::CONNECTION);
@@ -527,6 +762,28 @@ void SetupServerArgs()
     gArgs.AddArg("-zmqpubhashtxhwm=<n>", strprintf("Set publish hash transaction outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawblockhwm=<n>", strprintf("Set publish raw block outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawtxhwm=<n>", strprintf("Set publish raw transaction outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
+    // VELES BEGIN
+    gArgs.AddArg("-zmqpubwork=<address>", "Enable publish mining work for every algo in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubworkhwm=<n>", strprintf("Set publish mining work outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubworkaddress=<address>", "Address the coinbase of the published mining work pays to, required by -zmqpubwork", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubworkfeedelta=<amt>", strprintf("Publish new mining work when the fees of the best template grew by at least <amt> %s (default: %s)", CURRENCY_UNIT, FormatMoney(DEFAULT_ZMQ_WORK_FEE_DELTA)), false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubhashtxlock=<address>", "Enable publish hash of transactions locked by InstantSend in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubrawtxlock=<address>", "Enable publish raw transactions locked by InstantSend in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubhashgovernanceobject=<address>", "Enable publish hash of new governance objects in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubhashgovernancevote=<address>", "Enable publish hash of new governance votes in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubmasternodelistchange=<address>", "Enable publish masternodes added to or removed from the list in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubhashtxlockhwm=<n>", strprintf("Set publish hash transaction lock outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubrawtxlockhwm=<n>", strprintf("Set publish raw transaction lock outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubhashgovernanceobjecthwm=<n>", strprintf("Set publish hash governance object outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubhashgovernancevotehwm=<n>", strprintf("Set publish hash governance vote outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubmasternodelistchangehwm=<n>", strprintf("Set publish masternode list change outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubhashtxbatch=<address>", "Enable publish the hashes of the transactions in batches in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubhashtxbatchhwm=<n>", strprintf("Set publish hash transaction batch outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubhashtxbatchinterval=<n>", strprintf("Milliseconds the transaction hashes of a batch are collected for (default: %d)", DEFAULT_ZMQ_HASHTX_BATCH_INTERVAL), false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubblockdelta=<address>", "Enable publish the outputs spent and created by each connected or disconnected block in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubblockdeltahwm=<n>", strprintf("Set publish block delta outbound message high water mark (default: %d)", CZMQAbstractNotifier::DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqqueuesize=<n>", strprintf("Number of messages waiting to be published before new ones are dropped (default: %u)", DEFAULT_ZMQ_QUEUE_SIZE), false, OptionsCategory::ZMQ);
+    // VELES END
 #else
     hidden_args.emplace_back("-zmqpubhashblock=<address>");
     hidden_args.emplace_back("-zmqpubhashtx=<address>");
@@ -536,6 +793,28 @@ void SetupServerArgs()
     hidden_args.emplace_back("-zmqpubhashtxhwm=<n>");
     hidden_args.emplace_back("-zmqpubrawblockhwm=<n>");
     hidden_args.emplace_back("-zmqpubrawtxhwm=<n>");
+    // VELES BEGIN
+    hidden_args.emplace_back("-zmqpubwork=<address>");
+    hidden_args.emplace_back("-zmqpubworkhwm=<n>");
+    hidden_args.emplace_back("-zmqpubworkaddress=<address>");
+    hidden_args.emplace_back("-zmqpubworkfeedelta=<amt>");
+    hidden_args.emplace_back("-zmqpubhashtxlock=<address>");
+    hidden_args.emplace_back("-zmqpubrawtxlock=<address>");
+    hidden_args.emplace_back("-zmqpubhashgovernanceobject=<address>");
+    hidden_args.emplace_back("-zmqpubhashgovernancevote=<address>");
+    hidden_args.emplace_back("-zmqpubmasternodelistchange=<address>");
+    hidden_args.emplace_back("-zmqpubhashtxlockhwm=<n>");
+    hidden_args.emplace_back("-zmqpubrawtxlockhwm=<n>");
+    hidden_args.emplace_back("-zmqpubhashgovernanceobjecthwm=<n>");
+    hidden_args.emplace_back("-zmqpubhashgovernancevotehwm=<n>");
+    hidden_args.emplace_back("-zmqpubmasternodelistchangehwm=<n>");
+    hidden_args.emplace_back("-zmqpubhashtxbatch=<address>");
+    hidden_args.emplace_back("-zmqpubhashtxbatchhwm=<n>");
+    hidden_args.emplace_back("-zmqpubhashtxbatchinterval=<n>");
+    hidden_args.emplace_back("-zmqpubblockdelta=<address>");
+    hidden_args.emplace_back("-zmqpubblockdeltahwm=<n>");
+    hidden_args.emplace_back("-zmqqueuesize=<n>");
+    // VELES END
 #endif
 
     gArgs.AddArg("-checkblocks=<n>", strprintf("How many blocks to check at startup (default: %u, 0 = all)", DEFAULT_CHECKBLOCKS), true, OptionsCategory::DEBUG_TEST);
@@ -547,7 +826,14 @@ void SetupServerArgs()
         "and level 4 tries to reconnect the blocks, "
         "each level includes the checks of the previous levels "
         "(0-4, default: %u)", DEFAULT_CHECKLEVEL), true, OptionsCategory::DEBUG_TEST);
+    // VELES BEGIN
+    gArgs.AddArg("-backgroundverify", strprintf("Only run the startup block verification up to level 2 and the higher -checklevel once started, in the background (default: %u)", DEFAULT_BACKGROUND_VERIFY), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-backgroundverifyrate=<n>", strprintf("Limit the blocks read by the background verification to <n> MiB per second (0 = no limit, default: %u)", DEFAULT_BACKGROUND_VERIFY_RATE), true, OptionsCategory::DEBUG_TEST);
+    // VELES END
     gArgs.AddArg("-checkblockindex", strprintf("Do a full consistency check for mapBlockIndex, setBlockIndexCandidates, chainActive and mapBlocksUnlinked occasionally. (default: %u, regtest: %u)", defaultChainParams->DefaultConsistencyChecks(), regtestChainParams->DefaultConsistencyChecks()), true, OptionsCategory::DEBUG_TEST);
+    // VELES BEGIN
+    gArgs.AddArg("-checkpowonload=<n>", strprintf("How many of the most recent block headers to re-verify the stored proof-of-work hash of at startup (default: %d, -1 = all)", DEFAULT_CHECKPOWONLOAD), true, OptionsCategory::DEBUG_TEST);
+    // VELES END
     gArgs.AddArg("-checkmempool=<n>", strprintf("Run checks every <n> transactions (default: %u, regtest: %u)", defaultChainParams->DefaultConsistencyChecks(), regtestChainParams->DefaultConsistencyChecks()), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checkpoints", strprintf("Disable expensive verification for known chain history (default: %u)", DEFAULT_CHECKPOINTS_ENABLED), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-deprecatedrpc=<method>", "Allows deprecated RPC method(s) to be used", true, OptionsCategory::DEBUG_TEST);
@@ -562,11 +848,21 @@ void SetupServerArgs()
     gArgs.AddArg("-debug=<category>", "Output debugging information (default: -nodebug, supplying <category> is optional). "
         "If <category> is not supplied or if <category> = 1, output all debugging information. <category> can be: " + ListLogCategories() + ".", false, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-debugexclude=<category>", strprintf("Exclude debugging information for a category. Can be used in conjunction with -debug=1 to output debug logs for all categories except one or more specified categories."), false, OptionsCategory::DEBUG_TEST);
+    // VELES BEGIN
+    gArgs.AddArg("-lockstats", strprintf("Record how long every lock site waits for and holds its lock, returned by getlockstats and written to %s at shutdown. Slows down locking (default: %u)", LOCK_STATS_FILENAME, DEFAULT_LOCK_STATS), true, OptionsCategory::DEBUG_TEST);
+    // VELES END
+    // VELES BEGIN
+    gArgs.AddArg("-logasync", strprintf("Write the log from a background thread, so logging does not wait for the disk. Messages are dropped when the writer falls behind (default: %u)", DEFAULT_LOGASYNC), false, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-logratelimit=<n>", strprintf("Log at most <n> messages per second of every debug category, 0 for no limit (default: %u)", DEFAULT_LOGRATELIMIT), false, OptionsCategory::DEBUG_TEST);
+    // VELES END
     gArgs.AddArg("-logips", strprintf("Include IP addresses in debug output (default: %u)", DEFAULT_LOGIPS), false, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-logtimestamps", strprintf("Prepend debug output with timestamp (default: %u)", DEFAULT_LOGTIMESTAMPS), false, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-logtimemicros", strprintf("Add microsecond precision to debug timestamps (default: %u)", DEFAULT_LOGTIMEMICROS), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-mocktime=<n>", "Replace actual time with <n> seconds since epoch (default: 0)", true, OptionsCategory::DEBUG_TEST);
-    gArgs.AddArg("-maxsigcachesize=<n>", strprintf("Limit sum of signature cache and script execution cache sizes to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE), true, OptionsCategory::DEBUG_TEST);
+    // VELES BEGIN
+    //gArgs.AddArg("-maxsigcachesize=<n>", strprintf("Limit sum of signature cache and script execution cache sizes to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-maxsigcachesize=<n>", strprintf("Limit sum of signature cache and script execution cache sizes to <n> MiB (default: enough for a full -maxmempool, at least %u)", DEFAULT_MAX_SIG_CACHE_SIZE), true, OptionsCategory::DEBUG_TEST);
+    // VELES END
     gArgs.AddArg("-maxtipage=<n>", strprintf("Maximum tip age in seconds to consider node in initial block download (default: %u)", DEFAULT_MAX_TIP_AGE), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-maxtxfee=<amt>", strprintf("Maximum total fees (in %s) to use in a single wallet transaction or raw transaction; setting this too low may abort large transactions (default: %s)",
         CURRENCY_UNIT, FormatMoney(DEFAULT_TRANSACTION_MAXFEE)), false, OptionsCategory::DEBUG_TEST);
@@ -599,6 +895,11 @@ void SetupServerArgs()
     // VELES END
 
     gArgs.AddArg("-rest", strprintf("Accept public REST requests (default: %u)", DEFAULT_REST_ENABLE), false, OptionsCategory::RPC);
+    // VELES BEGIN
+    gArgs.AddArg("-metrics", strprintf("Serve counters and gauges of the node at /metrics in the Prometheus text format, without authentication (default: %u)", DEFAULT_METRICS_ENABLE), false, OptionsCategory::RPC);
+    gArgs.AddArg("-restthreads=<n>", strprintf("Set the number of threads to service REST requests, apart from the RPC threads (default: %d)", DEFAULT_HTTP_REST_THREADS), false, OptionsCategory::RPC);
+    gArgs.AddArg("-restworkqueue=<n>", strprintf("Set the depth of the work queue to service REST requests (default: %d)", DEFAULT_HTTP_REST_WORKQUEUE), true, OptionsCategory::RPC);
+    // VELES END
     gArgs.AddArg("-rpcallowip=<ip>", "Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times", false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcauth=<userpw>", "Username and HMAC-SHA-256 hashed password for JSON-RPC connections. The field <userpw> comes in the format: <USERNAME>:<SALT>$<HASH>. A canonical python script is included in share/rpcauth. The client then connects normally using the rpcuser=<USERNAME>/rpcpassword=<PASSWORD> pair of arguments. This option can be specified multiple times", false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcbind=<addr>[:port]", "Bind to given address to listen for JSON-RPC connections. Do not expose the RPC server to untrusted networks such as the public internet! This option is ignored unless -rpcallowip is also passed. Port is optional and overrides -rpcport. Use [host]:port notation for IPv6. This option can be specified multiple times (default: 127.0.0.1 and ::1 i.e., localhost)", false, OptionsCategory::RPC);
@@ -606,7 +907,9 @@ void SetupServerArgs()
     gArgs.AddArg("-rpcpassword=<pw>", "Password for JSON-RPC connections", false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcport=<port>", strprintf("Listen for JSON-RPC connections on <port> (default: %u, testnet: %u, regtest: %u)", defaultBaseParams->RPCPort(), testnetBaseParams->RPCPort(), regtestBaseParams->RPCPort()), false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcserialversion", strprintf("Sets the serialization of raw transaction or block hex returned in non-verbose mode, non-segwit(0) or segwit(1) (default: %d)", DEFAULT_RPC_SERIALIZE_VERSION), false, OptionsCategory::RPC);
+    gArgs.AddArg("-rpcslowlog=<ms>", strprintf("Log the RPC calls running for at least <ms> milliseconds with the sizes of their parameters, 0 to log none (default: %d)", DEFAULT_RPC_SLOW_LOG), false, OptionsCategory::RPC); // VELES
     gArgs.AddArg("-rpcservertimeout=<n>", strprintf("Timeout during HTTP requests (default: %d)", DEFAULT_HTTP_SERVER_TIMEOUT), true, OptionsCategory::RPC);
+    gArgs.AddArg("-rpcbatchthreads=<n>", strprintf("Set the number of threads running the read-only calls of JSON-RPC batches concurrently, 0 to run batches in order on one thread (default: %d, maximum: %d)", DEFAULT_RPC_BATCH_THREADS, MAX_RPC_BATCH_THREADS), false, OptionsCategory::RPC); // VELES
     gArgs.AddArg("-rpcthreads=<n>", strprintf("Set the number of threads to service RPC calls (default: %d)", DEFAULT_HTTP_THREADS), false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcuser=<user>", "Username for JSON-RPC connections", false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcworkqueue=<n>", strprintf("Set the depth of the work queue to service RPC calls (default: %d)", DEFAULT_HTTP_WORKQUEUE), true, OptionsCategory::RPC);
@@ -622,6 +925,9 @@ void SetupServerArgs()
     // Dash
     gArgs.AddArg("-masternode", "Run as masternode", false, OptionsCategory::DASH_FEATURES);
     gArgs.AddArg("-masternodeprivkey", "Masternode private key", false, OptionsCategory::DASH_FEATURES);
+    // VELES BEGIN
+    gArgs.AddArg("-hostmasternodes", strprintf("Also operate the masternodes of masternode.conf, the node must accept connections on their addresses (default: %u)", DEFAULT_HOST_MASTERNODES), false, OptionsCategory::DASH_FEATURES);
+    // VELES END
     hidden_args.emplace_back("-litemode");
     hidden_args.emplace_back("-sporkkey");
     //
@@ -748,8 +1054,14 @@ static void ThreadImport(std::vector<fs::path> vImportFiles)
     {
     CImportingNow imp;
 
+    // VELES BEGIN
+    int nImportThreads = std::max(1, std::min((int)gArgs.GetArg("-importthreads", DEFAULT_IMPORT_THREADS), MAX_IMPORT_THREADS));
+    // VELES END
+
     // -reindex
     if (fReindex) {
+        // VELES BEGIN
+        /*
         int nFile = 0;
         while (true) {
             CDiskBlockPos pos(nFile, 0);
@@ -762,6 +1074,9 @@ static void ThreadImport(std::vector<fs::path> vImportFiles)
             LoadExternalBlockFile(chainparams, file, &pos);
             nFile++;
         }
+        */
+        ReindexBlockFiles(chainparams, nImportThreads);
+        // VELES END
         pblocktree->WriteReindexing(false);
         fReindex = false;
         LogPrintf("Reindexing finished\n");
@@ -784,6 +1099,8 @@ static void ThreadImport(std::vector<fs::path> vImportFiles)
     }
 
     // -loadblock=
+    // VELES BEGIN
+    /*
     for (const fs::path& path : vImportFiles) {
         FILE *file = fsbridge::fopen(path, "rb");
         if (file) {
@@ -793,6 +1110,9 @@ static void ThreadImport(std::vector<fs::path> vImportFiles)
             LogPrintf("Warning: Could not open blocks file %s\n", path.string());
         }
     }
+    */
+    LoadExternalBlockFiles(chainparams, vImportFiles, nImportThreads);
+    // VELES END
 
     // scan for better chains in the block chain database, that are not yet connected in the active best chain
     CValidationState state;
@@ -812,6 +1132,11 @@ static void ThreadImport(std::vector<fs::path> vImportFiles)
         LoadMempool();
     }
     g_is_mempool_loaded = !ShutdownRequested();
+    // VELES BEGIN
+    if (g_is_mempool_loaded && gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
+        g_mempool_journal.Open(mempool);
+    }
+    // VELES END
 }
 
 /** Sanity checks
@@ -846,6 +1171,7 @@ static bool AppInitServers()
     if (!StartHTTPRPC())
         return false;
     if (gArgs.GetBoolArg("-rest", DEFAULT_REST_ENABLE)) StartREST();
+    if (gArgs.GetBoolArg("-metrics", DEFAULT_METRICS_ENABLE)) StartMetricsServer(); // VELES
     StartHTTPServer();
     return true;
 }
@@ -951,8 +1277,10 @@ void InitLogging()
     LogInstance().m_print_to_console = gArgs.GetBoolArg("-printtoconsole", !gArgs.GetBoolArg("-daemon", false));
     LogInstance().m_log_timestamps = gArgs.GetBoolArg("-logtimestamps", DEFAULT_LOGTIMESTAMPS);
     LogInstance().m_log_time_micros = gArgs.GetBoolArg("-logtimemicros", DEFAULT_LOGTIMEMICROS);
+    LogInstance().m_rate_limit = std::max<int64_t>(0, gArgs.GetArg("-logratelimit", DEFAULT_LOGRATELIMIT)); // VELES
 
     fLogIPs = gArgs.GetBoolArg("-logips", DEFAULT_LOGIPS);
+    g_lock_stats = gArgs.GetBoolArg("-lockstats", DEFAULT_LOCK_STATS); // VELES
 
     std::string version_string = FormatFullVersion();
 #ifdef DEBUG
@@ -1045,10 +1373,56 @@ bool AppInitParameterInteraction()
         return InitError(strprintf(_("Specified blocks directory \"%s\" does not exist."), gArgs.GetArg("-blocksdir", "").c_str()));
     }
 
+    // VELES BEGIN
+    // parse and validate enabled filter types
+    std::string blockfilterindex_value = gArgs.GetArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX);
+    if (blockfilterindex_value == "" || blockfilterindex_value == "1") {
+        g_enabled_filter_types.insert(AllBlockFilterTypes().begin(), AllBlockFilterTypes().end());
+    } else if (blockfilterindex_value != "0") {
+        const std::vector<std::string> names = gArgs.GetArgs("-blockfilterindex");
+        for (const auto& name : names) {
+            BlockFilterType filter_type;
+            if (!BlockFilterTypeByName(name, filter_type)) {
+                return InitError(strprintf(_("Unknown -blockfilterindex value %s."), name));
+            }
+            g_enabled_filter_types.insert(filter_type);
+        }
+    }
+
+    // Signal NODE_COMPACT_FILTERS if peerblockfilters and basic filters index are both enabled.
+    if (gArgs.GetBoolArg("-peerblockfilters", DEFAULT_PEERBLOCKFILTERS)) {
+        if (g_enabled_filter_types.count(BlockFilterType::BASIC) != 1) {
+            return InitError(_("Cannot set -peerblockfilters without -blockfilterindex."));
+        }
+        nLocalServices = ServiceFlags(nLocalServices | NODE_COMPACT_FILTERS);
+    }
+    // VELES END
+
+    // VELES BEGIN
+    {
+        std::string strError;
+        if (!CheckDBOptions(strError))
+            return InitError(strError);
+    }
+    // VELES END
+
     // if using block pruning, then disallow txindex
     if (gArgs.GetArg("-prune", 0)) {
         if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX))
             return InitError(_("Prune mode is incompatible with -txindex."));
+        // VELES BEGIN
+        if (!g_enabled_filter_types.empty()) {
+            return InitError(_("Prune mode is incompatible with -blockfilterindex."));
+        }
+        if (gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX))
+            return InitError(_("Prune mode is incompatible with -addressindex."));
+        if (gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX))
+            return InitError(_("Prune mode is incompatible with -spentindex."));
+        if (gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX))
+            return InitError(_("Prune mode is incompatible with -timestampindex."));
+        if (gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX))
+            return InitError(_("Prune mode is incompatible with -coinstatsindex."));
+        // VELES END
     }
 
     // -bind and -whitebind can't be set when not listening
@@ -1151,6 +1525,17 @@ bool AppInitParameterInteraction()
         nScriptCheckThreads = 0;
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
+    // VELES BEGIN
+    const std::string strPinning = gArgs.GetArg("-parpin", DEFAULT_SCRIPTCHECK_PINNING);
+    if (strPinning == "none") {
+        g_script_check_pinning = ScriptCheckPinning::NONE;
+    } else if (strPinning == "cores") {
+        g_script_check_pinning = ScriptCheckPinning::CORES;
+    } else {
+        return InitError(strprintf(_("Unknown -parpin policy '%s'"), strPinning));
+    }
+    g_max_validation_queue = std::min<int64_t>(std::max<int64_t>(gArgs.GetArg("-maxvalidationqueue", DEFAULT_MAX_VALIDATION_QUEUE), 2), 1000000);
+    // VELES END
 
     // block pruning; get the amount of disk space (in MiB) to allot for block & undo files
     int64_t nPruneArg = gArgs.GetArg("-prune", 0);
@@ -1293,6 +1678,10 @@ bool AppInitSanityChecks()
     // Initialize elliptic curve code
     std::string sha256_algo = SHA256AutoDetect();
     LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    // VELES BEGIN
+    LogPrintf("Using the '%s' scrypt implementation\n", scrypt_detect());
+    LogPrintf("Using the '%s' ECHO, Groestl and SHAvite implementation\n", SphAutoDetect());
+    // VELES END
     RandomInit();
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -1319,6 +1708,98 @@ bool AppInitLockDataDirectory()
     return true;
 }
 
+// VELES BEGIN
+static void ThreadBackgroundVerify()
+{
+    RenameThread("veles-verify");
+    ScheduleBatchPriority();
+    try {
+        CVerifyDB().VerifyDBBackground(Params(), gArgs.GetArg("-checklevel", DEFAULT_CHECKLEVEL),
+            gArgs.GetArg("-checkblocks", DEFAULT_CHECKBLOCKS), gArgs.GetArg("-backgroundverifyrate", DEFAULT_BACKGROUND_VERIFY_RATE) << 20);
+    } catch (const boost::thread_interrupted&) {
+        LogPrintf("Background block verification interrupted\n");
+    }
+}
+// VELES END
+
+// VELES BEGIN
+//! Ready once the chain and the masternode settings are loaded, see ThreadLoadCaches
+static std::promise<void> g_caches_check_promise;
+
+static void ThreadLoadCaches()
+{
+    RenameThread("veles-loadcache");
+    int64_t nStart = GetTimeMillis();
+    std::future<void> futureCheck = g_caches_check_promise.get_future();
+
+    // LOAD SERIALIZED DAT FILES INTO DATA CACHES FOR INTERNAL USE
+
+    // The files are read while the block index and the chainstate load and verify,
+    // the entries are only checked against the chain once it is ready
+
+    boost::filesystem::path pathDB = GetDataDir();
+    std::string strDBName;
+
+    strDBName = "mncache.dat";
+    uiInterface.ShowProgress(_("Loading masternode cache..."), 0, false);
+    CStartupPhaseTimer timerMasternodes("masternode cache");
+    CFlatDB<CMasternodeMan> flatdb1(strDBName, "magicMasternodeCache");
+    if(!flatdb1.Load(mnodeman, true)) {
+        uiInterface.ShowProgress("", 100, false);
+        InitError(_("Failed to load masternode cache from") + "\n" + (pathDB / strDBName).string());
+        StartShutdown();
+        return;
+    }
+    timerMasternodes.Stop();
+
+    const bool fLoadOthers = mnodeman.size() > 0;
+    if(fLoadOthers) {
+        strDBName = "mnpayments.dat";
+        uiInterface.ShowProgress(_("Loading masternode payment cache..."), 33, false);
+        CStartupPhaseTimer timerPayments("masternode payment cache");
+        CFlatDB<CMasternodePayments> flatdb2(strDBName, "magicMasternodePaymentsCache");
+        if(!flatdb2.Load(mnpayments, true)) {
+            uiInterface.ShowProgress("", 100, false);
+            InitError(_("Failed to load masternode payments cache from") + "\n" + (pathDB / strDBName).string());
+            StartShutdown();
+            return;
+        }
+        timerPayments.Stop();
+
+        strDBName = "governance.dat";
+        uiInterface.ShowProgress(_("Loading governance cache..."), 66, false);
+        CStartupPhaseTimer timerGovernance("governance cache");
+        CFlatDB<CGovernanceManager> flatdb3(strDBName, "magicGovernanceCache");
+        if(!flatdb3.Load(governance, true)) {
+            uiInterface.ShowProgress("", 100, false);
+            InitError(_("Failed to load governance cache from") + "\n" + (pathDB / strDBName).string());
+            StartShutdown();
+            return;
+        }
+    } else {
+        LogPrintf("Masternode cache is empty, skipping payments and governance cache...\n");
+    }
+    uiInterface.ShowProgress("", 100, false);
+
+    while (futureCheck.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready)
+        boost::this_thread::interruption_point();
+
+    CStartupPhaseTimer timerCheck("masternode caches check");
+    mnodeman.CheckAndRemove();
+    if(fLoadOthers) {
+        mnpayments.CheckAndRemove();
+        governance.CheckAndRemove();
+        governance.InitOnLoad();
+    }
+    timerCheck.Stop();
+
+    // the caches missed the blocks connected while they were loading
+    pdsNotificationInterface->InitializeCurrentBlockTip();
+    masternodeSync.SetCachesLoaded();
+    LogPrintf("Masternode caches loaded  %dms\n", GetTimeMillis() - nStart);
+}
+// VELES END
+
 bool AppInitMain(InitInterfaces& interfaces)
 {
     const CChainParams& chainparams = Params();
@@ -1338,6 +1819,11 @@ bool AppInitMain(InitInterfaces& interfaces)
                 LogInstance().m_file_path.string()));
         }
     }
+    // VELES BEGIN
+    if (gArgs.GetBoolArg("-logasync", DEFAULT_LOGASYNC)) {
+        LogInstance().StartAsync();
+    }
+    // VELES END
 
     if (!LogInstance().m_log_timestamps)
         LogPrintf("Startup time: %s\n", FormatISO8601DateTime(GetTime()));
@@ -1369,11 +1855,29 @@ bool AppInitMain(InitInterfaces& interfaces)
 
     InitSignatureCache();
     InitScriptExecutionCache();
+    // VELES BEGIN
+    InitHashSignerCache();
+    if (gArgs.GetBoolArg("-persistvalidationcaches", DEFAULT_PERSIST_VALIDATION_CACHES)) {
+        LoadValidationCaches();
+    }
+    // VELES END
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
         for (int i=0; i<nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
+        // VELES BEGIN
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadPoWHashCheck);
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadHashSignerCheck);
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadPrivateSendServerScriptCheck);
+#ifdef ENABLE_WALLET
+        for (int i=0; i<nScriptCheckThreads-1; i++)
+            threadGroup.create_thread(&ThreadWalletScanCheck);
+#endif // ENABLE_WALLET
+        // VELES END
     }
 
     // Dash
@@ -1386,10 +1890,16 @@ bool AppInitMain(InitInterfaces& interfaces)
 
     // Start the lightweight task scheduler thread
     CScheduler::Function serviceLoop = std::bind(&CScheduler::serviceQueue, &scheduler);
-    threadGroup.create_thread(std::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
+    // VELES BEGIN
+    //threadGroup.create_thread(std::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
+    int nSchedulerThreads = std::max(1, std::min((int)gArgs.GetArg("-schedulerthreads", DEFAULT_SCHEDULER_THREADS), MAX_SCHEDULER_THREADS));
+    for (int i = 0; i < nSchedulerThreads; i++)
+        threadGroup.create_thread(std::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
+    // VELES END
 
     GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
     GetMainSignals().RegisterWithMempoolSignals(mempool);
+    g_block_selection.RegisterWithMempoolSignals(mempool); // VELES
 
     // Create client interfaces for wallets that are supposed to be loaded
     // according to -wallet and -disablewallet options. This only constructs
@@ -1539,39 +2049,124 @@ bool AppInitMain(InitInterfaces& interfaces)
     uint64_t nMaxOutboundTimeframe = MAX_UPLOAD_TIMEFRAME;
 
     // Dash
-    pdsNotificationInterface = new CDSNotificationInterface(*g_connman);
+    //pdsNotificationInterface = new CDSNotificationInterface(*g_connman);
+    pdsNotificationInterface = new CDSNotificationInterface(*g_connman, &scheduler); // VELES
     RegisterValidationInterface(pdsNotificationInterface);
     //
 
+    // VELES BEGIN
+    // The side indexes keep what pruned nodes no longer have on disk, they are
+    // loaded before the blocks they follow connect
+    CStartupPhaseTimer timerSideIndexes("payee and collateral indexes");
+    CFlatDB<PayeeIndex> flatdbPayees("payeeindex.dat", "magicPayeeIndex");
+    if (!flatdbPayees.Load(g_payee_index))
+        return InitError(_("Failed to load payee index from") + "\n" + (GetDataDir() / "payeeindex.dat").string());
+    CFlatDB<CollateralIndex> flatdbCollaterals("collateralindex.dat", "magicCollateralIndex");
+    if (!flatdbCollaterals.Load(g_collateral_index))
+        return InitError(_("Failed to load collateral index from") + "\n" + (GetDataDir() / "collateralindex.dat").string());
+    timerSideIndexes.Stop();
+
+    RegisterValidationInterface(&algoStats);
+    RegisterValidationInterface(&g_payee_index);
+    RegisterValidationInterface(&g_collateral_index);
+    if (gArgs.GetBoolArg("-metrics", DEFAULT_METRICS_ENABLE))
+        RegisterValidationInterface(&g_metrics);
+    RegisterValidationInterface(&g_template_precomputer);
+    g_template_precomputer.Start();
+    // VELES END
+
     if (gArgs.IsArgSet("-maxuploadtarget")) {
         nMaxOutboundLimit = gArgs.GetArg("-maxuploadtarget", DEFAULT_MAX_UPLOAD_TARGET)*1024*1024;
     }
 
+    // VELES BEGIN
+    // The Dash-layer caches don't depend on the block index, they are read
+    // while it loads and verifies
+    threadGroup.create_thread(&ThreadLoadCaches);
+    std::future<bool> futureFulfilled = std::async(std::launch::async, []{
+        RenameThread("veles-loadfulfilled");
+        CStartupPhaseTimer timer("fulfilled requests cache");
+        CFlatDB<CNetFulfilledRequestManager> flatdb4("netfulfilled.dat", "magicFulfilledCache");
+        return flatdb4.Load(netfulfilledman);
+    });
+    // VELES END
+
     // ********************************************************* Step 7: load block chain
 
     fReindex = gArgs.GetBoolArg("-reindex", false);
     bool fReindexChainState = gArgs.GetBoolArg("-reindex-chainstate", false);
 
     // cache size calculations
-    int64_t nTotalCache = (gArgs.GetArg("-dbcache", nDefaultDbCache) << 20);
+    //int64_t nTotalCache = (gArgs.GetArg("-dbcache", nDefaultDbCache) << 20);
+    // VELES BEGIN
+    // The extra memory -dbcache=auto allows during the initial block download all goes to the coins cache
+    const bool fAutoDbCache = gArgs.GetArg("-dbcache", "") == "auto";
+    int64_t nTotalCache = fAutoDbCache ? GetAutoDbCache(false) : (gArgs.GetArg("-dbcache", nDefaultDbCache) << 20);
+    const int64_t nCoinCacheIBDExtra = fAutoDbCache ? std::max<int64_t>(GetAutoDbCache(true) - nTotalCache, 0) : 0;
+    // VELES END
     nTotalCache = std::max(nTotalCache, nMinDbCache << 20); // total cache cannot be less than nMinDbCache
     nTotalCache = std::min(nTotalCache, nMaxDbCache << 20); // total cache cannot be greater than nMaxDbcache
     int64_t nBlockTreeDBCache = std::min(nTotalCache / 8, nMaxBlockDBCache << 20);
     nTotalCache -= nBlockTreeDBCache;
     int64_t nTxIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nMaxTxIndexCache << 20 : 0);
     nTotalCache -= nTxIndexCache;
+    // VELES BEGIN
+    int64_t filter_index_cache = 0;
+    if (!g_enabled_filter_types.empty()) {
+        size_t n_indexes = g_enabled_filter_types.size();
+        int64_t max_cache = std::min(nTotalCache / 8, max_filter_index_cache << 20);
+        filter_index_cache = max_cache / n_indexes;
+        nTotalCache -= filter_index_cache * n_indexes;
+    }
+    const bool fAddressIndex = gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
+    const bool fSpentIndex = gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
+    const bool fTimestampIndex = gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
+    const bool fCoinStatsIndex = gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX);
+    int64_t address_index_cache = 0;
+    if (fAddressIndex || fSpentIndex) {
+        // the timestamp index is tiny and gets a fixed cache, the other two share this one
+        int n_indexes = (int)fAddressIndex + (int)fSpentIndex;
+        int64_t max_cache = std::min(nTotalCache / 8, max_address_index_cache << 20);
+        address_index_cache = max_cache / n_indexes;
+        nTotalCache -= address_index_cache * n_indexes;
+    }
+    // VELES END
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
     nCoinCacheUsage = nTotalCache; // the rest goes to in-memory cache
+    nCoinCacheUsageIBD = nCoinCacheIBDExtra > 0 ? nCoinCacheUsage + nCoinCacheIBDExtra : 0; // VELES
     int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1f MiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
     if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
         LogPrintf("* Using %.1f MiB for transaction index database\n", nTxIndexCache * (1.0 / 1024 / 1024));
     }
+    // VELES BEGIN
+    for (BlockFilterType filter_type : g_enabled_filter_types) {
+        LogPrintf("* Using %.1f MiB for %s block filter index database\n",
+                  filter_index_cache * (1.0 / 1024 / 1024), BlockFilterTypeName(filter_type));
+    }
+    if (fAddressIndex) {
+        LogPrintf("* Using %.1f MiB for address index database\n", address_index_cache * (1.0 / 1024 / 1024));
+    }
+    if (fSpentIndex) {
+        LogPrintf("* Using %.1f MiB for spent index database\n", address_index_cache * (1.0 / 1024 / 1024));
+    }
+    int64_t nBlockReadCache = std::max((int64_t)0, std::min(gArgs.GetArg("-blockreadcache", DEFAULT_BLOCK_READ_CACHE), MAX_BLOCK_READ_CACHE)) << 20;
+    g_block_read_cache.SetLimit(nBlockReadCache);
+    LogPrintf("* Using %.1f MiB for blocks read from disk\n", nBlockReadCache * (1.0 / 1024 / 1024));
+    if (gArgs.GetBoolArg("-blockmmap", DEFAULT_BLOCK_MMAP) && !g_block_read_cache.SetMmap(true)) {
+        InitWarning(_("Memory mapped block files are not supported on this system, ignoring -blockmmap."));
+    }
+    // VELES END
     LogPrintf("* Using %.1f MiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1f MiB for in-memory UTXO set (plus up to %.1f MiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
+    // VELES BEGIN
+    if (nCoinCacheUsageIBD > 0) {
+        LogPrintf("* Using up to %.1f MiB for in-memory UTXO set during initial block download (-dbcache=auto)\n", nCoinCacheUsageIBD * (1.0 / 1024 / 1024));
+    }
+    // VELES END
 
     bool fLoaded = false;
     while (!fLoaded && !ShutdownRequested()) {
@@ -1607,7 +2202,9 @@ bool AppInitMain(InitInterfaces& interfaces)
 
                 // FXTC BEGIN
                 uiInterface.InitMessage(_("Loading sporks..."));
+                CStartupPhaseTimer timerSporks("sporks"); // VELES
                 sporkManager.LoadSporksFromDB();
+                timerSporks.Stop(); // VELES
                 uiInterface.InitMessage(_("Loading block index..."));
                 // FXTC END
 
@@ -1617,10 +2214,12 @@ bool AppInitMain(InitInterfaces& interfaces)
                 // block file from disk.
                 // Note that it also sets fReindex based on the disk flag!
                 // From here on out fReindex and fReset mean something different!
+                CStartupPhaseTimer timerBlockIndex("block index"); // VELES
                 if (!LoadBlockIndex(chainparams)) {
                     strLoadError = _("Error loading block database");
                     break;
                 }
+                timerBlockIndex.Stop(); // VELES
 
                 // If the loaded chain has a wrong genesis, bail out immediately
                 // (we're likely using a testnet datadir, or the other way around).
@@ -1647,7 +2246,9 @@ bool AppInitMain(InitInterfaces& interfaces)
                 // At this point we're either in reindex or we've loaded a useful
                 // block tree into mapBlockIndex!
 
+                CStartupPhaseTimer timerChainstate("chainstate"); // VELES
                 pcoinsdbview.reset(new CCoinsViewDB(nCoinDBCache, false, fReset || fReindexChainState));
+                pcoinsdbview->SetAsyncFlush(gArgs.GetBoolArg("-asyncflush", DEFAULT_ASYNC_FLUSH)); // VELES
                 pcoinscatcher.reset(new CCoinsViewErrorCatcher(pcoinsdbview.get()));
 
                 // If necessary, upgrade from older database format.
@@ -1675,6 +2276,7 @@ bool AppInitMain(InitInterfaces& interfaces)
                     }
                     assert(chainActive.Tip() != nullptr);
                 }
+                timerChainstate.Stop(); // VELES
             } catch (const std::exception& e) {
                 LogPrintf("%s\n", e.what());
                 strLoadError = _("Error opening block database");
@@ -1686,6 +2288,7 @@ bool AppInitMain(InitInterfaces& interfaces)
                 // It both disconnects blocks based on chainActive, and drops block data in
                 // mapBlockIndex based on lack of available witness data.
                 uiInterface.InitMessage(_("Rewinding blocks..."));
+                CStartupPhaseTimer timerRewind("rewind"); // VELES
                 if (!RewindBlockIndex(chainparams)) {
                     strLoadError = _("Unable to rewind the database to a pre-fork state. You will need to redownload the blockchain");
                     break;
@@ -1710,8 +2313,16 @@ bool AppInitMain(InitInterfaces& interfaces)
                         break;
                     }
 
-                    if (!CVerifyDB().VerifyDB(chainparams, pcoinsdbview.get(), gArgs.GetArg("-checklevel", DEFAULT_CHECKLEVEL),
-                                  gArgs.GetArg("-checkblocks", DEFAULT_CHECKBLOCKS))) {
+                    CStartupPhaseTimer timerVerify("verify blocks"); // VELES
+                    // VELES BEGIN
+                    // The deeper levels run in the background once started
+                    int nCheckLevel = gArgs.GetArg("-checklevel", DEFAULT_CHECKLEVEL);
+                    if (gArgs.GetBoolArg("-backgroundverify", DEFAULT_BACKGROUND_VERIFY))
+                        nCheckLevel = std::min(nCheckLevel, 2);
+                    // VELES END
+                    //if (!CVerifyDB().VerifyDB(chainparams, pcoinsdbview.get(), gArgs.GetArg("-checklevel", DEFAULT_CHECKLEVEL),
+                    //              gArgs.GetArg("-checkblocks", DEFAULT_CHECKBLOCKS))) {
+                    if (!CVerifyDB().VerifyDB(chainparams, pcoinsdbview.get(), nCheckLevel, gArgs.GetArg("-checkblocks", DEFAULT_CHECKBLOCKS))) { // VELES
                         strLoadError = _("Corrupted block database detected");
                         break;
                     }
@@ -1761,18 +2372,50 @@ bool AppInitMain(InitInterfaces& interfaces)
         ::feeEstimator.Read(est_filein);
     fFeeEstimatesInitialized = true;
 
+    // VELES BEGIN
+    int nPrefetchThreads = std::max(0, std::min((int)gArgs.GetArg("-prefetchthreads", DEFAULT_COINS_PREFETCH_THREADS), MAX_COINS_PREFETCH_THREADS));
+    LogPrintf("Using %d threads for coins prefetch\n", nPrefetchThreads);
+    g_coins_prefetcher.Start(nPrefetchThreads);
+    // VELES END
+
     // ********************************************************* Step 8: start indexers
     if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
         g_txindex = MakeUnique<TxIndex>(nTxIndexCache, false, fReindex);
         g_txindex->Start();
     }
 
+    // VELES BEGIN
+    for (const auto& filter_type : g_enabled_filter_types) {
+        InitBlockFilterIndex(filter_type, filter_index_cache, false, fReindex);
+        GetBlockFilterIndex(filter_type)->Start();
+    }
+    if (fAddressIndex) {
+        g_addressindex = MakeUnique<AddressIndex>(address_index_cache, false, fReindex);
+        g_addressindex->Start();
+    }
+    if (fSpentIndex) {
+        g_spentindex = MakeUnique<SpentIndex>(address_index_cache, false, fReindex);
+        g_spentindex->Start();
+    }
+    if (fTimestampIndex) {
+        g_timestampindex = MakeUnique<TimestampIndex>(1 << 20, false, fReindex);
+        g_timestampindex->Start();
+    }
+    if (fCoinStatsIndex) {
+        // one entry of about 100 bytes per block, like the timestamp index it gets a fixed cache
+        g_coinstatsindex = MakeUnique<CoinStatsIndex>(1 << 22, false, fReindex);
+        g_coinstatsindex->Start();
+    }
+    // VELES END
+
     // ********************************************************* Step 9: load wallet
+    CStartupPhaseTimer timerWallets("wallets"); // VELES
     for (const auto& client : interfaces.chain_clients) {
         if (!client->load()) {
             return false;
         }
     }
+    timerWallets.Stop(); // VELES
 
     // ********************************************************* Step 10: data directory maintenance
 
@@ -1787,6 +2430,17 @@ bool AppInitMain(InitInterfaces& interfaces)
         }
     }
 
+    // VELES BEGIN
+    // blocks up to a loaded UTXO snapshot can't be served either
+    {
+        LOCK(cs_main);
+        if (g_snapshot_base) {
+            LogPrintf("Unsetting NODE_NETWORK, the chain state was loaded from a UTXO snapshot\n");
+            nLocalServices = ServiceFlags(nLocalServices & ~NODE_NETWORK);
+        }
+    }
+    // VELES END
+
     if (chainparams.GetConsensus().vDeployments[Consensus::DEPLOYMENT_SEGWIT].nTimeout != 0) {
         // Only advertise witness capabilities if they have a reasonable start time.
         // This allows us to have the code merged without a defined softfork, by setting its
@@ -1846,7 +2500,11 @@ bool AppInitMain(InitInterfaces& interfaces)
     fMasterNode = gArgs.GetBoolArg("-masternode", false);
     // TODO: masternode should have no wallet
 
-    if((fMasterNode || masternodeConfig.getCount() > -1) && gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX) == false) {
+    // VELES BEGIN
+    // Pruned nodes find the collaterals in the UTXO set and the collateral index
+    //if((fMasterNode || masternodeConfig.getCount() > -1) && gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX) == false) {
+    if((fMasterNode || masternodeConfig.getCount() > -1) && gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX) == false && !fPruneMode) {
+    // VELES END
         return InitError("Enabling Masternode support requires turning on transaction indexing."
                   "Please add txindex=1 to your configuration and start with -reindex");
     }
@@ -1863,6 +2521,17 @@ bool AppInitMain(InitInterfaces& interfaces)
         } else {
             return InitError(_("You must specify a masternodeprivkey in the configuration. Please see documentation for help."));
         }
+
+        // VELES BEGIN
+        if(gArgs.GetBoolArg("-hostmasternodes", DEFAULT_HOST_MASTERNODES)) {
+            for (const CMasternodeConfig::CMasternodeEntry& mne : masternodeConfig.getEntries()) {
+                std::string strError;
+                if(!hostedMasternodes.Add(mne.getAlias(), mne.getPrivKey(), mne.getIp(), strError))
+                    return InitError(strprintf(_("Can't host masternode %s: %s"), mne.getAlias(), strError));
+            }
+            LogPrintf("  hosted masternodes: %u\n", hostedMasternodes.size());
+        }
+        // VELES END
     }
 
 #ifdef ENABLE_WALLET
@@ -1875,18 +2544,26 @@ bool AppInitMain(InitInterfaces& interfaces)
             LogPrintf("Locking Masternodes:\n");
             uint256 mnTxHash;
             int outputIndex;
+            // VELES BEGIN
+            std::set<COutPoint> setCollaterals;
+            // VELES END
             for (CMasternodeConfig::CMasternodeEntry mne : masternodeConfig.getEntries()) {
                 mnTxHash.SetHex(mne.getTxHash());
                 outputIndex = boost::lexical_cast<unsigned int>(mne.getOutputIndex());
                 COutPoint outpoint = COutPoint(mnTxHash, outputIndex);
-                // don't lock non-spendable outpoint (i.e. it's already spent or it's not from this wallet at all)
-                if(pwallet->IsMine(CTxIn(outpoint)) != ISMINE_SPENDABLE) {
-                    LogPrintf("  %s %s - IS NOT SPENDABLE, was not locked\n", mne.getTxHash(), mne.getOutputIndex());
-                    continue;
-                }
-                pwallet->LockCoin(outpoint);
-                LogPrintf("  %s %s - locked successfully\n", mne.getTxHash(), mne.getOutputIndex());
+                //// don't lock non-spendable outpoint (i.e. it's already spent or it's not from this wallet at all)
+                //if(pwallet->IsMine(CTxIn(outpoint)) != ISMINE_SPENDABLE) {
+                //    LogPrintf("  %s %s - IS NOT SPENDABLE, was not locked\n", mne.getTxHash(), mne.getOutputIndex());
+                //    continue;
+                //}
+                //pwallet->LockCoin(outpoint);
+                //LogPrintf("  %s %s - locked successfully\n", mne.getTxHash(), mne.getOutputIndex());
+                setCollaterals.insert(outpoint); // VELES
             }
+            // VELES BEGIN
+            // the wallet also locks the collaterals it receives later on
+            pwallet->LockMasternodeCollaterals(setCollaterals);
+            // VELES END
         }
     }
 
@@ -1900,6 +2577,7 @@ bool AppInitMain(InitInterfaces& interfaces)
     privateSendClient.fPrivateSendMultiSession = gArgs.GetBoolArg("-privatesendmultisession", DEFAULT_PRIVATESEND_MULTISESSION);
     privateSendClient.nPrivateSendRounds = std::min(std::max((int)gArgs.GetArg("-privatesendrounds", DEFAULT_PRIVATESEND_ROUNDS), 2), privateSendClient.nLiquidityProvider ? 99999 : 16);
     privateSendClient.nPrivateSendAmount = std::min(std::max((int)gArgs.GetArg("-privatesendamount", DEFAULT_PRIVATESEND_AMOUNT), 2), 999999);
+    privateSendClient.nPrivateSendSessions = std::min(std::max((int)gArgs.GetArg("-privatesendsessions", DEFAULT_PRIVATESEND_SESSIONS), 1), MAX_PRIVATESEND_SESSIONS); // VELES
 #endif // ENABLE_WALLET
 
     fEnableInstantSend = gArgs.GetBoolArg("-enableinstantsend", 1);
@@ -1917,47 +2595,67 @@ bool AppInitMain(InitInterfaces& interfaces)
 #ifdef ENABLE_WALLET
     LogPrintf("PrivateSend rounds %d\n", privateSendClient.nPrivateSendRounds);
     LogPrintf("PrivateSend amount %d\n", privateSendClient.nPrivateSendAmount);
+    LogPrintf("PrivateSend sessions %d\n", privateSendClient.nPrivateSendSessions); // VELES
 #endif // ENABLE_WALLET
 
     CPrivateSend::InitStandardDenominations();
 
+    // VELES BEGIN
+    size_t nMaxDashCache = std::max((int64_t)0, gArgs.GetArg("-maxdashcache", DEFAULT_MAX_DASH_CACHE)) << 20;
+    mnodeman.SetMaxSeenPingUsage(nMaxDashCache);
+    governance.SetMaxVoteCacheUsage(nMaxDashCache);
+    instantsend.SetMaxOrphanVoteUsage(nMaxDashCache);
+    // VELES END
+
     // ********************************************************* Step 11b: Load cache data
 
     // LOAD SERIALIZED DAT FILES INTO DATA CACHES FOR INTERNAL USE
 
-    boost::filesystem::path pathDB = GetDataDir();
-    std::string strDBName;
-
-    strDBName = "mncache.dat";
-    uiInterface.InitMessage(_("Loading masternode cache..."));
-    CFlatDB<CMasternodeMan> flatdb1(strDBName, "magicMasternodeCache");
-    if(!flatdb1.Load(mnodeman)) {
-        return InitError(_("Failed to load masternode cache from") + "\n" + (pathDB / strDBName).string());
-    }
+    //boost::filesystem::path pathDB = GetDataDir();
+    //std::string strDBName;
+
+    //strDBName = "mncache.dat";
+    //uiInterface.InitMessage(_("Loading masternode cache..."));
+    //CFlatDB<CMasternodeMan> flatdb1(strDBName, "magicMasternodeCache");
+    //if(!flatdb1.Load(mnodeman)) {
+    //    return InitError(_("Failed to load masternode cache from") + "\n" + (pathDB / strDBName).string());
+    //}
+
+    //if(mnodeman.size()) {
+    //    strDBName = "mnpayments.dat";
+    //    uiInterface.InitMessage(_("Loading masternode payment cache..."));
+    //    CFlatDB<CMasternodePayments> flatdb2(strDBName, "magicMasternodePaymentsCache");
+    //    if(!flatdb2.Load(mnpayments)) {
+    //        return InitError(_("Failed to load masternode payments cache from") + "\n" + (pathDB / strDBName).string());
+    //    }
+
+    //    strDBName = "governance.dat";
+    //    uiInterface.InitMessage(_("Loading governance cache..."));
+    //    CFlatDB<CGovernanceManager> flatdb3(strDBName, "magicGovernanceCache");
+    //    if(!flatdb3.Load(governance)) {
+    //        return InitError(_("Failed to load governance cache from") + "\n" + (pathDB / strDBName).string());
+    //    }
+    //    governance.InitOnLoad();
+    //} else {
+    //    uiInterface.InitMessage(_("Masternode cache is empty, skipping payments and governance cache..."));
+    //}
 
-    if(mnodeman.size()) {
-        strDBName = "mnpayments.dat";
-        uiInterface.InitMessage(_("Loading masternode payment cache..."));
-        CFlatDB<CMasternodePayments> flatdb2(strDBName, "magicMasternodePaymentsCache");
-        if(!flatdb2.Load(mnpayments)) {
-            return InitError(_("Failed to load masternode payments cache from") + "\n" + (pathDB / strDBName).string());
-        }
+    // VELES BEGIN
+    // The node starts without waiting for the big caches, the masternode
+    // sync doesn't leave MASTERNODE_SYNC_WAITING until they are loaded.
+    // Read since step 7, they are now checked against the chain.
+    //threadGroup.create_thread(&ThreadLoadCaches);
+    g_caches_check_promise.set_value();
 
-        strDBName = "governance.dat";
-        uiInterface.InitMessage(_("Loading governance cache..."));
-        CFlatDB<CGovernanceManager> flatdb3(strDBName, "magicGovernanceCache");
-        if(!flatdb3.Load(governance)) {
-            return InitError(_("Failed to load governance cache from") + "\n" + (pathDB / strDBName).string());
-        }
-        governance.InitOnLoad();
-    } else {
-        uiInterface.InitMessage(_("Masternode cache is empty, skipping payments and governance cache..."));
-    }
+    boost::filesystem::path pathDB = GetDataDir();
+    std::string strDBName;
 
     strDBName = "netfulfilled.dat";
     uiInterface.InitMessage(_("Loading fulfilled requests cache..."));
-    CFlatDB<CNetFulfilledRequestManager> flatdb4(strDBName, "magicFulfilledCache");
-    if(!flatdb4.Load(netfulfilledman)) {
+    //CFlatDB<CNetFulfilledRequestManager> flatdb4(strDBName, "magicFulfilledCache");
+    //if(!flatdb4.Load(netfulfilledman)) {
+    if(!futureFulfilled.get()) {
+    // VELES END
         return InitError(_("Failed to load fulfilled requests cache from") + "\n" + (pathDB / strDBName).string());
     }
 
@@ -2019,6 +2717,13 @@ bool AppInitMain(InitInterfaces& interfaces)
     connOptions.nMaxOutboundLimit = nMaxOutboundLimit;
     connOptions.m_peer_connect_timeout = peer_connect_timeout;
 
+    // VELES BEGIN
+    std::string strSocketEventsMode = gArgs.GetArg("-socketevents", DEFAULT_SOCKETEVENTS);
+    if (!ParseSocketEventsMode(strSocketEventsMode, connOptions.socketEventsMode)) {
+        return InitError(strprintf(_("Invalid -socketevents ('%s') specified. Only these modes are supported: %s"), strSocketEventsMode, GetSupportedSocketEventsStr()));
+    }
+    // VELES END
+
     for (const std::string& strBind : gArgs.GetArgs("-bind")) {
         CService addrBind;
         if (!Lookup(strBind.c_str(), addrBind, GetListenPort(), false)) {
@@ -2055,12 +2760,17 @@ bool AppInitMain(InitInterfaces& interfaces)
             connOptions.m_specified_outgoing = connect;
         }
     }
+    // VELES BEGIN
+    if (gArgs.GetBoolArg("-dashmsgqueues", DEFAULT_DASH_MESSAGE_QUEUES))
+        StartDashMessageQueues(*g_connman);
+    // VELES END
     if (!g_connman->Start(scheduler, connOptions)) {
         return false;
     }
 
     // ********************************************************* Step 13: finished
 
+    g_startup_timings.SetFinished(); // VELES
     SetRPCWarmupFinished();
     uiInterface.InitMessage(_("Done loading"));
 
@@ -2070,7 +2780,39 @@ bool AppInitMain(InitInterfaces& interfaces)
 
     scheduler.scheduleEvery([]{
         g_banman->DumpBanlist();
-    }, DUMP_BANS_INTERVAL * 1000);
+    }, DUMP_BANS_INTERVAL * 1000, CScheduler::PRIORITY_BACKGROUND); // VELES
+
+    // VELES BEGIN
+    scheduler.scheduleEvery([]{
+        g_mempool_journal.Flush();
+    }, MEMPOOL_JOURNAL_FLUSH_INTERVAL * 1000, CScheduler::PRIORITY_BACKGROUND);
+
+    scheduler.scheduleEvery([]{
+        sporkManager.FlushSporksToDB();
+    }, SPORK_DB_FLUSH_INTERVAL * 1000, CScheduler::PRIORITY_BACKGROUND);
+
+    scheduler.scheduleEvery([]{
+        for (const std::function<void()>& dump : GetDashCacheDumps()) {
+            dump();
+        }
+    }, DUMP_DASH_CACHES_INTERVAL * 1000, CScheduler::PRIORITY_BACKGROUND);
+
+    if (gArgs.GetBoolArg("-metrics", DEFAULT_METRICS_ENABLE)) {
+        {
+            LOCK(cs_main);
+            g_metrics.SetTip(chainActive.Tip(), IsInitialBlockDownload());
+            g_metrics.SetHeaderTip(pindexBestHeader);
+        }
+        g_metrics.Sample();
+        scheduler.scheduleEvery([]{
+            g_metrics.Sample();
+        }, METRICS_SAMPLE_INTERVAL * 1000, CScheduler::PRIORITY_BACKGROUND);
+    }
+
+    if (gArgs.GetBoolArg("-backgroundverify", DEFAULT_BACKGROUND_VERIFY) && gArgs.GetArg("-checklevel", DEFAULT_CHECKLEVEL) > 2) {
+        threadGroup.create_thread(&ThreadBackgroundVerify);
+    }
+    // VELES END
 
     return true;
 }
@@ -5,11 +5,14 @@
 
 #include <instantx.h>
 #include <key.h>
+#include <core_memusage.h> // VELES
+#include <index/txindex.h> // VELES
 #include <validation.h>
 #include <masternode/activemasternode.h>
 #include <masternode/sync.h>
 #include <masternode/manager.h>
 #include <messagesigner.h>
+#include <metrics.h> // VELES
 #include <net.h>
 #include <protocol.h>
 #include <reverse_iterator.h>
@@ -62,11 +65,24 @@ void CInstantSend::ProcessMessage(CNode* pfrom, const std::string& strCommand, C
 
         uint256 nVoteHash = vote.GetHash();
 
-        pfrom->setAskFor.erase(nVoteHash);
+        //pfrom->setAskFor.erase(nVoteHash);
+        pfrom->RemoveAskFor(nVoteHash); // VELES
 
         // Ignore any InstantSend messages until masternode list is synced
         if(!masternodeSync.IsMasternodeListSynced()) return;
 
+        // VELES BEGIN
+        // Stateless part first, without cs_main: drop known votes and verify the signature,
+        // only the rank check and the state update below run under the locks
+        {
+            LOCK(cs_instantsend);
+            if(mapTxLockVotes.count(nVoteHash)) return;
+        }
+        if(mnodeman.Has(vote.GetMasternodeOutpoint())) {
+            vote.CheckSignature();
+        }
+        // VELES END
+
         LOCK(cs_main);
 #ifdef ENABLE_WALLET
         std::vector<std::shared_ptr<CWallet>> wallets = GetWallets();
@@ -77,7 +93,8 @@ void CInstantSend::ProcessMessage(CNode* pfrom, const std::string& strCommand, C
         LOCK(cs_instantsend);
 
         if(mapTxLockVotes.count(nVoteHash)) return;
-        mapTxLockVotes.insert(std::make_pair(nVoteHash, vote));
+        //mapTxLockVotes.insert(std::make_pair(nVoteHash, vote));
+        AddTxLockVote(nVoteHash, vote); // VELES
 
         ProcessTxLockVote(pfrom, vote, connman);
 
@@ -93,7 +110,8 @@ bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest, CCo
 
     // Check to see if we conflict with existing completed lock
     for (const auto& txin : txLockRequest.vin) {
-        std::map<COutPoint, uint256>::iterator it = mapLockedOutpoints.find(txin.prevout);
+        //std::map<COutPoint, uint256>::iterator it = mapLockedOutpoints.find(txin.prevout);
+        locked_outpoint_m_t::iterator it = mapLockedOutpoints.find(txin.prevout); // VELES
         if(it != mapLockedOutpoints.end() && it->second != txLockRequest.GetHash()) {
             // Conflicting with complete lock, proceed to see if we should cancel them both
             LogPrintf("CInstantSend::ProcessTxLockRequest -- WARNING: Found conflicting completed Transaction Lock, txid=%s, completed lock txid=%s\n",
@@ -104,7 +122,8 @@ bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest, CCo
     // Check to see if there are votes for conflicting request,
     // if so - do not fail, just warn user
     for (const auto& txin : txLockRequest.vin) {
-        std::map<COutPoint, std::set<uint256> >::iterator it = mapVotedOutpoints.find(txin.prevout);
+        //std::map<COutPoint, std::set<uint256> >::iterator it = mapVotedOutpoints.find(txin.prevout);
+        voted_outpoint_m_t::iterator it = mapVotedOutpoints.find(txin.prevout); // VELES
         if(it != mapVotedOutpoints.end()) {
             for (const auto& hash : it->second) {
                 if(hash != txLockRequest.GetHash()) {
@@ -126,7 +145,8 @@ bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest, CCo
     // Masternodes will sometimes propagate votes before the transaction is known to the client.
     // If this just happened - lock inputs, resolve conflicting locks, update transaction status
     // forcing external script notification.
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    //std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    lock_candidate_m_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash); // VELES
     TryToFinalizeLockCandidate(itLockCandidate->second);
 
     return true;
@@ -140,7 +160,8 @@ bool CInstantSend::CreateTxLockCandidate(const CTxLockRequest& txLockRequest)
 
     uint256 txHash = txLockRequest.GetHash();
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    //std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    lock_candidate_m_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash); // VELES
     if(itLockCandidate == mapTxLockCandidates.end()) {
         LogPrintf("CInstantSend::CreateTxLockCandidate -- new, txid=%s\n", txHash.ToString());
 
@@ -153,6 +174,7 @@ bool CInstantSend::CreateTxLockCandidate(const CTxLockRequest& txLockRequest)
     } else if (!itLockCandidate->second.txLockRequest) {
         // i.e. empty Transaction Lock Candidate was created earlier, let's update it with actual data
         itLockCandidate->second.txLockRequest = txLockRequest;
+        itLockCandidate->second.nTimeRequestReceived = GetTimeMicros(); // VELES
         if (itLockCandidate->second.IsTimedOut()) {
             LogPrintf("CInstantSend::CreateTxLockCandidate -- timed out, txid=%s\n", txHash.ToString());
             return false;
@@ -184,7 +206,8 @@ void CInstantSend::Vote(const uint256& txHash, CConnman& connman)
     AssertLockHeld(cs_main);
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    //std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    lock_candidate_m_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash); // VELES
     if (itLockCandidate == mapTxLockCandidates.end()) return;
     Vote(itLockCandidate->second, connman);
     // Let's see if our vote changed smth
@@ -230,14 +253,16 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate, CConnman& connman)
 
         LogPrint(BCLog::INSTANTSEND, "CInstantSend::Vote -- In the top %d (%d)\n", nSignaturesTotal, nRank);
 
-        std::map<COutPoint, std::set<uint256> >::iterator itVoted = mapVotedOutpoints.find(itOutpointLock->first);
+        //std::map<COutPoint, std::set<uint256> >::iterator itVoted = mapVotedOutpoints.find(itOutpointLock->first);
+        voted_outpoint_m_t::iterator itVoted = mapVotedOutpoints.find(itOutpointLock->first); // VELES
 
         // Check to see if we already voted for this outpoint,
         // refuse to vote twice or to include the same outpoint in another tx
         bool fAlreadyVoted = false;
         if(itVoted != mapVotedOutpoints.end()) {
             for (const auto& hash : itVoted->second) {
-                std::map<uint256, CTxLockCandidate>::iterator it2 = mapTxLockCandidates.find(hash);
+                //std::map<uint256, CTxLockCandidate>::iterator it2 = mapTxLockCandidates.find(hash);
+                lock_candidate_m_t::iterator it2 = mapTxLockCandidates.find(hash); // VELES
                 if(it2->second.HasMasternodeVoted(itOutpointLock->first, activeMasternode.outpoint)) {
                     // we already voted for this outpoint to be included either in the same tx or in a competing one,
                     // skip it anyway
@@ -267,7 +292,8 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate, CConnman& connman)
 
         // vote constructed sucessfully, let's store and relay it
         uint256 nVoteHash = vote.GetHash();
-        mapTxLockVotes.insert(std::make_pair(nVoteHash, vote));
+        //mapTxLockVotes.insert(std::make_pair(nVoteHash, vote));
+        AddTxLockVote(nVoteHash, vote); // VELES
         if(itOutpointLock->second.AddVote(vote)) {
             LogPrintf("CInstantSend::Vote -- Vote created successfully, relaying: txHash=%s, outpoint=%s, vote=%s\n",
                     txHash.ToString(), itOutpointLock->first.ToStringShort(), nVoteHash.ToString());
@@ -319,16 +345,27 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote, CConnman&
     // Masternodes will sometimes propagate votes before the transaction is known to the client,
     // will actually process only after the lock request itself has arrived
 
-    std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    //std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    lock_candidate_m_t::iterator it = mapTxLockCandidates.find(txHash); // VELES
     if(it == mapTxLockCandidates.end() || !it->second.txLockRequest) {
         if(!mapTxLockVotesOrphan.count(vote.GetHash())) {
             // start timeout countdown after the very first vote
             CreateEmptyTxLockCandidate(txHash);
+            // VELES BEGIN
+            CTxLockCandidate& txLockCandidateEmpty = mapTxLockCandidates.find(txHash)->second;
+            if(!txLockCandidateEmpty.nTimeFirstVote) txLockCandidateEmpty.nTimeFirstVote = GetTimeMicros();
+            ++txLockCandidateEmpty.nOrphanVotesReceived;
+            // VELES END
             mapTxLockVotesOrphan[vote.GetHash()] = vote;
+            // VELES BEGIN
+            setOrphanVoteTimeouts.insert(std::make_pair(vote.GetTimeCreated() + INSTANTSEND_LOCK_TIMEOUT_SECONDS, vote.GetHash()));
+            LimitOrphanVotes();
+            // VELES END
             LogPrint(BCLog::INSTANTSEND, "CInstantSend::ProcessTxLockVote -- Orphan vote: txid=%s  masternode=%s new\n",
                     txHash.ToString(), vote.GetMasternodeOutpoint().ToStringShort());
             bool fReprocess = true;
-            std::map<uint256, CTxLockRequest>::iterator itLockRequest = mapLockRequestAccepted.find(txHash);
+            //std::map<uint256, CTxLockRequest>::iterator itLockRequest = mapLockRequestAccepted.find(txHash);
+            lock_request_m_t::iterator itLockRequest = mapLockRequestAccepted.find(txHash); // VELES
             if(itLockRequest == mapLockRequestAccepted.end()) {
                 itLockRequest = mapLockRequestRejected.find(txHash);
                 if(itLockRequest == mapLockRequestRejected.end()) {
@@ -353,7 +390,8 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote, CConnman&
 
         int nMasternodeOrphanExpireTime = GetTime() + 60*10; // keep time data for 10 minutes
         if(!mapMasternodeOrphanVotes.count(vote.GetMasternodeOutpoint())) {
-            mapMasternodeOrphanVotes[vote.GetMasternodeOutpoint()] = nMasternodeOrphanExpireTime;
+            //mapMasternodeOrphanVotes[vote.GetMasternodeOutpoint()] = nMasternodeOrphanExpireTime;
+            SetMasternodeOrphanVoteTime(vote.GetMasternodeOutpoint(), nMasternodeOrphanExpireTime); // VELES
         } else {
             int64_t nPrevOrphanVote = mapMasternodeOrphanVotes[vote.GetMasternodeOutpoint()];
             if(nPrevOrphanVote > GetTime() && nPrevOrphanVote > GetAverageMasternodeOrphanVoteTime()) {
@@ -363,7 +401,8 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote, CConnman&
                 return false;
             }
             // not spamming, refresh
-            mapMasternodeOrphanVotes[vote.GetMasternodeOutpoint()] = nMasternodeOrphanExpireTime;
+            //mapMasternodeOrphanVotes[vote.GetMasternodeOutpoint()] = nMasternodeOrphanExpireTime;
+            SetMasternodeOrphanVoteTime(vote.GetMasternodeOutpoint(), nMasternodeOrphanExpireTime); // VELES
         }
 
         return true;
@@ -378,14 +417,16 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote, CConnman&
 
     LogPrint(BCLog::INSTANTSEND, "CInstantSend::ProcessTxLockVote -- Transaction Lock Vote, txid=%s\n", txHash.ToString());
 
-    std::map<COutPoint, std::set<uint256> >::iterator it1 = mapVotedOutpoints.find(vote.GetOutpoint());
+    //std::map<COutPoint, std::set<uint256> >::iterator it1 = mapVotedOutpoints.find(vote.GetOutpoint());
+    voted_outpoint_m_t::iterator it1 = mapVotedOutpoints.find(vote.GetOutpoint()); // VELES
     if(it1 != mapVotedOutpoints.end()) {
         for (const auto& hash : it1->second) {
             if(hash != txHash) {
                 // same outpoint was already voted to be locked by another tx lock request,
                 // let's see if it was the same masternode who voted on this outpoint
                 // for another tx lock request
-                std::map<uint256, CTxLockCandidate>::iterator it2 = mapTxLockCandidates.find(hash);
+                //std::map<uint256, CTxLockCandidate>::iterator it2 = mapTxLockCandidates.find(hash);
+                lock_candidate_m_t::iterator it2 = mapTxLockCandidates.find(hash); // VELES
                 if(it2 !=mapTxLockCandidates.end() && it2->second.HasMasternodeVoted(vote.GetOutpoint(), vote.GetMasternodeOutpoint())) {
                     // yes, it was the same masternode
                     LogPrintf("CInstantSend::ProcessTxLockVote -- masternode sent conflicting votes! %s\n", vote.GetMasternodeOutpoint().ToStringShort());
@@ -415,6 +456,11 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote, CConnman&
         return false;
     }
 
+    // VELES BEGIN
+    if(!txLockCandidate.nTimeFirstVote) txLockCandidate.nTimeFirstVote = GetTimeMicros();
+    ++txLockCandidate.nVotesReceived;
+    // VELES END
+
     int nSignatures = txLockCandidate.CountVotes();
     int nSignaturesMax = txLockCandidate.txLockRequest.GetMaxSignatures();
     LogPrint(BCLog::INSTANTSEND, "CInstantSend::ProcessTxLockVote -- Transaction Lock signatures count: %d/%d, vote hash=%s\n",
@@ -436,7 +482,8 @@ void CInstantSend::ProcessOrphanTxLockVotes(CConnman& connman)
 #endif
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.begin();
+    //std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.begin();
+    lock_vote_m_t::iterator it = mapTxLockVotesOrphan.begin(); // VELES
     while(it != mapTxLockVotesOrphan.end()) {
         if(ProcessTxLockVote(NULL, it->second, connman)) {
             mapTxLockVotesOrphan.erase(it++);
@@ -464,7 +511,8 @@ bool CInstantSend::IsEnoughOrphanVotesForTxAndOutPoint(const uint256& txHash, co
     // Scan orphan votes to check if this outpoint has enough orphan votes to be locked in some tx.
     LOCK2(cs_main, cs_instantsend);
     int nCountVotes = 0;
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.begin();
+    //std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.begin();
+    lock_vote_m_t::iterator it = mapTxLockVotesOrphan.begin(); // VELES
     while(it != mapTxLockVotesOrphan.end()) {
         if(it->second.GetTxHash() == txHash && it->second.GetOutpoint() == outpoint) {
             nCountVotes++;
@@ -494,13 +542,108 @@ void CInstantSend::TryToFinalizeLockCandidate(const CTxLockCandidate& txLockCand
     if(txLockCandidate.IsAllOutPointsReady() && !IsLockedInstantSendTransaction(txHash)) {
         // we have enough votes now
         LogPrint(BCLog::INSTANTSEND, "CInstantSend::TryToFinalizeLockCandidate -- Transaction Lock is ready to complete, txid=%s\n", txHash.ToString());
-        if(ResolveConflicts(txLockCandidate)) {
+        // VELES BEGIN
+        //if(ResolveConflicts(txLockCandidate)) {
+        int64_t nTimeStart = GetTimeMicros();
+        bool fResolved = ResolveConflicts(txLockCandidate);
+        RecordValidationPhase(ValidationPhase::INSTANTSEND_CONFLICTS, GetTimeMicros() - nTimeStart);
+        if(fResolved) {
+        // VELES END
             LockTransactionInputs(txLockCandidate);
             UpdateLockedTransaction(txLockCandidate);
+            RecordLockTiming(txLockCandidate); // VELES
         }
     }
 }
 
+// VELES BEGIN
+void CInstantSend::RecordLockTiming(const CTxLockCandidate& txLockCandidate)
+{
+    AssertLockHeld(cs_instantsend);
+
+    CTxLockTiming timing;
+    timing.txHash = txLockCandidate.GetHash();
+    timing.nTimeRequest = txLockCandidate.nTimeRequestReceived;
+    timing.nFirstVoteDelay = txLockCandidate.nTimeFirstVote - txLockCandidate.nTimeRequestReceived;
+    timing.nLockDelay = GetTimeMicros() - txLockCandidate.nTimeRequestReceived;
+    timing.nVotes = txLockCandidate.nVotesReceived;
+    timing.nOrphanVotes = txLockCandidate.nOrphanVotesReceived;
+    g_metrics.ObserveInstantSendLock(timing.nLockDelay);
+
+    if(vecLockTimings.size() < INSTANTSEND_LOCK_TIMINGS_SIZE) {
+        vecLockTimings.push_back(timing);
+    } else {
+        vecLockTimings[nLockTimingsPos] = timing;
+    }
+    nLockTimingsPos = (nLockTimingsPos + 1) % INSTANTSEND_LOCK_TIMINGS_SIZE;
+}
+
+std::vector<CTxLockTiming> CInstantSend::GetLockTimings()
+{
+    LOCK(cs_instantsend);
+
+    // the oldest entry is the one to be overwritten next once the buffer is full
+    std::vector<CTxLockTiming> vecResult;
+    vecResult.reserve(vecLockTimings.size());
+    if(vecLockTimings.size() == INSTANTSEND_LOCK_TIMINGS_SIZE) {
+        vecResult.insert(vecResult.end(), vecLockTimings.begin() + nLockTimingsPos, vecLockTimings.end());
+        vecResult.insert(vecResult.end(), vecLockTimings.begin(), vecLockTimings.begin() + nLockTimingsPos);
+    } else {
+        vecResult = vecLockTimings;
+    }
+    return vecResult;
+}
+
+void CInstantSend::GetUnconfirmedLockedTxns(std::vector<std::pair<uint256, CTransactionRef>>& vtxRet)
+{
+    LOCK(cs_instantsend);
+
+    vtxRet.clear();
+    vtxRet.reserve(mapLockRequestUnconfirmed.size());
+    for (const auto& pair : mapLockRequestUnconfirmed) {
+        vtxRet.emplace_back(pair.second->GetWitnessHash(), pair.second);
+    }
+}
+
+size_t CInstantSend::DynamicMemoryUsage()
+{
+    LOCK(cs_instantsend);
+
+    size_t nUsage = memusage::DynamicUsage(mapLockRequestAccepted) + memusage::DynamicUsage(mapLockRequestRejected);
+    for (const auto& pair : mapLockRequestAccepted) {
+        nUsage += RecursiveDynamicUsage(pair.second);
+    }
+    for (const auto& pair : mapLockRequestRejected) {
+        nUsage += RecursiveDynamicUsage(pair.second);
+    }
+    nUsage += memusage::DynamicUsage(mapTxLockVotes) + memusage::DynamicUsage(mapTxLockVotesOrphan);
+    for (const auto& pair : mapTxLockVotes) {
+        nUsage += pair.second.DynamicMemoryUsage();
+    }
+    for (const auto& pair : mapTxLockVotesOrphan) {
+        nUsage += pair.second.DynamicMemoryUsage();
+    }
+    // the transactions are shared with mapLockRequestAccepted and the mempool
+    nUsage += memusage::DynamicUsage(mapLockRequestUnconfirmed);
+    nUsage += memusage::DynamicUsage(mapTxLockCandidates);
+    for (const auto& pair : mapTxLockCandidates) {
+        nUsage += RecursiveDynamicUsage(pair.second.txLockRequest) + memusage::DynamicUsage(pair.second.mapOutPointLocks);
+        for (const auto& lock : pair.second.mapOutPointLocks) {
+            nUsage += lock.second.DynamicMemoryUsage();
+        }
+    }
+    nUsage += memusage::DynamicUsage(mapVotedOutpoints);
+    for (const auto& pair : mapVotedOutpoints) {
+        nUsage += memusage::DynamicUsage(pair.second);
+    }
+    nUsage += memusage::DynamicUsage(mapLockedOutpoints) + memusage::DynamicUsage(mapMasternodeOrphanVotes);
+    nUsage += memusage::DynamicUsage(setVoteFailTimes) + memusage::DynamicUsage(setOrphanVoteTimeouts) + memusage::DynamicUsage(setMasternodeOrphanTimes);
+    nUsage += memusage::DynamicUsage(setCandidateHeights) + memusage::DynamicUsage(setVoteHeights);
+    nUsage += memusage::DynamicUsage(vecLockTimings);
+    return nUsage;
+}
+// VELES END
+
 void CInstantSend::UpdateLockedTransaction(const CTxLockCandidate& txLockCandidate)
 {
     // cs_wallet and cs_instantsend should be already locked
@@ -516,6 +659,8 @@ void CInstantSend::UpdateLockedTransaction(const CTxLockCandidate& txLockCandida
 
     if(!IsLockedInstantSendTransaction(txHash)) return; // not a locked tx, do not update/notify
 
+    mempool.SetInstantSendLocked(txHash); // VELES
+
 #ifdef ENABLE_WALLET
     if(pwallet && pwallet->UpdatedTransaction(txHash)) {
         // bumping this to update UI
@@ -556,7 +701,8 @@ void CInstantSend::LockTransactionInputs(const CTxLockCandidate& txLockCandidate
 bool CInstantSend::GetLockedOutPointTxHash(const COutPoint& outpoint, uint256& hashRet)
 {
     LOCK(cs_instantsend);
-    std::map<COutPoint, uint256>::iterator it = mapLockedOutpoints.find(outpoint);
+    //std::map<COutPoint, uint256>::iterator it = mapLockedOutpoints.find(outpoint);
+    locked_outpoint_m_t::iterator it = mapLockedOutpoints.find(outpoint); // VELES
     if(it == mapLockedOutpoints.end()) return false;
     hashRet = it->second;
     return true;
@@ -578,8 +724,10 @@ bool CInstantSend::ResolveConflicts(const CTxLockCandidate& txLockCandidate)
         if(GetLockedOutPointTxHash(txin.prevout, hashConflicting) && txHash != hashConflicting) {
             // completed lock which conflicts with another completed one?
             // this means that majority of MNs in the quorum for this specific tx input are malicious!
-            std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
-            std::map<uint256, CTxLockCandidate>::iterator itLockCandidateConflicting = mapTxLockCandidates.find(hashConflicting);
+            //std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+            lock_candidate_m_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash); // VELES
+            //std::map<uint256, CTxLockCandidate>::iterator itLockCandidateConflicting = mapTxLockCandidates.find(hashConflicting);
+            lock_candidate_m_t::iterator itLockCandidateConflicting = mapTxLockCandidates.find(hashConflicting); // VELES
             if(itLockCandidate == mapTxLockCandidates.end() || itLockCandidateConflicting == mapTxLockCandidates.end()) {
                 // safety check, should never really happen
                 LogPrintf("CInstantSend::ResolveConflicts -- ERROR: Found conflicting completed Transaction Lock, but one of txLockCandidate-s is missing, txid=%s, conflicting txid=%s\n",
@@ -592,6 +740,10 @@ bool CInstantSend::ResolveConflicts(const CTxLockCandidate& txLockCandidate)
             CTxLockRequest txLockRequestConflicting = itLockCandidateConflicting->second.txLockRequest;
             itLockCandidate->second.SetConfirmedHeight(0); // expired
             itLockCandidateConflicting->second.SetConfirmedHeight(0); // expired
+            // VELES BEGIN
+            setCandidateHeights.insert(std::make_pair(0, txHash));
+            setCandidateHeights.insert(std::make_pair(0, hashConflicting));
+            // VELES END
             CheckAndRemove(); // clean up
             // AlreadyHave should still return "true" for both of them
             mapLockRequestRejected.insert(make_pair(txHash, txLockRequest));
@@ -627,6 +779,13 @@ bool CInstantSend::ResolveConflicts(const CTxLockCandidate& txLockCandidate)
         LogPrint(BCLog::INSTANTSEND, "CInstantSend::ResolveConflicts -- Done, %s is included in block %s\n", txHash.ToString(), hashBlock.ToString());
         return true;
     }
+    // VELES BEGIN
+    // Without the transaction index, as on pruned nodes, the unspent outputs tell that it was mined
+    if(!g_txindex && !AccessByTxid(*pcoinsTip, txHash).IsSpent()) {
+        LogPrint(BCLog::INSTANTSEND, "CInstantSend::ResolveConflicts -- Done, %s is included in a block\n", txHash.ToString());
+        return true;
+    }
+    // VELES END
     // Not in block yet, make sure all its inputs are still unspent
     for(const auto& txin : txLockCandidate.txLockRequest.vin) {
         Coin coin;
@@ -647,7 +806,8 @@ int64_t CInstantSend::GetAverageMasternodeOrphanVoteTime()
     // NOTE: should never actually call this function when mapMasternodeOrphanVotes is empty
     if(mapMasternodeOrphanVotes.empty()) return 0;
 
-    std::map<COutPoint, int64_t>::iterator it = mapMasternodeOrphanVotes.begin();
+    //std::map<COutPoint, int64_t>::iterator it = mapMasternodeOrphanVotes.begin();
+    mn_orphan_vote_m_t::iterator it = mapMasternodeOrphanVotes.begin(); // VELES
     int64_t total = 0;
 
     while(it != mapMasternodeOrphanVotes.end()) {
@@ -663,80 +823,218 @@ void CInstantSend::CheckAndRemove()
     if(!masternodeSync.IsMasternodeListSynced()) return;
 
     LOCK(cs_instantsend);
-
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.begin();
+//
+//    //std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.begin();
+//    lock_candidate_m_t::iterator itLockCandidate = mapTxLockCandidates.begin(); // VELES
+//
+//    // remove expired candidates
+//    while(itLockCandidate != mapTxLockCandidates.end()) {
+//        CTxLockCandidate &txLockCandidate = itLockCandidate->second;
+//        uint256 txHash = txLockCandidate.GetHash();
+//        if(txLockCandidate.IsExpired(nCachedBlockHeight)) {
+//            LogPrintf("CInstantSend::CheckAndRemove -- Removing expired Transaction Lock Candidate: txid=%s\n", txHash.ToString());
+//            std::map<COutPoint, COutPointLock>::iterator itOutpointLock = txLockCandidate.mapOutPointLocks.begin();
+//            while(itOutpointLock != txLockCandidate.mapOutPointLocks.end()) {
+//                mapLockedOutpoints.erase(itOutpointLock->first);
+//                mapVotedOutpoints.erase(itOutpointLock->first);
+//                ++itOutpointLock;
+//            }
+//            mapLockRequestAccepted.erase(txHash);
+//            mapLockRequestRejected.erase(txHash);
+//            mapTxLockCandidates.erase(itLockCandidate++);
+//        } else {
+//            ++itLockCandidate;
+//        }
+//    }
+//
+//    // remove expired votes
+//    //std::map<uint256, CTxLockVote>::iterator itVote = mapTxLockVotes.begin();
+//    lock_vote_m_t::iterator itVote = mapTxLockVotes.begin(); // VELES
+//    while(itVote != mapTxLockVotes.end()) {
+//        if(itVote->second.IsExpired(nCachedBlockHeight)) {
+//            LogPrint(BCLog::INSTANTSEND, "CInstantSend::CheckAndRemove -- Removing expired vote: txid=%s  masternode=%s\n",
+//                    itVote->second.GetTxHash().ToString(), itVote->second.GetMasternodeOutpoint().ToStringShort());
+//            mapTxLockVotes.erase(itVote++);
+//        } else {
+//            ++itVote;
+//        }
+//    }
+//
+//    // remove timed out orphan votes
+//    //std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.begin();
+//    lock_vote_m_t::iterator itOrphanVote = mapTxLockVotesOrphan.begin(); // VELES
+//    while(itOrphanVote != mapTxLockVotesOrphan.end()) {
+//        if(itOrphanVote->second.IsTimedOut()) {
+//            LogPrint(BCLog::INSTANTSEND, "CInstantSend::CheckAndRemove -- Removing timed out orphan vote: txid=%s  masternode=%s\n",
+//                    itOrphanVote->second.GetTxHash().ToString(), itOrphanVote->second.GetMasternodeOutpoint().ToStringShort());
+//            mapTxLockVotes.erase(itOrphanVote->first);
+//            mapTxLockVotesOrphan.erase(itOrphanVote++);
+//        } else {
+//            ++itOrphanVote;
+//        }
+//    }
+//
+//    // remove invalid votes and votes for failed lock attempts
+//    itVote = mapTxLockVotes.begin();
+//    while(itVote != mapTxLockVotes.end()) {
+//        if(itVote->second.IsFailed()) {
+//            LogPrint(BCLog::INSTANTSEND, "CInstantSend::CheckAndRemove -- Removing vote for failed lock attempt: txid=%s  masternode=%s\n",
+//                    itVote->second.GetTxHash().ToString(), itVote->second.GetMasternodeOutpoint().ToStringShort());
+//            mapTxLockVotes.erase(itVote++);
+//        } else {
+//            ++itVote;
+//        }
+//    }
+//
+//    // remove timed out masternode orphan votes (DOS protection)
+//    //std::map<COutPoint, int64_t>::iterator itMasternodeOrphan = mapMasternodeOrphanVotes.begin();
+//    mn_orphan_vote_m_t::iterator itMasternodeOrphan = mapMasternodeOrphanVotes.begin(); // VELES
+//    while(itMasternodeOrphan != mapMasternodeOrphanVotes.end()) {
+//        if(itMasternodeOrphan->second < GetTime()) {
+//            LogPrint(BCLog::INSTANTSEND, "CInstantSend::CheckAndRemove -- Removing timed out orphan masternode vote: masternode=%s\n",
+//                    itMasternodeOrphan->first.ToStringShort());
+//            mapMasternodeOrphanVotes.erase(itMasternodeOrphan++);
+//        } else {
+//            ++itMasternodeOrphan;
+//        }
+//    }
+    // VELES BEGIN
+    int64_t nNow = GetTime();
+    int nExpiredHeight = nCachedBlockHeight - Params().GetConsensus().nInstantSendKeepLock;
 
     // remove expired candidates
-    while(itLockCandidate != mapTxLockCandidates.end()) {
+    while(!setCandidateHeights.empty() && setCandidateHeights.begin()->first < nExpiredHeight) {
+        uint256 txHash = setCandidateHeights.begin()->second;
+        setCandidateHeights.erase(setCandidateHeights.begin());
+        lock_candidate_m_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+        // the transaction may have been reorganized out or confirmed again since
+        if(itLockCandidate == mapTxLockCandidates.end() || !itLockCandidate->second.IsExpired(nCachedBlockHeight)) {
+            continue;
+        }
         CTxLockCandidate &txLockCandidate = itLockCandidate->second;
-        uint256 txHash = txLockCandidate.GetHash();
-        if(txLockCandidate.IsExpired(nCachedBlockHeight)) {
-            LogPrintf("CInstantSend::CheckAndRemove -- Removing expired Transaction Lock Candidate: txid=%s\n", txHash.ToString());
-            std::map<COutPoint, COutPointLock>::iterator itOutpointLock = txLockCandidate.mapOutPointLocks.begin();
-            while(itOutpointLock != txLockCandidate.mapOutPointLocks.end()) {
-                mapLockedOutpoints.erase(itOutpointLock->first);
-                mapVotedOutpoints.erase(itOutpointLock->first);
-                ++itOutpointLock;
-            }
-            mapLockRequestAccepted.erase(txHash);
-            mapLockRequestRejected.erase(txHash);
-            mapTxLockCandidates.erase(itLockCandidate++);
-        } else {
-            ++itLockCandidate;
+        LogPrintf("CInstantSend::CheckAndRemove -- Removing expired Transaction Lock Candidate: txid=%s\n", txHash.ToString());
+        std::map<COutPoint, COutPointLock>::iterator itOutpointLock = txLockCandidate.mapOutPointLocks.begin();
+        while(itOutpointLock != txLockCandidate.mapOutPointLocks.end()) {
+            mapLockedOutpoints.erase(itOutpointLock->first);
+            mapVotedOutpoints.erase(itOutpointLock->first);
+            ++itOutpointLock;
         }
+        mapLockRequestAccepted.erase(txHash);
+        mapLockRequestUnconfirmed.erase(txHash);
+        mapLockRequestRejected.erase(txHash);
+        mapTxLockCandidates.erase(itLockCandidate);
+        mempool.UnsetInstantSendLocked(txHash);
     }
 
     // remove expired votes
-    std::map<uint256, CTxLockVote>::iterator itVote = mapTxLockVotes.begin();
-    while(itVote != mapTxLockVotes.end()) {
-        if(itVote->second.IsExpired(nCachedBlockHeight)) {
+    while(!setVoteHeights.empty() && setVoteHeights.begin()->first < nExpiredHeight) {
+        uint256 nVoteHash = setVoteHeights.begin()->second;
+        setVoteHeights.erase(setVoteHeights.begin());
+        lock_vote_m_t::iterator itVote = mapTxLockVotes.find(nVoteHash);
+        if(itVote != mapTxLockVotes.end() && itVote->second.IsExpired(nCachedBlockHeight)) {
             LogPrint(BCLog::INSTANTSEND, "CInstantSend::CheckAndRemove -- Removing expired vote: txid=%s  masternode=%s\n",
                     itVote->second.GetTxHash().ToString(), itVote->second.GetMasternodeOutpoint().ToStringShort());
-            mapTxLockVotes.erase(itVote++);
-        } else {
-            ++itVote;
+            mapTxLockVotes.erase(itVote);
         }
     }
 
     // remove timed out orphan votes
-    std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.begin();
-    while(itOrphanVote != mapTxLockVotesOrphan.end()) {
-        if(itOrphanVote->second.IsTimedOut()) {
+    while(!setOrphanVoteTimeouts.empty() && setOrphanVoteTimeouts.begin()->first < nNow) {
+        uint256 nVoteHash = setOrphanVoteTimeouts.begin()->second;
+        setOrphanVoteTimeouts.erase(setOrphanVoteTimeouts.begin());
+        lock_vote_m_t::iterator itOrphanVote = mapTxLockVotesOrphan.find(nVoteHash);
+        if(itOrphanVote != mapTxLockVotesOrphan.end() && itOrphanVote->second.IsTimedOut()) {
             LogPrint(BCLog::INSTANTSEND, "CInstantSend::CheckAndRemove -- Removing timed out orphan vote: txid=%s  masternode=%s\n",
                     itOrphanVote->second.GetTxHash().ToString(), itOrphanVote->second.GetMasternodeOutpoint().ToStringShort());
             mapTxLockVotes.erase(itOrphanVote->first);
-            mapTxLockVotesOrphan.erase(itOrphanVote++);
-        } else {
-            ++itOrphanVote;
+            mapTxLockVotesOrphan.erase(itOrphanVote);
         }
     }
 
     // remove invalid votes and votes for failed lock attempts
-    itVote = mapTxLockVotes.begin();
-    while(itVote != mapTxLockVotes.end()) {
+    std::vector<uint256> vecLockedVotes;
+    while(!setVoteFailTimes.empty() && setVoteFailTimes.begin()->first < nNow) {
+        uint256 nVoteHash = setVoteFailTimes.begin()->second;
+        setVoteFailTimes.erase(setVoteFailTimes.begin());
+        lock_vote_m_t::iterator itVote = mapTxLockVotes.find(nVoteHash);
+        if(itVote == mapTxLockVotes.end()) {
+            continue;
+        }
         if(itVote->second.IsFailed()) {
             LogPrint(BCLog::INSTANTSEND, "CInstantSend::CheckAndRemove -- Removing vote for failed lock attempt: txid=%s  masternode=%s\n",
                     itVote->second.GetTxHash().ToString(), itVote->second.GetMasternodeOutpoint().ToStringShort());
-            mapTxLockVotes.erase(itVote++);
+            mapTxLockVotes.erase(itVote);
         } else {
-            ++itVote;
+            // the transaction is locked, the vote fails only if the lock goes away
+            vecLockedVotes.push_back(nVoteHash);
         }
     }
+    for (const auto& nVoteHash : vecLockedVotes) {
+        setVoteFailTimes.insert(std::make_pair(nNow + INSTANTSEND_FAILED_TIMEOUT_SECONDS, nVoteHash));
+    }
 
     // remove timed out masternode orphan votes (DOS protection)
-    std::map<COutPoint, int64_t>::iterator itMasternodeOrphan = mapMasternodeOrphanVotes.begin();
-    while(itMasternodeOrphan != mapMasternodeOrphanVotes.end()) {
-        if(itMasternodeOrphan->second < GetTime()) {
+    while(!setMasternodeOrphanTimes.empty() && setMasternodeOrphanTimes.begin()->first < nNow) {
+        COutPoint outpointMasternode = setMasternodeOrphanTimes.begin()->second;
+        setMasternodeOrphanTimes.erase(setMasternodeOrphanTimes.begin());
+        mn_orphan_vote_m_t::iterator itMasternodeOrphan = mapMasternodeOrphanVotes.find(outpointMasternode);
+        // refreshed entries were queued again with their new time
+        if(itMasternodeOrphan != mapMasternodeOrphanVotes.end() && itMasternodeOrphan->second < nNow) {
             LogPrint(BCLog::INSTANTSEND, "CInstantSend::CheckAndRemove -- Removing timed out orphan masternode vote: masternode=%s\n",
                     itMasternodeOrphan->first.ToStringShort());
-            mapMasternodeOrphanVotes.erase(itMasternodeOrphan++);
-        } else {
-            ++itMasternodeOrphan;
+            mapMasternodeOrphanVotes.erase(itMasternodeOrphan);
         }
     }
+    // VELES END
     LogPrintf("CInstantSend::CheckAndRemove -- %s\n", ToString());
 }
 
+// VELES BEGIN
+void CInstantSend::AddTxLockVote(const uint256& nVoteHash, const CTxLockVote& vote)
+{
+    AssertLockHeld(cs_instantsend);
+    mapTxLockVotes.insert(std::make_pair(nVoteHash, vote));
+    setVoteFailTimes.insert(std::make_pair(vote.GetTimeCreated() + INSTANTSEND_FAILED_TIMEOUT_SECONDS, nVoteHash));
+}
+
+void CInstantSend::SetMasternodeOrphanVoteTime(const COutPoint& outpointMasternode, int64_t nExpireTime)
+{
+    AssertLockHeld(cs_instantsend);
+    mapMasternodeOrphanVotes[outpointMasternode] = nExpireTime;
+    setMasternodeOrphanTimes.insert(std::make_pair(nExpireTime, outpointMasternode));
+}
+
+void CInstantSend::LimitOrphanVotes()
+{
+    AssertLockHeld(cs_instantsend);
+    if(nMaxOrphanVoteUsage == 0) return;
+
+    // An orphan vote is kept in both vote maps and its timeout in setOrphanVoteTimeouts,
+    // the votes are evicted in the order they time out
+    static const size_t nVoteUsage = 2 * memusage::MallocUsage(sizeof(memusage::unordered_node<lock_vote_m_t::value_type>)) +
+            memusage::MallocUsage(sizeof(memusage::stl_tree_node<time_hash_s_t::value_type>)) +
+            2 * memusage::MallocUsage(CPubKey::COMPACT_SIGNATURE_SIZE);
+    while(!setOrphanVoteTimeouts.empty() && mapTxLockVotesOrphan.size() * nVoteUsage > nMaxOrphanVoteUsage) {
+        uint256 nVoteHash = setOrphanVoteTimeouts.begin()->second;
+        setOrphanVoteTimeouts.erase(setOrphanVoteTimeouts.begin());
+        lock_vote_m_t::iterator itOrphanVote = mapTxLockVotesOrphan.find(nVoteHash);
+        if(itOrphanVote != mapTxLockVotesOrphan.end()) {
+            LogPrint(BCLog::INSTANTSEND, "CInstantSend::LimitOrphanVotes -- Evicting orphan vote: txid=%s  masternode=%s\n",
+                    itOrphanVote->second.GetTxHash().ToString(), itOrphanVote->second.GetMasternodeOutpoint().ToStringShort());
+            mapTxLockVotes.erase(itOrphanVote->first);
+            mapTxLockVotesOrphan.erase(itOrphanVote);
+        }
+    }
+}
+
+void CInstantSend::SetMaxOrphanVoteUsage(size_t nMaxOrphanVoteUsageIn)
+{
+    LOCK(cs_instantsend);
+    nMaxOrphanVoteUsage = nMaxOrphanVoteUsageIn;
+    LimitOrphanVotes();
+}
+// VELES END
+
 bool CInstantSend::AlreadyHave(const uint256& hash)
 {
     LOCK(cs_instantsend);
@@ -748,7 +1046,12 @@ bool CInstantSend::AlreadyHave(const uint256& hash)
 void CInstantSend::AcceptLockRequest(const CTxLockRequest& txLockRequest)
 {
     LOCK(cs_instantsend);
-    mapLockRequestAccepted.insert(make_pair(txLockRequest.GetHash(), txLockRequest));
+    //mapLockRequestAccepted.insert(make_pair(txLockRequest.GetHash(), txLockRequest));
+    // VELES BEGIN
+    if(mapLockRequestAccepted.insert(make_pair(txLockRequest.GetHash(), txLockRequest)).second) {
+        mapLockRequestUnconfirmed.insert(make_pair(txLockRequest.GetHash(), MakeTransactionRef(CTransaction(txLockRequest))));
+    }
+    // VELES END
 }
 
 void CInstantSend::RejectLockRequest(const CTxLockRequest& txLockRequest)
@@ -767,7 +1070,8 @@ bool CInstantSend::GetTxLockRequest(const uint256& txHash, CTxLockRequest& txLoc
 {
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    //std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    lock_candidate_m_t::iterator it = mapTxLockCandidates.find(txHash); // VELES
     if(it == mapTxLockCandidates.end()) return false;
     txLockRequestRet = it->second.txLockRequest;
 
@@ -778,7 +1082,8 @@ bool CInstantSend::GetTxLockVote(const uint256& hash, CTxLockVote& txLockVoteRet
 {
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotes.find(hash);
+    //std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotes.find(hash);
+    lock_vote_m_t::iterator it = mapTxLockVotes.find(hash); // VELES
     if(it == mapTxLockVotes.end()) return false;
     txLockVoteRet = it->second;
 
@@ -793,7 +1098,8 @@ bool CInstantSend::IsInstantSendReadyToLock(const uint256& txHash)
     LOCK(cs_instantsend);
     // There must be a successfully verified lock request
     // and all outputs must be locked (i.e. have enough signatures)
-    std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    //std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    lock_candidate_m_t::iterator it = mapTxLockCandidates.find(txHash); // VELES
     return it != mapTxLockCandidates.end() && it->second.IsAllOutPointsReady();
 }
 
@@ -805,7 +1111,8 @@ bool CInstantSend::IsLockedInstantSendTransaction(const uint256& txHash)
     LOCK(cs_instantsend);
 
     // there must be a lock candidate
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    //std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    lock_candidate_m_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash); // VELES
     if(itLockCandidate == mapTxLockCandidates.end()) return false;
 
     // which should have outpoints
@@ -830,7 +1137,8 @@ int CInstantSend::GetTransactionLockSignatures(const uint256& txHash)
 
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    //std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    lock_candidate_m_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash); // VELES
     if(itLockCandidate != mapTxLockCandidates.end()) {
         return itLockCandidate->second.CountVotes();
     }
@@ -849,7 +1157,8 @@ bool CInstantSend::IsTxLockCandidateTimedOut(const uint256& txHash)
 
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    //std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    lock_candidate_m_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash); // VELES
     if (itLockCandidate != mapTxLockCandidates.end()) {
         return !itLockCandidate->second.IsAllOutPointsReady() &&
                 itLockCandidate->second.IsTimedOut();
@@ -862,7 +1171,8 @@ void CInstantSend::Relay(const uint256& txHash, CConnman& connman)
 {
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::const_iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    //std::map<uint256, CTxLockCandidate>::const_iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    lock_candidate_m_t::const_iterator itLockCandidate = mapTxLockCandidates.find(txHash); // VELES
     if (itLockCandidate != mapTxLockCandidates.end()) {
         itLockCandidate->second.Relay(connman);
     }
@@ -900,19 +1210,34 @@ void CInstantSend::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
 
     LogPrint(BCLog::INSTANTSEND, "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d\n", txHash.ToString(), nHeightNew);
 
+    // VELES BEGIN
+    if(nHeightNew != -1) {
+        mapLockRequestUnconfirmed.erase(txHash);
+    } else if(mapLockRequestAccepted.count(txHash)) {
+        mapLockRequestUnconfirmed.insert(make_pair(txHash, MakeTransactionRef(tx)));
+    }
+    // VELES END
+
     // Check lock candidates
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    //std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    lock_candidate_m_t::iterator itLockCandidate = mapTxLockCandidates.find(txHash); // VELES
     if(itLockCandidate != mapTxLockCandidates.end()) {
         LogPrint(BCLog::INSTANTSEND, "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d lock candidate updated\n",
                 txHash.ToString(), nHeightNew);
         itLockCandidate->second.SetConfirmedHeight(nHeightNew);
+        // VELES BEGIN
+        if(nHeightNew != -1) {
+            setCandidateHeights.insert(std::make_pair(nHeightNew, txHash));
+        }
+        // VELES END
         // Loop through outpoint locks
         std::map<COutPoint, COutPointLock>::iterator itOutpointLock = itLockCandidate->second.mapOutPointLocks.begin();
         while(itOutpointLock != itLockCandidate->second.mapOutPointLocks.end()) {
             // Check corresponding lock votes
             std::vector<CTxLockVote> vVotes = itOutpointLock->second.GetVotes();
             std::vector<CTxLockVote>::iterator itVote = vVotes.begin();
-            std::map<uint256, CTxLockVote>::iterator it;
+            //std::map<uint256, CTxLockVote>::iterator it;
+            lock_vote_m_t::iterator it; // VELES
             while(itVote != vVotes.end()) {
                 uint256 nVoteHash = itVote->GetHash();
                 LogPrint(BCLog::INSTANTSEND, "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d vote %s updated\n",
@@ -920,6 +1245,11 @@ void CInstantSend::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
                 it = mapTxLockVotes.find(nVoteHash);
                 if(it != mapTxLockVotes.end()) {
                     it->second.SetConfirmedHeight(nHeightNew);
+                    // VELES BEGIN
+                    if(nHeightNew != -1) {
+                        setVoteHeights.insert(std::make_pair(nHeightNew, nVoteHash));
+                    }
+                    // VELES END
                 }
                 ++itVote;
             }
@@ -928,12 +1258,21 @@ void CInstantSend::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
     }
 
     // check orphan votes
-    std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.begin();
+    //std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.begin();
+    lock_vote_m_t::iterator itOrphanVote = mapTxLockVotesOrphan.begin(); // VELES
     while(itOrphanVote != mapTxLockVotesOrphan.end()) {
         if(itOrphanVote->second.GetTxHash() == txHash) {
             LogPrint(BCLog::INSTANTSEND, "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d vote %s updated\n",
                     txHash.ToString(), nHeightNew, itOrphanVote->first.ToString());
-            mapTxLockVotes[itOrphanVote->first].SetConfirmedHeight(nHeightNew);
+            //mapTxLockVotes[itOrphanVote->first].SetConfirmedHeight(nHeightNew);
+            // VELES BEGIN
+            CTxLockVote& vote = mapTxLockVotes[itOrphanVote->first];
+            vote.SetConfirmedHeight(nHeightNew);
+            setVoteFailTimes.insert(std::make_pair(vote.GetTimeCreated() + INSTANTSEND_FAILED_TIMEOUT_SECONDS, itOrphanVote->first));
+            if(nHeightNew != -1) {
+                setVoteHeights.insert(std::make_pair(nHeightNew, itOrphanVote->first));
+            }
+            // VELES END
         }
         ++itOrphanVote;
     }
@@ -1077,16 +1416,26 @@ bool CTxLockVote::CheckSignature() const
         return false;
     }
 
+    // VELES BEGIN
+    // orphan votes are checked again once their lock request arrives
+    if(pubKeySignatureChecked.IsValid() && pubKeySignatureChecked == infoMn.pubKeyMasternode) {
+        return true;
+    }
+    // VELES END
+
     if(!CMessageSigner::VerifyMessage(infoMn.pubKeyMasternode, vchMasternodeSignature, strMessage, strError)) {
         LogPrintf("CTxLockVote::CheckSignature -- VerifyMessage() failed, error: %s\n", strError);
         return false;
     }
 
+    pubKeySignatureChecked = infoMn.pubKeyMasternode; // VELES
+
     return true;
 }
 
 bool CTxLockVote::Sign()
 {
+    pubKeySignatureChecked = CPubKey(); // VELES
     std::string strError;
     std::string strMessage = txHash.ToString() + outpoint.ToStringShort();
 
@@ -1106,9 +1455,22 @@ bool CTxLockVote::Sign()
 void CTxLockVote::Relay(CConnman& connman) const
 {
     CInv inv(MSG_TXLOCK_VOTE, GetHash());
-    connman.RelayInv(inv);
+    //connman.RelayInv(inv);
+    // VELES BEGIN
+    CScratchDataStream ss(SER_NETWORK, PROTOCOL_VERSION); // VELES
+    ss.reserve(1000);
+    ss << *this;
+    connman.RelayInv(inv, ss);
+    // VELES END
 }
 
+// VELES BEGIN
+size_t CTxLockVote::DynamicMemoryUsage() const
+{
+    return memusage::DynamicUsage(vchMasternodeSignature);
+}
+// VELES END
+
 bool CTxLockVote::IsExpired(int nHeight) const
 {
     // Locks and votes expire nInstantSendKeepLock blocks after the block corresponding tx was included into.
@@ -1162,6 +1524,17 @@ void COutPointLock::Relay(CConnman& connman) const
     }
 }
 
+// VELES BEGIN
+size_t COutPointLock::DynamicMemoryUsage() const
+{
+    size_t nUsage = memusage::DynamicUsage(mapMasternodeVotes);
+    for (const auto& pair : mapMasternodeVotes) {
+        nUsage += pair.second.DynamicMemoryUsage();
+    }
+    return nUsage;
+}
+// VELES END
+
 //
 // CTxLockCandidate
 //
@@ -9,6 +9,14 @@
 #include <chain.h>
 #include <net.h>
 #include <primitives/transaction.h>
+// VELES BEGIN
+#include <coins.h>
+#include <pubkey.h>
+#include <txmempool.h>
+
+#include <set>
+#include <unordered_map>
+// VELES END
 
 class CTxLockVote;
 class COutPointLock;
@@ -38,6 +46,21 @@ static const int INSTANTSEND_LOCK_TIMEOUT_SECONDS   = 15;
 // For how long we are going to keep invalid votes and votes for failed lock attempts,
 // must be greater than INSTANTSEND_LOCK_TIMEOUT_SECONDS
 static const int INSTANTSEND_FAILED_TIMEOUT_SECONDS = 60;
+// VELES BEGIN
+// How many completed locks we keep the timings of
+static const size_t INSTANTSEND_LOCK_TIMINGS_SIZE   = 1000;
+
+/** Timings of a completed transaction lock, delays are in microseconds since the lock request was received */
+struct CTxLockTiming
+{
+    uint256 txHash;
+    int64_t nTimeRequest;
+    int64_t nFirstVoteDelay; // negative when votes arrived before the lock request
+    int64_t nLockDelay;
+    int nVotes;
+    int nOrphanVotes;
+};
+// VELES END
 
 extern bool fEnableInstantSend;
 extern int nInstantSendDepth;
@@ -49,19 +72,76 @@ private:
     // Keep track of current block height
     int nCachedBlockHeight;
 
-    // maps for AlreadyHave
-    std::map<uint256, CTxLockRequest> mapLockRequestAccepted; // tx hash - tx
-    std::map<uint256, CTxLockRequest> mapLockRequestRejected; // tx hash - tx
-    std::map<uint256, CTxLockVote> mapTxLockVotes; // vote hash - vote
-    std::map<uint256, CTxLockVote> mapTxLockVotesOrphan; // vote hash - vote
+    // VELES BEGIN
+    typedef std::unordered_map<uint256, CTxLockRequest, SaltedTxidHasher> lock_request_m_t;
+    typedef std::unordered_map<uint256, CTxLockVote, SaltedTxidHasher> lock_vote_m_t;
+    typedef std::unordered_map<uint256, CTxLockCandidate, SaltedTxidHasher> lock_candidate_m_t;
+    typedef std::unordered_map<COutPoint, std::set<uint256>, SaltedOutpointHasher> voted_outpoint_m_t;
+    typedef std::unordered_map<COutPoint, uint256, SaltedOutpointHasher> locked_outpoint_m_t;
+    typedef std::unordered_map<COutPoint, int64_t, SaltedOutpointHasher> mn_orphan_vote_m_t;
+    typedef std::unordered_map<uint256, CTransactionRef, SaltedTxidHasher> lock_txref_m_t;
 
-    std::map<uint256, CTxLockCandidate> mapTxLockCandidates; // tx hash - lock candidate
+    typedef std::set<std::pair<int64_t, uint256> > time_hash_s_t;
+    typedef std::set<std::pair<int, uint256> > height_hash_s_t;
+    // VELES END
 
-    std::map<COutPoint, std::set<uint256> > mapVotedOutpoints; // utxo - tx hash set
-    std::map<COutPoint, uint256> mapLockedOutpoints; // utxo - tx hash
+    // maps for AlreadyHave
+    //std::map<uint256, CTxLockRequest> mapLockRequestAccepted; // tx hash - tx
+    //std::map<uint256, CTxLockRequest> mapLockRequestRejected; // tx hash - tx
+    //std::map<uint256, CTxLockVote> mapTxLockVotes; // vote hash - vote
+    //std::map<uint256, CTxLockVote> mapTxLockVotesOrphan; // vote hash - vote
+    // VELES BEGIN
+    lock_request_m_t mapLockRequestAccepted; // tx hash - tx
+    lock_request_m_t mapLockRequestRejected; // tx hash - tx
+    lock_vote_m_t mapTxLockVotes; // vote hash - vote
+    lock_vote_m_t mapTxLockVotesOrphan; // vote hash - vote
+    // VELES END
+
+    // VELES BEGIN
+    // accepted lock requests not mined yet, shared with compact block reconstruction
+    lock_txref_m_t mapLockRequestUnconfirmed; // tx hash - tx
+    // VELES END
+
+    //std::map<uint256, CTxLockCandidate> mapTxLockCandidates; // tx hash - lock candidate
+    lock_candidate_m_t mapTxLockCandidates; // tx hash - lock candidate // VELES
+
+    //std::map<COutPoint, std::set<uint256> > mapVotedOutpoints; // utxo - tx hash set
+    //std::map<COutPoint, uint256> mapLockedOutpoints; // utxo - tx hash
+    // VELES BEGIN
+    voted_outpoint_m_t mapVotedOutpoints; // utxo - tx hash set
+    locked_outpoint_m_t mapLockedOutpoints; // utxo - tx hash
+    // VELES END
 
     //track masternodes who voted with no txreq (for DOS protection)
-    std::map<COutPoint, int64_t> mapMasternodeOrphanVotes; // mn outpoint - time
+    //std::map<COutPoint, int64_t> mapMasternodeOrphanVotes; // mn outpoint - time
+    mn_orphan_vote_m_t mapMasternodeOrphanVotes; // mn outpoint - time // VELES
+
+    // VELES BEGIN
+    // expiry queues, CheckAndRemove only looks at the entries that are due
+    time_hash_s_t setVoteFailTimes; // time to check for a failed lock attempt - vote hash
+    time_hash_s_t setOrphanVoteTimeouts; // time out - orphan vote hash
+    std::set<std::pair<int64_t, COutPoint> > setMasternodeOrphanTimes; // expiration time - mn outpoint
+    height_hash_s_t setCandidateHeights; // confirmed height - tx hash
+    height_hash_s_t setVoteHeights; // confirmed height - vote hash
+    // VELES END
+
+    // VELES BEGIN
+    // ring buffer of the timings of the last completed locks
+    std::vector<CTxLockTiming> vecLockTimings;
+    size_t nLockTimingsPos{0};
+    // VELES END
+
+    // VELES BEGIN
+    // memory the orphan votes may use before the oldest ones are evicted, 0 for no limit
+    size_t nMaxOrphanVoteUsage{0};
+    // VELES END
+
+    // VELES BEGIN
+    void AddTxLockVote(const uint256& nVoteHash, const CTxLockVote& vote);
+    void SetMasternodeOrphanVoteTime(const COutPoint& outpointMasternode, int64_t nExpireTime);
+    void RecordLockTiming(const CTxLockCandidate& txLockCandidate);
+    void LimitOrphanVotes();
+    // VELES END
 
     bool CreateTxLockCandidate(const CTxLockRequest& txLockRequest);
     void CreateEmptyTxLockCandidate(const uint256& txHash);
@@ -113,6 +193,16 @@ public:
     // verify if transaction lock timed out
     bool IsTxLockCandidateTimedOut(const uint256& txHash);
 
+    // VELES BEGIN
+    // timings of the last completed locks, oldest first
+    std::vector<CTxLockTiming> GetLockTimings();
+    // accepted lock requests not mined yet, in <witness hash, reference> form
+    void GetUnconfirmedLockedTxns(std::vector<std::pair<uint256, CTransactionRef>>& vtxRet);
+    // memory used by the lock requests, the lock candidates and the votes
+    size_t DynamicMemoryUsage();
+    void SetMaxOrphanVoteUsage(size_t nMaxOrphanVoteUsageIn);
+    // VELES END
+
     void Relay(const uint256& txHash, CConnman& connman);
 
     void UpdatedBlockTip(const CBlockIndex *pindex);
@@ -152,6 +242,10 @@ private:
     // local memory only
     int nConfirmedHeight; // when corresponding tx is 0-confirmed or conflicted, nConfirmedHeight is -1
     int64_t nTimeCreated;
+    // VELES BEGIN
+    // memory only, the masternode key vchMasternodeSignature was already verified against
+    mutable CPubKey pubKeySignatureChecked;
+    // VELES END
 
 public:
     CTxLockVote() :
@@ -187,6 +281,7 @@ public:
     uint256 GetTxHash() const { return txHash; }
     COutPoint GetOutpoint() const { return outpoint; }
     COutPoint GetMasternodeOutpoint() const { return outpointMasternode; }
+    int64_t GetTimeCreated() const { return nTimeCreated; } // VELES
 
     bool IsValid(CNode* pnode, CConnman& connman) const;
     void SetConfirmedHeight(int nConfirmedHeightIn) { nConfirmedHeight = nConfirmedHeightIn; }
@@ -198,6 +293,8 @@ public:
     bool CheckSignature() const;
 
     void Relay(CConnman& connman) const;
+
+    size_t DynamicMemoryUsage() const; // VELES
 };
 
 class COutPointLock
@@ -226,6 +323,8 @@ public:
     void MarkAsAttacked() { fAttacked = true; }
 
     void Relay(CConnman& connman) const;
+
+    size_t DynamicMemoryUsage() const; // VELES
 };
 
 class CTxLockCandidate
@@ -239,12 +338,26 @@ public:
         nConfirmedHeight(-1),
         nTimeCreated(GetTime()),
         txLockRequest(txLockRequestIn),
-        mapOutPointLocks()
+        mapOutPointLocks(),
+        // VELES BEGIN
+        nTimeRequestReceived(txLockRequestIn ? GetTimeMicros() : 0),
+        nTimeFirstVote(0),
+        nVotesReceived(0),
+        nOrphanVotesReceived(0)
+        // VELES END
         {}
 
     CTxLockRequest txLockRequest;
     std::map<COutPoint, COutPointLock> mapOutPointLocks;
 
+    // VELES BEGIN
+    // lock latency instrumentation, times are in microseconds, 0 when not seen yet
+    int64_t nTimeRequestReceived;
+    int64_t nTimeFirstVote;
+    int nVotesReceived;
+    int nOrphanVotesReceived;
+    // VELES END
+
     uint256 GetHash() const { return txLockRequest.GetHash(); }
 
     void AddOutPointLock(const COutPoint& outpoint);
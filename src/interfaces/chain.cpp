@@ -6,6 +6,7 @@
 
 #include <chain.h>
 #include <chainparams.h>
+#include <index/blockfilterindex.h> // VELES
 #include <primitives/block.h>
 #include <sync.h>
 #include <txmempool.h>
@@ -178,6 +179,26 @@ public:
         LOCK(cs_main);
         return GuessVerificationProgress(Params().TxData(), LookupBlockIndex(block_hash));
     }
+    // VELES BEGIN
+    bool hasBlockFilterIndex(BlockFilterType filter_type) override
+    {
+        return GetBlockFilterIndex(filter_type) != nullptr;
+    }
+    Optional<bool> blockFilterMatchesAny(BlockFilterType filter_type, const uint256& block_hash, const GCSFilter::ElementSet& filter_set) override
+    {
+        const BlockFilterIndex* block_filter_index = GetBlockFilterIndex(filter_type);
+        if (!block_filter_index) return nullopt;
+
+        const CBlockIndex* index;
+        {
+            LOCK(cs_main);
+            index = LookupBlockIndex(block_hash);
+        }
+        BlockFilter filter;
+        if (!index || !block_filter_index->LookupFilter(index, filter)) return nullopt;
+        return filter.GetFilter().MatchAny(filter_set);
+    }
+    // VELES END
     void requestMempoolTransactions(std::function<void(const CTransactionRef&)> fn) override
     {
         LOCK2(::cs_main, ::mempool.cs);
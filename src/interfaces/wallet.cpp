@@ -331,6 +331,18 @@ public:
         }
         return result;
     }
+    // VELES BEGIN
+    std::vector<WalletTx> getWalletTxs(const uint256& after_txid, size_t max_count) override
+    {
+        auto locked_chain = m_wallet->chain().lock();
+        LOCK(m_wallet->cs_wallet);
+        std::vector<WalletTx> result;
+        for (auto it = m_wallet->mapWallet.upper_bound(after_txid); it != m_wallet->mapWallet.end() && result.size() < max_count; ++it) {
+            result.emplace_back(MakeWalletTx(*locked_chain, *m_wallet, it->second));
+        }
+        return result;
+    }
+    // VELES END
     bool tryGetTxStatus(const uint256& txid,
         interfaces::WalletTxStatus& tx_status,
         int& num_blocks,
@@ -215,6 +215,11 @@ public:
     //! Get list of all wallet transactions.
     virtual std::vector<WalletTx> getWalletTxs() = 0;
 
+    // VELES BEGIN
+    //! Get up to max_count wallet transactions following txid, in txid order.
+    virtual std::vector<WalletTx> getWalletTxs(const uint256& after_txid, size_t max_count) = 0;
+    // VELES END
+
     //! Try to get updated status for a particular transaction, if possible without blocking.
     virtual bool tryGetTxStatus(const uint256& txid,
         WalletTxStatus& tx_status,
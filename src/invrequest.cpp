@@ -0,0 +1,104 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <invrequest.h>
+
+#include <algorithm>
+
+int64_t CInvRequestTimes::Schedule(const uint256& hash, int64_t nNow)
+{
+    LOCK(cs);
+    auto it = mapRequestTimes.find(hash);
+    if (it != mapRequestTimes.end()) {
+        it->second = std::max(it->second + INV_REQUEST_RETRY_INTERVAL, nNow);
+        return it->second;
+    }
+
+    if (mapRequestTimes.size() >= nMaxSize && nNow >= nNextPrune) {
+        // Entries whose retry time passed schedule exactly like unknown ones
+        for (auto itPrune = mapRequestTimes.begin(); itPrune != mapRequestTimes.end(); ) {
+            if (itPrune->second + INV_REQUEST_RETRY_INTERVAL <= nNow)
+                itPrune = mapRequestTimes.erase(itPrune);
+            else
+                ++itPrune;
+        }
+        nNextPrune = nNow + INV_REQUEST_RETRY_INTERVAL;
+    }
+    if (mapRequestTimes.size() < nMaxSize)
+        mapRequestTimes.emplace(hash, nNow);
+    return nNow;
+}
+
+void CInvRequestTimes::Erase(const uint256& hash)
+{
+    LOCK(cs);
+    mapRequestTimes.erase(hash);
+}
+
+bool CInvRequestTracker::Add(const CInv& inv, int64_t nRequestTime)
+{
+    LOCK(cs);
+    if (!mapEntries.emplace(inv.hash, Entry{++nSequence, false}).second)
+        return false;
+    queuePending.push(Scheduled{nRequestTime, nSequence, inv});
+    return true;
+}
+
+void CInvRequestTracker::Remove(const uint256& hash)
+{
+    LOCK(cs);
+    auto it = mapEntries.find(hash);
+    if (it == mapEntries.end())
+        return;
+    if (it->second.fInFlight)
+        nInFlight--;
+    // the heap elements are dropped lazily, their sequence no longer matches
+    mapEntries.erase(it);
+}
+
+bool CInvRequestTracker::Has(const uint256& hash) const
+{
+    LOCK(cs);
+    return mapEntries.count(hash) != 0;
+}
+
+size_t CInvRequestTracker::Size() const
+{
+    LOCK(cs);
+    return mapEntries.size();
+}
+
+size_t CInvRequestTracker::CountInFlight() const
+{
+    LOCK(cs);
+    return nInFlight;
+}
+
+void CInvRequestTracker::GetRequestable(int64_t nNow, size_t nMaxInFlight, std::vector<CInv>& vInvOut)
+{
+    LOCK(cs);
+
+    while (!queueInFlight.empty() && queueInFlight.top().nTime <= nNow) {
+        const Scheduled& scheduled = queueInFlight.top();
+        auto it = mapEntries.find(scheduled.inv.hash);
+        if (it != mapEntries.end() && it->second.nSequence == scheduled.nSequence && it->second.fInFlight) {
+            // timed out, the peer may announce it again
+            mapEntries.erase(it);
+            nInFlight--;
+        }
+        queueInFlight.pop();
+    }
+
+    while (!queuePending.empty() && queuePending.top().nTime <= nNow && nInFlight < nMaxInFlight) {
+        const Scheduled& scheduled = queuePending.top();
+        auto it = mapEntries.find(scheduled.inv.hash);
+        if (it != mapEntries.end() && it->second.nSequence == scheduled.nSequence && !it->second.fInFlight) {
+            it->second.fInFlight = true;
+            nInFlight++;
+            vInvOut.push_back(scheduled.inv);
+            queueInFlight.push(Scheduled{nNow + INV_REQUEST_TIMEOUT, scheduled.nSequence, scheduled.inv});
+        }
+        queuePending.pop();
+    }
+}
@@ -0,0 +1,111 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef VELES_INVREQUEST_H
+#define VELES_INVREQUEST_H
+
+#include <crypto/siphash.h>
+#include <protocol.h>
+#include <random.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <functional>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+/** Microseconds after which another peer is asked for an item that did not arrive */
+static const int64_t INV_REQUEST_RETRY_INTERVAL = 2 * 60 * 1000000;
+/** Microseconds a peer has to deliver a requested item before we stop waiting for it */
+static const int64_t INV_REQUEST_TIMEOUT = 2 * 60 * 1000000;
+/** Maximum number of items requested from a peer and not delivered yet */
+static const size_t MAX_PEER_INV_IN_FLIGHT = 1000;
+
+class SaltedInvHasher
+{
+private:
+    const uint64_t k0, k1;
+
+public:
+    SaltedInvHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+    size_t operator()(const uint256& hash) const { return SipHashUint256(k0, k1, hash); }
+};
+
+/**
+ * Earliest time each inventory item may be requested again, shared by all peers so an
+ * item announced by many peers is asked from one of them at a time. Entries that no
+ * longer delay anything are dropped when the map is full.
+ */
+class CInvRequestTimes
+{
+private:
+    Mutex cs;
+    std::unordered_map<uint256, int64_t, SaltedInvHasher> mapRequestTimes GUARDED_BY(cs);
+    const size_t nMaxSize;
+    int64_t nNextPrune GUARDED_BY(cs) = 0;
+
+public:
+    explicit CInvRequestTimes(size_t nMaxSizeIn) : nMaxSize(nMaxSizeIn) {}
+
+    /** Return the time to request hash at, INV_REQUEST_RETRY_INTERVAL after the previous request but not before nNow */
+    int64_t Schedule(const uint256& hash, int64_t nNow);
+    /** Forget hash, the item arrived */
+    void Erase(const uint256& hash);
+};
+
+/**
+ * Inventory items to be requested from one peer. Items are looked up by hash and
+ * taken in request time order from a heap; an item stays tracked while it is in
+ * flight until it is delivered (Remove) or INV_REQUEST_TIMEOUT passed.
+ */
+class CInvRequestTracker
+{
+private:
+    struct Entry {
+        uint64_t nSequence;
+        bool fInFlight;
+    };
+
+    /** Heap element, ordered by time and then by the order the items were added */
+    struct Scheduled {
+        int64_t nTime;
+        uint64_t nSequence;
+        CInv inv;
+
+        bool operator>(const Scheduled& other) const
+        {
+            return nTime != other.nTime ? nTime > other.nTime : nSequence > other.nSequence;
+        }
+    };
+    typedef std::priority_queue<Scheduled, std::vector<Scheduled>, std::greater<Scheduled>> ScheduleQueue;
+
+    mutable Mutex cs;
+    std::unordered_map<uint256, Entry, SaltedInvHasher> mapEntries GUARDED_BY(cs);
+    //! Items waiting for their request time
+    ScheduleQueue queuePending GUARDED_BY(cs);
+    //! Items requested, waiting for their timeout
+    ScheduleQueue queueInFlight GUARDED_BY(cs);
+    size_t nInFlight GUARDED_BY(cs) = 0;
+    uint64_t nSequence GUARDED_BY(cs) = 0;
+
+public:
+    /** Track inv to be requested at nRequestTime, false if it is tracked already */
+    bool Add(const CInv& inv, int64_t nRequestTime);
+    /** Stop tracking hash, it was delivered or will not be asked for */
+    void Remove(const uint256& hash);
+    bool Has(const uint256& hash) const;
+    /** Number of tracked items, pending and in flight */
+    size_t Size() const;
+    size_t CountInFlight() const;
+    /**
+     * Forget the in-flight items that timed out and move the items due at nNow to
+     * vInvOut and in flight, as long as fewer than nMaxInFlight items are in flight.
+     */
+    void GetRequestable(int64_t nNow, size_t nMaxInFlight, std::vector<CInv>& vInvOut);
+};
+
+#endif // VELES_INVREQUEST_H
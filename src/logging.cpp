@@ -6,6 +6,11 @@
 #include <logging.h>
 #include <util/time.h>
 
+// VELES BEGIN
+#include <chrono>
+#include <memory>
+// VELES END
+
 const char * const DEFAULT_DEBUGLOGFILE = "debug.log";
 
 BCLog::Logger& LogInstance()
@@ -215,10 +220,192 @@ std::string BCLog::Logger::LogTimestampStr(const std::string &str)
     return strStamped;
 }
 
+// VELES BEGIN
+namespace BCLog {
+/**
+ * Bounded queue of log messages, many threads push and the writer thread pops. Every slot
+ * carries a sequence number telling whether it is free for the push at that position or holds
+ * the message for the pop at that position, so neither side takes a lock.
+ */
+class LogRingBuffer
+{
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        std::string msg;
+    };
+    std::unique_ptr<Slot[]> m_slots;
+    const size_t m_mask;
+    std::atomic<size_t> m_push_pos{0};
+    std::atomic<size_t> m_pop_pos{0};
+
+public:
+    //! nSize must be a power of two
+    explicit LogRingBuffer(size_t nSize) : m_slots(new Slot[nSize]), m_mask(nSize - 1)
+    {
+        assert(nSize && (nSize & m_mask) == 0);
+        for (size_t i = 0; i < nSize; ++i) {
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    /** Returns false when the buffer is full */
+    bool Push(std::string&& msg)
+    {
+        size_t pos = m_push_pos.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = m_slots[pos & m_mask];
+            const intptr_t diff = (intptr_t)slot.sequence.load(std::memory_order_acquire) - (intptr_t)pos;
+            if (diff == 0) {
+                if (m_push_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.msg = std::move(msg);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                // The slot still holds the message of the previous round
+                return false;
+            } else {
+                pos = m_push_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /** Only called by the writer thread, returns false when the buffer is empty */
+    bool Pop(std::string& msg)
+    {
+        const size_t pos = m_pop_pos.load(std::memory_order_relaxed);
+        Slot& slot = m_slots[pos & m_mask];
+        if ((intptr_t)slot.sequence.load(std::memory_order_acquire) - (intptr_t)(pos + 1) < 0) {
+            return false;
+        }
+        m_pop_pos.store(pos + 1, std::memory_order_relaxed);
+        msg.swap(slot.msg);
+        slot.msg.clear();
+        slot.sequence.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+};
+} // namespace BCLog
+
+static const CLogCategoryDesc* GetLogCategoryDesc(BCLog::LogFlags flag)
+{
+    for (const CLogCategoryDesc& category_desc : LogCategories) {
+        if (category_desc.flag == flag) return &category_desc;
+    }
+    return nullptr;
+}
+
+static int LogCategoryIndex(BCLog::LogFlags category)
+{
+    int nIndex = 0;
+    while (nIndex < 31 && !(category & (1U << nIndex))) ++nIndex;
+    return nIndex;
+}
+
+bool BCLog::Logger::WithinRateLimit(BCLog::LogFlags category)
+{
+    const unsigned int nLimit = m_rate_limit.load(std::memory_order_relaxed);
+    if (nLimit == 0) return true;
+
+    CategoryRate& rate = m_category_rates[LogCategoryIndex(category)];
+    int64_t nSecond = rate.second.load(std::memory_order_relaxed);
+    const int64_t nNow = GetTimeMillis() / 1000;
+    if (nSecond != nNow && rate.second.compare_exchange_strong(nSecond, nNow)) {
+        // The first message of a new second reports the ones suppressed before
+        rate.count = 0;
+        const uint64_t nSuppressed = rate.suppressed.exchange(0);
+        if (nSuppressed) {
+            const CLogCategoryDesc* desc = GetLogCategoryDesc(category);
+            LogPrintStr(strprintf("Suppressed %u %s log messages over the limit of %u per second\n",
+                nSuppressed, desc ? desc->category : "unknown", nLimit));
+        }
+    }
+    if (rate.count.fetch_add(1, std::memory_order_relaxed) < nLimit) return true;
+    ++rate.suppressed;
+    ++rate.suppressed_total;
+    return false;
+}
+
+uint64_t BCLog::Logger::GetSuppressedCount(BCLog::LogFlags category) const
+{
+    return m_category_rates[LogCategoryIndex(category)].suppressed_total.load();
+}
+
+void BCLog::Logger::StartAsync()
+{
+    if (m_async_buffer) return;
+    m_async_stop = false;
+    LogRingBuffer* buffer = new LogRingBuffer(LOG_ASYNC_BUFFER_SIZE);
+    m_async_writer = std::thread(&BCLog::Logger::AsyncWriterThread, this, buffer);
+    m_async_buffer = buffer;
+}
+
+void BCLog::Logger::StopAsync()
+{
+    // New messages are written synchronously from here on
+    LogRingBuffer* buffer = m_async_buffer.exchange(nullptr);
+    if (!buffer) return;
+    {
+        std::lock_guard<std::mutex> lock(m_async_mutex);
+        m_async_stop = true;
+    }
+    m_async_cond.notify_one();
+    m_async_writer.join();
+    // Write what was pushed while the writer stopped. The buffer is leaked like the logger,
+    // a thread may still be pushing a message it took the buffer for.
+    std::string msg;
+    while (buffer->Pop(msg)) {
+        WriteStr(msg);
+    }
+}
+
+void BCLog::Logger::AsyncWriterThread(LogRingBuffer* buffer)
+{
+    std::string msg;
+    while (true) {
+        // Read before draining, so the messages pushed before the stop are all written
+        const bool fStop = m_async_stop.load();
+        bool fWritten = false;
+        while (buffer->Pop(msg)) {
+            WriteStr(msg);
+            fWritten = true;
+        }
+        const uint64_t nDropped = m_async_dropped.exchange(0);
+        if (nDropped) {
+            WriteStr(strprintf("%s Dropped %u log messages, the log writer fell behind\n", FormatISO8601DateTime(GetTime()), nDropped));
+        }
+        if (fStop) break;
+        if (!fWritten) {
+            // Pushes only notify an idle writer, the timeout covers a push racing with going idle
+            std::unique_lock<std::mutex> lock(m_async_mutex);
+            m_async_idle = true;
+            m_async_cond.wait_for(lock, std::chrono::milliseconds(100), [this] { return m_async_stop.load(); });
+            m_async_idle = false;
+        }
+    }
+}
+
 void BCLog::Logger::LogPrintStr(const std::string &str)
 {
     std::string strTimestamped = LogTimestampStr(str);
 
+    LogRingBuffer* buffer = m_async_buffer.load();
+    if (buffer) {
+        if (!buffer->Push(std::move(strTimestamped))) {
+            ++m_async_dropped;
+            ++m_async_dropped_total;
+        } else if (m_async_idle.load(std::memory_order_relaxed)) {
+            m_async_cond.notify_one();
+        }
+        return;
+    }
+    WriteStr(strTimestamped);
+}
+
+void BCLog::Logger::WriteStr(const std::string& strTimestamped)
+{
+// VELES END
     if (m_print_to_console) {
         // print to console
         fwrite(strTimestamped.data(), 1, strTimestamped.size(), stdout);
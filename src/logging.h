@@ -10,16 +10,25 @@
 #include <tinyformat.h>
 
 #include <atomic>
+#include <condition_variable> // VELES
 #include <cstdint>
 #include <list>
 #include <mutex>
 #include <string>
+#include <thread> // VELES
 #include <vector>
 
 static const bool DEFAULT_LOGTIMEMICROS = false;
 static const bool DEFAULT_LOGIPS        = false;
 static const bool DEFAULT_LOGTIMESTAMPS = true;
 extern const char * const DEFAULT_DEBUGLOGFILE;
+// VELES BEGIN
+static const bool DEFAULT_LOGASYNC = false;
+/** Messages the asynchronous log buffers before dropping the new ones */
+static const size_t LOG_ASYNC_BUFFER_SIZE = 8192;
+/** Messages per second logged of a debug category, 0 for no limit */
+static const unsigned int DEFAULT_LOGRATELIMIT = 0;
+// VELES END
 
 extern bool fLogIPs;
 
@@ -68,6 +77,8 @@ namespace BCLog {
         //
     };
 
+    class LogRingBuffer; // VELES
+
     class Logger
     {
     private:
@@ -75,6 +86,33 @@ namespace BCLog {
         std::mutex m_file_mutex;
         std::list<std::string> m_msgs_before_open;
 
+        // VELES BEGIN
+        /** Messages waiting for the writer thread, null when logging synchronously */
+        std::atomic<LogRingBuffer*> m_async_buffer{nullptr};
+        std::thread m_async_writer;
+        std::atomic<bool> m_async_stop{false};
+        std::atomic<bool> m_async_idle{false};
+        std::mutex m_async_mutex;
+        std::condition_variable m_async_cond;
+        /** Messages dropped as the buffer was full, since the writer last reported them and in total */
+        std::atomic<uint64_t> m_async_dropped{0};
+        std::atomic<uint64_t> m_async_dropped_total{0};
+
+        /** Rate limit state of a debug category, per second of the wall clock */
+        struct CategoryRate {
+            std::atomic<int64_t> second{0};
+            std::atomic<uint32_t> count{0};
+            std::atomic<uint64_t> suppressed{0};
+            std::atomic<uint64_t> suppressed_total{0};
+        };
+        CategoryRate m_category_rates[32];
+
+        /** Write a timestamped message to the console and the file */
+        void WriteStr(const std::string& str);
+        void AsyncWriterThread(LogRingBuffer* buffer);
+        // VELES END
+
+
         /**
          * m_started_new_line is a state variable that will suppress printing of
          * the timestamp when multiple calls are made that don't end in a
@@ -116,6 +154,26 @@ namespace BCLog {
         bool WillLogCategory(LogFlags category) const;
 
         bool DefaultShrinkDebugFile() const;
+
+        // VELES BEGIN
+        /** Messages per second logged of every debug category, 0 for no limit */
+        std::atomic<unsigned int> m_rate_limit{DEFAULT_LOGRATELIMIT};
+
+        /**
+         * Hand the messages to a writer thread through a bounded lock-free buffer, so the threads
+         * logging do not wait for the console or the disk. Messages are dropped when the buffer is
+         * full, and the ones buffered are lost on a crash.
+         */
+        void StartAsync();
+        /** Write the buffered messages and log synchronously again */
+        void StopAsync();
+
+        /** Whether a message of category is within the rate limit, counts the suppressed ones */
+        bool WithinRateLimit(LogFlags category);
+
+        uint64_t GetDroppedCount() const { return m_async_dropped_total.load(); }
+        uint64_t GetSuppressedCount(LogFlags category) const;
+        // VELES END
     };
 
 } // namespace BCLog
@@ -159,7 +217,10 @@ static inline void LogPrintf(const char* fmt, const Args&... args)
 template <typename... Args>
 static inline void LogPrint(const BCLog::LogFlags& category, const Args&... args)
 {
-    if (LogAcceptCategory((category))) {
+    // VELES BEGIN
+    //if (LogAcceptCategory((category))) {
+    if (LogAcceptCategory((category)) && LogInstance().WithinRateLimit(category)) {
+    // VELES END
         LogPrintf(args...);
     }
 }
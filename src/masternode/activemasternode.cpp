@@ -10,22 +10,40 @@
 #include <masternode/manager.h>
 #include <netbase.h>
 #include <protocol.h>
+// VELES BEGIN
+#include <messagesigner.h>
+#include <random.h>
+// VELES END
 
 // Keep track of the active Masternode
 CActiveMasternode activeMasternode;
+// VELES BEGIN
+CHostedMasternodes hostedMasternodes;
 
 void CActiveMasternode::ManageState(CConnman& connman)
+{
+    CMasternodePing mnp;
+    if(ManageState(connman, mnp)) {
+        RelayMasternodePing(mnp, connman);
+    }
+}
+// VELES END
+
+// VELES BEGIN
+//void CActiveMasternode::ManageState(CConnman& connman)
+bool CActiveMasternode::ManageState(CConnman& connman, CMasternodePing& mnpRet)
+// VELES END
 {
     LogPrint(BCLog::MASTERNODE, "CActiveMasternode::ManageState -- Start\n");
     if(!fMasterNode) {
         LogPrint(BCLog::MASTERNODE, "CActiveMasternode::ManageState -- Not a masternode, returning\n");
-        return;
+        return false; // VELES
     }
 
     if(Params().NetworkIDString() != CBaseChainParams::REGTEST && !masternodeSync.IsBlockchainSynced()) {
         nState = ACTIVE_MASTERNODE_SYNC_IN_PROCESS;
         LogPrintf("CActiveMasternode::ManageState -- %s: %s\n", GetStateString(), GetStatus());
-        return;
+        return false; // VELES
     }
 
     if(nState == ACTIVE_MASTERNODE_SYNC_IN_PROCESS) {
@@ -42,7 +60,10 @@ void CActiveMasternode::ManageState(CConnman& connman)
         ManageStateRemote();
     }
 
-    SendMasternodePing(connman);
+    // VELES BEGIN
+    //SendMasternodePing(connman);
+    return SignMasternodePing(mnpRet);
+    // VELES END
 }
 
 std::string CActiveMasternode::GetStateString() const
@@ -83,7 +104,10 @@ std::string CActiveMasternode::GetTypeString() const
     return strType;
 }
 
-bool CActiveMasternode::SendMasternodePing(CConnman& connman)
+// VELES BEGIN
+//bool CActiveMasternode::SendMasternodePing(CConnman& connman)
+bool CActiveMasternode::SignMasternodePing(CMasternodePing& mnpRet)
+// VELES END
 {
     if(!fPingerEnabled) {
         LogPrint(BCLog::MASTERNODE, "CActiveMasternode::SendMasternodePing -- %s: masternode ping service is disabled, skipping...\n", GetStateString());
@@ -101,10 +125,13 @@ bool CActiveMasternode::SendMasternodePing(CConnman& connman)
     mnp.nSentinelVersion = nSentinelVersion;
     mnp.fSentinelIsCurrent =
             (abs(GetAdjustedTime() - nSentinelPingTime) < MASTERNODE_WATCHDOG_MAX_SECONDS);
-    if(!mnp.Sign(keyMasternode, pubKeyMasternode)) {
-        LogPrintf("CActiveMasternode::SendMasternodePing -- ERROR: Couldn't sign Masternode Ping\n");
-        return false;
-    }
+    // VELES BEGIN
+    // Don't sign pings that are not due
+    //if(!mnp.Sign(keyMasternode, pubKeyMasternode)) {
+    //    LogPrintf("CActiveMasternode::SendMasternodePing -- ERROR: Couldn't sign Masternode Ping\n");
+    //    return false;
+    //}
+    // VELES END
 
     // Update lastPing for our masternode in Masternode list
     if(mnodeman.IsMasternodePingedWithin(outpoint, MASTERNODE_MIN_MNP_SECONDS, mnp.sigTime)) {
@@ -112,12 +139,25 @@ bool CActiveMasternode::SendMasternodePing(CConnman& connman)
         return false;
     }
 
+    // VELES BEGIN
+    if(!mnp.Sign(keyMasternode, pubKeyMasternode)) {
+        LogPrintf("CActiveMasternode::SendMasternodePing -- ERROR: Couldn't sign Masternode Ping\n");
+        return false;
+    }
+
+    mnpRet = mnp;
+    return true;
+}
+
+void CActiveMasternode::RelayMasternodePing(CMasternodePing& mnp, CConnman& connman)
+{
+    // VELES END
     mnodeman.SetMasternodeLastPing(outpoint, mnp);
 
     LogPrintf("CActiveMasternode::SendMasternodePing -- Relaying ping, collateral=%s\n", outpoint.ToStringShort());
     mnp.Relay(connman);
 
-    return true;
+    //return true; // VELES
 }
 
 bool CActiveMasternode::UpdateSentinelPing(int version)
@@ -141,9 +181,21 @@ void CActiveMasternode::ManageStateInitial(CConnman& connman)
         return;
     }
 
-    // First try to find whatever local address is specified by externalip option
-    bool fFoundLocal = GetLocal(service) && CMasternode::IsValidNetAddr(service);
-    if(!fFoundLocal) {
+    // VELES BEGIN
+    // Hosted masternodes use the address of their masternode.conf entry
+    //// First try to find whatever local address is specified by externalip option
+    //bool fFoundLocal = GetLocal(service) && CMasternode::IsValidNetAddr(service);
+    //if(!fFoundLocal) {
+    bool fFoundLocal;
+    if(serviceHosted.IsValid()) {
+        service = serviceHosted;
+        fFoundLocal = CMasternode::IsValidNetAddr(service);
+    } else {
+        // First try to find whatever local address is specified by externalip option
+        fFoundLocal = GetLocal(service) && CMasternode::IsValidNetAddr(service);
+    }
+    if(!fFoundLocal && !serviceHosted.IsValid()) {
+    // VELES END
         bool empty = true;
         // If we have some peers, let's try to find our local address from one of them
         connman.ForEachNodeContinueIf(CConnman::AllNodes, [&fFoundLocal, &empty, this](CNode* pnode) {
@@ -215,6 +267,14 @@ void CActiveMasternode::ManageStateRemote()
     LogPrint(BCLog::MASTERNODE, "CActiveMasternode::ManageStateRemote -- Start status = %s, type = %s, pinger enabled = %d, pubKeyMasternode.GetID() = %s\n",
              GetStatus(), GetTypeString(), fPingerEnabled, pubKeyMasternode.GetID().ToString());
 
+    // VELES BEGIN
+    // Once started, our entry is only looked up again after the masternode list
+    // notified a change of it, a started masternode keeps its state otherwise
+    if(!TakeEntryChanged() && nState == ACTIVE_MASTERNODE_STARTED) {
+        LogPrint(BCLog::MASTERNODE, "CActiveMasternode::ManageStateRemote -- Entry unchanged, nothing to do\n");
+        return;
+    }
+    // VELES END
     mnodeman.CheckMasternode(pubKeyMasternode, true);
     masternode_info_t infoMn;
     if(mnodeman.GetMasternodeInfo(pubKeyMasternode, infoMn)) {
@@ -250,3 +310,76 @@ void CActiveMasternode::ManageStateRemote()
         LogPrintf("CActiveMasternode::ManageStateRemote -- %s: %s\n", GetStateString(), strNotCapableReason);
     }
 }
+
+// VELES BEGIN
+bool CHostedMasternodes::Add(const std::string& strAlias, const std::string& strPrivKey, const std::string& strService, std::string& strErrorRet)
+{
+    CKey key;
+    CPubKey pubKey;
+    if(!CMessageSigner::GetKeysFromSecret(strPrivKey, key, pubKey)) {
+        strErrorRet = "Invalid masternode private key";
+        return false;
+    }
+    if(pubKey == activeMasternode.pubKeyMasternode || mapByPubKey.count(pubKey)) {
+        strErrorRet = "Masternode private key is already used";
+        return false;
+    }
+    CService serviceEntry;
+    if(!Lookup(strService.c_str(), serviceEntry, 0, false)) {
+        strErrorRet = strprintf("Invalid address %s", strService);
+        return false;
+    }
+    for(const CHostedMasternode& hosted : listHosted) {
+        // Masternodes sharing an address get banned
+        if(static_cast<const CNetAddr&>(hosted.activeMasternode.serviceHosted) == serviceEntry) {
+            strErrorRet = strprintf("Address %s is already used by %s", serviceEntry.ToStringIP(), hosted.strAlias);
+            return false;
+        }
+    }
+
+    listHosted.emplace_back();
+    CHostedMasternode& hosted = listHosted.back();
+    hosted.strAlias = strAlias;
+    hosted.activeMasternode.keyMasternode = key;
+    hosted.activeMasternode.pubKeyMasternode = pubKey;
+    hosted.activeMasternode.serviceHosted = serviceEntry;
+    hosted.nTimeNextPing = GetTime() + GetRandInt(HOSTED_MASTERNODE_PING_JITTER_SECONDS);
+    mapByPubKey.emplace(pubKey, &hosted);
+    return true;
+}
+
+void CHostedMasternodes::ManageState(CConnman& connman)
+{
+    const int64_t nNow = GetTime();
+    std::vector<std::pair<CHostedMasternode*, CMasternodePing> > vecPings;
+    for(CHostedMasternode& hosted : listHosted) {
+        if(nNow < hosted.nTimeNextPing) continue;
+        CMasternodePing mnp;
+        if(hosted.activeMasternode.ManageState(connman, mnp)) {
+            vecPings.emplace_back(&hosted, mnp);
+        }
+    }
+
+    if(vecPings.empty()) return;
+    LogPrint(BCLog::MASTERNODE, "CHostedMasternodes::ManageState -- Relaying %u pings\n", vecPings.size());
+    for(auto& ping : vecPings) {
+        ping.first->activeMasternode.RelayMasternodePing(ping.second, connman);
+        ping.first->nTimeNextPing = nNow + MASTERNODE_MIN_MNP_SECONDS + GetRandInt(HOSTED_MASTERNODE_PING_JITTER_SECONDS);
+    }
+}
+
+void CHostedMasternodes::NotifyEntryChanged(const CPubKey& pubKeyMasternode)
+{
+    auto it = mapByPubKey.find(pubKeyMasternode);
+    if(it != mapByPubKey.end()) {
+        it->second->activeMasternode.NotifyEntryChanged();
+    }
+}
+
+void CHostedMasternodes::UpdateSentinelPing(int version)
+{
+    for(CHostedMasternode& hosted : listHosted) {
+        hosted.activeMasternode.UpdateSentinelPing(version);
+    }
+}
+// VELES END
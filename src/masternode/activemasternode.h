@@ -11,7 +11,17 @@
 #include <net.h>
 #include <primitives/transaction.h>
 
+// VELES BEGIN
+#include <atomic>
+#include <list>
+#include <map>
+// VELES END
+
 class CActiveMasternode;
+// VELES BEGIN
+class CHostedMasternodes;
+class CMasternodePing;
+// VELES END
 
 static const int ACTIVE_MASTERNODE_INITIAL          = 0; // initial state
 static const int ACTIVE_MASTERNODE_SYNC_IN_PROCESS  = 1;
@@ -20,6 +30,14 @@ static const int ACTIVE_MASTERNODE_NOT_CAPABLE      = 3;
 static const int ACTIVE_MASTERNODE_STARTED          = 4;
 
 extern CActiveMasternode activeMasternode;
+// VELES BEGIN
+extern CHostedMasternodes hostedMasternodes;
+
+/// Whether to also operate the masternodes of masternode.conf
+static const bool DEFAULT_HOST_MASTERNODES = false;
+/// Hosted masternodes ping up to this many seconds later than due, so that their pings spread out
+static const int HOSTED_MASTERNODE_PING_JITTER_SECONDS = 2 * 60;
+// VELES END
 
 // Responsible for activating the Masternode and pinging the network
 class CActiveMasternode
@@ -36,15 +54,28 @@ private:
 
     masternode_type_enum_t eType;
 
+    friend class CHostedMasternodes; // VELES
+
     bool fPingerEnabled;
 
+    // VELES BEGIN
     /// Ping Masternode
-    bool SendMasternodePing(CConnman& connman);
+    //bool SendMasternodePing(CConnman& connman);
+    /// Sign a new ping when one is due
+    bool SignMasternodePing(CMasternodePing& mnpRet);
+    /// Update our entry in the masternode list with the ping and relay it
+    void RelayMasternodePing(CMasternodePing& mnp, CConnman& connman);
+    // VELES END
 
     //  sentinel ping data
     int64_t nSentinelPingTime;
     uint32_t nSentinelVersion;
 
+    // VELES BEGIN
+    /// Set by the masternode list when our entry is added, removed, pinged or changes state
+    std::atomic<bool> fEntryChanged;
+    // VELES END
+
 public:
     // Keys for the active Masternode
     CPubKey pubKeyMasternode;
@@ -54,6 +85,11 @@ public:
     COutPoint outpoint;
     CService service;
 
+    // VELES BEGIN
+    /// Address of the masternode.conf entry of a hosted masternode, announced instead of the detected local address
+    CService serviceHosted;
+    // VELES END
+
     int nState; // should be one of ACTIVE_MASTERNODE_XXXX
     std::string strNotCapableReason;
 
@@ -65,11 +101,16 @@ public:
           keyMasternode(),
           outpoint(),
           service(),
-          nState(ACTIVE_MASTERNODE_INITIAL)
+          nState(ACTIVE_MASTERNODE_INITIAL),
+          fEntryChanged(true) // VELES
     {}
 
     /// Manage state of active Masternode
     void ManageState(CConnman& connman);
+    // VELES BEGIN
+    /// Same as above, leaving the ping to the caller: returns true along with the signed ping when one is due
+    bool ManageState(CConnman& connman, CMasternodePing& mnpRet);
+    // VELES END
 
     std::string GetStateString() const;
     std::string GetStatus() const;
@@ -77,9 +118,58 @@ public:
 
     bool UpdateSentinelPing(int version);
 
+    // VELES BEGIN
+    /// Called by the masternode list whenever the entry of our masternode key changes
+    void NotifyEntryChanged() { fEntryChanged = true; }
+    /// Whether our entry changed since the last call
+    bool TakeEntryChanged() { return fEntryChanged.exchange(false); }
+    // VELES END
+
 private:
     void ManageStateInitial(CConnman& connman);
     void ManageStateRemote();
 };
 
+// VELES BEGIN
+/**
+ * Masternodes of masternode.conf operated by this node along with the one of
+ * -masternodeprivkey, so that a single node keeps the network state for all
+ * of them. The node must accept connections on the address of every entry.
+ * The hosted masternodes are only pinged, the payment, InstantSend and
+ * governance votes are cast by the masternode of -masternodeprivkey.
+ *
+ * The entries are only added at startup, before the threads using them run.
+ */
+class CHostedMasternodes
+{
+public:
+    struct CHostedMasternode {
+        std::string strAlias;
+        CActiveMasternode activeMasternode;
+        /// When the masternode is due for its next ping, jittered
+        int64_t nTimeNextPing;
+    };
+
+private:
+    std::list<CHostedMasternode> listHosted;
+    std::map<CPubKey, CHostedMasternode*> mapByPubKey;
+
+public:
+    /// Host the masternode of a masternode.conf entry
+    bool Add(const std::string& strAlias, const std::string& strPrivKey, const std::string& strService, std::string& strErrorRet);
+
+    /// Manage the state of the hosted masternodes, and ping together the ones that are due
+    void ManageState(CConnman& connman);
+
+    /// Called by the masternode list whenever the entry of a masternode key changes
+    void NotifyEntryChanged(const CPubKey& pubKeyMasternode);
+
+    /// The sentinel of the node watches the hosted masternodes too
+    void UpdateSentinelPing(int version);
+
+    const std::list<CHostedMasternode>& GetMasternodes() const { return listHosted; }
+    size_t size() const { return listHosted.size(); }
+};
+// VELES END
+
 #endif //DASH_MASTERNODE_ACTIVEMASTERNODE_H
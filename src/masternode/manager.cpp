@@ -4,7 +4,9 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <addrman.h>
+#include <core_memusage.h> // VELES
 #include <governance/governance.h>
+#include <index/payeeindex.h>
 #include <masternode/activemasternode.h>
 #include <masternode/payments.h>
 #include <masternode/sync.h>
@@ -18,6 +20,7 @@
 #include <script/standard.h>
 #include <spork.h>
 #include <util/system.h>
+#include <validationinterface.h> // VELES
 
 // FXTC BEGIN
 extern void Misbehaving(NodeId nodeid, int howmuch, const std::string& message="");
@@ -30,16 +33,10 @@ extern void Misbehaving(NodeId nodeid, int howmuch, const std::string& message="
 /** Masternode manager */
 CMasternodeMan mnodeman;
 
-const std::string CMasternodeMan::SERIALIZATION_VERSION_STRING = "CMasternodeMan-Version-7";
-
-struct CompareLastPaidBlock
-{
-    bool operator()(const std::pair<int, CMasternode*>& t1,
-                    const std::pair<int, CMasternode*>& t2) const
-    {
-        return (t1.first != t2.first) ? (t1.first < t2.first) : (t1.second->vin < t2.second->vin);
-    }
-};
+// VELES BEGIN
+//const std::string CMasternodeMan::SERIALIZATION_VERSION_STRING = "CMasternodeMan-Version-7";
+const std::string CMasternodeMan::SERIALIZATION_VERSION_STRING = "CMasternodeMan-Version-8";
+// VELES END
 
 struct CompareScoreMN
 {
@@ -50,15 +47,17 @@ struct CompareScoreMN
     }
 };
 
-struct CompareByAddr
-
-{
-    bool operator()(const CMasternode* t1,
-                    const CMasternode* t2) const
-    {
-        return t1->addr < t2->addr;
-    }
-};
+// VELES BEGIN
+//struct CompareByAddr
+//
+//{
+//    bool operator()(const CMasternode* t1,
+//                    const CMasternode* t2) const
+//    {
+//        return t1->addr < t2->addr;
+//    }
+//};
+// VELES END
 
 CMasternodeMan::CMasternodeMan()
 : cs(),
@@ -74,6 +73,11 @@ CMasternodeMan::CMasternodeMan()
   fMasternodesRemoved(false),
   vecDirtyGovernanceObjectHashes(),
   nLastWatchdogVoteTime(0),
+  // VELES BEGIN
+  nListVersion(0),
+  nMaxSeenPingUsage(0),
+  pindexLastPaid(nullptr),
+  // VELES END
   mapSeenMasternodeBroadcast(),
   mapSeenMasternodePing(),
   nDsqCount(0)
@@ -88,9 +92,76 @@ bool CMasternodeMan::Add(CMasternode &mn)
     LogPrint(BCLog::MASTERNODE, "CMasternodeMan::Add -- Adding new Masternode: addr=%s, %i now\n", mn.addr.ToString(), size() + 1);
     mapMasternodes[mn.vin.prevout] = mn;
     fMasternodesAdded = true;
+    // VELES BEGIN
+    InvalidateScoreCache();
+    ListChanged();
+    setLastPaid.insert(std::make_pair(mn.GetLastPaidBlock(), mn.vin.prevout));
+    setLastPaidPending.insert(mn.vin.prevout);
+    AddToIndexes(mn);
+    GetMainSignals().NotifyMasternodeListChanged(mn.vin.prevout, false);
+    // VELES END
     return true;
 }
 
+// VELES BEGIN
+void CMasternodeMan::NotifyActiveMasternode(const CMasternode& mn)
+{
+    if (!fMasterNode) return;
+    if (mn.pubKeyMasternode == activeMasternode.pubKeyMasternode)
+        activeMasternode.NotifyEntryChanged();
+    hostedMasternodes.NotifyEntryChanged(mn.pubKeyMasternode);
+}
+
+void CMasternodeMan::AddToIndexes(const CMasternode& mn, bool fNotify)
+{
+    AssertLockHeld(cs);
+    if (fNotify)
+        NotifyActiveMasternode(mn);
+    mapByPubKeyMasternode[mn.pubKeyMasternode].insert(mn.vin.prevout);
+    mapByPayee[mn.payeeScript].insert(mn.vin.prevout);
+    mapByAddr[mn.addr].insert(mn.vin.prevout);
+}
+
+void CMasternodeMan::RemoveFromIndexes(const CMasternode& mn)
+{
+    AssertLockHeld(cs);
+    NotifyActiveMasternode(mn);
+    auto itKey = mapByPubKeyMasternode.find(mn.pubKeyMasternode);
+    if (itKey != mapByPubKeyMasternode.end()) {
+        itKey->second.erase(mn.vin.prevout);
+        if (itKey->second.empty())
+            mapByPubKeyMasternode.erase(itKey);
+    }
+    auto itPayee = mapByPayee.find(mn.payeeScript);
+    if (itPayee != mapByPayee.end()) {
+        itPayee->second.erase(mn.vin.prevout);
+        if (itPayee->second.empty())
+            mapByPayee.erase(itPayee);
+    }
+    auto itAddr = mapByAddr.find(mn.addr);
+    if (itAddr != mapByAddr.end()) {
+        itAddr->second.erase(mn.vin.prevout);
+        if (itAddr->second.empty())
+            mapByAddr.erase(itAddr);
+    }
+}
+
+void CMasternodeMan::RebuildIndexes()
+{
+    AssertLockHeld(cs);
+    setLastPaid.clear();
+    mapByPubKeyMasternode.clear();
+    mapByPayee.clear();
+    mapByAddr.clear();
+    for (auto& mnpair : mapMasternodes) {
+        setLastPaid.insert(std::make_pair(mnpair.second.GetLastPaidBlock(), mnpair.first));
+        // The cache is read while the masternode settings are still being set up,
+        // the active masternodes start by checking their entries anyway
+        AddToIndexes(mnpair.second, false);
+    }
+}
+// VELES END
+
 void CMasternodeMan::AskForMN(CNode* pnode, const COutPoint& outpoint, CConnman& connman)
 {
     if(!pnode) return;
@@ -154,6 +225,10 @@ bool CMasternodeMan::PoSeBan(const COutPoint &outpoint)
         return false;
     }
     pmn->PoSeBan();
+    // VELES BEGIN
+    ListChanged();
+    NotifyActiveMasternode(*pmn);
+    // VELES END
 
     return true;
 }
@@ -168,10 +243,46 @@ void CMasternodeMan::Check()
     LogPrint(BCLog::MASTERNODE, "CMasternodeMan::Check -- nLastWatchdogVoteTime=%d, IsWatchdogActive()=%d\n", nLastWatchdogVoteTime, IsWatchdogActive());
 
     for (auto& mnpair : mapMasternodes) {
+        // VELES BEGIN
+        //mnpair.second.Check();
+        int nActiveStateOld = mnpair.second.nActiveState;
         mnpair.second.Check();
+        if (mnpair.second.nActiveState != nActiveStateOld) {
+            ListChanged();
+            NotifyActiveMasternode(mnpair.second);
+        }
+        // VELES END
     }
 }
 
+// VELES BEGIN
+void CMasternodeMan::BlockConnected(const CBlock& block)
+{
+    LOCK(cs);
+    for (const auto& tx : block.vtx) {
+        if (tx->IsCoinBase())
+            continue;
+        for (const auto& txin : tx->vin) {
+            CMasternode* pmn = Find(txin.prevout);
+            if (pmn)
+                pmn->SetCollateralCheckRequired();
+        }
+    }
+}
+
+void CMasternodeMan::BlockDisconnected(const CBlock& block)
+{
+    LOCK(cs);
+    for (const auto& tx : block.vtx) {
+        for (unsigned int i = 0; i < tx->vout.size(); i++) {
+            CMasternode* pmn = Find(COutPoint(tx->GetHash(), i));
+            if (pmn)
+                pmn->SetCollateralCheckRequired();
+        }
+    }
+}
+// VELES END
+
 void CMasternodeMan::CheckAndRemove(CConnman& connman)
 {
     if(!masternodeSync.IsMasternodeListSynced()) return;
@@ -203,6 +314,14 @@ void CMasternodeMan::CheckAndRemove(CConnman& connman)
 
                 // and finally remove it from the list
                 it->second.FlagGovernanceItemsAsDirty();
+                // VELES BEGIN
+                InvalidateScoreCache();
+                ListChanged();
+                setLastPaid.erase(std::make_pair(it->second.GetLastPaidBlock(), it->first));
+                RemoveFromIndexes(it->second);
+                mapRemovedTimes[it->first] = GetTime();
+                GetMainSignals().NotifyMasternodeListChanged(it->first, true);
+                // VELES END
                 mapMasternodes.erase(it++);
                 fMasternodesRemoved = true;
             } else {
@@ -347,6 +466,8 @@ void CMasternodeMan::CheckAndRemove(CConnman& connman)
             }
         }
 
+        LimitSeenPings(); // VELES
+
         LogPrintf("CMasternodeMan::CheckAndRemove -- %s\n", ToString());
     }
 
@@ -398,6 +519,19 @@ void CMasternodeMan::Clear()
 {
     LOCK(cs);
     mapMasternodes.clear();
+    // VELES BEGIN
+    InvalidateScoreCache();
+    ListChanged();
+    setLastPaid.clear();
+    mapByPubKeyMasternode.clear();
+    mapByPayee.clear();
+    mapByAddr.clear();
+    if (fMasterNode)
+        activeMasternode.NotifyEntryChanged();
+    hashListDiffBase.SetNull();
+    mapRemovedTimes.clear();
+    ResetLastPaid();
+    // VELES END
     mAskedUsForMasternodeList.clear();
     mWeAskedForMasternodeList.clear();
     mWeAskedForMasternodeListEntry.clear();
@@ -473,6 +607,36 @@ void CMasternodeMan::DsegUpdate(CNode* pnode, CConnman& connman)
     LogPrint(BCLog::MASTERNODE, "CMasternodeMan::DsegUpdate -- asked %s for the list\n", pnode->addr.ToString());
 }
 
+// VELES BEGIN
+void CMasternodeMan::ListDiffUpdate(CNode* pnode, CConnman& connman)
+{
+    LOCK(cs);
+
+    if(Params().NetworkIDString() == CBaseChainParams::MAIN) {
+        if(!(pnode->addr.IsRFC1918() || pnode->addr.IsLocal())) {
+            std::map<CNetAddr, int64_t>::iterator it = mWeAskedForMasternodeList.find(pnode->addr);
+            if(it != mWeAskedForMasternodeList.end() && GetTime() < (*it).second) {
+                LogPrintf("CMasternodeMan::ListDiffUpdate -- we already asked %s for the list; skipping...\n", pnode->addr.ToString());
+                return;
+            }
+        }
+    }
+
+    connman.PushMessage(pnode, CNetMsgMaker(pnode->GetSendVersion()).Make(NetMsgType::GETMNLISTDIFF, hashListDiffBase));
+    int64_t askAgain = GetTime() + DSEG_UPDATE_SECONDS;
+    mWeAskedForMasternodeList[pnode->addr] = askAgain;
+
+    LogPrint(BCLog::MASTERNODE, "CMasternodeMan::ListDiffUpdate -- asked %s for the list changes since %s\n", pnode->addr.ToString(), hashListDiffBase.ToString());
+}
+
+void CMasternodeMan::ListDiffSynced()
+{
+    LOCK2(cs_main, cs);
+    if (chainActive.Tip())
+        hashListDiffBase = chainActive.Tip()->GetBlockHash();
+}
+// VELES END
+
 CMasternode* CMasternodeMan::Find(const COutPoint &outpoint)
 {
     LOCK(cs);
@@ -504,28 +668,56 @@ bool CMasternodeMan::GetMasternodeInfo(const COutPoint& outpoint, masternode_inf
     return true;
 }
 
-bool CMasternodeMan::GetMasternodeInfo(const CPubKey& pubKeyMasternode, masternode_info_t& mnInfoRet)
+// VELES BEGIN
+std::vector<masternode_info_t> CMasternodeMan::GetMasternodeInfos(uint64_t& nListVersionRet)
 {
     LOCK(cs);
+    std::vector<masternode_info_t> vInfos;
+    vInfos.reserve(mapMasternodes.size());
     for (auto& mnpair : mapMasternodes) {
-        if (mnpair.second.pubKeyMasternode == pubKeyMasternode) {
-            mnInfoRet = mnpair.second.GetInfo();
-            return true;
-        }
+        vInfos.push_back(mnpair.second.GetInfo());
     }
+    nListVersionRet = nListVersion;
+    return vInfos;
+}
+// VELES END
+
+bool CMasternodeMan::GetMasternodeInfo(const CPubKey& pubKeyMasternode, masternode_info_t& mnInfoRet)
+{
+    LOCK(cs);
+    // VELES BEGIN
+    //for (auto& mnpair : mapMasternodes) {
+    //    if (mnpair.second.pubKeyMasternode == pubKeyMasternode) {
+    //        mnInfoRet = mnpair.second.GetInfo();
+    //        return true;
+    //    }
+    //}
+    auto it = mapByPubKeyMasternode.find(pubKeyMasternode);
+    if (it != mapByPubKeyMasternode.end()) {
+        mnInfoRet = mapMasternodes.at(*it->second.begin()).GetInfo();
+        return true;
+    }
+    // VELES END
     return false;
 }
 
 bool CMasternodeMan::GetMasternodeInfo(const CScript& payee, masternode_info_t& mnInfoRet)
 {
     LOCK(cs);
-    for (auto& mnpair : mapMasternodes) {
-        CScript scriptCollateralAddress = GetScriptForDestination(mnpair.second.pubKeyCollateralAddress.GetID());
-        if (scriptCollateralAddress == payee) {
-            mnInfoRet = mnpair.second.GetInfo();
-            return true;
-        }
-    }
+    // VELES BEGIN
+    //for (auto& mnpair : mapMasternodes) {
+    //    CScript scriptCollateralAddress = GetScriptForDestination(mnpair.second.pubKeyCollateralAddress.GetID());
+    //    if (scriptCollateralAddress == payee) {
+    //        mnInfoRet = mnpair.second.GetInfo();
+    //        return true;
+    //    }
+    //}
+    auto it = mapByPayee.find(payee);
+    if (it != mapByPayee.end()) {
+        mnInfoRet = mapMasternodes.at(*it->second.begin()).GetInfo();
+        return true;
+    }
+    // VELES END
     return false;
 }
 
@@ -535,6 +727,22 @@ bool CMasternodeMan::Has(const COutPoint& outpoint)
     return mapMasternodes.find(outpoint) != mapMasternodes.end();
 }
 
+// VELES BEGIN
+bool CMasternodeMan::HasVerifiedAtIP(const CNetAddr& addr)
+{
+    LOCK(cs);
+    // The addresses of the IP are next to each other, starting from port 0
+    for (auto itAddr = mapByAddr.lower_bound(CService(addr, 0)); itAddr != mapByAddr.end() && (CNetAddr)itAddr->first == addr; ++itAddr) {
+        for (const COutPoint& outpoint : itAddr->second) {
+            auto itMn = mapMasternodes.find(outpoint);
+            if (itMn != mapMasternodes.end() && itMn->second.IsEnabled() && itMn->second.IsPoSeVerified())
+                return true;
+        }
+    }
+    return false;
+}
+// VELES END
+
 //
 // Deterministically select the oldest/best masternode to pay on the network
 //
@@ -556,63 +764,70 @@ bool CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight, bool f
     // Need LOCK2 here to ensure consistent locking order because the GetBlockHash call below locks cs_main
     LOCK2(cs_main,cs);
 
-    std::vector<std::pair<int, CMasternode*> > vecMasternodeLastPaid;
-
     /*
-        Make a vector with all of the last paid times
+        Walk the masternodes from the oldest payment to the newest
     */
 
     int nMnCount = CountMasternodes();
 
-    for (auto& mnpair : mapMasternodes) {
-        if(!mnpair.second.IsValidForPayment()) continue;
+    // VELES BEGIN
+    // setLastPaid is kept in the order the payment queue used to be sorted in,
+    // so the first tenth of the eligible masternodes is scored during the walk.
+    //  -- This doesn't look at who is being paid in the +8-10 blocks, allowing for double payments very rarely
+    //  -- 1/100 payments should be a double payment on mainnet - (1/(3000/10))*2
+    //  -- (chance per block * chances before IsScheduled will fire)
+    uint256 blockHash;
+    bool fBlockHash = GetBlockHash(blockHash, nBlockHeight - 101);
+    int nTenthNetwork = std::max(nMnCount/10, 1);
+    arith_uint256 nHighest = 0;
+    CMasternode *pBestMasternode = NULL;
+    std::vector<CMasternode*> vecCandidates;
+
+    for (const auto& lastPaid : setLastPaid) {
+        CMasternode& mn = mapMasternodes.at(lastPaid.second);
+
+        if(!mn.IsValidForPayment()) continue;
 
         //check protocol version
-        if(mnpair.second.nProtocolVersion < mnpayments.GetMinMasternodePaymentsProto()) continue;
+        if(mn.nProtocolVersion < mnpayments.GetMinMasternodePaymentsProto()) continue;
 
         //it's in the list (up to 8 entries ahead of current block to allow propagation) -- so let's skip it
-        if(mnpayments.IsScheduled(mnpair.second, nBlockHeight)) continue;
+        if(mnpayments.IsScheduled(mn, nBlockHeight)) continue;
 
         //it's too new, wait for a cycle
-        if(fFilterSigTime && mnpair.second.sigTime + (nMnCount*2.6*60) > GetAdjustedTime()) continue;
+        if(fFilterSigTime && mn.sigTime + (nMnCount*2.6*60) > GetAdjustedTime()) continue;
 
         //make sure it has at least as many confirmations as there are masternodes
-        if(GetUTXOConfirmations(mnpair.first) < nMnCount) continue;
+        if(GetUTXOConfirmations(lastPaid.second) < nMnCount) continue;
+
+        nCountRet++;
 
-        vecMasternodeLastPaid.push_back(std::make_pair(mnpair.second.GetLastPaidBlock(), &mnpair.second));
+        // Look at 1/10 of the oldest nodes (by last payment), calculate their scores and pay the best one
+        if(fBlockHash && nCountRet <= nTenthNetwork) {
+            vecCandidates.push_back(&mn);
+        }
     }
 
-    nCountRet = (int)vecMasternodeLastPaid.size();
+    // The scores of the candidates are hashed together, the first of the highest is paid as in the walk
+    std::vector<arith_uint256> vecScores;
+    CMasternode::CalculateScores(vecCandidates, blockHash, vecScores);
+    for (size_t i = 0; i < vecCandidates.size(); i++) {
+        if(vecScores[i] > nHighest){
+            nHighest = vecScores[i];
+            pBestMasternode = vecCandidates[i];
+        }
+    }
 
     //when the network is in the process of upgrading, don't penalize nodes that recently restarted
     if(fFilterSigTime && nCountRet < nMnCount/3)
         return GetNextMasternodeInQueueForPayment(nBlockHeight, false, nCountRet, mnInfoRet);
 
-    // Sort them low to high
-    sort(vecMasternodeLastPaid.begin(), vecMasternodeLastPaid.end(), CompareLastPaidBlock());
-
-    uint256 blockHash;
-    if(!GetBlockHash(blockHash, nBlockHeight - 101)) {
+    if(!fBlockHash) {
         LogPrintf("CMasternode::GetNextMasternodeInQueueForPayment -- ERROR: GetBlockHash() failed at nBlockHeight %d\n", nBlockHeight - 101);
         return false;
     }
-    // Look at 1/10 of the oldest nodes (by last payment), calculate their scores and pay the best one
-    //  -- This doesn't look at who is being paid in the +8-10 blocks, allowing for double payments very rarely
-    //  -- 1/100 payments should be a double payment on mainnet - (1/(3000/10))*2
-    //  -- (chance per block * chances before IsScheduled will fire)
-    int nTenthNetwork = nMnCount/10;
-    int nCountTenth = 0;
-    arith_uint256 nHighest = 0;
-    CMasternode *pBestMasternode = NULL;
-    for (std::pair<int, CMasternode*>& s : vecMasternodeLastPaid){
-        arith_uint256 nScore = s.second->CalculateScore(blockHash);
-        if(nScore > nHighest){
-            nHighest = nScore;
-            pBestMasternode = s.second;
-        }
-        nCountTenth++;
-        if(nCountTenth >= nTenthNetwork) break;
-    }
+    // VELES END
+
     if (pBestMasternode) {
         mnInfoRet = pBestMasternode->GetInfo();
     }
@@ -662,28 +877,62 @@ masternode_info_t CMasternodeMan::FindRandomNotInVec(const std::vector<COutPoint
     return masternode_info_t();
 }
 
-bool CMasternodeMan::GetMasternodeScores(const uint256& nBlockHash, CMasternodeMan::score_pair_vec_t& vecMasternodeScoresRet, int nMinProtocol)
+// VELES BEGIN
+//bool CMasternodeMan::GetMasternodeScores(const uint256& nBlockHash, CMasternodeMan::score_pair_vec_t& vecMasternodeScoresRet, int nMinProtocol)
+const CMasternodeMan::CMasternodeScores* CMasternodeMan::GetMasternodeScores(const uint256& nBlockHash, int nMinProtocol)
 {
-    vecMasternodeScoresRet.clear();
-
     if (!masternodeSync.IsMasternodeListSynced())
-        return false;
+        return NULL;
 
     AssertLockHeld(cs);
 
     if (mapMasternodes.empty())
-        return false;
+        return NULL;
+
+    // Payment votes, lock votes and PoSe checks keep asking for the same few blocks
+    for (auto it = listScoreCache.begin(); it != listScoreCache.end(); ++it) {
+        if (it->nBlockHash == nBlockHash && it->nMinProtocol == nMinProtocol) {
+            listScoreCache.splice(listScoreCache.begin(), listScoreCache, it);
+            return listScoreCache.front().vecScores.empty() ? NULL : &listScoreCache.front();
+        }
+    }
+
+    CMasternodeScores scores;
+    scores.nBlockHash = nBlockHash;
+    scores.nMinProtocol = nMinProtocol;
 
     // calculate scores
+    // VELES BEGIN
+    std::vector<CMasternode*> vecMasternodes;
     for (auto& mnpair : mapMasternodes) {
         if (mnpair.second.nProtocolVersion >= nMinProtocol) {
-            vecMasternodeScoresRet.push_back(std::make_pair(mnpair.second.CalculateScore(nBlockHash), &mnpair.second));
+            // scores.vecScores.push_back(std::make_pair(mnpair.second.CalculateScore(nBlockHash), &mnpair.second));
+            vecMasternodes.push_back(&mnpair.second);
         }
     }
+    std::vector<arith_uint256> vecScores;
+    CMasternode::CalculateScores(vecMasternodes, nBlockHash, vecScores);
+    scores.vecScores.reserve(vecMasternodes.size());
+    for (size_t i = 0; i < vecMasternodes.size(); i++) {
+        scores.vecScores.push_back(std::make_pair(vecScores[i], vecMasternodes[i]));
+    }
+    // VELES END
+
+    sort(scores.vecScores.rbegin(), scores.vecScores.rend(), CompareScoreMN());
+
+    int nRank = 0;
+    for (auto& scorePair : scores.vecScores) {
+        scores.vecRanks.push_back(std::make_pair(scorePair.second->vin.prevout, ++nRank));
+    }
+    sort(scores.vecRanks.begin(), scores.vecRanks.end());
+
+    listScoreCache.push_front(std::move(scores));
+    if (listScoreCache.size() > MAX_SCORE_CACHE_SIZE)
+        listScoreCache.pop_back();
 
-    sort(vecMasternodeScoresRet.rbegin(), vecMasternodeScoresRet.rend(), CompareScoreMN());
-    return !vecMasternodeScoresRet.empty();
+    return listScoreCache.front().vecScores.empty() ? NULL : &listScoreCache.front();
 }
+// VELES END
 
 bool CMasternodeMan::GetMasternodeRank(const COutPoint& outpoint, int& nRankRet, int nBlockHeight, int nMinProtocol)
 {
@@ -701,18 +950,20 @@ bool CMasternodeMan::GetMasternodeRank(const COutPoint& outpoint, int& nRankRet,
 
     LOCK(cs);
 
-    score_pair_vec_t vecMasternodeScores;
-    if (!GetMasternodeScores(nBlockHash, vecMasternodeScores, nMinProtocol))
+    // VELES BEGIN
+    //score_pair_vec_t vecMasternodeScores;
+    //if (!GetMasternodeScores(nBlockHash, vecMasternodeScores, nMinProtocol))
+    //    return false;
+    const CMasternodeScores* pscores = GetMasternodeScores(nBlockHash, nMinProtocol);
+    if (!pscores)
         return false;
 
-    int nRank = 0;
-    for (auto& scorePair : vecMasternodeScores) {
-        nRank++;
-        if(scorePair.second->vin.prevout == outpoint) {
-            nRankRet = nRank;
-            return true;
-        }
+    auto it = std::lower_bound(pscores->vecRanks.begin(), pscores->vecRanks.end(), std::make_pair(outpoint, 0));
+    if (it != pscores->vecRanks.end() && it->first == outpoint) {
+        nRankRet = it->second;
+        return true;
     }
+    // VELES END
 
     return false;
 }
@@ -733,38 +984,69 @@ bool CMasternodeMan::GetMasternodeRanks(CMasternodeMan::rank_pair_vec_t& vecMast
 
     LOCK(cs);
 
-    score_pair_vec_t vecMasternodeScores;
-    if (!GetMasternodeScores(nBlockHash, vecMasternodeScores, nMinProtocol))
+    // VELES BEGIN
+    //score_pair_vec_t vecMasternodeScores;
+    //if (!GetMasternodeScores(nBlockHash, vecMasternodeScores, nMinProtocol))
+    //    return false;
+    const CMasternodeScores* pscores = GetMasternodeScores(nBlockHash, nMinProtocol);
+    if (!pscores)
         return false;
 
+    vecMasternodeRanksRet.reserve(pscores->vecScores.size());
     int nRank = 0;
-    for (auto& scorePair : vecMasternodeScores) {
+    for (auto& scorePair : pscores->vecScores) {
         nRank++;
         vecMasternodeRanksRet.push_back(std::make_pair(nRank, *scorePair.second));
     }
+    // VELES END
 
     return true;
 }
 
 void CMasternodeMan::ProcessMasternodeConnections(CConnman& connman)
 {
+    // VELES BEGIN
+    // let the outbound connections prefer the enabled masternodes
+    std::vector<CAddress> vMasternodeAddr;
+    {
+        LOCK(cs);
+        for (auto& mnpair : mapMasternodes) {
+            if (mnpair.second.IsEnabled()) {
+                // masternodes run full nodes of a recent protocol version
+                vMasternodeAddr.push_back(CAddress(mnpair.second.addr, ServiceFlags(NODE_NETWORK | NODE_WITNESS)));
+            }
+        }
+    }
+    connman.SetMasternodeAddresses(vMasternodeAddr);
+    // VELES END
+
     //we don't care about this for regtest
     if(Params().NetworkIDString() == CBaseChainParams::REGTEST) return;
 
-    connman.ForEachNode(CConnman::AllNodes, [](CNode* pnode) {
+    //connman.ForEachNode(CConnman::AllNodes, [](CNode* pnode) {
+//#ifdef ENABLE_WALLET
+    //    if(pnode->fMasternode && !privateSendClient.IsMixingMasternode(pnode)) {
+//#else
+    //    if(pnode->fMasternode) {
+//#endif // ENABLE_WALLET
+    //        // FXTC BEGIN
+    //        //LogPrintf("Closing Masternode connection: peer=%d, addr=%s\n", pnode->GetId(), pnode->addr.ToString());
+    //        LogPrintf("CMasternodeMan::ProcessMasternodeConnections -- removing node: peer=%d addr=%s nRefCount=%d fNetworkNode=%d fInbound=%d fMasternode=%d\n",
+    //                  pnode->GetId(), pnode->addr.ToString(), pnode->GetRefCount(), pnode->fNetworkNode, pnode->fInbound, pnode->fMasternode);
+    //        // FXTC END
+    //        pnode->fDisconnect = true;
+    //    }
+    //});
+    // VELES BEGIN
+    // keep recently used masternode links open for reuse, the mixing masternode is never trimmed
+    connman.TrimMasternodePool([](CNode* pnode) {
 #ifdef ENABLE_WALLET
-        if(pnode->fMasternode && !privateSendClient.IsMixingMasternode(pnode)) {
+        return privateSendClient.IsMixingMasternode(pnode);
 #else
-        if(pnode->fMasternode) {
+        return false;
 #endif // ENABLE_WALLET
-            // FXTC BEGIN
-            //LogPrintf("Closing Masternode connection: peer=%d, addr=%s\n", pnode->GetId(), pnode->addr.ToString());
-            LogPrintf("CMasternodeMan::ProcessMasternodeConnections -- removing node: peer=%d addr=%s nRefCount=%d fNetworkNode=%d fInbound=%d fMasternode=%d\n",
-                      pnode->GetId(), pnode->addr.ToString(), pnode->GetRefCount(), pnode->fNetworkNode, pnode->fInbound, pnode->fMasternode);
-            // FXTC END
-            pnode->fDisconnect = true;
-        }
     });
+    // VELES END
 }
 
 std::pair<CService, std::set<uint256> > CMasternodeMan::PopScheduledMnbRequestConnection()
@@ -795,6 +1077,62 @@ std::pair<CService, std::set<uint256> > CMasternodeMan::PopScheduledMnbRequestCo
 }
 
 
+// VELES BEGIN
+void CMasternodeMan::ProcessPing(CNode* pfrom, CMasternodePing& mnp, CConnman& connman)
+{
+    uint256 nHash = mnp.GetHash();
+
+    LogPrint(BCLog::MASTERNODE, "MNPING -- Masternode ping, masternode=%s\n", mnp.vin.prevout.ToStringShort());
+
+    // Need LOCK2 here to ensure consistent locking order because the CheckAndUpdate call below locks cs_main
+    LOCK2(cs_main, cs);
+
+    if(mapSeenMasternodePing.count(nHash)) return; //seen
+    mapSeenMasternodePing.insert(std::make_pair(nHash, mnp));
+
+    LogPrint(BCLog::MASTERNODE, "MNPING -- Masternode ping, masternode=%s new\n", mnp.vin.prevout.ToStringShort());
+
+    // see if we have this Masternode
+    CMasternode* pmn = Find(mnp.vin.prevout);
+
+    // if masternode uses sentinel ping instead of watchdog
+    // we shoud update nTimeLastWatchdogVote here if sentinel
+    // ping flag is actual
+    if(pmn && mnp.fSentinelIsCurrent)
+        UpdateWatchdogVoteTime(mnp.vin.prevout, mnp.sigTime);
+
+    // too late, new MNANNOUNCE is required
+    // FXTC BEGIN
+    // allow resync after wallet restart or resumed from standby
+    //if(pmn && pmn->IsNewStartRequired()) return;
+    if(pmn && pmn->IsExpired()) return;
+    // FXTC END
+
+    int nDos = 0;
+    // VELES BEGIN
+    //if(mnp.CheckAndUpdate(pmn, false, nDos, connman)) return;
+    if(mnp.CheckAndUpdate(pmn, false, nDos, connman)) {
+        // The last seen time and the sentinel state of the masternode changed
+        ListChanged();
+        NotifyActiveMasternode(*pmn);
+        return;
+    }
+    // VELES END
+
+    if(nDos > 0) {
+        // if anything significant failed, mark that node
+        Misbehaving(pfrom->GetId(), nDos);
+    } else if(pmn != NULL) {
+        // nothing significant failed, mn is a known one too
+        return;
+    }
+
+    // something significant is broken or mn is unknown,
+    // we might have to ask for a masternode entry once
+    AskForMN(pfrom, mnp.vin.prevout, connman);
+}
+// VELES END
+
 void CMasternodeMan::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman)
 {
     if(fLiteMode) return; // disable all Dash specific functionality
@@ -804,7 +1142,8 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, const std::string& strCommand,
         CMasternodeBroadcast mnb;
         vRecv >> mnb;
 
-        pfrom->setAskFor.erase(mnb.GetHash());
+        //pfrom->setAskFor.erase(mnb.GetHash());
+        pfrom->RemoveAskFor(mnb.GetHash()); // VELES
 
         if(!masternodeSync.IsBlockchainSynced()) return;
 
@@ -830,50 +1169,65 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, const std::string& strCommand,
 
         uint256 nHash = mnp.GetHash();
 
-        pfrom->setAskFor.erase(nHash);
+        //pfrom->setAskFor.erase(nHash);
+        pfrom->RemoveAskFor(nHash); // VELES
 
         if(!masternodeSync.IsBlockchainSynced()) return;
 
-        LogPrint(BCLog::MASTERNODE, "MNPING -- Masternode ping, masternode=%s\n", mnp.vin.prevout.ToStringShort());
-
-        // Need LOCK2 here to ensure consistent locking order because the CheckAndUpdate call below locks cs_main
-        LOCK2(cs_main, cs);
+        // VELES BEGIN
+        ProcessPing(pfrom, mnp, connman);
 
-        if(mapSeenMasternodePing.count(nHash)) return; //seen
-        mapSeenMasternodePing.insert(std::make_pair(nHash, mnp));
+    } else if (strCommand == NetMsgType::MNPINGBUNDLE) { //Masternode Pings bundled
 
-        LogPrint(BCLog::MASTERNODE, "MNPING -- Masternode ping, masternode=%s new\n", mnp.vin.prevout.ToStringShort());
+        std::vector<CMasternodePing> vecMnp;
+        vRecv >> vecMnp;
 
-        // see if we have this Masternode
-        CMasternode* pmn = Find(mnp.vin.prevout);
+        if (vecMnp.size() > MNBUNDLE_MAX_ENTRIES) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 20, strprintf("mnpingbundle message size = %u", vecMnp.size()));
+            return;
+        }
 
-        // if masternode uses sentinel ping instead of watchdog
-        // we shoud update nTimeLastWatchdogVote here if sentinel
-        // ping flag is actual
-        if(pmn && mnp.fSentinelIsCurrent)
-            UpdateWatchdogVoteTime(mnp.vin.prevout, mnp.sigTime);
+        for (const auto& mnp : vecMnp) {
+            pfrom->RemoveAskFor(mnp.GetHash());
+        }
 
-        // too late, new MNANNOUNCE is required
-        // FXTC BEGIN
-        // allow resync after wallet restart or resumed from standby
-        //if(pmn && pmn->IsNewStartRequired()) return;
-        if(pmn && pmn->IsExpired()) return;
-        // FXTC END
+        if(!masternodeSync.IsBlockchainSynced()) return;
 
-        int nDos = 0;
-        if(mnp.CheckAndUpdate(pmn, false, nDos, connman)) return;
+        LogPrint(BCLog::MASTERNODE, "MNPINGBUNDLE -- %d pings, peer=%d\n", vecMnp.size(), pfrom->GetId());
+
+        // Verify the signatures of the bundle in parallel first, as for a list diff
+        {
+            std::unique_ptr<bool[]> pfValid(new bool[vecMnp.size()]());
+            std::vector<CHashSignerCheck> vChecks;
+            vChecks.reserve(vecMnp.size());
+            std::vector<CPubKey> vecMnpPubKeys(vecMnp.size());
+            {
+                LOCK(cs);
+                for (size_t i = 0; i < vecMnp.size(); i++) {
+                    CMasternode* pmn = Find(vecMnp[i].vin.prevout);
+                    if (pmn)
+                        vecMnpPubKeys[i] = pmn->pubKeyMasternode;
+                }
+            }
+            for (size_t i = 0; i < vecMnp.size(); i++) {
+                // unknown masternode, the ping is rejected on its own below
+                if (vecMnpPubKeys[i].IsValid())
+                    vChecks.emplace_back(vecMnp[i].GetSignatureHash(), vecMnpPubKeys[i], vecMnp[i].vchSig, &pfValid[i]);
+            }
+            VerifyHashSignerChecks(vChecks);
 
-        if(nDos > 0) {
-            // if anything significant failed, mark that node
-            Misbehaving(pfrom->GetId(), nDos);
-        } else if(pmn != NULL) {
-            // nothing significant failed, mn is a known one too
-            return;
+            for (size_t i = 0; i < vecMnp.size(); i++) {
+                if (pfValid[i])
+                    vecMnp[i].pubKeySignatureChecked = vecMnpPubKeys[i];
+            }
         }
 
-        // something significant is broken or mn is unknown,
-        // we might have to ask for a masternode entry once
-        AskForMN(pfrom, mnp.vin.prevout, connman);
+        // Every ping is checked exactly as if it was announced on its own
+        for (auto& mnp : vecMnp) {
+            ProcessPing(pfrom, mnp, connman);
+        }
+        // VELES END
 
     } else if (strCommand == NetMsgType::DSEG) { //Get Masternode list or specific entry
         // Ignore such requests until we are fully synced.
@@ -937,6 +1291,177 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, const std::string& strCommand,
         // smth weird happen - someone asked us for vin we have no idea about?
         LogPrint(BCLog::MASTERNODE, "DSEG -- No invs sent to peer %d\n", pfrom->GetId());
 
+    // VELES BEGIN
+    } else if (strCommand == NetMsgType::GETMNLISTDIFF) { //Get Masternode list changes since a block
+        // Same as DSEG, only answer once fully synced
+        if (!masternodeSync.IsSynced()) return;
+
+        uint256 hashBase;
+        vRecv >> hashBase;
+
+        LogPrint(BCLog::MASTERNODE, "GETMNLISTDIFF -- Masternode list diff since %s, peer=%d\n", hashBase.ToString(), pfrom->GetId());
+
+        LOCK2(cs_main, cs);
+
+        //local network
+        bool isLocal = (pfrom->addr.IsRFC1918() || pfrom->addr.IsLocal());
+
+        if(!isLocal && Params().NetworkIDString() == CBaseChainParams::MAIN) {
+            std::map<CNetAddr, int64_t>::iterator it = mAskedUsForMasternodeList.find(pfrom->addr);
+            if (it != mAskedUsForMasternodeList.end() && it->second > GetTime()) {
+                Misbehaving(pfrom->GetId(), 34);
+                LogPrintf("GETMNLISTDIFF -- peer already asked me for the list, peer=%d\n", pfrom->GetId());
+                return;
+            }
+            int64_t askAgain = GetTime() + DSEG_UPDATE_SECONDS;
+            mAskedUsForMasternodeList[pfrom->addr] = askAgain;
+        }
+
+        // Entries signed since shortly before the base block are sent, older
+        // ones the peer already has. An unknown, stale or reorganized base
+        // gets the whole list.
+        int64_t nTimeSince = 0;
+        const CBlockIndex* pindexBase = hashBase.IsNull() ? nullptr : LookupBlockIndex(hashBase);
+        if (pindexBase && chainActive.Contains(pindexBase) && pindexBase->GetBlockTime() > GetAdjustedTime() - MNLISTDIFF_MAX_AGE_SECONDS) {
+            nTimeSince = pindexBase->GetBlockTime() - MNLISTDIFF_TIME_SLACK_SECONDS;
+        } else {
+            hashBase.SetNull();
+        }
+
+        std::vector<CMasternodeBroadcast> vecMnb;
+        std::vector<CMasternodePing> vecMnp;
+        std::vector<COutPoint> vecRemoved;
+        int nInvCount = 0;
+
+        for (auto& mnpair : mapMasternodes) {
+            if (mnpair.second.addr.IsRFC1918() || mnpair.second.addr.IsLocal()) continue; // do not send local network masternode
+            if (mnpair.second.IsUpdateRequired()) continue; // do not send outdated masternodes
+
+            CMasternodeBroadcast mnb = CMasternodeBroadcast(mnpair.second);
+            CMasternodePing mnp = mnpair.second.lastPing;
+            if (mnb.sigTime < nTimeSince && mnp.sigTime < nTimeSince) continue;
+
+            uint256 hashMNB = mnb.GetHash();
+            uint256 hashMNP = mnp.GetHash();
+            mapSeenMasternodeBroadcast.insert(std::make_pair(hashMNB, std::make_pair(GetTime(), mnb)));
+            mapSeenMasternodePing.insert(std::make_pair(hashMNP, mnp));
+
+            if (vecMnb.size() + vecMnp.size() >= MNLISTDIFF_MAX_ENTRIES) {
+                // keep the message small, the rest goes the DSEG way
+                pfrom->PushInventory(CInv(MSG_MASTERNODE_ANNOUNCE, hashMNB));
+                pfrom->PushInventory(CInv(MSG_MASTERNODE_PING, hashMNP));
+            } else if (mnb.sigTime >= nTimeSince) {
+                vecMnb.push_back(mnb);
+            } else {
+                vecMnp.push_back(mnp);
+            }
+            nInvCount++;
+        }
+
+        if (!hashBase.IsNull()) {
+            for (auto it = mapRemovedTimes.begin(); it != mapRemovedTimes.end(); ) {
+                if (it->second < GetTime() - MNLISTDIFF_MAX_AGE_SECONDS) {
+                    mapRemovedTimes.erase(it++);
+                    continue;
+                }
+                if (it->second >= nTimeSince)
+                    vecRemoved.push_back(it->first);
+                ++it;
+            }
+        }
+
+        // pings look at the stream size on deserialization, serialize through a CDataStream
+        CScratchDataStream ss(SER_NETWORK, pfrom->GetSendVersion()); // VELES
+        ss << hashBase << vecMnb << vecMnp << vecRemoved;
+        connman.PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::MNLISTDIFF, ss));
+        connman.PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_LIST, nInvCount));
+        LogPrintf("GETMNLISTDIFF -- Sent %d masternodes, %d pings and %d removals to peer %d\n", vecMnb.size(), vecMnp.size(), vecRemoved.size(), pfrom->GetId());
+
+    } else if (strCommand == NetMsgType::MNLISTDIFF) { //Masternode list changes
+        uint256 hashBase;
+        std::vector<CMasternodeBroadcast> vecMnb;
+        std::vector<CMasternodePing> vecMnp;
+        std::vector<COutPoint> vecRemoved;
+        vRecv >> hashBase >> vecMnb >> vecMnp >> vecRemoved;
+
+        if(!masternodeSync.IsBlockchainSynced()) return;
+
+        LogPrint(BCLog::MASTERNODE, "MNLISTDIFF -- %d masternodes, %d pings and %d removals since %s, peer=%d\n",
+                 vecMnb.size(), vecMnp.size(), vecRemoved.size(), hashBase.ToString(), pfrom->GetId());
+
+        // Verify all signatures of the diff in parallel first, the entries are
+        // then applied in order and only skip the signatures found valid here
+        {
+            const size_t nChecks = vecMnb.size() * 2 + vecMnp.size();
+            std::unique_ptr<bool[]> pfValid(new bool[nChecks]());
+            std::vector<CHashSignerCheck> vChecks;
+            vChecks.reserve(nChecks);
+            std::vector<CPubKey> vecMnpPubKeys(vecMnp.size());
+            {
+                LOCK(cs);
+                for (size_t i = 0; i < vecMnp.size(); i++) {
+                    CMasternode* pmn = Find(vecMnp[i].vin.prevout);
+                    if (pmn)
+                        vecMnpPubKeys[i] = pmn->pubKeyMasternode;
+                }
+            }
+            for (size_t i = 0; i < vecMnb.size(); i++) {
+                vChecks.emplace_back(vecMnb[i].GetSignatureHash(), vecMnb[i].pubKeyCollateralAddress, vecMnb[i].vchSig, &pfValid[2 * i]);
+                vChecks.emplace_back(vecMnb[i].lastPing.GetSignatureHash(), vecMnb[i].pubKeyMasternode, vecMnb[i].lastPing.vchSig, &pfValid[2 * i + 1]);
+            }
+            for (size_t i = 0; i < vecMnp.size(); i++) {
+                // unknown masternode, the ping is rejected on its own below
+                if (vecMnpPubKeys[i].IsValid())
+                    vChecks.emplace_back(vecMnp[i].GetSignatureHash(), vecMnpPubKeys[i], vecMnp[i].vchSig, &pfValid[2 * vecMnb.size() + i]);
+            }
+            VerifyHashSignerChecks(vChecks);
+
+            for (size_t i = 0; i < vecMnb.size(); i++) {
+                vecMnb[i].fSignatureChecked = pfValid[2 * i];
+                if (pfValid[2 * i + 1])
+                    vecMnb[i].lastPing.pubKeySignatureChecked = vecMnb[i].pubKeyMasternode;
+            }
+            for (size_t i = 0; i < vecMnp.size(); i++) {
+                if (pfValid[2 * vecMnb.size() + i])
+                    vecMnp[i].pubKeySignatureChecked = vecMnpPubKeys[i];
+            }
+        }
+
+        // Every entry is checked exactly as if it was announced on its own
+        for (auto& mnb : vecMnb) {
+            //pfrom->setAskFor.erase(mnb.GetHash());
+            pfrom->RemoveAskFor(mnb.GetHash()); // VELES
+            int nDos = 0;
+            if (CheckMnbAndUpdateMasternodeList(pfrom, mnb, nDos, connman)) {
+                // use announced Masternode as a peer
+                connman.AddNewAddress(CAddress(mnb.addr, NODE_NETWORK), pfrom->addr, 2*60*60);
+            } else if(nDos > 0) {
+                LOCK(cs_main);
+                Misbehaving(pfrom->GetId(), nDos);
+            }
+        }
+
+        for (auto& mnp : vecMnp) {
+            //pfrom->setAskFor.erase(mnp.GetHash());
+            pfrom->RemoveAskFor(mnp.GetHash()); // VELES
+            ProcessPing(pfrom, mnp, connman);
+        }
+
+        // Removals are only hints, the collaterals are looked up again on the next check
+        {
+            LOCK(cs);
+            for (const auto& outpoint : vecRemoved) {
+                CMasternode* pmn = Find(outpoint);
+                if (pmn)
+                    pmn->SetCollateralCheckRequired();
+            }
+        }
+
+        if(fMasternodesAdded) {
+            NotifyMasternodeUpdates(connman);
+        }
+
+    // VELES END
     } else if (strCommand == NetMsgType::MNVERIFY) { // Masternode Verify
 
         // Need LOCK2 here to ensure consistent locking order because the all functions below call GetBlockHash which locks cs_main
@@ -945,7 +1470,8 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, const std::string& strCommand,
         CMasternodeVerification mnv;
         vRecv >> mnv;
 
-        pfrom->setAskFor.erase(mnv.GetHash());
+        //pfrom->setAskFor.erase(mnv.GetHash());
+        pfrom->RemoveAskFor(mnv.GetHash()); // VELES
 
         if(!masternodeSync.IsMasternodeListSynced()) return;
 
@@ -969,73 +1495,63 @@ void CMasternodeMan::DoFullVerificationStep(CConnman& connman)
     if(activeMasternode.outpoint == COutPoint()) return;
     if(!masternodeSync.IsSynced()) return;
 
-    rank_pair_vec_t vecMasternodeRanks;
-    GetMasternodeRanks(vecMasternodeRanks, nCachedBlockHeight - 1, MIN_POSE_PROTO_VERSION);
+    // VELES BEGIN
+    // The masternodes of the round are picked from the cached score table
+    // first, the requests are then sent to all of them at once
+    uint256 nBlockHash;
+    if(!GetBlockHash(nBlockHash, nCachedBlockHeight - 1)) return;
 
-    // Need LOCK2 here to ensure consistent locking order because the SendVerifyRequest call below locks cs_main
-    // through GetHeight() signal in ConnectNode
-    LOCK2(cs_main, cs);
+    std::vector<CAddress> vecAddrs;
+    {
+        LOCK(cs);
 
-    int nCount = 0;
+        const CMasternodeScores* pscores = GetMasternodeScores(nBlockHash, MIN_POSE_PROTO_VERSION);
+        if(!pscores) return;
+
+        int nRanksTotal = (int)pscores->vecScores.size();
 
-    int nMyRank = -1;
-    int nRanksTotal = (int)vecMasternodeRanks.size();
+        // edge case: list is too short and this masternode is not enabled
+        auto itRank = std::lower_bound(pscores->vecRanks.begin(), pscores->vecRanks.end(), std::make_pair(activeMasternode.outpoint, 0));
+        if(itRank == pscores->vecRanks.end() || itRank->first != activeMasternode.outpoint) return;
 
-    // send verify requests only if we are in top MAX_POSE_RANK
-    std::vector<std::pair<int, CMasternode> >::iterator it = vecMasternodeRanks.begin();
-    while(it != vecMasternodeRanks.end()) {
-        if(it->first > MAX_POSE_RANK) {
+        // send verify requests only if we are in top MAX_POSE_RANK
+        int nMyRank = itRank->second;
+        if(nMyRank > MAX_POSE_RANK) {
             LogPrint(BCLog::MASTERNODE, "CMasternodeMan::DoFullVerificationStep -- Must be in top %d to send verify request\n",
                         (int)MAX_POSE_RANK);
             return;
         }
-        if(it->second.vin.prevout == activeMasternode.outpoint) {
-            nMyRank = it->first;
-            LogPrint(BCLog::MASTERNODE, "CMasternodeMan::DoFullVerificationStep -- Found self at rank %d/%d, verifying up to %d masternodes\n",
-                        nMyRank, nRanksTotal, (int)MAX_POSE_CONNECTIONS);
-            break;
+        LogPrint(BCLog::MASTERNODE, "CMasternodeMan::DoFullVerificationStep -- Found self at rank %d/%d, verifying up to %d masternodes\n",
+                    nMyRank, nRanksTotal, (int)MAX_POSE_CONNECTIONS);
+
+        // send verify requests to up to MAX_POSE_CONNECTIONS masternodes
+        // starting from MAX_POSE_RANK + nMyRank and using MAX_POSE_CONNECTIONS as a step
+        for (int nOffset = MAX_POSE_RANK + nMyRank - 1; nOffset < nRanksTotal; nOffset += MAX_POSE_CONNECTIONS) {
+            CMasternode* pmn = pscores->vecScores[nOffset].second;
+            if(pmn->IsPoSeVerified() || pmn->IsPoSeBanned()) {
+                LogPrint(BCLog::MASTERNODE, "CMasternodeMan::DoFullVerificationStep -- Already %s%s%s masternode %s address %s, skipping...\n",
+                            pmn->IsPoSeVerified() ? "verified" : "",
+                            pmn->IsPoSeVerified() && pmn->IsPoSeBanned() ? " and " : "",
+                            pmn->IsPoSeBanned() ? "banned" : "",
+                            pmn->vin.prevout.ToStringShort(), pmn->addr.ToString());
+                continue;
+            }
+            CAddress addr(pmn->addr, NODE_NETWORK);
+            if(netfulfilledman.HasFulfilledRequest(addr, FULFILLED_MNVERIFY_REQUEST) ||
+                std::find(vecAddrs.begin(), vecAddrs.end(), addr) != vecAddrs.end()) {
+                // we already asked for verification, not a good idea to do this too often, skip it
+                LogPrint(BCLog::MASTERNODE, "CMasternodeMan::DoFullVerificationStep -- too many requests, skipping... addr=%s\n", addr.ToString());
+                continue;
+            }
+            LogPrint(BCLog::MASTERNODE, "CMasternodeMan::DoFullVerificationStep -- Verifying masternode %s rank %d/%d address %s\n",
+                        pmn->vin.prevout.ToStringShort(), nOffset + 1, nRanksTotal, pmn->addr.ToString());
+            vecAddrs.push_back(addr);
+            if((int)vecAddrs.size() >= MAX_POSE_CONNECTIONS) break;
         }
-        ++it;
     }
 
-    // edge case: list is too short and this masternode is not enabled
-    if(nMyRank == -1) return;
-
-    // send verify requests to up to MAX_POSE_CONNECTIONS masternodes
-    // starting from MAX_POSE_RANK + nMyRank and using MAX_POSE_CONNECTIONS as a step
-    int nOffset = MAX_POSE_RANK + nMyRank - 1;
-    if(nOffset >= (int)vecMasternodeRanks.size()) return;
-
-    std::vector<CMasternode*> vSortedByAddr;
-    for (auto& mnpair : mapMasternodes) {
-        vSortedByAddr.push_back(&mnpair.second);
-    }
-
-    sort(vSortedByAddr.begin(), vSortedByAddr.end(), CompareByAddr());
-
-    it = vecMasternodeRanks.begin() + nOffset;
-    while(it != vecMasternodeRanks.end()) {
-        if(it->second.IsPoSeVerified() || it->second.IsPoSeBanned()) {
-            LogPrint(BCLog::MASTERNODE, "CMasternodeMan::DoFullVerificationStep -- Already %s%s%s masternode %s address %s, skipping...\n",
-                        it->second.IsPoSeVerified() ? "verified" : "",
-                        it->second.IsPoSeVerified() && it->second.IsPoSeBanned() ? " and " : "",
-                        it->second.IsPoSeBanned() ? "banned" : "",
-                        it->second.vin.prevout.ToStringShort(), it->second.addr.ToString());
-            nOffset += MAX_POSE_CONNECTIONS;
-            if(nOffset >= (int)vecMasternodeRanks.size()) break;
-            it += MAX_POSE_CONNECTIONS;
-            continue;
-        }
-        LogPrint(BCLog::MASTERNODE, "CMasternodeMan::DoFullVerificationStep -- Verifying masternode %s rank %d/%d address %s\n",
-                    it->second.vin.prevout.ToStringShort(), it->first, nRanksTotal, it->second.addr.ToString());
-        if(SendVerifyRequest(CAddress(it->second.addr, NODE_NETWORK), vSortedByAddr, connman)) {
-            nCount++;
-            if(nCount >= MAX_POSE_CONNECTIONS) break;
-        }
-        nOffset += MAX_POSE_CONNECTIONS;
-        if(nOffset >= (int)vecMasternodeRanks.size()) break;
-        it += MAX_POSE_CONNECTIONS;
-    }
+    int nCount = SendVerifyRequests(vecAddrs, connman);
+    // VELES END
 
     LogPrint(BCLog::MASTERNODE, "CMasternodeMan::DoFullVerificationStep -- Sent verification requests to %d masternodes\n", nCount);
 }
@@ -1050,31 +1566,33 @@ void CMasternodeMan::CheckSameAddr()
     if(!masternodeSync.IsSynced() || mapMasternodes.empty()) return;
 
     std::vector<CMasternode*> vBan;
-    std::vector<CMasternode*> vSortedByAddr;
+    // VELES BEGIN
+    //std::vector<CMasternode*> vSortedByAddr;
 
     {
         LOCK(cs);
 
-        CMasternode* pprevMasternode = NULL;
-        CMasternode* pverifiedMasternode = NULL;
-
-        for (auto& mnpair : mapMasternodes) {
-            vSortedByAddr.push_back(&mnpair.second);
-        }
-
-        sort(vSortedByAddr.begin(), vSortedByAddr.end(), CompareByAddr());
-
-        for (auto* pmn : vSortedByAddr) {
-            // check only (pre)enabled masternodes
-            if(!pmn->IsEnabled() && !pmn->IsPreEnabled()) continue;
-            // initial step
-            if(!pprevMasternode) {
-                pprevMasternode = pmn;
-                pverifiedMasternode = pmn->IsPoSeVerified() ? pmn : NULL;
-                continue;
-            }
-            // second+ step
-            if(pmn->addr == pprevMasternode->addr) {
+        // The masternodes are indexed by address, only the addresses shared
+        // by several of them need to be looked at
+        for (const auto& addrpair : mapByAddr) {
+            if (addrpair.second.size() < 2) continue;
+
+            CMasternode* pprevMasternode = NULL;
+            CMasternode* pverifiedMasternode = NULL;
+
+            for (const COutPoint& outpoint : addrpair.second) {
+                auto itMn = mapMasternodes.find(outpoint);
+                if (itMn == mapMasternodes.end()) continue;
+                CMasternode* pmn = &itMn->second;
+                // check only (pre)enabled masternodes
+                if(!pmn->IsEnabled() && !pmn->IsPreEnabled()) continue;
+                // initial step
+                if(!pprevMasternode) {
+                    pprevMasternode = pmn;
+                    pverifiedMasternode = pmn->IsPoSeVerified() ? pmn : NULL;
+                    continue;
+                }
+                // second+ step
                 if(pverifiedMasternode) {
                     // another masternode with the same ip is verified, ban this one
                     vBan.push_back(pmn);
@@ -1084,12 +1602,11 @@ void CMasternodeMan::CheckSameAddr()
                     // and keep a reference to be able to ban following masternodes with the same ip
                     pverifiedMasternode = pmn;
                 }
-            } else {
-                pverifiedMasternode = pmn->IsPoSeVerified() ? pmn : NULL;
+                pprevMasternode = pmn;
             }
-            pprevMasternode = pmn;
         }
     }
+    // VELES END
 
     // ban duplicates
     for (auto* pmn : vBan) {
@@ -1098,32 +1615,47 @@ void CMasternodeMan::CheckSameAddr()
     }
 }
 
-bool CMasternodeMan::SendVerifyRequest(const CAddress& addr, const std::vector<CMasternode*>& vSortedByAddr, CConnman& connman)
+//bool CMasternodeMan::SendVerifyRequest(const CAddress& addr, const std::vector<CMasternode*>& vSortedByAddr, CConnman& connman)
+// VELES BEGIN
+int CMasternodeMan::SendVerifyRequests(const std::vector<CAddress>& vecAddrs, CConnman& connman)
 {
-    if(netfulfilledman.HasFulfilledRequest(addr, strprintf("%s", NetMsgType::MNVERIFY)+"-request")) {
-        // we already asked for verification, not a good idea to do this too often, skip it
-        LogPrint(BCLog::MASTERNODE, "CMasternodeMan::SendVerifyRequest -- too many requests, skipping... addr=%s\n", addr.ToString());
-        return false;
+    // Each new connection can take up to the connect timeout, they are all
+    // opened at once and without holding any lock, the pooled links are reused
+    std::vector<CNode*> vecNodes(vecAddrs.size(), nullptr);
+    std::vector<std::thread> vThreads;
+    for (size_t i = 0; i < vecAddrs.size(); i++) {
+        vThreads.emplace_back(&TraceThread<std::function<void()>>, "mnverify", [&connman, &vecAddrs, &vecNodes, i] {
+            vecNodes[i] = connman.ConnectMasternode(vecAddrs[i]);
+        });
     }
-
-    // FXTC BEGIN
-    //CNode* pnode = connman.ConnectNode(addr, NULL, false, true);
-    CNode* pnode = connman.OpenNetworkConnection(addr, false, nullptr, NULL, false, false, false, true);
-    // FXTC END
-    if(pnode == NULL) {
-        LogPrintf("CMasternodeMan::SendVerifyRequest -- can't connect to node to verify it, addr=%s\n", addr.ToString());
-        return false;
+    for (std::thread& thread : vThreads) {
+        thread.join();
     }
 
-    netfulfilledman.AddFulfilledRequest(addr, strprintf("%s", NetMsgType::MNVERIFY)+"-request");
-    // use random nonce, store it and require node to reply with correct one later
-    CMasternodeVerification mnv(addr, GetRandInt(999999), nCachedBlockHeight - 1);
-    mWeAskedForVerification[addr] = mnv;
-    LogPrintf("CMasternodeMan::SendVerifyRequest -- verifying node using nonce %d addr=%s\n", mnv.nonce, addr.ToString());
-    connman.PushMessage(pnode, CNetMsgMaker(pnode->GetSendVersion()).Make(NetMsgType::MNVERIFY, mnv));
+    int nCount = 0;
 
-    return true;
+    LOCK(cs);
+
+    for (size_t i = 0; i < vecAddrs.size(); i++) {
+        const CAddress& addr = vecAddrs[i];
+        CNode* pnode = vecNodes[i];
+        if(pnode == NULL) {
+            LogPrintf("CMasternodeMan::SendVerifyRequests -- can't connect to node to verify it, addr=%s\n", addr.ToString());
+            continue;
+        }
+
+        netfulfilledman.AddFulfilledRequest(addr, FULFILLED_MNVERIFY_REQUEST);
+        // use random nonce, store it and require node to reply with correct one later
+        CMasternodeVerification mnv(addr, GetRandInt(999999), nCachedBlockHeight - 1);
+        mWeAskedForVerification[addr] = mnv;
+        LogPrintf("CMasternodeMan::SendVerifyRequests -- verifying node using nonce %d addr=%s\n", mnv.nonce, addr.ToString());
+        connman.PushMessage(pnode, CNetMsgMaker(pnode->GetSendVersion()).Make(NetMsgType::MNVERIFY, mnv));
+        nCount++;
+    }
+
+    return nCount;
 }
+// VELES END
 
 void CMasternodeMan::SendVerifyReply(CNode* pnode, CMasternodeVerification& mnv, CConnman& connman)
 {
@@ -1136,7 +1668,7 @@ void CMasternodeMan::SendVerifyReply(CNode* pnode, CMasternodeVerification& mnv,
         return;
     }
 
-    if(netfulfilledman.HasFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-reply")) {
+    if(netfulfilledman.HasFulfilledRequest(pnode->addr, FULFILLED_MNVERIFY_REPLY)) {
         // peer should not ask us that often
         LogPrintf("MasternodeMan::SendVerifyReply -- ERROR: peer already asked me recently, peer=%d\n", pnode->GetId());
         Misbehaving(pnode->GetId(), 20);
@@ -1164,7 +1696,7 @@ void CMasternodeMan::SendVerifyReply(CNode* pnode, CMasternodeVerification& mnv,
     }
 
     connman.PushMessage(pnode, CNetMsgMaker(pnode->GetSendVersion()).Make(NetMsgType::MNVERIFY, mnv));
-    netfulfilledman.AddFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-reply");
+    netfulfilledman.AddFulfilledRequest(pnode->addr, FULFILLED_MNVERIFY_REPLY);
 }
 
 void CMasternodeMan::ProcessVerifyReply(CNode* pnode, CMasternodeVerification& mnv)
@@ -1174,7 +1706,7 @@ void CMasternodeMan::ProcessVerifyReply(CNode* pnode, CMasternodeVerification& m
     std::string strError;
 
     // did we even ask for it? if that's the case we should have matching fulfilled request
-    if(!netfulfilledman.HasFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-request")) {
+    if(!netfulfilledman.HasFulfilledRequest(pnode->addr, FULFILLED_MNVERIFY_REQUEST)) {
         LogPrintf("CMasternodeMan::ProcessVerifyReply -- ERROR: we didn't ask for verification of %s, peer=%d\n", pnode->addr.ToString(), pnode->GetId());
         Misbehaving(pnode->GetId(), 20);
         return;
@@ -1204,7 +1736,7 @@ void CMasternodeMan::ProcessVerifyReply(CNode* pnode, CMasternodeVerification& m
     }
 
     // we already verified this address, why node is spamming?
-    if(netfulfilledman.HasFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-done")) {
+    if(netfulfilledman.HasFulfilledRequest(pnode->addr, FULFILLED_MNVERIFY_DONE)) {
         LogPrintf("CMasternodeMan::ProcessVerifyReply -- ERROR: already verified %s recently\n", pnode->addr.ToString());
         Misbehaving(pnode->GetId(), 20);
         return;
@@ -1216,15 +1748,39 @@ void CMasternodeMan::ProcessVerifyReply(CNode* pnode, CMasternodeVerification& m
         CMasternode* prealMasternode = NULL;
         std::vector<CMasternode*> vpMasternodesToBan;
         std::string strMessage1 = strprintf("%s%d%s", pnode->addr.ToString(false), mnv.nonce, blockHash.ToString());
-        for (auto& mnpair : mapMasternodes) {
-            if(CAddress(mnpair.second.addr, NODE_NETWORK) == pnode->addr) {
-                if(CMessageSigner::VerifyMessage(mnpair.second.pubKeyMasternode, mnv.vchSig1, strMessage1, strError)) {
+        // VELES BEGIN
+        //for (auto& mnpair : mapMasternodes) {
+        //    if(CAddress(mnpair.second.addr, NODE_NETWORK) == pnode->addr) {
+        std::vector<std::map<COutPoint, CMasternode>::iterator> vecCandidates;
+        auto itAddr = mapByAddr.find(pnode->addr);
+        if(itAddr != mapByAddr.end()) {
+            for (const COutPoint& outpoint : itAddr->second) {
+                auto itMn = mapMasternodes.find(outpoint);
+                if(itMn != mapMasternodes.end())
+                    vecCandidates.push_back(itMn);
+            }
+        }
+        // the signature is checked against all the masternodes of the address at once
+        const uint256 hashMessage1 = CMessageSigner::GetMessageHash(strMessage1);
+        std::unique_ptr<bool[]> pfValid(new bool[vecCandidates.size()]());
+        std::vector<CHashSignerCheck> vChecks;
+        vChecks.reserve(vecCandidates.size());
+        for (size_t i = 0; i < vecCandidates.size(); i++) {
+            vChecks.emplace_back(hashMessage1, vecCandidates[i]->second.pubKeyMasternode, mnv.vchSig1, &pfValid[i]);
+        }
+        VerifyHashSignerChecks(vChecks);
+        for (size_t i = 0; i < vecCandidates.size(); i++) {
+            {
+                auto& mnpair = *vecCandidates[i];
+        // VELES END
+                //if(CMessageSigner::VerifyMessage(mnpair.second.pubKeyMasternode, mnv.vchSig1, strMessage1, strError)) {
+                if(pfValid[i]) { // VELES
                     // found it!
                     prealMasternode = &mnpair.second;
                     if(!mnpair.second.IsPoSeVerified()) {
                         mnpair.second.DecreasePoSeBanScore();
                     }
-                    netfulfilledman.AddFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-done");
+                    netfulfilledman.AddFulfilledRequest(pnode->addr, FULFILLED_MNVERIFY_DONE);
 
                     // we can only broadcast it if we are an activated masternode
                     if(activeMasternode.outpoint == COutPoint()) continue;
@@ -1351,15 +1907,33 @@ void CMasternodeMan::ProcessVerifyBroadcast(CNode* pnode, const CMasternodeVerif
             return;
         }
 
-        if(!CMessageSigner::VerifyMessage(pmn1->pubKeyMasternode, mnv.vchSig1, strMessage1, strError)) {
-            LogPrintf("CMasternodeMan::ProcessVerifyBroadcast -- VerifyMessage() for masternode1 failed, error: %s\n", strError);
+        //if(!CMessageSigner::VerifyMessage(pmn1->pubKeyMasternode, mnv.vchSig1, strMessage1, strError)) {
+        //    LogPrintf("CMasternodeMan::ProcessVerifyBroadcast -- VerifyMessage() for masternode1 failed, error: %s\n", strError);
+        //    return;
+        //}
+        //
+        //if(!CMessageSigner::VerifyMessage(pmn2->pubKeyMasternode, mnv.vchSig2, strMessage2, strError)) {
+        //    LogPrintf("CMasternodeMan::ProcessVerifyBroadcast -- VerifyMessage() for masternode2 failed, error: %s\n", strError);
+        //    return;
+        //}
+        // VELES BEGIN
+        // both signatures are checked at once
+        bool fValid[2] = {false, false};
+        std::vector<CHashSignerCheck> vChecks;
+        vChecks.emplace_back(CMessageSigner::GetMessageHash(strMessage1), pmn1->pubKeyMasternode, mnv.vchSig1, &fValid[0]);
+        vChecks.emplace_back(CMessageSigner::GetMessageHash(strMessage2), pmn2->pubKeyMasternode, mnv.vchSig2, &fValid[1]);
+        VerifyHashSignerChecks(vChecks);
+
+        if(!fValid[0]) {
+            LogPrintf("CMasternodeMan::ProcessVerifyBroadcast -- VerifyMessage() for masternode1 failed\n");
             return;
         }
 
-        if(!CMessageSigner::VerifyMessage(pmn2->pubKeyMasternode, mnv.vchSig2, strMessage2, strError)) {
-            LogPrintf("CMasternodeMan::ProcessVerifyBroadcast -- VerifyMessage() for masternode2 failed, error: %s\n", strError);
+        if(!fValid[1]) {
+            LogPrintf("CMasternodeMan::ProcessVerifyBroadcast -- VerifyMessage() for masternode2 failed\n");
             return;
         }
+        // VELES END
 
         if(!pmn1->IsPoSeVerified()) {
             pmn1->DecreasePoSeBanScore();
@@ -1397,6 +1971,124 @@ std::string CMasternodeMan::ToString() const
     return info.str();
 }
 
+// VELES BEGIN
+static size_t RecursiveDynamicUsage(const CMasternodePing& mnp)
+{
+    return memusage::DynamicUsage(mnp.vchSig);
+}
+
+static size_t RecursiveDynamicUsage(const CMasternode& mn)
+{
+    size_t nUsage = RecursiveDynamicUsage(mn.lastPing) + memusage::DynamicUsage(mn.vchSig);
+    return nUsage + memusage::DynamicUsage(mn.mapGovernanceObjectsVotedOn);
+}
+
+static size_t RecursiveDynamicUsage(const CMasternodeVerification& mnv)
+{
+    return memusage::DynamicUsage(mnv.vchSig1) + memusage::DynamicUsage(mnv.vchSig2);
+}
+
+size_t CMasternodeMan::DynamicMemoryUsage() const
+{
+    LOCK(cs);
+
+    size_t nUsage = memusage::DynamicUsage(mapMasternodes);
+    for (const auto& pair : mapMasternodes) {
+        nUsage += RecursiveDynamicUsage(pair.second);
+    }
+    nUsage += memusage::DynamicUsage(mAskedUsForMasternodeList) + memusage::DynamicUsage(mWeAskedForMasternodeList);
+    nUsage += memusage::DynamicUsage(mWeAskedForMasternodeListEntry);
+    for (const auto& pair : mWeAskedForMasternodeListEntry) {
+        nUsage += memusage::DynamicUsage(pair.second);
+    }
+    nUsage += memusage::DynamicUsage(mWeAskedForVerification);
+    for (const auto& pair : mWeAskedForVerification) {
+        nUsage += RecursiveDynamicUsage(pair.second);
+    }
+    nUsage += memusage::DynamicUsage(mMnbRecoveryRequests);
+    for (const auto& pair : mMnbRecoveryRequests) {
+        nUsage += memusage::DynamicUsage(pair.second.second);
+    }
+    nUsage += memusage::DynamicUsage(mMnbRecoveryGoodReplies);
+    for (const auto& pair : mMnbRecoveryGoodReplies) {
+        nUsage += memusage::DynamicUsage(pair.second);
+        for (const auto& mnb : pair.second) {
+            nUsage += RecursiveDynamicUsage(mnb);
+        }
+    }
+    // a list node holds the scores and two links
+    for (const auto& scores : listScoreCache) {
+        nUsage += memusage::MallocUsage(sizeof(CMasternodeScores) + 2 * sizeof(void*));
+        nUsage += memusage::DynamicUsage(scores.vecScores) + memusage::DynamicUsage(scores.vecRanks);
+    }
+    nUsage += memusage::DynamicUsage(setLastPaid) + memusage::DynamicUsage(mapByPubKeyMasternode);
+    for (const auto& pair : mapByPubKeyMasternode) {
+        nUsage += memusage::DynamicUsage(pair.second);
+    }
+    nUsage += memusage::DynamicUsage(mapByPayee);
+    for (const auto& pair : mapByPayee) {
+        nUsage += RecursiveDynamicUsage(pair.first) + memusage::DynamicUsage(pair.second);
+    }
+    nUsage += memusage::DynamicUsage(mapByAddr);
+    for (const auto& pair : mapByAddr) {
+        nUsage += memusage::DynamicUsage(pair.second);
+    }
+    nUsage += memusage::DynamicUsage(mapRemovedTimes) + memusage::DynamicUsage(vecDirtyGovernanceObjectHashes);
+    nUsage += memusage::DynamicUsage(mapSeenMasternodeBroadcast);
+    for (const auto& pair : mapSeenMasternodeBroadcast) {
+        nUsage += RecursiveDynamicUsage(pair.second.second);
+    }
+    nUsage += memusage::DynamicUsage(mapSeenMasternodePing);
+    for (const auto& pair : mapSeenMasternodePing) {
+        nUsage += RecursiveDynamicUsage(pair.second);
+    }
+    nUsage += memusage::DynamicUsage(mapSeenMasternodeVerification);
+    for (const auto& pair : mapSeenMasternodeVerification) {
+        nUsage += RecursiveDynamicUsage(pair.second);
+    }
+    return nUsage;
+}
+
+void CMasternodeMan::SetMaxSeenPingUsage(size_t nMaxSeenPingUsageIn)
+{
+    LOCK(cs);
+    nMaxSeenPingUsage = nMaxSeenPingUsageIn;
+    LimitSeenPings();
+}
+
+void CMasternodeMan::LimitSeenPings()
+{
+    AssertLockHeld(cs);
+    if (nMaxSeenPingUsage == 0) return;
+
+    // Pings are the seen messages that pile up, the broadcasts are kept to relay the list and
+    // the verifications go after MAX_POSE_BLOCKS anyway
+    size_t nUsage = memusage::DynamicUsage(mapSeenMasternodePing);
+    for (const auto& pair : mapSeenMasternodePing) {
+        nUsage += RecursiveDynamicUsage(pair.second);
+    }
+    if (nUsage <= nMaxSeenPingUsage) return;
+
+    std::vector<std::pair<int64_t, uint256> > vecPings;
+    vecPings.reserve(mapSeenMasternodePing.size());
+    for (const auto& pair : mapSeenMasternodePing) {
+        vecPings.emplace_back(pair.second.sigTime, pair.first);
+    }
+    std::sort(vecPings.begin(), vecPings.end());
+
+    const size_t nNodeUsage = memusage::DynamicUsage(mapSeenMasternodePing) / mapSeenMasternodePing.size();
+    size_t nEvicted = 0;
+    for (const auto& ping : vecPings) {
+        if (nUsage <= nMaxSeenPingUsage) break;
+        auto it = mapSeenMasternodePing.find(ping.second);
+        nUsage -= nNodeUsage + RecursiveDynamicUsage(it->second);
+        mapSeenMasternodePing.erase(it);
+        nEvicted++;
+    }
+    LogPrint(BCLog::MASTERNODE, "CMasternodeMan::LimitSeenPings -- Evicted %d oldest pings, %d bytes left\n", nEvicted, nUsage);
+}
+// VELES END
+
 void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb, CConnman& connman)
 {
     LOCK2(cs_main, cs);
@@ -1412,7 +2104,19 @@ void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb, CConnman& co
         }
     } else {
         CMasternodeBroadcast mnbOld = mapSeenMasternodeBroadcast[CMasternodeBroadcast(*pmn).GetHash()].second;
-        if(pmn->UpdateFromNewBroadcast(mnb, connman)) {
+        // VELES BEGIN
+        //if(pmn->UpdateFromNewBroadcast(mnb, connman)) {
+        // The masternode key may change
+        RemoveFromIndexes(*pmn);
+        bool fUpdated = pmn->UpdateFromNewBroadcast(mnb, connman);
+        AddToIndexes(*pmn);
+        // VELES END
+        if(fUpdated) {
+            // VELES BEGIN
+            // The protocol version of the masternode may have changed
+            InvalidateScoreCache();
+            ListChanged();
+            // VELES END
             masternodeSync.BumpAssetLastTime("CMasternodeMan::UpdateMasternodeList - seen");
             mapSeenMasternodeBroadcast.erase(mnbOld.GetHash());
         }
@@ -1474,7 +2178,16 @@ bool CMasternodeMan::CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBr
         CMasternode* pmn = Find(mnb.vin.prevout);
         if(pmn) {
             CMasternodeBroadcast mnbOld = mapSeenMasternodeBroadcast[CMasternodeBroadcast(*pmn).GetHash()].second;
-            if(!mnb.Update(pmn, nDos, connman)) {
+            // VELES BEGIN
+            // The protocol version and the key of the masternode may change
+            InvalidateScoreCache();
+            ListChanged();
+            RemoveFromIndexes(*pmn);
+            bool fUpdated = mnb.Update(pmn, nDos, connman);
+            AddToIndexes(*pmn);
+            //if(!mnb.Update(pmn, nDos, connman)) {
+            if(!fUpdated) {
+            // VELES END
                 LogPrint(BCLog::MASTERNODE, "CMasternodeMan::CheckMnbAndUpdateMasternodeList -- Update() failed, masternode=%s\n", mnb.vin.prevout.ToStringShort());
                 return false;
             }
@@ -1521,6 +2234,8 @@ void CMasternodeMan::UpdateLastPaid(const CBlockIndex* pindex)
 
     if(fLiteMode || !masternodeSync.IsWinnersListSynced() || mapMasternodes.empty()) return;
 
+    // VELES BEGIN
+    /*
     static bool IsFirstRun = true;
     // Do full scan on first run or if we are not a masternode
     // (MNs should update this info on every block, so limited scan should be enough for them)
@@ -1534,7 +2249,117 @@ void CMasternodeMan::UpdateLastPaid(const CBlockIndex* pindex)
     }
 
     IsFirstRun = false;
+    */
+    if (!pindex || pindex == pindexLastPaid) return;
+
+    const int nStorageLimit = mnpayments.GetStorageLimit();
+    const CBlockIndex* pindexFork = pindexLastPaid ? LastCommonAncestor(pindexLastPaid, pindex) : nullptr;
+    if (pindexFork && pindexLastPaid->nHeight - pindexFork->nHeight > LAST_PAID_UNDO_BLOCKS) {
+        // Deeper than the undo goes, forget the payments of the disconnected blocks and scan again
+        LogPrint(BCLog::MASTERNODE, "CMasternodeMan::UpdateLastPaid -- reorg from %d to %d, scanning again\n", pindexLastPaid->nHeight, pindexFork->nHeight);
+        for (auto& mnpair : mapMasternodes) {
+            if (mnpair.second.nBlockLastPaid > pindexFork->nHeight) {
+                setLastPaid.erase(std::make_pair(mnpair.second.nBlockLastPaid, mnpair.first));
+                mnpair.second.nBlockLastPaid = 0;
+                mnpair.second.nTimeLastPaid = 0;
+                setLastPaid.insert(std::make_pair(0, mnpair.first));
+                ListChanged();
+            }
+        }
+        mapLastPaidUndo.clear();
+        pindexFork = nullptr;
+    }
+
+    // Undo the payments of the disconnected blocks
+    if (pindexFork)
+        UndoLastPaid(pindexFork->nHeight);
+
+    if (!pindexFork || pindex->nHeight - pindexFork->nHeight > nStorageLimit) {
+        // Read the blocks the payee index doesn't know yet once, instead of once per masternode
+        g_payee_index.Sync(pindex, nStorageLimit);
+        for (auto& mnpair : mapMasternodes) {
+            ScanLastPaid(mnpair.second, pindex, nStorageLimit);
+        }
+    } else {
+        // Read the payments of the connected blocks, lowest first, through the masternodes
+        // paid by the payee scripts of each block
+        g_payee_index.Sync(pindex, pindex->nHeight - pindexFork->nHeight);
+        LOCK(cs_mapMasternodeBlocks);
+        for (int nHeight = pindexFork->nHeight + 1; nHeight <= pindex->nHeight; nHeight++) {
+            const CBlockIndex* pindexPaid = pindex->GetAncestor(nHeight);
+            auto itBlock = mnpayments.mapMasternodeBlocks.find(nHeight);
+            if (itBlock == mnpayments.mapMasternodeBlocks.end())
+                continue;
+            for (const CScript& payee : g_payee_index.GetBlockPayees(pindexPaid)) {
+                auto itPayee = mapByPayee.find(payee);
+                if (itPayee == mapByPayee.end() || !itBlock->second.HasPayeeWithVotes(payee, GetPayeeHash(payee), 2))
+                    continue;
+                for (const COutPoint& outpoint : itPayee->second) {
+                    SetLastPaid(mapMasternodes[outpoint], nHeight, pindexPaid->nTime);
+                }
+            }
+        }
+        for (const COutPoint& outpoint : setLastPaidPending) {
+            auto it = mapMasternodes.find(outpoint);
+            if (it != mapMasternodes.end())
+                ScanLastPaid(it->second, pindex, nStorageLimit);
+        }
+    }
+    setLastPaidPending.clear();
+
+    pindexLastPaid = pindex;
+    mapLastPaidUndo.erase(mapLastPaidUndo.begin(), mapLastPaidUndo.upper_bound(pindex->nHeight - LAST_PAID_UNDO_BLOCKS));
+    // VELES END
+}
+
+// VELES BEGIN
+void CMasternodeMan::SetLastPaid(CMasternode& mn, int nHeight, int64_t nTime)
+{
+    AssertLockHeld(cs);
+    if (nHeight == mn.nBlockLastPaid) return;
+    mapLastPaidUndo[nHeight].push_back(LastPaidUndo{mn.vin.prevout, mn.nBlockLastPaid, mn.nTimeLastPaid});
+    setLastPaid.erase(std::make_pair(mn.nBlockLastPaid, mn.vin.prevout));
+    mn.nBlockLastPaid = nHeight;
+    mn.nTimeLastPaid = nTime;
+    setLastPaid.insert(std::make_pair(nHeight, mn.vin.prevout));
+    ListChanged();
+}
+
+void CMasternodeMan::ScanLastPaid(CMasternode& mn, const CBlockIndex* pindex, int nMaxBlocksToScanBack)
+{
+    AssertLockHeld(cs);
+    const int nBlockLastPaidOld = mn.nBlockLastPaid;
+    const int64_t nTimeLastPaidOld = mn.nTimeLastPaid;
+    mn.UpdateLastPaid(pindex, nMaxBlocksToScanBack);
+    if (mn.nBlockLastPaid == nBlockLastPaidOld) return;
+
+    // Recorded as if the block had set it, so that disconnecting the block undoes it
+    const int nHeight = mn.nBlockLastPaid;
+    const int64_t nTime = mn.nTimeLastPaid;
+    mn.nBlockLastPaid = nBlockLastPaidOld;
+    mn.nTimeLastPaid = nTimeLastPaidOld;
+    SetLastPaid(mn, nHeight, nTime);
+}
+
+void CMasternodeMan::UndoLastPaid(int nHeight)
+{
+    AssertLockHeld(cs);
+    for (auto it = mapLastPaidUndo.rbegin(); it != mapLastPaidUndo.rend() && it->first > nHeight; ++it) {
+        for (auto itUndo = it->second.rbegin(); itUndo != it->second.rend(); ++itUndo) {
+            auto itMn = mapMasternodes.find(itUndo->outpoint);
+            if (itMn == mapMasternodes.end())
+                continue;
+            CMasternode& mn = itMn->second;
+            setLastPaid.erase(std::make_pair(mn.nBlockLastPaid, mn.vin.prevout));
+            mn.nBlockLastPaid = itUndo->nBlockLastPaid;
+            mn.nTimeLastPaid = itUndo->nTimeLastPaid;
+            setLastPaid.insert(std::make_pair(mn.nBlockLastPaid, mn.vin.prevout));
+            ListChanged();
+        }
+    }
+    mapLastPaidUndo.erase(mapLastPaidUndo.upper_bound(nHeight), mapLastPaidUndo.end());
 }
+// VELES END
 
 void CMasternodeMan::UpdateWatchdogVoteTime(const COutPoint& outpoint, uint64_t nVoteTime)
 {
@@ -1579,12 +2404,24 @@ void CMasternodeMan::CheckMasternode(const CPubKey& pubKeyMasternode, bool fForc
     //LOCK(cs)
     LOCK2(cs_main, cs);
     // FXTC END
-    for (auto& mnpair : mapMasternodes) {
-        if (mnpair.second.pubKeyMasternode == pubKeyMasternode) {
-            mnpair.second.Check(fForce);
-            return;
+    // VELES BEGIN
+    //for (auto& mnpair : mapMasternodes) {
+    //    if (mnpair.second.pubKeyMasternode == pubKeyMasternode) {
+    //        mnpair.second.Check(fForce);
+    //        return;
+    //    }
+    //}
+    auto it = mapByPubKeyMasternode.find(pubKeyMasternode);
+    if (it != mapByPubKeyMasternode.end()) {
+        CMasternode& mn = mapMasternodes.at(*it->second.begin());
+        int nActiveStateOld = mn.nActiveState;
+        mn.Check(fForce);
+        if (mn.nActiveState != nActiveStateOld) {
+            ListChanged();
+            NotifyActiveMasternode(mn);
         }
     }
+    // VELES END
 }
 
 bool CMasternodeMan::IsMasternodePingedWithin(const COutPoint& outpoint, int nSeconds, int64_t nTimeToCheckAt)
@@ -1602,6 +2439,7 @@ void CMasternodeMan::SetMasternodeLastPing(const COutPoint& outpoint, const CMas
         return;
     }
     pmn->lastPing = mnp;
+    ListChanged(); // VELES
     // if masternode uses sentinel ping instead of watchdog
     // we shoud update nTimeLastWatchdogVote here if sentinel
     // ping flag is actual
@@ -1614,6 +2452,7 @@ void CMasternodeMan::SetMasternodeLastPing(const COutPoint& outpoint, const CMas
     uint256 hash = mnb.GetHash();
     if(mapSeenMasternodeBroadcast.count(hash)) {
         mapSeenMasternodeBroadcast[hash].second.lastPing = mnp;
+        ForgetRelayedInv(CInv(MSG_MASTERNODE_ANNOUNCE, hash)); // VELES
     }
 }
 
@@ -9,6 +9,8 @@
 #include <masternode/masternode.h>
 #include <sync.h>
 
+#include <unordered_map> // VELES
+
 using namespace std;
 
 class CMasternodeMan;
@@ -16,6 +18,11 @@ class CConnman;
 
 extern CMasternodeMan mnodeman;
 
+// VELES BEGIN
+//! most pings or payment votes sent in one "mnpingbundle" or "mnwbundle" message
+static const size_t MNBUNDLE_MAX_ENTRIES = 1000;
+// VELES END
+
 class CMasternodeMan
 {
 public:
@@ -30,6 +37,7 @@ private:
     static const int DSEG_UPDATE_SECONDS        = 3 * 60 * 60;
 
     static const int LAST_PAID_SCAN_BLOCKS      = 100;
+    static const int LAST_PAID_UNDO_BLOCKS      = 100; // VELES
 
     static const int MIN_POSE_PROTO_VERSION     = 70203;
     static const int MAX_POSE_CONNECTIONS       = 10;
@@ -42,6 +50,24 @@ private:
     static const int MNB_RECOVERY_WAIT_SECONDS      = 60;
     static const int MNB_RECOVERY_RETRY_SECONDS     = 3 * 60 * 60;
 
+    // VELES BEGIN
+    static const size_t MAX_SCORE_CACHE_SIZE        = 16;
+
+    static const int MNLISTDIFF_MAX_AGE_SECONDS     = 24 * 60 * 60;
+    static const int MNLISTDIFF_TIME_SLACK_SECONDS  = 60 * 60;
+    static const size_t MNLISTDIFF_MAX_ENTRIES      = 4000;
+
+    /// Masternode scores for one block hash and minimum protocol, and the rank of each outpoint
+    struct CMasternodeScores {
+        uint256 nBlockHash;
+        int nMinProtocol;
+        /// sorted from the highest score to the lowest
+        score_pair_vec_t vecScores;
+        /// sorted by outpoint
+        std::vector<std::pair<COutPoint, int> > vecRanks;
+    };
+    // VELES END
+
 
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
@@ -75,11 +101,69 @@ private:
 
     int64_t nLastWatchdogVoteTime;
 
+    // VELES BEGIN
+    /// Recently used masternode scores, most recent first, cleared whenever the masternode list changes
+    std::list<CMasternodeScores> listScoreCache;
+
+    /// Payment queue, the masternodes ordered by last paid block and then by collateral outpoint
+    std::set<std::pair<int, COutPoint> > setLastPaid;
+
+    /// Outpoints of the masternodes by masternode key and by collateral payee script
+    std::map<CPubKey, std::set<COutPoint> > mapByPubKeyMasternode;
+    std::unordered_map<CScript, std::set<COutPoint>, SaltedPayeeHasher> mapByPayee;
+    /// Outpoints of the masternodes by address, in address order for the duplicate address checks
+    std::map<CService, std::set<COutPoint> > mapByAddr;
+
+    /// Block hash our list was last synced at, sent with "getmnlistd" to only ask for the changes since
+    uint256 hashListDiffBase;
+    /// Collaterals of the recently removed masternodes and when they were removed, sent as hints in "mnlistdiff"
+    std::map<COutPoint, int64_t> mapRemovedTimes;
+    /// Bumped whenever a masternode is added, removed or changes what the masternode list shows of it
+    uint64_t nListVersion;
+    /// Memory the seen pings may use before the oldest ones are evicted, 0 for no limit
+    size_t nMaxSeenPingUsage;
+
+    /// Last paid block of a masternode before a block paid it
+    struct LastPaidUndo {
+        COutPoint outpoint;
+        int nBlockLastPaid;
+        int64_t nTimeLastPaid;
+    };
+    /// Undo of the last paid blocks, by height of the paying block, for the last LAST_PAID_UNDO_BLOCKS blocks
+    std::map<int, std::vector<LastPaidUndo> > mapLastPaidUndo;
+    /// Tip the last paid blocks are up to date with, nullptr until the first full scan
+    const CBlockIndex* pindexLastPaid;
+    /// Masternodes added since, whose last payment was not looked up yet
+    std::set<COutPoint> setLastPaidPending;
+
+    /// Move the last paid block of mn to nHeight, recording the undo
+    void SetLastPaid(CMasternode& mn, int nHeight, int64_t nTime);
+    /// Look up the last payment of mn in the nMaxBlocksToScanBack blocks up to pindex
+    void ScanLastPaid(CMasternode& mn, const CBlockIndex* pindex, int nMaxBlocksToScanBack);
+    /// Restore the last paid blocks of the masternodes paid above nHeight
+    void UndoLastPaid(int nHeight);
+
+    void ListChanged() { AssertLockHeld(cs); ++nListVersion; }
+    /// Let the active masternode know its entry changed when mn is ours
+    void NotifyActiveMasternode(const CMasternode& mn);
+    /// Index mn or remove it from the indexes, notifying the active masternode when mn is ours
+    void AddToIndexes(const CMasternode& mn, bool fNotify = true);
+    void RemoveFromIndexes(const CMasternode& mn);
+    void RebuildIndexes();
+    void ResetLastPaid() { AssertLockHeld(cs); mapLastPaidUndo.clear(); pindexLastPaid = nullptr; setLastPaidPending.clear(); }
+    void LimitSeenPings();
+    // VELES END
+
     friend class CMasternodeSync;
     /// Find an entry
     CMasternode* Find(const COutPoint& outpoint);
 
-    bool GetMasternodeScores(const uint256& nBlockHash, score_pair_vec_t& vecMasternodeScoresRet, int nMinProtocol = 0);
+    // VELES BEGIN
+    //bool GetMasternodeScores(const uint256& nBlockHash, score_pair_vec_t& vecMasternodeScoresRet, int nMinProtocol = 0);
+    /// Return the cached scores for nBlockHash, computing them on a miss, or NULL when there are none
+    const CMasternodeScores* GetMasternodeScores(const uint256& nBlockHash, int nMinProtocol = 0);
+    void InvalidateScoreCache() { AssertLockHeld(cs); listScoreCache.clear(); }
+    // VELES END
 
 public:
     // Keep track of all broadcasts I've seen
@@ -117,9 +201,20 @@ public:
 
         READWRITE(mapSeenMasternodeBroadcast);
         READWRITE(mapSeenMasternodePing);
+        // VELES BEGIN
+        READWRITE(hashListDiffBase);
+        // VELES END
         if(ser_action.ForRead() && (strVersion != SERIALIZATION_VERSION_STRING)) {
             Clear();
         }
+        // VELES BEGIN
+        if(ser_action.ForRead()) {
+            InvalidateScoreCache();
+            RebuildIndexes();
+            ListChanged();
+            ResetLastPaid();
+        }
+        // VELES END
     }
 
     CMasternodeMan();
@@ -157,10 +252,20 @@ public:
     // int CountByIP(int nNetworkType);
 
     void DsegUpdate(CNode* pnode, CConnman& connman);
+    // VELES BEGIN
+    /// Ask (source) node for the masternode list changes since the last sync, or the whole list
+    void ListDiffUpdate(CNode* pnode, CConnman& connman);
+    /// Remember the current tip as the base of the next list diff, called once the list is synced
+    void ListDiffSynced();
+    // VELES END
 
     /// Versions of Find that are safe to use from outside the class
     bool Get(const COutPoint& outpoint, CMasternode& masternodeRet);
     bool Has(const COutPoint& outpoint);
+    // VELES BEGIN
+    /// Whether an enabled masternode with the IP address was verified to run at its address
+    bool HasVerifiedAtIP(const CNetAddr& addr);
+    // VELES END
 
     bool GetMasternodeInfo(const COutPoint& outpoint, masternode_info_t& mnInfoRet);
     bool GetMasternodeInfo(const CPubKey& pubKeyMasternode, masternode_info_t& mnInfoRet);
@@ -174,7 +279,15 @@ public:
     /// Find a random entry
     masternode_info_t FindRandomNotInVec(const std::vector<COutPoint> &vecToExclude, int nProtocolVersion = -1);
 
-    std::map<COutPoint, CMasternode> GetFullMasternodeMap() { return mapMasternodes; }
+    //std::map<COutPoint, CMasternode> GetFullMasternodeMap() { return mapMasternodes; }
+    // VELES BEGIN
+    std::map<COutPoint, CMasternode> GetFullMasternodeMap() { LOCK(cs); return mapMasternodes; }
+    /// Same as above, along with the version of the list the copy was taken at
+    std::map<COutPoint, CMasternode> GetFullMasternodeMap(uint64_t& nListVersionRet) { LOCK(cs); nListVersionRet = nListVersion; return mapMasternodes; }
+    uint64_t GetListVersion() const { LOCK(cs); return nListVersion; }
+    /// The info of every masternode in collateral order, along with the version of the list
+    std::vector<masternode_info_t> GetMasternodeInfos(uint64_t& nListVersionRet);
+    // VELES END
 
     bool GetMasternodeRanks(rank_pair_vec_t& vecMasternodeRanksRet, int nBlockHeight = -1, int nMinProtocol = 0);
     bool GetMasternodeRank(const COutPoint &outpoint, int& nRankRet, int nBlockHeight = -1, int nMinProtocol = 0);
@@ -183,10 +296,18 @@ public:
     std::pair<CService, std::set<uint256> > PopScheduledMnbRequestConnection();
 
     void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman);
+    // VELES BEGIN
+    void ProcessPing(CNode* pfrom, CMasternodePing& mnp, CConnman& connman);
+    // VELES END
 
     void DoFullVerificationStep(CConnman& connman);
     void CheckSameAddr();
-    bool SendVerifyRequest(const CAddress& addr, const std::vector<CMasternode*>& vSortedByAddr, CConnman& connman);
+    //bool SendVerifyRequest(const CAddress& addr, const std::vector<CMasternode*>& vSortedByAddr, CConnman& connman);
+    //bool SendVerifyRequest(const CAddress& addr, CConnman& connman);
+    // VELES BEGIN
+    /// Connect to all the addresses at once and ask them to verify themselves, returns the number of requests sent
+    int SendVerifyRequests(const std::vector<CAddress>& vecAddrs, CConnman& connman);
+    // VELES END
     void SendVerifyReply(CNode* pnode, CMasternodeVerification& mnv, CConnman& connman);
     void ProcessVerifyReply(CNode* pnode, CMasternodeVerification& mnv);
     void ProcessVerifyBroadcast(CNode* pnode, const CMasternodeVerification& mnv);
@@ -196,12 +317,23 @@ public:
 
     std::string ToString() const;
 
+    // VELES BEGIN
+    /// Memory used by the masternode list, its indexes and caches and the seen messages
+    size_t DynamicMemoryUsage() const;
+    void SetMaxSeenPingUsage(size_t nMaxSeenPingUsageIn);
+    // VELES END
+
     /// Update masternode list and maps using provided CMasternodeBroadcast
     void UpdateMasternodeList(CMasternodeBroadcast mnb, CConnman& connman);
     /// Perform complete check and only then update list and maps
     bool CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBroadcast mnb, int& nDos, CConnman& connman);
     bool IsMnbRecoveryRequested(const uint256& hash) { return mMnbRecoveryRequests.count(hash); }
 
+    // VELES BEGIN
+    /// Bring the last paid blocks up to pindex: the payments of the blocks disconnected since the last
+    /// update are undone and only the blocks connected since are read. The first update, and those
+    /// after a reorg deeper than LAST_PAID_UNDO_BLOCKS, scan the payments of every masternode.
+    // VELES END
     void UpdateLastPaid(const CBlockIndex* pindex);
 
     void AddDirtyGovernanceObjectHash(const uint256& nHash)
@@ -230,6 +362,13 @@ public:
 
     void UpdatedBlockTip(const CBlockIndex *pindex);
 
+    // VELES BEGIN
+    /// Flag the masternodes whose collateral is spent by the block
+    void BlockConnected(const CBlock& block);
+    /// Flag the masternodes whose collateral was created by the block
+    void BlockDisconnected(const CBlock& block);
+    // VELES END
+
     /**
      * Called to notify CGovernanceManager that the masternode index has been updated.
      * Must be called while not holding the CMasternodeMan::cs mutex
@@ -3,6 +3,9 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <crypto/sha256.h> // VELES
+#include <crypto/siphash.h> // VELES
+#include <index/payeeindex.h>
 #include <init.h>
 #include <key_io.h>
 #include <netbase.h>
@@ -12,6 +15,7 @@
 #include <masternode/sync.h>
 #include <masternode/manager.h>
 #include <messagesigner.h>
+#include <random.h> // VELES
 #include <script/standard.h>
 // FXTC BEGIN
 #include <shutdown.h>
@@ -23,6 +27,23 @@
 
 #include <boost/lexical_cast.hpp>
 
+#include <limits> // VELES
+
+
+// VELES BEGIN
+uint64_t GetPayeeHash(const CScript& script)
+{
+    static const uint64_t k0 = GetRand(std::numeric_limits<uint64_t>::max());
+    static const uint64_t k1 = GetRand(std::numeric_limits<uint64_t>::max());
+    return CSipHasher(k0, k1).Write(script.data(), script.size()).Finalize();
+}
+
+void masternode_info_t::SetPayee()
+{
+    payeeScript = GetScriptForDestination(pubKeyCollateralAddress.GetID());
+    nPayeeHash = GetPayeeHash(payeeScript);
+}
+// VELES END
 
 CMasternode::CMasternode() :
     masternode_info_t{ MASTERNODE_ENABLED, PROTOCOL_VERSION, GetAdjustedTime()},
@@ -100,11 +121,58 @@ bool CMasternode::UpdateFromNewBroadcast(CMasternodeBroadcast& mnb, CConnman& co
 arith_uint256 CMasternode::CalculateScore(const uint256& blockHash)
 {
     // Deterministically calculate a "score" for a Masternode based on any given (block)hash
-    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
-    ss << vin.prevout << nCollateralMinConfBlockHash << blockHash;
-    return UintToArith256(ss.GetHash());
+    // CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    // ss << vin.prevout << nCollateralMinConfBlockHash << blockHash;
+    // return UintToArith256(ss.GetHash());
+    // VELES BEGIN
+    // The hash of vin.prevout, nCollateralMinConfBlockHash and blockHash serialized as above, the
+    // first two are written once for all the scores of the masternode
+    LOCK(cs);
+    if (!fScoreHasherValid || outpointScoreHasher != vin.prevout || hashScoreHasherConfBlock != nCollateralMinConfBlockHash) {
+        unsigned char vchIndex[4];
+        WriteLE32(vchIndex, vin.prevout.n);
+        scoreHasher.Reset();
+        scoreHasher.Write(vin.prevout.hash.begin(), vin.prevout.hash.size());
+        scoreHasher.Write(vchIndex, sizeof(vchIndex));
+        scoreHasher.Write(nCollateralMinConfBlockHash.begin(), nCollateralMinConfBlockHash.size());
+        outpointScoreHasher = vin.prevout;
+        hashScoreHasherConfBlock = nCollateralMinConfBlockHash;
+        fScoreHasherValid = true;
+    }
+    CHash256 hasher(scoreHasher);
+    uint256 hash;
+    hasher.Write(blockHash.begin(), blockHash.size()).Finalize(hash.begin());
+    return UintToArith256(hash);
+    // VELES END
 }
 
+// VELES BEGIN
+void CMasternode::CalculateScores(const std::vector<CMasternode*>& vecMasternodes, const uint256& blockHash, std::vector<arith_uint256>& vecScoresRet)
+{
+    // The same 100 byte messages as CalculateScore(), all double hashed at once
+    static const size_t SCORE_MESSAGE_SIZE = 100;
+    vecScoresRet.clear();
+    if (vecMasternodes.empty()) return;
+
+    std::vector<unsigned char> vchMessages(vecMasternodes.size() * SCORE_MESSAGE_SIZE);
+    for (size_t i = 0; i < vecMasternodes.size(); i++) {
+        CMasternode* pmn = vecMasternodes[i];
+        unsigned char* pch = vchMessages.data() + i * SCORE_MESSAGE_SIZE;
+        LOCK(pmn->cs);
+        memcpy(pch, pmn->vin.prevout.hash.begin(), 32);
+        WriteLE32(pch + 32, pmn->vin.prevout.n);
+        memcpy(pch + 36, pmn->nCollateralMinConfBlockHash.begin(), 32);
+        memcpy(pch + 68, blockHash.begin(), 32);
+    }
+
+    std::vector<uint256> vHashes(vecMasternodes.size());
+    SHA256DN(vHashes[0].begin(), vchMessages.data(), SCORE_MESSAGE_SIZE, vHashes.size());
+    vecScoresRet.reserve(vHashes.size());
+    for (const uint256& hash : vHashes)
+        vecScoresRet.push_back(UintToArith256(hash));
+}
+// VELES END
+
 CMasternode::CollateralStatus CMasternode::CheckCollateral(const COutPoint& outpoint)
 {
     int nHeight;
@@ -165,12 +233,20 @@ void CMasternode::Check(bool fForce)
         TRY_LOCK(cs_main, lockMain);
         if(!lockMain) return;
 
-        CollateralStatus err = CheckCollateral(vin.prevout);
-        if (err == COLLATERAL_UTXO_NOT_FOUND) {
-            nActiveState = MASTERNODE_OUTPOINT_SPENT;
-            LogPrint(BCLog::MASTERNODE, "CMasternode::Check -- Failed to find Masternode UTXO, masternode=%s\n", vin.prevout.ToStringShort());
-            return;
+        // VELES BEGIN
+        // The collateral can only disappear from the UTXO set through a block
+        // touching it, the masternode manager flags those in BlockConnected()
+        // and BlockDisconnected()
+        if (fForce || fCollateralCheckRequired) {
+            CollateralStatus err = CheckCollateral(vin.prevout);
+            if (err == COLLATERAL_UTXO_NOT_FOUND) {
+                nActiveState = MASTERNODE_OUTPOINT_SPENT;
+                LogPrint(BCLog::MASTERNODE, "CMasternode::Check -- Failed to find Masternode UTXO, masternode=%s\n", vin.prevout.ToStringShort());
+                return;
+            }
+            fCollateralCheckRequired = false;
         }
+        // VELES END
 
         nHeight = chainActive.Height();
     }
@@ -267,21 +343,29 @@ void CMasternode::Check(bool fForce)
 
 bool CMasternode::IsInputAssociatedWithPubkey()
 {
-    CScript payee;
-    payee = GetScriptForDestination(pubKeyCollateralAddress.GetID());
-
-    CTransactionRef tx;
-    uint256 hash;
-    if(GetTransaction(vin.prevout.hash, tx, Params().GetConsensus(), hash)) {
-        // FXTC BEGIN
-        //for (auto out : tx->vout)
-        //    if(out.nValue == 1000*COIN && out.scriptPubKey == payee) return true;
-        for(unsigned int i = 0; i < tx->vout.size(); ++i)
-            if(CheckCollateral(COutPoint(tx->GetHash(),i)) == COLLATERAL_OK && tx->vout[i].scriptPubKey == payee) return true;
-        // FXTC END
-    }
-
-    return false;
+    //CScript payee;
+    //payee = GetScriptForDestination(pubKeyCollateralAddress.GetID());
+    const CScript& payee = payeeScript; // VELES
+
+    // VELES BEGIN
+    // The collateral is unspent, its coin tells whom it pays without the
+    // transaction index, which pruned nodes don't have
+    //CTransactionRef tx;
+    //uint256 hash;
+    //if(GetTransaction(vin.prevout.hash, tx, Params().GetConsensus(), hash)) {
+    //    // FXTC BEGIN
+    //    //for (auto out : tx->vout)
+    //    //    if(out.nValue == 1000*COIN && out.scriptPubKey == payee) return true;
+    //    for(unsigned int i = 0; i < tx->vout.size(); ++i)
+    //        if(CheckCollateral(COutPoint(tx->GetHash(),i)) == COLLATERAL_OK && tx->vout[i].scriptPubKey == payee) return true;
+    //    // FXTC END
+    //}
+    //
+    //return false;
+    LOCK(cs_main);
+    Coin coin;
+    return GetUTXOCoin(vin.prevout, coin) && coin.out.scriptPubKey == payee;
+    // VELES END
 }
 
 bool CMasternode::IsValidNetAddr()
@@ -337,33 +421,48 @@ void CMasternode::UpdateLastPaid(const CBlockIndex *pindex, int nMaxBlocksToScan
 
     const CBlockIndex *BlockReading = pindex;
 
-    CScript mnpayee = GetScriptForDestination(pubKeyCollateralAddress.GetID());
+    //CScript mnpayee = GetScriptForDestination(pubKeyCollateralAddress.GetID());
+    const CScript& mnpayee = payeeScript; // VELES
     // LogPrint(BCLog::MASTERNODE, "CMasternode::UpdateLastPaidBlock -- searching for block with payment to %s\n", vin.prevout.ToStringShort());
 
     LOCK(cs_mapMasternodeBlocks);
 
-    for (int i = 0; BlockReading && BlockReading->nHeight > nBlockLastPaid && i < nMaxBlocksToScanBack; i++) {
-        if(mnpayments.mapMasternodeBlocks.count(BlockReading->nHeight) &&
-            mnpayments.mapMasternodeBlocks[BlockReading->nHeight].HasPayeeWithVotes(mnpayee, 2))
+    // VELES BEGIN
+    //for (int i = 0; BlockReading && BlockReading->nHeight > nBlockLastPaid && i < nMaxBlocksToScanBack; i++) {
+    //    if(mnpayments.mapMasternodeBlocks.count(BlockReading->nHeight) &&
+    //        mnpayments.mapMasternodeBlocks[BlockReading->nHeight].HasPayeeWithVotes(mnpayee, 2))
+    //    {
+    //        CBlock block;
+    //        if(!ReadBlockFromDisk(block, BlockReading, Params().GetConsensus())) // shouldn't really happen
+    //            continue;
+    //
+    //        CAmount nMasternodePayment = GetMasternodePayment(BlockReading->nHeight, block.vtx[0]->GetValueOut());
+    //
+    //        for (auto txout : block.vtx[0]->vout)
+    //            if(mnpayee == txout.scriptPubKey && nMasternodePayment == txout.nValue) {
+    //                nBlockLastPaid = BlockReading->nHeight;
+    //                nTimeLastPaid = BlockReading->nTime;
+    //                LogPrint(BCLog::MASTERNODE, "CMasternode::UpdateLastPaidBlock -- searching for block with payment to %s -- found new %d\n", vin.prevout.ToStringShort(), nBlockLastPaid);
+    //                return;
+    //            }
+    //    }
+    //
+    //    if (BlockReading->pprev == NULL) { assert(BlockReading); break; }
+    //    BlockReading = BlockReading->pprev;
+    //}
+    // The payee index only holds the blocks whose coinbase actually paid the masternode reward to this payee
+    int nMinHeight = std::max(nBlockLastPaid, BlockReading->nHeight - nMaxBlocksToScanBack);
+    for (int nHeight : g_payee_index.GetPayments(mnpayee, BlockReading, nMinHeight)) {
+        if(mnpayments.mapMasternodeBlocks.count(nHeight) &&
+            mnpayments.mapMasternodeBlocks[nHeight].HasPayeeWithVotes(mnpayee, nPayeeHash, 2))
         {
-            CBlock block;
-            if(!ReadBlockFromDisk(block, BlockReading, Params().GetConsensus())) // shouldn't really happen
-                continue;
-
-            CAmount nMasternodePayment = GetMasternodePayment(BlockReading->nHeight, block.vtx[0]->GetValueOut());
-
-            for (auto txout : block.vtx[0]->vout)
-                if(mnpayee == txout.scriptPubKey && nMasternodePayment == txout.nValue) {
-                    nBlockLastPaid = BlockReading->nHeight;
-                    nTimeLastPaid = BlockReading->nTime;
-                    LogPrint(BCLog::MASTERNODE, "CMasternode::UpdateLastPaidBlock -- searching for block with payment to %s -- found new %d\n", vin.prevout.ToStringShort(), nBlockLastPaid);
-                    return;
-                }
+            nBlockLastPaid = nHeight;
+            nTimeLastPaid = BlockReading->GetAncestor(nHeight)->nTime;
+            LogPrint(BCLog::MASTERNODE, "CMasternode::UpdateLastPaidBlock -- searching for block with payment to %s -- found new %d\n", vin.prevout.ToStringShort(), nBlockLastPaid);
+            return;
         }
-
-        if (BlockReading->pprev == NULL) { assert(BlockReading); break; }
-        BlockReading = BlockReading->pprev;
     }
+    // VELES END
 
     // Last payment for this masternode wasn't found in latest mnpayments blocks
     // or it was found in mnpayments blocks but wasn't found in the blockchain.
@@ -475,8 +574,9 @@ bool CMasternodeBroadcast::SimpleCheck(int& nDos)
         return false;
     }
 
-    CScript pubkeyScript;
-    pubkeyScript = GetScriptForDestination(pubKeyCollateralAddress.GetID());
+    //CScript pubkeyScript;
+    //pubkeyScript = GetScriptForDestination(pubKeyCollateralAddress.GetID());
+    const CScript& pubkeyScript = payeeScript; // VELES
 
     if(pubkeyScript.size() != 25) {
         LogPrintf("CMasternodeBroadcast::SimpleCheck -- pubKeyCollateralAddress has the wrong size\n");
@@ -616,15 +716,24 @@ bool CMasternodeBroadcast::CheckOutpoint(int& nDos)
 
     // verify that sig time is legit in past
     // should be at least not earlier than block when masternode collateral tx got nMasternodeMinimumConfirmations
-    uint256 hashBlock = uint256();
-    CTransactionRef tx2;
-    GetTransaction(vin.prevout.hash, tx2, Params().GetConsensus(), hashBlock);
+    // VELES BEGIN
+    // The block where the collateral got its confirmations was found above
+    //uint256 hashBlock = uint256();
+    //CTransactionRef tx2;
+    //GetTransaction(vin.prevout.hash, tx2, Params().GetConsensus(), hashBlock);
+    // VELES END
     {
         LOCK(cs_main);
-        BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
+        // VELES BEGIN
+        //BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
+        BlockMap::iterator mi = mapBlockIndex.find(nCollateralMinConfBlockHash);
+        // VELES END
         if (mi != mapBlockIndex.end() && (*mi).second) {
-            CBlockIndex* pMNIndex = (*mi).second; // block for masternode collateral tx -> 1 confirmation
-            CBlockIndex* pConfIndex = chainActive[pMNIndex->nHeight + Params().GetConsensus().nMasternodeMinimumConfirmations - 1]; // block where tx got nMasternodeMinimumConfirmations
+            // VELES BEGIN
+            //CBlockIndex* pMNIndex = (*mi).second; // block for masternode collateral tx -> 1 confirmation
+            //CBlockIndex* pConfIndex = chainActive[pMNIndex->nHeight + Params().GetConsensus().nMasternodeMinimumConfirmations - 1]; // block where tx got nMasternodeMinimumConfirmations
+            CBlockIndex* pConfIndex = (*mi).second; // block where tx got nMasternodeMinimumConfirmations
+            // VELES END
             if(pConfIndex->GetBlockTime() > sigTime) {
                 LogPrintf("CMasternodeBroadcast::CheckOutpoint -- Bad sigTime %d (%d conf block is at %d) for Masternode %s %s\n",
                           sigTime, Params().GetConsensus().nMasternodeMinimumConfirmations, pConfIndex->GetBlockTime(), vin.prevout.ToStringShort(), addr.ToString());
@@ -642,6 +751,9 @@ bool CMasternodeBroadcast::Sign(const CKey& keyCollateralAddress)
     std::string strMessage;
 
     sigTime = GetAdjustedTime();
+    // VELES BEGIN
+    fSignatureChecked = false;
+    // VELES END
 
     strMessage = addr.ToString(false) + boost::lexical_cast<std::string>(sigTime) +
                     pubKeyCollateralAddress.GetID().ToString() + pubKeyMasternode.GetID().ToString() +
@@ -666,6 +778,10 @@ bool CMasternodeBroadcast::CheckSignature(int& nDos)
     std::string strError = "";
     nDos = 0;
 
+    // VELES BEGIN
+    if (fSignatureChecked) return true;
+    // VELES END
+
     strMessage = addr.ToString(false) + boost::lexical_cast<std::string>(sigTime) +
                     pubKeyCollateralAddress.GetID().ToString() + pubKeyMasternode.GetID().ToString() +
                     boost::lexical_cast<std::string>(nProtocolVersion);
@@ -681,6 +797,17 @@ bool CMasternodeBroadcast::CheckSignature(int& nDos)
     return true;
 }
 
+// VELES BEGIN
+uint256 CMasternodeBroadcast::GetSignatureHash() const
+{
+    std::string strMessage = addr.ToString(false) + boost::lexical_cast<std::string>(sigTime) +
+                    pubKeyCollateralAddress.GetID().ToString() + pubKeyMasternode.GetID().ToString() +
+                    boost::lexical_cast<std::string>(nProtocolVersion);
+
+    return CMessageSigner::GetMessageHash(strMessage);
+}
+// VELES END
+
 void CMasternodeBroadcast::Relay(CConnman& connman)
 {
     // Do not relay until fully synced
@@ -690,7 +817,13 @@ void CMasternodeBroadcast::Relay(CConnman& connman)
     }
 
     CInv inv(MSG_MASTERNODE_ANNOUNCE, GetHash());
-    connman.RelayInv(inv);
+    //connman.RelayInv(inv);
+    // VELES BEGIN
+    CScratchDataStream ss(SER_NETWORK, PROTOCOL_VERSION); // VELES
+    ss.reserve(1000);
+    ss << *this;
+    connman.RelayInv(inv, ss);
+    // VELES END
 }
 
 CMasternodePing::CMasternodePing(const COutPoint& outpoint)
@@ -710,6 +843,9 @@ bool CMasternodePing::Sign(const CKey& keyMasternode, const CPubKey& pubKeyMaste
 
     // TODO: add sentinel data
     sigTime = GetAdjustedTime();
+    // VELES BEGIN
+    pubKeySignatureChecked = CPubKey();
+    // VELES END
     std::string strMessage = vin.ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
 
     if(!CMessageSigner::SignMessage(strMessage, vchSig, keyMasternode)) {
@@ -732,6 +868,10 @@ bool CMasternodePing::CheckSignature(CPubKey& pubKeyMasternode, int &nDos)
     std::string strError = "";
     nDos = 0;
 
+    // VELES BEGIN
+    if (pubKeySignatureChecked.IsValid() && pubKeySignatureChecked == pubKeyMasternode) return true;
+    // VELES END
+
     if(!CMessageSigner::VerifyMessage(pubKeyMasternode, vchSig, strMessage, strError)) {
         LogPrintf("CMasternodePing::CheckSignature -- Got bad Masternode ping signature, masternode=%s, error: %s\n", vin.prevout.ToStringShort(), strError);
         nDos = 33;
@@ -740,6 +880,16 @@ bool CMasternodePing::CheckSignature(CPubKey& pubKeyMasternode, int &nDos)
     return true;
 }
 
+// VELES BEGIN
+uint256 CMasternodePing::GetSignatureHash() const
+{
+    // TODO: add sentinel data
+    std::string strMessage = vin.ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
+
+    return CMessageSigner::GetMessageHash(strMessage);
+}
+// VELES END
+
 bool CMasternodePing::SimpleCheck(int& nDos)
 {
     // don't ban by default
@@ -839,6 +989,7 @@ bool CMasternodePing::CheckAndUpdate(CMasternode* pmn, bool fFromNewBroadcast, i
     uint256 hash = mnb.GetHash();
     if (mnodeman.mapSeenMasternodeBroadcast.count(hash)) {
         mnodeman.mapSeenMasternodeBroadcast[hash].second.lastPing = *this;
+        ForgetRelayedInv(CInv(MSG_MASTERNODE_ANNOUNCE, hash)); // VELES
     }
 
     // force update, ignoring cache
@@ -861,7 +1012,13 @@ void CMasternodePing::Relay(CConnman& connman)
     }
 
     CInv inv(MSG_MASTERNODE_PING, GetHash());
-    connman.RelayInv(inv);
+    //connman.RelayInv(inv);
+    // VELES BEGIN
+    CScratchDataStream ss(SER_NETWORK, PROTOCOL_VERSION); // VELES
+    ss.reserve(1000);
+    ss << *this;
+    connman.RelayInv(inv, ss);
+    // VELES END
 }
 
 void CMasternode::AddGovernanceVote(uint256 nGovernanceObjectHash)
@@ -6,6 +6,7 @@
 #ifndef DASH_MASTERNODE_MASTERNODE_H
 #define DASH_MASTERNODE_MASTERNODE_H
 
+#include <hash.h> // VELES
 #include <key.h>
 #include <validation.h>
 #include <spork.h>
@@ -40,6 +41,10 @@ public:
     bool fSentinelIsCurrent = false; // true if last sentinel ping was actual
     // MSB is always 0, other 3 bits corresponds to x.x.x version scheme
     uint32_t nSentinelVersion{DEFAULT_SENTINEL_VERSION};
+    // VELES BEGIN
+    // memory only, the masternode key vchSig was already verified against
+    CPubKey pubKeySignatureChecked{};
+    // VELES END
 
     CMasternodePing() = default;
 
@@ -75,6 +80,9 @@ public:
 
     bool Sign(const CKey& keyMasternode, const CPubKey& pubKeyMasternode);
     bool CheckSignature(CPubKey& pubKeyMasternode, int &nDos);
+    // VELES BEGIN
+    uint256 GetSignatureHash() const;
+    // VELES END
     bool SimpleCheck(int& nDos);
     bool CheckAndUpdate(CMasternode* pmn, bool fFromNewBroadcast, int& nDos, CConnman& connman);
     void Relay(CConnman& connman);
@@ -89,6 +97,16 @@ inline bool operator!=(const CMasternodePing& a, const CMasternodePing& b)
     return !(a == b);
 }
 
+// VELES BEGIN
+/** Salted 64-bit hash of a payee script, scripts are only compared in full when their hashes match */
+uint64_t GetPayeeHash(const CScript& script);
+
+struct SaltedPayeeHasher
+{
+    size_t operator()(const CScript& script) const { return GetPayeeHash(script); }
+};
+// VELES END
+
 struct masternode_info_t
 {
     // Note: all these constructors can be removed once C++14 is enabled.
@@ -106,7 +124,8 @@ struct masternode_info_t
         nActiveState{activeState}, nProtocolVersion{protoVer}, sigTime{sTime},
         vin{outpoint}, addr{addr},
         pubKeyCollateralAddress{pkCollAddr}, pubKeyMasternode{pkMN},
-        nTimeLastWatchdogVote{tWatchdogV} {}
+        //nTimeLastWatchdogVote{tWatchdogV} {}
+        nTimeLastWatchdogVote{tWatchdogV} { SetPayee(); } // VELES
 
     int nActiveState = 0;
     int nProtocolVersion = 0;
@@ -123,6 +142,16 @@ struct masternode_info_t
     int64_t nTimeLastPaid = 0;
     int64_t nTimeLastPing = 0; //* not in CMN
     bool fInfoValid = false; //* not in CMN
+    // VELES BEGIN
+    //! (memory only) Script paying pubKeyCollateralAddress and its GetPayeeHash()
+    CScript payeeScript{};
+    uint64_t nPayeeHash = 0;
+
+    /// Compute the payee script again, whenever pubKeyCollateralAddress is set
+    void SetPayee();
+    /// Does the script, whose GetPayeeHash() is nHash, pay this masternode?
+    bool IsPayee(const CScript& script, uint64_t nHash) const { return nHash == nPayeeHash && script == payeeScript; }
+    // VELES END
 };
 
 //
@@ -134,6 +163,14 @@ class CMasternode : public masternode_info_t
 private:
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
+    // VELES BEGIN
+    // (memory only) Score hasher with the collateral outpoint and the confirmation block hash
+    // written. Their first SHA256 block is compressed once, not for every score.
+    bool fScoreHasherValid = false;
+    COutPoint outpointScoreHasher;
+    uint256 hashScoreHasherConfBlock;
+    CHash256 scoreHasher;
+    // VELES END
 
 public:
     enum state {
@@ -163,6 +200,10 @@ public:
     int nPoSeBanHeight{};
     bool fAllowMixingTx{};
     bool fUnitTest = false;
+    // VELES BEGIN
+    //! (memory only) Set until the collateral was looked up, and again whenever a block touches it
+    bool fCollateralCheckRequired = true;
+    // VELES END
 
     // KEEP TRACK OF GOVERNANCE ITEMS EACH MASTERNODE HAS VOTE UPON FOR RECALCULATION
     std::map<uint256, int> mapGovernanceObjectsVotedOn;
@@ -197,10 +238,18 @@ public:
         READWRITE(fAllowMixingTx);
         READWRITE(fUnitTest);
         READWRITE(mapGovernanceObjectsVotedOn);
+        // VELES BEGIN
+        if (ser_action.ForRead())
+            SetPayee();
+        // VELES END
     }
 
     // CALCULATE A RANK AGAINST OF GIVEN BLOCK
     arith_uint256 CalculateScore(const uint256& blockHash);
+    // VELES BEGIN
+    /** The scores of many masternodes against the same block, hashed in batches of 4 or 8 when the CPU allows */
+    static void CalculateScores(const std::vector<CMasternode*>& vecMasternodes, const uint256& blockHash, std::vector<arith_uint256>& vecScoresRet);
+    // VELES END
 
     bool UpdateFromNewBroadcast(CMasternodeBroadcast& mnb, CConnman& connman);
 
@@ -208,11 +257,19 @@ public:
     static CollateralStatus CheckCollateral(const COutPoint& outpoint, int& nHeightRet);
 
     // FXTC BEGIN
-    bool CollateralValueCheck(int nHeight, CAmount TxValue);
-    CAmount CollateralValue(int nHeight);
+    //bool CollateralValueCheck(int nHeight, CAmount TxValue);
+    //CAmount CollateralValue(int nHeight);
     // FXTC END
+    // VELES BEGIN
+    static bool CollateralValueCheck(int nHeight, CAmount TxValue);
+    static CAmount CollateralValue(int nHeight);
+    // VELES END
 
     void Check(bool fForce = false);
+    // VELES BEGIN
+    /// Look the collateral up again on the next Check(), a block spent or disconnected it
+    void SetCollateralCheckRequired() { LOCK(cs); fCollateralCheckRequired = true; }
+    // VELES END
 
     bool IsBroadcastedWithin(int nSeconds) { return GetAdjustedTime() - sigTime < nSeconds; }
 
@@ -322,6 +379,10 @@ class CMasternodeBroadcast : public CMasternode
 public:
 
     bool fRecovery;
+    // VELES BEGIN
+    // memory only, vchSig was already verified
+    bool fSignatureChecked = false;
+    // VELES END
 
     CMasternodeBroadcast() : CMasternode(), fRecovery(false) {}
     CMasternodeBroadcast(const CMasternode& mn) : CMasternode(mn), fRecovery(false) {}
@@ -340,6 +401,10 @@ public:
         READWRITE(sigTime);
         READWRITE(nProtocolVersion);
         READWRITE(lastPing);
+        // VELES BEGIN
+        if (ser_action.ForRead())
+            SetPayee();
+        // VELES END
     }
 
     uint256 GetHash() const
@@ -361,6 +426,9 @@ public:
 
     bool Sign(const CKey& keyCollateralAddress);
     bool CheckSignature(int& nDos);
+    // VELES BEGIN
+    uint256 GetSignatureHash() const;
+    // VELES END
     void Relay(CConnman& connman);
 };
 
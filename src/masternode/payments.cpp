@@ -3,6 +3,7 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <core_memusage.h> // VELES
 #include <governance/classes.h>
 #include <masternode/activemasternode.h>
 #include <masternode/payments.h>
@@ -13,9 +14,12 @@
 #include <netmessagemaker.h>
 #include <spork.h>
 #include <util/system.h>
+#include <validation.h> // VELES
 
 #include <boost/lexical_cast.hpp>
 
+#include <limits> // VELES
+
 // FXTC BEGIN
 extern void Misbehaving(NodeId nodeid, int howmuch, const std::string& message="");
 // FXTC END
@@ -105,7 +109,13 @@ bool IsBlockValueValid(const CBlock& block, int nBlockHeight, CAmount blockRewar
 
     if(sporkManager.IsSporkActive(SPORK_9_SUPERBLOCKS_ENABLED)) {
         if(CSuperblockManager::IsSuperblockTriggered(nBlockHeight)) {
-            if(CSuperblockManager::IsValid(block.vtx[0], nBlockHeight, blockReward, block.GetBlockHeader())) {
+            // VELES BEGIN
+            //if(CSuperblockManager::IsValid(block.vtx[0], nBlockHeight, blockReward, block.GetBlockHeader())) {
+            int64_t nTimeStart = GetTimeMicros();
+            bool fValid = CSuperblockManager::IsValid(block.vtx[0], nBlockHeight, blockReward, block.GetBlockHeader());
+            RecordValidationPhase(ValidationPhase::SUPERBLOCK, GetTimeMicros() - nTimeStart);
+            if(fValid) {
+            // VELES END
                 LogPrint(BCLog::GOBJECT, "IsBlockValueValid -- Valid superblock at height %d: %s\n", nBlockHeight, block.vtx[0]->ToString());
                 // all checks are done in CSuperblock::IsValid, nothing to do here
                 return true;
@@ -187,7 +197,13 @@ bool IsBlockPayeeValid(const CTransactionRef txNew, int nBlockHeight, CAmount bl
 
     if(sporkManager.IsSporkActive(SPORK_9_SUPERBLOCKS_ENABLED)) {
         if(CSuperblockManager::IsSuperblockTriggered(nBlockHeight)) {
-            if(CSuperblockManager::IsValid(txNew, nBlockHeight, blockReward, pblock)) {
+            // VELES BEGIN
+            //if(CSuperblockManager::IsValid(txNew, nBlockHeight, blockReward, pblock)) {
+            int64_t nTimeStart = GetTimeMicros();
+            bool fValid = CSuperblockManager::IsValid(txNew, nBlockHeight, blockReward, pblock);
+            RecordValidationPhase(ValidationPhase::SUPERBLOCK, GetTimeMicros() - nTimeStart);
+            if(fValid) {
+            // VELES END
                 LogPrint(BCLog::GOBJECT, "IsBlockPayeeValid -- Valid superblock at height %d: %s\n", nBlockHeight, txNew->ToString());
                 return true;
             }
@@ -250,7 +266,9 @@ void CMasternodePayments::Clear()
 {
     LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
     mapMasternodeBlocks.clear();
-    mapMasternodePaymentVotes.clear();
+    // mapMasternodePaymentVotes.clear();
+    mapMasternodePaymentVotes.Clear(); // VELES
+    mapRangeRequests.clear(); // VELES
 }
 
 bool CMasternodePayments::CanVote(COutPoint outMasternode, int nBlockHeight)
@@ -281,15 +299,17 @@ void CMasternodePayments::FillBlockPayee(CMutableTransaction& txNew, int nBlockH
 
     if(!mnpayments.GetBlockPayee(nBlockHeight, payee)) {
         // no masternode detected...
-        int nCount = 0;
+        // int nCount = 0;
         masternode_info_t mnInfo;
-        if(!mnodeman.GetNextMasternodeInQueueForPayment(nBlockHeight, true, nCount, mnInfo)) {
+        // if(!mnodeman.GetNextMasternodeInQueueForPayment(nBlockHeight, true, nCount, mnInfo)) {
+        if(!GetExpectedPayee(nBlockHeight, mnInfo)) { // VELES
             // ...and we can't calculate it on our own
             LogPrintf("CMasternodePayments::FillBlockPayee -- Failed to detect masternode to pay\n");
             return;
         }
         // fill payee with locally calculated winner and hope for the best
-        payee = GetScriptForDestination(mnInfo.pubKeyCollateralAddress.GetID());
+        //payee = GetScriptForDestination(mnInfo.pubKeyCollateralAddress.GetID());
+        payee = mnInfo.payeeScript; // VELES
     }
 
     // GET MASTERNODE PAYMENT VARIABLES SETUP
@@ -328,14 +348,14 @@ void CMasternodePayments::ProcessMessage(CNode* pfrom, const std::string& strCom
         int nCountNeeded;
         vRecv >> nCountNeeded;
 
-        if(netfulfilledman.HasFulfilledRequest(pfrom->addr, NetMsgType::MASTERNODEPAYMENTSYNC)) {
+        if(netfulfilledman.HasFulfilledRequest(pfrom->addr, FULFILLED_MASTERNODEPAYMENTSYNC)) {
             LOCK(cs_main);
             // Asking for the payments list multiple times in a short period of time is no good
             LogPrintf("MASTERNODEPAYMENTSYNC -- peer already asked me for the list, peer=%d\n", pfrom->GetId());
             Misbehaving(pfrom->GetId(), 20);
             return;
         }
-        netfulfilledman.AddFulfilledRequest(pfrom->addr, NetMsgType::MASTERNODEPAYMENTSYNC);
+        netfulfilledman.AddFulfilledRequest(pfrom->addr, FULFILLED_MASTERNODEPAYMENTSYNC);
 
         Sync(pfrom, connman);
         LogPrintf("MASTERNODEPAYMENTSYNC -- Sent Masternode payment votes to peer %d\n", pfrom->GetId());
@@ -349,84 +369,144 @@ void CMasternodePayments::ProcessMessage(CNode* pfrom, const std::string& strCom
 
         uint256 nHash = vote.GetHash();
 
-        pfrom->setAskFor.erase(nHash);
+        //pfrom->setAskFor.erase(nHash);
+        pfrom->RemoveAskFor(nHash); // VELES
 
         // TODO: clear setAskFor for MSG_MASTERNODE_PAYMENT_BLOCK too
 
         // Ignore any payments messages until masternode list is synced
         if(!masternodeSync.IsMasternodeListSynced()) return;
 
-        {
-            LOCK(cs_mapMasternodePaymentVotes);
-            if(mapMasternodePaymentVotes.count(nHash)) {
-                LogPrint(BCLog::MNPAYMENTS, "MASTERNODEPAYMENTVOTE -- hash=%s, nHeight=%d seen\n", nHash.ToString(), nCachedBlockHeight);
-                return;
-            }
+        // VELES BEGIN
+        ProcessPaymentVote(pfrom, vote, connman);
+        // VELES END
 
-            // Avoid processing same vote multiple times
-            mapMasternodePaymentVotes[nHash] = vote;
-            // but first mark vote as non-verified,
-            // AddPaymentVote() below should take care of it if vote is actually ok
-            mapMasternodePaymentVotes[nHash].MarkAsNotVerified();
-        }
+    // VELES BEGIN
+    } else if (strCommand == NetMsgType::MNPAYMENTVOTEBUNDLE) { // Masternode Payments Votes bundled
+
+        std::vector<CMasternodePaymentVote> vecVotes;
+        vRecv >> vecVotes;
 
-        int nFirstBlock = nCachedBlockHeight - GetStorageLimit();
-        if(vote.nBlockHeight < nFirstBlock || vote.nBlockHeight > nCachedBlockHeight+20) {
-            LogPrint(BCLog::MNPAYMENTS, "MASTERNODEPAYMENTVOTE -- vote out of range: nFirstBlock=%d, nBlockHeight=%d, nHeight=%d\n", nFirstBlock, vote.nBlockHeight, nCachedBlockHeight);
+        if(pfrom->nVersion < GetMinMasternodePaymentsProto()) return;
+
+        if(vecVotes.size() > MNBUNDLE_MAX_ENTRIES) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 20, strprintf("mnwbundle message size = %u", vecVotes.size()));
             return;
         }
 
-        std::string strError = "";
-        if(!vote.IsValid(pfrom, nCachedBlockHeight, strError, connman)) {
-            LogPrint(BCLog::MNPAYMENTS, "MASTERNODEPAYMENTVOTE -- invalid message, error: %s\n", strError);
-            return;
+        for (const auto& vote : vecVotes) {
+            pfrom->RemoveAskFor(vote.GetHash());
         }
 
-        if(!CanVote(vote.vinMasternode.prevout, vote.nBlockHeight)) {
-            LogPrintf("MASTERNODEPAYMENTVOTE -- masternode already voted, masternode=%s\n", vote.vinMasternode.prevout.ToStringShort());
-            return;
+        // Ignore any payments messages until masternode list is synced
+        if(!masternodeSync.IsMasternodeListSynced()) return;
+
+        LogPrint(BCLog::MNPAYMENTS, "MNPAYMENTVOTEBUNDLE -- %d votes, peer=%d\n", vecVotes.size(), pfrom->GetId());
+
+        // Verify the signatures of the bundle in parallel first, the valid ones
+        // are then found in the signature cache when each vote is checked in order
+        {
+            std::unique_ptr<bool[]> pfValid(new bool[vecVotes.size()]());
+            std::vector<CHashSignerCheck> vChecks;
+            vChecks.reserve(vecVotes.size());
+            for (size_t i = 0; i < vecVotes.size(); i++) {
+                masternode_info_t mnInfo;
+                // unknown masternode, the vote is rejected on its own below
+                if (mnodeman.GetMasternodeInfo(vecVotes[i].vinMasternode.prevout, mnInfo))
+                    vChecks.emplace_back(vecVotes[i].GetSignatureHash(), mnInfo.pubKeyMasternode, vecVotes[i].vchSig, &pfValid[i]);
+            }
+            VerifyHashSignerChecks(vChecks);
         }
 
-        masternode_info_t mnInfo;
-        if(!mnodeman.GetMasternodeInfo(vote.vinMasternode.prevout, mnInfo)) {
-            // mn was not found, so we can't check vote, some info is probably missing
-            LogPrintf("MASTERNODEPAYMENTVOTE -- masternode is missing %s\n", vote.vinMasternode.prevout.ToStringShort());
-            mnodeman.AskForMN(pfrom, vote.vinMasternode.prevout, connman);
-            return;
+        // Every vote is checked exactly as if it was announced on its own
+        for (auto& vote : vecVotes) {
+            ProcessPaymentVote(pfrom, vote, connman);
         }
+    // VELES END
+    }
+}
 
-        int nDos = 0;
-        if(!vote.CheckSignature(mnInfo.pubKeyMasternode, nCachedBlockHeight, nDos)) {
-            if(nDos) {
-                LOCK(cs_main);
-                LogPrintf("MASTERNODEPAYMENTVOTE -- ERROR: invalid signature\n");
-                Misbehaving(pfrom->GetId(), nDos);
-            } else {
-                // only warn about anything non-critical (i.e. nDos == 0) in debug mode
-                LogPrint(BCLog::MNPAYMENTS, "MASTERNODEPAYMENTVOTE -- WARNING: invalid signature\n");
-            }
-            // Either our info or vote info could be outdated.
-            // In case our info is outdated, ask for an update,
-            mnodeman.AskForMN(pfrom, vote.vinMasternode.prevout, connman);
-            // but there is nothing we can do if vote info itself is outdated
-            // (i.e. it was signed by a mn which changed its key),
-            // so just quit here.
+// VELES BEGIN
+void CMasternodePayments::ProcessPaymentVote(CNode* pfrom, CMasternodePaymentVote& vote, CConnman& connman)
+{
+    uint256 nHash = vote.GetHash();
+
+    {
+        LOCK(cs_mapMasternodePaymentVotes);
+        // if(mapMasternodePaymentVotes.count(nHash)) {
+        if(mapMasternodePaymentVotes.Has(nHash)) {
+            LogPrint(BCLog::MNPAYMENTS, "MASTERNODEPAYMENTVOTE -- hash=%s, nHeight=%d seen\n", nHash.ToString(), nCachedBlockHeight);
             return;
         }
 
-        CTxDestination address1;
-        ExtractDestination(vote.payee, address1);
-        std::string address2 = EncodeDestination(address1);
+        // Avoid processing same vote multiple times
+        // mapMasternodePaymentVotes[nHash] = vote;
+        // but first mark vote as non-verified,
+        // AddPaymentVote() below should take care of it if vote is actually ok
+        // mapMasternodePaymentVotes[nHash].MarkAsNotVerified();
+        CMasternodePaymentVote voteNotVerified(vote);
+        voteNotVerified.MarkAsNotVerified();
+        mapMasternodePaymentVotes.Put(nHash, voteNotVerified);
+    }
+
+    int nFirstBlock = nCachedBlockHeight - GetStorageLimit();
+    if(vote.nBlockHeight < nFirstBlock || vote.nBlockHeight > nCachedBlockHeight+20) {
+        LogPrint(BCLog::MNPAYMENTS, "MASTERNODEPAYMENTVOTE -- vote out of range: nFirstBlock=%d, nBlockHeight=%d, nHeight=%d\n", nFirstBlock, vote.nBlockHeight, nCachedBlockHeight);
+        return;
+    }
+
+    std::string strError = "";
+    if(!vote.IsValid(pfrom, nCachedBlockHeight, strError, connman)) {
+        LogPrint(BCLog::MNPAYMENTS, "MASTERNODEPAYMENTVOTE -- invalid message, error: %s\n", strError);
+        return;
+    }
 
-        LogPrint(BCLog::MNPAYMENTS, "MASTERNODEPAYMENTVOTE -- vote: address=%s, nBlockHeight=%d, nHeight=%d, prevout=%s, hash=%s new\n",
-                    address2, vote.nBlockHeight, nCachedBlockHeight, vote.vinMasternode.prevout.ToStringShort(), nHash.ToString());
+    if(!CanVote(vote.vinMasternode.prevout, vote.nBlockHeight)) {
+        LogPrintf("MASTERNODEPAYMENTVOTE -- masternode already voted, masternode=%s\n", vote.vinMasternode.prevout.ToStringShort());
+        return;
+    }
 
-        if(AddPaymentVote(vote)){
-            vote.Relay(connman);
-            masternodeSync.BumpAssetLastTime("MASTERNODEPAYMENTVOTE");
+    masternode_info_t mnInfo;
+    if(!mnodeman.GetMasternodeInfo(vote.vinMasternode.prevout, mnInfo)) {
+        // mn was not found, so we can't check vote, some info is probably missing
+        LogPrintf("MASTERNODEPAYMENTVOTE -- masternode is missing %s\n", vote.vinMasternode.prevout.ToStringShort());
+        mnodeman.AskForMN(pfrom, vote.vinMasternode.prevout, connman);
+        return;
+    }
+
+    int nDos = 0;
+    if(!vote.CheckSignature(mnInfo.pubKeyMasternode, nCachedBlockHeight, nDos)) {
+        if(nDos) {
+            LOCK(cs_main);
+            LogPrintf("MASTERNODEPAYMENTVOTE -- ERROR: invalid signature\n");
+            Misbehaving(pfrom->GetId(), nDos);
+        } else {
+            // only warn about anything non-critical (i.e. nDos == 0) in debug mode
+            LogPrint(BCLog::MNPAYMENTS, "MASTERNODEPAYMENTVOTE -- WARNING: invalid signature\n");
         }
+        // Either our info or vote info could be outdated.
+        // In case our info is outdated, ask for an update,
+        mnodeman.AskForMN(pfrom, vote.vinMasternode.prevout, connman);
+        // but there is nothing we can do if vote info itself is outdated
+        // (i.e. it was signed by a mn which changed its key),
+        // so just quit here.
+        return;
+    }
+
+    CTxDestination address1;
+    ExtractDestination(vote.payee, address1);
+    std::string address2 = EncodeDestination(address1);
+
+    LogPrint(BCLog::MNPAYMENTS, "MASTERNODEPAYMENTVOTE -- vote: address=%s, nBlockHeight=%d, nHeight=%d, prevout=%s, hash=%s new\n",
+                address2, vote.nBlockHeight, nCachedBlockHeight, vote.vinMasternode.prevout.ToStringShort(), nHash.ToString());
+
+    if(AddPaymentVote(vote)){
+        vote.Relay(connman);
+        masternodeSync.BumpAssetLastTime("MASTERNODEPAYMENTVOTE");
     }
 }
+// VELES END
 
 bool CMasternodePaymentVote::Sign()
 {
@@ -465,8 +545,9 @@ bool CMasternodePayments::IsScheduled(CMasternode& mn, int nNotBlockHeight)
 
     if(!masternodeSync.IsMasternodeListSynced()) return false;
 
-    CScript mnpayee;
-    mnpayee = GetScriptForDestination(mn.pubKeyCollateralAddress.GetID());
+    //CScript mnpayee;
+    //mnpayee = GetScriptForDestination(mn.pubKeyCollateralAddress.GetID());
+    const CScript& mnpayee = mn.payeeScript; // VELES
 
     CScript payee;
     for (int64_t h = nCachedBlockHeight; h <= nCachedBlockHeight + 8; h++){
@@ -488,7 +569,8 @@ bool CMasternodePayments::AddPaymentVote(const CMasternodePaymentVote& vote)
 
     LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
 
-    mapMasternodePaymentVotes[vote.GetHash()] = vote;
+    // mapMasternodePaymentVotes[vote.GetHash()] = vote;
+    mapMasternodePaymentVotes.Put(vote.GetHash(), vote); // VELES
 
     if(!mapMasternodeBlocks.count(vote.nBlockHeight)) {
        CMasternodeBlockPayees blockPayees(vote.nBlockHeight);
@@ -503,16 +585,179 @@ bool CMasternodePayments::AddPaymentVote(const CMasternodePaymentVote& vote)
 bool CMasternodePayments::HasVerifiedPaymentVote(uint256 hashIn)
 {
     LOCK(cs_mapMasternodePaymentVotes);
-    std::map<uint256, CMasternodePaymentVote>::iterator it = mapMasternodePaymentVotes.find(hashIn);
-    return it != mapMasternodePaymentVotes.end() && it->second.IsVerified();
+    // std::map<uint256, CMasternodePaymentVote>::iterator it = mapMasternodePaymentVotes.find(hashIn);
+    // return it != mapMasternodePaymentVotes.end() && it->second.IsVerified();
+    return mapMasternodePaymentVotes.IsVerified(hashIn); // VELES
+}
+
+// VELES BEGIN
+bool CMasternodePayments::GetVerifiedPaymentVote(const uint256& hashIn, CMasternodePaymentVote& voteRet)
+{
+    LOCK(cs_mapMasternodePaymentVotes);
+    return mapMasternodePaymentVotes.Get(hashIn, voteRet) && voteRet.IsVerified();
+}
+
+CMasternodePaymentVoteStore::CMasternodePaymentVoteStore()
+    : mapHeights(0, CacheKeyHasher(GetRand(std::numeric_limits<uint64_t>::max()), GetRand(std::numeric_limits<uint64_t>::max())))
+{}
+
+const CMasternodePaymentVoteStore::Vote* CMasternodePaymentVoteStore::Find(const uint256& hash) const
+{
+    auto itHeight = mapHeights.find(hash);
+    if (itHeight == mapHeights.end()) return nullptr;
+    for (const Vote& stored : mapBuckets.at(itHeight->second)) {
+        if (stored.hash == hash) return &stored;
+    }
+    return nullptr;
+}
+
+void CMasternodePaymentVoteStore::MakeVote(int nBlockHeight, const Vote& stored, CMasternodePaymentVote& voteRet) const
+{
+    voteRet.vinMasternode = CTxIn(stored.outpointMasternode);
+    voteRet.nBlockHeight = nBlockHeight;
+    voteRet.payee = vecPayees[stored.nPayee].first;
+    voteRet.vchSig.assign(stored.vchSig, stored.vchSig + stored.nSigSize);
+}
+
+uint32_t CMasternodePaymentVoteStore::AddPayee(const CScript& payee)
+{
+    auto it = mapPayeeIndex.find(payee);
+    if (it != mapPayeeIndex.end()) {
+        vecPayees[it->second].second++;
+        return it->second;
+    }
+    uint32_t nPayee;
+    if (!vecFreePayees.empty()) {
+        nPayee = vecFreePayees.back();
+        vecFreePayees.pop_back();
+        vecPayees[nPayee] = std::make_pair(payee, 1);
+    } else {
+        nPayee = vecPayees.size();
+        vecPayees.emplace_back(payee, 1);
+    }
+    mapPayeeIndex.emplace(payee, nPayee);
+    return nPayee;
+}
+
+void CMasternodePaymentVoteStore::ReleasePayee(uint32_t nPayee)
+{
+    if (--vecPayees[nPayee].second > 0) return;
+    mapPayeeIndex.erase(vecPayees[nPayee].first);
+    vecPayees[nPayee].first.clear();
+    vecFreePayees.push_back(nPayee);
+}
+
+bool CMasternodePaymentVoteStore::IsVerified(const uint256& hash) const
+{
+    const Vote* stored = Find(hash);
+    return stored != nullptr && stored->nSigSize != 0;
+}
+
+bool CMasternodePaymentVoteStore::Get(const uint256& hash, CMasternodePaymentVote& voteRet) const
+{
+    const Vote* stored = Find(hash);
+    if (stored == nullptr) return false;
+    MakeVote(mapHeights.at(hash), *stored, voteRet);
+    return true;
+}
+
+void CMasternodePaymentVoteStore::Put(const uint256& hash, const CMasternodePaymentVote& vote)
+{
+    auto itHeight = mapHeights.find(hash);
+    if (itHeight != mapHeights.end() && itHeight->second != vote.nBlockHeight) {
+        // only a corrupted cache has votes with the same hash for two heights
+        return;
+    }
+
+    Vote* stored = nullptr;
+    std::vector<Vote>& vecVotes = mapBuckets[vote.nBlockHeight];
+    if (itHeight != mapHeights.end()) {
+        for (Vote& entry : vecVotes) {
+            if (entry.hash == hash) {
+                stored = &entry;
+                break;
+            }
+        }
+        ReleasePayee(stored->nPayee);
+    } else {
+        vecVotes.emplace_back();
+        stored = &vecVotes.back();
+        stored->hash = hash;
+        mapHeights.emplace(hash, vote.nBlockHeight);
+    }
+    stored->outpointMasternode = vote.vinMasternode.prevout;
+    stored->nPayee = AddPayee(vote.payee);
+    // Verified votes carry a compact signature, anything else can't be checked and is kept as not verified
+    stored->nSigSize = vote.vchSig.size() == sizeof(stored->vchSig) ? sizeof(stored->vchSig) : 0;
+    std::copy(vote.vchSig.begin(), vote.vchSig.begin() + stored->nSigSize, stored->vchSig);
+}
+
+size_t CMasternodePaymentVoteStore::EraseBelow(int nBlockHeight)
+{
+    size_t nErased = 0;
+    auto itEnd = mapBuckets.lower_bound(nBlockHeight);
+    for (auto it = mapBuckets.begin(); it != itEnd; ++it) {
+        for (const Vote& stored : it->second) {
+            mapHeights.erase(stored.hash);
+            ReleasePayee(stored.nPayee);
+        }
+        nErased += it->second.size();
+    }
+    mapBuckets.erase(mapBuckets.begin(), itEnd);
+    return nErased;
+}
+
+void CMasternodePaymentVoteStore::Clear()
+{
+    mapBuckets.clear();
+    mapHeights.clear();
+    vecPayees.clear();
+    mapPayeeIndex.clear();
+    vecFreePayees.clear();
+}
+
+size_t CMasternodePaymentVoteStore::DynamicMemoryUsage() const
+{
+    size_t nUsage = memusage::DynamicUsage(mapBuckets);
+    for (const auto& bucket : mapBuckets) {
+        nUsage += memusage::DynamicUsage(bucket.second);
+    }
+    nUsage += memusage::DynamicUsage(mapHeights) + memusage::DynamicUsage(vecPayees);
+    for (const auto& payee : vecPayees) {
+        nUsage += RecursiveDynamicUsage(payee.first);
+    }
+    nUsage += memusage::DynamicUsage(mapPayeeIndex);
+    for (const auto& pair : mapPayeeIndex) {
+        nUsage += RecursiveDynamicUsage(pair.first);
+    }
+    return nUsage + memusage::DynamicUsage(vecFreePayees);
+}
+
+size_t CMasternodePayee::DynamicMemoryUsage() const
+{
+    return RecursiveDynamicUsage(scriptPubKey) + memusage::DynamicUsage(vecVoteHashes);
+}
+
+size_t CMasternodeBlockPayees::DynamicMemoryUsage() const
+{
+    LOCK(cs_vecPayees);
+
+    size_t nUsage = memusage::DynamicUsage(vecPayees);
+    for (const auto& payee : vecPayees) {
+        nUsage += payee.DynamicMemoryUsage();
+    }
+    return nUsage;
 }
+// VELES END
 
 void CMasternodeBlockPayees::AddPayee(const CMasternodePaymentVote& vote)
 {
     LOCK(cs_vecPayees);
 
+    const uint64_t nPayeeHash = GetPayeeHash(vote.payee); // VELES
     for (auto& payee : vecPayees) {
-        if (payee.GetPayee() == vote.payee) {
+        //if (payee.GetPayee() == vote.payee) {
+        if (payee.IsPayee(vote.payee, nPayeeHash)) { // VELES
             payee.AddVoteHash(vote.GetHash());
             return;
         }
@@ -542,11 +787,29 @@ bool CMasternodeBlockPayees::GetBestPayee(CScript& payeeRet)
 }
 
 bool CMasternodeBlockPayees::HasPayeeWithVotes(const CScript& payeeIn, int nVotesReq)
+{
+    // VELES BEGIN
+    //LOCK(cs_vecPayees);
+    //
+    //for (auto& payee : vecPayees) {
+    //    if (payee.GetVoteCount() >= nVotesReq && payee.GetPayee() == payeeIn) {
+    //        return true;
+    //    }
+    //}
+    //
+    //LogPrint(BCLog::MNPAYMENTS, "CMasternodeBlockPayees::HasPayeeWithVotes -- ERROR: couldn't find any payee with %d+ votes\n", nVotesReq);
+    //return false;
+    return HasPayeeWithVotes(payeeIn, GetPayeeHash(payeeIn), nVotesReq);
+    // VELES END
+}
+
+// VELES BEGIN
+bool CMasternodeBlockPayees::HasPayeeWithVotes(const CScript& payeeIn, uint64_t nPayeeHash, int nVotesReq)
 {
     LOCK(cs_vecPayees);
 
     for (auto& payee : vecPayees) {
-        if (payee.GetVoteCount() >= nVotesReq && payee.GetPayee() == payeeIn) {
+        if (payee.GetVoteCount() >= nVotesReq && payee.IsPayee(payeeIn, nPayeeHash)) {
             return true;
         }
     }
@@ -554,6 +817,7 @@ bool CMasternodeBlockPayees::HasPayeeWithVotes(const CScript& payeeIn, int nVote
     LogPrint(BCLog::MNPAYMENTS, "CMasternodeBlockPayees::HasPayeeWithVotes -- ERROR: couldn't find any payee with %d+ votes\n", nVotesReq);
     return false;
 }
+// VELES END
 
 bool CMasternodeBlockPayees::IsTransactionValid(const CTransactionRef txNew)
 {
@@ -575,10 +839,21 @@ bool CMasternodeBlockPayees::IsTransactionValid(const CTransactionRef txNew)
     // if we don't have at least MNPAYMENTS_SIGNATURES_REQUIRED signatures on a payee, approve whichever is the longest chain
     if(nMaxSignatures < MNPAYMENTS_SIGNATURES_REQUIRED) return true;
 
+    // VELES BEGIN
+    // Hash the scripts of the outputs paying the masternode amount once for all the payees
+    std::vector<std::pair<const CTxOut*, uint64_t> > vecPayments;
+    for (const CTxOut& txout : txNew->vout) {
+        if (nMasternodePayment == txout.nValue)
+            vecPayments.emplace_back(&txout, GetPayeeHash(txout.scriptPubKey));
+    }
+    // VELES END
+
     for (auto& payee : vecPayees) {
         if (payee.GetVoteCount() >= MNPAYMENTS_SIGNATURES_REQUIRED) {
-            for (auto txout : txNew->vout) {
-                if (payee.GetPayee() == txout.scriptPubKey && nMasternodePayment == txout.nValue) {
+            //for (auto txout : txNew->vout) {
+            //    if (payee.GetPayee() == txout.scriptPubKey && nMasternodePayment == txout.nValue) {
+            for (const auto& payment : vecPayments) { // VELES
+                if (payee.IsPayee(payment.first->scriptPubKey, payment.second)) { // VELES
                     LogPrint(BCLog::MNPAYMENTS, "CMasternodeBlockPayees::IsTransactionValid -- Found required payment\n");
                     return true;
                 }
@@ -652,6 +927,7 @@ void CMasternodePayments::CheckAndRemove()
 
     int nLimit = GetStorageLimit();
 
+    /*
     std::map<uint256, CMasternodePaymentVote>::iterator it = mapMasternodePaymentVotes.begin();
     while(it != mapMasternodePaymentVotes.end()) {
         CMasternodePaymentVote vote = (*it).second;
@@ -664,6 +940,16 @@ void CMasternodePayments::CheckAndRemove()
             ++it;
         }
     }
+    */
+    // VELES BEGIN
+    // the votes and blocks are kept by height, the old heights go at once
+    const int nFirstBlock = nCachedBlockHeight - nLimit;
+    const size_t nErased = mapMasternodePaymentVotes.EraseBelow(nFirstBlock);
+    mapMasternodeBlocks.erase(mapMasternodeBlocks.begin(), mapMasternodeBlocks.lower_bound(nFirstBlock));
+    if (nErased > 0) {
+        LogPrint(BCLog::MNPAYMENTS, "CMasternodePayments::CheckAndRemove -- Removed %d old Masternode payments below nBlockHeight=%d\n", nErased, nFirstBlock);
+    }
+    // VELES END
     LogPrintf("CMasternodePayments::CheckAndRemove -- %s\n", ToString());
 }
 
@@ -754,10 +1040,11 @@ bool CMasternodePayments::ProcessBlock(int nBlockHeight, CConnman& connman)
     LogPrintf("CMasternodePayments::ProcessBlock -- Start: nBlockHeight=%d, masternode=%s\n", nBlockHeight, activeMasternode.outpoint.ToStringShort());
 
     // pay to the oldest MN that still had no payment but its input is old enough and it was active long enough
-    int nCount = 0;
+    // int nCount = 0;
     masternode_info_t mnInfo;
 
-    if (!mnodeman.GetNextMasternodeInQueueForPayment(nBlockHeight, true, nCount, mnInfo)) {
+    // if (!mnodeman.GetNextMasternodeInQueueForPayment(nBlockHeight, true, nCount, mnInfo)) {
+    if (!GetExpectedPayee(nBlockHeight, mnInfo)) { // VELES
         LogPrintf("CMasternodePayments::ProcessBlock -- ERROR: Failed to find masternode to pay\n");
         return false;
     }
@@ -765,7 +1052,8 @@ bool CMasternodePayments::ProcessBlock(int nBlockHeight, CConnman& connman)
     LogPrintf("CMasternodePayments::ProcessBlock -- Masternode found by GetNextMasternodeInQueueForPayment(): %s\n", mnInfo.vin.prevout.ToStringShort());
 
 
-    CScript payee = GetScriptForDestination(mnInfo.pubKeyCollateralAddress.GetID());
+    //CScript payee = GetScriptForDestination(mnInfo.pubKeyCollateralAddress.GetID());
+    const CScript& payee = mnInfo.payeeScript; // VELES
 
     CMasternodePaymentVote voteNew(activeMasternode.outpoint, nBlockHeight, payee);
 
@@ -815,12 +1103,14 @@ void CMasternodePayments::CheckPreviousBlockVotes(int nPrevBlockHeight)
         if (mapMasternodeBlocks.count(nPrevBlockHeight)) {
             for (auto &p : mapMasternodeBlocks[nPrevBlockHeight].vecPayees) {
                 for (auto &voteHash : p.GetVoteHashes()) {
-                    if (!mapMasternodePaymentVotes.count(voteHash)) {
+                    // if (!mapMasternodePaymentVotes.count(voteHash)) {
+                    CMasternodePaymentVote vote; // VELES
+                    if (!mapMasternodePaymentVotes.Get(voteHash, vote)) { // VELES
                         debugStr += strprintf("CMasternodePayments::CheckPreviousBlockVotes --   could not find vote %s\n",
                                               voteHash.ToString());
                         continue;
                     }
-                    auto vote = mapMasternodePaymentVotes[voteHash];
+                    // auto vote = mapMasternodePaymentVotes[voteHash];
                     if (vote.vinMasternode.prevout == mn.second.vin.prevout) {
                         payee = vote.payee;
                         found = true;
@@ -887,6 +1177,17 @@ bool CMasternodePaymentVote::CheckSignature(const CPubKey& pubKeyMasternode, int
     return true;
 }
 
+// VELES BEGIN
+uint256 CMasternodePaymentVote::GetSignatureHash() const
+{
+    std::string strMessage = vinMasternode.prevout.ToStringShort() +
+                boost::lexical_cast<std::string>(nBlockHeight) +
+                ScriptToAsmStr(payee);
+
+    return CMessageSigner::GetMessageHash(strMessage);
+}
+// VELES END
+
 std::string CMasternodePaymentVote::ToString() const
 {
     std::ostringstream info;
@@ -926,13 +1227,17 @@ void CMasternodePayments::Sync(CNode* pnode, CConnman& connman)
 }
 
 // Request low data/unknown payment blocks in batches directly from some node instead of/after preliminary Sync.
-void CMasternodePayments::RequestLowDataPaymentBlocks(CNode* pnode, CConnman& connman)
+// VELES: the blocks are split in ranges of MNPAYMENTS_SYNC_RANGE_BLOCKS heights shared by the syncing peers,
+// a range is asked again from another peer only when the one asked did not fill it in time.
+// void CMasternodePayments::RequestLowDataPaymentBlocks(CNode* pnode, CConnman& connman)
+void CMasternodePayments::RequestLowDataPaymentBlocks(CNode* pnode, CConnman& connman, int nPeers) // VELES
 {
     if(!masternodeSync.IsMasternodeListSynced()) return;
 
     LOCK2(cs_main, cs_mapMasternodeBlocks);
 
-    std::vector<CInv> vToFetch;
+    // std::vector<CInv> vToFetch;
+    std::map<int, uint256> mapToFetch; // VELES
     int nLimit = GetStorageLimit();
 
     const CBlockIndex *pindex = chainActive.Tip();
@@ -940,14 +1245,8 @@ void CMasternodePayments::RequestLowDataPaymentBlocks(CNode* pnode, CConnman& co
     while(nCachedBlockHeight - pindex->nHeight < nLimit) {
         if(!mapMasternodeBlocks.count(pindex->nHeight)) {
             // We have no idea about this block height, let's ask
-            vToFetch.push_back(CInv(MSG_MASTERNODE_PAYMENT_BLOCK, pindex->GetBlockHash()));
-            // We should not violate GETDATA rules
-            if(vToFetch.size() == MAX_INV_SZ) {
-                LogPrintf("CMasternodePayments::SyncLowDataPaymentBlocks -- asking peer %d for %d blocks\n", pnode->GetId(), MAX_INV_SZ);
-                connman.PushMessage(pnode, CNetMsgMaker(pnode->GetSendVersion()).Make(NetMsgType::GETDATA, vToFetch));
-                // Start filling new batch
-                vToFetch.clear();
-            }
+            // vToFetch.push_back(CInv(MSG_MASTERNODE_PAYMENT_BLOCK, pindex->GetBlockHash()));
+            mapToFetch[pindex->nHeight] = pindex->GetBlockHash(); // VELES
         }
         if(!pindex->pprev) break;
         pindex = pindex->pprev;
@@ -987,17 +1286,52 @@ void CMasternodePayments::RequestLowDataPaymentBlocks(CNode* pnode, CConnman& co
         // Low data block found, let's try to sync it
         uint256 hash;
         if(GetBlockHash(hash, it->first)) {
-            vToFetch.push_back(CInv(MSG_MASTERNODE_PAYMENT_BLOCK, hash));
+            // vToFetch.push_back(CInv(MSG_MASTERNODE_PAYMENT_BLOCK, hash));
+            mapToFetch[it->first] = hash; // VELES
         }
+        ++it;
+    }
+
+    // VELES BEGIN
+    std::map<int, std::vector<CInv> > mapRanges;
+    for (const auto& entry : mapToFetch) {
+        mapRanges[entry.first / MNPAYMENTS_SYNC_RANGE_BLOCKS].push_back(CInv(MSG_MASTERNODE_PAYMENT_BLOCK, entry.second));
+    }
+
+    // Nothing is missing in the ranges no longer found, those still in flight wait for their peer
+    const int64_t nNow = GetTime();
+    int nComplete = 0;
+    for (auto itRange = mapRangeRequests.begin(); itRange != mapRangeRequests.end(); ) {
+        if (!mapRanges.count(itRange->first)) {
+            nComplete++;
+            itRange = mapRangeRequests.erase(itRange);
+        } else {
+            ++itRange;
+        }
+    }
+
+    // Every peer takes its share of all the ranges, the last ones asked pick up what timed out
+    const size_t nShare = (mapRanges.size() + std::max(nPeers, 1) - 1) / std::max(nPeers, 1);
+    std::vector<CInv> vToFetch;
+    size_t nRanges = 0;
+    for (const auto& range : mapRanges) {
+        if (nRanges == nShare) break;
+        auto itRange = mapRangeRequests.find(range.first);
+        if (itRange != mapRangeRequests.end() && nNow - itRange->second.second <= MASTERNODE_SYNC_TIMEOUT_SECONDS) continue;
+        mapRangeRequests[range.first] = std::make_pair(pnode->GetId(), nNow);
+        nRanges++;
         // We should not violate GETDATA rules
-        if(vToFetch.size() == MAX_INV_SZ) {
-            LogPrintf("CMasternodePayments::SyncLowDataPaymentBlocks -- asking peer %d for %d payment blocks\n", pnode->GetId(), MAX_INV_SZ);
+        if(vToFetch.size() + range.second.size() > MAX_INV_SZ) {
+            LogPrintf("CMasternodePayments::SyncLowDataPaymentBlocks -- asking peer %d for %d payment blocks\n", pnode->GetId(), vToFetch.size());
             connman.PushMessage(pnode, CNetMsgMaker(pnode->GetSendVersion()).Make(NetMsgType::GETDATA, vToFetch));
             // Start filling new batch
             vToFetch.clear();
         }
-        ++it;
+        vToFetch.insert(vToFetch.end(), range.second.begin(), range.second.end());
     }
+    LogPrint(BCLog::MNPAYMENTS, "CMasternodePayments::SyncLowDataPaymentBlocks -- %d ranges complete, %d of %d missing ranges in flight, %d for peer %d\n",
+             nComplete, mapRangeRequests.size(), mapRanges.size(), nRanges, pnode->GetId());
+    // VELES END
     // Ask for the rest of it
     if(!vToFetch.empty()) {
         LogPrintf("CMasternodePayments::SyncLowDataPaymentBlocks -- asking peer %d for %d payment blocks\n", pnode->GetId(), vToFetch.size());
@@ -1015,6 +1349,27 @@ std::string CMasternodePayments::ToString() const
     return info.str();
 }
 
+// VELES BEGIN
+size_t CMasternodePayments::DynamicMemoryUsage()
+{
+    size_t nUsage = 0;
+    {
+        LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
+        nUsage += mapMasternodePaymentVotes.DynamicMemoryUsage() + memusage::DynamicUsage(mapMasternodeBlocks);
+        for (const auto& pair : mapMasternodeBlocks) {
+            nUsage += pair.second.DynamicMemoryUsage();
+        }
+        nUsage += memusage::DynamicUsage(mapMasternodesLastVote) + memusage::DynamicUsage(mapMasternodesDidNotVote);
+        nUsage += memusage::DynamicUsage(mapRangeRequests);
+    }
+    {
+        LOCK(cs_mapExpectedPayees);
+        nUsage += memusage::DynamicUsage(mapExpectedPayees);
+    }
+    return nUsage;
+}
+// VELES END
+
 bool CMasternodePayments::IsEnoughData()
 {
     float nAverageVotes = (MNPAYMENTS_SIGNATURES_TOTAL + MNPAYMENTS_SIGNATURES_REQUIRED) / 2;
@@ -1036,6 +1391,67 @@ void CMasternodePayments::UpdatedBlockTip(const CBlockIndex *pindex, CConnman& c
 
     int nFutureBlock = nCachedBlockHeight + 10;
 
-    CheckPreviousBlockVotes(nFutureBlock - 1);
+    UpdateExpectedPayees(pindex); // VELES
+    // VELES BEGIN
+    //CheckPreviousBlockVotes(nFutureBlock - 1);
+    // After a reorg to a chain no longer than the old one the votes of the height were counted already
+    if (nFutureBlock - 1 > nLastCheckedVotesHeight) {
+        CheckPreviousBlockVotes(nFutureBlock - 1);
+        nLastCheckedVotesHeight = nFutureBlock - 1;
+    }
+    // VELES END
     ProcessBlock(nFutureBlock, connman);
 }
+
+// VELES BEGIN
+void CMasternodePayments::UpdateExpectedPayees(const CBlockIndex *pindex)
+{
+    if(fLiteMode || !masternodeSync.IsWinnersListSynced()) return;
+
+    // Runs with the other tip notifications, off the path of block templates and validation
+    mnodeman.UpdateLastPaid(pindex);
+
+    std::map<int, masternode_info_t> mapPayees;
+    for (int nHeight = pindex->nHeight + 1; nHeight <= pindex->nHeight + MNPAYMENTS_EXPECTED_PAYEE_BLOCKS; nHeight++) {
+        int nCount = 0;
+        masternode_info_t mnInfo;
+        if (mnodeman.GetNextMasternodeInQueueForPayment(nHeight, true, nCount, mnInfo)) {
+            mapPayees.emplace(nHeight, mnInfo);
+        }
+    }
+
+    LOCK(cs_mapExpectedPayees);
+    hashExpectedTip = pindex->GetBlockHash();
+    mapExpectedPayees.swap(mapPayees);
+    LogPrint(BCLog::MNPAYMENTS, "CMasternodePayments::UpdateExpectedPayees -- %d payees expected after %s\n", mapExpectedPayees.size(), hashExpectedTip.ToString());
+}
+
+bool CMasternodePayments::GetExpectedPayee(int nBlockHeight, masternode_info_t& mnInfoRet)
+{
+    uint256 hashTip;
+    {
+        LOCK(cs_main);
+        if (chainActive.Tip()) hashTip = chainActive.Tip()->GetBlockHash();
+    }
+    {
+        LOCK(cs_mapExpectedPayees);
+        if (hashTip == hashExpectedTip) {
+            auto it = mapExpectedPayees.find(nBlockHeight);
+            if (it != mapExpectedPayees.end()) {
+                mnInfoRet = it->second;
+                return true;
+            }
+        }
+    }
+
+    // Not computed yet for this tip
+    int nCount = 0;
+    if (!mnodeman.GetNextMasternodeInQueueForPayment(nBlockHeight, true, nCount, mnInfoRet)) return false;
+
+    LOCK(cs_mapExpectedPayees);
+    if (hashTip == hashExpectedTip) {
+        mapExpectedPayees.emplace(nBlockHeight, mnInfoRet);
+    }
+    return true;
+}
+// VELES END
@@ -13,12 +13,24 @@
 #include <util/strencodings.h>
 #include <util/system.h>
 
+// VELES BEGIN
+#include <cachemap.h>
+
+#include <unordered_map>
+// VELES END
+
 class CMasternodePayments;
 class CMasternodePaymentVote;
 class CMasternodeBlockPayees;
 
 static const int MNPAYMENTS_SIGNATURES_REQUIRED         = 6;
 static const int MNPAYMENTS_SIGNATURES_TOTAL            = 10;
+// VELES BEGIN
+// missing payment blocks are requested from the syncing peers in ranges of this many heights
+static const int MNPAYMENTS_SYNC_RANGE_BLOCKS           = 100;
+// the payees expected by the queue are computed ahead for this many blocks after every tip
+static const int MNPAYMENTS_EXPECTED_PAYEE_BLOCKS       = 10;
+// VELES END
 
 //! minimum peer version that can receive and send masternode payment messages,
 //  vote for masternode and be elected as a payment winner
@@ -30,6 +42,9 @@ static const int MIN_MASTERNODE_PAYMENT_PROTO_VERSION_2 = 70208;
 extern CCriticalSection cs_vecPayees;
 extern CCriticalSection cs_mapMasternodeBlocks;
 extern CCriticalSection cs_mapMasternodePayeeVotes;
+// VELES BEGIN
+extern CCriticalSection cs_mapMasternodePaymentVotes;
+// VELES END
 
 extern CMasternodePayments mnpayments;
 
@@ -44,6 +59,7 @@ class CMasternodePayee
 private:
     CScript scriptPubKey;
     std::vector<uint256> vecVoteHashes;
+    uint64_t nPayeeHash = 0; // VELES memory only, GetPayeeHash() of scriptPubKey
 
 public:
     CMasternodePayee() :
@@ -53,7 +69,8 @@ public:
 
     CMasternodePayee(CScript payee, uint256 hashIn) :
         scriptPubKey(payee),
-        vecVoteHashes()
+        vecVoteHashes(),
+        nPayeeHash(GetPayeeHash(payee)) // VELES
     {
         vecVoteHashes.push_back(hashIn);
     }
@@ -64,13 +81,24 @@ public:
     inline void SerializationOp(Stream& s, Operation ser_action) {
         READWRITE(*(CScriptBase*)(&scriptPubKey));
         READWRITE(vecVoteHashes);
+        // VELES BEGIN
+        if (ser_action.ForRead())
+            nPayeeHash = GetPayeeHash(scriptPubKey);
+        // VELES END
     }
 
-    CScript GetPayee() { return scriptPubKey; }
+    //CScript GetPayee() { return scriptPubKey; }
+    // VELES BEGIN
+    const CScript& GetPayee() const { return scriptPubKey; }
+    /// Is this the script whose GetPayeeHash() is nHash?
+    bool IsPayee(const CScript& payee, uint64_t nHash) const { return nHash == nPayeeHash && payee == scriptPubKey; }
+    // VELES END
 
     void AddVoteHash(uint256 hashIn) { vecVoteHashes.push_back(hashIn); }
     std::vector<uint256> GetVoteHashes() { return vecVoteHashes; }
     int GetVoteCount() { return vecVoteHashes.size(); }
+
+    size_t DynamicMemoryUsage() const; // VELES
 };
 
 // Keep track of votes for payees from masternodes
@@ -100,10 +128,13 @@ public:
     void AddPayee(const CMasternodePaymentVote& vote);
     bool GetBestPayee(CScript& payeeRet);
     bool HasPayeeWithVotes(const CScript& payeeIn, int nVotesReq);
+    bool HasPayeeWithVotes(const CScript& payeeIn, uint64_t nPayeeHash, int nVotesReq); // VELES
 
     bool IsTransactionValid(const CTransactionRef txNew);
 
     std::string GetRequiredPaymentsString();
+
+    size_t DynamicMemoryUsage() const; // VELES
 };
 
 // vote for the winning payment
@@ -150,6 +181,7 @@ public:
 
     bool Sign();
     bool CheckSignature(const CPubKey& pubKeyMasternode, int nValidationHeight, int &nDos);
+    uint256 GetSignatureHash() const; // VELES
 
     bool IsValid(CNode* pnode, int nValidationHeight, std::string& strError, CConnman& connman);
     void Relay(CConnman& connman);
@@ -160,6 +192,81 @@ public:
     std::string ToString() const;
 };
 
+// VELES BEGIN
+// Payment votes in buckets by block height. The payee script, shared by most votes of a height,
+// is kept once for all of them and the compact signature in a fixed size slot, so a stored vote
+// is a fraction of the size of a CMasternodePaymentVote. Old heights are dropped a bucket at a time.
+// Serialized as the std::map<uint256, CMasternodePaymentVote> it replaces.
+class CMasternodePaymentVoteStore
+{
+private:
+    struct Vote
+    {
+        uint256 hash;
+        COutPoint outpointMasternode;
+        uint32_t nPayee;
+        //! 0 when the vote is not verified
+        uint8_t nSigSize;
+        unsigned char vchSig[CPubKey::COMPACT_SIGNATURE_SIZE];
+    };
+
+    std::map<int, std::vector<Vote> > mapBuckets;
+    //! Bucket of every vote, a bucket only holds the few votes of a height
+    std::unordered_map<uint256, int, CacheKeyHasher> mapHeights;
+    //! Payee scripts with the number of votes for them, unused ones are reused
+    std::vector<std::pair<CScript, uint32_t> > vecPayees;
+    std::unordered_map<CScript, uint32_t, SaltedPayeeHasher> mapPayeeIndex;
+    std::vector<uint32_t> vecFreePayees;
+
+    const Vote* Find(const uint256& hash) const;
+    void MakeVote(int nBlockHeight, const Vote& stored, CMasternodePaymentVote& voteRet) const;
+    uint32_t AddPayee(const CScript& payee);
+    void ReleasePayee(uint32_t nPayee);
+
+public:
+    CMasternodePaymentVoteStore();
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        WriteCompactSize(s, size());
+        CMasternodePaymentVote vote;
+        for (const auto& bucket : mapBuckets) {
+            for (const Vote& stored : bucket.second) {
+                MakeVote(bucket.first, stored, vote);
+                s << stored.hash << vote;
+            }
+        }
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        Clear();
+        const uint64_t nSize = ReadCompactSize(s);
+        for (uint64_t i = 0; i < nSize; i++) {
+            uint256 hash;
+            CMasternodePaymentVote vote;
+            s >> hash >> vote;
+            Put(hash, vote);
+        }
+    }
+
+    size_t size() const { return mapHeights.size(); }
+    bool Has(const uint256& hash) const { return mapHeights.count(hash) != 0; }
+    bool IsVerified(const uint256& hash) const;
+    bool Get(const uint256& hash, CMasternodePaymentVote& voteRet) const;
+
+    /** Add the vote or replace the one with the same hash */
+    void Put(const uint256& hash, const CMasternodePaymentVote& vote);
+    /** Drop the votes for the blocks below nBlockHeight, returns how many were dropped */
+    size_t EraseBelow(int nBlockHeight);
+    void Clear();
+
+    size_t DynamicMemoryUsage() const;
+};
+// VELES END
+
 //
 // Masternode Payments Class
 // Keeps track of who should get paid for which blocks
@@ -176,8 +283,25 @@ private:
     // Keep track of current block height
     int nCachedBlockHeight;
 
+    // VELES BEGIN
+    // Ranges of missing payment blocks (height / MNPAYMENTS_SYNC_RANGE_BLOCKS) in flight, with
+    // the peer asked and when. A range is complete once none of its blocks is missing anymore.
+    std::map<int, std::pair<NodeId, int64_t> > mapRangeRequests;
+
+    // Payees the queue selects for the next blocks, computed for the tip hashExpectedTip
+    CCriticalSection cs_mapExpectedPayees;
+    uint256 hashExpectedTip GUARDED_BY(cs_mapExpectedPayees);
+    std::map<int, masternode_info_t> mapExpectedPayees GUARDED_BY(cs_mapExpectedPayees);
+
+    void UpdateExpectedPayees(const CBlockIndex *pindex);
+
+    // Highest block the missed payment votes were counted for
+    int nLastCheckedVotesHeight = 0;
+    // VELES END
+
 public:
-    std::map<uint256, CMasternodePaymentVote> mapMasternodePaymentVotes;
+    // std::map<uint256, CMasternodePaymentVote> mapMasternodePaymentVotes;
+    CMasternodePaymentVoteStore mapMasternodePaymentVotes; // VELES
     std::map<int, CMasternodeBlockPayees> mapMasternodeBlocks;
     std::map<COutPoint, int> mapMasternodesLastVote;
     std::map<COutPoint, int> mapMasternodesDidNotVote;
@@ -188,6 +312,10 @@ public:
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action) {
+        // VELES BEGIN
+        // the cache is loaded while the node is already running
+        LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePaymentVotes);
+        // VELES END
         READWRITE(mapMasternodePaymentVotes);
         READWRITE(mapMasternodeBlocks);
     }
@@ -196,14 +324,23 @@ public:
 
     bool AddPaymentVote(const CMasternodePaymentVote& vote);
     bool HasVerifiedPaymentVote(uint256 hashIn);
+    bool GetVerifiedPaymentVote(const uint256& hashIn, CMasternodePaymentVote& voteRet); // VELES
     bool ProcessBlock(int nBlockHeight, CConnman& connman);
     void CheckPreviousBlockVotes(int nPrevBlockHeight);
 
     void Sync(CNode* node, CConnman& connman);
-    void RequestLowDataPaymentBlocks(CNode* pnode, CConnman& connman);
+    // void RequestLowDataPaymentBlocks(CNode* pnode, CConnman& connman);
+    // VELES BEGIN
+    // Ask pnode for a share of the ranges nobody was asked for, nPeers peers share them
+    void RequestLowDataPaymentBlocks(CNode* pnode, CConnman& connman, int nPeers = 1);
+    // VELES END
     void CheckAndRemove();
 
     bool GetBlockPayee(int nBlockHeight, CScript& payee);
+    // VELES BEGIN
+    // The masternode the payment queue selects for nBlockHeight, computed ahead for the next blocks
+    bool GetExpectedPayee(int nBlockHeight, masternode_info_t& mnInfoRet);
+    // VELES END
     bool IsTransactionValid(const CTransactionRef txNew, int nBlockHeight);
     bool IsScheduled(CMasternode& mn, int nNotBlockHeight);
 
@@ -211,9 +348,16 @@ public:
 
     int GetMinMasternodePaymentsProto();
     void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman);
+    // VELES BEGIN
+    void ProcessPaymentVote(CNode* pfrom, CMasternodePaymentVote& vote, CConnman& connman);
+    // VELES END
     std::string GetRequiredPaymentsString(int nBlockHeight);
     void FillBlockPayee(CMutableTransaction& txNew, int nBlockHeight, CAmount blockReward, CTxOut& txoutMasternodeRet);
     std::string ToString() const;
+    // VELES BEGIN
+    // Memory used by the payment votes and blocks, they are bounded by GetStorageLimit
+    size_t DynamicMemoryUsage();
+    // VELES END
 
     int GetBlockCount() { return mapMasternodeBlocks.size(); }
     int GetVoteCount() { return mapMasternodePaymentVotes.size(); }
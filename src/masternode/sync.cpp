@@ -28,11 +28,18 @@ void CMasternodeSync::Fail()
 
 void CMasternodeSync::Reset()
 {
+    LOCK(cs); // VELES
     nRequestedMasternodeAssets = MASTERNODE_SYNC_INITIAL;
     nRequestedMasternodeAttempt = 0;
     nTimeAssetSyncStarted = GetTime();
     nTimeLastBumped = GetTime();
     nTimeLastFailure = 0;
+    // VELES BEGIN
+    mapAssetRequests.clear();
+    setAssetReplies.clear();
+    nTimeLastReply = 0;
+    fTickNow = false;
+    // VELES END
 }
 
 void CMasternodeSync::BumpAssetLastTime(std::string strFuncName)
@@ -59,6 +66,7 @@ std::string CMasternodeSync::GetAssetName()
 
 void CMasternodeSync::SwitchToNextAsset(CConnman& connman)
 {
+    LOCK(cs); // VELES
     switch(nRequestedMasternodeAssets)
     {
         case(MASTERNODE_SYNC_FAILED):
@@ -70,6 +78,14 @@ void CMasternodeSync::SwitchToNextAsset(CConnman& connman)
             LogPrintf("CMasternodeSync::SwitchToNextAsset -- Starting %s\n", GetAssetName());
             break;
         case(MASTERNODE_SYNC_WAITING):
+            // VELES BEGIN
+            // Masternode messages are processed once the blockchain is synced,
+            // they must not race the caches still loading from disk
+            if (!fCachesLoaded) {
+                LogPrint(BCLog::MNSYNC, "CMasternodeSync::SwitchToNextAsset -- Waiting for the caches to load\n");
+                return;
+            }
+            // VELES END
             ClearFulfilledRequests(connman);
             LogPrintf("CMasternodeSync::SwitchToNextAsset -- Completed %s in %llds\n", GetAssetName(), GetTime() - nTimeAssetSyncStarted);
             nRequestedMasternodeAssets = MASTERNODE_SYNC_LIST;
@@ -77,6 +93,10 @@ void CMasternodeSync::SwitchToNextAsset(CConnman& connman)
             break;
         case(MASTERNODE_SYNC_LIST):
             LogPrintf("CMasternodeSync::SwitchToNextAsset -- Completed %s in %llds\n", GetAssetName(), GetTime() - nTimeAssetSyncStarted);
+            // VELES BEGIN
+            // the next list sync only needs the changes from here on
+            mnodeman.ListDiffSynced();
+            // VELES END
             nRequestedMasternodeAssets = MASTERNODE_SYNC_MNW;
             LogPrintf("CMasternodeSync::SwitchToNextAsset -- Starting %s\n", GetAssetName());
             break;
@@ -97,7 +117,7 @@ void CMasternodeSync::SwitchToNextAsset(CConnman& connman)
             // if(lockRecv) { ... }
 
             connman.ForEachNode(CConnman::AllNodes, [](CNode* pnode) {
-                netfulfilledman.AddFulfilledRequest(pnode->addr, "full-sync");
+                netfulfilledman.AddFulfilledRequest(pnode->addr, FULFILLED_FULL_SYNC);
             });
             LogPrintf("CMasternodeSync::SwitchToNextAsset -- Sync has finished\n");
 
@@ -106,6 +126,13 @@ void CMasternodeSync::SwitchToNextAsset(CConnman& connman)
     nRequestedMasternodeAttempt = 0;
     nTimeAssetSyncStarted = GetTime();
     BumpAssetLastTime("CMasternodeSync::SwitchToNextAsset");
+    // VELES BEGIN
+    mapAssetRequests.clear();
+    setAssetReplies.clear();
+    nTimeLastReply = 0;
+    // request the next asset on the next tick instead of up to MASTERNODE_SYNC_TICK_SECONDS later
+    fTickNow = true;
+    // VELES END
 }
 
 std::string CMasternodeSync::GetSyncStatus()
@@ -122,7 +149,8 @@ std::string CMasternodeSync::GetSyncStatus()
     }
 }
 
-void CMasternodeSync::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv)
+// void CMasternodeSync::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv)
+void CMasternodeSync::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman) // VELES
 {
     if (strCommand == NetMsgType::SYNCSTATUSCOUNT) { //Sync status count
 
@@ -134,9 +162,58 @@ void CMasternodeSync::ProcessMessage(CNode* pfrom, const std::string& strCommand
         vRecv >> nItemID >> nCount;
 
         LogPrintf("SYNCSTATUSCOUNT -- got inventory count: nItemID=%d  nCount=%d  peer=%d\n", nItemID, nCount, pfrom->GetId());
+
+        // VELES BEGIN
+        // The count follows the items a peer sent for the asset it was asked for
+        const int nAsset = nItemID == MASTERNODE_SYNC_GOVOBJ ? MASTERNODE_SYNC_GOVERNANCE : nItemID;
+        LOCK(cs);
+        if(nAsset != nRequestedMasternodeAssets || !mapAssetRequests.count(pfrom->GetId())) return;
+        setAssetReplies.insert(pfrom->GetId());
+        nTimeLastReply = GetTime();
+        fTickNow = true;
+        CheckAssetComplete(connman);
+        // VELES END
     }
 }
 
+// VELES BEGIN
+void CMasternodeSync::AssetRequested(CNode* pnode)
+{
+    mapAssetRequests[pnode->GetId()] = GetTime();
+}
+
+int CMasternodeSync::CountPendingRequests()
+{
+    // Peers that did not reply in time free their slot for another one
+    const int64_t nNow = GetTime();
+    int nPending = 0;
+    for (const auto& request : mapAssetRequests) {
+        if (!setAssetReplies.count(request.first) && nNow - request.second <= MASTERNODE_SYNC_TIMEOUT_SECONDS)
+            nPending++;
+    }
+    return nPending;
+}
+
+void CMasternodeSync::CheckAssetComplete(CConnman& connman)
+{
+    // The governance votes are requested object by object once the objects arrived, ProcessTick
+    // tells when they are done
+    if (nRequestedMasternodeAssets != MASTERNODE_SYNC_LIST && nRequestedMasternodeAssets != MASTERNODE_SYNC_MNW)
+        return;
+    if (setAssetReplies.empty() || CountPendingRequests() > 0)
+        return;
+    // payment votes are fetched from two peers at least, with fewer the timeout moves on
+    if (nRequestedMasternodeAssets == MASTERNODE_SYNC_MNW && setAssetReplies.size() < 2)
+        return;
+    // items announced before the count are still being fetched until nothing arrives for a while
+    if (GetTime() - std::max(nTimeLastReply, (int64_t)nTimeLastBumped) < MASTERNODE_SYNC_SETTLE_SECONDS)
+        return;
+
+    LogPrintf("CMasternodeSync::CheckAssetComplete -- %d of %d peers replied for %s\n", setAssetReplies.size(), mapAssetRequests.size(), GetAssetName());
+    SwitchToNextAsset(connman);
+}
+// VELES END
+
 void CMasternodeSync::ClearFulfilledRequests(CConnman& connman)
 {
     // TODO: Find out whether we can just use LOCK instead of:
@@ -144,18 +221,29 @@ void CMasternodeSync::ClearFulfilledRequests(CConnman& connman)
     // if(!lockRecv) return;
 
     connman.ForEachNode(CConnman::AllNodes, [](CNode* pnode) {
-        netfulfilledman.RemoveFulfilledRequest(pnode->addr, "spork-sync");
-        netfulfilledman.RemoveFulfilledRequest(pnode->addr, "masternode-list-sync");
-        netfulfilledman.RemoveFulfilledRequest(pnode->addr, "masternode-payment-sync");
-        netfulfilledman.RemoveFulfilledRequest(pnode->addr, "governance-sync");
-        netfulfilledman.RemoveFulfilledRequest(pnode->addr, "full-sync");
+        netfulfilledman.RemoveFulfilledRequest(pnode->addr, FULFILLED_SPORK_SYNC);
+        netfulfilledman.RemoveFulfilledRequest(pnode->addr, FULFILLED_MASTERNODE_LIST_SYNC);
+        netfulfilledman.RemoveFulfilledRequest(pnode->addr, FULFILLED_MASTERNODE_PAYMENT_SYNC);
+        netfulfilledman.RemoveFulfilledRequest(pnode->addr, FULFILLED_GOVERNANCE_SYNC);
+        netfulfilledman.RemoveFulfilledRequest(pnode->addr, FULFILLED_FULL_SYNC);
     });
 }
 
 void CMasternodeSync::ProcessTick(CConnman& connman)
 {
+    LOCK(cs); // VELES
     static int nTick = 0;
-    if(nTick++ % MASTERNODE_SYNC_TICK_SECONDS != 0) return;
+    // if(nTick++ % MASTERNODE_SYNC_TICK_SECONDS != 0) return;
+    // VELES BEGIN
+    // Replies drive the sync, the ticks in between only check whether the current asset settled.
+    // Every MASTERNODE_SYNC_TICK_SECONDS, or right after a reply or a new asset, the peers are
+    // asked for the asset and the stalled ones time out.
+    if(nTick++ % MASTERNODE_SYNC_TICK_SECONDS != 0 && !fTickNow) {
+        if(!IsFailed() && !IsSynced()) CheckAssetComplete(connman);
+        return;
+    }
+    fTickNow = false;
+    // VELES END
 
     // reset the sync process if the last call to this function was more than 60 minutes ago (client was in sleep mode)
     static int64_t nTimeLastProcess = GetTime();
@@ -222,7 +310,7 @@ void CMasternodeSync::ProcessTick(CConnman& connman)
 
         // NORMAL NETWORK MODE - TESTNET/MAINNET
         {
-            if(masternodeSync.IsSynced() && netfulfilledman.HasFulfilledRequest(pnode->addr, "full-sync")) {
+            if(masternodeSync.IsSynced() && netfulfilledman.HasFulfilledRequest(pnode->addr, FULFILLED_FULL_SYNC)) {
                 // We already fully synced from this node recently,
                 // disconnect to free this connection slot for another peer.
                 pnode->fDisconnect = true;
@@ -232,9 +320,9 @@ void CMasternodeSync::ProcessTick(CConnman& connman)
 
             // SPORK : ALWAYS ASK FOR SPORKS AS WE SYNC
 
-            if(!netfulfilledman.HasFulfilledRequest(pnode->addr, "spork-sync")) {
+            if(!netfulfilledman.HasFulfilledRequest(pnode->addr, FULFILLED_SPORK_SYNC)) {
                 // always get sporks first, only request once from each peer
-                netfulfilledman.AddFulfilledRequest(pnode->addr, "spork-sync");
+                netfulfilledman.AddFulfilledRequest(pnode->addr, FULFILLED_SPORK_SYNC);
                 // get current network sporks
                 connman.PushMessage(pnode, CNetMsgMaker(INIT_PROTO_VERSION).Make(NetMsgType::GETSPORKS));
                 LogPrintf("CMasternodeSync::ProcessTick -- nTick %d nRequestedMasternodeAssets %d -- requesting sporks from peer %d\n", nTick, nRequestedMasternodeAssets, pnode->GetId());
@@ -276,16 +364,25 @@ void CMasternodeSync::ProcessTick(CConnman& connman)
                 }
 
                 // only request once from each peer
-                if(netfulfilledman.HasFulfilledRequest(pnode->addr, "masternode-list-sync")) continue;
-                netfulfilledman.AddFulfilledRequest(pnode->addr, "masternode-list-sync");
+                if(netfulfilledman.HasFulfilledRequest(pnode->addr, FULFILLED_MASTERNODE_LIST_SYNC)) continue;
+                if(CountPendingRequests() >= MASTERNODE_SYNC_PARALLEL_PEERS) continue; // VELES
+                netfulfilledman.AddFulfilledRequest(pnode->addr, FULFILLED_MASTERNODE_LIST_SYNC);
 
                 if (pnode->nVersion < mnpayments.GetMinMasternodePaymentsProto()) continue;
                 nRequestedMasternodeAttempt++;
-
-                mnodeman.DsegUpdate(pnode, connman);
-
-                connman.ReleaseNodeVector(vNodesCopy);
-                return; //this will cause each peer to get one request each six seconds for the various assets we need
+                AssetRequested(pnode); // VELES
+
+                //mnodeman.DsegUpdate(pnode, connman);
+                // VELES BEGIN
+                if (pnode->nVersion >= MNLISTDIFF_VERSION)
+                    mnodeman.ListDiffUpdate(pnode, connman);
+                else
+                    mnodeman.DsegUpdate(pnode, connman);
+                // VELES END
+
+                // connman.ReleaseNodeVector(vNodesCopy);
+                // return; //this will cause each peer to get one request each six seconds for the various assets we need
+                continue; // VELES: up to MASTERNODE_SYNC_PARALLEL_PEERS peers are asked at once
             }
 
             // MNW : SYNC MASTERNODE PAYMENT VOTES FROM OTHER CONNECTED CLIENTS
@@ -320,19 +417,23 @@ void CMasternodeSync::ProcessTick(CConnman& connman)
                 }
 
                 // only request once from each peer
-                if(netfulfilledman.HasFulfilledRequest(pnode->addr, "masternode-payment-sync")) continue;
-                netfulfilledman.AddFulfilledRequest(pnode->addr, "masternode-payment-sync");
+                if(netfulfilledman.HasFulfilledRequest(pnode->addr, FULFILLED_MASTERNODE_PAYMENT_SYNC)) continue;
+                if(CountPendingRequests() >= MASTERNODE_SYNC_PARALLEL_PEERS) continue; // VELES
+                netfulfilledman.AddFulfilledRequest(pnode->addr, FULFILLED_MASTERNODE_PAYMENT_SYNC);
 
                 if(pnode->nVersion < mnpayments.GetMinMasternodePaymentsProto()) continue;
                 nRequestedMasternodeAttempt++;
+                AssetRequested(pnode); // VELES
 
                 // ask node for all payment votes it has (new nodes will only return votes for future payments)
                 connman.PushMessage(pnode, CNetMsgMaker(pnode->GetSendVersion()).Make(NetMsgType::MASTERNODEPAYMENTSYNC, mnpayments.GetStorageLimit()));
                 // ask node for missing pieces only (old nodes will not be asked)
-                mnpayments.RequestLowDataPaymentBlocks(pnode, connman);
+                // mnpayments.RequestLowDataPaymentBlocks(pnode, connman);
+                mnpayments.RequestLowDataPaymentBlocks(pnode, connman, MASTERNODE_SYNC_PARALLEL_PEERS); // VELES: the peers asked share the missing blocks
 
-                connman.ReleaseNodeVector(vNodesCopy);
-                return; //this will cause each peer to get one request each six seconds for the various assets we need
+                // connman.ReleaseNodeVector(vNodesCopy);
+                // return; //this will cause each peer to get one request each six seconds for the various assets we need
+                continue; // VELES: up to MASTERNODE_SYNC_PARALLEL_PEERS peers are asked at once
             }
 
             // GOVOBJ : SYNC GOVERNANCE ITEMS FROM OUR PEERS
@@ -353,7 +454,7 @@ void CMasternodeSync::ProcessTick(CConnman& connman)
                 }
 
                 // only request obj sync once from each peer, then request votes on per-obj basis
-                if(netfulfilledman.HasFulfilledRequest(pnode->addr, "governance-sync")) {
+                if(netfulfilledman.HasFulfilledRequest(pnode->addr, FULFILLED_GOVERNANCE_SYNC)) {
                     int nObjsLeftToAsk = governance.RequestGovernanceObjectVotes(pnode, connman);
                     static int64_t nTimeNoObjectsLeft = 0;
                     // check for data
@@ -385,15 +486,18 @@ void CMasternodeSync::ProcessTick(CConnman& connman)
                     }
                     continue;
                 }
-                netfulfilledman.AddFulfilledRequest(pnode->addr, "governance-sync");
+                if(CountPendingRequests() >= MASTERNODE_SYNC_PARALLEL_PEERS) continue; // VELES
+                netfulfilledman.AddFulfilledRequest(pnode->addr, FULFILLED_GOVERNANCE_SYNC);
 
                 if (pnode->nVersion < MIN_GOVERNANCE_PEER_PROTO_VERSION) continue;
                 nRequestedMasternodeAttempt++;
+                AssetRequested(pnode); // VELES
 
                 SendGovernanceSyncRequest(pnode, connman);
 
-                connman.ReleaseNodeVector(vNodesCopy);
-                return; //this will cause each peer to get one request each six seconds for the various assets we need
+                // connman.ReleaseNodeVector(vNodesCopy);
+                // return; //this will cause each peer to get one request each six seconds for the various assets we need
+                continue; // VELES: up to MASTERNODE_SYNC_PARALLEL_PEERS peers are asked at once
             }
         }
     }
@@ -11,6 +11,13 @@
 
 #include <univalue.h>
 
+// VELES BEGIN
+#include <atomic>
+#include <map>
+#include <set>
+#include <sync.h>
+// VELES END
+
 class CMasternodeSync;
 
 static const int MASTERNODE_SYNC_FAILED          = -1;
@@ -27,6 +34,10 @@ static const int MASTERNODE_SYNC_TICK_SECONDS    = 6;
 static const int MASTERNODE_SYNC_TIMEOUT_SECONDS = 30; // our blocks are 2.5 minutes so 30 seconds should be fine
 
 static const int MASTERNODE_SYNC_ENOUGH_PEERS    = 6;
+// VELES BEGIN
+static const int MASTERNODE_SYNC_PARALLEL_PEERS  = 3; // peers asked for an asset at the same time
+static const int MASTERNODE_SYNC_SETTLE_SECONDS  = 3; // quiet time after the last reply before an asset is complete
+// VELES END
 
 extern CMasternodeSync masternodeSync;
 
@@ -37,23 +48,59 @@ extern CMasternodeSync masternodeSync;
 class CMasternodeSync
 {
 private:
+    // VELES BEGIN
+    // Guards the sync progress, taken before the locks of the other managers. The asset,
+    // attempt and bump time are read and bumped without it.
+    CCriticalSection cs;
+    // VELES END
+
     // Keep track of current asset
-    int nRequestedMasternodeAssets;
+    // int nRequestedMasternodeAssets;
+    std::atomic<int> nRequestedMasternodeAssets; // VELES
     // Count peers we've requested the asset from
-    int nRequestedMasternodeAttempt;
+    // int nRequestedMasternodeAttempt;
+    std::atomic<int> nRequestedMasternodeAttempt; // VELES
 
     // Time when current masternode asset sync started
     int64_t nTimeAssetSyncStarted;
     // ... last bumped
-    int64_t nTimeLastBumped;
+    // int64_t nTimeLastBumped;
+    std::atomic<int64_t> nTimeLastBumped; // VELES
     // ... or failed
     int64_t nTimeLastFailure;
+    // VELES BEGIN
+    // the masternode, payments and governance caches are loaded in the background
+    std::atomic<bool> fCachesLoaded{false};
+
+    // Peers asked for the current asset and when, and those that replied with their sync status count
+    std::map<NodeId, int64_t> mapAssetRequests GUARDED_BY(cs);
+    std::set<NodeId> setAssetReplies GUARDED_BY(cs);
+    int64_t nTimeLastReply GUARDED_BY(cs);
+    // Run the next tick right away, set when a reply arrives or the asset changes
+    bool fTickNow GUARDED_BY(cs);
+
+    void AssetRequested(CNode* pnode) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    int CountPendingRequests() EXCLUSIVE_LOCKS_REQUIRED(cs);
+    // Move to the next asset once the peers asked for the current one replied and the data settled
+    void CheckAssetComplete(CConnman& connman) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    // VELES END
 
     void Fail();
     void ClearFulfilledRequests(CConnman& connman);
 
 public:
-    CMasternodeSync() { Reset(); }
+    // CMasternodeSync() { Reset(); }
+    // VELES BEGIN
+    CMasternodeSync() :
+        nRequestedMasternodeAssets(MASTERNODE_SYNC_INITIAL),
+        nRequestedMasternodeAttempt(0),
+        nTimeAssetSyncStarted(GetTime()),
+        nTimeLastBumped(GetTime()),
+        nTimeLastFailure(0),
+        nTimeLastReply(0),
+        fTickNow(false)
+    {}
+    // VELES END
 
 
     void SendGovernanceSyncRequest(CNode* pnode, CConnman& connman);
@@ -63,6 +110,10 @@ public:
     bool IsMasternodeListSynced() { return nRequestedMasternodeAssets > MASTERNODE_SYNC_LIST; }
     bool IsWinnersListSynced() { return nRequestedMasternodeAssets > MASTERNODE_SYNC_MNW; }
     bool IsSynced() { return nRequestedMasternodeAssets == MASTERNODE_SYNC_FINISHED; }
+    // VELES BEGIN
+    bool IsCachesLoaded() { return fCachesLoaded; }
+    void SetCachesLoaded() { fCachesLoaded = true; }
+    // VELES END
 
     int GetAssetID() { return nRequestedMasternodeAssets; }
     int GetAttempt() { return nRequestedMasternodeAttempt; }
@@ -74,7 +125,8 @@ public:
     void Reset();
     void SwitchToNextAsset(CConnman& connman);
 
-    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv);
+    // void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv);
+    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman); // VELES
     void ProcessTick(CConnman& connman);
 
     void AcceptedBlockHeader(const CBlockIndex *pindexNew);
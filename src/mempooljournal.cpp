@@ -0,0 +1,269 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <mempooljournal.h>
+
+#include <clientversion.h>
+#include <serialize.h>
+#include <txmempool.h>
+#include <util/system.h>
+
+static const uint64_t MEMPOOL_JOURNAL_VERSION = 1;
+/** The journal is rewritten once it is larger than this and twice the size of the mempool */
+static const uint64_t MEMPOOL_JOURNAL_MIN_REWRITE = 32 << 20;
+
+CMempoolJournal g_mempool_journal;
+
+CMempoolJournal::~CMempoolJournal()
+{
+    LOCK(cs_file);
+    if (m_file) fclose(m_file);
+}
+
+void CMempoolJournal::Append(RecordType type, const uint256& hash)
+{
+    LOCK(cs);
+    m_buffer << (uint8_t)type << hash;
+}
+
+void CMempoolJournal::Added(const CTransactionRef& tx, int64_t nTime)
+{
+    LOCK(cs);
+    m_buffer << (uint8_t)TX_ADDED << tx << nTime;
+}
+
+void CMempoolJournal::Removed(const uint256& hash)
+{
+    Append(TX_REMOVED, hash);
+}
+
+void CMempoolJournal::DeltaAdded(const uint256& hash, CAmount nFeeDelta)
+{
+    LOCK(cs);
+    m_buffer << (uint8_t)DELTA_ADDED << hash << nFeeDelta;
+}
+
+void CMempoolJournal::DeltaCleared(const uint256& hash)
+{
+    Append(DELTA_CLEARED, hash);
+}
+
+void CMempoolJournal::LockChanged(const uint256& hash, bool fLocked)
+{
+    Append(fLocked ? IS_LOCKED : IS_UNLOCKED, hash);
+}
+
+void CMempoolJournal::Cleared()
+{
+    LOCK(cs);
+    m_buffer << (uint8_t)CLEARED;
+}
+
+bool CMempoolJournal::Write(const CDataStream& records)
+{
+    if (records.empty()) return true;
+    if (fwrite(records.data(), 1, records.size(), m_file) != records.size() || fflush(m_file) != 0) {
+        LogPrintf("%s: Failed to write the mempool journal, it is not kept any more\n", __func__);
+        fclose(m_file);
+        m_file = nullptr;
+        return false;
+    }
+    m_file_size += records.size();
+    return true;
+}
+
+bool CMempoolJournal::Rewrite()
+{
+    // Take the contents of the mempool and start buffering its changes at the same time,
+    // they are appended after the contents
+    std::vector<TxMempoolInfo> vinfo;
+    std::map<uint256, CAmount> mapDeltas;
+    std::vector<uint256> vLocked;
+    {
+        LOCK(m_pool->cs);
+        vinfo = m_pool->infoAll();
+        mapDeltas = m_pool->mapDeltas;
+        vLocked.assign(m_pool->setInstantSendLocked.begin(), m_pool->setInstantSendLocked.end());
+        LOCK(cs);
+        m_buffer.clear();
+        m_pool->SetJournal(this);
+    }
+
+    const fs::path path = GetDataDir() / MEMPOOL_JOURNAL_FILENAME;
+    const fs::path path_new = GetDataDir() / (std::string(MEMPOOL_JOURNAL_FILENAME) + ".new");
+    try {
+        CAutoFile file(fsbridge::fopen(path_new, "wb"), SER_DISK, CLIENT_VERSION);
+        if (file.IsNull()) {
+            throw std::runtime_error("Unable to open " + path_new.string());
+        }
+        file << MEMPOOL_JOURNAL_VERSION;
+        for (const auto& delta : mapDeltas) {
+            file << (uint8_t)DELTA_ADDED << delta.first << delta.second;
+        }
+        // Parents come before their children
+        for (const TxMempoolInfo& info : vinfo) {
+            file << (uint8_t)TX_ADDED << info.tx << (int64_t)info.nTime;
+        }
+        for (const uint256& hash : vLocked) {
+            file << (uint8_t)IS_LOCKED << hash;
+        }
+        if (!FileCommit(file.Get())) {
+            throw std::runtime_error("FileCommit failed");
+        }
+        file.fclose();
+        if (m_file) fclose(m_file);
+        m_file = nullptr;
+        if (!RenameOver(path_new, path)) {
+            throw std::runtime_error("Unable to rename " + path_new.string());
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("%s: Failed to write the mempool journal: %s\n", __func__, e.what());
+        // The changes buffered since the last flush are gone, do not leave an incomplete journal
+        if (m_file) fclose(m_file);
+        m_file = nullptr;
+        boost::system::error_code ec;
+        fs::remove(path, ec);
+        fs::remove(path_new, ec);
+        return false;
+    }
+
+    m_file = fsbridge::fopen(path, "ab");
+    if (!m_file) {
+        LogPrintf("%s: Failed to open the mempool journal\n", __func__);
+        return false;
+    }
+    m_file_size = fs::file_size(path);
+    LogPrint(BCLog::MEMPOOL, "Rewrote the mempool journal: %u txn, %u bytes\n", vinfo.size(), m_file_size);
+    return true;
+}
+
+bool CMempoolJournal::Open(CTxMemPool& pool)
+{
+    LOCK(cs_file);
+    m_pool = &pool;
+    if (Rewrite()) return true;
+    Detach();
+    return false;
+}
+
+void CMempoolJournal::Flush()
+{
+    LOCK(cs_file);
+    if (!m_file) return;
+
+    CDataStream records(SER_DISK, CLIENT_VERSION);
+    {
+        LOCK(cs);
+        records.write(m_buffer.data(), m_buffer.size());
+        m_buffer.clear();
+    }
+    if (!Write(records)) {
+        Detach();
+        return;
+    }
+
+    // The removed transactions make up most of the journal now
+    if (m_file_size > MEMPOOL_JOURNAL_MIN_REWRITE && m_file_size > 2 * m_pool->GetTotalTxSize()) {
+        if (!Rewrite()) Detach();
+    }
+}
+
+bool CMempoolJournal::Detach()
+{
+    if (!m_pool) return false;
+    {
+        LOCK(m_pool->cs);
+        m_pool->SetJournal(nullptr);
+    }
+    m_pool = nullptr;
+
+    CDataStream records(SER_DISK, CLIENT_VERSION);
+    {
+        LOCK(cs);
+        records.write(m_buffer.data(), m_buffer.size());
+        m_buffer.clear();
+    }
+    if (m_file && Write(records) && FileCommit(m_file)) {
+        fclose(m_file);
+        m_file = nullptr;
+        return true;
+    }
+    // Changes are missing from the journal, it must not be loaded
+    if (m_file) fclose(m_file);
+    m_file = nullptr;
+    boost::system::error_code ec;
+    fs::remove(GetDataDir() / MEMPOOL_JOURNAL_FILENAME, ec);
+    return false;
+}
+
+bool CMempoolJournal::Close()
+{
+    LOCK(cs_file);
+    return Detach();
+}
+
+bool CMempoolJournal::Read(const fs::path& path, Contents& contents)
+{
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) return false;
+
+    // Position of every transaction in contents.vtx, removed ones are nulled and dropped at the end
+    std::map<uint256, size_t> mapIndex;
+    try {
+        uint64_t version;
+        file >> version;
+        if (version != MEMPOOL_JOURNAL_VERSION) return false;
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    try {
+        while (true) {
+            uint8_t type;
+            file >> type;
+            if (type == TX_ADDED) {
+                CTransactionRef tx;
+                int64_t nTime;
+                file >> tx >> nTime;
+                auto it = mapIndex.find(tx->GetHash());
+                if (it != mapIndex.end()) contents.vtx[it->second].first = nullptr;
+                mapIndex[tx->GetHash()] = contents.vtx.size();
+                contents.vtx.emplace_back(tx, nTime);
+            } else if (type == DELTA_ADDED) {
+                uint256 hash;
+                CAmount nFeeDelta;
+                file >> hash >> nFeeDelta;
+                contents.mapDeltas[hash] += nFeeDelta;
+            } else if (type == CLEARED) {
+                contents.vtx.clear();
+                mapIndex.clear();
+            } else {
+                uint256 hash;
+                file >> hash;
+                if (type == TX_REMOVED) {
+                    auto it = mapIndex.find(hash);
+                    if (it != mapIndex.end()) {
+                        contents.vtx[it->second].first = nullptr;
+                        mapIndex.erase(it);
+                    }
+                } else if (type == DELTA_CLEARED) {
+                    contents.mapDeltas.erase(hash);
+                } else if (type == IS_LOCKED) {
+                    contents.setLocked.insert(hash);
+                } else if (type == IS_UNLOCKED) {
+                    contents.setLocked.erase(hash);
+                } else {
+                    throw std::ios_base::failure("Unknown mempool journal record");
+                }
+            }
+        }
+    } catch (const std::exception&) {
+        // The end of the journal, or a record cut short
+    }
+
+    contents.vtx.erase(std::remove_if(contents.vtx.begin(), contents.vtx.end(), [](const std::pair<CTransactionRef, int64_t>& entry) {
+        return entry.first == nullptr;
+    }), contents.vtx.end());
+    return true;
+}
@@ -0,0 +1,103 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef VELES_MEMPOOLJOURNAL_H
+#define VELES_MEMPOOLJOURNAL_H
+
+#include <amount.h>
+#include <clientversion.h>
+#include <fs.h>
+#include <primitives/transaction.h>
+#include <streams.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <map>
+#include <set>
+#include <stdint.h>
+#include <stdio.h>
+#include <utility>
+#include <vector>
+
+class CTxMemPool;
+
+/** Name of the mempool journal in the data directory */
+static const char* const MEMPOOL_JOURNAL_FILENAME = "mempool.journal";
+/** Seconds between writes of the buffered journal records */
+static const int64_t MEMPOOL_JOURNAL_FLUSH_INTERVAL = 10;
+
+/**
+ * Append-only record of the mempool changes, so the mempool is persisted as it changes instead
+ * of being dumped at shutdown. The mempool hands every change to the journal, which buffers
+ * the records and appends them to the file on Flush, from the scheduler and at shutdown.
+ * Once the file grows well beyond the size of the mempool it is rewritten with the current
+ * contents only.
+ *
+ * Besides the transactions and their acceptance times, the journal keeps the fee deltas of
+ * prioritisetransaction and the InstantSend lock state of the mempool.
+ */
+class CMempoolJournal
+{
+public:
+    enum RecordType : uint8_t {
+        TX_ADDED = 1,
+        TX_REMOVED = 2,
+        DELTA_ADDED = 3,
+        DELTA_CLEARED = 4,
+        IS_LOCKED = 5,
+        IS_UNLOCKED = 6,
+        CLEARED = 7,
+    };
+
+    /** The mempool a journal describes, transactions in the order they entered it */
+    struct Contents {
+        std::vector<std::pair<CTransactionRef, int64_t>> vtx;
+        std::map<uint256, CAmount> mapDeltas;
+        std::set<uint256> setLocked;
+    };
+
+private:
+    //! Guards the buffered records, taken with the mempool lock held
+    Mutex cs;
+    CDataStream m_buffer GUARDED_BY(cs){SER_DISK, CLIENT_VERSION};
+
+    //! Guards the file, held while writing it
+    Mutex cs_file;
+    FILE* m_file GUARDED_BY(cs_file) = nullptr;
+    uint64_t m_file_size GUARDED_BY(cs_file) = 0;
+    CTxMemPool* m_pool GUARDED_BY(cs_file) = nullptr;
+
+    void Append(RecordType type, const uint256& hash);
+    bool Rewrite() EXCLUSIVE_LOCKS_REQUIRED(cs_file);
+    bool Write(const CDataStream& records) EXCLUSIVE_LOCKS_REQUIRED(cs_file);
+    bool Detach() EXCLUSIVE_LOCKS_REQUIRED(cs_file);
+
+public:
+    ~CMempoolJournal();
+
+    /** Changes of the mempool, called with its lock held */
+    void Added(const CTransactionRef& tx, int64_t nTime);
+    void Removed(const uint256& hash);
+    void DeltaAdded(const uint256& hash, CAmount nFeeDelta);
+    void DeltaCleared(const uint256& hash);
+    void LockChanged(const uint256& hash, bool fLocked);
+    void Cleared();
+
+    /** Start a journal holding the current contents of pool and record its changes from now on */
+    bool Open(CTxMemPool& pool);
+    /** Append the buffered records, rewriting the journal when it grew too large */
+    void Flush();
+    /**
+     * Append the buffered records and stop recording the changes of the mempool. Returns false
+     * when the journal does not hold the mempool, it was not opened or could not be written.
+     */
+    bool Close();
+
+    /** Replay the journal at path, false when it cannot be read. A record cut short by a crash ends the journal. */
+    static bool Read(const fs::path& path, Contents& contents);
+};
+
+extern CMempoolJournal g_mempool_journal;
+
+#endif // VELES_MEMPOOLJOURNAL_H
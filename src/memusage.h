@@ -5,7 +5,9 @@
 #ifndef BITCOIN_MEMUSAGE_H
 #define BITCOIN_MEMUSAGE_H
 
+#include <arenamap.h> // VELES
 #include <indirectmap.h>
+#include <prevector.h> // VELES
 
 #include <stdlib.h>
 
@@ -131,6 +133,24 @@ static inline size_t IncrementalDynamicUsage(const indirectmap<X, Y>& m)
     return MallocUsage(sizeof(stl_tree_node<std::pair<const X*, Y> >));
 }
 
+// VELES BEGIN
+// arenamap allocates its table, free list and arena chunks, but nothing per entry
+
+template<typename X, typename Y, typename Z>
+static inline size_t DynamicUsage(const arenamap<X, Y, Z>& m)
+{
+    size_t usage = MallocUsage(m.slot_bytes()) + MallocUsage(m.free_list_bytes()) + MallocUsage(sizeof(void*) * m.chunk_count());
+    for (size_t i = 0; i < m.chunk_count(); ++i) {
+        if (arenamap<X, Y, Z>::chunk_size(i) == arenamap<X, Y, Z>::chunk_size(m.chunk_count())) {
+            // All the chunks from here on have the same size
+            return usage + MallocUsage(m.chunk_size(i) * m.entry_bytes()) * (m.chunk_count() - i);
+        }
+        usage += MallocUsage(m.chunk_size(i) * m.entry_bytes());
+    }
+    return usage;
+}
+// VELES END
+
 template<typename X>
 static inline size_t DynamicUsage(const std::unique_ptr<X>& p)
 {
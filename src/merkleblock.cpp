@@ -7,6 +7,7 @@
 
 #include <hash.h>
 #include <consensus/consensus.h>
+#include <memusage.h> // VELES
 #include <util/strencodings.h>
 
 
@@ -37,6 +38,43 @@ CMerkleBlock::CMerkleBlock(const CBlock& block, CBloomFilter* filter, const std:
     txn = CPartialMerkleTree(vHashes, vMatch);
 }
 
+// VELES BEGIN
+CBlockBloomElements::CBlockBloomElements(const CBlock& block) : header(block.GetBlockHeader())
+{
+    vtx.reserve(block.vtx.size());
+    for (const CTransactionRef& tx : block.vtx)
+        vtx.emplace_back(*tx);
+    nUsage = memusage::DynamicUsage(vtx);
+    for (const CBloomTxElements& elements : vtx)
+        nUsage += elements.DynamicMemoryUsage();
+}
+
+CMerkleBlock::CMerkleBlock(const CBlockBloomElements& elements, CBloomFilter& filter)
+{
+    header = elements.header;
+
+    std::vector<bool> vMatch;
+    std::vector<uint256> vHashes;
+
+    vMatch.reserve(elements.vtx.size());
+    vHashes.reserve(elements.vtx.size());
+
+    for (unsigned int i = 0; i < elements.vtx.size(); i++)
+    {
+        const uint256& hash = elements.vtx[i].hash;
+        if (filter.IsRelevantAndUpdate(elements.vtx[i])) {
+            vMatch.push_back(true);
+            vMatchedTxn.emplace_back(i, hash);
+        } else {
+            vMatch.push_back(false);
+        }
+        vHashes.push_back(hash);
+    }
+
+    txn = CPartialMerkleTree(vHashes, vMatch);
+}
+// VELES END
+
 uint256 CPartialMerkleTree::CalcHash(int height, unsigned int pos, const std::vector<uint256> &vTxid) {
     //we can never have zero txs in a merkle block, we always need the coinbase tx
     //if we do not have this assert, we can hit a memory access violation when indexing into vTxid
@@ -124,6 +124,18 @@ public:
 };
 
 
+// VELES BEGIN
+/** The bloom filter elements of every transaction of a block */
+struct CBlockBloomElements
+{
+    CBlockHeader header;
+    std::vector<CBloomTxElements> vtx;
+    size_t nUsage;
+
+    explicit CBlockBloomElements(const CBlock& block);
+};
+// VELES END
+
 /**
  * Used to relay blocks as header + vector<merkle branch>
  * to filtered nodes.
@@ -155,6 +167,14 @@ public:
     // Create from a CBlock, matching the txids in the set
     CMerkleBlock(const CBlock& block, const std::set<uint256>& txids) : CMerkleBlock(block, nullptr, &txids) { }
 
+    // VELES BEGIN
+    /**
+     * Create from the bloom filter elements of a block, with the same matches
+     * and filter updates as from the block itself
+     */
+    CMerkleBlock(const CBlockBloomElements& elements, CBloomFilter& filter);
+    // VELES END
+
     CMerkleBlock() {}
 
     ADD_SERIALIZE_METHODS;
@@ -3,12 +3,76 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <checkqueue.h>
+#include <crypto/sha256.h>
+#include <cuckoocache.h>
 #include <hash.h>
 #include <key_io.h>
 #include <validation.h> // For strMessageMagic
 #include <messagesigner.h>
+#include <random.h>
+#include <script/sigcache.h>
 #include <tinyformat.h>
 #include <util/strencodings.h>
+#include <util/system.h>
+
+#include <boost/thread.hpp>
+
+// VELES BEGIN
+namespace {
+/**
+ * Valid hash signature cache, the same masternode messages are relayed by
+ * many peers and their signatures are checked again on every copy.
+ */
+class CHashSignerCache
+{
+private:
+    //! Entries are SHA256(nonce || hash || public key id || signature):
+    uint256 nonce;
+    typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
+    map_type setValid;
+    boost::shared_mutex cs_sigcache;
+
+public:
+    CHashSignerCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+    }
+
+    void ComputeEntry(uint256& entry, const uint256& hash, const CKeyID& keyID, const std::vector<unsigned char>& vchSig)
+    {
+        CSHA256().Write(nonce.begin(), 32).Write(hash.begin(), 32).Write(keyID.begin(), keyID.size()).Write(vchSig.data(), vchSig.size()).Finalize(entry.begin());
+    }
+
+    bool Get(const uint256& entry)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        return setValid.contains(entry, false);
+    }
+
+    void Set(uint256& entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        setValid.insert(entry);
+    }
+
+    uint32_t setup_bytes(size_t n)
+    {
+        return setValid.setup_bytes(n);
+    }
+};
+
+static CHashSignerCache hashSignerCache;
+} // namespace
+
+void InitHashSignerCache()
+{
+    size_t nMaxCacheSize = (size_t)HASH_SIGNER_CACHE_SIZE << 20;
+    size_t nElems = hashSignerCache.setup_bytes(nMaxCacheSize);
+    LogPrintf("Using %zu MiB for masternode message signature cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nElems);
+}
+// VELES END
 
 bool CMessageSigner::GetKeysFromSecret(const std::string strSecret, CKey& keyRet, CPubKey& pubkeyRet)
 {
@@ -30,13 +94,27 @@ bool CMessageSigner::SignMessage(const std::string strMessage, std::vector<unsig
 }
 
 bool CMessageSigner::VerifyMessage(const CPubKey pubkey, const std::vector<unsigned char>& vchSig, const std::string strMessage, std::string& strErrorRet)
+{
+    //CHashWriter ss(SER_GETHASH, 0);
+    //ss << strMessageMagic;
+    //ss << strMessage;
+
+    //return CHashSigner::VerifyHash(ss.GetHash(), pubkey, vchSig, strErrorRet);
+    // VELES BEGIN
+    return CHashSigner::VerifyHash(GetMessageHash(strMessage), pubkey, vchSig, strErrorRet);
+    // VELES END
+}
+
+// VELES BEGIN
+uint256 CMessageSigner::GetMessageHash(const std::string& strMessage)
 {
     CHashWriter ss(SER_GETHASH, 0);
     ss << strMessageMagic;
     ss << strMessage;
 
-    return CHashSigner::VerifyHash(ss.GetHash(), pubkey, vchSig, strErrorRet);
+    return ss.GetHash();
 }
+// VELES END
 
 bool CHashSigner::SignHash(const uint256& hash, const CKey key, std::vector<unsigned char>& vchSigRet)
 {
@@ -45,6 +123,13 @@ bool CHashSigner::SignHash(const uint256& hash, const CKey key, std::vector<unsi
 
 bool CHashSigner::VerifyHash(const uint256& hash, const CPubKey pubkey, const std::vector<unsigned char>& vchSig, std::string& strErrorRet)
 {
+    // VELES BEGIN
+    uint256 entry;
+    hashSignerCache.ComputeEntry(entry, hash, pubkey.GetID(), vchSig);
+    if (hashSignerCache.Get(entry))
+        return true;
+    // VELES END
+
     CPubKey pubkeyFromSig;
     if(!pubkeyFromSig.RecoverCompact(hash, vchSig)) {
         strErrorRet = "Error recovering public key.";
@@ -58,5 +143,35 @@ bool CHashSigner::VerifyHash(const uint256& hash, const CPubKey pubkey, const st
         return false;
     }
 
+    // VELES BEGIN
+    hashSignerCache.Set(entry);
+    // VELES END
+
     return true;
 }
+
+// VELES BEGIN
+bool CHashSignerCheck::operator()()
+{
+    std::string strError;
+    *pfValid = CHashSigner::VerifyHash(hash, pubkey, vchSig, strError);
+    // a bad signature must not stop the other checks of the batch
+    return true;
+}
+
+static CCheckQueue<CHashSignerCheck> hashsignercheckqueue(64);
+
+void VerifyHashSignerChecks(std::vector<CHashSignerCheck>& vChecks)
+{
+    // The calling thread takes part, the checks run on it alone without worker threads
+    CCheckQueueControl<CHashSignerCheck> control(&hashsignercheckqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
+
+void ThreadHashSignerCheck()
+{
+    RenameThread("veles-sigcheck");
+    hashsignercheckqueue.Thread();
+}
+// VELES END
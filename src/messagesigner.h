@@ -8,6 +8,15 @@
 
 #include <key.h>
 
+// VELES BEGIN
+#include <vector>
+// VELES END
+
+// VELES BEGIN
+/** Size of the cache of valid masternode message signatures in MiB */
+static const unsigned int HASH_SIGNER_CACHE_SIZE = 8;
+// VELES END
+
 /** Helper class for signing messages and checking their signatures
  */
 class CMessageSigner
@@ -19,6 +28,10 @@ public:
     static bool SignMessage(const std::string strMessage, std::vector<unsigned char>& vchSigRet, const CKey key);
     /// Verify the message signature, returns true if succcessful
     static bool VerifyMessage(const CPubKey pubkey, const std::vector<unsigned char>& vchSig, const std::string strMessage, std::string& strErrorRet);
+    // VELES BEGIN
+    /// Hash signed by SignMessage for the message
+    static uint256 GetMessageHash(const std::string& strMessage);
+    // VELES END
 };
 
 /** Helper class for signing hashes and checking their signatures
@@ -32,4 +45,40 @@ public:
     static bool VerifyHash(const uint256& hash, const CPubKey pubkey, const std::vector<unsigned char>& vchSig, std::string& strErrorRet);
 };
 
+// VELES BEGIN
+/**
+ * Closure verifying one hash signature, used to verify the signatures of a
+ * batch of masternode messages on worker threads before processing them.
+ */
+class CHashSignerCheck
+{
+private:
+    uint256 hash;
+    CPubKey pubkey;
+    std::vector<unsigned char> vchSig;
+    bool* pfValid;
+
+public:
+    CHashSignerCheck() : pfValid(nullptr) {}
+    CHashSignerCheck(const uint256& hashIn, const CPubKey& pubkeyIn, const std::vector<unsigned char>& vchSigIn, bool* pfValidIn) :
+        hash(hashIn), pubkey(pubkeyIn), vchSig(vchSigIn), pfValid(pfValidIn) { }
+
+    bool operator()();
+
+    void swap(CHashSignerCheck &check) {
+        std::swap(hash, check.hash);
+        std::swap(pubkey, check.pubkey);
+        vchSig.swap(check.vchSig);
+        std::swap(pfValid, check.pfValid);
+    }
+};
+
+/** Set up the cache of valid hash signatures, to be called once at startup */
+void InitHashSignerCache();
+/** Run the checks on the signature verification threads, each check stores its own result */
+void VerifyHashSignerChecks(std::vector<CHashSignerCheck>& vChecks);
+/** Run an instance of the signature verification thread */
+void ThreadHashSignerCheck();
+// VELES END
+
 #endif // DASH_MESSAGESIGNER_H
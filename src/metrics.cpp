@@ -0,0 +1,247 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <metrics.h>
+
+#include <chain.h>
+#include <governance/governance.h>
+#include <httpserver.h>
+#include <masternode/manager.h>
+#include <masternode/sync.h>
+#include <net.h>
+#include <rpc/protocol.h>
+#include <sync.h>
+#include <tinyformat.h>
+#include <txmempool.h>
+#include <validation.h>
+
+#include <map>
+#include <set>
+
+CMetrics g_metrics;
+
+void CMetricsHistogram::Observe(int64_t nMicros)
+{
+    for (int i = 0; i < METRICS_LATENCY_BUCKET_COUNT; i++) {
+        if (nMicros <= METRICS_LATENCY_BUCKETS[i])
+            ++vBuckets[i];
+    }
+    ++vBuckets[METRICS_LATENCY_BUCKET_COUNT];
+    nSumMicros += nMicros;
+}
+
+void CMetricsHistogram::Render(const std::string& name, const std::string& help, std::string& out) const
+{
+    out += strprintf("# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+    for (int i = 0; i < METRICS_LATENCY_BUCKET_COUNT; i++) {
+        out += strprintf("%s_bucket{le=\"%g\"} %u\n", name, METRICS_LATENCY_BUCKETS[i] / 1e6, vBuckets[i].load());
+    }
+    const uint64_t nCount = vBuckets[METRICS_LATENCY_BUCKET_COUNT];
+    out += strprintf("%s_bucket{le=\"+Inf\"} %u\n", name, nCount);
+    out += strprintf("%s_sum %f\n", name, nSumMicros / 1e6);
+    out += strprintf("%s_count %u\n", name, nCount);
+}
+
+CMetrics::CMetrics()
+{
+    for (auto& nHeight : vAlgoHeight)
+        nHeight = -1;
+}
+
+void CMetrics::SetTip(const CBlockIndex* pindexTip, bool fInitialDownload)
+{
+    if (!pindexTip)
+        return;
+    nTipHeight = pindexTip->nHeight;
+    nTipTime = pindexTip->GetBlockTime();
+    fInitialBlockDownload = fInitialDownload;
+
+    // Block index entries are never deleted and their pprev, height and version do not
+    // change, so the chain is walked without cs_main
+    std::set<int32_t> setFound;
+    int nDepth = 0;
+    for (const CBlockIndex* pindex = pindexTip; pindex && nDepth < METRICS_ALGO_SCAN_DEPTH && (int)setFound.size() < METRICS_ALGOS; pindex = pindex->pprev, nDepth++) {
+        const int32_t nAlgo = pindex->GetAlgo();
+        const int nIndex = nAlgo >> 8;
+        if (nIndex < 0 || nIndex >= METRICS_ALGOS || !setFound.insert(nAlgo).second)
+            continue;
+        vAlgoHeight[nIndex] = pindex->nHeight;
+    }
+}
+
+void CMetrics::SetHeaderTip(const CBlockIndex* pindexHeader)
+{
+    if (pindexHeader)
+        nHeaderHeight = pindexHeader->nHeight;
+}
+
+void CMetrics::Sample()
+{
+    nMempoolTransactions = mempool.size();
+    nMempoolBytes = mempool.GetTotalTxSize();
+    nMempoolUsage = mempool.DynamicMemoryUsage();
+
+    if (g_connman) {
+        nPeersInbound = g_connman->GetNodeCount(CConnman::CONNECTIONS_IN);
+        nPeersOutbound = g_connman->GetNodeCount(CConnman::CONNECTIONS_OUT);
+    }
+
+    nMasternodes = mnodeman.CountMasternodes();
+    nMasternodesEnabled = mnodeman.CountEnabled();
+    nMasternodeSyncAsset = masternodeSync.GetAssetID();
+
+    int nProposals, nTriggers, nWatchdogs, nOther;
+    governance.CountObjects(nProposals, nTriggers, nWatchdogs, nOther);
+    nGovernanceProposals = nProposals;
+    nGovernanceTriggers = nTriggers;
+    nGovernanceWatchdogs = nWatchdogs;
+    nGovernanceOther = nOther;
+}
+
+void CMetrics::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    SetTip(pindexNew, fInitialDownload);
+}
+
+void CMetrics::NotifyHeaderTip(const CBlockIndex *pindexNew, bool fInitialDownload)
+{
+    SetHeaderTip(pindexNew);
+}
+
+void CMetrics::TransactionAddedToMempool(const CTransactionRef &ptxn)
+{
+    ++nMempoolAccepted;
+}
+
+void CMetrics::BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex, const std::vector<CTransactionRef> &txnConflicted)
+{
+    ++nBlocksConnected;
+}
+
+void CMetrics::BlockDisconnected(const std::shared_ptr<const CBlock> &block)
+{
+    ++nBlocksDisconnected;
+}
+
+void CMetrics::NotifyTransactionLock(const CTransaction &tx)
+{
+    ++nTransactionLocks;
+}
+
+/** Escape a label value of the Prometheus text format */
+static std::string EscapeLabel(const std::string& str)
+{
+    std::string ret;
+    for (char c : str) {
+        if (c == '\\' || c == '"') {
+            ret += '\\';
+            ret += c;
+        } else if (c == '\n') {
+            ret += "\\n";
+        } else {
+            ret += c;
+        }
+    }
+    return ret;
+}
+
+static void RenderHeader(const std::string& name, const std::string& type, const std::string& help, std::string& out)
+{
+    out += strprintf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void RenderValue(const std::string& name, const std::string& type, const std::string& help, int64_t nValue, std::string& out)
+{
+    RenderHeader(name, type, help, out);
+    out += strprintf("%s %d\n", name, nValue);
+}
+
+std::string CMetrics::Render() const
+{
+    std::string out;
+    RenderValue("veles_tip_height", "gauge", "Height of the active chain tip", nTipHeight, out);
+    RenderValue("veles_tip_time_seconds", "gauge", "Block time of the active chain tip", nTipTime, out);
+    RenderValue("veles_header_height", "gauge", "Height of the best known header", nHeaderHeight, out);
+    RenderValue("veles_initial_block_download", "gauge", "Whether the node is in initial block download", fInitialBlockDownload ? 1 : 0, out);
+
+    RenderHeader("veles_algo_tip_height", "gauge", "Height of the last block of the active chain mined by each algo", out);
+    for (int i = 0; i < METRICS_ALGOS; i++) {
+        const int64_t nHeight = vAlgoHeight[i];
+        if (nHeight >= 0)
+            out += strprintf("veles_algo_tip_height{algo=\"%s\"} %d\n", GetAlgoName(i << 8), nHeight);
+    }
+
+    RenderValue("veles_blocks_connected_total", "counter", "Blocks connected to the active chain", nBlocksConnected, out);
+    RenderValue("veles_blocks_disconnected_total", "counter", "Blocks disconnected from the active chain", nBlocksDisconnected, out);
+
+    RenderValue("veles_mempool_transactions", "gauge", "Transactions in the mempool", nMempoolTransactions, out);
+    RenderValue("veles_mempool_bytes", "gauge", "Total size of the transactions in the mempool", nMempoolBytes, out);
+    RenderValue("veles_mempool_usage_bytes", "gauge", "Memory used by the mempool", nMempoolUsage, out);
+    RenderValue("veles_mempool_accepted_total", "counter", "Transactions accepted to the mempool", nMempoolAccepted, out);
+
+    RenderHeader("veles_peers", "gauge", "Connected peers by direction", out);
+    out += strprintf("veles_peers{direction=\"inbound\"} %d\n", nPeersInbound.load());
+    out += strprintf("veles_peers{direction=\"outbound\"} %d\n", nPeersOutbound.load());
+
+    RenderHeader("veles_masternodes", "gauge", "Masternodes in the list, and the enabled ones", out);
+    out += strprintf("veles_masternodes{state=\"total\"} %d\n", nMasternodes.load());
+    out += strprintf("veles_masternodes{state=\"enabled\"} %d\n", nMasternodesEnabled.load());
+    RenderValue("veles_masternode_sync_asset", "gauge", "Masternode sync asset being synced, 999 once finished", nMasternodeSyncAsset, out);
+
+    RenderHeader("veles_governance_objects", "gauge", "Governance objects by type", out);
+    out += strprintf("veles_governance_objects{type=\"proposal\"} %d\n", nGovernanceProposals.load());
+    out += strprintf("veles_governance_objects{type=\"trigger\"} %d\n", nGovernanceTriggers.load());
+    out += strprintf("veles_governance_objects{type=\"watchdog\"} %d\n", nGovernanceWatchdogs.load());
+    out += strprintf("veles_governance_objects{type=\"other\"} %d\n", nGovernanceOther.load());
+
+    RenderValue("veles_instantsend_locks_total", "counter", "Transactions locked by InstantSend", nTransactionLocks, out);
+    histInstantSendLock.Render("veles_instantsend_lock_latency_seconds", "Time from receiving an InstantSend lock request to completing the lock", out);
+
+    // Recorded with -lockstats only, summed over the sites taking each lock
+    if (g_lock_stats) {
+        struct Totals {
+            uint64_t acquisitions = 0;
+            uint64_t contentions = 0;
+            uint64_t wait_micros = 0;
+        };
+        std::map<std::string, Totals> mapLocks;
+        for (const LockSiteStats& site : GetLockStats()) {
+            Totals& totals = mapLocks[site.name];
+            totals.acquisitions += site.acquisitions;
+            totals.contentions += site.contentions;
+            totals.wait_micros += site.wait_micros;
+        }
+        RenderHeader("veles_lock_acquisitions_total", "counter", "Acquisitions of each lock", out);
+        for (const auto& lock : mapLocks)
+            out += strprintf("veles_lock_acquisitions_total{lock=\"%s\"} %u\n", EscapeLabel(lock.first), lock.second.acquisitions);
+        RenderHeader("veles_lock_contentions_total", "counter", "Acquisitions of each lock that waited for another thread", out);
+        for (const auto& lock : mapLocks)
+            out += strprintf("veles_lock_contentions_total{lock=\"%s\"} %u\n", EscapeLabel(lock.first), lock.second.contentions);
+        RenderHeader("veles_lock_wait_seconds_total", "counter", "Time spent waiting for each lock", out);
+        for (const auto& lock : mapLocks)
+            out += strprintf("veles_lock_wait_seconds_total{lock=\"%s\"} %f\n", EscapeLabel(lock.first), lock.second.wait_micros / 1e6);
+    }
+    return out;
+}
+
+static bool HTTPReq_Metrics(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (req->GetRequestMethod() != HTTPRequest::GET) {
+        req->WriteReply(HTTP_BAD_METHOD, "Only GET requests allowed");
+        return false;
+    }
+    req->WriteHeader("Content-Type", "text/plain; version=0.0.4");
+    req->WriteReply(HTTP_OK, g_metrics.Render());
+    return true;
+}
+
+void StartMetricsServer()
+{
+    RegisterHTTPHandler("/metrics", true, HTTPReq_Metrics, HTTPWorkQueueClass::REST);
+}
+
+void StopMetricsServer()
+{
+    UnregisterHTTPHandler("/metrics", true);
+}
@@ -0,0 +1,109 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef VELES_METRICS_H
+#define VELES_METRICS_H
+
+#include <primitives/block.h>
+#include <validationinterface.h>
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+class CBlockIndex;
+
+static const bool DEFAULT_METRICS_ENABLE = false;
+/** Seconds between the samples of the gauges that no notification reports */
+static const int64_t METRICS_SAMPLE_INTERVAL = 5;
+/** Blocks walked back from the tip to find the last block of every algo */
+static const int METRICS_ALGO_SCAN_DEPTH = 1000;
+/** Algos are numbered by bits 8-15 of the block version */
+static const int METRICS_ALGOS = (ALGO_X16R >> 8) + 1;
+/** Upper bounds of the InstantSend lock latency buckets, in microseconds */
+static const int64_t METRICS_LATENCY_BUCKETS[] = {100000, 250000, 500000, 1000000, 2000000, 5000000, 10000000, 30000000, 60000000};
+static const int METRICS_LATENCY_BUCKET_COUNT = sizeof(METRICS_LATENCY_BUCKETS) / sizeof(METRICS_LATENCY_BUCKETS[0]);
+
+/** Latency histogram with fixed buckets, observed and read without locks */
+class CMetricsHistogram
+{
+public:
+    void Observe(int64_t nMicros);
+    /** Append the histogram in the Prometheus text format, in seconds */
+    void Render(const std::string& name, const std::string& help, std::string& out) const;
+
+private:
+    //! Observations up to each bucket bound, the last one counts all of them
+    std::atomic<uint64_t> vBuckets[METRICS_LATENCY_BUCKET_COUNT + 1] = {};
+    std::atomic<int64_t> nSumMicros{0};
+};
+
+/**
+ * Counters and gauges exported at /metrics in the Prometheus text format, for dashboards that
+ * would otherwise poll getblockchaininfo, getmempoolinfo, masternode count and the like. The
+ * chain figures follow the validation interface notifications, InstantSend records the lock
+ * latencies, and the rest is sampled from the managers every METRICS_SAMPLE_INTERVAL seconds.
+ * A scrape only reads these atomics, it does not take cs_main or the locks of the managers.
+ */
+class CMetrics final : public CValidationInterface
+{
+public:
+    CMetrics();
+
+    /** Set the chain gauges to pindexTip, used at startup before notifications arrive */
+    void SetTip(const CBlockIndex* pindexTip, bool fInitialDownload);
+    void SetHeaderTip(const CBlockIndex* pindexHeader);
+    /** Sample the mempool, peer, masternode and governance gauges */
+    void Sample();
+    void ObserveInstantSendLock(int64_t nLatencyMicros) { histInstantSendLock.Observe(nLatencyMicros); }
+
+    /** All metrics in the Prometheus text format */
+    std::string Render() const;
+
+protected:
+    // CValidationInterface
+    void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+    void NotifyHeaderTip(const CBlockIndex *pindexNew, bool fInitialDownload) override;
+    void TransactionAddedToMempool(const CTransactionRef &ptxn) override;
+    void BlockConnected(const std::shared_ptr<const CBlock> &block, const CBlockIndex *pindex, const std::vector<CTransactionRef> &txnConflicted) override;
+    void BlockDisconnected(const std::shared_ptr<const CBlock> &block) override;
+    void NotifyTransactionLock(const CTransaction &tx) override;
+
+private:
+    std::atomic<int64_t> nTipHeight{-1};
+    std::atomic<int64_t> nTipTime{0};
+    std::atomic<int64_t> nHeaderHeight{-1};
+    std::atomic<bool> fInitialBlockDownload{true};
+    //! Height of the last block of each algo, -1 when none was found
+    std::atomic<int64_t> vAlgoHeight[METRICS_ALGOS];
+
+    std::atomic<uint64_t> nBlocksConnected{0};
+    std::atomic<uint64_t> nBlocksDisconnected{0};
+    std::atomic<uint64_t> nMempoolAccepted{0};
+    std::atomic<uint64_t> nTransactionLocks{0};
+
+    std::atomic<int64_t> nMempoolTransactions{0};
+    std::atomic<int64_t> nMempoolBytes{0};
+    std::atomic<int64_t> nMempoolUsage{0};
+    std::atomic<int64_t> nPeersInbound{0};
+    std::atomic<int64_t> nPeersOutbound{0};
+    std::atomic<int64_t> nMasternodes{0};
+    std::atomic<int64_t> nMasternodesEnabled{0};
+    std::atomic<int64_t> nMasternodeSyncAsset{0};
+    std::atomic<int64_t> nGovernanceProposals{0};
+    std::atomic<int64_t> nGovernanceTriggers{0};
+    std::atomic<int64_t> nGovernanceWatchdogs{0};
+    std::atomic<int64_t> nGovernanceOther{0};
+
+    CMetricsHistogram histInstantSendLock;
+};
+
+extern CMetrics g_metrics;
+
+/** Register the /metrics HTTP endpoint */
+void StartMetricsServer();
+/** Unregister the /metrics HTTP endpoint */
+void StopMetricsServer();
+
+#endif // VELES_METRICS_H
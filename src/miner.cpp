@@ -33,8 +33,17 @@
 #include <masternode/sync.h>
 //
 
+// VELES BEGIN
+#include <crypto/lyra2z.h>
+#include <crypto/scrypt.h>
+#include <crypto/x16r.h>
+#include <versionbits.h>
+// VELES END
+
 #include <algorithm>
+#include <atomic>
 #include <queue>
+#include <thread>
 #include <utility>
 
 // FXTC BEGIN
@@ -143,12 +152,17 @@ void BlockAssembler::resetBlock()
     // These counters do not include coinbase tx
     nBlockTx = 0;
     nFees = 0;
+
+    // VELES BEGIN
+    fLimited = false;
+    minPackageFeeRate = CFeeRate(MAX_MONEY);
+    // VELES END
 }
 
 Optional<int64_t> BlockAssembler::m_last_block_num_txs{nullopt};
 Optional<int64_t> BlockAssembler::m_last_block_weight{nullopt};
 
-std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn, int32_t nPowAlgo) // Veles: Add parameter nPowAlgo
+std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn, int32_t nPowAlgo, BlockSelection* pselection) // Veles: Add parameters nPowAlgo and pselection
 {
     int64_t nTimeStart = GetTimeMicros();
 
@@ -170,17 +184,9 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     assert(pindexPrev != nullptr);
     nHeight = pindexPrev->nHeight + 1;
 
-    // Veles
-    if (nPowAlgo == ALGO_NULL)
-        pblock->nVersion = ComputeBlockVersion(pindexPrev, chainparams.GetConsensus());
-    else
-        pblock->nVersion = ComputeBlockVersion(pindexPrev, chainparams.GetConsensus(), nPowAlgo);
-    //
-
-    // -regtest only: allow overriding block.nVersion with
-    // -blockversion=N to test forking scenarios
-    if (chainparams.MineBlocksOnDemand())
-        pblock->nVersion = gArgs.GetArg("-blockversion", pblock->nVersion);
+    // VELES BEGIN
+    SetBlockVersion(pindexPrev, nPowAlgo);
+    // VELES END
 
     pblock->nTime = GetAdjustedTime();
     const int64_t nMedianTimePast = pindexPrev->GetMedianTimePast();
@@ -202,13 +208,96 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
 
     int nPackagesSelected = 0;
     int nDescendantsUpdated = 0;
-    addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+    // VELES BEGIN
+    if (!pselection || !UpdateSelection(*pselection, pindexPrev, nPackagesSelected)) {
+        addInstantSendLockedTxs(nPackagesSelected);
+        addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+    }
+    if (pselection)
+        StoreSelection(*pselection, pindexPrev);
+    // VELES END
 
     int64_t nTime1 = GetTimeMicros();
 
     m_last_block_num_txs = nBlockTx;
     m_last_block_weight = nBlockWeight;
 
+    // VELES BEGIN
+    FinishBlock(scriptPubKeyIn, pindexPrev);
+    // VELES END
+    int64_t nTime2 = GetTimeMicros();
+
+    LogPrint(BCLog::BENCH, "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
+
+    return std::move(pblocktemplate);
+}
+// Veles
+std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn)
+{
+    return BlockAssembler::CreateNewBlock(scriptPubKeyIn, ALGO_NULL);
+}
+//
+
+// VELES BEGIN
+std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CBlockTemplate& selection, const CScript& scriptPubKeyIn, int32_t nPowAlgo)
+{
+    int64_t nTimeStart = GetTimeMicros();
+
+    resetBlock();
+
+    pblocktemplate.reset(new CBlockTemplate(selection));
+
+    if(!pblocktemplate.get())
+        return nullptr;
+    pblock = &pblocktemplate->block; // pointer for convenience
+
+    // The header, the payments and the coinbase are rebuilt below
+    pblock->hashPrevBlock.SetNull();
+    pblock->txoutMasternode = CTxOut();
+    pblock->voutSuperblock.clear();
+    pblock->fChecked = false;
+
+    LOCK2(cs_main, mempool.cs);
+    CBlockIndex* pindexPrev = chainActive.Tip();
+    assert(pindexPrev != nullptr);
+    if (selection.block.hashPrevBlock != pindexPrev->GetBlockHash())
+        return nullptr; // selected for an older tip
+    nHeight = pindexPrev->nHeight + 1;
+
+    SetBlockVersion(pindexPrev, nPowAlgo);
+    pblock->nTime = GetAdjustedTime();
+
+    // Take over the counters of the selected transactions, the coinbase entries are updated at the end
+    for (size_t i = 1; i < pblock->vtx.size(); i++) {
+        nBlockWeight += GetTransactionWeight(*pblock->vtx[i]);
+        nBlockSigOpsCost += pblocktemplate->vTxSigOpsCost[i];
+        nFees += pblocktemplate->vTxFees[i];
+        ++nBlockTx;
+    }
+
+    FinishBlock(scriptPubKeyIn, pindexPrev);
+    int64_t nTime1 = GetTimeMicros();
+
+    LogPrint(BCLog::BENCH, "CreateNewBlock() reused %u txs, validity: %.2fms\n", nBlockTx, 0.001 * (nTime1 - nTimeStart));
+
+    return std::move(pblocktemplate);
+}
+
+void BlockAssembler::SetBlockVersion(const CBlockIndex* pindexPrev, int32_t nPowAlgo)
+{
+    if (nPowAlgo == ALGO_NULL)
+        pblock->nVersion = ComputeBlockVersion(pindexPrev, chainparams.GetConsensus());
+    else
+        pblock->nVersion = ComputeBlockVersion(pindexPrev, chainparams.GetConsensus(), nPowAlgo);
+
+    // -regtest only: allow overriding block.nVersion with
+    // -blockversion=N to test forking scenarios
+    if (chainparams.MineBlocksOnDemand())
+        pblock->nVersion = gArgs.GetArg("-blockversion", pblock->nVersion);
+}
+
+void BlockAssembler::FinishBlock(const CScript& scriptPubKeyIn, CBlockIndex* pindexPrev)
+{
     // Create coinbase transaction.
     CMutableTransaction coinbaseTx;
     pblock->nBits=GetNextWorkRequired(pindexPrev, pblock, chainparams.GetConsensus());
@@ -257,21 +346,170 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     pblocktemplate->vTxSigOpsCost[0] = WITNESS_SCALE_FACTOR * GetLegacySigOpCount(*pblock->vtx[0]);
 
     CValidationState state;
-    if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
+    //if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
+    if (!TestBlockTemplateValidity(state, chainparams, *pblock, pindexPrev, false)) { // VELES
         throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
     }
-    int64_t nTime2 = GetTimeMicros();
+}
 
-    LogPrint(BCLog::BENCH, "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
+bool BlockAssembler::UpdateSelection(BlockSelection& selection, const CBlockIndex* pindexPrev, int& nPackagesSelected)
+{
+    // Anything but additions and removals, like a prioritisetransaction, changes the package fees
+    if (!selection.fRegistered || selection.hashTip != pindexPrev->GetBlockHash() ||
+        selection.nBlockMaxWeight != nBlockMaxWeight || selection.blockMinFeeRate != blockMinFeeRate ||
+        mempool.GetTransactionsUpdated() != selection.nTransactionsUpdated + selection.nChanges)
+        return false;
+    // Removals from a full block make room for transactions selected against before
+    if (selection.fLimited && !selection.setRemoved.empty())
+        return false;
 
-    return std::move(pblocktemplate);
+    // Empty the block again for addPackageTxs
+    auto StartOver = [this]() {
+        const bool fWitness = fIncludeWitness;
+        resetBlock();
+        fIncludeWitness = fWitness;
+        pblock->vtx.resize(1);
+        pblocktemplate->vTxFees.resize(1);
+        pblocktemplate->vTxSigOpsCost.resize(1);
+        return false;
+    };
+
+    // The descendants of a removed transaction have left the mempool too,
+    // the other selected transactions still form a valid block
+    for (const CTransactionRef& tx : selection.vtx) {
+        if (selection.setRemoved.count(tx->GetHash()))
+            continue;
+        CTxMemPool::txiter it = mempool.mapTx.find(tx->GetHash());
+        if (it == mempool.mapTx.end())
+            return StartOver();
+        AddToBlock(it);
+    }
+    fLimited = selection.fLimited;
+    minPackageFeeRate = selection.minPackageFeeRate;
+
+    // Packages of the added transactions, best fee rate first
+    std::vector<std::pair<CFeeRate, CTxMemPool::txiter>> vPackages;
+    for (const CTransactionRef& tx : selection.vAdded) {
+        CTxMemPool::txiter it = mempool.mapTx.find(tx->GetHash());
+        if (it == mempool.mapTx.end() || inBlock.count(it))
+            continue;
+        vPackages.emplace_back(CFeeRate(it->GetModFeesWithAncestors(), it->GetSizeWithAncestors()), it);
+    }
+    std::sort(vPackages.begin(), vPackages.end(), [](const std::pair<CFeeRate, CTxMemPool::txiter>& a, const std::pair<CFeeRate, CTxMemPool::txiter>& b) {
+        return a.first > b.first;
+    });
+
+    for (const auto& package : vPackages) {
+        CTxMemPool::txiter iter = package.second;
+        if (inBlock.count(iter))
+            continue; // ancestor of a package added before
+
+        CTxMemPool::setEntries ancestors;
+        uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+        std::string dummy;
+        mempool.CalculateMemPoolAncestors(*iter, ancestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
+        onlyUnconfirmed(ancestors);
+        ancestors.insert(iter);
+
+        uint64_t packageSize = 0;
+        CAmount packageFees = 0;
+        int64_t packageSigOpsCost = 0;
+        for (CTxMemPool::txiter it : ancestors) {
+            packageSize += it->GetTxSize();
+            packageFees += it->GetModifiedFee();
+            packageSigOpsCost += it->GetSigOpCost();
+        }
+        const CFeeRate packageFeeRate(packageFees, packageSize);
+
+        if (packageFees < blockMinFeeRate.GetFee(packageSize))
+            continue;
+        if (!TestPackage(packageSize, packageSigOpsCost)) {
+            if (packageFeeRate > minPackageFeeRate)
+                return StartOver(); // it could take the place of selected transactions
+            fLimited = true;
+            continue;
+        }
+        if (!TestPackageTransactions(ancestors))
+            continue;
+
+        std::vector<CTxMemPool::txiter> sortedEntries;
+        SortForBlock(ancestors, sortedEntries);
+        for (CTxMemPool::txiter it : sortedEntries)
+            AddToBlock(it);
+        ++nPackagesSelected;
+        minPackageFeeRate = std::min(minPackageFeeRate, packageFeeRate);
+    }
+
+    LogPrint(BCLog::BENCH, "CreateNewBlock() updated selection: %u added, %u removed txs\n", selection.vAdded.size(), selection.setRemoved.size());
+    return true;
 }
-// Veles
-std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& scriptPubKeyIn)
+
+void BlockAssembler::StoreSelection(BlockSelection& selection, const CBlockIndex* pindexPrev)
 {
-    return BlockAssembler::CreateNewBlock(scriptPubKeyIn, ALGO_NULL);
+    selection.hashTip = pindexPrev->GetBlockHash();
+    selection.nBlockMaxWeight = nBlockMaxWeight;
+    selection.blockMinFeeRate = blockMinFeeRate;
+    selection.vtx.assign(pblock->vtx.begin() + 1, pblock->vtx.end());
+    selection.fLimited = fLimited;
+    selection.minPackageFeeRate = minPackageFeeRate;
+    selection.nTransactionsUpdated = mempool.GetTransactionsUpdated();
+    selection.nChanges = 0;
+    selection.vAdded.clear();
+    selection.setRemoved.clear();
 }
-//
+
+BlockSelection g_block_selection;
+
+void BlockSelection::RegisterWithMempoolSignals(CTxMemPool& pool)
+{
+    LOCK(pool.cs);
+    connAdded = pool.NotifyEntryAdded.connect(std::bind(&BlockSelection::TransactionAdded, this, std::placeholders::_1));
+    connRemoved = pool.NotifyEntryRemoved.connect(std::bind(&BlockSelection::TransactionRemoved, this, std::placeholders::_1, std::placeholders::_2));
+    fRegistered = true;
+    Clear();
+}
+
+void BlockSelection::UnregisterWithMempoolSignals(CTxMemPool& pool)
+{
+    LOCK(pool.cs);
+    connAdded.disconnect();
+    connRemoved.disconnect();
+    fRegistered = false;
+    Clear();
+}
+
+void BlockSelection::Clear()
+{
+    hashTip.SetNull();
+    vtx.clear();
+    nChanges = 0;
+    vAdded.clear();
+    setRemoved.clear();
+}
+
+void BlockSelection::TransactionAdded(CTransactionRef tx)
+{
+    if (hashTip.IsNull())
+        return;
+    // Past this many changes a fresh selection is about as cheap as the update
+    if (++nChanges > MAX_SELECTION_CHANGES) {
+        Clear();
+        return;
+    }
+    vAdded.push_back(tx);
+}
+
+void BlockSelection::TransactionRemoved(CTransactionRef tx, MemPoolRemovalReason reason)
+{
+    if (hashTip.IsNull())
+        return;
+    if (++nChanges > MAX_SELECTION_CHANGES) {
+        Clear();
+        return;
+    }
+    setRemoved.insert(tx->GetHash());
+}
+// VELES END
 
 void BlockAssembler::onlyUnconfirmed(CTxMemPool::setEntries& testSet)
 {
@@ -468,6 +706,7 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
         }
 
         if (!TestPackage(packageSize, packageSigOpsCost)) {
+            fLimited = true; // VELES
             if (fUsingModified) {
                 // Since we always look at the best entry in mapModifiedTx,
                 // we must erase failed entries so that we can consider the
@@ -517,12 +756,53 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
         }
 
         ++nPackagesSelected;
+        // VELES BEGIN
+        minPackageFeeRate = std::min(minPackageFeeRate, CFeeRate(packageFees, packageSize));
+        // VELES END
 
         // Update transactions that depend on each of these
         nDescendantsUpdated += UpdatePackagesForAdded(ancestors, mapModifiedTx);
     }
 }
 
+// VELES BEGIN
+void BlockAssembler::addInstantSendLockedTxs(int &nPackagesSelected)
+{
+    for (CTxMemPool::txiter iter : mempool.GetInstantSendLocked()) {
+        if (inBlock.count(iter))
+            continue; // ancestor of a locked transaction added before
+
+        CTxMemPool::setEntries ancestors;
+        uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+        std::string dummy;
+        mempool.CalculateMemPoolAncestors(*iter, ancestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
+        onlyUnconfirmed(ancestors);
+        ancestors.insert(iter);
+
+        uint64_t packageSize = 0;
+        int64_t packageSigOpsCost = 0;
+        for (CTxMemPool::txiter it : ancestors) {
+            packageSize += it->GetTxSize();
+            packageSigOpsCost += it->GetSigOpCost();
+        }
+        // No fee rate check, and the package does not count for minPackageFeeRate:
+        // no other transaction could take its place
+        if (!TestPackage(packageSize, packageSigOpsCost)) {
+            fLimited = true;
+            continue;
+        }
+        if (!TestPackageTransactions(ancestors))
+            continue;
+
+        std::vector<CTxMemPool::txiter> sortedEntries;
+        SortForBlock(ancestors, sortedEntries);
+        for (CTxMemPool::txiter it : sortedEntries)
+            AddToBlock(it);
+        ++nPackagesSelected;
+    }
+}
+// VELES END
+
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
 {
     // Update nExtraNonce
@@ -541,3 +821,117 @@ void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned
     pblock->vtx[0] = MakeTransactionRef(std::move(txCoinbase));
     pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
 }
+
+// VELES BEGIN
+namespace {
+
+/** Hashes batches of nonces of one header, with the scratchpads of one thread */
+class NonceHasher
+{
+public:
+    NonceHasher(const CBlockHeader& header, const CX16RPlan& planIn) :
+        vHeaders(SCAN_NONCE_BATCH, header), plan(planIn), midstate(header)
+    {
+        if ((header.nVersion & VERSIONBITS_TOP_MASK) != VERSIONBITS_TOP_BITS || (header.nVersion & ALGO_VERSION_MASK) == ALGO_SCRYPT)
+            vScratchpad.resize(SCRYPT_8WAY_SCRATCHPAD_SIZE);
+        else if ((header.nVersion & ALGO_VERSION_MASK) == ALGO_LYRA2Z)
+            vScratchpad.resize(LYRA2Z_SCRATCHPAD_SIZE);
+    }
+
+    /** Hash the nCount nonces from nNonce on into hashes */
+    void Hash(uint32_t nNonce, size_t nCount, uint256 hashes[])
+    {
+        for (size_t i = 0; i < nCount; i++)
+            vHeaders[i].nNonce = nNonce + i;
+
+        const CBlockHeader& header = vHeaders[0];
+        if (vScratchpad.size() == SCRYPT_8WAY_SCRATCHPAD_SIZE) {
+            const char* inputs[SCAN_NONCE_BATCH];
+            char* outputs[SCAN_NONCE_BATCH];
+            for (size_t i = 0; i < nCount; i++) {
+                inputs[i] = BEGIN(vHeaders[i].nVersion);
+                outputs[i] = BEGIN(hashes[i]);
+            }
+            scrypt_1024_1_1_256_batch_sp(inputs, outputs, nCount, vScratchpad.data());
+        } else if (!vScratchpad.empty()) {
+            for (size_t i = 0; i < nCount; i++)
+                lyra2z_hash_sp(BEGIN(vHeaders[i].nVersion), BEGIN(hashes[i]), vScratchpad.data());
+        } else if ((header.nVersion & ALGO_VERSION_MASK) == ALGO_SHA256D) {
+            midstate.GetHashes(nNonce, nCount, hashes);
+        } else if ((header.nVersion & ALGO_VERSION_MASK) == ALGO_X11 || (header.nVersion & ALGO_VERSION_MASK) == ALGO_X16R) {
+            const CBlockHeader* pheaders[SCAN_NONCE_BATCH];
+            uint256* phashes[SCAN_NONCE_BATCH];
+            for (size_t i = 0; i < nCount; i++) {
+                pheaders[i] = &vHeaders[i];
+                phashes[i] = &hashes[i];
+            }
+            CBlockHeader::GetPoWHashes(pheaders, phashes, nCount);
+        } else {
+            for (size_t i = 0; i < nCount; i++)
+                hashes[i] = vHeaders[i].GetPoWHash(&plan);
+        }
+    }
+
+private:
+    std::vector<CBlockHeader> vHeaders;
+    const CX16RPlan& plan;
+    const CBlockHeaderMidstate midstate;
+    std::vector<char> vScratchpad;
+};
+
+}
+
+bool ScanNonces(CBlockHeader& header, uint32_t nMaxNonce, uint64_t& nMaxTries, int nThreads, const Consensus::Params& params)
+{
+    const uint64_t nEnd = std::min<uint64_t>(nMaxNonce, header.nNonce + nMaxTries);
+    if (header.nNonce >= nEnd)
+        return false;
+
+    // The X16R algorithm chain only depends on hashPrevBlock, resolve it once per template
+    const CX16RPlan plan(header.hashPrevBlock);
+    std::atomic<uint64_t> nNext(header.nNonce);
+    std::atomic<uint64_t> nTried(0);
+    std::atomic<bool> fFound(false);
+    uint32_t nFoundNonce = 0;
+    Mutex cs_found;
+
+    auto scan = [&]() {
+        NonceHasher hasher(header, plan);
+        uint256 hashes[SCAN_NONCE_BATCH];
+        while (!fFound) {
+            const uint64_t nNonce = nNext.fetch_add(SCAN_NONCE_BATCH);
+            if (nNonce >= nEnd)
+                break;
+            const size_t nCount = std::min<uint64_t>(SCAN_NONCE_BATCH, nEnd - nNonce);
+            hasher.Hash(nNonce, nCount, hashes);
+            size_t nHashed = nCount;
+            for (size_t i = 0; i < nCount; i++) {
+                if (CheckProofOfWork(hashes[i], header.nBits, params)) {
+                    // Keep the lowest solution, so a single thread finds the same one as before
+                    LOCK(cs_found);
+                    if (!fFound || nNonce + i < nFoundNonce)
+                        nFoundNonce = nNonce + i;
+                    fFound = true;
+                    nHashed = i + 1;
+                    break;
+                }
+            }
+            nTried += nHashed;
+        }
+    };
+
+    if (nThreads <= 1) {
+        scan();
+    } else {
+        std::vector<std::thread> vThreads;
+        for (int i = 0; i < nThreads; i++)
+            vThreads.emplace_back(scan);
+        for (std::thread& thread : vThreads)
+            thread.join();
+    }
+
+    nMaxTries -= std::min<uint64_t>(nMaxTries, nTried);
+    header.nNonce = fFound ? nFoundNonce : nEnd;
+    return fFound;
+}
+// VELES END
@@ -13,10 +13,13 @@
 #include <validation.h>
 
 #include <memory>
+#include <set>
 #include <stdint.h>
+#include <vector>
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
+#include <boost/signals2/connection.hpp>
 
 class CBlockIndex;
 class CChainParams;
@@ -25,6 +28,12 @@ class CScript;
 namespace Consensus { struct Params; };
 
 static const bool DEFAULT_PRINTPRIORITY = false;
+// VELES BEGIN
+/** Mempool changes after which a BlockSelection starts over instead of updating */
+static const unsigned int MAX_SELECTION_CHANGES = 10000;
+/** Nonces a ScanNonces thread hashes at once, the width of the multi-buffer kernels */
+static const size_t SCAN_NONCE_BATCH = 8;
+// VELES END
 
 struct CBlockTemplate
 {
@@ -123,6 +132,51 @@ struct update_for_parent_inclusion
     CTxMemPool::txiter iter;
 };
 
+// VELES BEGIN
+/** The transactions a BlockAssembler selected on the current tip, together with
+ *  the mempool changes since. The next template on the same tip only drops the
+ *  removed transactions and adds the packages of the new ones instead of going
+ *  through the whole mempool again. The members are guarded by mempool.cs, the
+ *  mempool signals are sent with it held. */
+class BlockSelection
+{
+public:
+    /** Follow the transactions added to and removed from pool, without it every template is selected from scratch */
+    void RegisterWithMempoolSignals(CTxMemPool& pool);
+    void UnregisterWithMempoolSignals(CTxMemPool& pool);
+
+private:
+    friend class BlockAssembler;
+
+    void TransactionAdded(CTransactionRef tx);
+    void TransactionRemoved(CTransactionRef tx, MemPoolRemovalReason reason);
+    /** Forget the selection, the next template is selected from scratch */
+    void Clear();
+
+    boost::signals2::scoped_connection connAdded;
+    boost::signals2::scoped_connection connRemoved;
+    bool fRegistered = false;
+
+    //! Tip the transactions were selected on, null when there is no selection
+    uint256 hashTip;
+    //! Assembler options the transactions were selected with
+    unsigned int nBlockMaxWeight = 0;
+    CFeeRate blockMinFeeRate;
+    //! The selected transactions in block order, without the coinbase
+    std::vector<CTransactionRef> vtx;
+    //! Whether a package did not fit in the block any more
+    bool fLimited = false;
+    //! Lowest fee rate of the selected packages
+    CFeeRate minPackageFeeRate;
+
+    //! Mempool update counter at the selection, every later update must be one of the changes below
+    unsigned int nTransactionsUpdated = 0;
+    unsigned int nChanges = 0;
+    std::vector<CTransactionRef> vAdded;
+    std::set<uint256> setRemoved;
+};
+// VELES END
+
 /** Generate a new block, without valid proof-of-work */
 class BlockAssembler
 {
@@ -143,6 +197,10 @@ private:
     uint64_t nBlockSigOpsCost;
     CAmount nFees;
     CTxMemPool::setEntries inBlock;
+    // VELES BEGIN
+    bool fLimited;
+    CFeeRate minPackageFeeRate;
+    // VELES END
 
     // Chain context for the block
     int nHeight;
@@ -160,10 +218,13 @@ public:
     BlockAssembler(const CChainParams& params, const Options& options);
 
     /** Construct a new block template with coinbase to scriptPubKeyIn */
-    std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn, int32_t nPowAlgo); // VELES: Add parameter nPowAlgo
+    std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn, int32_t nPowAlgo, BlockSelection* pselection = nullptr); // VELES: Add parameters nPowAlgo and pselection
     // VELES BEGIN
     /** Default behaviour to return block for the algo set in the daemon configuration */
     std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn);
+    /** Construct a block template for nPowAlgo with the transactions of selection, a template built on the current tip.
+      * Only the header and the coinbase are rebuilt, returns nullptr when the tip has moved on. */
+    std::unique_ptr<CBlockTemplate> CreateNewBlock(const CBlockTemplate& selection, const CScript& scriptPubKeyIn, int32_t nPowAlgo);
     // VELES END
     static Optional<int64_t> m_last_block_num_txs;
     static Optional<int64_t> m_last_block_weight;
@@ -174,6 +235,20 @@ private:
     void resetBlock();
     /** Add a tx to the block */
     void AddToBlock(CTxMemPool::txiter iter);
+    // VELES BEGIN
+    /** Set the version of the block for nPowAlgo, ALGO_NULL picks the configured algo */
+    void SetBlockVersion(const CBlockIndex* pindexPrev, int32_t nPowAlgo);
+    /** Add the coinbase paying scriptPubKeyIn, fill in the header and check the block */
+    void FinishBlock(const CScript& scriptPubKeyIn, CBlockIndex* pindexPrev);
+    /** Take over the transactions of selection and add the packages of the transactions added to
+      * the mempool since. Returns false, with an empty block, when they have to be selected from scratch. */
+    bool UpdateSelection(BlockSelection& selection, const CBlockIndex* pindexPrev, int& nPackagesSelected) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
+    /** Remember the transactions of the block in selection */
+    void StoreSelection(BlockSelection& selection, const CBlockIndex* pindexPrev) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
+    /** Add the InstantSend locked transactions with their ancestors ahead of the fee rate
+      * ordered packages, they have to be mined whatever their fee rate */
+    void addInstantSendLockedTxs(int &nPackagesSelected) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
+    // VELES END
 
     // Methods for how to add transactions to a block.
     /** Add transactions based on feerate including unconfirmed ancestors
@@ -206,4 +281,15 @@ private:
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
 int64_t UpdateTime(CBlock* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
 
+// VELES BEGIN
+/** Selection shared by the templates of getblocktemplate and the ZMQ work notifier */
+extern BlockSelection g_block_selection;
+
+/** Search the nonces from header.nNonce up to nMaxNonce (exclusive) for a proof-of-work meeting header.nBits.
+ *  The nThreads threads share the header, each hashes batches of nonces with its own scratchpads.
+ *  Returns true with header.nNonce set to the solution, otherwise header.nNonce is the first nonce left.
+ *  At most nMaxTries nonces are tried, nMaxTries is decreased by the nonces tried. */
+bool ScanNonces(CBlockHeader& header, uint32_t nMaxNonce, uint64_t& nMaxTries, int nThreads, const Consensus::Params& params);
+// VELES END
+
 #endif // BITCOIN_MINER_H
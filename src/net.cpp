@@ -39,6 +39,12 @@
 #include <poll.h>
 #endif
 
+// VELES BEGIN
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#endif
+// VELES END
+
 #ifdef USE_UPNP
 #include <miniupnpc/miniupnpc.h>
 #include <miniupnpc/miniwget.h>
@@ -98,7 +104,8 @@ std::map<CInv, CDataStream> mapRelayDash;
 std::deque<pair<int64_t, CInv> > vRelayExpirationDash;
 CCriticalSection cs_mapRelayDash;
 //
-limitedmap<uint256, int64_t> mapAlreadyAskedFor(MAX_INV_SZ);
+//limitedmap<uint256, int64_t> mapAlreadyAskedFor(MAX_INV_SZ);
+CInvRequestTimes g_inv_request_times(MAX_INV_SZ); // VELES
 
 void CConnman::AddOneShot(const std::string& strDest)
 {
@@ -574,6 +581,22 @@ void CNode::SetAddrLocal(const CService& addrLocalIn) {
 
 #undef X
 #define X(name) stats.name = name
+// VELES BEGIN
+static bool IsMasternodePoolHealthy(const CNode* pnode, int64_t nNow)
+{
+    if (pnode->fDisconnect)
+        return false;
+    // handshake never completed
+    if (!pnode->fSuccessfullyConnected)
+        return nNow - pnode->nTimeConnected < MASTERNODE_POOL_HANDSHAKE_TIMEOUT;
+    // outstanding ping and nothing received for too long
+    if (pnode->nPingNonceSent != 0 && pnode->nPingUsecStart != 0 &&
+        GetTimeMicros() - pnode->nPingUsecStart > MASTERNODE_POOL_HANDSHAKE_TIMEOUT * 1000000)
+        return false;
+    return true;
+}
+// VELES END
+
 void CNode::copyStats(CNodeStats &stats)
 {
     stats.nodeid = this->GetId();
@@ -601,6 +624,7 @@ void CNode::copyStats(CNodeStats &stats)
         LOCK(cs_vSend);
         X(mapSendBytesPerMsgCmd);
         X(nSendBytes);
+        X(nSendBytesPerClass); // VELES
     }
     {
         LOCK(cs_vRecv);
@@ -608,6 +632,12 @@ void CNode::copyStats(CNodeStats &stats)
         X(nRecvBytes);
     }
     X(fWhitelisted);
+    // VELES BEGIN
+    X(fMasternode);
+    X(nTimeMasternodePoolUsed);
+    X(nMasternodePoolUses);
+    stats.fMasternodePoolHealthy = IsMasternodePoolHealthy(this, GetTime());
+    // VELES END
     {
         LOCK(cs_feeFilter);
         X(minFeeFilter);
@@ -647,7 +677,8 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
         // get current incomplete message, or create a new one
         if (vRecvMsg.empty() ||
             vRecvMsg.back().complete())
-            vRecvMsg.push_back(CNetMessage(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION));
+            //vRecvMsg.push_back(CNetMessage(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION));
+            vRecvMsg.emplace_back(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION); // VELES
 
         CNetMessage& msg = vRecvMsg.back();
 
@@ -727,12 +758,19 @@ int CNetMessage::readHeader(const char *pch, unsigned int nBytes)
         return nCopy;
 
     // deserialize to CMessageHeader
-    try {
-        hdrbuf >> hdr;
-    }
-    catch (const std::exception&) {
-        return -1;
-    }
+    //try {
+    //    hdrbuf >> hdr;
+    //}
+    //catch (const std::exception&) {
+    //    return -1;
+    //}
+    // VELES BEGIN
+    // Field by field as CMessageHeader serializes, the header needs no stream of its own
+    memcpy(hdr.pchMessageStart, hdrbuf, CMessageHeader::MESSAGE_START_SIZE);
+    memcpy(hdr.pchCommand, hdrbuf + CMessageHeader::MESSAGE_START_SIZE, CMessageHeader::COMMAND_SIZE);
+    hdr.nMessageSize = ReadLE32((const unsigned char*)hdrbuf + CMessageHeader::MESSAGE_SIZE_OFFSET);
+    memcpy(hdr.pchChecksum, hdrbuf + CMessageHeader::CHECKSUM_OFFSET, CMessageHeader::CHECKSUM_SIZE);
+    // VELES END
 
     // reject messages larger than MAX_SIZE
     if (hdr.nMessageSize > MAX_SIZE)
@@ -749,6 +787,12 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes)
     unsigned int nRemaining = hdr.nMessageSize - nDataPos;
     unsigned int nCopy = std::min(nRemaining, nBytes);
 
+    // VELES BEGIN
+    if (nDataPos == 0 && vRecv.size() == 0) {
+        CSerializeData buffer = g_net_message_buffers.Get();
+        vRecv.swap_data(buffer);
+    }
+    // VELES END
     if (vRecv.size() < nDataPos + nCopy) {
         // Allocate up to 256 KiB ahead, but never more than the total message size.
         vRecv.resize(std::min(hdr.nMessageSize, nDataPos + nCopy + 256 * 1024));
@@ -761,6 +805,41 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes)
     return nCopy;
 }
 
+// VELES BEGIN
+CNetMessageBufferPool g_net_message_buffers;
+
+CSerializeData CNetMessageBufferPool::Get()
+{
+    CSerializeData buffer;
+    LOCK(cs);
+    if (!vBuffers.empty()) {
+        buffer.swap(vBuffers.back());
+        vBuffers.pop_back();
+        nPoolSize -= buffer.capacity();
+    }
+    return buffer;
+}
+
+void CNetMessageBufferPool::Put(CSerializeData&& buffer)
+{
+    if (buffer.capacity() == 0 || buffer.capacity() > MAX_BUFFER_SIZE)
+        return;
+    buffer.clear();
+    LOCK(cs);
+    if (nPoolSize + buffer.capacity() > MAX_POOL_SIZE)
+        return;
+    nPoolSize += buffer.capacity();
+    vBuffers.push_back(std::move(buffer));
+}
+
+CNetMessage::~CNetMessage()
+{
+    CSerializeData buffer;
+    vRecv.swap_data(buffer);
+    g_net_message_buffers.Put(std::move(buffer));
+}
+// VELES END
+
 const uint256& CNetMessage::GetMessageHash() const
 {
     assert(complete());
@@ -769,13 +848,49 @@ const uint256& CNetMessage::GetMessageHash() const
     return data_hash;
 }
 
+// VELES BEGIN
+/** Bytes each class may send in its turn, so that the classes share the bandwidth 8:4:1 when all have messages */
+static const int64_t SEND_PRIORITY_QUANTUM[SEND_PRIORITY_COUNT] = {512 * 1024, 256 * 1024, 64 * 1024};
+
+bool CNode::SelectSendClass()
+{
+    if (SendQueueEmpty())
+        return false;
+
+    // Deficit round robin: the classes with messages take turns in priority order. A turn adds
+    // the quantum of the class to its deficit, and lasts as long as it covers the next message.
+    // Messages are never interleaved: the class of a message sends its payload after its header.
+    while (true) {
+        const auto& queue = vSendMsg[nSendClass];
+        if (!queue.empty()) {
+            const uint32_t nPayloadSize = ReadLE32(queue.front().data() + CMessageHeader::MESSAGE_SIZE_OFFSET);
+            if (nSendDeficit[nSendClass] >= int64_t(CMessageHeader::HEADER_SIZE + nPayloadSize)) {
+                nSendParts = nPayloadSize ? 2 : 1;
+                return true;
+            }
+        } else {
+            // an idle class can't save up for later
+            nSendDeficit[nSendClass] = 0;
+        }
+        nSendClass = (nSendClass + 1) % SEND_PRIORITY_COUNT;
+        if (!vSendMsg[nSendClass].empty())
+            nSendDeficit[nSendClass] += SEND_PRIORITY_QUANTUM[nSendClass];
+    }
+}
+// VELES END
+
 size_t CConnman::SocketSendData(CNode *pnode) const EXCLUSIVE_LOCKS_REQUIRED(pnode->cs_vSend)
 {
-    auto it = pnode->vSendMsg.begin();
+    // auto it = pnode->vSendMsg.begin();
     size_t nSentSize = 0;
 
-    while (it != pnode->vSendMsg.end()) {
-        const auto &data = *it;
+    // VELES BEGIN
+    // while (it != pnode->vSendMsg.end()) {
+    //     const auto &data = *it;
+    while (pnode->nSendParts > 0 || pnode->SelectSendClass()) {
+        auto& queue = pnode->vSendMsg[pnode->nSendClass];
+        const auto &data = queue.front();
+    // VELES END
         assert(data.size() > pnode->nSendOffset);
         int nBytes = 0;
         {
@@ -789,11 +904,17 @@ size_t CConnman::SocketSendData(CNode *pnode) const EXCLUSIVE_LOCKS_REQUIRED(pno
             pnode->nSendBytes += nBytes;
             pnode->nSendOffset += nBytes;
             nSentSize += nBytes;
+            pnode->nSendBytesPerClass[pnode->nSendClass] += nBytes; // VELES
             if (pnode->nSendOffset == data.size()) {
                 pnode->nSendOffset = 0;
                 pnode->nSendSize -= data.size();
                 pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
-                it++;
+                // VELES BEGIN
+                // it++;
+                pnode->nSendDeficit[pnode->nSendClass] -= data.size();
+                pnode->nSendParts--;
+                queue.pop_front();
+                // VELES END
             } else {
                 // could not send full message; stop sending more
                 break;
@@ -813,11 +934,14 @@ size_t CConnman::SocketSendData(CNode *pnode) const EXCLUSIVE_LOCKS_REQUIRED(pno
         }
     }
 
-    if (it == pnode->vSendMsg.end()) {
+    // VELES BEGIN
+    // if (it == pnode->vSendMsg.end()) {
+    if (pnode->SendQueueEmpty()) {
+    // VELES END
         assert(pnode->nSendOffset == 0);
         assert(pnode->nSendSize == 0);
     }
-    pnode->vSendMsg.erase(pnode->vSendMsg.begin(), it);
+    // pnode->vSendMsg.erase(pnode->vSendMsg.begin(), it);
     return nSentSize;
 }
 
@@ -1058,6 +1182,8 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
 
     LogPrint(BCLog::NET, "connection from %s accepted\n", addr.ToString());
 
+    RegisterEvents(hSocket, false); // VELES
+
     {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
@@ -1217,7 +1343,7 @@ bool CConnman::GenerateSelectSet(std::set<SOCKET> &recv_set, std::set<SOCKET> &s
             bool select_send;
             {
                 LOCK(pnode->cs_vSend);
-                select_send = !pnode->vSendMsg.empty();
+                select_send = !pnode->SendQueueEmpty(); // VELES
             }
 
             LOCK(pnode->cs_hSocket);
@@ -1356,10 +1482,112 @@ void CConnman::SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_s
 }
 #endif
 
+// VELES BEGIN
+std::string GetSupportedSocketEventsStr()
+{
+#ifdef USE_POLL
+    std::string strSupportedModes = "poll";
+#else
+    std::string strSupportedModes = "select";
+#endif
+#ifdef USE_EPOLL
+    strSupportedModes += ", epoll";
+#endif
+    return strSupportedModes;
+}
+
+bool ParseSocketEventsMode(const std::string& str, SocketEventsMode& mode)
+{
+#ifdef USE_POLL
+    if (str == "poll") {
+#else
+    if (str == "select") {
+#endif
+        mode = SOCKETEVENTS_SELECT;
+        return true;
+    }
+#ifdef USE_EPOLL
+    if (str == "epoll") {
+        mode = SOCKETEVENTS_EPOLL;
+        return true;
+    }
+#endif
+    return false;
+}
+
+void CConnman::RegisterEvents(SOCKET hSocket, bool fListen)
+{
+#ifdef USE_EPOLL
+    if (epollfd == -1)
+        return;
+
+    // Closing the socket drops it from the set, no need to unregister
+    struct epoll_event event;
+    event.data.fd = hSocket;
+    // A listening socket stays level-triggered, a connection is accepted per round
+    event.events = fListen ? EPOLLIN : (EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET);
+    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, hSocket, &event) != 0) {
+        LogPrintf("epoll_ctl failed for socket %d with error %s\n", hSocket, NetworkErrorString(WSAGetLastError()));
+    }
+#endif
+}
+
+#ifdef USE_EPOLL
+void CConnman::SocketEventsEpoll(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set)
+{
+    const int nMaxEvents = 64;
+    struct epoll_event events[nMaxEvents];
+
+    int nEvents = epoll_wait(epollfd, events, nMaxEvents, fEpollMoreData ? 0 : SELECT_TIMEOUT_MILLISECONDS);
+    fEpollMoreData = false;
+
+    if (interruptNet) return;
+
+    if (nEvents < 0) {
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEINTR)
+            LogPrintf("socket epoll error %s\n", NetworkErrorString(nErr));
+        nEvents = 0;
+    }
+
+    for (int i = 0; i < nEvents; i++) {
+        const SOCKET hSocket = events[i].data.fd;
+        if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+            error_set.insert(hSocket);
+        }
+        if (events[i].events & (EPOLLIN | EPOLLRDHUP)) {
+            bool fListenSocket = false;
+            for (const ListenSocket& hListenSocket : vhListenSocket) {
+                fListenSocket |= hListenSocket.socket == hSocket;
+            }
+            if (fListenSocket)
+                recv_set.insert(hSocket);
+            else
+                setEpollReceivable.insert(hSocket);
+        }
+        // Only an edge after a send filled the socket buffer, SocketSendData picks up from there
+        if (events[i].events & EPOLLOUT) {
+            send_set.insert(hSocket);
+        }
+    }
+
+    recv_set.insert(setEpollReceivable.begin(), setEpollReceivable.end());
+}
+#endif
+// VELES END
+
 void CConnman::SocketHandler()
 {
     std::set<SOCKET> recv_set, send_set, error_set;
-    SocketEvents(recv_set, send_set, error_set);
+    //SocketEvents(recv_set, send_set, error_set);
+    // VELES BEGIN
+#ifdef USE_EPOLL
+    if (socketEventsMode == SOCKETEVENTS_EPOLL)
+        SocketEventsEpoll(recv_set, send_set, error_set);
+    else
+#endif
+        SocketEvents(recv_set, send_set, error_set);
+    // VELES END
 
     if (interruptNet) return;
 
@@ -1403,16 +1631,35 @@ void CConnman::SocketHandler()
             sendSet = send_set.count(pnode->hSocket) > 0;
             errorSet = error_set.count(pnode->hSocket) > 0;
         }
+        // VELES BEGIN
+        // epoll reports every readable socket, hold the reads back as GenerateSelectSet does
+        if (recvSet && socketEventsMode == SOCKETEVENTS_EPOLL) {
+            if (pnode->fPauseRecv) {
+                recvSet = false;
+            } else {
+                LOCK(pnode->cs_vSend);
+                recvSet = pnode->SendQueueEmpty();
+            }
+        }
+        // VELES END
         if (recvSet || errorSet)
         {
             // typical socket buffer is 8K-64K
             char pchBuf[0x10000];
             int nBytes = 0;
+            // VELES BEGIN
+            SOCKET hSocketRead = INVALID_SOCKET;
+            bool fDrained = false;
+            // VELES END
             {
                 LOCK(pnode->cs_hSocket);
                 if (pnode->hSocket == INVALID_SOCKET)
                     continue;
                 nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+                // VELES BEGIN
+                hSocketRead = pnode->hSocket;
+                fDrained = nBytes < (int)sizeof(pchBuf) && !(nBytes < 0 && WSAGetLastError() == WSAEINTR);
+                // VELES END
             }
             if (nBytes > 0)
             {
@@ -1456,6 +1703,14 @@ void CConnman::SocketHandler()
                     pnode->CloseSocketDisconnect();
                 }
             }
+            // VELES BEGIN
+            if (socketEventsMode == SOCKETEVENTS_EPOLL) {
+                if (fDrained)
+                    setEpollReceivable.erase(hSocketRead);
+                else
+                    fEpollMoreData = true;
+            }
+            // VELES END
         }
 
         //
@@ -1710,7 +1965,18 @@ void CConnman::DumpAddresses()
 {
     int64_t nStart = GetTimeMillis();
 
+    // VELES BEGIN
+    // Dumps from the scheduler and from Stop() must not interleave their writes
+    static CCriticalSection cs_dump_addresses;
+    LOCK(cs_dump_addresses);
+
+    // Only the changes are appended to the journal of peers.dat, until it is compacted
     CAddrDB adb;
+    if (adb.WriteChanges(addrman)) {
+        LogPrint(BCLog::NET, "Flushed changed addresses to peers.journal  %dms\n", GetTimeMillis() - nStart);
+        return;
+    }
+    // VELES END
     adb.Write(addrman);
 
     LogPrint(BCLog::NET, "Flushed %d addresses to peers.dat  %dms\n",
@@ -1823,6 +2089,7 @@ void CConnman::ThreadOpenConnections(const std::vector<std::string> connect)
 
         // Only connect out to one peer per network group (/16 for IPv4).
         int nOutbound = 0;
+        int nOutboundMasternode = 0; // VELES
         std::set<std::vector<unsigned char> > setConnected;
         {
             LOCK(cs_vNodes);
@@ -1838,6 +2105,10 @@ void CConnman::ThreadOpenConnections(const std::vector<std::string> connect)
                     // to prevent us from connecting to particular hosts if we used them here.
                     setConnected.insert(pnode->addr.GetGroup());
                     nOutbound++;
+                    // VELES BEGIN
+                    if (!pnode->fFeeler && addrman.IsMasternodeAddress(pnode->addr))
+                        nOutboundMasternode++;
+                    // VELES END
                 }
             }
         }
@@ -1870,14 +2141,33 @@ void CConnman::ThreadOpenConnections(const std::vector<std::string> connect)
 
         int64_t nANow = GetAdjustedTime();
         int nTries = 0;
+        // VELES BEGIN
+        // Keep a share of the outbound slots on masternodes, they relay the InstantSend and governance traffic
+        const bool fMasternodeTier = !fFeeler && nOutboundMasternode < nMaxOutbound / OUTBOUND_MASTERNODE_TIER_RATIO && addrman.MasternodeTierSize() > 0;
+        // VELES END
         while (!interruptNet)
         {
             CAddrInfo addr = addrman.SelectTriedCollision();
 
             // SelectTriedCollision returns an invalid address if it is empty.
-            if (!fFeeler || !addr.IsValid()) {
+            //if (!fFeeler || !addr.IsValid()) {
+            //    addr = addrman.Select(fFeeler);
+            //}
+            // VELES BEGIN
+            // the first tries go to the masternode tier, then fall back to the tables
+            const bool fTryMasternode = fMasternodeTier && nTries < 10;
+            if (fTryMasternode) {
+                addr = addrman.SelectMasternode();
+            }
+            if ((!fFeeler && !fTryMasternode) || !addr.IsValid()) {
                 addr = addrman.Select(fFeeler);
             }
+            // a masternode that doesn't fit is no reason to restart, the tables are tried next
+            if (fTryMasternode && (setConnected.count(addr.GetGroup()) || !addr.IsValid() || IsLocal(addr))) {
+                nTries++;
+                continue;
+            }
+            // VELES END
 
             // Require outbound connections, other than feelers, to be to distinct network groups
             if (!fFeeler && setConnected.count(addr.GetGroup())) {
@@ -2047,8 +2337,9 @@ void CConnman::ThreadMnbRequestConnections()
 
         // FXTC BEGIN
         //ConnectNode(CAddress(p.first, NODE_NETWORK), NULL, false, false, true);
-        OpenNetworkConnection(CAddress(p.first, NODE_NETWORK), false, nullptr, NULL, false, false, false, true);
+        //OpenNetworkConnection(CAddress(p.first, NODE_NETWORK), false, nullptr, NULL, false, false, false, true);
         // FXTC END
+        ConnectMasternode(CAddress(p.first, NODE_NETWORK)); // VELES
 
         LOCK(cs_vNodes);
 
@@ -2138,6 +2429,13 @@ CNode* CConnman::OpenNetworkConnection(const CAddress& addrConnect, bool fCountF
         pnode->m_manual_connection = true;
 
     m_msgproc->InitializeNode(pnode);
+    // VELES BEGIN
+    {
+        LOCK(pnode->cs_hSocket);
+        if (pnode->hSocket != INVALID_SOCKET)
+            RegisterEvents(pnode->hSocket, false);
+    }
+    // VELES END
     {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
@@ -2263,6 +2561,7 @@ bool CConnman::BindListenPort(const CService &addrBind, std::string& strError, b
     }
 
     vhListenSocket.push_back(ListenSocket(hListenSocket, fWhitelisted));
+    RegisterEvents(hListenSocket, true); // VELES
 
     if (addrBind.IsRoutable() && fDiscover && !fWhitelisted)
         AddLocal(addrBind, LOCAL_BIND);
@@ -2383,6 +2682,18 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
 {
     Init(connOptions);
 
+    // VELES BEGIN
+#ifdef USE_EPOLL
+    if (socketEventsMode == SOCKETEVENTS_EPOLL) {
+        epollfd = epoll_create1(EPOLL_CLOEXEC);
+        if (epollfd == -1) {
+            LogPrintf("Failed to create epoll file descriptor (%s), using poll\n", NetworkErrorString(WSAGetLastError()));
+            socketEventsMode = SOCKETEVENTS_SELECT;
+        }
+    }
+#endif
+    // VELES END
+
     {
         LOCK(cs_totalBytesRecv);
         nTotalBytesRecv = 0;
@@ -2486,7 +2797,7 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
     threadMessageHandler = std::thread(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this)));
 
     // Dump network addresses
-    scheduler.scheduleEvery(std::bind(&CConnman::DumpAddresses, this), DUMP_PEERS_INTERVAL * 1000);
+    scheduler.scheduleEvery(std::bind(&CConnman::DumpAddresses, this), DUMP_PEERS_INTERVAL * 1000, CScheduler::PRIORITY_BACKGROUND); // VELES
 
     return true;
 }
@@ -2577,6 +2888,15 @@ void CConnman::Stop()
     vNodes.clear();
     vNodesDisconnected.clear();
     vhListenSocket.clear();
+    // VELES BEGIN
+    setEpollReceivable.clear();
+#ifdef USE_EPOLL
+    if (epollfd != -1) {
+        close(epollfd);
+        epollfd = -1;
+    }
+#endif
+    // VELES END
     semOutbound.reset();
     // Dash
     semMasternodeOutbound.reset();
@@ -2724,7 +3044,7 @@ bool CConnman::DisconnectNode(NodeId id)
 // Dash
 void CConnman::RelayTransaction(const CTransaction& tx)
 {
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    CScratchDataStream ss(SER_NETWORK, PROTOCOL_VERSION); // VELES
     ss.reserve(10000);
     uint256 hash = tx.GetHash();
     CTxLockRequest txLockRequest;
@@ -2740,25 +3060,50 @@ void CConnman::RelayTransaction(const CTransaction& tx)
 }
 
 
+// VELES BEGIN
+static void RememberRelayedInv(const CInv& inv, const CDataStream& ss)
+{
+    LOCK(cs_mapRelayDash);
+    // Expire old relay messages
+    while (!vRelayExpirationDash.empty() && vRelayExpirationDash.front().first < GetTime())
+    {
+        mapRelayDash.erase(vRelayExpirationDash.front().second);
+        vRelayExpirationDash.pop_front();
+    }
+
+    // Save original serialized message so newer versions are preserved
+    if (mapRelayDash.insert(std::make_pair(inv, ss)).second)
+        vRelayExpirationDash.push_back(std::make_pair(GetTime() + 15 * 60, inv));
+}
+
+void ForgetRelayedInv(const CInv& inv)
+{
+    LOCK(cs_mapRelayDash);
+    mapRelayDash.erase(inv);
+}
+// VELES END
+
 void CConnman::RelayTransaction(const CTransaction& tx, const CDataStream& ss)
 {
     uint256 hash = tx.GetHash();
-    int nInv = static_cast<bool>(CPrivateSend::GetDSTX(hash)) ? MSG_DSTX :
+    //int nInv = static_cast<bool>(CPrivateSend::GetDSTX(hash)) ? MSG_DSTX :
+    int nInv = CPrivateSend::HasDSTX(hash) ? MSG_DSTX : // VELES
                 (instantsend.HasTxLockRequest(hash) ? MSG_TXLOCK_REQUEST : MSG_TX);
     CInv inv(nInv, hash);
-    {
-        LOCK(cs_mapRelayDash);
-        // Expire old relay messages
-        while (!vRelayExpirationDash.empty() && vRelayExpirationDash.front().first < GetTime())
-        {
-            mapRelayDash.erase(vRelayExpirationDash.front().second);
-            vRelayExpirationDash.pop_front();
-        }
-
-        // Save original serialized message so newer versions are preserved
-        mapRelayDash.insert(std::make_pair(inv, ss));
-        vRelayExpirationDash.push_back(std::make_pair(GetTime() + 15 * 60, inv));
-    }
+    //{
+    //    LOCK(cs_mapRelayDash);
+    //    // Expire old relay messages
+    //    while (!vRelayExpirationDash.empty() && vRelayExpirationDash.front().first < GetTime())
+    //    {
+    //        mapRelayDash.erase(vRelayExpirationDash.front().second);
+    //        vRelayExpirationDash.pop_front();
+    //    }
+    //
+    //    // Save original serialized message so newer versions are preserved
+    //    mapRelayDash.insert(std::make_pair(inv, ss));
+    //    vRelayExpirationDash.push_back(std::make_pair(GetTime() + 15 * 60, inv));
+    //}
+    RememberRelayedInv(inv, ss); // VELES
     LOCK(cs_vNodes);
     for (auto* pnode : vNodes)
     {
@@ -2780,6 +3125,72 @@ void CConnman::RelayInv(CInv &inv, const int minProtoVersion) {
         if(pnode->nVersion >= minProtoVersion)
            pnode->PushInventory(inv);
 }
+
+// VELES BEGIN
+CNode* CConnman::ConnectMasternode(const CAddress& addr)
+{
+    {
+        LOCK(cs_vNodes);
+        CNode* pnode = FindNode(static_cast<CService>(addr));
+        if (pnode && !pnode->fDisconnect) {
+            // reuse the existing link, taking a masternode reference if it was a regular peer
+            if (!pnode->fMasternode) {
+                pnode->AddRef();
+                pnode->fMasternode = true;
+            }
+            pnode->nTimeMasternodePoolUsed = GetTime();
+            pnode->nMasternodePoolUses++;
+            LogPrint(BCLog::NET, "CConnman::ConnectMasternode -- reusing node: peer=%d addr=%s uses=%d\n",
+                      pnode->id, pnode->addr.ToString(), pnode->nMasternodePoolUses.load());
+            return pnode;
+        }
+    }
+
+    CNode* pnode = OpenNetworkConnection(addr, false, nullptr, nullptr, false, false, false, true);
+    if (pnode) {
+        pnode->nTimeMasternodePoolUsed = GetTime();
+        pnode->nMasternodePoolUses++;
+    }
+    return pnode;
+}
+
+void CConnman::TrimMasternodePool(std::function<bool(CNode*)> fKeep)
+{
+    int64_t nNow = GetTime();
+    std::vector<CNode*> vPooled;
+
+    LOCK(cs_vNodes);
+    for (CNode* pnode : vNodes) {
+        if (!pnode->fMasternode || pnode->fDisconnect || fKeep(pnode))
+            continue;
+        if (!IsMasternodePoolHealthy(pnode, nNow) || nNow - pnode->nTimeMasternodePoolUsed > MASTERNODE_POOL_IDLE_TIMEOUT) {
+            LogPrint(BCLog::NET, "CConnman::TrimMasternodePool -- removing node: peer=%d addr=%s idle=%d healthy=%d\n",
+                      pnode->id, pnode->addr.ToString(), nNow - pnode->nTimeMasternodePoolUsed, IsMasternodePoolHealthy(pnode, nNow));
+            pnode->fDisconnect = true;
+            continue;
+        }
+        vPooled.push_back(pnode);
+    }
+
+    if (vPooled.size() <= (size_t)MAX_MASTERNODE_POOL_CONNECTIONS)
+        return;
+
+    // over quota, keep the most recently used links
+    std::sort(vPooled.begin(), vPooled.end(), [](const CNode* a, const CNode* b) {
+        return a->nTimeMasternodePoolUsed > b->nTimeMasternodePoolUsed;
+    });
+    for (size_t i = MAX_MASTERNODE_POOL_CONNECTIONS; i < vPooled.size(); i++) {
+        LogPrint(BCLog::NET, "CConnman::TrimMasternodePool -- over quota, removing node: peer=%d addr=%s\n",
+                  vPooled[i]->id, vPooled[i]->addr.ToString());
+        vPooled[i]->fDisconnect = true;
+    }
+}
+
+void CConnman::RelayInv(CInv &inv, const CDataStream& ss, const int minProtoVersion) {
+    RememberRelayedInv(inv, ss);
+    RelayInv(inv, minProtoVersion);
+}
+// VELES END
 //
 
 void CConnman::RecordBytesRecv(uint64_t bytes)
@@ -2958,39 +3369,55 @@ CNode::~CNode()
     // FXTC END
 }
 
+//void CNode::AskFor(const CInv& inv)
+//{
+//    if (mapAskFor.size() > MAPASKFOR_MAX_SZ || setAskFor.size() > SETASKFOR_MAX_SZ)
+//        return;
+//    // a peer may not have multiple non-responded queue positions for a single inv item
+//    if (!setAskFor.insert(inv.hash).second)
+//        return;
+//
+//    // We're using mapAskFor as a priority queue,
+//    // the key is the earliest time the request can be sent
+//    int64_t nRequestTime;
+//    limitedmap<uint256, int64_t>::const_iterator it = mapAlreadyAskedFor.find(inv.hash);
+//    if (it != mapAlreadyAskedFor.end())
+//        nRequestTime = it->second;
+//    else
+//        nRequestTime = 0;
+//    LogPrint(BCLog::NET, "askfor %s  %d (%s) peer=%d\n", inv.ToString(), nRequestTime, FormatISO8601Time(nRequestTime/1000000), id);
+//
+//    // Make sure not to reuse time indexes to keep things in the same order
+//    int64_t nNow = GetTimeMicros() - 1000000;
+//    static int64_t nLastTime;
+//    ++nLastTime;
+//    nNow = std::max(nNow, nLastTime);
+//    nLastTime = nNow;
+//
+//    // Each retry is 2 minutes after the last
+//    nRequestTime = std::max(nRequestTime + 2 * 60 * 1000000, nNow);
+//    if (it != mapAlreadyAskedFor.end())
+//        mapAlreadyAskedFor.update(it, nRequestTime);
+//    else
+//        mapAlreadyAskedFor.insert(std::make_pair(inv.hash, nRequestTime));
+//    mapAskFor.insert(std::make_pair(nRequestTime, inv));
+//}
+// VELES BEGIN
 void CNode::AskFor(const CInv& inv)
 {
-    if (mapAskFor.size() > MAPASKFOR_MAX_SZ || setAskFor.size() > SETASKFOR_MAX_SZ)
+    const size_t nTracked = invRequests.Size();
+    if (nTracked - invRequests.CountInFlight() > MAPASKFOR_MAX_SZ || nTracked > SETASKFOR_MAX_SZ)
         return;
     // a peer may not have multiple non-responded queue positions for a single inv item
-    if (!setAskFor.insert(inv.hash).second)
+    if (invRequests.Has(inv.hash))
         return;
 
-    // We're using mapAskFor as a priority queue,
-    // the key is the earliest time the request can be sent
-    int64_t nRequestTime;
-    limitedmap<uint256, int64_t>::const_iterator it = mapAlreadyAskedFor.find(inv.hash);
-    if (it != mapAlreadyAskedFor.end())
-        nRequestTime = it->second;
-    else
-        nRequestTime = 0;
+    // The tracker keeps the items in request time order, ties in the order they were asked for
+    const int64_t nRequestTime = g_inv_request_times.Schedule(inv.hash, GetTimeMicros() - 1000000);
     LogPrint(BCLog::NET, "askfor %s  %d (%s) peer=%d\n", inv.ToString(), nRequestTime, FormatISO8601Time(nRequestTime/1000000), id);
-
-    // Make sure not to reuse time indexes to keep things in the same order
-    int64_t nNow = GetTimeMicros() - 1000000;
-    static int64_t nLastTime;
-    ++nLastTime;
-    nNow = std::max(nNow, nLastTime);
-    nLastTime = nNow;
-
-    // Each retry is 2 minutes after the last
-    nRequestTime = std::max(nRequestTime + 2 * 60 * 1000000, nNow);
-    if (it != mapAlreadyAskedFor.end())
-        mapAlreadyAskedFor.update(it, nRequestTime);
-    else
-        mapAlreadyAskedFor.insert(std::make_pair(inv.hash, nRequestTime));
-    mapAskFor.insert(std::make_pair(nRequestTime, inv));
+    invRequests.Add(inv, nRequestTime);
 }
+// VELES END
 
 bool CConnman::NodeFullyConnected(const CNode* pnode)
 {
@@ -3002,6 +3429,42 @@ bool CConnman::NotMasternodesOnly(const CNode* pnode)
     return pnode && !pnode->fMasternode;
 }
 
+// VELES BEGIN
+SendPriority GetSendPriority(const std::string& command)
+{
+    // Everything else, the control messages included, goes with the blocks
+    static const std::map<std::string, SendPriority> mapPriority = {
+        {NetMsgType::TX, SEND_PRIORITY_TX},
+        {NetMsgType::DSTX, SEND_PRIORITY_TX},
+        {NetMsgType::MNPING, SEND_PRIORITY_TX},
+        {NetMsgType::MNPINGBUNDLE, SEND_PRIORITY_TX},
+        {NetMsgType::MNANNOUNCE, SEND_PRIORITY_SYNC},
+        {NetMsgType::MNVERIFY, SEND_PRIORITY_SYNC},
+        {NetMsgType::DSEG, SEND_PRIORITY_SYNC},
+        {NetMsgType::MNLISTDIFF, SEND_PRIORITY_SYNC},
+        {NetMsgType::MASTERNODEPAYMENTVOTE, SEND_PRIORITY_SYNC},
+        {NetMsgType::MNPAYMENTVOTEBUNDLE, SEND_PRIORITY_SYNC},
+        {NetMsgType::MASTERNODEPAYMENTSYNC, SEND_PRIORITY_SYNC},
+        {NetMsgType::MNGOVERNANCESYNC, SEND_PRIORITY_SYNC},
+        {NetMsgType::MNGOVERNANCEOBJECT, SEND_PRIORITY_SYNC},
+        {NetMsgType::MNGOVERNANCEOBJECTVOTE, SEND_PRIORITY_SYNC},
+        {NetMsgType::SYNCSTATUSCOUNT, SEND_PRIORITY_SYNC},
+    };
+    auto it = mapPriority.find(command);
+    return it != mapPriority.end() ? it->second : SEND_PRIORITY_HIGH;
+}
+
+const char* GetSendPriorityName(int nClass)
+{
+    switch (nClass) {
+    case SEND_PRIORITY_HIGH: return "high";
+    case SEND_PRIORITY_TX: return "tx";
+    case SEND_PRIORITY_SYNC: return "sync";
+    }
+    return "";
+}
+// VELES END
+
 void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
 {
     size_t nMessageSize = msg.data.size();
@@ -3016,10 +3479,11 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
 
     CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, serializedHeader, 0, hdr};
 
+    const SendPriority priority = GetSendPriority(msg.command); // VELES
     size_t nBytesSent = 0;
     {
         LOCK(pnode->cs_vSend);
-        bool optimisticSend(pnode->vSendMsg.empty());
+        bool optimisticSend(pnode->SendQueueEmpty()); // VELES
 
         //log total amount of bytes per command
         pnode->mapSendBytesPerMsgCmd[msg.command] += nTotalSize;
@@ -3027,9 +3491,14 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
 
         if (pnode->nSendSize > nSendBufferMaxSize)
             pnode->fPauseSend = true;
-        pnode->vSendMsg.push_back(std::move(serializedHeader));
+        // VELES BEGIN
+        // pnode->vSendMsg.push_back(std::move(serializedHeader));
+        // if (nMessageSize)
+        //     pnode->vSendMsg.push_back(std::move(msg.data));
+        pnode->vSendMsg[priority].push_back(std::move(serializedHeader));
         if (nMessageSize)
-            pnode->vSendMsg.push_back(std::move(msg.data));
+            pnode->vSendMsg[priority].push_back(std::move(msg.data));
+        // VELES END
 
         // If write queue empty, attempt "optimistic write"
         if (optimisticSend == true)
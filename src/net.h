@@ -15,6 +15,7 @@
 #include <compat.h>
 #include <crypto/siphash.h>
 #include <hash.h>
+#include <invrequest.h> // VELES
 #include <limitedmap.h>
 #include <netaddress.h>
 #include <policy/feerate.h>
@@ -25,6 +26,7 @@
 #include <uint256.h>
 #include <threadinterrupt.h>
 
+#include <array> // VELES
 #include <atomic>
 #include <deque>
 #include <stdint.h>
@@ -63,6 +65,16 @@ static const int MAX_OUTBOUND_CONNECTIONS = 8;
 /** Maximum number if outgoing masternodes */
 static const int MAX_OUTBOUND_MASTERNODE_CONNECTIONS = 20;
 //
+// VELES BEGIN
+/** Maximum number of idle masternode links kept open for reuse */
+static const int MAX_MASTERNODE_POOL_CONNECTIONS = 8;
+/** Seconds a pooled masternode link may stay unused before it is closed */
+static const int64_t MASTERNODE_POOL_IDLE_TIMEOUT = 15 * 60;
+/** Seconds a pooled masternode link may take to finish its version handshake */
+static const int64_t MASTERNODE_POOL_HANDSHAKE_TIMEOUT = 60;
+/** One in this many automatic outbound connections is kept to a masternode address */
+static const int OUTBOUND_MASTERNODE_TIER_RATIO = 4;
+// VELES END
 /** Maximum number of addnode outgoing nodes */
 static const int MAX_ADDNODE_CONNECTIONS = 8;
 /** -listen default */
@@ -73,9 +85,9 @@ static const bool DEFAULT_UPNP = USE_UPNP;
 #else
 static const bool DEFAULT_UPNP = false;
 #endif
-/** The maximum number of entries in mapAskFor */
+/** The maximum number of items waiting to be requested from a peer */
 static const size_t MAPASKFOR_MAX_SZ = MAX_INV_SZ;
-/** The maximum number of entries in setAskFor (larger due to getdata latency)*/
+/** The maximum number of items tracked for a peer, waiting or in flight (larger due to getdata latency)*/
 static const size_t SETASKFOR_MAX_SZ = 2 * MAX_INV_SZ;
 /** The maximum number of peer connections to maintain. */
 static const unsigned int DEFAULT_MAX_PEER_CONNECTIONS = 125;
@@ -94,6 +106,26 @@ static const size_t DEFAULT_MAXSENDBUFFER    = 1 * 1000;
 
 // VELES BEGIN
 static const bool DEFAULT_RPC_BACK_COMPATIBLE = true;
+
+/** How the socket handler waits for the sockets, see -socketevents */
+enum SocketEventsMode {
+    //! Rebuild a select() (poll() where it works) set from the peers every round
+    SOCKETEVENTS_SELECT,
+    //! Sockets registered once with epoll, edge-triggered for the peers
+    SOCKETEVENTS_EPOLL,
+};
+
+#ifdef USE_EPOLL
+static const char* const DEFAULT_SOCKETEVENTS = "epoll";
+#elif defined(USE_POLL)
+static const char* const DEFAULT_SOCKETEVENTS = "poll";
+#else
+static const char* const DEFAULT_SOCKETEVENTS = "select";
+#endif
+
+/** Comma separated names of the -socketevents modes this build supports */
+std::string GetSupportedSocketEventsStr();
+bool ParseSocketEventsMode(const std::string& str, SocketEventsMode& mode);
 // VELES END
 
 typedef int64_t NodeId;
@@ -157,6 +189,7 @@ public:
         bool m_use_addrman_outgoing = true;
         std::vector<std::string> m_specified_outgoing;
         std::vector<std::string> m_added_nodes;
+        SocketEventsMode socketEventsMode = SOCKETEVENTS_SELECT; // VELES
     };
 
     void Init(const Options& connOptions) {
@@ -173,6 +206,7 @@ public:
         nSendBufferMaxSize = connOptions.nSendBufferMaxSize;
         nReceiveFloodSize = connOptions.nReceiveFloodSize;
         m_peer_connect_timeout = connOptions.m_peer_connect_timeout;
+        socketEventsMode = connOptions.socketEventsMode; // VELES
         {
             LOCK(cs_totalBytesSent);
             nMaxOutboundTimeframe = connOptions.nMaxOutboundTimeframe;
@@ -336,6 +370,25 @@ public:
     void RelayTransaction(const CTransaction& tx);
     void RelayTransaction(const CTransaction& tx, const CDataStream& ss);
     void RelayInv(CInv &inv, const int minProtoVersion = MIN_PEER_PROTO_VERSION);
+    // VELES BEGIN
+    /**
+     * Return a link to the masternode at addr, reusing an open connection when one
+     * exists and opening a new masternode connection otherwise.
+     */
+    CNode* ConnectMasternode(const CAddress& addr);
+    /**
+     * Close masternode links that are unhealthy, idle for longer than MASTERNODE_POOL_IDLE_TIMEOUT
+     * or beyond the MAX_MASTERNODE_POOL_CONNECTIONS most recently used ones. Links for which
+     * fKeep returns true are left alone and do not count against the quota.
+     */
+    void TrimMasternodePool(std::function<bool(CNode*)> fKeep);
+    /** Update the masternode addresses preferred for a share of the automatic outbound connections */
+    void SetMasternodeAddresses(const std::vector<CAddress>& vAddr) { addrman.SetMasternodeAddresses(vAddr); }
+    // VELES END
+    // VELES BEGIN
+    /** Relay an inv and keep its serialized payload so getdata can answer every peer from one encoding */
+    void RelayInv(CInv &inv, const CDataStream& ss, const int minProtoVersion = MIN_PEER_PROTO_VERSION);
+    // VELES END
     //
 
     // Addrman functions
@@ -434,6 +487,13 @@ private:
     void InactivityCheck(CNode *pnode);
     bool GenerateSelectSet(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set);
     void SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set);
+    // VELES BEGIN
+#ifdef USE_EPOLL
+    void SocketEventsEpoll(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set);
+#endif
+    /** Add a new socket to the epoll set, edge-triggered unless it is a listening one */
+    void RegisterEvents(SOCKET hSocket, bool fListen);
+    // VELES END
     void SocketHandler();
     void ThreadSocketHandler();
     void ThreadDNSAddressSeed();
@@ -493,6 +553,20 @@ private:
     unsigned int nSendBufferMaxSize{0};
     unsigned int nReceiveFloodSize{0};
 
+    // VELES BEGIN
+    SocketEventsMode socketEventsMode{SOCKETEVENTS_SELECT};
+#ifdef USE_EPOLL
+    int epollfd{-1};
+#endif
+    /**
+     * Peer sockets epoll reported readable which were not read empty yet, no new edge comes
+     * for them until they are. Only used by the socket handler thread.
+     */
+    std::set<SOCKET> setEpollReceivable;
+    //! A read of the last round filled the buffer, wait for nothing in the next one
+    bool fEpollMoreData{false};
+    // VELES END
+
     std::vector<ListenSocket> vhListenSocket;
     std::atomic<bool> fNetworkActive{true};
     bool fAddressesInitialized{false};
@@ -639,8 +713,13 @@ extern bool g_relay_txes;
 extern std::map<CInv, CDataStream> mapRelayDash;
 extern std::deque<std::pair<int64_t, CInv> > vRelayExpirationDash;
 extern CCriticalSection cs_mapRelayDash;
+// VELES BEGIN
+/** Drop the cached payload of an inv whose object changed after it was relayed */
+void ForgetRelayedInv(const CInv& inv);
+// VELES END
 //
-extern limitedmap<uint256, int64_t> mapAlreadyAskedFor;
+//extern limitedmap<uint256, int64_t> mapAlreadyAskedFor;
+extern CInvRequestTimes g_inv_request_times; // VELES
 
 /** Subversion as sent to the P2P network in `version` messages */
 extern std::string strSubVersion;
@@ -656,6 +735,24 @@ extern std::map<CNetAddr, LocalServiceInfo> mapLocalHost GUARDED_BY(cs_mapLocalH
 extern const std::string NET_MESSAGE_COMMAND_OTHER;
 typedef std::map<std::string, uint64_t> mapMsgCmdSize; //command, total bytes
 
+// VELES BEGIN
+/** Priority classes of the messages sent to a peer, highest first */
+enum SendPriority : int {
+    SEND_PRIORITY_HIGH = 0, //!< blocks, headers, InstantSend and the control messages
+    SEND_PRIORITY_TX,       //!< transactions and masternode pings
+    SEND_PRIORITY_SYNC,     //!< masternode list, payment and governance sync
+    SEND_PRIORITY_COUNT
+};
+
+/** Priority class of the messages of a command */
+SendPriority GetSendPriority(const std::string& command);
+
+/** Name of a priority class, as reported by getpeerinfo */
+const char* GetSendPriorityName(int nClass);
+
+typedef std::array<uint64_t, SEND_PRIORITY_COUNT> sendPriorityBytes;
+// VELES END
+
 class CNodeStats
 {
 public:
@@ -674,6 +771,7 @@ public:
     int nStartingHeight;
     uint64_t nSendBytes;
     mapMsgCmdSize mapSendBytesPerMsgCmd;
+    sendPriorityBytes nSendBytesPerClass; // VELES
     uint64_t nRecvBytes;
     mapMsgCmdSize mapRecvBytesPerMsgCmd;
     bool fWhitelisted;
@@ -687,11 +785,43 @@ public:
     CAddress addr;
     // Bind address of our side of the connection
     CAddress addrBind;
+    // VELES BEGIN
+    bool fMasternode;
+    int64_t nTimeMasternodePoolUsed;
+    uint64_t nMasternodePoolUses;
+    bool fMasternodePoolHealthy;
+    // VELES END
 };
 
 
 
 
+// VELES BEGIN
+/**
+ * Buffers of processed messages kept for the next ones received, so the thousands of
+ * small messages of a masternode or governance sync do not allocate one each.
+ */
+class CNetMessageBufferPool
+{
+private:
+    Mutex cs;
+    std::vector<CSerializeData> vBuffers GUARDED_BY(cs);
+    size_t nPoolSize GUARDED_BY(cs) = 0;
+
+public:
+    //! Buffers with a larger capacity, the ones of blocks mostly, are freed
+    static constexpr size_t MAX_BUFFER_SIZE = 512 * 1024;
+    //! Total capacity of the buffers kept
+    static constexpr size_t MAX_POOL_SIZE = 4 * 1024 * 1024;
+
+    /** An empty buffer, with the capacity of a recycled one if there is any */
+    CSerializeData Get();
+    void Put(CSerializeData&& buffer);
+};
+
+extern CNetMessageBufferPool g_net_message_buffers;
+// VELES END
+
 class CNetMessage {
 private:
     mutable CHash256 hasher;
@@ -699,7 +829,8 @@ private:
 public:
     bool in_data;                   // parsing header (false) or data (true)
 
-    CDataStream hdrbuf;             // partially received header
+    //CDataStream hdrbuf;             // partially received header
+    char hdrbuf[CMessageHeader::HEADER_SIZE]; // partially received header // VELES
     CMessageHeader hdr;             // complete header
     unsigned int nHdrPos;
 
@@ -708,14 +839,21 @@ public:
 
     int64_t nTime;                  // time (in microseconds) of message receipt.
 
-    CNetMessage(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nTypeIn, int nVersionIn) : hdrbuf(nTypeIn, nVersionIn), hdr(pchMessageStartIn), vRecv(nTypeIn, nVersionIn) {
-        hdrbuf.resize(24);
+    //CNetMessage(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nTypeIn, int nVersionIn) : hdrbuf(nTypeIn, nVersionIn), hdr(pchMessageStartIn), vRecv(nTypeIn, nVersionIn) {
+    CNetMessage(const CMessageHeader::MessageStartChars& pchMessageStartIn, int nTypeIn, int nVersionIn) : hdr(pchMessageStartIn), vRecv(nTypeIn, nVersionIn) { // VELES
+        //hdrbuf.resize(24);
         in_data = false;
         nHdrPos = 0;
         nDataPos = 0;
         nTime = 0;
     }
 
+    // VELES BEGIN
+    ~CNetMessage();
+    CNetMessage(CNetMessage&&) = default;
+    CNetMessage& operator=(CNetMessage&&) = default;
+    // VELES END
+
     bool complete() const
     {
         if (!in_data)
@@ -727,7 +865,7 @@ public:
 
     void SetVersion(int nVersionIn)
     {
-        hdrbuf.SetVersion(nVersionIn);
+        //hdrbuf.SetVersion(nVersionIn);
         vRecv.SetVersion(nVersionIn);
     }
 
@@ -747,7 +885,15 @@ public:
     size_t nSendSize{0}; // total size of all vSendMsg entries
     size_t nSendOffset{0}; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes GUARDED_BY(cs_vSend){0};
-    std::deque<std::vector<unsigned char>> vSendMsg GUARDED_BY(cs_vSend);
+    // std::deque<std::vector<unsigned char>> vSendMsg GUARDED_BY(cs_vSend);
+    // VELES BEGIN
+    //! messages to send by priority class, each as its header followed by its payload if not empty
+    std::deque<std::vector<unsigned char>> vSendMsg[SEND_PRIORITY_COUNT] GUARDED_BY(cs_vSend);
+    //! class sending, parts of its current message left to send, and bytes each class may still send in its turn
+    int nSendClass GUARDED_BY(cs_vSend){SEND_PRIORITY_COUNT - 1};
+    int nSendParts GUARDED_BY(cs_vSend){0};
+    int64_t nSendDeficit[SEND_PRIORITY_COUNT] GUARDED_BY(cs_vSend){};
+    // VELES END
     CCriticalSection cs_vSend;
     CCriticalSection cs_hSocket;
     CCriticalSection cs_vRecv;
@@ -800,6 +946,11 @@ public:
     // Dash
     bool fMasternode{false};
     //
+    // VELES BEGIN
+    // Masternode pool bookkeeping, see CConnman::ConnectMasternode()
+    std::atomic<int64_t> nTimeMasternodePoolUsed{0};
+    std::atomic<uint64_t> nMasternodePoolUses{0};
+    // VELES END
     bool fSentAddr{false};
     CSemaphoreGrant grantOutbound;
     // Dash
@@ -815,6 +966,7 @@ public:
 
 protected:
     mapMsgCmdSize mapSendBytesPerMsgCmd;
+    sendPriorityBytes nSendBytesPerClass GUARDED_BY(cs_vSend){}; // VELES
     mapMsgCmdSize mapRecvBytesPerMsgCmd GUARDED_BY(cs_vRecv);
 
 public:
@@ -841,13 +993,22 @@ public:
     // There is no final sorting before sending, as they are always sent immediately
     // and in the order requested.
     std::vector<uint256> vInventoryBlockToSend GUARDED_BY(cs_inventory);
+    // VELES BEGIN
+    // Governance vote hashes we still have to announce, sent in batches
+    std::vector<uint256> vInventoryVoteToSend GUARDED_BY(cs_inventory);
+    // VELES END
     CCriticalSection cs_inventory;
-    std::set<uint256> setAskFor;
-    std::multimap<int64_t, CInv> mapAskFor;
+    //std::set<uint256> setAskFor;
+    //std::multimap<int64_t, CInv> mapAskFor;
+    // VELES BEGIN
+    // Inventory items to request from this peer, see AskFor()
+    CInvRequestTracker invRequests;
+    // VELES END
     int64_t nNextInvSend{0};
     // Dash
     int64_t nNextInvSendDash{0};
     //
+    int64_t nNextVoteInvSend{0}; // VELES
     // Used for headers announcements - unfiltered blocks to relay
     std::vector<uint256> vBlockHashesToAnnounce GUARDED_BY(cs_inventory);
     // Used for BIP35 mempool sending
@@ -988,6 +1149,13 @@ public:
         } else if (inv.type == MSG_BLOCK) {
             LogPrint(BCLog::NET, "PushInventory --  inv: %s peer=%d\n", inv.ToString(), id);
             vInventoryBlockToSend.push_back(inv.hash);
+        // VELES BEGIN
+        } else if (inv.type == MSG_GOVERNANCE_OBJECT_VOTE) {
+            if (!filterInventoryKnown.contains(inv.hash)) {
+                LogPrint(BCLog::NET, "PushInventory --  vote inv: %s peer=%d\n", inv.ToString(), id);
+                vInventoryVoteToSend.push_back(inv.hash);
+            }
+        // VELES END
         } else {
             LogPrint(BCLog::NET, "PushInventory --  %s peer=%d\n", inv.ToString(), id);
             vInventoryToSend.push_back(inv);
@@ -1001,11 +1169,30 @@ public:
     }
 
     void AskFor(const CInv& inv);
+    // VELES BEGIN
+    /** Stop tracking an asked for item, it was delivered or is not going to be */
+    void RemoveAskFor(const uint256& hash) { invRequests.Remove(hash); }
+    size_t GetAskForCount() const { return invRequests.Size(); }
+    // VELES END
 
     void CloseSocketDisconnect();
 
     void copyStats(CNodeStats &stats);
 
+    // VELES BEGIN
+    //! Whether all the messages queued were sent
+    bool SendQueueEmpty() const EXCLUSIVE_LOCKS_REQUIRED(cs_vSend)
+    {
+        for (const auto& queue : vSendMsg) {
+            if (!queue.empty()) return false;
+        }
+        return true;
+    }
+
+    //! Pick the class of the next message to send, false if none is queued
+    bool SelectSendClass() EXCLUSIVE_LOCKS_REQUIRED(cs_vSend);
+    // VELES END
+
     ServiceFlags GetLocalServices() const
     {
         return nLocalServices;
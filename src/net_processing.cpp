@@ -14,6 +14,7 @@
 #include <chainparams.h>
 #include <consensus/validation.h>
 #include <hash.h>
+#include <index/blockfilterindex.h> // VELES
 #include <validation.h>
 #include <merkleblock.h>
 #include <netmessagemaker.h>
@@ -34,6 +35,17 @@
 
 #include <memory>
 
+// VELES BEGIN
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <list>
+#include <map>
+#include <set>
+#include <thread>
+// VELES END
+
 // Dash
 #include <spork.h>
 #include <governance/governance.h>
@@ -105,10 +117,29 @@ static const unsigned int INVENTORY_BROADCAST_INTERVAL = 5;
 /** Maximum number of inventory items to send per transmission.
  *  Limits the impact of low-fee transaction floods. */
 static constexpr unsigned int INVENTORY_BROADCAST_MAX = 7 * INVENTORY_BROADCAST_INTERVAL;
+// VELES BEGIN
+/** Average delay between governance vote inventory transmissions in seconds.
+ *  Votes arrive in bursts near superblocks and are announced in batches. */
+static const unsigned int VOTE_INVENTORY_BROADCAST_INTERVAL = 2;
+// VELES END
 /** Average delay between feefilter broadcasts in seconds. */
 static constexpr unsigned int AVG_FEEFILTER_BROADCAST_INTERVAL = 10 * 60;
 /** Maximum feefilter broadcast delay after significant change. */
 static constexpr unsigned int MAX_FEEFILTER_CHANGE_DELAY = 5 * 60;
+// VELES BEGIN
+/** Maximum number of compact filters that may be requested with one getcfilters. See BIP 157. */
+static constexpr uint32_t MAX_GETCFILTERS_SIZE = 1000;
+/** Maximum number of cf hashes that may be requested with one getcfheaders. See BIP 157. */
+static constexpr uint32_t MAX_GETCFHEADERS_SIZE = 2000;
+/** Interval between compact filter checkpoints. See BIP 157. */
+static constexpr int CFCHECKPT_INTERVAL = 1000;
+/** Announcements of a block later than this after the first one count as this late, in microseconds */
+static constexpr int64_t BLOCK_ANNOUNCE_LATENCY_MAX = 30 * 1000000;
+/** Number of recent blocks whose first announcement is remembered to time the others */
+static constexpr size_t BLOCK_ANNOUNCE_TRACKED_MAX = 8;
+/** Announcement latency the masternodes are credited with when choosing the high-bandwidth compact block peers, in microseconds */
+static constexpr int64_t HB_MASTERNODE_LATENCY_BONUS = 200 * 1000;
+// VELES END
 
 // Internal stuff
 namespace {
@@ -157,12 +188,26 @@ namespace {
     /** Stack of nodes which we have set to announce using compact blocks */
     std::list<NodeId> lNodesAnnouncingHeaderAndIDs GUARDED_BY(cs_main);
 
+    // VELES BEGIN
+    /** New blocks announced recently, when they were first announced and the peers that announced them since */
+    struct BlockAnnouncement {
+        int64_t nTimeFirst;
+        std::vector<NodeId> vPeers;
+    };
+    std::map<uint256, BlockAnnouncement> mapBlockAnnouncements GUARDED_BY(cs_main);
+    // VELES END
+
     /** Number of preferable block download peers. */
     int nPreferredDownload GUARDED_BY(cs_main) = 0;
 
     /** Number of peers from which we're downloading blocks. */
     int nPeersWithValidatedDownloads GUARDED_BY(cs_main) = 0;
 
+    // VELES BEGIN
+    /** Sum of the blocks in transit limits of the peers with blocks in flight, sizes the download window. */
+    int nBlocksInFlightCapacity GUARDED_BY(cs_main) = 0;
+    // VELES END
+
     /** Number of outbound peers with m_chain_sync.m_protect. */
     int g_outbound_peers_with_protect_from_disconnect GUARDED_BY(cs_main) = 0;
 
@@ -240,6 +285,20 @@ struct CNodeState {
     int64_t nDownloadingSince;
     int nBlocksInFlight;
     int nBlocksInFlightValidHeaders;
+    // VELES BEGIN
+    //! Number of blocks that may be in flight from this peer, adapted to how fast it delivers.
+    int nBlocksInFlightLimit;
+    //! Moving average of the time the first entry in vBlocksInFlight took to arrive (in microseconds), or 0.
+    int64_t nBlockDeliveryTime;
+    //! Whether the limit was already reduced because the first entry in vBlocksInFlight is late.
+    bool fBlockDeliverySlow;
+    //! Whether this peer wants its headers in "cmpheaders" rather than "headers" messages.
+    bool fPreferCompressedHeaders;
+    //! Whether this peer wants the pings and payment votes it asks for in bundles.
+    bool fWantsMnBundles;
+    //! Moving average of how long after the first peer this one announces new blocks (in microseconds), or -1.
+    int64_t nBlockAnnounceLatency;
+    // VELES END
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload;
     //! Whether this peer wants invs or headers (when possible) for block announcements.
@@ -307,6 +366,14 @@ struct CNodeState {
         nDownloadingSince = 0;
         nBlocksInFlight = 0;
         nBlocksInFlightValidHeaders = 0;
+        // VELES BEGIN
+        nBlocksInFlightLimit = MAX_BLOCKS_IN_TRANSIT_PER_PEER;
+        nBlockDeliveryTime = 0;
+        fBlockDeliverySlow = false;
+        fPreferCompressedHeaders = false;
+        fWantsMnBundles = false;
+        nBlockAnnounceLatency = -1;
+        // VELES END
         fPreferredDownload = false;
         fPreferHeaders = false;
         fPreferHeaderAndIDs = false;
@@ -375,9 +442,15 @@ static bool MarkBlockAsReceived(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs
         if (state->vBlocksInFlight.begin() == itInFlight->second.second) {
             // First block on the queue was received, update the start download time for the next one
             state->nDownloadingSince = std::max(state->nDownloadingSince, GetTimeMicros());
+            state->fBlockDeliverySlow = false; // VELES
         }
         state->vBlocksInFlight.erase(itInFlight->second.second);
         state->nBlocksInFlight--;
+        // VELES BEGIN
+        if (state->nBlocksInFlight == 0) {
+            nBlocksInFlightCapacity -= state->nBlocksInFlightLimit;
+        }
+        // VELES END
         state->nStallingSince = 0;
         mapBlocksInFlight.erase(itInFlight);
         return true;
@@ -410,6 +483,7 @@ static bool MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const CBlock
     if (state->nBlocksInFlight == 1) {
         // We're starting a block download (batch) from this peer.
         state->nDownloadingSince = GetTimeMicros();
+        nBlocksInFlightCapacity += state->nBlocksInFlightLimit; // VELES
     }
     if (state->nBlocksInFlightValidHeaders == 1 && pindex != nullptr) {
         nPeersWithValidatedDownloads++;
@@ -420,6 +494,50 @@ static bool MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const CBlock
     return true;
 }
 
+// VELES BEGIN
+static void SetBlocksInFlightLimit(CNodeState* state, int nLimit) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    nLimit = std::max(MIN_BLOCKS_IN_TRANSIT_PER_PEER, std::min(MAX_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER, nLimit));
+    if (state->nBlocksInFlight > 0) {
+        nBlocksInFlightCapacity += nLimit - state->nBlocksInFlightLimit;
+    }
+    state->nBlocksInFlightLimit = nLimit;
+}
+
+/**
+ * Measure how long the block that arrived from nodeid took, if it was the first one in flight from that
+ * peer, and step its limit of blocks in transit towards enough blocks to cover two round trips.
+ */
+static void UpdateBlockDelivery(NodeId nodeid, const uint256& hash, int64_t nPingUsecTime) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
+    if (itInFlight == mapBlocksInFlight.end() || itInFlight->second.first != nodeid)
+        return;
+    CNodeState *state = State(nodeid);
+    assert(state != nullptr);
+    if (state->vBlocksInFlight.begin() != itInFlight->second.second)
+        return;
+
+    int64_t nDeliveryTime = std::max<int64_t>(GetTimeMicros() - state->nDownloadingSince, 1);
+    state->nBlockDeliveryTime = state->nBlockDeliveryTime == 0 ? nDeliveryTime : (state->nBlockDeliveryTime * 7 + nDeliveryTime) / 8;
+    if (nPingUsecTime <= 0)
+        return;
+
+    // While the peer has enough blocks queued the delivery time is its per block transfer time, so this many
+    // blocks keep it busy for two round trips. Move one step at a time so a single sample can't swing the limit.
+    int64_t nTarget = 2 * (1 + nPingUsecTime / state->nBlockDeliveryTime);
+    if (nTarget > state->nBlocksInFlightLimit) {
+        SetBlocksInFlightLimit(state, state->nBlocksInFlightLimit + 1);
+    } else if (nTarget < state->nBlocksInFlightLimit) {
+        SetBlocksInFlightLimit(state, state->nBlocksInFlightLimit - 1);
+    }
+}
+
+/** How far beyond the last common block we fetch, grows with the number of blocks that may be in transit. */
+static int GetBlockDownloadWindow() EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    int64_t nWindow = (int64_t)nBlocksInFlightCapacity * BLOCK_DOWNLOAD_WINDOW_PER_BLOCK_IN_TRANSIT;
+    return std::max<int64_t>(BLOCK_DOWNLOAD_WINDOW, std::min<int64_t>(BLOCK_DOWNLOAD_WINDOW_MAX, nWindow));
+}
+// VELES END
+
 /** Check whether the last unknown block a peer advertised is not yet known. */
 static void ProcessBlockAvailability(NodeId nodeid) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
     CNodeState *state = State(nodeid);
@@ -436,11 +554,47 @@ static void ProcessBlockAvailability(NodeId nodeid) EXCLUSIVE_LOCKS_REQUIRED(cs_
     }
 }
 
+// VELES BEGIN
+/**
+ * Time the announcement of a block by a peer against its first announcement
+ * by any peer. Only the blocks that may extend our chain are timed, and each
+ * peer is timed once per block.
+ */
+static void UpdateBlockAnnounceLatency(CNodeState* state, NodeId nodeid, const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    if (IsInitialBlockDownload())
+        return;
+
+    const int64_t nNow = GetTimeMicros();
+    auto it = mapBlockAnnouncements.find(hash);
+    if (it == mapBlockAnnouncements.end()) {
+        const CBlockIndex* pindex = LookupBlockIndex(hash);
+        if (pindex && ((pindex->nStatus & BLOCK_HAVE_DATA) || pindex->nHeight <= chainActive.Height()))
+            return;
+        if (mapBlockAnnouncements.size() >= BLOCK_ANNOUNCE_TRACKED_MAX) {
+            mapBlockAnnouncements.erase(std::min_element(mapBlockAnnouncements.begin(), mapBlockAnnouncements.end(),
+                [](const std::pair<const uint256, BlockAnnouncement>& a, const std::pair<const uint256, BlockAnnouncement>& b) {
+                    return a.second.nTimeFirst < b.second.nTimeFirst;
+                }));
+        }
+        it = mapBlockAnnouncements.emplace(hash, BlockAnnouncement{nNow, {}}).first;
+    }
+    std::vector<NodeId>& vPeers = it->second.vPeers;
+    if (std::find(vPeers.begin(), vPeers.end(), nodeid) != vPeers.end())
+        return;
+    vPeers.push_back(nodeid);
+
+    const int64_t nLatency = std::min(nNow - it->second.nTimeFirst, BLOCK_ANNOUNCE_LATENCY_MAX);
+    state->nBlockAnnounceLatency = state->nBlockAnnounceLatency < 0 ? nLatency : (state->nBlockAnnounceLatency * 7 + nLatency) / 8;
+}
+// VELES END
+
 /** Update tracking information about which blocks a peer is assumed to have. */
 static void UpdateBlockAvailability(NodeId nodeid, const uint256 &hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
     CNodeState *state = State(nodeid);
     assert(state != nullptr);
 
+    UpdateBlockAnnounceLatency(state, nodeid, hash); // VELES
     ProcessBlockAvailability(nodeid);
 
     const CBlockIndex* pindex = LookupBlockIndex(hash);
@@ -455,12 +609,34 @@ static void UpdateBlockAvailability(NodeId nodeid, const uint256 &hash) EXCLUSIV
     }
 }
 
+// VELES BEGIN
+/**
+ * Rank of a peer as a high-bandwidth compact block peer, lower is better: its
+ * block announcement latency, the longest one while unknown, lowered for the
+ * masternodes verified to run at the peer's IP.
+ */
+static int64_t GetHighBandwidthPeerScore(NodeId nodeid) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    const CNodeState* state = State(nodeid);
+    if (!state)
+        return std::numeric_limits<int64_t>::max();
+    int64_t nScore = state->nBlockAnnounceLatency < 0 ? BLOCK_ANNOUNCE_LATENCY_MAX : state->nBlockAnnounceLatency;
+    if (mnodeman.HasVerifiedAtIP(state->address))
+        nScore -= HB_MASTERNODE_LATENCY_BONUS;
+    return nScore;
+}
+// VELES END
+
 /**
  * When a peer sends us a valid block, instruct it to announce blocks to us
  * using CMPCTBLOCK if possible by adding its nodeid to the end of
  * lNodesAnnouncingHeaderAndIDs, and keeping that list under a certain size by
  * removing the first element if necessary.
  */
+// VELES BEGIN
+// Once the list is full the peer replaces the one with the worst score, see
+// GetHighBandwidthPeerScore(), unless its own score is worse.
+// VELES END
 static void MaybeSetPeerAsAnnouncingHeaderAndIDs(NodeId nodeid, CConnman* connman) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     AssertLockHeld(cs_main);
@@ -477,18 +653,37 @@ static void MaybeSetPeerAsAnnouncingHeaderAndIDs(NodeId nodeid, CConnman* connma
                 return;
             }
         }
-        connman->ForNode(nodeid, [connman](CNode* pfrom){
+        // VELES BEGIN
+        // The oldest of the peers with the worst score is replaced
+        std::list<NodeId>::iterator itReplace = lNodesAnnouncingHeaderAndIDs.end();
+        if (lNodesAnnouncingHeaderAndIDs.size() >= 3) {
+            int64_t nWorstScore = std::numeric_limits<int64_t>::min();
+            for (auto it = lNodesAnnouncingHeaderAndIDs.begin(); it != lNodesAnnouncingHeaderAndIDs.end(); ++it) {
+                const int64_t nScore = GetHighBandwidthPeerScore(*it);
+                if (nScore > nWorstScore) {
+                    nWorstScore = nScore;
+                    itReplace = it;
+                }
+            }
+            if (GetHighBandwidthPeerScore(nodeid) > nWorstScore)
+                return;
+        }
+        // VELES END
+        //connman->ForNode(nodeid, [connman](CNode* pfrom){
+        connman->ForNode(nodeid, [connman, itReplace](CNode* pfrom){ // VELES
             AssertLockHeld(cs_main);
             uint64_t nCMPCTBLOCKVersion = (pfrom->GetLocalServices() & NODE_WITNESS) ? 2 : 1;
             if (lNodesAnnouncingHeaderAndIDs.size() >= 3) {
                 // As per BIP152, we only get 3 of our peers to announce
                 // blocks using compact encodings.
-                connman->ForNode(lNodesAnnouncingHeaderAndIDs.front(), [connman, nCMPCTBLOCKVersion](CNode* pnodeStop){
+                //connman->ForNode(lNodesAnnouncingHeaderAndIDs.front(), [connman, nCMPCTBLOCKVersion](CNode* pnodeStop){
+                connman->ForNode(*itReplace, [connman, nCMPCTBLOCKVersion](CNode* pnodeStop){ // VELES
                     AssertLockHeld(cs_main);
                     connman->PushMessage(pnodeStop, CNetMsgMaker(pnodeStop->GetSendVersion()).Make(NetMsgType::SENDCMPCT, /*fAnnounceUsingCMPCTBLOCK=*/false, nCMPCTBLOCKVersion));
                     return true;
                 });
-                lNodesAnnouncingHeaderAndIDs.pop_front();
+                //lNodesAnnouncingHeaderAndIDs.pop_front();
+                lNodesAnnouncingHeaderAndIDs.erase(itReplace); // VELES
             }
             connman->PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::SENDCMPCT, /*fAnnounceUsingCMPCTBLOCK=*/true, nCMPCTBLOCKVersion));
             lNodesAnnouncingHeaderAndIDs.push_back(pfrom->GetId());
@@ -556,7 +751,8 @@ static void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vec
     // Never fetch further than the best block we know the peer has, or more than BLOCK_DOWNLOAD_WINDOW + 1 beyond the last
     // linked block we have in common with this peer. The +1 is so we can detect stalling, namely if we would be able to
     // download that next block if the window were 1 larger.
-    int nWindowEnd = state->pindexLastCommonBlock->nHeight + BLOCK_DOWNLOAD_WINDOW;
+    //int nWindowEnd = state->pindexLastCommonBlock->nHeight + BLOCK_DOWNLOAD_WINDOW;
+    int nWindowEnd = state->pindexLastCommonBlock->nHeight + GetBlockDownloadWindow(); // VELES
     int nMaxHeight = std::min<int>(state->pindexBestKnownBlock->nHeight, nWindowEnd + 1);
     NodeId waitingfor = -1;
     while (pindexWalk->nHeight < nMaxHeight) {
@@ -659,6 +855,12 @@ void PeerLogicValidation::FinalizeNode(NodeId nodeid, bool& fUpdateConnectionTim
     nPreferredDownload -= state->fPreferredDownload;
     nPeersWithValidatedDownloads -= (state->nBlocksInFlightValidHeaders != 0);
     assert(nPeersWithValidatedDownloads >= 0);
+    // VELES BEGIN
+    if (state->nBlocksInFlight > 0) {
+        nBlocksInFlightCapacity -= state->nBlocksInFlightLimit;
+    }
+    assert(nBlocksInFlightCapacity >= 0);
+    // VELES END
     g_outbound_peers_with_protect_from_disconnect -= state->m_chain_sync.m_protect;
     assert(g_outbound_peers_with_protect_from_disconnect >= 0);
 
@@ -669,6 +871,7 @@ void PeerLogicValidation::FinalizeNode(NodeId nodeid, bool& fUpdateConnectionTim
         assert(mapBlocksInFlight.empty());
         assert(nPreferredDownload == 0);
         assert(nPeersWithValidatedDownloads == 0);
+        assert(nBlocksInFlightCapacity == 0); // VELES
         assert(g_outbound_peers_with_protect_from_disconnect == 0);
     }
     LogPrint(BCLog::NET, "Cleared nodestate for peer=%d\n", nodeid);
@@ -682,6 +885,12 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
     stats.nMisbehavior = state->nMisbehavior;
     stats.nSyncHeight = state->pindexBestKnownBlock ? state->pindexBestKnownBlock->nHeight : -1;
     stats.nCommonHeight = state->pindexLastCommonBlock ? state->pindexLastCommonBlock->nHeight : -1;
+    // VELES BEGIN
+    stats.nBlocksInFlightLimit = state->nBlocksInFlightLimit;
+    stats.nBlockDeliveryTime = state->nBlockDeliveryTime;
+    stats.nBlockAnnounceLatency = state->nBlockAnnounceLatency;
+    stats.fHighBandwidthCmpct = std::find(lNodesAnnouncingHeaderAndIDs.begin(), lNodesAnnouncingHeaderAndIDs.end(), nodeid) != lNodesAnnouncingHeaderAndIDs.end();
+    // VELES END
     for (const QueuedBlock& queue : state->vBlocksInFlight) {
         if (queue.pindex)
             stats.vHeightInFlight.push_back(queue.pindex->nHeight);
@@ -927,6 +1136,55 @@ static std::shared_ptr<const CBlockHeaderAndShortTxIDs> most_recent_compact_bloc
 static uint256 most_recent_block_hash GUARDED_BY(cs_most_recent_block);
 static bool fWitnessesPresentInMostRecentCompactBlock GUARDED_BY(cs_most_recent_block);
 
+// VELES BEGIN
+/** Number of blocks whose bloom filter elements are cached for the filtered peers */
+static const size_t MAX_BLOOM_ELEMENTS_BLOCKS = 144;
+/** Memory the cached bloom filter elements may use */
+static const size_t MAX_BLOOM_ELEMENTS_USAGE = 32 << 20;
+
+// The bloom filter elements of the blocks last requested by filtered peers, most
+// recently requested first, are protected by cs_bloom_elements
+static CCriticalSection cs_bloom_elements;
+static std::list<std::pair<uint256, std::shared_ptr<const CBlockBloomElements>>> bloom_elements_cache GUARDED_BY(cs_bloom_elements);
+static size_t bloom_elements_usage GUARDED_BY(cs_bloom_elements) = 0;
+
+static std::shared_ptr<const CBlockBloomElements> FindBloomElements(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_bloom_elements)
+{
+    for (auto it = bloom_elements_cache.begin(); it != bloom_elements_cache.end(); ++it) {
+        if (it->first == hash) {
+            bloom_elements_cache.splice(bloom_elements_cache.begin(), bloom_elements_cache, it);
+            return it->second;
+        }
+    }
+    return nullptr;
+}
+
+static std::shared_ptr<const CBlockBloomElements> GetCachedBloomElements(const uint256& hash) LOCKS_EXCLUDED(cs_bloom_elements)
+{
+    LOCK(cs_bloom_elements);
+    return FindBloomElements(hash);
+}
+
+static std::shared_ptr<const CBlockBloomElements> CacheBloomElements(const uint256& hash, const CBlock& block) LOCKS_EXCLUDED(cs_bloom_elements)
+{
+    std::shared_ptr<const CBlockBloomElements> elements = std::make_shared<const CBlockBloomElements>(block);
+
+    LOCK(cs_bloom_elements);
+    // Another peer may have requested the block meanwhile
+    std::shared_ptr<const CBlockBloomElements> cached = FindBloomElements(hash);
+    if (cached)
+        return cached;
+    bloom_elements_cache.emplace_front(hash, elements);
+    bloom_elements_usage += elements->nUsage;
+    while (bloom_elements_cache.size() > MAX_BLOOM_ELEMENTS_BLOCKS ||
+           (bloom_elements_cache.size() > 1 && bloom_elements_usage > MAX_BLOOM_ELEMENTS_USAGE)) {
+        bloom_elements_usage -= bloom_elements_cache.back().second->nUsage;
+        bloom_elements_cache.pop_back();
+    }
+    return elements;
+}
+// VELES END
+
 /**
  * Maintain state about the best-seen block and fast-announce a compact block
  * to compatible peers.
@@ -1105,7 +1363,13 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
         return mapSporks.count(inv.hash);
 
     case MSG_MASTERNODE_PAYMENT_VOTE:
-        return mnpayments.mapMasternodePaymentVotes.count(inv.hash);
+        // return mnpayments.mapMasternodePaymentVotes.count(inv.hash);
+        // VELES BEGIN
+        {
+            LOCK(cs_mapMasternodePaymentVotes);
+            return mnpayments.mapMasternodePaymentVotes.Has(inv.hash);
+        }
+        // VELES END
 
     case MSG_MASTERNODE_PAYMENT_BLOCK:
         {
@@ -1120,7 +1384,8 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
         return mnodeman.mapSeenMasternodePing.count(inv.hash);
 
     case MSG_DSTX: {
-        return static_cast<bool>(CPrivateSend::GetDSTX(inv.hash));
+        //return static_cast<bool>(CPrivateSend::GetDSTX(inv.hash));
+        return CPrivateSend::HasDSTX(inv.hash); // VELES
     }
 
     case MSG_GOVERNANCE_OBJECT:
@@ -1252,6 +1517,14 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
     if (send && (pindex->nStatus & BLOCK_HAVE_DATA))
     {
         std::shared_ptr<const CBlock> pblock;
+        // VELES BEGIN
+        // Filtered blocks are built from the bloom filter elements of the block,
+        // cached for all the filtered peers, and the block is only read from disk
+        // when some of its transactions matched
+        std::shared_ptr<const CBlockBloomElements> bloom_elements;
+        if (inv.type == MSG_FILTERED_BLOCK)
+            bloom_elements = GetCachedBloomElements(pindex->GetBlockHash());
+        // VELES END
         if (a_recent_block && a_recent_block->GetHash() == pindex->GetBlockHash()) {
             pblock = a_recent_block;
         } else if (inv.type == MSG_WITNESS_BLOCK) {
@@ -1263,6 +1536,10 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
             }
             connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, MakeSpan(block_data)));
             // Don't set pblock as we've sent the block
+        // VELES BEGIN
+        } else if (bloom_elements) {
+            // Don't set pblock, the merkle block is built from the cached elements
+        // VELES END
         } else {
             // Send block from disk
             std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
@@ -1270,20 +1547,26 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
                 assert(!"cannot load block from disk");
             pblock = pblockRead;
         }
-        if (pblock) {
+        //if (pblock) {
+        if (pblock || bloom_elements) { // VELES
             if (inv.type == MSG_BLOCK)
                 connman->PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, *pblock));
             else if (inv.type == MSG_WITNESS_BLOCK)
                 connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, *pblock));
             else if (inv.type == MSG_FILTERED_BLOCK)
             {
+                // VELES BEGIN
+                if (!bloom_elements)
+                    bloom_elements = CacheBloomElements(pindex->GetBlockHash(), *pblock);
+                // VELES END
                 bool sendMerkleBlock = false;
                 CMerkleBlock merkleBlock;
                 {
                     LOCK(pfrom->cs_filter);
                     if (pfrom->pfilter) {
                         sendMerkleBlock = true;
-                        merkleBlock = CMerkleBlock(*pblock, *pfrom->pfilter);
+                        //merkleBlock = CMerkleBlock(*pblock, *pfrom->pfilter);
+                        merkleBlock = CMerkleBlock(*bloom_elements, *pfrom->pfilter); // VELES
                     }
                 }
                 if (sendMerkleBlock) {
@@ -1294,6 +1577,14 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
                     // they must either disconnect and retry or request the full block.
                     // Thus, the protocol spec specified allows for us to provide duplicate txn here,
                     // however we MUST always provide at least what the remote peer needs
+                    // VELES BEGIN
+                    if (!pblock && !merkleBlock.vMatchedTxn.empty()) {
+                        std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+                        if (!ReadBlockFromDisk(*pblockRead, pindex, consensusParams))
+                            assert(!"cannot load block from disk");
+                        pblock = pblockRead;
+                    }
+                    // VELES END
                     typedef std::pair<unsigned int, uint256> PairType;
                     for (PairType& pair : merkleBlock.vMatchedTxn)
                         connman->PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::TX, *pblock->vtx[pair.first]));
@@ -1336,6 +1627,53 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
     }
 }
 
+// VELES BEGIN
+/**
+ * Masternode pings or payment votes answering a getdata, collected for one
+ * "mnpingbundle" or "mnwbundle" message. The objects are appended already
+ * serialized, the relayed ones straight from the relay memory.
+ */
+class CMnBundle
+{
+private:
+    const char* command;
+    unsigned int nCount;
+    CDataStream body;
+
+public:
+    explicit CMnBundle(const char* commandIn) : command(commandIn), nCount(0), body(SER_NETWORK, PROTOCOL_VERSION) {}
+
+    template <typename T>
+    void Add(const T& obj)
+    {
+        body << obj;
+        nCount++;
+    }
+
+    void AddSerialized(const CDataStream& ss)
+    {
+        body += ss;
+        nCount++;
+    }
+
+    bool IsFull() const { return nCount >= MNBUNDLE_MAX_ENTRIES; }
+
+    void Push(CNode* pto, CConnman* connman)
+    {
+        if (nCount == 0) return;
+        CSerializedNetMsg msg;
+        msg.command = command;
+        msg.data.reserve(GetSizeOfCompactSize(nCount) + body.size());
+        CVectorWriter writer(SER_NETWORK, PROTOCOL_VERSION, msg.data, 0);
+        WriteCompactSize(writer, nCount);
+        msg.data.insert(msg.data.end(), body.begin(), body.end());
+        connman->PushMessage(pto, std::move(msg));
+        body.clear();
+        nCount = 0;
+    }
+};
+// VELES END
+
 void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnman* connman, const std::atomic<bool>& interruptMsgProc) LOCKS_EXCLUDED(cs_main)
 {
     AssertLockNotHeld(cs_main);
@@ -1343,8 +1681,13 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
     std::deque<CInv>::iterator it = pfrom->vRecvGetData.begin();
     std::vector<CInv> vNotFound;
     const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    // VELES BEGIN
+    CMnBundle bundleMnp(NetMsgType::MNPINGBUNDLE);
+    CMnBundle bundleVotes(NetMsgType::MNPAYMENTVOTEBUNDLE);
+    // VELES END
     {
         LOCK(cs_main);
+        const bool fMnBundles = State(pfrom->GetId())->fWantsMnBundles; // VELES
 
         // FXTC BEGIN
         //while (it != pfrom->vRecvGetData.end() && (it->type == MSG_TX || it->type == MSG_WITNESS_TX))
@@ -1401,25 +1744,53 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
             {
                 // Send stream from relay memory
                 bool pushed = false;
+                //{
+                //    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                //    {
+                //        LOCK(cs_mapRelayDash);
+                //        map<CInv, CDataStream>::iterator mi = mapRelayDash.find(inv);
+                //        if (mi != mapRelayDash.end()) {
+                //            ss += (*mi).second;
+                //            pushed = true;
+                //        }
+                //    }
+                //    if(pushed)
+                //        connman->PushMessage(pfrom, msgMaker.Make(inv.GetCommand(), ss));
+                //}
+                // VELES BEGIN
                 {
-                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                    // Copy the cached payload straight into the outgoing message,
+                    // skipping the intermediate stream and re-serialization
+                    CSerializedNetMsg msg;
+                    bool fBundled = false;
                     {
                         LOCK(cs_mapRelayDash);
                         map<CInv, CDataStream>::iterator mi = mapRelayDash.find(inv);
                         if (mi != mapRelayDash.end()) {
-                            ss += (*mi).second;
+                            if (fMnBundles && inv.type == MSG_MASTERNODE_PING) {
+                                bundleMnp.AddSerialized(mi->second);
+                                fBundled = true;
+                            } else {
+                                msg.data.assign(mi->second.begin(), mi->second.end());
+                            }
                             pushed = true;
                         }
                     }
-                    if(pushed)
-                        connman->PushMessage(pfrom, msgMaker.Make(inv.GetCommand(), ss));
+                    if(fBundled) {
+                        if (bundleMnp.IsFull())
+                            bundleMnp.Push(pfrom, connman);
+                    } else if(pushed) {
+                        msg.command = inv.GetCommand();
+                        connman->PushMessage(pfrom, std::move(msg));
+                    }
                 }
+                // VELES END
                 // FXTC TODO: check if there are MSG_TX messages in Dash processing before removing this code
                 /*
                 if (!pushed && inv.type == MSG_TX) {
                     CTransaction tx;
                     if (mempool.lookup(inv.hash, tx)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                        CScratchDataStream ss(SER_NETWORK, PROTOCOL_VERSION); // VELES
                         ss.reserve(1000);
                         ss << tx;
                         connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::TX, ss));
@@ -1430,7 +1801,7 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
                 if (!pushed && inv.type == MSG_TXLOCK_REQUEST) {
                     CTxLockRequest txLockRequest;
                     if(instantsend.GetTxLockRequest(inv.hash, txLockRequest)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                        CScratchDataStream ss(SER_NETWORK, PROTOCOL_VERSION); // VELES
                         ss.reserve(1000);
                         ss << txLockRequest;
                         connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::TXLOCKREQUEST, ss));
@@ -1441,7 +1812,7 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
                 if (!pushed && inv.type == MSG_TXLOCK_VOTE) {
                     CTxLockVote vote;
                     if(instantsend.GetTxLockVote(inv.hash, vote)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                        CScratchDataStream ss(SER_NETWORK, PROTOCOL_VERSION); // VELES
                         ss.reserve(1000);
                         ss << vote;
                         connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::TXLOCKVOTE, ss));
@@ -1451,7 +1822,7 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
 
                 if (!pushed && inv.type == MSG_SPORK) {
                     if(mapSporks.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                        CScratchDataStream ss(SER_NETWORK, PROTOCOL_VERSION); // VELES
                         ss.reserve(1000);
                         ss << mapSporks[inv.hash];
                         connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SPORK, ss));
@@ -1460,11 +1831,22 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
                 }
 
                 if (!pushed && inv.type == MSG_MASTERNODE_PAYMENT_VOTE) {
-                    if(mnpayments.HasVerifiedPaymentVote(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                    // if(mnpayments.HasVerifiedPaymentVote(inv.hash)) {
+                    CMasternodePaymentVote vote; // VELES
+                    if(mnpayments.GetVerifiedPaymentVote(inv.hash, vote)) { // VELES
+                        // VELES BEGIN
+                        if (fMnBundles) {
+                            bundleVotes.Add(vote);
+                            if (bundleVotes.IsFull())
+                                bundleVotes.Push(pfrom, connman);
+                        } else {
+                        // VELES END
+                        CScratchDataStream ss(SER_NETWORK, PROTOCOL_VERSION); // VELES
                         ss.reserve(1000);
-                        ss << mnpayments.mapMasternodePaymentVotes[inv.hash];
+                        // ss << mnpayments.mapMasternodePaymentVotes[inv.hash];
+                        ss << vote; // VELES
                         connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MASTERNODEPAYMENTVOTE, ss));
+                        } // VELES
                         pushed = true;
                     }
                 }
@@ -1476,10 +1858,21 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
                         for (CMasternodePayee& payee : mnpayments.mapMasternodeBlocks[mi->second->nHeight].vecPayees) {
                             std::vector<uint256> vecVoteHashes = payee.GetVoteHashes();
                             for (uint256& hash : vecVoteHashes) {
-                                if(mnpayments.HasVerifiedPaymentVote(hash)) {
-                                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                                // if(mnpayments.HasVerifiedPaymentVote(hash)) {
+                                CMasternodePaymentVote vote; // VELES
+                                if(mnpayments.GetVerifiedPaymentVote(hash, vote)) { // VELES
+                                    // VELES BEGIN
+                                    if (fMnBundles) {
+                                        bundleVotes.Add(vote);
+                                        if (bundleVotes.IsFull())
+                                            bundleVotes.Push(pfrom, connman);
+                                        continue;
+                                    }
+                                    // VELES END
+                                    CScratchDataStream ss(SER_NETWORK, PROTOCOL_VERSION); // VELES
                                     ss.reserve(1000);
-                                    ss << mnpayments.mapMasternodePaymentVotes[hash];
+                                    // ss << mnpayments.mapMasternodePaymentVotes[hash];
+                                    ss << vote; // VELES
                                     connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MASTERNODEPAYMENTVOTE, ss));
                                 }
                             }
@@ -1490,7 +1883,7 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
 
                 if (!pushed && inv.type == MSG_MASTERNODE_ANNOUNCE) {
                     if(mnodeman.mapSeenMasternodeBroadcast.count(inv.hash)){
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                        CScratchDataStream ss(SER_NETWORK, PROTOCOL_VERSION); // VELES
                         ss.reserve(1000);
                         ss << mnodeman.mapSeenMasternodeBroadcast[inv.hash].second;
                         connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MNANNOUNCE, ss));
@@ -1500,10 +1893,18 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
 
                 if (!pushed && inv.type == MSG_MASTERNODE_PING) {
                     if(mnodeman.mapSeenMasternodePing.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                        // VELES BEGIN
+                        if (fMnBundles) {
+                            bundleMnp.Add(mnodeman.mapSeenMasternodePing[inv.hash]);
+                            if (bundleMnp.IsFull())
+                                bundleMnp.Push(pfrom, connman);
+                        } else {
+                        // VELES END
+                        CScratchDataStream ss(SER_NETWORK, PROTOCOL_VERSION); // VELES
                         ss.reserve(1000);
                         ss << mnodeman.mapSeenMasternodePing[inv.hash];
                         connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MNPING, ss));
+                        } // VELES
                         pushed = true;
                     }
                 }
@@ -1511,7 +1912,7 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
                 if (!pushed && inv.type == MSG_DSTX) {
                     CDarksendBroadcastTx dstx = CPrivateSend::GetDSTX(inv.hash);
                     if(dstx) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                        CScratchDataStream ss(SER_NETWORK, PROTOCOL_VERSION); // VELES
                         ss.reserve(1000);
                         ss << dstx;
                         connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::DSTX, ss));
@@ -1521,7 +1922,7 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
 
                 if (!pushed && inv.type == MSG_GOVERNANCE_OBJECT) {
                     LogPrint(BCLog::NET, "ProcessGetData -- MSG_GOVERNANCE_OBJECT: inv = %s\n", inv.ToString());
-                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                    CScratchDataStream ss(SER_NETWORK, PROTOCOL_VERSION); // VELES
                     bool topush = false;
                     {
                         if(governance.HaveObjectForHash(inv.hash)) {
@@ -1539,7 +1940,7 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
                 }
 
                 if (!pushed && inv.type == MSG_GOVERNANCE_OBJECT_VOTE) {
-                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                    CScratchDataStream ss(SER_NETWORK, PROTOCOL_VERSION); // VELES
                     bool topush = false;
                     {
                         if(governance.HaveVoteForHash(inv.hash)) {
@@ -1558,7 +1959,7 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
 
                 if (!pushed && inv.type == MSG_MASTERNODE_VERIFY) {
                     if(mnodeman.mapSeenMasternodeVerification.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                        CScratchDataStream ss(SER_NETWORK, PROTOCOL_VERSION); // VELES
                         ss.reserve(1000);
                         ss << mnodeman.mapSeenMasternodeVerification[inv.hash];
                         connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MNVERIFY, ss));
@@ -1584,6 +1985,11 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
 
     pfrom->vRecvGetData.erase(pfrom->vRecvGetData.begin(), it);
 
+    // VELES BEGIN
+    bundleMnp.Push(pfrom, connman);
+    bundleVotes.Push(pfrom, connman);
+    // VELES END
+
     if (!vNotFound.empty()) {
         // Let the peer know that we didn't find what it asked for, so it doesn't
         // have to wait around forever. Currently only SPV clients actually care
@@ -1620,6 +2026,22 @@ inline void static SendBlockTransactions(const CBlock& block, const BlockTransac
     connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::BLOCKTXN, resp));
 }
 
+// VELES BEGIN
+/** Sends headers in the form the peer asked for */
+static void PushHeadersMessage(CNode* pto, CConnman* connman, const CNetMsgMaker& msgMaker, const CNodeState& state, const std::vector<CBlock>& vHeaders)
+{
+    if (!state.fPreferCompressedHeaders) {
+        connman->PushMessage(pto, msgMaker.Make(NetMsgType::HEADERS, vHeaders));
+        return;
+    }
+    CompressedHeaders compressed;
+    compressed.headers.reserve(vHeaders.size());
+    for (const CBlock& block : vHeaders)
+        compressed.headers.push_back(block.GetBlockHeader());
+    connman->PushMessage(pto, msgMaker.Make(NetMsgType::CMPHEADERS, compressed));
+}
+// VELES END
+
 bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::vector<CBlockHeader>& headers, const CChainParams& chainparams, bool punish_duplicate_invalid)
 {
     const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
@@ -1841,6 +2263,27 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
     return true;
 }
 
+// VELES BEGIN
+/** Queue the orphans spending outputs of tx, which was just accepted to the mempool. Their scripts
+ *  are verified together on the script check threads, ahead of processing them one by one. */
+static void QueueOrphansOf(const CTransaction& tx, std::set<uint256>& orphan_work_set) EXCLUSIVE_LOCKS_REQUIRED(cs_main, g_cs_orphans)
+{
+    std::vector<CTransactionRef> vOrphans;
+    for (unsigned int i = 0; i < tx.vout.size(); i++) {
+        auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(tx.GetHash(), i));
+        if (it_by_prev != mapOrphanTransactionsByPrev.end()) {
+            for (const auto& elem : it_by_prev->second) {
+                if (orphan_work_set.insert(elem->first).second)
+                    vOrphans.push_back(elem->second.tx);
+            }
+        }
+    }
+    // A single orphan gains nothing over its own verification
+    if (vOrphans.size() > 1)
+        PreVerifyMempoolScripts(mempool, vOrphans);
+}
+// VELES END
+
 void static ProcessOrphanTx(CConnman* connman, std::set<uint256>& orphan_work_set, std::list<CTransactionRef>& removed_txn) EXCLUSIVE_LOCKS_REQUIRED(cs_main, g_cs_orphans)
 {
     AssertLockHeld(cs_main);
@@ -1867,14 +2310,17 @@ void static ProcessOrphanTx(CConnman* connman, std::set<uint256>& orphan_work_se
         if (AcceptToMemoryPool(mempool, stateDummy, porphanTx, &fMissingInputs2, &removed_txn, false /* bypass_limits */, 0 /* nAbsurdFee */)) {
             LogPrint(BCLog::MEMPOOL, "   accepted orphan tx %s\n", orphanHash.ToString());
             RelayTransaction(orphanTx, connman);
-            for (unsigned int i = 0; i < orphanTx.vout.size(); i++) {
-                auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(orphanHash, i));
-                if (it_by_prev != mapOrphanTransactionsByPrev.end()) {
-                    for (const auto& elem : it_by_prev->second) {
-                        orphan_work_set.insert(elem->first);
-                    }
-                }
-            }
+            // VELES BEGIN
+            //for (unsigned int i = 0; i < orphanTx.vout.size(); i++) {
+            //    auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(orphanHash, i));
+            //    if (it_by_prev != mapOrphanTransactionsByPrev.end()) {
+            //        for (const auto& elem : it_by_prev->second) {
+            //            orphan_work_set.insert(elem->first);
+            //        }
+            //    }
+            //}
+            QueueOrphansOf(orphanTx, orphan_work_set);
+            // VELES END
             EraseOrphanTx(orphanHash);
             done = true;
         } else if (!fMissingInputs2) {
@@ -1902,6 +2348,473 @@ void static ProcessOrphanTx(CConnman* connman, std::set<uint256>& orphan_work_se
     }
 }
 
+// VELES BEGIN
+namespace {
+/** Processing times per message command and per subsystem handler */
+class CMessageProcessingTimes
+{
+private:
+    Mutex cs;
+    std::map<std::string, MessageProcessingStats> mapCommands GUARDED_BY(cs);
+    std::map<std::string, MessageProcessingStats> mapHandlers GUARDED_BY(cs);
+
+    static void Add(MessageProcessingStats& stats, int64_t nMicros)
+    {
+        stats.nCount++;
+        stats.nTotalMicros += nMicros;
+        stats.nMaxMicros = std::max(stats.nMaxMicros, nMicros);
+    }
+
+public:
+    void RecordCommand(const std::string& strCommand, int64_t nMicros)
+    {
+        // Unknown commands share one entry so peers can't grow the map
+        static const std::set<std::string> setKnownCommands = [] {
+            const std::vector<std::string>& vCommands = getAllNetMessageTypes();
+            return std::set<std::string>(vCommands.begin(), vCommands.end());
+        }();
+        const std::string& strKey = setKnownCommands.count(strCommand) ? strCommand : NET_MESSAGE_COMMAND_OTHER;
+        LOCK(cs);
+        Add(mapCommands[strKey], nMicros);
+    }
+
+    void RecordHandler(const char* pszHandler, int64_t nMicros)
+    {
+        LOCK(cs);
+        Add(mapHandlers[pszHandler], nMicros);
+    }
+
+    void Get(std::map<std::string, MessageProcessingStats>& mapCommandsOut, std::map<std::string, MessageProcessingStats>& mapHandlersOut)
+    {
+        LOCK(cs);
+        mapCommandsOut = mapCommands;
+        mapHandlersOut = mapHandlers;
+    }
+};
+
+CMessageProcessingTimes g_message_processing_times;
+
+/** Run one subsystem handler and account the time spent in it */
+template <typename Callable>
+void TimeMessageHandler(const char* pszHandler, Callable&& handler)
+{
+    const int64_t nTimeStart = GetTimeMicros();
+    handler();
+    g_message_processing_times.RecordHandler(pszHandler, GetTimeMicros() - nTimeStart);
+}
+
+/** Dash subsystems whose messages are handled on a thread of their own */
+enum DashMessageQueueType {
+    DASH_QUEUE_MASTERNODE,
+    DASH_QUEUE_GOVERNANCE,
+    DASH_QUEUE_INSTANTSEND,
+    DASH_QUEUE_PRIVATESEND,
+    DASH_QUEUE_COUNT,
+    DASH_QUEUE_NONE = DASH_QUEUE_COUNT
+};
+
+DashMessageQueueType GetDashMessageQueueType(const std::string& strCommand)
+{
+    // The sporks stay on the message handler thread, every subsystem reads them
+    static const std::map<std::string, DashMessageQueueType> mapQueueTypes = {
+        {NetMsgType::MNANNOUNCE, DASH_QUEUE_MASTERNODE},
+        {NetMsgType::MNPING, DASH_QUEUE_MASTERNODE},
+        {NetMsgType::MNPINGBUNDLE, DASH_QUEUE_MASTERNODE},
+        {NetMsgType::DSEG, DASH_QUEUE_MASTERNODE},
+        {NetMsgType::GETMNLISTDIFF, DASH_QUEUE_MASTERNODE},
+        {NetMsgType::MNLISTDIFF, DASH_QUEUE_MASTERNODE},
+        {NetMsgType::MNVERIFY, DASH_QUEUE_MASTERNODE},
+        {NetMsgType::MASTERNODEPAYMENTSYNC, DASH_QUEUE_MASTERNODE},
+        {NetMsgType::MASTERNODEPAYMENTVOTE, DASH_QUEUE_MASTERNODE},
+        {NetMsgType::MNPAYMENTVOTEBUNDLE, DASH_QUEUE_MASTERNODE},
+        {NetMsgType::SYNCSTATUSCOUNT, DASH_QUEUE_MASTERNODE},
+        {NetMsgType::MNGOVERNANCESYNC, DASH_QUEUE_GOVERNANCE},
+        {NetMsgType::MNGOVERNANCEOBJECT, DASH_QUEUE_GOVERNANCE},
+        {NetMsgType::MNGOVERNANCEOBJECTVOTE, DASH_QUEUE_GOVERNANCE},
+        {NetMsgType::TXLOCKVOTE, DASH_QUEUE_INSTANTSEND},
+        {NetMsgType::DSACCEPT, DASH_QUEUE_PRIVATESEND},
+        {NetMsgType::DSVIN, DASH_QUEUE_PRIVATESEND},
+        {NetMsgType::DSFINALTX, DASH_QUEUE_PRIVATESEND},
+        {NetMsgType::DSSIGNFINALTX, DASH_QUEUE_PRIVATESEND},
+        {NetMsgType::DSCOMPLETE, DASH_QUEUE_PRIVATESEND},
+        {NetMsgType::DSSTATUSUPDATE, DASH_QUEUE_PRIVATESEND},
+        {NetMsgType::DSQUEUE, DASH_QUEUE_PRIVATESEND},
+    };
+    auto it = mapQueueTypes.find(strCommand);
+    return it == mapQueueTypes.end() ? DASH_QUEUE_NONE : it->second;
+}
+
+void ProcessDashMessage(DashMessageQueueType type, CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman)
+{
+    const int64_t nTimeStart = GetTimeMicros();
+    switch (type) {
+    case DASH_QUEUE_MASTERNODE:
+        TimeMessageHandler("mnodeman", [&] { mnodeman.ProcessMessage(pfrom, strCommand, vRecv, connman); });
+        TimeMessageHandler("mnpayments", [&] { mnpayments.ProcessMessage(pfrom, strCommand, vRecv, connman); });
+        TimeMessageHandler("masternodeSync", [&] { masternodeSync.ProcessMessage(pfrom, strCommand, vRecv, connman); });
+        break;
+    case DASH_QUEUE_GOVERNANCE:
+        TimeMessageHandler("governance", [&] { governance.ProcessMessage(pfrom, strCommand, vRecv, connman); });
+        break;
+    case DASH_QUEUE_INSTANTSEND:
+        TimeMessageHandler("instantsend", [&] { instantsend.ProcessMessage(pfrom, strCommand, vRecv, connman); });
+        break;
+    case DASH_QUEUE_PRIVATESEND:
+#ifdef ENABLE_WALLET
+        TimeMessageHandler("privateSendClient", [&] { privateSendClient.ProcessMessage(pfrom, strCommand, vRecv, connman); });
+#endif // ENABLE_WALLET
+        TimeMessageHandler("privateSendServer", [&] { privateSendServer.ProcessMessage(pfrom, strCommand, vRecv, connman); });
+        break;
+    default:
+        break;
+    }
+    // queued messages are accounted here rather than on the message handler thread
+    g_message_processing_times.RecordCommand(strCommand, GetTimeMicros() - nTimeStart);
+}
+
+/**
+ * Messages of one Dash subsystem, handled in arrival order by a dedicated thread.
+ * A peer whose next message is for a full queue is not processed until the queue drained.
+ */
+class CDashMessageQueue
+{
+private:
+    struct Entry
+    {
+        CNode* pnode;
+        std::string strCommand;
+        CDataStream vRecv;
+        size_t nSize;
+    };
+
+    Mutex cs;
+    std::condition_variable cond;
+    std::deque<std::unique_ptr<Entry>> queue GUARDED_BY(cs);
+    bool fRunning GUARDED_BY(cs) = false;
+    //! Bytes of the queued messages
+    std::atomic<size_t> nQueueSize{0};
+    std::thread thread;
+
+    void Run(DashMessageQueueType type, CConnman* connman)
+    {
+        while (true) {
+            std::unique_ptr<Entry> entry;
+            {
+                WAIT_LOCK(cs, lock);
+                while (fRunning && queue.empty())
+                    cond.wait(lock);
+                if (!fRunning)
+                    break;
+                entry = std::move(queue.front());
+                queue.pop_front();
+            }
+            if (!entry->pnode->fDisconnect) {
+                try {
+                    ProcessDashMessage(type, entry->pnode, entry->strCommand, entry->vRecv, *connman);
+                } catch (const std::ios_base::failure& e) {
+                    LogPrint(BCLog::NET, "%s(%s, %u bytes): Exception '%s' caught\n", __func__, SanitizeString(entry->strCommand), entry->nSize, e.what());
+                } catch (const std::exception& e) {
+                    PrintExceptionContinue(&e, "ProcessDashMessage()");
+                } catch (...) {
+                    PrintExceptionContinue(nullptr, "ProcessDashMessage()");
+                }
+            }
+            entry->pnode->Release();
+            const bool fWasFull = IsFull();
+            nQueueSize -= entry->nSize;
+            // the peers waiting for this queue can go on
+            if (fWasFull && !IsFull())
+                connman->WakeMessageHandler();
+        }
+    }
+
+public:
+    void Start(DashMessageQueueType type, const char* name, CConnman& connman)
+    {
+        {
+            LOCK(cs);
+            fRunning = true;
+        }
+        thread = std::thread(&TraceThread<std::function<void()> >, name, std::function<void()>(std::bind(&CDashMessageQueue::Run, this, type, &connman)));
+    }
+
+    void Interrupt()
+    {
+        LOCK(cs);
+        fRunning = false;
+        cond.notify_all();
+    }
+
+    void Stop()
+    {
+        Interrupt();
+        if (thread.joinable())
+            thread.join();
+        LOCK(cs);
+        for (const auto& entry : queue)
+            entry->pnode->Release();
+        queue.clear();
+        nQueueSize = 0;
+    }
+
+    /** Take the message over, false when the queue does not run and the caller has to handle it */
+    bool Push(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv)
+    {
+        LOCK(cs);
+        if (!fRunning)
+            return false;
+        const size_t nSize = vRecv.size();
+        queue.emplace_back(new Entry{pfrom->AddRef(), strCommand, std::move(vRecv), nSize});
+        nQueueSize += nSize;
+        cond.notify_one();
+        return true;
+    }
+
+    bool IsFull() const { return nQueueSize >= MAX_DASH_MESSAGE_QUEUE_SIZE; }
+
+    bool IsRunning()
+    {
+        LOCK(cs);
+        return fRunning;
+    }
+};
+
+CDashMessageQueue g_dash_message_queues[DASH_QUEUE_COUNT];
+
+bool PushDashMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv)
+{
+    DashMessageQueueType type = GetDashMessageQueueType(strCommand);
+    if (type == DASH_QUEUE_NONE)
+        return false;
+    return g_dash_message_queues[type].Push(pfrom, strCommand, vRecv);
+}
+
+/** Whether the message will be handed to a queue thread instead of being handled in place */
+bool IsDashMessageQueued(const std::string& strCommand)
+{
+    DashMessageQueueType type = GetDashMessageQueueType(strCommand);
+    return type != DASH_QUEUE_NONE && g_dash_message_queues[type].IsRunning();
+}
+
+bool IsDashMessageQueueFull(const std::string& strCommand)
+{
+    bool fAnyFull = false;
+    for (const CDashMessageQueue& queue : g_dash_message_queues)
+        fAnyFull |= queue.IsFull();
+    if (!fAnyFull)
+        return false;
+    DashMessageQueueType type = GetDashMessageQueueType(strCommand);
+    return type != DASH_QUEUE_NONE && g_dash_message_queues[type].IsFull();
+}
+} // namespace
+
+void StartDashMessageQueues(CConnman& connman)
+{
+    g_dash_message_queues[DASH_QUEUE_MASTERNODE].Start(DASH_QUEUE_MASTERNODE, "mnmsg", connman);
+    g_dash_message_queues[DASH_QUEUE_GOVERNANCE].Start(DASH_QUEUE_GOVERNANCE, "govmsg", connman);
+    g_dash_message_queues[DASH_QUEUE_INSTANTSEND].Start(DASH_QUEUE_INSTANTSEND, "ixmsg", connman);
+    g_dash_message_queues[DASH_QUEUE_PRIVATESEND].Start(DASH_QUEUE_PRIVATESEND, "psmsg", connman);
+}
+
+void GetMessageProcessingStats(std::map<std::string, MessageProcessingStats>& mapCommands, std::map<std::string, MessageProcessingStats>& mapHandlers)
+{
+    g_message_processing_times.Get(mapCommands, mapHandlers);
+}
+
+void InterruptDashMessageQueues()
+{
+    for (CDashMessageQueue& queue : g_dash_message_queues)
+        queue.Interrupt();
+}
+
+void StopDashMessageQueues()
+{
+    for (CDashMessageQueue& queue : g_dash_message_queues)
+        queue.Stop();
+}
+// VELES END
+
+// VELES BEGIN
+/**
+ * Validates a getcfilters, getcfheaders or getcfcheckpt request. If it is
+ * invalid, the peer is disconnected.
+ *
+ * @param[out] stop_index   Set to the block index of the stop hash
+ * @param[out] filter_index Set to the filter index of the requested type
+ * @return                  True if the request can be served
+ */
+static bool PrepareBlockFilterRequest(CNode* pfrom, const CChainParams& chainparams,
+                                      BlockFilterType filter_type, uint32_t start_height,
+                                      const uint256& stop_hash, uint32_t max_height_diff,
+                                      const CBlockIndex*& stop_index,
+                                      BlockFilterIndex*& filter_index)
+{
+    const bool supported_filter_type =
+        (filter_type == BlockFilterType::BASIC &&
+         (pfrom->GetLocalServices() & NODE_COMPACT_FILTERS));
+    if (!supported_filter_type) {
+        LogPrint(BCLog::NET, "peer %d requested unsupported block filter type: %d\n",
+                 pfrom->GetId(), static_cast<uint8_t>(filter_type));
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    {
+        LOCK(cs_main);
+        stop_index = LookupBlockIndex(stop_hash);
+
+        // Check that the stop block exists and the peer would be allowed to fetch it.
+        if (!stop_index || !BlockRequestAllowed(stop_index, chainparams.GetConsensus())) {
+            LogPrint(BCLog::NET, "peer %d requested invalid block hash: %s\n",
+                     pfrom->GetId(), stop_hash.ToString());
+            pfrom->fDisconnect = true;
+            return false;
+        }
+    }
+
+    uint32_t stop_height = stop_index->nHeight;
+    if (start_height > stop_height) {
+        LogPrint(BCLog::NET, "peer %d sent invalid getcfilters/getcfheaders with "
+                 "start height %d and stop height %d\n",
+                 pfrom->GetId(), start_height, stop_height);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    if (stop_height - start_height >= max_height_diff) {
+        LogPrint(BCLog::NET, "peer %d requested too many cfilters/cfheaders: %d / %d\n",
+                 pfrom->GetId(), stop_height - start_height + 1, max_height_diff);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    filter_index = GetBlockFilterIndex(filter_type);
+    if (!filter_index) {
+        LogPrint(BCLog::NET, "Filter index for supported type %s not found\n", BlockFilterTypeName(filter_type));
+        return false;
+    }
+
+    return true;
+}
+
+/** Sends a cfilter message for every block of a getcfilters request */
+static void ProcessGetCFilters(CNode* pfrom, CDataStream& vRecv, const CChainParams& chainparams,
+                               CConnman* connman)
+{
+    uint8_t filter_type_ser;
+    uint32_t start_height;
+    uint256 stop_hash;
+
+    vRecv >> filter_type_ser >> start_height >> stop_hash;
+
+    const BlockFilterType filter_type = static_cast<BlockFilterType>(filter_type_ser);
+
+    const CBlockIndex* stop_index;
+    BlockFilterIndex* filter_index;
+    if (!PrepareBlockFilterRequest(pfrom, chainparams, filter_type, start_height, stop_hash,
+                                   MAX_GETCFILTERS_SIZE, stop_index, filter_index)) {
+        return;
+    }
+
+    std::vector<BlockFilter> filters;
+    if (!filter_index->LookupFilterRange(start_height, stop_index, filters)) {
+        LogPrint(BCLog::NET, "Failed to find block filter in index: filter_type=%s, start_height=%d, stop_hash=%s\n",
+                 BlockFilterTypeName(filter_type), start_height, stop_hash.ToString());
+        return;
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    for (const BlockFilter& filter : filters) {
+        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFILTER, filter));
+    }
+}
+
+/** Sends the cfheaders message answering a getcfheaders request */
+static void ProcessGetCFHeaders(CNode* pfrom, CDataStream& vRecv, const CChainParams& chainparams,
+                                CConnman* connman)
+{
+    uint8_t filter_type_ser;
+    uint32_t start_height;
+    uint256 stop_hash;
+
+    vRecv >> filter_type_ser >> start_height >> stop_hash;
+
+    const BlockFilterType filter_type = static_cast<BlockFilterType>(filter_type_ser);
+
+    const CBlockIndex* stop_index;
+    BlockFilterIndex* filter_index;
+    if (!PrepareBlockFilterRequest(pfrom, chainparams, filter_type, start_height, stop_hash,
+                                   MAX_GETCFHEADERS_SIZE, stop_index, filter_index)) {
+        return;
+    }
+
+    uint256 prev_header;
+    if (start_height > 0) {
+        const CBlockIndex* const prev_block =
+            stop_index->GetAncestor(static_cast<int>(start_height - 1));
+        if (!filter_index->LookupFilterHeader(prev_block, prev_header)) {
+            LogPrint(BCLog::NET, "Failed to find block filter header in index: filter_type=%s, block_hash=%s\n",
+                     BlockFilterTypeName(filter_type), prev_block->GetBlockHash().ToString());
+            return;
+        }
+    }
+
+    std::vector<uint256> filter_hashes;
+    if (!filter_index->LookupFilterHashRange(start_height, stop_index, filter_hashes)) {
+        LogPrint(BCLog::NET, "Failed to find block filter hashes in index: filter_type=%s, start_height=%d, stop_hash=%s\n",
+                 BlockFilterTypeName(filter_type), start_height, stop_hash.ToString());
+        return;
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFHEADERS,
+                                              filter_type_ser,
+                                              stop_index->GetBlockHash(),
+                                              prev_header,
+                                              filter_hashes));
+}
+
+/** Sends the cfcheckpt message answering a getcfcheckpt request */
+static void ProcessGetCFCheckPt(CNode* pfrom, CDataStream& vRecv, const CChainParams& chainparams,
+                                CConnman* connman)
+{
+    uint8_t filter_type_ser;
+    uint256 stop_hash;
+
+    vRecv >> filter_type_ser >> stop_hash;
+
+    const BlockFilterType filter_type = static_cast<BlockFilterType>(filter_type_ser);
+
+    const CBlockIndex* stop_index;
+    BlockFilterIndex* filter_index;
+    if (!PrepareBlockFilterRequest(pfrom, chainparams, filter_type, /*start_height=*/0, stop_hash,
+                                   /*max_height_diff=*/std::numeric_limits<uint32_t>::max(),
+                                   stop_index, filter_index)) {
+        return;
+    }
+
+    std::vector<uint256> headers(stop_index->nHeight / CFCHECKPT_INTERVAL);
+
+    // Populate headers.
+    const CBlockIndex* block_index = stop_index;
+    for (int i = headers.size() - 1; i >= 0; i--) {
+        int height = (i + 1) * CFCHECKPT_INTERVAL;
+        block_index = block_index->GetAncestor(height);
+
+        if (!filter_index->LookupFilterHeader(block_index, headers[i])) {
+            LogPrint(BCLog::NET, "Failed to find block filter header in index: filter_type=%s, block_hash=%s\n",
+                     BlockFilterTypeName(filter_type), block_index->GetBlockHash().ToString());
+            return;
+        }
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFCHECKPT,
+                                              filter_type_ser,
+                                              stop_index->GetBlockHash(),
+                                              headers));
+}
+// VELES END
+
 bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman* connman, const std::atomic<bool>& interruptMsgProc, bool enable_bip61)
 {
     LogPrint(BCLog::NET, "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->GetId());
@@ -2163,6 +3076,16 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             // nodes)
             connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDHEADERS));
         }
+        // VELES BEGIN
+        if (pfrom->nVersion >= CMPHEADERS_VERSION) {
+            // And that we would rather receive them compressed
+            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDCMPHEADERS));
+        }
+        if (pfrom->nVersion >= MNBUNDLE_VERSION) {
+            // Ask for the pings and payment votes in bundles too
+            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SENDMNBUNDLE));
+        }
+        // VELES END
         if (pfrom->nVersion >= SHORT_IDS_BLOCKS_VERSION) {
             // Tell our peer we are willing to provide version 1 or 2 cmpctblocks
             // However, we do not request new block announcements using
@@ -2244,6 +3167,20 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         return true;
     }
 
+    // VELES BEGIN
+    if (strCommand == NetMsgType::SENDCMPHEADERS) {
+        LOCK(cs_main);
+        State(pfrom->GetId())->fPreferCompressedHeaders = true;
+        return true;
+    }
+
+    if (strCommand == NetMsgType::SENDMNBUNDLE) {
+        LOCK(cs_main);
+        State(pfrom->GetId())->fWantsMnBundles = true;
+        return true;
+    }
+    // VELES END
+
     if (strCommand == NetMsgType::SENDCMPCT) {
         bool fAnnounceUsingCMPCTBLOCK = false;
         uint64_t nCMPCTBLOCKVersion = 0;
@@ -2529,7 +3466,8 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         // will re-announce the new block via headers (or compact blocks again)
         // in the SendMessages logic.
         nodestate->pindexBestHeaderSent = pindex ? pindex : chainActive.Tip();
-        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::HEADERS, vHeaders));
+        //connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::HEADERS, vHeaders));
+        PushHeadersMessage(pfrom, connman, msgMaker, *nodestate, vHeaders); // VELES
         return true;
     }
 
@@ -2583,8 +3521,12 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         bool fMissingInputs = false;
         CValidationState state;
 
-        pfrom->setAskFor.erase(inv.hash);
-        mapAlreadyAskedFor.erase(inv.hash);
+        //pfrom->setAskFor.erase(inv.hash);
+        //mapAlreadyAskedFor.erase(inv.hash);
+        // VELES BEGIN
+        pfrom->RemoveAskFor(inv.hash);
+        g_inv_request_times.Erase(inv.hash);
+        // VELES END
         // Dash
         // Process custom logic, no matter if tx will be accepted to mempool later or not
         if (strCommand == NetMsgType::TXLOCKREQUEST) {
@@ -2594,7 +3536,8 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             }
         } else if (strCommand == NetMsgType::DSTX) {
             uint256 hashTx = tx.GetHash();
-            if(CPrivateSend::GetDSTX(hashTx)) {
+            //if(CPrivateSend::GetDSTX(hashTx)) {
+            if(CPrivateSend::HasDSTX(hashTx)) { // VELES
                 LogPrint(BCLog::PRIVATESEND, "DSTX -- Already have %s, skipping...\n", hashTx.ToString());
                 return true; // not an error
             }
@@ -2643,14 +3586,17 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             //
             mempool.check(pcoinsTip.get());
             RelayTransaction(tx, connman);
-            for (unsigned int i = 0; i < tx.vout.size(); i++) {
-                auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(inv.hash, i));
-                if (it_by_prev != mapOrphanTransactionsByPrev.end()) {
-                    for (const auto& elem : it_by_prev->second) {
-                        pfrom->orphan_work_set.insert(elem->first);
-                    }
-                }
-            }
+            // VELES BEGIN
+            //for (unsigned int i = 0; i < tx.vout.size(); i++) {
+            //    auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(inv.hash, i));
+            //    if (it_by_prev != mapOrphanTransactionsByPrev.end()) {
+            //        for (const auto& elem : it_by_prev->second) {
+            //            pfrom->orphan_work_set.insert(elem->first);
+            //        }
+            //    }
+            //}
+            QueueOrphansOf(tx, pfrom->orphan_work_set);
+            // VELES END
 
             pfrom->nLastTXTime = GetTime();
 
@@ -2830,6 +3776,12 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
         bool fBlockReconstructed = false;
 
+        // VELES BEGIN
+        // InstantSend locked transactions are very likely part of the block, try them first
+        std::vector<std::pair<uint256, CTransactionRef>> vLockedTxn;
+        instantsend.GetUnconfirmedLockedTxns(vLockedTxn);
+        // VELES END
+
         {
         LOCK2(cs_main, g_cs_orphans);
         // If AcceptBlockHeader returned true, it set pindex
@@ -2889,7 +3841,8 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 }
 
                 PartiallyDownloadedBlock& partialBlock = *(*queuedBlockIt)->partialBlock;
-                ReadStatus status = partialBlock.InitData(cmpctblock, vExtraTxnForCompact);
+                //ReadStatus status = partialBlock.InitData(cmpctblock, vExtraTxnForCompact);
+                ReadStatus status = partialBlock.InitData(cmpctblock, vExtraTxnForCompact, vLockedTxn); // VELES
                 if (status == READ_STATUS_INVALID) {
                     MarkBlockAsReceived(pindex->GetBlockHash()); // Reset in-flight state in case of whitelist
                     Misbehaving(pfrom->GetId(), 100, strprintf("Peer %d sent us invalid compact block\n", pfrom->GetId()));
@@ -2924,7 +3877,8 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 // Optimistically try to reconstruct anyway since we might be
                 // able to without any round trips.
                 PartiallyDownloadedBlock tempBlock(&mempool);
-                ReadStatus status = tempBlock.InitData(cmpctblock, vExtraTxnForCompact);
+                //ReadStatus status = tempBlock.InitData(cmpctblock, vExtraTxnForCompact);
+                ReadStatus status = tempBlock.InitData(cmpctblock, vExtraTxnForCompact, vLockedTxn); // VELES
                 if (status != READ_STATUS_OK) {
                     // TODO: don't ignore failures
                     return true;
@@ -3098,6 +4052,24 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         return ProcessHeadersMessage(pfrom, connman, headers, chainparams, should_punish);
     }
 
+    // VELES BEGIN
+    if (strCommand == NetMsgType::CMPHEADERS && !fImporting && !fReindex) // Ignore headers received while importing
+    {
+        // The decoded headers go through the same checks as those of a "headers" message,
+        // their PoW hashes are computed in parallel by ProcessNewBlockHeaders()
+        CompressedHeaders compressed;
+        vRecv >> compressed;
+        if (compressed.headers.size() > MAX_HEADERS_RESULTS) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 20, strprintf("cmpheaders message size = %u", compressed.headers.size()));
+            return false;
+        }
+
+        bool should_punish = !pfrom->fInbound && !pfrom->m_manual_connection;
+        return ProcessHeadersMessage(pfrom, connman, compressed.headers, chainparams, should_punish);
+    }
+    // VELES END
+
     if (strCommand == NetMsgType::BLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
     {
         std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
@@ -3109,6 +4081,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         const uint256 hash(pblock->GetHash());
         {
             LOCK(cs_main);
+            UpdateBlockDelivery(pfrom->GetId(), hash, pfrom->nPingUsecTime); // VELES
             // Also always process if we requested the block explicitly, as we may
             // need it even though it is not a candidate for a new best tip.
             forceProcessing |= MarkBlockAsReceived(hash);
@@ -3320,9 +4293,35 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         return true;
     }
 
+    // VELES BEGIN
+    if (strCommand == NetMsgType::GETCFILTERS) {
+        ProcessGetCFilters(pfrom, vRecv, chainparams, connman);
+        return true;
+    }
+
+    if (strCommand == NetMsgType::GETCFHEADERS) {
+        ProcessGetCFHeaders(pfrom, vRecv, chainparams, connman);
+        return true;
+    }
+
+    if (strCommand == NetMsgType::GETCFCHECKPT) {
+        ProcessGetCFCheckPt(pfrom, vRecv, chainparams, connman);
+        return true;
+    }
+    // VELES END
+
     if (strCommand == NetMsgType::NOTFOUND) {
         // We do not care about the NOTFOUND message, but logging an Unknown Command
         // message would be undesirable as we transmit it ourselves.
+        // VELES BEGIN
+        // Stop waiting for the items the peer doesn't have
+        std::vector<CInv> vInv;
+        vRecv >> vInv;
+        if (vInv.size() <= MAX_INV_SZ) {
+            for (const CInv& inv : vInv)
+                pfrom->RemoveAskFor(inv.hash);
+        }
+        // VELES END
         return true;
     }
     else
@@ -3339,17 +4338,33 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
         if (found)
         {
+            // VELES BEGIN
+            if (PushDashMessage(pfrom, strCommand, vRecv))
+                return true;
+            // VELES END
             //probably one the extensions
+//#ifdef ENABLE_WALLET
+            //privateSendClient.ProcessMessage(pfrom, strCommand, vRecv, *connman);
+//#endif // ENABLE_WALLET
+            //privateSendServer.ProcessMessage(pfrom, strCommand, vRecv, *connman);
+            //mnodeman.ProcessMessage(pfrom, strCommand, vRecv, *connman);
+            //mnpayments.ProcessMessage(pfrom, strCommand, vRecv, *connman);
+            //instantsend.ProcessMessage(pfrom, strCommand, vRecv, *connman);
+            //sporkManager.ProcessSpork(pfrom, strCommand, vRecv, *connman);
+            //masternodeSync.ProcessMessage(pfrom, strCommand, vRecv);
+            //governance.ProcessMessage(pfrom, strCommand, vRecv, *connman);
+            // VELES BEGIN
 #ifdef ENABLE_WALLET
-            privateSendClient.ProcessMessage(pfrom, strCommand, vRecv, *connman);
+            TimeMessageHandler("privateSendClient", [&] { privateSendClient.ProcessMessage(pfrom, strCommand, vRecv, *connman); });
 #endif // ENABLE_WALLET
-            privateSendServer.ProcessMessage(pfrom, strCommand, vRecv, *connman);
-            mnodeman.ProcessMessage(pfrom, strCommand, vRecv, *connman);
-            mnpayments.ProcessMessage(pfrom, strCommand, vRecv, *connman);
-            instantsend.ProcessMessage(pfrom, strCommand, vRecv, *connman);
-            sporkManager.ProcessSpork(pfrom, strCommand, vRecv, *connman);
-            masternodeSync.ProcessMessage(pfrom, strCommand, vRecv);
-            governance.ProcessMessage(pfrom, strCommand, vRecv, *connman);
+            TimeMessageHandler("privateSendServer", [&] { privateSendServer.ProcessMessage(pfrom, strCommand, vRecv, *connman); });
+            TimeMessageHandler("mnodeman", [&] { mnodeman.ProcessMessage(pfrom, strCommand, vRecv, *connman); });
+            TimeMessageHandler("mnpayments", [&] { mnpayments.ProcessMessage(pfrom, strCommand, vRecv, *connman); });
+            TimeMessageHandler("instantsend", [&] { instantsend.ProcessMessage(pfrom, strCommand, vRecv, *connman); });
+            TimeMessageHandler("sporkManager", [&] { sporkManager.ProcessSpork(pfrom, strCommand, vRecv, *connman); });
+            TimeMessageHandler("masternodeSync", [&] { masternodeSync.ProcessMessage(pfrom, strCommand, vRecv, *connman); });
+            TimeMessageHandler("governance", [&] { governance.ProcessMessage(pfrom, strCommand, vRecv, *connman); });
+            // VELES END
 
             return true;
         }
@@ -3438,6 +4453,11 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
         LOCK(pfrom->cs_vProcessMsg);
         if (pfrom->vProcessMsg.empty())
             return false;
+        // VELES BEGIN
+        // The next message is for a full Dash message queue, the peer waits until it drained
+        if (IsDashMessageQueueFull(pfrom->vProcessMsg.front().hdr.GetCommand()))
+            return false;
+        // VELES END
         // Just take one message
         msgs.splice(msgs.begin(), pfrom->vProcessMsg, pfrom->vProcessMsg.begin());
         pfrom->nProcessQueueSize -= msgs.front().vRecv.size() + CMessageHeader::HEADER_SIZE;
@@ -3480,6 +4500,10 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
 
     // Process message
     bool fRet = false;
+    // VELES BEGIN
+    const bool fQueued = IsDashMessageQueued(strCommand);
+    const int64_t nTimeStart = GetTimeMicros();
+    // VELES END
     try
     {
         fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime, chainparams, connman, interruptMsgProc, m_enable_bip61);
@@ -3518,6 +4542,11 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
         PrintExceptionContinue(nullptr, "ProcessMessages()");
     }
 
+    // VELES BEGIN
+    if (!fQueued)
+        g_message_processing_times.RecordCommand(strCommand, GetTimeMicros() - nTimeStart);
+    // VELES END
+
     if (!fRet) {
         LogPrint(BCLog::NET, "%s(%s, %u bytes) FAILED peer=%d\n", __func__, SanitizeString(strCommand), nMessageSize, pfrom->GetId());
     }
@@ -3915,7 +4944,8 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
                         LogPrint(BCLog::NET, "%s: sending header %s to peer=%d\n", __func__,
                                 vHeaders.front().GetHash().ToString(), pto->GetId());
                     }
-                    connman->PushMessage(pto, msgMaker.Make(NetMsgType::HEADERS, vHeaders));
+                    //connman->PushMessage(pto, msgMaker.Make(NetMsgType::HEADERS, vHeaders));
+                    PushHeadersMessage(pto, connman, msgMaker, state, vHeaders); // VELES
                     state.pindexBestHeaderSent = pBestIndex;
                 } else
                     fRevertToInv = true;
@@ -3955,7 +4985,8 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
                     LogPrint(BCLog::NET, "%s: sending header %s to peer=%d\n", __func__,
                             vHeaders.front().GetHash().ToString(), pto->GetId());
                 }
-                connman->PushMessage(pto, msgMaker.Make(NetMsgType::HEADERS, vHeaders));
+                //connman->PushMessage(pto, msgMaker.Make(NetMsgType::HEADERS, vHeaders));
+                PushHeadersMessage(pto, connman, msgMaker, state, vHeaders); // VELES
                 state.pindexBestHeaderSent = pBestIndex;
             //
             }
@@ -4147,6 +5178,26 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
                 }
             }
             pto->vInventoryToSend = vInvWait;
+
+            // VELES BEGIN
+            // Governance votes are announced together on their own timer
+            if (pto->fWhitelisted || pto->nNextVoteInvSend < nNow) {
+                pto->nNextVoteInvSend = PoissonNextSend(nNow, VOTE_INVENTORY_BROADCAST_INTERVAL);
+                for (const uint256& hash : pto->vInventoryVoteToSend) {
+                    if (pto->filterInventoryKnown.contains(hash))
+                        continue;
+                    pto->filterInventoryKnown.insert(hash);
+                    vInv.push_back(CInv(MSG_GOVERNANCE_OBJECT_VOTE, hash));
+                    if (vInv.size() >= 1000)
+                    {
+                        LogPrint(BCLog::NET, "SendMessages -- pushing vote inv's: count=%d peer=%d\n", vInv.size(), pto->GetId());
+                        connman->PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
+                        vInv.clear();
+                    }
+                }
+                pto->vInventoryVoteToSend.clear();
+            }
+            // VELES END
         }
         if (!vInv.empty()) {
             connman->PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
@@ -4164,6 +5215,15 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
             pto->fDisconnect = true;
             return true;
         }
+        // VELES BEGIN
+        // A peer falling behind its own delivery rate gets fewer blocks, so less of the window waits on it
+        if (!state.vBlocksInFlight.empty() && state.nBlockDeliveryTime > 0 && !state.fBlockDeliverySlow &&
+                nNow > state.nDownloadingSince + BLOCK_DELIVERY_SLOW_FACTOR * state.nBlockDeliveryTime + pto->nPingUsecTime) {
+            state.fBlockDeliverySlow = true;
+            SetBlocksInFlightLimit(&state, state.nBlocksInFlightLimit / 2);
+            LogPrint(BCLog::NET, "Block delivery slow, limit of blocks in flight now %d peer=%d\n", state.nBlocksInFlightLimit, pto->GetId());
+        }
+        // VELES END
         // In case there is a block that has been in flight from this peer for 2 + 0.5 * N times the block interval
         // (with N the number of peers from which we're downloading validated blocks), disconnect due to timeout.
         // We compensate for other peers to prevent killing off peers due to our own downstream link
@@ -4219,10 +5279,14 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
         // Message: getdata (blocks)
         //
         std::vector<CInv> vGetData;
-        if (!pto->fClient && ((fFetch && !pto->m_limited_node) || !IsInitialBlockDownload()) && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        //if (!pto->fClient && ((fFetch && !pto->m_limited_node) || !IsInitialBlockDownload()) && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        // VELES BEGIN
+        if (!pto->fClient && ((fFetch && !pto->m_limited_node) || !IsInitialBlockDownload()) && state.nBlocksInFlight < state.nBlocksInFlightLimit) {
+        // VELES END
             std::vector<const CBlockIndex*> vToDownload;
             NodeId staller = -1;
-            FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload, staller, consensusParams);
+            //FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload, staller, consensusParams);
+            FindNextBlocksToDownload(pto->GetId(), state.nBlocksInFlightLimit - state.nBlocksInFlight, vToDownload, staller, consensusParams); // VELES
             for (const CBlockIndex *pindex : vToDownload) {
                 uint32_t nFetchFlags = GetFetchFlags(pto);
                 vGetData.push_back(CInv(MSG_BLOCK | nFetchFlags, pindex->GetBlockHash()));
@@ -4241,9 +5305,15 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
         //
         // Message: getdata (non-blocks)
         //
-        while (!pto->mapAskFor.empty() && (*pto->mapAskFor.begin()).first <= nNow)
+        //while (!pto->mapAskFor.empty() && (*pto->mapAskFor.begin()).first <= nNow)
+        //{
+        //    const CInv& inv = (*pto->mapAskFor.begin()).second;
+        // VELES BEGIN
+        std::vector<CInv> vAskFor;
+        pto->invRequests.GetRequestable(nNow, MAX_PEER_INV_IN_FLIGHT, vAskFor);
+        for (const CInv& inv : vAskFor)
         {
-            const CInv& inv = (*pto->mapAskFor.begin()).second;
+        // VELES END
             if (!AlreadyHave(inv))
             {
                 LogPrint(BCLog::NET, "Requesting %s peer=%d\n", inv.ToString(), pto->GetId());
@@ -4257,9 +5327,10 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
             } else {
                 //If we're not going to ask, don't expect a response.
                 LogPrint(BCLog::NET, "Request already have inv = %s peer=%d\n", inv.ToString(), pto->GetId());
-                pto->setAskFor.erase(inv.hash);
+                //pto->setAskFor.erase(inv.hash);
+                pto->RemoveAskFor(inv.hash); // VELES
             }
-            pto->mapAskFor.erase(pto->mapAskFor.begin());
+            //pto->mapAskFor.erase(pto->mapAskFor.begin());
         }
         if (!vGetData.empty()) {
             connman->PushMessage(pto, msgMaker.Make(NetMsgType::GETDATA, vGetData));
@@ -21,6 +21,16 @@ static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS = 100;
 static const unsigned int DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN = 100;
 /** Default for BIP61 (sending reject messages) */
 static constexpr bool DEFAULT_ENABLE_BIP61{true};
+// VELES BEGIN
+/** Default for -dashmsgqueues, handle the masternode, governance, InstantSend and PrivateSend messages on a thread per subsystem */
+static const bool DEFAULT_DASH_MESSAGE_QUEUES = true;
+/** Bytes of messages queued for a Dash subsystem above which the peers sending it more are paused */
+static const size_t MAX_DASH_MESSAGE_QUEUE_SIZE = 5 * 1000 * 1000;
+/** Default for -maxdashcache, MiB each of the seen masternode pings, governance vote caches and InstantSend orphan votes may use */
+static const int64_t DEFAULT_MAX_DASH_CACHE = 32;
+/** Default for -peerblockfilters, serve the basic block filters to peers (BIP 157) */
+static const bool DEFAULT_PEERBLOCKFILTERS = false;
+// VELES END
 
 class PeerLogicValidation final : public CValidationInterface, public NetEventsInterface {
 private:
@@ -86,9 +96,33 @@ struct CNodeStateStats {
     int nSyncHeight = -1;
     int nCommonHeight = -1;
     std::vector<int> vHeightInFlight;
+    // VELES BEGIN
+    int nBlocksInFlightLimit = 0;
+    int64_t nBlockDeliveryTime = 0;
+    int64_t nBlockAnnounceLatency = -1;
+    bool fHighBandwidthCmpct = false;
+    // VELES END
 };
 
 /** Get statistics from node state */
 bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats);
 
+// VELES BEGIN
+/** Start the Dash message queue threads, the messages are handled by the message handler thread until then */
+void StartDashMessageQueues(CConnman& connman);
+void InterruptDashMessageQueues();
+/** Join the Dash message queue threads and drop the messages left, must happen before the peers are deleted */
+void StopDashMessageQueues();
+
+/** Time the message handler spent on one command or in one subsystem handler */
+struct MessageProcessingStats {
+    uint64_t nCount = 0;
+    int64_t nTotalMicros = 0;
+    int64_t nMaxMicros = 0;
+};
+
+/** Get the processing times per message command and per subsystem handler, since startup */
+void GetMessageProcessingStats(std::map<std::string, MessageProcessingStats>& mapCommands, std::map<std::string, MessageProcessingStats>& mapHandlers);
+// VELES END
+
 #endif // BITCOIN_NET_PROCESSING_H
@@ -10,6 +10,8 @@
 #include <util/strencodings.h>
 #include <tinyformat.h>
 
+#include <algorithm> // VELES
+
 static const unsigned char pchIPv4[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
 static const unsigned char pchOnionCat[] = {0xFD,0x87,0xD8,0x7E,0xEB,0x43};
 
@@ -715,6 +717,40 @@ bool CSubNet::IsValid() const
     return valid;
 }
 
+// VELES BEGIN
+int CSubNet::GetPrefixLength() const
+{
+    if (!valid)
+        return -1;
+    int n = 0;
+    for (; n < 16 && netmask[n] == 0xff; ++n) {}
+    int nLength = n * 8;
+    if (n < 16) {
+        const int bits = NetmaskBits(netmask[n]);
+        if (bits < 0)
+            return -1;
+        nLength += bits;
+        for (++n; n < 16; ++n)
+            if (netmask[n] != 0x00)
+                return -1;
+    }
+    return nLength;
+}
+
+CSubNet CSubNet::FromPrefix(const CNetAddr& addr, int nPrefixLength)
+{
+    CSubNet subnet;
+    subnet.valid = nPrefixLength >= 0 && nPrefixLength <= 128;
+    subnet.network = addr;
+    for (int x = 0; x < 16; ++x) {
+        const int bits = std::max(0, std::min(8, nPrefixLength - x * 8));
+        subnet.netmask[x] = (uint8_t)(0xff00 >> bits);
+        subnet.network.ip[x] &= subnet.netmask[x];
+    }
+    return subnet;
+}
+// VELES END
+
 bool operator==(const CSubNet& a, const CSubNet& b)
 {
     return a.valid == b.valid && a.network == b.network && !memcmp(a.netmask, b.netmask, 16);
@@ -127,6 +127,13 @@ class CSubNet
         std::string ToString() const;
         bool IsValid() const;
 
+        // VELES BEGIN
+        /** Number of leading one bits of the 128 bit netmask, -1 if the netmask isn't a prefix or the subnet is invalid */
+        int GetPrefixLength() const;
+        /** Subnet of addr with a netmask of the nPrefixLength first bits, equal to the subnets of the same prefix matching addr */
+        static CSubNet FromPrefix(const CNetAddr& addr, int nPrefixLength);
+        // VELES END
+
         friend bool operator==(const CSubNet& a, const CSubNet& b);
         friend bool operator!=(const CSubNet& a, const CSubNet& b) { return !(a == b); }
         friend bool operator<(const CSubNet& a, const CSubNet& b);
@@ -5,33 +5,106 @@
 
 #include <chainparams.h>
 #include <netfulfilledman.h>
+#include <random.h>
 #include <util/system.h>
 
+#include <algorithm>
+#include <limits>
+
 CNetFulfilledRequestManager netfulfilledman;
 
-void CNetFulfilledRequestManager::AddFulfilledRequest(CAddress addr, std::string strRequest)
+std::string GetFulfilledRequestName(FulfilledRequest request)
+{
+    switch (request) {
+    case FULFILLED_SPORK_SYNC: return "spork-sync";
+    case FULFILLED_MASTERNODE_LIST_SYNC: return "masternode-list-sync";
+    case FULFILLED_MASTERNODE_PAYMENT_SYNC: return "masternode-payment-sync";
+    case FULFILLED_GOVERNANCE_SYNC: return "governance-sync";
+    case FULFILLED_FULL_SYNC: return "full-sync";
+    case FULFILLED_MNGOVERNANCESYNC: return NetMsgType::MNGOVERNANCESYNC;
+    case FULFILLED_MASTERNODEPAYMENTSYNC: return NetMsgType::MASTERNODEPAYMENTSYNC;
+    case FULFILLED_MNVERIFY_REQUEST: return std::string(NetMsgType::MNVERIFY) + "-request";
+    case FULFILLED_MNVERIFY_REPLY: return std::string(NetMsgType::MNVERIFY) + "-reply";
+    case FULFILLED_MNVERIFY_DONE: return std::string(NetMsgType::MNVERIFY) + "-done";
+    case FULFILLED_REQUEST_COUNT: break;
+    }
+    return "";
+}
+
+bool CNetFulfilledRequestManager::Requests::IsEmpty() const
+{
+    for (int64_t nExpire : vExpire) {
+        if (nExpire != 0) return false;
+    }
+    return true;
+}
+
+CNetFulfilledRequestManager::CNetFulfilledRequestManager()
+    : mapFulfilledRequests(0, CacheKeyHasher(GetRand(std::numeric_limits<uint64_t>::max()), GetRand(std::numeric_limits<uint64_t>::max()))),
+      nWheelTime(0),
+      vLevelTimers(),
+      nTimers(0)
+{}
+
+void CNetFulfilledRequestManager::ScheduleExpiry(const Timer& timer)
+{
+    if (nWheelTime == 0) {
+        nWheelTime = GetTime();
+    }
+    // Timers beyond the range of the wheel wait in the top level and are scheduled again
+    // when their slot comes around
+    const int64_t nRange = int64_t(1) << (WHEEL_BITS * WHEEL_LEVELS);
+    const int64_t nTime = std::min(std::max(timer.nExpire, nWheelTime), nWheelTime + nRange - 1);
+    const int64_t nDelta = nTime - nWheelTime;
+    int nLevel = 0;
+    while (nLevel < WHEEL_LEVELS - 1 && nDelta >= (int64_t(1) << (WHEEL_BITS * (nLevel + 1)))) {
+        nLevel++;
+    }
+    vWheel[nLevel][(nTime >> (WHEEL_BITS * nLevel)) & (WHEEL_SIZE - 1)].push_back(timer);
+    vLevelTimers[nLevel]++;
+    nTimers++;
+}
+
+void CNetFulfilledRequestManager::Expire(const Timer& timer)
+{
+    fulfilledreqmap_t::iterator it = mapFulfilledRequests.find(timer.addr);
+    // The request was removed or added again since
+    if (it == mapFulfilledRequests.end() || it->second.vExpire[timer.request] != timer.nExpire) {
+        return;
+    }
+    it->second.vExpire[timer.request] = 0;
+    if (it->second.IsEmpty()) {
+        mapFulfilledRequests.erase(it);
+    }
+}
+
+void CNetFulfilledRequestManager::AddFulfilledRequest(const CAddress& addr, FulfilledRequest request)
 {
     LOCK(cs_mapFulfilledRequests);
-    mapFulfilledRequests[addr][strRequest] = GetTime() + Params().FulfilledRequestExpireTime();
+    const int64_t nExpire = GetTime() + Params().FulfilledRequestExpireTime();
+    mapFulfilledRequests[addr].vExpire[request] = nExpire;
+    ScheduleExpiry(Timer{addr, request, nExpire});
 }
 
-bool CNetFulfilledRequestManager::HasFulfilledRequest(CAddress addr, std::string strRequest)
+bool CNetFulfilledRequestManager::HasFulfilledRequest(const CAddress& addr, FulfilledRequest request)
 {
     LOCK(cs_mapFulfilledRequests);
-    fulfilledreqmap_t::iterator it = mapFulfilledRequests.find(addr);
+    fulfilledreqmap_t::const_iterator it = mapFulfilledRequests.find(addr);
 
     return  it != mapFulfilledRequests.end() &&
-            it->second.find(strRequest) != it->second.end() &&
-            it->second[strRequest] > GetTime();
+            it->second.vExpire[request] > GetTime();
 }
 
-void CNetFulfilledRequestManager::RemoveFulfilledRequest(CAddress addr, std::string strRequest)
+void CNetFulfilledRequestManager::RemoveFulfilledRequest(const CAddress& addr, FulfilledRequest request)
 {
     LOCK(cs_mapFulfilledRequests);
     fulfilledreqmap_t::iterator it = mapFulfilledRequests.find(addr);
 
     if (it != mapFulfilledRequests.end()) {
-        it->second.erase(strRequest);
+        it->second.vExpire[request] = 0;
+        if (it->second.IsEmpty()) {
+            mapFulfilledRequests.erase(it);
+        }
     }
 }
 
@@ -40,21 +113,66 @@ void CNetFulfilledRequestManager::CheckAndRemove()
     LOCK(cs_mapFulfilledRequests);
 
     int64_t now = GetTime();
-    fulfilledreqmap_t::iterator it = mapFulfilledRequests.begin();
+    while(nTimers > 0 && nWheelTime <= now) {
+        // Nothing expires before the next slot of the lowest level holding timers
+        int nLowest = 0;
+        while (nLowest < WHEEL_LEVELS - 1 && vLevelTimers[nLowest] == 0) {
+            nLowest++;
+        }
+        const int64_t nStep = int64_t(1) << (WHEEL_BITS * nLowest);
+        const int64_t nNext = (nWheelTime + nStep - 1) & ~(nStep - 1);
+        if (nNext > now) {
+            nWheelTime = now + 1;
+            break;
+        }
+        nWheelTime = nNext;
 
-    while(it != mapFulfilledRequests.end()) {
-        fulfilledreqmapentry_t::iterator it_entry = it->second.begin();
-        while(it_entry != it->second.end()) {
-            if(now > it_entry->second) {
-                it->second.erase(it_entry++);
+        // Move the timers of the next slot of each coarser level down, once the levels
+        // below went around
+        for (int nLevel = 1; nLevel < WHEEL_LEVELS; nLevel++) {
+            if ((nWheelTime & ((int64_t(1) << (WHEEL_BITS * nLevel)) - 1)) != 0) break;
+            std::vector<Timer> vTimers;
+            vTimers.swap(vWheel[nLevel][(nWheelTime >> (WHEEL_BITS * nLevel)) & (WHEEL_SIZE - 1)]);
+            vLevelTimers[nLevel] -= vTimers.size();
+            nTimers -= vTimers.size();
+            for (const Timer& timer : vTimers) {
+                ScheduleExpiry(timer);
+            }
+        }
+
+        std::vector<Timer> vTimers;
+        vTimers.swap(vWheel[0][nWheelTime & (WHEEL_SIZE - 1)]);
+        vLevelTimers[0] -= vTimers.size();
+        nTimers -= vTimers.size();
+        for (const Timer& timer : vTimers) {
+            if (timer.nExpire > nWheelTime) {
+                ScheduleExpiry(timer);
             } else {
-                ++it_entry;
+                Expire(timer);
             }
         }
-        if(it->second.size() == 0) {
-            mapFulfilledRequests.erase(it++);
-        } else {
-            ++it;
+        nWheelTime++;
+    }
+    if (nTimers == 0) {
+        nWheelTime = 0;
+    }
+}
+
+void CNetFulfilledRequestManager::Load(const std::map<CNetAddr, std::map<std::string, int64_t> >& mapRequests)
+{
+    LOCK(cs_mapFulfilledRequests);
+    Clear();
+
+    std::map<std::string, FulfilledRequest> mapNames;
+    for (int i = 0; i < FULFILLED_REQUEST_COUNT; i++) {
+        mapNames[GetFulfilledRequestName((FulfilledRequest)i)] = (FulfilledRequest)i;
+    }
+    for (const auto& entry : mapRequests) {
+        for (const auto& request : entry.second) {
+            auto it = mapNames.find(request.first);
+            if (it == mapNames.end() || request.second == 0) continue;
+            mapFulfilledRequests[entry.first].vExpire[it->second] = request.second;
+            ScheduleExpiry(Timer{entry.first, it->second, request.second});
         }
     }
 }
@@ -63,6 +181,16 @@ void CNetFulfilledRequestManager::Clear()
 {
     LOCK(cs_mapFulfilledRequests);
     mapFulfilledRequests.clear();
+    for (auto& level : vWheel) {
+        for (auto& slot : level) {
+            slot.clear();
+        }
+    }
+    nWheelTime = 0;
+    for (size_t& nLevelTimers : vLevelTimers) {
+        nLevelTimers = 0;
+    }
+    nTimers = 0;
 }
 
 std::string CNetFulfilledRequestManager::ToString() const
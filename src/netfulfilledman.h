@@ -6,40 +6,115 @@
 #ifndef DASH_NETFULFILLEDMAN_H
 #define DASH_NETFULFILLEDMAN_H
 
+#include <cachemap.h>
 #include <netbase.h>
 #include <protocol.h>
 #include <serialize.h>
 #include <sync.h>
 
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 class CNetFulfilledRequestManager;
 extern CNetFulfilledRequestManager netfulfilledman;
 
+/** Requests tracked for every peer, stored by name in netfulfilled.dat */
+enum FulfilledRequest : uint8_t {
+    FULFILLED_SPORK_SYNC,
+    FULFILLED_MASTERNODE_LIST_SYNC,
+    FULFILLED_MASTERNODE_PAYMENT_SYNC,
+    FULFILLED_GOVERNANCE_SYNC,
+    FULFILLED_FULL_SYNC,
+    FULFILLED_MNGOVERNANCESYNC,
+    FULFILLED_MASTERNODEPAYMENTSYNC,
+    FULFILLED_MNVERIFY_REQUEST,
+    FULFILLED_MNVERIFY_REPLY,
+    FULFILLED_MNVERIFY_DONE,
+    FULFILLED_REQUEST_COUNT
+};
+
+std::string GetFulfilledRequestName(FulfilledRequest request);
+
 // Fulfilled requests are used to prevent nodes from asking for the same data on sync
 // and from being banned for doing so too often.
+//
+// Every request expires some time after it is added. The expiry times are kept in a
+// hierarchical timing wheel of WHEEL_LEVELS levels of WHEEL_SIZE slots, each level
+// WHEEL_SIZE times coarser than the one below, so CheckAndRemove only visits the
+// requests that expire rather than all of them.
 class CNetFulfilledRequestManager
 {
 private:
-    typedef std::map<std::string, int64_t> fulfilledreqmapentry_t;
-    typedef std::map<CNetAddr, fulfilledreqmapentry_t> fulfilledreqmap_t;
+    static const int WHEEL_BITS = 6;
+    static const int WHEEL_SIZE = 1 << WHEEL_BITS;
+    static const int WHEEL_LEVELS = 4;
+
+    struct Requests
+    {
+        //! Expiry time of every request, 0 when not fulfilled
+        int64_t vExpire[FULFILLED_REQUEST_COUNT] = {};
+
+        bool IsEmpty() const;
+    };
+
+    struct Timer
+    {
+        CNetAddr addr;
+        FulfilledRequest request;
+        int64_t nExpire;
+    };
+
+    typedef std::unordered_map<CNetAddr, Requests, CacheKeyHasher> fulfilledreqmap_t;
 
     //keep track of what node has/was asked for and when
     fulfilledreqmap_t mapFulfilledRequests;
-    CCriticalSection cs_mapFulfilledRequests;
+    mutable CCriticalSection cs_mapFulfilledRequests;
 
-public:
-    CNetFulfilledRequestManager() {}
+    //! Timers expiring in the slots of every level, stale ones are skipped when they expire
+    std::vector<Timer> vWheel[WHEEL_LEVELS][WHEEL_SIZE];
+    //! Time of the next level 0 slot to expire, 0 before the first timer
+    int64_t nWheelTime;
+    //! Timers in the slots of each level
+    size_t vLevelTimers[WHEEL_LEVELS];
+    size_t nTimers;
 
-    ADD_SERIALIZE_METHODS;
+    void ScheduleExpiry(const Timer& timer);
+    void Expire(const Timer& timer);
+
+public:
+    CNetFulfilledRequestManager();
 
-    template <typename Stream, typename Operation>
-    inline void SerializationOp(Stream& s, Operation ser_action) {
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
         LOCK(cs_mapFulfilledRequests);
-        READWRITE(mapFulfilledRequests);
+        std::map<CNetAddr, std::map<std::string, int64_t> > mapRequests;
+        for (const auto& entry : mapFulfilledRequests) {
+            for (int i = 0; i < FULFILLED_REQUEST_COUNT; i++) {
+                if (entry.second.vExpire[i] != 0) {
+                    mapRequests[entry.first][GetFulfilledRequestName((FulfilledRequest)i)] = entry.second.vExpire[i];
+                }
+            }
+        }
+        s << mapRequests;
     }
 
-    void AddFulfilledRequest(CAddress addr, std::string strRequest); // expire after 1 hour by default
-    bool HasFulfilledRequest(CAddress addr, std::string strRequest);
-    void RemoveFulfilledRequest(CAddress addr, std::string strRequest);
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        std::map<CNetAddr, std::map<std::string, int64_t> > mapRequests;
+        s >> mapRequests;
+        Load(mapRequests);
+    }
+
+    /** Replace the requests with those of netfulfilled.dat, dropping the unknown ones */
+    void Load(const std::map<CNetAddr, std::map<std::string, int64_t> >& mapRequests);
+
+    void AddFulfilledRequest(const CAddress& addr, FulfilledRequest request); // expire after 1 hour by default
+    bool HasFulfilledRequest(const CAddress& addr, FulfilledRequest request);
+    void RemoveFulfilledRequest(const CAddress& addr, FulfilledRequest request);
 
     void CheckAndRemove();
     void Clear();
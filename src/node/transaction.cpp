@@ -101,3 +101,65 @@ TransactionError BroadcastTransaction(const CTransactionRef tx, uint256& hashTx,
 
     return TransactionError::OK;
 }
+
+// VELES BEGIN
+void BroadcastTransactions(const std::vector<CTransactionRef>& vtx, std::vector<TransactionError>& errors, std::vector<std::string>& err_strings, const CAmount& highfee)
+{
+    errors.assign(vtx.size(), TransactionError::OK);
+    err_strings.assign(vtx.size(), std::string());
+
+    // The transactions neither in the chain nor in the mempool yet
+    std::vector<CTransactionRef> vtxAccept;
+    std::vector<size_t> vAcceptIndex;
+    {
+        LOCK(cs_main);
+        CCoinsViewCache &view = *pcoinsTip;
+        for (size_t i = 0; i < vtx.size(); i++) {
+            const uint256& hashTx = vtx[i]->GetHash();
+            bool fHaveChain = false;
+            for (size_t o = 0; !fHaveChain && o < vtx[i]->vout.size(); o++) {
+                const Coin& existingCoin = view.AccessCoin(COutPoint(hashTx, o));
+                fHaveChain = !existingCoin.IsSpent();
+            }
+            if (fHaveChain) {
+                errors[i] = TransactionError::ALREADY_IN_CHAIN;
+            } else if (!mempool.exists(hashTx)) {
+                vtxAccept.push_back(vtx[i]);
+                vAcceptIndex.push_back(i);
+            }
+        }
+    }
+
+    std::vector<CValidationState> states;
+    std::vector<bool> missing_inputs;
+    const std::vector<bool> accepted = AcceptToMemoryPoolBatch(mempool, vtxAccept, states, missing_inputs, nullptr /* plTxnReplaced */, highfee);
+    for (size_t j = 0; j < vtxAccept.size(); j++) {
+        if (accepted[j]) continue;
+        const size_t i = vAcceptIndex[j];
+        if (states[j].IsInvalid()) {
+            err_strings[i] = FormatStateMessage(states[j]);
+            errors[i] = TransactionError::MEMPOOL_REJECTED;
+        } else if (missing_inputs[j]) {
+            errors[i] = TransactionError::MISSING_INPUTS;
+        } else {
+            err_strings[i] = FormatStateMessage(states[j]);
+            errors[i] = TransactionError::MEMPOOL_ERROR;
+        }
+    }
+
+    // Make sure the wallets have seen the accepted transactions before returning, see BroadcastTransaction
+    SyncWithValidationInterfaceQueue();
+
+    for (size_t i = 0; i < vtx.size(); i++) {
+        if (errors[i] != TransactionError::OK) continue;
+        if (!g_connman) {
+            errors[i] = TransactionError::P2P_DISABLED;
+            continue;
+        }
+        CInv inv(MSG_TX, vtx[i]->GetHash());
+        g_connman->ForEachNode([&inv](CNode* pnode) {
+            pnode->PushInventory(inv);
+        });
+    }
+}
+// VELES END
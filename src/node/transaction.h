@@ -34,4 +34,16 @@ std::string TransactionErrorString(const TransactionError error);
  */
 NODISCARD TransactionError BroadcastTransaction(CTransactionRef tx, uint256& txid, std::string& err_string, const CAmount& highfee);
 
+// VELES BEGIN
+/**
+ * Broadcast transactions, accepting them to the mempool together (see AcceptToMemoryPoolBatch)
+ *
+ * @param[in]  vtx the transactions to broadcast, in order
+ * @param[out] &errors the error of each transaction
+ * @param[out] &err_strings the error string of each transaction, if available
+ * @param[in]  highfee Reject txs with fees higher than this (if 0, accept any fee)
+ */
+void BroadcastTransactions(const std::vector<CTransactionRef>& vtx, std::vector<TransactionError>& errors, std::vector<std::string>& err_strings, const CAmount& highfee);
+// VELES END
+
 #endif // BITCOIN_NODE_TRANSACTION_H
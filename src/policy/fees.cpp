@@ -15,6 +15,8 @@
 #include <txmempool.h>
 #include <util/system.h>
 
+#include <cmath>
+
 static constexpr double INF_FEERATE = 1e99;
 
 std::string StringForFeeEstimateHorizon(FeeEstimateHorizon horizon) {
@@ -104,6 +106,13 @@ private:
     // Resolution (# of blocks) with which confirmations are tracked
     unsigned int scale;
 
+    // VELES BEGIN
+    // The averages are decayed lazily: the stored values are the actual ones multiplied by
+    // inflation, which grows by 1/decay every period, and new data points are added multiplied
+    // by it. Decaying then touches no bucket until the values are normalized again.
+    double inflation;
+    // VELES END
+
     // Mempool counts of outstanding transactions
     // For each bucket X, track the number of transactions in the mempool
     // that are unconfirmed for each possible confirmation value Y
@@ -112,6 +121,7 @@ private:
     std::vector<int> oldUnconfTxs;
 
     void resizeInMemoryCounters(size_t newbuckets);
+    void Normalize(); // VELES
 
 public:
     /**
@@ -144,7 +154,7 @@ public:
 
     /** Update our estimates by decaying our historical moving average and updating
         with the data gathered from the current block */
-    void UpdateMovingAverages();
+    void UpdateMovingAverages(unsigned int nPeriods = 1); // VELES
 
     /**
      * Calculate a feerate estimate.  Find the lowest value bucket (or range of buckets
@@ -181,6 +191,7 @@ TxConfirmStats::TxConfirmStats(const std::vector<double>& defaultBuckets,
     : buckets(defaultBuckets), bucketMap(defaultBucketMap)
 {
     decay = _decay;
+    inflation = 1; // VELES
     assert(_scale != 0 && "_scale must be non-zero");
     scale = _scale;
     confAvg.resize(maxPeriods);
@@ -224,13 +235,24 @@ void TxConfirmStats::Record(int blocksToConfirm, double val)
         return;
     int periodsToConfirm = (blocksToConfirm + scale - 1)/scale;
     unsigned int bucketindex = bucketMap.lower_bound(val)->second;
+    // VELES BEGIN
+    /*
     for (size_t i = periodsToConfirm; i <= confAvg.size(); i++) {
         confAvg[i - 1][bucketindex]++;
     }
     txCtAvg[bucketindex]++;
     avg[bucketindex] += val;
+    */
+    for (size_t i = periodsToConfirm; i <= confAvg.size(); i++) {
+        confAvg[i - 1][bucketindex] += inflation;
+    }
+    txCtAvg[bucketindex] += inflation;
+    avg[bucketindex] += val * inflation;
+    // VELES END
 }
 
+// VELES BEGIN
+/*
 void TxConfirmStats::UpdateMovingAverages()
 {
     for (unsigned int j = 0; j < buckets.size(); j++) {
@@ -242,6 +264,28 @@ void TxConfirmStats::UpdateMovingAverages()
         txCtAvg[j] = txCtAvg[j] * decay;
     }
 }
+*/
+void TxConfirmStats::UpdateMovingAverages(unsigned int nPeriods)
+{
+    inflation /= std::pow(decay, nPeriods);
+    // Keep well within the range of double, avg holds feerates times counts
+    if (inflation > 1e100) Normalize();
+}
+
+void TxConfirmStats::Normalize()
+{
+    const double factor = 1 / inflation;
+    for (unsigned int j = 0; j < avg.size(); j++) {
+        for (unsigned int i = 0; i < confAvg.size(); i++)
+            confAvg[i][j] *= factor;
+        for (unsigned int i = 0; i < failAvg.size(); i++)
+            failAvg[i][j] *= factor;
+        avg[j] *= factor;
+        txCtAvg[j] *= factor;
+    }
+    inflation = 1;
+}
+// VELES END
 
 // returns -1 on error conditions
 double TxConfirmStats::EstimateMedianVal(int confTarget, double sufficientTxVal,
@@ -288,9 +332,14 @@ double TxConfirmStats::EstimateMedianVal(int confTarget, double sufficientTxVal,
             newBucketRange = false;
         }
         curFarBucket = bucket;
-        nConf += confAvg[periodTarget - 1][bucket];
-        totalNum += txCtAvg[bucket];
-        failNum += failAvg[periodTarget - 1][bucket];
+        // VELES BEGIN
+        //nConf += confAvg[periodTarget - 1][bucket];
+        //totalNum += txCtAvg[bucket];
+        //failNum += failAvg[periodTarget - 1][bucket];
+        nConf += confAvg[periodTarget - 1][bucket] / inflation;
+        totalNum += txCtAvg[bucket] / inflation;
+        failNum += failAvg[periodTarget - 1][bucket] / inflation;
+        // VELES END
         for (unsigned int confct = confTarget; confct < GetMaxConfirms(); confct++)
             extraNum += unconfTxs[(nBlockHeight - confct)%bins][bucket];
         extraNum += oldUnconfTxs[bucket];
@@ -400,10 +449,19 @@ void TxConfirmStats::Write(CAutoFile& fileout) const
 {
     fileout << decay;
     fileout << scale;
-    fileout << avg;
-    fileout << txCtAvg;
-    fileout << confAvg;
-    fileout << failAvg;
+    // VELES BEGIN
+    //fileout << avg;
+    //fileout << txCtAvg;
+    //fileout << confAvg;
+    //fileout << failAvg;
+    // The file holds the actual averages
+    TxConfirmStats normalized(*this);
+    normalized.Normalize();
+    fileout << normalized.avg;
+    fileout << normalized.txCtAvg;
+    fileout << normalized.confAvg;
+    fileout << normalized.failAvg;
+    // VELES END
 }
 
 void TxConfirmStats::Read(CAutoFile& filein, int nFileVersion, size_t numBuckets)
@@ -422,6 +480,7 @@ void TxConfirmStats::Read(CAutoFile& filein, int nFileVersion, size_t numBuckets
     if (scale == 0) {
         throw std::runtime_error("Corrupt estimates file. Scale must be non-zero");
     }
+    inflation = 1; // VELES
 
     filein >> avg;
     if (avg.size() != numBuckets) {
@@ -502,7 +561,7 @@ void TxConfirmStats::removeTx(unsigned int entryHeight, unsigned int nBestSeenHe
         assert(scale != 0);
         unsigned int periodsAgo = blocksAgo / scale;
         for (size_t i = 0; i < periodsAgo && i < failAvg.size(); i++) {
-            failAvg[i][bucketindex]++;
+            failAvg[i][bucketindex] += inflation; // VELES
         }
     }
 }
@@ -520,6 +579,7 @@ bool CBlockPolicyEstimator::removeTx(uint256 hash, bool inBlock)
         feeStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
         shortStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
         longStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
+        timeStats->removeTx(pos->second.timeSlot, nBestSeenSlot, pos->second.bucketIndex, inBlock); // VELES
         mapMemPoolTxs.erase(hash);
         return true;
     } else {
@@ -528,7 +588,9 @@ bool CBlockPolicyEstimator::removeTx(uint256 hash, bool inBlock)
 }
 
 CBlockPolicyEstimator::CBlockPolicyEstimator()
-    : nBestSeenHeight(0), firstRecordedHeight(0), historicalFirst(0), historicalBest(0), trackedTxs(0), untrackedTxs(0)
+    : nBestSeenHeight(0), firstRecordedHeight(0), historicalFirst(0), historicalBest(0),
+      nBestSeenSlot(0), firstRecordedSlot(0), historicalFirstSlot(0), historicalBestSlot(0), // VELES
+      trackedTxs(0), untrackedTxs(0)
 {
     static_assert(MIN_BUCKET_FEERATE > 0, "Min feerate must be nonzero");
     size_t bucketIndex = 0;
@@ -543,6 +605,7 @@ CBlockPolicyEstimator::CBlockPolicyEstimator()
     feeStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, bucketMap, MED_BLOCK_PERIODS, MED_DECAY, MED_SCALE));
     shortStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, bucketMap, SHORT_BLOCK_PERIODS, SHORT_DECAY, SHORT_SCALE));
     longStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, bucketMap, LONG_BLOCK_PERIODS, LONG_DECAY, LONG_SCALE));
+    timeStats = std::unique_ptr<TxConfirmStats>(new TxConfirmStats(buckets, bucketMap, TIME_PERIODS, TIME_DECAY, TIME_SCALE)); // VELES
 }
 
 CBlockPolicyEstimator::~CBlockPolicyEstimator()
@@ -586,10 +649,20 @@ void CBlockPolicyEstimator::processTransaction(const CTxMemPoolEntry& entry, boo
     assert(bucketIndex == bucketIndex2);
     unsigned int bucketIndex3 = longStats->NewTx(txHeight, (double)feeRate.GetFeePerK());
     assert(bucketIndex == bucketIndex3);
+    // VELES BEGIN
+    UpdateTimeSlot(entry.GetTime());
+    mapMemPoolTxs[hash].timeSlot = nBestSeenSlot;
+    unsigned int bucketIndex4 = timeStats->NewTx(nBestSeenSlot, (double)feeRate.GetFeePerK());
+    assert(bucketIndex == bucketIndex4);
+    // VELES END
 }
 
 bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxMemPoolEntry* entry)
 {
+    // VELES BEGIN
+    auto pos = mapMemPoolTxs.find(entry->GetTx().GetHash());
+    const unsigned int timeSlot = pos != mapMemPoolTxs.end() ? pos->second.timeSlot : 0;
+    // VELES END
     if (!removeTx(entry->GetTx().GetHash(), true)) {
         // This transaction wasn't being tracked for fee estimation
         return false;
@@ -612,6 +685,10 @@ bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxM
     feeStats->Record(blocksToConfirm, (double)feeRate.GetFeePerK());
     shortStats->Record(blocksToConfirm, (double)feeRate.GetFeePerK());
     longStats->Record(blocksToConfirm, (double)feeRate.GetFeePerK());
+    // VELES BEGIN
+    // Slots are 1-based as well, a transaction mined within the slot it entered took 1
+    timeStats->Record(nBestSeenSlot - timeSlot + 1, (double)feeRate.GetFeePerK());
+    // VELES END
     return true;
 }
 
@@ -643,6 +720,11 @@ void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
     shortStats->UpdateMovingAverages();
     longStats->UpdateMovingAverages();
 
+    // VELES BEGIN
+    // The time based data is decayed by the time passed since the last block instead
+    UpdateTimeSlot(GetTime());
+    // VELES END
+
     unsigned int countedTxs = 0;
     // Update averages with data points from current block
     for (const auto& entry : entries) {
@@ -654,6 +736,11 @@ void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
         firstRecordedHeight = nBestSeenHeight;
         LogPrint(BCLog::ESTIMATEFEE, "Blockpolicy first recorded height %u\n", firstRecordedHeight);
     }
+    // VELES BEGIN
+    if (firstRecordedSlot == 0 && countedTxs > 0) {
+        firstRecordedSlot = nBestSeenSlot;
+    }
+    // VELES END
 
 
     LogPrint(BCLog::ESTIMATEFEE, "Blockpolicy estimates updated by %u of %u block txs, since last block %u of %u tracked, mempool map size %u, max target %u from %s\n",
@@ -754,6 +841,101 @@ unsigned int CBlockPolicyEstimator::MaxUsableEstimate() const
     return std::min(longStats->GetMaxConfirms(), std::max(BlockSpan(), HistoricalBlockSpan()) / 2);
 }
 
+// VELES BEGIN
+void CBlockPolicyEstimator::UpdateTimeSlot(int64_t nTime)
+{
+    const unsigned int slot = nTime / TIME_SLOT_SECONDS;
+    if (slot <= nBestSeenSlot) return;
+    if (nBestSeenSlot == 0) {
+        nBestSeenSlot = slot;
+        return;
+    }
+
+    // Roll every slot of the circular buffer once at most, and decay all the slots passed at once
+    const unsigned int nSlots = slot - nBestSeenSlot;
+    for (unsigned int i = slot - std::min(nSlots, timeStats->GetMaxConfirms()) + 1; i <= slot; i++) {
+        timeStats->ClearCurrent(i);
+    }
+    timeStats->UpdateMovingAverages(nSlots);
+    nBestSeenSlot = slot;
+}
+
+unsigned int CBlockPolicyEstimator::MaxUsableTimeSlots() const
+{
+    unsigned int span = firstRecordedSlot == 0 ? 0 : nBestSeenSlot - firstRecordedSlot;
+    unsigned int historicalSpan = 0;
+    if (historicalFirstSlot != 0 && nBestSeenSlot - historicalBestSlot <= OLDEST_TIME_HISTORY) {
+        historicalSpan = historicalBestSlot - historicalFirstSlot;
+    }
+    // Divided by 2 for the same reason as MaxUsableEstimate
+    return std::min(timeStats->GetMaxConfirms(), std::max(span, historicalSpan) / 2);
+}
+
+int64_t CBlockPolicyEstimator::HighestTimeTracked() const
+{
+    LOCK(m_cs_fee_estimator);
+    return (int64_t)timeStats->GetMaxConfirms() * TIME_SLOT_SECONDS;
+}
+
+/** estimateTimeFee returns the max of the feerates calculated with a 60%
+ * threshold required at target / 2, an 85% threshold required at target and,
+ * unless economical, a 95% threshold required at 2 * target, all from the time
+ * based data.
+ */
+CFeeRate CBlockPolicyEstimator::estimateTimeFee(int64_t nSeconds, FeeCalculation *feeCalc, bool conservative) const
+{
+    LOCK(m_cs_fee_estimator);
+
+    if (feeCalc) {
+        feeCalc->desiredTarget = (int)nSeconds;
+        feeCalc->returnedTarget = (int)nSeconds;
+    }
+
+    // Return failure if trying to analyze a target we're not tracking
+    if (nSeconds <= 0 || nSeconds > (int64_t)timeStats->GetMaxConfirms() * TIME_SLOT_SECONDS) {
+        return CFeeRate(0);
+    }
+    unsigned int confTarget = (nSeconds + TIME_SLOT_SECONDS - 1) / TIME_SLOT_SECONDS;
+
+    // A slot is too short to tell the transactions that just made it from the others
+    if (confTarget == 1) confTarget = 2;
+
+    confTarget = std::min(confTarget, MaxUsableTimeSlots());
+    if (feeCalc) feeCalc->returnedTarget = confTarget * TIME_SLOT_SECONDS;
+
+    if (confTarget <= 1) return CFeeRate(0); // error condition
+
+    EstimationResult tempResult;
+    double median = timeStats->EstimateMedianVal(confTarget / 2, SUFFICIENT_FEETXS, HALF_SUCCESS_PCT, true, nBestSeenSlot, &tempResult);
+    if (feeCalc) {
+        feeCalc->est = tempResult;
+        feeCalc->reason = FeeReason::HALF_ESTIMATE;
+    }
+    double actualEst = timeStats->EstimateMedianVal(confTarget, SUFFICIENT_FEETXS, SUCCESS_PCT, true, nBestSeenSlot, &tempResult);
+    if (actualEst > median) {
+        median = actualEst;
+        if (feeCalc) {
+            feeCalc->est = tempResult;
+            feeCalc->reason = FeeReason::FULL_ESTIMATE;
+        }
+    }
+    if (conservative && 2 * confTarget <= timeStats->GetMaxConfirms()) {
+        double doubleEst = timeStats->EstimateMedianVal(2 * confTarget, SUFFICIENT_FEETXS, DOUBLE_SUCCESS_PCT, true, nBestSeenSlot, &tempResult);
+        if (doubleEst > median) {
+            median = doubleEst;
+            if (feeCalc) {
+                feeCalc->est = tempResult;
+                feeCalc->reason = FeeReason::DOUBLE_ESTIMATE;
+            }
+        }
+    }
+
+    if (median < 0) return CFeeRate(0); // error condition
+
+    return CFeeRate(llround(median));
+}
+// VELES END
+
 /** Return a fee estimate at the required successThreshold from the shortest
  * time horizon which tracks confirmations up to the desired target.  If
  * checkShorterHorizon is requested, also allow short time horizon estimates
@@ -959,6 +1141,18 @@ bool CBlockPolicyEstimator::Write(CAutoFile& fileout) const
         feeStats->Write(fileout);
         shortStats->Write(fileout);
         longStats->Write(fileout);
+        // VELES BEGIN
+        // The time based data comes last, versions before it stop reading at the long stats
+        fileout << nBestSeenSlot;
+        unsigned int slotSpan = firstRecordedSlot == 0 ? 0 : nBestSeenSlot - firstRecordedSlot;
+        if (slotSpan > (historicalBestSlot - historicalFirstSlot) / 2) {
+            fileout << firstRecordedSlot << nBestSeenSlot;
+        }
+        else {
+            fileout << historicalFirstSlot << historicalBestSlot;
+        }
+        timeStats->Write(fileout);
+        // VELES END
     }
     catch (const std::exception&) {
         LogPrintf("CBlockPolicyEstimator::Write(): unable to write policy estimator data (non-fatal)\n");
@@ -1002,6 +1196,23 @@ bool CBlockPolicyEstimator::Read(CAutoFile& filein)
             fileShortStats->Read(filein, nVersionThatWrote, numBuckets);
             fileLongStats->Read(filein, nVersionThatWrote, numBuckets);
 
+            // VELES BEGIN
+            std::unique_ptr<TxConfirmStats> fileTimeStats(new TxConfirmStats(buckets, bucketMap, TIME_PERIODS, TIME_DECAY, TIME_SCALE));
+            unsigned int nFileBestSeenSlot = 0, nFileHistoricalFirstSlot = 0, nFileHistoricalBestSlot = 0;
+            try {
+                filein >> nFileBestSeenSlot >> nFileHistoricalFirstSlot >> nFileHistoricalBestSlot;
+                if (nFileHistoricalFirstSlot > nFileHistoricalBestSlot || nFileHistoricalBestSlot > nFileBestSeenSlot) {
+                    throw std::runtime_error("Corrupt estimates file. Historical time range for estimates is invalid");
+                }
+                fileTimeStats->Read(filein, nVersionThatWrote, numBuckets);
+            } catch (const std::exception& e) {
+                // Written before the time based estimates, they start over
+                LogPrint(BCLog::ESTIMATEFEE, "%s: no time based fee estimation data: %s\n", __func__, e.what());
+                fileTimeStats.reset(new TxConfirmStats(buckets, bucketMap, TIME_PERIODS, TIME_DECAY, TIME_SCALE));
+                nFileBestSeenSlot = nFileHistoricalFirstSlot = nFileHistoricalBestSlot = 0;
+            }
+            // VELES END
+
             // Fee estimates file parsed correctly
             // Copy buckets from file and refresh our bucketmap
             buckets = fileBuckets;
@@ -1014,10 +1225,16 @@ bool CBlockPolicyEstimator::Read(CAutoFile& filein)
             feeStats = std::move(fileFeeStats);
             shortStats = std::move(fileShortStats);
             longStats = std::move(fileLongStats);
+            timeStats = std::move(fileTimeStats); // VELES
 
             nBestSeenHeight = nFileBestSeenHeight;
             historicalFirst = nFileHistoricalFirst;
             historicalBest = nFileHistoricalBest;
+            // VELES BEGIN
+            nBestSeenSlot = nFileBestSeenSlot;
+            historicalFirstSlot = nFileHistoricalFirstSlot;
+            historicalBestSlot = nFileHistoricalBestSlot;
+            // VELES END
         }
     }
     catch (const std::exception& e) {
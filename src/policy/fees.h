@@ -135,6 +135,11 @@ struct FeeCalculation
  *  We want to be able to estimate feerates that are needed on tx's to be included in
  * a certain number of blocks.  Every time a block is added to the best chain, this class records
  * stats on the transactions included in that block
+ *
+ * VELES: blocks of the five algos do not arrive at a regular interval, so a fourth data set
+ * tracks the confirmation delays in time slots of TIME_SLOT_SECONDS instead of blocks, and
+ * decays with the time passed instead of per block. estimateTimeFee answers from it for a
+ * target given in seconds.
  */
 class CBlockPolicyEstimator
 {
@@ -158,6 +163,18 @@ private:
     /** Decay of .9995 is a half-life of 1008 blocks or about 1 week */
     static constexpr double LONG_DECAY = .99931;
 
+    // VELES BEGIN
+    /** Resolution of the time based estimates */
+    static constexpr int64_t TIME_SLOT_SECONDS = 60;
+    /** Track confirm delays up to 480 minutes for the time based estimates */
+    static constexpr unsigned int TIME_PERIODS = 80;
+    static constexpr unsigned int TIME_SCALE = 6;
+    /** Decay of .998 per minute is a half-life of about 6 hours */
+    static constexpr double TIME_DECAY = .998;
+    /** Time based historical estimates older than a week aren't valid */
+    static const unsigned int OLDEST_TIME_HISTORY = 7 * 24 * 60;
+    // VELES END
+
     // Dash
     /** Require greater than 95% of X fee transactions to be confirmed within Y blocks for X to be big enough */
     static constexpr double MIN_SUCCESS_PCT = .95;
@@ -236,6 +253,16 @@ public:
      */
     CFeeRate estimateRawFee(int confTarget, double successThreshold, FeeEstimateHorizon horizon, EstimationResult *result = nullptr) const;
 
+    // VELES BEGIN
+    /** Estimate feerate needed to get be included in a block within nSeconds, whatever the
+     *  algos and spacing of the blocks. feeCalc targets are in seconds. Economical estimates
+     *  skip the 95% threshold at twice the target.
+     */
+    CFeeRate estimateTimeFee(int64_t nSeconds, FeeCalculation *feeCalc, bool conservative) const;
+    /** Highest target in seconds the time based estimates are tracked for */
+    int64_t HighestTimeTracked() const;
+    // VELES END
+
     // Dash
     /** Return a priority estimate */
     //-//double estimatePriority(int confTarget);
@@ -267,11 +294,21 @@ private:
     unsigned int historicalFirst GUARDED_BY(m_cs_fee_estimator);
     unsigned int historicalBest GUARDED_BY(m_cs_fee_estimator);
 
+    // VELES BEGIN
+    //! Time slot of the last block, and range of the slots with time based data as in the
+    //! block heights above
+    unsigned int nBestSeenSlot GUARDED_BY(m_cs_fee_estimator);
+    unsigned int firstRecordedSlot GUARDED_BY(m_cs_fee_estimator);
+    unsigned int historicalFirstSlot GUARDED_BY(m_cs_fee_estimator);
+    unsigned int historicalBestSlot GUARDED_BY(m_cs_fee_estimator);
+    // VELES END
+
     struct TxStatsInfo
     {
         unsigned int blockHeight;
         unsigned int bucketIndex;
-        TxStatsInfo() : blockHeight(0), bucketIndex(0) {}
+        unsigned int timeSlot; // VELES
+        TxStatsInfo() : blockHeight(0), bucketIndex(0), timeSlot(0) {}
     };
 
     // map of txids to information about that transaction
@@ -281,6 +318,7 @@ private:
     std::unique_ptr<TxConfirmStats> feeStats PT_GUARDED_BY(m_cs_fee_estimator);
     std::unique_ptr<TxConfirmStats> shortStats PT_GUARDED_BY(m_cs_fee_estimator);
     std::unique_ptr<TxConfirmStats> longStats PT_GUARDED_BY(m_cs_fee_estimator);
+    std::unique_ptr<TxConfirmStats> timeStats PT_GUARDED_BY(m_cs_fee_estimator); // VELES
 
     // Dash
     std::unique_ptr<TxConfirmStats> priStats PT_GUARDED_BY(m_cs_fee_estimator);
@@ -305,6 +343,12 @@ private:
     unsigned int HistoricalBlockSpan() const EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
     /** Calculation of highest target that reasonable estimate can be provided for */
     unsigned int MaxUsableEstimate() const EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
+    // VELES BEGIN
+    /** Roll the time based data forward to the slot of nTime */
+    void UpdateTimeSlot(int64_t nTime) EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
+    /** Number of time slots of time based data, recorded or read from the data file */
+    unsigned int MaxUsableTimeSlots() const EXCLUSIVE_LOCKS_REQUIRED(m_cs_fee_estimator);
+    // VELES END
 };
 
 class FeeFilterRounder
@@ -217,7 +217,9 @@ unsigned int static DarkGravityWave(const CBlockIndex* pindexLast, const CBlockH
     unsigned int nCountAlgoFastBlocks = 0;
 
     while (nCountBlocks < nPastBlocks && nCountAlgoBlocks < nPastAlgoBlocks) {
-        arith_uint256 bnTarget = arith_uint256().SetCompact(pindex->nBits) / pindex->GetBlockHeader().GetAlgoEfficiency(pindex->nHeight); // convert to normalized target by algo efficiency
+        // VELES BEGIN
+        const arith_uint256& bnTarget = pindex->GetAlgoTarget(); // normalized target by algo efficiency, cached in the block index
+        // VELES END
 
         // calculate algo average
         if (nVersion == (pindex->nVersion & ALGO_VERSION_MASK))
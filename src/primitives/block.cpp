@@ -21,7 +21,10 @@
 // FXTC END
 
 // VELES BEGIN
+#include <crypto/sha256.h>
 #include <versionbits.h>
+
+#include <string.h>
 // VELES END
 
 uint256 CBlockHeader::GetHash() const
@@ -31,6 +34,13 @@ uint256 CBlockHeader::GetHash() const
 
 // FXTC BEGIN
 uint256 CBlockHeader::GetPoWHash() const
+// VELES BEGIN
+{
+    return GetPoWHash(nullptr);
+}
+
+uint256 CBlockHeader::GetPoWHash(const CX16RPlan* pplan) const
+// VELES END
 {
     uint256 powHash = uint256S("ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
 
@@ -48,7 +58,13 @@ uint256 CBlockHeader::GetPoWHash() const
           case ALGO_NIST5:   powHash = NIST5(BEGIN(nVersion), END(nNonce)); break;
           case ALGO_LYRA2Z:  lyra2z_hash(BEGIN(nVersion), BEGIN(powHash)); break;
           case ALGO_X11:     powHash = HashX11(BEGIN(nVersion), END(nNonce)); break;
-          case ALGO_X16R:    powHash = HashX16R(BEGIN(nVersion), END(nNonce), hashPrevBlock); break;
+          // VELES BEGIN
+          //case ALGO_X16R:    powHash = HashX16R(BEGIN(nVersion), END(nNonce), hashPrevBlock); break;
+          case ALGO_X16R:
+              assert(!pplan || pplan->GetPrevBlockHash() == hashPrevBlock);
+              powHash = pplan ? pplan->Hash(BEGIN(nVersion), END(nNonce)) : HashX16R(BEGIN(nVersion), END(nNonce), hashPrevBlock);
+              break;
+          // VELES END
           default:           break; // FXTC TODO: we should not be here
       }
     // VELES BEGIN
@@ -58,6 +74,81 @@ uint256 CBlockHeader::GetPoWHash() const
 }
 // FXTC END
 
+// VELES BEGIN
+void CBlockHeader::GetPoWHashes(const CBlockHeader* const pheaders[], uint256* const phashes[], size_t nCount)
+{
+    if (nCount == 0)
+        return;
+
+    const size_t nHeaderSize = END(pheaders[0]->nNonce) - BEGIN(pheaders[0]->nVersion);
+    std::vector<const unsigned char*> vInputsX11, vInputsX16R;
+    std::vector<const char*> vInputsScrypt;
+    std::vector<char*> vOutputsScrypt;
+    std::vector<uint256> vPrevX16R;
+    std::vector<size_t> vIndexX11, vIndexX16R;
+
+    for (size_t i = 0; i < nCount; i++) {
+        const CBlockHeader& header = *pheaders[i];
+        const bool fVersionBits = (header.nVersion & VERSIONBITS_TOP_MASK) == VERSIONBITS_TOP_BITS;
+        if (!fVersionBits || (header.nVersion & ALGO_VERSION_MASK) == ALGO_SCRYPT) {
+            vInputsScrypt.push_back(BEGIN(header.nVersion));
+            vOutputsScrypt.push_back(BEGIN(*phashes[i]));
+        } else if ((header.nVersion & ALGO_VERSION_MASK) == ALGO_X11) {
+            vInputsX11.push_back(reinterpret_cast<const unsigned char*>(BEGIN(header.nVersion)));
+            vIndexX11.push_back(i);
+        } else if ((header.nVersion & ALGO_VERSION_MASK) == ALGO_X16R) {
+            vInputsX16R.push_back(reinterpret_cast<const unsigned char*>(BEGIN(header.nVersion)));
+            vPrevX16R.push_back(header.hashPrevBlock);
+            vIndexX16R.push_back(i);
+        } else {
+            *phashes[i] = header.GetPoWHash();
+        }
+    }
+
+    scrypt_1024_1_1_256_batch(vInputsScrypt.data(), vOutputsScrypt.data(), vInputsScrypt.size());
+
+    std::vector<uint256> vHashes(vIndexX11.size());
+    HashX11Batch(vInputsX11.data(), nHeaderSize, vHashes.data(), vHashes.size());
+    for (size_t i = 0; i < vIndexX11.size(); i++)
+        *phashes[vIndexX11[i]] = vHashes[i];
+
+    vHashes.resize(vIndexX16R.size());
+    HashX16RBatch(vInputsX16R.data(), nHeaderSize, vPrevX16R.data(), vHashes.data(), vHashes.size());
+    for (size_t i = 0; i < vIndexX16R.size(); i++)
+        *phashes[vIndexX16R[i]] = vHashes[i];
+}
+// VELES END
+
+// VELES BEGIN
+CBlockHeaderMidstate::CBlockHeaderMidstate(const CBlockHeader& header)
+{
+    const unsigned char* begin = reinterpret_cast<const unsigned char*>(BEGIN(header.nVersion));
+    SHA256Midstate(midstate, begin);
+    memcpy(tail, begin + 64, sizeof(tail));
+}
+
+uint256 CBlockHeaderMidstate::GetHash(uint32_t nNonce) const
+{
+    uint256 hash;
+    GetHashes(nNonce, 1, &hash);
+    return hash;
+}
+
+void CBlockHeaderMidstate::GetHashes(uint32_t nNonce, size_t nCount, uint256 hashes[]) const
+{
+    static const size_t BATCH = 8;
+    unsigned char tails[16 * BATCH];
+    for (size_t n = 0; n < nCount; n += BATCH) {
+        const size_t nBatch = std::min(BATCH, nCount - n);
+        for (size_t i = 0; i < nBatch; i++) {
+            memcpy(tails + 16 * i, tail, 12);
+            WriteLE32(tails + 16 * i + 12, nNonce + n + i);
+        }
+        SHA256D80(hashes[n].begin(), midstate, tails, nBatch);
+    }
+}
+// VELES END
+
 unsigned int CBlockHeader::GetAlgoEfficiency(int nBlockHeight) const
 {
     switch (nVersion & ALGO_VERSION_MASK)
@@ -13,6 +13,10 @@
 #include <serialize.h>
 #include <uint256.h>
 
+// VELES BEGIN
+class CX16RPlan;
+// VELES END
+
 // FXTC BEGIN
 // Algo number in nVersion
 enum {
@@ -91,6 +95,16 @@ public:
 
     uint256 GetPoWHash() const;
 
+    // VELES BEGIN
+    /** Same as GetPoWHash(), X16R headers are hashed with pplan (if set) which must have been built for hashPrevBlock */
+    uint256 GetPoWHash(const CX16RPlan* pplan) const;
+    // VELES END
+
+    // VELES BEGIN
+    /** Compute the PoW hashes of nCount headers, scrypt, X11 and X16R headers are hashed through the batch kernels */
+    static void GetPoWHashes(const CBlockHeader* const pheaders[], uint256* const phashes[], size_t nCount);
+    // VELES END
+
     unsigned int GetAlgoEfficiency(int nBlockHeight) const;
 
     int64_t GetBlockTime() const
@@ -99,6 +113,27 @@ public:
     }
 };
 
+// VELES BEGIN
+/** The double SHA256 GetHash() of a block header for any nonce, the SHA256 state
+ *  after the first 64 bytes of the header is computed only once */
+class CBlockHeaderMidstate
+{
+public:
+    explicit CBlockHeaderMidstate(const CBlockHeader& header);
+
+    /** GetHash() of the header with nNonce */
+    uint256 GetHash(uint32_t nNonce) const;
+
+    /** GetHash() of the header with the nCount nonces from nNonce on, several at once with the multi-way kernels */
+    void GetHashes(uint32_t nNonce, size_t nCount, uint256 hashes[]) const;
+
+private:
+    uint32_t midstate[8];
+    //! The last 16 bytes of the header, the nonce in the last 4 of them
+    unsigned char tail[16];
+};
+// VELES END
+
 
 class CBlock : public CBlockHeader
 {
@@ -112,6 +147,10 @@ public:
     mutable std::vector<CTxOut> voutSuperblock; // superblock payment
     //
     mutable bool fChecked;
+    // VELES BEGIN
+    // PoW hash of the header once checked, like fChecked it isn't reset when the header is changed
+    mutable uint256 hashPoW;
+    // VELES END
 
     CBlock()
     {
@@ -139,6 +178,7 @@ public:
         txoutMasternode = CTxOut();
         voutSuperblock.clear();
         fChecked = false;
+        hashPoW.SetNull(); // VELES
     }
 
     CBlockHeader GetBlockHeader() const
@@ -173,3 +173,7 @@ std::string CTransaction::ToString() const
         str += "    " + tx_out.ToString() + "\n";
     return str;
 }
+
+// VELES BEGIN
+thread_local CMonotonicArena* g_tx_arena = nullptr;
+// VELES END
@@ -13,6 +13,7 @@
 #include <amount.h>
 #include <script/script.h>
 #include <serialize.h>
+#include <support/allocators/arena.h> // VELES
 #include <uint256.h>
 
 static const int SERIALIZE_TRANSACTION_NO_WITNESS = 0x40000000;
@@ -448,6 +449,33 @@ typedef std::shared_ptr<const CTransaction> CTransactionRef;
 static inline CTransactionRef MakeTransactionRef() { return std::make_shared<const CTransaction>(); }
 template <typename Tx> static inline CTransactionRef MakeTransactionRef(Tx&& txIn) { return std::make_shared<const CTransaction>(std::forward<Tx>(txIn)); }
 
+// VELES BEGIN
+/** Arena the transactions deserialized on this thread are allocated from, if any */
+extern thread_local CMonotonicArena* g_tx_arena;
+
+/** Allocates the transactions deserialized by the thread from an arena while in scope */
+class CTxArenaScope
+{
+private:
+    CMonotonicArena* const prev;
+
+public:
+    explicit CTxArenaScope(CMonotonicArena& arena) : prev(g_tx_arena) { g_tx_arena = &arena; }
+    ~CTxArenaScope() { g_tx_arena = prev; }
+};
+
+/** Found by argument dependent lookup and preferred over the generic shared_ptr deserialization */
+template<typename Stream>
+void Unserialize(Stream& is, CTransactionRef& p)
+{
+    if (g_tx_arena) {
+        p = std::allocate_shared<CTransaction>(arena_allocator<CTransaction>(*g_tx_arena), deserialize, is);
+    } else {
+        p = std::make_shared<const CTransaction>(deserialize, is);
+    }
+}
+// VELES END
+
 /** Implementation of BIP69
  * https://github.com/bitcoin/bips/blob/master/bip-0069.mediawiki
  */
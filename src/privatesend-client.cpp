@@ -43,12 +43,13 @@ void CPrivateSendClient::ProcessMessage(CNode* pfrom, const std::string& strComm
         vRecv >> dsq;
 
         // process every dsq only once
-        for (auto q : vecDarksendQueue) {
-            if(q == dsq) {
-                // LogPrint(BCLog::PRIVATESEND, "DSQUEUE -- %s seen\n", dsq.ToString());
-                return;
-            }
-        }
+        //for (auto q : vecDarksendQueue) {
+        //    if(q == dsq) {
+        //        // LogPrint(BCLog::PRIVATESEND, "DSQUEUE -- %s seen\n", dsq.ToString());
+        //        return;
+        //    }
+        //}
+        if(indexDarksendQueue.Has(dsq)) return; // VELES
 
         LogPrint(BCLog::PRIVATESEND, "DSQUEUE -- %s new\n", dsq.ToString());
 
@@ -65,24 +66,43 @@ void CPrivateSendClient::ProcessMessage(CNode* pfrom, const std::string& strComm
 
         // if the queue is ready, submit if we can
         if(dsq.fReady) {
-            if(!infoMixingMasternode.fInfoValid) return;
-            if(infoMixingMasternode.addr != infoMn.addr) {
-                LogPrintf("DSQUEUE -- message doesn't match current Masternode: infoMixingMasternode=%s, addr=%s\n", infoMixingMasternode.addr.ToString(), infoMn.addr.ToString());
-                return;
-            }
-
-            if(nState == POOL_STATE_QUEUE) {
-                LogPrint(BCLog::PRIVATESEND, "DSQUEUE -- PrivateSend queue (%s) is ready on masternode %s\n", dsq.ToString(), infoMn.addr.ToString());
-                SubmitDenominate(connman);
-            }
-        } else {
-            for (auto q : vecDarksendQueue) {
-                if(q.vin == dsq.vin) {
-                    // no way same mn can send another "not yet ready" dsq this soon
-                    LogPrint(BCLog::PRIVATESEND, "DSQUEUE -- Masternode %s is sending WAY too many dsq messages\n", infoMn.addr.ToString());
+            //if(!infoMixingMasternode.fInfoValid) return;
+            //if(infoMixingMasternode.addr != infoMn.addr) {
+            //    LogPrintf("DSQUEUE -- message doesn't match current Masternode: infoMixingMasternode=%s, addr=%s\n", infoMixingMasternode.addr.ToString(), infoMn.addr.ToString());
+            //    return;
+            //}
+            //
+            //if(nState == POOL_STATE_QUEUE) {
+            //    LogPrint(BCLog::PRIVATESEND, "DSQUEUE -- PrivateSend queue (%s) is ready on masternode %s\n", dsq.ToString(), infoMn.addr.ToString());
+            //    SubmitDenominate(connman);
+            //}
+            // VELES BEGIN
+            LOCK(cs_deqsessions);
+            for (auto& session : deqSessions) {
+                if(session.IsMixingMasternode(infoMn.addr)) {
+                    LogPrint(BCLog::PRIVATESEND, "DSQUEUE -- PrivateSend queue (%s) is ready on masternode %s\n", dsq.ToString(), infoMn.addr.ToString());
+                    session.OnQueueReady(connman);
+                    UpdateMixingMasternodes();
                     return;
                 }
             }
+            LogPrint(BCLog::PRIVATESEND, "DSQUEUE -- no session is mixing on masternode %s\n", infoMn.addr.ToString());
+            // VELES END
+        } else {
+            //for (auto q : vecDarksendQueue) {
+            //    if(q.vin == dsq.vin) {
+            //        // no way same mn can send another "not yet ready" dsq this soon
+            //        LogPrint(BCLog::PRIVATESEND, "DSQUEUE -- Masternode %s is sending WAY too many dsq messages\n", infoMn.addr.ToString());
+            //        return;
+            //    }
+            //}
+            // VELES BEGIN
+            if(indexDarksendQueue.HasMasternode(dsq.vin.prevout)) {
+                // no way same mn can send another "not yet ready" dsq this soon
+                LogPrint(BCLog::PRIVATESEND, "DSQUEUE -- Masternode %s is sending WAY too many dsq messages\n", infoMn.addr.ToString());
+                return;
+            }
+            // VELES END
 
             int nThreshold = infoMn.nLastDsq + mnodeman.CountEnabled(MIN_PRIVATESEND_PEER_PROTO_VERSION)/5;
             LogPrint(BCLog::PRIVATESEND, "DSQUEUE -- nLastDsq: %d  threshold: %d  nDsqCount: %d\n", infoMn.nLastDsq, nThreshold, mnodeman.nDsqCount);
@@ -95,14 +115,33 @@ void CPrivateSendClient::ProcessMessage(CNode* pfrom, const std::string& strComm
             if(!mnodeman.AllowMixing(dsq.vin.prevout)) return;
 
             LogPrint(BCLog::PRIVATESEND, "DSQUEUE -- new PrivateSend queue (%s) from masternode %s\n", dsq.ToString(), infoMn.addr.ToString());
-            if(infoMixingMasternode.fInfoValid && infoMixingMasternode.vin.prevout == dsq.vin.prevout) {
+            //if(infoMixingMasternode.fInfoValid && infoMixingMasternode.vin.prevout == dsq.vin.prevout) {
+            if(IsMasternodeInUse(infoMn.addr)) { // VELES
                 dsq.fTried = true;
             }
-            vecDarksendQueue.push_back(dsq);
+            //vecDarksendQueue.push_back(dsq);
+            indexDarksendQueue.Add(dsq); // VELES
             dsq.Relay(connman);
         }
 
-    } else if(strCommand == NetMsgType::DSSTATUSUPDATE) {
+    // VELES BEGIN
+    } else if(strCommand == NetMsgType::DSSTATUSUPDATE || strCommand == NetMsgType::DSFINALTX || strCommand == NetMsgType::DSCOMPLETE) {
+        // every session talks to its own Masternode
+        LOCK(cs_deqsessions);
+        for (auto& session : deqSessions) {
+            if(session.IsMixingMasternode(pfrom->addr)) {
+                session.ProcessMessage(pfrom, strCommand, vRecv, connman);
+                break;
+            }
+        }
+        UpdateMixingMasternodes();
+    }
+}
+
+void CPrivateSendClientSession::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman)
+{
+    if(strCommand == NetMsgType::DSSTATUSUPDATE) {
+    // VELES END
 
         if(pfrom->nVersion < MIN_PRIVATESEND_PEER_PROTO_VERSION) {
             LogPrintf("DSSTATUSUPDATE -- incompatible version! nVersion: %d\n", pfrom->nVersion);
@@ -209,14 +248,32 @@ void CPrivateSendClient::ProcessMessage(CNode* pfrom, const std::string& strComm
 void CPrivateSendClient::ResetPool()
 {
     nCachedLastSuccessBlock = 0;
-    txMyCollateral = CMutableTransaction();
+    //txMyCollateral = CMutableTransaction();
     vecMasternodesUsed.clear();
+    //UnlockCoins();
+    //keyHolderStorage.ReturnAll();
+    //SetNull();
+    // VELES BEGIN
+    LOCK(cs_deqsessions);
+    for (auto& session : deqSessions) {
+        session.ResetPool();
+    }
+    deqSessions.clear();
+    UpdateMixingMasternodes();
+    // VELES END
+}
+
+// VELES BEGIN
+void CPrivateSendClientSession::ResetPool()
+{
+    txMyCollateral = CMutableTransaction();
     UnlockCoins();
     keyHolderStorage.ReturnAll();
     SetNull();
 }
+// VELES END
 
-void CPrivateSendClient::SetNull()
+void CPrivateSendClientSession::SetNull()
 {
     // Client side
     nEntriesCount = 0;
@@ -229,7 +286,17 @@ void CPrivateSendClient::SetNull()
 //
 // Unlock coins after mixing fails or succeeds
 //
+// VELES BEGIN
 void CPrivateSendClient::UnlockCoins()
+{
+    LOCK(cs_deqsessions);
+    for (auto& session : deqSessions) {
+        session.UnlockCoins();
+    }
+}
+// VELES END
+
+void CPrivateSendClientSession::UnlockCoins()
 {
     while(true) {
         std::vector<std::shared_ptr<CWallet>> wallets = GetWallets();
@@ -245,14 +312,33 @@ void CPrivateSendClient::UnlockCoins()
     vecOutPointLocked.clear();
 }
 
+// VELES BEGIN
 std::string CPrivateSendClient::GetStatus()
+{
+    if(WaitForAnotherBlock() || !masternodeSync.IsBlockchainSynced())
+        return strAutoDenomResult;
+
+    LOCK(cs_deqsessions);
+    if(deqSessions.empty())
+        return _("PrivateSend is idle.");
+
+    std::string strStatus;
+    for (auto& session : deqSessions) {
+        if(!strStatus.empty()) strStatus += "; ";
+        strStatus += session.GetStatus();
+    }
+    return strStatus;
+}
+// VELES END
+
+std::string CPrivateSendClientSession::GetStatus()
 {
     static int nStatusMessageProgress = 0;
     nStatusMessageProgress += 10;
     std::string strSuffix = "";
 
-    if(WaitForAnotherBlock() || !masternodeSync.IsBlockchainSynced())
-        return strAutoDenomResult;
+    //if(WaitForAnotherBlock() || !masternodeSync.IsBlockchainSynced())
+    //    return strAutoDenomResult;
 
     switch(nState) {
         case POOL_STATE_IDLE:
@@ -294,21 +380,87 @@ std::string CPrivateSendClient::GetStatus()
     }
 }
 
-bool CPrivateSendClient::GetMixingMasternodeInfo(masternode_info_t& mnInfoRet)
+//bool CPrivateSendClient::GetMixingMasternodeInfo(masternode_info_t& mnInfoRet)
+//{
+//    mnInfoRet = infoMixingMasternode.fInfoValid ? infoMixingMasternode : masternode_info_t();
+//    return infoMixingMasternode.fInfoValid;
+//}
+//
+//bool CPrivateSendClient::IsMixingMasternode(const CNode* pnode)
+//{
+//    return infoMixingMasternode.fInfoValid && pnode->addr == infoMixingMasternode.addr;
+//}
+// VELES BEGIN
+bool CPrivateSendClientSession::GetMixingMasternodeInfo(masternode_info_t& mnInfoRet) const
 {
     mnInfoRet = infoMixingMasternode.fInfoValid ? infoMixingMasternode : masternode_info_t();
     return infoMixingMasternode.fInfoValid;
 }
 
+bool CPrivateSendClient::GetMixingMasternodeInfo(masternode_info_t& mnInfoRet)
+{
+    LOCK(cs_deqsessions);
+    for (const auto& session : deqSessions) {
+        if(session.GetMixingMasternodeInfo(mnInfoRet)) return true;
+    }
+    mnInfoRet = masternode_info_t();
+    return false;
+}
+
+bool CPrivateSendClient::GetMixingMasternodesInfo(std::vector<masternode_info_t>& vecMnInfoRet) const
+{
+    LOCK(cs_deqsessions);
+    vecMnInfoRet.clear();
+    for (const auto& session : deqSessions) {
+        masternode_info_t mnInfo;
+        if(session.GetMixingMasternodeInfo(mnInfo)) vecMnInfoRet.push_back(mnInfo);
+    }
+    return !vecMnInfoRet.empty();
+}
+
+int CPrivateSendClient::GetActiveSessions() const
+{
+    LOCK(cs_deqsessions);
+    int nActive = 0;
+    for (const auto& session : deqSessions) {
+        if(!session.IsIdle()) nActive++;
+    }
+    return nActive;
+}
+
+bool CPrivateSendClient::IsMasternodeInUse(const CService& addr) const
+{
+    LOCK(cs_deqsessions);
+    for (const auto& session : deqSessions) {
+        if(session.IsMixingMasternode(addr)) return true;
+    }
+    return false;
+}
+
+void CPrivateSendClient::UpdateMixingMasternodes()
+{
+    AssertLockHeld(cs_deqsessions);
+    std::set<CService> setAddr;
+    for (const auto& session : deqSessions) {
+        masternode_info_t mnInfo;
+        if(session.GetMixingMasternodeInfo(mnInfo)) setAddr.insert(mnInfo.addr);
+    }
+    LOCK(cs_mixingmasternodes);
+    setMixingMasternodes.swap(setAddr);
+}
+
+// Called by the masternode manager with the nodes locked, so don't wait for the sessions here
 bool CPrivateSendClient::IsMixingMasternode(const CNode* pnode)
 {
-    return infoMixingMasternode.fInfoValid && pnode->addr == infoMixingMasternode.addr;
+    LOCK(cs_mixingmasternodes);
+    return setMixingMasternodes.count(pnode->addr) > 0;
 }
+// VELES END
 
 //
 // Check the mixing progress and send client updates if a Masternode
 //
-void CPrivateSendClient::CheckPool()
+void CPrivateSendClientSession::CheckPool()
 {
     // reset if we're here for 10 seconds
     if((nState == POOL_STATE_ERROR || nState == POOL_STATE_SUCCESS) && GetTimeMillis() - nTimeLastSuccessfulStep >= 10000) {
@@ -326,12 +478,27 @@ void CPrivateSendClient::CheckPool()
 //
 // Check for various timeouts (queue objects, mixing, etc)
 //
+// VELES BEGIN
 void CPrivateSendClient::CheckTimeout()
 {
     CheckQueue();
 
     if(!fEnablePrivateSend && !fMasterNode) return;
 
+    LOCK(cs_deqsessions);
+    for (auto& session : deqSessions) {
+        session.CheckTimeout();
+    }
+    UpdateMixingMasternodes();
+}
+// VELES END
+
+void CPrivateSendClientSession::CheckTimeout()
+{
+    //CheckQueue();
+
+    //if(!fEnablePrivateSend && !fMasterNode) return;
+
     // catching hanging sessions
     if(!fMasterNode) {
         switch(nState) {
@@ -367,7 +534,7 @@ void CPrivateSendClient::CheckTimeout()
 // Execute a mixing denomination via a Masternode.
 // This is only ran from clients
 //
-bool CPrivateSendClient::SendDenominate(const std::vector<CTxDSIn>& vecTxDSIn, const std::vector<CTxOut>& vecTxOut, CConnman& connman)
+bool CPrivateSendClientSession::SendDenominate(const std::vector<CTxDSIn>& vecTxDSIn, const std::vector<CTxOut>& vecTxOut, CConnman& connman)
 {
     if(fMasterNode) {
         LogPrintf("CPrivateSendClient::SendDenominate -- PrivateSend from a Masternode is not supported currently.\n");
@@ -380,8 +547,9 @@ bool CPrivateSendClient::SendDenominate(const std::vector<CTxDSIn>& vecTxDSIn, c
     }
 
     // lock the funds we're going to use
-    for (auto txin : txMyCollateral.vin)
-        vecOutPointLocked.push_back(txin.prevout);
+    //for (auto txin : txMyCollateral.vin)
+    //    vecOutPointLocked.push_back(txin.prevout);
+    // VELES: the collateral is locked since we connected to the Masternode
 
     for (const auto& txdsin : vecTxDSIn)
         vecOutPointLocked.push_back(txdsin.prevout);
@@ -399,7 +567,7 @@ bool CPrivateSendClient::SendDenominate(const std::vector<CTxDSIn>& vecTxDSIn, c
         UnlockCoins();
         keyHolderStorage.ReturnAll();
         SetNull();
-        fEnablePrivateSend = false;
+        privateSendClient.fEnablePrivateSend = false; // VELES
         LogPrintf("CPrivateSendClient::SendDenominate -- Not enough disk space, disabling PrivateSend.\n");
         return false;
     }
@@ -448,7 +616,7 @@ bool CPrivateSendClient::SendDenominate(const std::vector<CTxDSIn>& vecTxDSIn, c
 }
 
 // Incoming message from Masternode updating the progress of mixing
-bool CPrivateSendClient::CheckPoolStateUpdate(PoolState nStateNew, int nEntriesCountNew, PoolStatusUpdate nStatusUpdate, PoolMessage nMessageID, int nSessionIDNew)
+bool CPrivateSendClientSession::CheckPoolStateUpdate(PoolState nStateNew, int nEntriesCountNew, PoolStatusUpdate nStatusUpdate, PoolMessage nMessageID, int nSessionIDNew)
 {
     if(fMasterNode) return false;
 
@@ -494,7 +662,7 @@ bool CPrivateSendClient::CheckPoolStateUpdate(PoolState nStateNew, int nEntriesC
 // check it to make sure it's what we want, then sign it if we agree.
 // If we refuse to sign, it's possible we'll be charged collateral
 //
-bool CPrivateSendClient::SignFinalTransaction(const CMutableTransaction& finalTransactionNew, CNode* pnode, CConnman& connman)
+bool CPrivateSendClientSession::SignFinalTransaction(const CMutableTransaction& finalTransactionNew, CNode* pnode, CConnman& connman)
 {
     if(fMasterNode || pnode == NULL) return false;
 
@@ -595,13 +763,14 @@ bool CPrivateSendClient::SignFinalTransaction(const CMutableTransaction& finalTr
 }
 
 // mixing transaction was completed (failed or successful)
-void CPrivateSendClient::CompletedTransaction(PoolMessage nMessageID)
+void CPrivateSendClientSession::CompletedTransaction(PoolMessage nMessageID)
 {
     if(fMasterNode) return;
 
     if(nMessageID == MSG_SUCCESS) {
         LogPrintf("CompletedTransaction -- success\n");
-        nCachedLastSuccessBlock = nCachedBlockHeight;
+        //nCachedLastSuccessBlock = nCachedBlockHeight;
+        privateSendClient.nCachedLastSuccessBlock = privateSendClient.nCachedBlockHeight; // VELES
         keyHolderStorage.KeepAll();
     } else {
         LogPrintf("CompletedTransaction -- error\n");
@@ -704,7 +873,7 @@ bool CPrivateSendClient::DoAutomaticDenominating(CConnman& connman, bool fDryRun
     std::vector<std::shared_ptr<CWallet>> wallets = GetWallets();
     CWallet * const pwallet = (wallets.size() > 0) ? wallets[0].get() : nullptr;
     if(!pwallet || pwallet->IsLocked(true)) return false;
-    if(nState != POOL_STATE_IDLE) return false;
+    //if(nState != POOL_STATE_IDLE) return false;
 
     if(!masternodeSync.IsMasternodeListSynced()) {
         strAutoDenomResult = _("Can't mix while sync in progress.");
@@ -714,10 +883,10 @@ bool CPrivateSendClient::DoAutomaticDenominating(CConnman& connman, bool fDryRun
     if(!CheckAutomaticBackup())
         return false;
 
-    if(GetEntriesCount() > 0) {
-        strAutoDenomResult = _("Mixing in progress...");
-        return false;
-    }
+    //if(GetEntriesCount() > 0) {
+    //    strAutoDenomResult = _("Mixing in progress...");
+    //    return false;
+    //}
 
     TRY_LOCK(cs_darksend, lockDS);
     if(!lockDS) {
@@ -787,17 +956,12 @@ bool CPrivateSendClient::DoAutomaticDenominating(CConnman& connman, bool fDryRun
     if(!pwallet->HasCollateralInputs())
         return !pwallet->HasCollateralInputs(false) && MakeCollateralAmounts(connman);
 
-    if(nSessionID) {
-        strAutoDenomResult = _("Mixing in progress...");
-        return false;
-    }
-
-    // Initial phase, find a Masternode
-    // Clean if there is anything left from previous session
-    UnlockCoins();
-    keyHolderStorage.ReturnAll();
-    SetNull();
+    //if(nSessionID) {
+    //    strAutoDenomResult = _("Mixing in progress...");
+    //    return false;
+    //}
 
+    // VELES BEGIN
     // should be no unconfirmed denoms in non-multi-session mode
     if(!fPrivateSendMultiSession && nBalanceDenominatedUnconf > 0) {
         LogPrintf("CPrivateSendClient::DoAutomaticDenominating -- Found unconfirmed denominated outputs, will wait till they confirm to continue.\n");
@@ -805,23 +969,6 @@ bool CPrivateSendClient::DoAutomaticDenominating(CConnman& connman, bool fDryRun
         return false;
     }
 
-    //check our collateral and create new if needed
-    std::string strReason;
-    if(txMyCollateral == CMutableTransaction()) {
-        if(!pwallet->CreateCollateralTransaction(txMyCollateral, strReason)) {
-            LogPrintf("CPrivateSendClient::DoAutomaticDenominating -- create collateral error:%s\n", strReason);
-            return false;
-        }
-    } else {
-        if(!CPrivateSend::IsCollateralValid(txMyCollateral)) {
-            LogPrintf("CPrivateSendClient::DoAutomaticDenominating -- invalid collateral, recreating...\n");
-            if(!pwallet->CreateCollateralTransaction(txMyCollateral, strReason)) {
-                LogPrintf("CPrivateSendClient::DoAutomaticDenominating -- create collateral error: %s\n", strReason);
-                return false;
-            }
-        }
-    }
-
     int nMnCountEnabled = mnodeman.CountEnabled(MIN_PRIVATESEND_PEER_PROTO_VERSION);
 
     // If we've used 90% of the Masternode list then drop the oldest first ~30%
@@ -834,13 +981,77 @@ bool CPrivateSendClient::DoAutomaticDenominating(CConnman& connman, bool fDryRun
         LogPrint(BCLog::PRIVATESEND, "  vecMasternodesUsed: new size: %d, threshold: %d\n", (int)vecMasternodesUsed.size(), nThreshold_high);
     }
 
+    // Start every idle session, each of them finds its own Masternode
+    LOCK(cs_deqsessions);
+    while((int)deqSessions.size() < nPrivateSendSessions)
+        deqSessions.emplace_back();
+
+    int nStarted = 0;
+    for (auto& session : deqSessions) {
+        if(!session.IsIdle()) continue;
+        // every session uses keys, the backup must still be fine
+        if(!CheckAutomaticBackup()) break;
+        if(session.DoAutomaticDenominating(nValueMin, nBalanceNeedsAnonymized, connman)) {
+            nStarted++;
+        } else {
+            // the others would fail for the same reason
+            strAutoDenomResult = session.strAutoDenomResult;
+            break;
+        }
+    }
+    UpdateMixingMasternodes();
+
+    if(nStarted == 0 && GetActiveSessions() > 0) {
+        strAutoDenomResult = _("Mixing in progress...");
+    }
+    LogPrint(BCLog::PRIVATESEND, "CPrivateSendClient::DoAutomaticDenominating -- started %d sessions, %d of %d active\n", nStarted, GetActiveSessions(), (int)deqSessions.size());
+
+    return nStarted > 0;
+}
+
+bool CPrivateSendClientSession::DoAutomaticDenominating(CAmount nValueMin, CAmount nBalanceNeedsAnonymized, CConnman& connman)
+{
+    std::vector<std::shared_ptr<CWallet>> wallets = GetWallets();
+    CWallet * const pwallet = (wallets.size() > 0) ? wallets[0].get() : nullptr;
+    if(!pwallet) return false;
+    // VELES END
+
+    // Initial phase, find a Masternode
+    // Clean if there is anything left from previous session
+    UnlockCoins();
+    keyHolderStorage.ReturnAll();
+    SetNull();
+
+    // should be no unconfirmed denoms in non-multi-session mode
+    //if(!fPrivateSendMultiSession && nBalanceDenominatedUnconf > 0) {
+    //    LogPrintf("CPrivateSendClient::DoAutomaticDenominating -- Found unconfirmed denominated outputs, will wait till they confirm to continue.\n");
+    //    strAutoDenomResult = _("Found unconfirmed denominated outputs, will wait till they confirm to continue.");
+    //    return false;
+    //}
+
+    //check our collateral and create new if needed
+    if(!CheckCollateral(pwallet)) // VELES
+        return false;
+
+    //int nMnCountEnabled = mnodeman.CountEnabled(MIN_PRIVATESEND_PEER_PROTO_VERSION);
+
+    // If we've used 90% of the Masternode list then drop the oldest first ~30%
+    //int nThreshold_high = nMnCountEnabled * 0.9;
+    //int nThreshold_low = nThreshold_high * 0.7;
+    //LogPrint(BCLog::PRIVATESEND, "Checking vecMasternodesUsed: size: %d, threshold: %d\n", (int)vecMasternodesUsed.size(), nThreshold_high);
+
+    //if((int)vecMasternodesUsed.size() > nThreshold_high) {
+    //    vecMasternodesUsed.erase(vecMasternodesUsed.begin(), vecMasternodesUsed.begin() + vecMasternodesUsed.size() - nThreshold_low);
+    //    LogPrint(BCLog::PRIVATESEND, "  vecMasternodesUsed: new size: %d, threshold: %d\n", (int)vecMasternodesUsed.size(), nThreshold_high);
+    //}
+
     bool fUseQueue = GetRandInt(100) > 33;
     // don't use the queues all of the time for mixing unless we are a liquidity provider
-    if((nLiquidityProvider || fUseQueue) && JoinExistingQueue(nBalanceNeedsAnonymized, connman))
+    if((privateSendClient.nLiquidityProvider || fUseQueue) && JoinExistingQueue(nBalanceNeedsAnonymized, connman)) // VELES
         return true;
 
     // do not initiate queue if we are a liquidity provider to avoid useless inter-mixing
-    if(nLiquidityProvider) return false;
+    if(privateSendClient.nLiquidityProvider) return false; // VELES
 
     if(StartNewQueue(nValueMin, nBalanceNeedsAnonymized, connman))
         return true;
@@ -849,17 +1060,88 @@ bool CPrivateSendClient::DoAutomaticDenominating(CConnman& connman, bool fDryRun
     return false;
 }
 
-bool CPrivateSendClient::JoinExistingQueue(CAmount nBalanceNeedsAnonymized, CConnman& connman)
+// VELES BEGIN
+bool CPrivateSendClientSession::CheckCollateral(CWallet* pwallet)
+{
+    // our collateral inputs were unlocked at the end of the last session, another session may use them now
+    bool fCollateralInUse = false;
+    {
+        LOCK(pwallet->cs_wallet);
+        for (const auto& txin : txMyCollateral.vin) {
+            if(pwallet->IsLockedCoin(txin.prevout.hash, txin.prevout.n)) fCollateralInUse = true;
+        }
+    }
+
+    std::string strReason;
+    if(txMyCollateral == CMutableTransaction()) {
+        if(!pwallet->CreateCollateralTransaction(txMyCollateral, strReason)) {
+            LogPrintf("CPrivateSendClientSession::DoAutomaticDenominating -- create collateral error:%s\n", strReason);
+            strAutoDenomResult = _("Can't create a collateral transaction.");
+            return false;
+        }
+    } else if(fCollateralInUse || !CPrivateSend::IsCollateralValid(txMyCollateral)) {
+        LogPrintf("CPrivateSendClientSession::DoAutomaticDenominating -- invalid or used collateral, recreating...\n");
+        if(!pwallet->CreateCollateralTransaction(txMyCollateral, strReason)) {
+            LogPrintf("CPrivateSendClientSession::DoAutomaticDenominating -- create collateral error: %s\n", strReason);
+            strAutoDenomResult = _("Can't create a collateral transaction.");
+            return false;
+        }
+    }
+    return true;
+}
+
+void CPrivateSendClientSession::LockCollateral(CWallet* pwallet)
+{
+    LOCK(pwallet->cs_wallet);
+    for (const auto& txin : txMyCollateral.vin) {
+        pwallet->LockCoin(txin.prevout);
+        vecOutPointLocked.push_back(txin.prevout);
+    }
+}
+
+void CPrivateSendClientSession::OnQueueReady(CConnman& connman)
+{
+    if(nState == POOL_STATE_QUEUE) {
+        SubmitDenominate(connman);
+    }
+}
+// VELES END
+
+bool CPrivateSendClientSession::JoinExistingQueue(CAmount nBalanceNeedsAnonymized, CConnman& connman)
 {
     std::vector<std::shared_ptr<CWallet>> wallets = GetWallets();
     CWallet * const pwallet = (wallets.size() > 0) ? wallets[0].get() : nullptr;
 
     std::vector<CAmount> vecStandardDenoms = CPrivateSend::GetStandardDenominations();
     // Look through the queues and see if anything matches
-    for (auto& dsq : vecDarksendQueue) {
+    //for (auto& dsq : vecDarksendQueue) {
+    //    // only try each queue once
+    //    if(dsq.fTried) continue;
+    //    dsq.fTried = true;
+    // VELES BEGIN
+    // The queues are indexed by denomination, our coins are matched once per denomination
+    for (int nDenom : privateSendClient.indexDarksendQueue.GetUntriedDenominations()) {
+        std::vector<int> vecBits;
+        if(!CPrivateSend::GetDenominationsBits(nDenom, vecBits)) {
+            // incompatible denom
+            continue;
+        }
+
+        CAmount nValueInTmp = 0;
+        std::vector<CTxDSIn> vecTxDSInTmp;
+        std::vector<COutput> vCoinsTmp;
+
+        // Try to match their denominations if possible, select at least 1 denominations
+        // the queues are left untried, our coins may match them later
+        if(!pwallet->SelectCoinsByDenominations(nDenom, vecStandardDenoms[vecBits.front()], nBalanceNeedsAnonymized, vecTxDSInTmp, vCoinsTmp, nValueInTmp, 0, privateSendClient.nPrivateSendRounds)) {
+            LogPrint(BCLog::PRIVATESEND, "CPrivateSendClient::JoinExistingQueue -- Couldn't match denominations %d %d (%s)\n", vecBits.front(), nDenom, CPrivateSend::GetDenominationsToString(nDenom));
+            continue;
+        }
+
         // only try each queue once
-        if(dsq.fTried) continue;
-        dsq.fTried = true;
+        CDarksendQueue dsq;
+        while(privateSendClient.indexDarksendQueue.PopUntried(nDenom, dsq)) {
+    // VELES END
 
         if(dsq.IsExpired()) continue;
 
@@ -872,29 +1154,35 @@ bool CPrivateSendClient::JoinExistingQueue(CAmount nBalanceNeedsAnonymized, CCon
 
         if(infoMn.nProtocolVersion < MIN_PRIVATESEND_PEER_PROTO_VERSION) continue;
 
-        std::vector<int> vecBits;
-        if(!CPrivateSend::GetDenominationsBits(dsq.nDenom, vecBits)) {
-            // incompatible denom
-            continue;
-        }
+        // VELES BEGIN
+        // another session is mixing on this one already
+        if(privateSendClient.IsMasternodeInUse(infoMn.addr)) continue;
+        // VELES END
+
+        //std::vector<int> vecBits;
+        //if(!CPrivateSend::GetDenominationsBits(dsq.nDenom, vecBits)) {
+        //    // incompatible denom
+        //    continue;
+        //}
 
         // mixing rate limit i.e. nLastDsq check should already pass in DSQUEUE ProcessMessage
-        // in order for dsq to get into vecDarksendQueue, so we should be safe to mix already,
+        // in order for dsq to get into indexDarksendQueue, so we should be safe to mix already,
         // no need for additional verification here
 
         LogPrint(BCLog::PRIVATESEND, "CPrivateSendClient::JoinExistingQueue -- found valid queue: %s\n", dsq.ToString());
 
-        CAmount nValueInTmp = 0;
-        std::vector<CTxDSIn> vecTxDSInTmp;
-        std::vector<COutput> vCoinsTmp;
+        //CAmount nValueInTmp = 0;
+        //std::vector<CTxDSIn> vecTxDSInTmp;
+        //std::vector<COutput> vCoinsTmp;
 
         // Try to match their denominations if possible, select at least 1 denominations
-        if(!pwallet->SelectCoinsByDenominations(dsq.nDenom, vecStandardDenoms[vecBits.front()], nBalanceNeedsAnonymized, vecTxDSInTmp, vCoinsTmp, nValueInTmp, 0, nPrivateSendRounds)) {
-            LogPrintf("CPrivateSendClient::JoinExistingQueue -- Couldn't match denominations %d %d (%s)\n", vecBits.front(), dsq.nDenom, CPrivateSend::GetDenominationsToString(dsq.nDenom));
-            continue;
-        }
+        //if(!pwallet->SelectCoinsByDenominations(dsq.nDenom, vecStandardDenoms[vecBits.front()], nBalanceNeedsAnonymized, vecTxDSInTmp, vCoinsTmp, nValueInTmp, 0, nPrivateSendRounds)) {
+        //    LogPrintf("CPrivateSendClient::JoinExistingQueue -- Couldn't match denominations %d %d (%s)\n", vecBits.front(), dsq.nDenom, CPrivateSend::GetDenominationsToString(dsq.nDenom));
+        //    continue;
+        //}
 
-        vecMasternodesUsed.push_back(dsq.vin.prevout);
+        //vecMasternodesUsed.push_back(dsq.vin.prevout);
+        privateSendClient.vecMasternodesUsed.push_back(dsq.vin.prevout); // VELES
 
         // FXTC TODO:
         if (connman.ForNode(infoMn.addr, CConnman::AllNodesExceptMasternodes)) {
@@ -906,11 +1194,13 @@ bool CPrivateSendClient::JoinExistingQueue(CAmount nBalanceNeedsAnonymized, CCon
         // connect to Masternode and submit the queue request
         // FXTC BEGIN
         //CNode* pnode = connman.ConnectNode(CAddress(infoMn.addr, NODE_NETWORK), NULL, false, true);
-        CNode *pnode = g_connman->OpenNetworkConnection(CAddress(infoMn.addr, NODE_NETWORK), false, nullptr, NULL, false, false, false, true);
+        //CNode *pnode = g_connman->OpenNetworkConnection(CAddress(infoMn.addr, NODE_NETWORK), false, nullptr, NULL, false, false, false, true);
         // FXTC END
+        CNode* pnode = connman.ConnectMasternode(CAddress(infoMn.addr, NODE_NETWORK)); // VELES
         if(pnode) {
             infoMixingMasternode = infoMn;
             nSessionDenom = dsq.nDenom;
+            LockCollateral(pwallet); // VELES
 
             connman.PushMessage(pnode, CNetMsgMaker(pnode->GetSendVersion()).Make(NetMsgType::DSACCEPT, nSessionDenom, txMyCollateral));
             LogPrintf("CPrivateSendClient::JoinExistingQueue -- connected (from queue), sending DSACCEPT: nSessionDenom: %d (%s), addr=%s\n",
@@ -924,11 +1214,12 @@ bool CPrivateSendClient::JoinExistingQueue(CAmount nBalanceNeedsAnonymized, CCon
             strAutoDenomResult = _("Error connecting to Masternode.");
             continue;
         }
+        } // VELES
     }
     return false;
 }
 
-bool CPrivateSendClient::StartNewQueue(CAmount nValueMin, CAmount nBalanceNeedsAnonymized, CConnman& connman)
+bool CPrivateSendClientSession::StartNewQueue(CAmount nValueMin, CAmount nBalanceNeedsAnonymized, CConnman& connman)
 {
     int nTries = 0;
     int nMnCountEnabled = mnodeman.CountEnabled(MIN_PRIVATESEND_PEER_PROTO_VERSION);
@@ -939,7 +1230,8 @@ bool CPrivateSendClient::StartNewQueue(CAmount nValueMin, CAmount nBalanceNeedsA
 
     std::vector<std::shared_ptr<CWallet>> wallets = GetWallets();
     CWallet * const pwallet = (wallets.size() > 0) ? wallets[0].get() : nullptr;
-    if(!pwallet->SelectCoinsDark(nValueMin, nBalanceNeedsAnonymized, vecTxIn, nValueInTmp, 0, nPrivateSendRounds)) {
+    //if(!pwallet->SelectCoinsDark(nValueMin, nBalanceNeedsAnonymized, vecTxIn, nValueInTmp, 0, nPrivateSendRounds)) {
+    if(!pwallet->SelectCoinsDark(nValueMin, nBalanceNeedsAnonymized, vecTxIn, nValueInTmp, 0, privateSendClient.nPrivateSendRounds)) { // VELES
         // this should never happen
         LogPrintf("CPrivateSendClient::StartNewQueue -- Can't mix: no compatible inputs found!\n");
         strAutoDenomResult = _("Can't mix: no compatible inputs found!");
@@ -948,13 +1240,23 @@ bool CPrivateSendClient::StartNewQueue(CAmount nValueMin, CAmount nBalanceNeedsA
 
     // otherwise, try one randomly
     while(nTries < 10) {
-        masternode_info_t infoMn = mnodeman.FindRandomNotInVec(vecMasternodesUsed, MIN_PRIVATESEND_PEER_PROTO_VERSION);
+        //masternode_info_t infoMn = mnodeman.FindRandomNotInVec(vecMasternodesUsed, MIN_PRIVATESEND_PEER_PROTO_VERSION);
+        masternode_info_t infoMn = mnodeman.FindRandomNotInVec(privateSendClient.vecMasternodesUsed, MIN_PRIVATESEND_PEER_PROTO_VERSION); // VELES
         if(!infoMn.fInfoValid) {
             LogPrintf("CPrivateSendClient::StartNewQueue -- Can't find random masternode!\n");
             strAutoDenomResult = _("Can't find random Masternode.");
             return false;
         }
-        vecMasternodesUsed.push_back(infoMn.vin.prevout);
+        //vecMasternodesUsed.push_back(infoMn.vin.prevout);
+        privateSendClient.vecMasternodesUsed.push_back(infoMn.vin.prevout); // VELES
+
+        // VELES BEGIN
+        // another session is mixing on this one already
+        if(privateSendClient.IsMasternodeInUse(infoMn.addr)) {
+            nTries++;
+            continue;
+        }
+        // VELES END
 
         if(infoMn.nLastDsq != 0 && infoMn.nLastDsq + nMnCountEnabled/5 > mnodeman.nDsqCount) {
             LogPrintf("CPrivateSendClient::StartNewQueue -- Too early to mix on this masternode!" /* Continued */
@@ -975,11 +1277,13 @@ bool CPrivateSendClient::StartNewQueue(CAmount nValueMin, CAmount nBalanceNeedsA
         LogPrintf("CPrivateSendClient::StartNewQueue -- attempt %d connection to Masternode %s\n", nTries, infoMn.addr.ToString());
         // FXTC BEGIN
         //CNode* pnode = connman.ConnectNode(CAddress(infoMn.addr, NODE_NETWORK), NULL, false, true);
-        CNode *pnode = g_connman->OpenNetworkConnection(CAddress(infoMn.addr, NODE_NETWORK), false, nullptr, NULL, false, false, false, true);
+        //CNode *pnode = g_connman->OpenNetworkConnection(CAddress(infoMn.addr, NODE_NETWORK), false, nullptr, NULL, false, false, false, true);
         // FXTC END
+        CNode* pnode = connman.ConnectMasternode(CAddress(infoMn.addr, NODE_NETWORK)); // VELES
         if(pnode) {
             LogPrintf("CPrivateSendClient::StartNewQueue -- connected, addr=%s\n", infoMn.addr.ToString());
             infoMixingMasternode = infoMn;
+            LockCollateral(pwallet); // VELES
 
             std::vector<CAmount> vecAmounts;
             pwallet->ConvertList(vecTxIn, vecAmounts);
@@ -1004,16 +1308,18 @@ bool CPrivateSendClient::StartNewQueue(CAmount nValueMin, CAmount nBalanceNeedsA
     return false;
 }
 
-bool CPrivateSendClient::SubmitDenominate(CConnman& connman)
+bool CPrivateSendClientSession::SubmitDenominate(CConnman& connman)
 {
     std::string strError;
     std::vector<CTxDSIn> vecTxDSInRet;
     std::vector<CTxOut> vecTxOutRet;
 
     // Submit transaction to the pool if we get here
-    if (nLiquidityProvider) {
+    //if (nLiquidityProvider) {
+    if (privateSendClient.nLiquidityProvider) { // VELES
         // Try to use only inputs with the same number of rounds starting from the lowest number of rounds possible
-        for(int i = 0; i< nPrivateSendRounds; i++) {
+        //for(int i = 0; i< nPrivateSendRounds; i++) {
+        for(int i = 0; i< privateSendClient.nPrivateSendRounds; i++) { // VELES
             if(PrepareDenominate(i, i + 1, strError, vecTxDSInRet, vecTxOutRet)) {
                 LogPrintf("CPrivateSendClient::SubmitDenominate -- Running PrivateSend denominate for %d rounds, success\n", i);
                 return SendDenominate(vecTxDSInRet, vecTxOutRet, connman);
@@ -1022,7 +1328,8 @@ bool CPrivateSendClient::SubmitDenominate(CConnman& connman)
         }
     } else {
         // Try to use only inputs with the same number of rounds starting from the highest number of rounds possible
-        for(int i = nPrivateSendRounds; i > 0; i--) {
+        //for(int i = nPrivateSendRounds; i > 0; i--) {
+        for(int i = privateSendClient.nPrivateSendRounds; i > 0; i--) { // VELES
             if(PrepareDenominate(i - 1, i, strError, vecTxDSInRet, vecTxOutRet)) {
                 LogPrintf("CPrivateSendClient::SubmitDenominate -- Running PrivateSend denominate for %d rounds, success\n", i);
                 return SendDenominate(vecTxDSInRet, vecTxOutRet, connman);
@@ -1032,7 +1339,8 @@ bool CPrivateSendClient::SubmitDenominate(CConnman& connman)
     }
 
     // We failed? That's strange but let's just make final attempt and try to mix everything
-    if(PrepareDenominate(0, nPrivateSendRounds, strError, vecTxDSInRet, vecTxOutRet)) {
+    //if(PrepareDenominate(0, nPrivateSendRounds, strError, vecTxDSInRet, vecTxOutRet)) {
+    if(PrepareDenominate(0, privateSendClient.nPrivateSendRounds, strError, vecTxDSInRet, vecTxOutRet)) { // VELES
         LogPrintf("CPrivateSendClient::SubmitDenominate -- Running PrivateSend denominate for all rounds, success\n");
         return SendDenominate(vecTxDSInRet, vecTxOutRet, connman);
     }
@@ -1043,7 +1351,7 @@ bool CPrivateSendClient::SubmitDenominate(CConnman& connman)
     return false;
 }
 
-bool CPrivateSendClient::PrepareDenominate(int nMinRounds, int nMaxRounds, std::string& strErrorRet, std::vector<CTxDSIn>& vecTxDSInRet, std::vector<CTxOut>& vecTxOutRet)
+bool CPrivateSendClientSession::PrepareDenominate(int nMinRounds, int nMaxRounds, std::string& strErrorRet, std::vector<CTxDSIn>& vecTxDSInRet, std::vector<CTxOut>& vecTxOutRet)
 {
     std::vector<std::shared_ptr<CWallet>> wallets = GetWallets();
     CWallet * const pwallet = (wallets.size() > 0) ? wallets[0].get() : nullptr;
@@ -1289,6 +1597,10 @@ bool CPrivateSendClient::CreateDenominated(CConnman& connman)
     CWallet * const pwallet = (wallets.size() > 0) ? wallets[0].get() : nullptr;
 
     LOCK2(cs_main, pwallet->cs_wallet);
+    // VELES BEGIN
+    // keys reserved and kept for every denominated output, flush once for the whole run
+    WalletFlushDeferral flush_deferral(pwallet->GetDBHandle());
+    // VELES END
 
     std::vector<CompactTallyItem> vecTally;
     if(!pwallet->SelectCoinsGrouppedByAddresses(vecTally)) {
@@ -1428,7 +1740,7 @@ bool CPrivateSendClient::CreateDenominated(const CompactTallyItem& tallyItem, bo
     return true;
 }
 
-void CPrivateSendClient::RelayIn(const CDarkSendEntry& entry, CConnman& connman)
+void CPrivateSendClientSession::RelayIn(const CDarkSendEntry& entry, CConnman& connman)
 {
     if(!infoMixingMasternode.fInfoValid) return;
 
@@ -1439,7 +1751,7 @@ void CPrivateSendClient::RelayIn(const CDarkSendEntry& entry, CConnman& connman)
     });
 }
 
-void CPrivateSendClient::SetState(PoolState nStateNew)
+void CPrivateSendClientSession::SetState(PoolState nStateNew)
 {
     LogPrintf("CPrivateSendClient::SetState -- nState: %d, nStateNew: %d\n", nState, nStateNew);
     nState = nStateNew;
@@ -11,7 +11,13 @@
 #include <wallet/wallet.h>
 #include <privatesend-util.h>
 
+// VELES BEGIN
+#include <deque>
+#include <set>
+// VELES END
+
 class CPrivateSendClient;
+class CPrivateSendClientSession; // VELES
 class CConnman;
 
 static const int DENOMS_COUNT_MAX                   = 100;
@@ -27,26 +33,24 @@ static const int PRIVATESEND_KEYS_THRESHOLD_WARNING = 100;
 // Stop mixing completely, it's too dangerous to continue when we have only this many keys left
 static const int PRIVATESEND_KEYS_THRESHOLD_STOP    = 50;
 
+// VELES BEGIN
+static const int DEFAULT_PRIVATESEND_SESSIONS       = 4;
+static const int MAX_PRIVATESEND_SESSIONS           = 10;
+// VELES END
+
 // The main object for accessing mixing
 extern CPrivateSendClient privateSendClient;
 
-/** Used to keep track of current status of mixing pool
+// VELES BEGIN
+/** A mixing session with a single Masternode, several of them run at once
  */
-class CPrivateSendClient : public CPrivateSendBase
+class CPrivateSendClientSession : public CPrivateSendBase
 {
 private:
-    // Keep track of the used Masternodes
-    std::vector<COutPoint> vecMasternodesUsed;
+    friend class CPrivateSendClient;
 
-    std::vector<CAmount> vecDenominationsSkipped;
     std::vector<COutPoint> vecOutPointLocked;
 
-    int nCachedLastSuccessBlock;
-    int nMinBlocksToWait; // how many blocks to wait after one successful mixing tx in non-multisession mode
-
-    // Keep track of current block height
-    int nCachedBlockHeight;
-
     int nEntriesCount;
     bool fLastEntryAccepted;
 
@@ -62,25 +66,14 @@ private:
     void CheckPool();
     void CompletedTransaction(PoolMessage nMessageID);
 
-    bool IsDenomSkipped(CAmount nDenomValue) {
-        return std::find(vecDenominationsSkipped.begin(), vecDenominationsSkipped.end(), nDenomValue) != vecDenominationsSkipped.end();
-    }
+    /// Make sure our collateral is valid and not used by another session
+    bool CheckCollateral(CWallet* pwallet);
+    /// Lock the collateral inputs for as long as we wait for the Masternode
+    void LockCollateral(CWallet* pwallet);
 
-    bool WaitForAnotherBlock();
-
-    // Make sure we have enough keys since last backup
-    bool CheckAutomaticBackup();
     bool JoinExistingQueue(CAmount nBalanceNeedsAnonymized, CConnman& connman);
     bool StartNewQueue(CAmount nValueMin, CAmount nBalanceNeedsAnonymized, CConnman& connman);
 
-    /// Create denominations
-    bool CreateDenominated(CConnman& connman);
-    bool CreateDenominated(const CompactTallyItem& tallyItem, bool fCreateMixingCollaterals, CConnman& connman, mapValue_t mapValue, std::string fromAccount);
-
-    /// Split up large inputs or make fee sized inputs
-    bool MakeCollateralAmounts(CConnman& connman);
-    bool MakeCollateralAmounts(const CompactTallyItem& tallyItem, bool fTryDenominated, CConnman& connman, mapValue_t mapValue, std::string fromAccount);
-
     /// As a client, submit part of a future mixing transaction to a Masternode to start the process
     bool SubmitDenominate(CConnman& connman);
     /// step 1: prepare denominated inputs and outputs
@@ -100,12 +93,108 @@ private:
 
     void SetNull();
 
+public:
+    CPrivateSendClientSession() :
+        txMyCollateral(CMutableTransaction()) { SetNull(); }
+
+    /// Handle the messages of our Masternode, pfrom must be the mixing Masternode of this session
+    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman);
+
+    void ResetPool();
+
+    void UnlockCoins();
+
+    std::string GetStatus();
+
+    bool GetMixingMasternodeInfo(masternode_info_t& mnInfoRet) const;
+    bool IsMixingMasternode(const CService& addr) const { return infoMixingMasternode.fInfoValid && infoMixingMasternode.addr == addr; }
+    bool IsIdle() const { return nState == POOL_STATE_IDLE && nSessionID == 0; }
+
+    /// Find a Masternode and start mixing with it, the checks common to all sessions are done by CPrivateSendClient
+    bool DoAutomaticDenominating(CAmount nValueMin, CAmount nBalanceNeedsAnonymized, CConnman& connman);
+
+    /// The queue of our Masternode is ready
+    void OnQueueReady(CConnman& connman);
+
+    void CheckTimeout();
+};
+// VELES END
+
+/** Used to keep track of current status of mixing pool
+ */
+class CPrivateSendClient : public CPrivateSendBase
+{
+private:
+    // VELES BEGIN
+    friend class CPrivateSendClientSession;
+
+    mutable CCriticalSection cs_deqsessions;
+    // Mixing sessions in progress, each with a different Masternode
+    std::deque<CPrivateSendClientSession> deqSessions GUARDED_BY(cs_deqsessions);
+    // Their Masternodes, for the connection manager which can't wait for the sessions
+    mutable CCriticalSection cs_mixingmasternodes;
+    std::set<CService> setMixingMasternodes GUARDED_BY(cs_mixingmasternodes);
+    // VELES END
+
+    // Keep track of the used Masternodes
+    std::vector<COutPoint> vecMasternodesUsed;
+
+    std::vector<CAmount> vecDenominationsSkipped;
+    //std::vector<COutPoint> vecOutPointLocked;
+
+    int nCachedLastSuccessBlock;
+    int nMinBlocksToWait; // how many blocks to wait after one successful mixing tx in non-multisession mode
+
+    // Keep track of current block height
+    int nCachedBlockHeight;
+
+    //int nEntriesCount;
+    //bool fLastEntryAccepted;
+
+    //std::string strLastMessage;
+    std::string strAutoDenomResult;
+
+    //masternode_info_t infoMixingMasternode;
+    //CMutableTransaction txMyCollateral; // client side collateral
+
+    //CKeyHolderStorage keyHolderStorage; // storage for keys used in PrepareDenominate
+
+    /// Check for process
+    //void CheckPool();
+    //void CompletedTransaction(PoolMessage nMessageID);
+
+    bool IsDenomSkipped(CAmount nDenomValue) {
+        return std::find(vecDenominationsSkipped.begin(), vecDenominationsSkipped.end(), nDenomValue) != vecDenominationsSkipped.end();
+    }
+
+    bool WaitForAnotherBlock();
+
+    // Make sure we have enough keys since last backup
+    bool CheckAutomaticBackup();
+    //bool JoinExistingQueue(CAmount nBalanceNeedsAnonymized, CConnman& connman);
+    //bool StartNewQueue(CAmount nValueMin, CAmount nBalanceNeedsAnonymized, CConnman& connman);
+
+    /// Create denominations
+    bool CreateDenominated(CConnman& connman);
+    bool CreateDenominated(const CompactTallyItem& tallyItem, bool fCreateMixingCollaterals, CConnman& connman, mapValue_t mapValue, std::string fromAccount);
+
+    /// Split up large inputs or make fee sized inputs
+    bool MakeCollateralAmounts(CConnman& connman);
+    bool MakeCollateralAmounts(const CompactTallyItem& tallyItem, bool fTryDenominated, CConnman& connman, mapValue_t mapValue, std::string fromAccount);
+
+    // VELES BEGIN
+    /// Masternodes are only mixed with by one session at a time
+    bool IsMasternodeInUse(const CService& addr) const;
+    void UpdateMixingMasternodes() EXCLUSIVE_LOCKS_REQUIRED(cs_deqsessions);
+    // VELES END
+
 public:
     int nPrivateSendRounds;
     int nPrivateSendAmount;
     int nLiquidityProvider;
     bool fEnablePrivateSend;
     bool fPrivateSendMultiSession;
+    int nPrivateSendSessions; // VELES
 
     int nCachedNumBlocks; //used for the overview screen
     bool fCreateAutoBackups; //builtin support for automatic backups
@@ -113,12 +202,13 @@ public:
     CPrivateSendClient() :
         nCachedLastSuccessBlock(0),
         nMinBlocksToWait(1),
-        txMyCollateral(CMutableTransaction()),
+        //txMyCollateral(CMutableTransaction()),
         nPrivateSendRounds(DEFAULT_PRIVATESEND_ROUNDS),
         nPrivateSendAmount(DEFAULT_PRIVATESEND_AMOUNT),
         nLiquidityProvider(DEFAULT_PRIVATESEND_LIQUIDITY),
         fEnablePrivateSend(false),
         fPrivateSendMultiSession(DEFAULT_PRIVATESEND_MULTISESSION),
+        nPrivateSendSessions(DEFAULT_PRIVATESEND_SESSIONS), // VELES
         nCachedNumBlocks(std::numeric_limits<int>::max()),
         fCreateAutoBackups(true) { SetNull(); }
 
@@ -136,6 +226,10 @@ public:
     std::string GetStatus();
 
     bool GetMixingMasternodeInfo(masternode_info_t& mnInfoRet);
+    // VELES BEGIN
+    bool GetMixingMasternodesInfo(std::vector<masternode_info_t>& vecMnInfoRet) const;
+    int GetActiveSessions() const;
+    // VELES END
     bool IsMixingMasternode(const CNode* pnode);
 
     /// Passively run mixing in the background according to the configuration in settings
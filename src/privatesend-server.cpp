@@ -18,6 +18,10 @@
 #include <txmempool.h>
 #include <util/system.h>
 #include <util/moneystr.h>
+// VELES BEGIN
+#include <checkqueue.h>
+#include <validation.h>
+// VELES END
 
 CPrivateSendServer privateSendServer;
 
@@ -89,12 +93,13 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, const std::string& strComm
         vRecv >> dsq;
 
         // process every dsq only once
-        for (auto q : vecDarksendQueue) {
-            if(q == dsq) {
-                // LogPrint(BCLog::PRIVATESEND, "DSQUEUE -- %s seen\n", dsq.ToString());
-                return;
-            }
-        }
+        //for (auto q : vecDarksendQueue) {
+        //    if(q == dsq) {
+        //        // LogPrint(BCLog::PRIVATESEND, "DSQUEUE -- %s seen\n", dsq.ToString());
+        //        return;
+        //    }
+        //}
+        if(indexDarksendQueue.Has(dsq)) return; // VELES
 
         LogPrint(BCLog::PRIVATESEND, "DSQUEUE -- %s new\n", dsq.ToString());
 
@@ -110,13 +115,20 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, const std::string& strComm
         }
 
         if(!dsq.fReady) {
-            for (auto q : vecDarksendQueue) {
-                if(q.vin == dsq.vin) {
-                    // no way same mn can send another "not yet ready" dsq this soon
-                    LogPrint(BCLog::PRIVATESEND, "DSQUEUE -- Masternode %s is sending WAY too many dsq messages\n", mnInfo.addr.ToString());
-                    return;
-                }
+            //for (auto q : vecDarksendQueue) {
+            //    if(q.vin == dsq.vin) {
+            //        // no way same mn can send another "not yet ready" dsq this soon
+            //        LogPrint(BCLog::PRIVATESEND, "DSQUEUE -- Masternode %s is sending WAY too many dsq messages\n", mnInfo.addr.ToString());
+            //        return;
+            //    }
+            //}
+            // VELES BEGIN
+            if(indexDarksendQueue.HasMasternode(dsq.vin.prevout)) {
+                // no way same mn can send another "not yet ready" dsq this soon
+                LogPrint(BCLog::PRIVATESEND, "DSQUEUE -- Masternode %s is sending WAY too many dsq messages\n", mnInfo.addr.ToString());
+                return;
             }
+            // VELES END
 
             int nThreshold = mnInfo.nLastDsq + mnodeman.CountEnabled(MIN_PRIVATESEND_PEER_PROTO_VERSION)/5;
             LogPrint(BCLog::PRIVATESEND, "DSQUEUE -- nLastDsq: %d  threshold: %d  nDsqCount: %d\n", mnInfo.nLastDsq, nThreshold, mnodeman.nDsqCount);
@@ -128,7 +140,8 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, const std::string& strComm
             mnodeman.AllowMixing(dsq.vin.prevout);
 
             LogPrint(BCLog::PRIVATESEND, "DSQUEUE -- new PrivateSend queue (%s) from masternode %s\n", dsq.ToString(), mnInfo.addr.ToString());
-            vecDarksendQueue.push_back(dsq);
+            //vecDarksendQueue.push_back(dsq);
+            indexDarksendQueue.Add(dsq); // VELES
             dsq.Relay(connman);
         }
 
@@ -257,9 +270,18 @@ void CPrivateSendServer::ProcessMessage(CNode* pfrom, const std::string& strComm
         int nTxInIndex = 0;
         int nTxInsCount = (int)vecTxIn.size();
 
+        // VELES BEGIN
+        if(!IsInputScriptSigsValid(vecTxIn)) {
+            LogPrint(BCLog::PRIVATESEND, "DSSIGNFINALTX -- IsInputScriptSigsValid() failed, session: %d\n", nSessionID);
+            RelayStatus(STATUS_REJECTED, connman);
+            return;
+        }
+        // VELES END
+
         for (const auto txin : vecTxIn) {
             nTxInIndex++;
-            if(!AddScriptSig(txin)) {
+            //if(!AddScriptSig(txin)) {
+            if(!AddScriptSig(txin, false)) { // VELES
                 LogPrint(BCLog::PRIVATESEND, "DSSIGNFINALTX -- AddScriptSig() failed at %d/%d, session: %d\n", nTxInIndex, nTxInsCount, nSessionID);
                 RelayStatus(STATUS_REJECTED, connman);
                 return;
@@ -362,7 +384,8 @@ void CPrivateSendServer::CommitFinalTransaction(CConnman& connman)
     LogPrintf("CPrivateSendServer::CommitFinalTransaction -- CREATING DSTX\n");
 
     // create and sign masternode dstx transaction
-    if(!CPrivateSend::GetDSTX(hashTx)) {
+    //if(!CPrivateSend::GetDSTX(hashTx)) {
+    if(!CPrivateSend::HasDSTX(hashTx)) { // VELES
         CDarksendBroadcastTx dstxNew(finalTransaction, activeMasternode.outpoint, GetAdjustedTime());
         dstxNew.Sign();
         CPrivateSend::AddDSTX(dstxNew);
@@ -579,6 +602,62 @@ bool CPrivateSendServer::IsInputScriptSigValid(const CTxIn& txin)
     return true;
 }
 
+// VELES BEGIN
+static CCheckQueue<CScriptCheck> privatesendscriptcheckqueue(16);
+
+bool CPrivateSendServer::IsInputScriptSigsValid(const std::vector<CTxIn>& vecTxIn)
+{
+    // Same transaction as the one IsInputScriptSigValid verifies each input against,
+    // with all the new scriptSigs set so it is built only once
+    CMutableTransaction txNew;
+    std::vector<CScript> vecPrevPubKeys;
+
+    for (const auto& entry : vecEntries) {
+        for (const auto& txout : entry.vecTxOut)
+            txNew.vout.push_back(txout);
+
+        for (const auto& txdsin : entry.vecTxDSIn) {
+            txNew.vin.push_back(txdsin);
+            vecPrevPubKeys.push_back(txdsin.prevPubKey);
+        }
+    }
+
+    std::vector<int> vecTxInIndexes;
+    for (const auto& txin : vecTxIn) {
+        int nTxInIndex = -1;
+        for (size_t i = 0; i < txNew.vin.size(); i++) {
+            if(txNew.vin[i].prevout == txin.prevout) {
+                nTxInIndex = i;
+            }
+        }
+        if(nTxInIndex < 0 || txNew.vout.empty()) {
+            LogPrint(BCLog::PRIVATESEND, "CPrivateSendServer::IsInputScriptSigsValid -- Failed to find matching input in pool, %s\n", txin.ToString());
+            return false;
+        }
+        txNew.vin[nTxInIndex].scriptSig = txin.scriptSig;
+        vecTxInIndexes.push_back(nTxInIndex);
+    }
+
+    const CTransaction tx(txNew);
+    PrecomputedTransactionData txdata(tx);
+    std::vector<CScriptCheck> vChecks;
+    for (int nTxInIndex : vecTxInIndexes) {
+        vChecks.emplace_back(CTxOut(tx.vout[0].nValue, vecPrevPubKeys[nTxInIndex]), tx, nTxInIndex, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, false, &txdata);
+    }
+
+    // The calling thread takes part, the checks run on it alone without worker threads
+    CCheckQueueControl<CScriptCheck> control(&privatesendscriptcheckqueue);
+    control.Add(vChecks);
+    if(!control.Wait()) {
+        LogPrint(BCLog::PRIVATESEND, "CPrivateSendServer::IsInputScriptSigsValid -- VerifyScript() failed\n");
+        return false;
+    }
+
+    LogPrint(BCLog::PRIVATESEND, "CPrivateSendServer::IsInputScriptSigsValid -- Successfully validated %d inputs and scriptSigs\n", vecTxIn.size());
+    return true;
+}
+// VELES END
+
 //
 // Add a clients transaction to the pool
 //
@@ -628,7 +707,8 @@ bool CPrivateSendServer::AddEntry(const CDarkSendEntry& entryNew, PoolMessage& n
     return true;
 }
 
-bool CPrivateSendServer::AddScriptSig(const CTxIn& txinNew)
+//bool CPrivateSendServer::AddScriptSig(const CTxIn& txinNew)
+bool CPrivateSendServer::AddScriptSig(const CTxIn& txinNew, bool fCheckScriptSig) // VELES
 {
     LogPrint(BCLog::PRIVATESEND, "CPrivateSendServer::AddScriptSig -- scriptSig=%s\n", ScriptToAsmStr(txinNew.scriptSig).substr(0,24));
 
@@ -641,7 +721,8 @@ bool CPrivateSendServer::AddScriptSig(const CTxIn& txinNew)
         }
     }
 
-    if(!IsInputScriptSigValid(txinNew)) {
+    //if(!IsInputScriptSigValid(txinNew)) {
+    if(fCheckScriptSig && !IsInputScriptSigValid(txinNew)) { // VELES
         LogPrint(BCLog::PRIVATESEND, "CPrivateSendServer::AddScriptSig -- Invalid scriptSig\n");
         return false;
     }
@@ -739,7 +820,8 @@ bool CPrivateSendServer::CreateNewSession(int nDenom, CMutableTransaction txColl
         LogPrint(BCLog::PRIVATESEND, "CPrivateSendServer::CreateNewSession -- signing and relaying new queue: %s\n", dsq.ToString());
         dsq.Sign();
         dsq.Relay(connman);
-        vecDarksendQueue.push_back(dsq);
+        //vecDarksendQueue.push_back(dsq);
+        indexDarksendQueue.Add(dsq); // VELES
     }
 
     vecSessionCollaterals.push_back(txCollateral);
@@ -899,3 +981,11 @@ void ThreadCheckPrivateSendServer(CConnman& connman)
         }
     }
 }
+
+// VELES BEGIN
+void ThreadPrivateSendServerScriptCheck()
+{
+    RenameThread("veles-psscript");
+    privatesendscriptcheckqueue.Thread();
+}
+// VELES END
@@ -28,7 +28,8 @@ private:
     /// Add a clients entry to the pool
     bool AddEntry(const CDarkSendEntry& entryNew, PoolMessage& nMessageIDRet);
     /// Add signature to a txin
-    bool AddScriptSig(const CTxIn& txin);
+    //bool AddScriptSig(const CTxIn& txin);
+    bool AddScriptSig(const CTxIn& txin, bool fCheckScriptSig = true); // VELES
 
     /// Charge fees to bad actors (Charge clients a fee if they're abusive)
     void ChargeFees(CConnman& connman);
@@ -52,6 +53,10 @@ private:
     bool IsSignaturesComplete();
     /// Check to make sure a given input matches an input in the pool and its scriptSig is valid
     bool IsInputScriptSigValid(const CTxIn& txin);
+    // VELES BEGIN
+    /// Check that all the given inputs match inputs in the pool and verify their scriptSigs at once on the check threads
+    bool IsInputScriptSigsValid(const std::vector<CTxIn>& vecTxIn);
+    // VELES END
     /// Are these outputs compatible with other client in the pool?
     bool IsOutputsCompatibleWithSessionDenom(const std::vector<CTxOut>& vecTxOut);
 
@@ -77,5 +82,9 @@ public:
 };
 
 void ThreadCheckPrivateSendServer(CConnman& connman);
+// VELES BEGIN
+/** Run an instance of the mixing signature verification thread */
+void ThreadPrivateSendServerScriptCheck();
+// VELES END
 
 #endif // DASH_PRIVATESEND_SERVER_H
@@ -13,6 +13,7 @@
 #include <masternode/sync.h>
 #include <masternode/manager.h>
 #include <messagesigner.h>
+#include <netfulfilledman.h> // VELES
 #include <netmessagemaker.h>
 #include <reverse_iterator.h>
 #include <script/sign.h>
@@ -23,6 +24,10 @@
 #include <util/system.h>
 #include <util/moneystr.h>
 
+// VELES BEGIN
+#include <algorithm>
+// VELES END
+
 #include <boost/lexical_cast.hpp>
 
 bool CDarkSendEntry::AddScriptSig(const CTxIn& txin)
@@ -130,15 +135,85 @@ void CPrivateSendBase::CheckQueue()
     if(!lockDS) return; // it's ok to fail here, we run this quite frequently
 
     // check mixing queue objects for timeouts
-    std::vector<CDarksendQueue>::iterator it = vecDarksendQueue.begin();
-    while(it != vecDarksendQueue.end()) {
-        if((*it).IsExpired()) {
-            LogPrint(BCLog::PRIVATESEND, "CPrivateSendBase::%s -- Removing expired queue (%s)\n", __func__, (*it).ToString());
-            it = vecDarksendQueue.erase(it);
-        } else ++it;
+    //std::vector<CDarksendQueue>::iterator it = vecDarksendQueue.begin();
+    //while(it != vecDarksendQueue.end()) {
+    //    if((*it).IsExpired()) {
+    //        LogPrint(BCLog::PRIVATESEND, "CPrivateSendBase::%s -- Removing expired queue (%s)\n", __func__, (*it).ToString());
+    //        it = vecDarksendQueue.erase(it);
+    //    } else ++it;
+    //}
+    indexDarksendQueue.RemoveExpired(); // VELES
+}
+
+// VELES BEGIN
+bool CDarksendQueueIndex::Has(const CDarksendQueue& dsq) const
+{
+    auto it = mapQueues.find(dsq.vin.prevout);
+    return it != mapQueues.end() && it->second == dsq;
+}
+
+void CDarksendQueueIndex::EraseUntried(const CDarksendQueue& dsq)
+{
+    auto it = mapUntriedByDenom.find(dsq.nDenom);
+    if (it == mapUntriedByDenom.end()) return;
+    it->second.erase(dsq.vin.prevout);
+    if (it->second.empty())
+        mapUntriedByDenom.erase(it);
+}
+
+void CDarksendQueueIndex::Add(const CDarksendQueue& dsq)
+{
+    auto it = mapQueues.find(dsq.vin.prevout);
+    if (it != mapQueues.end()) {
+        EraseUntried(it->second);
+        it->second = dsq;
+    } else {
+        mapQueues.emplace(dsq.vin.prevout, dsq);
+    }
+    if (!dsq.fTried)
+        mapUntriedByDenom[dsq.nDenom].insert(dsq.vin.prevout);
+    heapExpiry.emplace(dsq.nTime, dsq.vin.prevout);
+}
+
+void CDarksendQueueIndex::RemoveExpired()
+{
+    const int64_t nNow = GetAdjustedTime();
+    while (!heapExpiry.empty() && nNow - heapExpiry.top().first > PRIVATESEND_QUEUE_TIMEOUT) {
+        const COutPoint outpoint = heapExpiry.top().second;
+        const int64_t nTime = heapExpiry.top().first;
+        heapExpiry.pop();
+        auto it = mapQueues.find(outpoint);
+        // replaced by a later queue of the same Masternode
+        if (it == mapQueues.end() || it->second.nTime != nTime) continue;
+        LogPrint(BCLog::PRIVATESEND, "CPrivateSendBase::CheckQueue -- Removing expired queue (%s)\n", it->second.ToString());
+        EraseUntried(it->second);
+        mapQueues.erase(it);
     }
 }
 
+std::vector<int> CDarksendQueueIndex::GetUntriedDenominations() const
+{
+    std::vector<int> vecDenoms;
+    for (const auto& entry : mapUntriedByDenom)
+        vecDenoms.push_back(entry.first);
+    return vecDenoms;
+}
+
+bool CDarksendQueueIndex::PopUntried(int nDenom, CDarksendQueue& dsqRet)
+{
+    auto it = mapUntriedByDenom.find(nDenom);
+    if (it == mapUntriedByDenom.end()) return false;
+    auto itQueue = mapQueues.find(*it->second.begin());
+    it->second.erase(it->second.begin());
+    if (it->second.empty())
+        mapUntriedByDenom.erase(it);
+    if (itQueue == mapQueues.end()) return false;
+    itQueue->second.fTried = true;
+    dsqRet = itQueue->second;
+    return true;
+}
+// VELES END
+
 std::string CPrivateSendBase::GetStateString() const
 {
     switch(nState) {
@@ -154,7 +229,12 @@ std::string CPrivateSendBase::GetStateString() const
 
 // Definitions for static data members
 std::vector<CAmount> CPrivateSend::vecStandardDenominations;
-std::map<uint256, CDarksendBroadcastTx> CPrivateSend::mapDSTX;
+std::vector<std::pair<CAmount, int> > CPrivateSend::vecDenominationsLookup; // VELES
+//std::map<uint256, CDarksendBroadcastTx> CPrivateSend::mapDSTX;
+// VELES BEGIN
+std::unordered_map<uint256, CDarksendBroadcastTx, SaltedTxidHasher> CPrivateSend::mapDSTX;
+std::multimap<int, uint256> CPrivateSend::mapDSTXByHeight;
+// VELES END
 CCriticalSection CPrivateSend::cs_mapdstx;
 
 void CPrivateSend::InitStandardDenominations()
@@ -179,8 +259,33 @@ void CPrivateSend::InitStandardDenominations()
     /* Disabled till we need them
     vecStandardDenominations.push_back( (.001     * COIN)+1 );
     */
+
+    // VELES BEGIN
+    vecDenominationsLookup.clear();
+    for (size_t i = 0; i < vecStandardDenominations.size(); ++i)
+        vecDenominationsLookup.emplace_back(vecStandardDenominations[i], i);
+    std::sort(vecDenominationsLookup.begin(), vecDenominationsLookup.end());
+    // VELES END
+}
+
+// VELES BEGIN
+int CPrivateSend::GetDenominationIndex(CAmount nAmount)
+{
+    auto it = std::lower_bound(vecDenominationsLookup.begin(), vecDenominationsLookup.end(), std::make_pair(nAmount, 0));
+    if (it == vecDenominationsLookup.end() || it->first != nAmount)
+        return -1;
+    return it->second;
 }
 
+bool CPrivateSend::IsDenominatedAmounts(const std::vector<CTxOut>& vecTxOut)
+{
+    for (const auto& txout : vecTxOut)
+        if (GetDenominationIndex(txout.nValue) < 0)
+            return false;
+    return true;
+}
+// VELES END
+
 // check to make sure the collateral provided by the client is valid
 bool CPrivateSend::IsCollateralValid(const CTransaction& txCollateral)
 {
@@ -280,34 +385,54 @@ std::string CPrivateSend::GetDenominationsToString(int nDenom)
 */
 int CPrivateSend::GetDenominations(const std::vector<CTxOut>& vecTxOut, bool fSingleRandomDenom)
 {
-    std::vector<std::pair<CAmount, int> > vecDenomUsed;
-
-    // make a list of denominations, with zero uses
-    for (auto nDenomValue : vecStandardDenominations)
-        vecDenomUsed.push_back(std::make_pair(nDenomValue, 0));
-
-    // look for denominations and update uses to 1
-    for (auto txout : vecTxOut) {
-        bool found = false;
-        for (std::pair<CAmount, int>& s : vecDenomUsed) {
-            if(txout.nValue == s.first) {
-                s.second = 1;
-                found = true;
-            }
-        }
-        if(!found) return 0;
+    //std::vector<std::pair<CAmount, int> > vecDenomUsed;
+    //
+    //// make a list of denominations, with zero uses
+    //for (auto nDenomValue : vecStandardDenominations)
+    //    vecDenomUsed.push_back(std::make_pair(nDenomValue, 0));
+    //
+    //// look for denominations and update uses to 1
+    //for (auto txout : vecTxOut) {
+    //    bool found = false;
+    //    for (std::pair<CAmount, int>& s : vecDenomUsed) {
+    //        if(txout.nValue == s.first) {
+    //            s.second = 1;
+    //            found = true;
+    //        }
+    //    }
+    //    if(!found) return 0;
+    //}
+    //
+    //int nDenom = 0;
+    //int c = 0;
+    //// if the denomination is used, shift the bit on
+    //for (std::pair<CAmount, int>& s : vecDenomUsed) {
+    //    int bit = (fSingleRandomDenom ? GetRandInt(2) : 1) & s.second;
+    //    nDenom |= bit << c++;
+    //    if(fSingleRandomDenom && bit) break; // use just one random denomination
+    //}
+    //
+    //return nDenom;
+    // VELES BEGIN
+    // Bitmask of the used denominations, built with one lookup per output
+    int nDenomUsed = 0;
+    for (const auto& txout : vecTxOut) {
+        int nIndex = GetDenominationIndex(txout.nValue);
+        if(nIndex < 0) return 0;
+        nDenomUsed |= 1 << nIndex;
     }
 
-    int nDenom = 0;
-    int c = 0;
-    // if the denomination is used, shift the bit on
-    for (std::pair<CAmount, int>& s : vecDenomUsed) {
-        int bit = (fSingleRandomDenom ? GetRandInt(2) : 1) & s.second;
-        nDenom |= bit << c++;
-        if(fSingleRandomDenom && bit) break; // use just one random denomination
+    if(!fSingleRandomDenom) return nDenomUsed;
+
+    // use just one random denomination, drawing for each denomination in order like before
+    int nMaxDenoms = vecStandardDenominations.size();
+    for (int i = 0; i < nMaxDenoms; ++i) {
+        int bit = GetRandInt(2) & (nDenomUsed >> i);
+        if(bit) return bit << i;
     }
 
-    return nDenom;
+    return 0;
+    // VELES END
 }
 
 bool CPrivateSend::GetDenominationsBits(int nDenom, std::vector<int> &vecBitsRet)
@@ -346,13 +471,13 @@ int CPrivateSend::GetDenominationsByAmounts(const std::vector<CAmount>& vecAmoun
     return GetDenominations(vecTxOut, true);
 }
 
-bool CPrivateSend::IsDenominatedAmount(CAmount nInputAmount)
-{
-    for (const auto& nDenomValue : vecStandardDenominations)
-        if(nInputAmount == nDenomValue)
-            return true;
-    return false;
-}
+//bool CPrivateSend::IsDenominatedAmount(CAmount nInputAmount)
+//{
+//    for (const auto& nDenomValue : vecStandardDenominations)
+//        if(nInputAmount == nDenomValue)
+//            return true;
+//    return false;
+//}
 
 std::string CPrivateSend::GetMessageByID(PoolMessage nMessageID)
 {
@@ -396,17 +521,39 @@ CDarksendBroadcastTx CPrivateSend::GetDSTX(const uint256& hash)
     return (it == mapDSTX.end()) ? CDarksendBroadcastTx() : it->second;
 }
 
+// VELES BEGIN
+bool CPrivateSend::HasDSTX(const uint256& hash)
+{
+    LOCK(cs_mapdstx);
+    return mapDSTX.count(hash) != 0;
+}
+// VELES END
+
 void CPrivateSend::CheckDSTXes(int nHeight)
 {
     LOCK(cs_mapdstx);
-    std::map<uint256, CDarksendBroadcastTx>::iterator it = mapDSTX.begin();
-    while(it != mapDSTX.end()) {
-        if (it->second.IsExpired(nHeight)) {
-            mapDSTX.erase(it++);
-        } else {
-            ++it;
+    //std::map<uint256, CDarksendBroadcastTx>::iterator it = mapDSTX.begin();
+    //while(it != mapDSTX.end()) {
+    //    if (it->second.IsExpired(nHeight)) {
+    //        mapDSTX.erase(it++);
+    //    } else {
+    //        ++it;
+    //    }
+    //}
+    // VELES BEGIN
+    // Lowest confirmation heights first, stop at the first one that isn't expired
+    auto it = mapDSTXByHeight.begin();
+    while(it != mapDSTXByHeight.end()) {
+        auto itDSTX = mapDSTX.find(it->second);
+        if (itDSTX != mapDSTX.end() && !itDSTX->second.IsExpired(nHeight)) {
+            break;
+        }
+        if (itDSTX != mapDSTX.end()) {
+            mapDSTX.erase(itDSTX);
         }
+        mapDSTXByHeight.erase(it++);
     }
+    // VELES END
     LogPrint(BCLog::PRIVATESEND, "CPrivateSend::CheckDSTXes -- mapDSTX.size()=%llu\n", mapDSTX.size());
 }
 
@@ -438,7 +585,23 @@ void CPrivateSend::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
         }
         pblockindex = mi->second;
     }
-    mapDSTX[txHash].SetConfirmedHeight(pblockindex ? pblockindex->nHeight : -1);
+    //mapDSTX[txHash].SetConfirmedHeight(pblockindex ? pblockindex->nHeight : -1);
+    // VELES BEGIN
+    CDarksendBroadcastTx& dstx = mapDSTX[txHash];
+    if (dstx.GetConfirmedHeight() != -1) {
+        auto range = mapDSTXByHeight.equal_range(dstx.GetConfirmedHeight());
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == txHash) {
+                mapDSTXByHeight.erase(it);
+                break;
+            }
+        }
+    }
+    dstx.SetConfirmedHeight(pblockindex ? pblockindex->nHeight : -1);
+    if (dstx.GetConfirmedHeight() != -1) {
+        mapDSTXByHeight.emplace(dstx.GetConfirmedHeight(), txHash);
+    }
+    // VELES END
     LogPrint(BCLog::PRIVATESEND, "CPrivateSendClient::SyncTransaction -- txid=%s\n", txHash.ToString());
 }
 
@@ -483,11 +646,18 @@ void ThreadCheckPrivateSend(CConnman& connman)
             if(nTick % MASTERNODE_MIN_MNP_SECONDS == 15)
                 activeMasternode.ManageState(connman);
 
+            // VELES BEGIN
+            // the hosted masternodes ping on their own jittered schedules
+            if(nTick % 60 == 15)
+                hostedMasternodes.ManageState(connman);
+            // VELES END
+
             if(nTick % 60 == 0) {
                 mnodeman.ProcessMasternodeConnections(connman);
                 mnodeman.CheckAndRemove(connman);
                 mnpayments.CheckAndRemove();
                 instantsend.CheckAndRemove();
+                netfulfilledman.CheckAndRemove(); // VELES
             }
             if(fMasterNode && (nTick % (60 * 5) == 0)) {
                 mnodeman.DoFullVerificationStep(connman);
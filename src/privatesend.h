@@ -13,6 +13,15 @@
 #include <sync.h>
 #include <tinyformat.h>
 #include <timedata.h>
+// VELES BEGIN
+#include <txmempool.h>
+
+#include <functional>
+#include <map>
+#include <queue>
+#include <set>
+#include <unordered_map>
+// VELES END
 
 class CPrivateSend;
 class CConnman;
@@ -207,6 +216,40 @@ public:
     }
 };
 
+// VELES BEGIN
+/** The not yet ready mixing queues, one per Masternode as they may not send
+ *  another one before it expires. Indexed by Masternode, the untried ones by
+ *  denomination, and by time in a heap for the expiry.
+ */
+class CDarksendQueueIndex
+{
+private:
+    std::unordered_map<COutPoint, CDarksendQueue, SaltedOutpointHasher> mapQueues;
+    // Queues not tried yet by this client, by denomination
+    std::map<int, std::set<COutPoint> > mapUntriedByDenom;
+    // (nTime, masternode) of the queues, the entries of replaced queues are skipped when popped
+    std::priority_queue<std::pair<int64_t, COutPoint>, std::vector<std::pair<int64_t, COutPoint> >, std::greater<std::pair<int64_t, COutPoint> > > heapExpiry;
+
+    void EraseUntried(const CDarksendQueue& dsq);
+
+public:
+    size_t size() const { return mapQueues.size(); }
+
+    /// Was this very queue seen already?
+    bool Has(const CDarksendQueue& dsq) const;
+    /// Do we have a queue of this Masternode?
+    bool HasMasternode(const COutPoint& outpoint) const { return mapQueues.count(outpoint) > 0; }
+    /// Add a queue, in place of the one of the same Masternode if any
+    void Add(const CDarksendQueue& dsq);
+    void RemoveExpired();
+
+    /// Denominations of the queues not tried yet
+    std::vector<int> GetUntriedDenominations() const;
+    /// Take a queue of this denomination not tried yet, it is marked as tried
+    bool PopUntried(int nDenom, CDarksendQueue& dsqRet);
+};
+// VELES END
+
 /** Helper class to store mixing transaction (tx) information.
  */
 class CDarksendBroadcastTx
@@ -265,6 +308,7 @@ public:
     bool CheckSignature(const CPubKey& pubKeyMasternode);
 
     void SetConfirmedHeight(int nConfirmedHeightIn) { nConfirmedHeight = nConfirmedHeightIn; }
+    int GetConfirmedHeight() const { return nConfirmedHeight; } // VELES
     bool IsExpired(int nHeight);
 };
 
@@ -275,7 +319,8 @@ protected:
     mutable CCriticalSection cs_darksend;
 
     // The current mixing sessions in progress on the network
-    std::vector<CDarksendQueue> vecDarksendQueue;
+    //std::vector<CDarksendQueue> vecDarksendQueue;
+    CDarksendQueueIndex indexDarksendQueue; // VELES
 
     std::vector<CDarkSendEntry> vecEntries; // Masternode/clients entries
 
@@ -294,7 +339,8 @@ public:
 
     CPrivateSendBase() { SetNull(); }
 
-    int GetQueueSize() const { return vecDarksendQueue.size(); }
+    //int GetQueueSize() const { return vecDarksendQueue.size(); }
+    int GetQueueSize() const { return indexDarksendQueue.size(); } // VELES
     int GetState() const { return nState; }
     std::string GetStateString() const;
 
@@ -315,7 +361,16 @@ private:
 
     // static members
     static std::vector<CAmount> vecStandardDenominations;
-    static std::map<uint256, CDarksendBroadcastTx> mapDSTX;
+    // VELES BEGIN
+    /// Standard denominations sorted by amount with their bit index, for the binary search lookups
+    static std::vector<std::pair<CAmount, int> > vecDenominationsLookup;
+    // VELES END
+    //static std::map<uint256, CDarksendBroadcastTx> mapDSTX;
+    // VELES BEGIN
+    static std::unordered_map<uint256, CDarksendBroadcastTx, SaltedTxidHasher> mapDSTX;
+    /// Confirmed DSTXes by confirmation height, so only the expired ones are visited on a new block
+    static std::multimap<int, uint256> mapDSTXByHeight;
+    // VELES END
 
     static CCriticalSection cs_mapdstx;
 
@@ -323,13 +378,21 @@ private:
 
 public:
     static void InitStandardDenominations();
-    static std::vector<CAmount> GetStandardDenominations() { return vecStandardDenominations; }
+    //static std::vector<CAmount> GetStandardDenominations() { return vecStandardDenominations; }
+    static const std::vector<CAmount>& GetStandardDenominations() { return vecStandardDenominations; } // VELES
     static CAmount GetSmallestDenomination() { return vecStandardDenominations.back(); }
 
     /// Get the denominations for a specific amount of dash.
     static int GetDenominationsByAmounts(const std::vector<CAmount>& vecAmount);
 
-    static bool IsDenominatedAmount(CAmount nInputAmount);
+    //static bool IsDenominatedAmount(CAmount nInputAmount);
+    // VELES BEGIN
+    static bool IsDenominatedAmount(CAmount nInputAmount) { return GetDenominationIndex(nInputAmount) >= 0; }
+    /// Bit index of a standard denomination, -1 for non-denominated amounts
+    static int GetDenominationIndex(CAmount nAmount);
+    /// Whether every output of the list is a standard denomination
+    static bool IsDenominatedAmounts(const std::vector<CTxOut>& vecTxOut);
+    // VELES END
 
     /// Get the denominations for a list of outputs (returns a bitshifted integer)
     static int GetDenominations(const std::vector<CTxOut>& vecTxOut, bool fSingleRandomDenom = false);
@@ -352,6 +415,7 @@ public:
 
     static void AddDSTX(const CDarksendBroadcastTx& dstx);
     static CDarksendBroadcastTx GetDSTX(const uint256& hash);
+    static bool HasDSTX(const uint256& hash); // VELES
 
     static void UpdatedBlockTip(const CBlockIndex *pindex);
     static void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
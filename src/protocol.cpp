@@ -68,6 +68,21 @@ const char *MNGOVERNANCESYNC="govsync";
 const char *MNGOVERNANCEOBJECT="govobj";
 const char *MNGOVERNANCEOBJECTVOTE="govobjvote";
 const char *MNVERIFY="mnv";
+// VELES BEGIN
+const char *GETMNLISTDIFF="getmnlistd";
+const char *MNLISTDIFF="mnlistdiff";
+const char *SENDCMPHEADERS="sendcmphdrs";
+const char *CMPHEADERS="cmpheaders";
+const char *SENDMNBUNDLE="sendmnbundle";
+const char *MNPINGBUNDLE="mnpingbundle";
+const char *MNPAYMENTVOTEBUNDLE="mnwbundle";
+const char *GETCFILTERS="getcfilters";
+const char *CFILTER="cfilter";
+const char *GETCFHEADERS="getcfheaders";
+const char *CFHEADERS="cfheaders";
+const char *GETCFCHECKPT="getcfcheckpt";
+const char *CFCHECKPT="cfcheckpt";
+// VELES END
 } // namespace NetMsgType
 
 /** All known message types. Keep this in the same order as the list of
@@ -125,6 +140,21 @@ const static std::string allNetMessageTypes[] = {
     NetMsgType::MNGOVERNANCEOBJECT,
     NetMsgType::MNGOVERNANCEOBJECTVOTE,
     NetMsgType::MNVERIFY,
+    // VELES BEGIN
+    NetMsgType::GETMNLISTDIFF,
+    NetMsgType::MNLISTDIFF,
+    NetMsgType::SENDCMPHEADERS,
+    NetMsgType::CMPHEADERS,
+    NetMsgType::SENDMNBUNDLE,
+    NetMsgType::MNPINGBUNDLE,
+    NetMsgType::MNPAYMENTVOTEBUNDLE,
+    NetMsgType::GETCFILTERS,
+    NetMsgType::CFILTER,
+    NetMsgType::GETCFHEADERS,
+    NetMsgType::CFHEADERS,
+    NetMsgType::GETCFCHECKPT,
+    NetMsgType::CFCHECKPT,
+    // VELES END
 };
 const static std::vector<std::string> allNetMessageTypesVec(allNetMessageTypes, allNetMessageTypes+ARRAYLEN(allNetMessageTypes));
 
@@ -266,6 +266,84 @@ extern const char *MNGOVERNANCESYNC;
 extern const char *MNGOVERNANCEOBJECT;
 extern const char *MNGOVERNANCEOBJECTVOTE;
 extern const char *MNVERIFY;
+// VELES BEGIN
+/**
+ * Asks for the masternode list changes since a block hash, a null hash asks
+ * for the whole list.
+ * @since protocol version 80011
+ */
+extern const char *GETMNLISTDIFF;
+/**
+ * Contains masternode broadcasts, pings and removed collaterals.
+ * Sent in response to a "getmnlistd" message.
+ * @since protocol version 80011
+ */
+extern const char *MNLISTDIFF;
+/**
+ * Indicates that a node prefers to receive headers in "cmpheaders" messages
+ * rather than "headers" messages.
+ * @since protocol version 80012
+ */
+extern const char *SENDCMPHEADERS;
+/**
+ * Contains CompressedHeaders, the same headers as a "headers" message
+ * without the parts implied by the headers before them.
+ * @since protocol version 80012
+ */
+extern const char *CMPHEADERS;
+/**
+ * Indicates that a node prefers to receive the masternode pings and payment
+ * votes it asks for in "mnpingbundle" and "mnwbundle" messages.
+ * @since protocol version 80013
+ */
+extern const char *SENDMNBUNDLE;
+/**
+ * Contains the masternode pings of many "mnp" messages.
+ * @since protocol version 80013
+ */
+extern const char *MNPINGBUNDLE;
+/**
+ * Contains the masternode payment votes of many "mnw" messages.
+ * @since protocol version 80013
+ */
+extern const char *MNPAYMENTVOTEBUNDLE;
+/**
+ * getcfilters requests compact filters for a range of blocks.
+ * Only available with service bit NODE_COMPACT_FILTERS as described by
+ * BIP 157 & 158.
+ */
+extern const char *GETCFILTERS;
+/**
+ * cfilter is a response to a getcfilters request containing a single compact
+ * filter.
+ */
+extern const char *CFILTER;
+/**
+ * getcfheaders requests a compact filter header and the filter hashes for a
+ * range of blocks, which can then be used to reconstruct the filter headers
+ * for those blocks.
+ * Only available with service bit NODE_COMPACT_FILTERS as described by
+ * BIP 157 & 158.
+ */
+extern const char *GETCFHEADERS;
+/**
+ * cfheaders is a response to a getcfheaders request containing a filter header
+ * and a vector of filter hashes for each subsequent block in the requested range.
+ */
+extern const char *CFHEADERS;
+/**
+ * getcfcheckpt requests evenly spaced compact filter headers, enabling
+ * parallelized download and validation of the headers between them.
+ * Only available with service bit NODE_COMPACT_FILTERS as described by
+ * BIP 157 & 158.
+ */
+extern const char *GETCFCHECKPT;
+/**
+ * cfcheckpt is a response to a getcfcheckpt request containing a vector of
+ * evenly spaced filter headers for blocks on the requested chain.
+ */
+extern const char *CFCHECKPT;
+// VELES END
 };
 
 /* Get a vector of all valid message types (see above) */
@@ -292,6 +370,11 @@ enum ServiceFlags : uint64_t {
     // NODE_XTHIN means the node supports Xtreme Thinblocks
     // If this is turned off then the node will not service nor make xthin requests
     NODE_XTHIN = (1 << 4),
+    // VELES BEGIN
+    // NODE_COMPACT_FILTERS means the node will service basic block filter requests.
+    // See BIP157 and BIP158 for details on how this is implemented.
+    NODE_COMPACT_FILTERS = (1 << 6),
+    // VELES END
     // NODE_NETWORK_LIMITED means the same as NODE_NETWORK with the limitation of only
     // serving the last 288 (2 day) blocks
     // See BIP159 for details on how this is implemented.
@@ -183,6 +183,47 @@ bool CPubKey::Verify(const uint256 &hash, const std::vector<unsigned char>& vchS
     return secp256k1_ecdsa_verify(secp256k1_context_verify, &sig, hash.begin(), &pubkey);
 }
 
+// VELES BEGIN
+bool CPubKey::VerifyBatch(const std::vector<CSignatureVerification>& vSigs, std::vector<bool>& vResults) {
+    vResults.assign(vSigs.size(), false);
+    std::vector<secp256k1_ecdsa_signature> vParsedSigs;
+    std::vector<secp256k1_pubkey> vPubKeys;
+    std::vector<unsigned char> vMsgs;
+    std::vector<size_t> vIndex;
+    vParsedSigs.reserve(vSigs.size());
+    vPubKeys.reserve(vSigs.size());
+    vMsgs.reserve(32 * vSigs.size());
+    vIndex.reserve(vSigs.size());
+    bool fAllValid = true;
+    for (size_t i = 0; i < vSigs.size(); i++) {
+        const CSignatureVerification& sig = vSigs[i];
+        secp256k1_pubkey pubkey;
+        secp256k1_ecdsa_signature parsed;
+        if (!sig.pubkey.IsValid() ||
+            !secp256k1_ec_pubkey_parse(secp256k1_context_verify, &pubkey, sig.pubkey.begin(), sig.pubkey.size()) ||
+            !ecdsa_signature_parse_der_lax(secp256k1_context_verify, &parsed, sig.vchSig.data(), sig.vchSig.size())) {
+            fAllValid = false;
+            continue;
+        }
+        // Normalized like in Verify
+        secp256k1_ecdsa_signature_normalize(secp256k1_context_verify, &parsed, &parsed);
+        vParsedSigs.push_back(parsed);
+        vPubKeys.push_back(pubkey);
+        vMsgs.insert(vMsgs.end(), sig.hash.begin(), sig.hash.end());
+        vIndex.push_back(i);
+    }
+    if (vIndex.empty()) return fAllValid;
+
+    std::vector<int> vValid(vIndex.size());
+    secp256k1_ecdsa_verify_batch(secp256k1_context_verify, vValid.data(), vParsedSigs.data(), vMsgs.data(), vPubKeys.data(), vIndex.size());
+    for (size_t i = 0; i < vIndex.size(); i++) {
+        vResults[vIndex[i]] = vValid[i];
+        fAllValid &= vValid[i] != 0;
+    }
+    return fAllValid;
+}
+// VELES END
+
 bool CPubKey::RecoverCompact(const uint256 &hash, const std::vector<unsigned char>& vchSig) {
     if (vchSig.size() != COMPACT_SIGNATURE_SIZE)
         return false;
@@ -27,6 +27,8 @@ public:
 typedef uint256 ChainCode;
 
 /** An encapsulated public key. */
+struct CSignatureVerification; // VELES
+
 class CPubKey
 {
 public:
@@ -188,6 +190,15 @@ public:
      */
     bool Verify(const uint256& hash, const std::vector<unsigned char>& vchSig) const;
 
+    // VELES BEGIN
+    /**
+     * Verify several DER signatures at once, cheaper than verifying them one by one.
+     * vResults is set to the result Verify would give for every signature, returns
+     * whether all of them are valid.
+     */
+    static bool VerifyBatch(const std::vector<CSignatureVerification>& vSigs, std::vector<bool>& vResults);
+    // VELES END
+
     /**
      * Check whether a signature is normalized (lower-S).
      */
@@ -203,6 +214,18 @@ public:
     bool Derive(CPubKey& pubkeyChild, ChainCode &ccChild, unsigned int nChild, const ChainCode& cc) const;
 };
 
+// VELES BEGIN
+/** A signature to verify with CPubKey::VerifyBatch */
+struct CSignatureVerification {
+    CPubKey pubkey;
+    uint256 hash;
+    std::vector<unsigned char> vchSig;
+
+    CSignatureVerification(const CPubKey& pubkeyIn, const uint256& hashIn, const std::vector<unsigned char>& vchSigIn) :
+        pubkey(pubkeyIn), hash(hashIn), vchSig(vchSigIn) {}
+};
+// VELES END
+
 struct CExtPubKey {
     unsigned char nDepth;
     unsigned char vchFingerprint[4];
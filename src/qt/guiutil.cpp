@@ -962,6 +962,11 @@ QString formatServicesStr(quint64 mask)
             case NODE_XTHIN:
                 strList.append("XTHIN");
                 break;
+            // VELES BEGIN
+            case NODE_COMPACT_FILTERS:
+                strList.append("COMPACT_FILTERS");
+                break;
+            // VELES END
             default:
                 strList.append(QString("%1[%2]").arg("UNKNOWN").arg(check));
             }
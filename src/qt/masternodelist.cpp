@@ -8,6 +8,7 @@
 
 #include <qt/clientmodel.h>
 #include <qt/guiutil.h>
+#include <qt/masternodetablemodel.h> // VELES
 #include <init.h>
 #include <key_io.h>
 #include <masternode/activemasternode.h>
@@ -30,6 +31,7 @@
 #include <QJsonArray>
 #include <QDesktopServices>
 #include <QUrl>
+#include <QSortFilterProxyModel> // VELES
 
 int GetOffsetFromUtc()
 {
@@ -85,6 +87,21 @@ MasternodeList::MasternodeList(const PlatformStyle *platformStyle, QWidget *pare
     ui->tableWidgetMyMasternodes->setColumnWidth(4, columnActiveWidth);
     ui->tableWidgetMyMasternodes->setColumnWidth(5, columnLastSeenWidth);
 
+    // VELES BEGIN
+    // The list is diffed on a background thread and updated a row at a time
+    masternodeModel = new MasternodeTableModel(MASTERNODELIST_UPDATE_SECONDS, this);
+    masternodeProxyModel = new QSortFilterProxyModel(this);
+    masternodeProxyModel->setSourceModel(masternodeModel);
+    masternodeProxyModel->setDynamicSortFilter(true);
+    masternodeProxyModel->setSortRole(MasternodeTableModel::SortRole);
+    masternodeProxyModel->setFilterKeyColumn(-1);
+    ui->tableWidgetMasternodes->setModel(masternodeProxyModel);
+    connect(masternodeProxyModel, &QSortFilterProxyModel::rowsInserted, this, &MasternodeList::updateNodeCount);
+    connect(masternodeProxyModel, &QSortFilterProxyModel::rowsRemoved, this, &MasternodeList::updateNodeCount);
+    connect(masternodeProxyModel, &QSortFilterProxyModel::modelReset, this, &MasternodeList::updateNodeCount);
+    connect(masternodeProxyModel, &QSortFilterProxyModel::layoutChanged, this, &MasternodeList::updateNodeCount);
+    // VELES END
+
     ui->tableWidgetMasternodes->setColumnWidth(0, columnAddressWidth);
     ui->tableWidgetMasternodes->setColumnWidth(1, columnProtocolWidth);
     ui->tableWidgetMasternodes->setColumnWidth(2, columnStatusWidth);
@@ -110,14 +127,17 @@ MasternodeList::MasternodeList(const PlatformStyle *platformStyle, QWidget *pare
     connect(startAliasAction, &QAction::triggered, [this]{ on_startButton_clicked(); });
 
     timer = new QTimer(this);
-    connect(timer, &QTimer::timeout, [this]{ updateNodeList(); });
+    //connect(timer, &QTimer::timeout, [this]{ updateNodeList(); }); // VELES
     connect(timer, &QTimer::timeout, [this]{ updateMyNodeList(); });
     //connect(timer, &QTimer::timeout, [this]{ updateDappsNodeList(); }); //VELES
     timer->start(1000);
 
-    fFilterUpdated = false;
-    nTimeFilterUpdated = GetTime();
-    updateNodeList();
+    // VELES BEGIN
+    //fFilterUpdated = false;
+    //nTimeFilterUpdated = GetTime();
+    //updateNodeList();
+    updateNodeCount();
+    // VELES END
     updateDappsNodeList(); // VELES
 }
 
@@ -131,7 +151,7 @@ void MasternodeList::setClientModel(ClientModel *model)
     this->clientModel = model;
     if(model) {
         // try to update list when masternode count changes
-        connect(clientModel, &ClientModel::strMasternodesChanged, this, &MasternodeList::updateNodeList);
+        //connect(clientModel, &ClientModel::strMasternodesChanged, this, &MasternodeList::updateNodeList); // VELES
     }
 }
 
@@ -295,6 +315,8 @@ void MasternodeList::updateMyNodeList(bool fForce)
     ui->secondsLabel->setText("0");
 }
 
+// VELES BEGIN
+/*
 void MasternodeList::updateNodeList()
 {
     TRY_LOCK(cs_mnlist, fLockAcquired);
@@ -359,6 +381,12 @@ void MasternodeList::updateNodeList()
     ui->countLabel->setText(QString::number(ui->tableWidgetMasternodes->rowCount()));
     ui->tableWidgetMasternodes->setSortingEnabled(true);
 }
+*/
+void MasternodeList::updateNodeCount()
+{
+    ui->countLabel->setText(QString::number(masternodeProxyModel->rowCount()));
+}
+// VELES END
 
 // VELES BEGIN
 void MasternodeList::updateDappsNodeList(bool fForce)
@@ -476,10 +504,16 @@ void MasternodeList::updateDappsNodeList(bool fForce)
 
 void MasternodeList::on_filterLineEdit_textChanged(const QString &strFilterIn)
 {
+    // VELES BEGIN
+    /*
     strCurrentFilter = strFilterIn;
     nTimeFilterUpdated = GetTime();
     fFilterUpdated = true;
     ui->countLabel->setText(QString::fromStdString(strprintf("Please wait... %d", MASTERNODELIST_FILTER_COOLDOWN_SECONDS)));
+    */
+    masternodeProxyModel->setFilterFixedString(strFilterIn);
+    updateNodeCount();
+    // VELES END
 }
 
 void MasternodeList::on_startButton_clicked()
@@ -25,12 +25,16 @@ namespace Ui {
 }
 
 class ClientModel;
+class MasternodeTableModel; // VELES
 class WalletModel;
 
 QT_BEGIN_NAMESPACE
 class QModelIndex;
+class QSortFilterProxyModel; // VELES
 QT_END_NAMESPACE
 
+int GetOffsetFromUtc(); // VELES
+
 /** Masternode Manager page widget */
 class MasternodeList : public QWidget
 {
@@ -47,13 +51,16 @@ public:
 
 private:
     QMenu *contextMenu;
-    int64_t nTimeFilterUpdated;
-    bool fFilterUpdated;
+    // VELES BEGIN
+    //int64_t nTimeFilterUpdated;
+    //bool fFilterUpdated;
+    // VELES END
 
 public Q_SLOTS:
     void updateMyMasternodeInfo(QString strAlias, QString strAddr, const COutPoint& outpoint);
     void updateMyNodeList(bool fForce = false);
-    void updateNodeList();
+    //void updateNodeList();
+    void updateNodeCount(); // VELES
     void updateDappsNodeList(bool fForce = false); // VELES
 
 Q_SIGNALS:
@@ -64,8 +71,12 @@ private:
     ClientModel *clientModel;
     WalletModel *walletModel;
 
+    // VELES BEGIN
     // Protects tableWidgetMasternodes
-    CCriticalSection cs_mnlist;
+    //CCriticalSection cs_mnlist;
+    MasternodeTableModel *masternodeModel;
+    QSortFilterProxyModel *masternodeProxyModel;
+    // VELES END
 
     // Protects tableWidgetMyMasternodes
     CCriticalSection cs_mymnlist;
@@ -73,7 +84,7 @@ private:
     // Protects tableWidgetDappMasternodes
     CCriticalSection cs_dappmnlist;
 
-    QString strCurrentFilter;
+    //QString strCurrentFilter; // VELES
 
 private Q_SLOTS:
     void showContextMenu(const QPoint &);
@@ -0,0 +1,186 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <qt/masternodetablemodel.h>
+
+#include <key_io.h>
+#include <masternode/manager.h>
+#include <qt/masternodelist.h>
+#include <util/time.h>
+
+#include <QTimer>
+
+#include <algorithm>
+
+// Comparison operator for the binary search of the rows
+struct MasternodeRowLessThan
+{
+    bool operator()(const MasternodeTableRow &a, const COutPoint &b) const
+    {
+        return a.outpoint < b;
+    }
+};
+
+bool MasternodeTableRow::operator==(const MasternodeTableRow& other) const
+{
+    return outpoint == other.outpoint && strAddress == other.strAddress &&
+           nProtocolVersion == other.nProtocolVersion && strStatus == other.strStatus &&
+           nActiveSeconds == other.nActiveSeconds && nTimeLastSeen == other.nTimeLastSeen &&
+           strPayee == other.strPayee;
+}
+
+void MasternodeTableWorker::start()
+{
+    timer = new QTimer(this);
+    connect(timer, &QTimer::timeout, this, &MasternodeTableWorker::poll);
+    timer->start(1000);
+    poll();
+}
+
+void MasternodeTableWorker::poll()
+{
+    const int64_t nNow = GetTime();
+    if (nTimeUpdated != 0 && nNow < nTimeUpdated + nUpdateSeconds) return;
+    uint64_t nVersion = mnodeman.GetListVersion();
+    if (nTimeUpdated != 0 && nVersion == nListVersion) return;
+
+    // Only the info of the masternodes is copied under the lock of the manager
+    const std::vector<masternode_info_t> vInfos = mnodeman.GetMasternodeInfos(nVersion);
+    nListVersion = nVersion;
+    nTimeUpdated = nNow;
+
+    MasternodeTableDiff diff;
+    std::map<COutPoint, MasternodeTableRow> mapNewRows;
+    for (const masternode_info_t& info : vInfos) {
+        MasternodeTableRow row;
+        row.outpoint = info.vin.prevout;
+        row.strAddress = QString::fromStdString(info.addr.ToString());
+        row.nProtocolVersion = info.nProtocolVersion;
+        row.strStatus = QString::fromStdString(CMasternode::StateToString(info.nActiveState));
+        row.nActiveSeconds = info.nTimeLastPing - info.sigTime;
+        row.nTimeLastSeen = info.nTimeLastPing;
+        row.strPayee = QString::fromStdString(EncodeDestination(info.pubKeyCollateralAddress.GetID()));
+
+        auto it = mapRows.find(row.outpoint);
+        if (it == mapRows.end() || !(it->second == row)) {
+            diff.vUpdated.append(row);
+        }
+        mapNewRows.emplace(row.outpoint, row);
+    }
+    for (const auto& entry : mapRows) {
+        if (!mapNewRows.count(entry.first)) {
+            diff.vRemoved.push_back(entry.first);
+        }
+    }
+    mapRows.swap(mapNewRows);
+
+    if (!diff.vUpdated.isEmpty() || !diff.vRemoved.empty()) {
+        Q_EMIT listChanged(diff);
+    }
+}
+
+MasternodeTableModel::MasternodeTableModel(int nUpdateSeconds, QObject *parent) :
+    QAbstractTableModel(parent)
+{
+    columns << tr("Address") << tr("Protocol") << tr("Status") << tr("Active") << tr("Last Seen") << tr("Payee");
+
+    qRegisterMetaType<MasternodeTableDiff>("MasternodeTableDiff");
+
+    MasternodeTableWorker *worker = new MasternodeTableWorker(nUpdateSeconds);
+    worker->moveToThread(&thread);
+
+    // Diffs from the worker are applied on the GUI thread
+    connect(worker, &MasternodeTableWorker::listChanged, this, &MasternodeTableModel::applyDiff);
+    connect(&thread, &QThread::started, worker, &MasternodeTableWorker::start);
+
+    // Make sure the worker is deleted in its own thread
+    connect(&thread, &QThread::finished, worker, &MasternodeTableWorker::deleteLater);
+
+    thread.start();
+}
+
+MasternodeTableModel::~MasternodeTableModel()
+{
+    thread.quit();
+    thread.wait();
+}
+
+int MasternodeTableModel::rowCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return rows.size();
+}
+
+int MasternodeTableModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return columns.length();
+}
+
+QVariant MasternodeTableModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= rows.size()) return QVariant();
+    const MasternodeTableRow& row = rows.at(index.row());
+
+    if (role == Qt::DisplayRole) {
+        switch (index.column()) {
+        case Address: return row.strAddress;
+        case Protocol: return QString::number(row.nProtocolVersion);
+        case Status: return row.strStatus;
+        case Active: return QString::fromStdString(DurationToDHMS(row.nActiveSeconds));
+        case LastSeen: return QString::fromStdString(FormatISO8601DateTime(row.nTimeLastSeen + GetOffsetFromUtc()));
+        case Payee: return row.strPayee;
+        }
+    } else if (role == SortRole) {
+        switch (index.column()) {
+        case Address: return row.strAddress;
+        case Protocol: return row.nProtocolVersion;
+        case Status: return row.strStatus;
+        case Active: return qint64(row.nActiveSeconds);
+        case LastSeen: return qint64(row.nTimeLastSeen);
+        case Payee: return row.strPayee;
+        }
+    }
+    return QVariant();
+}
+
+QVariant MasternodeTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section >= 0 && section < columns.size()) {
+        return columns[section];
+    }
+    return QVariant();
+}
+
+void MasternodeTableModel::applyDiff(const MasternodeTableDiff& diff)
+{
+    // The first diff has every masternode, in collateral order
+    if (rows.isEmpty()) {
+        beginResetModel();
+        rows = diff.vUpdated;
+        endResetModel();
+        return;
+    }
+
+    for (const COutPoint& outpoint : diff.vRemoved) {
+        auto it = std::lower_bound(rows.begin(), rows.end(), outpoint, MasternodeRowLessThan());
+        if (it == rows.end() || it->outpoint != outpoint) continue;
+        const int nRow = it - rows.begin();
+        beginRemoveRows(QModelIndex(), nRow, nRow);
+        rows.removeAt(nRow);
+        endRemoveRows();
+    }
+    for (const MasternodeTableRow& row : diff.vUpdated) {
+        auto it = std::lower_bound(rows.begin(), rows.end(), row.outpoint, MasternodeRowLessThan());
+        const int nRow = it - rows.begin();
+        if (it != rows.end() && it->outpoint == row.outpoint) {
+            *it = row;
+            Q_EMIT dataChanged(index(nRow, 0), index(nRow, columns.size() - 1));
+        } else {
+            beginInsertRows(QModelIndex(), nRow, nRow);
+            rows.insert(nRow, row);
+            endInsertRows();
+        }
+    }
+}
@@ -0,0 +1,112 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef VELES_QT_MASTERNODETABLEMODEL_H
+#define VELES_QT_MASTERNODETABLEMODEL_H
+
+#include <primitives/transaction.h>
+
+#include <QAbstractTableModel>
+#include <QList>
+#include <QMetaType>
+#include <QStringList>
+#include <QThread>
+
+#include <map>
+#include <vector>
+
+QT_BEGIN_NAMESPACE
+class QTimer;
+QT_END_NAMESPACE
+
+/** What the masternode list shows of a masternode */
+struct MasternodeTableRow
+{
+    COutPoint outpoint;
+    QString strAddress;
+    int nProtocolVersion;
+    QString strStatus;
+    int64_t nActiveSeconds;
+    int64_t nTimeLastSeen;
+    QString strPayee;
+
+    bool operator==(const MasternodeTableRow& other) const;
+};
+
+/** Masternodes added or changed, and removed since the previous diff */
+struct MasternodeTableDiff
+{
+    QList<MasternodeTableRow> vUpdated;
+    std::vector<COutPoint> vRemoved;
+};
+
+Q_DECLARE_METATYPE(MasternodeTableDiff)
+
+/** Polls the version of the masternode list on a background thread, and diffs
+ * the rows against those of the previous poll once it changed.
+ */
+class MasternodeTableWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MasternodeTableWorker(int nUpdateSecondsIn) : nUpdateSeconds(nUpdateSecondsIn) {}
+
+public Q_SLOTS:
+    void start();
+    void poll();
+
+Q_SIGNALS:
+    void listChanged(const MasternodeTableDiff& diff);
+
+private:
+    //! Minimum time between two diffs
+    const int nUpdateSeconds;
+    QTimer *timer = nullptr;
+    uint64_t nListVersion = 0;
+    //! Time of the last diff, 0 before the first one
+    int64_t nTimeUpdated = 0;
+    //! Rows of the last diff, as the model has them
+    std::map<COutPoint, MasternodeTableRow> mapRows;
+};
+
+/** UI model for the masternode list, updated a row at a time from the diffs of
+ * the worker.
+ */
+class MasternodeTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    explicit MasternodeTableModel(int nUpdateSeconds, QObject *parent = nullptr);
+    ~MasternodeTableModel();
+
+    enum ColumnIndex {
+        Address = 0,
+        Protocol = 1,
+        Status = 2,
+        Active = 3,
+        LastSeen = 4,
+        Payee = 5
+    };
+
+    /** Raw value of a column, to sort by */
+    static const int SortRole = Qt::UserRole;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+
+public Q_SLOTS:
+    void applyDiff(const MasternodeTableDiff& diff);
+
+private:
+    QStringList columns;
+    //! Sorted by collateral outpoint
+    QList<MasternodeTableRow> rows;
+    QThread thread;
+};
+
+#endif // VELES_QT_MASTERNODETABLEMODEL_H
@@ -26,6 +26,14 @@
 #include <QDebug>
 #include <QIcon>
 #include <QList>
+// VELES BEGIN
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <atomic>
+#include <map>
+#include <thread>
+// VELES END
 
 
 // Amount column is right-aligned it contains numbers
@@ -64,6 +72,27 @@ public:
     {
     }
 
+    // VELES BEGIN
+    ~TransactionTablePriv()
+    {
+        fInterruptLoad = true;
+        if (loadThread.joinable()) {
+            loadThread.join();
+        }
+    }
+
+    /* Wallet transactions decomposed at a time while loading */
+    static const size_t LOAD_PAGE_SIZE = 1000;
+
+    /* Records of the wallet transactions following the previous page */
+    struct Page
+    {
+        QList<TransactionRecord> records;
+        uint256 hashLast;
+        bool fLast;
+    };
+    // VELES END
+
     TransactionTableModel *parent;
 
     /* Local cache of wallet.
@@ -72,12 +101,88 @@ public:
      */
     QList<TransactionRecord> cachedWallet;
 
+    // VELES BEGIN
+    /* The wallet is loaded in pages in hash order, cachedWallet holds the
+     * transactions up to hashLoaded while fLoading.
+     */
+    bool fLoading = false;
+    uint256 hashLoaded;
+    /* Latest change of the transactions not loaded yet, replayed once their page is in */
+    std::map<uint256, bool> mapPendingUpdates;
+
+    std::thread loadThread;
+    std::atomic<bool> fInterruptLoad{false};
+    QMutex mutexPages;
+    QList<Page> loadedPages;
+
+    static Page loadPage(interfaces::Wallet& wallet, const uint256& hashAfter)
+    {
+        Page page;
+        const std::vector<interfaces::WalletTx> wtxs = wallet.getWalletTxs(hashAfter, LOAD_PAGE_SIZE);
+        for (const auto& wtx : wtxs) {
+            if (TransactionRecord::showTransaction()) {
+                page.records.append(TransactionRecord::decomposeTransaction(wtx));
+            }
+        }
+        page.hashLast = wtxs.empty() ? hashAfter : wtxs.back().tx->GetHash();
+        page.fLast = wtxs.size() < LOAD_PAGE_SIZE;
+        return page;
+    }
+
+    /* Decompose the rest of the wallet on the load thread, handing the pages to the GUI thread */
+    void loadPages(interfaces::Wallet& wallet, uint256 hashAfter)
+    {
+        while (!fInterruptLoad) {
+            Page page = loadPage(wallet, hashAfter);
+            hashAfter = page.hashLast;
+            const bool fLast = page.fLast;
+            {
+                QMutexLocker locker(&mutexPages);
+                loadedPages.append(page);
+            }
+            QMetaObject::invokeMethod(parent, "loadPendingRecords", Qt::QueuedConnection);
+            if (fLast) break;
+        }
+    }
+
+    /* Append the pages decomposed since the last call. They follow every record in
+     * the model, so the rows go at the end and the cache stays sorted.
+     */
+    void applyPages(interfaces::Wallet& wallet)
+    {
+        QList<Page> pages;
+        {
+            QMutexLocker locker(&mutexPages);
+            pages.swap(loadedPages);
+        }
+        for (const Page& page : pages) {
+            if (!page.records.isEmpty()) {
+                parent->beginInsertRows(QModelIndex(), cachedWallet.size(), cachedWallet.size() + page.records.size() - 1);
+                cachedWallet.append(page.records);
+                parent->endInsertRows();
+            }
+            hashLoaded = page.hashLast;
+            fLoading = !page.fLast;
+
+            // The pending changes are replayed as updates, which add or remove the
+            // transaction depending on whether the page had it
+            auto it = mapPendingUpdates.begin();
+            while (it != mapPendingUpdates.end() && (!fLoading || !(hashLoaded < it->first))) {
+                updateWallet(wallet, it->first, CT_UPDATED, it->second);
+                it = mapPendingUpdates.erase(it);
+            }
+        }
+    }
+    // VELES END
+
     /* Query entire wallet anew from core.
      */
     void refreshWallet(interfaces::Wallet& wallet)
     {
         qDebug() << "TransactionTablePriv::refreshWallet";
         cachedWallet.clear();
+        // VELES BEGIN
+        /*
         {
             for (const auto& wtx : wallet.getWalletTxs()) {
                 if (TransactionRecord::showTransaction()) {
@@ -85,6 +190,17 @@ public:
                 }
             }
         }
+        */
+        // The first page is shown right away, the rest of the wallet is decomposed
+        // on a background thread and added a page at a time
+        Page page = loadPage(wallet, uint256());
+        cachedWallet = page.records;
+        hashLoaded = page.hashLast;
+        fLoading = !page.fLast;
+        if (fLoading) {
+            loadThread = std::thread(&TransactionTablePriv::loadPages, this, std::ref(wallet), hashLoaded);
+        }
+        // VELES END
     }
 
     /* Update our model of the wallet incrementally, to synchronize our model of the wallet
@@ -96,6 +212,14 @@ public:
     {
         qDebug() << "TransactionTablePriv::updateWallet: " + QString::fromStdString(hash.ToString()) + " " + QString::number(status);
 
+        // VELES BEGIN
+        if (fLoading && hashLoaded < hash) {
+            // Not loaded yet, checked again once its page is in
+            mapPendingUpdates[hash] = status != CT_DELETED && showTransaction;
+            return;
+        }
+        // VELES END
+
         // Find bounds of this transaction in model
         QList<TransactionRecord>::iterator lower = qLowerBound(
             cachedWallet.begin(), cachedWallet.end(), hash, TxLessThan());
@@ -253,6 +377,13 @@ void TransactionTableModel::updateTransaction(const QString &hash, int status, b
     priv->updateWallet(walletModel->wallet(), updated, status, showTransaction);
 }
 
+// VELES BEGIN
+void TransactionTableModel::loadPendingRecords()
+{
+    priv->applyPages(walletModel->wallet());
+}
+// VELES END
+
 void TransactionTableModel::updateConfirmations()
 {
     // Blocks came in since last poll.
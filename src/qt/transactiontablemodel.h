@@ -116,6 +116,10 @@ public Q_SLOTS:
     void updateAmountColumnTitle();
     /* Needed to update fProcessingQueuedTransactions through a QueuedConnection */
     void setProcessingQueuedTransactions(bool value) { fProcessingQueuedTransactions = value; }
+    // VELES BEGIN
+    /* Add the pages of the wallet decomposed by the load thread */
+    void loadPendingRecords();
+    // VELES END
 
     friend class TransactionTablePriv;
 };
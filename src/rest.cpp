@@ -7,11 +7,24 @@
 #include <chain.h>
 #include <chainparams.h>
 #include <core_io.h>
+// VELES BEGIN
+#include <blockdelta.h>
+#include <governance/governance.h>
+#include <governance/object.h>
+#include <governance/vote.h>
+#include <hash.h>
+#include <instantx.h>
+#include <key_io.h>
+#include <masternode/manager.h>
+#include <masternode/masternode.h>
+// VELES END
 #include <httpserver.h>
 #include <index/txindex.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <rpc/blockchain.h>
+#include <rpc/jsonstream.h> // VELES
+#include <rpc/mining.h> // VELES
 #include <rpc/server.h>
 #include <streams.h>
 #include <sync.h>
@@ -242,10 +255,17 @@ static bool rest_block(HTTPRequest* req,
     }
 
     case RetFormat::JSON: {
-        UniValue objBlock = blockToJSON(block, tip, pblockindex, showTxDetails);
-        std::string strJSON = objBlock.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        // VELES BEGIN
+        //UniValue objBlock = blockToJSON(block, tip, pblockindex, showTxDetails);
+        //std::string strJSON = objBlock.write() + "\n";
+        //req->WriteHeader("Content-Type", "application/json");
+        //req->WriteReply(HTTP_OK, strJSON);
+        HTTPStreamedReply reply(req, HTTP_OK, "application/json");
+        JSONStreamWriter writer([&reply](const std::string& strChunk) { reply.Write(strChunk); });
+        blockToJSONStream(writer, block, tip, pblockindex, showTxDetails);
+        writer.WriteRaw("\n");
+        reply.End(writer.TakeBuffer());
+        // VELES END
         return true;
     }
 
@@ -322,11 +342,18 @@ static bool rest_mempool_contents(HTTPRequest* req, const std::string& strURIPar
 
     switch (rf) {
     case RetFormat::JSON: {
-        UniValue mempoolObject = mempoolToJSON(true);
-
-        std::string strJSON = mempoolObject.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        // VELES BEGIN
+        //UniValue mempoolObject = mempoolToJSON(true);
+        //
+        //std::string strJSON = mempoolObject.write() + "\n";
+        //req->WriteHeader("Content-Type", "application/json");
+        //req->WriteReply(HTTP_OK, strJSON);
+        HTTPStreamedReply reply(req, HTTP_OK, "application/json");
+        JSONStreamWriter writer([&reply](const std::string& strChunk) { reply.Write(strChunk); });
+        mempoolToJSONStream(writer);
+        writer.WriteRaw("\n");
+        reply.End(writer.TakeBuffer());
+        // VELES END
         return true;
     }
     default: {
@@ -621,6 +648,412 @@ static bool rest_blockhash_by_height(HTTPRequest* req,
     }
 }
 
+// VELES BEGIN
+/** Masternode list entry of /rest/masternodes */
+struct CRESTMasternode {
+    COutPoint outpoint;
+    CService addr;
+    CPubKey pubKeyCollateralAddress;
+    CPubKey pubKeyMasternode;
+    int32_t nProtocolVersion;
+    int32_t nActiveState;
+    int64_t nSigTime;
+    int64_t nLastSeen;
+    int64_t nLastPaidTime;
+    int32_t nLastPaidBlock;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(outpoint);
+        READWRITE(addr);
+        READWRITE(pubKeyCollateralAddress);
+        READWRITE(pubKeyMasternode);
+        READWRITE(nProtocolVersion);
+        READWRITE(nActiveState);
+        READWRITE(nSigTime);
+        READWRITE(nLastSeen);
+        READWRITE(nLastPaidTime);
+        READWRITE(nLastPaidBlock);
+    }
+
+    UniValue ToJSON() const
+    {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("outpoint", outpoint.ToStringShort());
+        obj.pushKV("address", addr.ToString());
+        obj.pushKV("payee", EncodeDestination(pubKeyCollateralAddress.GetID()));
+        obj.pushKV("pubkey", HexStr(pubKeyMasternode));
+        obj.pushKV("protocol", nProtocolVersion);
+        obj.pushKV("status", CMasternode::StateToString(nActiveState));
+        obj.pushKV("sigtime", nSigTime);
+        obj.pushKV("lastseen", nLastSeen);
+        obj.pushKV("lastpaidtime", nLastPaidTime);
+        obj.pushKV("lastpaidblock", nLastPaidBlock);
+        return obj;
+    }
+};
+
+/** Governance object of /rest/governance/objects, with its funding votes and cached flags */
+struct CRESTGovernanceObject {
+    uint256 hash;
+    uint256 collateralHash;
+    int32_t nObjectType;
+    int64_t nCreationTime;
+    std::string strData;
+    COutPoint masternodeOutpoint;
+    int32_t nAbsoluteYesCount;
+    int32_t nYesCount;
+    int32_t nNoCount;
+    int32_t nAbstainCount;
+    bool fCachedValid;
+    bool fCachedFunding;
+    bool fCachedDelete;
+    bool fCachedEndorsed;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(hash);
+        READWRITE(collateralHash);
+        READWRITE(nObjectType);
+        READWRITE(nCreationTime);
+        READWRITE(strData);
+        READWRITE(masternodeOutpoint);
+        READWRITE(nAbsoluteYesCount);
+        READWRITE(nYesCount);
+        READWRITE(nNoCount);
+        READWRITE(nAbstainCount);
+        READWRITE(fCachedValid);
+        READWRITE(fCachedFunding);
+        READWRITE(fCachedDelete);
+        READWRITE(fCachedEndorsed);
+    }
+
+    UniValue ToJSON() const
+    {
+        // Same keys as gobject list
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("DataHex", HexStr(strData));
+        obj.pushKV("DataString", strData);
+        obj.pushKV("Hash", hash.ToString());
+        obj.pushKV("CollateralHash", collateralHash.ToString());
+        obj.pushKV("ObjectType", nObjectType);
+        obj.pushKV("CreationTime", nCreationTime);
+        if (!masternodeOutpoint.IsNull()) {
+            obj.pushKV("SigningMasternode", masternodeOutpoint.ToStringShort());
+        }
+        obj.pushKV("AbsoluteYesCount", nAbsoluteYesCount);
+        obj.pushKV("YesCount", nYesCount);
+        obj.pushKV("NoCount", nNoCount);
+        obj.pushKV("AbstainCount", nAbstainCount);
+        obj.pushKV("fCachedValid", fCachedValid);
+        obj.pushKV("fCachedFunding", fCachedFunding);
+        obj.pushKV("fCachedDelete", fCachedDelete);
+        obj.pushKV("fCachedEndorsed", fCachedEndorsed);
+        return obj;
+    }
+};
+
+/** InstantSend state of a transaction, /rest/txlock/<txid> */
+struct CRESTTxLock {
+    uint256 txid;
+    bool fRequest;
+    bool fLocked;
+    bool fTimedOut;
+    int32_t nSignatures;
+    int32_t nMaxSignatures;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(txid);
+        READWRITE(fRequest);
+        READWRITE(fLocked);
+        READWRITE(fTimedOut);
+        READWRITE(nSignatures);
+        READWRITE(nMaxSignatures);
+    }
+
+    UniValue ToJSON() const
+    {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("txid", txid.GetHex());
+        obj.pushKV("request", fRequest);
+        obj.pushKV("locked", fLocked);
+        obj.pushKV("timedout", fTimedOut);
+        obj.pushKV("signatures", nSignatures);
+        obj.pushKV("maxsignatures", nMaxSignatures);
+        return obj;
+    }
+};
+
+/**
+ * Reply with the records in the requested format. The ETag is a hash of their binary encoding, a
+ * client polling with it in If-None-Match gets a 304 and the records are not encoded or sent again.
+ */
+template <typename T>
+static bool RESTReplyWithETag(HTTPRequest* req, RetFormat rf, const T& records, const std::function<UniValue()>& toJSON)
+{
+    CDataStream ssRecords(SER_NETWORK, PROTOCOL_VERSION);
+    ssRecords << records;
+
+    std::string strFormat;
+    for (unsigned int i = 0; i < ARRAYLEN(rf_names); i++)
+        if (rf_names[i].rf == rf)
+            strFormat = rf_names[i].name;
+    const std::string strETag = "\"" + Hash(ssRecords.begin(), ssRecords.end()).GetHex().substr(0, 32) + "-" + strFormat + "\"";
+    req->WriteHeader("ETag", strETag);
+    req->WriteHeader("Cache-Control", "no-cache");
+
+    const std::pair<bool, std::string> ifNoneMatch = req->GetHeader("If-None-Match");
+    if (ifNoneMatch.first && (ifNoneMatch.second == "*" || ifNoneMatch.second.find(strETag) != std::string::npos)) {
+        req->WriteReply(HTTP_NOT_MODIFIED);
+        return true;
+    }
+
+    switch (rf) {
+    case RetFormat::BINARY: {
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, ssRecords.str());
+        return true;
+    }
+    case RetFormat::HEX: {
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, HexStr(ssRecords.begin(), ssRecords.end()) + "\n");
+        return true;
+    }
+    case RetFormat::JSON: {
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, toJSON().write() + "\n");
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+}
+
+static bool rest_masternodes(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    if (rf == RetFormat::UNDEF || !param.empty())
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+
+    std::vector<CRESTMasternode> vMasternodes;
+    for (auto& mnpair : mnodeman.GetFullMasternodeMap()) {
+        CMasternode& mn = mnpair.second;
+        CRESTMasternode entry;
+        entry.outpoint = mnpair.first;
+        entry.addr = mn.addr;
+        entry.pubKeyCollateralAddress = mn.pubKeyCollateralAddress;
+        entry.pubKeyMasternode = mn.pubKeyMasternode;
+        entry.nProtocolVersion = mn.nProtocolVersion;
+        entry.nActiveState = mn.nActiveState;
+        entry.nSigTime = mn.sigTime;
+        entry.nLastSeen = mn.lastPing.sigTime;
+        entry.nLastPaidTime = mn.GetLastPaidTime();
+        entry.nLastPaidBlock = mn.GetLastPaidBlock();
+        vMasternodes.push_back(entry);
+    }
+
+    return RESTReplyWithETag(req, rf, vMasternodes, [&vMasternodes]() {
+        UniValue result(UniValue::VARR);
+        for (const CRESTMasternode& entry : vMasternodes) {
+            result.push_back(entry.ToJSON());
+        }
+        return result;
+    });
+}
+
+static bool rest_governance_objects(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    if (rf == RetFormat::UNDEF || !param.empty())
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+
+    std::vector<CRESTGovernanceObject> vObjects;
+    {
+        LOCK2(cs_main, governance.cs);
+        for (CGovernanceObject* pGovObj : governance.GetAllNewerThan(0)) {
+            CRESTGovernanceObject entry;
+            entry.hash = pGovObj->GetHash();
+            entry.collateralHash = pGovObj->GetCollateralHash();
+            entry.nObjectType = pGovObj->GetObjectType();
+            entry.nCreationTime = pGovObj->GetCreationTime();
+            entry.strData = pGovObj->GetDataAsString();
+            entry.masternodeOutpoint = pGovObj->GetMasternodeVin().prevout;
+            entry.nAbsoluteYesCount = pGovObj->GetAbsoluteYesCount(VOTE_SIGNAL_FUNDING);
+            entry.nYesCount = pGovObj->GetYesCount(VOTE_SIGNAL_FUNDING);
+            entry.nNoCount = pGovObj->GetNoCount(VOTE_SIGNAL_FUNDING);
+            entry.nAbstainCount = pGovObj->GetAbstainCount(VOTE_SIGNAL_FUNDING);
+            entry.fCachedValid = pGovObj->IsSetCachedValid();
+            entry.fCachedFunding = pGovObj->IsSetCachedFunding();
+            entry.fCachedDelete = pGovObj->IsSetCachedDelete();
+            entry.fCachedEndorsed = pGovObj->IsSetCachedEndorsed();
+            vObjects.push_back(entry);
+        }
+    }
+    // The order of the governance map is not stable, the ETag must not depend on it
+    std::sort(vObjects.begin(), vObjects.end(), [](const CRESTGovernanceObject& a, const CRESTGovernanceObject& b) {
+        return a.hash < b.hash;
+    });
+
+    return RESTReplyWithETag(req, rf, vObjects, [&vObjects]() {
+        UniValue result(UniValue::VOBJ);
+        for (const CRESTGovernanceObject& entry : vObjects) {
+            result.pushKV(entry.hash.ToString(), entry.ToJSON());
+        }
+        return result;
+    });
+}
+
+static bool rest_txlock(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string hashStr;
+    const RetFormat rf = ParseDataFormat(hashStr, strURIPart);
+    if (rf == RetFormat::UNDEF)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+
+    uint256 hash;
+    if (!ParseHashStr(hashStr, hash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
+
+    CRESTTxLock txlock;
+    txlock.txid = hash;
+    CTxLockRequest txLockRequest;
+    txlock.fRequest = instantsend.GetTxLockRequest(hash, txLockRequest);
+    txlock.fLocked = instantsend.IsLockedInstantSendTransaction(hash);
+    if (!txlock.fRequest && !txlock.fLocked)
+        return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+    txlock.fTimedOut = instantsend.IsTxLockCandidateTimedOut(hash);
+    txlock.nSignatures = instantsend.GetTransactionLockSignatures(hash);
+    txlock.nMaxSignatures = txlock.fRequest ? txLockRequest.GetMaxSignatures() : 0;
+
+    return RESTReplyWithETag(req, rf, txlock, [&txlock]() { return txlock.ToJSON(); });
+}
+
+static bool rest_blockdelta(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string hashStr;
+    const RetFormat rf = ParseDataFormat(hashStr, strURIPart);
+    if (rf == RetFormat::UNDEF)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+
+    uint256 hash;
+    if (!ParseHashStr(hashStr, hash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
+
+    CBlock block;
+    const CBlockIndex* pblockindex = nullptr;
+    {
+        LOCK(cs_main);
+        pblockindex = LookupBlockIndex(hash);
+        if (!pblockindex)
+            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+
+        if (pblockindex->nHeight > 0 && !(pblockindex->nStatus & BLOCK_HAVE_UNDO))
+            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (not connected or pruned data)");
+
+        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+    }
+
+    CBlockDelta delta;
+    if (!GetBlockDelta(block, pblockindex, true, delta))
+        return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
+
+    return RESTReplyWithETag(req, rf, delta, [&delta]() { return blockDeltaToJSON(delta); });
+}
+
+static bool rest_template(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string algoStr;
+    const RetFormat rf = ParseDataFormat(algoStr, strURIPart);
+    if (rf != RetFormat::BINARY && rf != RetFormat::HEX)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: .bin, .hex)");
+
+    const int32_t nAlgo = GetAlgoId(algoStr);
+    if (nAlgo == ALGO_NULL)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Unknown algorithm: " + algoStr);
+
+    CBinaryBlockTemplate tmpl;
+    std::string strError;
+    if (!GetBinaryBlockTemplate(nAlgo, tmpl, strError))
+        return RESTERR(req, HTTP_SERVICE_UNAVAILABLE, strError);
+
+    CDataStream ssTemplate(SER_NETWORK, PROTOCOL_VERSION);
+    ssTemplate << tmpl;
+    if (rf == RetFormat::BINARY) {
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, ssTemplate.str());
+    } else {
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, HexStr(ssTemplate.begin(), ssTemplate.end()) + "\n");
+    }
+    return true;
+}
+
+static bool rest_submitblock(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    if (req->GetRequestMethod() != HTTPRequest::POST)
+        return RESTERR(req, HTTP_BAD_METHOD, "Only POST requests allowed");
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    if (!param.empty() || (rf != RetFormat::BINARY && rf != RetFormat::HEX))
+        return RESTERR(req, HTTP_NOT_FOUND, "input format not found (available: .bin, .hex)");
+
+    // The block is read as it is sent, the binary one without a hex round trip
+    std::shared_ptr<CBlock> blockptr = std::make_shared<CBlock>();
+    if (rf == RetFormat::BINARY) {
+        const std::string strBody = req->ReadBody();
+        try {
+            CDataStream ssBlock(strBody.data(), strBody.data() + strBody.size(), SER_NETWORK, PROTOCOL_VERSION);
+            ssBlock >> *blockptr;
+            if (!ssBlock.empty())
+                return RESTERR(req, HTTP_BAD_REQUEST, "Block decode failed");
+        } catch (const std::exception&) {
+            return RESTERR(req, HTTP_BAD_REQUEST, "Block decode failed");
+        }
+    } else if (!DecodeHexBlk(*blockptr, boost::trim_copy(req->ReadBody()))) {
+        return RESTERR(req, HTTP_BAD_REQUEST, "Block decode failed");
+    }
+    if (blockptr->vtx.empty() || !blockptr->vtx[0]->IsCoinBase())
+        return RESTERR(req, HTTP_BAD_REQUEST, "Block does not start with a coinbase");
+
+    UniValue result;
+    try {
+        result = SubmitBlock(blockptr);
+    } catch (const UniValue& objError) {
+        return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, find_value(objError, "message").get_str());
+    }
+    // The BIP22 result of submitblock, null when the block was accepted
+    req->WriteHeader("Content-Type", "application/json");
+    req->WriteReply(HTTP_OK, result.write() + "\n");
+    return true;
+}
+// VELES END
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
@@ -634,12 +1067,23 @@ static const struct {
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
       {"/rest/blockhashbyheight/", rest_blockhash_by_height},
+      // VELES BEGIN
+      {"/rest/masternodes", rest_masternodes},
+      {"/rest/governance/objects", rest_governance_objects},
+      {"/rest/txlock/", rest_txlock},
+      {"/rest/blockdelta/", rest_blockdelta},
+      {"/rest/template/", rest_template},
+      {"/rest/submitblock", rest_submitblock},
+      // VELES END
 };
 
 void StartREST()
 {
     for (unsigned int i = 0; i < ARRAYLEN(uri_prefixes); i++)
-        RegisterHTTPHandler(uri_prefixes[i].prefix, false, uri_prefixes[i].handler);
+        // VELES BEGIN
+        //RegisterHTTPHandler(uri_prefixes[i].prefix, false, uri_prefixes[i].handler);
+        RegisterHTTPHandler(uri_prefixes[i].prefix, false, uri_prefixes[i].handler, HTTPWorkQueueClass::REST);
+        // VELES END
 }
 
 void InterruptREST()
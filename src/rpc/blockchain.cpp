@@ -9,19 +9,26 @@
 
 #include <amount.h>
 #include <base58.h>
+#include <blockdelta.h> // VELES
+#include <blockfilter.h> // VELES
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
+#include <clientversion.h> // VELES
 #include <coins.h>
 #include <consensus/validation.h>
 #include <core_io.h>
 #include <hash.h>
+#include <index/blockfilterindex.h> // VELES
+#include <index/coinstatsindex.h> // VELES
+#include <index/timestampindex.h> // VELES
 #include <index/txindex.h>
 #include <key_io.h>
 #include <policy/feerate.h>
 #include <policy/policy.h>
 #include <policy/rbf.h>
 #include <primitives/transaction.h>
+#include <rpc/jsonstream.h> // VELES
 #include <rpc/server.h>
 #include <rpc/util.h>
 #include <script/descriptor.h>
@@ -29,6 +36,7 @@
 #include <sync.h>
 #include <txdb.h>
 #include <txmempool.h>
+#include <utxosnapshot.h> // VELES
 #include <util/strencodings.h>
 #include <util/system.h>
 #include <validation.h>
@@ -43,6 +51,8 @@
 
 #include <boost/thread/thread.hpp> // boost::thread::interrupt
 
+#include <cmath> // VELES
+#include <functional> // VELES
 #include <memory>
 #include <mutex>
 #include <condition_variable>
@@ -117,6 +127,134 @@ UniValue blockheaderToJSON(const CBlockIndex* tip, const CBlockIndex* blockindex
     return result;
 }
 
+// VELES BEGIN
+static void ScriptPubKeyToJSONStream(JSONStreamWriter& writer, const CScript& scriptPubKey)
+{
+    txnouttype type;
+    std::vector<CTxDestination> addresses;
+    int nRequired;
+
+    writer.BeginObject();
+    writer.Key("asm");
+    writer.String(ScriptToAsmStr(scriptPubKey));
+    writer.Key("hex");
+    writer.String(HexStr(scriptPubKey.begin(), scriptPubKey.end()));
+    if (!ExtractDestinations(scriptPubKey, type, addresses, nRequired)) {
+        writer.Key("type");
+        writer.String(GetTxnOutputType(type));
+        writer.EndObject();
+        return;
+    }
+    writer.Key("reqSigs");
+    writer.Int(nRequired);
+    writer.Key("type");
+    writer.String(GetTxnOutputType(type));
+    writer.Key("addresses");
+    writer.BeginArray();
+    for (const CTxDestination& addr : addresses) {
+        writer.String(EncodeDestination(addr));
+    }
+    writer.EndArray();
+    writer.EndObject();
+}
+
+void TxToJSONStream(JSONStreamWriter& writer, const CTransaction& tx, int serialize_flags)
+{
+    const int64_t weight = GetTransactionWeight(tx);
+    writer.BeginObject();
+    writer.Key("txid");
+    writer.String(tx.GetHash().GetHex());
+    writer.Key("hash");
+    writer.String(tx.GetWitnessHash().GetHex());
+    writer.Key("version");
+    writer.Int(tx.nVersion);
+    writer.Key("size");
+    writer.Int(::GetSerializeSize(tx, PROTOCOL_VERSION));
+    writer.Key("vsize");
+    writer.Int((weight + WITNESS_SCALE_FACTOR - 1) / WITNESS_SCALE_FACTOR);
+    writer.Key("weight");
+    writer.Int(weight);
+    writer.Key("locktime");
+    writer.Int(tx.nLockTime);
+
+    writer.Key("vin");
+    writer.BeginArray();
+    for (const CTxIn& txin : tx.vin) {
+        writer.BeginObject();
+        if (tx.IsCoinBase()) {
+            writer.Key("coinbase");
+            writer.String(HexStr(txin.scriptSig.begin(), txin.scriptSig.end()));
+        } else {
+            writer.Key("txid");
+            writer.String(txin.prevout.hash.GetHex());
+            writer.Key("vout");
+            writer.Int(txin.prevout.n);
+            writer.Key("scriptSig");
+            writer.BeginObject();
+            writer.Key("asm");
+            writer.String(ScriptToAsmStr(txin.scriptSig, true));
+            writer.Key("hex");
+            writer.String(HexStr(txin.scriptSig.begin(), txin.scriptSig.end()));
+            writer.EndObject();
+            if (!txin.scriptWitness.IsNull()) {
+                writer.Key("txinwitness");
+                writer.BeginArray();
+                for (const auto& item : txin.scriptWitness.stack) {
+                    writer.String(HexStr(item.begin(), item.end()));
+                }
+                writer.EndArray();
+            }
+        }
+        writer.Key("sequence");
+        writer.Int(txin.nSequence);
+        writer.EndObject();
+    }
+    writer.EndArray();
+
+    writer.Key("vout");
+    writer.BeginArray();
+    for (unsigned int i = 0; i < tx.vout.size(); i++) {
+        const CTxOut& txout = tx.vout[i];
+        writer.BeginObject();
+        writer.Key("value");
+        writer.Amount(txout.nValue);
+        writer.Key("n");
+        writer.Int(i);
+        writer.Key("scriptPubKey");
+        ScriptPubKeyToJSONStream(writer, txout.scriptPubKey);
+        writer.EndObject();
+    }
+    writer.EndArray();
+
+    writer.Key("hex");
+    writer.String(EncodeHexTx(tx, serialize_flags));
+    writer.EndObject();
+}
+
+void blockToJSONStream(JSONStreamWriter& writer, const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, bool txDetails)
+{
+    // The description with transaction ids is small, the transactions replace the ids as they are written
+    const UniValue result = blockToJSON(block, tip, blockindex, false);
+    const std::vector<std::string>& keys = result.getKeys();
+    const std::vector<UniValue>& values = result.getValues();
+    writer.BeginObject();
+    for (size_t i = 0; i < keys.size(); ++i) {
+        writer.Key(keys[i]);
+        if (keys[i] == "tx" && txDetails) {
+            writer.BeginArray();
+            const int serialize_flags = RPCSerializationFlags();
+            for (const auto& tx : block.vtx) {
+                TxToJSONStream(writer, *tx, serialize_flags);
+            }
+            writer.EndArray();
+        } else {
+            writer.Value(values[i]);
+        }
+    }
+    writer.EndObject();
+}
+// VELES END
+
 UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, bool txDetails)
 {
     UniValue result(UniValue::VOBJ);
@@ -495,6 +633,22 @@ UniValue mempoolToJSON(bool fVerbose)
     }
 }
 
+// VELES BEGIN
+void mempoolToJSONStream(JSONStreamWriter& writer)
+{
+    LOCK(mempool.cs);
+    writer.BeginObject();
+    for (const CTxMemPoolEntry& e : mempool.mapTx)
+    {
+        UniValue info(UniValue::VOBJ);
+        entryToJSON(info, e);
+        writer.Key(e.GetTx().GetHash().ToString());
+        writer.Value(info);
+    }
+    writer.EndObject();
+}
+// VELES END
+
 static UniValue getrawmempool(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() > 1)
@@ -530,6 +684,18 @@ static UniValue getrawmempool(const JSONRPCRequest& request)
     return mempoolToJSON(fVerbose);
 }
 
+// VELES BEGIN
+static bool getrawmempool_stream(const JSONRPCRequest& request, JSONStreamWriter& writer)
+{
+    // Help and the transaction ids go through getrawmempool
+    if (request.fHelp || request.params.size() > 1 || request.params[0].isNull() || !request.params[0].get_bool())
+        return false;
+
+    mempoolToJSONStream(writer);
+    return true;
+}
+// VELES END
+
 static UniValue getmempoolancestors(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 1 || request.params.size() > 2) {
@@ -911,6 +1077,39 @@ static UniValue getblock(const JSONRPCRequest& request)
     return blockToJSON(block, chainActive.Tip(), pblockindex, verbosity >= 2);
 }
 
+// VELES BEGIN
+static bool getblock_stream(const JSONRPCRequest& request, JSONStreamWriter& writer)
+{
+    // Help and raw blocks go through getblock
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        return false;
+
+    int verbosity = 1;
+    if (!request.params[1].isNull()) {
+        if(request.params[1].isNum())
+            verbosity = request.params[1].get_int();
+        else
+            verbosity = request.params[1].get_bool() ? 1 : 0;
+    }
+    if (verbosity <= 0)
+        return false;
+
+    uint256 hash(ParseHashV(request.params[0], "blockhash"));
+
+    LOCK(cs_main);
+
+    const CBlockIndex* pblockindex = LookupBlockIndex(hash);
+    if (!pblockindex) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+    }
+
+    const CBlock block = GetBlockChecked(pblockindex);
+
+    blockToJSONStream(writer, block, chainActive.Tip(), pblockindex, verbosity >= 2);
+    return true;
+}
+// VELES END
+
 struct CCoinsStats
 {
     int nHeight;
@@ -919,68 +1118,134 @@ struct CCoinsStats
     uint64_t nTransactionOutputs;
     uint64_t nBogoSize;
     uint256 hashSerialized;
+    uint256 muhash; // VELES
     uint64_t nDiskSize;
     CAmount nTotalAmount;
 
     CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nBogoSize(0), nDiskSize(0), nTotalAmount(0) {}
 };
 
-static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
+// VELES BEGIN
+enum class CoinStatsHashType {
+    HASH_SERIALIZED,
+    MUHASH,
+    NONE,
+};
+
+static CoinStatsHashType ParseHashType(const UniValue& param)
+{
+    const std::string hash_type = param.isNull() ? "hash_serialized_2" : param.get_str();
+    if (hash_type == "hash_serialized_2") return CoinStatsHashType::HASH_SERIALIZED;
+    if (hash_type == "muhash") return CoinStatsHashType::MUHASH;
+    if (hash_type == "none") return CoinStatsHashType::NONE;
+    throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("%s is not a valid hash_type", hash_type));
+}
+// VELES END
+
+static void ApplyStats(CCoinsStats &stats, CHashWriter* ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs) // VELES
 {
     assert(!outputs.empty());
-    ss << hash;
-    ss << VARINT(outputs.begin()->second.nHeight * 2 + outputs.begin()->second.fCoinBase ? 1u : 0u);
+    // VELES BEGIN
+    if (ss) {
+        *ss << hash;
+        *ss << VARINT(outputs.begin()->second.nHeight * 2 + outputs.begin()->second.fCoinBase ? 1u : 0u);
+    }
+    // VELES END
     stats.nTransactions++;
     for (const auto& output : outputs) {
-        ss << VARINT(output.first + 1);
-        ss << output.second.out.scriptPubKey;
-        ss << VARINT(output.second.out.nValue, VarIntMode::NONNEGATIVE_SIGNED);
+        // VELES BEGIN
+        if (ss) {
+            *ss << VARINT(output.first + 1);
+            *ss << output.second.out.scriptPubKey;
+            *ss << VARINT(output.second.out.nValue, VarIntMode::NONNEGATIVE_SIGNED);
+        }
+        // VELES END
         stats.nTransactionOutputs++;
         stats.nTotalAmount += output.second.out.nValue;
         stats.nBogoSize += 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
                            2 /* scriptPubKey len */ + output.second.out.scriptPubKey.size() /* scriptPubKey */;
     }
-    ss << VARINT(0u);
+    if (ss) *ss << VARINT(0u); // VELES
 }
 
-//! Calculate statistics about the unspent transaction output set
-static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
+// VELES BEGIN
+/** Computes the statistics of coins fed in the order of the coin database, at stats.hashBlock */
+class CoinsStatsHasher
+{
+    CCoinsStats& m_stats;
+    const CoinStatsHashType m_hash_type;
+    CHashWriter m_ss;
+    MuHash3072 m_muhash;
+    uint256 m_prevkey;
+    std::map<uint32_t, Coin> m_outputs;
+
+    CHashWriter* Writer() { return m_hash_type == CoinStatsHashType::HASH_SERIALIZED ? &m_ss : nullptr; }
+
+public:
+    explicit CoinsStatsHasher(CCoinsStats& stats, CoinStatsHashType hash_type = CoinStatsHashType::HASH_SERIALIZED)
+        : m_stats(stats), m_hash_type(hash_type), m_ss(SER_GETHASH, PROTOCOL_VERSION)
+    {
+        m_ss << m_stats.hashBlock;
+    }
+
+    void Add(const COutPoint& key, Coin&& coin)
+    {
+        if (!m_outputs.empty() && key.hash != m_prevkey) {
+            ApplyStats(m_stats, Writer(), m_prevkey, m_outputs);
+            m_outputs.clear();
+        }
+        if (m_hash_type == CoinStatsHashType::MUHASH) {
+            ApplyCoinHash(m_muhash, key, coin);
+        }
+        m_prevkey = key.hash;
+        m_outputs[key.n] = std::move(coin);
+    }
+
+    void Finish()
+    {
+        if (!m_outputs.empty()) {
+            ApplyStats(m_stats, Writer(), m_prevkey, m_outputs);
+            m_outputs.clear();
+        }
+        if (m_hash_type == CoinStatsHashType::HASH_SERIALIZED) {
+            m_stats.hashSerialized = m_ss.GetHash();
+        } else if (m_hash_type == CoinStatsHashType::MUHASH) {
+            m_muhash.Finalize(m_stats.muhash);
+        }
+    }
+};
+
+//! Calculate statistics about the unspent transaction output set, passing each coin to visitor if given
+static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats, CoinStatsHashType hash_type = CoinStatsHashType::HASH_SERIALIZED, const std::function<void(const COutPoint&, const Coin&)>& visitor = nullptr)
 {
     std::unique_ptr<CCoinsViewCursor> pcursor(view->Cursor());
     assert(pcursor);
 
-    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
     stats.hashBlock = pcursor->GetBestBlock();
     {
         LOCK(cs_main);
         stats.nHeight = LookupBlockIndex(stats.hashBlock)->nHeight;
     }
-    ss << stats.hashBlock;
-    uint256 prevkey;
-    std::map<uint32_t, Coin> outputs;
+    CoinsStatsHasher hasher(stats, hash_type);
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         COutPoint key;
         Coin coin;
         if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
-            if (!outputs.empty() && key.hash != prevkey) {
-                ApplyStats(stats, ss, prevkey, outputs);
-                outputs.clear();
+            if (visitor) {
+                visitor(key, coin);
             }
-            prevkey = key.hash;
-            outputs[key.n] = std::move(coin);
+            hasher.Add(key, std::move(coin));
         } else {
             return error("%s: unable to read value", __func__);
         }
         pcursor->Next();
     }
-    if (!outputs.empty()) {
-        ApplyStats(stats, ss, prevkey, outputs);
-    }
-    stats.hashSerialized = ss.GetHash();
+    hasher.Finish();
     stats.nDiskSize = view->EstimateSize();
     return true;
 }
+// VELES END
 
 static UniValue pruneblockchain(const JSONRPCRequest& request)
 {
@@ -1042,41 +1307,118 @@ static UniValue pruneblockchain(const JSONRPCRequest& request)
 
 static UniValue gettxoutsetinfo(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() != 0)
+    if (request.fHelp || request.params.size() > 3)
         throw std::runtime_error(
             RPCHelpMan{"gettxoutsetinfo",
                 "\nReturns statistics about the unspent transaction output set.\n"
-                "Note this call may take some time.\n",
-                {},
+                "Note this call may take some time without -coinstatsindex.\n",
+                {
+                    // VELES BEGIN
+                    {"hash_type", RPCArg::Type::STR, /* default */ "hash_serialized_2", "Which UTXO set hash should be calculated. Options: 'hash_serialized_2' (the legacy algorithm), 'muhash', 'none'."},
+                    {"hash_or_height", RPCArg::Type::NUM, /* default */ "the current best block", "The block hash or height of the target height (only available with -coinstatsindex).", "", {"", "string or numeric"}},
+                    {"use_index", RPCArg::Type::BOOL, /* default */ "true", "Use coinstatsindex, if available, for the 'muhash' and 'none' hash types."},
+                    // VELES END
+                },
                 RPCResult{
             "{\n"
-            "  \"height\":n,     (numeric) The current block height (index)\n"
-            "  \"bestblock\": \"hex\",   (string) The hash of the block at the tip of the chain\n"
-            "  \"transactions\": n,      (numeric) The number of transactions with unspent outputs\n"
+            "  \"height\":n,     (numeric) The block height (index) of the statistics\n"
+            "  \"bestblock\": \"hex\",   (string) The hash of that block\n"
+            "  \"transactions\": n,      (numeric) The number of transactions with unspent outputs (not available when the index is used)\n"
             "  \"txouts\": n,            (numeric) The number of unspent transaction outputs\n"
             "  \"bogosize\": n,          (numeric) A meaningless metric for UTXO set size\n"
-            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash\n"
-            "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk\n"
+            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash (only present if 'hash_serialized_2' hash_type is chosen)\n"
+            "  \"muhash\": \"hash\",      (string) The order-independent MuHash3072 of the set (only present if 'muhash' hash_type is chosen)\n"
+            "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk (only present for the current best block)\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
                 },
                 RPCExamples{
                     HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", "\"muhash\" 1000")
             + HelpExampleRpc("gettxoutsetinfo", "")
                 },
             }.ToString());
 
     UniValue ret(UniValue::VOBJ);
 
+    // VELES BEGIN
+    const CoinStatsHashType hash_type = ParseHashType(request.params[0]);
+    const bool use_index = request.params[2].isNull() ? true : request.params[2].get_bool();
+    // The index only keeps the MuHash of the set
+    const bool index_requested = g_coinstatsindex && use_index && hash_type != CoinStatsHashType::HASH_SERIALIZED;
+
+    if (!request.params[1].isNull()) {
+        if (!g_coinstatsindex) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Querying specific block heights requires coinstatsindex");
+        }
+        if (!index_requested) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Querying specific block heights requires the 'muhash' or 'none' hash_type and use_index");
+        }
+    }
+
+    if (index_requested) {
+        if (!g_coinstatsindex->BlockUntilSyncedToCurrentChain()) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set because coinstatsindex is still syncing");
+        }
+
+        const CBlockIndex* pindex;
+        bool at_tip;
+        {
+            LOCK(cs_main);
+            if (request.params[1].isNull()) {
+                pindex = chainActive.Tip();
+            } else if (request.params[1].isNum()) {
+                const int height = request.params[1].get_int();
+                if (height < 0 || height > chainActive.Height()) {
+                    throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Target block height %d is out of range", height));
+                }
+                pindex = chainActive[height];
+            } else {
+                pindex = LookupBlockIndex(ParseHashV(request.params[1], "hash_or_height"));
+                if (!pindex) {
+                    throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+                }
+                if (!chainActive.Contains(pindex)) {
+                    throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Block is not in chain %s", Params().NetworkIDString()));
+                }
+            }
+            at_tip = pindex == chainActive.Tip();
+        }
+
+        CoinStatsEntry entry;
+        if (!g_coinstatsindex->LookUpStats(pindex, entry)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set statistics from coinstatsindex");
+        }
+        ret.pushKV("height", (int64_t)pindex->nHeight);
+        ret.pushKV("bestblock", pindex->GetBlockHash().GetHex());
+        ret.pushKV("txouts", (int64_t)entry.transaction_output_count);
+        ret.pushKV("bogosize", (int64_t)entry.bogo_size);
+        if (hash_type == CoinStatsHashType::MUHASH) {
+            ret.pushKV("muhash", entry.muhash.GetHex());
+        }
+        if (at_tip) {
+            ret.pushKV("disk_size", pcoinsdbview->EstimateSize());
+        }
+        ret.pushKV("total_amount", ValueFromAmount(entry.total_amount));
+        return ret;
+    }
+    // VELES END
+
     CCoinsStats stats;
     FlushStateToDisk();
-    if (GetUTXOStats(pcoinsdbview.get(), stats)) {
+    if (GetUTXOStats(pcoinsdbview.get(), stats, hash_type)) { // VELES
         ret.pushKV("height", (int64_t)stats.nHeight);
         ret.pushKV("bestblock", stats.hashBlock.GetHex());
         ret.pushKV("transactions", (int64_t)stats.nTransactions);
         ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
         ret.pushKV("bogosize", (int64_t)stats.nBogoSize);
-        ret.pushKV("hash_serialized_2", stats.hashSerialized.GetHex());
+        // VELES BEGIN
+        if (hash_type == CoinStatsHashType::HASH_SERIALIZED) {
+            ret.pushKV("hash_serialized_2", stats.hashSerialized.GetHex());
+        } else if (hash_type == CoinStatsHashType::MUHASH) {
+            ret.pushKV("muhash", stats.muhash.GetHex());
+        }
+        // VELES END
         ret.pushKV("disk_size", stats.nDiskSize);
         ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
     } else {
@@ -1289,6 +1631,14 @@ UniValue getblockchaininfo(const JSONRPCRequest& request)
             "  \"pruneheight\": xxxxxx,        (numeric) lowest-height complete block stored (only present if pruning is enabled)\n"
             "  \"automatic_pruning\": xx,      (boolean) whether automatic pruning is enabled (only present if pruning is enabled)\n"
             "  \"prune_target_size\": xxxxxx,  (numeric) the target size used by pruning (only present if automatic pruning is enabled)\n"
+            "  \"background_verification\": {  (object) the -backgroundverify checks (only present once started)\n"
+            "     \"status\": \"xxxx\",          (string) one of \"waiting\", \"running\", \"done\", \"failed\"\n"
+            "     \"level\": xx,               (numeric) the -checklevel of the checks\n"
+            "     \"depth\": xx,               (numeric) the number of blocks checked back from the tip\n"
+            "     \"progress\": xx,            (numeric) percentage of the blocks checked so far\n"
+            "     \"restarts\": xx,            (numeric) times the checks restarted after the tip moved\n"
+            "     \"error\": \"xxxx\"            (string) the inconsistency found (only present if failed)\n"
+            "  },\n"
             "  \"softforks\": [                (array) status of softforks in progress\n"
             "     {\n"
             "        \"id\": \"xxxx\",           (string) name of softfork\n"
@@ -1355,6 +1705,22 @@ UniValue getblockchaininfo(const JSONRPCRequest& request)
         }
     }
 
+    // VELES BEGIN
+    const BackgroundVerifyStatus verify = GetBackgroundVerifyStatus();
+    if (verify.state != BackgroundVerifyStatus::NOT_STARTED) {
+        UniValue background(UniValue::VOBJ);
+        background.pushKV("status", BackgroundVerifyStateToString(verify.state));
+        background.pushKV("level", verify.nCheckLevel);
+        background.pushKV("depth", verify.nCheckDepth);
+        background.pushKV("progress", verify.nProgress);
+        background.pushKV("restarts", verify.nRestarts);
+        if (verify.state == BackgroundVerifyStatus::FAILED) {
+            background.pushKV("error", verify.strError);
+        }
+        obj.pushKV("background_verification", background);
+    }
+    // VELES END
+
     const Consensus::Params& consensusParams = Params().GetConsensus();
     UniValue softforks(UniValue::VARR);
     UniValue bip9_softforks(UniValue::VOBJ);
@@ -2307,33 +2673,562 @@ UniValue scantxoutset(const JSONRPCRequest& request)
     return result;
 }
 
+// VELES BEGIN
+static UniValue getblockfilter(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2) {
+        throw std::runtime_error(
+            RPCHelpMan{"getblockfilter",
+                "\nRetrieve a BIP 157 content filter for a particular block.\n"
+                "Requires -blockfilterindex for the filter type.\n",
+                {
+                    {"blockhash", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The hash of the block"},
+                    {"filtertype", RPCArg::Type::STR, /* default */ "basic", "The type name of the filter"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"filter\" : (string) the hex-encoded filter data\n"
+            "  \"header\" : (string) the hex-encoded filter header\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\" \"basic\"")
+            + HelpExampleRpc("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\", \"basic\"")
+                },
+            }.ToString());
+    }
+
+    uint256 block_hash = ParseHashV(request.params[0], "blockhash");
+    std::string filtertype_name = "basic";
+    if (!request.params[1].isNull()) {
+        filtertype_name = request.params[1].get_str();
+    }
+
+    BlockFilterType filtertype;
+    if (!BlockFilterTypeByName(filtertype_name, filtertype)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown filtertype");
+    }
+
+    BlockFilterIndex* index = GetBlockFilterIndex(filtertype);
+    if (!index) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Index is not enabled for filtertype " + filtertype_name);
+    }
+
+    const CBlockIndex* block_index;
+    bool block_was_connected;
+    {
+        LOCK(cs_main);
+        block_index = LookupBlockIndex(block_hash);
+        if (!block_index) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        }
+        block_was_connected = block_index->IsValid(BLOCK_VALID_SCRIPTS);
+    }
+
+    bool index_ready = index->BlockUntilSyncedToCurrentChain();
+
+    BlockFilter filter;
+    uint256 filter_header;
+    if (!index->LookupFilter(block_index, filter) ||
+        !index->LookupFilterHeader(block_index, filter_header)) {
+        int err_code;
+        std::string errmsg = "Filter not found.";
+
+        if (!block_was_connected) {
+            err_code = RPC_INVALID_ADDRESS_OR_KEY;
+            errmsg += " Block was not connected to active chain.";
+        } else if (!index_ready) {
+            err_code = RPC_MISC_ERROR;
+            errmsg += " Block filters are still in the process of being indexed.";
+        } else {
+            err_code = RPC_INTERNAL_ERROR;
+            errmsg += " This error is unexpected and indicates index corruption.";
+        }
+
+        throw JSONRPCError(err_code, errmsg);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("filter", HexStr(filter.GetEncodedFilter()));
+    ret.pushKV("header", filter_header.GetHex());
+    return ret;
+}
+
+// VELES BEGIN
+static UniValue OutputDeltaToJSON(const CTxOut& out)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("value", ValueFromAmount(out.nValue));
+    obj.pushKV("scriptPubKey", HexStr(out.scriptPubKey.begin(), out.scriptPubKey.end()));
+    CTxDestination dest;
+    if (ExtractDestination(out.scriptPubKey, dest)) {
+        obj.pushKV("address", EncodeDestination(dest));
+    }
+    return obj;
+}
+
+UniValue blockDeltaToJSON(const CBlockDelta& delta)
+{
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("hash", delta.hash.GetHex());
+    result.pushKV("height", delta.nHeight);
+    result.pushKV("connected", delta.fConnected);
+    UniValue txs(UniValue::VARR);
+    for (const CTxDelta& txdelta : delta.vtx) {
+        UniValue tx(UniValue::VOBJ);
+        tx.pushKV("txid", txdelta.txid.GetHex());
+        UniValue spent(UniValue::VARR);
+        for (const CSpentOutputDelta& input : txdelta.vSpent) {
+            UniValue obj = OutputDeltaToJSON(input.out);
+            obj.pushKV("txid", input.prevout.hash.GetHex());
+            obj.pushKV("vout", (int64_t)input.prevout.n);
+            spent.push_back(obj);
+        }
+        tx.pushKV("spent", spent);
+        UniValue created(UniValue::VARR);
+        for (const CCreatedOutputDelta& output : txdelta.vCreated) {
+            UniValue obj = OutputDeltaToJSON(output.out);
+            obj.pushKV("n", (int64_t)output.n);
+            if (output.role != PayeeRole::NONE) {
+                obj.pushKV("payee", PayeeRoleToString(output.role));
+            }
+            created.push_back(obj);
+        }
+        tx.pushKV("created", created);
+        txs.push_back(tx);
+    }
+    result.pushKV("tx", txs);
+    return result;
+}
+
+static UniValue getblockdelta(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            RPCHelpMan{"getblockdelta",
+                "\nReturns the outputs spent and created by each transaction of a block, with the values and scripts\n"
+                "of the spent outputs from the undo data of the block. The block must have been connected and not pruned.\n",
+                {
+                    {"blockhash", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The block hash"},
+                    {"verbose", RPCArg::Type::BOOL, /* default */ "true", "true for a json object, false for the hex-encoded data published by -zmqpubblockdelta"},
+                },
+                {
+                    RPCResult{"for verbose = false",
+            "\"data\"                  (string) A string that is serialized, hex-encoded data for the delta of block 'hash'\n"
+                    },
+                    RPCResult{"for verbose = true",
+            "{\n"
+            "  \"hash\" : \"hash\",          (string) the block hash (same as provided)\n"
+            "  \"height\" : n,               (numeric) the block height\n"
+            "  \"connected\" : true,         (boolean) always true, the delta of connecting the block\n"
+            "  \"tx\" : [                    (array) the transactions of the block, in block order\n"
+            "    {\n"
+            "      \"txid\" : \"id\",          (string) the transaction id\n"
+            "      \"spent\" : [             (array) the outputs spent by the inputs, in input order, empty for the coinbase\n"
+            "        {\n"
+            "          \"value\" : x.xxx,     (numeric) the value in " + CURRENCY_UNIT + "\n"
+            "          \"scriptPubKey\" : \"hex\", (string) the script\n"
+            "          \"address\" : \"address\", (string) the address of the script, if any\n"
+            "          \"txid\" : \"id\",      (string) the transaction id of the output\n"
+            "          \"vout\" : n           (numeric) the output index\n"
+            "        }, ...\n"
+            "      ],\n"
+            "      \"created\" : [           (array) the spendable outputs created\n"
+            "        {\n"
+            "          \"value\" : x.xxx,     (numeric) the value in " + CURRENCY_UNIT + "\n"
+            "          \"scriptPubKey\" : \"hex\", (string) the script\n"
+            "          \"address\" : \"address\", (string) the address of the script, if any\n"
+            "          \"n\" : n,             (numeric) the output index\n"
+            "          \"payee\" : \"xxxx\"     (string) \"masternode\", \"superblock\" or \"founder\" for those coinbase payments\n"
+            "        }, ...\n"
+            "      ]\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+                    },
+                },
+                RPCExamples{
+                    HelpExampleCli("getblockdelta", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\"")
+            + HelpExampleRpc("getblockdelta", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\"")
+                },
+            }.ToString());
+
+    uint256 hash(ParseHashV(request.params[0], "blockhash"));
+    const bool fVerbose = request.params[1].isNull() || request.params[1].get_bool();
+
+    const CBlockIndex* pblockindex;
+    CBlock block;
+    {
+        LOCK(cs_main);
+        pblockindex = LookupBlockIndex(hash);
+        if (!pblockindex) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        }
+        if (pblockindex->nHeight > 0 && !(pblockindex->nStatus & BLOCK_HAVE_UNDO)) {
+            throw JSONRPCError(RPC_MISC_ERROR, "Undo data not available (block not connected or pruned)");
+        }
+        block = GetBlockChecked(pblockindex);
+    }
+
+    CBlockDelta delta;
+    if (!GetBlockDelta(block, pblockindex, true, delta)) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Can't read undo data from disk");
+    }
+
+    if (!fVerbose) {
+        CDataStream ssDelta(SER_NETWORK, PROTOCOL_VERSION);
+        ssDelta << delta;
+        return HexStr(ssDelta.begin(), ssDelta.end());
+    }
+    return blockDeltaToJSON(delta);
+}
+// VELES END
+
+static UniValue getblockhashes(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 2) {
+        throw std::runtime_error(
+            RPCHelpMan{"getblockhashes",
+                "\nReturns the hashes of the active chain blocks with a timestamp in a range, in timestamp order.\n"
+                "Requires -timestampindex.\n",
+                {
+                    {"high", RPCArg::Type::NUM, RPCArg::Optional::NO, "The newer block timestamp, inclusive"},
+                    {"low", RPCArg::Type::NUM, RPCArg::Optional::NO, "The older block timestamp, inclusive"},
+                },
+                RPCResult{
+            "[\n"
+            "  \"hash\"  (string) The block hash\n"
+            "  ,...\n"
+            "]\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getblockhashes", "1231614698 1231024505")
+            + HelpExampleRpc("getblockhashes", "1231614698, 1231024505")
+                },
+            }.ToString());
+    }
+
+    int64_t high = request.params[0].get_int64();
+    int64_t low = request.params[1].get_int64();
+    if (low < 0 || high < low || high > std::numeric_limits<uint32_t>::max()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "High and low are expected to be a timestamp range");
+    }
+
+    if (!g_timestampindex) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Timestamp index not enabled, restart with -timestampindex");
+    }
+    g_timestampindex->BlockUntilSyncedToCurrentChain();
+
+    std::vector<uint256> hashes;
+    if (!g_timestampindex->FindBlockHashes(low, high, hashes)) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read the timestamp index");
+    }
+
+    UniValue result(UniValue::VARR);
+    for (const uint256& hash : hashes) {
+        result.push_back(hash.GetHex());
+    }
+    return result;
+}
+// VELES END
+
+// VELES BEGIN
+static UniValue dumptxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            RPCHelpMan{"dumptxoutset",
+                "\nWrite the unspent transaction output set at the chain tip to a file, which nodes can load with loadtxoutset.\n"
+                "Note this call may take some time.\n",
+                {
+                    {"path", RPCArg::Type::STR, RPCArg::Optional::NO, "The file to write, relative to the data directory if not absolute"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"path\": \"path\",           (string) The absolute path of the file written\n"
+            "  \"base_hash\": \"hash\",      (string) The hash of the block the snapshot is at\n"
+            "  \"base_height\": n,         (numeric) The height of that block\n"
+            "  \"coins_written\": n,       (numeric) The number of unspent transaction outputs written\n"
+            "  \"nchaintx\": n,            (numeric) The number of transactions of the chain up to that block\n"
+            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash of the snapshot, as of gettxoutsetinfo\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("dumptxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+                },
+            }.ToString());
+
+    const fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    // Write to a temporary file first, so that a half written snapshot is never mistaken for a complete one
+    const fs::path temppath = path.string() + ".incomplete";
+    if (fs::exists(path)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists. If you are sure this is what you want, move it out of the way first");
+    }
+
+    CAutoFile afile(fsbridge::fopen(temppath, "wb"), SER_DISK, CLIENT_VERSION);
+    if (afile.IsNull()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Couldn't open " + temppath.string() + " for writing");
+    }
+
+    SnapshotMetadata metadata;
+    CCoinsStats stats;
+    try {
+        // The header is written again once the coins are counted
+        afile << metadata;
+        FlushStateToDisk();
+        if (!GetUTXOStats(pcoinsdbview.get(), stats, CoinStatsHashType::HASH_SERIALIZED, [&](const COutPoint& outpoint, const Coin& coin) {
+                afile << outpoint;
+                afile << coin;
+            })) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+        }
+        metadata.m_base_blockhash = stats.hashBlock;
+        metadata.m_coins_count = stats.nTransactionOutputs;
+        metadata.m_hash_serialized = stats.hashSerialized;
+        {
+            LOCK(cs_main);
+            metadata.m_chain_tx = LookupBlockIndex(stats.hashBlock)->nChainTx;
+        }
+        if (fseek(afile.Get(), 0, SEEK_SET) != 0) {
+            throw std::ios_base::failure("seek failed");
+        }
+        afile << metadata;
+        if (!FileCommit(afile.Get())) {
+            throw std::ios_base::failure("commit failed");
+        }
+    } catch (const std::ios_base::failure& e) {
+        afile.fclose();
+        fs::remove(temppath);
+        throw JSONRPCError(RPC_MISC_ERROR, strprintf("Failed to write %s: %s", temppath.string(), e.what()));
+    }
+    afile.fclose();
+    if (!RenameOver(temppath, path)) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Couldn't rename " + temppath.string() + " to " + path.string());
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("path", path.string());
+    ret.pushKV("base_hash", metadata.m_base_blockhash.GetHex());
+    ret.pushKV("base_height", stats.nHeight);
+    ret.pushKV("coins_written", metadata.m_coins_count);
+    ret.pushKV("nchaintx", metadata.m_chain_tx);
+    ret.pushKV("hash_serialized_2", metadata.m_hash_serialized.GetHex());
+    return ret;
+}
+
+static UniValue loadtxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            RPCHelpMan{"loadtxoutset",
+                "\nReplace the chain state with a UTXO set snapshot written by dumptxoutset and continue syncing from its block.\n"
+                "Only snapshots listed in the chain parameters are accepted, and only while no block beyond genesis is connected.\n"
+                "The headers up to the snapshot block must be synced first. The blocks up to it are never downloaded nor\n"
+                "validated, so they can't be served to peers and the chain can't be reorganized below it. The node stops\n"
+                "advertising itself as a full node on the next start.\n"
+                "Note this call may take some time.\n",
+                {
+                    {"path", RPCArg::Type::STR, RPCArg::Optional::NO, "The snapshot file, relative to the data directory if not absolute"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"base_hash\": \"hash\",      (string) The hash of the block the snapshot is at\n"
+            "  \"base_height\": n,         (numeric) The height of that block\n"
+            "  \"coins_loaded\": n,        (numeric) The number of unspent transaction outputs loaded\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("loadtxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("loadtxoutset", "\"utxo.dat\"")
+                },
+            }.ToString());
+
+    const fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    CAutoFile afile(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (afile.IsNull()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Couldn't open " + path.string());
+    }
+
+    SnapshotMetadata metadata;
+    try {
+        afile >> metadata;
+    } catch (const std::ios_base::failure& e) {
+        throw JSONRPCError(RPC_DESERIALIZATION_ERROR, strprintf("Failed to read %s: %s", path.string(), e.what()));
+    }
+
+    // Unknown snapshots can only be tried out where anyone can make up a chain anyway
+    const MapAssumeutxo& assumeutxo = Params().Assumeutxo();
+    const auto it = assumeutxo.find(metadata.m_base_blockhash);
+    if (it == assumeutxo.end()) {
+        if (!Params().MineBlocksOnDemand()) {
+            throw JSONRPCError(RPC_VERIFY_REJECTED, "The snapshot block " + metadata.m_base_blockhash.GetHex() + " is not an accepted snapshot of this chain");
+        }
+    } else if (it->second.hashSerialized != metadata.m_hash_serialized || it->second.nChainTx != metadata.m_chain_tx) {
+        throw JSONRPCError(RPC_VERIFY_REJECTED, "The snapshot doesn't match the accepted snapshot at its block");
+    }
+
+    // Check the coins against the header before anything is written
+    CCoinsStats stats;
+    stats.hashBlock = metadata.m_base_blockhash;
+    try {
+        CoinsStatsHasher hasher(stats);
+        for (uint64_t n = 0; n < metadata.m_coins_count; ++n) {
+            boost::this_thread::interruption_point();
+            COutPoint outpoint;
+            Coin coin;
+            afile >> outpoint;
+            afile >> coin;
+            hasher.Add(outpoint, std::move(coin));
+        }
+        hasher.Finish();
+    } catch (const std::ios_base::failure& e) {
+        throw JSONRPCError(RPC_DESERIALIZATION_ERROR, strprintf("Failed to read %s: %s", path.string(), e.what()));
+    }
+    if (stats.hashSerialized != metadata.m_hash_serialized || stats.nTransactionOutputs != metadata.m_coins_count) {
+        throw JSONRPCError(RPC_VERIFY_REJECTED, "The coins of the snapshot don't match its hash");
+    }
+
+    std::string strError;
+    try {
+        if (fseek(afile.Get(), 0, SEEK_SET) != 0) {
+            throw std::ios_base::failure("seek failed");
+        }
+        afile >> metadata;
+    } catch (const std::ios_base::failure& e) {
+        throw JSONRPCError(RPC_DESERIALIZATION_ERROR, strprintf("Failed to read %s: %s", path.string(), e.what()));
+    }
+    if (!ActivateSnapshot(afile, metadata, strError)) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Failed to load the snapshot: " + strError);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("base_hash", metadata.m_base_blockhash.GetHex());
+    {
+        LOCK(cs_main);
+        ret.pushKV("base_height", LookupBlockIndex(metadata.m_base_blockhash)->nHeight);
+    }
+    ret.pushKV("coins_loaded", metadata.m_coins_count);
+    return ret;
+}
+
+/** Upper bound of the histogram bucket holding the fraction of the times, a power of two microseconds */
+static int64_t ValidationPhasePercentile(const ValidationPhaseStats& stats, double fraction)
+{
+    const uint64_t nRank = std::max<uint64_t>(1, (uint64_t)std::ceil(fraction * stats.count));
+    uint64_t nCount = 0;
+    for (int i = 0; i < VALIDATION_STATS_BUCKETS; ++i) {
+        nCount += stats.histogram[i];
+        if (nCount >= nRank) return std::min<int64_t>(int64_t{1} << i, stats.max_micros);
+    }
+    return stats.max_micros;
+}
+
+static UniValue getvalidationstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+            RPCHelpMan{"getvalidationstats",
+                "Returns the times spent in the phases of connecting blocks to the chain since startup or the last reset.\n"
+                "The phases of ConnectBlock are check, forks, connect_txs, verify (from connect_txs to the end of the script checks,\n"
+                "including block_value and masternode_payee), index and callbacks. Those of ConnectTip are read_from_disk, prefetch,\n"
+                "connect_total (ConnectBlock), flush, chainstate and post_connect, connect_block being the whole of them.\n"
+                "superblock times the superblock payment checks, instantsend_conflicts the conflict checks of the transaction locks\n"
+                "and the tip_ phases the masternode managers following a new tip, which they skip during the initial block download.\n"
+                "queue_wait times the waits for the validation interface queue to drain to half of -maxvalidationqueue.\n",
+                {
+                    {"reset", RPCArg::Type::BOOL, /* default */ "false", "Clear the recorded stats after returning them"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"phase\": {               (json object) The stats of a phase, keyed by its name\n"
+            "    \"count\": n,             (numeric) Number of times the phase ran\n"
+            "    \"total_us\": n,          (numeric) Total microseconds spent in the phase\n"
+            "    \"max_us\": n,            (numeric) Longest run in microseconds\n"
+            "    \"last_us\": n,           (numeric) Last run in microseconds\n"
+            "    \"p50_us\": n,            (numeric) Median run, rounded up to a power of two microseconds\n"
+            "    \"p99_us\": n,            (numeric) 99th percentile run, rounded up to a power of two microseconds\n"
+            "    \"histogram\": [n,...]    (json array) Runs per bucket, bucket 0 counts the runs below 1 microsecond and bucket i the ones from 2^(i-1) up to 2^i\n"
+            "  }, ...\n"
+            "  \"queue\": {               (json object) The validation interface queue\n"
+            "    \"pending\": n,           (numeric) Callbacks pending now\n"
+            "    \"peak\": n,              (numeric) Most callbacks pending at once\n"
+            "    \"limit\": n              (numeric) The -maxvalidationqueue limit\n"
+            "  }\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getvalidationstats", "")
+            + HelpExampleCli("getvalidationstats", "true")
+            + HelpExampleRpc("getvalidationstats", "")
+                },
+            }.ToString());
+
+    UniValue result(UniValue::VOBJ);
+    for (const ValidationPhaseStats& stats : GetValidationStats()) {
+        int nLast = VALIDATION_STATS_BUCKETS - 1;
+        while (nLast > 0 && !stats.histogram[nLast]) --nLast;
+        UniValue histogram(UniValue::VARR);
+        for (int i = 0; i <= nLast; ++i) {
+            histogram.push_back(stats.histogram[i]);
+        }
+
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("count", stats.count);
+        obj.pushKV("total_us", stats.total_micros);
+        obj.pushKV("max_us", stats.max_micros);
+        obj.pushKV("last_us", stats.last_micros);
+        obj.pushKV("p50_us", ValidationPhasePercentile(stats, 0.5));
+        obj.pushKV("p99_us", ValidationPhasePercentile(stats, 0.99));
+        obj.pushKV("histogram", histogram);
+        result.pushKV(stats.name, obj);
+    }
+    UniValue queue(UniValue::VOBJ);
+    queue.pushKV("pending", (uint64_t)GetMainSignals().CallbacksPending());
+    queue.pushKV("peak", (uint64_t)GetMainSignals().CallbacksPendingPeak());
+    queue.pushKV("limit", (uint64_t)g_max_validation_queue);
+    result.pushKV("queue", queue);
+    if (!request.params[0].isNull() && request.params[0].get_bool()) {
+        ResetValidationStats();
+        GetMainSignals().ResetCallbacksPendingPeak();
+    }
+    return result;
+}
+// VELES END
+
 // clang-format off
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
-    { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      {} },
-    { "blockchain",         "getchaintxstats",        &getchaintxstats,        {"nblocks", "blockhash"} },
-    { "blockchain",         "getblockstats",          &getblockstats,          {"hash_or_height", "stats"} },
-    { "blockchain",         "getbestblockhash",       &getbestblockhash,       {} },
-    { "blockchain",         "getblockcount",          &getblockcount,          {} },
-    { "blockchain",         "getblock",               &getblock,               {"blockhash","verbosity|verbose"} },
-    { "blockchain",         "getblockhash",           &getblockhash,           {"height"} },
-    { "blockchain",         "getblockheader",         &getblockheader,         {"blockhash","verbose"} },
-    { "blockchain",         "getchaintips",           &getchaintips,           {} },
-    { "blockchain",         "getdifficulty",          &getdifficulty,          {} },
-    { "blockchain",         "getmempoolancestors",    &getmempoolancestors,    {"txid","verbose"} },
-    { "blockchain",         "getmempooldescendants",  &getmempooldescendants,  {"txid","verbose"} },
-    { "blockchain",         "getmempoolentry",        &getmempoolentry,        {"txid"} },
-    { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         {} },
-    { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose"} },
-    { "blockchain",         "gettxout",               &gettxout,               {"txid","n","include_mempool"} },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {} },
+    { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      {}, true }, // VELES
+    { "blockchain",         "getchaintxstats",        &getchaintxstats,        {"nblocks", "blockhash"}, true }, // VELES
+    { "blockchain",         "getblockstats",          &getblockstats,          {"hash_or_height", "stats"}, true }, // VELES
+    { "blockchain",         "getbestblockhash",       &getbestblockhash,       {}, true }, // VELES
+    { "blockchain",         "getblockcount",          &getblockcount,          {}, true }, // VELES
+    { "blockchain",         "getblock",               &getblock,               {"blockhash","verbosity|verbose"}, true, &getblock_stream }, // VELES
+    { "blockchain",         "getblockhash",           &getblockhash,           {"height"}, true }, // VELES
+    { "blockchain",         "getblockheader",         &getblockheader,         {"blockhash","verbose"}, true }, // VELES
+    { "blockchain",         "getchaintips",           &getchaintips,           {}, true }, // VELES
+    { "blockchain",         "getdifficulty",          &getdifficulty,          {}, true }, // VELES
+    { "blockchain",         "getmempoolancestors",    &getmempoolancestors,    {"txid","verbose"}, true }, // VELES
+    { "blockchain",         "getmempooldescendants",  &getmempooldescendants,  {"txid","verbose"}, true }, // VELES
+    { "blockchain",         "getmempoolentry",        &getmempoolentry,        {"txid"}, true }, // VELES
+    { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         {}, true }, // VELES
+    { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose"}, true, &getrawmempool_stream }, // VELES
+    { "blockchain",         "gettxout",               &gettxout,               {"txid","n","include_mempool"}, true }, // VELES
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {"hash_type", "hash_or_height", "use_index"} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        {"height"} },
     { "blockchain",         "savemempool",            &savemempool,            {} },
     { "blockchain",         "verifychain",            &verifychain,            {"checklevel","nblocks"} },
 
     { "blockchain",         "preciousblock",          &preciousblock,          {"blockhash"} },
     { "blockchain",         "scantxoutset",           &scantxoutset,           {"action", "scanobjects"} },
+    { "blockchain",         "getblockfilter",         &getblockfilter,         {"blockhash", "filtertype"}, true }, // VELES
+    { "blockchain",         "getblockhashes",         &getblockhashes,         {"high", "low"}, true }, // VELES
+    { "blockchain",         "getblockdelta",          &getblockdelta,          {"blockhash", "verbose"}, true }, // VELES
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           {"path"} }, // VELES
+    { "blockchain",         "loadtxoutset",           &loadtxoutset,           {"path"} }, // VELES
+    { "blockchain",         "getvalidationstats",     &getvalidationstats,     {"reset"} }, // VELES
 
     /* Not shown in help */
     { "hidden",             "invalidateblock",        &invalidateblock,        {"blockhash"} },
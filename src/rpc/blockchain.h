@@ -10,7 +10,10 @@
 #include <amount.h>
 
 class CBlock;
+struct CBlockDelta; // VELES
 class CBlockIndex;
+class CTransaction; // VELES
+class JSONStreamWriter; // VELES
 class UniValue;
 
 static constexpr int NUM_GETBLOCKSTATS_PERCENTILES = 5;
@@ -29,11 +32,24 @@ void RPCNotifyBlockChange(bool ibd, const CBlockIndex *);
 /** Block description to JSON */
 UniValue blockToJSON(const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, bool txDetails = false);
 
+// VELES BEGIN
+/** Transaction streamed as JSON with typed values, the same text as TxToUniv with its hex and no block hash */
+void TxToJSONStream(JSONStreamWriter& writer, const CTransaction& tx, int serialize_flags);
+
+/** Block description streamed as JSON, a transaction at a time */
+void blockToJSONStream(JSONStreamWriter& writer, const CBlock& block, const CBlockIndex* tip, const CBlockIndex* blockindex, bool txDetails = false);
+
+/** Outputs spent and created by a block to JSON */
+UniValue blockDeltaToJSON(const CBlockDelta& delta);
+// VELES END
+
 /** Mempool information to JSON */
 UniValue mempoolInfoToJSON();
 
 /** Mempool to JSON */
 UniValue mempoolToJSON(bool fVerbose = false);
+/** Verbose mempool streamed as JSON, an entry at a time */
+void mempoolToJSONStream(JSONStreamWriter& writer); // VELES
 
 /** Block header to JSON */
 UniValue blockheaderToJSON(const CBlockIndex* tip, const CBlockIndex* blockindex);
@@ -36,6 +36,54 @@
 
 #include <boost/lexical_cast.hpp>
 
+// VELES BEGIN
+#include <clientversion.h>
+#include <hash.h>
+#include <key_io.h>
+#include <random.h>
+#include <util/strencodings.h>
+#include <version.h>
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <set>
+// VELES END
+
+// VELES BEGIN
+/** An object as gobject list shows it */
+static UniValue GovernanceObjectListEntry(CGovernanceObject& govobj)
+{
+    UniValue bObj(UniValue::VOBJ);
+    bObj.pushKV("DataHex",  govobj.GetDataAsHex());
+    bObj.pushKV("DataString",  govobj.GetDataAsString());
+    bObj.pushKV("Hash",  govobj.GetHash().ToString());
+    bObj.pushKV("CollateralHash",  govobj.GetCollateralHash().ToString());
+    bObj.pushKV("ObjectType", govobj.GetObjectType());
+    bObj.pushKV("CreationTime", govobj.GetCreationTime());
+    const CTxIn& masternodeVin = govobj.GetMasternodeVin();
+    if(masternodeVin != CTxIn()) {
+        bObj.pushKV("SigningMasternode", masternodeVin.prevout.ToStringShort());
+    }
+
+    // REPORT STATUS FOR FUNDING VOTES SPECIFICALLY
+    bObj.pushKV("AbsoluteYesCount",  govobj.GetAbsoluteYesCount(VOTE_SIGNAL_FUNDING));
+    bObj.pushKV("YesCount",  govobj.GetYesCount(VOTE_SIGNAL_FUNDING));
+    bObj.pushKV("NoCount",  govobj.GetNoCount(VOTE_SIGNAL_FUNDING));
+    bObj.pushKV("AbstainCount",  govobj.GetAbstainCount(VOTE_SIGNAL_FUNDING));
+
+    // REPORT VALIDITY AND CACHING FLAGS FOR VARIOUS SETTINGS
+    std::string strError = "";
+    bObj.pushKV("fBlockchainValidity",  govobj.IsValidLocally(strError, false));
+    bObj.pushKV("IsValidReason",  strError.c_str());
+    bObj.pushKV("fCachedValid",  govobj.IsSetCachedValid());
+    bObj.pushKV("fCachedFunding",  govobj.IsSetCachedFunding());
+    bObj.pushKV("fCachedDelete",  govobj.IsSetCachedDelete());
+    bObj.pushKV("fCachedEndorsed",  govobj.IsSetCachedEndorsed());
+    return bObj;
+}
+// VELES END
+
 UniValue gobject(const JSONRPCRequest& request)
 {
 #ifdef ENABLE_WALLET
@@ -131,10 +179,16 @@ UniValue gobject(const JSONRPCRequest& request)
         CGovernanceObject govobj(hashParent, nRevision, nTime, uint256(), strData);
 
         if(govobj.GetObjectType() == GOVERNANCE_OBJECT_PROPOSAL) {
-            CProposalValidator validator(strData);
-            if(!validator.Validate())  {
-                throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid proposal data, error messages:" + validator.GetErrorMessages());
+            // VELES BEGIN
+            // Validated when the data was parsed with the object
+            //CProposalValidator validator(strData);
+            //if(!validator.Validate())  {
+            //    throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid proposal data, error messages:" + validator.GetErrorMessages());
+            //}
+            if(!govobj.GetPayload().fValidProposal)  {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid proposal data, error messages:" + govobj.GetPayload().strProposalErrors);
             }
+            // VELES END
         }
         else {
             throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid object type, only proposals can be validated");
@@ -177,10 +231,16 @@ UniValue gobject(const JSONRPCRequest& request)
         CGovernanceObject govobj(hashParent, nRevision, nTime, uint256(), strData);
 
         if(govobj.GetObjectType() == GOVERNANCE_OBJECT_PROPOSAL) {
-            CProposalValidator validator(strData);
-            if(!validator.Validate())  {
-                throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid proposal data, error messages:" + validator.GetErrorMessages());
+            // VELES BEGIN
+            // Validated when the data was parsed with the object
+            //CProposalValidator validator(strData);
+            //if(!validator.Validate())  {
+            //    throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid proposal data, error messages:" + validator.GetErrorMessages());
+            //}
+            if(!govobj.GetPayload().fValidProposal)  {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid proposal data, error messages:" + govobj.GetPayload().strProposalErrors);
             }
+            // VELES END
         }
 
         if((govobj.GetObjectType() == GOVERNANCE_OBJECT_TRIGGER) ||
@@ -269,10 +329,16 @@ UniValue gobject(const JSONRPCRequest& request)
              << endl; );
 
         if(govobj.GetObjectType() == GOVERNANCE_OBJECT_PROPOSAL) {
-            CProposalValidator validator(strData);
-            if(!validator.Validate())  {
-                throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid proposal data, error messages:" + validator.GetErrorMessages());
+            // VELES BEGIN
+            // Validated when the data was parsed with the object
+            //CProposalValidator validator(strData);
+            //if(!validator.Validate())  {
+            //    throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid proposal data, error messages:" + validator.GetErrorMessages());
+            //}
+            if(!govobj.GetPayload().fValidProposal)  {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid proposal data, error messages:" + govobj.GetPayload().strProposalErrors);
             }
+            // VELES END
         }
 
         // Attempt to sign triggers if we are a MN
@@ -666,7 +732,14 @@ UniValue gobject(const JSONRPCRequest& request)
 
         LOCK2(cs_main, governance.cs);
 
-        std::vector<CGovernanceObject*> objs = governance.GetAllNewerThan(nStartTime);
+        //std::vector<CGovernanceObject*> objs = governance.GetAllNewerThan(nStartTime);
+        // VELES BEGIN
+        int nObjectType = -1;
+        if(strType == "proposals") nObjectType = GOVERNANCE_OBJECT_PROPOSAL;
+        if(strType == "triggers") nObjectType = GOVERNANCE_OBJECT_TRIGGER;
+        if(strType == "watchdogs") nObjectType = GOVERNANCE_OBJECT_WATCHDOG;
+        std::vector<CGovernanceObject*> objs = governance.GetAllNewerThan(nStartTime, nObjectType);
+        // VELES END
         governance.UpdateLastDiffTime(GetTime());
 
         // CREATE RESULTS FOR USER
@@ -682,32 +755,7 @@ UniValue gobject(const JSONRPCRequest& request)
             if(strType == "triggers" && pGovObj->GetObjectType() != GOVERNANCE_OBJECT_TRIGGER) continue;
             if(strType == "watchdogs" && pGovObj->GetObjectType() != GOVERNANCE_OBJECT_WATCHDOG) continue;
 
-            UniValue bObj(UniValue::VOBJ);
-            bObj.pushKV("DataHex",  pGovObj->GetDataAsHex());
-            bObj.pushKV("DataString",  pGovObj->GetDataAsString());
-            bObj.pushKV("Hash",  pGovObj->GetHash().ToString());
-            bObj.pushKV("CollateralHash",  pGovObj->GetCollateralHash().ToString());
-            bObj.pushKV("ObjectType", pGovObj->GetObjectType());
-            bObj.pushKV("CreationTime", pGovObj->GetCreationTime());
-            const CTxIn& masternodeVin = pGovObj->GetMasternodeVin();
-            if(masternodeVin != CTxIn()) {
-                bObj.pushKV("SigningMasternode", masternodeVin.prevout.ToStringShort());
-            }
-
-            // REPORT STATUS FOR FUNDING VOTES SPECIFICALLY
-            bObj.pushKV("AbsoluteYesCount",  pGovObj->GetAbsoluteYesCount(VOTE_SIGNAL_FUNDING));
-            bObj.pushKV("YesCount",  pGovObj->GetYesCount(VOTE_SIGNAL_FUNDING));
-            bObj.pushKV("NoCount",  pGovObj->GetNoCount(VOTE_SIGNAL_FUNDING));
-            bObj.pushKV("AbstainCount",  pGovObj->GetAbstainCount(VOTE_SIGNAL_FUNDING));
-
-            // REPORT VALIDITY AND CACHING FLAGS FOR VARIOUS SETTINGS
-            std::string strError = "";
-            bObj.pushKV("fBlockchainValidity",  pGovObj->IsValidLocally(strError, false));
-            bObj.pushKV("IsValidReason",  strError.c_str());
-            bObj.pushKV("fCachedValid",  pGovObj->IsSetCachedValid());
-            bObj.pushKV("fCachedFunding",  pGovObj->IsSetCachedFunding());
-            bObj.pushKV("fCachedDelete",  pGovObj->IsSetCachedDelete());
-            bObj.pushKV("fCachedEndorsed",  pGovObj->IsSetCachedEndorsed());
+            UniValue bObj = GovernanceObjectListEntry(*pGovObj); // VELES
 
             objResult.pushKV(pGovObj->GetHash().ToString(), bObj);
         }
@@ -954,6 +1002,42 @@ UniValue voteraw(const JSONRPCRequest& request)
     }
 }
 
+// VELES BEGIN
+/** The governance parameters of getgovernanceinfo at the height */
+static UniValue GovernanceInfo(int nBlockHeight)
+{
+    // Compute last/next superblock
+    int nLastSuperblock, nNextSuperblock;
+
+    // Get chain parameters
+    int nSuperblockStartBlock = Params().GetConsensus().nSuperblockStartBlock;
+    int nSuperblockCycle = Params().GetConsensus().nSuperblockCycle;
+
+    // Get first superblock
+    int nFirstSuperblockOffset = (nSuperblockCycle - nSuperblockStartBlock % nSuperblockCycle) % nSuperblockCycle;
+    int nFirstSuperblock = nSuperblockStartBlock + nFirstSuperblockOffset;
+
+    if(nBlockHeight < nFirstSuperblock){
+        nLastSuperblock = 0;
+        nNextSuperblock = nFirstSuperblock;
+    } else {
+        nLastSuperblock = nBlockHeight - nBlockHeight % nSuperblockCycle;
+        nNextSuperblock = nLastSuperblock + nSuperblockCycle;
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("governanceminquorum", Params().GetConsensus().nGovernanceMinQuorum);
+    obj.pushKV("masternodewatchdogmaxseconds", MASTERNODE_WATCHDOG_MAX_SECONDS);
+    obj.pushKV("proposalfee", ValueFromAmount(GOVERNANCE_PROPOSAL_FEE_TX));
+    obj.pushKV("superblockcycle", Params().GetConsensus().nSuperblockCycle);
+    obj.pushKV("lastsuperblock", nLastSuperblock);
+    obj.pushKV("nextsuperblock", nNextSuperblock);
+    obj.pushKV("maxgovobjdatasize", MAX_GOVERNANCE_OBJECT_DATA_SIZE);
+
+    return obj;
+}
+// VELES END
+
 UniValue getgovernanceinfo(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 0) {
@@ -979,9 +1063,7 @@ UniValue getgovernanceinfo(const JSONRPCRequest& request)
             }.ToString());
     }
 
-    // Compute last/next superblock
-    int nLastSuperblock, nNextSuperblock;
-
+    // VELES BEGIN
     // Get current block height
     int nBlockHeight = 0;
     {
@@ -989,32 +1071,8 @@ UniValue getgovernanceinfo(const JSONRPCRequest& request)
         nBlockHeight = (int)chainActive.Height();
     }
 
-    // Get chain parameters
-    int nSuperblockStartBlock = Params().GetConsensus().nSuperblockStartBlock;
-    int nSuperblockCycle = Params().GetConsensus().nSuperblockCycle;
-
-    // Get first superblock
-    int nFirstSuperblockOffset = (nSuperblockCycle - nSuperblockStartBlock % nSuperblockCycle) % nSuperblockCycle;
-    int nFirstSuperblock = nSuperblockStartBlock + nFirstSuperblockOffset;
-
-    if(nBlockHeight < nFirstSuperblock){
-        nLastSuperblock = 0;
-        nNextSuperblock = nFirstSuperblock;
-    } else {
-        nLastSuperblock = nBlockHeight - nBlockHeight % nSuperblockCycle;
-        nNextSuperblock = nLastSuperblock + nSuperblockCycle;
-    }
-
-    UniValue obj(UniValue::VOBJ);
-    obj.pushKV("governanceminquorum", Params().GetConsensus().nGovernanceMinQuorum);
-    obj.pushKV("masternodewatchdogmaxseconds", MASTERNODE_WATCHDOG_MAX_SECONDS);
-    obj.pushKV("proposalfee", ValueFromAmount(GOVERNANCE_PROPOSAL_FEE_TX));
-    obj.pushKV("superblockcycle", Params().GetConsensus().nSuperblockCycle);
-    obj.pushKV("lastsuperblock", nLastSuperblock);
-    obj.pushKV("nextsuperblock", nNextSuperblock);
-    obj.pushKV("maxgovobjdatasize", MAX_GOVERNANCE_OBJECT_DATA_SIZE);
-
-    return obj;
+    return GovernanceInfo(nBlockHeight);
+    // VELES END
 }
 
 UniValue getsuperblockbudget(const JSONRPCRequest& request)
@@ -1050,6 +1108,186 @@ UniValue getsuperblockbudget(const JSONRPCRequest& request)
     return strBudget;
 }
 
+// VELES BEGIN
+/** Seconds the removed governance objects are remembered for the deltas of getsentinelstatus */
+static const int64_t SENTINEL_STATUS_REMOVED_EXPIRY = 24 * 60 * 60;
+
+/**
+ * Sequence of the governance object changes behind the delta tokens of getsentinelstatus.
+ * Every call compares the objects with what the previous call saw, so the changes are
+ * noticed by the calls and not where the governance code makes them. A token is the
+ * sequence number a reply was made at, with the run of the node it belongs to.
+ */
+struct GovernanceObjectChanges
+{
+    //! Random per run of the node, set by the first call
+    uint64_t nRun = 0;
+    uint64_t nSequence = 0;
+    //! Fingerprint of every object seen, and the sequence it last changed at
+    std::map<uint256, std::pair<uint256, uint64_t>> mapObjects;
+    //! Objects gone since, with the sequence and time of their removal
+    std::map<uint256, std::pair<uint64_t, int64_t>> mapRemoved;
+    //! Last sequence of the removals forgotten, older tokens get the full list
+    uint64_t nForgotten = 0;
+};
+static GovernanceObjectChanges g_governance_changes GUARDED_BY(governance.cs);
+
+/** Hash of what gobject list shows of an object, apart from the validity against the chain */
+static uint256 GovernanceObjectFingerprint(const CGovernanceObject& govobj)
+{
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << govobj.GetAbsoluteYesCount(VOTE_SIGNAL_FUNDING) << govobj.GetYesCount(VOTE_SIGNAL_FUNDING)
+       << govobj.GetNoCount(VOTE_SIGNAL_FUNDING) << govobj.GetAbstainCount(VOTE_SIGNAL_FUNDING)
+       << govobj.IsSetCachedValid() << govobj.IsSetCachedFunding() << govobj.IsSetCachedDelete()
+       << govobj.IsSetCachedEndorsed();
+    return ss.GetHash();
+}
+
+static std::string SentinelStatusToken(const GovernanceObjectChanges& changes)
+{
+    return strprintf("%016x-%d", changes.nRun, changes.nSequence);
+}
+
+UniValue getsentinelstatus(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1) {
+        throw std::runtime_error(
+            RPCHelpMan{"getsentinelstatus",
+                "\nReturns the state Sentinel polls for, from one snapshot of the chain and governance state.\n"
+                "The governance objects are the ones of gobject list all, given a token of an earlier\n"
+                "reply only the ones that changed since are returned.\n",
+                {
+                    {"token", RPCArg::Type::STR, /* default */ "", "The token of an earlier reply, to get the governance objects that changed since"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"version\": xxxxx,            (numeric) the server version\n"
+            "  \"protocolversion\": xxxxx,    (numeric) the protocol version\n"
+            "  \"blocks\": xxxxx,             (numeric) the height of the active chain, like getblockcount\n"
+            "  \"bestblockhash\": \"hash\",     (string) the hash of the tip of the active chain\n"
+            "  \"masternode\": {...},         (object) masternode status, null when this is not a masternode\n"
+            "  \"mnsync\": {...},             (object) mnsync status\n"
+            "  \"governanceinfo\": {...},     (object) getgovernanceinfo\n"
+            "  \"token\": \"xxxx\",             (string) the token to pass to the next call\n"
+            "  \"full\": true|false,          (boolean) whether objects holds all objects, when no token or an unknown one was given\n"
+            "  \"objects\": {...},            (object) the changed governance objects by hash, as gobject list shows them\n"
+            "  \"removed\": [\"hash\",...]      (array) the governance objects removed since the token\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getsentinelstatus", "")
+            + HelpExampleCli("getsentinelstatus", "\"token\"")
+            + HelpExampleRpc("getsentinelstatus", "\"token\"")
+                },
+            }.ToString());
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("version", CLIENT_VERSION);
+    result.pushKV("protocolversion", PROTOCOL_VERSION);
+
+    LOCK2(cs_main, governance.cs);
+
+    const int nBlockHeight = chainActive.Height();
+    result.pushKV("blocks", nBlockHeight);
+    result.pushKV("bestblockhash", chainActive.Tip()->GetBlockHash().GetHex());
+
+    if (fMasterNode) {
+        UniValue mnObj(UniValue::VOBJ);
+        mnObj.pushKV("outpoint", activeMasternode.outpoint.ToStringShort());
+        mnObj.pushKV("service", activeMasternode.service.ToString());
+        CMasternode mn;
+        if (mnodeman.Get(activeMasternode.outpoint, mn)) {
+            mnObj.pushKV("payee", EncodeDestination(mn.pubKeyCollateralAddress.GetID()));
+        }
+        mnObj.pushKV("status", activeMasternode.GetStatus());
+        result.pushKV("masternode", mnObj);
+    } else {
+        result.pushKV("masternode", NullUniValue);
+    }
+
+    UniValue objSync(UniValue::VOBJ);
+    objSync.pushKV("AssetID", masternodeSync.GetAssetID());
+    objSync.pushKV("AssetName", masternodeSync.GetAssetName());
+    objSync.pushKV("AssetStartTime", masternodeSync.GetAssetStartTime());
+    objSync.pushKV("Attempt", masternodeSync.GetAttempt());
+    objSync.pushKV("IsBlockchainSynced", masternodeSync.IsBlockchainSynced());
+    objSync.pushKV("IsMasternodeListSynced", masternodeSync.IsMasternodeListSynced());
+    objSync.pushKV("IsWinnersListSynced", masternodeSync.IsWinnersListSynced());
+    objSync.pushKV("IsSynced", masternodeSync.IsSynced());
+    objSync.pushKV("IsFailed", masternodeSync.IsFailed());
+    result.pushKV("mnsync", objSync);
+
+    result.pushKV("governanceinfo", GovernanceInfo(nBlockHeight));
+
+    // Note the changes of the objects since the last call
+    GovernanceObjectChanges& changes = g_governance_changes;
+    if (changes.nRun == 0) changes.nRun = GetRand(std::numeric_limits<uint64_t>::max() - 1) + 1;
+    const std::vector<CGovernanceObject*> objs = governance.GetAllNewerThan(0);
+    std::set<uint256> setSeen;
+    for (CGovernanceObject* pGovObj : objs) {
+        const uint256 hash = pGovObj->GetHash();
+        const uint256 fingerprint = GovernanceObjectFingerprint(*pGovObj);
+        setSeen.insert(hash);
+        auto it = changes.mapObjects.find(hash);
+        if (it == changes.mapObjects.end()) {
+            changes.mapObjects.emplace(hash, std::make_pair(fingerprint, ++changes.nSequence));
+            changes.mapRemoved.erase(hash);
+        } else if (it->second.first != fingerprint) {
+            it->second = std::make_pair(fingerprint, ++changes.nSequence);
+        }
+    }
+    const int64_t nNow = GetTime();
+    for (auto it = changes.mapObjects.begin(); it != changes.mapObjects.end();) {
+        if (setSeen.count(it->first)) {
+            ++it;
+            continue;
+        }
+        changes.mapRemoved[it->first] = std::make_pair(++changes.nSequence, nNow);
+        it = changes.mapObjects.erase(it);
+    }
+    for (auto it = changes.mapRemoved.begin(); it != changes.mapRemoved.end();) {
+        if (nNow - it->second.second <= SENTINEL_STATUS_REMOVED_EXPIRY) {
+            ++it;
+            continue;
+        }
+        changes.nForgotten = std::max(changes.nForgotten, it->second.first);
+        it = changes.mapRemoved.erase(it);
+    }
+
+    // The sequence of the token when it belongs to this run and no removal since was forgotten
+    bool fFull = true;
+    uint64_t nSince = 0;
+    if (!request.params[0].isNull()) {
+        const std::string strToken = request.params[0].get_str();
+        const std::string strRun = strprintf("%016x-", changes.nRun);
+        uint64_t nTokenSequence;
+        if (strToken.compare(0, strRun.size(), strRun) == 0 && ParseUInt64(strToken.substr(strRun.size()), &nTokenSequence) &&
+            nTokenSequence <= changes.nSequence && nTokenSequence >= changes.nForgotten) {
+            fFull = false;
+            nSince = nTokenSequence;
+        }
+    }
+
+    result.pushKV("token", SentinelStatusToken(changes));
+    result.pushKV("full", fFull);
+    UniValue objResult(UniValue::VOBJ);
+    for (CGovernanceObject* pGovObj : objs) {
+        if (changes.mapObjects.at(pGovObj->GetHash()).second <= nSince) continue;
+        objResult.pushKV(pGovObj->GetHash().ToString(), GovernanceObjectListEntry(*pGovObj));
+    }
+    result.pushKV("objects", objResult);
+    UniValue removed(UniValue::VARR);
+    if (!fFull) {
+        for (const auto& entry : changes.mapRemoved) {
+            if (entry.second.first > nSince) removed.push_back(entry.first.ToString());
+        }
+    }
+    result.pushKV("removed", removed);
+    return result;
+}
+// VELES END
+
 // Dash
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
@@ -1057,6 +1295,7 @@ static const CRPCCommand commands[] =
     { "governance",         "gobject",                &gobject,                {"command"}  },
     { "governance",         "getgovernanceinfo",      &getgovernanceinfo,      {}  },
     { "governance",         "getsuperblockbudget",    &getsuperblockbudget,    {"index"}  },
+    { "governance",         "getsentinelstatus",      &getsentinelstatus,      {"token"}  }, // VELES
     { "governance",         "voteraw",                &voteraw,                {"masternode-tx-hash", "masternode-tx-index", "governance-hash", "vote-signal", "yes-no-abstain", "time", "vote-sig"}  },
 };
 
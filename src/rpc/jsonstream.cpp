@@ -0,0 +1,169 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rpc/jsonstream.h>
+
+#include <tinyformat.h>
+
+#include <assert.h>
+
+/** Append str as a JSON string, escaped the way univalue escapes it */
+static void AppendQuoted(std::string& out, const std::string& str)
+{
+    static const char* const hex = "0123456789abcdef";
+    out += '"';
+    for (const char c : str) {
+        const unsigned char ch = c;
+        switch (ch) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\b': out += "\\b"; break;
+        case '\t': out += "\\t"; break;
+        case '\n': out += "\\n"; break;
+        case '\f': out += "\\f"; break;
+        case '\r': out += "\\r"; break;
+        default:
+            if (ch < 0x20 || ch == 0x7f) {
+                out += "\\u00";
+                out += hex[ch >> 4];
+                out += hex[ch & 0xf];
+            } else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+}
+
+JSONStreamWriter::JSONStreamWriter(Sink sink, size_t nFlushSize) : m_sink(std::move(sink)), m_flush_size(nFlushSize)
+{
+    m_buffer.reserve(nFlushSize);
+}
+
+void JSONStreamWriter::Separate()
+{
+    if (m_after_key) {
+        m_after_key = false;
+        return;
+    }
+    if (m_empty.empty()) return;
+    if (!m_empty.back()) m_buffer += ',';
+    m_empty.back() = false;
+}
+
+void JSONStreamWriter::MaybeFlush()
+{
+    if (m_buffer.size() >= m_flush_size) Flush();
+}
+
+void JSONStreamWriter::BeginObject()
+{
+    Separate();
+    m_buffer += '{';
+    m_empty.push_back(true);
+}
+
+void JSONStreamWriter::EndObject()
+{
+    assert(!m_empty.empty() && !m_after_key);
+    m_buffer += '}';
+    m_empty.pop_back();
+    MaybeFlush();
+}
+
+void JSONStreamWriter::BeginArray()
+{
+    Separate();
+    m_buffer += '[';
+    m_empty.push_back(true);
+}
+
+void JSONStreamWriter::EndArray()
+{
+    assert(!m_empty.empty() && !m_after_key);
+    m_buffer += ']';
+    m_empty.pop_back();
+    MaybeFlush();
+}
+
+void JSONStreamWriter::Key(const std::string& key)
+{
+    assert(!m_empty.empty() && !m_after_key);
+    Separate();
+    AppendQuoted(m_buffer, key);
+    m_buffer += ':';
+    m_after_key = true;
+}
+
+void JSONStreamWriter::Value(const UniValue& value)
+{
+    Separate();
+    m_buffer += value.write();
+    MaybeFlush();
+}
+
+void JSONStreamWriter::String(const std::string& str)
+{
+    Separate();
+    AppendQuoted(m_buffer, str);
+    MaybeFlush();
+}
+
+void JSONStreamWriter::Int(int64_t n)
+{
+    Separate();
+    m_buffer += std::to_string(n);
+    MaybeFlush();
+}
+
+void JSONStreamWriter::UInt(uint64_t n)
+{
+    Separate();
+    m_buffer += std::to_string(n);
+    MaybeFlush();
+}
+
+void JSONStreamWriter::Bool(bool f)
+{
+    Separate();
+    m_buffer += f ? "true" : "false";
+    MaybeFlush();
+}
+
+void JSONStreamWriter::Null()
+{
+    Separate();
+    m_buffer += "null";
+    MaybeFlush();
+}
+
+void JSONStreamWriter::Amount(CAmount amount)
+{
+    Separate();
+    const bool sign = amount < 0;
+    const int64_t n_abs = (sign ? -amount : amount);
+    m_buffer += strprintf("%s%d.%08d", sign ? "-" : "", n_abs / COIN, n_abs % COIN);
+    MaybeFlush();
+}
+
+void JSONStreamWriter::WriteRaw(const std::string& text)
+{
+    m_buffer += text;
+    MaybeFlush();
+}
+
+void JSONStreamWriter::Flush()
+{
+    if (m_buffer.empty()) return;
+    m_sink(m_buffer);
+    m_flushed = true;
+    m_buffer.clear();
+}
+
+std::string JSONStreamWriter::TakeBuffer()
+{
+    std::string text;
+    text.swap(m_buffer);
+    return text;
+}
@@ -0,0 +1,74 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef VELES_RPC_JSONSTREAM_H
+#define VELES_RPC_JSONSTREAM_H
+
+#include <amount.h>
+#include <univalue.h>
+
+#include <functional>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** Bytes of JSON buffered before they are handed to the sink */
+static const size_t JSON_STREAM_FLUSH_SIZE = 64 * 1024;
+
+/**
+ * Writes a JSON document piece by piece, handing the text to a sink whenever enough of it is
+ * buffered, so large results are never held in memory as a whole. Containers are opened and
+ * closed explicitly, everything else is written as complete UniValues. The output is the same
+ * as UniValue::write of the whole document.
+ *
+ * The typed values are formatted straight into the buffer, without building a UniValue and
+ * its string copy of numbers first, for the hot paths writing many small values.
+ */
+class JSONStreamWriter
+{
+public:
+    typedef std::function<void(const std::string&)> Sink;
+
+private:
+    Sink m_sink;
+    const size_t m_flush_size;
+    std::string m_buffer;
+    //! Whether the open containers are still empty, innermost last
+    std::vector<bool> m_empty;
+    bool m_after_key = false;
+    bool m_flushed = false;
+
+    void Separate();
+    void MaybeFlush();
+
+public:
+    explicit JSONStreamWriter(Sink sink, size_t nFlushSize = JSON_STREAM_FLUSH_SIZE);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+    /** The key of the next value of the innermost object */
+    void Key(const std::string& key);
+    void Value(const UniValue& value);
+    /** Typed values, written as UniValue::write would write them */
+    void String(const std::string& str);
+    void Int(int64_t n);
+    void UInt(uint64_t n);
+    void Bool(bool f);
+    void Null();
+    /** An amount in coins, like ValueFromAmount */
+    void Amount(CAmount amount);
+    /** Text outside of the document, like its trailing newline */
+    void WriteRaw(const std::string& text);
+
+    /** Hand what is buffered to the sink */
+    void Flush();
+    /** Whether the sink was given any text yet */
+    bool Flushed() const { return m_flushed; }
+    /** Take the buffered text instead of handing it to the sink, for documents small enough to send at once */
+    std::string TakeBuffer();
+};
+
+#endif // VELES_RPC_JSONSTREAM_H
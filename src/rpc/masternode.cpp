@@ -111,6 +111,8 @@ UniValue getpoolinfo(const JSONRPCRequest& request)
                     "  \"queue\": nnn,              (numeric)\n"
                     "  \"entries\": nnn,            (numeric)\n"
                     "  \"status\": \"...\",         (string)\n"
+                    "  \"sessions\": nnn,           (numeric) Number of mixing sessions in progress\n"
+                    "  \"masternodes\": [...],     (array) Masternodes of the mixing sessions\n"
                     "  \"keys_left\": nnnnnnnn,     (numeric)\n"
                     "  \"warnings\": \"...\",       (string)\n"
                     "}\n"
@@ -136,6 +138,21 @@ UniValue getpoolinfo(const JSONRPCRequest& request)
         obj.pushKV("outpoint",      mnInfo.vin.prevout.ToStringShort());
         obj.pushKV("addr",          mnInfo.addr.ToString());
     }
+    // VELES BEGIN
+    if (!fMasterNode) {
+        obj.pushKV("sessions",      privateSendClient.GetActiveSessions());
+        std::vector<masternode_info_t> vecMnInfo;
+        privateSendClient.GetMixingMasternodesInfo(vecMnInfo);
+        UniValue masternodes(UniValue::VARR);
+        for (const auto& info : vecMnInfo) {
+            UniValue mn(UniValue::VOBJ);
+            mn.pushKV("outpoint",   info.vin.prevout.ToStringShort());
+            mn.pushKV("addr",       info.addr.ToString());
+            masternodes.push_back(mn);
+        }
+        obj.pushKV("masternodes",   masternodes);
+    }
+    // VELES END
 
     if (pwallet) {
         obj.pushKV("keys_left",     pwallet->nKeysLeftSinceAutoBackup);
@@ -278,7 +295,7 @@ UniValue masternode(const JSONRPCRequest& request)
 
     if (strCommand == "current" || strCommand == "winner")
     {
-        int nCount;
+        // int nCount;
         int nHeight;
         masternode_info_t mnInfo;
         CBlockIndex* pindex = NULL;
@@ -289,7 +306,8 @@ UniValue masternode(const JSONRPCRequest& request)
         nHeight = pindex->nHeight + (strCommand == "current" ? 1 : 10);
         mnodeman.UpdateLastPaid(pindex);
 
-        if(!mnodeman.GetNextMasternodeInQueueForPayment(nHeight, true, nCount, mnInfo))
+        // if(!mnodeman.GetNextMasternodeInQueueForPayment(nHeight, true, nCount, mnInfo))
+        if(!mnpayments.GetExpectedPayee(nHeight, mnInfo)) // VELES
             return "unknown";
 
         UniValue obj(UniValue::VOBJ);
@@ -473,6 +491,20 @@ UniValue masternode(const JSONRPCRequest& request)
         }
 
         mnObj.pushKV("status", activeMasternode.GetStatus());
+        // VELES BEGIN
+        if (hostedMasternodes.size()) {
+            UniValue hostedArr(UniValue::VARR);
+            for (const CHostedMasternodes::CHostedMasternode& hosted : hostedMasternodes.GetMasternodes()) {
+                UniValue hostedObj(UniValue::VOBJ);
+                hostedObj.pushKV("alias", hosted.strAlias);
+                hostedObj.pushKV("outpoint", hosted.activeMasternode.outpoint.ToStringShort());
+                hostedObj.pushKV("service", hosted.activeMasternode.serviceHosted.ToString());
+                hostedObj.pushKV("status", hosted.activeMasternode.GetStatus());
+                hostedArr.push_back(hostedObj);
+            }
+            mnObj.pushKV("hosted", hostedArr);
+        }
+        // VELES END
         return mnObj;
     }
 
@@ -530,6 +562,129 @@ UniValue masternode(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
+// VELES BEGIN
+/** A masternode as shown by one masternodelist mode, with the fields the filter is matched against */
+struct MasternodeListEntry {
+    std::string strOutpoint;
+    UniValue value;
+    std::string strStatus;
+    std::string strAddress;
+    std::string strPayee;
+    int nProtocolVersion;
+};
+
+typedef std::shared_ptr<const std::vector<MasternodeListEntry> > MasternodeListEntriesRef;
+
+/** The masternodelist modes rendered so far, valid as long as the masternode list version does not change */
+static struct {
+    Mutex cs;
+    uint64_t nListVersion GUARDED_BY(cs) = 0;
+    std::map<std::string, MasternodeListEntriesRef> mapModes GUARDED_BY(cs);
+} g_masternodelist_cache;
+
+static MasternodeListEntry RenderMasternodeListEntry(const std::string& strMode, const COutPoint& outpoint, CMasternode& mn)
+{
+    MasternodeListEntry entry;
+    entry.strOutpoint = outpoint.ToStringShort();
+    entry.strStatus = mn.GetStatus();
+    entry.strAddress = mn.addr.ToString();
+    entry.strPayee = EncodeDestination(mn.pubKeyCollateralAddress.GetID());
+    entry.nProtocolVersion = mn.nProtocolVersion;
+
+    if (strMode == "activeseconds") {
+        entry.value = (int64_t)(mn.lastPing.sigTime - mn.sigTime);
+    } else if (strMode == "addr") {
+        entry.value = entry.strAddress;
+    } else if (strMode == "full") {
+        std::ostringstream streamFull;
+        streamFull << std::setw(18) <<
+                       entry.strStatus << " " <<
+                       mn.nProtocolVersion << " " <<
+                       entry.strPayee << " " <<
+                       (int64_t)mn.lastPing.sigTime << " " << std::setw(8) <<
+                       (int64_t)(mn.lastPing.sigTime - mn.sigTime) << " " << std::setw(10) <<
+                       mn.GetLastPaidTime() << " "  << std::setw(6) <<
+                       mn.GetLastPaidBlock() << " " <<
+                       entry.strAddress;
+        entry.value = streamFull.str();
+    } else if (strMode == "info") {
+        std::ostringstream streamInfo;
+        streamInfo << std::setw(18) <<
+                       entry.strStatus << " " <<
+                       mn.nProtocolVersion << " " <<
+                       entry.strPayee << " " <<
+                       (int64_t)mn.lastPing.sigTime << " " << std::setw(8) <<
+                       (int64_t)(mn.lastPing.sigTime - mn.sigTime) << " " <<
+                       SafeIntVersionToString(mn.lastPing.nSentinelVersion) << " "  <<
+                       (mn.lastPing.fSentinelIsCurrent ? "current" : "expired") << " " <<
+                       entry.strAddress;
+        entry.value = streamInfo.str();
+    } else if (strMode == "lastpaidblock") {
+        entry.value = mn.GetLastPaidBlock();
+    } else if (strMode == "lastpaidtime") {
+        entry.value = mn.GetLastPaidTime();
+    } else if (strMode == "lastseen") {
+        entry.value = (int64_t)mn.lastPing.sigTime;
+    } else if (strMode == "payee") {
+        entry.value = entry.strPayee;
+    } else if (strMode == "protocol") {
+        entry.value = (int64_t)mn.nProtocolVersion;
+    } else if (strMode == "pubkey") {
+        entry.value = HexStr(mn.pubKeyMasternode);
+    } else if (strMode == "status") {
+        entry.value = entry.strStatus;
+    }
+    return entry;
+}
+
+/**
+ * Partial match on the outpoint in every mode and on the fields the mode shows: the address,
+ * payee and status, or an exact match on the protocol version.
+ */
+static bool MatchesMasternodeListFilter(const std::string& strMode, const MasternodeListEntry& entry, const std::string& strFilter)
+{
+    if (strFilter.empty() || entry.strOutpoint.find(strFilter) != std::string::npos) return true;
+
+    const bool fAll = strMode == "full" || strMode == "info";
+    if ((fAll || strMode == "addr") && entry.strAddress.find(strFilter) != std::string::npos) return true;
+    if ((fAll || strMode == "payee") && entry.strPayee.find(strFilter) != std::string::npos) return true;
+    if ((fAll || strMode == "status") && entry.strStatus.find(strFilter) != std::string::npos) return true;
+    if ((fAll || strMode == "protocol") && strFilter == strprintf("%d", entry.nProtocolVersion)) return true;
+    return false;
+}
+
+/** The masternodes rendered in strMode, from the cache unless the masternode list changed since */
+static MasternodeListEntriesRef GetMasternodeListEntries(const std::string& strMode)
+{
+    {
+        LOCK(g_masternodelist_cache.cs);
+        const uint64_t nListVersion = mnodeman.GetListVersion();
+        if (g_masternodelist_cache.nListVersion != nListVersion) {
+            g_masternodelist_cache.mapModes.clear();
+            g_masternodelist_cache.nListVersion = nListVersion;
+        }
+        auto it = g_masternodelist_cache.mapModes.find(strMode);
+        if (it != g_masternodelist_cache.mapModes.end()) return it->second;
+    }
+
+    uint64_t nListVersion;
+    std::map<COutPoint, CMasternode> mapMasternodes = mnodeman.GetFullMasternodeMap(nListVersion);
+    std::shared_ptr<std::vector<MasternodeListEntry> > entries = std::make_shared<std::vector<MasternodeListEntry> >();
+    entries->reserve(mapMasternodes.size());
+    for (auto& mnpair : mapMasternodes) {
+        entries->push_back(RenderMasternodeListEntry(strMode, mnpair.first, mnpair.second));
+    }
+
+    LOCK(g_masternodelist_cache.cs);
+    if (g_masternodelist_cache.nListVersion != nListVersion) {
+        g_masternodelist_cache.mapModes.clear();
+        g_masternodelist_cache.nListVersion = nListVersion;
+    }
+    g_masternodelist_cache.mapModes[strMode] = entries;
+    return entries;
+}
+// VELES END
+
 UniValue masternodelist(const JSONRPCRequest& request)
 {
     std::string strMode = "status";
@@ -588,6 +743,88 @@ UniValue masternodelist(const JSONRPCRequest& request)
         mnodeman.UpdateLastPaid(pindex);
     }
 
+    // VELES BEGIN
+    //UniValue obj(UniValue::VOBJ);
+    //if (strMode == "rank") {
+    //    CMasternodeMan::rank_pair_vec_t vMasternodeRanks;
+    //    mnodeman.GetMasternodeRanks(vMasternodeRanks);
+    //    for (std::pair<int, CMasternode>& s : vMasternodeRanks) {
+    //        std::string strOutpoint = s.second.vin.prevout.ToStringShort();
+    //        if (strFilter !="" && strOutpoint.find(strFilter) == std::string::npos) continue;
+    //        obj.pushKV(strOutpoint, s.first);
+    //    }
+    //} else {
+    //    std::map<COutPoint, CMasternode> mapMasternodes = mnodeman.GetFullMasternodeMap();
+    //    for (auto& mnpair : mapMasternodes) {
+    //        CMasternode mn = mnpair.second;
+    //        std::string strOutpoint = mnpair.first.ToStringShort();
+    //        if (strMode == "activeseconds") {
+    //            if (strFilter !="" && strOutpoint.find(strFilter) == std::string::npos) continue;
+    //            obj.pushKV(strOutpoint, (int64_t)(mn.lastPing.sigTime - mn.sigTime));
+    //        } else if (strMode == "addr") {
+    //            std::string strAddress = mn.addr.ToString();
+    //            if (strFilter !="" && strAddress.find(strFilter) == std::string::npos &&
+    //                strOutpoint.find(strFilter) == std::string::npos) continue;
+    //            obj.pushKV(strOutpoint, strAddress);
+    //        } else if (strMode == "full") {
+    //            std::ostringstream streamFull;
+    //            streamFull << std::setw(18) <<
+    //                           mn.GetStatus() << " " <<
+    //                           mn.nProtocolVersion << " " <<
+    //                           EncodeDestination(mn.pubKeyCollateralAddress.GetID()) << " " <<
+    //                           (int64_t)mn.lastPing.sigTime << " " << std::setw(8) <<
+    //                           (int64_t)(mn.lastPing.sigTime - mn.sigTime) << " " << std::setw(10) <<
+    //                           mn.GetLastPaidTime() << " "  << std::setw(6) <<
+    //                           mn.GetLastPaidBlock() << " " <<
+    //                           mn.addr.ToString();
+    //            std::string strFull = streamFull.str();
+    //            if (strFilter !="" && strFull.find(strFilter) == std::string::npos &&
+    //                strOutpoint.find(strFilter) == std::string::npos) continue;
+    //            obj.pushKV(strOutpoint, strFull);
+    //        } else if (strMode == "info") {
+    //            std::ostringstream streamInfo;
+    //            streamInfo << std::setw(18) <<
+    //                           mn.GetStatus() << " " <<
+    //                           mn.nProtocolVersion << " " <<
+    //                           EncodeDestination(mn.pubKeyCollateralAddress.GetID()) << " " <<
+    //                           (int64_t)mn.lastPing.sigTime << " " << std::setw(8) <<
+    //                           (int64_t)(mn.lastPing.sigTime - mn.sigTime) << " " <<
+    //                           SafeIntVersionToString(mn.lastPing.nSentinelVersion) << " "  <<
+    //                           (mn.lastPing.fSentinelIsCurrent ? "current" : "expired") << " " <<
+    //                           mn.addr.ToString();
+    //            std::string strInfo = streamInfo.str();
+    //            if (strFilter !="" && strInfo.find(strFilter) == std::string::npos &&
+    //                strOutpoint.find(strFilter) == std::string::npos) continue;
+    //            obj.pushKV(strOutpoint, strInfo);
+    //        } else if (strMode == "lastpaidblock") {
+    //            if (strFilter !="" && strOutpoint.find(strFilter) == std::string::npos) continue;
+    //            obj.pushKV(strOutpoint, mn.GetLastPaidBlock());
+    //        } else if (strMode == "lastpaidtime") {
+    //            if (strFilter !="" && strOutpoint.find(strFilter) == std::string::npos) continue;
+    //            obj.pushKV(strOutpoint, mn.GetLastPaidTime());
+    //        } else if (strMode == "lastseen") {
+    //            if (strFilter !="" && strOutpoint.find(strFilter) == std::string::npos) continue;
+    //            obj.pushKV(strOutpoint, (int64_t)mn.lastPing.sigTime);
+    //        } else if (strMode == "payee") {
+    //            std::string strPayee = EncodeDestination(mn.pubKeyCollateralAddress.GetID());
+    //            if (strFilter !="" && strPayee.find(strFilter) == std::string::npos &&
+    //                strOutpoint.find(strFilter) == std::string::npos) continue;
+    //            obj.pushKV(strOutpoint, strPayee);
+    //        } else if (strMode == "protocol") {
+    //            if (strFilter !="" && strFilter != strprintf("%d", mn.nProtocolVersion) &&
+    //                strOutpoint.find(strFilter) == std::string::npos) continue;
+    //            obj.pushKV(strOutpoint, (int64_t)mn.nProtocolVersion);
+    //        } else if (strMode == "pubkey") {
+    //            if (strFilter !="" && strOutpoint.find(strFilter) == std::string::npos) continue;
+    //            obj.pushKV(strOutpoint, HexStr(mn.pubKeyMasternode));
+    //        } else if (strMode == "status") {
+    //            std::string strStatus = mn.GetStatus();
+    //            if (strFilter !="" && strStatus.find(strFilter) == std::string::npos &&
+    //                strOutpoint.find(strFilter) == std::string::npos) continue;
+    //            obj.pushKV(strOutpoint, strStatus);
+    //        }
+    //    }
+    //}
     UniValue obj(UniValue::VOBJ);
     if (strMode == "rank") {
         CMasternodeMan::rank_pair_vec_t vMasternodeRanks;
@@ -598,77 +835,13 @@ UniValue masternodelist(const JSONRPCRequest& request)
             obj.pushKV(strOutpoint, s.first);
         }
     } else {
-        std::map<COutPoint, CMasternode> mapMasternodes = mnodeman.GetFullMasternodeMap();
-        for (auto& mnpair : mapMasternodes) {
-            CMasternode mn = mnpair.second;
-            std::string strOutpoint = mnpair.first.ToStringShort();
-            if (strMode == "activeseconds") {
-                if (strFilter !="" && strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.pushKV(strOutpoint, (int64_t)(mn.lastPing.sigTime - mn.sigTime));
-            } else if (strMode == "addr") {
-                std::string strAddress = mn.addr.ToString();
-                if (strFilter !="" && strAddress.find(strFilter) == std::string::npos &&
-                    strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.pushKV(strOutpoint, strAddress);
-            } else if (strMode == "full") {
-                std::ostringstream streamFull;
-                streamFull << std::setw(18) <<
-                               mn.GetStatus() << " " <<
-                               mn.nProtocolVersion << " " <<
-                               EncodeDestination(mn.pubKeyCollateralAddress.GetID()) << " " <<
-                               (int64_t)mn.lastPing.sigTime << " " << std::setw(8) <<
-                               (int64_t)(mn.lastPing.sigTime - mn.sigTime) << " " << std::setw(10) <<
-                               mn.GetLastPaidTime() << " "  << std::setw(6) <<
-                               mn.GetLastPaidBlock() << " " <<
-                               mn.addr.ToString();
-                std::string strFull = streamFull.str();
-                if (strFilter !="" && strFull.find(strFilter) == std::string::npos &&
-                    strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.pushKV(strOutpoint, strFull);
-            } else if (strMode == "info") {
-                std::ostringstream streamInfo;
-                streamInfo << std::setw(18) <<
-                               mn.GetStatus() << " " <<
-                               mn.nProtocolVersion << " " <<
-                               EncodeDestination(mn.pubKeyCollateralAddress.GetID()) << " " <<
-                               (int64_t)mn.lastPing.sigTime << " " << std::setw(8) <<
-                               (int64_t)(mn.lastPing.sigTime - mn.sigTime) << " " <<
-                               SafeIntVersionToString(mn.lastPing.nSentinelVersion) << " "  <<
-                               (mn.lastPing.fSentinelIsCurrent ? "current" : "expired") << " " <<
-                               mn.addr.ToString();
-                std::string strInfo = streamInfo.str();
-                if (strFilter !="" && strInfo.find(strFilter) == std::string::npos &&
-                    strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.pushKV(strOutpoint, strInfo);
-            } else if (strMode == "lastpaidblock") {
-                if (strFilter !="" && strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.pushKV(strOutpoint, mn.GetLastPaidBlock());
-            } else if (strMode == "lastpaidtime") {
-                if (strFilter !="" && strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.pushKV(strOutpoint, mn.GetLastPaidTime());
-            } else if (strMode == "lastseen") {
-                if (strFilter !="" && strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.pushKV(strOutpoint, (int64_t)mn.lastPing.sigTime);
-            } else if (strMode == "payee") {
-                std::string strPayee = EncodeDestination(mn.pubKeyCollateralAddress.GetID());
-                if (strFilter !="" && strPayee.find(strFilter) == std::string::npos &&
-                    strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.pushKV(strOutpoint, strPayee);
-            } else if (strMode == "protocol") {
-                if (strFilter !="" && strFilter != strprintf("%d", mn.nProtocolVersion) &&
-                    strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.pushKV(strOutpoint, (int64_t)mn.nProtocolVersion);
-            } else if (strMode == "pubkey") {
-                if (strFilter !="" && strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.pushKV(strOutpoint, HexStr(mn.pubKeyMasternode));
-            } else if (strMode == "status") {
-                std::string strStatus = mn.GetStatus();
-                if (strFilter !="" && strStatus.find(strFilter) == std::string::npos &&
-                    strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.pushKV(strOutpoint, strStatus);
-            }
+        // Outpoints are unique, skip the duplicate key check of pushKV
+        for (const MasternodeListEntry& entry : *GetMasternodeListEntries(strMode)) {
+            if (!MatchesMasternodeListFilter(strMode, entry, strFilter)) continue;
+            obj.__pushKV(entry.strOutpoint, entry.value);
         }
     }
+    // VELES END
     return obj;
 }
 
@@ -958,6 +1131,7 @@ UniValue sentinelping(const JSONRPCRequest& request)
     }
 
     activeMasternode.UpdateSentinelPing(StringVersionToInt(request.params[0].get_str()));
+    hostedMasternodes.UpdateSentinelPing(StringVersionToInt(request.params[0].get_str())); // VELES
     return true;
 }
 
@@ -37,6 +37,10 @@
 #include <masternode/sync.h>
 //
 
+// VELES BEGIN
+#include <algostats.h>
+// VELES END
+
 #include <memory>
 #include <stdint.h>
 
@@ -78,11 +82,28 @@ static UniValue GetNetworkHashPS(int lookup, int height, int32_t nAlgo) {   // V
 
     arith_uint256 workDiff = pb->nChainWork - pb0->nChainWork;
     // FXTC BEGIN
-    CBlockIndex* pbAlgo = pb;
-    while (pbAlgo->pprev && nAlgo != (pbAlgo->nVersion & ALGO_VERSION_MASK)) pbAlgo = pbAlgo->pprev;
-    CBlockIndex* pb0Algo = pb0;
-    while (pb0Algo->pprev && nAlgo != (pb0Algo->nVersion & ALGO_VERSION_MASK)) pb0Algo = pb0Algo->pprev;
-    workDiff = pbAlgo->nChainWorkAlgo - pb0Algo->nChainWorkAlgo;
+    //CBlockIndex* pbAlgo = pb;
+    //while (pbAlgo->pprev && nAlgo != (pbAlgo->nVersion & ALGO_VERSION_MASK)) pbAlgo = pbAlgo->pprev;
+    //CBlockIndex* pb0Algo = pb0;
+    //while (pb0Algo->pprev && nAlgo != (pb0Algo->nVersion & ALGO_VERSION_MASK)) pb0Algo = pb0Algo->pprev;
+    //workDiff = pbAlgo->nChainWorkAlgo - pb0Algo->nChainWorkAlgo;
+    // VELES BEGIN
+    // Only the window is searched for the last block of the algo, an algo without
+    // blocks within the window did no work there. Its older blocks are reached
+    // through pprevAlgo instead of walking the chain back to the genesis block.
+    const CBlockIndex* pbAlgo = pb;
+    while (pbAlgo != pb0 && pbAlgo->GetAlgo() != nAlgo)
+        pbAlgo = pbAlgo->pprev;
+    workDiff = 0;
+    if (pbAlgo != pb0) {
+        const CBlockIndex* pb0Algo = pbAlgo;
+        while (pb0Algo->pprevAlgo && pb0Algo->nHeight > pb0->nHeight)
+            pb0Algo = pb0Algo->pprevAlgo;
+        if (pb0Algo->nHeight > pb0->nHeight)
+            pb0Algo = pb0->GetAncestor(0);
+        workDiff = pbAlgo->nChainWorkAlgo - pb0Algo->nChainWorkAlgo;
+    }
+    // VELES END
     // FXTC END
     int64_t timeDiff = maxTime - minTime;
 
@@ -118,14 +139,9 @@ static UniValue getnetworkhashps(const JSONRPCRequest& request)
 // VELES BEGIN
 /* Returns last block mined by the given algo */
 static const CBlockIndex *GetLastAlgoBlock(int32_t nAlgo) {
-    CBlockIndex *pb = chainActive.Tip();
-
-    // Look up last block mined by the current algo
-    while ((pb->nVersion & ALGO_VERSION_MASK) != nAlgo && pb->pprev) {
-        pb = pb->pprev;
-    }
-
-   return pb;
+    LOCK(cs_main);
+    algoStats.SetTip(chainActive.Tip());
+    return algoStats.GetLastBlock(nAlgo);
 }
 
 /**
@@ -145,41 +161,9 @@ static const CBlockIndex *GetLastAlgoBlock(int32_t nAlgo) {
 static double GetAlgoDifficulty(int32_t nAlgo) {
    return (double)GetDifficulty(GetLastAlgoBlock(nAlgo));
 }
-
-/* Returns sum of rewards for blocks mined by this algo from last X blocks */
-CAmount CountAlgoBlockRewards(int32_t nAlgo, int nBlocks) {
-    CBlockIndex *pb = chainActive.Tip();
-    CAmount nRewards = 0;
-
-    // Look up last block mined by the current algo
-    while (nBlocks && pb->pprev) {
-        if ((pb->nVersion & ALGO_VERSION_MASK) == nAlgo)
-            nRewards += GetBlockSubsidy(pb->nHeight, pb->GetBlockHeader(), Params().GetConsensus(), false);
-        pb = pb->pprev;
-        nBlocks--;
-    }
-
-   return nRewards;
-}
-
-/* Returns number of blocks mined by the given algo from last X blocks */
-int CountAlgoBlocks(int32_t nAlgo, int nBlocks) {
-    CBlockIndex *pb = chainActive.Tip();
-    int nAlgoBlocks = 0;
-
-    // Look up last block mined by the current algo
-    while (nBlocks && pb->pprev) {
-        if ((pb->nVersion & ALGO_VERSION_MASK) == nAlgo)
-            nAlgoBlocks++;
-        pb = pb->pprev;
-        nBlocks--;
-    }
-
-   return nAlgoBlocks;
-}
 // VELES END
 
-UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGenerate, uint64_t nMaxTries, bool keepScript)
+UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGenerate, uint64_t nMaxTries, bool keepScript, int nThreads) // VELES: Add parameter nThreads
 {
     static const int nInnerLoopCount = 0x10000;
     int nHeightEnd = 0;
@@ -204,17 +188,19 @@ UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGen
         }
         // FXTC BEGIN
         //while (nMaxTries > 0 && pblock->nNonce < nInnerLoopCount && !CheckProofOfWork(pblock->GetHash(), pblock->nBits, Params().GetConsensus())) {
-        while (nMaxTries > 0 && pblock->nNonce < nInnerLoopCount && !CheckProofOfWork(pblock->GetPoWHash(), pblock->nBits, Params().GetConsensus())) {
-        // FXTC END
-            ++pblock->nNonce;
-            --nMaxTries;
-        }
-        if (nMaxTries == 0) {
-            break;
-        }
-        if (pblock->nNonce == nInnerLoopCount) {
+        // VELES BEGIN
+        //while (nMaxTries > 0 && pblock->nNonce < nInnerLoopCount && !CheckProofOfWork(pblock->GetPoWHash(), pblock->nBits, Params().GetConsensus())) {
+        //    ++pblock->nNonce;
+        //    --nMaxTries;
+        //}
+        if (!ScanNonces(*pblock, nInnerLoopCount, nMaxTries, nThreads, Params().GetConsensus())) {
+            if (nMaxTries == 0) {
+                break;
+            }
             continue;
         }
+        // VELES END
+        // FXTC END
         std::shared_ptr<const CBlock> shared_pblock = std::make_shared<const CBlock>(*pblock);
         if (!ProcessNewBlock(Params(), shared_pblock, true, nullptr))
             throw JSONRPCError(RPC_INTERNAL_ERROR, "ProcessNewBlock, block not accepted");
@@ -232,7 +218,7 @@ UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGen
 
 static UniValue generatetoaddress(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() < 2 || request.params.size() > 3)
+    if (request.fHelp || request.params.size() < 2 || request.params.size() > 4) // VELES: Added parameter
         throw std::runtime_error(
             RPCHelpMan{"generatetoaddress",
                 "\nMine blocks immediately to a specified address (before the RPC call returns)\n",
@@ -240,6 +226,9 @@ static UniValue generatetoaddress(const JSONRPCRequest& request)
                     {"nblocks", RPCArg::Type::NUM, RPCArg::Optional::NO, "How many blocks are generated immediately."},
                     {"address", RPCArg::Type::STR, RPCArg::Optional::NO, "The address to send the newly generated veles to."},
                     {"maxtries", RPCArg::Type::NUM, /* default */ "1000000", "How many iterations to try."},
+                    // VELES BEGIN
+                    {"nthreads", RPCArg::Type::NUM, /* default */ "1", "How many threads search the nonces, -1 for one per CPU core."},
+                    // VELES END
                 },
                 RPCResult{
             "[ blockhashes ]     (array) hashes of blocks generated\n"
@@ -247,6 +236,10 @@ static UniValue generatetoaddress(const JSONRPCRequest& request)
                 RPCExamples{
             "\nGenerate 11 blocks to myaddress\n"
             + HelpExampleCli("generatetoaddress", "11 \"myaddress\"")
+            // VELES BEGIN
+            + "\nGenerate 11 blocks to myaddress with 4 threads\n"
+            + HelpExampleCli("generatetoaddress", "11 \"myaddress\" 1000000 4")
+            // VELES END
             + "If you are running the veles core wallet, you can get a new address to send the newly generated veles to with:\n"
             + HelpExampleCli("getnewaddress", "")
                 },
@@ -263,10 +256,21 @@ static UniValue generatetoaddress(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Error: Invalid address");
     }
 
+    // VELES BEGIN
+    int nThreads = 1;
+    if (!request.params[3].isNull()) {
+        nThreads = request.params[3].get_int();
+        if (nThreads == -1)
+            nThreads = GetNumCores();
+        if (nThreads < 1)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Error: Invalid number of threads");
+    }
+    // VELES END
+
     std::shared_ptr<CReserveScript> coinbaseScript = std::make_shared<CReserveScript>();
     coinbaseScript->reserveScript = GetScriptForDestination(destination);
 
-    return generateBlocks(coinbaseScript, nGenerate, nMaxTries, false);
+    return generateBlocks(coinbaseScript, nGenerate, nMaxTries, false, nThreads); // VELES: Add parameter nThreads
 }
 
 static UniValue getmininginfo(const JSONRPCRequest& request)
@@ -374,7 +378,7 @@ static UniValue gethalvinginfo(const JSONRPCRequest& request)
         );
     }
 
-    HalvingParameters *halvingParams = GetSubsidyHalvingParameters();
+    std::shared_ptr<const HalvingParameters> halvingParams = GetSubsidyHalvingParameters();
     std::vector<std::string> knownEpochs = { "COINSWAP", "BOOTSTRAP", "ALPHA" };
     std::string epochName;
     int nHalvings = 0;
@@ -419,8 +423,7 @@ static UniValue gethalvinginfo(const JSONRPCRequest& request)
             ? halvingParams->epochs[i].nEndSupply - halvingParams->epochs[i].nStartSupply
             : CountBlockRewards(
                 halvingParams->epochs[i].nStartBlock,
-                chainActive.Height(),
-                GetSubsidyHalvingParameters(chainActive.Height(), Params().GetConsensus())
+                chainActive.Height()
                 );
         nSupplySinceHalving += nEpochRealSupply;
 
@@ -525,41 +528,106 @@ static UniValue getminingstats(const JSONRPCRequest& request)
 
     UniValue arr(UniValue::VARR);
     UniValue algoObj(UniValue::VOBJ);
-    int nBlocksTotal24h = (24 * 3600) / Params().GetConsensus().nPowTargetSpacing;
-    int nBlocksTotal7d = (7 * 24 * 3600) / Params().GetConsensus().nPowTargetSpacing;
-    int nAlgoBlocks24h;
-    int nAlgoBlocks7d;
     std::vector<int32_t> algos = {ALGO_SHA256D, ALGO_SCRYPT, ALGO_LYRA2Z, ALGO_X11, ALGO_X16R, ALGO_NIST5};
     const CBlockIndex* pb;
 
+    LOCK(cs_main);
+    algoStats.SetTip(chainActive.Tip());
+
     for(int i = 0; i < (int)algos.size(); i++) {
-        pb = GetLastAlgoBlock(algos[i]);
-        nAlgoBlocks24h = CountAlgoBlocks(algos[i], nBlocksTotal24h);
-        nAlgoBlocks7d = CountAlgoBlocks(algos[i], nBlocksTotal7d);
+        pb = algoStats.GetLastBlock(algos[i]);
+        const CAlgoStats::Totals totals = algoStats.GetTotals(algos[i]);
 
         algoObj.pushKV("algo", GetAlgoName(algos[i]));
         algoObj.pushKV("last_block_reward", ValueFromAmount(GetBlockSubsidy(pb->nHeight, pb->GetBlockHeader(), Params().GetConsensus(), false)));
 
-        if (nAlgoBlocks24h > 0) {
-            algoObj.pushKV("avg_block_reward_24h", ValueFromAmount(CountAlgoBlockRewards(algos[i], nBlocksTotal24h) / nAlgoBlocks24h));
+        if (totals.nBlocks24h > 0) {
+            algoObj.pushKV("avg_block_reward_24h", ValueFromAmount(totals.nRewards24h / totals.nBlocks24h));
         } else {
             algoObj.pushKV("avg_block_reward_24h", 0);
         }
 
-        if (nAlgoBlocks7d > 0) {
-            algoObj.pushKV("avg_block_reward_7d", ValueFromAmount(CountAlgoBlockRewards(algos[i], nBlocksTotal7d) / nAlgoBlocks7d));
+        if (totals.nBlocks7d > 0) {
+            algoObj.pushKV("avg_block_reward_7d", ValueFromAmount(totals.nRewards7d / totals.nBlocks7d));
         } else {
             algoObj.pushKV("avg_block_reward_7d", 0);
         }
 
-        algoObj.pushKV("total_blocks_24h", nAlgoBlocks24h);
-        algoObj.pushKV("total_blocks_7d", nAlgoBlocks7d);
+        algoObj.pushKV("total_blocks_24h", totals.nBlocks24h);
+        algoObj.pushKV("total_blocks_7d", totals.nBlocks7d);
         // algoObj.pushKV("cost_factor", GetAlgoCostFactor(algos[i]));  // if shown it should be calculated to some human-understandable form, like %
         arr.push_back(algoObj);
     }
 
     return arr;
 }
+
+static UniValue getalgocostfactors(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+            RPCHelpMan{"getalgocostfactors",
+            "\nReturns the cost factors and efficiencies used to compute the block rewards of each algo at the given height,\n"
+            "together with the range of heights sharing them. The cost factors only change at the heights where the cost\n"
+            "factor sporks activate.",
+            {
+                {"height", RPCArg::Type::NUM, /* default */ "next block", "The height to show the factors for."},
+            },
+            RPCResult{
+                "{\n"
+                "  \"height\": nnn,                  (numeric) Height the factors apply to\n"
+                "  \"start_height\": nnn,            (numeric) First height sharing these factors\n"
+                "  \"end_height\": nnn,              (numeric|null) First height with different factors, null when no further change is scheduled\n"
+                "  \"algos\": [\n"
+                "     {\n"
+                "       \"algo\": xxxxxx,            (string)  PoW algorithm name\n"
+                "       \"cost_factor\": x.xxx,      (numeric) Cost factor of the algo relative to the average of all algos\n"
+                "       \"efficiency\": nnn,         (numeric) Efficiency the algo target is normalized by\n"
+                "     },\n"
+                "     ...\n"
+                "  ]\n"
+                "}\n"
+            },
+            RPCExamples{
+                HelpExampleCli("getalgocostfactors", "")
+              + HelpExampleCli("getalgocostfactors", "51000")
+              + HelpExampleRpc("getalgocostfactors", "51000")
+            },
+        }.ToString());
+
+    int nHeight;
+    if (!request.params[0].isNull()) {
+        nHeight = request.params[0].get_int();
+        if (nHeight < 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+    } else {
+        LOCK(cs_main);
+        nHeight = chainActive.Height() + 1;
+    }
+
+    int64_t nStartHeight, nEndHeight;
+    GetAlgoCostFactorRange(nHeight, nStartHeight, nEndHeight);
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("height", nHeight);
+    obj.pushKV("start_height", nStartHeight);
+    obj.pushKV("end_height", nEndHeight < 0 ? UniValue() : UniValue(nEndHeight));
+
+    UniValue arr(UniValue::VARR);
+    for (int32_t nAlgo : {ALGO_SHA256D, ALGO_SCRYPT, ALGO_LYRA2Z, ALGO_X11, ALGO_X16R, ALGO_NIST5}) {
+        CBlockHeader header;
+        header.nVersion = VERSIONBITS_TOP_BITS | nAlgo;
+
+        UniValue algoObj(UniValue::VOBJ);
+        algoObj.pushKV("algo", GetAlgoName(nAlgo));
+        algoObj.pushKV("cost_factor", GetAlgoCostFactor(nAlgo, nHeight));
+        algoObj.pushKV("efficiency", (uint64_t)header.GetAlgoEfficiency(nHeight));
+        arr.push_back(algoObj);
+    }
+    obj.pushKV("algos", arr);
+
+    return obj;
+}
 // VELES END
 
 // NOTE: Unlike wallet RPC (which use BTC values), mining RPCs follow GBT (BIP 22) in using satoshi amounts
@@ -629,6 +697,158 @@ static std::string gbt_vb_name(const Consensus::DeploymentPos pos) {
     return s;
 }
 
+// VELES BEGIN
+// Every algo keeps its own template and longpoll state, the templates built
+// on the same tip share one selection of mempool transactions
+struct AlgoTemplate {
+    CBlockIndex* pindexPrev = nullptr;
+    int64_t nStart = 0;
+    unsigned int nTransactionsUpdatedLast = 0;
+    std::unique_ptr<CBlockTemplate> pblocktemplate;
+    //! Asked for by a client since the last refresh
+    bool fRequested = false;
+};
+static std::map<int32_t, AlgoTemplate> mapAlgoTemplates GUARDED_BY(cs_main);
+static CBlockIndex* pindexSelection GUARDED_BY(cs_main);
+static int64_t nSelectionStart GUARDED_BY(cs_main);
+static unsigned int nSelectionTransactionsUpdated GUARDED_BY(cs_main);
+static std::unique_ptr<CBlockTemplate> pselection GUARDED_BY(cs_main);
+
+/** The template of the algo on the active tip, made again when the tip changed or the mempool did more than five seconds ago */
+static AlgoTemplate& UpdateAlgoTemplate(int32_t nPowAlgo, bool fPrecompute = false) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    AlgoTemplate& algoTemplate = mapAlgoTemplates[nPowAlgo];
+    if (!fPrecompute) {
+        algoTemplate.fRequested = true;
+        g_template_precomputer.SetUsed();
+    }
+    CBlockIndex*& pindexPrev = algoTemplate.pindexPrev;
+    int64_t& nStart = algoTemplate.nStart;
+    unsigned int& nTransactionsUpdatedLast = algoTemplate.nTransactionsUpdatedLast;
+    std::unique_ptr<CBlockTemplate>& pblocktemplate = algoTemplate.pblocktemplate;
+    if (pindexPrev != chainActive.Tip() ||
+        (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5))
+    {
+        // Clear pindexPrev so future calls make a new block, despite any failures from here on
+        pindexPrev = nullptr;
+
+        CBlockIndex* pindexPrevNew = chainActive.Tip();
+        CScript scriptDummy = CScript() << OP_TRUE;
+
+        // Select the transactions again only when the shared selection is as outdated as this template
+        if (pindexSelection != pindexPrevNew ||
+            (mempool.GetTransactionsUpdated() != nSelectionTransactionsUpdated && GetTime() - nSelectionStart > 5))
+        {
+            pindexSelection = nullptr;
+
+            // Store the pindexBest used before CreateNewBlock, to avoid races
+            nSelectionTransactionsUpdated = mempool.GetTransactionsUpdated();
+            nSelectionStart = GetTime();
+
+            // Create new block, on the same tip only the mempool changes since the last one are looked at
+            pselection = BlockAssembler(Params()).CreateNewBlock(scriptDummy, nPowAlgo, &g_block_selection);
+            if (!pselection)
+                throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
+            pindexSelection = pindexPrevNew;
+            pblocktemplate.reset(new CBlockTemplate(*pselection));
+        } else {
+            // Same transactions, only the header and the coinbase of the algo differ
+            pblocktemplate = BlockAssembler(Params()).CreateNewBlock(*pselection, scriptDummy, nPowAlgo);
+            if (!pblocktemplate)
+                throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
+        }
+        nTransactionsUpdatedLast = nSelectionTransactionsUpdated;
+        nStart = nSelectionStart;
+
+        // Need to update only after we know CreateNewBlock succeeded
+        pindexPrev = pindexPrevNew;
+    }
+    assert(pindexPrev);
+
+    // Update nTime
+    UpdateTime(&pblocktemplate->block, Params().GetConsensus(), pindexPrev);
+    pblocktemplate->block.nNonce = 0;
+    return algoTemplate;
+}
+
+CBlockTemplatePrecomputer g_template_precomputer;
+
+static const int32_t ACTIVE_ALGOS[ALGO_ACTIVE_COUNT] = {ALGO_SHA256D, ALGO_SCRYPT, ALGO_LYRA2Z, ALGO_X11, ALGO_X16R};
+
+/** Make the templates of all the active algos, or refresh the ones asked for since the last call */
+static void PrecomputeAlgoTemplates(bool fAllAlgos)
+{
+    LOCK(cs_main);
+    if (IsInitialBlockDownload())
+        return;
+    for (int32_t nPowAlgo : ACTIVE_ALGOS) {
+        AlgoTemplate& algoTemplate = mapAlgoTemplates[nPowAlgo];
+        if (!fAllAlgos && !algoTemplate.fRequested)
+            continue;
+        algoTemplate.fRequested = false;
+        try {
+            UpdateAlgoTemplate(nPowAlgo, true);
+        } catch (const UniValue& objError) {
+            LogPrint(BCLog::RPC, "%s: %s\n", __func__, find_value(objError, "message").get_str());
+        } catch (const std::exception& e) {
+            LogPrint(BCLog::RPC, "%s: %s\n", __func__, e.what());
+        }
+    }
+}
+
+void CBlockTemplatePrecomputer::ThreadPrecompute()
+{
+    WAIT_LOCK(cs, lock);
+    while (!fStop) {
+        const bool fAllAlgos = fTipChanged;
+        fTipChanged = false;
+        if (fUsed) {
+            lock.unlock();
+            int64_t nTimeStart = GetTimeMicros();
+            PrecomputeAlgoTemplates(fAllAlgos);
+            if (fAllAlgos)
+                LogPrint(BCLog::BENCH, "%s: templates of the new tip made in %.2fms\n", __func__, (GetTimeMicros() - nTimeStart) * 0.001);
+            lock.lock();
+        }
+        if (!fStop && !fTipChanged)
+            cond.wait_for(lock, std::chrono::seconds(BLOCK_TEMPLATE_REFRESH_INTERVAL));
+    }
+}
+
+void CBlockTemplatePrecomputer::UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload)
+{
+    if (fInitialDownload || !fUsed)
+        return;
+    {
+        LOCK(cs);
+        fTipChanged = true;
+    }
+    cond.notify_one();
+}
+
+void CBlockTemplatePrecomputer::Start()
+{
+    assert(!thread.joinable());
+    {
+        LOCK(cs);
+        fStop = false;
+    }
+    thread = std::thread(&TraceThread<std::function<void()>>, "tmplprecomp",
+                         std::bind(&CBlockTemplatePrecomputer::ThreadPrecompute, this));
+}
+
+void CBlockTemplatePrecomputer::Stop()
+{
+    {
+        LOCK(cs);
+        fStop = true;
+    }
+    cond.notify_all();
+    if (thread.joinable())
+        thread.join();
+}
+// VELES END
+
 static UniValue getblocktemplate(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() > 2) // Veles: Added parameter
@@ -790,7 +1010,8 @@ static UniValue getblocktemplate(const JSONRPCRequest& request)
             if (block.hashPrevBlock != pindexPrev->GetBlockHash())
                 return "inconclusive-not-best-prevblk";
             CValidationState state;
-            TestBlockValidity(state, Params(), block, pindexPrev, false, true);
+            //TestBlockValidity(state, Params(), block, pindexPrev, false, true);
+            TestBlockTemplateValidity(state, Params(), block, pindexPrev, true); // VELES
             return BIP22ValidationResult(state);
         }
 
@@ -845,7 +1066,10 @@ static UniValue getblocktemplate(const JSONRPCRequest& request)
             throw JSONRPCError(RPC_CLIENT_IN_INITIAL_DOWNLOAD, "Veles Core is syncing with network...");
     //
 
-    static unsigned int nTransactionsUpdatedLast;
+    // VELES BEGIN
+    AlgoTemplate& algoTemplate = mapAlgoTemplates[nPowAlgo];
+    unsigned int& nTransactionsUpdatedLast = algoTemplate.nTransactionsUpdatedLast;
+    // VELES END
 
     if (!lpval.isNull())
     {
@@ -906,39 +1130,13 @@ static UniValue getblocktemplate(const JSONRPCRequest& request)
     }
 
     // Update block
-    static CBlockIndex* pindexPrev;
-    static int64_t nStart;
-    static std::unique_ptr<CBlockTemplate> pblocktemplate;
-    static int32_t nTemplatePowAlgo;    // Veles
-    if (pindexPrev != chainActive.Tip() ||
-        (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5) ||
-        nPowAlgo != nTemplatePowAlgo)   // Veles: Check whether the cached template has been generated for the same algo
-    {
-        // Clear pindexPrev so future calls make a new block, despite any failures from here on
-        pindexPrev = nullptr;
-
-        // Store the pindexBest used before CreateNewBlock, to avoid races
-        nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
-        CBlockIndex* pindexPrevNew = chainActive.Tip();
-        nStart = GetTime();
-        nTemplatePowAlgo = nPowAlgo;    // Veles
-
-        // Create new block
-        CScript scriptDummy = CScript() << OP_TRUE;
-        pblocktemplate = BlockAssembler(Params()).CreateNewBlock(scriptDummy, nPowAlgo); // VELES: Use given algo
-        if (!pblocktemplate)
-            throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
-
-        // Need to update only after we know CreateNewBlock succeeded
-        pindexPrev = pindexPrevNew;
-    }
-    assert(pindexPrev);
+    // VELES BEGIN
+    UpdateAlgoTemplate(nPowAlgo);
+    CBlockIndex* const pindexPrev = algoTemplate.pindexPrev;
+    std::unique_ptr<CBlockTemplate>& pblocktemplate = algoTemplate.pblocktemplate;
     CBlock* pblock = &pblocktemplate->block; // pointer for convenience
     const Consensus::Params& consensusParams = Params().GetConsensus();
-
-    // Update nTime
-    UpdateTime(pblock, consensusParams, pindexPrev);
-    pblock->nNonce = 0;
+    // VELES END
 
     // NOTE: If at some point we support pre-segwit miners post-segwit-activation, this needs to take segwit support into consideration
     const bool fPreSegWit = (ThresholdState::ACTIVE != VersionBitsState(pindexPrev, consensusParams, Consensus::DEPLOYMENT_SEGWIT, versionbitscache));
@@ -1175,6 +1373,14 @@ static UniValue submitblock(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Block does not start with a coinbase");
     }
 
+    return SubmitBlock(blockptr); // VELES
+}
+
+// VELES BEGIN
+UniValue SubmitBlock(const std::shared_ptr<CBlock>& blockptr)
+{
+    CBlock& block = *blockptr;
+    // VELES END
     uint256 hash = block.GetHash();
     {
         LOCK(cs_main);
@@ -1211,6 +1417,79 @@ static UniValue submitblock(const JSONRPCRequest& request)
     return BIP22ValidationResult(sc.state);
 }
 
+// VELES BEGIN
+bool GetBinaryBlockTemplate(int32_t nPowAlgo, CBinaryBlockTemplate& tmpl, std::string& strError)
+{
+    // The checks of getblocktemplate
+    if (!g_connman) {
+        strError = "Peer-to-peer functionality missing or disabled";
+        return false;
+    }
+    if (g_connman->GetNodeCount(CConnman::CONNECTIONS_ALL) == 0) {
+        strError = "Veles is not connected!";
+        return false;
+    }
+    if (IsInitialBlockDownload()) {
+        strError = "Veles is downloading blocks...";
+        return false;
+    }
+
+    LOCK(cs_main);
+
+    CScript payee;
+    if (sporkManager.IsSporkActive(SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT)
+        && !masternodeSync.IsWinnersListSynced()
+        && !mnpayments.GetBlockPayee(chainActive.Height() + 1, payee)) {
+        strError = "Veles Core is downloading masternode winners...";
+        return false;
+    }
+    if (sporkManager.IsSporkActive(SPORK_9_SUPERBLOCKS_ENABLED)
+        && !masternodeSync.IsSynced()
+        && CSuperblock::IsValidBlockHeight(chainActive.Height() + 1)) {
+        strError = "Veles Core is syncing with network...";
+        return false;
+    }
+
+    const AlgoTemplate& algoTemplate = UpdateAlgoTemplate(nPowAlgo);
+    const CBlockIndex* pindexPrev = algoTemplate.pindexPrev;
+    const CBlockTemplate& blocktemplate = *algoTemplate.pblocktemplate;
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+
+    // Transactions are shared with the cached template, only the header is set on the copy
+    tmpl.block = blocktemplate.block;
+    // The version getblocktemplate gives to a client with the segwit rule
+    for (int j = 0; j < (int)Consensus::MAX_VERSION_BITS_DEPLOYMENTS; ++j) {
+        const Consensus::DeploymentPos pos = Consensus::DeploymentPos(j);
+        const struct VBDeploymentInfo& vbinfo = VersionBitsDeploymentInfo[pos];
+        const bool fSupported = (pos == Consensus::DEPLOYMENT_SEGWIT) || vbinfo.gbt_force;
+        switch (VersionBitsState(pindexPrev, consensusParams, pos, versionbitscache)) {
+        case ThresholdState::DEFINED:
+        case ThresholdState::FAILED:
+            break;
+        case ThresholdState::LOCKED_IN:
+            tmpl.block.nVersion |= VersionBitsMask(consensusParams, pos);
+            // FALL THROUGH
+        case ThresholdState::STARTED:
+            if (!fSupported)
+                tmpl.block.nVersion &= ~VersionBitsMask(consensusParams, pos);
+            break;
+        case ThresholdState::ACTIVE:
+            if (!fSupported) {
+                strError = strprintf("Support for '%s' rule requires explicit client support", vbinfo.name);
+                return false;
+            }
+            break;
+        }
+    }
+    tmpl.vTxFees = blocktemplate.vTxFees;
+    tmpl.vTxSigOpsCost = blocktemplate.vTxSigOpsCost;
+    tmpl.vchCoinbaseCommitment = blocktemplate.vchCoinbaseCommitment;
+    tmpl.nHeight = pindexPrev->nHeight + 1;
+    tmpl.nMinTime = pindexPrev->GetMedianTimePast() + 1;
+    return true;
+}
+// VELES END
+
 static UniValue submitheader(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1) {
@@ -1253,7 +1532,7 @@ static UniValue submitheader(const JSONRPCRequest& request)
 
 static UniValue estimatesmartfee(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 3) // VELES
         throw std::runtime_error(
             RPCHelpMan{"estimatesmartfee",
                 "\nEstimates the approximate fee per kilobyte needed for a transaction to begin\n"
@@ -1271,12 +1550,16 @@ static UniValue estimatesmartfee(const JSONRPCRequest& request)
             "       \"UNSET\"\n"
             "       \"ECONOMICAL\"\n"
             "       \"CONSERVATIVE\""},
+                    {"time_based", RPCArg::Type::BOOL, /* default */ "false", "Estimate from the confirmation times instead of the\n"
+            "                   block counts, for conf_target times the target block spacing. Blocks of the\n"
+            "                   different algos do not arrive at a regular interval."},
                 },
                 RPCResult{
             "{\n"
             "  \"feerate\" : x.x,     (numeric, optional) estimate fee rate in " + CURRENCY_UNIT + "/kB\n"
             "  \"errors\": [ str... ] (json array of strings, optional) Errors encountered during processing\n"
             "  \"blocks\" : n         (numeric) block number where estimate was found\n"
+            "  \"seconds\" : n        (numeric, optional) time in seconds the estimate was found for, when time_based\n"
             "}\n"
             "\n"
             "The request target will be clamped between 2 and the highest target\n"
@@ -1286,10 +1569,11 @@ static UniValue estimatesmartfee(const JSONRPCRequest& request)
                 },
                 RPCExamples{
                     HelpExampleCli("estimatesmartfee", "6")
+            + HelpExampleCli("estimatesmartfee", "6 CONSERVATIVE true")
                 },
             }.ToString());
 
-    RPCTypeCheck(request.params, {UniValue::VNUM, UniValue::VSTR});
+    RPCTypeCheck(request.params, {UniValue::VNUM, UniValue::VSTR, UniValue::VBOOL}); // VELES
     RPCTypeCheckArgument(request.params[0], UniValue::VNUM);
     unsigned int conf_target = ParseConfirmTarget(request.params[0]);
     bool conservative = true;
@@ -1304,14 +1588,33 @@ static UniValue estimatesmartfee(const JSONRPCRequest& request)
     UniValue result(UniValue::VOBJ);
     UniValue errors(UniValue::VARR);
     FeeCalculation feeCalc;
-    CFeeRate feeRate = ::feeEstimator.estimateSmartFee(conf_target, &feeCalc, conservative);
+    // VELES BEGIN
+    //CFeeRate feeRate = ::feeEstimator.estimateSmartFee(conf_target, &feeCalc, conservative);
+    const bool time_based = !request.params[2].isNull() && request.params[2].get_bool();
+    const int64_t nSpacing = Params().GetConsensus().nPowTargetSpacing;
+    CFeeRate feeRate;
+    if (time_based) {
+        int64_t nSeconds = std::min((int64_t)conf_target * nSpacing, ::feeEstimator.HighestTimeTracked());
+        feeRate = ::feeEstimator.estimateTimeFee(nSeconds, &feeCalc, conservative);
+    } else {
+        feeRate = ::feeEstimator.estimateSmartFee(conf_target, &feeCalc, conservative);
+    }
+    // VELES END
     if (feeRate != CFeeRate(0)) {
         result.pushKV("feerate", ValueFromAmount(feeRate.GetFeePerK()));
     } else {
         errors.push_back("Insufficient data or no feerate found");
         result.pushKV("errors", errors);
     }
-    result.pushKV("blocks", feeCalc.returnedTarget);
+    // VELES BEGIN
+    //result.pushKV("blocks", feeCalc.returnedTarget);
+    if (time_based) {
+        result.pushKV("blocks", (feeCalc.returnedTarget + nSpacing - 1) / nSpacing);
+        result.pushKV("seconds", feeCalc.returnedTarget);
+    } else {
+        result.pushKV("blocks", feeCalc.returnedTarget);
+    }
+    // VELES END
     return result;
 }
 
@@ -1430,15 +1733,16 @@ static const CRPCCommand commands[] =
     { "mining",             "gethalvinginfo",         &gethalvinginfo,         {} },
     { "mining",             "getmultialgoinfo",       &getmultialgoinfo,       {} },
     { "mining",             "getminingstats",         &getminingstats,         {} },
+    { "mining",             "getalgocostfactors",     &getalgocostfactors,     {"height"} },
     //
     { "mining",             "prioritisetransaction",  &prioritisetransaction,  {"txid","dummy","fee_delta"} },
     { "mining",             "getblocktemplate",       &getblocktemplate,       {"template_request"} },
     { "mining",             "submitblock",            &submitblock,            {"hexdata","dummy"} },
     { "mining",             "submitheader",           &submitheader,           {"hexdata"} },
 
-    { "generating",         "generatetoaddress",      &generatetoaddress,      {"nblocks","address","maxtries"} },
+    { "generating",         "generatetoaddress",      &generatetoaddress,      {"nblocks","address","maxtries","nthreads"} }, // VELES: Added parameter nthreads
 
-    { "util",               "estimatesmartfee",       &estimatesmartfee,       {"conf_target", "estimate_mode"} },
+    { "util",               "estimatesmartfee",       &estimatesmartfee,       {"conf_target", "estimate_mode", "time_based"} },
 
     { "hidden",             "estimaterawfee",         &estimaterawfee,         {"conf_target", "threshold"} },
     // Veles
@@ -5,11 +5,98 @@
 #ifndef BITCOIN_RPC_MINING_H
 #define BITCOIN_RPC_MINING_H
 
+#include <amount.h>
+#include <primitives/block.h>
 #include <script/script.h>
+#include <serialize.h>
+#include <sync.h> // VELES
+#include <validationinterface.h> // VELES
 
 #include <univalue.h>
 
-/** Generate blocks (mine) */
-UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGenerate, uint64_t nMaxTries, bool keepScript);
+// VELES BEGIN
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+// VELES END
+
+/** Generate blocks (mine), searching the nonces with nThreads threads */
+UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGenerate, uint64_t nMaxTries, bool keepScript, int nThreads = 1); // VELES: Add parameter nThreads
+
+// VELES BEGIN
+/**
+ * Block template of the binary template transport, a serialized block instead of the hex of
+ * every transaction. The block is the getblocktemplate one ready to mine apart from the nonce,
+ * its coinbase pays the masternode, superblock and founder outputs and OP_TRUE the rest.
+ */
+struct CBinaryBlockTemplate
+{
+    CBlock block;
+    //! Fees and sigops cost of the transactions, the fee of the coinbase is minus the total fees
+    std::vector<CAmount> vTxFees;
+    std::vector<int64_t> vTxSigOpsCost;
+    std::vector<unsigned char> vchCoinbaseCommitment;
+    int32_t nHeight = 0;
+    int64_t nMinTime = 0;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(block);
+        READWRITE(vTxFees);
+        READWRITE(vTxSigOpsCost);
+        READWRITE(vchCoinbaseCommitment);
+        READWRITE(nHeight);
+        READWRITE(nMinTime);
+    }
+};
+
+/** The getblocktemplate template of the algo, sharing its cache. False with strError when no template can be made. */
+bool GetBinaryBlockTemplate(int32_t nPowAlgo, CBinaryBlockTemplate& tmpl, std::string& strError);
+
+/** Process a block from a miner like submitblock. Returns the BIP22 result, null when the block was accepted. */
+UniValue SubmitBlock(const std::shared_ptr<CBlock>& blockptr);
+
+/** Seconds between the refreshes of the templates asked for since the last one */
+static const int64_t BLOCK_TEMPLATE_REFRESH_INTERVAL = 5;
+
+/**
+ * Makes the templates of all the active algos in the background as soon as the tip
+ * changed, so the first getblocktemplate of every algo on the new tip is answered from
+ * the cache. The templates asked for in between are refreshed against the mempool
+ * and the fee deltas, reusing the shared transaction selection. Idle until a template
+ * was asked for once, a node that nobody mines on does not pay for it.
+ */
+class CBlockTemplatePrecomputer final : public CValidationInterface
+{
+private:
+    Mutex cs;
+    std::condition_variable cond;
+    std::thread thread;
+    bool fStop GUARDED_BY(cs) = false;
+    bool fTipChanged GUARDED_BY(cs) = false;
+    std::atomic<bool> fUsed{false};
+
+    void ThreadPrecompute();
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) override;
+
+public:
+    void Start();
+    void Stop();
+
+    /** A template was asked for, from now on they are made in advance */
+    void SetUsed() { fUsed = true; }
+};
+
+extern CBlockTemplatePrecomputer g_template_precomputer;
+// VELES END
 
 #endif
@@ -5,9 +5,11 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <blockreadcache.h> // VELES
 #include <chain.h>
 #include <clientversion.h>
 #include <core_io.h>
+#include <dbwrapper.h> // VELES
 #include <crypto/ripemd160.h>
 #include <key_io.h>
 #include <validation.h>
@@ -19,6 +21,8 @@
 #include <rpc/server.h>
 #include <rpc/util.h>
 #include <script/descriptor.h>
+#include <script/sigcache.h> // VELES
+#include <startuptimings.h> // VELES
 #include <timedata.h>
 #include <util/system.h>
 #include <util/strencodings.h>
@@ -27,12 +31,28 @@
 // Dash
 #include <masternode/sync.h>
 #include <spork.h>
+#include <instantx.h> // VELES
+// VELES BEGIN
+#include <governance/governance.h>
+#include <masternode/manager.h>
+#include <masternode/payments.h>
+#include <net_processing.h>
+#include <index/addressindex.h>
+#include <index/spentindex.h>
+// VELES BEGIN
+#include <index/blockfilterindex.h>
+#include <index/coinstatsindex.h>
+#include <index/timestampindex.h>
+#include <index/txindex.h>
+// VELES END
+// VELES END
 // FXTC BEGIN
 #include <wallet/rpcwallet.h>
 // FXTC END
 //
 
 #include <stdint.h>
+#include <algorithm> // VELES
 #ifdef HAVE_MALLOC_INFO
 #include <malloc.h>
 #endif
@@ -208,6 +228,340 @@ UniValue spork(const JSONRPCRequest& request)
 }
 //
 
+// VELES BEGIN
+static UniValue LockTimingPercentiles(std::vector<int64_t> vecValues)
+{
+    UniValue obj(UniValue::VOBJ);
+    if (vecValues.empty())
+        return obj;
+
+    std::sort(vecValues.begin(), vecValues.end());
+    for (int nPercentile : {50, 90, 99}) {
+        obj.pushKV(strprintf("p%d", nPercentile), vecValues[(vecValues.size() - 1) * nPercentile / 100]);
+    }
+    obj.pushKV("max", vecValues.back());
+    return obj;
+}
+
+static UniValue getinstantsendstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            RPCHelpMan{"getinstantsendstats",
+                "\nReturns the latency percentiles of the last " + std::to_string(INSTANTSEND_LOCK_TIMINGS_SIZE) + " transaction locks completed by this node.\n",
+                {},
+                RPCResult{
+            "{\n"
+            "  \"count\": n,             (numeric) The number of completed locks the statistics are based on\n"
+            "  \"first_vote_ms\": {      (json object) Delay of the first vote after the lock request, in milliseconds, negative when votes arrived first\n"
+            "    \"p50\": n,             (numeric) The 50th percentile\n"
+            "    \"p90\": n,             (numeric) The 90th percentile\n"
+            "    \"p99\": n,             (numeric) The 99th percentile\n"
+            "    \"max\": n              (numeric) The maximum\n"
+            "  },\n"
+            "  \"lock_ms\": {...},       (json object) Delay until the lock was complete, in milliseconds, same fields as above\n"
+            "  \"votes\": {...},         (json object) Votes received for each lock, same fields as above\n"
+            "  \"orphan_votes\": {...}   (json object) Votes received before the lock request, same fields as above\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getinstantsendstats", "")
+            + HelpExampleRpc("getinstantsendstats", "")
+                },
+            }.ToString());
+
+    std::vector<CTxLockTiming> vecTimings = instantsend.GetLockTimings();
+
+    std::vector<int64_t> vecFirstVote, vecLock, vecVotes, vecOrphanVotes;
+    for (const CTxLockTiming& timing : vecTimings) {
+        vecFirstVote.push_back(timing.nFirstVoteDelay / 1000);
+        vecLock.push_back(timing.nLockDelay / 1000);
+        vecVotes.push_back(timing.nVotes);
+        vecOrphanVotes.push_back(timing.nOrphanVotes);
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("count", (uint64_t)vecTimings.size());
+    obj.pushKV("first_vote_ms", LockTimingPercentiles(vecFirstVote));
+    obj.pushKV("lock_ms", LockTimingPercentiles(vecLock));
+    obj.pushKV("votes", LockTimingPercentiles(vecVotes));
+    obj.pushKV("orphan_votes", LockTimingPercentiles(vecOrphanVotes));
+    return obj;
+}
+// VELES END
+
+// VELES BEGIN
+/** The addresses an address index rpc call is about, given as one address or {"addresses": [...]} */
+static std::vector<std::pair<std::string, uint160>> ParseIndexAddresses(const UniValue& param)
+{
+    std::vector<UniValue> values;
+    if (param.isStr()) {
+        values.push_back(param);
+    } else if (param.isObject()) {
+        const UniValue& addresses = find_value(param.get_obj(), "addresses");
+        if (!addresses.isArray()) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Addresses is expected to be an array");
+        }
+        values = addresses.getValues();
+    } else {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Expected an address or an object with an addresses array");
+    }
+
+    std::vector<std::pair<std::string, uint160>> result;
+    for (const UniValue& value : values) {
+        const std::string& address = value.get_str();
+        CTxDestination dest = DecodeDestination(address);
+        if (!IsValidDestination(dest)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address: " + address);
+        }
+        result.emplace_back(address, GetAddressIndexHash(GetScriptForDestination(dest)));
+    }
+    return result;
+}
+
+static AddressIndex& GetSyncedAddressIndex()
+{
+    if (!g_addressindex) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Address index not enabled, restart with -addressindex");
+    }
+    g_addressindex->BlockUntilSyncedToCurrentChain();
+    return *g_addressindex;
+}
+
+static const std::string ADDRESSES_ARG_HELP = "An address, or a json object with the addresses";
+
+static UniValue getaddressbalance(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            RPCHelpMan{"getaddressbalance",
+                "\nReturns the balance of addresses in the active chain. Requires -addressindex.\n",
+                {
+                    {"addresses", RPCArg::Type::OBJ, RPCArg::Optional::NO, ADDRESSES_ARG_HELP,
+                        {
+                            {"addresses", RPCArg::Type::ARR, RPCArg::Optional::NO, "The addresses",
+                                {
+                                    {"address", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "The veles address"},
+                                },
+                            },
+                        },
+                    },
+                },
+                RPCResult{
+            "{\n"
+            "  \"balance\": n,    (numeric) The current balance in satoshis\n"
+            "  \"received\": n,   (numeric) The total number of satoshis received (including change)\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getaddressbalance", "'{\"addresses\": [\"fExDspm4Jxk6NcLmwm2gDBREYngUn4QhbA\"]}'")
+            + HelpExampleRpc("getaddressbalance", "{\"addresses\": [\"fExDspm4Jxk6NcLmwm2gDBREYngUn4QhbA\"]}")
+                },
+            }.ToString());
+
+    const std::vector<std::pair<std::string, uint160>> addresses = ParseIndexAddresses(request.params[0]);
+    const AddressIndex& index = GetSyncedAddressIndex();
+
+    CAmount balance = 0;
+    CAmount received = 0;
+    for (const auto& address : addresses) {
+        std::vector<AddressDelta> deltas;
+        if (!index.FindAddressDeltas(address.second, 0, std::numeric_limits<int>::max(), deltas)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read the address index");
+        }
+        for (const AddressDelta& delta : deltas) {
+            balance += delta.amount;
+            if (delta.amount > 0) {
+                received += delta.amount;
+            }
+        }
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("balance", balance);
+    result.pushKV("received", received);
+    return result;
+}
+
+static UniValue getaddressutxos(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            RPCHelpMan{"getaddressutxos",
+                "\nReturns the unspent outputs of addresses in the active chain, in height order. Requires -addressindex.\n",
+                {
+                    {"addresses", RPCArg::Type::OBJ, RPCArg::Optional::NO, ADDRESSES_ARG_HELP,
+                        {
+                            {"addresses", RPCArg::Type::ARR, RPCArg::Optional::NO, "The addresses",
+                                {
+                                    {"address", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "The veles address"},
+                                },
+                            },
+                        },
+                    },
+                },
+                RPCResult{
+            "[\n"
+            "  {\n"
+            "    \"address\": \"address\",  (string) The address\n"
+            "    \"txid\": \"hash\",        (string) The transaction id\n"
+            "    \"outputIndex\": n,      (numeric) The output index\n"
+            "    \"script\": \"hex\",       (string) The hex-encoded output script\n"
+            "    \"satoshis\": n,         (numeric) The number of satoshis of the output\n"
+            "    \"height\": n            (numeric) The height of the block containing the output\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"fExDspm4Jxk6NcLmwm2gDBREYngUn4QhbA\"]}'")
+            + HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"fExDspm4Jxk6NcLmwm2gDBREYngUn4QhbA\"]}")
+                },
+            }.ToString());
+
+    const std::vector<std::pair<std::string, uint160>> addresses = ParseIndexAddresses(request.params[0]);
+    const AddressIndex& index = GetSyncedAddressIndex();
+
+    std::vector<std::pair<const std::string*, AddressUnspent>> vUnspent;
+    for (const auto& address : addresses) {
+        std::vector<AddressUnspent> unspent;
+        if (!index.FindAddressUnspent(address.second, unspent)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read the address index");
+        }
+        for (AddressUnspent& entry : unspent) {
+            vUnspent.emplace_back(&address.first, std::move(entry));
+        }
+    }
+    std::stable_sort(vUnspent.begin(), vUnspent.end(), [](const std::pair<const std::string*, AddressUnspent>& a, const std::pair<const std::string*, AddressUnspent>& b) {
+        return a.second.height < b.second.height;
+    });
+
+    UniValue result(UniValue::VARR);
+    for (const auto& entry : vUnspent) {
+        UniValue output(UniValue::VOBJ);
+        output.pushKV("address", *entry.first);
+        output.pushKV("txid", entry.second.txhash.GetHex());
+        output.pushKV("outputIndex", (int64_t)entry.second.index);
+        output.pushKV("script", HexStr(entry.second.script.begin(), entry.second.script.end()));
+        output.pushKV("satoshis", entry.second.amount);
+        output.pushKV("height", entry.second.height);
+        result.push_back(output);
+    }
+    return result;
+}
+
+static UniValue getaddresstxids(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            RPCHelpMan{"getaddresstxids",
+                "\nReturns the ids of the transactions paying to or spending from addresses in the active chain, in height order. Requires -addressindex.\n",
+                {
+                    {"addresses", RPCArg::Type::OBJ, RPCArg::Optional::NO, ADDRESSES_ARG_HELP,
+                        {
+                            {"addresses", RPCArg::Type::ARR, RPCArg::Optional::NO, "The addresses",
+                                {
+                                    {"address", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "The veles address"},
+                                },
+                            },
+                            {"start", RPCArg::Type::NUM, /* default */ "0", "The start block height"},
+                            {"end", RPCArg::Type::NUM, /* default */ "tip", "The end block height"},
+                        },
+                    },
+                },
+                RPCResult{
+            "[\n"
+            "  \"transactionid\"  (string) The transaction id\n"
+            "  ,...\n"
+            "]\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"fExDspm4Jxk6NcLmwm2gDBREYngUn4QhbA\"]}'")
+            + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"fExDspm4Jxk6NcLmwm2gDBREYngUn4QhbA\"]}")
+                },
+            }.ToString());
+
+    const std::vector<std::pair<std::string, uint160>> addresses = ParseIndexAddresses(request.params[0]);
+    int start = 0;
+    int end = std::numeric_limits<int>::max();
+    if (request.params[0].isObject()) {
+        const UniValue& startValue = find_value(request.params[0].get_obj(), "start");
+        const UniValue& endValue = find_value(request.params[0].get_obj(), "end");
+        if (!startValue.isNull()) start = startValue.get_int();
+        if (!endValue.isNull()) end = endValue.get_int();
+        if (start < 0 || end < start) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Start and end are expected to be a height range");
+        }
+    }
+    const AddressIndex& index = GetSyncedAddressIndex();
+
+    std::vector<std::pair<int, uint256>> vTxids;
+    for (const auto& address : addresses) {
+        std::vector<AddressDelta> deltas;
+        if (!index.FindAddressDeltas(address.second, start, end, deltas)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read the address index");
+        }
+        for (const AddressDelta& delta : deltas) {
+            vTxids.emplace_back(delta.height, delta.txhash);
+        }
+    }
+    std::sort(vTxids.begin(), vTxids.end());
+    vTxids.erase(std::unique(vTxids.begin(), vTxids.end()), vTxids.end());
+
+    UniValue result(UniValue::VARR);
+    for (const auto& entry : vTxids) {
+        result.push_back(entry.second.GetHex());
+    }
+    return result;
+}
+
+static UniValue getspentinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 2)
+        throw std::runtime_error(
+            RPCHelpMan{"getspentinfo",
+                "\nReturns the input spending a transaction output in the active chain. Requires -spentindex.\n",
+                {
+                    {"txid", RPCArg::Type::STR_HEX, RPCArg::Optional::NO, "The id of the transaction with the output"},
+                    {"index", RPCArg::Type::NUM, RPCArg::Optional::NO, "The output index"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"txid\": \"hash\",   (string) The id of the spending transaction\n"
+            "  \"index\": n,       (numeric) The index of the spending input\n"
+            "  \"height\": n       (numeric) The height of the block containing the spending transaction\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getspentinfo", "\"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\" 0")
+            + HelpExampleRpc("getspentinfo", "\"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", 0")
+                },
+            }.ToString());
+
+    uint256 txid = ParseHashV(request.params[0], "txid");
+    int n = request.params[1].get_int();
+    if (n < 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid output index");
+    }
+
+    if (!g_spentindex) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Spent index not enabled, restart with -spentindex");
+    }
+    g_spentindex->BlockUntilSyncedToCurrentChain();
+
+    SpentInfo info;
+    if (!g_spentindex->FindSpent(COutPoint(txid, n), info)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unable to get spent info");
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("txid", info.txid.GetHex());
+    result.pushKV("index", (int64_t)info.input_index);
+    result.pushKV("height", info.height);
+    return result;
+}
+// VELES END
+
 static UniValue validateaddress(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -592,6 +946,44 @@ static UniValue RPCLockedMemoryInfo()
     return obj;
 }
 
+// VELES BEGIN
+static UniValue RPCBlockCacheInfo()
+{
+    CBlockReadCache::Stats stats = g_block_read_cache.GetStats();
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("usage", uint64_t(stats.usage));
+    obj.pushKV("limit", uint64_t(stats.limit));
+    obj.pushKV("entries", uint64_t(stats.entries));
+    obj.pushKV("hits", stats.hits);
+    obj.pushKV("misses", stats.misses);
+    obj.pushKV("mapped_files", uint64_t(stats.mapped_files));
+    obj.pushKV("mapped_bytes", uint64_t(stats.mapped_bytes));
+    return obj;
+}
+
+static UniValue RPCValidationCacheInfo(const ValidationCacheStats& stats)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("entries", uint64_t(stats.entries));
+    obj.pushKV("capacity", uint64_t(stats.capacity));
+    obj.pushKV("hits", stats.hits);
+    obj.pushKV("misses", stats.misses);
+    return obj;
+}
+
+static UniValue RPCSubsystemMemoryInfo()
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("masternodes", uint64_t(mnodeman.DynamicMemoryUsage()));
+    obj.pushKV("payments", uint64_t(mnpayments.DynamicMemoryUsage()));
+    obj.pushKV("governance", uint64_t(governance.DynamicMemoryUsage()));
+    obj.pushKV("instantsend", uint64_t(instantsend.DynamicMemoryUsage()));
+    obj.pushKV("sporks", uint64_t(sporkManager.DynamicMemoryUsage()));
+    obj.pushKV("cachelimit", uint64_t(std::max((int64_t)0, gArgs.GetArg("-maxdashcache", DEFAULT_MAX_DASH_CACHE)) << 20));
+    return obj;
+}
+// VELES END
+
 #ifdef HAVE_MALLOC_INFO
 static std::string RPCMallocInfo()
 {
@@ -635,6 +1027,35 @@ static UniValue getmemoryinfo(const JSONRPCRequest& request)
             "    \"locked\": xxxxxx,       (numeric) Amount of bytes that succeeded locking. If this number is smaller than total, locking pages failed at some point and key data could be swapped to disk.\n"
             "    \"chunks_used\": xxxxx,   (numeric) Number allocated chunks\n"
             "    \"chunks_free\": xxxxx,   (numeric) Number unused chunks\n"
+            "  },\n"
+            "  \"blockcache\": {           (json object) Information about the cache of blocks read from disk\n"
+            "    \"usage\": xxxxx,         (numeric) Number of bytes used by cached blocks\n"
+            "    \"limit\": xxxxx,         (numeric) Maximum number of bytes used by cached blocks (-blockreadcache)\n"
+            "    \"entries\": xxxxx,       (numeric) Number of cached blocks\n"
+            "    \"hits\": xxxxx,          (numeric) Number of block reads served from the cache\n"
+            "    \"misses\": xxxxx,        (numeric) Number of block reads from disk\n"
+            "    \"mapped_files\": xxxxx,  (numeric) Number of block files mapped into memory (-blockmmap)\n"
+            "    \"mapped_bytes\": xxxxx,  (numeric) Number of bytes of block files mapped into memory\n"
+            "  },\n"
+            "  \"sigcache\": {             (json object) Information about the cache of verified signatures\n"
+            "    \"entries\": xxxxx,       (numeric) Number of cached signatures\n"
+            "    \"capacity\": xxxxx,      (numeric) Number of signatures the cache has room for\n"
+            "    \"hits\": xxxxx,          (numeric) Number of signatures found in the cache\n"
+            "    \"misses\": xxxxx         (numeric) Number of signatures not found in the cache\n"
+            "  },\n"
+            "  \"scriptcache\": {          (json object) Information about the cache of transactions with verified scripts\n"
+            "    \"entries\": xxxxx,       (numeric) Number of cached transactions\n"
+            "    \"capacity\": xxxxx,      (numeric) Number of transactions the cache has room for\n"
+            "    \"hits\": xxxxx,          (numeric) Number of transactions found in the cache\n"
+            "    \"misses\": xxxxx         (numeric) Number of transactions not found in the cache\n"
+            "  },\n"
+            "  \"subsystems\": {           (json object) Estimated number of bytes used by the masternode subsystems\n"
+            "    \"masternodes\": xxxxx,   (numeric) By the masternode list and the seen masternode messages\n"
+            "    \"payments\": xxxxx,      (numeric) By the masternode payment votes and blocks\n"
+            "    \"governance\": xxxxx,    (numeric) By the governance objects and votes\n"
+            "    \"instantsend\": xxxxx,   (numeric) By the InstantSend lock requests and votes\n"
+            "    \"sporks\": xxxxx,        (numeric) By the sporks\n"
+            "    \"cachelimit\": xxxxx     (numeric) Maximum number of bytes used by each of the seen pings, governance vote caches and orphan InstantSend votes (-maxdashcache)\n"
             "  }\n"
             "}\n"
                     },
@@ -652,6 +1073,12 @@ static UniValue getmemoryinfo(const JSONRPCRequest& request)
     if (mode == "stats") {
         UniValue obj(UniValue::VOBJ);
         obj.pushKV("locked", RPCLockedMemoryInfo());
+        // VELES BEGIN
+        obj.pushKV("blockcache", RPCBlockCacheInfo());
+        obj.pushKV("sigcache", RPCValidationCacheInfo(GetSignatureCacheStats()));
+        obj.pushKV("scriptcache", RPCValidationCacheInfo(GetScriptExecutionCacheStats()));
+        obj.pushKV("subsystems", RPCSubsystemMemoryInfo());
+        // VELES END
         return obj;
     } else if (mode == "mallocinfo") {
 #ifdef HAVE_MALLOC_INFO
@@ -664,6 +1091,284 @@ static UniValue getmemoryinfo(const JSONRPCRequest& request)
     }
 }
 
+// VELES BEGIN
+static UniValue getdbstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 0)
+        throw std::runtime_error(
+            RPCHelpMan{"getdbstats",
+                "Returns the LevelDB settings and statistics of every open database.\n",
+                {},
+                RPCResult{
+            "[\n"
+            "  {\n"
+            "    \"name\": \"xxxx\",             (string) Name of the database directory, as used by -dboption\n"
+            "    \"profile\": {                 (json object) LevelDB settings of the database\n"
+            "      \"block_size\": n,           (numeric) Approximate size of the data per block in bytes\n"
+            "      \"compression\": true|false, (boolean) Whether blocks are compressed\n"
+            "      \"bloom_bits\": n,           (numeric) Bits per key of the bloom filter, 0 if disabled\n"
+            "      \"max_open_files\": n        (numeric) Maximum number of open files, 0 for the default\n"
+            "    },\n"
+            "    \"memory_usage\": n,           (numeric) Approximate memory used by LevelDB in bytes\n"
+            "    \"compaction_time\": n,        (numeric) Seconds spent compacting since the database was opened\n"
+            "    \"levels\": [                  (json array) Levels holding files or compacted into\n"
+            "      {\n"
+            "        \"level\": n,              (numeric) The level\n"
+            "        \"files\": n,              (numeric) Number of files\n"
+            "        \"size_mb\": n,            (numeric) Size of the files in MiB\n"
+            "        \"compaction_time\": n,    (numeric) Seconds spent compacting into the level\n"
+            "        \"read_mb\": n,            (numeric) MiB read by these compactions\n"
+            "        \"write_mb\": n            (numeric) MiB written by these compactions\n"
+            "      }, ...\n"
+            "    ],\n"
+            "    \"stats\": \"xxxx\"             (string) The leveldb.stats property\n"
+            "  }, ...\n"
+            "]\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getdbstats", "")
+            + HelpExampleRpc("getdbstats", "")
+                },
+            }.ToString());
+
+    UniValue result(UniValue::VARR);
+    ForEachDBWrapper([&result](const CDBWrapper& db) {
+        const DBProfile& profile = db.GetProfile();
+        UniValue profileObj(UniValue::VOBJ);
+        profileObj.pushKV("block_size", uint64_t(profile.block_size));
+        profileObj.pushKV("compression", profile.compression);
+        profileObj.pushKV("bloom_bits", profile.bloom_bits);
+        profileObj.pushKV("max_open_files", profile.max_open_files);
+
+        DBStats stats = db.GetStats();
+        UniValue levels(UniValue::VARR);
+        for (const DBStats::Level& level : stats.levels) {
+            UniValue levelObj(UniValue::VOBJ);
+            levelObj.pushKV("level", level.level);
+            levelObj.pushKV("files", level.files);
+            levelObj.pushKV("size_mb", level.size_mb);
+            levelObj.pushKV("compaction_time", level.time);
+            levelObj.pushKV("read_mb", level.read_mb);
+            levelObj.pushKV("write_mb", level.write_mb);
+            levels.push_back(levelObj);
+        }
+
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("name", db.GetName());
+        obj.pushKV("profile", profileObj);
+        obj.pushKV("memory_usage", uint64_t(stats.memory_usage));
+        obj.pushKV("compaction_time", stats.compaction_time);
+        obj.pushKV("levels", levels);
+        obj.pushKV("stats", stats.text);
+        result.push_back(obj);
+    });
+    return result;
+}
+
+static UniValue LockHistogramToJSON(const uint64_t (&histogram)[LOCK_STATS_BUCKETS])
+{
+    int nLast = LOCK_STATS_BUCKETS - 1;
+    while (nLast > 0 && !histogram[nLast]) --nLast;
+    UniValue result(UniValue::VARR);
+    for (int i = 0; i <= nLast; ++i) {
+        result.push_back(histogram[i]);
+    }
+    return result;
+}
+
+static UniValue getlockstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+            RPCHelpMan{"getlockstats",
+                "Returns the contention of every lock site recorded since startup or the last reset, the ones waited for the longest first.\n"
+                "Locks are only recorded when running with -lockstats.\n"
+                "Hold times include the time a condition variable waited with the lock released.\n",
+                {
+                    {"reset", RPCArg::Type::BOOL, /* default */ "false", "Clear the recorded stats after returning them"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"enabled\": true|false,         (boolean) Whether locks are recorded\n"
+            "  \"locks\": [\n"
+            "    {\n"
+            "      \"name\": \"xxxx\",            (string) The lock as named at the LOCK site\n"
+            "      \"file\": \"xxxx\",            (string) Source file of the LOCK site\n"
+            "      \"line\": n,                 (numeric) Source line of the LOCK site\n"
+            "      \"acquisitions\": n,         (numeric) Number of times the lock was taken\n"
+            "      \"contentions\": n,          (numeric) Number of times the lock was held by another thread\n"
+            "      \"wait_us\": n,              (numeric) Total microseconds waited for the lock\n"
+            "      \"wait_max_us\": n,          (numeric) Longest wait in microseconds\n"
+            "      \"hold_us\": n,              (numeric) Total microseconds the lock was held\n"
+            "      \"hold_max_us\": n,          (numeric) Longest hold in microseconds\n"
+            "      \"wait_histogram\": [n,...], (json array) Waits per bucket, bucket 0 counts the waits below 1 microsecond and bucket i the ones from 2^(i-1) up to 2^i\n"
+            "      \"hold_histogram\": [n,...]  (json array) Holds per bucket, as wait_histogram\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getlockstats", "")
+            + HelpExampleCli("getlockstats", "true")
+            + HelpExampleRpc("getlockstats", "")
+                },
+            }.ToString());
+
+    UniValue locks(UniValue::VARR);
+    for (const LockSiteStats& stats : GetLockStats()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("name", stats.name);
+        obj.pushKV("file", stats.file);
+        obj.pushKV("line", stats.line);
+        obj.pushKV("acquisitions", stats.acquisitions);
+        obj.pushKV("contentions", stats.contentions);
+        obj.pushKV("wait_us", stats.wait_micros);
+        obj.pushKV("wait_max_us", stats.wait_max_micros);
+        obj.pushKV("hold_us", stats.hold_micros);
+        obj.pushKV("hold_max_us", stats.hold_max_micros);
+        obj.pushKV("wait_histogram", LockHistogramToJSON(stats.wait_histogram));
+        obj.pushKV("hold_histogram", LockHistogramToJSON(stats.hold_histogram));
+        locks.push_back(obj);
+    }
+    if (!request.params[0].isNull() && request.params[0].get_bool()) {
+        ResetLockStats();
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("enabled", g_lock_stats.load());
+    result.pushKV("locks", locks);
+    return result;
+}
+
+static UniValue dumplockstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+            RPCHelpMan{"dumplockstats",
+                "Writes the lock contention recorded with -lockstats to a text file, as returned by getlockstats.\n",
+                {
+                    {"filename", RPCArg::Type::STR, /* default */ LOCK_STATS_FILENAME, "The file to write, relative paths are taken from the data directory"},
+                },
+                RPCResult{
+            "\"path\"          (string) The absolute path of the file written\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("dumplockstats", "")
+            + HelpExampleRpc("dumplockstats", "\"locks.txt\"")
+                },
+            }.ToString());
+
+    const fs::path path = fs::absolute(request.params[0].isNull() ? LOCK_STATS_FILENAME : request.params[0].get_str(), GetDataDir());
+    if (!DumpLockStats(path.string())) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Unable to write " + path.string());
+    }
+    return path.string();
+}
+
+static UniValue getstartupinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 0)
+        throw std::runtime_error(
+            RPCHelpMan{"getstartupinfo",
+                "Returns where the time of the startup went. The caches read in the background\n"
+                "overlap the phases of the init thread, and may still be loading after it finished.\n",
+                {},
+                RPCResult{
+            "{\n"
+            "  \"finished\": true|false,   (boolean) Whether the init thread finished\n"
+            "  \"total_ms\": n,            (numeric) Milliseconds from the process start to the end of the init, or to now\n"
+            "  \"phases\": [               (json array) The phases, in the order they ended\n"
+            "    {\n"
+            "      \"name\": \"xxxx\",       (string) The phase\n"
+            "      \"start_ms\": n,        (numeric) Milliseconds from the process start to the start of the phase\n"
+            "      \"duration_ms\": n      (numeric) Milliseconds the phase took\n"
+            "    }, ...\n"
+            "  ]\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getstartupinfo", "")
+            + HelpExampleRpc("getstartupinfo", "")
+                },
+            }.ToString());
+
+    UniValue phases(UniValue::VARR);
+    for (const StartupPhase& phase : g_startup_timings.GetPhases()) {
+        UniValue phaseObj(UniValue::VOBJ);
+        phaseObj.pushKV("name", phase.strName);
+        phaseObj.pushKV("start_ms", phase.nStart);
+        phaseObj.pushKV("duration_ms", phase.nDuration);
+        phases.push_back(phaseObj);
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("finished", g_startup_timings.IsFinished());
+    result.pushKV("total_ms", g_startup_timings.GetTotal());
+    result.pushKV("phases", phases);
+    return result;
+}
+
+static void PushIndexSummary(UniValue& result, const IndexSummary& summary, const std::string& index_name)
+{
+    if (!index_name.empty() && index_name != summary.name) return;
+
+    UniValue entry(UniValue::VOBJ);
+    entry.pushKV("synced", summary.synced);
+    entry.pushKV("best_block_height", summary.best_block_height);
+    const double sync_seconds = summary.sync_time_ms * 0.001;
+    entry.pushKV("sync_blocks", summary.sync_blocks);
+    entry.pushKV("sync_transactions", summary.sync_transactions);
+    entry.pushKV("sync_seconds", sync_seconds);
+    entry.pushKV("blocks_per_second", sync_seconds > 0 ? summary.sync_blocks / sync_seconds : 0.0);
+    entry.pushKV("transactions_per_second", sync_seconds > 0 ? summary.sync_transactions / sync_seconds : 0.0);
+    result.pushKV(summary.name, entry);
+}
+
+static UniValue getindexinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+            RPCHelpMan{"getindexinfo",
+                "Returns the status of the enabled indices and the throughput of their background sync.\n",
+                {
+                    {"index_name", RPCArg::Type::STR, /* default */ "all indices", "Filter results for an index with a specific name."},
+                },
+                RPCResult{
+            "{\n"
+            "  \"name\": {                      (json object) The name of the index\n"
+            "    \"synced\": true|false,        (boolean) Whether the index is synced or not\n"
+            "    \"best_block_height\": n,      (numeric) The block height to which the index is synced\n"
+            "    \"sync_blocks\": n,            (numeric) Number of blocks written by the background sync\n"
+            "    \"sync_transactions\": n,      (numeric) Number of transactions of these blocks\n"
+            "    \"sync_seconds\": n,           (numeric) Seconds the background sync took so far\n"
+            "    \"blocks_per_second\": n,      (numeric) Blocks written per second by the background sync\n"
+            "    \"transactions_per_second\": n (numeric) Transactions written per second by the background sync\n"
+            "  }, ...\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getindexinfo", "")
+            + HelpExampleRpc("getindexinfo", "")
+            + HelpExampleCli("getindexinfo", "txindex")
+            + HelpExampleRpc("getindexinfo", "txindex")
+                },
+            }.ToString());
+
+    const std::string index_name = request.params[0].isNull() ? "" : request.params[0].get_str();
+
+    UniValue result(UniValue::VOBJ);
+    if (g_txindex) PushIndexSummary(result, g_txindex->GetSummary(), index_name);
+    if (g_addressindex) PushIndexSummary(result, g_addressindex->GetSummary(), index_name);
+    if (g_spentindex) PushIndexSummary(result, g_spentindex->GetSummary(), index_name);
+    if (g_timestampindex) PushIndexSummary(result, g_timestampindex->GetSummary(), index_name);
+    if (g_coinstatsindex) PushIndexSummary(result, g_coinstatsindex->GetSummary(), index_name);
+    ForEachBlockFilterIndex([&result, &index_name](const BlockFilterIndex& index) {
+        PushIndexSummary(result, index.GetSummary(), index_name);
+    });
+    return result;
+}
+// VELES END
+
 static void EnableOrDisableLogCategories(UniValue cats, bool enable) {
     cats = cats.get_array();
     for (unsigned int i = 0; i < cats.size(); ++i) {
@@ -775,13 +1480,26 @@ static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "getmemoryinfo",          &getmemoryinfo,          {"mode"} },
+    // VELES BEGIN
+    { "control",            "getdbstats",             &getdbstats,             {} },
+    { "control",            "getlockstats",           &getlockstats,           {"reset"} },
+    { "control",            "dumplockstats",          &dumplockstats,          {"filename"} },
+    { "control",            "getstartupinfo",         &getstartupinfo,         {} },
+    { "util",               "getindexinfo",           &getindexinfo,           {"index_name"} },
+    // VELES END
     { "control",            "logging",                &logging,                {"include", "exclude"}},
-    { "util",               "validateaddress",        &validateaddress,        {"address"} },
+    { "util",               "validateaddress",        &validateaddress,        {"address"}, true }, // VELES
     { "util",               "createmultisig",         &createmultisig,         {"nrequired","keys","address_type"} },
     { "util",               "deriveaddresses",        &deriveaddresses,        {"descriptor", "range"} },
     { "util",               "getdescriptorinfo",      &getdescriptorinfo,      {"descriptor"} },
     { "util",               "verifymessage",          &verifymessage,          {"address","signature","message"} },
     { "util",               "signmessagewithprivkey", &signmessagewithprivkey, {"privkey","message"} },
+    // VELES BEGIN
+    { "addressindex",       "getaddressbalance",      &getaddressbalance,      {"addresses"}, true }, // VELES
+    { "addressindex",       "getaddressutxos",        &getaddressutxos,        {"addresses"}, true }, // VELES
+    { "addressindex",       "getaddresstxids",        &getaddresstxids,        {"addresses"}, true }, // VELES
+    { "blockchain",         "getspentinfo",           &getspentinfo,           {"txid","index"}, true }, // VELES
+    // VELES END
 
     /* Not shown in help */
     { "hidden",             "setmocktime",            &setmocktime,            {"timestamp"}},
@@ -793,6 +1511,7 @@ static const CRPCCommand commands[] =
     { "masternode",        "mnsync",                 &mnsync,                 {"status-next-reset"}  },
     { "governance",        "spork",                  &spork,                  {"name", "value"}  },
     //
+    { "masternode",        "getinstantsendstats",    &getinstantsendstats,    {}  }, // VELES
 };
 // clang-format on
 
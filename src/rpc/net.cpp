@@ -103,6 +103,10 @@ static UniValue getpeerinfo(const JSONRPCRequest& request)
             "    \"subver\": \"/Satoshi:0.8.5/\",  (string) The string version\n"
             "    \"inbound\": true|false,     (boolean) Inbound (true) or Outbound (false)\n"
             "    \"addnode\": true|false,     (boolean) Whether connection was due to addnode/-connect or if it was an automatic/inbound connection\n"
+            "    \"masternode\": true|false,  (boolean) Whether this is a masternode link\n"
+            "    \"mnpool_uses\": n,          (numeric) The number of masternode requests served by this link (masternode links only)\n"
+            "    \"mnpool_lastused\": ttt,    (numeric) The time in seconds since epoch (Jan 1 1970 GMT) this link was last used for a masternode request (masternode links only)\n"
+            "    \"mnpool_healthy\": true|false, (boolean) Whether the link is healthy enough to be kept for reuse (masternode links only)\n"
             "    \"startingheight\": n,       (numeric) The starting height (block) of the peer\n"
             "    \"banscore\": n,             (numeric) The ban score\n"
             "    \"synced_headers\": n,       (numeric) The last header we have in common with this peer\n"
@@ -111,6 +115,10 @@ static UniValue getpeerinfo(const JSONRPCRequest& request)
             "       n,                        (numeric) The heights of blocks we're currently asking from this peer\n"
             "       ...\n"
             "    ],\n"
+            "    \"inflight_limit\": n,       (numeric) The number of blocks we may ask from this peer at the same time\n"
+            "    \"block_delivery_us\": n,    (numeric) The average time in microseconds the blocks asked from this peer took to arrive, 0 before the first one\n"
+            "    \"block_announce_us\": n,    (numeric) The average time in microseconds this peer announced new blocks after the first peer, -1 before the first one\n"
+            "    \"cmpct_high_bandwidth\": true|false, (boolean) Whether this peer was asked to send new blocks as compact blocks without announcing them first\n"
             "    \"whitelisted\": true|false, (boolean) Whether the peer is whitelisted\n"
             "    \"minfeefilter\": n,         (numeric) The minimum fee rate for transactions this peer accepts\n"
             "    \"bytessent_per_msg\": {\n"
@@ -119,6 +127,11 @@ static UniValue getpeerinfo(const JSONRPCRequest& request)
             "                               Only known message types can appear as keys in the object.\n"
             "       ...\n"
             "    },\n"
+            "    \"bytessent_per_class\": {   (json object) The total bytes sent by priority class of the messages\n"
+            "       \"high\": n,              (numeric) Blocks, headers, InstantSend and the control messages\n"
+            "       \"tx\": n,                (numeric) Transactions and masternode pings\n"
+            "       \"sync\": n               (numeric) Masternode list, payment and governance sync\n"
+            "    },\n"
             "    \"bytesrecv_per_msg\": {\n"
             "       \"msg\": n,               (numeric) The total bytes received aggregated by message type\n"
             "                               When a message type is not listed in this json object, the bytes received are 0.\n"
@@ -174,6 +187,14 @@ static UniValue getpeerinfo(const JSONRPCRequest& request)
         obj.pushKV("subver", stats.cleanSubVer);
         obj.pushKV("inbound", stats.fInbound);
         obj.pushKV("addnode", stats.m_manual_connection);
+        // VELES BEGIN
+        obj.pushKV("masternode", stats.fMasternode);
+        if (stats.fMasternode) {
+            obj.pushKV("mnpool_uses", stats.nMasternodePoolUses);
+            obj.pushKV("mnpool_lastused", stats.nTimeMasternodePoolUsed);
+            obj.pushKV("mnpool_healthy", stats.fMasternodePoolHealthy);
+        }
+        // VELES END
         obj.pushKV("startingheight", stats.nStartingHeight);
         if (fStateStats) {
             obj.pushKV("banscore", statestats.nMisbehavior);
@@ -184,6 +205,12 @@ static UniValue getpeerinfo(const JSONRPCRequest& request)
                 heights.push_back(height);
             }
             obj.pushKV("inflight", heights);
+            // VELES BEGIN
+            obj.pushKV("inflight_limit", statestats.nBlocksInFlightLimit);
+            obj.pushKV("block_delivery_us", statestats.nBlockDeliveryTime);
+            obj.pushKV("block_announce_us", statestats.nBlockAnnounceLatency);
+            obj.pushKV("cmpct_high_bandwidth", statestats.fHighBandwidthCmpct);
+            // VELES END
         }
         obj.pushKV("whitelisted", stats.fWhitelisted);
         obj.pushKV("minfeefilter", ValueFromAmount(stats.minFeeFilter));
@@ -195,6 +222,14 @@ static UniValue getpeerinfo(const JSONRPCRequest& request)
         }
         obj.pushKV("bytessent_per_msg", sendPerMsgCmd);
 
+        // VELES BEGIN
+        UniValue sendPerClass(UniValue::VOBJ);
+        for (int nClass = 0; nClass < SEND_PRIORITY_COUNT; nClass++) {
+            sendPerClass.pushKV(GetSendPriorityName(nClass), stats.nSendBytesPerClass[nClass]);
+        }
+        obj.pushKV("bytessent_per_class", sendPerClass);
+        // VELES END
+
         UniValue recvPerMsgCmd(UniValue::VOBJ);
         for (const auto& i : stats.mapRecvBytesPerMsgCmd) {
             if (i.second > 0)
@@ -422,6 +457,87 @@ static UniValue getnettotals(const JSONRPCRequest& request)
     return obj;
 }
 
+// VELES BEGIN
+static UniValue MessageProcessingStatsToJSON(const MessageProcessingStats& stats)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("count", stats.nCount);
+    obj.pushKV("total_us", stats.nTotalMicros);
+    obj.pushKV("max_us", stats.nMaxMicros);
+    return obj;
+}
+
+static UniValue getmessagestats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 0)
+        throw std::runtime_error(
+            RPCHelpMan{"getmessagestats",
+                "\nReturns the time spent processing P2P messages since startup, per message command and per\n"
+                "subsystem handler, and the bytes exchanged per command with the currently connected peers.\n",
+                {},
+                RPCResult{
+            "{\n"
+            "  \"commands\": {\n"
+            "    \"msg\": {\n"
+            "      \"count\": n,        (numeric) Number of messages processed\n"
+            "      \"total_us\": n,     (numeric) Total processing time in microseconds\n"
+            "      \"max_us\": n,       (numeric) Longest processing time in microseconds\n"
+            "      \"bytessent\": n,    (numeric) Bytes sent to the connected peers\n"
+            "      \"bytesrecv\": n     (numeric) Bytes received from the connected peers\n"
+            "    },\n"
+            "    ...\n"
+            "  },\n"
+            "  \"handlers\": {\n"
+            "    \"name\": {           (object) Subsystem handler, e.g. mnodeman, governance, instantsend, mnpayments, sporkManager\n"
+            "      \"count\": n,        (numeric) Number of messages passed to the handler\n"
+            "      \"total_us\": n,     (numeric) Total time spent in the handler in microseconds\n"
+            "      \"max_us\": n        (numeric) Longest time spent in the handler in microseconds\n"
+            "    },\n"
+            "    ...\n"
+            "  }\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("getmessagestats", "")
+            + HelpExampleRpc("getmessagestats", "")
+                },
+            }.ToString());
+    if(!g_connman)
+        throw JSONRPCError(RPC_CLIENT_P2P_DISABLED, "Error: Peer-to-peer functionality missing or disabled");
+
+    std::map<std::string, MessageProcessingStats> mapCommands;
+    std::map<std::string, MessageProcessingStats> mapHandlers;
+    GetMessageProcessingStats(mapCommands, mapHandlers);
+
+    std::map<std::string, std::pair<uint64_t, uint64_t> > mapBytes;
+    std::vector<CNodeStats> vstats;
+    g_connman->GetNodeStats(vstats);
+    for (const CNodeStats& stats : vstats) {
+        for (const auto& i : stats.mapSendBytesPerMsgCmd)
+            mapBytes[i.first].first += i.second;
+        for (const auto& i : stats.mapRecvBytesPerMsgCmd)
+            mapBytes[i.first].second += i.second;
+    }
+
+    UniValue commands(UniValue::VOBJ);
+    for (const auto& i : mapCommands) {
+        UniValue obj = MessageProcessingStatsToJSON(i.second);
+        obj.pushKV("bytessent", mapBytes[i.first].first);
+        obj.pushKV("bytesrecv", mapBytes[i.first].second);
+        commands.pushKV(i.first, obj);
+    }
+    UniValue handlers(UniValue::VOBJ);
+    for (const auto& i : mapHandlers) {
+        handlers.pushKV(i.first, MessageProcessingStatsToJSON(i.second));
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("commands", commands);
+    ret.pushKV("handlers", handlers);
+    return ret;
+}
+// VELES END
+
 static UniValue GetNetworksInfo()
 {
     UniValue networks(UniValue::VARR);
@@ -750,6 +866,7 @@ static const CRPCCommand commands[] =
     { "network",            "disconnectnode",         &disconnectnode,         {"address", "nodeid"} },
     { "network",            "getaddednodeinfo",       &getaddednodeinfo,       {"node"} },
     { "network",            "getnettotals",           &getnettotals,           {} },
+    { "network",            "getmessagestats",        &getmessagestats,        {} }, // VELES
     { "network",            "getnetworkinfo",         &getnetworkinfo,         {} },
     { "network",            "setban",                 &setban,                 {"subnet", "command", "bantime", "absolute"} },
     { "network",            "listbanned",             &listbanned,             {} },
@@ -1085,6 +1085,70 @@ static UniValue sendrawtransaction(const JSONRPCRequest& request)
     return txid.GetHex();
 }
 
+// VELES BEGIN
+static UniValue sendrawtransactions(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            RPCHelpMan{"sendrawtransactions",
+                "\nSubmits raw transactions (serialized, hex-encoded) to local node and network, in order.\n"
+                "\nThe scripts of the transactions which do not spend each other are verified in parallel.\n"
+                "A transaction may spend the outputs of the transactions before it in the array.\n"
+                "\nSee sendrawtransaction call.\n",
+                {
+                    {"hexstrings", RPCArg::Type::ARR, RPCArg::Optional::NO, "An array of hex strings of raw transactions.",
+                        {
+                            {"hexstring", RPCArg::Type::STR_HEX, RPCArg::Optional::OMITTED, ""},
+                        },
+                        },
+                    {"allowhighfees", RPCArg::Type::BOOL, /* default */ "false", "Allow high fees"},
+                },
+                RPCResult{
+            "[                   (array) The result for each raw transaction in the input array\n"
+            " {\n"
+            "  \"txid\"           (string) The transaction hash in hex\n"
+            "  \"error\"          (string) The reason the transaction was not sent (only present when it was not)\n"
+            " }\n"
+            "]\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("sendrawtransactions", "'[\"signedhex\",\"signedhex\"]'")
+            + HelpExampleRpc("sendrawtransactions", "[\"signedhex\",\"signedhex\"]")
+                },
+            }.ToString());
+
+    RPCTypeCheck(request.params, {UniValue::VARR, UniValue::VBOOL});
+
+    const UniValue& hexstrings = request.params[0].get_array();
+    std::vector<CTransactionRef> vtx;
+    vtx.reserve(hexstrings.size());
+    for (size_t i = 0; i < hexstrings.size(); i++) {
+        CMutableTransaction mtx;
+        if (!DecodeHexTx(mtx, hexstrings[i].get_str()))
+            throw JSONRPCError(RPC_DESERIALIZATION_ERROR, strprintf("TX decode failed for transaction %u", i));
+        vtx.push_back(MakeTransactionRef(std::move(mtx)));
+    }
+
+    bool allowhighfees = false;
+    if (!request.params[1].isNull()) allowhighfees = request.params[1].get_bool();
+    const CAmount highfee{allowhighfees ? 0 : ::maxTxFee};
+    std::vector<TransactionError> errors;
+    std::vector<std::string> err_strings;
+    BroadcastTransactions(vtx, errors, err_strings, highfee);
+
+    UniValue result(UniValue::VARR);
+    for (size_t i = 0; i < vtx.size(); i++) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("txid", vtx[i]->GetHash().GetHex());
+        if (errors[i] != TransactionError::OK) {
+            entry.pushKV("error", err_strings[i].empty() ? TransactionErrorString(errors[i]) : err_strings[i]);
+        }
+        result.push_back(entry);
+    }
+    return result;
+}
+// VELES END
+
 static UniValue testmempoolaccept(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 1 || request.params.size() > 2) {
@@ -2056,16 +2120,17 @@ UniValue analyzepsbt(const JSONRPCRequest& request)
 static const CRPCCommand commands[] =
 { //  category              name                            actor (function)            argNames
   //  --------------------- ------------------------        -----------------------     ----------
-    { "rawtransactions",    "getrawtransaction",            &getrawtransaction,         {"txid","verbose","blockhash"} },
+    { "rawtransactions",    "getrawtransaction",            &getrawtransaction,         {"txid","verbose","blockhash"}, true }, // VELES
     { "rawtransactions",    "createrawtransaction",         &createrawtransaction,      {"inputs","outputs","locktime","replaceable"} },
-    { "rawtransactions",    "decoderawtransaction",         &decoderawtransaction,      {"hexstring","iswitness"} },
-    { "rawtransactions",    "decodescript",                 &decodescript,              {"hexstring"} },
+    { "rawtransactions",    "decoderawtransaction",         &decoderawtransaction,      {"hexstring","iswitness"}, true }, // VELES
+    { "rawtransactions",    "decodescript",                 &decodescript,              {"hexstring"}, true }, // VELES
     { "rawtransactions",    "sendrawtransaction",           &sendrawtransaction,        {"hexstring","allowhighfees"} },
+    { "rawtransactions",    "sendrawtransactions",          &sendrawtransactions,       {"hexstrings","allowhighfees"} }, // VELES
     { "rawtransactions",    "combinerawtransaction",        &combinerawtransaction,     {"txs"} },
     { "hidden",             "signrawtransaction",           &signrawtransaction,        {"hexstring","prevtxs","privkeys","sighashtype"} },
     { "rawtransactions",    "signrawtransactionwithkey",    &signrawtransactionwithkey, {"hexstring","privkeys","prevtxs","sighashtype"} },
     { "rawtransactions",    "testmempoolaccept",            &testmempoolaccept,         {"rawtxs","allowhighfees"} },
-    { "rawtransactions",    "decodepsbt",                   &decodepsbt,                {"psbt"} },
+    { "rawtransactions",    "decodepsbt",                   &decodepsbt,                {"psbt"}, true }, // VELES
     { "rawtransactions",    "combinepsbt",                  &combinepsbt,               {"txs"} },
     { "rawtransactions",    "finalizepsbt",                 &finalizepsbt,              {"psbt", "extract"} },
     { "rawtransactions",    "createpsbt",                   &createpsbt,                {"inputs","outputs","locktime","replaceable"} },
@@ -2074,8 +2139,8 @@ static const CRPCCommand commands[] =
     { "rawtransactions",    "joinpsbts",                    &joinpsbts,                 {"txs"} },
     { "rawtransactions",    "analyzepsbt",                  &analyzepsbt,               {"psbt"} },
 
-    { "blockchain",         "gettxoutproof",                &gettxoutproof,             {"txids", "blockhash"} },
-    { "blockchain",         "verifytxoutproof",             &verifytxoutproof,          {"proof"} },
+    { "blockchain",         "gettxoutproof",                &gettxoutproof,             {"txids", "blockhash"}, true }, // VELES
+    { "blockchain",         "verifytxoutproof",             &verifytxoutproof,          {"proof"}, true }, // VELES
 };
 // clang-format on
 
@@ -7,6 +7,7 @@
 #include <rpc/server.h>
 
 #include <fs.h>
+#include <httpserver.h> // VELES
 #include <key_io.h>
 #include <random.h>
 #include <rpc/util.h>
@@ -22,6 +23,14 @@
 
 #include <memory> // for unique_ptr
 #include <unordered_map>
+// VELES BEGIN
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <thread>
+// VELES END
 
 static CCriticalSection cs_rpcWarmup;
 static std::atomic<bool> g_rpc_running{false};
@@ -38,26 +47,105 @@ struct RPCCommandExecutionInfo
     int64_t start;
 };
 
+// VELES BEGIN
+/** Latency buckets of the RPC method stats, bucket n holds the calls of less than 2^n microseconds */
+static const int RPC_STATS_BUCKETS = 28;
+
+/** Completed calls of one method */
+struct RPCMethodStats
+{
+    uint64_t calls = 0;
+    uint64_t errors = 0;
+    int64_t total_micros = 0;
+    int64_t max_micros = 0;
+    int64_t cs_main_wait_micros = 0;
+    uint64_t histogram[RPC_STATS_BUCKETS] = {};
+
+    /** Upper bound of the bucket holding the fraction of the calls, a power of two microseconds */
+    int64_t Percentile(double fraction) const
+    {
+        const uint64_t nRank = std::max<uint64_t>(1, (uint64_t)std::ceil(fraction * calls));
+        uint64_t nCount = 0;
+        for (int i = 0; i < RPC_STATS_BUCKETS; ++i) {
+            nCount += histogram[i];
+            if (nCount >= nRank) return std::min<int64_t>(int64_t{1} << i, max_micros);
+        }
+        return max_micros;
+    }
+};
+
+/** Calls taking at least this long are logged with the sizes of their parameters, 0 to log none */
+static std::atomic<int64_t> g_rpc_slow_log_micros{0};
+// VELES END
+
 struct RPCServerInfo
 {
     Mutex mutex;
     std::list<RPCCommandExecutionInfo> active_commands GUARDED_BY(mutex);
+    std::map<std::string, RPCMethodStats> method_stats GUARDED_BY(mutex); // VELES
 };
 
 static RPCServerInfo g_rpc_server_info;
 
+// VELES BEGIN
+/** Sizes of the serialized parameters of a request, for the slow call log */
+static std::string ParamSizes(const UniValue& params)
+{
+    std::string strSizes;
+    if (params.isObject()) {
+        const std::vector<std::string>& keys = params.getKeys();
+        const std::vector<UniValue>& values = params.getValues();
+        for (size_t i = 0; i < keys.size(); ++i) {
+            strSizes += strprintf("%s%s=%u", i ? " " : "", keys[i], values[i].write().size());
+        }
+    } else if (params.isArray()) {
+        for (size_t i = 0; i < params.size(); ++i) {
+            strSizes += strprintf("%s%u", i ? " " : "", params[i].write().size());
+        }
+    }
+    return strSizes.empty() ? "none" : strSizes;
+}
+// VELES END
+
 struct RPCCommandExecution
 {
     std::list<RPCCommandExecutionInfo>::iterator it;
-    explicit RPCCommandExecution(const std::string& method)
+    // VELES BEGIN
+    const JSONRPCRequest& request;
+    const int64_t start;
+    MainLockWaitCounter main_lock_wait;
+    bool succeeded = false;
+    //explicit RPCCommandExecution(const std::string& method)
+    explicit RPCCommandExecution(const JSONRPCRequest& requestIn) : request(requestIn), start(GetTimeMicros())
+    // VELES END
     {
         LOCK(g_rpc_server_info.mutex);
-        it = g_rpc_server_info.active_commands.insert(g_rpc_server_info.active_commands.end(), {method, GetTimeMicros()});
+        it = g_rpc_server_info.active_commands.insert(g_rpc_server_info.active_commands.end(), {request.strMethod, start}); // VELES
     }
     ~RPCCommandExecution()
     {
+        // VELES BEGIN
+        const int64_t nMicros = std::max<int64_t>(GetTimeMicros() - start, 0);
+        const int64_t nWaitMicros = main_lock_wait.Micros();
+        const int64_t nSlowMicros = g_rpc_slow_log_micros.load();
+        if (nSlowMicros > 0 && nMicros >= nSlowMicros) {
+            LogPrintf("Slow RPC call %s: %dms, %dms waiting for cs_main, %s, parameter sizes: %s\n", request.strMethod,
+                nMicros / 1000, nWaitMicros / 1000, succeeded ? "succeeded" : "failed", ParamSizes(request.params));
+        }
+        int nBucket = 0;
+        while (nBucket < RPC_STATS_BUCKETS - 1 && (int64_t{1} << nBucket) <= nMicros) ++nBucket;
+        // VELES END
         LOCK(g_rpc_server_info.mutex);
         g_rpc_server_info.active_commands.erase(it);
+        // VELES BEGIN
+        RPCMethodStats& stats = g_rpc_server_info.method_stats[request.strMethod];
+        ++stats.calls;
+        if (!succeeded) ++stats.errors;
+        stats.total_micros += nMicros;
+        stats.max_micros = std::max(stats.max_micros, nMicros);
+        stats.cs_main_wait_micros += nWaitMicros;
+        ++stats.histogram[nBucket];
+        // VELES END
     }
 };
 
@@ -305,6 +393,41 @@ static UniValue getrpcinfo(const JSONRPCRequest& request)
             "    \"method\"       (string)  The name of the RPC command \n"
             "    \"duration\"     (numeric)  The running time in microseconds\n"
             "   },...\n"
+            "  ],\n"
+            " \"work_queues\" (array) The HTTP work queues, one per class of endpoints\n"
+            "  [\n"
+            "   {\n"
+            "    \"name\"           (string)  The class of endpoints, rpc or rest\n"
+            "    \"threads\"        (numeric) The number of worker threads\n"
+            "    \"depth\"          (numeric) The number of requests waiting for a worker\n"
+            "    \"max_depth\"      (numeric) The depth beyond which requests are rejected\n"
+            "    \"peak_depth\"     (numeric) The largest depth so far\n"
+            "    \"processed\"      (numeric) The number of requests handed to a worker\n"
+            "    \"rejected\"       (numeric) The number of requests rejected as the queue was full\n"
+            "    \"wait_avg\"       (numeric) The average time requests waited for a worker, in microseconds\n"
+            "    \"wait_max\"       (numeric) The longest time a request waited for a worker, in microseconds\n"
+            "   },...\n"
+            "  ],\n"
+            " \"connections\" (object) The HTTP connections\n"
+            "  {\n"
+            "   \"total\"           (numeric) The number of connections accepted\n"
+            "   \"open\"            (numeric) The number of connections open now\n"
+            "   \"requests\"        (numeric) The number of requests received\n"
+            "   \"reused\"          (numeric) The number of requests received on a connection kept alive\n"
+            "  },\n"
+            " \"methods\" (array) The completed calls of each command, the longest running in total first\n"
+            "  [\n"
+            "   {\n"
+            "    \"method\"         (string)  The name of the RPC command\n"
+            "    \"calls\"          (numeric) The number of calls\n"
+            "    \"errors\"         (numeric) The number of calls that returned an error\n"
+            "    \"total\"          (numeric) The running time of all calls, in microseconds\n"
+            "    \"p50\"            (numeric) The median running time, rounded up to a power of two microseconds\n"
+            "    \"p90\"            (numeric) The 90th percentile of the running time, likewise\n"
+            "    \"p99\"            (numeric) The 99th percentile of the running time, likewise\n"
+            "    \"max\"            (numeric) The longest running time, in microseconds\n"
+            "    \"cs_main_wait\"   (numeric) The time all calls waited for the main lock, in microseconds\n"
+            "   },...\n"
             "  ]\n"
             "}\n"
                 },
@@ -327,6 +450,53 @@ static UniValue getrpcinfo(const JSONRPCRequest& request)
     UniValue result(UniValue::VOBJ);
     result.pushKV("active_commands", active_commands);
 
+    // VELES BEGIN
+    UniValue work_queues(UniValue::VARR);
+    for (const HTTPWorkQueueStats& stats : GetHTTPWorkQueueStats()) {
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("name", stats.name);
+        entry.pushKV("threads", stats.nThreads);
+        entry.pushKV("depth", (uint64_t)stats.nDepth);
+        entry.pushKV("max_depth", (uint64_t)stats.nMaxDepth);
+        entry.pushKV("peak_depth", (uint64_t)stats.nPeakDepth);
+        entry.pushKV("processed", stats.nProcessed);
+        entry.pushKV("rejected", stats.nRejected);
+        entry.pushKV("wait_avg", stats.nProcessed ? stats.nWaitMicrosTotal / (int64_t)stats.nProcessed : 0);
+        entry.pushKV("wait_max", stats.nWaitMicrosMax);
+        work_queues.push_back(entry);
+    }
+    result.pushKV("work_queues", work_queues);
+
+    const HTTPConnectionStats connStats = GetHTTPConnectionStats();
+    UniValue connections(UniValue::VOBJ);
+    connections.pushKV("total", connStats.nConnections);
+    connections.pushKV("open", connStats.nOpen);
+    connections.pushKV("requests", connStats.nRequests);
+    connections.pushKV("reused", connStats.nReused);
+    result.pushKV("connections", connections);
+
+    std::vector<std::pair<std::string, RPCMethodStats>> vMethodStats(g_rpc_server_info.method_stats.begin(), g_rpc_server_info.method_stats.end());
+    std::sort(vMethodStats.begin(), vMethodStats.end(), [](const std::pair<std::string, RPCMethodStats>& a, const std::pair<std::string, RPCMethodStats>& b) {
+        return a.second.total_micros > b.second.total_micros;
+    });
+    UniValue methods(UniValue::VARR);
+    for (const auto& method : vMethodStats) {
+        const RPCMethodStats& stats = method.second;
+        UniValue entry(UniValue::VOBJ);
+        entry.pushKV("method", method.first);
+        entry.pushKV("calls", stats.calls);
+        entry.pushKV("errors", stats.errors);
+        entry.pushKV("total", stats.total_micros);
+        entry.pushKV("p50", stats.Percentile(0.5));
+        entry.pushKV("p90", stats.Percentile(0.9));
+        entry.pushKV("p99", stats.Percentile(0.99));
+        entry.pushKV("max", stats.max_micros);
+        entry.pushKV("cs_main_wait", stats.cs_main_wait_micros);
+        methods.push_back(entry);
+    }
+    result.pushKV("methods", methods);
+    // VELES END
+
     return result;
 }
 
@@ -376,10 +546,86 @@ bool CRPCTable::appendCommand(const std::string& name, const CRPCCommand* pcmd)
     return true;
 }
 
+// VELES BEGIN
+/**
+ * Threads shared by all batches to run their parallel commands. The thread that received a
+ * batch runs its elements too, so a batch completes even when the pool is busy or stopped.
+ */
+class RPCBatchExecutor
+{
+private:
+    Mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<std::function<void()>> m_queue GUARDED_BY(m_mutex);
+    bool m_stop GUARDED_BY(m_mutex) = false;
+    std::vector<std::thread> m_threads;
+
+    void Run()
+    {
+        RenameThread("veles-rpcbatch");
+        while (true) {
+            std::function<void()> task;
+            {
+                WAIT_LOCK(m_mutex, lock);
+                m_cond.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+                if (m_queue.empty()) return;
+                task = std::move(m_queue.front());
+                m_queue.pop_front();
+            }
+            task();
+        }
+    }
+
+public:
+    void Start(int nThreads)
+    {
+        {
+            LOCK(m_mutex);
+            m_stop = false;
+        }
+        for (int i = 0; i < nThreads; ++i) {
+            m_threads.emplace_back(&RPCBatchExecutor::Run, this);
+        }
+    }
+
+    void Stop()
+    {
+        {
+            LOCK(m_mutex);
+            m_stop = true;
+        }
+        m_cond.notify_all();
+        for (std::thread& thread : m_threads) {
+            thread.join();
+        }
+        m_threads.clear();
+    }
+
+    size_t Threads() const { return m_threads.size(); }
+
+    void Post(std::function<void()> task)
+    {
+        {
+            LOCK(m_mutex);
+            if (m_stop) return;
+            m_queue.push_back(std::move(task));
+        }
+        m_cond.notify_one();
+    }
+};
+
+static RPCBatchExecutor g_rpc_batch_executor;
+// VELES END
+
 void StartRPC()
 {
     LogPrint(BCLog::RPC, "Starting RPC\n");
     g_rpc_running = true;
+    // VELES BEGIN
+    const int nBatchThreads = std::min<int64_t>(std::max<int64_t>(gArgs.GetArg("-rpcbatchthreads", DEFAULT_RPC_BATCH_THREADS), 0), MAX_RPC_BATCH_THREADS);
+    g_rpc_batch_executor.Start(nBatchThreads);
+    g_rpc_slow_log_micros = std::max<int64_t>(gArgs.GetArg("-rpcslowlog", DEFAULT_RPC_SLOW_LOG), 0) * 1000;
+    // VELES END
     g_rpcSignals.Started();
 }
 
@@ -393,6 +639,7 @@ void InterruptRPC()
 void StopRPC()
 {
     LogPrint(BCLog::RPC, "Stopping RPC\n");
+    g_rpc_batch_executor.Stop(); // VELES
     deadlineTimers.clear();
     DeleteAuthCookie();
     g_rpcSignals.Stopped();
@@ -487,11 +734,88 @@ static UniValue JSONRPCExecOne(JSONRPCRequest jreq, const UniValue& req)
     return rpc_result;
 }
 
+// VELES BEGIN
+static bool IsParallelRPC(const UniValue& req)
+{
+    if (!req.isObject()) return false;
+    const UniValue& method = find_value(req.get_obj(), "method");
+    if (!method.isStr()) return false;
+    const CRPCCommand* pcmd = tableRPC[method.get_str()];
+    return pcmd && pcmd->parallel;
+}
+
+/** A run of parallel batch elements, taken one at a time by the threads working on it */
+struct RPCBatchRun
+{
+    const JSONRPCRequest* jreq;
+    const UniValue* vReq;
+    std::vector<UniValue>* vResults;
+    size_t nEnd;
+    std::atomic<size_t> nNext;
+    std::atomic<size_t> nDone{0};
+    Mutex mutex;
+    std::condition_variable cond;
+
+    /** Run elements until none are left. The elements are only touched once taken, so late helpers do nothing. */
+    void Work()
+    {
+        size_t nRan = 0;
+        for (size_t i = nNext++; i < nEnd; i = nNext++) {
+            (*vResults)[i] = JSONRPCExecOne(*jreq, (*vReq)[i]);
+            ++nRan;
+        }
+        if (nRan) {
+            LOCK(mutex);
+            nDone += nRan;
+            cond.notify_all();
+        }
+    }
+};
+// VELES END
+
 std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq)
 {
+    // VELES BEGIN
+    //UniValue ret(UniValue::VARR);
+    //for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
+    //    ret.push_back(JSONRPCExecOne(jreq, vReq[reqIdx]));
+    // Runs of parallel commands are spread over the batch executor, the other commands run in
+    // order on this thread and separate the runs, so calls with side effects keep their order
+    std::vector<UniValue> vResults(vReq.size());
+    size_t nIdx = 0;
+    while (nIdx < vReq.size()) {
+        size_t nEnd = nIdx;
+        while (nEnd < vReq.size() && IsParallelRPC(vReq[nEnd])) ++nEnd;
+        if (nEnd - nIdx < 2 || g_rpc_batch_executor.Threads() == 0) {
+            for (nEnd = std::max(nEnd, nIdx + 1); nIdx < nEnd; ++nIdx) {
+                vResults[nIdx] = JSONRPCExecOne(jreq, vReq[nIdx]);
+            }
+            continue;
+        }
+
+        std::shared_ptr<RPCBatchRun> run = std::make_shared<RPCBatchRun>();
+        run->jreq = &jreq;
+        run->vReq = &vReq;
+        run->vResults = &vResults;
+        run->nEnd = nEnd;
+        run->nNext = nIdx;
+        const size_t nHelpers = std::min(g_rpc_batch_executor.Threads(), nEnd - nIdx - 1);
+        for (size_t i = 0; i < nHelpers; ++i) {
+            g_rpc_batch_executor.Post([run] { run->Work(); });
+        }
+        run->Work();
+        {
+            WAIT_LOCK(run->mutex, lock);
+            run->cond.wait(lock, [&] { return run->nDone == nEnd - nIdx; });
+        }
+        nIdx = nEnd;
+    }
+
     UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(jreq, vReq[reqIdx]));
+    for (UniValue& result : vResults) {
+        ret.push_back(std::move(result));
+    }
+    // VELES END
 
     return ret.write() + "\n";
 }
@@ -562,19 +886,55 @@ UniValue CRPCTable::execute(const JSONRPCRequest &request) const
 
     try
     {
-        RPCCommandExecution execution(request.strMethod);
+        // VELES BEGIN
+        //RPCCommandExecution execution(request.strMethod);
+        //// Execute, convert arguments to array if necessary
+        //if (request.params.isObject()) {
+        //    return pcmd->actor(transformNamedArguments(request, pcmd->argNames));
+        //} else {
+        //    return pcmd->actor(request);
+        //}
+        RPCCommandExecution execution(request);
         // Execute, convert arguments to array if necessary
-        if (request.params.isObject()) {
-            return pcmd->actor(transformNamedArguments(request, pcmd->argNames));
-        } else {
-            return pcmd->actor(request);
-        }
+        UniValue result = request.params.isObject() ? pcmd->actor(transformNamedArguments(request, pcmd->argNames)) : pcmd->actor(request);
+        execution.succeeded = true;
+        return result;
+        // VELES END
+    }
+    catch (const std::exception& e)
+    {
+        throw JSONRPCError(RPC_MISC_ERROR, e.what());
+    }
+}
+
+// VELES BEGIN
+bool CRPCTable::executeStream(const JSONRPCRequest &request, JSONStreamWriter& writer) const
+{
+    {
+        LOCK(cs_rpcWarmup);
+        if (fRPCInWarmup)
+            throw JSONRPCError(RPC_IN_WARMUP, rpcWarmupStatus);
+    }
+
+    const CRPCCommand *pcmd = tableRPC[request.strMethod];
+    if (!pcmd)
+        throw JSONRPCError(RPC_METHOD_NOT_FOUND, "Method not found");
+    if (!pcmd->streamActor)
+        return false;
+
+    try
+    {
+        RPCCommandExecution execution(request);
+        const bool fStreamed = request.params.isObject() ? pcmd->streamActor(transformNamedArguments(request, pcmd->argNames), writer) : pcmd->streamActor(request, writer);
+        execution.succeeded = true;
+        return fStreamed;
     }
     catch (const std::exception& e)
     {
         throw JSONRPCError(RPC_MISC_ERROR, e.what());
     }
 }
+// VELES END
 
 std::vector<std::string> CRPCTable::listCommands() const
 {
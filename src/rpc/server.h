@@ -127,6 +127,15 @@ void RPCUnsetTimerInterface(RPCTimerInterface *iface);
 void RPCRunLater(const std::string& name, std::function<void()> func, int64_t nSeconds);
 
 typedef UniValue(*rpcfn_type)(const JSONRPCRequest& jsonRequest);
+// VELES BEGIN
+class JSONStreamWriter;
+/**
+ * Writes the result of a call to the writer as it is produced, for the calls with the largest
+ * results. Returns false without writing anything to leave the call to the actor, and throws
+ * like the actor as long as nothing was written.
+ */
+typedef bool(*rpcstreamfn_type)(const JSONRPCRequest& jsonRequest, JSONStreamWriter& writer);
+// VELES END
 
 class CRPCCommand
 {
@@ -135,6 +144,13 @@ public:
     std::string name;
     rpcfn_type actor;
     std::vector<std::string> argNames;
+    // VELES BEGIN
+    //! Whether the command only reads state, so batches may run it concurrently with the calls
+    //! around it. Left out of the command tables, it is false.
+    bool parallel;
+    //! Streams the result instead of the actor, when set
+    rpcstreamfn_type streamActor;
+    // VELES END
 };
 
 /**
@@ -157,6 +173,15 @@ public:
      */
     UniValue execute(const JSONRPCRequest &request) const;
 
+    // VELES BEGIN
+    /**
+     * Execute a method that streams its result to writer.
+     * @returns false, with nothing written, when the method does not stream this request.
+     * @throws an exception (UniValue) when an error happens.
+     */
+    bool executeStream(const JSONRPCRequest &request, JSONStreamWriter& writer) const;
+    // VELES END
+
     /**
     * Returns a list of registered commands
     * @returns List of registered commands.
@@ -198,6 +223,14 @@ extern CAmount AmountFromValue(const UniValue& value);
 extern std::string HelpExampleCli(const std::string& methodname, const std::string& args);
 extern std::string HelpExampleRpc(const std::string& methodname, const std::string& args);
 
+// VELES BEGIN
+/** Threads running the parallel commands of batches, besides the HTTP worker that received the batch */
+static const int DEFAULT_RPC_BATCH_THREADS = 4;
+static const int MAX_RPC_BATCH_THREADS = 64;
+/** Milliseconds from which RPC calls are logged as slow, 0 to log none */
+static const int64_t DEFAULT_RPC_SLOW_LOG = 0;
+// VELES END
+
 void StartRPC();
 void InterruptRPC();
 void StopRPC();
@@ -10,7 +10,7 @@
 #include <assert.h>
 #include <utility>
 
-CScheduler::CScheduler() : nThreadsServicingQueue(0), stopRequested(false), stopWhenEmpty(false)
+CScheduler::CScheduler() : nThreadsServicingQueue(0), stopRequested(false), stopWhenEmpty(false), nBackgroundRunning(0) // VELES
 {
 }
 
@@ -33,47 +33,69 @@ void CScheduler::serviceQueue()
 {
     boost::unique_lock<boost::mutex> lock(newTaskMutex);
     ++nThreadsServicingQueue;
+    // VELES BEGIN
+    // A background task may run on the thread now
+    newTaskScheduled.notify_all();
+    // VELES END
 
     // newTaskMutex is locked throughout this loop EXCEPT
     // when the thread is waiting or when the user's function
     // is called.
     while (!shouldStop()) {
+        bool fBackground = false; // VELES
         try {
-            if (!shouldStop() && taskQueue.empty()) {
+            // VELES BEGIN
+            //if (!shouldStop() && taskQueue.empty()) {
+            if (!shouldStop() && empty()) {
+            // VELES END
                 reverse_lock<boost::unique_lock<boost::mutex> > rlock(lock);
                 // Use this chance to get more entropy
                 RandAddSeedSleep();
             }
-            while (!shouldStop() && taskQueue.empty()) {
-                // Wait until there is something to do.
-                newTaskScheduled.wait(lock);
+            // VELES BEGIN
+            //while (!shouldStop() && taskQueue.empty()) {
+            //    // Wait until there is something to do.
+            //    newTaskScheduled.wait(lock);
+            //}
+            // Take the first due task of the highest priority, otherwise wait until
+            // the time of the first task that may run on this thread or a new task.
+            const boost::chrono::system_clock::time_point now = boost::chrono::system_clock::now();
+            int nPriority = -1;
+            boost::chrono::system_clock::time_point timeFirst = boost::chrono::system_clock::time_point::max();
+            for (int i = 0; i < NUM_PRIORITIES; i++) {
+                if (taskQueue[i].empty() || (i == PRIORITY_BACKGROUND && !canRunBackground()))
+                    continue;
+                if (taskQueue[i].begin()->first <= now) {
+                    nPriority = i;
+                    break;
+                }
+                timeFirst = std::min(timeFirst, taskQueue[i].begin()->first);
             }
-
-            // Wait until either there is a new task, or until
-            // the time of the first item on the queue:
-
+            if (nPriority < 0) {
+                if (shouldStop())
+                    continue;
+                if (timeFirst == boost::chrono::system_clock::time_point::max()) {
+                    // Wait until there is something to do.
+                    newTaskScheduled.wait(lock);
+                } else {
 // wait_until needs boost 1.50 or later; older versions have timed_wait:
 #if BOOST_VERSION < 105000
-            while (!shouldStop() && !taskQueue.empty() &&
-                   newTaskScheduled.timed_wait(lock, toPosixTime(taskQueue.begin()->first))) {
-                // Keep waiting until timeout
-            }
+                    newTaskScheduled.timed_wait(lock, toPosixTime(timeFirst));
 #else
-            // Some boost versions have a conflicting overload of wait_until that returns void.
-            // Explicitly use a template here to avoid hitting that overload.
-            while (!shouldStop() && !taskQueue.empty()) {
-                boost::chrono::system_clock::time_point timeToWaitFor = taskQueue.begin()->first;
-                if (newTaskScheduled.wait_until<>(lock, timeToWaitFor) == boost::cv_status::timeout)
-                    break; // Exit loop after timeout, it means we reached the time of the event
-            }
+                    // Some boost versions have a conflicting overload of wait_until that returns void.
+                    // Explicitly use a template here to avoid hitting that overload.
+                    newTaskScheduled.wait_until<>(lock, timeFirst);
 #endif
-            // If there are multiple threads, the queue can empty while we're waiting (another
-            // thread may service the task we were waiting on).
-            if (shouldStop() || taskQueue.empty())
+                }
                 continue;
+            }
 
-            Function f = taskQueue.begin()->second;
-            taskQueue.erase(taskQueue.begin());
+            Function f = taskQueue[nPriority].begin()->second;
+            taskQueue[nPriority].erase(taskQueue[nPriority].begin());
+            fBackground = nPriority == PRIORITY_BACKGROUND;
+            if (fBackground)
+                ++nBackgroundRunning;
+            // VELES END
 
             {
                 // Unlock before calling f, so it can reschedule itself or another task
@@ -81,7 +103,15 @@ void CScheduler::serviceQueue()
                 reverse_lock<boost::unique_lock<boost::mutex> > rlock(lock);
                 f();
             }
+            // VELES BEGIN
+            if (fBackground) {
+                --nBackgroundRunning;
+                // Another background task may be waiting for the thread
+                newTaskScheduled.notify_all();
+            }
+            // VELES END
         } catch (...) {
+            if (fBackground) --nBackgroundRunning; // VELES
             --nThreadsServicingQueue;
             throw;
         }
@@ -102,42 +132,72 @@ void CScheduler::stop(bool drain)
     newTaskScheduled.notify_all();
 }
 
-void CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t)
+// VELES BEGIN
+//void CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t)
+void CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t, Priority priority)
 {
     {
         boost::unique_lock<boost::mutex> lock(newTaskMutex);
-        taskQueue.insert(std::make_pair(t, f));
+        //taskQueue.insert(std::make_pair(t, f));
+        taskQueue[priority].insert(std::make_pair(t, f));
     }
-    newTaskScheduled.notify_one();
+    //newTaskScheduled.notify_one();
+    // The thread woken up may not be allowed to run a background task
+    newTaskScheduled.notify_all();
 }
 
-void CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaMilliSeconds)
+//void CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaMilliSeconds)
+void CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaMilliSeconds, Priority priority)
 {
-    schedule(f, boost::chrono::system_clock::now() + boost::chrono::milliseconds(deltaMilliSeconds));
+    //schedule(f, boost::chrono::system_clock::now() + boost::chrono::milliseconds(deltaMilliSeconds));
+    schedule(f, boost::chrono::system_clock::now() + boost::chrono::milliseconds(deltaMilliSeconds), priority);
 }
 
-static void Repeat(CScheduler* s, CScheduler::Function f, int64_t deltaMilliSeconds)
+//static void Repeat(CScheduler* s, CScheduler::Function f, int64_t deltaMilliSeconds)
+static void Repeat(CScheduler* s, CScheduler::Function f, int64_t deltaMilliSeconds, CScheduler::Priority priority)
 {
     f();
-    s->scheduleFromNow(std::bind(&Repeat, s, f, deltaMilliSeconds), deltaMilliSeconds);
+    //s->scheduleFromNow(std::bind(&Repeat, s, f, deltaMilliSeconds), deltaMilliSeconds);
+    s->scheduleFromNow(std::bind(&Repeat, s, f, deltaMilliSeconds, priority), deltaMilliSeconds, priority);
 }
 
-void CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaMilliSeconds)
+//void CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaMilliSeconds)
+void CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaMilliSeconds, Priority priority)
 {
-    scheduleFromNow(std::bind(&Repeat, this, f, deltaMilliSeconds), deltaMilliSeconds);
+    //scheduleFromNow(std::bind(&Repeat, this, f, deltaMilliSeconds), deltaMilliSeconds);
+    scheduleFromNow(std::bind(&Repeat, this, f, deltaMilliSeconds, priority), deltaMilliSeconds, priority);
+}
+
+bool CScheduler::empty() const
+{
+    for (int i = 0; i < NUM_PRIORITIES; i++)
+        if (!taskQueue[i].empty())
+            return false;
+    return true;
 }
 
 size_t CScheduler::getQueueInfo(boost::chrono::system_clock::time_point &first,
                              boost::chrono::system_clock::time_point &last) const
 {
     boost::unique_lock<boost::mutex> lock(newTaskMutex);
-    size_t result = taskQueue.size();
-    if (!taskQueue.empty()) {
-        first = taskQueue.begin()->first;
-        last = taskQueue.rbegin()->first;
+    //size_t result = taskQueue.size();
+    //if (!taskQueue.empty()) {
+    //    first = taskQueue.begin()->first;
+    //    last = taskQueue.rbegin()->first;
+    //}
+    size_t result = 0;
+    for (int i = 0; i < NUM_PRIORITIES; i++) {
+        if (taskQueue[i].empty())
+            continue;
+        if (result == 0 || taskQueue[i].begin()->first < first)
+            first = taskQueue[i].begin()->first;
+        if (result == 0 || taskQueue[i].rbegin()->first > last)
+            last = taskQueue[i].rbegin()->first;
+        result += taskQueue[i].size();
     }
     return result;
 }
+// VELES END
 
 bool CScheduler::AreThreadsServicingQueue() const {
     boost::unique_lock<boost::mutex> lock(newTaskMutex);
@@ -168,6 +228,7 @@ void SingleThreadedSchedulerClient::ProcessQueue() {
         callback = std::move(m_callbacks_pending.front());
         m_callbacks_pending.pop_front();
     }
+    m_callbacks_taken.notify_all(); // VELES
 
     // RAII the setting of fCallbacksRunning and calling MaybeScheduleProcessQueue
     // to ensure both happen safely even if callback() throws.
@@ -192,6 +253,7 @@ void SingleThreadedSchedulerClient::AddToProcessQueue(std::function<void ()> fun
     {
         LOCK(m_cs_callbacks_pending);
         m_callbacks_pending.emplace_back(std::move(func));
+        m_callbacks_pending_peak = std::max(m_callbacks_pending_peak, m_callbacks_pending.size()); // VELES
     }
     MaybeScheduleProcessQueue();
 }
@@ -210,3 +272,108 @@ size_t SingleThreadedSchedulerClient::CallbacksPending() {
     LOCK(m_cs_callbacks_pending);
     return m_callbacks_pending.size();
 }
+
+// VELES BEGIN
+void SingleThreadedSchedulerClient::WaitForCallbacksPending(size_t nMax) {
+    WAIT_LOCK(m_cs_callbacks_pending, lock);
+    while (m_callbacks_pending.size() > nMax) {
+        m_callbacks_taken.wait(lock);
+    }
+}
+
+size_t SingleThreadedSchedulerClient::CallbacksPendingPeak() {
+    LOCK(m_cs_callbacks_pending);
+    return m_callbacks_pending_peak;
+}
+
+void SingleThreadedSchedulerClient::ResetCallbacksPendingPeak() {
+    LOCK(m_cs_callbacks_pending);
+    m_callbacks_pending_peak = m_callbacks_pending.size();
+}
+
+size_t CSchedulerTaskGroup::Add(std::function<void ()> func, const std::vector<size_t>& dependencies)
+{
+    LOCK(m_state->mutex);
+    const size_t nTask = m_state->tasks.size();
+    m_state->tasks.emplace_back();
+    m_state->tasks.back().func = std::move(func);
+    m_state->tasks.back().remaining = dependencies.size();
+    for (size_t nDependency : dependencies) {
+        assert(nDependency < nTask);
+        m_state->tasks[nDependency].dependents.push_back(nTask);
+    }
+    return nTask;
+}
+
+void CSchedulerTaskGroup::Schedule(CScheduler *pscheduler, const std::shared_ptr<State>& state, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        pscheduler->schedule([pscheduler, state] { RunReady(pscheduler, state); });
+    }
+}
+
+bool CSchedulerTaskGroup::RunReady(CScheduler *pscheduler, const std::shared_ptr<State>& state)
+{
+    size_t nTask;
+    std::function<void ()> func;
+    {
+        LOCK(state->mutex);
+        if (state->ready.empty()) return false;
+        nTask = state->ready.front();
+        state->ready.pop_front();
+        func = std::move(state->tasks[nTask].func);
+    }
+
+    func();
+
+    size_t nReady = 0;
+    {
+        LOCK(state->mutex);
+        for (size_t nDependent : state->tasks[nTask].dependents) {
+            if (--state->tasks[nDependent].remaining == 0) {
+                state->ready.push_back(nDependent);
+                ++nReady;
+            }
+        }
+        ++state->done;
+    }
+    state->cond.notify_all();
+    Schedule(pscheduler, state, nReady);
+    return true;
+}
+
+void CSchedulerTaskGroup::Run()
+{
+    if (!m_pscheduler) {
+        std::vector<Task> tasks;
+        {
+            LOCK(m_state->mutex);
+            tasks.swap(m_state->tasks);
+        }
+        for (Task& task : tasks) {
+            task.func();
+        }
+        return;
+    }
+
+    size_t nReady;
+    {
+        LOCK(m_state->mutex);
+        for (size_t i = 0; i < m_state->tasks.size(); ++i) {
+            if (m_state->tasks[i].remaining == 0) m_state->ready.push_back(i);
+        }
+        nReady = m_state->ready.size();
+    }
+    // The first ready task is left to this thread
+    if (nReady > 1) Schedule(m_pscheduler, m_state, nReady - 1);
+
+    while (true) {
+        if (RunReady(m_pscheduler, m_state)) continue;
+        WAIT_LOCK(m_state->mutex, lock);
+        while (m_state->ready.empty() && m_state->done < m_state->tasks.size()) {
+            m_state->cond.wait(lock);
+        }
+        if (m_state->done == m_state->tasks.size()) return;
+    }
+}
+// VELES END
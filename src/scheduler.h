@@ -13,9 +13,23 @@
 #include <boost/chrono/chrono.hpp>
 #include <boost/thread.hpp>
 #include <map>
+// VELES BEGIN
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+// VELES END
 
 #include <sync.h>
 
+// VELES BEGIN
+/** Default for -schedulerthreads, the number of threads servicing the scheduler */
+static const int DEFAULT_SCHEDULER_THREADS = 2;
+/** Maximum number of threads servicing the scheduler */
+static const int MAX_SCHEDULER_THREADS = 8;
+// VELES END
+
 //
 // Simple class for background tasks that should be run
 // periodically or once "after a while"
@@ -42,18 +56,32 @@ public:
 
     typedef std::function<void()> Function;
 
+    // VELES BEGIN
+    // Priority classes of the tasks. A due task of a higher class runs first, and
+    // background tasks are kept off one of the threads when several run
+    // serviceQueue, so a long maintenance task does not hold up the others.
+    enum Priority {
+        PRIORITY_HIGH = 0,          // Latency-sensitive, like the validation interface notifications
+        PRIORITY_BACKGROUND = 1,    // Maintenance, runs on all but one of the threads
+    };
+    static const int NUM_PRIORITIES = 2;
+
     // Call func at/after time t
-    void schedule(Function f, boost::chrono::system_clock::time_point t=boost::chrono::system_clock::now());
+    //void schedule(Function f, boost::chrono::system_clock::time_point t=boost::chrono::system_clock::now());
+    void schedule(Function f, boost::chrono::system_clock::time_point t=boost::chrono::system_clock::now(), Priority priority=PRIORITY_HIGH);
 
     // Convenience method: call f once deltaMilliSeconds from now
-    void scheduleFromNow(Function f, int64_t deltaMilliSeconds);
+    //void scheduleFromNow(Function f, int64_t deltaMilliSeconds);
+    void scheduleFromNow(Function f, int64_t deltaMilliSeconds, Priority priority=PRIORITY_HIGH);
+    // VELES END
 
     // Another convenience method: call f approximately
     // every deltaMilliSeconds forever, starting deltaMilliSeconds from now.
     // To be more precise: every time f is finished, it
     // is rescheduled to run deltaMilliSeconds later. If you
     // need more accurate scheduling, don't use this method.
-    void scheduleEvery(Function f, int64_t deltaMilliSeconds);
+    //void scheduleEvery(Function f, int64_t deltaMilliSeconds);
+    void scheduleEvery(Function f, int64_t deltaMilliSeconds, Priority priority=PRIORITY_HIGH); // VELES
 
     // To keep things as simple as possible, there is no unschedule.
 
@@ -75,13 +103,23 @@ public:
     bool AreThreadsServicingQueue() const;
 
 private:
-    std::multimap<boost::chrono::system_clock::time_point, Function> taskQueue;
+    // VELES BEGIN
+    //std::multimap<boost::chrono::system_clock::time_point, Function> taskQueue;
+    std::multimap<boost::chrono::system_clock::time_point, Function> taskQueue[NUM_PRIORITIES];
+    // VELES END
     boost::condition_variable newTaskScheduled;
     mutable boost::mutex newTaskMutex;
     int nThreadsServicingQueue;
     bool stopRequested;
     bool stopWhenEmpty;
-    bool shouldStop() const { return stopRequested || (stopWhenEmpty && taskQueue.empty()); }
+    // VELES BEGIN
+    int nBackgroundRunning;
+    bool empty() const;
+    // One thread is left for the high priority tasks when there are several
+    bool canRunBackground() const { return nBackgroundRunning < std::max(1, nThreadsServicingQueue - 1); }
+    //bool shouldStop() const { return stopRequested || (stopWhenEmpty && taskQueue.empty()); }
+    bool shouldStop() const { return stopRequested || (stopWhenEmpty && empty()); }
+    // VELES END
 };
 
 /**
@@ -101,6 +139,10 @@ private:
     CCriticalSection m_cs_callbacks_pending;
     std::list<std::function<void ()>> m_callbacks_pending GUARDED_BY(m_cs_callbacks_pending);
     bool m_are_callbacks_running GUARDED_BY(m_cs_callbacks_pending) = false;
+    // VELES BEGIN
+    std::condition_variable_any m_callbacks_taken;
+    size_t m_callbacks_pending_peak GUARDED_BY(m_cs_callbacks_pending) = 0;
+    // VELES END
 
     void MaybeScheduleProcessQueue();
     void ProcessQueue();
@@ -121,6 +163,58 @@ public:
     void EmptyQueue();
 
     size_t CallbacksPending();
+    // VELES BEGIN
+    /** Block until no more than nMax callbacks are pending */
+    void WaitForCallbacksPending(size_t nMax);
+    /** Most callbacks pending at once since creation or the last reset */
+    size_t CallbacksPendingPeak();
+    void ResetCallbacksPendingPeak();
+    // VELES END
+};
+
+// VELES BEGIN
+/**
+ * Tasks run concurrently on the threads of a scheduler, each one once the tasks it depends on are
+ * done. The thread calling Run() takes the ready tasks no scheduler thread took yet and returns when
+ * all of them are done, so a group run from a scheduler task completes even when the other threads
+ * are busy. Without a scheduler the tasks run one after the other on the calling thread, in the
+ * order they were added. A group runs once.
+ */
+class CSchedulerTaskGroup {
+public:
+    explicit CSchedulerTaskGroup(CScheduler *pschedulerIn) : m_pscheduler(pschedulerIn), m_state(std::make_shared<State>()) {}
+
+    /** Add a task run after the tasks of the given indexes, added before it. Returns its index */
+    size_t Add(std::function<void ()> func, const std::vector<size_t>& dependencies = {});
+
+    /** Run the tasks and wait for all of them to be done */
+    void Run();
+
+private:
+    struct Task {
+        std::function<void ()> func;
+        //! Dependencies not done yet
+        size_t remaining = 0;
+        std::vector<size_t> dependents;
+    };
+
+    //! Shared with the scheduler tasks, which may run after the group is gone
+    struct State {
+        Mutex mutex;
+        std::condition_variable cond;
+        std::vector<Task> tasks GUARDED_BY(mutex);
+        std::deque<size_t> ready GUARDED_BY(mutex);
+        size_t done GUARDED_BY(mutex) = 0;
+    };
+
+    CScheduler *m_pscheduler;
+    std::shared_ptr<State> m_state;
+
+    /** Let the threads of the scheduler take count more ready tasks */
+    static void Schedule(CScheduler *pscheduler, const std::shared_ptr<State>& state, size_t count);
+    /** Run a ready task if there is any, returns whether there was one */
+    static bool RunReady(CScheduler *pscheduler, const std::shared_ptr<State>& state);
 };
+// VELES END
 
 #endif
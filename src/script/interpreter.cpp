@@ -10,6 +10,7 @@
 #include <crypto/sha256.h>
 #include <pubkey.h>
 #include <script/script.h>
+#include <streams.h> // VELES
 #include <uint256.h>
 
 typedef std::vector<unsigned char> valtype;
@@ -1212,6 +1213,57 @@ uint256 GetOutputsHash(const T& txTo)
     return ss.GetHash();
 }
 
+// VELES BEGIN
+/** Serializes straight into a SHA256 hasher, as CHashWriter does into its double SHA256 */
+class CSHA256Writer
+{
+private:
+    CSHA256& sha;
+
+public:
+    explicit CSHA256Writer(CSHA256& shaIn) : sha(shaIn) {}
+
+    int GetType() const { return SER_GETHASH; }
+    int GetVersion() const { return 0; }
+
+    void write(const char* pch, size_t size) { sha.Write((const unsigned char*)pch, size); }
+
+    template <typename T>
+    CSHA256Writer& operator<<(const T& obj)
+    {
+        ::Serialize(*this, obj);
+        return *this;
+    }
+};
+
+/** Legacy signature hash of SIGHASH_ALL, with or without SIGHASH_ANYONECANPAY, from the precomputed data */
+template <class T>
+uint256 LegacySignatureHash(const CScript& scriptCode, const T& txTo, unsigned int nIn, int nHashType, const PrecomputedTransactionData& cache)
+{
+    const CTransactionSignatureSerializer<T> txTmp(txTo, scriptCode, nIn, nHashType);
+    CSHA256 sha;
+    CSHA256Writer s(sha);
+    if (nHashType & SIGHASH_ANYONECANPAY) {
+        s << txTo.nVersion;
+        ::WriteCompactSize(s, 1);
+        txTmp.SerializeInput(s, nIn);
+    } else {
+        // Only the input being signed keeps its script, the others are the same for every input
+        sha = cache.vLegacyMidstates[nIn];
+        txTmp.SerializeInput(s, nIn);
+        const size_t nPos = cache.vLegacyInputPos[nIn + 1];
+        sha.Write(cache.vchLegacyInputs.data() + nPos, cache.vchLegacyInputs.size() - nPos);
+    }
+    sha.Write(cache.vchLegacyOutputs.data(), cache.vchLegacyOutputs.size());
+    s << nHashType;
+
+    uint256 hash;
+    sha.Finalize(hash.begin());
+    CSHA256().Write(hash.begin(), CSHA256::OUTPUT_SIZE).Finalize(hash.begin());
+    return hash;
+}
+// VELES END
+
 } // namespace
 
 template <class T>
@@ -1223,6 +1275,31 @@ PrecomputedTransactionData::PrecomputedTransactionData(const T& txTo)
         hashSequence = GetSequenceHash(txTo);
         hashOutputs = GetOutputsHash(txTo);
         ready = true;
+    // VELES BEGIN
+    } else if (txTo.vin.size() > 1) {
+        // Legacy signature hashes otherwise serialize the whole transaction for every input
+        CVectorWriter inputs(SER_GETHASH, 0, vchLegacyInputs, 0);
+        vLegacyInputPos.reserve(txTo.vin.size() + 1);
+        for (const auto& txin : txTo.vin) {
+            vLegacyInputPos.push_back(vchLegacyInputs.size());
+            inputs << txin.prevout << CScript() << txin.nSequence;
+        }
+        vLegacyInputPos.push_back(vchLegacyInputs.size());
+
+        CVectorWriter outputs(SER_GETHASH, 0, vchLegacyOutputs, 0);
+        outputs << txTo.vout << txTo.nLockTime;
+
+        CSHA256 sha;
+        CSHA256Writer s(sha);
+        s << txTo.nVersion;
+        ::WriteCompactSize(s, txTo.vin.size());
+        vLegacyMidstates.reserve(txTo.vin.size());
+        for (size_t i = 0; i < txTo.vin.size(); i++) {
+            vLegacyMidstates.push_back(sha);
+            sha.Write(vchLegacyInputs.data() + vLegacyInputPos[i], vLegacyInputPos[i + 1] - vLegacyInputPos[i]);
+        }
+        legacyReady = true;
+    // VELES END
     }
 }
 
@@ -1291,6 +1368,13 @@ uint256 SignatureHash(const CScript& scriptCode, const T& txTo, unsigned int nIn
         }
     }
 
+    // VELES BEGIN
+    if (cache && cache->legacyReady && cache->vLegacyMidstates.size() == txTo.vin.size() &&
+        (nHashType & 0x1f) != SIGHASH_SINGLE && (nHashType & 0x1f) != SIGHASH_NONE) {
+        return LegacySignatureHash(scriptCode, txTo, nIn, nHashType, *cache);
+    }
+    // VELES END
+
     // Wrapper to serialize only the necessary parts of the transaction being signed
     CTransactionSignatureSerializer<T> txTmp(txTo, scriptCode, nIn, nHashType);
 
@@ -7,6 +7,7 @@
 #define BITCOIN_SCRIPT_INTERPRETER_H
 
 #include <script/script_error.h>
+#include <crypto/sha256.h> // VELES
 #include <primitives/transaction.h>
 
 #include <vector>
@@ -124,6 +125,19 @@ struct PrecomputedTransactionData
     uint256 hashPrevouts, hashSequence, hashOutputs;
     bool ready = false;
 
+    // VELES BEGIN
+    //! Parts of the legacy serialization hashed for SIGHASH_ALL (with or without SIGHASH_ANYONECANPAY)
+    //! that do not depend on the input being signed, for transactions without witness and several inputs.
+    bool legacyReady = false;
+    //! SHA256 state after the version and the inputs before input i, with their scripts blanked out
+    std::vector<CSHA256> vLegacyMidstates;
+    //! Every input with its script blanked out, input i from vLegacyInputPos[i]
+    std::vector<unsigned char> vchLegacyInputs;
+    std::vector<size_t> vLegacyInputPos;
+    //! The outputs and nLockTime
+    std::vector<unsigned char> vchLegacyOutputs;
+    // VELES END
+
     template <class T>
     explicit PrecomputedTransactionData(const T& tx);
 };
@@ -6,8 +6,10 @@
 #include <script/sigcache.h>
 
 #include <memusage.h>
+#include <policy/policy.h>
 #include <pubkey.h>
 #include <random.h>
+#include <streams.h>
 #include <uint256.h>
 #include <util/system.h>
 
@@ -28,6 +30,10 @@ private:
     typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
     map_type setValid;
     boost::shared_mutex cs_sigcache;
+    // VELES BEGIN
+    std::atomic<uint64_t> nHits{0};
+    std::atomic<uint64_t> nMisses{0};
+    // VELES END
 
 public:
     CSignatureCache()
@@ -48,6 +54,16 @@ public:
         return setValid.contains(entry, erase);
     }
 
+    // VELES BEGIN
+    //! Get counting the hit or miss, for the first lookup of a signature
+    bool Lookup(const uint256& entry, const bool erase)
+    {
+        bool fHit = Get(entry, erase);
+        ++(fHit ? nHits : nMisses);
+        return fHit;
+    }
+    // VELES END
+
     void Set(uint256& entry)
     {
         boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
@@ -57,6 +73,34 @@ public:
     {
         return setValid.setup_bytes(n);
     }
+
+    // VELES BEGIN
+    ValidationCacheStats GetStats()
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        return {setValid.count(), setValid.capacity(), nHits, nMisses};
+    }
+
+    void Dump(CAutoFile& file)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        file << nonce << (uint64_t)setValid.count();
+        setValid.for_each([&file](const uint256& entry) { file << entry; });
+    }
+
+    void Load(CAutoFile& file)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        // The entries computed with the old nonce can not be found any more
+        uint64_t nEntries;
+        file >> nonce >> nEntries;
+        for (uint64_t i = 0; i < nEntries; i++) {
+            uint256 entry;
+            file >> entry;
+            setValid.insert(entry);
+        }
+    }
+    // VELES END
 };
 
 /* In previous versions of this code, signatureCache was a local static variable
@@ -74,17 +118,60 @@ void InitSignatureCache()
 {
     // nMaxCacheSize is unsigned. If -maxsigcachesize is set to zero,
     // setup_bytes creates the minimum possible cache (2 elements).
-    size_t nMaxCacheSize = std::min(std::max((int64_t)0, gArgs.GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) / 2), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+    // VELES BEGIN
+    //size_t nMaxCacheSize = std::min(std::max((int64_t)0, gArgs.GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) / 2), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+    size_t nMaxCacheSize, nScriptCacheSize;
+    GetValidationCacheSizes(nMaxCacheSize, nScriptCacheSize);
     size_t nElems = signatureCache.setup_bytes(nMaxCacheSize);
-    LogPrintf("Using %zu MiB out of %zu/2 requested for signature cache, able to store %zu elements\n",
-            (nElems*sizeof(uint256)) >>20, (nMaxCacheSize*2)>>20, nElems);
+    //LogPrintf("Using %zu MiB out of %zu/2 requested for signature cache, able to store %zu elements\n",
+    //        (nElems*sizeof(uint256)) >>20, (nMaxCacheSize*2)>>20, nElems);
+    LogPrintf("Using %zu MiB out of %zu requested for signature cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+    // VELES END
+}
+
+// VELES BEGIN
+void GetValidationCacheSizes(size_t& nSigCacheBytes, size_t& nScriptCacheBytes)
+{
+    int64_t nTotal = gArgs.GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE);
+    if (!gArgs.IsArgSet("-maxsigcachesize")) {
+        // One script execution entry and the signature entries of every transaction of a
+        // full mempool, at the 90% load the caches are kept at
+        int64_t nMempoolTxs = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000 / SIG_CACHE_AVG_TX_SIZE;
+        int64_t nNeeded = nMempoolTxs * (SIG_CACHE_SIGS_PER_TX + 1) * sizeof(uint256) * 10 / 9;
+        nTotal = std::max(nTotal, (nNeeded >> 20) + 1);
+    }
+    nTotal = std::max((int64_t)0, nTotal);
+    // nMaxCacheSize is unsigned. If -maxsigcachesize is set to zero,
+    // setup_bytes creates the minimum possible cache (2 elements).
+    nSigCacheBytes = std::min(nTotal * SIG_CACHE_SIGS_PER_TX / (SIG_CACHE_SIGS_PER_TX + 1), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+    nScriptCacheBytes = std::min(nTotal / (SIG_CACHE_SIGS_PER_TX + 1), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+}
+
+ValidationCacheStats GetSignatureCacheStats()
+{
+    return signatureCache.GetStats();
 }
 
+void DumpSignatureCache(CAutoFile& file)
+{
+    signatureCache.Dump(file);
+}
+
+void LoadSignatureCache(CAutoFile& file)
+{
+    signatureCache.Load(file);
+}
+// VELES END
+
 bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
 {
     uint256 entry;
     signatureCache.ComputeEntry(entry, sighash, vchSig, pubkey);
-    if (signatureCache.Get(entry, !store))
+    // VELES BEGIN
+    //if (signatureCache.Get(entry, !store))
+    if (signatureCache.Lookup(entry, !store))
+    // VELES END
         return true;
     if (!TransactionSignatureChecker::VerifySignature(vchSig, pubkey, sighash))
         return false;
@@ -92,3 +179,38 @@ bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsig
         signatureCache.Set(entry);
     return true;
 }
+
+// VELES BEGIN
+bool BatchingTransactionSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
+{
+    uint256 entry;
+    signatureCache.ComputeEntry(entry, sighash, vchSig, pubkey);
+    if (pvCollect) {
+        // Hits are kept, the script may be replayed and look them up again
+        if (!signatureCache.Lookup(entry, false))
+            pvCollect->emplace_back(pubkey, sighash, vchSig);
+        return true;
+    }
+
+    if (signatureCache.Get(entry, !store))
+        return true;
+    bool fValid;
+    if (nNext < nEnd && (*pvReplay)[nNext].hash == sighash && (*pvReplay)[nNext].pubkey == pubkey && (*pvReplay)[nNext].vchSig == vchSig) {
+        fValid = (*pvResults)[nNext++];
+    } else {
+        // The script went another way than when collecting
+        nNext = nEnd;
+        fValid = TransactionSignatureChecker::VerifySignature(vchSig, pubkey, sighash);
+    }
+    if (fValid && store)
+        signatureCache.Set(entry);
+    return fValid;
+}
+
+void AddToSignatureCache(const CSignatureVerification& sig)
+{
+    uint256 entry;
+    signatureCache.ComputeEntry(entry, sig.hash, sig.vchSig, sig.pubkey);
+    signatureCache.Set(entry);
+}
+// VELES END
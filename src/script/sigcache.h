@@ -18,6 +18,23 @@ static const unsigned int DEFAULT_MAX_SIG_CACHE_SIZE = 32;
 static const int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
 
 class CPubKey;
+// VELES BEGIN
+class CAutoFile;
+struct CSignatureVerification;
+
+/** The signatures per transaction the signature cache is sized for */
+static const unsigned int SIG_CACHE_SIGS_PER_TX = 2;
+/** The average size of a transaction the caches are sized for, to hold a full mempool */
+static const unsigned int SIG_CACHE_AVG_TX_SIZE = 500;
+
+/** Usage of the signature cache or the script execution cache */
+struct ValidationCacheStats {
+    size_t entries;
+    size_t capacity;
+    uint64_t hits;
+    uint64_t misses;
+};
+// VELES END
 
 /**
  * We're hashing a nonce into the entries themselves, so we don't need extra
@@ -51,6 +68,54 @@ public:
     bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const override;
 };
 
+// VELES BEGIN
+/**
+ * Signature checker for verifying the signatures of many scripts in one batch.
+ *
+ * Collecting, signatures missing from the cache are appended to vSigs and taken
+ * as valid, so the script runs the way it does when all its signatures are valid.
+ * Replaying, the signatures collected for the script in [nBegin, nEnd) take their
+ * result from vResults, as long as the script asks for them in the same order,
+ * any other signature is verified on its own.
+ */
+class BatchingTransactionSignatureChecker : public TransactionSignatureChecker
+{
+private:
+    bool store;
+    std::vector<CSignatureVerification>* pvCollect;
+    const std::vector<CSignatureVerification>* pvReplay;
+    const std::vector<bool>* pvResults;
+    mutable size_t nNext;
+    size_t nEnd;
+
+public:
+    BatchingTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const CAmount& amountIn, bool storeIn, PrecomputedTransactionData& txdataIn, std::vector<CSignatureVerification>& vSigs) :
+        TransactionSignatureChecker(txToIn, nInIn, amountIn, txdataIn), store(storeIn), pvCollect(&vSigs), pvReplay(nullptr), pvResults(nullptr), nNext(0), nEnd(0) {}
+    BatchingTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const CAmount& amountIn, bool storeIn, PrecomputedTransactionData& txdataIn, const std::vector<CSignatureVerification>& vSigs, size_t nBegin, size_t nEndIn, const std::vector<bool>& vResults) :
+        TransactionSignatureChecker(txToIn, nInIn, amountIn, txdataIn), store(storeIn), pvCollect(nullptr), pvReplay(&vSigs), pvResults(&vResults), nNext(nBegin), nEnd(nEndIn) {}
+
+    bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const override;
+};
+
+/** Add a signature verified in a batch to the signature cache */
+void AddToSignatureCache(const CSignatureVerification& sig);
+// VELES END
+
 void InitSignatureCache();
 
+// VELES BEGIN
+/**
+ * The sizes of the signature cache and the script execution cache in bytes. -maxsigcachesize
+ * is split between them, when it is not set they are sized to hold a full mempool of -maxmempool.
+ */
+void GetValidationCacheSizes(size_t& nSigCacheBytes, size_t& nScriptCacheBytes);
+
+ValidationCacheStats GetSignatureCacheStats();
+
+/** Write the nonce and the entries of the signature cache */
+void DumpSignatureCache(CAutoFile& file);
+/** Replace the nonce of the signature cache and add the entries written by DumpSignatureCache */
+void LoadSignatureCache(CAutoFile& file);
+// VELES END
+
 #endif // BITCOIN_SCRIPT_SIGCACHE_H
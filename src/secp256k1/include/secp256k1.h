@@ -388,6 +388,31 @@ SECP256K1_API SECP256K1_WARN_UNUSED_RESULT int secp256k1_ecdsa_verify(
     const secp256k1_pubkey *pubkey
 ) SECP256K1_ARG_NONNULL(1) SECP256K1_ARG_NONNULL(2) SECP256K1_ARG_NONNULL(3) SECP256K1_ARG_NONNULL(4);
 
+/** Verify several ECDSA signatures together.
+ *
+ *  Returns: 1: all the signatures are correct
+ *           0: at least one signature is incorrect or unparseable
+ *  Args:    ctx:       a secp256k1 context object, initialized for verification.
+ *  Out:     results:   an array of n ints set to the result secp256k1_ecdsa_verify
+ *                      would return for each signature (can be NULL)
+ *  In:      sigs:      an array of n signatures to verify (cannot be NULL)
+ *           msg32s:    the n 32-byte message hashes, one after the other (cannot be NULL)
+ *           pubkeys:   an array of n public keys to verify with (cannot be NULL)
+ *           n:         the number of signatures
+ *
+ * The results are the ones of secp256k1_ecdsa_verify, only lower-S signatures
+ * are accepted. The signatures share the modular inversions of their S values,
+ * which makes verifying a batch cheaper than verifying each signature alone.
+ */
+SECP256K1_API int secp256k1_ecdsa_verify_batch(
+    const secp256k1_context* ctx,
+    int *results,
+    const secp256k1_ecdsa_signature *sigs,
+    const unsigned char *msg32s,
+    const secp256k1_pubkey *pubkeys,
+    size_t n
+) SECP256K1_ARG_NONNULL(1) SECP256K1_ARG_NONNULL(3) SECP256K1_ARG_NONNULL(4) SECP256K1_ARG_NONNULL(5);
+
 /** Convert a signature to a normalized lower-S form.
  *
  *  Returns: 1 if sigin was not normalized, 0 if it already was.
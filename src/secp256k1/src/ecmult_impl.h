@@ -44,6 +44,10 @@
 /** The number of entries a table with precomputed multiples needs to have. */
 #define ECMULT_TABLE_SIZE(w) (1 << ((w)-2))
 
+#ifdef USE_ECMULT_STATIC_PRECOMPUTATION
+#include "ecmult_static_pre_g.h"
+#endif
+
 /** Fill a table 'prej' with precomputed odd multiples of a. Prej will contain
  *  the values [1*a,3*a,...,(2*n-1)*a], so it space for n values. zr[0] will
  *  contain prej[0].z / a.z. The other zr[i] values = prej[i].z / prej[i-1].z.
@@ -162,11 +166,20 @@ static void secp256k1_ecmult_context_init(secp256k1_ecmult_context *ctx) {
 }
 
 static void secp256k1_ecmult_context_build(secp256k1_ecmult_context *ctx, const secp256k1_callback *cb) {
+#ifndef USE_ECMULT_STATIC_PRECOMPUTATION
     secp256k1_gej gj;
+#endif
 
     if (ctx->pre_g != NULL) {
         return;
     }
+#ifdef USE_ECMULT_STATIC_PRECOMPUTATION
+    (void)cb;
+    ctx->pre_g = (secp256k1_ge_storage (*)[])secp256k1_ecmult_static_pre_g;
+#ifdef USE_ENDOMORPHISM
+    ctx->pre_g_128 = (secp256k1_ge_storage (*)[])secp256k1_ecmult_static_pre_g_128;
+#endif
+#else
 
     /* get the generator */
     secp256k1_gej_set_ge(&gj, &secp256k1_ge_const_g);
@@ -191,10 +204,18 @@ static void secp256k1_ecmult_context_build(secp256k1_ecmult_context *ctx, const
         secp256k1_ecmult_odd_multiples_table_storage_var(ECMULT_TABLE_SIZE(WINDOW_G), *ctx->pre_g_128, &g_128j, cb);
     }
 #endif
+#endif
 }
 
 static void secp256k1_ecmult_context_clone(secp256k1_ecmult_context *dst,
                                            const secp256k1_ecmult_context *src, const secp256k1_callback *cb) {
+#ifdef USE_ECMULT_STATIC_PRECOMPUTATION
+    (void)cb;
+    dst->pre_g = src->pre_g;
+#ifdef USE_ENDOMORPHISM
+    dst->pre_g_128 = src->pre_g_128;
+#endif
+#else
     if (src->pre_g == NULL) {
         dst->pre_g = NULL;
     } else {
@@ -211,6 +232,7 @@ static void secp256k1_ecmult_context_clone(secp256k1_ecmult_context *dst,
         memcpy(dst->pre_g_128, src->pre_g_128, size);
     }
 #endif
+#endif
 }
 
 static int secp256k1_ecmult_context_is_built(const secp256k1_ecmult_context *ctx) {
@@ -218,9 +240,11 @@ static int secp256k1_ecmult_context_is_built(const secp256k1_ecmult_context *ctx
 }
 
 static void secp256k1_ecmult_context_clear(secp256k1_ecmult_context *ctx) {
+#ifndef USE_ECMULT_STATIC_PRECOMPUTATION
     free(ctx->pre_g);
 #ifdef USE_ENDOMORPHISM
     free(ctx->pre_g_128);
+#endif
 #endif
     secp256k1_ecmult_context_init(ctx);
 }
@@ -0,0 +1,91 @@
+/**********************************************************************
+ * Copyright (c) 2013, 2014, 2015 Thomas Daede, Cory Fields           *
+ * Copyright (c) 2019 The Veles Core developers                       *
+ * Distributed under the MIT software license, see the accompanying   *
+ * file COPYING or http://www.opensource.org/licenses/mit-license.php.*
+ **********************************************************************/
+
+#define USE_BASIC_CONFIG 1
+
+#include "basic-config.h"
+#include "include/secp256k1.h"
+#include "field_impl.h"
+#include "scalar_impl.h"
+#include "group_impl.h"
+#include "ecmult_impl.h"
+
+/* The window sizes of ecmult_impl.h with and without the endomorphism, the
+ * tables are generated for both as this build config has none of them. */
+#define WINDOW_G_ENDO 15
+#define WINDOW_G_NO_ENDO 16
+
+static void default_error_callback_fn(const char* str, void* data) {
+    (void)data;
+    fprintf(stderr, "[libsecp256k1] internal consistency check failed: %s\n", str);
+    abort();
+}
+
+static const secp256k1_callback default_error_callback = {
+    default_error_callback_fn,
+    NULL
+};
+
+/* Print the odd multiples 1*a, 3*a, ..., (2*n-1)*a in the form of secp256k1_ecmult_odd_multiples_table_storage_var */
+static void print_table(FILE *fp, const char *name, const secp256k1_gej *a, int n) {
+    secp256k1_ge_storage* table = (secp256k1_ge_storage*)checked_malloc(&default_error_callback, sizeof(secp256k1_ge_storage) * n);
+    int i;
+
+    secp256k1_ecmult_odd_multiples_table_storage_var(n, table, a, &default_error_callback);
+    fprintf(fp, "static const secp256k1_ge_storage %s[%d] = {\n", name, n);
+    for (i = 0; i != n; i++) {
+        fprintf(fp,"    SC(%uu, %uu, %uu, %uu, %uu, %uu, %uu, %uu, %uu, %uu, %uu, %uu, %uu, %uu, %uu, %uu)%s\n", SECP256K1_GE_STORAGE_CONST_GET(table[i]), i != n - 1 ? "," : "");
+    }
+    fprintf(fp,"};\n");
+    free(table);
+}
+
+int main(int argc, char **argv) {
+    secp256k1_gej gj;
+    secp256k1_gej g_128j;
+    int i;
+    FILE* fp;
+
+    (void)argc;
+    (void)argv;
+
+    fp = fopen("src/ecmult_static_pre_g.h","w");
+    if (fp == NULL) {
+        fprintf(stderr, "Could not open src/ecmult_static_pre_g.h for writing!\n");
+        return -1;
+    }
+
+    secp256k1_gej_set_ge(&gj, &secp256k1_ge_const_g);
+    g_128j = gj;
+    for (i = 0; i < 128; i++) {
+        secp256k1_gej_double_var(&g_128j, &g_128j, NULL);
+    }
+
+    fprintf(fp, "#ifndef _SECP256K1_ECMULT_STATIC_PRE_G_\n");
+    fprintf(fp, "#define _SECP256K1_ECMULT_STATIC_PRE_G_\n");
+    fprintf(fp, "#include \"group.h\"\n");
+    fprintf(fp, "#define SC SECP256K1_GE_STORAGE_CONST\n");
+
+    fprintf(fp, "#if defined(USE_ENDOMORPHISM)\n");
+    fprintf(fp, "#if WINDOW_G != %d\n", WINDOW_G_ENDO);
+    fprintf(fp, "#  error \"The static ecmult tables do not match WINDOW_G\"\n");
+    fprintf(fp, "#endif\n");
+    print_table(fp, "secp256k1_ecmult_static_pre_g", &gj, ECMULT_TABLE_SIZE(WINDOW_G_ENDO));
+    print_table(fp, "secp256k1_ecmult_static_pre_g_128", &g_128j, ECMULT_TABLE_SIZE(WINDOW_G_ENDO));
+    fprintf(fp, "#else\n");
+    fprintf(fp, "#if WINDOW_G != %d\n", WINDOW_G_NO_ENDO);
+    fprintf(fp, "#  error \"The static ecmult tables do not match WINDOW_G\"\n");
+    fprintf(fp, "#endif\n");
+    print_table(fp, "secp256k1_ecmult_static_pre_g", &gj, ECMULT_TABLE_SIZE(WINDOW_G_NO_ENDO));
+    fprintf(fp, "#endif\n");
+
+    fprintf(fp, "#undef SC\n");
+    fprintf(fp, "#endif\n");
+    fclose(fp);
+
+    return 0;
+}
@@ -307,6 +307,64 @@ int secp256k1_ecdsa_verify(const secp256k1_context* ctx, const secp256k1_ecdsa_s
             secp256k1_ecdsa_sig_verify(&ctx->ecmult_ctx, &r, &s, &q, &m));
 }
 
+/* Number of signatures of a batch sharing an inversion, bounds the stack used */
+#define SECP256K1_ECDSA_VERIFY_BATCH_SIZE 64
+
+int secp256k1_ecdsa_verify_batch(const secp256k1_context* ctx, int *results, const secp256k1_ecdsa_signature *sigs, const unsigned char *msg32s, const secp256k1_pubkey *pubkeys, size_t n) {
+    secp256k1_ge q[SECP256K1_ECDSA_VERIFY_BATCH_SIZE];
+    secp256k1_scalar r[SECP256K1_ECDSA_VERIFY_BATCH_SIZE];
+    secp256k1_scalar s[SECP256K1_ECDSA_VERIFY_BATCH_SIZE];
+    secp256k1_scalar acc[SECP256K1_ECDSA_VERIFY_BATCH_SIZE];
+    int valid[SECP256K1_ECDSA_VERIFY_BATCH_SIZE];
+    secp256k1_scalar m, inv, sn;
+    size_t start, count, i;
+    int all = 1;
+    VERIFY_CHECK(ctx != NULL);
+    ARG_CHECK(secp256k1_ecmult_context_is_built(&ctx->ecmult_ctx));
+    ARG_CHECK(sigs != NULL);
+    ARG_CHECK(msg32s != NULL);
+    ARG_CHECK(pubkeys != NULL);
+
+    for (start = 0; start < n; start += count) {
+        count = n - start < SECP256K1_ECDSA_VERIFY_BATCH_SIZE ? n - start : SECP256K1_ECDSA_VERIFY_BATCH_SIZE;
+
+        /* Running products of the S values, the ones that cannot be valid are replaced by 1 */
+        for (i = 0; i < count; i++) {
+            secp256k1_ecdsa_signature_load(ctx, &r[i], &s[i], &sigs[start + i]);
+            valid[i] = !secp256k1_scalar_is_zero(&r[i]) && !secp256k1_scalar_is_zero(&s[i]) &&
+                       !secp256k1_scalar_is_high(&s[i]) && secp256k1_pubkey_load(ctx, &q[i], &pubkeys[start + i]);
+            if (!valid[i]) {
+                secp256k1_scalar_set_int(&s[i], 1);
+            }
+            if (i == 0) {
+                acc[0] = s[0];
+            } else {
+                secp256k1_scalar_mul(&acc[i], &acc[i - 1], &s[i]);
+            }
+        }
+
+        /* One inversion for the whole batch, the inverse of each S is taken out of it going back */
+        secp256k1_scalar_inverse_var(&inv, &acc[count - 1]);
+        for (i = count; i-- > 0;) {
+            if (i > 0) {
+                secp256k1_scalar_mul(&sn, &inv, &acc[i - 1]);
+                secp256k1_scalar_mul(&inv, &inv, &s[i]);
+            } else {
+                sn = inv;
+            }
+            if (valid[i]) {
+                secp256k1_scalar_set_b32(&m, msg32s + 32 * (start + i), NULL);
+                valid[i] = secp256k1_ecdsa_sig_verify_sinv(&ctx->ecmult_ctx, &r[i], &sn, &q[i], &m);
+            }
+            if (results) {
+                results[start + i] = valid[i];
+            }
+            all &= valid[i];
+        }
+    }
+    return all;
+}
+
 static int nonce_function_rfc6979(unsigned char *nonce32, const unsigned char *msg32, const unsigned char *key32, const unsigned char *algo16, void *data, unsigned int counter) {
    unsigned char keydata[112];
    int keylen = 64;
@@ -3641,6 +3641,55 @@ void run_ecdsa_end_to_end(void) {
     }
 }
 
+void test_ecdsa_verify_batch(void) {
+    secp256k1_ecdsa_signature sigs[100];
+    unsigned char msgs[100 * 32];
+    secp256k1_pubkey pubkeys[100];
+    int results[100];
+    int i, n;
+    secp256k1_scalar r, s;
+
+    /* Spans more than one inversion batch */
+    n = 1 + secp256k1_rand_int(100);
+    for (i = 0; i < n; i++) {
+        unsigned char privkey[32];
+        secp256k1_scalar msg, key;
+        random_scalar_order_test(&msg);
+        random_scalar_order_test(&key);
+        secp256k1_scalar_get_b32(privkey, &key);
+        secp256k1_scalar_get_b32(msgs + 32 * i, &msg);
+        CHECK(secp256k1_ec_pubkey_create(ctx, &pubkeys[i], privkey) == 1);
+        CHECK(secp256k1_ecdsa_sign(ctx, &sigs[i], msgs + 32 * i, privkey, NULL, NULL) == 1);
+    }
+    CHECK(secp256k1_ecdsa_verify_batch(ctx, results, sigs, msgs, pubkeys, n) == 1);
+    for (i = 0; i < n; i++) {
+        CHECK(results[i] == 1);
+    }
+    CHECK(secp256k1_ecdsa_verify_batch(ctx, NULL, sigs, msgs, pubkeys, 0) == 1);
+
+    /* Break a few signatures in different ways, the results match secp256k1_ecdsa_verify */
+    msgs[32 * secp256k1_rand_int(n)] ^= 1;
+    i = secp256k1_rand_int(n);
+    secp256k1_ecdsa_signature_load(ctx, &r, &s, &sigs[i]);
+    secp256k1_scalar_negate(&s, &s);
+    secp256k1_ecdsa_signature_save(&sigs[i], &r, &s);
+    i = secp256k1_rand_int(n);
+    secp256k1_ecdsa_signature_load(ctx, &r, &s, &sigs[i]);
+    secp256k1_scalar_clear(&s);
+    secp256k1_ecdsa_signature_save(&sigs[i], &r, &s);
+    CHECK(secp256k1_ecdsa_verify_batch(ctx, results, sigs, msgs, pubkeys, n) == 0);
+    for (i = 0; i < n; i++) {
+        CHECK(results[i] == secp256k1_ecdsa_verify(ctx, &sigs[i], msgs + 32 * i, &pubkeys[i]));
+    }
+}
+
+void run_ecdsa_verify_batch(void) {
+    int i;
+    for (i = 0; i < count; i++) {
+        test_ecdsa_verify_batch();
+    }
+}
+
 int test_ecdsa_der_parse(const unsigned char *sig, size_t siglen, int certainly_der, int certainly_not_der) {
     static const unsigned char zeroes[32] = {0};
 #ifdef ENABLE_OPENSSL_TESTS
@@ -4515,6 +4564,7 @@ int main(int argc, char **argv) {
     run_ecdsa_der_parse();
     run_ecdsa_sign_verify();
     run_ecdsa_end_to_end();
+    run_ecdsa_verify_batch();
     run_ecdsa_edge_cases();
 #ifdef ENABLE_OPENSSL_TESTS
     run_ecdsa_openssl();
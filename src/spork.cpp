@@ -29,6 +29,106 @@ CSporkManager sporkManager;
 
 std::map<uint256, CSporkMessage> mapSporks;
 
+// VELES BEGIN
+// default value of a known spork
+static bool GetSporkDefault(int nSporkID, int64_t& nValue)
+{
+    switch (nSporkID) {
+        case SPORK_2_INSTANTSEND_ENABLED:               nValue = SPORK_2_INSTANTSEND_ENABLED_DEFAULT; return true;
+        case SPORK_3_INSTANTSEND_BLOCK_FILTERING:       nValue = SPORK_3_INSTANTSEND_BLOCK_FILTERING_DEFAULT; return true;
+        case SPORK_5_INSTANTSEND_MAX_VALUE:             nValue = SPORK_5_INSTANTSEND_MAX_VALUE_DEFAULT; return true;
+        case SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT:    nValue = SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT_DEFAULT; return true;
+        case SPORK_9_SUPERBLOCKS_ENABLED:               nValue = SPORK_9_SUPERBLOCKS_ENABLED_DEFAULT; return true;
+        case SPORK_10_MASTERNODE_PAY_UPDATED_NODES:     nValue = SPORK_10_MASTERNODE_PAY_UPDATED_NODES_DEFAULT; return true;
+        case SPORK_12_RECONSIDER_BLOCKS:                nValue = SPORK_12_RECONSIDER_BLOCKS_DEFAULT; return true;
+        case SPORK_13_OLD_SUPERBLOCK_FLAG:              nValue = SPORK_13_OLD_SUPERBLOCK_FLAG_DEFAULT; return true;
+        case SPORK_14_REQUIRE_SENTINEL_FLAG:            nValue = SPORK_14_REQUIRE_SENTINEL_FLAG_DEFAULT; return true;
+        // FXTC BEGIN
+        case SPORK_FXTC_01_HANDBRAKE_HEIGHT:            nValue = SPORK_FXTC_01_HANDBRAKE_HEIGHT_DEFAULT; return true;
+        case SPORK_FXTC_01_HANDBRAKE_FORCE_SHA256D:     nValue = SPORK_FXTC_01_HANDBRAKE_FORCE_SHA256D_DEFAULT; return true;
+        case SPORK_FXTC_01_HANDBRAKE_FORCE_SCRYPT:      nValue = SPORK_FXTC_01_HANDBRAKE_FORCE_SCRYPT_DEFAULT; return true;
+        case SPORK_FXTC_01_HANDBRAKE_FORCE_NIST5:       nValue = SPORK_FXTC_01_HANDBRAKE_FORCE_NIST5_DEFAULT; return true;
+        case SPORK_FXTC_01_HANDBRAKE_FORCE_LYRA2Z:      nValue = SPORK_FXTC_01_HANDBRAKE_FORCE_LYRA2Z_DEFAULT; return true;
+        case SPORK_FXTC_01_HANDBRAKE_FORCE_X11:         nValue = SPORK_FXTC_01_HANDBRAKE_FORCE_X11_DEFAULT; return true;
+        case SPORK_FXTC_01_HANDBRAKE_FORCE_X16R:        nValue = SPORK_FXTC_01_HANDBRAKE_FORCE_X16R_DEFAULT; return true;
+
+        case SPORK_FXTC_02_IGNORE_SLIGHTLY_HIGHER_COINBASE:     nValue = SPORK_FXTC_02_IGNORE_SLIGHTLY_HIGHER_COINBASE_DEFAULT; return true;
+        case SPORK_FXTC_02_IGNORE_FOUNDER_REWARD_CHECK:         nValue = SPORK_FXTC_02_IGNORE_FOUNDER_REWARD_CHECK_DEFAULT; return true;
+        case SPORK_FXTC_02_IGNORE_FOUNDER_REWARD_VALUE:         nValue = SPORK_FXTC_02_IGNORE_FOUNDER_REWARD_VALUE_DEFAULT; return true;
+        case SPORK_FXTC_02_IGNORE_MASTERNODE_REWARD_VALUE:      nValue = SPORK_FXTC_02_IGNORE_MASTERNODE_REWARD_VALUE_DEFAULT; return true;
+        case SPORK_FXTC_02_IGNORE_MASTERNODE_REWARD_PAYEE:      nValue = SPORK_FXTC_02_IGNORE_MASTERNODE_REWARD_PAYEE_DEFAULT; return true;
+
+        case SPORK_FXTC_03_BLOCK_REWARD_SMOOTH_HALVING_START:   nValue = SPORK_FXTC_03_BLOCK_REWARD_SMOOTH_HALVING_START_DEFAULT; return true;
+        // FXTC END
+        case SPORK_VELES_01_FXTC_CHAIN_START:                     nValue = SPORK_VELES_01_FXTC_CHAIN_START_DEFAULT; return true;
+        case SPORK_VELES_02_UNLIMITED_BLOCK_SUBSIDY_START:        nValue = SPORK_VELES_02_UNLIMITED_BLOCK_SUBSIDY_START_DEFAULT; return true;
+        case SPORK_VELES_03_RECALCULATE_HALVING_PARAMETERS:       nValue = SPORK_VELES_03_RECALCULATE_HALVING_PARAMETERS_DEFAULT; return true;
+        case SPORK_VELES_04_REWARD_UPGRADE_ALPHA_START:           nValue = SPORK_VELES_04_REWARD_UPGRADE_ALPHA_START_DEFAULT; return true;
+        case SPORK_VELES_05A_ADJUST_COST_FACTOR_START:            nValue = SPORK_VELES_05A_ADJUST_COST_FACTOR_START_DEFAULT; return true;
+        case SPORK_VELES_05A_ADJUST_COST_FACTOR_SHA256D:          nValue = SPORK_VELES_05A_ADJUST_COST_FACTOR_SHA256D_DEFAULT; return true;
+        case SPORK_VELES_05A_ADJUST_COST_FACTOR_SCRYPT:           nValue = SPORK_VELES_05A_ADJUST_COST_FACTOR_SCRYPT_DEFAULT; return true;
+        case SPORK_VELES_05A_ADJUST_COST_FACTOR_NIST5:            nValue = SPORK_VELES_05A_ADJUST_COST_FACTOR_NIST5_DEFAULT; return true;
+        case SPORK_VELES_05A_ADJUST_COST_FACTOR_LYRA2Z:           nValue = SPORK_VELES_05A_ADJUST_COST_FACTOR_LYRA2Z_DEFAULT; return true;
+        case SPORK_VELES_05A_ADJUST_COST_FACTOR_X11:              nValue = SPORK_VELES_05A_ADJUST_COST_FACTOR_X11_DEFAULT; return true;
+        case SPORK_VELES_05A_ADJUST_COST_FACTOR_X16R:             nValue = SPORK_VELES_05A_ADJUST_COST_FACTOR_X16R_DEFAULT; return true;
+        case SPORK_VELES_05B_ADJUST_COST_FACTOR_START:            nValue = SPORK_VELES_05B_ADJUST_COST_FACTOR_START_DEFAULT; return true;
+        case SPORK_VELES_05B_ADJUST_COST_FACTOR_SHA256D:          nValue = SPORK_VELES_05B_ADJUST_COST_FACTOR_SHA256D_DEFAULT; return true;
+        case SPORK_VELES_05B_ADJUST_COST_FACTOR_SCRYPT:           nValue = SPORK_VELES_05B_ADJUST_COST_FACTOR_SCRYPT_DEFAULT; return true;
+        case SPORK_VELES_05B_ADJUST_COST_FACTOR_NIST5:            nValue = SPORK_VELES_05B_ADJUST_COST_FACTOR_NIST5_DEFAULT; return true;
+        case SPORK_VELES_05B_ADJUST_COST_FACTOR_LYRA2Z:           nValue = SPORK_VELES_05B_ADJUST_COST_FACTOR_LYRA2Z_DEFAULT; return true;
+        case SPORK_VELES_05B_ADJUST_COST_FACTOR_X11:              nValue = SPORK_VELES_05B_ADJUST_COST_FACTOR_X11_DEFAULT; return true;
+        case SPORK_VELES_05B_ADJUST_COST_FACTOR_X16R:             nValue = SPORK_VELES_05B_ADJUST_COST_FACTOR_X16R_DEFAULT; return true;
+        case SPORK_VELES_06A_DYNAMIC_REWARD_BOOST1_START:         nValue = SPORK_VELES_06A_DYNAMIC_REWARD_BOOST1_START_DEFAULT; return true;
+        case SPORK_VELES_06A_DYNAMIC_REWARD_BOOST1_FACTOR:        nValue = SPORK_VELES_06A_DYNAMIC_REWARD_BOOST1_FACTOR_DEFAULT; return true;
+        case SPORK_VELES_06B_DYNAMIC_REWARD_BOOST2_START:         nValue = SPORK_VELES_06B_DYNAMIC_REWARD_BOOST2_START_DEFAULT; return true;
+        case SPORK_VELES_06B_DYNAMIC_REWARD_BOOST2_FACTOR:        nValue = SPORK_VELES_06B_DYNAMIC_REWARD_BOOST2_FACTOR_DEFAULT; return true;
+        case SPORK_VELES_06C_DYNAMIC_REWARD_BOOST3_START:         nValue = SPORK_VELES_06C_DYNAMIC_REWARD_BOOST3_START_DEFAULT; return true;
+        case SPORK_VELES_06C_DYNAMIC_REWARD_BOOST3_FACTOR:        nValue = SPORK_VELES_06C_DYNAMIC_REWARD_BOOST3_FACTOR_DEFAULT; return true;
+        default:
+            return false;
+    }
+}
+
+// Spork IDs come in three ranges, packed one after another into the slots
+int CSporkManager::GetSporkSlot(int nSporkID)
+{
+    if (nSporkID >= SPORK_START && nSporkID <= SPORK_END)
+        return nSporkID - SPORK_START;
+    if (nSporkID >= SPORK_FXTC_START && nSporkID <= SPORK_FXTC_END)
+        return (SPORK_END - SPORK_START + 1) + nSporkID - SPORK_FXTC_START;
+    if (nSporkID >= SPORK_VELES_START && nSporkID <= SPORK_VELES_END)
+        return (SPORK_END - SPORK_START + 1) + (SPORK_FXTC_END - SPORK_FXTC_START + 1) + nSporkID - SPORK_VELES_START;
+    return -1;
+}
+
+CSporkManager::CSporkManager()
+{
+    for (SporkValue& value : vSporkValues) {
+        value.nValue = -1;
+        value.fKnown = false;
+    }
+    for (int i = SPORK_START; i <= SPORK_VELES_END; ++i) {
+        if (i > SPORK_END && i < SPORK_FXTC_START) i = SPORK_FXTC_START;
+        if (i > SPORK_FXTC_END && i < SPORK_VELES_START) i = SPORK_VELES_START;
+
+        int64_t nValue;
+        if (GetSporkDefault(i, nValue)) {
+            vSporkValues[GetSporkSlot(i)].nValue = nValue;
+            vSporkValues[GetSporkSlot(i)].fKnown = true;
+        }
+    }
+}
+
+// publish the value of an accepted spork to the readers of GetSporkValue
+void CSporkManager::SetSporkValue(int nSporkID, int64_t nValue)
+{
+    int nSlot = GetSporkSlot(nSporkID);
+    if (nSlot >= 0 && vSporkValues[nSlot].fKnown)
+        vSporkValues[nSlot].nValue.store(nValue, std::memory_order_relaxed);
+    nUpdateCount++;
+}
+// VELES END
+
 // FXTC BEGIN
 std::unique_ptr<CSporkDB> pSporkDB = NULL;
 
@@ -57,6 +157,9 @@ void CSporkManager::LoadSporksFromDB()
         // add spork to memory
         mapSporks[spork.GetHash()] = spork;
         mapSporksActive[spork.nSporkID] = spork;
+        // VELES BEGIN
+        SetSporkValue(spork.nSporkID, spork.nValue);
+        // VELES END
         std::time_t result = spork.nValue;
         // If SPORK Value is greater than 1,000,000 assume it's actually a Date and then convert to a more readable format
         if (spork.nValue > 1000000) {
@@ -85,11 +188,21 @@ void CSporkManager::ProcessSpork(CNode* pfrom, const std::string& strCommand, CD
         std::string strLogMsg;
         {
             LOCK(cs_main);
-            pfrom->setAskFor.erase(hash);
+            //pfrom->setAskFor.erase(hash);
+            pfrom->RemoveAskFor(hash); // VELES
             if(!chainActive.Tip()) return;
             strLogMsg = strprintf("SPORK -- hash: %s id: %d value: %10d bestHeight: %d peer=%d", hash.ToString(), spork.nSporkID, spork.nValue, chainActive.Height(), pfrom->GetId());
         }
 
+        // VELES BEGIN
+        // Peers send every spork they know on each GETSPORKS, a message known by its hash had its
+        // signature verified when first received
+        if (mapSporks.count(hash)) {
+            LogPrint(BCLog::SPORK, "%s seen\n", strLogMsg);
+            return;
+        }
+        // VELES END
+
         if(mapSporksActive.count(spork.nSporkID)) {
             if (mapSporksActive[spork.nSporkID].nTimeSigned >= spork.nTimeSigned) {
                 LogPrint(BCLog::SPORK, "%s seen\n", strLogMsg);
@@ -101,7 +214,24 @@ void CSporkManager::ProcessSpork(CNode* pfrom, const std::string& strCommand, CD
             LogPrintf("%s new\n", strLogMsg);
         }
 
-        if(!spork.CheckSignature()) {
+        // VELES BEGIN
+        // The message hash leaves the signature out, the same message with a bad signature must
+        // not keep a good one out
+        const uint256 hashSigned = SerializeHash(spork);
+        bool fInvalid;
+        {
+            LOCK(cs);
+            fInvalid = setInvalidSporks.count(hashSigned);
+        }
+        if (!fInvalid && !spork.CheckSignature()) {
+            fInvalid = true;
+            LOCK(cs);
+            if (setInvalidSporks.size() >= MAX_INVALID_SPORKS) setInvalidSporks.clear();
+            setInvalidSporks.insert(hashSigned);
+        }
+        //if(!spork.CheckSignature()) {
+        if(fInvalid) {
+        // VELES END
             LOCK(cs_main);
             LogPrintf("CSporkManager::ProcessSpork -- invalid signature\n");
             Misbehaving(pfrom->GetId(), 100);
@@ -110,6 +240,9 @@ void CSporkManager::ProcessSpork(CNode* pfrom, const std::string& strCommand, CD
 
         mapSporks[hash] = spork;
         mapSporksActive[spork.nSporkID] = spork;
+        // VELES BEGIN
+        SetSporkValue(spork.nSporkID, spork.nValue);
+        // VELES END
         spork.Relay(connman);
 
         //does a task if needed
@@ -117,7 +250,12 @@ void CSporkManager::ProcessSpork(CNode* pfrom, const std::string& strCommand, CD
 
         // FXTC BEGIN
         // PIVX: add to spork database.
-        pSporkDB->WriteSpork(spork.nSporkID, spork);
+        // VELES BEGIN
+        // Written with the other sporks received meanwhile by FlushSporksToDB
+        //pSporkDB->WriteSpork(spork.nSporkID, spork);
+        LOCK(cs);
+        mapSporksUnsaved[spork.nSporkID] = spork;
+        // VELES END
         // FXTC END
     } else if (strCommand == NetMsgType::GETSPORKS) {
 
@@ -169,6 +307,9 @@ bool CSporkManager::UpdateSpork(int nSporkID, int64_t nValue, CConnman& connman)
         spork.Relay(connman);
         mapSporks[spork.GetHash()] = spork;
         mapSporksActive[nSporkID] = spork;
+        // VELES BEGIN
+        SetSporkValue(nSporkID, nValue);
+        // VELES END
         return true;
     }
 
@@ -180,68 +321,17 @@ bool CSporkManager::IsSporkActive(int nSporkID)
 {
     int64_t r = -1;
 
-    if(mapSporksActive.count(nSporkID)){
+    // VELES BEGIN
+    int nSlot = GetSporkSlot(nSporkID);
+    if (nSlot >= 0 && vSporkValues[nSlot].fKnown) {
+        r = vSporkValues[nSlot].nValue.load(std::memory_order_relaxed);
+    } else if (mapSporksActive.count(nSporkID)) {
         r = mapSporksActive[nSporkID].nValue;
-    } else {
-        switch (nSporkID) {
-            case SPORK_2_INSTANTSEND_ENABLED:               r = SPORK_2_INSTANTSEND_ENABLED_DEFAULT; break;
-            case SPORK_3_INSTANTSEND_BLOCK_FILTERING:       r = SPORK_3_INSTANTSEND_BLOCK_FILTERING_DEFAULT; break;
-            case SPORK_5_INSTANTSEND_MAX_VALUE:             r = SPORK_5_INSTANTSEND_MAX_VALUE_DEFAULT; break;
-            case SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT:    r = SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT_DEFAULT; break;
-            case SPORK_9_SUPERBLOCKS_ENABLED:               r = SPORK_9_SUPERBLOCKS_ENABLED_DEFAULT; break;
-            case SPORK_10_MASTERNODE_PAY_UPDATED_NODES:     r = SPORK_10_MASTERNODE_PAY_UPDATED_NODES_DEFAULT; break;
-            case SPORK_12_RECONSIDER_BLOCKS:                r = SPORK_12_RECONSIDER_BLOCKS_DEFAULT; break;
-            case SPORK_13_OLD_SUPERBLOCK_FLAG:              r = SPORK_13_OLD_SUPERBLOCK_FLAG_DEFAULT; break;
-            case SPORK_14_REQUIRE_SENTINEL_FLAG:            r = SPORK_14_REQUIRE_SENTINEL_FLAG_DEFAULT; break;
-            // FXTC BEGIN
-            case SPORK_FXTC_01_HANDBRAKE_HEIGHT :           r = SPORK_FXTC_01_HANDBRAKE_HEIGHT_DEFAULT; break;
-            case SPORK_FXTC_01_HANDBRAKE_FORCE_SHA256D:     r = SPORK_FXTC_01_HANDBRAKE_FORCE_SHA256D_DEFAULT; break;
-            case SPORK_FXTC_01_HANDBRAKE_FORCE_SCRYPT:      r = SPORK_FXTC_01_HANDBRAKE_FORCE_SCRYPT_DEFAULT; break;
-            case SPORK_FXTC_01_HANDBRAKE_FORCE_NIST5:       r = SPORK_FXTC_01_HANDBRAKE_FORCE_NIST5_DEFAULT; break;
-            case SPORK_FXTC_01_HANDBRAKE_FORCE_LYRA2Z:      r = SPORK_FXTC_01_HANDBRAKE_FORCE_LYRA2Z_DEFAULT; break;
-            case SPORK_FXTC_01_HANDBRAKE_FORCE_X11:         r = SPORK_FXTC_01_HANDBRAKE_FORCE_X11_DEFAULT; break;
-            case SPORK_FXTC_01_HANDBRAKE_FORCE_X16R:        r = SPORK_FXTC_01_HANDBRAKE_FORCE_X16R_DEFAULT; break;
-
-            case SPORK_FXTC_02_IGNORE_SLIGHTLY_HIGHER_COINBASE:     r = SPORK_FXTC_02_IGNORE_SLIGHTLY_HIGHER_COINBASE_DEFAULT; break;
-            case SPORK_FXTC_02_IGNORE_FOUNDER_REWARD_CHECK:         r = SPORK_FXTC_02_IGNORE_FOUNDER_REWARD_CHECK_DEFAULT; break;
-            case SPORK_FXTC_02_IGNORE_FOUNDER_REWARD_VALUE:         r = SPORK_FXTC_02_IGNORE_FOUNDER_REWARD_VALUE_DEFAULT; break;
-            case SPORK_FXTC_02_IGNORE_MASTERNODE_REWARD_VALUE:      r = SPORK_FXTC_02_IGNORE_MASTERNODE_REWARD_VALUE_DEFAULT; break;
-            case SPORK_FXTC_02_IGNORE_MASTERNODE_REWARD_PAYEE:      r = SPORK_FXTC_02_IGNORE_MASTERNODE_REWARD_PAYEE_DEFAULT; break;
-
-            case SPORK_FXTC_03_BLOCK_REWARD_SMOOTH_HALVING_START:   r = SPORK_FXTC_03_BLOCK_REWARD_SMOOTH_HALVING_START_DEFAULT; break;
-            // FXTC END
-            // VELES BEGIN
-            case SPORK_VELES_01_FXTC_CHAIN_START:                     r = SPORK_VELES_01_FXTC_CHAIN_START_DEFAULT; break;
-            case SPORK_VELES_02_UNLIMITED_BLOCK_SUBSIDY_START:        r = SPORK_VELES_02_UNLIMITED_BLOCK_SUBSIDY_START_DEFAULT; break;
-            case SPORK_VELES_03_RECALCULATE_HALVING_PARAMETERS:       r = SPORK_VELES_03_RECALCULATE_HALVING_PARAMETERS_DEFAULT; break;
-            case SPORK_VELES_04_REWARD_UPGRADE_ALPHA_START:           r = SPORK_VELES_04_REWARD_UPGRADE_ALPHA_START_DEFAULT; break;
-            case SPORK_VELES_05A_ADJUST_COST_FACTOR_START:            r = SPORK_VELES_05A_ADJUST_COST_FACTOR_START_DEFAULT; break;
-            case SPORK_VELES_05A_ADJUST_COST_FACTOR_SHA256D:          r = SPORK_VELES_05A_ADJUST_COST_FACTOR_SHA256D_DEFAULT; break;
-            case SPORK_VELES_05A_ADJUST_COST_FACTOR_SCRYPT:           r = SPORK_VELES_05A_ADJUST_COST_FACTOR_SCRYPT_DEFAULT; break;
-            case SPORK_VELES_05A_ADJUST_COST_FACTOR_NIST5:            r = SPORK_VELES_05A_ADJUST_COST_FACTOR_NIST5_DEFAULT; break;
-            case SPORK_VELES_05A_ADJUST_COST_FACTOR_LYRA2Z:           r = SPORK_VELES_05A_ADJUST_COST_FACTOR_LYRA2Z_DEFAULT; break;
-            case SPORK_VELES_05A_ADJUST_COST_FACTOR_X11:              r = SPORK_VELES_05A_ADJUST_COST_FACTOR_X11_DEFAULT; break;
-            case SPORK_VELES_05A_ADJUST_COST_FACTOR_X16R:             r = SPORK_VELES_05A_ADJUST_COST_FACTOR_X16R_DEFAULT; break;
-            case SPORK_VELES_05B_ADJUST_COST_FACTOR_START:            r = SPORK_VELES_05B_ADJUST_COST_FACTOR_START_DEFAULT; break;
-            case SPORK_VELES_05B_ADJUST_COST_FACTOR_SHA256D:          r = SPORK_VELES_05B_ADJUST_COST_FACTOR_SHA256D_DEFAULT; break;
-            case SPORK_VELES_05B_ADJUST_COST_FACTOR_SCRYPT:           r = SPORK_VELES_05B_ADJUST_COST_FACTOR_SCRYPT_DEFAULT; break;
-            case SPORK_VELES_05B_ADJUST_COST_FACTOR_NIST5:            r = SPORK_VELES_05B_ADJUST_COST_FACTOR_NIST5_DEFAULT; break;
-            case SPORK_VELES_05B_ADJUST_COST_FACTOR_LYRA2Z:           r = SPORK_VELES_05B_ADJUST_COST_FACTOR_LYRA2Z_DEFAULT; break;
-            case SPORK_VELES_05B_ADJUST_COST_FACTOR_X11:              r = SPORK_VELES_05B_ADJUST_COST_FACTOR_X11_DEFAULT; break;
-            case SPORK_VELES_05B_ADJUST_COST_FACTOR_X16R:             r = SPORK_VELES_05B_ADJUST_COST_FACTOR_X16R_DEFAULT; break;
-            case SPORK_VELES_06A_DYNAMIC_REWARD_BOOST1_START:         r = SPORK_VELES_06A_DYNAMIC_REWARD_BOOST1_START_DEFAULT; break;
-            case SPORK_VELES_06A_DYNAMIC_REWARD_BOOST1_FACTOR:        r = SPORK_VELES_06A_DYNAMIC_REWARD_BOOST1_FACTOR_DEFAULT; break;
-            case SPORK_VELES_06B_DYNAMIC_REWARD_BOOST2_START:         r = SPORK_VELES_06B_DYNAMIC_REWARD_BOOST2_START_DEFAULT; break;
-            case SPORK_VELES_06B_DYNAMIC_REWARD_BOOST2_FACTOR:        r = SPORK_VELES_06B_DYNAMIC_REWARD_BOOST2_FACTOR_DEFAULT; break;
-            case SPORK_VELES_06C_DYNAMIC_REWARD_BOOST3_START:         r = SPORK_VELES_06C_DYNAMIC_REWARD_BOOST3_START_DEFAULT; break;
-            case SPORK_VELES_06C_DYNAMIC_REWARD_BOOST3_FACTOR:        r = SPORK_VELES_06C_DYNAMIC_REWARD_BOOST3_FACTOR_DEFAULT; break;
-            // VELES END
-            default:
-                LogPrint(BCLog::SPORK, "CSporkManager::IsSporkActive -- Unknown Spork ID %d\n", nSporkID);
-                r = 4070908800ULL; // 2099-1-1 i.e. off by default
-                break;
-        }
+    } else if (!GetSporkDefault(nSporkID, r)) {
+        LogPrint(BCLog::SPORK, "CSporkManager::IsSporkActive -- Unknown Spork ID %d\n", nSporkID);
+        r = 4070908800ULL; // 2099-1-1 i.e. off by default
     }
+    // VELES END
 
     return r < GetAdjustedTime();
 }
@@ -249,67 +339,23 @@ bool CSporkManager::IsSporkActive(int nSporkID)
 // grab the value of the spork on the network, or the default
 int64_t CSporkManager::GetSporkValue(int nSporkID)
 {
+    // VELES BEGIN
+    int nSlot = GetSporkSlot(nSporkID);
+    if (nSlot >= 0 && vSporkValues[nSlot].fKnown)
+        return vSporkValues[nSlot].nValue.load(std::memory_order_relaxed);
+    // VELES END
+
     if (mapSporksActive.count(nSporkID))
         return mapSporksActive[nSporkID].nValue;
 
-    switch (nSporkID) {
-        case SPORK_2_INSTANTSEND_ENABLED:               return SPORK_2_INSTANTSEND_ENABLED_DEFAULT;
-        case SPORK_3_INSTANTSEND_BLOCK_FILTERING:       return SPORK_3_INSTANTSEND_BLOCK_FILTERING_DEFAULT;
-        case SPORK_5_INSTANTSEND_MAX_VALUE:             return SPORK_5_INSTANTSEND_MAX_VALUE_DEFAULT;
-        case SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT:    return SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT_DEFAULT;
-        case SPORK_9_SUPERBLOCKS_ENABLED:               return SPORK_9_SUPERBLOCKS_ENABLED_DEFAULT;
-        case SPORK_10_MASTERNODE_PAY_UPDATED_NODES:     return SPORK_10_MASTERNODE_PAY_UPDATED_NODES_DEFAULT;
-        case SPORK_12_RECONSIDER_BLOCKS:                return SPORK_12_RECONSIDER_BLOCKS_DEFAULT;
-        case SPORK_13_OLD_SUPERBLOCK_FLAG:              return SPORK_13_OLD_SUPERBLOCK_FLAG_DEFAULT;
-        case SPORK_14_REQUIRE_SENTINEL_FLAG:            return SPORK_14_REQUIRE_SENTINEL_FLAG_DEFAULT;
-        // FXTC BEGIN
-        case SPORK_FXTC_01_HANDBRAKE_HEIGHT:            return SPORK_FXTC_01_HANDBRAKE_HEIGHT_DEFAULT;
-        case SPORK_FXTC_01_HANDBRAKE_FORCE_SHA256D:     return SPORK_FXTC_01_HANDBRAKE_FORCE_SHA256D_DEFAULT;
-        case SPORK_FXTC_01_HANDBRAKE_FORCE_SCRYPT:      return SPORK_FXTC_01_HANDBRAKE_FORCE_SCRYPT_DEFAULT;
-        case SPORK_FXTC_01_HANDBRAKE_FORCE_NIST5:       return SPORK_FXTC_01_HANDBRAKE_FORCE_NIST5_DEFAULT;
-        case SPORK_FXTC_01_HANDBRAKE_FORCE_LYRA2Z:      return SPORK_FXTC_01_HANDBRAKE_FORCE_LYRA2Z_DEFAULT;
-        case SPORK_FXTC_01_HANDBRAKE_FORCE_X11:         return SPORK_FXTC_01_HANDBRAKE_FORCE_X11_DEFAULT;
-        case SPORK_FXTC_01_HANDBRAKE_FORCE_X16R:        return SPORK_FXTC_01_HANDBRAKE_FORCE_X16R_DEFAULT;
-
-        case SPORK_FXTC_02_IGNORE_SLIGHTLY_HIGHER_COINBASE:     return SPORK_FXTC_02_IGNORE_SLIGHTLY_HIGHER_COINBASE_DEFAULT;
-        case SPORK_FXTC_02_IGNORE_FOUNDER_REWARD_CHECK:         return SPORK_FXTC_02_IGNORE_FOUNDER_REWARD_CHECK_DEFAULT;
-        case SPORK_FXTC_02_IGNORE_FOUNDER_REWARD_VALUE:         return SPORK_FXTC_02_IGNORE_FOUNDER_REWARD_VALUE_DEFAULT;
-        case SPORK_FXTC_02_IGNORE_MASTERNODE_REWARD_VALUE:      return SPORK_FXTC_02_IGNORE_MASTERNODE_REWARD_VALUE_DEFAULT;
-        case SPORK_FXTC_02_IGNORE_MASTERNODE_REWARD_PAYEE:      return SPORK_FXTC_02_IGNORE_MASTERNODE_REWARD_PAYEE_DEFAULT;
-
-        case SPORK_FXTC_03_BLOCK_REWARD_SMOOTH_HALVING_START:   return SPORK_FXTC_03_BLOCK_REWARD_SMOOTH_HALVING_START_DEFAULT;
-        // FXTC END
-        // VELES BEGIN
-        case SPORK_VELES_01_FXTC_CHAIN_START:                     return SPORK_VELES_01_FXTC_CHAIN_START_DEFAULT;
-        case SPORK_VELES_02_UNLIMITED_BLOCK_SUBSIDY_START:        return SPORK_VELES_02_UNLIMITED_BLOCK_SUBSIDY_START_DEFAULT;
-        case SPORK_VELES_03_RECALCULATE_HALVING_PARAMETERS:       return SPORK_VELES_03_RECALCULATE_HALVING_PARAMETERS_DEFAULT;
-        case SPORK_VELES_04_REWARD_UPGRADE_ALPHA_START:           return SPORK_VELES_04_REWARD_UPGRADE_ALPHA_START_DEFAULT;
-        case SPORK_VELES_05A_ADJUST_COST_FACTOR_START:            return SPORK_VELES_05A_ADJUST_COST_FACTOR_START_DEFAULT;
-        case SPORK_VELES_05A_ADJUST_COST_FACTOR_SHA256D:          return SPORK_VELES_05A_ADJUST_COST_FACTOR_SHA256D_DEFAULT;
-        case SPORK_VELES_05A_ADJUST_COST_FACTOR_SCRYPT:           return SPORK_VELES_05A_ADJUST_COST_FACTOR_SCRYPT_DEFAULT;
-        case SPORK_VELES_05A_ADJUST_COST_FACTOR_NIST5:            return SPORK_VELES_05A_ADJUST_COST_FACTOR_NIST5_DEFAULT;
-        case SPORK_VELES_05A_ADJUST_COST_FACTOR_LYRA2Z:           return SPORK_VELES_05A_ADJUST_COST_FACTOR_LYRA2Z_DEFAULT;
-        case SPORK_VELES_05A_ADJUST_COST_FACTOR_X11:              return SPORK_VELES_05A_ADJUST_COST_FACTOR_X11_DEFAULT;
-        case SPORK_VELES_05A_ADJUST_COST_FACTOR_X16R:             return SPORK_VELES_05A_ADJUST_COST_FACTOR_X16R_DEFAULT;
-        case SPORK_VELES_05B_ADJUST_COST_FACTOR_START:            return SPORK_VELES_05B_ADJUST_COST_FACTOR_START_DEFAULT;
-        case SPORK_VELES_05B_ADJUST_COST_FACTOR_SHA256D:          return SPORK_VELES_05B_ADJUST_COST_FACTOR_SHA256D_DEFAULT;
-        case SPORK_VELES_05B_ADJUST_COST_FACTOR_SCRYPT:           return SPORK_VELES_05B_ADJUST_COST_FACTOR_SCRYPT_DEFAULT;
-        case SPORK_VELES_05B_ADJUST_COST_FACTOR_NIST5:            return SPORK_VELES_05B_ADJUST_COST_FACTOR_NIST5_DEFAULT;
-        case SPORK_VELES_05B_ADJUST_COST_FACTOR_LYRA2Z:           return SPORK_VELES_05B_ADJUST_COST_FACTOR_LYRA2Z_DEFAULT;
-        case SPORK_VELES_05B_ADJUST_COST_FACTOR_X11:              return SPORK_VELES_05B_ADJUST_COST_FACTOR_X11_DEFAULT;
-        case SPORK_VELES_05B_ADJUST_COST_FACTOR_X16R:             return SPORK_VELES_05B_ADJUST_COST_FACTOR_X16R_DEFAULT;
-        case SPORK_VELES_06A_DYNAMIC_REWARD_BOOST1_START:         return SPORK_VELES_06A_DYNAMIC_REWARD_BOOST1_START_DEFAULT;
-        case SPORK_VELES_06A_DYNAMIC_REWARD_BOOST1_FACTOR:        return SPORK_VELES_06A_DYNAMIC_REWARD_BOOST1_FACTOR_DEFAULT;
-        case SPORK_VELES_06B_DYNAMIC_REWARD_BOOST2_START:         return SPORK_VELES_06B_DYNAMIC_REWARD_BOOST2_START_DEFAULT;
-        case SPORK_VELES_06B_DYNAMIC_REWARD_BOOST2_FACTOR:        return SPORK_VELES_06B_DYNAMIC_REWARD_BOOST2_FACTOR_DEFAULT;
-        case SPORK_VELES_06C_DYNAMIC_REWARD_BOOST3_START:         return SPORK_VELES_06C_DYNAMIC_REWARD_BOOST3_START_DEFAULT;
-        case SPORK_VELES_06C_DYNAMIC_REWARD_BOOST3_FACTOR:        return SPORK_VELES_06C_DYNAMIC_REWARD_BOOST3_FACTOR_DEFAULT;
-        // VELES END
-        default:
-            LogPrint(BCLog::SPORK, "CSporkManager::GetSporkValue -- Unknown Spork ID %d\n", nSporkID);
-            return -1;
-    }
+    // VELES BEGIN
+    int64_t nValue;
+    if (GetSporkDefault(nSporkID, nValue))
+        return nValue;
 
+    LogPrint(BCLog::SPORK, "CSporkManager::GetSporkValue -- Unknown Spork ID %d\n", nSporkID);
+    return -1;
+    // VELES END
 }
 
 int CSporkManager::GetSporkIDByName(std::string strName)
@@ -448,6 +494,33 @@ bool CSporkManager::SetPrivKey(std::string strPrivKey)
     }
 }
 
+// VELES BEGIN
+void CSporkManager::FlushSporksToDB()
+{
+    std::map<int, CSporkMessage> mapSporksToSave;
+    {
+        LOCK(cs);
+        mapSporksToSave.swap(mapSporksUnsaved);
+    }
+    if (mapSporksToSave.empty() || !pSporkDB) return;
+    if (!pSporkDB->WriteSporks(mapSporksToSave)) {
+        LogPrintf("CSporkManager::FlushSporksToDB -- failed to write %u sporks\n", mapSporksToSave.size());
+    }
+}
+
+size_t CSporkManager::DynamicMemoryUsage() const
+{
+    // the sporks are updated under cs_main
+    LOCK(cs_main);
+
+    size_t nUsage = memusage::DynamicUsage(vchSig) + memusage::DynamicUsage(mapSporksActive);
+    for (const auto& pair : mapSporksActive) {
+        nUsage += pair.second.DynamicMemoryUsage();
+    }
+    return nUsage;
+}
+// VELES END
+
 bool CSporkMessage::Sign(std::string strSignKey)
 {
     CKey key;
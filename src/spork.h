@@ -8,9 +8,22 @@
 #define DASH_SPORK_H
 
 #include <hash.h>
+#include <memusage.h> // VELES
 #include <net.h>
 #include <util/strencodings.h>
 
+// VELES BEGIN
+#include <array>
+#include <atomic>
+#include <map>
+#include <set>
+
+/** Seconds between the writes of the received sporks to the spork database */
+static const int64_t SPORK_DB_FLUSH_INTERVAL = 60;
+/** Spork messages remembered as failing signature verification, forgotten all at once beyond this */
+static const size_t MAX_INVALID_SPORKS = 1000;
+// VELES END
+
 // FXTC BEGIN
 class CSporkDB;
 
@@ -197,6 +210,8 @@ public:
     bool Sign(std::string strSignKey);
     bool CheckSignature();
     void Relay(CConnman& connman);
+
+    size_t DynamicMemoryUsage() const { return memusage::DynamicUsage(vchSig); } // VELES
 };
 
 
@@ -207,23 +222,55 @@ private:
     std::string strMasterPrivKey;
     std::map<int, CSporkMessage> mapSporksActive;
 
+    // VELES BEGIN
+    struct SporkValue {
+        std::atomic<int64_t> nValue;
+        bool fKnown;
+    };
+
+    static const int SPORK_SLOTS = (SPORK_END - SPORK_START + 1) + (SPORK_FXTC_END - SPORK_FXTC_START + 1) + (SPORK_VELES_END - SPORK_VELES_START + 1);
+
+    //! Current value of every known spork by slot, read without locking by the validation and mining threads
+    std::array<SporkValue, SPORK_SLOTS> vSporkValues;
+    std::atomic<uint64_t> nUpdateCount{0};
+
+    static int GetSporkSlot(int nSporkID);
+    void SetSporkValue(int nSporkID, int64_t nValue);
+
+    CCriticalSection cs;
+    //! Sporks accepted since the last write to the spork database, by ID
+    std::map<int, CSporkMessage> mapSporksUnsaved GUARDED_BY(cs);
+    //! Hashes of the spork messages, signature included, whose signature did not verify
+    std::set<uint256> setInvalidSporks GUARDED_BY(cs);
+    // VELES END
+
 public:
 
-    CSporkManager() {}
+    CSporkManager();
 
     // FXTC BEGIN
     void LoadSporksFromDB();
     // FXTC END
+    // VELES BEGIN
+    /** Write the sporks accepted since the last call to the spork database in one batch */
+    void FlushSporksToDB();
+    // VELES END
     void ProcessSpork(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman);
     void ExecuteSpork(int nSporkID, int nValue);
     bool UpdateSpork(int nSporkID, int64_t nValue, CConnman& connman);
 
     bool IsSporkActive(int nSporkID);
     int64_t GetSporkValue(int nSporkID);
+    // VELES BEGIN
+    //! Number of spork values changed since startup, lets callers cache what they derive from them
+    uint64_t GetUpdateCount() const { return nUpdateCount.load(); }
+    // VELES END
     int GetSporkIDByName(std::string strName);
     std::string GetSporkNameByID(int nSporkID);
 
     bool SetPrivKey(std::string strPrivKey);
+
+    size_t DynamicMemoryUsage() const; // VELES
 };
 
 #endif // DASH_SPORK_H
@@ -8,8 +8,19 @@
 
 // FXTC BEGIN
 //CSporkDB::CSporkDB(size_t nCacheSize, bool fMemory, bool fWipe) : CLevelDBWrapper(GetDataDir() / "sporks", nCacheSize, fMemory, fWipe) {}
-CSporkDB::CSporkDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "sporks", nCacheSize, fMemory, fWipe) {}
+//CSporkDB::CSporkDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "sporks", nCacheSize, fMemory, fWipe) {}
 //FXTC END
+// VELES BEGIN
+/** The sporks are a handful of small records read once, a few files are enough */
+static DBProfile SporkDBProfile()
+{
+    DBProfile profile;
+    profile.max_open_files = 64;
+    return profile;
+}
+
+CSporkDB::CSporkDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "sporks", nCacheSize, fMemory, fWipe, false, SporkDBProfile()) {}
+// VELES END
 
 bool CSporkDB::WriteSpork(const int nSporkId, const CSporkMessage& spork)
 {
@@ -18,6 +29,18 @@ bool CSporkDB::WriteSpork(const int nSporkId, const CSporkMessage& spork)
 
 }
 
+// VELES BEGIN
+bool CSporkDB::WriteSporks(const std::map<int, CSporkMessage>& mapSporks)
+{
+    CDBBatch batch(*this);
+    for (const auto& pair : mapSporks) {
+        batch.Write(pair.first, pair.second);
+    }
+    LogPrintf("Wrote %u sporks to database\n", mapSporks.size());
+    return WriteBatch(batch);
+}
+// VELES END
+
 bool CSporkDB::ReadSpork(const int nSporkId, CSporkMessage& spork)
 {
     return Read(nSporkId, spork);
@@ -24,6 +24,7 @@ private:
 
 public:
     bool WriteSpork(const int nSporkId, const CSporkMessage& spork);
+    bool WriteSporks(const std::map<int, CSporkMessage>& mapSporks); // VELES
     bool ReadSpork(const int nSporkId, CSporkMessage& spork);
     bool SporkExists(const int nSporkId);
 };
@@ -0,0 +1,63 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <startuptimings.h>
+
+#include <logging.h>
+#include <util/time.h>
+
+CStartupTimings g_startup_timings;
+
+CStartupTimings::CStartupTimings() : nProcessStart(GetTimeMillis())
+{
+}
+
+void CStartupTimings::Add(const std::string& strName, int64_t nStartMillis)
+{
+    const int64_t nNow = GetTimeMillis();
+    LogPrintf("Startup phase %s: %dms\n", strName, nNow - nStartMillis);
+    LOCK(cs);
+    vPhases.push_back(StartupPhase{strName, nStartMillis - nProcessStart, nNow - nStartMillis});
+}
+
+void CStartupTimings::SetFinished()
+{
+    int64_t nTotal;
+    {
+        LOCK(cs);
+        nFinished = GetTimeMillis();
+        nTotal = nFinished - nProcessStart;
+    }
+    LogPrintf("Startup finished: %dms\n", nTotal);
+}
+
+bool CStartupTimings::IsFinished() const
+{
+    LOCK(cs);
+    return nFinished != 0;
+}
+
+int64_t CStartupTimings::GetTotal() const
+{
+    LOCK(cs);
+    return (nFinished != 0 ? nFinished : GetTimeMillis()) - nProcessStart;
+}
+
+std::vector<StartupPhase> CStartupTimings::GetPhases() const
+{
+    LOCK(cs);
+    return vPhases;
+}
+
+CStartupPhaseTimer::CStartupPhaseTimer(const std::string& strNameIn) :
+    strName(strNameIn), nStart(GetTimeMillis())
+{
+}
+
+void CStartupPhaseTimer::Stop()
+{
+    if (fStopped) return;
+    fStopped = true;
+    g_startup_timings.Add(strName, nStart);
+}
@@ -0,0 +1,65 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef VELES_STARTUPTIMINGS_H
+#define VELES_STARTUPTIMINGS_H
+
+#include <sync.h>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** A phase of the startup, its times in milliseconds since the process started */
+struct StartupPhase
+{
+    std::string strName;
+    int64_t nStart;
+    int64_t nDuration;
+};
+
+/**
+ * Where the startup time goes, logged as each phase ends and reported by getstartupinfo.
+ * The phases run by background threads overlap the ones of the init thread.
+ */
+class CStartupTimings
+{
+public:
+    CStartupTimings();
+
+    /** Record the phase strName, begun at nStartMillis (GetTimeMillis) and ended now */
+    void Add(const std::string& strName, int64_t nStartMillis);
+    /** The node finished starting up */
+    void SetFinished();
+
+    bool IsFinished() const;
+    /** Milliseconds from the process start to the end of the startup, or to now until then */
+    int64_t GetTotal() const;
+    std::vector<StartupPhase> GetPhases() const;
+
+private:
+    mutable Mutex cs;
+    const int64_t nProcessStart;
+    int64_t nFinished GUARDED_BY(cs) = 0;
+    std::vector<StartupPhase> vPhases GUARDED_BY(cs);
+};
+
+/** Records the phase from its construction to Stop() or its destruction */
+class CStartupPhaseTimer
+{
+public:
+    explicit CStartupPhaseTimer(const std::string& strNameIn);
+    ~CStartupPhaseTimer() { Stop(); }
+
+    void Stop();
+
+private:
+    const std::string strName;
+    const int64_t nStart;
+    bool fStopped = false;
+};
+
+extern CStartupTimings g_startup_timings;
+
+#endif // VELES_STARTUPTIMINGS_H
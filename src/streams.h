@@ -196,6 +196,57 @@ public:
     }
 };
 
+// VELES BEGIN
+/** Minimal stream for reading from a range of memory it does not own, such as a
+ *  database value or a memory mapped file
+ */
+class SpanReader
+{
+private:
+    const int m_type;
+    const int m_version;
+    Span<const unsigned char> m_data;
+
+public:
+    SpanReader(int type, int version, Span<const unsigned char> data)
+        : m_type(type), m_version(version), m_data(data) {}
+
+    template<typename T>
+    SpanReader& operator>>(T&& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+
+    int GetVersion() const { return m_version; }
+    int GetType() const { return m_type; }
+
+    size_t size() const { return m_data.size(); }
+    bool empty() const { return m_data.size() == 0; }
+
+    void read(char* dst, size_t n)
+    {
+        if (n == 0) {
+            return;
+        }
+        if (n > (size_t)m_data.size()) {
+            throw std::ios_base::failure("SpanReader::read(): end of data");
+        }
+        memcpy(dst, m_data.data(), n);
+        m_data = m_data.subspan(n);
+    }
+
+    void ignore(size_t n)
+    {
+        if (n > (size_t)m_data.size()) {
+            throw std::ios_base::failure("SpanReader::ignore(): end of data");
+        }
+        m_data = m_data.subspan(n);
+    }
+};
+// VELES END
+
 /** Double ended buffer combining vector and stream-like interfaces.
  *
  * >> and << read and write unformatted data using the above serialization templates.
@@ -299,6 +350,10 @@ public:
     const_reference operator[](size_type pos) const  { return vch[pos + nReadPos]; }
     reference operator[](size_type pos)              { return vch[pos + nReadPos]; }
     void clear()                                     { vch.clear(); nReadPos = 0; }
+    // VELES BEGIN
+    //! Exchange the buffer with vchOther and read from the start of the new one, for reusing allocations
+    void swap_data(vector_type& vchOther)            { vch.swap(vchOther); nReadPos = 0; }
+    // VELES END
     iterator insert(iterator it, const char x=char()) { return vch.insert(it, x); }
     void insert(iterator it, size_type n, const char x) { vch.insert(it, n, x); }
     value_type* data()                               { return vch.data() + nReadPos; }
@@ -502,6 +557,53 @@ public:
     }
 };
 
+// VELES BEGIN
+/** CDataStream on a buffer kept by the current thread, for short-lived serialization such as
+ *  the messages pushed or relayed to peers. The buffer goes back to the thread when the stream
+ *  is destroyed, so the next stream neither allocates it nor has it zeroed when freed. Streams
+ *  created while another one is alive get buffers of their own.
+ *  Not for key material: a buffer is only zeroed when it is finally freed.
+ */
+class CScratchDataStream : public CDataStream
+{
+public:
+    //! Buffers with a larger capacity are freed
+    static constexpr size_t MAX_BUFFER_SIZE = 256 * 1024;
+    //! Buffers kept by every thread
+    static constexpr size_t MAX_BUFFERS = 4;
+
+    CScratchDataStream(int nTypeIn, int nVersionIn) : CDataStream(nTypeIn, nVersionIn)
+    {
+        std::vector<vector_type>& vBuffers = GetBuffers();
+        if (!vBuffers.empty()) {
+            swap_data(vBuffers.back());
+            vBuffers.pop_back();
+        }
+    }
+
+    CScratchDataStream(const CScratchDataStream&) = delete;
+    CScratchDataStream& operator=(const CScratchDataStream&) = delete;
+
+    ~CScratchDataStream()
+    {
+        vector_type buffer;
+        swap_data(buffer);
+        std::vector<vector_type>& vBuffers = GetBuffers();
+        if (buffer.capacity() > 0 && buffer.capacity() <= MAX_BUFFER_SIZE && vBuffers.size() < MAX_BUFFERS) {
+            buffer.clear();
+            vBuffers.push_back(std::move(buffer));
+        }
+    }
+
+private:
+    static std::vector<vector_type>& GetBuffers()
+    {
+        static thread_local std::vector<vector_type> vBuffers;
+        return vBuffers;
+    }
+};
+// VELES END
+
 template <typename IStream>
 class BitStreamReader
 {
@@ -0,0 +1,116 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef VELES_SUPPORT_ALLOCATORS_ARENA_H
+#define VELES_SUPPORT_ALLOCATORS_ARENA_H
+
+#include <algorithm>
+#include <assert.h>
+#include <memory>
+#include <stddef.h>
+#include <vector>
+
+/**
+ * Bump allocator for objects sharing one lifetime, e.g. the transactions of
+ * a block read from disk and dropped once it was looked at.
+ *
+ * Allocations are carved out of large chunks and nothing is given back until
+ * Clear(), which keeps the chunks to serve the next batch of objects from.
+ * Every object has to be freed before that: the count of live allocations is
+ * checked so a reference kept by mistake fails loudly instead of pointing
+ * into reused memory. Not thread safe, each thread needs its own arena.
+ */
+class CMonotonicArena
+{
+private:
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    std::vector<Chunk> vChunks;
+    //! Chunk allocated from and offset of its free space
+    size_t nChunk = 0;
+    size_t nOffset = 0;
+    //! Objects allocated and not freed yet
+    size_t nLive = 0;
+    size_t nChunkSize;
+
+public:
+    static const size_t DEFAULT_CHUNK_SIZE = 1 << 20;
+
+    explicit CMonotonicArena(size_t nChunkSizeIn = DEFAULT_CHUNK_SIZE) : nChunkSize(nChunkSizeIn) {}
+    CMonotonicArena(const CMonotonicArena&) = delete;
+    CMonotonicArena& operator=(const CMonotonicArena&) = delete;
+    ~CMonotonicArena() { assert(nLive == 0); }
+
+    void* Allocate(size_t n, size_t align)
+    {
+        for (; nChunk < vChunks.size(); nChunk++, nOffset = 0) {
+            const size_t nStart = (nOffset + align - 1) & ~(align - 1);
+            if (nStart + n <= vChunks[nChunk].size) {
+                nOffset = nStart + n;
+                nLive++;
+                return vChunks[nChunk].data.get() + nStart;
+            }
+        }
+        // new[] is aligned for any fundamental type
+        const size_t nSize = std::max(nChunkSize, n);
+        vChunks.push_back(Chunk{std::unique_ptr<char[]>(new char[nSize]), nSize});
+        nChunk = vChunks.size() - 1;
+        nOffset = n;
+        nLive++;
+        return vChunks[nChunk].data.get();
+    }
+
+    void Deallocate() { assert(nLive > 0); nLive--; }
+
+    /** Reuse the memory of the chunks, all objects must have been freed */
+    void Clear()
+    {
+        assert(nLive == 0);
+        nChunk = 0;
+        nOffset = 0;
+    }
+
+    size_t GetAllocatedSize() const
+    {
+        size_t nSize = 0;
+        for (const Chunk& chunk : vChunks) {
+            nSize += chunk.size;
+        }
+        return nSize;
+    }
+};
+
+/** Allocator handing out the memory of a CMonotonicArena */
+template <typename T>
+struct arena_allocator {
+    typedef T value_type;
+
+    CMonotonicArena* arena;
+
+    explicit arena_allocator(CMonotonicArena& arenaIn) noexcept : arena(&arenaIn) {}
+    template <typename U>
+    arena_allocator(const arena_allocator<U>& a) noexcept : arena(a.arena)
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(arena->Allocate(sizeof(T) * n, alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n)
+    {
+        arena->Deallocate();
+    }
+
+    template <typename U>
+    bool operator==(const arena_allocator<U>& a) const noexcept { return arena == a.arena; }
+    template <typename U>
+    bool operator!=(const arena_allocator<U>& a) const noexcept { return arena != a.arena; }
+};
+
+#endif // VELES_SUPPORT_ALLOCATORS_ARENA_H
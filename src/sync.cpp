@@ -2,6 +2,12 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+// VELES BEGIN
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+// VELES END
+
 #include <sync.h>
 
 #include <logging.h>
@@ -9,6 +15,12 @@
 
 #include <stdio.h>
 
+// VELES BEGIN
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+#include <tuple>
+// VELES END
 #include <map>
 #include <memory>
 #include <set>
@@ -201,4 +213,174 @@ void DeleteLock(void* cs)
 
 bool g_debug_lockorder_abort = true;
 
-#endif /* DEBUG_LOCKORDER */
\ No newline at end of file
+#endif /* DEBUG_LOCKORDER */
+// VELES BEGIN
+std::atomic<bool> g_lock_stats{false};
+
+namespace {
+//! The sites are told apart by the addresses of the literals LOCK passes, like the lock names of DEBUG_LOCKORDER
+typedef std::tuple<const char*, const char*, int> LockSite;
+
+struct LockStatsData {
+    std::mutex mutex;
+    std::map<LockSite, LockSiteStats> sites;
+};
+
+LockStatsData& GetLockStatsData()
+{
+    // Never destroyed, locks are still taken by the destructors of other globals
+    static LockStatsData* data = new LockStatsData();
+    return *data;
+}
+
+int LockStatsBucket(int64_t nMicros)
+{
+    int nBucket = 0;
+    while (nMicros > 0 && nBucket < LOCK_STATS_BUCKETS - 1) {
+        nMicros >>= 1;
+        ++nBucket;
+    }
+    return nBucket;
+}
+
+LockSiteStats& GetLockSite(LockStatsData& data, const char* pszName, const char* pszFile, int nLine)
+{
+    auto it = data.sites.find(LockSite(pszName, pszFile, nLine));
+    if (it == data.sites.end()) {
+        it = data.sites.emplace(LockSite(pszName, pszFile, nLine), LockSiteStats()).first;
+        it->second.name = pszName;
+        it->second.file = pszFile;
+        it->second.line = nLine;
+    }
+    return it->second;
+}
+} // namespace
+
+int64_t LockStatsTime()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void RecordLockWait(const char* pszName, const char* pszFile, int nLine, bool fContended, bool fAcquired, int64_t nMicros)
+{
+    LockStatsData& data = GetLockStatsData();
+    std::lock_guard<std::mutex> lock(data.mutex);
+    LockSiteStats& stats = GetLockSite(data, pszName, pszFile, nLine);
+    if (fContended) ++stats.contentions;
+    if (fAcquired) ++stats.acquisitions;
+    stats.wait_micros += nMicros;
+    stats.wait_max_micros = std::max<uint64_t>(stats.wait_max_micros, nMicros);
+    ++stats.wait_histogram[LockStatsBucket(nMicros)];
+}
+
+void RecordLockHold(const char* pszName, const char* pszFile, int nLine, int64_t nMicros)
+{
+    LockStatsData& data = GetLockStatsData();
+    std::lock_guard<std::mutex> lock(data.mutex);
+    LockSiteStats& stats = GetLockSite(data, pszName, pszFile, nLine);
+    stats.hold_micros += nMicros;
+    stats.hold_max_micros = std::max<uint64_t>(stats.hold_max_micros, nMicros);
+    ++stats.hold_histogram[LockStatsBucket(nMicros)];
+}
+
+std::vector<LockSiteStats> GetLockStats()
+{
+    std::vector<LockSiteStats> vStats;
+    {
+        LockStatsData& data = GetLockStatsData();
+        std::lock_guard<std::mutex> lock(data.mutex);
+        vStats.reserve(data.sites.size());
+        for (const auto& site : data.sites) {
+            vStats.push_back(site.second);
+        }
+    }
+    std::sort(vStats.begin(), vStats.end(), [](const LockSiteStats& a, const LockSiteStats& b) {
+        return a.wait_micros > b.wait_micros;
+    });
+    return vStats;
+}
+
+std::atomic<int> g_main_lock_wait_counters{0};
+
+#ifdef HAVE_THREAD_LOCAL
+//! Microseconds the thread waited for cs_main, -1 while it does not count them
+static thread_local int64_t g_thread_main_lock_wait = -1;
+#endif
+
+bool CountsLockWait(const char* pszName)
+{
+#ifdef HAVE_THREAD_LOCAL
+    return g_thread_main_lock_wait >= 0 && strcmp(pszName, "cs_main") == 0;
+#else
+    return false;
+#endif
+}
+
+void AddMainLockWait(int64_t nMicros)
+{
+#ifdef HAVE_THREAD_LOCAL
+    g_thread_main_lock_wait += nMicros;
+#endif
+}
+
+MainLockWaitCounter::MainLockWaitCounter()
+{
+#ifdef HAVE_THREAD_LOCAL
+    m_prev_micros = g_thread_main_lock_wait;
+    g_thread_main_lock_wait = 0;
+#else
+    m_prev_micros = -1;
+#endif
+    ++g_main_lock_wait_counters;
+}
+
+MainLockWaitCounter::~MainLockWaitCounter()
+{
+    --g_main_lock_wait_counters;
+#ifdef HAVE_THREAD_LOCAL
+    // The waits of a nested counter are the waits of the enclosing one too
+    g_thread_main_lock_wait = m_prev_micros < 0 ? -1 : m_prev_micros + g_thread_main_lock_wait;
+#endif
+}
+
+int64_t MainLockWaitCounter::Micros() const
+{
+#ifdef HAVE_THREAD_LOCAL
+    return g_thread_main_lock_wait;
+#else
+    return 0;
+#endif
+}
+
+void ResetLockStats()
+{
+    LockStatsData& data = GetLockStatsData();
+    std::lock_guard<std::mutex> lock(data.mutex);
+    data.sites.clear();
+}
+
+bool DumpLockStats(const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) return false;
+    fprintf(file, "%-40s %12s %12s %14s %12s %14s %12s\n", "lock", "acquisitions", "contentions", "wait_us", "wait_max_us", "hold_us", "hold_max_us");
+    for (const LockSiteStats& stats : GetLockStats()) {
+        const std::string strSite = stats.name + " " + stats.file + ":" + itostr(stats.line);
+        fprintf(file, "%-40s %12llu %12llu %14llu %12llu %14llu %12llu\n", strSite.c_str(),
+            (unsigned long long)stats.acquisitions, (unsigned long long)stats.contentions,
+            (unsigned long long)stats.wait_micros, (unsigned long long)stats.wait_max_micros,
+            (unsigned long long)stats.hold_micros, (unsigned long long)stats.hold_max_micros);
+        // Histogram buckets up to the last one used
+        for (const uint64_t* histogram : {stats.wait_histogram, stats.hold_histogram}) {
+            int nLast = LOCK_STATS_BUCKETS - 1;
+            while (nLast > 0 && !histogram[nLast]) --nLast;
+            fprintf(file, "    %s:", histogram == stats.wait_histogram ? "wait" : "hold");
+            for (int i = 0; i <= nLast; ++i) {
+                fprintf(file, " %llu", (unsigned long long)histogram[i]);
+            }
+            fprintf(file, "\n");
+        }
+    }
+    return fclose(file) == 0;
+}
+// VELES END
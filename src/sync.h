@@ -8,9 +8,15 @@
 
 #include <threadsafety.h>
 
+#include <atomic> // VELES
 #include <condition_variable>
 #include <thread>
 #include <mutex>
+// VELES BEGIN
+#include <stdint.h>
+#include <string>
+#include <vector>
+// VELES END
 
 
 ////////////////////////////////////////////////
@@ -114,14 +120,102 @@ typedef AnnotatedMixin<std::mutex> Mutex;
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+// VELES BEGIN
+/** Buckets of the lock wait and hold time histograms, bucket i > 0 counts the times from 2^(i-1) up to 2^i microseconds */
+static const int LOCK_STATS_BUCKETS = 24;
+/** File in the data directory the lock stats are written to at shutdown and by dumplockstats */
+static const char* const LOCK_STATS_FILENAME = "lockstats.txt";
+static const bool DEFAULT_LOCK_STATS = false;
+
+/** Contention of the locks taken at one LOCK site, recorded with -lockstats */
+struct LockSiteStats {
+    std::string name;
+    std::string file;
+    int line = 0;
+    uint64_t acquisitions = 0;
+    //! Acquisitions that waited for another thread, and tries that failed
+    uint64_t contentions = 0;
+    uint64_t wait_micros = 0;
+    uint64_t wait_max_micros = 0;
+    uint64_t hold_micros = 0;
+    uint64_t hold_max_micros = 0;
+    uint64_t wait_histogram[LOCK_STATS_BUCKETS] = {};
+    uint64_t hold_histogram[LOCK_STATS_BUCKETS] = {};
+};
+
+/** Whether the locks record their wait and hold times */
+extern std::atomic<bool> g_lock_stats;
+
+int64_t LockStatsTime();
+void RecordLockWait(const char* pszName, const char* pszFile, int nLine, bool fContended, bool fAcquired, int64_t nMicros);
+void RecordLockHold(const char* pszName, const char* pszFile, int nLine, int64_t nMicros);
+/** The recorded lock sites, the ones waited for the longest first */
+std::vector<LockSiteStats> GetLockStats();
+void ResetLockStats();
+/** Write the recorded lock sites as a table to the file at path */
+bool DumpLockStats(const std::string& path);
+
+/** Number of MainLockWaitCounter instances, the locks look for a counter of their thread only while there are any */
+extern std::atomic<int> g_main_lock_wait_counters;
+/** Whether the current thread counts its waits for the lock named pszName */
+bool CountsLockWait(const char* pszName);
+void AddMainLockWait(int64_t nMicros);
+
+/**
+ * Counts the time the current thread waits for cs_main while the counter exists, to tell how
+ * much of an RPC call was spent waiting for it. Without thread_local support nothing is counted.
+ */
+class MainLockWaitCounter
+{
+public:
+    MainLockWaitCounter();
+    ~MainLockWaitCounter();
+    /** Microseconds waited for cs_main so far */
+    int64_t Micros() const;
+
+private:
+    //! Count of the enclosing counter of the thread, -1 when there is none
+    int64_t m_prev_micros;
+};
+// VELES END
+
 /** Wrapper around std::unique_lock style lock for Mutex. */
 template <typename Mutex, typename Base = typename Mutex::UniqueLock>
 class SCOPED_LOCKABLE UniqueLock : public Base
 {
 private:
+    // VELES BEGIN
+    //! Site and time the lock was taken at, when recording lock stats
+    const char* m_stats_name = nullptr;
+    const char* m_stats_file = nullptr;
+    int m_stats_line = 0;
+    int64_t m_stats_locked = 0;
+    // VELES END
+
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(Base::mutex()));
+        // VELES BEGIN
+        const bool fStats = g_lock_stats.load(std::memory_order_relaxed);
+        const bool fCountWait = g_main_lock_wait_counters.load(std::memory_order_relaxed) > 0 && CountsLockWait(pszName);
+        if (fStats || fCountWait) {
+            const int64_t nStart = LockStatsTime();
+            const bool fContended = !Base::try_lock();
+            if (fContended)
+                Base::lock();
+            const int64_t nLocked = LockStatsTime();
+            if (fCountWait)
+                AddMainLockWait(nLocked - nStart);
+            if (fStats) {
+                m_stats_locked = nLocked;
+                RecordLockWait(pszName, pszFile, nLine, fContended, true, nLocked - nStart);
+                m_stats_name = pszName;
+                m_stats_file = pszFile;
+                m_stats_line = nLine;
+            }
+            return;
+        }
+        // VELES END
 #ifdef DEBUG_LOCKCONTENTION
         if (!Base::try_lock()) {
             PrintLockContention(pszName, pszFile, nLine);
@@ -138,6 +232,17 @@ private:
         Base::try_lock();
         if (!Base::owns_lock())
             LeaveCritical();
+        // VELES BEGIN
+        if (g_lock_stats.load(std::memory_order_relaxed)) {
+            RecordLockWait(pszName, pszFile, nLine, !Base::owns_lock(), Base::owns_lock(), 0);
+            if (Base::owns_lock()) {
+                m_stats_locked = LockStatsTime();
+                m_stats_name = pszName;
+                m_stats_file = pszFile;
+                m_stats_line = nLine;
+            }
+        }
+        // VELES END
         return Base::owns_lock();
     }
 
@@ -163,6 +268,11 @@ public:
 
     ~UniqueLock() UNLOCK_FUNCTION()
     {
+        // VELES BEGIN
+        // Includes the time the lock was released in between, by a condition variable or REVERSE_LOCK
+        if (m_stats_locked && Base::owns_lock())
+            RecordLockHold(m_stats_name, m_stats_file, m_stats_line, LockStatsTime() - m_stats_locked);
+        // VELES END
         if (Base::owns_lock())
             LeaveCritical();
     }
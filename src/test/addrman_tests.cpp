@@ -6,9 +6,11 @@
 #include <string>
 #include <boost/test/unit_test.hpp>
 
+#include <clientversion.h> // VELES
 #include <hash.h>
 #include <netbase.h>
 #include <random.h>
+#include <streams.h> // VELES
 
 class CAddrManTest : public CAddrMan
 {
@@ -222,6 +224,108 @@ BOOST_AUTO_TEST_CASE(addrman_select)
     BOOST_CHECK_EQUAL(ports.size(), 3U);
 }
 
+// VELES BEGIN
+BOOST_AUTO_TEST_CASE(addrman_masternode_tier)
+{
+    CAddrManTest addrman;
+
+    // Test: Select from an empty tier returns nothing.
+    BOOST_CHECK_EQUAL(addrman.MasternodeTierSize(), 0U);
+    BOOST_CHECK_EQUAL(addrman.SelectMasternode().ToString(), "[::]:0");
+
+    // Test: Duplicates and unroutable addresses are not part of the tier.
+    CService addr1 = ResolveService("250.1.1.1", 8333);
+    CService addr2 = ResolveService("250.2.2.2", 8333);
+    std::vector<CAddress> vAddr;
+    vAddr.push_back(CAddress(addr1, NODE_NETWORK));
+    vAddr.push_back(CAddress(addr2, NODE_NETWORK));
+    vAddr.push_back(CAddress(addr1, NODE_NETWORK));
+    vAddr.push_back(CAddress(ResolveService("127.0.0.1", 8333), NODE_NETWORK));
+    addrman.SetMasternodeAddresses(vAddr);
+    BOOST_CHECK_EQUAL(addrman.MasternodeTierSize(), 2U);
+    BOOST_CHECK(addrman.IsMasternodeAddress(addr1));
+    BOOST_CHECK(!addrman.IsMasternodeAddress(ResolveIP("250.3.3.3")));
+
+    // Test: Select only picks tier addresses, tier is independent of the tables.
+    BOOST_CHECK_EQUAL(addrman.size(), 0U);
+    std::set<std::string> picked;
+    for (int i = 0; i < 20; ++i) {
+        picked.insert(addrman.SelectMasternode().ToString());
+    }
+    BOOST_CHECK_EQUAL(picked.size(), 2U);
+    BOOST_CHECK(picked.count("250.1.1.1:8333"));
+
+    // Test: The last attempt is remembered across refreshes of the tier.
+    addrman.Attempt(addr1, true, 1000);
+    vAddr.resize(1);
+    addrman.SetMasternodeAddresses(vAddr);
+    BOOST_CHECK_EQUAL(addrman.MasternodeTierSize(), 1U);
+    CAddrInfo info = addrman.SelectMasternode();
+    BOOST_CHECK_EQUAL(info.nLastTry, 1000);
+    BOOST_CHECK(!addrman.IsMasternodeAddress(addr2));
+}
+
+BOOST_AUTO_TEST_CASE(addrman_journal)
+{
+    CAddrManTest addrman;
+    CNetAddr source1 = ResolveIP("252.2.2.2");
+    CNetAddr source2 = ResolveIP("252.2.2.3");
+
+    for (unsigned int i = 1; i < 250; i++) {
+        CService addr = ResolveService(strprintf("%i.%i.1.1", 40 + i % 8, i), 8333);
+        addrman.Add(CAddress(addr, NODE_NONE), source1);
+        if (i % 4 == 0)
+            addrman.Good(addr);
+    }
+
+    // Test: The tables as loaded from peers.dat have no changes.
+    CDataStream ssPeers(SER_DISK, CLIENT_VERSION);
+    ssPeers << addrman;
+    CAddrManTest addrmanLoaded;
+    ssPeers >> addrmanLoaded;
+    CDataStream ssChanges(SER_DISK, CLIENT_VERSION);
+    BOOST_CHECK(addrman.SerializeChanges(ssChanges));
+    BOOST_CHECK_EQUAL(ssChanges.size(), 1U);
+    ssChanges.clear();
+
+    // Test: Added, promoted and attempted entries are journaled.
+    for (unsigned int i = 1; i < 250; i++) {
+        addrman.Add(CAddress(ResolveService(strprintf("%i.%i.2.2", 40 + i % 8, i), 8333), NODE_NONE), i % 2 ? source1 : source2);
+        if (i % 3 == 0)
+            addrman.Good(ResolveService(strprintf("%i.%i.1.1", 40 + i % 8, i), 8333));
+        if (i % 5 == 0)
+            addrman.Attempt(ResolveService(strprintf("%i.%i.1.1", 40 + i % 8, i), 8333), true);
+    }
+    BOOST_CHECK(addrman.SerializeChanges(ssChanges));
+    BOOST_CHECK(ssChanges.size() > 1U);
+    addrmanLoaded.UnserializeChanges(ssChanges);
+    BOOST_CHECK_EQUAL(addrmanLoaded.size(), addrman.size());
+    for (unsigned int i = 1; i < 250; i++) {
+        CAddrInfo* pinfo = addrman.Find(ResolveIP(strprintf("%i.%i.1.1", 40 + i % 8, i)));
+        CAddrInfo* pinfoLoaded = addrmanLoaded.Find(ResolveIP(strprintf("%i.%i.1.1", 40 + i % 8, i)));
+        BOOST_CHECK_EQUAL(pinfo == nullptr, pinfoLoaded == nullptr);
+        if (!pinfo || !pinfoLoaded)
+            continue;
+        CDataStream ssInfo(SER_DISK, CLIENT_VERSION), ssInfoLoaded(SER_DISK, CLIENT_VERSION);
+        ssInfo << *pinfo;
+        ssInfoLoaded << *pinfoLoaded;
+        BOOST_CHECK(ssInfo.str() == ssInfoLoaded.str());
+    }
+
+    // Test: Same counts of new and tried entries in the same buckets, the serialized
+    // tables only differ by the order of the entries.
+    CDataStream ssTables(SER_DISK, CLIENT_VERSION), ssTablesLoaded(SER_DISK, CLIENT_VERSION);
+    ssTables << addrman;
+    ssTablesLoaded << addrmanLoaded;
+    BOOST_CHECK_EQUAL(ssTables.size(), ssTablesLoaded.size());
+    BOOST_CHECK(ssTables.str().substr(0, 42) == ssTablesLoaded.str().substr(0, 42));
+
+    // Test: Changes can't be journaled once the tables are cleared.
+    addrman.Clear();
+    BOOST_CHECK(!addrman.SerializeChanges(ssChanges));
+}
+// VELES END
+
 BOOST_AUTO_TEST_CASE(addrman_new_collisions)
 {
     CAddrManTest addrman;
@@ -0,0 +1,90 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <algostats.h>
+#include <arith_uint256.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <primitives/block.h>
+#include <validation.h>
+#include <versionbits.h>
+#include <test/test_bitcoin.h>
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(algostats_tests, BasicTestingSetup)
+
+static const int32_t algos[] = {ALGO_SHA256D, ALGO_SCRYPT, ALGO_LYRA2Z, ALGO_X11, ALGO_X16R, ALGO_NIST5};
+
+static void BuildChain(std::vector<CBlockIndex>& vIndex, std::vector<uint256>& vHash, CBlockIndex* pindexFork, uint64_t nSalt)
+{
+    for (size_t i = 0; i < vIndex.size(); i++) {
+        vHash[i] = ArithToUint256(arith_uint256(nSalt + i));
+        vIndex[i].phashBlock = &vHash[i];
+        vIndex[i].pprev = i ? &vIndex[i - 1] : pindexFork;
+        vIndex[i].nHeight = vIndex[i].pprev ? vIndex[i].pprev->nHeight + 1 : 0;
+        vIndex[i].nVersion = VERSIONBITS_TOP_BITS | algos[InsecureRandRange(5)];
+        vIndex[i].nBits = 0x1e0ffff0 - InsecureRandRange(0x10000);
+        vIndex[i].BuildSkip();
+        vIndex[i].BuildPrevAlgo();
+    }
+}
+
+// The rolling totals must match walking nBlocks back from the tip
+static void CheckTotals(CAlgoStats& stats, const CBlockIndex* pindexTip, int nWindow24h, int nWindow7d)
+{
+    for (int32_t nAlgo : algos) {
+        CAlgoStats::Totals expected;
+        int nBlocks = 0;
+        for (const CBlockIndex* pb = pindexTip; pb->pprev && nBlocks < nWindow7d; pb = pb->pprev, nBlocks++) {
+            if ((pb->nVersion & ALGO_VERSION_MASK) != nAlgo)
+                continue;
+            const CAmount nReward = GetBlockSubsidy(pb->nHeight, pb->GetBlockHeader(), Params().GetConsensus(), false);
+            expected.nBlocks7d++;
+            expected.nRewards7d += nReward;
+            if (nBlocks < nWindow24h) {
+                expected.nBlocks24h++;
+                expected.nRewards24h += nReward;
+            }
+        }
+        const CAlgoStats::Totals totals = stats.GetTotals(nAlgo);
+        BOOST_CHECK_EQUAL(totals.nBlocks24h, expected.nBlocks24h);
+        BOOST_CHECK_EQUAL(totals.nBlocks7d, expected.nBlocks7d);
+        BOOST_CHECK_EQUAL(totals.nRewards24h, expected.nRewards24h);
+        BOOST_CHECK_EQUAL(totals.nRewards7d, expected.nRewards7d);
+
+        const CBlockIndex* pb = pindexTip;
+        while ((pb->nVersion & ALGO_VERSION_MASK) != nAlgo && pb->pprev)
+            pb = pb->pprev;
+        BOOST_CHECK(stats.GetLastBlock(nAlgo) == pb);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(algostats_rolling_window)
+{
+    std::vector<CBlockIndex> vMain(300), vFork(80);
+    std::vector<uint256> vHashMain(vMain.size()), vHashFork(vFork.size());
+    BuildChain(vMain, vHashMain, nullptr, 0);
+    BuildChain(vFork, vHashFork, &vMain[250], 1000);
+
+    CAlgoStats stats(20, 50);
+    LOCK(cs_main);
+
+    // Grow from genesis past both window lengths one block at a time
+    for (size_t i = 0; i < 120; i++) {
+        stats.SetTip(&vMain[i]);
+        CheckTotals(stats, &vMain[i], 20, 50);
+    }
+
+    // Jump forward, unwind, reorganize onto a fork and back
+    const CBlockIndex* tips[] = {&vMain[299], &vMain[280], &vFork[10], &vFork[79], &vMain[260], &vMain[299], &vMain[100], &vFork[0], &vMain[5], &vMain[0]};
+    for (const CBlockIndex* pindex : tips) {
+        stats.SetTip(pindex);
+        CheckTotals(stats, pindex, 20, 50);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
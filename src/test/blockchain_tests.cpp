@@ -2,8 +2,15 @@
 
 #include <stdlib.h>
 
+#include <blockdelta.h>
+#include <blockimport.h>
+#include <chainparams.h>
 #include <rpc/blockchain.h>
+#include <script/interpreter.h>
 #include <test/test_bitcoin.h>
+#include <validation.h>
+
+#include <map>
 
 /* Equality between doubles is imprecise. Comparison should be done
  * with a small threshold of tolerance, rather than exact equality.
@@ -68,4 +75,114 @@ BOOST_AUTO_TEST_CASE(get_difficulty_for_very_high_target)
     TestDifficulty(0x12345678, 5913134931067755359633408.0);
 }
 
+// The block index read back from disk is linked and has the same chain work
+BOOST_FIXTURE_TEST_CASE(load_block_index, TestChain100Setup)
+{
+    gArgs.ForceSetArg("-importthreads", "3");
+    std::map<uint256, std::pair<int, arith_uint256>> mapExpected;
+    uint256 hashTip;
+    {
+        LOCK(cs_main);
+        for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex)
+            mapExpected.emplace(item.first, std::make_pair(item.second->nHeight, item.second->nChainWork));
+        hashTip = chainActive.Tip()->GetBlockHash();
+    }
+    FlushStateToDisk();
+    UnloadBlockIndex();
+
+    LOCK(cs_main);
+    BOOST_REQUIRE(LoadBlockIndex(Params()));
+    BOOST_REQUIRE(LoadChainTip(Params()));
+    BOOST_CHECK_EQUAL(mapBlockIndex.size(), mapExpected.size());
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == hashTip);
+    for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex) {
+        const CBlockIndex* pindex = item.second;
+        BOOST_REQUIRE(mapExpected.count(item.first));
+        BOOST_CHECK(pindex->GetBlockHash() == item.first);
+        BOOST_CHECK_EQUAL(pindex->nHeight, mapExpected[item.first].first);
+        BOOST_CHECK(pindex->nChainWork == mapExpected[item.first].second);
+        if (pindex->nHeight > 0) {
+            BOOST_REQUIRE(pindex->pprev);
+            BOOST_CHECK_EQUAL(pindex->pprev->nHeight, pindex->nHeight - 1);
+            BOOST_CHECK(pindex->pskip && pindex->pskip->nHeight < pindex->nHeight);
+        }
+    }
+    gArgs.ForceSetArg("-importthreads", std::to_string(DEFAULT_IMPORT_THREADS));
+}
+
+// The deep checks of the tip blocks leave the chainstate alone
+BOOST_FIXTURE_TEST_CASE(verify_db_background, TestChain100Setup)
+{
+    uint256 hashBest;
+    {
+        LOCK(cs_main);
+        hashBest = pcoinsTip->GetBestBlock();
+    }
+    BOOST_CHECK(CVerifyDB().VerifyDBBackground(Params(), 4, 20, 0));
+
+    const BackgroundVerifyStatus status = GetBackgroundVerifyStatus();
+    BOOST_CHECK_EQUAL(status.state, BackgroundVerifyStatus::DONE);
+    BOOST_CHECK_EQUAL(status.nCheckLevel, 4);
+    BOOST_CHECK_EQUAL(status.nCheckDepth, 20);
+    BOOST_CHECK_EQUAL(status.nProgress, 100);
+    BOOST_CHECK(status.strError.empty());
+    LOCK(cs_main);
+    BOOST_CHECK(pcoinsTip->GetBestBlock() == hashBest);
+}
+
+// The delta of a block has the spent outputs from the undo data and the created ones
+BOOST_FIXTURE_TEST_CASE(block_delta, TestChain100Setup)
+{
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = COutPoint(m_coinbase_txns[0]->GetHash(), 0);
+    spend.vout.resize(2);
+    spend.vout[0].nValue = 11 * CENT;
+    spend.vout[0].scriptPubKey = scriptPubKey;
+    spend.vout[1].nValue = 0;
+    spend.vout[1].scriptPubKey = CScript() << OP_RETURN;
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, spend, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+    BOOST_REQUIRE(coinbaseKey.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << vchSig;
+
+    const CBlock block = CreateAndProcessBlock({spend}, scriptPubKey);
+    const CBlockIndex* pindex;
+    {
+        LOCK(cs_main);
+        BOOST_REQUIRE(chainActive.Tip()->GetBlockHash() == block.GetHash());
+        pindex = chainActive.Tip();
+    }
+
+    CBlockDelta delta;
+    BOOST_REQUIRE(GetBlockDelta(block, pindex, true, delta));
+    BOOST_CHECK(delta.hash == block.GetHash());
+    BOOST_CHECK_EQUAL(delta.nHeight, pindex->nHeight);
+    BOOST_REQUIRE_EQUAL(delta.vtx.size(), 2U);
+    BOOST_CHECK(delta.vtx[0].txid == block.vtx[0]->GetHash());
+    BOOST_CHECK(delta.vtx[0].vSpent.empty());
+    BOOST_CHECK(delta.vtx[0].vCreated[0].role == PayeeRole::NONE);
+
+    const CTxDelta& txdelta = delta.vtx[1];
+    BOOST_CHECK(txdelta.txid == spend.GetHash());
+    BOOST_REQUIRE_EQUAL(txdelta.vSpent.size(), 1U);
+    BOOST_CHECK(txdelta.vSpent[0].prevout == spend.vin[0].prevout);
+    BOOST_CHECK(txdelta.vSpent[0].out == m_coinbase_txns[0]->vout[0]);
+    // The OP_RETURN output is left out
+    BOOST_REQUIRE_EQUAL(txdelta.vCreated.size(), 1U);
+    BOOST_CHECK_EQUAL(txdelta.vCreated[0].n, 0U);
+    BOOST_CHECK(txdelta.vCreated[0].out == spend.vout[0]);
+
+    // Published as is by -zmqpubblockdelta
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << delta;
+    CBlockDelta deltaRead;
+    ss >> deltaRead;
+    BOOST_CHECK(deltaRead.vtx[1].vSpent[0].out == txdelta.vSpent[0].out);
+    BOOST_CHECK(deltaRead.vtx[0].vCreated.size() == delta.vtx[0].vCreated.size());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
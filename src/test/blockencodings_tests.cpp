@@ -339,6 +339,51 @@ BOOST_AUTO_TEST_CASE(EmptyBlockRoundTripTest)
     }
 }
 
+// VELES BEGIN
+BOOST_AUTO_TEST_CASE(LockedTxnRoundTripTest)
+{
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+    CBlock block(BuildBlockTestCase());
+
+    LOCK2(cs_main, pool.cs);
+    pool.addUnchecked(entry.FromTx(block.vtx[2]));
+
+    CBlockHeaderAndShortTxIDs shortIDs(block, true);
+
+    // Locked txn alone complete the block
+    {
+        std::vector<std::pair<uint256, CTransactionRef>> locked_txn;
+        locked_txn.emplace_back(block.vtx[1]->GetWitnessHash(), block.vtx[1]);
+        locked_txn.emplace_back(block.vtx[2]->GetWitnessHash(), block.vtx[2]);
+
+        PartiallyDownloadedBlock partialBlock(&pool);
+        BOOST_CHECK(partialBlock.InitData(shortIDs, extra_txn, locked_txn) == READ_STATUS_OK);
+        BOOST_CHECK(partialBlock.IsTxAvailable(1));
+        BOOST_CHECK(partialBlock.IsTxAvailable(2));
+
+        CBlock block2;
+        BOOST_CHECK(partialBlock.FillBlock(block2, {}) == READ_STATUS_OK);
+        BOOST_CHECK_EQUAL(block.GetHash().ToString(), block2.GetHash().ToString());
+    }
+
+    // A locked tx found in the mempool again is not a short id collision
+    {
+        std::vector<std::pair<uint256, CTransactionRef>> locked_txn;
+        locked_txn.emplace_back(block.vtx[2]->GetWitnessHash(), block.vtx[2]);
+
+        PartiallyDownloadedBlock partialBlock(&pool);
+        BOOST_CHECK(partialBlock.InitData(shortIDs, extra_txn, locked_txn) == READ_STATUS_OK);
+        BOOST_CHECK(!partialBlock.IsTxAvailable(1));
+        BOOST_CHECK( partialBlock.IsTxAvailable(2));
+
+        CBlock block2;
+        BOOST_CHECK(partialBlock.FillBlock(block2, {block.vtx[1]}) == READ_STATUS_OK);
+        BOOST_CHECK_EQUAL(block.GetHash().ToString(), block2.GetHash().ToString());
+    }
+}
+// VELES END
+
 BOOST_AUTO_TEST_CASE(TransactionsRequestSerializationTest) {
     BlockTransactionsRequest req1;
     req1.blockhash = InsecureRand256();
@@ -407,4 +452,83 @@ BOOST_AUTO_TEST_CASE(TransactionsRequestDeserializationOverflowTest) {
     }
 }
 
+// VELES BEGIN
+BOOST_AUTO_TEST_CASE(CompressedHeadersRoundTrip)
+{
+    static const int32_t algos[] = {ALGO_SHA256D, ALGO_SCRYPT, ALGO_LYRA2Z, ALGO_X11, ALGO_X16R};
+    std::vector<CBlockHeader> headers;
+    uint32_t nTime = 1546300800;
+    for (int i = 0; i < 200; i++) {
+        CBlockHeader header;
+        const int32_t nAlgo = algos[InsecureRandRange(5)];
+        header.nVersion = 0x20000000 | nAlgo | (i == 100 ? 0x10 : 0);
+        header.hashPrevBlock = headers.empty() || i == 150 ? InsecureRand256() : headers.back().GetHash();
+        header.hashMerkleRoot = InsecureRand256();
+        // Times aren't ordered and may go back
+        nTime += InsecureRandRange(600) - 120;
+        header.nTime = nTime;
+        header.nBits = 0x1d00ffff - (nAlgo >> 8) - (i % 50 == 0 ? i : 0);
+        header.nNonce = InsecureRand32();
+        headers.push_back(header);
+    }
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << CompressedHeaders(headers);
+    CDataStream streamFull(SER_NETWORK, PROTOCOL_VERSION);
+    streamFull << headers;
+    BOOST_CHECK(stream.size() < streamFull.size() * 6 / 10);
+
+    CompressedHeaders compressed;
+    stream >> compressed;
+    BOOST_CHECK(stream.empty());
+    BOOST_REQUIRE_EQUAL(compressed.headers.size(), headers.size());
+    for (size_t i = 0; i < headers.size(); i++) {
+        BOOST_CHECK(compressed.headers[i].GetHash() == headers[i].GetHash());
+    }
+
+    // Timestamps at the ends of the range
+    headers.resize(2);
+    headers[0].nTime = std::numeric_limits<uint32_t>::max();
+    headers[1].nTime = 0;
+    stream << CompressedHeaders(headers);
+    stream >> compressed;
+    BOOST_REQUIRE_EQUAL(compressed.headers.size(), 2U);
+    BOOST_CHECK(compressed.headers[0].GetHash() == headers[0].GetHash());
+    BOOST_CHECK(compressed.headers[1].GetHash() == headers[1].GetHash());
+}
+
+BOOST_AUTO_TEST_CASE(CompressedHeadersMalformed)
+{
+    CompressedHeaders compressed;
+
+    // The first header must carry its previous block hash
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(stream, 1);
+    ser_writedata8(stream, CompressedHeaders::HEADER_VERSION | CompressedHeaders::HEADER_BITS);
+    stream << int32_t(0x20000000) << InsecureRand256() << VARINT(uint64_t(2)) << uint32_t(0x1d00ffff) << uint32_t(0);
+    BOOST_CHECK_THROW(stream >> compressed, std::ios_base::failure);
+
+    // The bits of an algo can't be left out before a header of that algo was sent
+    stream.clear();
+    WriteCompactSize(stream, 1);
+    ser_writedata8(stream, CompressedHeaders::HEADER_PREV_HASH | CompressedHeaders::HEADER_VERSION);
+    stream << int32_t(0x20000000) << InsecureRand256() << InsecureRand256() << VARINT(uint64_t(2)) << uint32_t(0);
+    BOOST_CHECK_THROW(stream >> compressed, std::ios_base::failure);
+
+    // Nor the version
+    stream.clear();
+    WriteCompactSize(stream, 1);
+    ser_writedata8(stream, CompressedHeaders::HEADER_PREV_HASH | CompressedHeaders::HEADER_BITS | (1 << CompressedHeaders::HEADER_ALGO_SHIFT));
+    stream << InsecureRand256() << InsecureRand256() << VARINT(uint64_t(2)) << uint32_t(0x1d00ffff) << uint32_t(0);
+    BOOST_CHECK_THROW(stream >> compressed, std::ios_base::failure);
+
+    // Times must stay within 32 bits
+    stream.clear();
+    WriteCompactSize(stream, 1);
+    ser_writedata8(stream, CompressedHeaders::HEADER_PREV_HASH | CompressedHeaders::HEADER_VERSION | CompressedHeaders::HEADER_BITS);
+    stream << int32_t(0x20000000) << InsecureRand256() << InsecureRand256() << VARINT(uint64_t(1)) << uint32_t(0x1d00ffff) << uint32_t(0);
+    BOOST_CHECK_THROW(stream >> compressed, std::ios_base::failure);
+}
+// VELES END
+
 BOOST_AUTO_TEST_SUITE_END()
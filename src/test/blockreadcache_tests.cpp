@@ -0,0 +1,70 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockreadcache.h>
+#include <chain.h>
+#include <core_memusage.h>
+#include <memusage.h>
+#include <primitives/block.h>
+#include <primitives/transaction.h>
+#include <test/test_bitcoin.h>
+
+#include <memory>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockreadcache_tests, BasicTestingSetup)
+
+static std::shared_ptr<const CBlock> MakeBlock(uint32_t nNonce)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = nNonce;
+    std::shared_ptr<CBlock> block = std::make_shared<CBlock>();
+    block->nNonce = nNonce;
+    block->vtx.push_back(MakeTransactionRef(tx));
+    return block;
+}
+
+BOOST_AUTO_TEST_CASE(blockreadcache_lru)
+{
+    CBlockReadCache cache;
+    std::shared_ptr<const CBlock> blocks[3] = {MakeBlock(1), MakeBlock(2), MakeBlock(3)};
+    const CDiskBlockPos pos[3] = {CDiskBlockPos(0, 8), CDiskBlockPos(0, 1000), CDiskBlockPos(1, 8)};
+    size_t usage = memusage::MallocUsage(sizeof(CBlock)) + RecursiveDynamicUsage(*blocks[0]);
+
+    // Disabled until a limit is set
+    cache.Insert(pos[0], blocks[0]);
+    BOOST_CHECK(!cache.Get(pos[0]));
+    BOOST_CHECK_EQUAL(cache.GetStats().entries, 0U);
+
+    cache.SetLimit(2 * usage);
+    cache.Insert(pos[0], blocks[0]);
+    cache.Insert(pos[1], blocks[1]);
+    BOOST_CHECK_EQUAL(cache.GetStats().usage, 2 * usage);
+    BOOST_CHECK(cache.Get(pos[0]) == blocks[0]);
+
+    // The least recently used block makes room
+    cache.Insert(pos[2], blocks[2]);
+    BOOST_CHECK(!cache.Get(pos[1]));
+    BOOST_CHECK(cache.Get(pos[0]) == blocks[0]);
+    BOOST_CHECK(cache.Get(pos[2]) == blocks[2]);
+
+    CBlockReadCache::Stats stats = cache.GetStats();
+    BOOST_CHECK_EQUAL(stats.entries, 2U);
+    BOOST_CHECK_EQUAL(stats.hits, 3U);
+    BOOST_CHECK_EQUAL(stats.misses, 1U);
+
+    // Blocks of pruned files are dropped
+    cache.EraseFile(0);
+    BOOST_CHECK(!cache.Get(pos[0]));
+    BOOST_CHECK(cache.Get(pos[2]) == blocks[2]);
+    BOOST_CHECK_EQUAL(cache.GetStats().usage, usage);
+
+    cache.SetLimit(0);
+    BOOST_CHECK_EQUAL(cache.GetStats().entries, 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
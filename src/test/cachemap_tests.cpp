@@ -0,0 +1,178 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <cachemap.h>
+#include <cachemultimap.h>
+#include <clientversion.h>
+#include <streams.h>
+#include <test/test_bitcoin.h>
+
+#include <list>
+#include <map>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(cachemap_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(cachemap_insert_evict)
+{
+    CacheMap<uint256, int> cache(3);
+    const uint256 a = InsecureRand256(), b = InsecureRand256(), c = InsecureRand256(), d = InsecureRand256();
+    cache.Insert(a, 1);
+    cache.Insert(b, 2);
+    cache.Insert(c, 3);
+    // Replacing a value does not make it recent
+    cache.Insert(a, 4);
+    BOOST_CHECK_EQUAL(cache.GetSize(), 3U);
+
+    cache.Insert(d, 5);
+    BOOST_CHECK_EQUAL(cache.GetSize(), 3U);
+    BOOST_CHECK(!cache.HasKey(a));
+    int value;
+    BOOST_CHECK(cache.Get(d, value));
+    BOOST_CHECK_EQUAL(value, 5);
+
+    std::vector<int> values;
+    for (const auto& item : cache.GetItemList()) values.push_back(item.value);
+    BOOST_CHECK(values == std::vector<int>({5, 3, 2}));
+
+    cache.Erase(c);
+    BOOST_CHECK(!cache.Get(c, value));
+    BOOST_CHECK_EQUAL(cache.GetSize(), 2U);
+    cache.Clear();
+    BOOST_CHECK_EQUAL(cache.GetSize(), 0U);
+    BOOST_CHECK(!cache.HasKey(d));
+}
+
+BOOST_AUTO_TEST_CASE(cachemap_random_ops)
+{
+    // Compare with a plain map while the index grows and entries are moved back on erase
+    CacheMap<uint32_t, uint32_t> cache(100000);
+    std::map<uint32_t, uint32_t> reference;
+    for (int i = 0; i < 20000; i++) {
+        const uint32_t key = InsecureRandRange(2000);
+        if (InsecureRandBool()) {
+            cache.Insert(key, i);
+            reference[key] = i;
+        } else {
+            cache.Erase(key);
+            reference.erase(key);
+        }
+    }
+    BOOST_CHECK_EQUAL(cache.GetSize(), reference.size());
+    for (uint32_t key = 0; key < 2000; key++) {
+        uint32_t value;
+        const bool found = cache.Get(key, value);
+        BOOST_CHECK_EQUAL(found, reference.count(key) > 0);
+        if (found) BOOST_CHECK_EQUAL(value, reference[key]);
+    }
+
+    CacheMap<uint32_t, uint32_t> copy(cache);
+    BOOST_CHECK_EQUAL(copy.GetSize(), reference.size());
+    for (const auto& entry : reference) BOOST_CHECK(copy.HasKey(entry.first));
+}
+
+BOOST_AUTO_TEST_CASE(cachemultimap_insert_erase)
+{
+    CacheMultiMap<COutPoint, int> cache(4);
+    const COutPoint a(InsecureRand256(), 0), b(InsecureRand256(), 1);
+    BOOST_CHECK(cache.Insert(a, 1));
+    BOOST_CHECK(cache.Insert(a, 2));
+    BOOST_CHECK(!cache.Insert(a, 1));
+    BOOST_CHECK(cache.Insert(b, 3));
+    BOOST_CHECK(cache.Insert(a, 4));
+    BOOST_CHECK_EQUAL(cache.GetSize(), 4U);
+
+    std::vector<int> values;
+    BOOST_CHECK(cache.GetAll(a, values));
+    BOOST_CHECK(values == std::vector<int>({1, 2, 4}));
+    std::vector<COutPoint> keys;
+    cache.GetKeys(keys);
+    BOOST_CHECK_EQUAL(keys.size(), 2U);
+
+    // The oldest item goes first
+    BOOST_CHECK(cache.Insert(b, 5));
+    values.clear();
+    BOOST_CHECK(cache.GetAll(a, values));
+    BOOST_CHECK(values == std::vector<int>({2, 4}));
+    int value;
+    BOOST_CHECK(cache.Get(a, value));
+    BOOST_CHECK_EQUAL(value, 2);
+
+    cache.Erase(a, 2);
+    BOOST_CHECK(cache.Get(a, value));
+    BOOST_CHECK_EQUAL(value, 4);
+    cache.Erase(b);
+    BOOST_CHECK(!cache.HasKey(b));
+    BOOST_CHECK_EQUAL(cache.GetSize(), 1U);
+    cache.Erase(a, 4);
+    BOOST_CHECK(!cache.HasKey(a));
+    BOOST_CHECK_EQUAL(cache.GetSize(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(cachemap_memory_usage)
+{
+    CacheMap<uint256, int> cache(1000);
+    BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), 0U);
+    std::vector<uint256> keys;
+    for (int i = 0; i < 100; i++) {
+        keys.push_back(InsecureRand256());
+        cache.Insert(keys.back(), i);
+    }
+    const size_t nUsage = cache.DynamicMemoryUsage();
+    BOOST_CHECK(nUsage >= 100 * sizeof(CacheMap<uint256, int>::item_t));
+
+    // The oldest items go first, their nodes are reused
+    cache.PruneLast();
+    cache.PruneLast();
+    BOOST_CHECK(!cache.HasKey(keys[0]));
+    BOOST_CHECK(!cache.HasKey(keys[1]));
+    BOOST_CHECK(cache.HasKey(keys[2]));
+    cache.Insert(InsecureRand256(), 100);
+    cache.Insert(InsecureRand256(), 101);
+    BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), nUsage);
+
+    cache.Clear();
+    BOOST_CHECK_EQUAL(cache.DynamicMemoryUsage(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(cachemap_serialization)
+{
+    // The format of the std::list based caches, most recent item first
+    typedef CacheItem<uint256, int64_t> item_t;
+    const uint32_t nMaxSize = 10;
+    uint32_t nCurrentSize = 3;
+    std::list<item_t> listItems;
+    for (int i = 0; i < 3; i++) listItems.push_back(item_t(InsecureRand256(), i));
+    listItems.push_back(item_t(listItems.front().key, 3));
+    CDataStream stream(SER_DISK, CLIENT_VERSION);
+    stream << nMaxSize << nCurrentSize << std::list<item_t>(listItems.begin(), std::next(listItems.begin(), 3));
+    const std::string strOld = stream.str();
+
+    CacheMap<uint256, int64_t> cache;
+    stream >> cache;
+    BOOST_CHECK_EQUAL(cache.GetMaxSize(), nMaxSize);
+    BOOST_CHECK_EQUAL(cache.GetSize(), 3U);
+    int64_t value;
+    BOOST_CHECK(cache.Get(listItems.back().key, value));
+    BOOST_CHECK_EQUAL(value, 0);
+    stream << cache;
+    BOOST_CHECK(stream.str() == strOld);
+
+    // The multimap keeps items sharing a key
+    stream.clear();
+    nCurrentSize = 4;
+    stream << nMaxSize << nCurrentSize << listItems;
+    const std::string strOldMulti = stream.str();
+    CacheMultiMap<uint256, int64_t> multi;
+    stream >> multi;
+    BOOST_CHECK_EQUAL(multi.GetSize(), 4U);
+    std::vector<int64_t> values;
+    BOOST_CHECK(multi.GetAll(listItems.front().key, values));
+    BOOST_CHECK(values == std::vector<int64_t>({3, 0}));
+    stream << multi;
+    BOOST_CHECK(stream.str() == strOldMulti);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -141,6 +141,12 @@ typedef CCheckQueue<FailingCheck> Failing_Queue;
 typedef CCheckQueue<UniqueCheck> Unique_Queue;
 typedef CCheckQueue<MemoryCheck> Memory_Queue;
 typedef CCheckQueue<FrozenCleanupCheck> FrozenCleanup_Queue;
+// VELES BEGIN
+typedef CWorkStealingCheckQueue<FakeCheckCheckCompletion> WorkStealing_Correct_Queue;
+typedef CWorkStealingCheckQueue<FailingCheck> WorkStealing_Failing_Queue;
+typedef CWorkStealingCheckQueue<UniqueCheck> WorkStealing_Unique_Queue;
+typedef CWorkStealingCheckQueue<MemoryCheck> WorkStealing_Memory_Queue;
+// VELES END
 
 
 /** This test case checks that the CCheckQueue works properly
@@ -442,5 +448,116 @@ BOOST_AUTO_TEST_CASE(test_CheckQueueControl_Locks)
         tg.join_all();
     }
 }
+
+// VELES BEGIN
+/** Test that the work stealing queue runs every check exactly once, with fewer
+ *  deques than workers too */
+BOOST_AUTO_TEST_CASE(test_WorkStealingCheckQueue_Correct)
+{
+    for (const unsigned int nMaxWorkers : {1U, 64U}) {
+        auto queue = MakeUnique<WorkStealing_Correct_Queue>(QUEUE_BATCH_SIZE, nMaxWorkers);
+        boost::thread_group tg;
+        for (auto x = 0; x < nScriptCheckThreads; ++x) {
+           tg.create_thread([&]{queue->Thread();});
+        }
+        std::vector<FakeCheckCheckCompletion> vChecks;
+        for (const size_t i : {(size_t)0, (size_t)1, (size_t)1000, (size_t)100000}) {
+            size_t total = i;
+            FakeCheckCheckCompletion::n_calls = 0;
+            CCheckQueueControl<FakeCheckCheckCompletion, WorkStealing_Correct_Queue> control(queue.get());
+            while (total) {
+                vChecks.resize(std::min(total, (size_t) InsecureRandRange(300)));
+                total -= vChecks.size();
+                control.Add(vChecks);
+            }
+            BOOST_REQUIRE(control.Wait());
+            BOOST_REQUIRE_EQUAL(FakeCheckCheckCompletion::n_calls, i);
+        }
+        tg.interrupt_all();
+        tg.join_all();
+    }
+}
+
+/** Test that the work stealing queue catches failures and recovers from them */
+BOOST_AUTO_TEST_CASE(test_WorkStealingCheckQueue_Failure)
+{
+    auto fail_queue = MakeUnique<WorkStealing_Failing_Queue>(QUEUE_BATCH_SIZE);
+    boost::thread_group tg;
+    for (auto x = 0; x < nScriptCheckThreads; ++x) {
+       tg.create_thread([&]{fail_queue->Thread();});
+    }
+
+    for (size_t i = 0; i < 1001; ++i) {
+        CCheckQueueControl<FailingCheck, WorkStealing_Failing_Queue> control(fail_queue.get());
+        size_t remaining = i;
+        while (remaining) {
+            size_t r = InsecureRandRange(10);
+            std::vector<FailingCheck> vChecks;
+            vChecks.reserve(r);
+            for (size_t k = 0; k < r && remaining; k++, remaining--)
+                vChecks.emplace_back(remaining == 1);
+            control.Add(vChecks);
+        }
+        BOOST_REQUIRE_EQUAL(control.Wait(), i == 0);
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+
+/** Test that the work stealing queue calls every check once and frees them all */
+BOOST_AUTO_TEST_CASE(test_WorkStealingCheckQueue_UniqueCheck)
+{
+    auto queue = MakeUnique<WorkStealing_Unique_Queue>(QUEUE_BATCH_SIZE);
+    boost::thread_group tg;
+    for (auto x = 0; x < nScriptCheckThreads; ++x) {
+       tg.create_thread([&]{queue->Thread();});
+    }
+
+    UniqueCheck::results.clear();
+    size_t COUNT = 100000;
+    size_t total = COUNT;
+    {
+        CCheckQueueControl<UniqueCheck, WorkStealing_Unique_Queue> control(queue.get());
+        while (total) {
+            size_t r = InsecureRandRange(10);
+            std::vector<UniqueCheck> vChecks;
+            for (size_t k = 0; k < r && total; k++)
+                vChecks.emplace_back(--total);
+            control.Add(vChecks);
+        }
+    }
+    bool r = true;
+    BOOST_REQUIRE_EQUAL(UniqueCheck::results.size(), COUNT);
+    for (size_t i = 0; i < COUNT; ++i)
+        r = r && UniqueCheck::results.count(i) == 1;
+    BOOST_REQUIRE(r);
+    tg.interrupt_all();
+    tg.join_all();
+
+    auto memory_queue = MakeUnique<WorkStealing_Memory_Queue>(QUEUE_BATCH_SIZE);
+    for (auto x = 0; x < nScriptCheckThreads; ++x) {
+       tg.create_thread([&]{memory_queue->Thread();});
+    }
+    for (size_t i = 0; i < 1000; ++i) {
+        total = i;
+        {
+            CCheckQueueControl<MemoryCheck, WorkStealing_Memory_Queue> control(memory_queue.get());
+            while (total) {
+                size_t r = InsecureRandRange(10);
+                std::vector<MemoryCheck> vChecks;
+                for (size_t k = 0; k < r && total; k++) {
+                    total--;
+                    vChecks.emplace_back(total == 0 || total == i || total == i/2);
+                }
+                control.Add(vChecks);
+            }
+        }
+        BOOST_REQUIRE_EQUAL(MemoryCheck::fake_allocated_memory, 0U);
+    }
+    tg.interrupt_all();
+    tg.join_all();
+}
+// VELES END
+
 BOOST_AUTO_TEST_SUITE_END()
 
@@ -7,6 +7,7 @@
 #include <consensus/validation.h>
 #include <script/standard.h>
 #include <test/test_bitcoin.h>
+#include <txdb.h> // VELES
 #include <uint256.h>
 #include <undo.h>
 #include <util/strencodings.h>
@@ -476,6 +477,50 @@ BOOST_AUTO_TEST_CASE(updatecoins_simulation_test)
     BOOST_CHECK(spent_a_duplicate_coinbase);
 }
 
+// VELES BEGIN
+BOOST_AUTO_TEST_CASE(ccoins_map_erase)
+{
+    // Erase entries while iterating, the way views flush, and check the
+    // remaining entries are still found and the table does not keep growing.
+    CCoinsMap map;
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 1000; ++i) {
+        outpoints.emplace_back(InsecureRand256(), InsecureRandRange(10));
+    }
+    size_t usage = 0;
+    for (int round = 0; round < 10; ++round) {
+        for (const COutPoint& outpoint : outpoints) {
+            map[outpoint].flags = CCoinsCacheEntry::DIRTY;
+        }
+        BOOST_CHECK_EQUAL(map.size(), outpoints.size());
+        // Once erased entries were refilled the first time, nothing has to be allocated anymore
+        if (round == 1) usage = memusage::DynamicUsage(map);
+        if (round > 1) BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), usage);
+
+        size_t erased = 0;
+        for (CCoinsMap::iterator it = map.begin(); it != map.end();) {
+            if (it->first.n % 2 == 0) {
+                it = map.erase(it);
+                ++erased;
+            } else {
+                ++it;
+            }
+        }
+        BOOST_CHECK_EQUAL(map.size(), outpoints.size() - erased);
+        size_t found = 0;
+        for (const COutPoint& outpoint : outpoints) {
+            found += map.count(outpoint);
+        }
+        BOOST_CHECK_EQUAL(found, map.size());
+    }
+
+    for (CCoinsMap::iterator it = map.begin(); it != map.end(); it = map.erase(it)) {}
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.begin() == map.end());
+    BOOST_CHECK(map.find(outpoints[0]) == map.end());
+}
+// VELES END
+
 BOOST_AUTO_TEST_CASE(ccoins_serialization)
 {
     // Good example
@@ -858,4 +903,116 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+// VELES BEGIN
+static void CheckAddUncachedCoin(CAmount cache_value, CAmount expected_value, char cache_flags, char expected_flags)
+{
+    SingleEntryCacheTest test(VALUE1, cache_value, cache_flags);
+    Coin coin;
+    SetCoinsValue(VALUE1, coin);
+    BOOST_CHECK_EQUAL(test.cache.AddUncachedCoin(OUTPOINT, std::move(coin)), cache_value == ABSENT);
+    test.cache.SelfTest();
+
+    CAmount result_value;
+    char result_flags;
+    GetCoinsMapEntry(test.cache.map(), result_value, result_flags);
+    BOOST_CHECK_EQUAL(result_value, expected_value);
+    BOOST_CHECK_EQUAL(result_flags, expected_flags);
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_add_uncached)
+{
+    /* Check AddUncachedCoin behavior, adding a coin read from the base view
+     * to the cache, and checking the resulting entry in the cache. Existing
+     * entries are never replaced.
+     *
+     *                   Cache   Result  Cache        Result
+     *                   Value   Value   Flags        Flags
+     */
+    CheckAddUncachedCoin(ABSENT, VALUE1, NO_ENTRY   , 0          );
+    CheckAddUncachedCoin(PRUNED, PRUNED, DIRTY      , DIRTY      );
+    CheckAddUncachedCoin(PRUNED, PRUNED, DIRTY|FRESH, DIRTY|FRESH);
+    CheckAddUncachedCoin(VALUE2, VALUE2, 0          , 0          );
+    CheckAddUncachedCoin(VALUE2, VALUE2, DIRTY      , DIRTY      );
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_db_async_flush)
+{
+    // Coins handed to a background write are visible right away and stay so
+    // once they reached the database.
+    SetDataDir("async_flush");
+    CCoinsViewDB db(1 << 20, true);
+    db.SetAsyncFlush(true);
+    CCoinsViewCache cache(&db);
+
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 100; ++i) {
+        outpoints.emplace_back(InsecureRand256(), i);
+        Coin coin;
+        SetCoinsValue(VALUE1, coin);
+        cache.AddCoin(outpoints.back(), std::move(coin), false);
+    }
+    const uint256 block1 = InsecureRand256();
+    cache.SetBestBlock(block1);
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(db.GetBestBlock() == block1);
+    for (const COutPoint& outpoint : outpoints) {
+        BOOST_CHECK(db.HaveCoin(outpoint));
+    }
+
+    // Spend half of the coins, the second write waits for the first one
+    for (size_t i = 0; i < outpoints.size(); i += 2) {
+        BOOST_CHECK(cache.SpendCoin(outpoints[i]));
+    }
+    const uint256 block2 = InsecureRand256();
+    cache.SetBestBlock(block2);
+    BOOST_CHECK(cache.Flush());
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        Coin coin;
+        BOOST_CHECK_EQUAL(db.GetCoin(outpoints[i], coin), i % 2 == 1);
+    }
+
+    BOOST_CHECK(db.WaitForFlush());
+    BOOST_CHECK(db.GetBestBlock() == block2);
+    for (size_t i = 0; i < outpoints.size(); ++i) {
+        BOOST_CHECK_EQUAL(db.HaveCoin(outpoints[i]), i % 2 == 1);
+        BOOST_CHECK_EQUAL(cache.HaveCoin(outpoints[i]), i % 2 == 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_db_snapshot_write)
+{
+    // A snapshot written in parts leaves the database marked as in transition
+    // until its last part is written.
+    CCoinsViewDB db(1 << 20, true);
+    const uint256 genesis = InsecureRand256();
+    {
+        CCoinsMap empty;
+        BOOST_CHECK(db.BatchWrite(empty, genesis));
+    }
+
+    const uint256 base = InsecureRand256();
+    std::vector<COutPoint> outpoints;
+    for (int part = 0; part < 2; ++part) {
+        CCoinsMap coins;
+        for (int i = 0; i < 50; ++i) {
+            outpoints.emplace_back(InsecureRand256(), i);
+            CCoinsCacheEntry& entry = coins[outpoints.back()];
+            SetCoinsValue(VALUE1, entry.coin);
+            entry.flags = CCoinsCacheEntry::DIRTY;
+        }
+        BOOST_CHECK(db.WriteSnapshotCoins(coins, base, part == 1));
+        BOOST_CHECK(coins.empty());
+        if (part == 0) {
+            BOOST_CHECK(db.GetBestBlock().IsNull());
+            BOOST_CHECK(db.GetHeadBlocks() == std::vector<uint256>({base, genesis}));
+        }
+    }
+    BOOST_CHECK(db.GetBestBlock() == base);
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+    for (const COutPoint& outpoint : outpoints) {
+        BOOST_CHECK(db.HaveCoin(outpoint));
+    }
+}
+// VELES END
+
 BOOST_AUTO_TEST_SUITE_END()
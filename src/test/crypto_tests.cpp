@@ -10,7 +10,22 @@
 #include <crypto/sha512.h>
 #include <crypto/hmac_sha256.h>
 #include <crypto/hmac_sha512.h>
+// VELES BEGIN
+#include <crypto/lyra2z.h>
+#include <crypto/muhash.h>
+#include <crypto/nist5.h>
+#include <crypto/scrypt.h>
+#include <crypto/sph_echo.h>
+#include <crypto/sph_groestl.h>
+#include <crypto/sph_hw.h>
+#include <crypto/sph_shavite.h>
+#include <crypto/x11.h>
+#include <crypto/x16r.h>
+#include <primitives/block.h>
+#include <versionbits.h>
+// VELES END
 #include <random.h>
+#include <streams.h> // VELES
 #include <util/strencodings.h>
 #include <test/test_bitcoin.h>
 
@@ -562,4 +577,224 @@ BOOST_AUTO_TEST_CASE(sha256d64)
     }
 }
 
+// VELES BEGIN
+BOOST_AUTO_TEST_CASE(sha256d80)
+{
+    unsigned char in[64 + 16 * 19];
+    for (size_t j = 0; j < sizeof(in); ++j) {
+        in[j] = InsecureRandBits(8);
+    }
+    uint32_t midstate[8];
+    SHA256Midstate(midstate, in);
+    for (int i = 0; i <= 19; ++i) {
+        unsigned char out1[32 * 19], out2[32 * 19];
+        for (int j = 0; j < i; ++j) {
+            CHash256().Write(in, 64).Write(in + 64 + 16 * j, 16).Finalize(out1 + 32 * j);
+        }
+        SHA256D80(out2, midstate, in + 64, i);
+        BOOST_CHECK(memcmp(out1, out2, 32 * i) == 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(sha256dn)
+{
+    // Blobs of one, two and three blocks, with the padding on either side of a block boundary
+    for (size_t len : {0, 32, 55, 56, 64, 100, 119, 120, 150}) {
+        unsigned char in[150 * 19];
+        unsigned char out1[32 * 19], out2[32 * 19];
+        for (size_t j = 0; j < len * 19; ++j) {
+            in[j] = InsecureRandBits(8);
+        }
+        for (int i = 0; i <= 19; ++i) {
+            for (int j = 0; j < i; ++j) {
+                CHash256().Write(in + len * j, len).Finalize(out1 + 32 * j);
+            }
+            SHA256DN(out2, in, len, i);
+            BOOST_CHECK(memcmp(out1, out2, 32 * i) == 0);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(block_header_midstate)
+{
+    CBlockHeader header;
+    header.nVersion = VERSIONBITS_TOP_BITS | ALGO_SHA256D;
+    header.hashPrevBlock = InsecureRand256();
+    header.hashMerkleRoot = InsecureRand256();
+    header.nTime = 1546300800;
+    header.nBits = 0x1e0ffff0;
+    const CBlockHeaderMidstate midstate(header);
+
+    uint256 hashes[11];
+    midstate.GetHashes(0xfffffffa, 11, hashes);
+    for (uint32_t i = 0; i < 11; ++i) {
+        header.nNonce = 0xfffffffa + i; // wraps around
+        BOOST_CHECK(hashes[i] == header.GetHash());
+        BOOST_CHECK(midstate.GetHash(header.nNonce) == header.GetHash());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(lyra2z_testvector)
+{
+    char input[80];
+    for (int i = 0; i < 80; i++)
+        input[i] = i;
+    const std::vector<unsigned char> expected = ParseHex("6b0ded5afb3b27cf0e601243ffd9b37ee65331a2d46c7add2a6a826958ab1c0b");
+
+    char output[32];
+    lyra2z_hash(input, output);
+    BOOST_CHECK(memcmp(output, expected.data(), 32) == 0);
+
+    // The scratchpad is aligned internally and can be reused between calls
+    std::vector<char> scratchpad(LYRA2Z_SCRATCHPAD_SIZE + 1);
+    for (int i = 0; i < 2; i++) {
+        memset(output, 0, sizeof(output));
+        lyra2z_hash_sp(input, output, scratchpad.data() + 1);
+        BOOST_CHECK(memcmp(output, expected.data(), 32) == 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(scrypt_batch)
+{
+    // Both a full group for the 8-way kernel and a remainder hashed one at a time
+    for (int n : {1, 8, 19}) {
+        std::vector<char> in(80 * n), out(32 * n), expected(32 * n);
+        std::vector<const char*> inputs;
+        std::vector<char*> outputs;
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < 80; j++)
+                in[80 * i + j] = InsecureRandBits(8);
+            scrypt_1024_1_1_256(&in[80 * i], &expected[32 * i]);
+            inputs.push_back(&in[80 * i]);
+            outputs.push_back(&out[32 * i]);
+        }
+        scrypt_1024_1_1_256_batch(inputs.data(), outputs.data(), n);
+        BOOST_CHECK(out == expected);
+    }
+}
+
+static void SphHashes(const std::vector<unsigned char>& in, bool fSaturate, std::vector<unsigned char>& out)
+{
+    out.resize(3 * 64);
+    sph_echo512_context ctx_echo;
+    sph_echo512_init(&ctx_echo);
+    if (fSaturate) {
+        // Salt of the ECHO rounds about to carry out of its low 64 bits
+        ctx_echo.C0 = 0xffffff00;
+        ctx_echo.C1 = 0xffffffff;
+    }
+    sph_echo512(&ctx_echo, in.data(), in.size());
+    sph_echo512_close(&ctx_echo, &out[0]);
+    sph_groestl512_context ctx_groestl;
+    sph_groestl512_init(&ctx_groestl);
+    sph_groestl512(&ctx_groestl, in.data(), in.size());
+    sph_groestl512_close(&ctx_groestl, &out[64]);
+    sph_shavite512_context ctx_shavite;
+    sph_shavite512_init(&ctx_shavite);
+    if (fSaturate) {
+        ctx_shavite.count0 = ctx_shavite.count1 = ctx_shavite.count2 = 0xffffffff;
+    }
+    sph_shavite512(&ctx_shavite, in.data(), in.size());
+    sph_shavite512_close(&ctx_shavite, &out[128]);
+}
+
+BOOST_AUTO_TEST_CASE(sph_aes_kernels)
+{
+    unsigned char header[80];
+    for (int i = 0; i < 80; i++)
+        header[i] = i;
+    const uint256 hashPrev = uint256S("fedcba9876543210");
+    std::vector<std::vector<unsigned char>> inputs;
+    for (size_t len : {0, 1, 63, 64, 80, 119, 120, 127, 128, 129, 255, 256, 300}) {
+        std::vector<unsigned char> in(len);
+        for (size_t j = 0; j < len; ++j)
+            in[j] = InsecureRandBits(8);
+        inputs.push_back(in);
+    }
+
+    // The table based sph code against the kernels picked for this CPU
+    std::vector<std::vector<unsigned char>> expected;
+    for (bool fDetect : {false, true}) {
+        if (fDetect) {
+            BOOST_TEST_MESSAGE("sph: " << SphAutoDetect());
+        } else {
+            sph_echo_big_compress_hw = nullptr;
+            sph_groestl_big_compress_hw = nullptr;
+            sph_groestl_big_final_hw = nullptr;
+            sph_shavite_big_compress_hw = nullptr;
+        }
+        BOOST_CHECK_EQUAL(HashX11(header, header + 80).GetHex(), "ceece3d4f75f36c26b50278c1ae635eef54fde24e49cea10e29ea3a97a762e41");
+        BOOST_CHECK_EQUAL(HashX16R(header, header + 80, hashPrev).GetHex(), "5a5fd149d4f1122c1158551ec6b81bde6a79e82be062a4e3a2d1ee3126a9e911");
+        BOOST_CHECK_EQUAL(NIST5(header, header + 80).GetHex(), "d3e3e64058f79b5813adf0e70d05adf388b50891d4f12904ae896b34e8613f61");
+
+        for (size_t i = 0; i < inputs.size(); i++) {
+            for (bool fSaturate : {false, true}) {
+                std::vector<unsigned char> out;
+                SphHashes(inputs[i], fSaturate, out);
+                if (!fDetect) {
+                    expected.push_back(out);
+                } else {
+                    BOOST_CHECK(out == expected[2 * i + fSaturate]);
+                }
+            }
+        }
+    }
+}
+
+static std::vector<unsigned char> MuHashElement(int i)
+{
+    return std::vector<unsigned char>(32, (unsigned char)i);
+}
+
+BOOST_AUTO_TEST_CASE(muhash_tests)
+{
+    uint256 empty, out, out2;
+    MuHash3072().Finalize(empty);
+
+    // The hash doesn't depend on the order of insertions and removals
+    MuHash3072 a, b;
+    a.Insert(MuHashElement(1)).Insert(MuHashElement(2)).Insert(MuHashElement(3)).Remove(MuHashElement(2));
+    b.Insert(MuHashElement(3)).Remove(MuHashElement(2)).Insert(MuHashElement(2)).Insert(MuHashElement(1));
+    a.Finalize(out);
+    b.Finalize(out2);
+    BOOST_CHECK(out == out2);
+    BOOST_CHECK(out != empty);
+
+    // Finalize leaves the set as it was
+    a.Remove(MuHashElement(1)).Remove(MuHashElement(3));
+    a.Finalize(out);
+    BOOST_CHECK(out == empty);
+
+    // Combining sets is the same as inserting their elements
+    MuHash3072 c(MuHashElement(4)), d(MuHashElement(5)), e;
+    c *= d;
+    e.Insert(MuHashElement(5)).Insert(MuHashElement(4));
+    c.Finalize(out);
+    e.Finalize(out2);
+    BOOST_CHECK(out == out2);
+    c /= d;
+    c.Finalize(out);
+    MuHash3072(MuHashElement(4)).Finalize(out2);
+    BOOST_CHECK(out == out2);
+
+    // The state survives serialization with removals pending
+    MuHash3072 f;
+    f.Insert(MuHashElement(6)).Insert(MuHashElement(7)).Remove(MuHashElement(8));
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    ss << f;
+    BOOST_CHECK_EQUAL(ss.size(), 2 * Num3072::BYTE_SIZE);
+    MuHash3072 g;
+    ss >> g;
+    g.Insert(MuHashElement(8));
+    f.Insert(MuHashElement(8));
+    f.Finalize(out);
+    g.Finalize(out2);
+    BOOST_CHECK(out == out2);
+    MuHash3072 h;
+    h.Insert(MuHashElement(7)).Insert(MuHashElement(6));
+    h.Finalize(out2);
+    BOOST_CHECK(out == out2);
+}
+// VELES END
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -6,6 +6,7 @@
 #include <script/sigcache.h>
 #include <test/test_bitcoin.h>
 #include <random.h>
+#include <set>
 #include <thread>
 
 /** Test Suite for CuckooCache
@@ -362,4 +363,32 @@ BOOST_AUTO_TEST_CASE(cuckoocache_generations)
     test_cache_generations<CuckooCache::cache<uint256, SignatureCacheHasher>>();
 }
 
+// VELES BEGIN
+/* Test that for_each visits every element not erased, and only those */
+BOOST_AUTO_TEST_CASE(cuckoocache_for_each)
+{
+    SeedInsecureRand(true);
+    CuckooCache::cache<uint256, SignatureCacheHasher> cc{};
+    cc.setup(1000);
+    BOOST_CHECK_EQUAL(cc.capacity(), 1000U);
+    BOOST_CHECK_EQUAL(cc.count(), 0U);
+
+    std::vector<uint256> hashes;
+    for (int x = 0; x < 300; ++x) {
+        hashes.push_back(InsecureRand256());
+        cc.insert(hashes.back());
+    }
+    for (int x = 0; x < 100; ++x) {
+        BOOST_CHECK(cc.contains(hashes[x], true));
+    }
+    std::set<uint256> seen;
+    cc.for_each([&seen](const uint256& e) { BOOST_CHECK(seen.insert(e).second); });
+    BOOST_CHECK_EQUAL(seen.size(), 200U);
+    BOOST_CHECK_EQUAL(cc.count(), 200U);
+    for (int x = 100; x < 300; ++x) {
+        BOOST_CHECK(seen.count(hashes[x]));
+    }
+}
+// VELES END
+
 BOOST_AUTO_TEST_SUITE_END();
@@ -119,6 +119,54 @@ BOOST_AUTO_TEST_CASE(dbwrapper_iterator)
     }
 }
 
+BOOST_AUTO_TEST_CASE(dbwrapper_prefix_scan)
+{
+    for (const bool obfuscate : {false, true}) {
+        fs::path ph = SetDataDir(std::string("dbwrapper_prefix_scan").append(obfuscate ? "_true" : "_false"));
+        CDBWrapper dbw(ph, (1 << 20), true, false, obfuscate);
+
+        // Keys of the form (char, uint32_t), one of another size within the prefix
+        std::vector<uint256> values;
+        for (uint32_t i = 0; i < 10; ++i) {
+            values.push_back(InsecureRand256());
+            BOOST_CHECK(dbw.Write(std::make_pair('p', i), values.back()));
+        }
+        BOOST_CHECK(dbw.Write(std::make_pair('q', (uint32_t)0), InsecureRand256()));
+
+        const std::vector<unsigned char> prefix{'p'};
+        const CDBFixedKeyDecoder<std::pair<char, uint32_t>> decode_key;
+        BOOST_CHECK_EQUAL(decode_key.size(), 5U);
+
+        std::unique_ptr<CDBIterator> it(dbw.NewIterator());
+        it->Seek('p');
+        uint32_t n = 0;
+        size_t visited = it->ForEachWithPrefix(MakeSpan(prefix), [&](Span<const unsigned char> key, Span<const unsigned char> value) {
+            std::pair<char, uint32_t> key_res;
+            BOOST_REQUIRE(decode_key(key, key_res));
+            BOOST_CHECK_EQUAL(key_res.second, n);
+            BOOST_CHECK(value == Span<const unsigned char>(values[n].begin(), values[n].size()));
+            ++n;
+            return true;
+        });
+        BOOST_CHECK_EQUAL(visited, 10U);
+        // The scan stops at the first key without the prefix
+        char key_res;
+        BOOST_REQUIRE(it->GetKey(key_res));
+        BOOST_CHECK_EQUAL(key_res, 'q');
+
+        // At most nMax entries, the iterator stays on the next one
+        it->Seek('p');
+        BOOST_CHECK_EQUAL(it->ForEachWithPrefix(MakeSpan(prefix), [](Span<const unsigned char>, Span<const unsigned char>) { return true; }, 3), 3U);
+        std::pair<char, uint32_t> key_pair;
+        BOOST_REQUIRE(it->GetKey(key_pair));
+        BOOST_CHECK_EQUAL(key_pair.second, 3U);
+
+        // Keys of another size are rejected
+        std::pair<char, uint32_t> key_short;
+        BOOST_CHECK(!decode_key(MakeSpan(prefix), key_short));
+    }
+}
+
 // Test that we do not obfuscation if there is existing data.
 BOOST_AUTO_TEST_CASE(existing_data_no_obfuscate)
 {
@@ -318,5 +366,42 @@ BOOST_AUTO_TEST_CASE(iterator_string_ordering)
 }
 
 
+// VELES BEGIN
+BOOST_AUTO_TEST_CASE(dbwrapper_profile)
+{
+    DBProfile profile;
+    BOOST_CHECK(profile.Set("block_size=65536"));
+    BOOST_CHECK(profile.Set("bloom_bits=0"));
+    BOOST_CHECK(profile.Set("compression=1"));
+    BOOST_CHECK(!profile.Set("block_size=1"));
+    BOOST_CHECK(!profile.Set("bloom_bits"));
+    BOOST_CHECK(!profile.Set("unknown=1"));
+    BOOST_CHECK_EQUAL(profile.block_size, 65536U);
+    BOOST_CHECK_EQUAL(profile.bloom_bits, 0);
+    BOOST_CHECK(profile.compression);
+
+    // -dboption overrides the defaults of the database with the same name
+    gArgs.ForceSetArg("-dboption", "dbwrapper_profile.bloom_bits=12");
+    fs::path ph = SetDataDir("dbwrapper_profile");
+    {
+        CDBWrapper dbw(ph, (1 << 20), true, false, false, profile);
+        BOOST_CHECK_EQUAL(dbw.GetProfile().block_size, 65536U);
+        BOOST_CHECK_EQUAL(dbw.GetProfile().bloom_bits, 12);
+        BOOST_CHECK(dbw.Write('k', InsecureRand256()));
+
+        int found = 0;
+        ForEachDBWrapper([&](const CDBWrapper& db) {
+            if (&db != &dbw) return;
+            ++found;
+            BOOST_CHECK(!db.GetStats().text.empty());
+        });
+        BOOST_CHECK_EQUAL(found, 1);
+    }
+    ForEachDBWrapper([&](const CDBWrapper& db) {
+        BOOST_CHECK(db.GetName() != "dbwrapper_profile");
+    });
+    gArgs.ForceSetArg("-dboption", "");
+}
+// VELES END
 
 BOOST_AUTO_TEST_SUITE_END()
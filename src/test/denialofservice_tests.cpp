@@ -8,6 +8,7 @@
 #include <chainparams.h>
 #include <keystore.h>
 #include <net.h>
+#include <netbase.h> // VELES
 #include <net_processing.h>
 #include <pow.h>
 #include <script/sign.h>
@@ -104,8 +105,8 @@ BOOST_AUTO_TEST_CASE(outbound_slow_chain_eviction)
     }
     {
         LOCK2(cs_main, dummyNode1.cs_vSend);
-        BOOST_CHECK(dummyNode1.vSendMsg.size() > 0);
-        dummyNode1.vSendMsg.clear();
+        BOOST_CHECK(dummyNode1.vSendMsg[SEND_PRIORITY_HIGH].size() > 0); // VELES
+        dummyNode1.vSendMsg[SEND_PRIORITY_HIGH].clear(); // VELES
     }
 
     int64_t nStartTime = GetTime();
@@ -117,7 +118,7 @@ BOOST_AUTO_TEST_CASE(outbound_slow_chain_eviction)
     }
     {
         LOCK2(cs_main, dummyNode1.cs_vSend);
-        BOOST_CHECK(dummyNode1.vSendMsg.size() > 0);
+        BOOST_CHECK(dummyNode1.vSendMsg[SEND_PRIORITY_HIGH].size() > 0); // VELES
     }
     // Wait 3 more minutes
     SetMockTime(nStartTime+24*60);
@@ -357,6 +358,61 @@ BOOST_AUTO_TEST_CASE(DoS_bantime)
     peerLogic->FinalizeNode(dummyNode.GetId(), dummy);
 }
 
+// VELES BEGIN
+BOOST_AUTO_TEST_CASE(DoS_bansubnets)
+{
+    auto banman = MakeUnique<BanMan>(GetDataDir() / "banlist.dat", nullptr, DEFAULT_MISBEHAVING_BANTIME);
+    banman->ClearBanned();
+
+    auto subnet = [](const char* str) {
+        CSubNet ret;
+        LookupSubNet(str, ret);
+        return ret;
+    };
+    auto host = [](const char* str) {
+        CNetAddr ret;
+        LookupHost(str, ret, false);
+        return ret;
+    };
+
+    banman->Ban(subnet("10.0.0.0/8"), BanReasonNodeMisbehaving);
+    banman->Ban(subnet("10.20.0.0/16"), BanReasonManuallyAdded);
+    banman->Ban(subnet("1.2.3.4"), BanReasonNodeMisbehaving);
+    banman->Ban(subnet("2001:db8::/32"), BanReasonManuallyAdded);
+    // Not a prefix
+    banman->Ban(subnet("192.168.0.7/255.255.0.255"), BanReasonNodeMisbehaving);
+
+    BOOST_CHECK_EQUAL(banman->IsBannedLevel(host("10.1.2.3")), 1);
+    BOOST_CHECK_EQUAL(banman->IsBannedLevel(host("10.20.2.3")), 2);
+    BOOST_CHECK_EQUAL(banman->IsBannedLevel(host("1.2.3.4")), 1);
+    BOOST_CHECK_EQUAL(banman->IsBannedLevel(host("1.2.3.5")), 0);
+    BOOST_CHECK_EQUAL(banman->IsBannedLevel(host("2001:db8::1")), 2);
+    BOOST_CHECK_EQUAL(banman->IsBannedLevel(host("2001:db9::1")), 0);
+    BOOST_CHECK(banman->IsBanned(host("192.168.42.7")));
+    BOOST_CHECK(!banman->IsBanned(host("192.168.42.8")));
+    BOOST_CHECK(!banman->IsBanned(host("11.0.0.1")));
+    BOOST_CHECK(!banman->IsBanned(CNetAddr()));
+
+    BOOST_CHECK(banman->Unban(subnet("10.20.0.0/16")));
+    BOOST_CHECK_EQUAL(banman->IsBannedLevel(host("10.20.2.3")), 1);
+    BOOST_CHECK(banman->Unban(subnet("192.168.0.7/255.255.0.255")));
+    BOOST_CHECK(!banman->IsBanned(host("192.168.42.7")));
+
+    // The whole address space
+    banman->Ban(subnet("::/0"), BanReasonManuallyAdded);
+    BOOST_CHECK_EQUAL(banman->IsBannedLevel(host("11.0.0.1")), 2);
+
+    // Expired bans don't match
+    SetMockTime(GetTime() + DEFAULT_MISBEHAVING_BANTIME + 1);
+    BOOST_CHECK(!banman->IsBanned(host("10.1.2.3")));
+    BOOST_CHECK(!banman->IsBanned(host("2001:db8::1")));
+    SetMockTime(0);
+
+    banman->ClearBanned();
+    BOOST_CHECK(!banman->IsBanned(host("10.1.2.3")));
+}
+// VELES END
+
 static CTransactionRef RandomOrphan()
 {
     std::map<uint256, COrphanTx>::iterator it;
@@ -0,0 +1,134 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <governance/governance.h>
+#include <governance/object.h>
+#include <governance/validators.h>
+#include <key_io.h>
+#include <streams.h>
+#include <util/strencodings.h>
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+static std::string ProposalHex(const std::string& strName, const std::string& strPaymentAddress)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("end_epoch", 1546300800 + 30 * 24 * 3600);
+    obj.pushKV("name", strName);
+    obj.pushKV("payment_address", strPaymentAddress);
+    obj.pushKV("payment_amount", 100);
+    obj.pushKV("start_epoch", 1546300800);
+    obj.pushKV("type", GOVERNANCE_OBJECT_PROPOSAL);
+    obj.pushKV("url", "https://veles.network/proposal");
+    UniValue inner(UniValue::VARR);
+    inner.push_back("proposal");
+    inner.push_back(obj);
+    UniValue outer(UniValue::VARR);
+    outer.push_back(inner);
+    const std::string str = outer.write();
+    return HexStr(str.begin(), str.end());
+}
+
+BOOST_FIXTURE_TEST_SUITE(governance_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(governance_object_payload)
+{
+    const std::string strAddress = EncodeDestination(CKeyID(uint160(ParseHex("0102030405060708090a0b0c0d0e0f1011121314"))));
+
+    // The data is parsed and validated once, as the proposal validator does from the hex
+    const std::string strHex = ProposalHex("test-proposal", strAddress);
+    CGovernanceObject govobj(uint256(), 1, 1546300800, uint256(), strHex);
+    BOOST_CHECK_EQUAL(govobj.GetObjectType(), GOVERNANCE_OBJECT_PROPOSAL);
+    BOOST_CHECK(govobj.GetPayload().fParsed);
+    BOOST_CHECK(govobj.GetPayload().fValidProposal);
+    BOOST_CHECK(CProposalValidator(strHex).Validate());
+    BOOST_CHECK_EQUAL(govobj.GetJSONObject()["name"].get_str(), "test-proposal");
+    const std::vector<unsigned char> vchData = ParseHex(strHex);
+    BOOST_CHECK(govobj.GetDataAsString() == std::string(vchData.begin(), vchData.end()));
+
+    const std::string strInvalidHex = ProposalHex("test proposal!", strAddress);
+    CGovernanceObject govobjInvalid(uint256(), 1, 1546300800, uint256(), strInvalidHex);
+    BOOST_CHECK(govobjInvalid.GetPayload().fParsed);
+    BOOST_CHECK(!govobjInvalid.GetPayload().fValidProposal);
+    CProposalValidator validator(strInvalidHex);
+    BOOST_CHECK(!validator.Validate());
+    BOOST_CHECK_EQUAL(govobjInvalid.GetPayload().strProposalErrors, validator.GetErrorMessages());
+
+    // Objects received from peers are parsed when deserialized
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << govobj;
+    CGovernanceObject govobjReceived;
+    ss >> govobjReceived;
+    BOOST_CHECK(govobjReceived.GetHash() == govobj.GetHash());
+    BOOST_CHECK(govobjReceived.GetPayload().fValidProposal);
+    BOOST_CHECK_EQUAL(govobjReceived.GetJSONObject()["name"].get_str(), "test-proposal");
+
+    // Unparsable data still throws when its object is asked for
+    CGovernanceObject govobjUnparsable(uint256(), 1, 1546300800, uint256(), HexStr(std::string("not json")));
+    BOOST_CHECK(!govobjUnparsable.GetPayload().fParsed);
+    BOOST_CHECK_THROW(govobjUnparsable.GetJSONObject(), std::exception);
+}
+
+BOOST_AUTO_TEST_CASE(governance_vote_sync_planner)
+{
+    CGovernanceVoteSyncPlanner planner;
+    const int64_t nNow = 1546300800;
+    BOOST_CHECK(planner.NeedsRebuild(nNow));
+
+    std::vector<uint256> vecObjects;
+    for (int i = 0; i < 4; i++) {
+        vecObjects.push_back(InsecureRand256());
+    }
+    planner.Rebuild(vecObjects, nNow);
+    BOOST_CHECK(!planner.NeedsRebuild(nNow));
+
+    std::vector<CService> vecPeers;
+    for (uint32_t i = 1; i <= CGovernanceVoteSyncPlanner::PEERS_PER_OBJECT + 1; i++) {
+        struct in_addr ip;
+        ip.s_addr = htonl(0x0a000000 + i);
+        vecPeers.push_back(CService(CNetAddr(ip), 7777));
+    }
+
+    // Every peer goes through the plan in order, each object is asked from PEERS_PER_OBJECT peers only
+    uint256 nHash;
+    for (size_t i = 0; i < CGovernanceVoteSyncPlanner::PEERS_PER_OBJECT; i++) {
+        BOOST_CHECK_EQUAL(planner.GetObjectsLeft(vecPeers[i]), vecObjects.size());
+        BOOST_CHECK(planner.NextObject(vecPeers[i], nHash));
+        BOOST_CHECK(nHash == vecObjects[0]);
+        planner.Asked(nHash, vecPeers[i], nNow);
+        BOOST_CHECK_EQUAL(planner.GetObjectsLeft(vecPeers[i]), vecObjects.size() - 1);
+    }
+    const CService& peerLast = vecPeers.back();
+    BOOST_CHECK(planner.NextObject(peerLast, nHash));
+    BOOST_CHECK(nHash == vecObjects[1]);
+    planner.Asked(nHash, peerLast, nNow);
+
+    // New objects are appended to the plan
+    const uint256 nHashNew = InsecureRand256();
+    planner.AddObject(nHashNew);
+    planner.AddObject(nHashNew);
+    size_t nAsked = 0;
+    while (planner.NextObject(peerLast, nHash)) {
+        planner.Asked(nHash, peerLast, nNow);
+        nAsked++;
+    }
+    BOOST_CHECK_EQUAL(nAsked, 3U);
+    BOOST_CHECK(nHash == nHashNew);
+    BOOST_CHECK_EQUAL(planner.GetObjectsLeft(peerLast), 0U);
+
+    // A new pass does not ask the same peers again until their asks expire
+    planner.Rebuild(vecObjects, nNow + 1);
+    BOOST_CHECK_EQUAL(planner.GetObjectsLeft(peerLast), vecObjects.size());
+    BOOST_CHECK(!planner.NextObject(peerLast, nHash));
+    BOOST_CHECK(planner.NeedsRebuild(nNow + 1 + CGovernanceVoteSyncPlanner::ASK_TIMEOUT));
+    planner.Rebuild(vecObjects, nNow + CGovernanceVoteSyncPlanner::ASK_TIMEOUT);
+    BOOST_CHECK(planner.NextObject(peerLast, nHash));
+    BOOST_CHECK(nHash == vecObjects[0]);
+
+    planner.Clear();
+    BOOST_CHECK(planner.NeedsRebuild(nNow));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
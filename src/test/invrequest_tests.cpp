@@ -0,0 +1,110 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <arith_uint256.h>
+#include <invrequest.h>
+#include <protocol.h>
+#include <test/test_bitcoin.h>
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(invrequest_tests, BasicTestingSetup)
+
+static CInv MakeInv(uint64_t n)
+{
+    return CInv(MSG_TX, ArithToUint256(arith_uint256(n)));
+}
+
+BOOST_AUTO_TEST_CASE(tracker_order_and_inflight)
+{
+    CInvRequestTracker tracker;
+    BOOST_CHECK(tracker.Add(MakeInv(1), 300));
+    BOOST_CHECK(tracker.Add(MakeInv(2), 100));
+    BOOST_CHECK(tracker.Add(MakeInv(3), 100));
+    BOOST_CHECK(!tracker.Add(MakeInv(2), 50));
+    BOOST_CHECK_EQUAL(tracker.Size(), 3U);
+
+    // nothing due yet
+    std::vector<CInv> vInv;
+    tracker.GetRequestable(99, 10, vInv);
+    BOOST_CHECK(vInv.empty());
+
+    // due items come in time order, ties in the order they were added
+    tracker.GetRequestable(300, 10, vInv);
+    BOOST_CHECK_EQUAL(vInv.size(), 3U);
+    BOOST_CHECK(vInv[0].hash == MakeInv(2).hash);
+    BOOST_CHECK(vInv[1].hash == MakeInv(3).hash);
+    BOOST_CHECK(vInv[2].hash == MakeInv(1).hash);
+    BOOST_CHECK_EQUAL(tracker.CountInFlight(), 3U);
+
+    // in-flight items stay tracked until delivered
+    BOOST_CHECK(!tracker.Add(MakeInv(1), 0));
+    tracker.Remove(MakeInv(1).hash);
+    BOOST_CHECK(!tracker.Has(MakeInv(1).hash));
+    BOOST_CHECK_EQUAL(tracker.CountInFlight(), 2U);
+    BOOST_CHECK_EQUAL(tracker.Size(), 2U);
+
+    // or until they time out
+    vInv.clear();
+    tracker.GetRequestable(300 + INV_REQUEST_TIMEOUT, 10, vInv);
+    BOOST_CHECK(vInv.empty());
+    BOOST_CHECK_EQUAL(tracker.Size(), 0U);
+    BOOST_CHECK_EQUAL(tracker.CountInFlight(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(tracker_inflight_limit)
+{
+    CInvRequestTracker tracker;
+    for (uint64_t i = 0; i < 5; i++)
+        tracker.Add(MakeInv(i), i);
+
+    std::vector<CInv> vInv;
+    tracker.GetRequestable(10, 2, vInv);
+    BOOST_CHECK_EQUAL(vInv.size(), 2U);
+
+    // the limit holds until a response frees a slot
+    tracker.GetRequestable(10, 2, vInv);
+    BOOST_CHECK_EQUAL(vInv.size(), 2U);
+    tracker.Remove(vInv[0].hash);
+    tracker.GetRequestable(10, 2, vInv);
+    BOOST_CHECK_EQUAL(vInv.size(), 3U);
+    BOOST_CHECK(vInv[2].hash == MakeInv(2).hash);
+
+    // removing a pending item drops it from the schedule
+    tracker.Remove(MakeInv(3).hash);
+    tracker.Remove(vInv[1].hash);
+    tracker.Remove(vInv[2].hash);
+    tracker.GetRequestable(10, 2, vInv);
+    BOOST_CHECK_EQUAL(vInv.size(), 4U);
+    BOOST_CHECK(vInv[3].hash == MakeInv(4).hash);
+}
+
+BOOST_AUTO_TEST_CASE(request_times)
+{
+    CInvRequestTimes times(2);
+    const uint256 hash1 = MakeInv(1).hash;
+    const uint256 hash2 = MakeInv(2).hash;
+    const uint256 hash3 = MakeInv(3).hash;
+
+    // each further request of an item is a retry interval later
+    BOOST_CHECK_EQUAL(times.Schedule(hash1, 1000), 1000);
+    BOOST_CHECK_EQUAL(times.Schedule(hash1, 1000), 1000 + INV_REQUEST_RETRY_INTERVAL);
+    BOOST_CHECK_EQUAL(times.Schedule(hash1, 1000), 1000 + 2 * INV_REQUEST_RETRY_INTERVAL);
+    times.Erase(hash1);
+    BOOST_CHECK_EQUAL(times.Schedule(hash1, 2000), 2000);
+
+    // a full map only keeps the entries that still delay a request
+    BOOST_CHECK_EQUAL(times.Schedule(hash2, 2500), 2500);
+    BOOST_CHECK_EQUAL(times.Schedule(hash3, 2000), 2000);
+    BOOST_CHECK_EQUAL(times.Schedule(hash3, 2000), 2000);
+    const int64_t nLater = 2000 + INV_REQUEST_RETRY_INTERVAL;
+    BOOST_CHECK_EQUAL(times.Schedule(hash3, nLater), nLater);
+    BOOST_CHECK_EQUAL(times.Schedule(hash3, nLater), nLater + INV_REQUEST_RETRY_INTERVAL);
+    BOOST_CHECK_EQUAL(times.Schedule(hash2, nLater), 2500 + INV_REQUEST_RETRY_INTERVAL);
+    BOOST_CHECK_EQUAL(times.Schedule(hash1, nLater), nLater);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -12,6 +12,7 @@
 #include <util/strencodings.h>
 #include <test/test_bitcoin.h>
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -189,4 +190,51 @@ BOOST_AUTO_TEST_CASE(key_signature_tests)
     BOOST_CHECK(found_small);
 }
 
+BOOST_AUTO_TEST_CASE(key_verify_batch)
+{
+    std::vector<CSignatureVerification> vSigs;
+    std::vector<bool> vExpected;
+    for (int n = 0; n < 150; n++) {
+        CKey key;
+        key.MakeNewKey(n % 2 == 0);
+        uint256 hash = InsecureRand256();
+        std::vector<unsigned char> vchSig;
+        BOOST_CHECK(key.Sign(hash, vchSig));
+        bool fValid = true;
+        switch (n % 5) {
+        case 1: // Other message
+            hash = InsecureRand256();
+            fValid = false;
+            break;
+        case 2: // Unparseable signature
+            vchSig[0] = 0;
+            fValid = false;
+            break;
+        case 3: // Invalid public key
+            vSigs.emplace_back(CPubKey(), hash, vchSig);
+            vExpected.push_back(false);
+            continue;
+        }
+        vSigs.emplace_back(key.GetPubKey(), hash, vchSig);
+        vExpected.push_back(fValid);
+    }
+
+    std::vector<bool> vResults;
+    BOOST_CHECK(!CPubKey::VerifyBatch(vSigs, vResults));
+    BOOST_CHECK(vResults == vExpected);
+    for (size_t i = 0; i < vSigs.size(); i++) {
+        BOOST_CHECK_EQUAL(vResults[i], vSigs[i].pubkey.Verify(vSigs[i].hash, vSigs[i].vchSig));
+    }
+
+    // Only the valid ones
+    std::vector<CSignatureVerification> vValid;
+    for (size_t i = 0; i < vSigs.size(); i++) {
+        if (vExpected[i]) vValid.push_back(vSigs[i]);
+    }
+    BOOST_CHECK(CPubKey::VerifyBatch(vValid, vResults));
+    BOOST_CHECK_EQUAL(std::count(vResults.begin(), vResults.end(), true), (long)vValid.size());
+    BOOST_CHECK(CPubKey::VerifyBatch({}, vResults));
+    BOOST_CHECK(vResults.empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
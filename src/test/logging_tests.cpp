@@ -0,0 +1,86 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <fs.h>
+#include <logging.h>
+#include <test/test_bitcoin.h>
+#include <util/time.h>
+
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(logging_tests, BasicTestingSetup)
+
+static std::vector<std::string> ReadLines(const fs::path& path)
+{
+    std::vector<std::string> lines;
+    std::ifstream file(path.string());
+    std::string line;
+    while (std::getline(file, line)) lines.push_back(line);
+    return lines;
+}
+
+BOOST_AUTO_TEST_CASE(logging_async)
+{
+    BCLog::Logger logger;
+    logger.m_print_to_file = true;
+    logger.m_log_timestamps = false;
+    logger.m_file_path = SetDataDir("logging_async") / "debug.log";
+    logger.LogPrintStr("before open\n");
+    BOOST_REQUIRE(logger.OpenDebugLog());
+
+    logger.StartAsync();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&logger, t] {
+            for (int i = 0; i < 100; ++i) {
+                logger.LogPrintStr(strprintf("thread %d message %d\n", t, i));
+            }
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    logger.StopAsync();
+    logger.LogPrintStr("after stop\n");
+
+    // Every message is written once, in order per thread, unless the writer fell behind
+    const std::vector<std::string> lines = ReadLines(logger.m_file_path);
+    BOOST_CHECK_EQUAL(lines.front(), "before open");
+    BOOST_CHECK_EQUAL(lines.back(), "after stop");
+    int next[4] = {};
+    for (const std::string& line : lines) {
+        int t, i;
+        if (sscanf(line.c_str(), "thread %d message %d", &t, &i) == 2) {
+            BOOST_CHECK(i >= next[t]);
+            next[t] = i + 1;
+        }
+    }
+    if (logger.GetDroppedCount() == 0) {
+        BOOST_CHECK_EQUAL(lines.size(), 402U);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(logging_rate_limit)
+{
+    BCLog::Logger logger;
+    BOOST_CHECK(logger.WithinRateLimit(BCLog::MASTERNODE));
+
+    logger.m_rate_limit = 2;
+    // Start right after a second begins, so the messages fall in the same one
+    const int64_t nSecond = GetTimeMillis() / 1000;
+    while (GetTimeMillis() / 1000 == nSecond) MilliSleep(1);
+    BOOST_CHECK(logger.WithinRateLimit(BCLog::MASTERNODE));
+    BOOST_CHECK(logger.WithinRateLimit(BCLog::MASTERNODE));
+    BOOST_CHECK(!logger.WithinRateLimit(BCLog::MASTERNODE));
+    BOOST_CHECK(!logger.WithinRateLimit(BCLog::MASTERNODE));
+    // Other categories have their own limit
+    BOOST_CHECK(logger.WithinRateLimit(BCLog::GOBJECT));
+    BOOST_CHECK_EQUAL(logger.GetSuppressedCount(BCLog::MASTERNODE), 2U);
+    BOOST_CHECK_EQUAL(logger.GetSuppressedCount(BCLog::GOBJECT), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -3,8 +3,11 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <arith_uint256.h>
 #include <chainparams.h>
+#include <spork.h>
 #include <validation.h>
+#include <versionbits.h>
 #include <net.h>
 
 #include <test/test_bitcoin.h>
@@ -63,6 +66,76 @@ BOOST_AUTO_TEST_CASE(subsidy_limit_test)
     //BOOST_CHECK_EQUAL(nSum, CAmount{2099999997690000});
 }
 
+// VELES BEGIN
+BOOST_AUTO_TEST_CASE(chain_subsidy_test)
+{
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    std::vector<CBlockIndex> vIndex(500);
+    std::vector<uint256> vHash(vIndex.size());
+    for (size_t i = 0; i < vIndex.size(); i++) {
+        vHash[i] = ArithToUint256(arith_uint256(i));
+        vIndex[i].phashBlock = &vHash[i];
+        vIndex[i].pprev = i ? &vIndex[i - 1] : nullptr;
+        vIndex[i].nHeight = i;
+        vIndex[i].nVersion = VERSIONBITS_TOP_BITS | ALGO_X16R;
+        vIndex[i].nBits = 0x1e0ffff0 - InsecureRandRange(0x10000);
+        vIndex[i].BuildSkip();
+    }
+
+    // Fill a prefix first, the rest is computed on top of it
+    GetChainSubsidy(&vIndex[200]);
+
+    CAmount nSum = 0;
+    for (size_t i = 1; i < vIndex.size(); i++) {
+        nSum += GetBlockSubsidy(i, vIndex[i].GetBlockHeader(), consensusParams, false, GetSubsidyHalvingParameters(i, consensusParams).get());
+        BOOST_CHECK_EQUAL(GetChainSubsidy(&vIndex[i]), nSum);
+    }
+    BOOST_CHECK_EQUAL(GetChainSubsidy(&vIndex[0]), 0);
+}
+
+BOOST_AUTO_TEST_CASE(halving_parameters_snapshot_test)
+{
+    // All heights of an epoch share one schedule
+    std::shared_ptr<const HalvingParameters> params = GetSubsidyHalvingParameters(100);
+    BOOST_CHECK(GetSubsidyHalvingParameters(2) == params);
+    BOOST_CHECK(GetSubsidyHalvingParameters(49999) == params);
+    BOOST_CHECK_EQUAL(params->epochs.back().nStartBlock, 2);
+    BOOST_CHECK_EQUAL(params->epochs.back().nEndBlock, 49999);
+
+    // The epochs after it count blocks which are not connected yet and are rebuilt on every call
+    std::shared_ptr<const HalvingParameters> paramsNext = GetSubsidyHalvingParameters(50000);
+    BOOST_CHECK(paramsNext != params);
+    BOOST_CHECK(GetSubsidyHalvingParameters(50001) != paramsNext);
+    BOOST_CHECK_EQUAL(paramsNext->epochs.back().nStartBlock, 50000);
+}
+
+BOOST_AUTO_TEST_CASE(algo_cost_factor_table_test)
+{
+    // With the cost factor sporks off only the Nist5 bump up at height 51000 changes the factors
+    int64_t nStartHeight, nEndHeight;
+    GetAlgoCostFactorRange(100, nStartHeight, nEndHeight);
+    BOOST_CHECK_EQUAL(nStartHeight, 0);
+    BOOST_CHECK_EQUAL(nEndHeight, 51000);
+    GetAlgoCostFactorRange(60000, nStartHeight, nEndHeight);
+    BOOST_CHECK_EQUAL(nStartHeight, 51000);
+    BOOST_CHECK_EQUAL(nEndHeight, -1);
+
+    // The average of the factors is rounded down to whole units
+    const CAmount nTotal = SPORK_VELES_05A_ADJUST_COST_FACTOR_SHA256D_DEFAULT + SPORK_VELES_05A_ADJUST_COST_FACTOR_SCRYPT_DEFAULT
+        + SPORK_VELES_05A_ADJUST_COST_FACTOR_LYRA2Z_DEFAULT + SPORK_VELES_05A_ADJUST_COST_FACTOR_X11_DEFAULT
+        + SPORK_VELES_05A_ADJUST_COST_FACTOR_X16R_DEFAULT + SPORK_VELES_05A_ADJUST_COST_FACTOR_NIST5_DEFAULT;
+    const CAmount nTotalBumped = nTotal + SPORK_VELES_05A_ADJUST_COST_FACTOR_NIST5_DEFAULT * 9;
+    for (int nHeight : {0, 1, 50999}) {
+        BOOST_CHECK_EQUAL(GetAlgoCostFactor(ALGO_SHA256D, nHeight), (double)SPORK_VELES_05A_ADJUST_COST_FACTOR_SHA256D_DEFAULT / (nTotal / 6));
+        BOOST_CHECK_EQUAL(GetAlgoCostFactor(ALGO_NIST5, nHeight), (double)SPORK_VELES_05A_ADJUST_COST_FACTOR_NIST5_DEFAULT / (nTotal / 6));
+    }
+    for (int nHeight : {51000, 1000000}) {
+        BOOST_CHECK_EQUAL(GetAlgoCostFactor(ALGO_X16R, nHeight), (double)SPORK_VELES_05A_ADJUST_COST_FACTOR_X16R_DEFAULT / (nTotalBumped / 6));
+        BOOST_CHECK_EQUAL(GetAlgoCostFactor(ALGO_NIST5, nHeight), (double)SPORK_VELES_05A_ADJUST_COST_FACTOR_NIST5_DEFAULT * 10 / (nTotalBumped / 6));
+    }
+}
+// VELES END
+
 static bool ReturnFalse() { return false; }
 static bool ReturnTrue() { return true; }
 
@@ -0,0 +1,169 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <clientversion.h>
+#include <hash.h>
+#include <masternode/activemasternode.h>
+#include <masternode/manager.h>
+#include <masternode/masternode.h>
+#include <key_io.h>
+#include <script/standard.h>
+#include <streams.h>
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+static arith_uint256 ExpectedScore(const CMasternode& mn, const uint256& blockHash)
+{
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << mn.vin.prevout << mn.nCollateralMinConfBlockHash << blockHash;
+    return UintToArith256(ss.GetHash());
+}
+
+BOOST_FIXTURE_TEST_SUITE(masternode_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(masternode_score)
+{
+    CMasternode mn;
+    mn.vin = CTxIn(COutPoint(InsecureRand256(), 0x01020304));
+    mn.nCollateralMinConfBlockHash = InsecureRand256();
+    for (int i = 0; i < 10; i++) {
+        const uint256 blockHash = InsecureRand256();
+        BOOST_CHECK(mn.CalculateScore(blockHash) == ExpectedScore(mn, blockHash));
+    }
+
+    // The score follows the collateral and its confirmation block
+    const uint256 blockHash = InsecureRand256();
+    mn.nCollateralMinConfBlockHash = InsecureRand256();
+    BOOST_CHECK(mn.CalculateScore(blockHash) == ExpectedScore(mn, blockHash));
+    mn.vin = CTxIn(COutPoint(mn.vin.prevout.hash, 7));
+    BOOST_CHECK(mn.CalculateScore(blockHash) == ExpectedScore(mn, blockHash));
+
+    CMasternode mnCopy(mn);
+    BOOST_CHECK(mnCopy.CalculateScore(blockHash) == mn.CalculateScore(blockHash));
+    mnCopy = CMasternode();
+    BOOST_CHECK(mnCopy.CalculateScore(blockHash) == ExpectedScore(mnCopy, blockHash));
+}
+
+BOOST_AUTO_TEST_CASE(masternode_scores_batch)
+{
+    // Enough masternodes for the 8-way, 4-way and 1-way hashing
+    std::vector<CMasternode> vecMasternodes(13);
+    std::vector<CMasternode*> vecPtrs;
+    for (CMasternode& mn : vecMasternodes) {
+        mn.vin = CTxIn(COutPoint(InsecureRand256(), InsecureRand32()));
+        mn.nCollateralMinConfBlockHash = InsecureRand256();
+        vecPtrs.push_back(&mn);
+    }
+    const uint256 blockHash = InsecureRand256();
+    for (size_t n = 0; n <= vecPtrs.size(); n++) {
+        std::vector<CMasternode*> vecBatch(vecPtrs.begin(), vecPtrs.begin() + n);
+        std::vector<arith_uint256> vecScores;
+        CMasternode::CalculateScores(vecBatch, blockHash, vecScores);
+        BOOST_CHECK_EQUAL(vecScores.size(), n);
+        for (size_t i = 0; i < n; i++) {
+            BOOST_CHECK(vecScores[i] == ExpectedScore(*vecBatch[i], blockHash));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(masternode_payee)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    const CScript payee = GetScriptForDestination(key.GetPubKey().GetID());
+    const CScript other = CScript() << OP_TRUE;
+    CMasternode mn(CService(), COutPoint(InsecureRand256(), 0), key.GetPubKey(), key.GetPubKey(), PROTOCOL_VERSION);
+    BOOST_CHECK(mn.payeeScript == payee);
+    BOOST_CHECK(mn.IsPayee(payee, GetPayeeHash(payee)));
+    BOOST_CHECK(!mn.IsPayee(other, GetPayeeHash(other)));
+    // The scripts are still compared when the hashes match
+    BOOST_CHECK(!mn.IsPayee(other, mn.nPayeeHash));
+
+    // Copied with the masternode and computed again when read
+    const masternode_info_t info = mn.GetInfo();
+    BOOST_CHECK(info.IsPayee(payee, GetPayeeHash(payee)));
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << mn;
+    CMasternode mnRead;
+    ss >> mnRead;
+    BOOST_CHECK(mnRead.payeeScript == payee);
+    BOOST_CHECK_EQUAL(mnRead.nPayeeHash, mn.nPayeeHash);
+
+    ss << CMasternodeBroadcast(mn);
+    CMasternodeBroadcast mnbRead;
+    ss >> mnbRead;
+    BOOST_CHECK(mnbRead.IsPayee(payee, GetPayeeHash(payee)));
+}
+
+BOOST_FIXTURE_TEST_CASE(active_masternode_notified, TestingSetup)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    const bool fMasterNodeOld = fMasterNode;
+    fMasterNode = true;
+    activeMasternode.pubKeyMasternode = key.GetPubKey();
+    activeMasternode.TakeEntryChanged();
+
+    CMasternodeMan man;
+    CMasternode mn;
+    mn.vin = CTxIn(COutPoint(InsecureRand256(), 0));
+    CKey keyOther;
+    keyOther.MakeNewKey(true);
+    mn.pubKeyMasternode = keyOther.GetPubKey();
+
+    // Other masternodes don't wake the active masternode up
+    BOOST_CHECK(man.Add(mn));
+    BOOST_CHECK(!activeMasternode.TakeEntryChanged());
+
+    mn.vin = CTxIn(COutPoint(InsecureRand256(), 0));
+    mn.pubKeyMasternode = key.GetPubKey();
+    BOOST_CHECK(man.Add(mn));
+    BOOST_CHECK(activeMasternode.TakeEntryChanged());
+    BOOST_CHECK(!activeMasternode.TakeEntryChanged());
+
+    BOOST_CHECK(man.PoSeBan(mn.vin.prevout));
+    BOOST_CHECK(activeMasternode.TakeEntryChanged());
+
+    man.Clear();
+    BOOST_CHECK(activeMasternode.TakeEntryChanged());
+
+    fMasterNode = fMasterNodeOld;
+    activeMasternode.pubKeyMasternode = CPubKey();
+}
+
+BOOST_AUTO_TEST_CASE(hosted_masternodes)
+{
+    CKey key1, key2;
+    key1.MakeNewKey(true);
+    key2.MakeNewKey(true);
+
+    CHostedMasternodes hosted;
+    std::string strError;
+    BOOST_CHECK(!hosted.Add("mn1", "notakey", "1.2.3.4:21337", strError));
+    BOOST_CHECK(!hosted.Add("mn1", EncodeSecret(key1), "notanaddress", strError));
+    BOOST_CHECK(hosted.Add("mn1", EncodeSecret(key1), "1.2.3.4:21337", strError));
+    // Neither the key nor the address may be shared
+    BOOST_CHECK(!hosted.Add("mn2", EncodeSecret(key1), "1.2.3.5:21337", strError));
+    BOOST_CHECK(!hosted.Add("mn2", EncodeSecret(key2), "1.2.3.4:21338", strError));
+    BOOST_CHECK(hosted.Add("mn2", EncodeSecret(key2), "1.2.3.5:21337", strError));
+    BOOST_CHECK_EQUAL(hosted.size(), 2U);
+
+    for (const CHostedMasternodes::CHostedMasternode& mn : hosted.GetMasternodes()) {
+        BOOST_CHECK(mn.activeMasternode.serviceHosted.IsValid());
+        BOOST_CHECK(mn.nTimeNextPing < GetTime() + HOSTED_MASTERNODE_PING_JITTER_SECONDS);
+    }
+
+    // Only the entry of the changed key is woken up
+    CActiveMasternode& mn1 = const_cast<CActiveMasternode&>(hosted.GetMasternodes().front().activeMasternode);
+    CActiveMasternode& mn2 = const_cast<CActiveMasternode&>(hosted.GetMasternodes().back().activeMasternode);
+    mn1.TakeEntryChanged();
+    mn2.TakeEntryChanged();
+    hosted.NotifyEntryChanged(key2.GetPubKey());
+    BOOST_CHECK(!mn1.TakeEntryChanged());
+    BOOST_CHECK(mn2.TakeEntryChanged());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
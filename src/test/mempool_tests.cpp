@@ -590,6 +590,62 @@ inline CTransactionRef make_tx(std::vector<CAmount>&& output_values, std::vector
 }
 
 
+BOOST_AUTO_TEST_CASE(MempoolInstantSendLockedTest)
+{
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+    TestMemPoolEntryHelper entry;
+
+    // A low fee parent with a locked child, and an unrelated transaction with a higher fee
+    CMutableTransaction tx1 = CMutableTransaction();
+    tx1.vin.resize(1);
+    tx1.vin[0].scriptSig = CScript() << OP_1;
+    tx1.vout.resize(1);
+    tx1.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+    tx1.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(entry.Fee(1000LL).FromTx(tx1));
+
+    CMutableTransaction tx2 = CMutableTransaction();
+    tx2.vin.resize(1);
+    tx2.vin[0].prevout = COutPoint(tx1.GetHash(), 0);
+    tx2.vin[0].scriptSig = CScript() << OP_1;
+    tx2.vout.resize(1);
+    tx2.vout[0].scriptPubKey = CScript() << OP_2 << OP_EQUAL;
+    tx2.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(entry.Fee(1000LL).FromTx(tx2));
+
+    CMutableTransaction tx3 = CMutableTransaction();
+    tx3.vin.resize(1);
+    tx3.vin[0].scriptSig = CScript() << OP_3;
+    tx3.vout.resize(1);
+    tx3.vout[0].scriptPubKey = CScript() << OP_3 << OP_EQUAL;
+    tx3.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(entry.Fee(50000LL).FromTx(tx3));
+
+    unsigned int nUpdated = pool.GetTransactionsUpdated();
+    pool.SetInstantSendLocked(tx2.GetHash());
+    BOOST_CHECK(pool.IsInstantSendLocked(tx2.GetHash()));
+    BOOST_CHECK_EQUAL(pool.GetTransactionsUpdated(), nUpdated + 1);
+    std::vector<CTxMemPool::txiter> vLocked = pool.GetInstantSendLocked();
+    BOOST_REQUIRE_EQUAL(vLocked.size(), 1U);
+    BOOST_CHECK(vLocked[0]->GetTx().GetHash() == tx2.GetHash());
+
+    // The package of the locked transaction stays, the other one goes
+    pool.TrimToSize(pool.DynamicMemoryUsage() * 3 / 4);
+    BOOST_CHECK(pool.exists(tx1.GetHash()));
+    BOOST_CHECK(pool.exists(tx2.GetHash()));
+    BOOST_CHECK(!pool.exists(tx3.GetHash()));
+
+    // Nothing left to evict
+    pool.TrimToSize(0);
+    BOOST_CHECK_EQUAL(pool.size(), 2U);
+
+    pool.UnsetInstantSendLocked(tx2.GetHash());
+    BOOST_CHECK(pool.GetInstantSendLocked().empty());
+    pool.TrimToSize(0);
+    BOOST_CHECK_EQUAL(pool.size(), 0U);
+}
+
 BOOST_AUTO_TEST_CASE(MempoolAncestryTests)
 {
     size_t ancestors, descendants;
@@ -749,4 +805,58 @@ BOOST_AUTO_TEST_CASE(MempoolAncestryTests)
     BOOST_CHECK_EQUAL(descendants, 6ULL);
 }
 
+// VELES BEGIN
+BOOST_AUTO_TEST_CASE(MempoolRemoveForBlockChainTest)
+{
+    CTxMemPool pool;
+    LOCK2(cs_main, pool.cs);
+    TestMemPoolEntryHelper entry;
+
+    // A chain of ten transactions, the sixth one also spent together with an unrelated one
+    std::vector<CTransactionRef> vChain;
+    for (int i = 0; i < 10; i++) {
+        vChain.push_back(i == 0 ? make_tx({10 * COIN, 10 * COIN}) : make_tx({10 * COIN, 10 * COIN}, {vChain.back()}));
+        pool.addUnchecked(entry.Fee(1000LL * (i + 1)).FromTx(vChain.back()));
+    }
+    CTransactionRef txOther = make_tx({10 * COIN});
+    pool.addUnchecked(entry.Fee(20000LL).FromTx(txOther));
+    CTransactionRef txSide = make_tx({15 * COIN}, {vChain[5], txOther}, {1, 0});
+    pool.addUnchecked(entry.Fee(30000LL).FromTx(txSide));
+
+    // The block confirms the first six
+    std::vector<CTransactionRef> vBlock(vChain.begin(), vChain.begin() + 6);
+    pool.removeForBlock(vBlock, 1);
+    BOOST_CHECK_EQUAL(pool.size(), 6U);
+    for (const auto& tx : vBlock) {
+        BOOST_CHECK(!pool.exists(tx->GetHash()));
+    }
+
+    // What is left has the same state as if it was added to the mempool on its own
+    const int64_t nTxSize = pool.mapTx.find(vChain[6]->GetHash())->GetTxSize();
+    for (int i = 6; i < 10; i++) {
+        auto it = pool.mapTx.find(vChain[i]->GetHash());
+        BOOST_CHECK_EQUAL(it->GetCountWithAncestors(), (uint64_t)(i - 5));
+        BOOST_CHECK_EQUAL(it->GetSizeWithAncestors(), (uint64_t)(nTxSize * (i - 5)));
+        CAmount nFees = 0;
+        for (int j = 6; j <= i; j++) nFees += 1000LL * (j + 1);
+        BOOST_CHECK_EQUAL(it->GetModFeesWithAncestors(), nFees);
+        BOOST_CHECK_EQUAL(it->GetCountWithDescendants(), (uint64_t)(10 - i));
+        BOOST_CHECK(pool.GetMemPoolParents(it).size() == (i == 6 ? 0U : 1U));
+    }
+    auto itSide = pool.mapTx.find(txSide->GetHash());
+    auto itOther = pool.mapTx.find(txOther->GetHash());
+    BOOST_CHECK_EQUAL(itSide->GetCountWithAncestors(), 2U);
+    BOOST_CHECK_EQUAL(itSide->GetSizeWithAncestors(), itSide->GetTxSize() + itOther->GetTxSize());
+    BOOST_CHECK_EQUAL(itSide->GetModFeesWithAncestors(), 50000LL);
+    BOOST_CHECK_EQUAL(pool.GetMemPoolParents(itSide).size(), 1U);
+    BOOST_CHECK_EQUAL(itOther->GetCountWithDescendants(), 2U);
+
+    // A block leaving an in-mempool parent behind still goes through
+    pool.removeForBlock({vChain[7]}, 2);
+    BOOST_CHECK(!pool.exists(vChain[7]->GetHash()));
+    BOOST_CHECK_EQUAL(pool.mapTx.find(vChain[6]->GetHash())->GetCountWithDescendants(), 1U);
+    BOOST_CHECK_EQUAL(pool.mapTx.find(vChain[8]->GetHash())->GetCountWithAncestors(), 2U);
+}
+// VELES END
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,108 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <mempooljournal.h>
+#include <policy/policy.h>
+#include <primitives/transaction.h>
+#include <test/test_bitcoin.h>
+#include <txmempool.h>
+#include <util/system.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(mempooljournal_tests, TestingSetup)
+
+static CTransactionRef MakeTx(const CTransactionRef& parent, CAmount nValue)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    if (parent) tx.vin[0].prevout = COutPoint(parent->GetHash(), 0);
+    tx.vin[0].scriptSig = CScript() << OP_11;
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx.vout[0].nValue = nValue;
+    return MakeTransactionRef(tx);
+}
+
+BOOST_AUTO_TEST_CASE(mempooljournal_replay)
+{
+    const fs::path path = GetDataDir() / MEMPOOL_JOURNAL_FILENAME;
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+    CTransactionRef tx1 = MakeTx(nullptr, 10 * COIN);
+    CTransactionRef tx2 = MakeTx(tx1, 9 * COIN);
+    CTransactionRef tx3 = MakeTx(nullptr, 8 * COIN);
+
+    {
+        LOCK2(cs_main, pool.cs);
+        pool.addUnchecked(entry.Fee(1000).Time(100).FromTx(tx1));
+    }
+    pool.PrioritiseTransaction(tx3->GetHash(), 500);
+
+    // The contents of the pool are written when the journal is opened
+    CMempoolJournal journal;
+    BOOST_CHECK(journal.Open(pool));
+    CMempoolJournal::Contents contents;
+    BOOST_CHECK(CMempoolJournal::Read(path, contents));
+    BOOST_CHECK_EQUAL(contents.vtx.size(), 1U);
+    BOOST_CHECK(contents.vtx[0].first->GetHash() == tx1->GetHash());
+    BOOST_CHECK_EQUAL(contents.vtx[0].second, 100);
+    BOOST_CHECK_EQUAL(contents.mapDeltas[tx3->GetHash()], 500);
+
+    // Changes are appended on flush
+    {
+        LOCK2(cs_main, pool.cs);
+        pool.addUnchecked(entry.Fee(1000).Time(200).FromTx(tx2));
+        pool.addUnchecked(entry.Fee(1000).Time(300).FromTx(tx3));
+    }
+    pool.PrioritiseTransaction(tx3->GetHash(), 200);
+    pool.PrioritiseTransaction(tx2->GetHash(), 100);
+    pool.ClearPrioritisation(tx2->GetHash());
+    pool.SetInstantSendLocked(tx2->GetHash());
+    pool.SetInstantSendLocked(tx3->GetHash());
+    pool.UnsetInstantSendLocked(tx3->GetHash());
+    pool.removeRecursive(*tx3);
+    journal.Flush();
+
+    contents = CMempoolJournal::Contents();
+    BOOST_CHECK(CMempoolJournal::Read(path, contents));
+    BOOST_CHECK_EQUAL(contents.vtx.size(), 2U);
+    BOOST_CHECK(contents.vtx[0].first->GetHash() == tx1->GetHash());
+    BOOST_CHECK(contents.vtx[1].first->GetHash() == tx2->GetHash());
+    BOOST_CHECK_EQUAL(contents.vtx[1].second, 200);
+    BOOST_CHECK_EQUAL(contents.mapDeltas.size(), 1U);
+    BOOST_CHECK_EQUAL(contents.mapDeltas[tx3->GetHash()], 700);
+    BOOST_CHECK_EQUAL(contents.setLocked.size(), 1U);
+    BOOST_CHECK(contents.setLocked.count(tx2->GetHash()));
+
+    // Closing writes the records buffered since, the pool is not followed any more
+    pool.removeRecursive(*tx1);
+    BOOST_CHECK(journal.Close());
+    {
+        LOCK2(cs_main, pool.cs);
+        pool.addUnchecked(entry.Fee(1000).Time(400).FromTx(tx3));
+    }
+    BOOST_CHECK(!journal.Close());
+
+    contents = CMempoolJournal::Contents();
+    BOOST_CHECK(CMempoolJournal::Read(path, contents));
+    BOOST_CHECK(contents.vtx.empty());
+
+    // A record cut short ends the journal
+    const uintmax_t nSize = fs::file_size(path);
+    {
+        FILE* file = fsbridge::fopen(path, "ab");
+        const unsigned char partial[] = {CMempoolJournal::TX_ADDED, 0x01, 0x00};
+        BOOST_CHECK_EQUAL(fwrite(partial, 1, sizeof(partial), file), sizeof(partial));
+        fclose(file);
+    }
+    BOOST_CHECK(fs::file_size(path) > nSize);
+    contents = CMempoolJournal::Contents();
+    BOOST_CHECK(CMempoolJournal::Read(path, contents));
+    BOOST_CHECK(contents.vtx.empty());
+    BOOST_CHECK_EQUAL(contents.mapDeltas[tx3->GetHash()], 700);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -244,6 +244,11 @@ BOOST_AUTO_TEST_CASE(merkle_test)
                     BOOST_CHECK(oldBranch == newBranch);
                     BOOST_CHECK(ComputeMerkleRootFromBranch(block.vtx[mtx]->GetHash(), newBranch, mtx) == oldRoot);
                 }
+                // VELES BEGIN
+                if (ntx > 0) {
+                    BOOST_CHECK(BlockCoinbaseMerkleBranch(block) == BlockMerkleBranch(block, 0));
+                }
+                // VELES END
             }
         }
     }
@@ -0,0 +1,62 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <arith_uint256.h>
+#include <chain.h>
+#include <metrics.h>
+#include <primitives/block.h>
+#include <test/test_bitcoin.h>
+#include <versionbits.h>
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(metrics_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(metrics_histogram)
+{
+    CMetricsHistogram hist;
+    hist.Observe(50000);
+    hist.Observe(1000000);
+    hist.Observe(120000000);
+
+    std::string out;
+    hist.Render("test_latency_seconds", "Test", out);
+    BOOST_CHECK(out.find("# TYPE test_latency_seconds histogram\n") != std::string::npos);
+    BOOST_CHECK(out.find("test_latency_seconds_bucket{le=\"0.1\"} 1\n") != std::string::npos);
+    BOOST_CHECK(out.find("test_latency_seconds_bucket{le=\"0.5\"} 1\n") != std::string::npos);
+    BOOST_CHECK(out.find("test_latency_seconds_bucket{le=\"1\"} 2\n") != std::string::npos);
+    BOOST_CHECK(out.find("test_latency_seconds_bucket{le=\"60\"} 2\n") != std::string::npos);
+    BOOST_CHECK(out.find("test_latency_seconds_bucket{le=\"+Inf\"} 3\n") != std::string::npos);
+    BOOST_CHECK(out.find("test_latency_seconds_sum 121.050000\n") != std::string::npos);
+    BOOST_CHECK(out.find("test_latency_seconds_count 3\n") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(metrics_algo_tip)
+{
+    const int32_t algos[] = {ALGO_SHA256D, ALGO_SCRYPT, ALGO_X11, ALGO_SCRYPT, ALGO_SHA256D};
+    std::vector<CBlockIndex> vIndex(5);
+    std::vector<uint256> vHash(5);
+    for (size_t i = 0; i < vIndex.size(); i++) {
+        vHash[i] = ArithToUint256(arith_uint256(i + 1));
+        vIndex[i].phashBlock = &vHash[i];
+        vIndex[i].pprev = i ? &vIndex[i - 1] : nullptr;
+        vIndex[i].nHeight = i;
+        vIndex[i].nVersion = VERSIONBITS_TOP_BITS | algos[i];
+    }
+
+    CMetrics metrics;
+    metrics.SetTip(&vIndex.back(), false);
+    const std::string out = metrics.Render();
+    BOOST_CHECK(out.find("veles_tip_height 4\n") != std::string::npos);
+    BOOST_CHECK(out.find("veles_initial_block_download 0\n") != std::string::npos);
+    BOOST_CHECK(out.find("veles_algo_tip_height{algo=\"sha256d\"} 4\n") != std::string::npos);
+    BOOST_CHECK(out.find("veles_algo_tip_height{algo=\"scrypt\"} 3\n") != std::string::npos);
+    BOOST_CHECK(out.find("veles_algo_tip_height{algo=\"x11\"} 2\n") != std::string::npos);
+    // Algos without a block are left out
+    BOOST_CHECK(out.find("algo=\"x16r\"") == std::string::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
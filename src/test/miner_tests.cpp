@@ -12,12 +12,14 @@
 #include <validation.h>
 #include <miner.h>
 #include <policy/policy.h>
+#include <pow.h>
 #include <pubkey.h>
 #include <script/standard.h>
 #include <txmempool.h>
 #include <uint256.h>
 #include <util/system.h>
 #include <util/strencodings.h>
+#include <versionbits.h>
 
 #include <test/test_bitcoin.h>
 
@@ -135,6 +137,21 @@ static void TestPackageSelection(const CChainParams& chainparams, const CScript&
     BOOST_CHECK(pblocktemplate->block.vtx[2]->GetHash() == hashHighFeeTx);
     BOOST_CHECK(pblocktemplate->block.vtx[3]->GetHash() == hashMediumFeeTx);
 
+    // VELES BEGIN
+    // A template of another algo reuses the selected transactions
+    std::unique_ptr<CBlockTemplate> pblocktemplateAlgo = AssemblerForTest(chainparams).CreateNewBlock(*pblocktemplate, scriptPubKey, ALGO_X11);
+    BOOST_CHECK_EQUAL(pblocktemplateAlgo->block.nVersion & ALGO_VERSION_MASK, ALGO_X11);
+    BOOST_CHECK_EQUAL(pblocktemplateAlgo->block.vtx.size(), pblocktemplate->block.vtx.size());
+    for (size_t i = 1; i < pblocktemplate->block.vtx.size(); i++)
+        BOOST_CHECK(pblocktemplateAlgo->block.vtx[i] == pblocktemplate->block.vtx[i]);
+    BOOST_CHECK_EQUAL(pblocktemplateAlgo->vTxFees[0], pblocktemplate->vTxFees[0]);
+
+    // From here on a selection follows the mempool changes below
+    BlockSelection selection;
+    selection.RegisterWithMempoolSignals(mempool);
+    AssemblerForTest(chainparams).CreateNewBlock(scriptPubKey, ALGO_NULL, &selection);
+    // VELES END
+
     // Test that a package below the block min tx fee doesn't get included
     tx.vin[0].prevout.hash = hashHighFeeTx;
     tx.vout[0].nValue = 5000000000LL - 1000 - 50000; // 0 fee
@@ -200,6 +217,20 @@ static void TestPackageSelection(const CChainParams& chainparams, const CScript&
     mempool.addUnchecked(entry.Fee(10000).FromTx(tx));
     pblocktemplate = AssemblerForTest(chainparams).CreateNewBlock(scriptPubKey);
     BOOST_CHECK(pblocktemplate->block.vtx[8]->GetHash() == hashLowFeeTx2);
+
+    // VELES BEGIN
+    // The updated selection ends up with the transactions selected from scratch
+    std::unique_ptr<CBlockTemplate> pblocktemplateUpdated = AssemblerForTest(chainparams).CreateNewBlock(scriptPubKey, ALGO_NULL, &selection);
+    BOOST_CHECK_EQUAL(pblocktemplateUpdated->block.vtx.size(), pblocktemplate->block.vtx.size());
+    std::set<uint256> setSelected, setUpdated;
+    for (size_t i = 1; i < pblocktemplate->block.vtx.size(); i++)
+        setSelected.insert(pblocktemplate->block.vtx[i]->GetHash());
+    for (size_t i = 1; i < pblocktemplateUpdated->block.vtx.size(); i++)
+        setUpdated.insert(pblocktemplateUpdated->block.vtx[i]->GetHash());
+    BOOST_CHECK(setUpdated == setSelected);
+    BOOST_CHECK_EQUAL(pblocktemplateUpdated->vTxFees[0], pblocktemplate->vTxFees[0]);
+    selection.UnregisterWithMempoolSignals(mempool);
+    // VELES END
 }
 
 // NOTE: These tests rely on CreateNewBlock doing its own self-validation!
@@ -522,4 +553,46 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     fCheckpointsEnabled = true;*/
 }
 
+// VELES BEGIN
+BOOST_AUTO_TEST_CASE(ScanNonces_threads)
+{
+    const auto chainParams = CreateChainParams(CBaseChainParams::REGTEST);
+    const Consensus::Params& params = chainParams->GetConsensus();
+
+    CBlockHeader header;
+    header.hashPrevBlock = uint256S("7dfeab8f971393e0e0a2ed1f2415b44ba554a6ec8e8bec1d4da8e8bd4268fe1e");
+    header.hashMerkleRoot = uint256S("cc2bb606c64c5bfc07a4e7e236ebf05a28aa0d9ee15fb0b6fd4a21e22d479b10");
+    header.nTime = 1546300800;
+    header.nBits = 0x2000ffff; // about one in 128 hashes
+
+    for (int32_t nAlgo : {ALGO_SHA256D, ALGO_SCRYPT, ALGO_LYRA2Z, ALGO_X11, ALGO_X16R}) {
+        header.nVersion = VERSIONBITS_TOP_BITS | nAlgo;
+
+        // Any number of threads finds the lowest solution
+        CBlockHeader headerSingle = header;
+        uint64_t nMaxTries = 100000;
+        BOOST_CHECK(ScanNonces(headerSingle, 0x10000, nMaxTries, 1, params));
+        BOOST_CHECK(CheckProofOfWork(headerSingle.GetPoWHash(), headerSingle.nBits, params));
+        BOOST_CHECK_EQUAL(nMaxTries, 100000U - headerSingle.nNonce - 1);
+        for (uint32_t nNonce = 0; nNonce < headerSingle.nNonce; nNonce++) {
+            CBlockHeader headerFailed = header;
+            headerFailed.nNonce = nNonce;
+            BOOST_CHECK(!CheckProofOfWork(headerFailed.GetPoWHash(), headerFailed.nBits, params));
+        }
+
+        CBlockHeader headerThreads = header;
+        nMaxTries = 100000;
+        BOOST_CHECK(ScanNonces(headerThreads, 0x10000, nMaxTries, 4, params));
+        BOOST_CHECK_EQUAL(headerThreads.nNonce, headerSingle.nNonce);
+
+        // Without a solution in range the nonce stops at the end of the range
+        CBlockHeader headerRange = header;
+        nMaxTries = headerSingle.nNonce;
+        BOOST_CHECK(!ScanNonces(headerRange, 0x10000, nMaxTries, 2, params));
+        BOOST_CHECK_EQUAL(headerRange.nNonce, headerSingle.nNonce);
+        BOOST_CHECK_EQUAL(nMaxTries, 0U);
+    }
+}
+// VELES END
+
 BOOST_AUTO_TEST_SUITE_END()
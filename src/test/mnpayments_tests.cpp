@@ -0,0 +1,111 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <clientversion.h>
+#include <masternode/payments.h>
+#include <streams.h>
+#include <test/test_bitcoin.h>
+
+#include <map>
+
+#include <boost/test/unit_test.hpp>
+
+static CMasternodePaymentVote MakeVote(int nBlockHeight, const CScript& payee, bool fVerified)
+{
+    CMasternodePaymentVote vote(COutPoint(InsecureRand256(), InsecureRandRange(4)), nBlockHeight, payee);
+    if (fVerified) {
+        vote.vchSig.resize(CPubKey::COMPACT_SIGNATURE_SIZE);
+        for (unsigned char& ch : vote.vchSig) ch = InsecureRandBits(8);
+    }
+    return vote;
+}
+
+static bool EqualVotes(const CMasternodePaymentVote& a, const CMasternodePaymentVote& b)
+{
+    return a.vinMasternode == b.vinMasternode && a.nBlockHeight == b.nBlockHeight && a.payee == b.payee && a.vchSig == b.vchSig;
+}
+
+BOOST_FIXTURE_TEST_SUITE(mnpayments_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(paymentvotestore_put_get)
+{
+    CMasternodePaymentVoteStore store;
+    const CScript payee1 = CScript() << OP_TRUE;
+    const CScript payee2 = CScript() << OP_FALSE;
+
+    // A vote is first stored as not verified, then replaced once checked
+    CMasternodePaymentVote vote = MakeVote(100, payee1, true);
+    CMasternodePaymentVote voteNotVerified(vote);
+    voteNotVerified.MarkAsNotVerified();
+    store.Put(vote.GetHash(), voteNotVerified);
+    BOOST_CHECK(store.Has(vote.GetHash()));
+    BOOST_CHECK(!store.IsVerified(vote.GetHash()));
+    store.Put(vote.GetHash(), vote);
+    BOOST_CHECK(store.IsVerified(vote.GetHash()));
+    BOOST_CHECK_EQUAL(store.size(), 1U);
+
+    CMasternodePaymentVote voteRet;
+    BOOST_CHECK(store.Get(vote.GetHash(), voteRet));
+    BOOST_CHECK(EqualVotes(vote, voteRet));
+
+    std::vector<CMasternodePaymentVote> vecVotes;
+    for (int i = 0; i < 20; i++) {
+        vecVotes.push_back(MakeVote(100 + i / 4, i % 3 ? payee1 : payee2, i % 5 != 0));
+        store.Put(vecVotes.back().GetHash(), vecVotes.back());
+    }
+    BOOST_CHECK_EQUAL(store.size(), 21U);
+    for (const CMasternodePaymentVote& entry : vecVotes) {
+        BOOST_CHECK(store.Get(entry.GetHash(), voteRet));
+        BOOST_CHECK(EqualVotes(entry, voteRet));
+        BOOST_CHECK_EQUAL(store.IsVerified(entry.GetHash()), !entry.vchSig.empty());
+    }
+    BOOST_CHECK(!store.Has(InsecureRand256()));
+
+    // Whole heights are dropped
+    BOOST_CHECK_EQUAL(store.EraseBelow(102), 9U);
+    BOOST_CHECK_EQUAL(store.size(), 12U);
+    BOOST_CHECK(!store.Has(vote.GetHash()));
+    for (size_t i = 0; i < vecVotes.size(); i++) {
+        BOOST_CHECK_EQUAL(store.Has(vecVotes[i].GetHash()), i >= 8);
+    }
+
+    // The payees of the dropped votes are reused
+    CMasternodePaymentVote voteNew = MakeVote(200, CScript() << OP_2, true);
+    store.Put(voteNew.GetHash(), voteNew);
+    BOOST_CHECK(store.Get(voteNew.GetHash(), voteRet));
+    BOOST_CHECK(EqualVotes(voteNew, voteRet));
+    BOOST_CHECK(store.Get(vecVotes.back().GetHash(), voteRet));
+    BOOST_CHECK(EqualVotes(vecVotes.back(), voteRet));
+
+    store.Clear();
+    BOOST_CHECK_EQUAL(store.size(), 0U);
+    BOOST_CHECK(!store.Has(voteNew.GetHash()));
+}
+
+BOOST_AUTO_TEST_CASE(paymentvotestore_serialization)
+{
+    // The cache format of the std::map based votes
+    std::map<uint256, CMasternodePaymentVote> mapVotes;
+    for (int i = 0; i < 10; i++) {
+        CMasternodePaymentVote vote = MakeVote(300 + i % 3, CScript() << i % 2, i % 4 != 0);
+        mapVotes[vote.GetHash()] = vote;
+    }
+    CDataStream stream(SER_DISK, CLIENT_VERSION);
+    stream << mapVotes;
+
+    CMasternodePaymentVoteStore store;
+    stream >> store;
+    BOOST_CHECK_EQUAL(store.size(), mapVotes.size());
+
+    stream << store;
+    std::map<uint256, CMasternodePaymentVote> mapStored;
+    stream >> mapStored;
+    BOOST_CHECK_EQUAL(mapStored.size(), mapVotes.size());
+    for (const auto& entry : mapVotes) {
+        BOOST_CHECK(mapStored.count(entry.first));
+        BOOST_CHECK(EqualVotes(entry.second, mapStored[entry.first]));
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
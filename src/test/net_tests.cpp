@@ -10,6 +10,7 @@
 #include <streams.h>
 #include <net.h>
 #include <netbase.h>
+#include <netmessagemaker.h> // VELES
 #include <chainparams.h>
 #include <util/system.h>
 
@@ -302,5 +303,55 @@ BOOST_AUTO_TEST_CASE(LocalAddress_BasicLifecycle)
     BOOST_CHECK_EQUAL(IsLocal(addr), false);
 }
 
+// VELES BEGIN
+BOOST_AUTO_TEST_CASE(send_priority_classes)
+{
+    BOOST_CHECK_EQUAL(GetSendPriority(NetMsgType::CMPCTBLOCK), SEND_PRIORITY_HIGH);
+    BOOST_CHECK_EQUAL(GetSendPriority(NetMsgType::TXLOCKVOTE), SEND_PRIORITY_HIGH);
+    BOOST_CHECK_EQUAL(GetSendPriority(NetMsgType::PING), SEND_PRIORITY_HIGH);
+    BOOST_CHECK_EQUAL(GetSendPriority(NetMsgType::TX), SEND_PRIORITY_TX);
+    BOOST_CHECK_EQUAL(GetSendPriority(NetMsgType::MNPING), SEND_PRIORITY_TX);
+    BOOST_CHECK_EQUAL(GetSendPriority(NetMsgType::MNGOVERNANCEOBJECTVOTE), SEND_PRIORITY_SYNC);
+
+    CConnman connman(0x1337, 0x1337);
+    CAddress addr = CAddress(CService(UtilBuildAddress(0x002, 0x001, 0x001, 0x001), 7777), NODE_NETWORK);
+    std::unique_ptr<CNode> pnode = MakeUnique<CNode>(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, CAddress{}, std::string{}, false);
+
+    // A governance sync of a megabyte is queued before a compact block and a transaction
+    const CNetMsgMaker msgMaker(INIT_PROTO_VERSION);
+    for (int i = 0; i < 100; i++) {
+        connman.PushMessage(pnode.get(), msgMaker.Make(NetMsgType::MNGOVERNANCEOBJECTVOTE, std::vector<unsigned char>(10000)));
+    }
+    connman.PushMessage(pnode.get(), msgMaker.Make(NetMsgType::CMPCTBLOCK, std::vector<unsigned char>(20000)));
+    connman.PushMessage(pnode.get(), msgMaker.Make(NetMsgType::TX, std::vector<unsigned char>(300)));
+    connman.PushMessage(pnode.get(), msgMaker.Make(NetMsgType::PING, std::vector<unsigned char>()));
+
+    // Drain the queues as SocketSendData() does, recording the class of every message sent
+    std::vector<int> vSent;
+    {
+        LOCK(pnode->cs_vSend);
+        BOOST_CHECK_EQUAL(pnode->vSendMsg[SEND_PRIORITY_HIGH].size(), 3U);
+        BOOST_CHECK_EQUAL(pnode->vSendMsg[SEND_PRIORITY_TX].size(), 2U);
+        BOOST_CHECK_EQUAL(pnode->vSendMsg[SEND_PRIORITY_SYNC].size(), 200U);
+        while (pnode->nSendParts > 0 || pnode->SelectSendClass()) {
+            auto& queue = pnode->vSendMsg[pnode->nSendClass];
+            pnode->nSendDeficit[pnode->nSendClass] -= queue.front().size();
+            if (--pnode->nSendParts == 0)
+                vSent.push_back(pnode->nSendClass);
+            queue.pop_front();
+        }
+        BOOST_CHECK(pnode->SendQueueEmpty());
+    }
+    BOOST_CHECK_EQUAL(vSent.size(), 103U);
+
+    // The turn of the sync ends with its quantum, the block, the ping and the transaction go next
+    const auto itBlock = std::find(vSent.begin(), vSent.end(), SEND_PRIORITY_HIGH);
+    const auto itTx = std::find(vSent.begin(), vSent.end(), SEND_PRIORITY_TX);
+    BOOST_CHECK(itBlock - vSent.begin() <= 7);
+    BOOST_CHECK(itBlock + 1 != vSent.end() && itBlock[1] == SEND_PRIORITY_HIGH);
+    BOOST_CHECK(itTx - itBlock == 2);
+}
+// VELES END
+
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -281,6 +281,29 @@ BOOST_AUTO_TEST_CASE(subnet_test)
 
 }
 
+// VELES BEGIN
+BOOST_AUTO_TEST_CASE(subnet_prefix_test)
+{
+    BOOST_CHECK_EQUAL(ResolveSubNet("1.2.3.4").GetPrefixLength(), 128);
+    BOOST_CHECK_EQUAL(ResolveSubNet("1.2.3.0/24").GetPrefixLength(), 120);
+    BOOST_CHECK_EQUAL(ResolveSubNet("1.2.0.0/255.255.128.0").GetPrefixLength(), 113);
+    BOOST_CHECK_EQUAL(ResolveSubNet("2001:db8::/32").GetPrefixLength(), 32);
+    BOOST_CHECK_EQUAL(ResolveSubNet("::/0").GetPrefixLength(), 0);
+    BOOST_CHECK_EQUAL(ResolveSubNet("1.2.0.4/255.255.0.255").GetPrefixLength(), -1);
+    BOOST_CHECK_EQUAL(CSubNet().GetPrefixLength(), -1);
+
+    // The subnet of an address with the prefix of a matching subnet is that subnet
+    for (const char* str : {"1.2.3.4", "1.2.3.0/24", "1.2.0.0/255.255.128.0", "2001:db8::/32", "::/0", "0.0.0.0/0"}) {
+        const CSubNet subnet = ResolveSubNet(str);
+        const CNetAddr addr = ResolveIP(subnet.Match(ResolveIP("1.2.3.4")) ? "1.2.3.4" : "2001:db8::1");
+        BOOST_CHECK(subnet.Match(addr));
+        BOOST_CHECK(CSubNet::FromPrefix(addr, subnet.GetPrefixLength()) == subnet);
+    }
+    BOOST_CHECK(CSubNet::FromPrefix(ResolveIP("1.2.4.4"), 120) != ResolveSubNet("1.2.3.0/24"));
+    BOOST_CHECK(!CSubNet::FromPrefix(ResolveIP("1.2.3.4"), 129).IsValid());
+}
+// VELES END
+
 BOOST_AUTO_TEST_CASE(netbase_getgroup)
 {
 
@@ -0,0 +1,96 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <clientversion.h>
+#include <netbase.h>
+#include <netfulfilledman.h>
+#include <streams.h>
+#include <test/test_bitcoin.h>
+#include <util/time.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(netfulfilledman_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(netfulfilledman_expiry)
+{
+    const int64_t nStart = 1560000000;
+    const int64_t nExpire = Params().FulfilledRequestExpireTime();
+    const CAddress addr1(LookupNumeric("1.2.3.4", 8333), NODE_NONE);
+    const CAddress addr2(LookupNumeric("5.6.7.8", 8333), NODE_NONE);
+    CNetFulfilledRequestManager man;
+
+    SetMockTime(nStart);
+    man.AddFulfilledRequest(addr1, FULFILLED_FULL_SYNC);
+    man.AddFulfilledRequest(addr2, FULFILLED_SPORK_SYNC);
+    BOOST_CHECK(man.HasFulfilledRequest(addr1, FULFILLED_FULL_SYNC));
+    BOOST_CHECK(!man.HasFulfilledRequest(addr1, FULFILLED_SPORK_SYNC));
+
+    // Adding a request again pushes its expiry back
+    SetMockTime(nStart + 100);
+    man.AddFulfilledRequest(addr2, FULFILLED_SPORK_SYNC);
+
+    SetMockTime(nStart + nExpire - 1);
+    man.CheckAndRemove();
+    BOOST_CHECK(man.HasFulfilledRequest(addr1, FULFILLED_FULL_SYNC));
+    BOOST_CHECK_EQUAL(man.ToString(), "Nodes with fulfilled requests: 2");
+
+    SetMockTime(nStart + nExpire);
+    BOOST_CHECK(!man.HasFulfilledRequest(addr1, FULFILLED_FULL_SYNC));
+    man.CheckAndRemove();
+    BOOST_CHECK_EQUAL(man.ToString(), "Nodes with fulfilled requests: 1");
+    BOOST_CHECK(man.HasFulfilledRequest(addr2, FULFILLED_SPORK_SYNC));
+
+    man.RemoveFulfilledRequest(addr2, FULFILLED_SPORK_SYNC);
+    BOOST_CHECK(!man.HasFulfilledRequest(addr2, FULFILLED_SPORK_SYNC));
+    BOOST_CHECK_EQUAL(man.ToString(), "Nodes with fulfilled requests: 0");
+
+    SetMockTime(nStart + 2 * nExpire);
+    man.CheckAndRemove();
+    BOOST_CHECK_EQUAL(man.ToString(), "Nodes with fulfilled requests: 0");
+
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_CASE(netfulfilledman_serialization)
+{
+    const int64_t nStart = 1560000000;
+    const CAddress addr(LookupNumeric("1.2.3.4", 8333), NODE_NONE);
+    SetMockTime(nStart);
+
+    // Requests are stored by name, unknown names are dropped on load
+    std::map<CNetAddr, std::map<std::string, int64_t> > mapRequests;
+    mapRequests[addr]["governance-sync"] = nStart + 10;
+    mapRequests[addr][std::string(NetMsgType::MNVERIFY) + "-done"] = nStart + 20;
+    mapRequests[addr]["unknown"] = nStart + 30;
+    // Beyond the range of the timing wheel
+    mapRequests[addr]["full-sync"] = nStart + 400 * 24 * 60 * 60;
+    CDataStream stream(SER_DISK, CLIENT_VERSION);
+    stream << mapRequests;
+
+    CNetFulfilledRequestManager man;
+    stream >> man;
+    BOOST_CHECK(man.HasFulfilledRequest(addr, FULFILLED_GOVERNANCE_SYNC));
+    BOOST_CHECK(man.HasFulfilledRequest(addr, FULFILLED_MNVERIFY_DONE));
+    BOOST_CHECK(man.HasFulfilledRequest(addr, FULFILLED_FULL_SYNC));
+
+    SetMockTime(nStart + 15);
+    man.CheckAndRemove();
+    stream << man;
+    std::map<CNetAddr, std::map<std::string, int64_t> > mapStored;
+    stream >> mapStored;
+    BOOST_CHECK_EQUAL(mapStored.size(), 1U);
+    BOOST_CHECK_EQUAL(mapStored[addr].size(), 2U);
+    BOOST_CHECK_EQUAL(mapStored[addr][std::string(NetMsgType::MNVERIFY) + "-done"], nStart + 20);
+
+    SetMockTime(nStart + 30 * 24 * 60 * 60);
+    man.CheckAndRemove();
+    BOOST_CHECK(man.HasFulfilledRequest(addr, FULFILLED_FULL_SYNC));
+    BOOST_CHECK(!man.HasFulfilledRequest(addr, FULFILLED_MNVERIFY_DONE));
+
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -180,4 +180,82 @@ BOOST_AUTO_TEST_CASE(BlockPolicyEstimates)
     }
 }
 
+BOOST_AUTO_TEST_CASE(TimePolicyEstimates)
+{
+    CBlockPolicyEstimator feeEst;
+    CTxMemPool mpool(&feeEst);
+    LOCK2(cs_main, mpool.cs);
+    TestMemPoolEntryHelper entry;
+    CAmount basefee(2000);
+    CAmount deltaFee(100);
+
+    CScript garbage;
+    for (unsigned int i = 0; i < 128; i++)
+        garbage.push_back('X');
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = garbage;
+    tx.vout.resize(1);
+    tx.vout[0].nValue=0LL;
+    CFeeRate baseRate(basefee, GetVirtualTransactionSize(CTransaction(tx)));
+
+    // Blocks every 2 minutes, where transactions of fee basefee * (j+1) wait 10 - j blocks
+    int64_t nTime = 1500000000;
+    SetMockTime(nTime);
+    std::vector<uint256> txHashes[10];
+    std::vector<CTransactionRef> block;
+    int blocknum = 0;
+    while (blocknum < 200) {
+        for (int j = 0; j < 10; j++) {
+            for (int k = 0; k < 4; k++) {
+                tx.vin[0].prevout.n = 10000*blocknum+100*j+k;
+                mpool.addUnchecked(entry.Fee(basefee * (j+1)).Time(nTime).Height(blocknum).FromTx(tx));
+                txHashes[j].push_back(tx.GetHash());
+            }
+        }
+        nTime += 120;
+        SetMockTime(nTime);
+        for (int j = 0; j < 10; j++) {
+            // The oldest transactions of the fee are due
+            while (txHashes[j].size() > 4 * (9 - j)) {
+                CTransactionRef ptx = mpool.get(txHashes[j].front());
+                if (ptx)
+                    block.push_back(ptx);
+                txHashes[j].erase(txHashes[j].begin());
+            }
+        }
+        mpool.removeForBlock(block, ++blocknum);
+        block.clear();
+    }
+
+    // The highest fee confirms within the slots of one block, the lowest within those of ten
+    BOOST_CHECK(feeEst.estimateTimeFee(0, nullptr, true) == CFeeRate(0));
+    FeeCalculation feeCalc;
+    CFeeRate shortEst = feeEst.estimateTimeFee(4 * 60, &feeCalc, false);
+    BOOST_CHECK_EQUAL(feeCalc.returnedTarget, 4 * 60);
+    BOOST_CHECK(shortEst.GetFeePerK() > 9 * baseRate.GetFeePerK() - deltaFee);
+    BOOST_CHECK(shortEst.GetFeePerK() < 10 * baseRate.GetFeePerK() + deltaFee);
+    CFeeRate prevEst = shortEst;
+    for (int64_t nSeconds = 6 * 60; nSeconds <= 30 * 60; nSeconds += 6 * 60) {
+        CFeeRate est = feeEst.estimateTimeFee(nSeconds, nullptr, false);
+        BOOST_CHECK(est != CFeeRate(0));
+        BOOST_CHECK(est <= prevEst);
+        prevEst = est;
+    }
+    BOOST_CHECK(prevEst.GetFeePerK() < 6 * baseRate.GetFeePerK());
+
+    // Targets beyond the tracked time fail, and estimates are bound by half the time recorded
+    BOOST_CHECK(feeEst.estimateTimeFee(feeEst.HighestTimeTracked() + 60, nullptr, false) == CFeeRate(0));
+    feeEst.estimateTimeFee(feeEst.HighestTimeTracked(), &feeCalc, false);
+    BOOST_CHECK_EQUAL(feeCalc.returnedTarget, 199 * 60);
+
+    // Two days without transactions decay the time based data, unlike the block based data
+    nTime += 2 * 24 * 60 * 60;
+    SetMockTime(nTime);
+    mpool.removeForBlock(block, ++blocknum);
+    BOOST_CHECK(feeEst.estimateTimeFee(4 * 60, nullptr, false) == CFeeRate(0));
+    BOOST_CHECK(feeEst.estimateSmartFee(2, nullptr, false) != CFeeRate(0));
+    SetMockTime(0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
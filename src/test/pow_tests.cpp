@@ -8,6 +8,8 @@
 #include <pow.h>
 #include <random.h>
 #include <util/system.h>
+#include <versionbits.h>
+#include <crypto/x16r.h>
 #include <test/test_bitcoin.h>
 
 #include <boost/test/unit_test.hpp>
@@ -84,4 +86,50 @@ BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
     }
 }
 
+// VELES BEGIN
+BOOST_AUTO_TEST_CASE(pow_hash_batch)
+{
+    const int32_t algos[] = { ALGO_SHA256D, ALGO_SCRYPT, ALGO_X11, ALGO_X16R, ALGO_X11, ALGO_X16R };
+    std::vector<CBlockHeader> headers(40);
+    for (size_t i = 0; i < headers.size(); i++) {
+        headers[i].nVersion = VERSIONBITS_TOP_BITS | algos[i % 6];
+        // Share hashPrevBlock between some of the X16R headers
+        headers[i].hashPrevBlock = InsecureRand256();
+        if (i >= 9)
+            headers[i].hashPrevBlock = headers[i - 6].hashPrevBlock;
+        headers[i].hashMerkleRoot = InsecureRand256();
+        headers[i].nTime = 1546300800 + i;
+        headers[i].nBits = 0x1e0ffff0;
+        headers[i].nNonce = InsecureRand32();
+    }
+    headers[0].nVersion = 2; // pre-VersionBits, hashed with scrypt
+
+    std::vector<uint256> hashes(headers.size());
+    std::vector<const CBlockHeader*> pheaders;
+    std::vector<uint256*> phashes;
+    for (size_t i = 0; i < headers.size(); i++) {
+        pheaders.push_back(&headers[i]);
+        phashes.push_back(&hashes[i]);
+    }
+    CBlockHeader::GetPoWHashes(pheaders.data(), phashes.data(), headers.size());
+
+    for (size_t i = 0; i < headers.size(); i++)
+        BOOST_CHECK_EQUAL(hashes[i], headers[i].GetPoWHash());
+}
+
+BOOST_AUTO_TEST_CASE(x16r_plan)
+{
+    for (int i = 0; i < 20; i++) {
+        CBlockHeader header;
+        header.nVersion = VERSIONBITS_TOP_BITS | ALGO_X16R;
+        header.hashPrevBlock = InsecureRand256();
+        header.hashMerkleRoot = InsecureRand256();
+        header.nNonce = InsecureRand32();
+        const CX16RPlan plan(header.hashPrevBlock);
+        BOOST_CHECK_EQUAL(plan.Hash(BEGIN(header.nVersion), END(header.nNonce)), HashX16R(BEGIN(header.nVersion), END(header.nNonce), header.hashPrevBlock));
+        BOOST_CHECK_EQUAL(header.GetPoWHash(&plan), header.GetPoWHash());
+    }
+}
+// VELES END
+
 BOOST_AUTO_TEST_SUITE_END()
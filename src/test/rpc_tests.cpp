@@ -21,6 +21,12 @@
 #include <univalue.h>
 
 #include <rpc/blockchain.h>
+#include <rpc/jsonstream.h> // VELES
+#include <script/script.h> // VELES
+#include <startuptimings.h> // VELES
+#include <validation.h> // VELES
+
+#include <limits> // VELES
 
 UniValue CallRPC(std::string args)
 {
@@ -421,4 +427,246 @@ BOOST_AUTO_TEST_CASE(rpc_getblockstats_calculate_percentiles_by_weight)
     }
 }
 
+// VELES BEGIN
+BOOST_AUTO_TEST_CASE(rpc_batch)
+{
+    SetRPCWarmupFinished();
+    StartRPC();
+
+    // Runs of read-only calls, separated by a call that runs in order and by invalid elements
+    UniValue batch(UniValue::VARR);
+    for (int i = 0; i < 40; ++i) {
+        UniValue req(UniValue::VOBJ);
+        req.pushKV("id", i);
+        if (i == 10) {
+            req.pushKV("method", "echo");
+            req.pushKV("params", UniValue(UniValue::VARR));
+        } else if (i == 20) {
+            req.pushKV("method", "nosuchmethod");
+        } else {
+            UniValue params(UniValue::VARR);
+            params.push_back(0);
+            req.pushKV("method", i % 2 ? "getblockcount" : "getblockhash");
+            req.pushKV("params", params);
+        }
+        batch.push_back(req);
+    }
+    batch.push_back(UniValue("not an object"));
+
+    JSONRPCRequest jreq;
+    UniValue replies;
+    BOOST_REQUIRE(replies.read(JSONRPCExecBatch(jreq, batch)));
+    BOOST_REQUIRE_EQUAL(replies.size(), batch.size());
+    for (int i = 0; i < 40; ++i) {
+        const UniValue& reply = replies[i];
+        BOOST_CHECK_EQUAL(find_value(reply, "id").get_int(), i);
+        if (i == 20) {
+            BOOST_CHECK_EQUAL(find_value(find_value(reply, "error"), "code").get_int(), RPC_METHOD_NOT_FOUND);
+        } else if (i != 10 && i % 2) {
+            BOOST_CHECK_EQUAL(find_value(reply, "result").get_int(), 0);
+        } else if (i != 10) {
+            BOOST_CHECK_EQUAL(find_value(reply, "result").get_str(), Params().GenesisBlock().GetHash().GetHex());
+        }
+    }
+    BOOST_CHECK(find_value(replies[40], "error").isObject());
+
+    StopRPC();
+}
+
+BOOST_AUTO_TEST_CASE(rpc_method_stats)
+{
+    if (RPCIsInWarmup(nullptr)) SetRPCWarmupFinished();
+
+    JSONRPCRequest request;
+    request.strMethod = "uptime";
+    request.params = UniValue(UniValue::VARR);
+    for (int i = 0; i < 3; ++i) {
+        BOOST_CHECK_NO_THROW(tableRPC.execute(request));
+    }
+    request.params.push_back(1);
+    BOOST_CHECK_THROW(tableRPC.execute(request), UniValue);
+
+    const UniValue info = CallRPC("getrpcinfo");
+    const UniValue& methods = find_value(info, "methods");
+    BOOST_REQUIRE(methods.isArray());
+    bool fFound = false;
+    for (size_t i = 0; i < methods.size(); ++i) {
+        const UniValue& entry = methods[i];
+        if (find_value(entry, "method").get_str() != "uptime") continue;
+        fFound = true;
+        BOOST_CHECK(find_value(entry, "calls").get_int64() >= 4);
+        BOOST_CHECK(find_value(entry, "errors").get_int64() >= 1);
+        BOOST_CHECK(find_value(entry, "p50").get_int64() <= find_value(entry, "p99").get_int64());
+        BOOST_CHECK(find_value(entry, "p99").get_int64() <= find_value(entry, "max").get_int64());
+        BOOST_CHECK(find_value(entry, "max").get_int64() <= find_value(entry, "total").get_int64());
+        BOOST_CHECK(find_value(entry, "cs_main_wait").get_int64() >= 0);
+    }
+    BOOST_CHECK(fFound);
+}
+
+BOOST_AUTO_TEST_CASE(rpc_getsentinelstatus)
+{
+    const UniValue first = CallRPC("getsentinelstatus");
+    BOOST_CHECK_EQUAL(find_value(first, "blocks").get_int(), 0);
+    BOOST_CHECK(find_value(first, "masternode").isNull());
+    BOOST_CHECK(find_value(first, "mnsync").isObject());
+    BOOST_CHECK(find_value(first, "governanceinfo").isObject());
+    BOOST_CHECK(find_value(first, "full").get_bool());
+    const std::string strToken = find_value(first, "token").get_str();
+
+    // Nothing changed since the token
+    const UniValue delta = CallRPC("getsentinelstatus " + strToken);
+    BOOST_CHECK(!find_value(delta, "full").get_bool());
+    BOOST_CHECK(find_value(delta, "objects").empty());
+    BOOST_CHECK(find_value(delta, "removed").empty());
+    BOOST_CHECK_EQUAL(find_value(delta, "token").get_str(), strToken);
+
+    // Tokens of other runs or from the future get everything
+    BOOST_CHECK(find_value(CallRPC("getsentinelstatus 0000000000000000-0"), "full").get_bool());
+    BOOST_CHECK(find_value(CallRPC("getsentinelstatus " + strToken + "1"), "full").get_bool());
+}
+// VELES END
+
+// VELES BEGIN
+BOOST_AUTO_TEST_CASE(rpc_jsonstream)
+{
+    UniValue tx(UniValue::VOBJ);
+    tx.pushKV("txid", "ab\"cd");
+    tx.pushKV("vout", UniValue(UniValue::VARR));
+    UniValue txs(UniValue::VARR);
+    for (int i = 0; i < 3; ++i) {
+        txs.push_back(tx);
+    }
+    UniValue expected(UniValue::VOBJ);
+    expected.pushKV("hash", "00ff");
+    expected.pushKV("tx", txs);
+    expected.pushKV("empty", UniValue(UniValue::VOBJ));
+    expected.pushKV("height", 7);
+
+    // Flushed every few bytes, the pieces add up to what write() gives
+    std::string strStreamed;
+    size_t nChunks = 0;
+    JSONStreamWriter writer([&](const std::string& strChunk) { strStreamed += strChunk; ++nChunks; }, 8);
+    writer.BeginObject();
+    writer.Key("hash");
+    writer.Value("00ff");
+    writer.Key("tx");
+    writer.BeginArray();
+    for (int i = 0; i < 3; ++i) {
+        writer.Value(tx);
+    }
+    writer.EndArray();
+    writer.Key("empty");
+    writer.BeginObject();
+    writer.EndObject();
+    writer.Key("height");
+    writer.Value(7);
+    writer.EndObject();
+    writer.WriteRaw("\n");
+    BOOST_CHECK(writer.Flushed());
+    strStreamed += writer.TakeBuffer();
+    BOOST_CHECK(nChunks > 1);
+    BOOST_CHECK_EQUAL(strStreamed, expected.write() + "\n");
+
+    // Nothing reaches the sink below the flush size
+    JSONStreamWriter small([](const std::string&) { BOOST_ERROR("flushed"); });
+    small.BeginArray();
+    small.Value(1);
+    small.EndArray();
+    BOOST_CHECK(!small.Flushed());
+    BOOST_CHECK_EQUAL(small.TakeBuffer(), "[1]");
+}
+
+BOOST_AUTO_TEST_CASE(rpc_jsonstream_typed)
+{
+    // Typed values write the same text as the UniValues they stand for
+    const std::string strEscaped("a\"b\\c\b\f\n\r\t\x01\x1f\x7f/\xc3\xa9");
+    JSONStreamWriter writer([](const std::string&) {});
+    writer.BeginArray();
+    writer.String(strEscaped);
+    writer.Int(-42);
+    writer.UInt(std::numeric_limits<uint64_t>::max());
+    writer.Bool(true);
+    writer.Null();
+    writer.Amount(-123456789);
+    writer.Amount(21 * COIN);
+    writer.EndArray();
+    UniValue expected(UniValue::VARR);
+    expected.push_back(strEscaped);
+    expected.push_back(-42);
+    expected.push_back(std::numeric_limits<uint64_t>::max());
+    expected.push_back(true);
+    expected.push_back(NullUniValue);
+    expected.push_back(ValueFromAmount(-123456789));
+    expected.push_back(ValueFromAmount(21 * COIN));
+    BOOST_CHECK_EQUAL(writer.TakeBuffer(), expected.write());
+
+    // A transaction written with typed values matches TxToUniv
+    CMutableTransaction mtx;
+    mtx.vin.resize(2);
+    mtx.vin[0].prevout = COutPoint(uint256S("0x01"), 3);
+    mtx.vin[0].scriptSig = CScript() << OP_0 << std::vector<unsigned char>(72, 0x30);
+    mtx.vin[0].scriptWitness.stack.push_back(std::vector<unsigned char>(33, 0x02));
+    mtx.vin[1].prevout = COutPoint(uint256S("0x02"), 0);
+    mtx.vout.resize(2);
+    mtx.vout[0].nValue = 5 * COIN + 1;
+    mtx.vout[0].scriptPubKey = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 0xab) << OP_EQUALVERIFY << OP_CHECKSIG;
+    mtx.vout[1].nValue = 0;
+    mtx.vout[1].scriptPubKey = CScript() << OP_RETURN << std::vector<unsigned char>(4, 0xcd);
+    const CTransaction tx(mtx);
+    UniValue objTx(UniValue::VOBJ);
+    TxToUniv(tx, uint256(), objTx, true, 0);
+    JSONStreamWriter txWriter([](const std::string&) {});
+    TxToJSONStream(txWriter, tx, 0);
+    BOOST_CHECK_EQUAL(txWriter.TakeBuffer(), objTx.write());
+}
+
+BOOST_AUTO_TEST_CASE(rpc_getvalidationstats)
+{
+    BOOST_CHECK_NO_THROW(CallRPC("getvalidationstats true"));
+    RecordValidationPhase(ValidationPhase::CONNECT_BLOCK, 0);
+    RecordValidationPhase(ValidationPhase::CONNECT_BLOCK, 3);
+    RecordValidationPhase(ValidationPhase::CONNECT_BLOCK, 1000);
+    RecordValidationPhase(ValidationPhase::TIP_GOVERNANCE, 5);
+
+    UniValue r = CallRPC("getvalidationstats");
+    const UniValue& connect = find_value(r.get_obj(), "connect_block");
+    BOOST_CHECK_EQUAL(find_value(connect, "count").get_int(), 3);
+    BOOST_CHECK_EQUAL(find_value(connect, "total_us").get_int(), 1003);
+    BOOST_CHECK_EQUAL(find_value(connect, "max_us").get_int(), 1000);
+    BOOST_CHECK_EQUAL(find_value(connect, "last_us").get_int(), 1000);
+    BOOST_CHECK_EQUAL(find_value(connect, "p50_us").get_int(), 4);
+    BOOST_CHECK_EQUAL(find_value(connect, "p99_us").get_int(), 1000);
+    // 0 in bucket 0, 3 in [2, 4) and 1000 in [512, 1024), trailing empty buckets left out
+    const UniValue& histogram = find_value(connect, "histogram");
+    BOOST_CHECK_EQUAL(histogram.size(), 11U);
+    BOOST_CHECK_EQUAL(histogram[0].get_int(), 1);
+    BOOST_CHECK_EQUAL(histogram[2].get_int(), 1);
+    BOOST_CHECK_EQUAL(histogram[10].get_int(), 1);
+    BOOST_CHECK_EQUAL(find_value(find_value(r.get_obj(), "tip_governance"), "count").get_int(), 1);
+    BOOST_CHECK_EQUAL(find_value(find_value(r.get_obj(), "tip_mnodeman"), "histogram").size(), 1U);
+
+    // Reset after returning the stats
+    r = CallRPC("getvalidationstats true");
+    BOOST_CHECK_EQUAL(find_value(find_value(r.get_obj(), "connect_block"), "count").get_int(), 3);
+    r = CallRPC("getvalidationstats");
+    BOOST_CHECK_EQUAL(find_value(find_value(r.get_obj(), "connect_block"), "count").get_int(), 0);
+    BOOST_CHECK_THROW(CallRPC("getvalidationstats true extra"), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(rpc_getstartupinfo)
+{
+    g_startup_timings.Add("test phase", GetTimeMillis() - 5);
+
+    UniValue r = CallRPC("getstartupinfo");
+    BOOST_CHECK(find_value(r.get_obj(), "total_ms").get_int64() >= 0);
+    const UniValue& phases = find_value(r.get_obj(), "phases");
+    BOOST_REQUIRE(phases.size() > 0);
+    const UniValue& phase = phases[phases.size() - 1];
+    BOOST_CHECK_EQUAL(find_value(phase, "name").get_str(), "test phase");
+    BOOST_CHECK(find_value(phase, "duration_ms").get_int64() >= 5);
+    BOOST_CHECK_THROW(CallRPC("getstartupinfo extra"), std::runtime_error);
+}
+// VELES END
+
 BOOST_AUTO_TEST_SUITE_END()
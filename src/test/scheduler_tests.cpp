@@ -8,6 +8,7 @@
 #include <test/test_bitcoin.h>
 
 #include <boost/thread.hpp>
+#include <atomic>
 #include <boost/test/unit_test.hpp>
 
 BOOST_AUTO_TEST_SUITE(scheduler_tests)
@@ -155,4 +156,135 @@ BOOST_AUTO_TEST_CASE(singlethreadedscheduler_ordered)
     BOOST_CHECK_EQUAL(counter2, 100);
 }
 
+// VELES BEGIN
+BOOST_AUTO_TEST_CASE(scheduler_priorities)
+{
+    CScheduler scheduler;
+
+    // Background tasks blocking until released may take one of the two threads only
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    bool fRelease = false;
+    std::atomic<int> nBackgroundStarted(0);
+    std::atomic<int> nHighRun(0);
+    for (int i = 0; i < 2; i++) {
+        scheduler.schedule([&] {
+            ++nBackgroundStarted;
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (!fRelease) cond.wait(lock);
+        }, boost::chrono::system_clock::now(), CScheduler::PRIORITY_BACKGROUND);
+    }
+
+    boost::thread_group threads;
+    for (int i = 0; i < 2; i++)
+        threads.create_thread(std::bind(&CScheduler::serviceQueue, &scheduler));
+
+    // A high priority task still runs
+    scheduler.schedule([&] { ++nHighRun; });
+    for (int i = 0; i < 1000 && (nHighRun == 0 || nBackgroundStarted == 0); i++)
+        MilliSleep(10);
+    BOOST_CHECK_EQUAL(nHighRun, 1);
+    BOOST_CHECK_EQUAL(nBackgroundStarted, 1);
+
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fRelease = true;
+    }
+    cond.notify_all();
+    scheduler.stop(true);
+    threads.join_all();
+    BOOST_CHECK_EQUAL(nBackgroundStarted, 2);
+
+    // Due high priority tasks run before due background tasks
+    CScheduler single;
+    std::vector<int> vOrder;
+    const boost::chrono::system_clock::time_point now = boost::chrono::system_clock::now();
+    single.schedule([&] { vOrder.push_back(1); }, now - boost::chrono::seconds(2), CScheduler::PRIORITY_BACKGROUND);
+    single.schedule([&] { vOrder.push_back(2); }, now - boost::chrono::seconds(1));
+    single.schedule([&] { vOrder.push_back(3); }, now);
+    boost::chrono::system_clock::time_point first, last;
+    BOOST_CHECK_EQUAL(single.getQueueInfo(first, last), 3U);
+    BOOST_CHECK(first == now - boost::chrono::seconds(2));
+    BOOST_CHECK(last == now);
+    single.stop(true);
+    single.serviceQueue();
+    BOOST_CHECK(vOrder == std::vector<int>({2, 3, 1}));
+}
+
+BOOST_AUTO_TEST_CASE(scheduler_task_group)
+{
+    // Without a scheduler the tasks run in the order they were added
+    std::vector<int> vOrder;
+    CSchedulerTaskGroup serial(nullptr);
+    size_t nFirst = serial.Add([&] { vOrder.push_back(1); });
+    serial.Add([&] { vOrder.push_back(2); }, {nFirst});
+    serial.Add([&] { vOrder.push_back(3); });
+    serial.Run();
+    BOOST_CHECK(vOrder == std::vector<int>({1, 2, 3}));
+
+    // Nothing services the scheduler, the calling thread runs every task after its dependencies
+    CScheduler scheduler;
+    vOrder.clear();
+    CSchedulerTaskGroup idle(&scheduler);
+    nFirst = idle.Add([&] { vOrder.push_back(1); });
+    idle.Add([&] { vOrder.push_back(2); }, {nFirst});
+    idle.Add([&] { vOrder.push_back(3); });
+    idle.Run();
+    BOOST_CHECK(vOrder == std::vector<int>({1, 3, 2}));
+
+    // Two tasks waiting for each other to start complete only when run concurrently
+    boost::thread_group threads;
+    for (int i = 0; i < 2; i++)
+        threads.create_thread(std::bind(&CScheduler::serviceQueue, &scheduler));
+    std::atomic<int> nStarted(0);
+    std::atomic<bool> fConcurrent(true);
+    auto meet = [&] {
+        ++nStarted;
+        for (int i = 0; i < 1000 && nStarted < 2; i++)
+            MilliSleep(10);
+        if (nStarted < 2) fConcurrent = false;
+    };
+    std::atomic<int> nAfter(0);
+    CSchedulerTaskGroup group(&scheduler);
+    size_t nMeet1 = group.Add(meet);
+    size_t nMeet2 = group.Add(meet);
+    group.Add([&] { nAfter = nStarted.load(); }, {nMeet1, nMeet2});
+    group.Run();
+    BOOST_CHECK(fConcurrent);
+    BOOST_CHECK_EQUAL(nAfter, 2);
+
+    scheduler.stop(true);
+    threads.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(singlethreadedscheduler_backpressure)
+{
+    CScheduler scheduler;
+    SingleThreadedSchedulerClient queue(&scheduler);
+
+    // Nothing services the scheduler yet, the callbacks pile up
+    std::atomic<int> nRun(0);
+    for (int i = 0; i < 20; ++i) {
+        queue.AddToProcessQueue([&nRun] { ++nRun; });
+    }
+    BOOST_CHECK_EQUAL(queue.CallbacksPending(), 20U);
+    BOOST_CHECK_EQUAL(queue.CallbacksPendingPeak(), 20U);
+    queue.WaitForCallbacksPending(20);
+
+    boost::thread_group threads;
+    threads.create_thread(std::bind(&CScheduler::serviceQueue, &scheduler));
+    queue.WaitForCallbacksPending(5);
+    BOOST_CHECK(queue.CallbacksPending() <= 5);
+    BOOST_CHECK(nRun >= 14);
+    queue.WaitForCallbacksPending(0);
+    BOOST_CHECK_EQUAL(queue.CallbacksPendingPeak(), 20U);
+    queue.ResetCallbacksPendingPeak();
+    BOOST_CHECK_EQUAL(queue.CallbacksPendingPeak(), 0U);
+
+    scheduler.stop(true);
+    threads.join_all();
+    BOOST_CHECK_EQUAL(nRun, 20);
+}
+// VELES END
+
 BOOST_AUTO_TEST_SUITE_END()
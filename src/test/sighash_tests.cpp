@@ -161,6 +161,35 @@ BOOST_AUTO_TEST_CASE(sighash_test)
     #endif
 }
 
+// VELES BEGIN
+// Legacy signature hashes from the precomputed data of transactions with many inputs,
+// as the final transactions of PrivateSend, for every input
+BOOST_AUTO_TEST_CASE(sighash_legacy_precomputed)
+{
+    static const int hashTypes[] = {SIGHASH_ALL, SIGHASH_ALL | SIGHASH_ANYONECANPAY, SIGHASH_NONE, SIGHASH_SINGLE | SIGHASH_ANYONECANPAY, 0};
+    for (int i = 0; i < 200; i++) {
+        CMutableTransaction txTo;
+        RandomTransaction(txTo, true);
+        const int nInputs = InsecureRandRange(100) + 1;
+        for (int in = txTo.vin.size(); in < nInputs; in++) {
+            txTo.vin.push_back(txTo.vin[InsecureRandRange(in)]);
+            RandomScript(txTo.vin.back().scriptSig);
+        }
+        const CTransaction tx(txTo);
+        const PrecomputedTransactionData txdata(tx);
+        BOOST_CHECK(txdata.legacyReady == (tx.vin.size() > 1));
+        CScript scriptCode;
+        RandomScript(scriptCode);
+        for (unsigned int nIn = 0; nIn < tx.vin.size(); nIn++) {
+            const int nHashType = hashTypes[InsecureRandRange(5)] | (InsecureRandBool() ? InsecureRand32() & ~0x9f : 0);
+            const uint256 sh = SignatureHash(scriptCode, tx, nIn, nHashType, 0, SigVersion::BASE, &txdata);
+            BOOST_CHECK(sh == SignatureHash(scriptCode, tx, nIn, nHashType, 0, SigVersion::BASE));
+            BOOST_CHECK(sh == SignatureHashOld(scriptCode, tx, nIn, nHashType));
+        }
+    }
+}
+// VELES END
+
 // Goal: check that SignatureHash generates correct hash
 BOOST_AUTO_TEST_CASE(sighash_from_data)
 {
@@ -206,6 +235,11 @@ BOOST_AUTO_TEST_CASE(sighash_from_data)
 
         sh = SignatureHash(scriptCode, *tx, nIn, nHashType, 0, SigVersion::BASE);
         BOOST_CHECK_MESSAGE(sh.GetHex() == sigHashHex, strTest);
+        // VELES BEGIN
+        const PrecomputedTransactionData txdata(*tx);
+        sh = SignatureHash(scriptCode, *tx, nIn, nHashType, 0, SigVersion::BASE, &txdata);
+        BOOST_CHECK_MESSAGE(sh.GetHex() == sigHashHex, strTest);
+        // VELES END
     }
 }
 BOOST_AUTO_TEST_SUITE_END()
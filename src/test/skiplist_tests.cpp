@@ -2,8 +2,10 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <arith_uint256.h>
 #include <chain.h>
 #include <util/system.h>
+#include <versionbits.h>
 #include <test/test_bitcoin.h>
 
 #include <vector>
@@ -176,4 +178,33 @@ BOOST_AUTO_TEST_CASE(findearliestatleast_edge_test)
     BOOST_CHECK(!chain.FindEarliestAtLeast(int64_t(std::numeric_limits<unsigned int>::max()) + 1));
 }
 
+// VELES BEGIN
+BOOST_AUTO_TEST_CASE(prevalgo_test)
+{
+    static const int32_t algos[] = {ALGO_SHA256D, ALGO_SCRYPT, ALGO_LYRA2Z, ALGO_X11, ALGO_X16R};
+    std::vector<uint256> vHash(2000);
+    std::vector<CBlockIndex> vIndex(vHash.size());
+
+    for (size_t i = 0; i < vIndex.size(); i++) {
+        vHash[i] = ArithToUint256(i);
+        vIndex[i].phashBlock = &vHash[i];
+        vIndex[i].nHeight = i;
+        vIndex[i].pprev = (i == 0) ? nullptr : &vIndex[i - 1];
+        vIndex[i].nVersion = VERSIONBITS_TOP_BITS | algos[InsecureRandRange(5)];
+        vIndex[i].nBits = 0x1e0ffff0 - InsecureRandRange(0x10000);
+        vIndex[i].BuildSkip();
+        vIndex[i].BuildPrevAlgo();
+    }
+
+    for (size_t i = 0; i < vIndex.size(); i++) {
+        const CBlockIndex* pindexAlgo = vIndex[i].pprev;
+        while (pindexAlgo && (pindexAlgo->nVersion & ALGO_VERSION_MASK) != (vIndex[i].nVersion & ALGO_VERSION_MASK))
+            pindexAlgo = pindexAlgo->pprev;
+        BOOST_CHECK(vIndex[i].pprevAlgo == pindexAlgo);
+        BOOST_CHECK(vIndex[i].GetAlgoTarget() == arith_uint256().SetCompact(vIndex[i].nBits) / vIndex[i].GetBlockHeader().GetAlgoEfficiency(vIndex[i].nHeight));
+        //BOOST_CHECK(vIndex[i].nBlockWork == GetBlockProof(vIndex[i]));
+    }
+}
+// VELES END
+
 BOOST_AUTO_TEST_SUITE_END()
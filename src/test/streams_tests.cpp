@@ -203,4 +203,31 @@ BOOST_AUTO_TEST_CASE(streams_serializedata_xor)
             std::string(ds.begin(), ds.end()));
 }
 
+BOOST_AUTO_TEST_CASE(streams_scratch_reuse)
+{
+    const char* pBuffer;
+    {
+        CScratchDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss.reserve(1000);
+        ss << uint32_t(1) << std::string("scratch");
+        pBuffer = &ss[0];
+    }
+    {
+        // The next stream of the thread starts empty on the same buffer
+        CScratchDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        BOOST_CHECK(ss.empty());
+        ss << uint8_t(2);
+        BOOST_CHECK(&ss[0] == pBuffer);
+        BOOST_CHECK_EQUAL(ss.GetVersion(), PROTOCOL_VERSION);
+
+        // A nested one gets a buffer of its own
+        CScratchDataStream ssNested(SER_DISK, PROTOCOL_VERSION);
+        ssNested << uint8_t(3);
+        BOOST_CHECK(&ssNested[0] != pBuffer);
+        BOOST_CHECK_EQUAL(ss.size(), 1U);
+        BOOST_CHECK_EQUAL(ss[0], 2);
+        BOOST_CHECK_EQUAL(ssNested[0], 3);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -7,6 +7,13 @@
 
 #include <boost/test/unit_test.hpp>
 
+// VELES BEGIN
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+// VELES END
+
 namespace {
 template <typename MutexType>
 void TestPotentialDeadLockDetected(MutexType& mutex1, MutexType& mutex2)
@@ -49,4 +56,85 @@ BOOST_AUTO_TEST_CASE(potential_deadlock_detected)
     #endif
 }
 
+// VELES BEGIN
+BOOST_AUTO_TEST_CASE(lock_stats)
+{
+    const bool prev = g_lock_stats;
+    g_lock_stats = true;
+    ResetLockStats();
+
+    Mutex stats_mutex;
+    for (int i = 0; i < 3; ++i) {
+        LOCK(stats_mutex);
+    }
+    {
+        LOCK(stats_mutex);
+        // Fails while the lock is held
+        std::thread([&stats_mutex] {
+            TRY_LOCK(stats_mutex, locked);
+            BOOST_CHECK(!locked);
+        }).join();
+    }
+    g_lock_stats = prev;
+
+    std::vector<LockSiteStats> vStats = GetLockStats();
+    std::vector<LockSiteStats> vSites;
+    std::copy_if(vStats.begin(), vStats.end(), std::back_inserter(vSites), [](const LockSiteStats& stats) {
+        return stats.name == "stats_mutex";
+    });
+    BOOST_REQUIRE_EQUAL(vSites.size(), 3U);
+    std::sort(vSites.begin(), vSites.end(), [](const LockSiteStats& a, const LockSiteStats& b) { return a.line < b.line; });
+    BOOST_CHECK_EQUAL(vSites[0].acquisitions, 3U);
+    BOOST_CHECK_EQUAL(vSites[0].contentions, 0U);
+    BOOST_CHECK_EQUAL(vSites[1].acquisitions, 1U);
+    BOOST_CHECK_EQUAL(vSites[2].acquisitions, 0U);
+    BOOST_CHECK_EQUAL(vSites[2].contentions, 1U);
+    uint64_t nHolds = 0;
+    for (const uint64_t n : vSites[0].hold_histogram) nHolds += n;
+    BOOST_CHECK_EQUAL(nHolds, 3U);
+
+    ResetLockStats();
+    for (const LockSiteStats& stats : GetLockStats()) {
+        BOOST_CHECK(stats.name != "stats_mutex");
+    }
+}
+
+#ifdef HAVE_THREAD_LOCAL
+BOOST_AUTO_TEST_CASE(main_lock_wait_counter)
+{
+    // Named like the main lock, the counters tell the locks apart by name
+    Mutex cs_main;
+    Mutex other_mutex;
+    std::atomic<bool> fWaiting{false};
+    int64_t nWaited = -1;
+    int64_t nOtherWaited = -1;
+
+    ENTER_CRITICAL_SECTION(other_mutex);
+    ENTER_CRITICAL_SECTION(cs_main);
+    std::thread thread([&] {
+        MainLockWaitCounter counter;
+        fWaiting = true;
+        {
+            LOCK(other_mutex);
+        }
+        nOtherWaited = counter.Micros();
+        {
+            LOCK(cs_main);
+        }
+        nWaited = counter.Micros() - nOtherWaited;
+    });
+    while (!fWaiting) std::this_thread::yield();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    LEAVE_CRITICAL_SECTION(other_mutex);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    LEAVE_CRITICAL_SECTION(cs_main);
+    thread.join();
+
+    BOOST_CHECK_EQUAL(nOtherWaited, 0);
+    BOOST_CHECK(nWaited >= 10000);
+    BOOST_CHECK_EQUAL(g_main_lock_wait_counters.load(), 0);
+}
+#endif
+// VELES END
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -768,4 +768,47 @@ BOOST_AUTO_TEST_CASE(test_IsStandard)
     BOOST_CHECK(!IsStandardTx(CTransaction(t), reason));
 }
 
+// VELES BEGIN
+BOOST_AUTO_TEST_CASE(test_tx_arena)
+{
+    std::vector<CTransactionRef> vtx;
+    for (int i = 0; i < 100; i++) {
+        CMutableTransaction mtx;
+        mtx.vin.resize(1);
+        mtx.vin[0].prevout = COutPoint(InsecureRand256(), i);
+        mtx.vout.resize(2);
+        mtx.vout[0].nValue = i * COIN;
+        mtx.vout[1].scriptPubKey = CScript() << OP_TRUE;
+        mtx.nLockTime = i;
+        vtx.push_back(MakeTransactionRef(std::move(mtx)));
+    }
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << vtx;
+
+    CMonotonicArena arena(4096);
+    size_t nAllocated = 0;
+    for (int round = 0; round < 3; round++) {
+        {
+            std::vector<CTransactionRef> vtxRead;
+            {
+                CTxArenaScope scope(arena);
+                CDataStream(ss) >> vtxRead;
+            }
+            BOOST_CHECK(g_tx_arena == nullptr);
+            BOOST_REQUIRE_EQUAL(vtxRead.size(), vtx.size());
+            for (size_t i = 0; i < vtx.size(); i++) {
+                BOOST_CHECK(vtxRead[i]->GetWitnessHash() == vtx[i]->GetWitnessHash());
+            }
+        }
+        // the chunks are reused once all the transactions are freed
+        if (round == 0) {
+            nAllocated = arena.GetAllocatedSize();
+            BOOST_CHECK(nAllocated > 4096);
+        }
+        BOOST_CHECK_EQUAL(arena.GetAllocatedSize(), nAllocated);
+        arena.Clear();
+    }
+}
+// VELES END
+
 BOOST_AUTO_TEST_SUITE_END()
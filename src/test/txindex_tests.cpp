@@ -3,12 +3,15 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <chainparams.h>
+#include <consensus/validation.h>
+#include <index/collateralindex.h>
 #include <index/txindex.h>
 #include <script/standard.h>
 #include <test/test_bitcoin.h>
 #include <util/system.h>
 #include <util/time.h>
 #include <validation.h>
+#include <validationinterface.h>
 
 #include <boost/test/unit_test.hpp>
 
@@ -39,6 +42,16 @@ BOOST_FIXTURE_TEST_CASE(txindex_initial_sync, TestChain100Setup)
         MilliSleep(100);
     }
 
+    // VELES BEGIN
+    // The background sync wrote the whole chain, in batches of blocks
+    const IndexSummary summary = txindex.GetSummary();
+    BOOST_CHECK_EQUAL(summary.name, "txindex");
+    BOOST_CHECK(summary.synced);
+    BOOST_CHECK_EQUAL(summary.best_block_height, chainActive.Height());
+    BOOST_CHECK_EQUAL(summary.sync_blocks, chainActive.Height() + 1);
+    BOOST_CHECK_EQUAL(summary.sync_transactions, chainActive.Height() + 1);
+    // VELES END
+
     // Check that txindex excludes genesis block transactions.
     const CBlock& genesis_block = Params().GenesisBlock();
     for (const auto& txn : genesis_block.vtx) {
@@ -78,4 +91,71 @@ BOOST_FIXTURE_TEST_CASE(txindex_initial_sync, TestChain100Setup)
     // Rest of shutdown sequence and destructors happen in ~TestingSetup()
 }
 
+BOOST_FIXTURE_TEST_CASE(collateral_index, TestChain100Setup)
+{
+    CollateralIndex index;
+    RegisterValidationInterface(&index);
+
+    // Burn to the OP_RETURN of a hash, as governance objects do
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CMutableTransaction mtx;
+    mtx.nVersion = 1;
+    mtx.vin.resize(1);
+    mtx.vin[0].prevout = COutPoint(m_coinbase_txns[0]->GetHash(), 0);
+    mtx.vout.resize(2);
+    mtx.vout[0].nValue = 11 * CENT;
+    mtx.vout[0].scriptPubKey = CScript() << OP_RETURN << ToByteVector(InsecureRand256());
+    mtx.vout[1].nValue = 11 * CENT;
+    mtx.vout[1].scriptPubKey = scriptPubKey;
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptPubKey, mtx, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+    BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    mtx.vin[0].scriptSig << vchSig;
+    BOOST_CHECK(CollateralIndex::IsCollateral(CTransaction(mtx)));
+    BOOST_CHECK(!CollateralIndex::IsCollateral(*m_coinbase_txns[0]));
+
+    const CBlock block = CreateAndProcessBlock({mtx}, scriptPubKey);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block.GetHash());
+    SyncWithValidationInterfaceQueue();
+
+    std::vector<CTxOut> vout;
+    uint256 hashBlock;
+    BOOST_CHECK(index.GetCollateral(mtx.GetHash(), vout, hashBlock));
+    BOOST_CHECK(vout == mtx.vout);
+    BOOST_CHECK(hashBlock == block.GetHash());
+    BOOST_CHECK(!index.GetCollateral(block.vtx[0]->GetHash(), vout, hashBlock));
+
+    // The index survives a restart
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << index;
+    CollateralIndex indexLoaded;
+    ss >> indexLoaded;
+    BOOST_CHECK(indexLoaded.GetCollateral(mtx.GetHash(), vout, hashBlock));
+    BOOST_CHECK(vout == mtx.vout);
+    BOOST_CHECK(hashBlock == block.GetHash());
+
+    // The whole transactions saved by the first version are read as their outputs
+    CDataStream ssV1(SER_DISK, CLIENT_VERSION);
+    ssV1 << std::string("CollateralIndex-Version-1") << std::map<uint256, std::pair<uint256, CTransactionRef>>{{mtx.GetHash(), {block.GetHash(), MakeTransactionRef(mtx)}}};
+    CollateralIndex indexV1;
+    ssV1 >> indexV1;
+    BOOST_CHECK(indexV1.GetCollateral(mtx.GetHash(), vout, hashBlock));
+    BOOST_CHECK(vout == mtx.vout);
+    BOOST_CHECK(hashBlock == block.GetHash());
+
+    // Disconnected collaterals are forgotten
+    CValidationState state;
+    CBlockIndex* pindexTip;
+    {
+        LOCK(cs_main);
+        pindexTip = chainActive.Tip();
+    }
+    BOOST_CHECK(InvalidateBlock(state, Params(), pindexTip));
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK(!index.GetCollateral(mtx.GetHash(), vout, hashBlock));
+
+    UnregisterValidationInterface(&index);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -92,6 +92,58 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_block_doublespend, TestChain100Setup)
     BOOST_CHECK_EQUAL(mempool.size(), 0U);
 }
 
+BOOST_FIXTURE_TEST_CASE(tx_mempool_batch, TestChain100Setup)
+{
+    CScript scriptPubKey = CScript() <<  ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    auto MakeSpend = [&](const uint256& hashPrev, CAmount nValue) {
+        CMutableTransaction spend;
+        spend.nVersion = 1;
+        spend.vin.resize(1);
+        spend.vin[0].prevout.hash = hashPrev;
+        spend.vin[0].prevout.n = 0;
+        spend.vout.resize(1);
+        spend.vout[0].nValue = nValue;
+        spend.vout[0].scriptPubKey = scriptPubKey;
+
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(scriptPubKey, spend, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+        BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        spend.vin[0].scriptSig << vchSig;
+        return MakeTransactionRef(std::move(spend));
+    };
+
+    // Two independent spends, a double spend of the first one, a child of the second one and
+    // a spend of an unknown output
+    std::vector<CTransactionRef> vtx;
+    vtx.push_back(MakeSpend(m_coinbase_txns[0]->GetHash(), 11*CENT));
+    vtx.push_back(MakeSpend(m_coinbase_txns[1]->GetHash(), 11*CENT));
+    vtx.push_back(MakeSpend(m_coinbase_txns[0]->GetHash(), 12*CENT));
+    vtx.push_back(MakeSpend(vtx[1]->GetHash(), 10*CENT));
+    vtx.push_back(MakeSpend(InsecureRand256(), 10*CENT));
+
+    std::vector<CValidationState> states;
+    std::vector<bool> missing_inputs;
+    std::vector<bool> accepted = AcceptToMemoryPoolBatch(mempool, vtx, states, missing_inputs, nullptr /* plTxnReplaced */, 0 /* nAbsurdFee */);
+    BOOST_REQUIRE_EQUAL(accepted.size(), vtx.size());
+    BOOST_CHECK(accepted[0]);
+    BOOST_CHECK(accepted[1]);
+    BOOST_CHECK(!accepted[2]);
+    BOOST_CHECK_EQUAL(states[2].GetRejectReason(), "txn-mempool-conflict");
+    BOOST_CHECK(accepted[3]);
+    BOOST_CHECK(!accepted[4]);
+    BOOST_CHECK(missing_inputs[4]);
+    BOOST_CHECK(!missing_inputs[0]);
+    BOOST_CHECK_EQUAL(mempool.size(), 3U);
+
+    // Transactions already in the mempool are not accepted again
+    accepted = AcceptToMemoryPoolBatch(mempool, {vtx[0]}, states, missing_inputs, nullptr /* plTxnReplaced */, 0 /* nAbsurdFee */);
+    BOOST_CHECK(!accepted[0]);
+    BOOST_CHECK_EQUAL(states[0].GetRejectReason(), "txn-already-in-mempool");
+    mempool.clear();
+}
+
 // Run CheckInputs (using pcoinsTip) on the given transaction, for all script
 // flags.  Test that CheckInputs passes for all flags that don't overlap with
 // the failing_flags argument, but otherwise fails.
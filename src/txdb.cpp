@@ -16,6 +16,9 @@
 
 #include <stdint.h>
 
+#include <functional> // VELES
+#include <thread> // VELES
+
 #include <boost/thread.hpp>
 
 static const char DB_COIN = 'C';
@@ -28,6 +31,9 @@ static const char DB_HEAD_BLOCKS = 'H';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+// VELES BEGIN
+static const char DB_BLOCK_POWHASH = 'p';
+// VELES END
 
 namespace {
 
@@ -57,15 +63,59 @@ CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(Get
 {
 }
 
+// VELES BEGIN
+CCoinsViewDB::~CCoinsViewDB()
+{
+    if (m_flush_thread.joinable()) {
+        m_flush_thread.join();
+    }
+}
+// VELES END
+
 bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    // VELES BEGIN
+    {
+        LOCK(m_cs_flush);
+        if (m_flushing) {
+            CCoinsMap::const_iterator it = m_flushing->find(outpoint);
+            if (it != m_flushing->end()) {
+                coin = it->second.coin;
+                return !coin.IsSpent();
+            }
+        }
+    }
+    // VELES END
     return db.Read(CoinEntry(&outpoint), coin);
 }
 
 bool CCoinsViewDB::HaveCoin(const COutPoint &outpoint) const {
+    // VELES BEGIN
+    {
+        LOCK(m_cs_flush);
+        if (m_flushing) {
+            CCoinsMap::const_iterator it = m_flushing->find(outpoint);
+            if (it != m_flushing->end()) {
+                return !it->second.coin.IsSpent();
+            }
+        }
+    }
+    // VELES END
     return db.Exists(CoinEntry(&outpoint));
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const {
+    // VELES BEGIN
+    {
+        LOCK(m_cs_flush);
+        if (m_flushing) {
+            return m_flushing_block;
+        }
+    }
+    return ReadBestBlock();
+}
+
+uint256 CCoinsViewDB::ReadBestBlock() const {
+    // VELES END
     uint256 hashBestChain;
     if (!db.Read(DB_BEST_BLOCK, hashBestChain))
         return uint256();
@@ -81,6 +131,89 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
 }
 
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    // VELES BEGIN
+    if (!m_async_flush) {
+        ++m_write_count;
+        return WriteCoins(mapCoins, hashBlock, true);
+    }
+
+    // Writes have to reach the database in order
+    if (!WaitForFlush()) {
+        return false;
+    }
+    if (m_flush_thread.joinable()) {
+        m_flush_thread.join();
+    }
+    {
+        LOCK(m_cs_flush);
+        m_flushing.reset(new CCoinsMap());
+        m_flushing->swap(mapCoins);
+        m_flushing_block = hashBlock;
+        m_flush_running = true;
+    }
+    ++m_write_count;
+    m_flush_thread = std::thread(&TraceThread<std::function<void()>>, "coinsflush", std::bind(&CCoinsViewDB::ThreadFlush, this));
+    return true;
+}
+
+void CCoinsViewDB::ThreadFlush()
+{
+    // Validation goes on meanwhile, the write only has to finish before the next one
+    ScheduleBatchPriority();
+
+    CCoinsMap* pcoins;
+    uint256 hashBlock;
+    {
+        LOCK(m_cs_flush);
+        pcoins = m_flushing.get();
+        hashBlock = m_flushing_block;
+    }
+    int64_t nStart = GetTimeMillis();
+    bool fOk = false;
+    try {
+        // Lookups keep reading the coins while they are written, so they stay in place
+        fOk = WriteCoins(*pcoins, hashBlock, false);
+    } catch (const std::exception& e) {
+        LogPrintf("%s: %s\n", __func__, e.what());
+    }
+    if (fOk) {
+        LogPrint(BCLog::COINDB, "Wrote coins of block %s in the background in %dms\n", hashBlock.ToString(), GetTimeMillis() - nStart);
+    } else {
+        LogPrintf("Error writing coins of block %s to the coin database\n", hashBlock.ToString());
+    }
+
+    std::unique_ptr<CCoinsMap> pwritten;
+    {
+        LOCK(m_cs_flush);
+        if (fOk) {
+            // The database has the coins now, free them outside of the lock
+            pwritten = std::move(m_flushing);
+        } else {
+            // Keep serving the coins, the next write reports the failure
+            m_flush_failed = true;
+        }
+        m_flush_running = false;
+    }
+    m_flush_cond.notify_all();
+}
+
+bool CCoinsViewDB::WaitForFlush() const
+{
+    WAIT_LOCK(m_cs_flush, lock);
+    m_flush_cond.wait(lock, [this]() { return !m_flush_running; });
+    return !m_flush_failed;
+}
+
+bool CCoinsViewDB::WriteSnapshotCoins(CCoinsMap& mapCoins, const uint256& hashBlock, bool fLast) {
+    if (!WaitForFlush()) {
+        return false;
+    }
+    ++m_write_count;
+    return WriteCoins(mapCoins, hashBlock, true, fLast);
+}
+
+bool CCoinsViewDB::WriteCoins(CCoinsMap& mapCoins, const uint256& hashBlock, bool fErase, bool fLast) {
+    // VELES END
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
@@ -88,7 +221,7 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
     assert(!hashBlock.IsNull());
 
-    uint256 old_tip = GetBestBlock();
+    uint256 old_tip = ReadBestBlock(); // VELES
     if (old_tip.IsNull()) {
         // We may be in the middle of replaying.
         std::vector<uint256> old_heads = GetHeadBlocks();
@@ -115,8 +248,13 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
+        // VELES BEGIN
+        if (fErase) {
+            it = mapCoins.erase(it);
+        } else {
+            ++it;
+        }
+        // VELES END
         if (batch.SizeEstimate() > batch_size) {
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
             db.WriteBatch(batch);
@@ -132,8 +270,12 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     }
 
     // In the last batch, mark the database as consistent with hashBlock again.
-    batch.Erase(DB_HEAD_BLOCKS);
-    batch.Write(DB_BEST_BLOCK, hashBlock);
+    // VELES BEGIN
+    if (fLast) {
+        batch.Erase(DB_HEAD_BLOCKS);
+        batch.Write(DB_BEST_BLOCK, hashBlock);
+    }
+    // VELES END
 
     LogPrint(BCLog::COINDB, "Writing final batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
     bool ret = db.WriteBatch(batch);
@@ -146,7 +288,20 @@ size_t CCoinsViewDB::EstimateSize() const
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" / "index" : GetBlocksDir() / "index", nCacheSize, fMemory, fWipe) {
+// VELES BEGIN
+/** The block index is read as a whole at startup and then mostly written, larger blocks suit the scan */
+static DBProfile BlockTreeDBProfile()
+{
+    DBProfile profile;
+    profile.block_size = 16 * 1024;
+    return profile;
+}
+// VELES END
+
+// VELES BEGIN
+//CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" / "index" : GetBlocksDir() / "index", nCacheSize, fMemory, fWipe) {
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" / "index" : GetBlocksDir() / "index", nCacheSize, fMemory, fWipe, false, BlockTreeDBProfile()) {
+// VELES END
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -170,6 +325,8 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
 
 CCoinsViewCursor *CCoinsViewDB::Cursor() const
 {
+    // The cursor only sees the database, let coins still being written reach it
+    WaitForFlush(); // VELES
     CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper&>(db).NewIterator(), GetBestBlock());
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
@@ -230,6 +387,11 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
     batch.Write(DB_LAST_BLOCK, nLastFile);
     for (std::vector<const CBlockIndex*>::const_iterator it=blockinfo.begin(); it != blockinfo.end(); it++) {
         batch.Write(std::make_pair(DB_BLOCK_INDEX, (*it)->GetBlockHash()), CDiskBlockIndex(*it));
+        // VELES BEGIN
+        // Only persist PoW hashes that have already been computed, never compute them here.
+        if (!(*it)->hashPoW.IsNull())
+            batch.Write(std::make_pair(DB_BLOCK_POWHASH, (*it)->GetBlockHash()), (*it)->hashPoW);
+        // VELES END
     }
     return WriteBatch(batch, true);
 }
@@ -246,12 +408,30 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+// VELES BEGIN
+/** Header of a block index entry read from disk, whose predecessor is only known by hash */
+static CBlockHeader DiskBlockHeader(const CDiskBlockIndex& diskindex)
+{
+    CBlockHeader block;
+    block.nVersion       = diskindex.nVersion;
+    block.hashPrevBlock  = diskindex.hashPrev;
+    block.hashMerkleRoot = diskindex.hashMerkleRoot;
+    block.nTime          = diskindex.nTime;
+    block.nBits          = diskindex.nBits;
+    block.nNonce         = diskindex.nNonce;
+    return block;
+}
+
+//bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::vector<CDiskBlockIndex>& vIndexRet, std::vector<uint256>& vHashRet, int nThreads)
+// VELES END
 {
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
     pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256()));
 
+    // VELES BEGIN
+    /*
     // Load mapBlockIndex
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
@@ -275,10 +455,11 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
                 pindexNew->nTx            = diskindex.nTx;
 
                 // FXTC BEGIN
-                if (pindexNew->nHeight > consensusParams.nlastValidPowHashHeight)
+                if (pindexNew->nHeight > consensusParams.nlastValidPowHashHeight) {
                 // FXTC END
-                if (!CheckProofOfWork(pindexNew->GetBlockPoWHash(), pindexNew->nBits, consensusParams))
-                    return error("%s: CheckProofOfWork failed: %s", __func__, pindexNew->ToString());
+                    if (!CheckProofOfWork(pindexNew->GetBlockPoWHash(), pindexNew->nBits, consensusParams))
+                        return error("%s: CheckProofOfWork failed: %s", __func__, pindexNew->ToString());
+                }
 
                 pcursor->Next();
             } else {
@@ -288,6 +469,125 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
             break;
         }
     }
+    */
+    // PoW hashes are stored under the same block hash keys as the index entries,
+    // so both ranges can be walked side by side in a single pass.
+    std::unique_ptr<CDBIterator> pcursorPoW(NewIterator());
+    pcursorPoW->Seek(std::make_pair(DB_BLOCK_POWHASH, uint256()));
+
+    // The raw values are copied in one buffer on this thread, the database
+    // iterators are not thread-safe
+    std::vector<unsigned char> vData;
+    std::vector<size_t> vOffset;
+    std::vector<uint256> vHashPoW;
+    const unsigned char prefix[] = {DB_BLOCK_INDEX};
+    bool fPoWError = false;
+    pcursor->ForEachWithPrefix(MakeSpan(prefix), [&](Span<const unsigned char> key, Span<const unsigned char> value) {
+        if ((vOffset.size() & 0xffff) == 0)
+            boost::this_thread::interruption_point();
+        if (key.size() != 1 + sizeof(uint256))
+            return true;
+        uint256 hash;
+        memcpy(hash.begin(), key.data() + 1, sizeof(uint256));
+
+        uint256 hashPoW;
+        std::pair<char, uint256> keyPoW;
+        while (pcursorPoW->Valid() && pcursorPoW->GetKey(keyPoW) && keyPoW.first == DB_BLOCK_POWHASH && keyPoW.second < hash)
+            pcursorPoW->Next();
+        if (pcursorPoW->Valid() && pcursorPoW->GetKey(keyPoW) && keyPoW.first == DB_BLOCK_POWHASH && keyPoW.second == hash) {
+            if (!pcursorPoW->GetValue(hashPoW)) {
+                fPoWError = true;
+                return false;
+            }
+        }
+
+        vOffset.push_back(vData.size());
+        vData.insert(vData.end(), value.begin(), value.end());
+        vHashPoW.push_back(hashPoW);
+        return true;
+    });
+    if (fPoWError)
+        return error("%s: failed to read PoW hash", __func__);
+    const size_t nEntries = vOffset.size();
+    vOffset.push_back(vData.size());
+
+    vIndexRet.clear();
+    vIndexRet.resize(nEntries);
+    vHashRet.assign(nEntries, uint256());
+    std::vector<char> vMissingPoW(nEntries, 0);
+
+    // Each thread parses a contiguous slice of the entries, in place
+    nThreads = std::max(1, std::min<int>(nThreads, nEntries / 64 + 1));
+    std::vector<std::string> vErrors(nThreads);
+    auto parse = [&](int nThread) {
+        const size_t nBegin = nEntries * nThread / nThreads;
+        const size_t nEnd = nEntries * (nThread + 1) / nThreads;
+        for (size_t i = nBegin; i < nEnd; i++) {
+            CDiskBlockIndex& diskindex = vIndexRet[i];
+            try {
+                SpanReader ssValue(SER_DISK, CLIENT_VERSION, Span<const unsigned char>(vData.data() + vOffset[i], vOffset[i + 1] - vOffset[i]));
+                ssValue >> diskindex;
+            } catch (const std::exception&) {
+                vErrors[nThread] = strprintf("%s: failed to read value", __func__);
+                return;
+            }
+            const CBlockHeader header = DiskBlockHeader(diskindex);
+            vHashRet[i] = header.GetHash();
+            diskindex.phashBlock = &vHashRet[i];
+            diskindex.hashPoW = vHashPoW[i];
+
+            // FXTC BEGIN
+            if (diskindex.nHeight > consensusParams.nlastValidPowHashHeight) {
+            // FXTC END
+                // A stored PoW hash is trusted here (only checked against nBits),
+                // -checkpowonload re-verifies the most recent headers.
+                if (diskindex.hashPoW.IsNull()) {
+                    diskindex.hashPoW = header.GetPoWHash();
+                    vMissingPoW[i] = 1;
+                }
+                if (!CheckProofOfWork(diskindex.hashPoW, diskindex.nBits, consensusParams)) {
+                    vErrors[nThread] = strprintf("%s: CheckProofOfWork failed: %s", __func__, diskindex.ToString());
+                    return;
+                }
+            }
+
+            // The work of the entry alone does not depend on its predecessors
+            diskindex.GetAlgoTarget();
+            diskindex.nBlockWork = GetBlockProof(diskindex);
+        }
+    };
+    if (nThreads == 1) {
+        parse(0);
+    } else {
+        std::vector<std::thread> vThreads;
+        for (int i = 0; i < nThreads; i++) {
+            vThreads.emplace_back(&TraceThread<std::function<void()>>, "loadindex", std::bind(parse, i));
+        }
+        for (std::thread& thread : vThreads) {
+            thread.join();
+        }
+    }
+    for (const std::string& strError : vErrors) {
+        if (!strError.empty())
+            return error("%s", strError);
+    }
+
+    // Upgrade entries written before PoW hashes were persisted, so they are
+    // only computed once.
+    size_t nMissingPoW = 0;
+    CDBBatch batch(*this);
+    for (size_t i = 0; i < nEntries; i++) {
+        if (!vMissingPoW[i])
+            continue;
+        batch.Write(std::make_pair(DB_BLOCK_POWHASH, vHashRet[i]), vIndexRet[i].hashPoW);
+        nMissingPoW++;
+    }
+    if (nMissingPoW > 0) {
+        if (!WriteBatch(batch))
+            return error("%s: failed to write PoW hashes", __func__);
+        LogPrintf("%s: stored PoW hashes for %u block index entries\n", __func__, nMissingPoW);
+    }
+    // VELES END
 
     return true;
 }
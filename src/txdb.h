@@ -10,10 +10,14 @@
 #include <dbwrapper.h>
 #include <chain.h>
 #include <primitives/block.h>
+#include <sync.h> // VELES
 
+#include <atomic> // VELES
+#include <condition_variable> // VELES
 #include <map>
 #include <memory>
 #include <string>
+#include <thread> // VELES
 #include <utility>
 #include <vector>
 
@@ -37,16 +41,47 @@ static const int64_t nMaxBlockDBCache = 2;
 // Unlike for the UTXO database, for the txindex scenario the leveldb cache make
 // a meaningful difference: https://github.com/bitcoin/bitcoin/pull/8273#issuecomment-229601991
 static const int64_t nMaxTxIndexCache = 1024;
+// VELES BEGIN
+//! Max memory allocated to all block filter index caches combined in MiB.
+static const int64_t max_filter_index_cache = 1024;
+//! Max memory allocated to the address, spent and timestamp index caches combined in MiB.
+static const int64_t max_address_index_cache = 1024;
+// VELES END
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+// VELES BEGIN
+//! -asyncflush default
+static const bool DEFAULT_ASYNC_FLUSH = false;
+//! Share of the memory left by the mempool and the Dash-layer caches used by -dbcache=auto once synced (percent)
+static const int64_t nAutoDbCacheSteadyPercent = 12;
+//! Share of that memory used by -dbcache=auto during the initial block download (percent)
+static const int64_t nAutoDbCacheIBDPercent = 50;
+// VELES END
 
 /** CCoinsView backed by the coin database (chainstate/) */
 class CCoinsViewDB final : public CCoinsView
 {
 protected:
     CDBWrapper db;
+    // VELES BEGIN
+    std::atomic<uint64_t> m_write_count{0};
+    bool m_async_flush = false;
+    mutable Mutex m_cs_flush;
+    mutable std::condition_variable m_flush_cond;
+    //! Coins handed to BatchWrite that are still being written, looked up before the database
+    std::unique_ptr<CCoinsMap> m_flushing GUARDED_BY(m_cs_flush);
+    uint256 m_flushing_block GUARDED_BY(m_cs_flush);
+    bool m_flush_running GUARDED_BY(m_cs_flush) = false;
+    bool m_flush_failed GUARDED_BY(m_cs_flush) = false;
+    std::thread m_flush_thread;
+
+    uint256 ReadBestBlock() const;
+    bool WriteCoins(CCoinsMap& mapCoins, const uint256& hashBlock, bool fErase, bool fLast = true);
+    void ThreadFlush();
+    // VELES END
 public:
     explicit CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    ~CCoinsViewDB(); // VELES
 
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
@@ -58,6 +93,24 @@ public:
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
+    // VELES BEGIN
+    //! Number of BatchWrite calls started, so readers outside of cs_main can tell their reads may be outdated
+    uint64_t GetWriteCount() const { return m_write_count.load(); }
+
+    /**
+     * Let BatchWrite hand the coins to a background thread and return right away. Until
+     * they are written, lookups are served from them, and the head blocks marker in the
+     * database covers a crash in the meantime just like during a synchronous write.
+     */
+    void SetAsyncFlush(bool fAsync) { m_async_flush = fAsync; }
+    //! Wait until coins handed to BatchWrite are written. Returns false if writing them failed.
+    bool WaitForFlush() const;
+    /**
+     * Write coins of a UTXO snapshot at hashBlock in several parts. The database stays
+     * marked as being in transition to hashBlock until the last part is written.
+     */
+    bool WriteSnapshotCoins(CCoinsMap& mapCoins, const uint256& hashBlock, bool fLast);
+    // VELES END
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -95,7 +148,16 @@ public:
     void ReadReindexing(bool &fReindexing);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
-    bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+    // VELES BEGIN
+    //bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+    /**
+     * Read every block index entry into vIndexRet, one contiguous allocation, with the
+     * hash of each entry in vHashRet. The values are parsed, hashed and their proof of
+     * work checked on nThreads threads. The entries are not linked, hashPrev names the
+     * predecessor of each.
+     */
+    bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::vector<CDiskBlockIndex>& vIndexRet, std::vector<uint256>& vHashRet, int nThreads);
+    // VELES END
 };
 
 #endif // BITCOIN_TXDB_H
@@ -10,6 +10,7 @@
 #include <consensus/consensus.h>
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
+#include <mempooljournal.h> // VELES
 #include <validation.h>
 #include <policy/policy.h>
 #include <policy/fees.h>
@@ -400,6 +401,7 @@ void CTxMemPool::addUnchecked(const CTxMemPoolEntry &entry, setEntries &setAnces
     nTransactionsUpdated++;
     totalTxSize += entry.GetTxSize();
     if (minerPolicyEstimator) {minerPolicyEstimator->processTransaction(entry, validFeeEstimate);}
+    if (journal) journal->Added(entry.GetSharedTx(), entry.GetTime()); // VELES
 
     vTxHashes.emplace_back(tx.GetWitnessHash(), newit);
     newit->vTxHashesIdx = vTxHashes.size() - 1;
@@ -428,6 +430,7 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
     mapTx.erase(it);
     nTransactionsUpdated++;
     if (minerPolicyEstimator) {minerPolicyEstimator->removeTx(hash, false);}
+    if (journal) journal->Removed(hash); // VELES
 }
 
 // Calculates descendants of entry that are not already in setDescendants, and adds to
@@ -565,6 +568,39 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
     }
     // Before the txs in the new block have been removed from the mempool, update policy estimates
     if (minerPolicyEstimator) {minerPolicyEstimator->processBlock(nBlockHeight, entries);}
+    // VELES BEGIN
+    // The in-mempool parents of the block transactions are in the block too,
+    // unless the mempool is in the middle of a reorg. The whole block is then
+    // removed at once, its conflicts after it.
+    std::vector<txiter> vConfirmed;
+    vConfirmed.reserve(entries.size());
+    setEntries setConfirmed;
+    for (const CTxMemPoolEntry* entry : entries) {
+        vConfirmed.push_back(mapTx.iterator_to(*entry));
+        setConfirmed.insert(vConfirmed.back());
+    }
+    bool fClosed = true;
+    for (txiter it : vConfirmed) {
+        for (txiter parent : GetMemPoolParents(it)) {
+            if (!setConfirmed.count(parent)) {
+                fClosed = false;
+                break;
+            }
+        }
+        if (!fClosed) break;
+    }
+    if (fClosed) {
+        RemoveConfirmed(vConfirmed, setConfirmed);
+        for (const auto& tx : vtx)
+        {
+            removeConflicts(*tx);
+            ClearPrioritisation(tx->GetHash());
+        }
+        lastRollingFeeUpdate = GetTime();
+        blockSinceLastRollingFeeBump = true;
+        return;
+    }
+    // VELES END
     for (const auto& tx : vtx)
     {
         txiter it = mapTx.find(tx->GetHash());
@@ -580,6 +616,52 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
     blockSinceLastRollingFeeBump = true;
 }
 
+// VELES BEGIN
+void CTxMemPool::RemoveConfirmed(const std::vector<txiter>& vConfirmed, const setEntries& setConfirmed)
+{
+    AssertLockHeld(cs);
+    const uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+
+    // Nothing left in the mempool is an ancestor of the confirmed transactions,
+    // only the descendants left behind are updated, each of them once
+    setEntries setDescendants;
+    for (txiter it : vConfirmed) {
+        for (txiter childit : GetMemPoolChildren(it)) {
+            if (!setConfirmed.count(childit))
+                CalculateDescendants(childit, setDescendants);
+        }
+    }
+    for (txiter dit : setDescendants) {
+        setEntries setAncestors;
+        std::string dummy;
+        CalculateMemPoolAncestors(*dit, setAncestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
+        int64_t modifySize = 0;
+        CAmount modifyFee = 0;
+        int64_t modifyCount = 0;
+        int64_t modifySigOps = 0;
+        for (txiter ancestorIt : setAncestors) {
+            if (!setConfirmed.count(ancestorIt)) continue;
+            modifySize -= ancestorIt->GetTxSize();
+            modifyFee -= ancestorIt->GetModifiedFee();
+            modifyCount--;
+            modifySigOps -= ancestorIt->GetSigOpCost();
+        }
+        mapTx.modify(dit, update_ancestor_state(modifySize, modifyFee, modifyCount, modifySigOps));
+    }
+
+    // The links between the confirmed transactions go away with them
+    for (txiter it : vConfirmed) {
+        for (txiter childit : GetMemPoolChildren(it)) {
+            if (!setConfirmed.count(childit))
+                UpdateParent(childit, it, false);
+        }
+    }
+    for (txiter it : vConfirmed) {
+        removeUnchecked(it, MemPoolRemovalReason::BLOCK);
+    }
+}
+// VELES END
+
 void CTxMemPool::_clear()
 {
     mapLinks.clear();
@@ -591,6 +673,7 @@ void CTxMemPool::_clear()
     blockSinceLastRollingFeeBump = false;
     rollingMinimumFeeRate = 0;
     ++nTransactionsUpdated;
+    if (journal) journal->Cleared(); // VELES
 }
 
 void CTxMemPool::clear()
@@ -886,6 +969,7 @@ void CTxMemPool::PrioritiseTransaction(const uint256& hash, const CAmount& nFeeD
         LOCK(cs);
         CAmount &delta = mapDeltas[hash];
         delta += nFeeDelta;
+        if (journal) journal->DeltaAdded(hash, nFeeDelta); // VELES
         txiter it = mapTx.find(hash);
         if (it != mapTx.end()) {
             mapTx.modify(it, update_fee_delta(delta));
@@ -924,6 +1008,7 @@ void CTxMemPool::ClearPrioritisation(const uint256 hash)
 {
     LOCK(cs);
     mapDeltas.erase(hash);
+    if (journal) journal->DeltaCleared(hash); // VELES
 }
 
 const CTransaction* CTxMemPool::GetConflictTx(const COutPoint& prevout) const
@@ -978,7 +1063,7 @@ bool CCoinsViewMemPool::GetCoin(const COutPoint &outpoint, Coin &coin) const {
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
     // Estimate the overhead of mapTx to be 12 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
-    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
+    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage + memusage::DynamicUsage(setInstantSendLocked); // VELES
 }
 
 void CTxMemPool::RemoveStaged(setEntries &stage, bool updateDescendants, MemPoolRemovalReason reason) {
@@ -1087,8 +1172,21 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpends
 
     unsigned nTxnRemoved = 0;
     CFeeRate maxFeeRateRemoved(0);
-    while (!mapTx.empty() && DynamicMemoryUsage() > sizelimit) {
-        indexed_transaction_set::index<descendant_score>::type::iterator it = mapTx.get<descendant_score>().begin();
+    // VELES BEGIN
+    indexed_transaction_set::index<descendant_score>::type::iterator it = mapTx.get<descendant_score>().begin();
+    //while (!mapTx.empty() && DynamicMemoryUsage() > sizelimit) {
+    while (it != mapTx.get<descendant_score>().end() && DynamicMemoryUsage() > sizelimit) {
+        //indexed_transaction_set::index<descendant_score>::type::iterator it = mapTx.get<descendant_score>().begin();
+        setEntries stage;
+        CalculateDescendants(mapTx.project<0>(it), stage);
+        // Locked transactions have to be mined, neither they nor their ancestors are evicted
+        if (!setInstantSendLocked.empty() && std::any_of(stage.begin(), stage.end(), [this](txiter iter) {
+                return setInstantSendLocked.count(iter->GetTx().GetHash()) != 0;
+            })) {
+            ++it;
+            continue;
+        }
+    // VELES END
 
         // We set the new mempool min fee to the feerate of the removed set, plus the
         // "minimum reasonable fee rate" (ie some value under which we consider txn
@@ -1099,8 +1197,8 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpends
         trackPackageRemoved(removed);
         maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
 
-        setEntries stage;
-        CalculateDescendants(mapTx.project<0>(it), stage);
+        //setEntries stage;
+        //CalculateDescendants(mapTx.project<0>(it), stage);
         nTxnRemoved += stage.size();
 
         std::vector<CTransaction> txn;
@@ -1110,6 +1208,7 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpends
                 txn.push_back(iter->GetTx());
         }
         RemoveStaged(stage, false, MemPoolRemovalReason::SIZELIMIT);
+        it = mapTx.get<descendant_score>().begin(); // VELES
         if (pvNoSpendsRemaining) {
             for (const CTransaction& tx : txn) {
                 for (const CTxIn& txin : tx.vin) {
@@ -1125,6 +1224,49 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpends
     }
 }
 
+// VELES BEGIN
+void CTxMemPool::SetInstantSendLocked(const uint256& hash)
+{
+    LOCK(cs);
+    // A template selected before the lock has to be selected again, with the transaction first
+    if (!setInstantSendLocked.insert(hash).second) return;
+    if (mapTx.count(hash))
+        nTransactionsUpdated++;
+    if (journal) journal->LockChanged(hash, true);
+}
+
+void CTxMemPool::UnsetInstantSendLocked(const uint256& hash)
+{
+    LOCK(cs);
+    if (setInstantSendLocked.erase(hash) && journal)
+        journal->LockChanged(hash, false);
+}
+
+void CTxMemPool::SetJournal(CMempoolJournal* journalIn)
+{
+    AssertLockHeld(cs);
+    journal = journalIn;
+}
+
+bool CTxMemPool::IsInstantSendLocked(const uint256& hash) const
+{
+    LOCK(cs);
+    return setInstantSendLocked.count(hash) != 0;
+}
+
+std::vector<CTxMemPool::txiter> CTxMemPool::GetInstantSendLocked() const
+{
+    AssertLockHeld(cs);
+    std::vector<txiter> vLocked;
+    for (const uint256& hash : setInstantSendLocked) {
+        txiter it = mapTx.find(hash);
+        if (it != mapTx.end())
+            vLocked.push_back(it);
+    }
+    return vLocked;
+}
+// VELES END
+
 uint64_t CTxMemPool::CalculateDescendantMaximum(txiter entry) const {
     // find parent with highest descendant count
     std::vector<txiter> candidates;
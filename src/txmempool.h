@@ -337,6 +337,7 @@ struct entry_time {};
 struct ancestor_score {};
 
 class CBlockPolicyEstimator;
+class CMempoolJournal; // VELES
 
 /**
  * Information about a mempool transaction.
@@ -461,6 +462,7 @@ private:
     uint32_t nCheckFrequency GUARDED_BY(cs); //!< Value n means that n times in 2^32 we check.
     unsigned int nTransactionsUpdated; //!< Used by getblocktemplate to trigger CreateNewBlock() invocation
     CBlockPolicyEstimator* minerPolicyEstimator;
+    CMempoolJournal* journal GUARDED_BY(cs) = nullptr; // VELES
 
     uint64_t totalTxSize;      //!< sum of all mempool tx's virtual sizes. Differs from serialized tx size since witness data is discounted. Defined in BIP 141.
     uint64_t cachedInnerUsage; //!< sum of dynamic memory usage of all the map elements (NOT the maps themselves)
@@ -572,6 +574,10 @@ private:
 public:
     indirectmap<COutPoint, const CTransaction*> mapNextTx GUARDED_BY(cs);
     std::map<uint256, CAmount> mapDeltas;
+    // VELES BEGIN
+    //! Transactions with a completed InstantSend lock, see SetInstantSendLocked
+    std::set<uint256> setInstantSendLocked GUARDED_BY(cs);
+    // VELES END
 
     /** Create a new CTxMemPool.
      */
@@ -710,6 +716,20 @@ public:
     TxMempoolInfo info(const uint256& hash) const;
     std::vector<TxMempoolInfo> infoAll() const;
 
+    // VELES BEGIN
+    /** Record a completed InstantSend lock of a transaction, in the pool or not yet. Locked
+     *  transactions have to be mined, block assembly includes them first and TrimToSize never
+     *  evicts them. */
+    void SetInstantSendLocked(const uint256& hash);
+    /** Forget the lock of a transaction, once it expired or was found to conflict */
+    void UnsetInstantSendLocked(const uint256& hash);
+    bool IsInstantSendLocked(const uint256& hash) const;
+    /** The locked transactions in the pool */
+    std::vector<txiter> GetInstantSendLocked() const EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Hand the changes of the pool to journal from now on, nullptr to stop */
+    void SetJournal(CMempoolJournal* journalIn) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    // VELES END
+
     // Dash
     /** Estimate fee rate needed to get into the next nBlocks
      *  If no answer can be given at nBlocks, return an estimate
@@ -766,6 +786,12 @@ private:
     void UpdateForRemoveFromMempool(const setEntries &entriesToRemove, bool updateDescendants) EXCLUSIVE_LOCKS_REQUIRED(cs);
     /** Sever link between specified transaction and direct children. */
     void UpdateChildrenForRemoval(txiter entry) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    // VELES BEGIN
+    /** Remove the transactions of a block, in block order. The set has to
+     *  include all their in-mempool ancestors, the ancestor state of the
+     *  descendants left behind is then updated once for all of them. */
+    void RemoveConfirmed(const std::vector<txiter>& vConfirmed, const setEntries& setConfirmed) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    // VELES END
 
     /** Before calling removeUnchecked for a given transaction,
      *  UpdateForRemoveFromMempool must be called on the entire (dependent) set
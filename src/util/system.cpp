@@ -36,6 +36,7 @@
 #include <sched.h>
 #include <sys/resource.h>
 #include <sys/stat.h>
+#include <unistd.h> // VELES
 
 #else
 
@@ -1278,6 +1279,27 @@ int GetNumCores()
     return std::thread::hardware_concurrency();
 }
 
+// VELES BEGIN
+int64_t GetTotalSystemMemory()
+{
+#ifdef WIN32
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (GlobalMemoryStatusEx(&status))
+        return status.ullTotalPhys;
+    return 0;
+#elif defined(_SC_PHYS_PAGES) && defined(_SC_PAGESIZE)
+    long nPages = sysconf(_SC_PHYS_PAGES);
+    long nPageSize = sysconf(_SC_PAGESIZE);
+    if (nPages <= 0 || nPageSize <= 0)
+        return 0;
+    return (int64_t)nPages * nPageSize;
+#else
+    return 0;
+#endif
+}
+// VELES END
+
 std::string CopyrightHolders(const std::string& strPrefix)
 {
     // VELES BEGIN
@@ -1324,6 +1346,24 @@ int ScheduleBatchPriority()
 #endif
 }
 
+// VELES BEGIN
+int PinThreadToCore(int nCore)
+{
+#if defined(__linux__) && defined(CPU_SET)
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(nCore % std::max(1, GetNumCores()), &cpuset);
+    if (int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset)) {
+        LogPrintf("Failed to pthread_setaffinity_np: %s\n", strerror(ret));
+        return ret;
+    }
+    return 0;
+#else
+    return 1;
+#endif
+}
+// VELES END
+
 // Dash
 uint32_t StringVersionToInt(const std::string& strVersion)
 {
@@ -359,6 +359,14 @@ std::string HelpMessageOpt(const std::string& option, const std::string& message
  */
 int GetNumCores();
 
+// VELES BEGIN
+/**
+ * Return the physical memory of the system in bytes, or 0 when it can't be
+ * determined.
+ */
+int64_t GetTotalSystemMemory();
+// VELES END
+
 void RenameThread(const char* name);
 
 /**
@@ -400,6 +408,16 @@ std::string CopyrightHolders(const std::string& strPrefix);
  */
 int ScheduleBatchPriority();
 
+// VELES BEGIN
+/**
+ * On platforms that support it, run the calling thread on the given core only.
+ *
+ * @return The return value of pthread_setaffinity_np(), or 1 on systems without
+ * it.
+ */
+int PinThreadToCore(int nCore);
+// VELES END
+
 namespace util {
 
 //! Simplification of std insertion
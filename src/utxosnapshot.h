@@ -0,0 +1,51 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef VELES_UTXOSNAPSHOT_H
+#define VELES_UTXOSNAPSHOT_H
+
+#include <serialize.h>
+#include <uint256.h>
+
+#include <ios>
+#include <stdint.h>
+
+/**
+ * Header of a UTXO set snapshot written by dumptxoutset. It is followed by
+ * m_coins_count pairs of COutPoint and Coin, in the order of the coin
+ * database, so hashing them the way gettxoutsetinfo does gives
+ * m_hash_serialized. The coins carry their heights and coinbase flags, which
+ * is all masternode collateral checks need besides the chain itself.
+ */
+class SnapshotMetadata
+{
+public:
+    static constexpr uint32_t SNAPSHOT_MAGIC = 0x7574786f; // "utxo"
+    static constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+    uint256 m_base_blockhash;
+    //! Number of transactions of the chain up to and including the base block
+    uint64_t m_chain_tx = 0;
+    uint64_t m_coins_count = 0;
+    uint256 m_hash_serialized;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        uint32_t nMagic = SNAPSHOT_MAGIC;
+        uint32_t nVersion = SNAPSHOT_VERSION;
+        READWRITE(nMagic);
+        READWRITE(nVersion);
+        if (nMagic != SNAPSHOT_MAGIC || nVersion != SNAPSHOT_VERSION) {
+            throw std::ios_base::failure("Not a supported UTXO snapshot");
+        }
+        READWRITE(m_base_blockhash);
+        READWRITE(m_chain_tx);
+        READWRITE(m_coins_count);
+        READWRITE(m_hash_serialized);
+    }
+};
+
+#endif // VELES_UTXOSNAPSHOT_H
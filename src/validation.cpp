@@ -8,10 +8,13 @@
 #include <validation.h>
 
 #include <arith_uint256.h>
+#include <blockimport.h> // VELES
+#include <blockreadcache.h> // VELES
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
 #include <checkqueue.h>
+#include <coinsprefetch.h> // VELES
 #include <consensus/consensus.h>
 #include <consensus/merkle.h>
 #include <consensus/tx_verify.h>
@@ -22,6 +25,7 @@
 // FXTC BEGIN
 #include <key_io.h>
 // FXTC END
+#include <mempooljournal.h> // VELES
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <policy/rbf.h>
@@ -40,6 +44,7 @@
 #include <txmempool.h>
 #include <ui_interface.h>
 #include <undo.h>
+#include <utxosnapshot.h> // VELES
 #include <util/system.h>
 #include <util/moneystr.h>
 #include <util/strencodings.h>
@@ -50,6 +55,7 @@
 #include <masternode/payments.h>
 
 #include <future>
+#include <map> // VELES
 #include <sstream>
 // VELES BEGIN
 #include <vector>
@@ -170,18 +176,26 @@ public:
     bool LoadBlockIndex(const Consensus::Params& consensus_params, CBlockTreeDB& blocktree) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     bool ActivateBestChain(CValidationState &state, const CChainParams& chainparams, std::shared_ptr<const CBlock> pblock);
+    bool ActivateSnapshot(CAutoFile& coins_file, const SnapshotMetadata& metadata, const CChainParams& chainparams, std::string& strError) LOCKS_EXCLUDED(cs_main); // VELES
 
     /**
      * If a block header hasn't already been seen, call CheckBlockHeader on it, ensure
      * that it doesn't descend from an invalid block, and then add it to mapBlockIndex.
      */
-    bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
-    bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    // VELES BEGIN
+    //bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    //! If phashPoW points to a non-null hash it is used as the already computed PoW hash of block.
+    bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, const uint256* phashPoW = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    // VELES END
+    // VELES: If phashPoW points to a non-null hash it is used as the already computed PoW hash of the block.
+    bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock, const uint256* phashPoW = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     // Block (dis)connection on a given view:
     DisconnectResult DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view);
+    // VELES: The scripts of the transactions flagged in pvScriptsChecked are not verified again
     bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex,
-                      CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck = false) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+                      CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck = false,
+                      const std::vector<bool>* pvScriptsChecked = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_main); // VELES: Added parameter pvScriptsChecked
 
     // Block disconnection on our pcoinsTip:
     bool DisconnectTip(CValidationState& state, const CChainParams& chainparams, DisconnectedBlockTransactions* disconnectpool) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
@@ -241,12 +255,72 @@ private:
 RecursiveMutex cs_main;
 
 BlockMap& mapBlockIndex = g_chainstate.mapBlockIndex;
+// VELES BEGIN
+/**
+ * Storage of the block index entries, allocated in chunks rather than one by one. This
+ * saves the allocator overhead of every entry and keeps the blocks of a chain synced in
+ * order next to each other, which the walks of the retargeting and of the masternode
+ * lookbacks benefit from. Entries are only released all together by Clear().
+ */
+class CBlockIndexArena
+{
+public:
+    CBlockIndex* Allocate()
+    {
+        if (!pChunk || nChunkUsed == CHUNK_ENTRIES) {
+            pChunk = AllocateBatch(CHUNK_ENTRIES);
+            nChunkUsed = 0;
+        }
+        return &pChunk[nChunkUsed++];
+    }
+
+    //! Contiguous entries in a chunk of their own, nullptr if nEntries is zero
+    CBlockIndex* AllocateBatch(size_t nEntries)
+    {
+        if (nEntries == 0)
+            return nullptr;
+        std::unique_ptr<CBlockIndex[]> chunk(new CBlockIndex[nEntries]);
+        CBlockIndex* pBegin = chunk.get();
+        mapChunks.emplace(pBegin, std::make_pair(nEntries, std::move(chunk)));
+        return pBegin;
+    }
+
+    bool Owns(const CBlockIndex* pindex) const
+    {
+        auto it = mapChunks.upper_bound(pindex);
+        if (it == mapChunks.begin())
+            return false;
+        --it;
+        return std::less<const CBlockIndex*>()(pindex, it->first + it->second.first);
+    }
+
+    void Clear()
+    {
+        mapChunks.clear();
+        pChunk = nullptr;
+        nChunkUsed = 0;
+    }
+
+private:
+    static const size_t CHUNK_ENTRIES = 4096;
+
+    //! Chunks by their first entry, with their number of entries
+    std::map<const CBlockIndex*, std::pair<size_t, std::unique_ptr<CBlockIndex[]>>> mapChunks;
+    //! Chunk of Allocate(), of which the first nChunkUsed entries are in use
+    CBlockIndex* pChunk = nullptr;
+    size_t nChunkUsed = 0;
+};
+static CBlockIndexArena g_block_index_arena;
+// VELES END
 CChain& chainActive = g_chainstate.chainActive;
 CBlockIndex *pindexBestHeader = nullptr;
+const CBlockIndex* g_snapshot_base = nullptr; // VELES
 Mutex g_best_block_mutex;
 std::condition_variable g_best_block_cv;
 uint256 g_best_block;
 int nScriptCheckThreads = 0;
+ScriptCheckPinning g_script_check_pinning = ScriptCheckPinning::NONE; // VELES
+unsigned int g_max_validation_queue = DEFAULT_MAX_VALIDATION_QUEUE; // VELES
 std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
 bool fHavePruned = false;
@@ -256,6 +330,7 @@ bool fRequireStandard = true;
 bool fCheckBlockIndex = false;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
 size_t nCoinCacheUsage = 5000 * 300;
+size_t nCoinCacheUsageIBD = 0; // VELES
 uint64_t nPruneTarget = 0;
 int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
 bool fEnableReplacement = DEFAULT_ENABLE_REPLACEMENT;
@@ -273,10 +348,6 @@ std::atomic_bool g_is_mempool_loaded{false};
 // Dash
 map<uint256, int64_t> mapRejectedBlocks GUARDED_BY(cs_main);
 //
-// VELES BEGIN
-std::map<int, std::map<int, CAmount>> totalSupplyIndex;
-// VELES END
-
 /** Constant stuff for coinbase transactions we create: */
 CScript COINBASE_FLAGS;
 
@@ -1115,42 +1186,78 @@ static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMes
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
+// VELES BEGIN
+// If phashPoW points to a non-null hash it is trusted as the PoW hash of the block read
+//bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
+static bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams, const uint256* phashPoW)
+// VELES END
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+    // VELES BEGIN
+    std::shared_ptr<const CBlock> cached = g_block_read_cache.Get(pos);
+    if (cached) {
+        block = *cached;
+        return true;
+    }
 
     // Read block
     try {
-        filein >> block;
+        if (!g_block_read_cache.ReadMapped(pos, block)) {
+            // Open history file to read
+            CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+            if (filein.IsNull())
+                return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+
+            filein >> block;
+        }
     }
     catch (const std::exception& e) {
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
     }
+    // VELES END
 
     // Check the header
     // FXTC BEGIN
     //if (!CheckProofOfWork(block.GetHash(), block.nBits, consensusParams))
-    if (!CheckProofOfWork(block.GetPoWHash(), block.nBits, consensusParams))
+    // VELES BEGIN
+    //if (!CheckProofOfWork(block.GetPoWHash(), block.nBits, consensusParams))
+    block.hashPoW = (phashPoW && !phashPoW->IsNull()) ? *phashPoW : block.GetPoWHash();
+    if (!CheckProofOfWork(block.hashPoW, block.nBits, consensusParams))
+    // VELES END
     // FXTC END
         return error("ReadBlockFromDisk: Errors in block header at %s", pos.ToString());
 
+    // VELES BEGIN
+    // A copy of a block read into an arena would keep its transactions beyond the arena
+    if (!g_tx_arena)
+        g_block_read_cache.Insert(pos, std::make_shared<const CBlock>(block));
+    // VELES END
     return true;
 }
 
+// VELES BEGIN
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
+{
+    return ReadBlockFromDisk(block, pos, consensusParams, nullptr);
+}
+// VELES END
+
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
 {
     CDiskBlockPos blockPos;
+    // VELES BEGIN
+    // The PoW hash of the index is the one of the block read if their hashes match
+    uint256 hashPoW;
+    // VELES END
     {
         LOCK(cs_main);
         blockPos = pindex->GetBlockPos();
+        hashPoW = pindex->hashPoW; // VELES
     }
 
-    if (!ReadBlockFromDisk(block, blockPos, consensusParams))
+    //if (!ReadBlockFromDisk(block, blockPos, consensusParams))
+    if (!ReadBlockFromDisk(block, blockPos, consensusParams, &hashPoW)) // VELES
         return false;
     if (block.GetHash() != pindex->GetBlockHash())
         return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): GetHash() doesn't match index for %s at %s",
@@ -1158,6 +1265,14 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
+// VELES BEGIN
+bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams, CMonotonicArena& arena)
+{
+    CTxArenaScope scope(arena);
+    return ReadBlockFromDisk(block, pindex, consensusParams);
+}
+// VELES END
+
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start)
 {
     CDiskBlockPos hpos = pos;
@@ -1227,34 +1342,53 @@ double ConvertBitsToDouble(unsigned int nBits)
 // FXTC END
 
 // VELES BEGIN
-// Note that this method will return the correct results only if nStartVlock and nEndBlock are
-// within the same halving epoch.
-CAmount CountBlockRewards(int nStartBlock, int nEndBlock, HalvingParameters *halvingParams)
+CAmount GetChainSubsidy(const CBlockIndex* pindex)
 {
-    CBlockIndex *pb = chainActive.Tip();
-    CAmount nRewards = 0;
-
-    // use indexed value if exists
-    if (totalSupplyIndex.count(nStartBlock) && totalSupplyIndex[nStartBlock].count(nEndBlock))
-        return totalSupplyIndex[nStartBlock][nEndBlock];
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    std::vector<const CBlockIndex*> vMissing;
 
-    while (pb->pprev) {
-        pb = pb->pprev;
+    for (const CBlockIndex* pb = pindex; pb && pb->nChainSubsidy < 0; pb = pb->pprev)
+        vMissing.push_back(pb);
 
-        if (pb->nHeight >= nStartBlock && pb->nHeight <= nEndBlock) {
-            nRewards += GetBlockSubsidy(pb->nHeight, pb->GetBlockHeader(), Params().GetConsensus(), false, halvingParams);
+    // Oldest first, the halving parameters of a block only need the sums of its ancestors
+    for (auto it = vMissing.rbegin(); it != vMissing.rend(); ++it) {
+        const CBlockIndex* pb = *it;
+        CAmount nSubsidy = 0;
+        if (pb->nHeight > 0) {
+            nSubsidy = GetBlockSubsidy(pb->nHeight, pb->GetBlockHeader(), consensusParams, false);
         }
+        pb->nChainSubsidy = (pb->pprev ? pb->pprev->nChainSubsidy : 0) + nSubsidy;
     }
-    totalSupplyIndex[nStartBlock][nEndBlock] = nRewards;    // update the index
 
-    return nRewards;
+    return pindex->nChainSubsidy;
 }
 
-HalvingParameters *GetSubsidyHalvingParameters(int nHeight, const Consensus::Params& consensusParams)
+CAmount CountBlockRewards(int nStartBlock, int nEndBlock)
+{
+    // The active tip is not counted
+    nStartBlock = std::max(nStartBlock, 1);
+    nEndBlock = std::min(nEndBlock, chainActive.Height() - 1);
+    if (nEndBlock < nStartBlock)
+        return 0;
+
+    return GetChainSubsidy(chainActive[nEndBlock]) - GetChainSubsidy(chainActive[nStartBlock - 1]);
+}
+
+CAmount GetTotalSupply(int nHeight)
+{
+    if (nHeight <= 0 || nHeight > chainActive.Height())
+        nHeight = chainActive.Height();
+    if (nHeight < 0)
+        return 0;
+
+    return GetChainSubsidy(chainActive[nHeight]);
+}
+
+/** Build the halving schedule up to the epoch of nHeight from scratch */
+static std::shared_ptr<HalvingParameters> BuildSubsidyHalvingParameters(int nHeight, int nHeightOffset, const Consensus::Params& consensusParams)
 {
-    int nHeightOffset = (int)sporkManager.GetSporkValue(SPORK_VELES_04_REWARD_UPGRADE_ALPHA_START);
     int nCurrentEpoch = 0;
-    HalvingParameters *params = new HalvingParameters();
+    std::shared_ptr<HalvingParameters> params = std::make_shared<HalvingParameters>();
     CAmount nCurrentMaxSupply = 0;
     CAmount nCurrentHalvingRealSupply = 0;
     CAmount nCurrentEpochRealSupply = 0;
@@ -1286,7 +1420,7 @@ HalvingParameters *GetSubsidyHalvingParameters(int nHeight, const Consensus::Par
     }
     params->epochs[nCurrentEpoch].fHasEnded = true;
     params->epochs[nCurrentEpoch].nEndSupply = params->epochs[nCurrentEpoch].nStartSupply
-        + CountBlockRewards(params->epochs[nCurrentEpoch].nStartBlock, params->epochs[nCurrentEpoch].nEndBlock - 1, params);
+        + CountBlockRewards(params->epochs[nCurrentEpoch].nStartBlock, params->epochs[nCurrentEpoch].nEndBlock - 1);
     nCurrentEpoch++;
     // first VCIP01 epoch before first halving
     params->epochs.push_back (HalvingEpoch{});
@@ -1307,7 +1441,7 @@ HalvingParameters *GetSubsidyHalvingParameters(int nHeight, const Consensus::Par
         params->epochs[nCurrentEpoch - 1].fHasEnded = true;
         //params->epochs[nCurrentEpoch - 1].nEndSupply = GetTotalSupply(params->epochs[nCurrentEpoch - 1].nEndBlock);
         params->epochs[nCurrentEpoch - 1].nEndSupply = params->epochs[nCurrentEpoch - 1].nStartSupply
-            + CountBlockRewards(params->epochs[nCurrentEpoch - 1].nStartBlock, params->epochs[nCurrentEpoch - 1].nEndBlock - 1, params);
+            + CountBlockRewards(params->epochs[nCurrentEpoch - 1].nStartBlock, params->epochs[nCurrentEpoch - 1].nEndBlock - 1);
         // initialize new epoch struct
         //params->epochs[nCurrentEpoch] = HalvingEpoch;   //*(new HalvingEpoch());
         params->epochs.push_back (HalvingEpoch{});
@@ -1352,23 +1486,92 @@ HalvingParameters *GetSubsidyHalvingParameters(int nHeight, const Consensus::Par
     return params;
 }
 
-HalvingParameters *GetSubsidyHalvingParameters(int nHeight)
+namespace {
+/** A halving schedule shared by every height of its last epoch */
+struct HalvingSnapshot
+{
+    std::shared_ptr<const HalvingParameters> params;
+    //! Last active chain block whose subsidy the ended epochs count, null before the first one ended
+    uint256 hashLastCounted;
+};
+
+CCriticalSection cs_halvingSnapshots;
+//! Snapshots by the first block of their last epoch
+std::map<int, HalvingSnapshot> mapHalvingSnapshots GUARDED_BY(cs_halvingSnapshots);
+const Consensus::Params* pHalvingSnapshotsParams GUARDED_BY(cs_halvingSnapshots) = nullptr;
+int nHalvingSnapshotsOffset GUARDED_BY(cs_halvingSnapshots) = 0;
+
+/** Height of the last block counted by the ended epochs of params, or -1 */
+int GetLastCountedHeight(const HalvingParameters& params)
+{
+    for (auto it = params.epochs.rbegin(); it != params.epochs.rend(); ++it) {
+        // The premine epoch is a constant
+        if (it->fHasEnded && it->nStartBlock > 1)
+            return it->nEndBlock - 1;
+    }
+    return -1;
+}
+}
+
+std::shared_ptr<const HalvingParameters> GetSubsidyHalvingParameters(int nHeight, const Consensus::Params& consensusParams)
+{
+    const int nHeightOffset = (int)sporkManager.GetSporkValue(SPORK_VELES_04_REWARD_UPGRADE_ALPHA_START);
+
+    {
+        LOCK(cs_halvingSnapshots);
+        if (pHalvingSnapshotsParams != &consensusParams || nHalvingSnapshotsOffset != nHeightOffset) {
+            mapHalvingSnapshots.clear();
+            pHalvingSnapshotsParams = &consensusParams;
+            nHalvingSnapshotsOffset = nHeightOffset;
+        }
+
+        auto it = mapHalvingSnapshots.upper_bound(nHeight);
+        if (it != mapHalvingSnapshots.begin()) {
+            --it;
+            const HalvingSnapshot& snapshot = it->second;
+            const int nLastCounted = GetLastCountedHeight(*snapshot.params);
+            if (nLastCounted >= 0 && (!chainActive[nLastCounted] || chainActive[nLastCounted]->GetBlockHash() != snapshot.hashLastCounted)) {
+                // Reorganized below an epoch boundary
+                mapHalvingSnapshots.erase(it);
+            } else if (nHeight <= snapshot.params->epochs.back().nEndBlock) {
+                return snapshot.params;
+            }
+        }
+    }
+
+    // Built without holding the lock, the epoch supplies ask for the schedules of earlier heights
+    std::shared_ptr<const HalvingParameters> params = BuildSubsidyHalvingParameters(nHeight, nHeightOffset, consensusParams);
+
+    // Only cache schedules whose ended epochs are fully connected, the active tip is never counted
+    const int nLastCounted = GetLastCountedHeight(*params);
+    if (nLastCounted < chainActive.Height()) {
+        LOCK(cs_halvingSnapshots);
+        if (pHalvingSnapshotsParams == &consensusParams && nHalvingSnapshotsOffset == nHeightOffset)
+            mapHalvingSnapshots[params->epochs.back().nStartBlock] = HalvingSnapshot{params, nLastCounted < 0 ? uint256() : chainActive[nLastCounted]->GetBlockHash()};
+    }
+
+    return params;
+}
+
+std::shared_ptr<const HalvingParameters> GetSubsidyHalvingParameters(int nHeight)
 {
     return GetSubsidyHalvingParameters(nHeight, Params().GetConsensus());
 }
 
-HalvingParameters *GetSubsidyHalvingParameters()
+std::shared_ptr<const HalvingParameters> GetSubsidyHalvingParameters()
 {
     return GetSubsidyHalvingParameters((int)chainActive.Height());
 }
 
-double GetAlgoCostFactor(int32_t nAlgo, int nHeight)
+static const int ALGO_COST_FACTOR_NIST_BUMP_HEIGHT = 51000;
+
+static double ComputeAlgoCostFactor(int32_t nAlgo, int nHeight)
 {
     double factor = 100;
     CAmount totalAdjustements = 0;
     // Nist5 bootstraping and reward discovery
     int nNistAlphaBumpUpFactor = 10;
-    int nNistAlphaBumpUpHeight = 51000;
+    int nNistAlphaBumpUpHeight = ALGO_COST_FACTOR_NIST_BUMP_HEIGHT;
 
     // We have a possibility to perform 2 more cost factor adjustements, taking
     // advantage of spork protocol.
@@ -1473,6 +1676,83 @@ double GetAlgoCostFactor(int32_t nAlgo, int nHeight)
     return factor / (totalAdjustements / 6);
 }
 
+namespace {
+const int ALGO_COST_FACTOR_SLOTS = 6;
+
+/** Cost factors of every algo over the heights from nStartHeight up to the next interval */
+struct AlgoCostFactorInterval
+{
+    int64_t nStartHeight;
+    double vFactor[ALGO_COST_FACTOR_SLOTS];
+};
+
+CCriticalSection cs_algoCostFactors;
+//! Intervals by ascending start height, the first one starts at height 0
+std::vector<AlgoCostFactorInterval> vAlgoCostFactors GUARDED_BY(cs_algoCostFactors);
+//! Spork update count the intervals were built for
+uint64_t nAlgoCostFactorsSporkUpdates GUARDED_BY(cs_algoCostFactors) = std::numeric_limits<uint64_t>::max();
+
+// Slot of nAlgo in vFactor, -1 for the algos without a table entry
+int GetAlgoCostFactorSlot(int32_t nAlgo)
+{
+    if ((nAlgo & ~ALGO_VERSION_MASK) != 0 || (nAlgo >> 8) >= ALGO_COST_FACTOR_SLOTS)
+        return -1;
+    return nAlgo >> 8;
+}
+
+/** Rebuild the intervals after the sporks have changed, the factors only change at the activation heights */
+void UpdateAlgoCostFactors() EXCLUSIVE_LOCKS_REQUIRED(cs_algoCostFactors)
+{
+    const uint64_t nSporkUpdates = sporkManager.GetUpdateCount();
+    if (nSporkUpdates == nAlgoCostFactorsSporkUpdates)
+        return;
+
+    std::vector<int64_t> vBoundaries = {0, ALGO_COST_FACTOR_NIST_BUMP_HEIGHT,
+        sporkManager.GetSporkValue(SPORK_VELES_05A_ADJUST_COST_FACTOR_START),
+        sporkManager.GetSporkValue(SPORK_VELES_05B_ADJUST_COST_FACTOR_START)};
+    std::sort(vBoundaries.begin(), vBoundaries.end());
+
+    vAlgoCostFactors.clear();
+    for (int64_t nBoundary : vBoundaries) {
+        if (nBoundary < 0 || nBoundary > std::numeric_limits<int>::max() || (!vAlgoCostFactors.empty() && vAlgoCostFactors.back().nStartHeight == nBoundary))
+            continue;
+        AlgoCostFactorInterval interval;
+        interval.nStartHeight = nBoundary;
+        for (int i = 0; i < ALGO_COST_FACTOR_SLOTS; i++)
+            interval.vFactor[i] = ComputeAlgoCostFactor(i << 8, (int)nBoundary);
+        vAlgoCostFactors.push_back(interval);
+    }
+    nAlgoCostFactorsSporkUpdates = nSporkUpdates;
+}
+
+const AlgoCostFactorInterval& FindAlgoCostFactorInterval(int nHeight) EXCLUSIVE_LOCKS_REQUIRED(cs_algoCostFactors)
+{
+    auto it = std::upper_bound(vAlgoCostFactors.begin(), vAlgoCostFactors.end(), nHeight,
+        [](int nHeight, const AlgoCostFactorInterval& interval) { return nHeight < interval.nStartHeight; });
+    return *(it - 1);
+}
+}
+
+double GetAlgoCostFactor(int32_t nAlgo, int nHeight)
+{
+    const int nSlot = GetAlgoCostFactorSlot(nAlgo);
+    if (nSlot < 0 || nHeight < 0)
+        return ComputeAlgoCostFactor(nAlgo, nHeight);
+
+    LOCK(cs_algoCostFactors);
+    UpdateAlgoCostFactors();
+    return FindAlgoCostFactorInterval(nHeight).vFactor[nSlot];
+}
+
+void GetAlgoCostFactorRange(int nHeight, int64_t& nStartHeight, int64_t& nEndHeight)
+{
+    LOCK(cs_algoCostFactors);
+    UpdateAlgoCostFactors();
+    const AlgoCostFactorInterval& interval = FindAlgoCostFactorInterval(std::max(nHeight, 0));
+    nStartHeight = interval.nStartHeight;
+    nEndHeight = &interval == &vAlgoCostFactors.back() ? -1 : (&interval + 1)->nStartHeight;
+}
+
 double GetAlgoCostFactor(int32_t nAlgo)
 {
     return GetAlgoCostFactor(nAlgo, (int)chainActive.Height());
@@ -1484,13 +1764,16 @@ double GetBlockAlgoCostFactor(CBlockHeader *pblock, int nHeight)
     return GetAlgoCostFactor(pblock->nVersion & ALGO_VERSION_MASK, nHeight);
 }
 
-CAmount GetBlockSubsidy(int nHeight, CBlockHeader pblock, const Consensus::Params& consensusParams, bool fSuperblockPartOnly, HalvingParameters *halvingParams)
+CAmount GetBlockSubsidy(int nHeight, CBlockHeader pblock, const Consensus::Params& consensusParams, bool fSuperblockPartOnly, const HalvingParameters *halvingParams)
 {
     CAmount nSubsidy = 0;
 
     //HalvingParameters *halvingParams = GetSubsidyHalvingParameters(nHeight, consensusParams);
-    if (halvingParams == nullptr)
-        halvingParams = GetSubsidyHalvingParameters(nHeight, consensusParams);
+    std::shared_ptr<const HalvingParameters> halvingParamsShared;
+    if (halvingParams == nullptr) {
+        halvingParamsShared = GetSubsidyHalvingParameters(nHeight, consensusParams);
+        halvingParams = halvingParamsShared.get();
+    }
 
     // Force block reward to zero when right shift is undefined.
     if (halvingParams->nHalvingCount >= 64)
@@ -1819,6 +2102,55 @@ bool CScriptCheck::operator()() {
     return VerifyScript(scriptSig, m_tx_out.scriptPubKey, witness, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, m_tx_out.nValue, cacheStore, *txdata), &error);
 }
 
+// VELES BEGIN
+bool CScriptCheck::Collect(std::vector<CSignatureVerification>& vSigs) {
+    const CScript &scriptSig = ptxTo->vin[nIn].scriptSig;
+    const CScriptWitness *witness = &ptxTo->vin[nIn].scriptWitness;
+    return VerifyScript(scriptSig, m_tx_out.scriptPubKey, witness, nFlags, BatchingTransactionSignatureChecker(ptxTo, nIn, m_tx_out.nValue, cacheStore, *txdata, vSigs), &error);
+}
+
+bool CScriptCheck::Replay(const std::vector<CSignatureVerification>& vSigs, size_t nBegin, size_t nEnd, const std::vector<bool>& vResults) {
+    const CScript &scriptSig = ptxTo->vin[nIn].scriptSig;
+    const CScriptWitness *witness = &ptxTo->vin[nIn].scriptWitness;
+    return VerifyScript(scriptSig, m_tx_out.scriptPubKey, witness, nFlags, BatchingTransactionSignatureChecker(ptxTo, nIn, m_tx_out.nValue, cacheStore, *txdata, vSigs, nBegin, nEnd, vResults), &error);
+}
+
+bool RunChecks(std::vector<CScriptCheck>& vChecks)
+{
+    // Run every script with its signatures taken as valid and verify all of them at once
+    std::vector<CSignatureVerification> vSigs;
+    std::vector<size_t> vBegin;
+    std::vector<bool> vPassed;
+    vBegin.reserve(vChecks.size() + 1);
+    vPassed.reserve(vChecks.size());
+    for (CScriptCheck& check : vChecks) {
+        vBegin.push_back(vSigs.size());
+        vPassed.push_back(check.Collect(vSigs));
+    }
+    vBegin.push_back(vSigs.size());
+    std::vector<bool> vResults;
+    CPubKey::VerifyBatch(vSigs, vResults);
+
+    for (size_t i = 0; i < vChecks.size(); i++) {
+        bool fAllValid = true;
+        for (size_t j = vBegin[i]; j < vBegin[i + 1]; j++)
+            fAllValid &= vResults[j];
+        if (vPassed[i] && fAllValid) {
+            // The script ran the way it does with these signatures
+            if (vChecks[i].IsCacheStore()) {
+                for (size_t j = vBegin[i]; j < vBegin[i + 1]; j++)
+                    AddToSignatureCache(vSigs[j]);
+            }
+            continue;
+        }
+        // A signature is invalid or the script failed, which may depend on a signature being invalid
+        if (!vChecks[i].Replay(vSigs, vBegin[i], vBegin[i + 1], vResults))
+            return false;
+    }
+    return true;
+}
+// VELES END
+
 int GetSpendHeight(const CCoinsViewCache& inputs)
 {
     LOCK(cs_main);
@@ -1829,15 +2161,96 @@ int GetSpendHeight(const CCoinsViewCache& inputs)
 
 static CuckooCache::cache<uint256, SignatureCacheHasher> scriptExecutionCache;
 static uint256 scriptExecutionCacheNonce(GetRandHash());
+// VELES BEGIN
+static std::atomic<uint64_t> nScriptExecutionCacheHits(0);
+static std::atomic<uint64_t> nScriptExecutionCacheMisses(0);
+// VELES END
 
 void InitScriptExecutionCache() {
     // nMaxCacheSize is unsigned. If -maxsigcachesize is set to zero,
     // setup_bytes creates the minimum possible cache (2 elements).
-    size_t nMaxCacheSize = std::min(std::max((int64_t)0, gArgs.GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) / 2), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+    // VELES BEGIN
+    //size_t nMaxCacheSize = std::min(std::max((int64_t)0, gArgs.GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) / 2), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+    size_t nSigCacheSize, nMaxCacheSize;
+    GetValidationCacheSizes(nSigCacheSize, nMaxCacheSize);
     size_t nElems = scriptExecutionCache.setup_bytes(nMaxCacheSize);
-    LogPrintf("Using %zu MiB out of %zu/2 requested for script execution cache, able to store %zu elements\n",
-            (nElems*sizeof(uint256)) >>20, (nMaxCacheSize*2)>>20, nElems);
+    //LogPrintf("Using %zu MiB out of %zu/2 requested for script execution cache, able to store %zu elements\n",
+    //        (nElems*sizeof(uint256)) >>20, (nMaxCacheSize*2)>>20, nElems);
+    LogPrintf("Using %zu MiB out of %zu requested for script execution cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+    // VELES END
+}
+
+// VELES BEGIN
+ValidationCacheStats GetScriptExecutionCacheStats()
+{
+    LOCK(cs_main);
+    return {scriptExecutionCache.count(), scriptExecutionCache.capacity(), nScriptExecutionCacheHits, nScriptExecutionCacheMisses};
+}
+
+static const uint64_t VALIDATION_CACHES_DUMP_VERSION = 1;
+
+bool DumpValidationCaches()
+{
+    int64_t nStart = GetTimeMicros();
+    const fs::path path = GetDataDir() / VALIDATION_CACHES_FILENAME;
+    const fs::path path_new = GetDataDir() / (std::string(VALIDATION_CACHES_FILENAME) + ".new");
+    try {
+        CAutoFile file(fsbridge::fopen(path_new, "wb"), SER_DISK, CLIENT_VERSION);
+        if (file.IsNull()) {
+            return false;
+        }
+        file << VALIDATION_CACHES_DUMP_VERSION;
+        DumpSignatureCache(file);
+        {
+            LOCK(cs_main);
+            file << scriptExecutionCacheNonce << (uint64_t)scriptExecutionCache.count();
+            scriptExecutionCache.for_each([&file](const uint256& entry) { file << entry; });
+        }
+        if (!FileCommit(file.Get()))
+            throw std::runtime_error("FileCommit failed");
+        file.fclose();
+        RenameOver(path_new, path);
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to dump the validation caches: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+    LogPrintf("Dumped the validation caches: %gs\n", (GetTimeMicros() - nStart) * MICRO);
+    return true;
+}
+
+bool LoadValidationCaches()
+{
+    int64_t nStart = GetTimeMicros();
+    const fs::path path = GetDataDir() / VALIDATION_CACHES_FILENAME;
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        LogPrintf("Failed to open the validation caches from disk. Continuing anyway.\n");
+        return false;
+    }
+    try {
+        uint64_t version;
+        file >> version;
+        if (version != VALIDATION_CACHES_DUMP_VERSION) {
+            return false;
+        }
+        LoadSignatureCache(file);
+        LOCK(cs_main);
+        uint64_t nEntries;
+        file >> scriptExecutionCacheNonce >> nEntries;
+        for (uint64_t i = 0; i < nEntries; i++) {
+            uint256 entry;
+            file >> entry;
+            scriptExecutionCache.insert(entry);
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to deserialize the validation caches: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+    LogPrintf("Loaded the validation caches: %gs\n", (GetTimeMicros() - nStart) * MICRO);
+    return true;
 }
+// VELES END
 
 /**
  * Check whether all inputs of this transaction are valid (no double spends, scripts & sigs, amounts)
@@ -1882,8 +2295,10 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
             CSHA256().Write(scriptExecutionCacheNonce.begin(), 55 - sizeof(flags) - 32).Write(tx.GetWitnessHash().begin(), 32).Write((unsigned char*)&flags, sizeof(flags)).Finalize(hashCacheEntry.begin());
             AssertLockHeld(cs_main); //TODO: Remove this requirement by making CuckooCache not require external locks
             if (scriptExecutionCache.contains(hashCacheEntry, !cacheFullScriptStore)) {
+                ++nScriptExecutionCacheHits; // VELES
                 return true;
             }
+            ++nScriptExecutionCacheMisses; // VELES
 
             for (unsigned int i = 0; i < tx.vin.size(); i++) {
                 const COutPoint &prevout = tx.vin[i].prevout;
@@ -1965,7 +2380,12 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
     return true;
 }
 
-static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
+// VELES BEGIN
+} // namespace
+// VELES END
+
+//static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex) // VELES
 {
     CDiskBlockPos pos = pindex->GetUndoPos();
     if (pos.IsNull()) {
@@ -1996,6 +2416,10 @@ static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
     return true;
 }
 
+// VELES BEGIN
+namespace {
+// VELES END
+
 /** Abort with a message */
 static bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
 {
@@ -2158,13 +2582,127 @@ static bool WriteUndoDataForBlock(const CBlockUndo& blockundo, CValidationState&
     return true;
 }
 
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+// VELES BEGIN
+//static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+typedef CWorkStealingCheckQueue<CScriptCheck> ScriptCheckQueue;
+static ScriptCheckQueue scriptcheckqueue(128, MAX_SCRIPTCHECK_THREADS);
+static std::atomic<int> nScriptCheckThreadsStarted(0);
+// VELES END
 
 void ThreadScriptCheck() {
     RenameThread("veles-scriptch");
+    // VELES BEGIN
+    const int nThread = ++nScriptCheckThreadsStarted;
+    if (g_script_check_pinning == ScriptCheckPinning::CORES) {
+        // The first core is left to the thread adding the checks
+        PinThreadToCore(nThread);
+    }
+    // VELES END
     scriptcheckqueue.Thread();
 }
 
+// VELES BEGIN
+bool CPoWHashCheck::operator()() {
+    CBlockHeader::GetPoWHashes(vHeaders.data(), vHashPoW.data(), vHeaders.size());
+    return true;
+}
+
+/** Number of headers hashed together by one CPoWHashCheck */
+static const size_t POW_HASH_CHECK_HEADERS = 8;
+
+static CCheckQueue<CPoWHashCheck> powhashcheckqueue(16);
+
+void ThreadPoWHashCheck() {
+    RenameThread("veles-powhash");
+    powhashcheckqueue.Thread();
+}
+// VELES END
+
+// VELES BEGIN
+void PreVerifyMempoolScripts(CTxMemPool& pool, const std::vector<CTransactionRef>& vtx)
+{
+    if (!nScriptCheckThreads || vtx.empty())
+        return;
+
+    // The checks point into the precomputed data, which must not move
+    std::vector<PrecomputedTransactionData> vTxData;
+    vTxData.reserve(vtx.size());
+    std::vector<CScriptCheck> vChecks;
+    {
+        LOCK2(cs_main, pool.cs);
+        CCoinsViewMemPool viewMemPool(pcoinsTip.get(), pool);
+        CCoinsViewCache view(&viewMemPool);
+        // Inputs spent by an earlier transaction of the batch, a later one spending them is
+        // either a double spend or a replacement, left to AcceptToMemoryPool
+        std::set<COutPoint> setSpent;
+        std::vector<COutPoint> coins_to_uncache;
+
+        for (const CTransactionRef& ptx : vtx) {
+            const CTransaction& tx = *ptx;
+            // The checks AcceptToMemoryPool does before the scripts, as far as they are cheap,
+            // so transactions it rejects anyway cost no script verification here
+            CValidationState state;
+            std::string reason;
+            if (tx.IsCoinBase() || !CheckTransaction(tx, state) || (fRequireStandard && !IsStandardTx(tx, reason)) ||
+                pool.exists(tx.GetHash()))
+                continue;
+            bool fInputs = true;
+            std::vector<COutPoint> vFetched;
+            for (const CTxIn& txin : tx.vin) {
+                if (!pcoinsTip->HaveCoinInCache(txin.prevout))
+                    vFetched.push_back(txin.prevout);
+                if (!setSpent.insert(txin.prevout).second || pool.GetConflictTx(txin.prevout) || !view.HaveCoin(txin.prevout)) {
+                    fInputs = false;
+                    break;
+                }
+            }
+            CAmount nFees = 0;
+            bool fPassed = fInputs && Consensus::CheckTxInputs(tx, state, view, GetSpendHeight(view), nFees) &&
+                           (!fRequireStandard || AreInputsStandard(tx, view));
+            if (fPassed) {
+                CAmount nModifiedFees = nFees;
+                pool.ApplyDelta(tx.GetHash(), nModifiedFees);
+                fPassed = nModifiedFees >= ::minRelayTxFee.GetFee(GetVirtualTransactionSize(tx));
+            }
+            if (!fPassed) {
+                // Inputs of the transactions which get further are fetched by AcceptToMemoryPool anyway
+                coins_to_uncache.insert(coins_to_uncache.end(), vFetched.begin(), vFetched.end());
+                continue;
+            }
+
+            vTxData.emplace_back(tx);
+            CheckInputs(tx, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true, false, vTxData.back(), &vChecks);
+        }
+        for (const COutPoint& outpoint : coins_to_uncache)
+            pcoinsTip->Uncache(outpoint);
+    }
+
+    // Failures are found again by AcceptToMemoryPool, with the reason. A failed check makes the
+    // queue skip the remaining ones, the transactions after it are verified without cached signatures.
+    CCheckQueueControl<CScriptCheck, ScriptCheckQueue> control(&scriptcheckqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
+
+std::vector<bool> AcceptToMemoryPoolBatch(CTxMemPool& pool, const std::vector<CTransactionRef>& vtx,
+                                          std::vector<CValidationState>& states, std::vector<bool>& missing_inputs,
+                                          std::list<CTransactionRef>* plTxnReplaced, const CAmount nAbsurdFee)
+{
+    PreVerifyMempoolScripts(pool, vtx);
+
+    std::vector<bool> accepted(vtx.size(), false);
+    states.assign(vtx.size(), CValidationState());
+    missing_inputs.assign(vtx.size(), false);
+    LOCK(cs_main);
+    for (size_t i = 0; i < vtx.size(); i++) {
+        bool fMissingInputs = false;
+        accepted[i] = AcceptToMemoryPool(pool, states[i], vtx[i], &fMissingInputs, plTxnReplaced, false /* bypass_limits */, nAbsurdFee);
+        missing_inputs[i] = fMissingInputs;
+    }
+    return accepted;
+}
+// VELES END
+
 VersionBitsCache versionbitscache GUARDED_BY(cs_main);
 
 int32_t ComputeBlockVersion(const CBlockIndex* pindexPrev, const Consensus::Params& params, int32_t nPowAlgo) // VELES: Add parameter nPowAlgo
@@ -2294,12 +2832,67 @@ static int64_t nTimeIndex = 0;
 static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
 static int64_t nBlocksTotal = 0;
+static ConnectBlockTimings connectBlockTimings GUARDED_BY(cs_main); // VELES
+
+// VELES BEGIN
+ConnectBlockTimings GetConnectBlockTimings()
+{
+    AssertLockHeld(cs_main);
+    return connectBlockTimings;
+}
+
+static const char* const VALIDATION_PHASE_NAMES[] = {
+    "check", "forks", "connect_txs", "verify", "block_value", "masternode_payee", "superblock", "index", "callbacks",
+    "read_from_disk", "prefetch", "connect_total", "flush", "chainstate", "post_connect", "connect_block",
+    "queue_wait",
+    "instantsend_conflicts",
+    "tip_masternode_sync", "tip_mnodeman", "tip_privatesend", "tip_instantsend", "tip_mnpayments", "tip_governance",
+};
+static_assert(sizeof(VALIDATION_PHASE_NAMES) / sizeof(VALIDATION_PHASE_NAMES[0]) == (size_t)ValidationPhase::COUNT, "a validation phase has no name");
+
+static Mutex cs_validation_stats;
+static ValidationPhaseStats validationStats[(int)ValidationPhase::COUNT] GUARDED_BY(cs_validation_stats);
+
+void RecordValidationPhase(ValidationPhase phase, int64_t nMicros)
+{
+    nMicros = std::max<int64_t>(nMicros, 0);
+    int nBucket = 0;
+    while (nBucket < VALIDATION_STATS_BUCKETS - 1 && (int64_t{1} << nBucket) <= nMicros) ++nBucket;
+
+    LOCK(cs_validation_stats);
+    ValidationPhaseStats& stats = validationStats[(int)phase];
+    ++stats.count;
+    stats.total_micros += nMicros;
+    stats.max_micros = std::max(stats.max_micros, nMicros);
+    stats.last_micros = nMicros;
+    ++stats.histogram[nBucket];
+}
+
+std::vector<ValidationPhaseStats> GetValidationStats()
+{
+    LOCK(cs_validation_stats);
+    std::vector<ValidationPhaseStats> vStats(std::begin(validationStats), std::end(validationStats));
+    for (int i = 0; i < (int)ValidationPhase::COUNT; ++i) {
+        vStats[i].name = VALIDATION_PHASE_NAMES[i];
+    }
+    return vStats;
+}
+
+void ResetValidationStats()
+{
+    LOCK(cs_validation_stats);
+    for (ValidationPhaseStats& stats : validationStats) {
+        stats = ValidationPhaseStats();
+    }
+}
+// VELES END
 
 /** Apply the effects of this block (with given index) on the UTXO set represented by coins.
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
  *  can fail if those validity checks fail (among other reasons). */
 bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex,
-                  CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck)
+                  CCoinsViewCache& view, const CChainParams& chainparams, bool fJustCheck,
+                  const std::vector<bool>* pvScriptsChecked) // VELES: Added parameter pvScriptsChecked
 {
     AssertLockHeld(cs_main);
     assert(pindex);
@@ -2342,6 +2935,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     }
 
     nBlocksTotal++;
+    ConnectBlockTimings timings; // VELES
 
     bool fScriptChecks = true;
     if (!hashAssumeValid.IsNull()) {
@@ -2371,6 +2965,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
     int64_t nTime1 = GetTimeMicros(); nTimeCheck += nTime1 - nTimeStart;
     LogPrint(BCLog::BENCH, "    - Sanity checks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime1 - nTimeStart), nTimeCheck * MICRO, nTimeCheck * MILLI / nBlocksTotal);
+    if (!fJustCheck) RecordValidationPhase(ValidationPhase::CHECK, nTime1 - nTimeStart); // VELES
 
     // Do not allow blocks that contain transactions which 'overwrite' older transactions,
     // unless those are already completely spent.
@@ -2473,10 +3068,14 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
     int64_t nTime2 = GetTimeMicros(); nTimeForks += nTime2 - nTime1;
     LogPrint(BCLog::BENCH, "    - Fork checks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime2 - nTime1), nTimeForks * MICRO, nTimeForks * MILLI / nBlocksTotal);
+    if (!fJustCheck) RecordValidationPhase(ValidationPhase::FORKS, nTime2 - nTime1); // VELES
 
     CBlockUndo blockundo;
 
-    CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : nullptr);
+    // VELES BEGIN
+    //CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : nullptr);
+    CCheckQueueControl<CScriptCheck, ScriptCheckQueue> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : nullptr);
+    // VELES END
 
     std::vector<int> prevheights;
     CAmount nFees = 0;
@@ -2493,6 +3092,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
         if (!tx.IsCoinBase())
         {
+            int64_t nTimeCoinsStart = GetTimeMicros(); // VELES
             CAmount txfee = 0;
             if (!Consensus::CheckTxInputs(tx, state, view, pindex->nHeight, txfee)) {
                 return error("%s: Consensus::CheckTxInputs: %s, %s", __func__, tx.GetHash().ToString(), FormatStateMessage(state));
@@ -2510,6 +3110,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             for (size_t j = 0; j < tx.vin.size(); j++) {
                 prevheights[j] = view.AccessCoin(tx.vin[j].prevout).nHeight;
             }
+            timings.nCoinFetch += GetTimeMicros() - nTimeCoinsStart; // VELES
 
             if (!SequenceLocks(tx, nLockTimeFlags, &prevheights, *pindex)) {
                 return state.DoS(100, error("%s: contains a non-BIP68-final transaction", __func__),
@@ -2531,9 +3132,15 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         {
             std::vector<CScriptCheck> vChecks;
             bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
-            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, txdata[i], nScriptCheckThreads ? &vChecks : nullptr))
+            int64_t nTimeScriptsStart = GetTimeMicros(); // VELES
+            //if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, txdata[i], nScriptCheckThreads ? &vChecks : nullptr))
+            // VELES BEGIN
+            const bool fTxScriptChecks = fScriptChecks && !(pvScriptsChecked && (*pvScriptsChecked)[i]);
+            if (!CheckInputs(tx, state, view, fTxScriptChecks, flags, fCacheResults, fCacheResults, txdata[i], nScriptCheckThreads ? &vChecks : nullptr))
+            // VELES END
                 return error("ConnectBlock(): CheckInputs on %s failed with %s",
                     tx.GetHash().ToString(), FormatStateMessage(state));
+            timings.nScriptCheck += GetTimeMicros() - nTimeScriptsStart; // VELES
             control.Add(vChecks);
         }
 
@@ -2545,7 +3152,9 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     }
     int64_t nTime3 = GetTimeMicros(); nTimeConnect += nTime3 - nTime2;
     LogPrint(BCLog::BENCH, "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs (%.2fms/blk)]\n", (unsigned)block.vtx.size(), MILLI * (nTime3 - nTime2), MILLI * (nTime3 - nTime2) / block.vtx.size(), nInputs <= 1 ? 0 : MILLI * (nTime3 - nTime2) / (nInputs-1), nTimeConnect * MICRO, nTimeConnect * MILLI / nBlocksTotal);
+    if (!fJustCheck) RecordValidationPhase(ValidationPhase::CONNECT_TXS, nTime3 - nTime2); // VELES
 
+    int64_t nTimeSubsidyStart = GetTimeMicros(); // VELES
     // FXTC BEGIN
     //CAmount blockReward = nFees + GetBlockSubsidy(pindex->nHeight, chainparams.GetConsensus());
     CAmount blockReward = nFees + GetBlockSubsidy(pindex->nHeight, pindex->GetBlockHeader(), chainparams.GetConsensus());
@@ -2559,6 +3168,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
                          error("ConnectBlock(): coinbase pays too much (actual=%d vs limit=%d)",
                                block.vtx[0]->GetValueOut(), blockReward),
                                REJECT_INVALID, "bad-cb-amount");
+    timings.nSubsidy += GetTimeMicros() - nTimeSubsidyStart; // VELES
 /*
     // FXTC BEGIN
     CAmount founderReward = GetFounderReward(pindex->nHeight, block.vtx[0]->GetValueOut());
@@ -2594,21 +3204,34 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     // TODO: resync data (both ways?) and try to reprocess this block later.
     //CAmount blockReward = nFees + GetBlockSubsidy(pindex->nHeight, pindex->GetBlockHeader(), chainparams.GetConsensus());
     std::string strError = "";
+    int64_t nTimePaymentsStart = GetTimeMicros(); // VELES
     if (!sporkManager.IsSporkActive(SPORK_FXTC_02_IGNORE_MASTERNODE_REWARD_VALUE) && !IsBlockValueValid(block, pindex->nHeight, block.vtx[0]->GetValueOut(), strError)) {
         return state.DoS(0, error("ConnectBlock(DASH): %s", strError), REJECT_INVALID, "bad-cb-amount");
     }
+    int64_t nTimeValueChecked = GetTimeMicros(); // VELES
 
     if (!sporkManager.IsSporkActive(SPORK_FXTC_02_IGNORE_MASTERNODE_REWARD_PAYEE) && !IsBlockPayeeValid(block.vtx[0], pindex->nHeight, block.vtx[0]->GetValueOut(), pindex->GetBlockHeader())) {
         mapRejectedBlocks.insert(make_pair(block.GetHash(), GetTime()));
         return state.DoS(0, error("ConnectBlock(DASH): couldn't find masternode or superblock payments"),
                                 REJECT_INVALID, "bad-cb-payee");
     }
+    // VELES BEGIN
+    int64_t nTimePayeeChecked = GetTimeMicros();
+    timings.nPayments += nTimePayeeChecked - nTimePaymentsStart;
+    if (!fJustCheck) {
+        RecordValidationPhase(ValidationPhase::BLOCK_VALUE, nTimeValueChecked - nTimePaymentsStart);
+        RecordValidationPhase(ValidationPhase::MASTERNODE_PAYEE, nTimePayeeChecked - nTimeValueChecked);
+    }
+    // VELES END
     // END DASH
 
+    int64_t nTimeWaitStart = GetTimeMicros(); // VELES
     if (!control.Wait())
         return state.DoS(100, error("%s: CheckQueue failed", __func__), REJECT_INVALID, "block-validation-failed");
+    timings.nScriptCheck += GetTimeMicros() - nTimeWaitStart; // VELES
     int64_t nTime4 = GetTimeMicros(); nTimeVerify += nTime4 - nTime2;
     LogPrint(BCLog::BENCH, "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs (%.2fms/blk)]\n", nInputs - 1, MILLI * (nTime4 - nTime2), nInputs <= 1 ? 0 : MILLI * (nTime4 - nTime2) / (nInputs-1), nTimeVerify * MICRO, nTimeVerify * MILLI / nBlocksTotal);
+    if (!fJustCheck) RecordValidationPhase(ValidationPhase::VERIFY, nTime4 - nTime2); // VELES
 
     if (fJustCheck)
         return true;
@@ -2627,9 +3250,21 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
     int64_t nTime5 = GetTimeMicros(); nTimeIndex += nTime5 - nTime4;
     LogPrint(BCLog::BENCH, "    - Index writing: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime5 - nTime4), nTimeIndex * MICRO, nTimeIndex * MILLI / nBlocksTotal);
+    RecordValidationPhase(ValidationPhase::INDEX, nTime5 - nTime4); // VELES
 
     int64_t nTime6 = GetTimeMicros(); nTimeCallbacks += nTime6 - nTime5;
     LogPrint(BCLog::BENCH, "    - Callbacks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime6 - nTime5), nTimeCallbacks * MICRO, nTimeCallbacks * MILLI / nBlocksTotal);
+    RecordValidationPhase(ValidationPhase::CALLBACKS, nTime6 - nTime5); // VELES
+
+    // VELES BEGIN
+    // Blocks only checked for validity, as those of getblocktemplate, are left out
+    connectBlockTimings.nBlocks++;
+    connectBlockTimings.nCoinFetch += timings.nCoinFetch;
+    connectBlockTimings.nScriptCheck += timings.nScriptCheck;
+    connectBlockTimings.nSubsidy += timings.nSubsidy;
+    connectBlockTimings.nPayments += timings.nPayments;
+    connectBlockTimings.nTotal += nTime6 - nTimeStart;
+    // VELES END
 
     return true;
 }
@@ -2681,10 +3316,22 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
         int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
         int64_t cacheSize = pcoinsTip->DynamicMemoryUsage();
         int64_t nTotalSpace = nCoinCacheUsage + std::max<int64_t>(nMempoolSizeMax - nMempoolUsage, 0);
+        // VELES BEGIN
+        // With -dbcache=auto the coins cache grows during the initial block download. Once
+        // synced it is brought back down by the periodic flush between blocks, the larger
+        // budget stays the critical limit so a block is never held up for it.
+        int64_t nCriticalSpace = nTotalSpace;
+        if (nCoinCacheUsageIBD > nCoinCacheUsage) {
+            nCriticalSpace += nCoinCacheUsageIBD - nCoinCacheUsage;
+            if (IsInitialBlockDownload())
+                nTotalSpace = nCriticalSpace;
+        }
+        // VELES END
         // The cache is large and we're within 10% and 10 MiB of the limit, but we have time now (not in the middle of a block processing).
         bool fCacheLarge = mode == FlushStateMode::PERIODIC && cacheSize > std::max((9 * nTotalSpace) / 10, nTotalSpace - MAX_BLOCK_COINSDB_USAGE * 1024 * 1024);
         // The cache is over the limit, we have to write now.
-        bool fCacheCritical = mode == FlushStateMode::IF_NEEDED && cacheSize > nTotalSpace;
+        //bool fCacheCritical = mode == FlushStateMode::IF_NEEDED && cacheSize > nTotalSpace;
+        bool fCacheCritical = mode == FlushStateMode::IF_NEEDED && cacheSize > nCriticalSpace; // VELES
         // It's been a while since we wrote the block index to disk. Do this frequently, so we don't need to redownload after a crash.
         bool fPeriodicWrite = mode == FlushStateMode::PERIODIC && nNow > nLastWrite + (int64_t)DATABASE_WRITE_INTERVAL * 1000000;
         // It's been very long since we flushed the cache. Do this infrequently, to optimize cache usage.
@@ -2733,6 +3380,11 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             // Flush the chainstate (which may refer to block index entries).
             if (!pcoinsTip->Flush())
                 return AbortNode(state, "Failed to write to coin database");
+            // VELES BEGIN
+            // A background write may still be running, only stop for it when asked to flush everything
+            if (mode == FlushStateMode::ALWAYS && !pcoinsdbview->WaitForFlush())
+                return AbortNode(state, "Failed to write to coin database");
+            // VELES END
             nLastFlush = nNow;
             full_flush_completed = true;
         }
@@ -2849,6 +3501,11 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
 {
     CBlockIndex *pindexDelete = chainActive.Tip();
     assert(pindexDelete);
+    // VELES BEGIN
+    if (pindexDelete == g_snapshot_base) {
+        return state.Error(strprintf("%s: cannot disconnect the UTXO snapshot block %s", __func__, pindexDelete->GetBlockHash().ToString()));
+    }
+    // VELES END
     // Read block from disk.
     std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
     CBlock& block = *pblock;
@@ -2892,6 +3549,7 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
 }
 
 static int64_t nTimeReadFromDisk = 0;
+static int64_t nTimePrefetch = 0; // VELES
 static int64_t nTimeConnectTotal = 0;
 static int64_t nTimeFlush = 0;
 static int64_t nTimeChainState = 0;
@@ -2984,6 +3642,15 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
     LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * MILLI, nTimeReadFromDisk * MICRO);
+    RecordValidationPhase(ValidationPhase::READ_FROM_DISK, nTime2 - nTime1); // VELES
+    // VELES BEGIN
+    // Read the coins spent by the block in parallel, rather than one at a time from ConnectBlock
+    size_t nPrefetched = g_coins_prefetcher.Apply(blockConnecting, pcoinsdbview.get(), *pcoinsTip);
+    int64_t nTimePrefetched = GetTimeMicros(); nTimePrefetch += nTimePrefetched - nTime2;
+    LogPrint(BCLog::BENCH, "  - Prefetch %u coins: %.2fms [%.2fs]\n", nPrefetched, (nTimePrefetched - nTime2) * MILLI, nTimePrefetch * MICRO);
+    RecordValidationPhase(ValidationPhase::PREFETCH, nTimePrefetched - nTime2);
+    nTime2 = nTimePrefetched;
+    // VELES END
     {
         CCoinsViewCache view(pcoinsTip.get());
         bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams);
@@ -2995,16 +3662,19 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
         }
         nTime3 = GetTimeMicros(); nTimeConnectTotal += nTime3 - nTime2;
         LogPrint(BCLog::BENCH, "  - Connect total: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime3 - nTime2) * MILLI, nTimeConnectTotal * MICRO, nTimeConnectTotal * MILLI / nBlocksTotal);
+        RecordValidationPhase(ValidationPhase::CONNECT_TOTAL, nTime3 - nTime2); // VELES
         bool flushed = view.Flush();
         assert(flushed);
     }
     int64_t nTime4 = GetTimeMicros(); nTimeFlush += nTime4 - nTime3;
     LogPrint(BCLog::BENCH, "  - Flush: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime4 - nTime3) * MILLI, nTimeFlush * MICRO, nTimeFlush * MILLI / nBlocksTotal);
+    RecordValidationPhase(ValidationPhase::FLUSH, nTime4 - nTime3); // VELES
     // Write the chain state to disk, if necessary.
     if (!FlushStateToDisk(chainparams, state, FlushStateMode::IF_NEEDED))
         return false;
     int64_t nTime5 = GetTimeMicros(); nTimeChainState += nTime5 - nTime4;
     LogPrint(BCLog::BENCH, "  - Writing chainstate: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime5 - nTime4) * MILLI, nTimeChainState * MICRO, nTimeChainState * MILLI / nBlocksTotal);
+    RecordValidationPhase(ValidationPhase::CHAINSTATE, nTime5 - nTime4); // VELES
     // Remove conflicting transactions from the mempool.;
     mempool.removeForBlock(blockConnecting.vtx, pindexNew->nHeight);
     disconnectpool.removeForBlock(blockConnecting.vtx);
@@ -3015,6 +3685,10 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5; nTimeTotal += nTime6 - nTime1;
     LogPrint(BCLog::BENCH, "  - Connect postprocess: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime5) * MILLI, nTimePostConnect * MICRO, nTimePostConnect * MILLI / nBlocksTotal);
     LogPrint(BCLog::BENCH, "- Connect block: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime1) * MILLI, nTimeTotal * MICRO, nTimeTotal * MILLI / nBlocksTotal);
+    // VELES BEGIN
+    RecordValidationPhase(ValidationPhase::POST_CONNECT, nTime6 - nTime5);
+    RecordValidationPhase(ValidationPhase::CONNECT_BLOCK, nTime6 - nTime1);
+    // VELES END
 
     connectTrace.BlockConnected(pindexNew, std::move(pthisBlock));
     return true;
@@ -3123,6 +3797,13 @@ CBlockIndex* CChainState::FindMostWorkChain() {
             }
             pindexTest = pindexTest->pprev;
         }
+        // VELES BEGIN
+        // Blocks up to a UTXO snapshot can't be disconnected, so chains forking off below it are unusable
+        if (!fInvalidAncestor && g_snapshot_base && pindexTest && pindexTest->nHeight < g_snapshot_base->nHeight) {
+            setBlockIndexCandidates.erase(pindexNew);
+            fInvalidAncestor = true;
+        }
+        // VELES END
         if (!fInvalidAncestor)
             return pindexNew;
     } while(true);
@@ -3183,6 +3864,13 @@ bool CChainState::ActivateBestChainStep(CValidationState& state, const CChainPar
 
         // Connect new blocks.
         for (CBlockIndex *pindexConnect : reverse_iterate(vpindexToConnect)) {
+            // VELES BEGIN
+            // Read the coins of the next block while this one is validated
+            CBlockIndex* pindexNext = pindexMostWork->GetAncestor(pindexConnect->nHeight + 1);
+            if (pindexNext && (pindexNext->nStatus & BLOCK_HAVE_DATA)) {
+                g_coins_prefetcher.Schedule(pindexNext, pcoinsdbview.get());
+            }
+            // VELES END
             if (!ConnectTip(state, chainparams, pindexConnect, pindexConnect == pindexMostWork ? pblock : std::shared_ptr<const CBlock>(), connectTrace, disconnectpool)) {
                 if (state.IsInvalid()) {
                     // The block violates a consensus rule.
@@ -3251,9 +3939,18 @@ static void NotifyHeaderTip() LOCKS_EXCLUDED(cs_main) {
 static void LimitValidationInterfaceQueue() {
     AssertLockNotHeld(cs_main);
 
-    if (GetMainSignals().CallbacksPending() > 10) {
-        SyncWithValidationInterfaceQueue();
+    // VELES BEGIN
+    // if (GetMainSignals().CallbacksPending() > 10) {
+    //     SyncWithValidationInterfaceQueue();
+    // }
+    // Wait for the queue to drain to half the limit rather than to empty, so
+    // the subscribers keep busy while the next blocks are connected
+    if (GetMainSignals().CallbacksPending() > g_max_validation_queue) {
+        const int64_t nTimeStart = GetTimeMicros();
+        GetMainSignals().WaitForCallbacksPending(g_max_validation_queue / 2);
+        RecordValidationPhase(ValidationPhase::QUEUE_WAIT, GetTimeMicros() - nTimeStart);
     }
+    // VELES END
 }
 
 /**
@@ -3537,7 +4234,11 @@ CBlockIndex* CChainState::AddToBlockIndex(const CBlockHeader& block)
         return it->second;
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
+    // VELES BEGIN
+    //CBlockIndex* pindexNew = new CBlockIndex(block);
+    CBlockIndex* pindexNew = g_block_index_arena.Allocate();
+    *pindexNew = CBlockIndex(block);
+    // VELES END
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
@@ -3552,13 +4253,18 @@ CBlockIndex* CChainState::AddToBlockIndex(const CBlockHeader& block)
         pindexNew->BuildSkip();
     }
     pindexNew->nTimeMax = (pindexNew->pprev ? std::max(pindexNew->pprev->nTimeMax, pindexNew->nTime) : pindexNew->nTime);
-    pindexNew->nChainWork = (pindexNew->pprev ? pindexNew->pprev->nChainWork : 0) + GetBlockProof(*pindexNew);
+    // VELES BEGIN
+    //pindexNew->nChainWork = (pindexNew->pprev ? pindexNew->pprev->nChainWork : 0) + GetBlockProof(*pindexNew);
+    pindexNew->BuildPrevAlgo();
+    const arith_uint256 nBlockWork = GetBlockProof(*pindexNew);
+    pindexNew->nChainWork = (pindexNew->pprev ? pindexNew->pprev->nChainWork : 0) + nBlockWork;
+    // VELES END
     // FXTC BEGIN
-    int32_t nAlgo = pindexNew->nVersion & ALGO_VERSION_MASK;
-    CBlockIndex* pindexNewAlgo = pindexNew;
-    if (pindexNewAlgo->pprev) pindexNewAlgo = pindexNewAlgo->pprev;
-    while (pindexNewAlgo->pprev && nAlgo != (pindexNewAlgo->nVersion & ALGO_VERSION_MASK)) pindexNewAlgo = pindexNewAlgo->pprev;
-    pindexNew->nChainWorkAlgo = (pindexNewAlgo ? pindexNewAlgo->nChainWorkAlgo : 0) + GetBlockProof(*pindexNew);
+    // VELES BEGIN
+    // Without a predecessor of the same algo the work is counted on top of the genesis block
+    const CBlockIndex* pindexNewAlgo = pindexNew->pprevAlgo ? pindexNew->pprevAlgo : (pindexNew->pprev ? pindexNew->GetAncestor(0) : pindexNew);
+    pindexNew->nChainWorkAlgo = (pindexNewAlgo ? pindexNewAlgo->nChainWorkAlgo : 0) + nBlockWork;
+    // VELES END
     // FXTC END
     pindexNew->RaiseValidity(BLOCK_VALID_TREE);
     if (pindexBestHeader == nullptr || pindexBestHeader->nChainWork < pindexNew->nChainWork)
@@ -3704,19 +4410,28 @@ static bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos,
     return true;
 }
 
-static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true)
+// VELES: if phashPoW points to a non-null hash it is trusted as the PoW hash of block,
+// otherwise the computed PoW hash is returned through it
+static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, uint256* phashPoW = nullptr)
 {
     // Check proof of work matches claimed amount
     // FXTC BEGIN
     //if (fCheckPOW && !CheckProofOfWork(block.GetHash(), block.nBits, consensusParams))
-    if (fCheckPOW && !CheckProofOfWork(block.GetPoWHash(), block.nBits, consensusParams))
+    if (fCheckPOW) {
+        // VELES BEGIN
+        const uint256 hashPoW = (phashPoW && !phashPoW->IsNull()) ? *phashPoW : block.GetPoWHash();
+        if (phashPoW)
+            *phashPoW = hashPoW;
+        // VELES END
+        if (!CheckProofOfWork(hashPoW, block.nBits, consensusParams))
+            return state.DoS(50, false, REJECT_INVALID, "high-hash", false, "proof of work failed");
+    }
     // FXTC END
-        return state.DoS(50, false, REJECT_INVALID, "high-hash", false, "proof of work failed");
 
     return true;
 }
 
-bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, bool fCheckMerkleRoot)
+bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, bool fCheckMerkleRoot, const uint256* phashPoW)
 {
     // These are checks that are independent of context.
 
@@ -3725,8 +4440,17 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
 
     // Check that the header is valid (particularly PoW).  This is mostly
     // redundant with the call in AcceptBlockHeader.
-    if (!CheckBlockHeader(block, state, consensusParams, fCheckPOW))
+    // VELES BEGIN
+    //if (!CheckBlockHeader(block, state, consensusParams, fCheckPOW))
+    uint256 hashPoW = phashPoW ? *phashPoW : block.hashPoW;
+    if (!CheckBlockHeader(block, state, consensusParams, fCheckPOW, &hashPoW))
+    // VELES END
         return false;
+    // VELES BEGIN
+    // Remember the PoW hash for AcceptBlockHeader() and later checks of the block
+    if (fCheckPOW)
+        block.hashPoW = hashPoW;
+    // VELES END
 
     // Check the merkle root.
     if (fCheckMerkleRoot) {
@@ -3983,13 +4707,16 @@ static bool ContextualCheckBlock(const CBlock& block, CValidationState& state, c
     return true;
 }
 
-bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, const uint256* phashPoW)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
     uint256 hash = block.GetHash();
     BlockMap::iterator miSelf = mapBlockIndex.find(hash);
     CBlockIndex *pindex = nullptr;
+    // VELES BEGIN
+    uint256 hashPoW = phashPoW ? *phashPoW : uint256();
+    // VELES END
     if (hash != chainparams.GetConsensus().hashGenesisBlock) {
         if (miSelf != mapBlockIndex.end()) {
             // Block header is already known.
@@ -4001,7 +4728,10 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, chainparams.GetConsensus()))
+        // VELES BEGIN
+        //if (!CheckBlockHeader(block, state, chainparams.GetConsensus()))
+        if (!CheckBlockHeader(block, state, chainparams.GetConsensus(), true, &hashPoW))
+        // VELES END
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
 
         // Get prev block index
@@ -4060,6 +4790,12 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
     if (pindex == nullptr)
         pindex = AddToBlockIndex(block);
 
+    // VELES BEGIN
+    // Keep the PoW hash computed above so it gets persisted with the index
+    if (pindex->hashPoW.IsNull() && !hashPoW.IsNull())
+        pindex->hashPoW = hashPoW;
+    // VELES END
+
     if (ppindex)
         *ppindex = pindex;
 
@@ -4072,13 +4808,52 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex, CBlockHeader *first_invalid)
 {
     if (first_invalid != nullptr) first_invalid->SetNull();
-    {
-        LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
-            CBlockIndex *pindex = nullptr; // Use a temp pindex instead of ppindex to avoid a const_cast
-            if (!g_chainstate.AcceptBlockHeader(header, state, chainparams, &pindex)) {
-                if (first_invalid) *first_invalid = header;
-                return false;
+    // VELES BEGIN
+    // Hash the unknown headers of the batch in parallel before taking cs_main for
+    // the contextual checks, PoW hashing dominates the cost of accepting a header.
+    std::vector<uint256> vHashPoW(headers.size());
+    if (nScriptCheckThreads && headers.size() > 1) {
+        std::vector<bool> vKnown(headers.size());
+        {
+            LOCK(cs_main);
+            for (size_t i = 0; i < headers.size(); i++)
+                vKnown[i] = LookupBlockIndex(headers[i].GetHash()) != nullptr;
+        }
+        std::vector<CPoWHashCheck> vChecks;
+        std::vector<const CBlockHeader*> vHeaders;
+        std::vector<uint256*> vHashes;
+        for (size_t i = 0; i < headers.size(); i++) {
+            if (vKnown[i])
+                continue;
+            vHeaders.push_back(&headers[i]);
+            vHashes.push_back(&vHashPoW[i]);
+            if (vHeaders.size() == POW_HASH_CHECK_HEADERS) {
+                vChecks.emplace_back(std::move(vHeaders), std::move(vHashes));
+                vHeaders.clear();
+                vHashes.clear();
+            }
+        }
+        if (!vHeaders.empty())
+            vChecks.emplace_back(std::move(vHeaders), std::move(vHashes));
+        CCheckQueueControl<CPoWHashCheck> control(&powhashcheckqueue);
+        control.Add(vChecks);
+        control.Wait();
+    }
+    // VELES END
+    {
+        LOCK(cs_main);
+        // VELES BEGIN
+        //for (const CBlockHeader& header : headers) {
+        for (size_t i = 0; i < headers.size(); i++) {
+            const CBlockHeader& header = headers[i];
+        // VELES END
+            CBlockIndex *pindex = nullptr; // Use a temp pindex instead of ppindex to avoid a const_cast
+            // VELES BEGIN
+            //if (!g_chainstate.AcceptBlockHeader(header, state, chainparams, &pindex)) {
+            if (!g_chainstate.AcceptBlockHeader(header, state, chainparams, &pindex, &vHashPoW[i])) {
+            // VELES END
+                if (first_invalid) *first_invalid = header;
+                return false;
             }
             if (ppindex) {
                 *ppindex = pindex;
@@ -4109,7 +4884,7 @@ static CDiskBlockPos SaveBlockToDisk(const CBlock& block, int nHeight, const CCh
 }
 
 /** Store block on disk. If dbp is non-nullptr, the file is known to already reside on disk */
-bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock)
+bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock, const uint256* phashPoW)
 {
     const CBlock& block = *pblock;
 
@@ -4119,7 +4894,12 @@ bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CVali
     CBlockIndex *pindexDummy = nullptr;
     CBlockIndex *&pindex = ppindex ? *ppindex : pindexDummy;
 
-    if (!AcceptBlockHeader(block, state, chainparams, &pindex))
+    // VELES BEGIN
+    if (!phashPoW)
+        phashPoW = &block.hashPoW;
+    //if (!AcceptBlockHeader(block, state, chainparams, &pindex))
+    if (!AcceptBlockHeader(block, state, chainparams, &pindex, phashPoW))
+    // VELES END
         return false;
 
     // Try to process all requested blocks that we don't have, but only
@@ -4154,7 +4934,12 @@ bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CVali
         if (pindex->nChainWork < nMinimumChainWork) return true;
     }
 
-    if (!CheckBlock(block, state, chainparams.GetConsensus()) ||
+    // VELES BEGIN
+    // The header of the block is the one of pindex, its PoW hash is known by now
+    //if (!CheckBlock(block, state, chainparams.GetConsensus()) ||
+    const uint256 hashPoW = pindex->GetBlockPoWHash();
+    if (!CheckBlock(block, state, chainparams.GetConsensus(), true, true, &hashPoW) ||
+    // VELES END
         !ContextualCheckBlock(block, state, chainparams.GetConsensus(), pindex->pprev)) {
         if (state.IsInvalid() && !state.CorruptionPossible()) {
             pindex->nStatus |= BLOCK_FAILED_VALID;
@@ -4201,6 +4986,13 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
         // Therefore, the following critical section must include the CheckBlock() call as well.
         LOCK(cs_main);
 
+        // VELES BEGIN
+        // The PoW hash of a header received before the block was computed already
+        const CBlockIndex* pindexKnown = LookupBlockIndex(pblock->GetHash());
+        if (pindexKnown && pblock->hashPoW.IsNull())
+            pblock->hashPoW = pindexKnown->hashPoW;
+        // VELES END
+
         // Ensure that CheckBlock() passes before calling AcceptBlock, as
         // belt-and-suspenders.
         bool ret = CheckBlock(*pblock, state, chainparams.GetConsensus());
@@ -4248,6 +5040,46 @@ bool TestBlockValidity(CValidationState& state, const CChainParams& chainparams,
     return true;
 }
 
+// VELES BEGIN
+bool TestBlockTemplateValidity(CValidationState& state, const CChainParams& chainparams, const CBlock& block, CBlockIndex* pindexPrev, bool fCheckMerkleRoot)
+{
+    AssertLockHeld(cs_main);
+    assert(pindexPrev && pindexPrev == chainActive.Tip());
+
+    // The mempool verified the scripts of its transactions with the standard flags, which include
+    // those of every consensus rule, the same transaction with the same witness passes them again
+    std::vector<bool> vScriptsChecked(block.vtx.size(), false);
+    {
+        LOCK(mempool.cs);
+        for (size_t i = 1; i < block.vtx.size(); i++) {
+            CTxMemPool::txiter it = mempool.mapTx.find(block.vtx[i]->GetHash());
+            vScriptsChecked[i] = it != mempool.mapTx.end() && it->GetTx().GetWitnessHash() == block.vtx[i]->GetWitnessHash();
+        }
+    }
+
+    CCoinsViewCache viewNew(pcoinsTip.get());
+    uint256 block_hash(block.GetHash());
+    CBlockIndex indexDummy(block);
+    indexDummy.pprev = pindexPrev;
+    indexDummy.nHeight = pindexPrev->nHeight + 1;
+    indexDummy.phashBlock = &block_hash;
+
+    // NOTE: CheckBlock is called by ConnectBlock
+    if (!ContextualCheckBlockHeader(block, state, chainparams, pindexPrev, GetAdjustedTime()))
+        return error("%s: Consensus::ContextualCheckBlockHeader: %s", __func__, FormatStateMessage(state));
+    if (!CheckBlock(block, state, chainparams.GetConsensus(), false, fCheckMerkleRoot))
+        return error("%s: Consensus::CheckBlock: %s", __func__, FormatStateMessage(state));
+    if (!ContextualCheckBlock(block, state, chainparams.GetConsensus(), pindexPrev))
+        return error("%s: Consensus::ContextualCheckBlock: %s", __func__, FormatStateMessage(state));
+    // The inputs, fees, sequence locks and sigops of every transaction, the coinbase and its payees
+    if (!g_chainstate.ConnectBlock(block, state, &indexDummy, viewNew, chainparams, true, &vScriptsChecked))
+        return false;
+    assert(state.IsValid());
+
+    return true;
+}
+// VELES END
+
 /**
  * BLOCK PRUNING CODE
  */
@@ -4303,6 +5135,7 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
 {
     for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        g_block_read_cache.EraseFile(*it); // VELES
         fs::remove(GetBlockPosFilename(pos, "blk"));
         fs::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -4473,7 +5306,8 @@ CBlockIndex * CChainState::InsertBlockIndex(const uint256& hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
+    //CBlockIndex* pindexNew = new CBlockIndex();
+    CBlockIndex* pindexNew = g_block_index_arena.Allocate(); // VELES
     mi = mapBlockIndex.insert(std::make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
@@ -4482,34 +5316,99 @@ CBlockIndex * CChainState::InsertBlockIndex(const uint256& hash)
 
 bool CChainState::LoadBlockIndex(const Consensus::Params& consensus_params, CBlockTreeDB& blocktree)
 {
-    if (!blocktree.LoadBlockIndexGuts(consensus_params, [this](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return this->InsertBlockIndex(hash); }))
+    // VELES BEGIN
+    //if (!blocktree.LoadBlockIndexGuts(consensus_params, [this](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return this->InsertBlockIndex(hash); }))
+    //    return false;
+    const int nThreads = std::max(1, std::min((int)gArgs.GetArg("-importthreads", DEFAULT_IMPORT_THREADS), MAX_IMPORT_THREADS));
+    std::vector<CDiskBlockIndex> vIndex;
+    std::vector<uint256> vHash;
+    if (!blocktree.LoadBlockIndexGuts(consensus_params, vIndex, vHash, nThreads))
         return false;
 
+    mapBlockIndex.reserve(mapBlockIndex.size() + vIndex.size());
+    // The entries are copied next to each other, without the hash of their predecessor
+    CBlockIndex* pindexLoaded = g_block_index_arena.AllocateBatch(vIndex.size());
+    std::vector<CBlockIndex*> vInserted(vIndex.size());
+    for (size_t i = 0; i < vIndex.size(); i++) {
+        std::pair<BlockMap::iterator, bool> ret = mapBlockIndex.emplace(vHash[i], &pindexLoaded[i]);
+        // Already in the index or not, fill in the entry of the index
+        CBlockIndex* pindex = ret.first->second;
+        *pindex = vIndex[i];
+        pindex->phashBlock = &ret.first->first;
+        vInserted[i] = pindex;
+    }
+    // Only link the predecessors once every entry is in the index, entries
+    // with an unknown predecessor get an empty one as before
+    for (size_t i = 0; i < vIndex.size(); i++) {
+        vInserted[i]->pprev = InsertBlockIndex(vIndex[i].hashPrev);
+    }
+    // The loaded entries come with their work computed in parallel
+    std::less<const CBlockIndex*> less;
+    auto blockWork = [&](const CBlockIndex* pindex) {
+        if (!less(pindex, pindexLoaded) && less(pindex, pindexLoaded + vIndex.size()))
+            return vIndex[pindex - pindexLoaded].nBlockWork;
+        return GetBlockProof(*pindex);
+    };
+    // VELES END
+
     // Calculate nChainWork
     std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight;
     vSortedByHeight.reserve(mapBlockIndex.size());
+    // VELES BEGIN
+    /*
     for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex)
     {
         CBlockIndex* pindex = item.second;
         vSortedByHeight.push_back(std::make_pair(pindex->nHeight, pindex));
     }
     sort(vSortedByHeight.begin(), vSortedByHeight.end());
+    */
+    // Counting sort by height, the heights of a valid index are below its size
+    int nMaxHeight = 0;
+    for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex)
+        nMaxHeight = std::max(nMaxHeight, item.second->nHeight);
+    if ((size_t)nMaxHeight < mapBlockIndex.size()) {
+        std::vector<size_t> vHeightStart(nMaxHeight + 2, 0);
+        for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex)
+            vHeightStart[item.second->nHeight + 1]++;
+        for (int nHeight = 1; nHeight <= nMaxHeight + 1; nHeight++)
+            vHeightStart[nHeight] += vHeightStart[nHeight - 1];
+        vSortedByHeight.resize(mapBlockIndex.size());
+        for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex) {
+            CBlockIndex* pindex = item.second;
+            vSortedByHeight[vHeightStart[pindex->nHeight]++] = std::make_pair(pindex->nHeight, pindex);
+        }
+    } else {
+        for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex)
+            vSortedByHeight.push_back(std::make_pair(item.second->nHeight, item.second));
+        std::sort(vSortedByHeight.begin(), vSortedByHeight.end());
+    }
+    // VELES END
     for (const std::pair<int, CBlockIndex*>& item : vSortedByHeight)
     {
         CBlockIndex* pindex = item.second;
-        pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
+        // VELES BEGIN
+        //pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
+        pindex->BuildPrevAlgo();
+        const arith_uint256 nBlockWork = blockWork(pindex);
+        pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + nBlockWork;
+        // VELES END
         // FXTC BEGIN
-        int32_t nAlgo = pindex->nVersion & ALGO_VERSION_MASK;
-        CBlockIndex* pindexAlgo = pindex;
-        if (pindexAlgo->pprev) pindexAlgo = pindexAlgo->pprev;
-        while (pindexAlgo->pprev && nAlgo != (pindexAlgo->nVersion & ALGO_VERSION_MASK)) pindexAlgo = pindexAlgo->pprev;
-        pindex->nChainWorkAlgo = (pindexAlgo ? pindexAlgo->nChainWorkAlgo : 0) + GetBlockProof(*pindex);
+        // VELES BEGIN
+        const CBlockIndex* pindexAlgo = pindex->pprevAlgo ? pindex->pprevAlgo : (pindex->pprev ? pindex->GetAncestor(0) : pindex);
+        pindex->nChainWorkAlgo = (pindexAlgo ? pindexAlgo->nChainWorkAlgo : 0) + nBlockWork;
+        // VELES END
         // FXTC END
         pindex->nTimeMax = (pindex->pprev ? std::max(pindex->pprev->nTimeMax, pindex->nTime) : pindex->nTime);
         // We can link the chain of blocks for which we've received transactions at some point.
         // Pruned nodes may have deleted the block.
         if (pindex->nTx > 0) {
-            if (pindex->pprev) {
+            // VELES BEGIN
+            if (pindex->nStatus & BLOCK_SNAPSHOT) {
+                pindex->nChainTx = pindex->nTx;
+                g_snapshot_base = pindex;
+            } else if (pindex->pprev) {
+            // VELES END
                 if (pindex->pprev->HaveTxsDownloaded()) {
                     pindex->nChainTx = pindex->pprev->nChainTx + pindex->nTx;
                 } else {
@@ -4534,6 +5433,25 @@ bool CChainState::LoadBlockIndex(const Consensus::Params& consensus_params, CBlo
             pindexBestHeader = pindex;
     }
 
+    // VELES BEGIN
+    // PoW hashes read from disk are trusted, optionally re-verify the most recent headers
+    int nCheckPoWDepth = gArgs.GetArg("-checkpowonload", DEFAULT_CHECKPOWONLOAD);
+    if (nCheckPoWDepth != 0 && !vSortedByHeight.empty()) {
+        const int nMinHeight = nCheckPoWDepth < 0 ? 0 : vSortedByHeight.back().first - nCheckPoWDepth + 1;
+        int nChecked = 0;
+        for (auto it = vSortedByHeight.rbegin(); it != vSortedByHeight.rend() && it->first >= nMinHeight; ++it) {
+            const CBlockIndex* pindex = it->second;
+            if (pindex->nHeight <= consensus_params.nlastValidPowHashHeight)
+                break;
+            const uint256 hashPoW = pindex->GetBlockHeader().GetPoWHash();
+            if (hashPoW != pindex->GetBlockPoWHash() || !CheckProofOfWork(hashPoW, pindex->nBits, consensus_params))
+                return error("%s: stored PoW hash is invalid: %s", __func__, pindex->ToString());
+            nChecked++;
+        }
+        LogPrintf("%s: re-verified PoW of %d block headers\n", __func__, nChecked);
+    }
+    // VELES END
+
     return true;
 }
 
@@ -4667,6 +5585,13 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
             LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
             break;
         }
+        // VELES BEGIN
+        if (pindex == g_snapshot_base) {
+            // Blocks up to a UTXO snapshot have no undo data
+            LogPrintf("VerifyDB(): block verification stopping at height %d (UTXO snapshot)\n", pindex->nHeight);
+            break;
+        }
+        // VELES END
         CBlock block;
         // check level 0: read from disk
         if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
@@ -4733,6 +5658,199 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
     return true;
 }
 
+// VELES BEGIN
+static Mutex g_background_verify_mutex;
+static BackgroundVerifyStatus g_background_verify_status GUARDED_BY(g_background_verify_mutex);
+
+BackgroundVerifyStatus GetBackgroundVerifyStatus()
+{
+    LOCK(g_background_verify_mutex);
+    return g_background_verify_status;
+}
+
+std::string BackgroundVerifyStateToString(BackgroundVerifyStatus::State state)
+{
+    switch (state) {
+    case BackgroundVerifyStatus::NOT_STARTED: return "not_started";
+    case BackgroundVerifyStatus::WAITING: return "waiting";
+    case BackgroundVerifyStatus::RUNNING: return "running";
+    case BackgroundVerifyStatus::DONE: return "done";
+    case BackgroundVerifyStatus::FAILED: return "failed";
+    }
+    assert(false);
+}
+
+static void SetBackgroundVerifyProgress(BackgroundVerifyStatus::State state, int nProgress)
+{
+    LOCK(g_background_verify_mutex);
+    g_background_verify_status.state = state;
+    if (nProgress / 10 != g_background_verify_status.nProgress / 10)
+        LogPrintf("Background block verification: %d%%\n", nProgress);
+    g_background_verify_status.nProgress = nProgress;
+}
+
+static bool BackgroundVerifyFailed(const std::string& strError)
+{
+    {
+        LOCK(g_background_verify_mutex);
+        g_background_verify_status.state = BackgroundVerifyStatus::FAILED;
+        g_background_verify_status.strError = strError;
+    }
+    const std::string strWarning = _("Corrupted block database detected by the background verification, restart with -reindex or -reindex-chainstate to recover.");
+    SetMiscWarning(strWarning);
+    uiInterface.ThreadSafeMessageBox(strWarning, "", CClientUIInterface::MSG_ERROR);
+    return error("VerifyDBBackground(): %s", strError);
+}
+
+/** Sleep long enough for nBytes read to stay below nBytesPerSecond */
+static void ThrottleBackgroundVerify(size_t nBytes, int64_t nBytesPerSecond)
+{
+    if (nBytesPerSecond > 0)
+        MilliSleep(nBytes * 1000 / nBytesPerSecond);
+}
+
+bool CVerifyDB::VerifyDBBackground(const CChainParams& chainparams, int nCheckLevel, int nCheckDepth, int64_t nBytesPerSecond)
+{
+    const Consensus::Params& consensus = chainparams.GetConsensus();
+    nCheckLevel = std::max(0, std::min(4, nCheckLevel));
+    {
+        LOCK(g_background_verify_mutex);
+        g_background_verify_status = BackgroundVerifyStatus();
+        g_background_verify_status.state = BackgroundVerifyStatus::WAITING;
+        g_background_verify_status.nCheckLevel = nCheckLevel;
+    }
+
+    // A chain still syncing would move the tip under every run
+    while (IsInitialBlockDownload())
+        MilliSleep(1000);
+
+    while (true) {
+        CBlockIndex* pindexTip;
+        std::unique_ptr<CCoinsViewCache> pcoins;
+        int nDepth;
+        {
+            LOCK(cs_main);
+            pindexTip = chainActive.Tip();
+            if (pindexTip == nullptr || pindexTip->pprev == nullptr) {
+                SetBackgroundVerifyProgress(BackgroundVerifyStatus::DONE, 100);
+                return true;
+            }
+            nDepth = (nCheckDepth <= 0 || nCheckDepth > chainActive.Height()) ? chainActive.Height() : nCheckDepth;
+            pcoins.reset(new CCoinsViewCache(pcoinsTip.get()));
+        }
+        {
+            LOCK(g_background_verify_mutex);
+            g_background_verify_status.nCheckDepth = nDepth;
+        }
+        SetBackgroundVerifyProgress(BackgroundVerifyStatus::RUNNING, 0);
+        LogPrintf("Verifying last %i blocks at level %i in the background\n", nDepth, nCheckLevel);
+
+        // Levels 0 to 3 walk back from the tip, pindexCoins is the block the coins are at
+        bool fTipMoved = false;
+        CBlockIndex* pindexCoins = pindexTip;
+        CBlockIndex* pindexFailure = nullptr;
+        int nGoodTransactions = 0;
+        int nBlocks = 0;
+        for (CBlockIndex* pindex = pindexTip; pindex->pprev && pindex->nHeight > pindexTip->nHeight - nDepth; pindex = pindex->pprev) {
+            boost::this_thread::interruption_point();
+            SetBackgroundVerifyProgress(BackgroundVerifyStatus::RUNNING, nBlocks * (nCheckLevel >= 4 ? 50 : 100) / nDepth);
+            {
+                LOCK(cs_main);
+                if (fPruneMode && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
+                    LogPrintf("VerifyDBBackground(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
+                    break;
+                }
+                if (pindex == g_snapshot_base) {
+                    LogPrintf("VerifyDBBackground(): block verification stopping at height %d (UTXO snapshot)\n", pindex->nHeight);
+                    break;
+                }
+            }
+            CBlock block;
+            // check level 0: read from disk
+            if (!ReadBlockFromDisk(block, pindex, consensus))
+                return BackgroundVerifyFailed(strprintf("ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString()));
+            // check level 1: verify block validity
+            CValidationState state;
+            if (nCheckLevel >= 1 && !CheckBlock(block, state, consensus))
+                return BackgroundVerifyFailed(strprintf("found bad block at %d, hash=%s (%s)", pindex->nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(state)));
+            // check level 2: verify undo validity
+            if (nCheckLevel == 2) {
+                CBlockUndo undo;
+                if (!pindex->GetUndoPos().IsNull() && !UndoReadFromDisk(undo, pindex))
+                    return BackgroundVerifyFailed(strprintf("found bad undo data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString()));
+            }
+            // check level 3: check for inconsistencies during memory-only disconnect of tip blocks,
+            // which reads the undo data as well
+            if (nCheckLevel >= 3 && pindexCoins == pindex) {
+                LOCK(cs_main);
+                if (chainActive.Tip() != pindexTip) {
+                    fTipMoved = true;
+                    break;
+                }
+                if (pcoins->DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage() <= nCoinCacheUsage) {
+                    assert(pcoins->GetBestBlock() == pindex->GetBlockHash());
+                    DisconnectResult res = g_chainstate.DisconnectBlock(block, pindex, *pcoins);
+                    if (res == DISCONNECT_FAILED)
+                        return BackgroundVerifyFailed(strprintf("irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString()));
+                    if (res == DISCONNECT_UNCLEAN) {
+                        nGoodTransactions = 0;
+                        pindexFailure = pindex;
+                    } else {
+                        nGoodTransactions += block.vtx.size();
+                    }
+                    pindexCoins = pindex->pprev;
+                }
+            }
+            nBlocks++;
+            ThrottleBackgroundVerify(::GetSerializeSize(block, PROTOCOL_VERSION), nBytesPerSecond);
+        }
+        if (pindexFailure)
+            return BackgroundVerifyFailed(strprintf("coin database inconsistencies found (last %i blocks, %i good transactions before that)", pindexTip->nHeight - pindexFailure->nHeight + 1, nGoodTransactions));
+
+        // check level 4: try reconnecting blocks
+        const int nHeightCoins = pindexCoins->nHeight;
+        while (!fTipMoved && nCheckLevel >= 4 && pindexCoins != pindexTip) {
+            boost::this_thread::interruption_point();
+            SetBackgroundVerifyProgress(BackgroundVerifyStatus::RUNNING, 50 + (pindexCoins->nHeight - nHeightCoins) * 50 / (pindexTip->nHeight - nHeightCoins));
+            CBlockIndex* pindex = pindexTip->GetAncestor(pindexCoins->nHeight + 1);
+            CBlock block;
+            if (!ReadBlockFromDisk(block, pindex, consensus))
+                return BackgroundVerifyFailed(strprintf("ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString()));
+            {
+                LOCK(cs_main);
+                if (chainActive.Tip() != pindexTip) {
+                    fTipMoved = true;
+                    break;
+                }
+                // Only checked, the block is already connected and its undo data written
+                CValidationState state;
+                if (!g_chainstate.ConnectBlock(block, state, pindex, *pcoins, chainparams, true)) {
+                    // The masternode payments depend on the current masternode list
+                    if (state.GetRejectReason() == "bad-cb-payee" || state.GetRejectReason() == "bad-cb-amount") {
+                        LogPrintf("VerifyDBBackground(): block reconnection stopping at height %d (%s)\n", pindex->nHeight, FormatStateMessage(state));
+                        break;
+                    }
+                    return BackgroundVerifyFailed(strprintf("found unconnectable block at %d, hash=%s (%s)", pindex->nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(state)));
+                }
+                pcoins->SetBestBlock(pindex->GetBlockHash());
+                pindexCoins = pindex;
+            }
+            ThrottleBackgroundVerify(::GetSerializeSize(block, PROTOCOL_VERSION), nBytesPerSecond);
+        }
+
+        if (fTipMoved) {
+            LOCK(g_background_verify_mutex);
+            g_background_verify_status.nRestarts++;
+            continue;
+        }
+
+        SetBackgroundVerifyProgress(BackgroundVerifyStatus::DONE, 100);
+        LogPrintf("Background block verification: no coin database inconsistencies in last %i blocks (%i transactions)\n", nBlocks, nGoodTransactions);
+        return true;
+    }
+}
+// VELES END
+
 /** Apply the effects of a block on the utxo cache, ignoring that it may already have been applied. */
 bool CChainState::RollforwardBlock(const CBlockIndex* pindex, CCoinsViewCache& inputs, const CChainParams& params)
 {
@@ -4860,6 +5978,128 @@ void CChainState::EraseBlockData(CBlockIndex* index)
     }
 }
 
+// VELES BEGIN
+bool CChainState::ActivateSnapshot(CAutoFile& coins_file, const SnapshotMetadata& metadata, const CChainParams& chainparams, std::string& strError)
+{
+    CValidationState state;
+    {
+        LOCK(cs_main);
+        CBlockIndex* pindexBase = LookupBlockIndex(metadata.m_base_blockhash);
+        if (!pindexBase || !pindexBase->IsValid(BLOCK_VALID_TREE) || pindexBase->nHeight == 0) {
+            strError = "The snapshot block header is not known, wait for the headers to sync";
+            return false;
+        }
+        if (pindexBase->nStatus & BLOCK_FAILED_MASK) {
+            strError = "The snapshot block is invalid";
+            return false;
+        }
+        if (g_snapshot_base || chainActive.Height() != 0) {
+            strError = "A snapshot can only be loaded when no blocks beyond genesis are connected";
+            return false;
+        }
+        if (!FlushStateToDisk(chainparams, state, FlushStateMode::ALWAYS)) {
+            strError = FormatStateMessage(state);
+            return false;
+        }
+        mempool.clear();
+
+        // Write the coins in parts no bigger than the coins cache, the database
+        // can't be used again until the last one is written.
+        CCoinsMap coins;
+        size_t nCoinsUsage = 0;
+        bool fWritten = false;
+        for (uint64_t n = 0; n < metadata.m_coins_count; ++n) {
+            COutPoint outpoint;
+            Coin coin;
+            try {
+                coins_file >> outpoint;
+                coins_file >> coin;
+            } catch (const std::exception& e) {
+                strError = strprintf("Failed to read coin %u of the snapshot: %s", n, e.what());
+                break;
+            }
+            if (coin.IsSpent() || coin.nHeight > (uint32_t)pindexBase->nHeight) {
+                strError = strprintf("Coin %s of the snapshot is not unspent at its block", outpoint.ToString());
+                break;
+            }
+            CCoinsCacheEntry& entry = coins[outpoint];
+            nCoinsUsage += coin.DynamicMemoryUsage();
+            entry.coin = std::move(coin);
+            entry.flags = CCoinsCacheEntry::DIRTY;
+            if (nCoinsUsage + memusage::DynamicUsage(coins) > nCoinCacheUsage) {
+                if (!pcoinsdbview->WriteSnapshotCoins(coins, metadata.m_base_blockhash, false)) {
+                    return AbortNode(state, "Failed to write the UTXO snapshot to the coin database");
+                }
+                nCoinsUsage = 0;
+                fWritten = true;
+            }
+        }
+        if (!strError.empty()) {
+            if (fWritten) {
+                return AbortNode(state, "Failed to load the UTXO snapshot after writing part of it. " + strError,
+                                 _("The coin database is corrupted, restart with -reindex-chainstate to recover."));
+            }
+            return false;
+        }
+        if (!pcoinsdbview->WriteSnapshotCoins(coins, metadata.m_base_blockhash, true)) {
+            return AbortNode(state, "Failed to write the UTXO snapshot to the coin database");
+        }
+        pcoinsTip->SetBestBlock(metadata.m_base_blockhash);
+
+        // Blocks up to the base are never connected here, so the base stands in for all of them
+        pindexBase->nTx = metadata.m_chain_tx;
+        pindexBase->nChainTx = metadata.m_chain_tx;
+        pindexBase->nStatus |= BLOCK_SNAPSHOT;
+        pindexBase->RaiseValidity(BLOCK_VALID_SCRIPTS);
+        setDirtyBlockIndex.insert(pindexBase);
+        g_snapshot_base = pindexBase;
+        chainActive.SetTip(pindexBase);
+
+        // Descendants already received were waiting for the base
+        std::deque<CBlockIndex*> queue;
+        queue.push_back(pindexBase);
+        while (!queue.empty()) {
+            CBlockIndex *pindex = queue.front();
+            queue.pop_front();
+            if (pindex != pindexBase) {
+                pindex->nChainTx = pindex->pprev->nChainTx + pindex->nTx;
+            }
+            {
+                LOCK(cs_nBlockSequenceId);
+                pindex->nSequenceId = nBlockSequenceId++;
+            }
+            setBlockIndexCandidates.insert(pindex);
+            std::pair<std::multimap<CBlockIndex*, CBlockIndex*>::iterator, std::multimap<CBlockIndex*, CBlockIndex*>::iterator> range = mapBlocksUnlinked.equal_range(pindex);
+            while (range.first != range.second) {
+                std::multimap<CBlockIndex*, CBlockIndex*>::iterator it = range.first;
+                queue.push_back(it->second);
+                range.first++;
+                mapBlocksUnlinked.erase(it);
+            }
+        }
+        PruneBlockIndexCandidates();
+
+        LogPrintf("Loaded UTXO snapshot of %u coins at block %s (height %d)\n", metadata.m_coins_count, metadata.m_base_blockhash.ToString(), pindexBase->nHeight);
+        if (!FlushStateToDisk(chainparams, state, FlushStateMode::ALWAYS)) {
+            strError = FormatStateMessage(state);
+            return false;
+        }
+    }
+    GetMainSignals().UpdatedBlockTip(chainActive.Tip(), nullptr, IsInitialBlockDownload());
+
+    if (!ActivateBestChain(state, chainparams, nullptr)) {
+        strError = FormatStateMessage(state);
+        return false;
+    }
+    return true;
+}
+
+bool ActivateSnapshot(CAutoFile& coins_file, const SnapshotMetadata& metadata, std::string& strError)
+{
+    return g_chainstate.ActivateSnapshot(coins_file, metadata, Params(), strError);
+}
+// VELES END
+
 bool CChainState::RewindBlockIndex(const CChainParams& params)
 {
     // Note that during -reindex-chainstate we are called with an empty chainActive!
@@ -4881,6 +6121,12 @@ bool CChainState::RewindBlockIndex(const CChainParams& params)
     int nHeight = 1;
     {
         LOCK(cs_main);
+        // VELES BEGIN
+        // Blocks up to a UTXO snapshot were never validated here, nor can they be disconnected
+        if (g_snapshot_base) {
+            nHeight = g_snapshot_base->nHeight + 1;
+        }
+        // VELES END
         while (nHeight <= chainActive.Height()) {
             // Although SCRIPT_VERIFY_WITNESS is now generally enforced on all
             // blocks in ConnectBlock, we don't need to go back and
@@ -4987,6 +6233,7 @@ void UnloadBlockIndex()
     chainActive.SetTip(nullptr);
     pindexBestInvalid = nullptr;
     pindexBestHeader = nullptr;
+    g_snapshot_base = nullptr; // VELES
     mempool.clear();
     mapBlocksUnlinked.clear();
     vinfoBlockFile.clear();
@@ -4999,9 +6246,14 @@ void UnloadBlockIndex()
     }
 
     for (const BlockMap::value_type& entry : mapBlockIndex) {
-        delete entry.second;
+        // VELES BEGIN
+        //delete entry.second;
+        if (!g_block_index_arena.Owns(entry.second))
+            delete entry.second;
+        // VELES END
     }
     mapBlockIndex.clear();
+    g_block_index_arena.Clear(); // VELES
     fHavePruned = false;
 
     g_chainstate.UnloadBlockIndex();
@@ -5059,10 +6311,89 @@ bool LoadGenesisBlock(const CChainParams& chainparams)
     return g_chainstate.LoadGenesisBlock(chainparams);
 }
 
+// VELES BEGIN
+/** Map of disk positions for blocks with unknown parent (only used for reindex) */
+static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
+
+/**
+ * Accept a block read from a file being imported, and the blocks waiting for it as their
+ * parent. Returns false when the rest of the file should not be imported.
+ */
+static bool AcceptImportedBlock(const CChainParams& chainparams, CImportedBlock& imported, int& nLoaded)
+{
+    const CBlock& block = *imported.pblock;
+    const uint256& hash = imported.hash;
+    const CDiskBlockPos* dbp = imported.pos.IsNull() ? nullptr : &imported.pos;
+    {
+        LOCK(cs_main);
+        // detect out of order blocks, and store them for later
+        if (hash != chainparams.GetConsensus().hashGenesisBlock && !LookupBlockIndex(block.hashPrevBlock)) {
+            LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                    block.hashPrevBlock.ToString());
+            if (dbp)
+                mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+            return true;
+        }
+
+        // process in case the block isn't known yet
+        CBlockIndex* pindex = LookupBlockIndex(hash);
+        if (!pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0) {
+          CValidationState state;
+          if (g_chainstate.AcceptBlock(imported.pblock, state, chainparams, nullptr, true, dbp, nullptr, &imported.hashPoW)) {
+              nLoaded++;
+          }
+          if (state.IsError()) {
+              return false;
+          }
+        } else if (hash != chainparams.GetConsensus().hashGenesisBlock && pindex->nHeight % 1000 == 0) {
+          LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), pindex->nHeight);
+        }
+    }
+
+    // Activate the genesis block so normal node progress can continue
+    if (hash == chainparams.GetConsensus().hashGenesisBlock) {
+        CValidationState state;
+        if (!ActivateBestChain(state, chainparams)) {
+            return false;
+        }
+    }
+
+    NotifyHeaderTip();
+
+    // Recursively process earlier encountered successors of this block
+    std::deque<uint256> queue;
+    queue.push_back(hash);
+    while (!queue.empty()) {
+        uint256 head = queue.front();
+        queue.pop_front();
+        std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+        while (range.first != range.second) {
+            std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
+            std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
+            if (ReadBlockFromDisk(*pblockrecursive, it->second, chainparams.GetConsensus()))
+            {
+                LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
+                        head.ToString());
+                LOCK(cs_main);
+                CValidationState dummy;
+                if (g_chainstate.AcceptBlock(pblockrecursive, dummy, chainparams, nullptr, true, &it->second, nullptr))
+                {
+                    nLoaded++;
+                    queue.push_back(pblockrecursive->GetHash());
+                }
+            }
+            range.first++;
+            mapBlocksUnknownParent.erase(it);
+            NotifyHeaderTip();
+        }
+    }
+    return true;
+}
+// VELES END
+
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
 {
-    // Map of disk positions for blocks with unknown parent (only used for reindex)
-    static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
+    // VELES: Map of disk positions for blocks with unknown parent moved to file scope
     int64_t nStart = GetTimeMillis();
 
     int nLoaded = 0;
@@ -5105,70 +6436,15 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
                 blkdat >> block;
                 nRewind = blkdat.GetPos();
 
-                uint256 hash = block.GetHash();
-                {
-                    LOCK(cs_main);
-                    // detect out of order blocks, and store them for later
-                    if (hash != chainparams.GetConsensus().hashGenesisBlock && !LookupBlockIndex(block.hashPrevBlock)) {
-                        LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                                block.hashPrevBlock.ToString());
-                        if (dbp)
-                            mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
-                        continue;
-                    }
-
-                    // process in case the block isn't known yet
-                    CBlockIndex* pindex = LookupBlockIndex(hash);
-                    if (!pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0) {
-                      CValidationState state;
-                      if (g_chainstate.AcceptBlock(pblock, state, chainparams, nullptr, true, dbp, nullptr)) {
-                          nLoaded++;
-                      }
-                      if (state.IsError()) {
-                          break;
-                      }
-                    } else if (hash != chainparams.GetConsensus().hashGenesisBlock && pindex->nHeight % 1000 == 0) {
-                      LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), pindex->nHeight);
-                    }
-                }
-
-                // Activate the genesis block so normal node progress can continue
-                if (hash == chainparams.GetConsensus().hashGenesisBlock) {
-                    CValidationState state;
-                    if (!ActivateBestChain(state, chainparams)) {
-                        break;
-                    }
-                }
-
-                NotifyHeaderTip();
-
-                // Recursively process earlier encountered successors of this block
-                std::deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
-                        if (ReadBlockFromDisk(*pblockrecursive, it->second, chainparams.GetConsensus()))
-                        {
-                            LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
-                                    head.ToString());
-                            LOCK(cs_main);
-                            CValidationState dummy;
-                            if (g_chainstate.AcceptBlock(pblockrecursive, dummy, chainparams, nullptr, true, &it->second, nullptr))
-                            {
-                                nLoaded++;
-                                queue.push_back(pblockrecursive->GetHash());
-                            }
-                        }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                        NotifyHeaderTip();
-                    }
-                }
+                // VELES BEGIN
+                CImportedBlock imported;
+                imported.pblock = pblock;
+                imported.hash = block.GetHash();
+                if (dbp)
+                    imported.pos = *dbp;
+                if (!AcceptImportedBlock(chainparams, imported, nLoaded))
+                    break;
+                // VELES END
             } catch (const std::exception& e) {
                 LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
@@ -5181,11 +6457,86 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
     return nLoaded > 0;
 }
 
+// VELES BEGIN
+/** Import files in order, their blocks are parsed and hashed by nThreads threads ahead of the import */
+static void ImportBlockFiles(const CChainParams& chainparams, const std::vector<CBlockFileParser::Source>& vSources, int nThreads)
+{
+    CBlockFileParser parser(chainparams, vSources, nThreads);
+    for (size_t i = 0; i < vSources.size(); ++i) {
+        const CBlockFileParser::Source& source = vSources[i];
+        if (!parser.WaitOpened(i)) {
+            if (source.nFile >= 0) {
+                error("%s: Unable to open file %s", __func__, source.path.string());
+                break;
+            }
+            LogPrintf("Warning: Could not open blocks file %s\n", source.path.string());
+            continue;
+        }
+        if (source.nFile >= 0) {
+            LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)source.nFile);
+        } else {
+            LogPrintf("Importing blocks file %s...\n", source.path.string());
+        }
+
+        int64_t nStart = GetTimeMillis();
+        int nLoaded = 0;
+        std::vector<CImportedBlock> vBlocks;
+        std::string strError;
+        bool fContinue = true;
+        while (fContinue && parser.Next(i, vBlocks, strError)) {
+            for (CImportedBlock& imported : vBlocks) {
+                boost::this_thread::interruption_point();
+                try {
+                    if (!AcceptImportedBlock(chainparams, imported, nLoaded)) {
+                        fContinue = false;
+                        break;
+                    }
+                } catch (const std::exception& e) {
+                    LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+                }
+            }
+        }
+        parser.Finish(i);
+        if (!strError.empty())
+            AbortNode(std::string("System error: ") + strError);
+        if (nLoaded > 0)
+            LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
+    }
+}
+
+void ReindexBlockFiles(const CChainParams& chainparams, int nThreads)
+{
+    std::vector<CBlockFileParser::Source> vSources;
+    for (int nFile = 0; ; nFile++) {
+        fs::path path = GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk");
+        if (!fs::exists(path))
+            break; // No block files left to reindex
+        vSources.push_back({path, nFile});
+    }
+    ImportBlockFiles(chainparams, vSources, nThreads);
+}
+
+void LoadExternalBlockFiles(const CChainParams& chainparams, const std::vector<fs::path>& vFiles, int nThreads)
+{
+    std::vector<CBlockFileParser::Source> vSources;
+    for (const fs::path& path : vFiles) {
+        vSources.push_back({path, -1});
+    }
+    ImportBlockFiles(chainparams, vSources, nThreads);
+}
+// VELES END
+
 void CChainState::CheckBlockIndex(const Consensus::Params& consensusParams)
 {
     if (!fCheckBlockIndex) {
         return;
     }
+    // VELES BEGIN
+    // The consistency rules below assume every block was connected from genesis
+    if (g_snapshot_base) {
+        return;
+    }
+    // VELES END
 
     LOCK(cs_main);
 
@@ -5397,23 +6748,20 @@ int VersionBitsTipStateSinceHeight(const Consensus::Params& params, Consensus::D
 
 static const uint64_t MEMPOOL_DUMP_VERSION = 1;
 
-bool LoadMempool()
+// VELES BEGIN
+/** Number of transactions whose scripts are verified together while loading the mempool */
+static const size_t MEMPOOL_LOAD_BATCH = 256;
+
+/** Read the mempool dumped by savemempool, or at shutdown before the journal */
+static bool ReadMempoolDump(const fs::path& path, CMempoolJournal::Contents& contents)
 {
-    const CChainParams& chainparams = Params();
-    int64_t nExpiryTimeout = gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60;
-    FILE* filestr = fsbridge::fopen(GetDataDir() / "mempool.dat", "rb");
+    FILE* filestr = fsbridge::fopen(path, "rb");
     CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
     if (file.IsNull()) {
         LogPrintf("Failed to open mempool file from disk. Continuing anyway.\n");
         return false;
     }
 
-    int64_t count = 0;
-    int64_t expired = 0;
-    int64_t failed = 0;
-    int64_t already_there = 0;
-    int64_t nNow = GetTime();
-
     try {
         uint64_t version;
         file >> version;
@@ -5430,10 +6778,65 @@ bool LoadMempool()
             file >> nTime;
             file >> nFeeDelta;
 
-            CAmount amountdelta = nFeeDelta;
-            if (amountdelta) {
-                mempool.PrioritiseTransaction(tx->GetHash(), amountdelta);
+            if (nFeeDelta) {
+                contents.mapDeltas[tx->GetHash()] += nFeeDelta;
+            }
+            contents.vtx.emplace_back(tx, nTime);
+        }
+        std::map<uint256, CAmount> mapDeltas;
+        file >> mapDeltas;
+
+        for (const auto& i : mapDeltas) {
+            contents.mapDeltas[i.first] += i.second;
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+    return true;
+}
+
+bool LoadMempool()
+{
+    const CChainParams& chainparams = Params();
+    int64_t nExpiryTimeout = gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60;
+
+    // The journal is kept up to date while running, mempool.dat is left by savemempool and
+    // by the versions before the journal
+    CMempoolJournal::Contents contents;
+    const fs::path journal_path = GetDataDir() / MEMPOOL_JOURNAL_FILENAME;
+    if (fs::exists(journal_path)) {
+        if (!CMempoolJournal::Read(journal_path, contents)) {
+            LogPrintf("Failed to read the mempool journal from disk. Continuing anyway.\n");
+            return false;
+        }
+    } else if (!ReadMempoolDump(GetDataDir() / "mempool.dat", contents)) {
+        return false;
+    }
+
+    int64_t count = 0;
+    int64_t expired = 0;
+    int64_t failed = 0;
+    int64_t already_there = 0;
+    int64_t nNow = GetTime();
+
+    for (const auto& i : contents.mapDeltas) {
+        mempool.PrioritiseTransaction(i.first, i.second);
+    }
+
+    for (size_t nBatch = 0; nBatch < contents.vtx.size(); nBatch += MEMPOOL_LOAD_BATCH) {
+        std::vector<CTransactionRef> vtx;
+        for (size_t i = nBatch; i < std::min(nBatch + MEMPOOL_LOAD_BATCH, contents.vtx.size()); ++i) {
+            if (contents.vtx[i].second + nExpiryTimeout > nNow) {
+                vtx.push_back(contents.vtx[i].first);
             }
+        }
+        // Warm the signature cache on all cores, the transactions are then accepted in order
+        PreVerifyMempoolScripts(mempool, vtx);
+
+        for (size_t i = nBatch; i < std::min(nBatch + MEMPOOL_LOAD_BATCH, contents.vtx.size()); ++i) {
+            const CTransactionRef& tx = contents.vtx[i].first;
+            int64_t nTime = contents.vtx[i].second;
             CValidationState state;
             if (nTime + nExpiryTimeout > nNow) {
                 LOCK(cs_main);
@@ -5456,23 +6859,19 @@ bool LoadMempool()
             } else {
                 ++expired;
             }
-            if (ShutdownRequested())
-                return false;
         }
-        std::map<uint256, CAmount> mapDeltas;
-        file >> mapDeltas;
+        if (ShutdownRequested())
+            return false;
+    }
 
-        for (const auto& i : mapDeltas) {
-            mempool.PrioritiseTransaction(i.first, i.second);
-        }
-    } catch (const std::exception& e) {
-        LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
-        return false;
+    for (const uint256& hash : contents.setLocked) {
+        mempool.SetInstantSendLocked(hash);
     }
 
-    LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there\n", count, failed, expired, already_there);
+    LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there, %i InstantSend locked\n", count, failed, expired, already_there, contents.setLocked.size());
     return true;
 }
+// VELES END
 
 bool DumpMempool()
 {
@@ -5554,7 +6953,12 @@ public:
         // block headers
         BlockMap::iterator it1 = mapBlockIndex.begin();
         for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
+            // VELES BEGIN
+            //delete (*it1).second;
+            if (!g_block_index_arena.Owns((*it1).second))
+                delete (*it1).second;
+            // VELES END
         mapBlockIndex.clear();
+        g_block_index_arena.Clear(); // VELES
     }
 } instance_of_cmaincleanup;
@@ -44,7 +44,14 @@ class CScriptCheck;
 class CBlockPolicyEstimator;
 class CTxMemPool;
 class CValidationState;
+class CBlockUndo; // VELES
+class CAutoFile; // VELES
+class SnapshotMetadata; // VELES
 struct ChainTxData;
+// VELES BEGIN
+struct CSignatureVerification;
+struct ValidationCacheStats;
+// VELES END
 
 struct PrecomputedTransactionData;
 struct LockPoints;
@@ -84,6 +91,15 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+// VELES BEGIN
+/** How script-checking threads are placed on the cores */
+enum class ScriptCheckPinning {
+    NONE,   //!< left to the scheduler
+    CORES,  //!< one thread per core, from the second core on
+};
+/** -parpin default */
+static const char* const DEFAULT_SCRIPTCHECK_PINNING = "none";
+// VELES END
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -101,6 +117,19 @@ static const int MAX_BLOCKTXN_DEPTH = 10;
  *  degree of disordering of blocks on disk (which make reindexing and pruning harder). We'll probably
  *  want to make this a per-peer adaptive value at some point. */
 static const unsigned int BLOCK_DOWNLOAD_WINDOW = 1024;
+// VELES BEGIN
+/** Bounds of the per-peer limit of blocks in transit, which adapts to the round trip and block delivery
+ *  time measured for the peer. Peers start at MAX_BLOCKS_IN_TRANSIT_PER_PEER. */
+static const int MIN_BLOCKS_IN_TRANSIT_PER_PEER = 2;
+static const int MAX_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER = 64;
+/** The block download window grows by this many blocks per block that may be in transit from the
+ *  peers we are downloading from, between BLOCK_DOWNLOAD_WINDOW and BLOCK_DOWNLOAD_WINDOW_MAX. */
+static const unsigned int BLOCK_DOWNLOAD_WINDOW_PER_BLOCK_IN_TRANSIT = 8;
+static const unsigned int BLOCK_DOWNLOAD_WINDOW_MAX = 8192;
+/** A peer whose oldest block in transit takes this many times its usual delivery time (plus a round
+ *  trip) gets its limit of blocks in transit halved. */
+static const int BLOCK_DELIVERY_SLOW_FACTOR = 4;
+// VELES END
 /** Time to wait (in seconds) between writing blocks/block index to disk. */
 static const unsigned int DATABASE_WRITE_INTERVAL = 60 * 60;
 /** Time to wait (in seconds) between flushing chainstate to disk. */
@@ -123,9 +152,22 @@ static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
 //static const bool DEFAULT_TXINDEX = false;
 static const bool DEFAULT_TXINDEX = true;
 //
+static const char* const DEFAULT_BLOCKFILTERINDEX = "0"; // VELES
+// VELES BEGIN
+static const bool DEFAULT_ADDRESSINDEX = false;
+static const bool DEFAULT_SPENTINDEX = false;
+static const bool DEFAULT_TIMESTAMPINDEX = false;
+static const bool DEFAULT_COINSTATSINDEX = false;
+// VELES END
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 /** Default for -persistmempool */
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
+// VELES BEGIN
+/** Default for -persistvalidationcaches */
+static const bool DEFAULT_PERSIST_VALIDATION_CACHES = false;
+/** Name of the file the validation caches are kept in across restarts */
+static const char* const VALIDATION_CACHES_FILENAME = "validationcaches.dat";
+// VELES END
 /** Default for -mempoolreplacement */
 static const bool DEFAULT_ENABLE_REPLACEMENT = true;
 /** Default for using fee filter */
@@ -146,6 +188,8 @@ static const int DEFAULT_STOPATHEIGHT = 0;
 static const double HALVING_MIN_SUPPLY_TARGET = 0.80;
 static const double HALVING_MIN_BOOST_SUPPLY_TARGET = 0.60;
 static const double HALVING_MAX_BOOST_STEP = 0.5;
+/** Default for -maxvalidationqueue, the most validation interface callbacks pending before connecting blocks waits for them */
+static const unsigned int DEFAULT_MAX_VALIDATION_QUEUE = 64;
 // VELES END
 
 struct BlockHasher
@@ -170,11 +214,15 @@ extern uint256 g_best_block;
 extern std::atomic_bool fImporting;
 extern std::atomic_bool fReindex;
 extern int nScriptCheckThreads;
+extern ScriptCheckPinning g_script_check_pinning; // VELES
+extern unsigned int g_max_validation_queue; // VELES
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
 extern size_t nCoinCacheUsage;
+/** Coins cache budget during the initial block download with -dbcache=auto, 0 when it is nCoinCacheUsage */
+extern size_t nCoinCacheUsageIBD; // VELES
 /** A fee rate smaller than this is considered zero fee (for relaying, mining and transaction creation) */
 extern CFeeRate minRelayTxFee;
 /** Absolute maximum transaction fee (in satoshis) used by wallet and mempool (rejects high fee in sendrawtransaction) */
@@ -198,6 +246,10 @@ extern arith_uint256 nMinimumChainWork;
 
 /** Best header we've seen so far (used for getheaders queries' starting points). */
 extern CBlockIndex *pindexBestHeader;
+// VELES BEGIN
+/** Block the chain state was loaded from a UTXO snapshot at, if any. Blocks up to it have no data nor undo data. */
+extern const CBlockIndex* g_snapshot_base;
+// VELES END
 
 /** Minimum disk space required - used in CheckDiskSpace() */
 static const uint64_t nMinDiskSpace = 52428800;
@@ -216,6 +268,14 @@ static const unsigned int NODE_NETWORK_LIMITED_MIN_BLOCKS = 288;
 
 static const signed int DEFAULT_CHECKBLOCKS = 6;
 static const unsigned int DEFAULT_CHECKLEVEL = 3;
+// VELES BEGIN
+/** Number of most recent block headers whose stored PoW hash is re-verified on startup */
+static const signed int DEFAULT_CHECKPOWONLOAD = 0;
+/** Whether the checks of -checklevel above 2 run in the background after the startup */
+static const bool DEFAULT_BACKGROUND_VERIFY = false;
+/** MiB of blocks read per second by the background verification, 0 for no limit */
+static const int64_t DEFAULT_BACKGROUND_VERIFY_RATE = 8;
+// VELES END
 
 // Require that user allocate at least 550 MiB for block & undo files (blk???.dat and rev???.dat)
 // At 1MB per block, 288 blocks = 288MB.
@@ -271,6 +331,12 @@ FILE* OpenBlockFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 fs::path GetBlockPosFilename(const CDiskBlockPos &pos, const char *prefix);
 /** Import blocks from an external file */
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp = nullptr);
+// VELES BEGIN
+/** Reindex the block files (blk?????.dat) in order, parsing and hashing their blocks on nThreads threads */
+void ReindexBlockFiles(const CChainParams& chainparams, int nThreads);
+/** Import blocks from external files in order, parsing and hashing their blocks on nThreads threads */
+void LoadExternalBlockFiles(const CChainParams& chainparams, const std::vector<fs::path>& vFiles, int nThreads);
+// VELES END
 /** Ensures we have a genesis block in the block tree, possibly writing one to disk. */
 bool LoadGenesisBlock(const CChainParams& chainparams);
 /** Load the block tree and coins database from disk,
@@ -282,6 +348,10 @@ bool LoadChainTip(const CChainParams& chainparams) EXCLUSIVE_LOCKS_REQUIRED(cs_m
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+// VELES BEGIN
+/** Run an instance of the headers PoW hashing thread */
+void ThreadPoWHashCheck();
+// VELES END
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
@@ -294,6 +364,73 @@ bool GetTransaction(const uint256& hash, CTransactionRef& tx, const Consensus::P
  */
 bool ActivateBestChain(CValidationState& state, const CChainParams& chainparams, std::shared_ptr<const CBlock> pblock = std::shared_ptr<const CBlock>());
 // VELES BEGIN
+/** Time spent connecting blocks to the active chain since startup, in microseconds, by phase of ConnectBlock() */
+struct ConnectBlockTimings
+{
+    int64_t nBlocks = 0;
+    //! Coins of the inputs fetched and checked against the outputs
+    int64_t nCoinFetch = 0;
+    //! Input scripts verified, or queued and waited for with -par
+    int64_t nScriptCheck = 0;
+    //! Block subsidy computed and checked against the coinbase
+    int64_t nSubsidy = 0;
+    //! IsBlockValueValid() and IsBlockPayeeValid()
+    int64_t nPayments = 0;
+    int64_t nTotal = 0;
+};
+ConnectBlockTimings GetConnectBlockTimings() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+/** Buckets of the validation phase histograms, bucket i > 0 counts the times from 2^(i-1) up to 2^i microseconds */
+static const int VALIDATION_STATS_BUCKETS = 28;
+
+/** Timed phases of connecting blocks and of the masternode managers following the tip, see getvalidationstats */
+enum class ValidationPhase {
+    // ConnectBlock()
+    CHECK,
+    FORKS,
+    CONNECT_TXS,
+    VERIFY,
+    BLOCK_VALUE,
+    MASTERNODE_PAYEE,
+    SUPERBLOCK,
+    INDEX,
+    CALLBACKS,
+    // ConnectTip()
+    READ_FROM_DISK,
+    PREFETCH,
+    CONNECT_TOTAL,
+    FLUSH,
+    CHAINSTATE,
+    POST_CONNECT,
+    CONNECT_BLOCK,
+    // ActivateBestChain() waiting for the validation interface queue
+    QUEUE_WAIT,
+    // Transaction locks completed by InstantSend
+    INSTANTSEND_CONFLICTS,
+    // CDSNotificationInterface::UpdatedBlockTip()
+    TIP_MASTERNODE_SYNC,
+    TIP_MNODEMAN,
+    TIP_PRIVATESEND,
+    TIP_INSTANTSEND,
+    TIP_MNPAYMENTS,
+    TIP_GOVERNANCE,
+    COUNT
+};
+
+/** Times of one phase since startup or the last reset */
+struct ValidationPhaseStats {
+    std::string name;
+    uint64_t count = 0;
+    int64_t total_micros = 0;
+    int64_t max_micros = 0;
+    int64_t last_micros = 0;
+    uint64_t histogram[VALIDATION_STATS_BUCKETS] = {};
+};
+
+void RecordValidationPhase(ValidationPhase phase, int64_t nMicros);
+/** The stats of every phase, in the order of ValidationPhase */
+std::vector<ValidationPhaseStats> GetValidationStats();
+void ResetValidationStats();
 struct HalvingEpoch
 {
 	int nStartBlock = 0;
@@ -316,18 +453,29 @@ struct HalvingParameters
 //    int nLastHalvingBlockHeight = 0;
     std::vector<HalvingEpoch> epochs;
 };
-CAmount CountBlockRewards(int nStartBlock, int nEndBlock, HalvingParameters *halvingParams);
+/** Total subsidy of the blocks from height 1 up to and including pindex, computed once per block index */
+CAmount GetChainSubsidy(const CBlockIndex* pindex);
+/** Sum of the subsidies of the active chain blocks nStartBlock to nEndBlock, excluding the tip */
+CAmount CountBlockRewards(int nStartBlock, int nEndBlock);
+/** Total subsidy of the active chain up to and including nHeight, or the tip when nHeight is 0 */
 CAmount GetTotalSupply(int nHeight = 0);
-HalvingParameters *GetSubsidyHalvingParameters(int nHeight, const Consensus::Params& consensusParams);
-HalvingParameters *GetSubsidyHalvingParameters(int nHeight);
-HalvingParameters *GetSubsidyHalvingParameters();
+/**
+ * Return the halving schedule in effect at nHeight. Schedules are shared between all heights of an
+ * epoch and only rebuilt when a new epoch starts, the active chain is reorganized below an epoch
+ * boundary or the reward upgrade spork moves.
+ */
+std::shared_ptr<const HalvingParameters> GetSubsidyHalvingParameters(int nHeight, const Consensus::Params& consensusParams);
+std::shared_ptr<const HalvingParameters> GetSubsidyHalvingParameters(int nHeight);
+std::shared_ptr<const HalvingParameters> GetSubsidyHalvingParameters();
 double GetAlgoCostFactor(int32_t nAlgo, int nHeight);
 double GetAlgoCostFactor(int32_t nAlgo);
+/** Heights from nStartHeight up to nEndHeight, or on when it is -1, sharing the cost factors of nHeight */
+void GetAlgoCostFactorRange(int nHeight, int64_t& nStartHeight, int64_t& nEndHeight);
 double GetBlockAlgoCostFactor(CBlockHeader *pblock, int nHeight);
 // VELES END
 // FXTC BEGIN
 //CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams);
-CAmount GetBlockSubsidy(int nHeight, CBlockHeader pblock, const Consensus::Params& consensusParams, bool fSuperblockPartOnly = false, HalvingParameters *halvingParams = nullptr);
+CAmount GetBlockSubsidy(int nHeight, CBlockHeader pblock, const Consensus::Params& consensusParams, bool fSuperblockPartOnly = false, const HalvingParameters *halvingParams = nullptr);
 // FXTC END
 // Dash
 CAmount GetMasternodePayment(int nHeight, CAmount blockValue);
@@ -365,6 +513,21 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
                         bool* pfMissingInputs, std::list<CTransactionRef>* plTxnReplaced,
                         bool bypass_limits, const CAmount nAbsurdFee, bool test_accept=false) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+// VELES BEGIN
+/** (try to) add the transactions of vtx to memory pool, in order. The scripts of the transactions
+ * spending confirmed or mempool outputs only are verified on the script check threads first,
+ * without cs_main held, so accepting them one by one finds their signatures cached.
+ * states and missing_inputs are filled in per transaction, returns whether each was accepted. **/
+std::vector<bool> AcceptToMemoryPoolBatch(CTxMemPool& pool, const std::vector<CTransactionRef>& vtx,
+                                          std::vector<CValidationState>& states, std::vector<bool>& missing_inputs,
+                                          std::list<CTransactionRef>* plTxnReplaced, const CAmount nAbsurdFee) LOCKS_EXCLUDED(cs_main);
+
+/** Verify the scripts of the transactions of vtx that would get to script verification in
+ * AcceptToMemoryPool on the script check threads, warming the signature cache for it. Runs
+ * with cs_main held when the caller holds it. */
+void PreVerifyMempoolScripts(CTxMemPool& pool, const std::vector<CTransactionRef>& vtx);
+// VELES END
+
 // Dash
 bool GetUTXOCoin(const COutPoint& outpoint, Coin& coin);
 int GetUTXOHeight(const COutPoint& outpoint);
@@ -438,6 +601,14 @@ public:
 
     bool operator()();
 
+    // VELES BEGIN
+    //! Run the script taking its signatures as valid, collecting the ones not in the cache into vSigs
+    bool Collect(std::vector<CSignatureVerification>& vSigs);
+    //! Run the script again with the results of the signatures collected for it in [nBegin, nEnd)
+    bool Replay(const std::vector<CSignatureVerification>& vSigs, size_t nBegin, size_t nEnd, const std::vector<bool>& vResults);
+    bool IsCacheStore() const { return cacheStore; }
+    // VELES END
+
     void swap(CScriptCheck &check) {
         std::swap(ptxTo, check.ptxTo);
         std::swap(m_tx_out, check.m_tx_out);
@@ -451,6 +622,36 @@ public:
     ScriptError GetScriptError() const { return error; }
 };
 
+// VELES BEGIN
+/** Verify a batch of script checks, verifying all their signatures together */
+bool RunChecks(std::vector<CScriptCheck>& vChecks);
+// VELES END
+
+// VELES BEGIN
+/**
+ * Closure computing the proof-of-work hashes of a small group of block headers,
+ * used to hash headers batches on worker threads before taking cs_main.
+ */
+class CPoWHashCheck
+{
+private:
+    std::vector<const CBlockHeader*> vHeaders;
+    std::vector<uint256*> vHashPoW;
+
+public:
+    CPoWHashCheck() {}
+    CPoWHashCheck(std::vector<const CBlockHeader*> vHeadersIn, std::vector<uint256*> vHashPoWIn) :
+        vHeaders(std::move(vHeadersIn)), vHashPoW(std::move(vHashPoWIn)) { }
+
+    bool operator()();
+
+    void swap(CPoWHashCheck &check) {
+        vHeaders.swap(check.vHeaders);
+        vHashPoW.swap(check.vHashPoW);
+    }
+};
+// VELES END
+
 /** Initializes the script-execution cache */
 void InitScriptExecutionCache();
 
@@ -458,8 +659,16 @@ void InitScriptExecutionCache();
 /** Functions for disk access for blocks */
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+// VELES BEGIN
+/**
+ * Read a block allocating its transactions from an arena, for the scans looking at it and dropping it.
+ * Neither the block nor any of its transactions may outlive the arena or be kept around.
+ */
+bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams, CMonotonicArena& arena);
+// VELES END
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start);
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start);
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex); // VELES
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -472,11 +681,22 @@ void ReprocessBlocks(int nBlocks);
 unsigned int GetAlgoSubsidy(int32_t nAlgo);
 
 /** Context-independent validity checks */
-bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, bool fCheckMerkleRoot = true);
+// VELES: If phashPoW points to a non-null hash it is trusted as the PoW hash of block
+bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true, bool fCheckMerkleRoot = true, const uint256* phashPoW = nullptr);
 
 /** Check a block is completely valid from start to finish (only works on top of our current best block) */
 bool TestBlockValidity(CValidationState& state, const CChainParams& chainparams, const CBlock& block, CBlockIndex* pindexPrev, bool fCheckPOW = true, bool fCheckMerkleRoot = true) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+// VELES BEGIN
+/**
+ * TestBlockValidity for a block template, without the proof of work. The scripts of the
+ * transactions found in the mempool with the same witness are not verified again, the mempool
+ * did when it accepted them. Everything else, the inputs, fees, sigops, the coinbase and its
+ * payees, is checked as for any block.
+ */
+bool TestBlockTemplateValidity(CValidationState& state, const CChainParams& chainparams, const CBlock& block, CBlockIndex* pindexPrev, bool fCheckMerkleRoot = true) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+// VELES END
+
 /** Check whether witness commitments are required for block. */
 bool IsWitnessEnabled(const CBlockIndex* pindexPrev, const Consensus::Params& params);
 
@@ -498,11 +718,49 @@ public:
     CVerifyDB();
     ~CVerifyDB();
     bool VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview, int nCheckLevel, int nCheckDepth);
+    // VELES BEGIN
+    /**
+     * Run the checks of VerifyDB() while the node is running, holding cs_main for one block
+     * at a time. The coins are disconnected and connected again on top of pcoinsTip, so a
+     * run starts over when the tip moves. At most nBytesPerSecond of blocks are read, 0 for
+     * no limit. The progress is reported by GetBackgroundVerifyStatus().
+     */
+    bool VerifyDBBackground(const CChainParams& chainparams, int nCheckLevel, int nCheckDepth, int64_t nBytesPerSecond);
+    // VELES END
 };
 
+// VELES BEGIN
+/** Progress of CVerifyDB::VerifyDBBackground() */
+struct BackgroundVerifyStatus
+{
+    enum State { NOT_STARTED, WAITING, RUNNING, DONE, FAILED };
+
+    State state = NOT_STARTED;
+    int nCheckLevel = 0;
+    int nCheckDepth = 0;
+    //! Percentage of the current run done
+    int nProgress = 0;
+    //! Runs started over because the tip moved
+    int nRestarts = 0;
+    std::string strError;
+};
+
+BackgroundVerifyStatus GetBackgroundVerifyStatus();
+std::string BackgroundVerifyStateToString(BackgroundVerifyStatus::State state);
+// VELES END
+
 /** Replay blocks that aren't fully applied to the database. */
 bool ReplayBlocks(const CChainParams& params, CCoinsView* view);
 
+// VELES BEGIN
+/**
+ * Replace the chain state, which must be at the genesis block, with the coins of
+ * a UTXO snapshot read from coins_file, and continue syncing from its block. The
+ * snapshot must have been checked against metadata before.
+ */
+bool ActivateSnapshot(CAutoFile& coins_file, const SnapshotMetadata& metadata, std::string& strError) LOCKS_EXCLUDED(cs_main);
+// VELES END
+
 inline CBlockIndex* LookupBlockIndex(const uint256& hash)
 {
     AssertLockHeld(cs_main);
@@ -581,6 +839,16 @@ bool DumpMempool();
 /** Load the mempool from disk. */
 bool LoadMempool();
 
+// VELES BEGIN
+/** Dump the signature cache and the script execution cache to disk. */
+bool DumpValidationCaches();
+
+/** Load the caches dumped by DumpValidationCaches, before any script is verified. */
+bool LoadValidationCaches();
+
+ValidationCacheStats GetScriptExecutionCacheStats();
+// VELES END
+
 //! Check whether the block associated with this index entry is pruned or not.
 inline bool IsBlockPruned(const CBlockIndex* pblockindex)
 {
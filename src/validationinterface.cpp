@@ -37,6 +37,11 @@ struct ValidationInterfaceConnections {
     boost::signals2::scoped_connection SyncTransaction;
     boost::signals2::scoped_connection NotifyTransactionLock;
     //
+    // VELES BEGIN
+    boost::signals2::scoped_connection NotifyGovernanceObject;
+    boost::signals2::scoped_connection NotifyGovernanceVote;
+    boost::signals2::scoped_connection NotifyMasternodeListChanged;
+    // VELES END
     // FXTC END
 };
 
@@ -61,6 +66,12 @@ struct MainSignalsInstance {
     boost::signals2::signal<void (const CTransaction &)> NotifyTransactionLock;
     //
 
+    // VELES BEGIN
+    boost::signals2::signal<void (const uint256 &)> NotifyGovernanceObject;
+    boost::signals2::signal<void (const uint256 &)> NotifyGovernanceVote;
+    boost::signals2::signal<void (const COutPoint &, bool fRemoved)> NotifyMasternodeListChanged;
+    // VELES END
+
     boost::signals2::signal<void (const CBlockLocator &)> ChainStateFlushed;
     boost::signals2::signal<void (int64_t nBestBlockTime, CConnman* connman)> Broadcast;
     boost::signals2::signal<void (const CBlock&, const CValidationState&)> BlockChecked;
@@ -102,6 +113,23 @@ size_t CMainSignals::CallbacksPending() {
     return m_internals->m_schedulerClient.CallbacksPending();
 }
 
+// VELES BEGIN
+void CMainSignals::WaitForCallbacksPending(size_t nMax) {
+    AssertLockNotHeld(cs_main);
+    if (!m_internals) return;
+    m_internals->m_schedulerClient.WaitForCallbacksPending(nMax);
+}
+
+size_t CMainSignals::CallbacksPendingPeak() {
+    if (!m_internals) return 0;
+    return m_internals->m_schedulerClient.CallbacksPendingPeak();
+}
+
+void CMainSignals::ResetCallbacksPendingPeak() {
+    if (m_internals) m_internals->m_schedulerClient.ResetCallbacksPendingPeak();
+}
+// VELES END
+
 void CMainSignals::RegisterWithMempoolSignals(CTxMemPool& pool) {
     g_connNotifyEntryRemoved.emplace(std::piecewise_construct,
         std::forward_as_tuple(&pool),
@@ -136,6 +164,11 @@ void RegisterValidationInterface(CValidationInterface* pwalletIn) {
     conns.SyncTransaction = g_signals.m_internals->SyncTransaction.connect(std::bind(&CValidationInterface::SyncTransaction, pwalletIn, std::placeholders::_1, std::placeholders::_2));
     conns.NotifyTransactionLock = g_signals.m_internals->NotifyTransactionLock.connect(std::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, std::placeholders::_1));
     //
+    // VELES BEGIN
+    conns.NotifyGovernanceObject = g_signals.m_internals->NotifyGovernanceObject.connect(std::bind(&CValidationInterface::NotifyGovernanceObject, pwalletIn, std::placeholders::_1));
+    conns.NotifyGovernanceVote = g_signals.m_internals->NotifyGovernanceVote.connect(std::bind(&CValidationInterface::NotifyGovernanceVote, pwalletIn, std::placeholders::_1));
+    conns.NotifyMasternodeListChanged = g_signals.m_internals->NotifyMasternodeListChanged.connect(std::bind(&CValidationInterface::NotifyMasternodeListChanged, pwalletIn, std::placeholders::_1, std::placeholders::_2));
+    // VELES END
     // FXTC END
 }
 
@@ -232,6 +265,26 @@ void CMainSignals::NotifyTransactionLock(const CTransaction &tx) {
 }
 //
 
+// VELES BEGIN
+void CMainSignals::NotifyGovernanceObject(const uint256 &nHash) {
+    m_internals->m_schedulerClient.AddToProcessQueue([nHash, this] {
+        m_internals->NotifyGovernanceObject(nHash);
+    });
+}
+
+void CMainSignals::NotifyGovernanceVote(const uint256 &nHash) {
+    m_internals->m_schedulerClient.AddToProcessQueue([nHash, this] {
+        m_internals->NotifyGovernanceVote(nHash);
+    });
+}
+
+void CMainSignals::NotifyMasternodeListChanged(const COutPoint &outpoint, bool fRemoved) {
+    m_internals->m_schedulerClient.AddToProcessQueue([outpoint, fRemoved, this] {
+        m_internals->NotifyMasternodeListChanged(outpoint, fRemoved);
+    });
+}
+// VELES END
+
 void CMainSignals::ChainStateFlushed(const CBlockLocator &locator) {
     m_internals->m_schedulerClient.AddToProcessQueue([locator, this] {
         m_internals->ChainStateFlushed(locator);
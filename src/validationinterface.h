@@ -134,6 +134,15 @@ protected:
     virtual void NotifyTransactionLock(const CTransaction &tx) {}
     //
 
+    // VELES BEGIN
+    /** Notifies listeners of a new governance object. */
+    virtual void NotifyGovernanceObject(const uint256 &nHash) {}
+    /** Notifies listeners of a new governance vote. */
+    virtual void NotifyGovernanceVote(const uint256 &nHash) {}
+    /** Notifies listeners of a masternode added to or removed from the list. */
+    virtual void NotifyMasternodeListChanged(const COutPoint &outpoint, bool fRemoved) {}
+    // VELES END
+
     /**
      * Notifies listeners of the new active block chain on-disk.
      *
@@ -190,6 +199,12 @@ public:
     void FlushBackgroundCallbacks();
 
     size_t CallbacksPending();
+    // VELES BEGIN
+    /** Block until no more than nMax callbacks are pending, see -maxvalidationqueue */
+    void WaitForCallbacksPending(size_t nMax) LOCKS_EXCLUDED(cs_main);
+    size_t CallbacksPendingPeak();
+    void ResetCallbacksPendingPeak();
+    // VELES END
 
     /** Register with mempool to call TransactionRemovedFromMempool callbacks */
     void RegisterWithMempoolSignals(CTxMemPool& pool);
@@ -219,6 +234,15 @@ public:
     void NotifyTransactionLock(const CTransaction &);
     //
 
+    // VELES BEGIN
+    /** Notifies listeners of a new governance object. */
+    void NotifyGovernanceObject(const uint256 &);
+    /** Notifies listeners of a new governance vote. */
+    void NotifyGovernanceVote(const uint256 &);
+    /** Notifies listeners of a masternode added to or removed from the list. */
+    void NotifyMasternodeListChanged(const COutPoint &, bool fRemoved);
+    // VELES END
+
     void ChainStateFlushed(const CBlockLocator &);
     void Broadcast(int64_t nBestBlockTime, CConnman* connman);
     void BlockChecked(const CBlock&, const CValidationState&);
@@ -14,7 +14,10 @@
 //static const int PROTOCOL_VERSION = 70015;
 // VELES BEGIN
 //static const int PROTOCOL_VERSION = 70208;
-static const int PROTOCOL_VERSION = 80010;
+//static const int PROTOCOL_VERSION = 80010;
+//static const int PROTOCOL_VERSION = 80011;
+//static const int PROTOCOL_VERSION = 80012;
+static const int PROTOCOL_VERSION = 80013;
 // VELES END
 
 //! initial proto version, to be increased after version/verack negotiation
@@ -57,4 +60,15 @@ static const int SHORT_IDS_BLOCKS_VERSION = 70014;
 //! not banning for invalid compact blocks starts with this version
 static const int INVALID_CB_NO_BAN_VERSION = 70015;
 
+// VELES BEGIN
+//! "getmnlistd" and "mnlistdiff" masternode list diffs are supported from this version
+static const int MNLISTDIFF_VERSION = 80011;
+
+//! "sendcmphdrs" and compressed "cmpheaders" are supported from this version
+static const int CMPHEADERS_VERSION = 80012;
+
+//! "sendmnbundle" and the bundled "mnpingbundle" and "mnwbundle" are supported from this version
+static const int MNBUNDLE_VERSION = 80013;
+// VELES END
+
 #endif // BITCOIN_VERSION_H
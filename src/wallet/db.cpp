@@ -521,6 +521,11 @@ BerkeleyBatch::BerkeleyBatch(BerkeleyDatabase& database, const char* pszMode, bo
 {
     fReadOnly = (!strchr(pszMode, '+') && !strchr(pszMode, 'w'));
     fFlushOnClose = fFlushOnCloseIn;
+    // VELES BEGIN
+    // leave the flush to the periodic flusher while a run of writes is in progress
+    if (database.nFlushDeferDepth > 0)
+        fFlushOnClose = false;
+    // VELES END
     env = database.env.get();
     if (database.IsDummy()) {
         return;
@@ -170,6 +170,12 @@ public:
     unsigned int nLastSeen;
     unsigned int nLastFlushed;
     int64_t nLastWalletUpdate;
+    // VELES BEGIN
+    //! Time of the oldest update the periodic flush hasn't written yet, 0 if none
+    int64_t nFirstUnflushedUpdate = 0;
+    //! Number of live WalletFlushDeferral scopes, the batches opened meanwhile don't flush on close
+    std::atomic<int> nFlushDeferDepth{0};
+    // VELES END
 
     /**
      * Pointer to shared database environment.
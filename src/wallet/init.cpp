@@ -66,6 +66,10 @@ void WalletInit::AddWalletOptions() const
 
     gArgs.AddArg("-dblogsize=<n>", strprintf("Flush wallet database activity from memory to disk log every <n> megabytes (default: %u)", DEFAULT_WALLET_DBLOGSIZE), true, OptionsCategory::WALLET_DEBUG_TEST);
     gArgs.AddArg("-flushwallet", strprintf("Run a thread to flush wallet periodically (default: %u)", DEFAULT_FLUSHWALLET), true, OptionsCategory::WALLET_DEBUG_TEST);
+    // VELES BEGIN
+    gArgs.AddArg("-walletflushdelay=<n>", strprintf("Flush the wallet updates once the wallet was idle for <n> seconds (default: %u)", DEFAULT_WALLET_FLUSH_DELAY), true, OptionsCategory::WALLET_DEBUG_TEST);
+    gArgs.AddArg("-walletflushwindow=<n>", strprintf("Flush the wallet updates at most <n> seconds after the first one even if the wallet is never idle (default: %u)", DEFAULT_WALLET_FLUSH_WINDOW), true, OptionsCategory::WALLET_DEBUG_TEST);
+    // VELES END
     gArgs.AddArg("-privdb", strprintf("Sets the DB_PRIVATE flag in the wallet db environment (default: %u)", DEFAULT_WALLET_PRIVDB), true, OptionsCategory::WALLET_DEBUG_TEST);
     gArgs.AddArg("-walletrejectlongchains", strprintf("Wallet will not create transactions that violate mempool chain limits (default: %u)", DEFAULT_WALLET_REJECT_LONG_CHAINS), true, OptionsCategory::WALLET_DEBUG_TEST);
 }
@@ -208,7 +212,7 @@ void StartWallets(CScheduler& scheduler)
     }
 
     // Run a thread to flush wallet periodically
-    scheduler.scheduleEvery(MaybeCompactWalletDB, 500);
+    scheduler.scheduleEvery(MaybeCompactWalletDB, 500, CScheduler::PRIORITY_BACKGROUND); // VELES
 }
 
 void FlushWallets()
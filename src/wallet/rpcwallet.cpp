@@ -49,6 +49,7 @@
 #include <univalue.h>
 
 #include <functional>
+#include <sstream> // VELES
 
 static const std::string WALLET_ENDPOINT_BASE = "/wallet/";
 
@@ -1088,6 +1089,221 @@ static UniValue sendmany(const JSONRPCRequest& request)
     return tx->GetHash().GetHex();
 }
 
+// VELES BEGIN
+static const int DEFAULT_PAYOUTS_PER_TX = 1000;
+/** Payouts of a transaction of sendpayouts, so that it stays well below the standard weight with its inputs */
+static const int MAX_PAYOUTS_PER_TX = 2500;
+
+static std::string TrimPayoutField(const std::string& str)
+{
+    const size_t nBegin = str.find_first_not_of(" \t\r");
+    if (nBegin == std::string::npos) return std::string();
+    return str.substr(nBegin, str.find_last_not_of(" \t\r") - nBegin + 1);
+}
+
+/** Parse the "address,amount" lines of a payout list, empty lines and lines starting with # are skipped */
+static std::vector<CRecipient> ParsePayouts(const std::string& strPayouts, bool fSubtractFeeFromAmount)
+{
+    std::vector<CRecipient> vecPayouts;
+    std::set<CTxDestination> destinations;
+    std::istringstream stream(strPayouts);
+    std::string strLine;
+    for (int nLine = 1; std::getline(stream, strLine); nLine++) {
+        strLine = TrimPayoutField(strLine);
+        if (strLine.empty() || strLine[0] == '#') continue;
+
+        const size_t nComma = strLine.find(',');
+        if (nComma == std::string::npos) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Invalid payout on line %d, expected address,amount", nLine));
+        }
+        const std::string strAddress = TrimPayoutField(strLine.substr(0, nComma));
+        CTxDestination dest = DecodeDestination(strAddress);
+        if (!IsValidDestination(dest)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, strprintf("Invalid Veles address on line %d: %s", nLine, strAddress));
+        }
+        if (!destinations.insert(dest).second) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Invalid parameter, duplicated address on line %d: %s", nLine, strAddress));
+        }
+        CAmount nAmount;
+        if (!ParseFixedPoint(TrimPayoutField(strLine.substr(nComma + 1)), 8, &nAmount) || !MoneyRange(nAmount) || nAmount <= 0) {
+            throw JSONRPCError(RPC_TYPE_ERROR, strprintf("Invalid amount on line %d", nLine));
+        }
+        vecPayouts.push_back({GetScriptForDestination(dest), nAmount, fSubtractFeeFromAmount});
+    }
+    return vecPayouts;
+}
+
+static UniValue sendpayouts(const JSONRPCRequest& request)
+{
+    std::shared_ptr<CWallet> const wallet = GetWalletForJSONRPCRequest(request);
+    CWallet* const pwallet = wallet.get();
+
+    if (!EnsureWalletIsAvailable(pwallet, request.fHelp)) {
+        return NullUniValue;
+    }
+
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            RPCHelpMan{"sendpayouts",
+                "\nSend to a long list of addresses, like the payouts of a pool, in as many transactions as needed.\n"
+                "The coins of the wallet are listed once for all the transactions, which are funded, signed and\n"
+                "broadcast one after the other. Amounts are decimal numbers." +
+                    HelpRequiringPassphrase(pwallet) + "\n",
+                {
+                    {"payouts", RPCArg::Type::STR, RPCArg::Optional::NO, "One \"address,amount\" line per payout, with the amount in " + CURRENCY_UNIT + ".\n"
+            "                              Empty lines and lines starting with # are skipped."},
+                    {"options", RPCArg::Type::OBJ, RPCArg::Optional::OMITTED_NAMED_ARG, "",
+                        {
+                            {"minconf", RPCArg::Type::NUM, /* default */ "1", "Only use the balance confirmed at least this many times."},
+                            {"outputs_per_tx", RPCArg::Type::NUM, /* default */ strprintf("%d", DEFAULT_PAYOUTS_PER_TX), strprintf("The maximum number of payouts of a transaction, at most %d", MAX_PAYOUTS_PER_TX)},
+                            {"subtract_fee", RPCArg::Type::BOOL, /* default */ "false", "The fee of every transaction is equally deducted from its payouts"},
+                            {"use_ps", RPCArg::Type::BOOL, /* default */ "false", "Only spend PrivateSend denominated coins"},
+                            {"comment", RPCArg::Type::STR, RPCArg::Optional::OMITTED, "A comment stored with every transaction"},
+                            {"replaceable", RPCArg::Type::BOOL, /* default */ "fallback to wallet's default", "Allow the transactions to be replaced by transactions with higher fees via BIP 125"},
+                            {"conf_target", RPCArg::Type::NUM, /* default */ "fallback to wallet's default", "Confirmation target (in blocks)"},
+                            {"estimate_mode", RPCArg::Type::STR, /* default */ "UNSET", "The fee estimate mode, must be one of:\n"
+            "         \"UNSET\"\n"
+            "         \"ECONOMICAL\"\n"
+            "         \"CONSERVATIVE\""},
+                        },
+                        "options"},
+                },
+                RPCResult{
+            "{\n"
+            "  \"txids\": [ \"txid\", ... ],  (array of string) The ids of the transactions, in the order of the payouts\n"
+            "  \"fee\": n                     (numeric) The fee of all the transactions in " + CURRENCY_UNIT + "\n"
+            "}\n"
+                },
+                RPCExamples{
+                    HelpExampleCli("sendpayouts", "\"$(cat payouts.csv)\" '{\"outputs_per_tx\": 500}'")
+            + HelpExampleRpc("sendpayouts", "\"fExDspm4Jxk6NcLmwm2gDBREYngUn4QhbA,0.01\\nFXnUtN5uNimyWjnxzKgdeoqUGybxhrndLA,0.02\"")
+                },
+            }.ToString());
+
+    RPCTypeCheck(request.params, {UniValue::VSTR, UniValue::VOBJ});
+
+    int nMinDepth = 1;
+    int nPayoutsPerTx = DEFAULT_PAYOUTS_PER_TX;
+    bool fSubtractFeeFromAmount = false;
+    bool fUsePrivateSend = false;
+    mapValue_t mapValue;
+    CCoinControl coin_control;
+    if (!request.params[1].isNull()) {
+        const UniValue& options = request.params[1];
+        RPCTypeCheckObj(options,
+            {
+                {"minconf", UniValueType(UniValue::VNUM)},
+                {"outputs_per_tx", UniValueType(UniValue::VNUM)},
+                {"subtract_fee", UniValueType(UniValue::VBOOL)},
+                {"use_ps", UniValueType(UniValue::VBOOL)},
+                {"comment", UniValueType(UniValue::VSTR)},
+                {"replaceable", UniValueType(UniValue::VBOOL)},
+                {"conf_target", UniValueType(UniValue::VNUM)},
+                {"estimate_mode", UniValueType(UniValue::VSTR)},
+            },
+            true, true);
+
+        if (options.exists("minconf")) {
+            nMinDepth = options["minconf"].get_int();
+        }
+        if (options.exists("outputs_per_tx")) {
+            nPayoutsPerTx = options["outputs_per_tx"].get_int();
+            if (nPayoutsPerTx < 1 || nPayoutsPerTx > MAX_PAYOUTS_PER_TX) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Invalid outputs_per_tx, must be between 1 and %d", MAX_PAYOUTS_PER_TX));
+            }
+        }
+        if (options.exists("subtract_fee")) {
+            fSubtractFeeFromAmount = options["subtract_fee"].get_bool();
+        }
+        if (options.exists("use_ps")) {
+            fUsePrivateSend = options["use_ps"].get_bool();
+        }
+        if (options.exists("comment") && !options["comment"].get_str().empty()) {
+            mapValue["comment"] = options["comment"].get_str();
+        }
+        if (options.exists("replaceable")) {
+            coin_control.m_signal_bip125_rbf = options["replaceable"].get_bool();
+        }
+        if (options.exists("conf_target")) {
+            coin_control.m_confirm_target = ParseConfirmTarget(options["conf_target"]);
+        }
+        if (options.exists("estimate_mode")) {
+            if (!FeeModeFromString(options["estimate_mode"].get_str(), coin_control.m_fee_mode)) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid estimate_mode parameter");
+            }
+        }
+    }
+
+    std::vector<CRecipient> vecPayouts = ParsePayouts(request.params[0].get_str(), fSubtractFeeFromAmount);
+    if (vecPayouts.empty()) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "No payouts");
+    }
+    CAmount nTotalAmount = 0;
+    for (const CRecipient& payout : vecPayouts) {
+        nTotalAmount += payout.nAmount;
+    }
+
+    // Make sure the results are valid at least up to the most recent block
+    // the user could have gotten from another RPC command prior to now
+    pwallet->BlockUntilSyncedToCurrentChain();
+
+    auto locked_chain = pwallet->chain().lock();
+    LOCK(pwallet->cs_wallet);
+
+    if (pwallet->GetBroadcastTransactions() && !g_connman) {
+        throw JSONRPCError(RPC_CLIENT_P2P_DISABLED, "Error: Peer-to-peer functionality missing or disabled");
+    }
+
+    EnsureWalletIsUnlocked(pwallet);
+
+    // Check funds
+    if (!MoneyRange(nTotalAmount) || nTotalAmount > pwallet->GetLegacyBalance(ISMINE_SPENDABLE, nMinDepth)) {
+        throw JSONRPCError(RPC_WALLET_INSUFFICIENT_FUNDS, "Wallet has insufficient funds");
+    }
+
+    // The coins are listed once, the inputs of every transaction are then removed from the list
+    std::vector<COutput> vAvailableCoins;
+    pwallet->AvailableCoins(*locked_chain, vAvailableCoins, true, &coin_control);
+
+    UniValue txids(UniValue::VARR);
+    CAmount nFeeTotal = 0;
+    FastRandomContext rng;
+    for (size_t nStart = 0; nStart < vecPayouts.size(); nStart += nPayoutsPerTx) {
+        std::vector<CRecipient> vecSend(vecPayouts.begin() + nStart, vecPayouts.begin() + std::min(nStart + nPayoutsPerTx, vecPayouts.size()));
+        std::shuffle(vecSend.begin(), vecSend.end(), rng);
+
+        CReserveKey keyChange(pwallet);
+        CAmount nFeeRequired = 0;
+        int nChangePosRet = -1;
+        std::string strFailReason;
+        CTransactionRef tx;
+        if (!pwallet->CreateTransaction(*locked_chain, vecSend, tx, keyChange, nFeeRequired, nChangePosRet, strFailReason, coin_control, true,
+                                        fUsePrivateSend ? ONLY_DENOMINATED : ALL_COINS, false, &vAvailableCoins)) {
+            throw JSONRPCError(RPC_WALLET_INSUFFICIENT_FUNDS, strprintf("%s (after %u transactions sent)", strFailReason, txids.size()));
+        }
+        CValidationState state;
+        if (!pwallet->CommitTransaction(tx, mapValue, {} /* orderForm */, keyChange, g_connman.get(), state)) {
+            throw JSONRPCError(RPC_WALLET_ERROR, strprintf("Transaction commit failed:: %s (after %u transactions sent)", FormatStateMessage(state), txids.size()));
+        }
+        txids.push_back(tx->GetHash().GetHex());
+        nFeeTotal += nFeeRequired;
+
+        std::set<COutPoint> setSpent;
+        for (const CTxIn& txin : tx->vin) {
+            setSpent.insert(txin.prevout);
+        }
+        vAvailableCoins.erase(std::remove_if(vAvailableCoins.begin(), vAvailableCoins.end(), [&setSpent](const COutput& out) {
+            return setSpent.count(COutPoint(out.tx->GetHash(), out.i)) > 0;
+        }), vAvailableCoins.end());
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("txids", txids);
+    result.pushKV("fee", ValueFromAmount(nFeeTotal));
+    return result;
+}
+// VELES END
+
 static UniValue addmultisigaddress(const JSONRPCRequest& request)
 {
     std::shared_ptr<CWallet> const wallet = GetWalletForJSONRPCRequest(request);
@@ -4382,6 +4598,7 @@ static const CRPCCommand commands[] =
     { "wallet",             "removeprunedfunds",                &removeprunedfunds,             {"txid"} },
     { "wallet",             "rescanblockchain",                 &rescanblockchain,              {"start_height", "stop_height"} },
     { "wallet",             "sendmany",                         &sendmany,                      {"dummy","amounts","minconf","comment","subtractfeefrom","replaceable","conf_target","estimate_mode"} },
+    { "wallet",             "sendpayouts",                      &sendpayouts,                   {"payouts","options"} }, // VELES
     { "wallet",             "sendtoaddress",                    &sendtoaddress,                 {"address","amount","comment","comment_to","subtractfeefromamount","replaceable","conf_target","estimate_mode"} },
     { "wallet",             "sethdseed",                        &sethdseed,                     {"newkeypool","seed"} },
     { "wallet",             "setlabel",                         &setlabel,                      {"address","label"} },
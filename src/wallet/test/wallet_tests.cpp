@@ -18,6 +18,7 @@
 #include <wallet/coincontrol.h>
 #include <wallet/test/wallet_test_fixture.h>
 #include <policy/policy.h>
+#include <privatesend.h> // VELES
 
 #include <boost/test/unit_test.hpp>
 #include <univalue.h>
@@ -448,6 +449,194 @@ BOOST_FIXTURE_TEST_CASE(ListCoins, ListCoinsTestingSetup)
     BOOST_CHECK_EQUAL(list.begin()->second.size(), 1U);
 }
 
+// VELES BEGIN
+// The cached balance totals stay right across new blocks, as the coinbases of
+// the wallet reach maturity, without being dropped at every block
+BOOST_FIXTURE_TEST_CASE(balance_cache_new_blocks, ListCoinsTestingSetup)
+{
+    auto check_balances = [&]() {
+        const CAmount nBalance = wallet->GetBalance();
+        const CAmount nDeepBalance = wallet->GetBalance(ISMINE_SPENDABLE, 10);
+        const CAmount nImmature = wallet->GetImmatureBalance();
+        wallet->InvalidateBalanceCache();
+        BOOST_CHECK_EQUAL(nBalance, wallet->GetBalance());
+        BOOST_CHECK_EQUAL(nDeepBalance, wallet->GetBalance(ISMINE_SPENDABLE, 10));
+        BOOST_CHECK_EQUAL(nImmature, wallet->GetImmatureBalance());
+    };
+
+    check_balances();
+    const CAmount nBalanceBefore = wallet->GetBalance();
+    for (int i = 0; i < COINBASE_MATURITY_850k - chainActive.Height() + 3; i++) {
+        const CBlock block = CreateAndProcessBlock({}, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+        wallet->BlockConnected(std::make_shared<const CBlock>(block), chainActive.Tip(), {});
+        check_balances();
+    }
+    // The first coinbases of the wallet matured meanwhile
+    BOOST_CHECK(wallet->GetBalance() > nBalanceBefore);
+}
+
+// The mixing sessions find their denominated inputs by denomination and rounds
+BOOST_FIXTURE_TEST_CASE(denominated_coins_index, ListCoinsTestingSetup)
+{
+    CPrivateSend::InitStandardDenominations();
+    const std::vector<CAmount> vecDenoms = CPrivateSend::GetStandardDenominations();
+    const CAmount nDenomValue = vecDenoms[2];
+    const CScript script = GetScriptForRawPubKey(coinbaseKey.GetPubKey());
+
+    // Two denominated outputs and the change, in a new block
+    {
+        CTransactionRef tx;
+        CReserveKey reservekey(wallet.get());
+        CAmount fee;
+        int changePos = -1;
+        std::string error;
+        CCoinControl dummy;
+        BOOST_CHECK(wallet->CreateTransaction(*m_locked_chain, {{script, nDenomValue, false}, {script, nDenomValue, false}}, tx, reservekey, fee, changePos, error, dummy));
+        CValidationState state;
+        BOOST_CHECK(wallet->CommitTransaction(tx, {}, {}, reservekey, nullptr, state));
+        CreateAndProcessBlock({CMutableTransaction(*tx)}, script);
+        LOCK(wallet->cs_wallet);
+        wallet->mapWallet.at(tx->GetHash()).SetMerkleBranch(chainActive.Tip()->GetBlockHash(), 1);
+    }
+
+    std::vector<CTxDSIn> vecTxDSIn;
+    std::vector<COutput> vCoins;
+    CAmount nValue;
+    // Both are found, with no round as the transaction has a change
+    std::vector<CTxIn> vecTxIn;
+    BOOST_CHECK(wallet->SelectCoinsDark(nDenomValue, 100 * COIN, vecTxIn, nValue, 0, 2));
+    BOOST_CHECK_EQUAL(vecTxIn.size(), 2U);
+    BOOST_CHECK_EQUAL(nValue, 2 * nDenomValue);
+    BOOST_CHECK(wallet->SelectCoinsByDenominations(1 << 2, nDenomValue, 100 * COIN, vecTxDSIn, vCoins, nValue, 0, 2));
+    BOOST_CHECK(!vCoins.empty());
+    for (const COutput& out : vCoins)
+        BOOST_CHECK_EQUAL(out.tx->tx->vout[out.i].nValue, nDenomValue);
+    // None of another denomination or with more rounds
+    BOOST_CHECK(!wallet->SelectCoinsByDenominations(1 << 1, vecDenoms[1], 100 * COIN, vecTxDSIn, vCoins, nValue, 0, 2));
+    BOOST_CHECK(!wallet->SelectCoinsByDenominations(1 << 2, nDenomValue, 100 * COIN, vecTxDSIn, vCoins, nValue, 1, 2));
+
+    // A locked coin is left to the session which locked it
+    {
+        LOCK(wallet->cs_wallet);
+        wallet->LockCoin(vecTxIn[0].prevout);
+    }
+    BOOST_CHECK(wallet->SelectCoinsDark(nDenomValue, 100 * COIN, vecTxIn, nValue, 0, 2));
+    BOOST_CHECK_EQUAL(vecTxIn.size(), 1U);
+    {
+        LOCK(wallet->cs_wallet);
+        wallet->UnlockAllCoins();
+    }
+
+    // New coins are sorted on the next selection, spent ones are dropped
+    {
+        CTransactionRef tx;
+        CReserveKey reservekey(wallet.get());
+        CAmount fee;
+        int changePos = -1;
+        std::string error;
+        CCoinControl coinControl;
+        coinControl.fAllowOtherInputs = true;
+        coinControl.Select(vecTxIn[0].prevout);
+        BOOST_CHECK(wallet->CreateTransaction(*m_locked_chain, {{script, vecDenoms[3], false}}, tx, reservekey, fee, changePos, error, coinControl));
+        CValidationState state;
+        BOOST_CHECK(wallet->CommitTransaction(tx, {}, {}, reservekey, nullptr, state));
+        CreateAndProcessBlock({CMutableTransaction(*tx)}, script);
+        LOCK(wallet->cs_wallet);
+        wallet->mapWallet.at(tx->GetHash()).SetMerkleBranch(chainActive.Tip()->GetBlockHash(), 1);
+    }
+    BOOST_CHECK(wallet->SelectCoinsDark(vecDenoms[3], 100 * COIN, vecTxIn, nValue, 0, 2));
+    std::vector<COutput> vAvailable;
+    {
+        LOCK2(cs_main, wallet->cs_wallet);
+        wallet->AvailableCoins(*m_locked_chain, vAvailable, true, nullptr, false, ONLY_DENOMINATED);
+    }
+    BOOST_CHECK_EQUAL(vecTxIn.size(), vAvailable.size());
+    BOOST_CHECK(wallet->SelectCoinsByDenominations(1 << 3, vecDenoms[3], 100 * COIN, vecTxDSIn, vCoins, nValue, 0, 2));
+}
+
+// The keys of a keypool top-up are the ones of the sequential HD derivation
+BOOST_FIXTURE_TEST_CASE(keypool_topup_hd_derivation, TestChain100Setup)
+{
+    auto chain = interfaces::MakeChain();
+    std::shared_ptr<CWallet> wallet = std::make_shared<CWallet>(*chain, WalletLocation(), WalletDatabase::CreateDummy());
+    wallet->SetMinVersion(FEATURE_LATEST);
+    LOCK(wallet->cs_wallet);
+    wallet->SetHDSeed(wallet->GenerateNewSeed());
+    BOOST_CHECK(wallet->TopUpKeyPool(300));
+    BOOST_CHECK_EQUAL(wallet->KeypoolCountExternalKeys(), 300U);
+    BOOST_CHECK_EQUAL(wallet->GetHDChain().nExternalChainCounter, 300U);
+    BOOST_CHECK_EQUAL(wallet->GetHDChain().nInternalChainCounter, 300U);
+
+    const uint32_t nHardened = 0x80000000;
+    CKey seed;
+    BOOST_CHECK(wallet->GetKey(wallet->GetHDChain().seed_id, seed));
+    CExtKey masterKey, accountKey, chainKeys[2], childKey;
+    masterKey.SetSeed(seed.begin(), seed.size());
+    masterKey.Derive(accountKey, nHardened);
+    for (int internal = 0; internal < 2; internal++) {
+        accountKey.Derive(chainKeys[internal], nHardened + internal);
+        for (uint32_t i = 0; i < 300; i++) {
+            chainKeys[internal].Derive(childKey, i | nHardened);
+            const CKeyID keyid = childKey.key.GetPubKey().GetID();
+            CKey key;
+            BOOST_CHECK(wallet->GetKey(keyid, key));
+            BOOST_CHECK(key == childKey.key);
+            BOOST_CHECK_EQUAL(wallet->mapKeyMetadata.at(keyid).hdKeypath, strprintf("m/0'/%d'/%d'", internal, i));
+        }
+    }
+}
+
+// The transactions are only passed to the wallets they may concern
+BOOST_FIXTURE_TEST_CASE(wallet_tx_filter, TestChain100Setup)
+{
+    auto chain = interfaces::MakeChain();
+    std::shared_ptr<CWallet> walletA = std::make_shared<CWallet>(*chain, WalletLocation(), WalletDatabase::CreateDummy());
+    std::shared_ptr<CWallet> walletB = std::make_shared<CWallet>(*chain, WalletLocation(), WalletDatabase::CreateDummy());
+    CKey keyA, keyB;
+    keyA.MakeNewKey(true);
+    keyB.MakeNewKey(true);
+    AddKey(*walletA, keyA);
+    const CScript scriptB = GetScriptForDestination(WitnessV0KeyHash(keyB.GetPubKey().GetID()));
+    {
+        LOCK(walletB->cs_wallet);
+        walletB->AddWatchOnly(scriptB, 0);
+    }
+
+    CMutableTransaction txToA;
+    txToA.vin.emplace_back(InsecureRand256(), 0);
+    txToA.vout.emplace_back(COIN, GetScriptForDestination(keyA.GetPubKey().GetID()));
+    BOOST_CHECK(g_wallet_tx_filter.MayConcern(walletA.get(), CTransaction(txToA)));
+    BOOST_CHECK(!g_wallet_tx_filter.MayConcern(walletB.get(), CTransaction(txToA)));
+
+    CMutableTransaction txToB;
+    txToB.vin.emplace_back(InsecureRand256(), 0);
+    txToB.vout.emplace_back(COIN, scriptB);
+    BOOST_CHECK(!g_wallet_tx_filter.MayConcern(walletA.get(), CTransaction(txToB)));
+    BOOST_CHECK(g_wallet_tx_filter.MayConcern(walletB.get(), CTransaction(txToB)));
+
+    // Spending from a wallet transaction, or conflicting with it
+    CMutableTransaction txSpend;
+    txSpend.vin.emplace_back(txToA.GetHash(), 0);
+    txSpend.vout.emplace_back(COIN, CScript() << OP_TRUE);
+    CMutableTransaction txConflict;
+    txConflict.vin.push_back(txToA.vin[0]);
+    txConflict.vout.emplace_back(COIN, CScript() << OP_TRUE);
+    BOOST_CHECK(!g_wallet_tx_filter.MayConcern(walletA.get(), CTransaction(txSpend)));
+    {
+        LOCK(walletA->cs_wallet);
+        walletA->LoadToWallet(CWalletTx(walletA.get(), MakeTransactionRef(txToA)));
+    }
+    BOOST_CHECK(g_wallet_tx_filter.MayConcern(walletA.get(), CTransaction(txSpend)));
+    BOOST_CHECK(g_wallet_tx_filter.MayConcern(walletA.get(), CTransaction(txConflict)));
+    BOOST_CHECK(!g_wallet_tx_filter.MayConcern(walletB.get(), CTransaction(txSpend)));
+
+    // Unloaded wallets are forgotten
+    const CWallet* pwalletA = walletA.get();
+    walletA.reset();
+    BOOST_CHECK(!g_wallet_tx_filter.MayConcern(pwalletA, CTransaction(txToA)));
+}
+// VELES END
+
 BOOST_FIXTURE_TEST_CASE(wallet_disableprivkeys, TestChain100Setup)
 {
     auto chain = interfaces::MakeChain();
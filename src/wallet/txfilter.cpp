@@ -0,0 +1,157 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <wallet/txfilter.h>
+
+#include <crypto/ripemd160.h>
+#include <crypto/siphash.h>
+#include <pubkey.h>
+#include <primitives/transaction.h>
+#include <random.h>
+#include <script/standard.h>
+
+#include <algorithm>
+#include <limits>
+
+CWalletTxFilter g_wallet_tx_filter;
+
+CWalletTxFilter::SaltedIdHasher::SaltedIdHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+size_t CWalletTxFilter::SaltedIdHasher::operator()(const uint160& id) const
+{
+    return CSipHasher(k0, k1).Write(id.begin(), id.size()).Finalize();
+}
+
+size_t CWalletTxFilter::SaltedIdHasher::operator()(const uint256& txid) const
+{
+    return SipHashUint256(k0, k1, txid);
+}
+
+bool CWalletTxFilter::Add(WalletList& vWallets, const CWallet* pwallet)
+{
+    if (std::find(vWallets.begin(), vWallets.end(), pwallet) != vWallets.end())
+        return false;
+    vWallets.push_back(pwallet);
+    // the recent transactions may concern the wallet now
+    mapRecent.clear();
+    return true;
+}
+
+void CWalletTxFilter::AddKey(const CWallet* pwallet, const uint160& keyid)
+{
+    LOCK(cs);
+    Add(mapIds[keyid], pwallet);
+}
+
+void CWalletTxFilter::AddScript(const CWallet* pwallet, const uint160& scriptid)
+{
+    LOCK(cs);
+    Add(mapIds[scriptid], pwallet);
+}
+
+void CWalletTxFilter::AddWatchOnly(const CWallet* pwallet, const CScript& script)
+{
+    LOCK(cs);
+    if (Add(mapIds[CScriptID(script)], pwallet))
+        nWatchOnly++;
+}
+
+void CWalletTxFilter::AddTx(const CWallet* pwallet, const CTransaction& tx)
+{
+    LOCK(cs);
+    Add(mapTxs[tx.GetHash()], pwallet);
+    // the transactions conflicting with it spend the same outputs
+    if (!tx.IsCoinBase()) {
+        for (const CTxIn& txin : tx.vin) {
+            Add(mapTxs[txin.prevout.hash], pwallet);
+        }
+    }
+}
+
+void CWalletTxFilter::RemoveWallet(const CWallet* pwallet)
+{
+    LOCK(cs);
+    for (auto it = mapIds.begin(); it != mapIds.end();) {
+        it->second.erase(std::remove(it->second.begin(), it->second.end(), pwallet), it->second.end());
+        it = it->second.empty() ? mapIds.erase(it) : std::next(it);
+    }
+    for (auto it = mapTxs.begin(); it != mapTxs.end();) {
+        it->second.erase(std::remove(it->second.begin(), it->second.end(), pwallet), it->second.end());
+        it = it->second.empty() ? mapTxs.erase(it) : std::next(it);
+    }
+    mapRecent.clear();
+}
+
+bool CWalletTxFilter::MayConcern(const CWallet* pwallet, const CTransaction& tx)
+{
+    LOCK(cs);
+    auto itRecent = mapRecent.find(tx.GetHash());
+    if (itRecent == mapRecent.end()) {
+        WalletList vWallets;
+        auto add = [&](const WalletList& vFound) {
+            for (const CWallet* pwalletFound : vFound) {
+                if (std::find(vWallets.begin(), vWallets.end(), pwalletFound) == vWallets.end())
+                    vWallets.push_back(pwalletFound);
+            }
+        };
+
+        // the transaction itself, or one spending from or conflicting with a wallet transaction
+        auto itTx = mapTxs.find(tx.GetHash());
+        if (itTx != mapTxs.end()) add(itTx->second);
+        if (!tx.IsCoinBase()) {
+            for (const CTxIn& txin : tx.vin) {
+                itTx = mapTxs.find(txin.prevout.hash);
+                if (itTx != mapTxs.end()) add(itTx->second);
+            }
+        }
+
+        // or one paying to the wallet
+        std::vector<uint160> vIds;
+        for (const CTxOut& txout : tx.vout) {
+            vIds.clear();
+            GetScriptIds(txout.scriptPubKey, nWatchOnly > 0, vIds);
+            for (const uint160& id : vIds) {
+                auto itId = mapIds.find(id);
+                if (itId != mapIds.end()) add(itId->second);
+            }
+        }
+
+        if (mapRecent.size() >= MAX_WALLET_TX_FILTER_RECENT)
+            mapRecent.clear();
+        itRecent = mapRecent.emplace(tx.GetHash(), std::move(vWallets)).first;
+    }
+    return std::find(itRecent->second.begin(), itRecent->second.end(), pwallet) != itRecent->second.end();
+}
+
+void CWalletTxFilter::GetScriptIds(const CScript& script, bool fWholeScript, std::vector<uint160>& vIdsRet)
+{
+    if (fWholeScript)
+        vIdsRet.push_back(CScriptID(script));
+
+    // the same IDs as IsMine() looks up in the key store
+    std::vector<std::vector<unsigned char>> vSolutions;
+    switch (Solver(script, vSolutions)) {
+    case TX_PUBKEY:
+        vIdsRet.push_back(CPubKey(vSolutions[0]).GetID());
+        break;
+    case TX_PUBKEYHASH:
+    case TX_SCRIPTHASH:
+    case TX_WITNESS_V0_KEYHASH:
+        vIdsRet.push_back(uint160(vSolutions[0]));
+        break;
+    case TX_WITNESS_V0_SCRIPTHASH: {
+        uint160 hash;
+        CRIPEMD160().Write(vSolutions[0].data(), vSolutions[0].size()).Finalize(hash.begin());
+        vIdsRet.push_back(hash);
+        break;
+    }
+    case TX_MULTISIG:
+        for (size_t i = 1; i + 1 < vSolutions.size(); i++) {
+            vIdsRet.push_back(CPubKey(vSolutions[i]).GetID());
+        }
+        break;
+    default:
+        break;
+    }
+}
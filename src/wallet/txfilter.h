@@ -0,0 +1,76 @@
+// Copyright (c) 2019 The Veles Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef VELES_WALLET_TXFILTER_H
+#define VELES_WALLET_TXFILTER_H
+
+#include <sync.h>
+#include <uint256.h>
+
+#include <unordered_map>
+#include <vector>
+
+class CScript;
+class CTransaction;
+class CWallet;
+
+/** Number of transactions the wallets they concern are remembered for */
+static const size_t MAX_WALLET_TX_FILTER_RECENT = 20000;
+
+/**
+ * Node level prefilter of the transactions notified to the loaded wallets.
+ *
+ * Every wallet registers the 160 bit IDs its outputs can be matched by, i.e.
+ * the IDs of its keys, redeem scripts and watch-only scripts, and the
+ * transactions it holds or spends from. The IDs of a transaction are
+ * extracted once and looked up for all the wallets together, the result is
+ * kept until the wallets registered anything new, so with many wallets each
+ * of them only runs its own checks on the transactions that could concern
+ * it. The index is exact: a wallet is never skipped for a transaction it is
+ * involved in, and nothing is removed from it but whole wallets.
+ */
+class CWalletTxFilter
+{
+private:
+    class SaltedIdHasher
+    {
+    private:
+        const uint64_t k0, k1;
+
+    public:
+        SaltedIdHasher();
+        size_t operator()(const uint160& id) const;
+        size_t operator()(const uint256& txid) const;
+    };
+
+    typedef std::vector<const CWallet*> WalletList;
+
+    CCriticalSection cs;
+    std::unordered_map<uint160, WalletList, SaltedIdHasher> mapIds GUARDED_BY(cs);
+    std::unordered_map<uint256, WalletList, SaltedIdHasher> mapTxs GUARDED_BY(cs);
+    //! Wallets concerned by the recently checked transactions
+    std::unordered_map<uint256, WalletList, SaltedIdHasher> mapRecent GUARDED_BY(cs);
+    //! Whether the whole output scripts have to be looked up
+    size_t nWatchOnly GUARDED_BY(cs) = 0;
+
+    bool Add(WalletList& vWallets, const CWallet* pwallet) EXCLUSIVE_LOCKS_REQUIRED(cs);
+
+public:
+    void AddKey(const CWallet* pwallet, const uint160& keyid);
+    void AddScript(const CWallet* pwallet, const uint160& scriptid);
+    void AddWatchOnly(const CWallet* pwallet, const CScript& script);
+    /** A transaction of the wallet, registers it and the ones it spends from */
+    void AddTx(const CWallet* pwallet, const CTransaction& tx);
+    void RemoveWallet(const CWallet* pwallet);
+
+    /** False when the transaction can't concern the wallet */
+    bool MayConcern(const CWallet* pwallet, const CTransaction& tx);
+
+    /** The key and script IDs an output script is matched by */
+    static void GetScriptIds(const CScript& script, bool fWholeScript, std::vector<uint160>& vIdsRet);
+};
+
+extern CWalletTxFilter g_wallet_tx_filter;
+
+#endif // VELES_WALLET_TXFILTER_H
@@ -42,6 +42,13 @@
 #include <algorithm>
 #include <assert.h>
 #include <future>
+// VELES BEGIN
+#include <checkqueue.h>
+
+#include <condition_variable>
+#include <deque>
+#include <thread>
+// VELES END
 
 #include <boost/algorithm/string/replace.hpp>
 
@@ -183,8 +190,9 @@ std::string COutput::ToString() const
 // Dash
 int COutput::Priority() const
 {
-    for (CAmount d : CPrivateSend::GetStandardDenominations())
-        if(tx->tx->vout[i].nValue == d) return 10000;
+    //for (CAmount d : CPrivateSend::GetStandardDenominations())
+    //    if(tx->tx->vout[i].nValue == d) return 10000;
+    if(CPrivateSend::IsDenominatedAmount(tx->tx->vout[i].nValue)) return 10000; // VELES
     if(tx->tx->vout[i].nValue < 1*COIN) return 20000;
 
     //nondenom return largest first
@@ -305,6 +313,93 @@ void CWallet::DeriveNewChildKey(WalletBatch &batch, CKeyMetadata& metadata, CKey
         throw std::runtime_error(std::string(__func__) + ": Writing HD chain model failed");
 }
 
+// VELES BEGIN
+void CWallet::DeriveNewChildKeys(WalletBatch &batch, int64_t nCount, bool internal, std::vector<CPubKey>& vPubKeysRet)
+{
+    AssertLockHeld(cs_wallet); // mapKeyMetadata
+    vPubKeysRet.clear();
+    if (nCount <= 0)
+        return;
+
+    // same fixed keypath scheme of m/0'/0'/k as DeriveNewChildKey
+    CKey seed;
+    CExtKey masterKey;
+    CExtKey accountKey;
+    CExtKey chainChildKey;
+
+    if (!GetKey(hdChain.seed_id, seed))
+        throw std::runtime_error(std::string(__func__) + ": seed not found");
+
+    masterKey.SetSeed(seed.begin(), seed.size());
+    masterKey.Derive(accountKey, BIP32_HARDENED_KEY_LIMIT);
+    assert(internal ? CanSupportFeature(FEATURE_HD_SPLIT) : true);
+    accountKey.Derive(chainChildKey, BIP32_HARDENED_KEY_LIMIT+(internal ? 1 : 0));
+    const CKeyID master_id = masterKey.key.GetPubKey().GetID();
+
+    const int64_t nCreationTime = GetTime();
+    uint32_t& nChainCounter = internal ? hdChain.nInternalChainCounter : hdChain.nExternalChainCounter;
+    while ((int64_t)vPubKeysRet.size() < nCount) {
+        // The child keys only depend on their index, each thread derives a
+        // contiguous range of them along with their public keys
+        const int64_t nKeys = nCount - vPubKeysRet.size();
+        const uint32_t nFirst = nChainCounter;
+        std::vector<CKey> vKeys(nKeys);
+        std::vector<CPubKey> vPubKeys(nKeys);
+        const int nThreads = std::max(1, std::min<int>(GetNumCores(), nKeys / 64 + 1));
+        auto derive = [&](int nThread) {
+            CExtKey childKey;
+            for (int64_t i = nKeys * nThread / nThreads; i < nKeys * (nThread + 1) / nThreads; i++) {
+                chainChildKey.Derive(childKey, (nFirst + i) | BIP32_HARDENED_KEY_LIMIT);
+                vKeys[i] = childKey.key;
+                vPubKeys[i] = childKey.key.GetPubKey();
+                assert(vKeys[i].VerifyPubKey(vPubKeys[i]));
+            }
+        };
+        if (nThreads == 1) {
+            derive(0);
+        } else {
+            std::vector<std::thread> vThreads;
+            for (int i = 0; i < nThreads; i++) {
+                vThreads.emplace_back(&TraceThread<std::function<void()>>, "keypool", std::bind(derive, i));
+            }
+            for (std::thread& thread : vThreads) {
+                thread.join();
+            }
+        }
+
+        // Add them in order, skipping the keys already known to the wallet
+        for (int64_t i = 0; i < nKeys; i++) {
+            const uint32_t nChild = nChainCounter++;
+            if (HaveKey(vPubKeys[i].GetID()))
+                continue;
+
+            CKeyMetadata metadata(nCreationTime);
+            metadata.hdKeypath = std::string(internal ? "m/0'/1'/" : "m/0'/0'/") + std::to_string(nChild) + "'";
+            metadata.key_origin.path.push_back(0 | BIP32_HARDENED_KEY_LIMIT);
+            metadata.key_origin.path.push_back((internal ? 1 : 0) | BIP32_HARDENED_KEY_LIMIT);
+            metadata.key_origin.path.push_back(nChild | BIP32_HARDENED_KEY_LIMIT);
+            metadata.hd_seed_id = hdChain.seed_id;
+            std::copy(master_id.begin(), master_id.begin() + 4, metadata.key_origin.fingerprint);
+            metadata.has_key_origin = true;
+            mapKeyMetadata[vPubKeys[i].GetID()] = metadata;
+
+            if (!AddKeyPubKeyWithDB(batch, vKeys[i], vPubKeys[i])) {
+                throw std::runtime_error(std::string(__func__) + ": AddKey failed");
+            }
+            vPubKeysRet.push_back(vPubKeys[i]);
+        }
+    }
+
+    // HD keys are always compressed
+    SetMinVersion(FEATURE_COMPRPUBKEY);
+    UpdateTimeFirstKey(nCreationTime);
+
+    // update the chain model in the database, once for all the keys
+    if (!batch.WriteHDChain(hdChain))
+        throw std::runtime_error(std::string(__func__) + ": Writing HD chain model failed");
+}
+// VELES END
+
 bool CWallet::AddKeyPubKeyWithDB(WalletBatch &batch, const CKey& secret, const CPubKey &pubkey)
 {
     AssertLockHeld(cs_wallet); // mapKeyMetadata
@@ -324,6 +419,7 @@ bool CWallet::AddKeyPubKeyWithDB(WalletBatch &batch, const CKey& secret, const C
         return false;
     }
     if (needsDB) encrypted_batch = nullptr;
+    g_wallet_tx_filter.AddKey(this, pubkey.GetID()); // VELES
 
     // check if we need to remove from watch-only
     CScript script;
@@ -356,6 +452,7 @@ bool CWallet::AddCryptedKey(const CPubKey &vchPubKey,
 {
     if (!CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret))
         return false;
+    g_wallet_tx_filter.AddKey(this, vchPubKey.GetID()); // VELES
     {
         LOCK(cs_wallet);
         if (encrypted_batch)
@@ -433,7 +530,13 @@ void CWallet::UpgradeKeyMetadata()
 
 bool CWallet::LoadCryptedKey(const CPubKey &vchPubKey, const std::vector<unsigned char> &vchCryptedSecret)
 {
-    return CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret);
+    //return CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret);
+    // VELES BEGIN
+    if (!CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret))
+        return false;
+    g_wallet_tx_filter.AddKey(this, vchPubKey.GetID());
+    return true;
+    // VELES END
 }
 
 /**
@@ -456,6 +559,7 @@ bool CWallet::AddCScript(const CScript& redeemScript)
 {
     if (!CCryptoKeyStore::AddCScript(redeemScript))
         return false;
+    g_wallet_tx_filter.AddScript(this, CScriptID(redeemScript)); // VELES
     if (WalletBatch(*database).WriteCScript(Hash160(redeemScript), redeemScript)) {
         UnsetWalletFlag(WALLET_FLAG_BLANK_WALLET);
         return true;
@@ -475,13 +579,20 @@ bool CWallet::LoadCScript(const CScript& redeemScript)
         return true;
     }
 
-    return CCryptoKeyStore::AddCScript(redeemScript);
+    //return CCryptoKeyStore::AddCScript(redeemScript);
+    // VELES BEGIN
+    if (!CCryptoKeyStore::AddCScript(redeemScript))
+        return false;
+    g_wallet_tx_filter.AddScript(this, CScriptID(redeemScript));
+    return true;
+    // VELES END
 }
 
 bool CWallet::AddWatchOnly(const CScript& dest)
 {
     if (!CCryptoKeyStore::AddWatchOnly(dest))
         return false;
+    g_wallet_tx_filter.AddWatchOnly(this, dest); // VELES
     const CKeyMetadata& meta = m_script_metadata[CScriptID(dest)];
     UpdateTimeFirstKey(meta.nCreateTime);
     NotifyWatchonlyChanged(true);
@@ -513,7 +624,13 @@ bool CWallet::RemoveWatchOnly(const CScript &dest)
 
 bool CWallet::LoadWatchOnly(const CScript &dest)
 {
-    return CCryptoKeyStore::AddWatchOnly(dest);
+    //return CCryptoKeyStore::AddWatchOnly(dest);
+    // VELES BEGIN
+    if (!CCryptoKeyStore::AddWatchOnly(dest))
+        return false;
+    g_wallet_tx_filter.AddWatchOnly(this, dest);
+    return true;
+    // VELES END
 }
 
 // Dash
@@ -751,12 +868,93 @@ void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
     SyncMetaData(range);
 }
 
+// VELES BEGIN
+void CWallet::AddToCoinsIndex(const COutPoint& outpoint, const CAmount& nValue) const
+{
+    if (!fCoinsIndexBuilt)
+        return;
+    setCoinsIndex.insert(outpoint);
+    if (CPrivateSend::IsDenominatedAmount(nValue) && setDenominatedCoinsIndex.insert(outpoint).second)
+        setDenominatedCoinsUnsorted.insert(outpoint);
+    // The collateral amount does not depend on the height, CheckCollateral has the final word anyway
+    if (CMasternode::CollateralValueCheck(0, nValue))
+        setCollateralCoinsIndex.insert(outpoint);
+}
+
+void CWallet::RemoveFromCoinsIndex(const COutPoint& outpoint) const
+{
+    setCoinsIndex.erase(outpoint);
+    setDenominatedCoinsIndex.erase(outpoint);
+    setCollateralCoinsIndex.erase(outpoint);
+    setDenominatedCoinsUnsorted.erase(outpoint);
+    auto itKey = mapDenominatedCoinKeys.find(outpoint);
+    if (itKey != mapDenominatedCoinKeys.end()) {
+        auto itBucket = mapDenominatedCoinsByRounds.find(itKey->second);
+        itBucket->second.erase(outpoint);
+        if (itBucket->second.empty())
+            mapDenominatedCoinsByRounds.erase(itBucket);
+        mapDenominatedCoinKeys.erase(itKey);
+    }
+}
+
+void CWallet::BuildCoinsIndex() const
+{
+    setCoinsIndex.clear();
+    setDenominatedCoinsIndex.clear();
+    setCollateralCoinsIndex.clear();
+    mapDenominatedCoinsByRounds.clear();
+    mapDenominatedCoinKeys.clear();
+    setDenominatedCoinsUnsorted.clear();
+    fCoinsIndexBuilt = true;
+    // Spent outputs are dropped by the first AvailableCoins walking them
+    for (const auto& entry : mapWallet) {
+        for (unsigned int i = 0; i < entry.second.tx->vout.size(); ++i) {
+            AddToCoinsIndex(COutPoint(entry.first, i), entry.second.tx->vout[i].nValue);
+        }
+    }
+}
+
+void CWallet::SortDenominatedCoins() const
+{
+    if (!fCoinsIndexBuilt)
+        BuildCoinsIndex();
+
+    for (const COutPoint& outpoint : setDenominatedCoinsUnsorted) {
+        auto it = mapWallet.find(outpoint.hash);
+        if (it == mapWallet.end() || outpoint.n >= it->second.tx->vout.size())
+            continue;
+        const std::pair<CAmount, int> key(it->second.tx->vout[outpoint.n].nValue, GetRealOutpointPrivateSendRounds(outpoint, 0));
+        mapDenominatedCoinsByRounds[key].insert(outpoint);
+        mapDenominatedCoinKeys[outpoint] = key;
+    }
+    setDenominatedCoinsUnsorted.clear();
+}
+
+void CWallet::SelectDenominatedCoins(const std::vector<CAmount>& vecDenoms, int nRoundsMin, int nRoundsMax, CCoinControl& coinControl) const
+{
+    SortDenominatedCoins();
+
+    for (const CAmount nDenom : vecDenoms) {
+        for (auto it = mapDenominatedCoinsByRounds.lower_bound(std::make_pair(nDenom, std::numeric_limits<int>::min()));
+                it != mapDenominatedCoinsByRounds.end() && it->first.first == nDenom; ++it) {
+            // same as GetOutpointPrivateSendRounds, the rounds above the setting count as the setting
+            const int nRounds = std::min(it->first.second, privateSendClient.nPrivateSendRounds);
+            if (nRounds < nRoundsMin || nRounds >= nRoundsMax)
+                continue;
+            for (const COutPoint& outpoint : it->second)
+                coinControl.Select(outpoint);
+        }
+    }
+}
+// VELES END
+
 
 void CWallet::AddToSpends(const uint256& wtxid)
 {
     auto it = mapWallet.find(wtxid);
     assert(it != mapWallet.end());
     CWalletTx& thisTx = it->second;
+    g_wallet_tx_filter.AddTx(this, *thisTx.tx); // VELES
     if (thisTx.IsCoinBase()) // Coinbases don't spend anything!
         return;
 
@@ -1103,6 +1301,12 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
 
     // Break debit/credit balance caches:
     wtx.MarkDirty();
+    // VELES BEGIN
+    if (wtx.IsCoinBase() && (fInsertedNew || fUpdated)) {
+        // the height it matures at may have changed
+        fMaturityQueueStale = true;
+    }
+    // VELES END
 
     // Notify UI of new or updated transaction
     NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
@@ -1122,6 +1326,31 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
     fAnonymizableTallyCachedNonDenom = false;
     //
 
+    // VELES BEGIN
+    if (fInsertedNew) {
+        for (unsigned int i = 0; i < wtx.tx->vout.size(); ++i) {
+            AddToCoinsIndex(COutPoint(hash, i), wtx.tx->vout[i].nValue);
+            // a masternode collateral of the config funded after the startup
+            if (setMasternodeCollaterals.count(COutPoint(hash, i)) && IsMine(wtx.tx->vout[i]) == ISMINE_SPENDABLE) {
+                LockCoin(COutPoint(hash, i));
+                WalletLogPrintf("Masternode collateral %s locked\n", COutPoint(hash, i).ToStringShort());
+            }
+        }
+    }
+    // VELES END
+
+    // VELES BEGIN
+    // the rounds of the wallet transactions spending a parent that arrived late were computed without it
+    if (fInsertedNew) {
+        for (unsigned int i = 0; i < wtx.tx->vout.size(); ++i) {
+            if (mapTxSpends.count(COutPoint(hash, i))) {
+                ClearOutpointRoundsCache();
+                break;
+            }
+        }
+    }
+    // VELES END
+
     return true;
 }
 
@@ -1133,6 +1362,11 @@ void CWallet::LoadToWallet(const CWalletTx& wtxIn)
     wtx.BindWallet(this);
     if (/* insertion took place */ ins.second) {
         wtx.m_it_wtxOrdered = wtxOrdered.insert(std::make_pair(wtx.nOrderPos, &wtx));
+        // VELES BEGIN
+        for (unsigned int i = 0; i < wtx.tx->vout.size(); ++i) {
+            AddToCoinsIndex(COutPoint(hash, i), wtx.tx->vout[i].nValue);
+        }
+        // VELES END
     }
     AddToSpends(hash);
     for (const CTxIn& txin : wtx.tx->vin) {
@@ -1217,6 +1451,12 @@ void CWallet::MarkInputsDirty(const CTransactionRef& tx)
         auto it = mapWallet.find(txin.prevout.hash);
         if (it != mapWallet.end()) {
             it->second.MarkDirty();
+            // VELES BEGIN
+            // the spender changed state, the output may be available again
+            if (txin.prevout.n < it->second.tx->vout.size()) {
+                AddToCoinsIndex(txin.prevout, it->second.tx->vout[txin.prevout.n].nValue);
+            }
+            // VELES END
         }
     }
 }
@@ -1339,6 +1579,11 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
 }
 
 void CWallet::SyncTransaction(const CTransactionRef& ptx, const uint256& block_hash, int posInBlock, bool update_tx) {
+    // VELES BEGIN
+    // skip the full checks of the transactions that can't involve this wallet
+    if (!g_wallet_tx_filter.MayConcern(this, *ptx))
+        return;
+    // VELES END
     if (!AddToWalletIfInvolvingMe(ptx, block_hash, posInBlock, update_tx))
         return; // Not one of ours
 
@@ -1361,6 +1606,7 @@ void CWallet::TransactionAddedToMempool(const CTransactionRef& ptx) {
     auto it = mapWallet.find(ptx->GetHash());
     if (it != mapWallet.end()) {
         it->second.fInMempool = true;
+        InvalidateBalanceCache(); // VELES
     }
 }
 
@@ -1369,12 +1615,18 @@ void CWallet::TransactionRemovedFromMempool(const CTransactionRef &ptx) {
     auto it = mapWallet.find(ptx->GetHash());
     if (it != mapWallet.end()) {
         it->second.fInMempool = false;
+        InvalidateBalanceCache(); // VELES
     }
 }
 
 void CWallet::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex, const std::vector<CTransactionRef>& vtxConflicted) {
     auto locked_chain = chain().lock();
     LOCK(cs_wallet);
+    // VELES BEGIN
+    // depths, maturity and finality of the wallet transactions all move with the tip
+    //InvalidateBalanceCache();
+    // VELES END
+    WalletFlushDeferral flush_deferral(*database); // VELES
     // TODO: Temporarily ensure that mempool removals are notified before
     // connected transactions.  This shouldn't matter, but the abandoned
     // state of transactions in our wallet is currently cleared when we
@@ -1391,6 +1643,11 @@ void CWallet::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const
         SyncTransaction(pblock->vtx[i], pindex->GetBlockHash(), i);
         TransactionRemovedFromMempool(pblock->vtx[i]);
     }
+    // VELES BEGIN
+    // The transactions of the block are dirty once synced, the others only
+    // change when they reach maturity
+    UpdateBalanceCacheForTip(*locked_chain, pindex->nHeight);
+    // VELES END
 
     m_last_block_processed = pindex->GetBlockHash();
 }
@@ -1398,8 +1655,16 @@ void CWallet::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const
 void CWallet::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) {
     auto locked_chain = chain().lock();
     LOCK(cs_wallet);
+    InvalidateBalanceCache(); // VELES
+    fMaturityQueueStale = true; // VELES
 
     for (const CTransactionRef& ptx : pblock->vtx) {
+        // VELES BEGIN
+        // wallet transactions may get replaced after a reorg, the rounds are rebuilt on demand
+        if (mapWallet.count(ptx->GetHash())) {
+            ClearOutpointRoundsCache();
+        }
+        // VELES END
         SyncTransaction(ptx, {} /* block hash */, 0 /* position in block */);
     }
 }
@@ -1468,7 +1733,8 @@ CAmount CWallet::GetDebit(const CTxIn &txin, const isminefilter& filter) const
 // Recursively determine the rounds of a given input (How deep is the PrivateSend chain for a given input)
 int CWallet::GetRealOutpointPrivateSendRounds(const COutPoint& outpoint, int nRounds) const
 {
-    static std::map<uint256, CMutableTransaction> mDenomWtxes;
+    //static std::map<uint256, CMutableTransaction> mDenomWtxes;
+    AssertLockHeld(cs_wallet); // VELES
 
     if(nRounds >= 16) return 15; // 16 rounds max
 
@@ -1478,15 +1744,22 @@ int CWallet::GetRealOutpointPrivateSendRounds(const COutPoint& outpoint, int nRo
     const CWalletTx* wtx = GetWalletTx(hash);
     if(wtx != NULL)
     {
-        std::map<uint256, CMutableTransaction>::const_iterator mdwi = mDenomWtxes.find(hash);
-        if (mdwi == mDenomWtxes.end()) {
-            // not known yet, let's add it
-            LogPrint(BCLog::PRIVATESEND, "GetRealOutpointPrivateSendRounds INSERTING %s\n", hash.ToString());
-            mDenomWtxes[hash] = CMutableTransaction(*wtx->tx);
-        } else if(mDenomWtxes[hash].vout[nout].nRounds != -10) {
-            // found and it's not an initial value, just return it
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
+        //std::map<uint256, CMutableTransaction>::const_iterator mdwi = mDenomWtxes.find(hash);
+        //if (mdwi == mDenomWtxes.end()) {
+        //    // not known yet, let's add it
+        //    LogPrint(BCLog::PRIVATESEND, "GetRealOutpointPrivateSendRounds INSERTING %s\n", hash.ToString());
+        //    mDenomWtxes[hash] = CMutableTransaction(*wtx->tx);
+        //} else if(mDenomWtxes[hash].vout[nout].nRounds != -10) {
+        //    // found and it's not an initial value, just return it
+        //    return mDenomWtxes[hash].vout[nout].nRounds;
+        //}
+        // VELES BEGIN
+        std::map<COutPoint, int>::const_iterator itRounds = mapOutpointRoundsCache.find(outpoint);
+        if (itRounds != mapOutpointRoundsCache.end()) {
+            // found, just return it
+            return itRounds->second;
+        }
+        // VELES END
 
 
         // bounds check
@@ -1497,28 +1770,32 @@ int CWallet::GetRealOutpointPrivateSendRounds(const COutPoint& outpoint, int nRo
         }
 
         if (CPrivateSend::IsCollateralAmount(wtx->tx->vout[nout].nValue)) {
-            mDenomWtxes[hash].vout[nout].nRounds = -3;
-            LogPrint(BCLog::PRIVATESEND, "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
+            //mDenomWtxes[hash].vout[nout].nRounds = -3;
+            //LogPrint(BCLog::PRIVATESEND, "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
+            //return mDenomWtxes[hash].vout[nout].nRounds;
+            return SetOutpointPrivateSendRounds(outpoint, -3); // VELES
         }
 
         //make sure the final output is non-denominate
         if (!CPrivateSend::IsDenominatedAmount(wtx->tx->vout[nout].nValue)) { //NOT DENOM
-            mDenomWtxes[hash].vout[nout].nRounds = -2;
-            LogPrint(BCLog::PRIVATESEND, "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
+            //mDenomWtxes[hash].vout[nout].nRounds = -2;
+            //LogPrint(BCLog::PRIVATESEND, "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
+            //return mDenomWtxes[hash].vout[nout].nRounds;
+            return SetOutpointPrivateSendRounds(outpoint, -2); // VELES
         }
 
-        bool fAllDenoms = true;
-        for (CTxOut out : wtx->tx->vout) {
-            fAllDenoms = fAllDenoms && CPrivateSend::IsDenominatedAmount(out.nValue);
-        }
+        //bool fAllDenoms = true;
+        //for (CTxOut out : wtx->tx->vout) {
+        //    fAllDenoms = fAllDenoms && CPrivateSend::IsDenominatedAmount(out.nValue);
+        //}
+        bool fAllDenoms = CPrivateSend::IsDenominatedAmounts(wtx->tx->vout); // VELES
 
         // this one is denominated but there is another non-denominated output found in the same tx
         if (!fAllDenoms) {
-            mDenomWtxes[hash].vout[nout].nRounds = 0;
-            LogPrint(BCLog::PRIVATESEND, "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
+            //mDenomWtxes[hash].vout[nout].nRounds = 0;
+            //LogPrint(BCLog::PRIVATESEND, "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
+            //return mDenomWtxes[hash].vout[nout].nRounds;
+            return SetOutpointPrivateSendRounds(outpoint, 0); // VELES
         }
 
         int nShortest = -10; // an initial value, should be no way to get this by calculations
@@ -1534,16 +1811,54 @@ int CWallet::GetRealOutpointPrivateSendRounds(const COutPoint& outpoint, int nRo
                 }
             }
         }
-        mDenomWtxes[hash].vout[nout].nRounds = fDenomFound
+        //mDenomWtxes[hash].vout[nout].nRounds = fDenomFound
+        //        ? (nShortest >= 15 ? 16 : nShortest + 1) // good, we a +1 to the shortest one but only 16 rounds max allowed
+        //        : 0;            // too bad, we are the fist one in that chain
+        //LogPrint(BCLog::PRIVATESEND, "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
+        //return mDenomWtxes[hash].vout[nout].nRounds;
+        // VELES BEGIN
+        return SetOutpointPrivateSendRounds(outpoint, fDenomFound
                 ? (nShortest >= 15 ? 16 : nShortest + 1) // good, we a +1 to the shortest one but only 16 rounds max allowed
-                : 0;            // too bad, we are the fist one in that chain
-        LogPrint(BCLog::PRIVATESEND, "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-        return mDenomWtxes[hash].vout[nout].nRounds;
+                : 0);           // too bad, we are the fist one in that chain
+        // VELES END
     }
 
     return nRounds - 1;
 }
 
+// VELES BEGIN
+int CWallet::SetOutpointPrivateSendRounds(const COutPoint& outpoint, int nRounds) const
+{
+    AssertLockHeld(cs_wallet);
+    mapOutpointRoundsCache[outpoint] = nRounds;
+    WalletBatch(*database, "r+", false).WriteOutpointPrivateSendRounds(outpoint, nRounds);
+    LogPrint(BCLog::PRIVATESEND, "GetRealOutpointPrivateSendRounds UPDATED   %s %3d %3d\n", outpoint.hash.ToString(), outpoint.n, nRounds);
+    return nRounds;
+}
+
+void CWallet::ClearOutpointRoundsCache()
+{
+    AssertLockHeld(cs_wallet);
+    if (mapOutpointRoundsCache.empty()) return;
+    WalletBatch batch(*database);
+    for (const auto& entry : mapOutpointRoundsCache) {
+        batch.EraseOutpointPrivateSendRounds(entry.first);
+    }
+    mapOutpointRoundsCache.clear();
+    InvalidateBalanceCache();
+    // the denominated coins are sorted again with their new rounds
+    for (const auto& entry : mapDenominatedCoinKeys)
+        setDenominatedCoinsUnsorted.insert(entry.first);
+    mapDenominatedCoinKeys.clear();
+    mapDenominatedCoinsByRounds.clear();
+}
+
+void CWallet::LoadOutpointPrivateSendRounds(const COutPoint& outpoint, int nRounds)
+{
+    mapOutpointRoundsCache[outpoint] = nRounds;
+}
+// VELES END
+
 // respect current settings
 int CWallet::GetOutpointPrivateSendRounds(const COutPoint& outpoint) const
 {
@@ -1622,6 +1937,57 @@ bool CWallet::IsMine(const CTransaction& tx) const
     return false;
 }
 
+// VELES BEGIN
+bool CWallet::IsRelevantToScan(const CTransaction& tx) const
+{
+    AssertLockHeld(cs_wallet);
+    // Same conditions as AddToWalletIfInvolvingMe besides IsMine(tx): already in the wallet,
+    // conflicting with a wallet transaction or spending one of our outputs (IsFromMe)
+    if (mapWallet.count(tx.GetHash()))
+        return true;
+    for (const CTxIn& txin : tx.vin) {
+        if (mapTxSpends.count(txin.prevout) || mapWallet.count(txin.prevout.hash))
+            return true;
+    }
+    return false;
+}
+
+size_t CWallet::GetKeyStoreSize() const
+{
+    LOCK(cs_KeyStore);
+    return mapKeys.size() + mapCryptedKeys.size() + mapWatchKeys.size() + mapScripts.size() + setWatchOnly.size();
+}
+
+GCSFilter::ElementSet CWallet::GetScanFilterElements() const
+{
+    GCSFilter::ElementSet elements;
+    auto add = [&elements](const CScript& script) { elements.emplace(script.begin(), script.end()); };
+
+    LOCK(cs_KeyStore);
+    // All standard outputs to one of our keys, IsMine() rejects the witness ones later if their script is unknown
+    for (const CKeyID& keyid : GetKeys()) {
+        CPubKey pubkey;
+        if (!GetPubKey(keyid, pubkey))
+            continue;
+        add(GetScriptForRawPubKey(pubkey));
+        add(GetScriptForDestination(keyid));
+        if (pubkey.IsCompressed()) {
+            CScript witprog = GetScriptForDestination(WitnessV0KeyHash(keyid));
+            add(witprog);
+            add(GetScriptForDestination(CScriptID(witprog)));
+        }
+    }
+    for (const auto& entry : mapScripts) {
+        add(entry.second);
+        add(GetScriptForDestination(CScriptID(entry.second)));
+        add(GetScriptForDestination(WitnessV0ScriptHash(entry.second)));
+    }
+    for (const CScript& script : setWatchOnly)
+        add(script);
+    return elements;
+}
+// VELES END
+
 bool CWallet::IsFromMe(const CTransaction& tx) const
 {
     return (GetDebit(tx, ISMINE_ALL) > 0);
@@ -1974,6 +2340,181 @@ int64_t CWallet::RescanFromTime(int64_t startTime, const WalletRescanReserver& r
     return startTime;
 }
 
+// VELES BEGIN
+/** Matches the outputs of one transaction against the wallet keys for a rescan */
+class CWalletScanCheck
+{
+private:
+    const CWallet* pwallet;
+    const CTransaction* ptx;
+    char* pfIsMine;
+
+public:
+    CWalletScanCheck() : pwallet(nullptr), ptx(nullptr), pfIsMine(nullptr) {}
+    CWalletScanCheck(const CWallet* pwalletIn, const CTransaction* ptxIn, char* pfIsMineIn) :
+        pwallet(pwalletIn), ptx(ptxIn), pfIsMine(pfIsMineIn) {}
+
+    bool operator()()
+    {
+        *pfIsMine = pwallet->IsMine(*ptx);
+        return true;
+    }
+
+    void swap(CWalletScanCheck& check)
+    {
+        std::swap(pwallet, check.pwallet);
+        std::swap(ptx, check.ptx);
+        std::swap(pfIsMine, check.pfIsMine);
+    }
+};
+
+static CCheckQueue<CWalletScanCheck> walletscancheckqueue(128);
+
+void ThreadWalletScanCheck()
+{
+    RenameThread("veles-walletscan");
+    walletscancheckqueue.Thread();
+}
+
+/**
+ * Reads the blocks of a rescan ahead of it on its own thread, and matches their
+ * transactions against the wallet keys on the wallet scan check threads, so the
+ * rescan only has to apply the transactions that may be ours, in order.
+ */
+class CWalletScanPrefetcher
+{
+public:
+    struct Entry {
+        int nHeight = 0;
+        uint256 hash;
+        bool fFound = false;
+        CBlock block;
+        //! IsMine() of each transaction of the block, valid while the key store size is unchanged
+        std::vector<char> vIsMine;
+        size_t nKeyStoreSize = 0;
+        //! The block filter matches none of our scripts, the block was not read
+        bool fFilterMiss = false;
+    };
+
+private:
+    static const size_t MAX_BLOCKS_AHEAD = 16;
+
+    interfaces::Chain& m_chain;
+    const CWallet* m_wallet;
+    const uint256 m_stop_block;
+    int m_next_height;
+    const bool m_use_filters;
+    GCSFilter::ElementSet m_filter_elements;
+    size_t m_filter_key_store_size = 0;
+    bool m_filter_elements_built = false;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<Entry> m_entries;
+    bool m_stop = false;
+    bool m_done = false;
+    std::thread m_thread;
+
+    void Run()
+    {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cond.wait(lock, [this] { return m_stop || m_entries.size() < MAX_BLOCKS_AHEAD; });
+                if (m_stop) break;
+            }
+
+            Entry entry;
+            entry.nHeight = m_next_height;
+            {
+                auto locked_chain = m_chain.lock();
+                Optional<int> tip_height = locked_chain->getHeight();
+                if (!tip_height || *tip_height < entry.nHeight) break;
+                entry.hash = locked_chain->getBlockHash(entry.nHeight);
+            }
+            entry.nKeyStoreSize = m_wallet->GetKeyStoreSize();
+            if (m_use_filters) {
+                // Taking the size before the elements keeps the match conservative when keys are added meanwhile
+                if (!m_filter_elements_built || m_filter_key_store_size != entry.nKeyStoreSize) {
+                    m_filter_elements = m_wallet->GetScanFilterElements();
+                    m_filter_key_store_size = entry.nKeyStoreSize;
+                    m_filter_elements_built = true;
+                }
+                Optional<bool> matches = m_chain.blockFilterMatchesAny(BlockFilterType::BASIC, entry.hash, m_filter_elements);
+                entry.fFilterMiss = matches && !*matches;
+            }
+            if (!entry.fFilterMiss) {
+                entry.fFound = m_chain.findBlock(entry.hash, &entry.block) && !entry.block.IsNull();
+            }
+            if (entry.fFound) {
+                entry.vIsMine.resize(entry.block.vtx.size());
+                std::vector<CWalletScanCheck> vChecks;
+                vChecks.reserve(entry.block.vtx.size());
+                for (size_t i = 0; i < entry.block.vtx.size(); ++i) {
+                    vChecks.emplace_back(m_wallet, entry.block.vtx[i].get(), &entry.vIsMine[i]);
+                }
+                CCheckQueueControl<CWalletScanCheck> control(&walletscancheckqueue);
+                control.Add(vChecks);
+                control.Wait();
+            }
+
+            const bool fStopBlock = entry.hash == m_stop_block;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_entries.push_back(std::move(entry));
+            }
+            m_cond.notify_all();
+            if (fStopBlock) break;
+            ++m_next_height;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_done = true;
+        }
+        m_cond.notify_all();
+    }
+
+public:
+    CWalletScanPrefetcher(interfaces::Chain& chain, const CWallet* wallet, int start_height, const uint256& stop_block) :
+        m_chain(chain), m_wallet(wallet), m_stop_block(stop_block), m_next_height(start_height),
+        m_use_filters(chain.hasBlockFilterIndex(BlockFilterType::BASIC))
+    {
+        m_thread = std::thread(&TraceThread<std::function<void()> >, "walletprefetch", std::function<void()>(std::bind(&CWalletScanPrefetcher::Run, this)));
+    }
+
+    ~CWalletScanPrefetcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cond.notify_all();
+        m_thread.join();
+    }
+
+    /** Next prefetched block if it is the one at nHeight with the given hash, false otherwise */
+    bool Get(int nHeight, const uint256& hash, Entry& entryRet)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true) {
+            m_cond.wait(lock, [this] { return m_done || !m_entries.empty(); });
+            if (m_entries.empty()) return false;
+            // Blocks from before a reorg or below the scan position are of no use
+            if (m_entries.front().nHeight < nHeight) {
+                m_entries.pop_front();
+                m_cond.notify_all();
+                continue;
+            }
+            if (m_entries.front().nHeight != nHeight || m_entries.front().hash != hash) return false;
+            entryRet = std::move(m_entries.front());
+            m_entries.pop_front();
+            m_cond.notify_all();
+            return true;
+        }
+    }
+};
+// VELES END
+
 /**
  * Scan the block chain (starting in start_block) for transactions
  * from or to us. If fUpdate is true, found transactions that already
@@ -2007,6 +2548,7 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
     WalletLogPrintf("Rescan started from block %s...\n", start_block.ToString());
 
     {
+        WalletFlushDeferral flush_deferral(*database); // VELES
         fAbortRescan = false;
         ShowProgress(strprintf("%s " + _("Rescanning..."), GetDisplayName()), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
         uint256 tip_hash;
@@ -2024,6 +2566,12 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
             progress_end = chain().guessVerificationProgress(stop_block.IsNull() ? tip_hash : stop_block);
         }
         double progress_current = progress_begin;
+        // VELES BEGIN
+        std::unique_ptr<CWalletScanPrefetcher> prefetcher;
+        if (block_height) {
+            prefetcher = MakeUnique<CWalletScanPrefetcher>(chain(), this, *block_height, stop_block);
+        }
+        // VELES END
         while (block_height && !fAbortRescan && !ShutdownRequested()) {
             if (*block_height % 100 == 0 && progress_end - progress_begin > 0.0) {
                 ShowProgress(strprintf("%s " + _("Rescanning..."), GetDisplayName()), std::max(1, std::min(99, (int)((progress_current - progress_begin) / (progress_end - progress_begin) * 100))));
@@ -2033,8 +2581,28 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
                 WalletLogPrintf("Still rescanning. At block %d. Progress=%f\n", *block_height, progress_current);
             }
 
-            CBlock block;
-            if (chain().findBlock(block_hash, &block) && !block.IsNull()) {
+            //CBlock block;
+            //if (chain().findBlock(block_hash, &block) && !block.IsNull()) {
+            // VELES BEGIN
+            CWalletScanPrefetcher::Entry entry;
+            if (!prefetcher->Get(*block_height, block_hash, entry)) {
+                // the prefetcher fell behind a reorg or stopped at an older tip
+                entry.fFound = chain().findBlock(block_hash, &entry.block) && !entry.block.IsNull();
+                entry.vIsMine.clear();
+                entry.fFilterMiss = false;
+            }
+            if (entry.fFilterMiss && entry.nKeyStoreSize != GetKeyStoreSize()) {
+                // keys were added since the filter was matched, e.g. by a keypool top up
+                entry.fFound = chain().findBlock(block_hash, &entry.block) && !entry.block.IsNull();
+                entry.fFilterMiss = false;
+            }
+            const CBlock& block = entry.block;
+            if (entry.fFilterMiss) {
+                // None of our scripts is in the block filter, no transaction of the block pays or spends a coin of ours
+                result.last_scanned_block = block_hash;
+                result.last_scanned_height = *block_height;
+            } else if (entry.fFound) {
+            // VELES END
                 auto locked_chain = chain().lock();
                 LOCK(cs_wallet);
                 if (!locked_chain->getBlockHeight(block_hash)) {
@@ -2047,6 +2615,13 @@ CWallet::ScanResult CWallet::ScanForWalletTransactions(const uint256& start_bloc
                     break;
                 }
                 for (size_t posInBlock = 0; posInBlock < block.vtx.size(); ++posInBlock) {
+                    // VELES BEGIN
+                    // The transactions neither paying us nor touching the wallet are skipped by SyncTransaction anyway.
+                    // The matches are stale once keys were added, e.g. by a keypool top up of an earlier transaction.
+                    const bool fMatched = entry.vIsMine.size() == block.vtx.size() && entry.nKeyStoreSize == GetKeyStoreSize();
+                    if (fMatched && !entry.vIsMine[posInBlock] && !IsRelevantToScan(*block.vtx[posInBlock]))
+                        continue;
+                    // VELES END
                     SyncTransaction(block.vtx[posInBlock], block_hash, posInBlock, fUpdate);
                 }
                 // scan succeeded, record block as most recent successfully scanned
@@ -2527,12 +3102,93 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman
  */
 
 
+// VELES BEGIN
+enum BalanceCacheKind {
+    BALANCE_TRUSTED,
+    BALANCE_UNCONFIRMED,
+    BALANCE_IMMATURE,
+    BALANCE_UNCONFIRMED_WATCHONLY,
+    BALANCE_IMMATURE_WATCHONLY,
+    BALANCE_ANONYMIZABLE,
+    BALANCE_ANONYMIZED,
+    BALANCE_DENOMINATED,
+};
+
+bool CWallet::GetCachedBalance(const balance_key_t& key, CAmount& nBalanceRet, uint64_t& nGenerationRet) const
+{
+    AssertLockHeld(cs_wallet);
+    nGenerationRet = nBalanceCacheGeneration;
+    if (nGenerationRet != nBalanceCacheGenerationUsed) {
+        mapBalanceCache.clear();
+        nBalanceCacheGenerationUsed = nGenerationRet;
+        return false;
+    }
+    std::map<balance_key_t, CAmount>::const_iterator it = mapBalanceCache.find(key);
+    if (it == mapBalanceCache.end()) return false;
+    nBalanceRet = it->second;
+    return true;
+}
+
+void CWallet::SetCachedBalance(const balance_key_t& key, CAmount nBalance, uint64_t nGeneration) const
+{
+    AssertLockHeld(cs_wallet);
+    // something changed while the total was computed
+    if (nGeneration != nBalanceCacheGeneration || nGeneration != nBalanceCacheGenerationUsed) return;
+    mapBalanceCache[key] = nBalance;
+}
+
+void CWalletTx::InvalidateWalletBalances() const
+{
+    if (pwallet) pwallet->InvalidateBalanceCache();
+}
+
+void CWallet::UpdateBalanceCacheForTip(interfaces::Chain::Lock& locked_chain, int nHeight)
+{
+    AssertLockHeld(cs_wallet);
+
+    // Only the totals of a minimum depth above one depend on the depth of every transaction
+    for (auto it = mapBalanceCache.begin(); it != mapBalanceCache.end();) {
+        if (std::get<0>(it->first) == BALANCE_TRUSTED && std::get<2>(it->first) > 1) {
+            it = mapBalanceCache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // The coinbases that matured before the queue went stale are already accounted for
+    if (fMaturityQueueStale) {
+        mapMaturityQueue.clear();
+        for (const auto& entry : mapWallet) {
+            const CWalletTx& wtx = entry.second;
+            if (!wtx.IsCoinBase() || wtx.hashUnset()) continue;
+            const Optional<int> block_height = locked_chain.getBlockHeight(wtx.hashBlock);
+            if (block_height && *block_height + COINBASE_MATURITY_850k >= nHeight) {
+                mapMaturityQueue.emplace(*block_height + COINBASE_MATURITY_850k, entry.first);
+            }
+        }
+        fMaturityQueueStale = false;
+    }
+
+    const auto itMatured = mapMaturityQueue.upper_bound(nHeight);
+    for (auto it = mapMaturityQueue.begin(); it != itMatured; ++it) {
+        auto itTx = mapWallet.find(it->second);
+        if (itTx != mapWallet.end()) itTx->second.MarkDirty();
+    }
+    mapMaturityQueue.erase(mapMaturityQueue.begin(), itMatured);
+}
+// VELES END
+
 CAmount CWallet::GetBalance(const isminefilter& filter, const int min_depth) const
 {
     CAmount nTotal = 0;
     {
         auto locked_chain = chain().lock();
         LOCK(cs_wallet);
+        // VELES BEGIN
+        const balance_key_t key(BALANCE_TRUSTED, filter, min_depth);
+        uint64_t nGeneration;
+        if (GetCachedBalance(key, nTotal, nGeneration)) return nTotal;
+        // VELES END
         for (const auto& entry : mapWallet)
         {
             const CWalletTx* pcoin = &entry.second;
@@ -2540,6 +3196,7 @@ CAmount CWallet::GetBalance(const isminefilter& filter, const int min_depth) con
                 nTotal += pcoin->GetAvailableCredit(*locked_chain, true, filter);
             }
         }
+        SetCachedBalance(key, nTotal, nGeneration); // VELES
     }
 
     return nTotal;
@@ -2551,6 +3208,15 @@ CAmount CWallet::GetAnonymizableBalance(bool fSkipDenominated, bool fSkipUnconfi
 {
     if(fLiteMode) return 0;
 
+    // VELES BEGIN
+    auto locked_chain = chain().lock();
+    LOCK(cs_wallet);
+    const balance_key_t key(BALANCE_ANONYMIZABLE, fSkipDenominated, fSkipUnconfirmed);
+    uint64_t nGeneration;
+    CAmount nCached;
+    if (GetCachedBalance(key, nCached, nGeneration)) return nCached;
+    // VELES END
+
     std::vector<CompactTallyItem> vecTally;
     if(!SelectCoinsGrouppedByAddresses(vecTally, fSkipDenominated, true, fSkipUnconfirmed)) return 0;
 
@@ -2566,6 +3232,7 @@ CAmount CWallet::GetAnonymizableBalance(bool fSkipDenominated, bool fSkipUnconfi
             nTotal += item.nAmount;
     }
 
+    SetCachedBalance(key, nTotal, nGeneration); // VELES
     return nTotal;
 }
 
@@ -2577,6 +3244,12 @@ CAmount CWallet::GetAnonymizedBalance() const
 
     LOCK2(cs_main, cs_wallet);
 
+    // VELES BEGIN
+    const balance_key_t key(BALANCE_ANONYMIZED, privateSendClient.nPrivateSendRounds, 0);
+    uint64_t nGeneration;
+    if (GetCachedBalance(key, nTotal, nGeneration)) return nTotal;
+    // VELES END
+
     std::set<uint256> setWalletTxesCounted;
     for (auto& outpoint : setWalletUTXO) {
 
@@ -2595,6 +3268,7 @@ CAmount CWallet::GetAnonymizedBalance() const
         // FXTC END
     }
 
+    SetCachedBalance(key, nTotal, nGeneration); // VELES
     return nTotal;
 }
 /*
@@ -2673,12 +3347,18 @@ CAmount CWallet::GetDenominatedBalance(bool unconfirmed) const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
+        // VELES BEGIN
+        const balance_key_t key(BALANCE_DENOMINATED, unconfirmed, 0);
+        uint64_t nGeneration;
+        if (GetCachedBalance(key, nTotal, nGeneration)) return nTotal;
+        // VELES END
         for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
         {
             const CWalletTx* pcoin = &(*it).second;
 
             nTotal += pcoin->GetDenominatedCredit(unconfirmed);
         }
+        SetCachedBalance(key, nTotal, nGeneration); // VELES
     }
 
     return nTotal;
@@ -2691,12 +3371,18 @@ CAmount CWallet::GetUnconfirmedBalance() const
     {
         auto locked_chain = chain().lock();
         LOCK(cs_wallet);
+        // VELES BEGIN
+        const balance_key_t key(BALANCE_UNCONFIRMED, 0, 0);
+        uint64_t nGeneration;
+        if (GetCachedBalance(key, nTotal, nGeneration)) return nTotal;
+        // VELES END
         for (const auto& entry : mapWallet)
         {
             const CWalletTx* pcoin = &entry.second;
             if (!pcoin->IsTrusted(*locked_chain) && pcoin->GetDepthInMainChain(*locked_chain) == 0 && pcoin->InMempool())
                 nTotal += pcoin->GetAvailableCredit(*locked_chain);
         }
+        SetCachedBalance(key, nTotal, nGeneration); // VELES
     }
     return nTotal;
 }
@@ -2707,11 +3393,17 @@ CAmount CWallet::GetImmatureBalance() const
     {
         auto locked_chain = chain().lock();
         LOCK(cs_wallet);
+        // VELES BEGIN
+        const balance_key_t key(BALANCE_IMMATURE, 0, 0);
+        uint64_t nGeneration;
+        if (GetCachedBalance(key, nTotal, nGeneration)) return nTotal;
+        // VELES END
         for (const auto& entry : mapWallet)
         {
             const CWalletTx* pcoin = &entry.second;
             nTotal += pcoin->GetImmatureCredit(*locked_chain);
         }
+        SetCachedBalance(key, nTotal, nGeneration); // VELES
     }
     return nTotal;
 }
@@ -2722,12 +3414,18 @@ CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
     {
         auto locked_chain = chain().lock();
         LOCK(cs_wallet);
+        // VELES BEGIN
+        const balance_key_t key(BALANCE_UNCONFIRMED_WATCHONLY, 0, 0);
+        uint64_t nGeneration;
+        if (GetCachedBalance(key, nTotal, nGeneration)) return nTotal;
+        // VELES END
         for (const auto& entry : mapWallet)
         {
             const CWalletTx* pcoin = &entry.second;
             if (!pcoin->IsTrusted(*locked_chain) && pcoin->GetDepthInMainChain(*locked_chain) == 0 && pcoin->InMempool())
                 nTotal += pcoin->GetAvailableCredit(*locked_chain, true, ISMINE_WATCH_ONLY);
         }
+        SetCachedBalance(key, nTotal, nGeneration); // VELES
     }
     return nTotal;
 }
@@ -2738,11 +3436,17 @@ CAmount CWallet::GetImmatureWatchOnlyBalance() const
     {
         auto locked_chain = chain().lock();
         LOCK(cs_wallet);
+        // VELES BEGIN
+        const balance_key_t key(BALANCE_IMMATURE_WATCHONLY, 0, 0);
+        uint64_t nGeneration;
+        if (GetCachedBalance(key, nTotal, nGeneration)) return nTotal;
+        // VELES END
         for (const auto& entry : mapWallet)
         {
             const CWalletTx* pcoin = &entry.second;
             nTotal += pcoin->GetImmatureWatchOnlyCredit(*locked_chain);
         }
+        SetCachedBalance(key, nTotal, nGeneration); // VELES
     }
     return nTotal;
 }
@@ -2828,10 +3532,45 @@ void CWallet::AvailableCoins(interfaces::Chain::Lock& locked_chain, std::vector<
     vCoins.clear();
     CAmount nTotal = 0;
 
-    for (const auto& entry : mapWallet)
+    //for (const auto& entry : mapWallet)
+    // VELES BEGIN
+    if (!fCoinsIndexBuilt)
+        BuildCoinsIndex();
+
+    const std::set<COutPoint>* psetCoins = (nCoinType == ONLY_DENOMINATED) ? &setDenominatedCoinsIndex :
+                                           (nCoinType == ONLY_MASTERNODE_COLLATERAL) ? &setCollateralCoinsIndex : &setCoinsIndex;
+    // Only the selected coins can be used, no need to walk the index
+    std::set<COutPoint> setSelected;
+    if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs) {
+        std::vector<COutPoint> vOutpoints;
+        coinControl->ListSelected(vOutpoints);
+        setSelected.insert(vOutpoints.begin(), vOutpoints.end());
+        psetCoins = &setSelected;
+    }
+
+    auto itCoin = psetCoins->begin();
+    while (itCoin != psetCoins->end())
+    // VELES END
     {
-        const uint256& wtxid = entry.first;
+        //const uint256& wtxid = entry.first;
+        //const CWalletTx* pcoin = &entry.second;
+        // VELES BEGIN
+        // The outputs of a transaction are next to each other in the index, collect them
+        // before anything is dropped from it
+        const uint256 wtxid = itCoin->hash;
+        std::vector<unsigned int> vOutputs;
+        for (; itCoin != psetCoins->end() && itCoin->hash == wtxid; ++itCoin)
+            vOutputs.push_back(itCoin->n);
+
+        auto itWallet = mapWallet.find(wtxid);
+        if (itWallet == mapWallet.end()) {
+            for (unsigned int i : vOutputs)
+                RemoveFromCoinsIndex(COutPoint(wtxid, i));
+            continue;
+        }
+        const auto& entry = *itWallet;
         const CWalletTx* pcoin = &entry.second;
+        // VELES END
 
         if (!CheckFinalTx(*pcoin->tx))
             continue;
@@ -2894,7 +3633,9 @@ void CWallet::AvailableCoins(interfaces::Chain::Lock& locked_chain, std::vector<
         if (nDepth < nMinDepth || nDepth > nMaxDepth)
             continue;
 
-        for (unsigned int i = 0; i < pcoin->tx->vout.size(); i++) {
+        //for (unsigned int i = 0; i < pcoin->tx->vout.size(); i++) {
+        for (unsigned int i : vOutputs) { // VELES
+            if (i >= pcoin->tx->vout.size()) continue; // VELES
             if (pcoin->tx->vout[i].nValue < nMinimumAmount || pcoin->tx->vout[i].nValue > nMaximumAmount)
                 continue;
 
@@ -2905,8 +3646,14 @@ void CWallet::AvailableCoins(interfaces::Chain::Lock& locked_chain, std::vector<
             if (IsLockedCoin(entry.first, i) && nCoinType != ONLY_MASTERNODE_COLLATERAL)
                 continue;
 
-            if (IsSpent(locked_chain, wtxid, i))
+            //if (IsSpent(locked_chain, wtxid, i))
+            //    continue;
+            // VELES BEGIN
+            if (IsSpent(locked_chain, wtxid, i)) {
+                RemoveFromCoinsIndex(COutPoint(wtxid, i));
                 continue;
+            }
+            // VELES END
 
             // Dash
             bool found = false;
@@ -3220,14 +3967,6 @@ bool CWallet::SelectCoinsByDenominations(int nDenom, CAmount nValueMin, CAmount
     auto locked_chain = chain().lock();
     // FXTC END
 
-    vector<COutput> vCoins;
-    // FXTC BEGIN
-    //AvailableCoins(vCoins, true, NULL, false, ONLY_DENOMINATED);
-    AvailableCoins(*locked_chain, vCoins, true, NULL, false, ONLY_DENOMINATED);
-    // FXTC END
-
-    std::random_shuffle(vCoins.rbegin(), vCoins.rend(), GetRandInt);
-
     // ( bit on if present )
     // bit 0 - 100DASH+1
     // bit 1 - 10DASH+1
@@ -3242,6 +3981,27 @@ bool CWallet::SelectCoinsByDenominations(int nDenom, CAmount nValueMin, CAmount
     int nDenomResult = 0;
 
     std::vector<CAmount> vecPrivateSendDenominations = CPrivateSend::GetStandardDenominations();
+
+    // VELES BEGIN
+    // only the coins of the session denominations and rounds, from the denominated coins index
+    std::vector<CAmount> vecDenoms;
+    for (int nBit : vecBits)
+        vecDenoms.push_back(vecPrivateSendDenominations[nBit]);
+    CCoinControl coinControl;
+    coinControl.fAllowOtherInputs = false;
+    SelectDenominatedCoins(vecDenoms, nPrivateSendRoundsMin, nPrivateSendRoundsMax, coinControl);
+    if (!coinControl.HasSelected())
+        return false;
+    // VELES END
+
+    vector<COutput> vCoins;
+    // FXTC BEGIN
+    //AvailableCoins(vCoins, true, NULL, false, ONLY_DENOMINATED);
+    //AvailableCoins(*locked_chain, vCoins, true, NULL, false, ONLY_DENOMINATED);
+    // FXTC END
+    AvailableCoins(*locked_chain, vCoins, true, &coinControl, false, ONLY_DENOMINATED); // VELES
+
+    std::random_shuffle(vCoins.rbegin(), vCoins.rend(), GetRandInt);
     InsecureRand insecureRand;
     for (const COutput& out : vCoins)
     {
@@ -3421,6 +4181,18 @@ bool CWallet::SelectCoinsDark(CAmount nValueMin, CAmount nValueMax, std::vector<
     vecTxInRet.clear();
     nValueRet = 0;
 
+    // VELES BEGIN
+    // denominated coins come from the index, only those of the wanted rounds
+    CCoinControl coinControlDenominated;
+    if (nPrivateSendRoundsMin >= 0) {
+        coinControlDenominated.fAllowOtherInputs = false;
+        SelectDenominatedCoins(CPrivateSend::GetStandardDenominations(), nPrivateSendRoundsMin, nPrivateSendRoundsMax, coinControlDenominated);
+        if (!coinControlDenominated.HasSelected())
+            return false;
+        coinControl = &coinControlDenominated;
+    }
+    // VELES END
+
     vector<COutput> vCoins;
     // FXTC BEGIN
     //AvailableCoins(vCoins, true, coinControl, false, nPrivateSendRoundsMin < 0 ? ONLY_NONDENOMINATED : ONLY_DENOMINATED);
@@ -3864,7 +4636,11 @@ OutputType CWallet::TransactionChangeType(OutputType change_type, const std::vec
 bool CWallet::CreateTransaction(interfaces::Chain::Lock& locked_chain, const std::vector<CRecipient>& vecSend, CTransactionRef& tx, CReserveKey& reservekey, CAmount& nFeeRet,
                          // Dash
                          //int& nChangePosInOut, std::string& strFailReason, const CCoinControl& coin_control, bool sign)
-                         int& nChangePosInOut, std::string& strFailReason, const CCoinControl& coin_control, bool sign, AvailableCoinsType nCoinType, bool fUseInstantSend)
+                         // VELES BEGIN
+                         //int& nChangePosInOut, std::string& strFailReason, const CCoinControl& coin_control, bool sign, AvailableCoinsType nCoinType, bool fUseInstantSend)
+                         int& nChangePosInOut, std::string& strFailReason, const CCoinControl& coin_control, bool sign, AvailableCoinsType nCoinType, bool fUseInstantSend,
+                         const std::vector<COutput>* pAvailableCoins)
+                         // VELES END
                          //
 {
     // Dash
@@ -3904,8 +4680,15 @@ bool CWallet::CreateTransaction(interfaces::Chain::Lock& locked_chain, const std
         auto locked_chain = chain().lock();
         LOCK(cs_wallet);
         {
-            std::vector<COutput> vAvailableCoins;
-            AvailableCoins(*locked_chain, vAvailableCoins, true, &coin_control);
+            // VELES BEGIN
+            // std::vector<COutput> vAvailableCoins;
+            // AvailableCoins(*locked_chain, vAvailableCoins, true, &coin_control);
+            // The coins of a batch of transactions are only listed once by the caller
+            std::vector<COutput> vWalletCoins;
+            if (!pAvailableCoins)
+                AvailableCoins(*locked_chain, vWalletCoins, true, &coin_control);
+            const std::vector<COutput>& vAvailableCoins = pAvailableCoins ? *pAvailableCoins : vWalletCoins;
+            // VELES END
             CoinSelectionParams coin_selection_params; // Parameters for coin selection, init with dummy
 
             // Create change script that will be used if we need change
@@ -4491,6 +5274,7 @@ DBErrors CWallet::ZapSelectTx(std::vector<uint256>& vHashIn, std::vector<uint256
         wtxOrdered.erase(it->second.m_it_wtxOrdered);
         mapWallet.erase(it);
     }
+    fCoinsIndexBuilt = false; // VELES
 
     if (nZapSelectTxRet == DBErrors::NEED_REWRITE)
     {
@@ -4694,6 +5478,21 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
         }
         bool internal = false;
         WalletBatch batch(*database);
+        // VELES BEGIN
+        // write all the new keys and pool entries at once
+        const bool fTxn = batch.TxnBegin();
+        if (IsHDEnabled()) {
+            std::vector<CPubKey> vPubKeys;
+            DeriveNewChildKeys(batch, missingExternal, false, vPubKeys);
+            for (const CPubKey& pubkey : vPubKeys) {
+                AddKeypoolPubkeyWithDB(pubkey, false, batch);
+            }
+            DeriveNewChildKeys(batch, missingInternal, true, vPubKeys);
+            for (const CPubKey& pubkey : vPubKeys) {
+                AddKeypoolPubkeyWithDB(pubkey, true, batch);
+            }
+        } else
+        // VELES END
         for (int64_t i = missingInternal + missingExternal; i--;)
         {
             if (i < missingInternal) {
@@ -4703,6 +5502,11 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
             CPubKey pubkey(GenerateNewKey(batch, internal));
             AddKeypoolPubkeyWithDB(pubkey, internal, batch);
         }
+        // VELES BEGIN
+        if (fTxn && !batch.TxnCommit()) {
+            throw std::runtime_error(std::string(__func__) + ": writing the keypool failed");
+        }
+        // VELES END
         if (missingInternal + missingExternal > 0) {
             WalletLogPrintf("keypool added %d keys (%d internal), size=%u (%u internal)\n", missingInternal + missingExternal, missingInternal, setInternalKeyPool.size() + setExternalKeyPool.size() + set_pre_split_keypool.size(), setInternalKeyPool.size());
         }
@@ -5082,6 +5886,7 @@ bool CWallet::UpdatedTransaction(const uint256 &hashTx)
         // Only notify UI if this transaction is in this wallet
         map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hashTx);
         if (mi != mapWallet.end()){
+            InvalidateBalanceCache(); // VELES
             NotifyTransactionChanged(this, hashTx, CT_UPDATED);
             return true;
         }
@@ -5129,6 +5934,23 @@ void CWallet::UnlockCoin(const COutPoint& output)
     //
 }
 
+// VELES BEGIN
+void CWallet::LockMasternodeCollaterals(const std::set<COutPoint>& setOutpoints)
+{
+    AssertLockHeld(cs_wallet); // setMasternodeCollaterals
+    setMasternodeCollaterals = setOutpoints;
+    for (const COutPoint& outpoint : setMasternodeCollaterals) {
+        // don't lock non-spendable outpoint (i.e. it's already spent or it's not from this wallet at all)
+        if (IsMine(CTxIn(outpoint)) != ISMINE_SPENDABLE) {
+            WalletLogPrintf("  %s - IS NOT SPENDABLE, was not locked\n", outpoint.ToStringShort());
+            continue;
+        }
+        LockCoin(outpoint);
+        WalletLogPrintf("  %s - locked successfully\n", outpoint.ToStringShort());
+    }
+}
+// VELES END
+
 void CWallet::UnlockAllCoins()
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
@@ -22,6 +22,7 @@
 #include <validationinterface.h>
 #include <wallet/crypter.h>
 #include <wallet/coinselection.h>
+#include <wallet/txfilter.h> // VELES
 #include <wallet/walletdb.h>
 #include <wallet/walletutil.h>
 
@@ -37,6 +38,7 @@
 #include <stdexcept>
 #include <stdint.h>
 #include <string>
+#include <tuple> // VELES
 #include <utility>
 #include <vector>
 
@@ -578,8 +580,14 @@ public:
         fImmatureWatchCreditCached = false;
         fDebitCached = false;
         fChangeCached = false;
+        InvalidateWalletBalances(); // VELES
     }
 
+    // VELES BEGIN
+    //! drop the balance totals cached by the wallet, they include this transaction
+    void InvalidateWalletBalances() const;
+    // VELES END
+
     void BindWallet(CWallet *pwalletIn)
     {
         pwallet = pwalletIn;
@@ -763,6 +771,30 @@ private:
     mutable std::vector<CompactTallyItem> vecAnonymizableTallyCachedNonDenom;
     //
 
+    // VELES BEGIN
+    //! Balance totals by query kind and parameters, valid as long as nBalanceCacheGeneration doesn't change
+    typedef std::tuple<int, int, int> balance_key_t;
+    mutable std::map<balance_key_t, CAmount> mapBalanceCache GUARDED_BY(cs_wallet);
+    mutable uint64_t nBalanceCacheGenerationUsed GUARDED_BY(cs_wallet) = 0;
+    mutable std::atomic<uint64_t> nBalanceCacheGeneration{1};
+    bool GetCachedBalance(const balance_key_t& key, CAmount& nBalanceRet, uint64_t& nGenerationRet) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void SetCachedBalance(const balance_key_t& key, CAmount nBalance, uint64_t nGeneration) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
+    //! Wallet coinbases by the height of the tip at which they become mature, rebuilt from mapWallet when stale
+    std::multimap<int, uint256> mapMaturityQueue GUARDED_BY(cs_wallet);
+    bool fMaturityQueueStale GUARDED_BY(cs_wallet) = true;
+    //! Drops what a new tip at nHeight changes in the cached balances, the transactions it confirms are marked dirty when synced
+    void UpdateBalanceCacheForTip(interfaces::Chain::Lock& locked_chain, int nHeight) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    // VELES END
+
+    // VELES BEGIN
+    //! PrivateSend rounds of the wallet outpoints, also kept in the wallet database
+    mutable std::map<COutPoint, int> mapOutpointRoundsCache GUARDED_BY(cs_wallet);
+    int SetOutpointPrivateSendRounds(const COutPoint& outpoint, int nRounds) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    //! Forgets the cached rounds, in memory and on disk
+    void ClearOutpointRoundsCache() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    // VELES END
+
     /**
      * Used to keep track of spent outpoints, and
      * detect and report conflicts (double-spends or
@@ -777,6 +809,40 @@ private:
     std::set<COutPoint> setWalletUTXO;
     //
 
+    // VELES BEGIN
+    /**
+     * Outputs of the wallet transactions that may still be unspent, walked by
+     * AvailableCoins instead of every output in mapWallet. Outputs found spent
+     * there are dropped and come back when the spender changes state (conflicted,
+     * abandoned, synced again), so the index never misses an available coin.
+     * Built on first use, after the PrivateSend denominations are known.
+     */
+    mutable std::set<COutPoint> setCoinsIndex GUARDED_BY(cs_wallet);
+    //! Denominated subset of setCoinsIndex, for the PrivateSend coin selection
+    mutable std::set<COutPoint> setDenominatedCoinsIndex GUARDED_BY(cs_wallet);
+    //! Masternode collateral sized subset of setCoinsIndex, for `masternode outputs` and the masternode start
+    mutable std::set<COutPoint> setCollateralCoinsIndex GUARDED_BY(cs_wallet);
+    /** Collaterals of masternode.conf, locked as soon as the wallet can spend them */
+    std::set<COutPoint> setMasternodeCollaterals GUARDED_BY(cs_wallet);
+    mutable bool fCoinsIndexBuilt GUARDED_BY(cs_wallet) = false;
+    void AddToCoinsIndex(const COutPoint& outpoint, const CAmount& nValue) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void RemoveFromCoinsIndex(const COutPoint& outpoint) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void BuildCoinsIndex() const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /**
+     * Coins of setDenominatedCoinsIndex by denomination and PrivateSend rounds,
+     * so the mixing sessions select their inputs without going through every
+     * denominated coin. New coins wait in setDenominatedCoinsUnsorted until the
+     * next selection computes their rounds, all of them go back there when the
+     * rounds cache is cleared.
+     */
+    mutable std::map<std::pair<CAmount, int>, std::set<COutPoint>> mapDenominatedCoinsByRounds GUARDED_BY(cs_wallet);
+    mutable std::map<COutPoint, std::pair<CAmount, int>> mapDenominatedCoinKeys GUARDED_BY(cs_wallet);
+    mutable std::set<COutPoint> setDenominatedCoinsUnsorted GUARDED_BY(cs_wallet);
+    void SortDenominatedCoins() const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    //! Selects in coinControl the indexed coins of these denominations with nRoundsMin <= rounds < nRoundsMax
+    void SelectDenominatedCoins(const std::vector<CAmount>& vecDenoms, int nRoundsMin, int nRoundsMax, CCoinControl& coinControl) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    // VELES END
+
     /**
      * Add a transaction to the wallet, or update it.  pIndex and posInBlock should
      * be set when the transaction was known to be included in a block.  When
@@ -809,6 +875,10 @@ private:
 
     /* HD derive new child key (on internal or external chain) */
     void DeriveNewChildKey(WalletBatch &batch, CKeyMetadata& metadata, CKey& secret, bool internal = false) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    // VELES BEGIN
+    /* HD derive the next nCount unknown child keys of a chain on several threads and add them to the wallet */
+    void DeriveNewChildKeys(WalletBatch &batch, int64_t nCount, bool internal, std::vector<CPubKey>& vPubKeysRet) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    // VELES END
 
     std::set<int64_t> setInternalKeyPool;
     std::set<int64_t> setExternalKeyPool GUARDED_BY(cs_wallet);
@@ -916,6 +986,7 @@ public:
     {
         // Should not have slots connected at this point.
         assert(NotifyUnload.empty());
+        g_wallet_tx_filter.RemoveWallet(this); // VELES
         delete encrypted_batch;
         encrypted_batch = nullptr;
     }
@@ -991,7 +1062,7 @@ public:
     int  CountInputsWithAmount(CAmount nInputAmount);
 
     // get the PrivateSend chain depth for a given input
-    int GetRealOutpointPrivateSendRounds(const COutPoint& outpoint, int nRounds) const;
+    int GetRealOutpointPrivateSendRounds(const COutPoint& outpoint, int nRounds) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet); // VELES
     // respect current settings
     int GetOutpointPrivateSendRounds(const COutPoint& outpoint) const;
 
@@ -1004,6 +1075,10 @@ public:
     bool IsLockedCoin(uint256 hash, unsigned int n) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     void LockCoin(const COutPoint& output) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     void UnlockCoin(const COutPoint& output) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    // VELES BEGIN
+    /** Lock the given masternode collaterals, and the ones of them the wallet only receives later on */
+    void LockMasternodeCollaterals(const std::set<COutPoint>& setOutpoints) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    // VELES END
     void UnlockAllCoins() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     void ListLockedCoins(std::vector<COutPoint>& vOutpts) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
@@ -1023,7 +1098,16 @@ public:
     bool AddKeyPubKey(const CKey& key, const CPubKey &pubkey) override EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     bool AddKeyPubKeyWithDB(WalletBatch &batch,const CKey& key, const CPubKey &pubkey) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     //! Adds a key to the store, without saving it to disk (used by LoadWallet)
-    bool LoadKey(const CKey& key, const CPubKey &pubkey) { return CCryptoKeyStore::AddKeyPubKey(key, pubkey); }
+    //bool LoadKey(const CKey& key, const CPubKey &pubkey) { return CCryptoKeyStore::AddKeyPubKey(key, pubkey); }
+    // VELES BEGIN
+    bool LoadKey(const CKey& key, const CPubKey &pubkey)
+    {
+        if (!CCryptoKeyStore::AddKeyPubKey(key, pubkey))
+            return false;
+        g_wallet_tx_filter.AddKey(this, pubkey.GetID());
+        return true;
+    }
+    // VELES END
     //! Load metadata (used by LoadWallet)
     void LoadKeyMetadata(const CKeyID& keyID, const CKeyMetadata &metadata) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     void LoadScriptMetadata(const CScriptID& script_id, const CKeyMetadata &metadata) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
@@ -1046,6 +1130,10 @@ public:
     bool EraseDestData(const CTxDestination& dest, const std::string& key) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     //! Adds a destination data tuple to the store, without saving it to disk
     void LoadDestData(const CTxDestination& dest, const std::string& key, const std::string& value) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    // VELES BEGIN
+    //! Adds the PrivateSend rounds of an outpoint to the cache, without saving them to disk
+    void LoadOutpointPrivateSendRounds(const COutPoint& outpoint, int nRounds) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    // VELES END
     //! Look up a destination data tuple in the store, return true if found false otherwise
     bool GetDestData(const CTxDestination& dest, const std::string& key, std::string* value) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     //! Get all destination values matching a prefix.
@@ -1106,6 +1194,10 @@ public:
     void ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman) override EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     // ResendWalletTransactionsBefore may only be called if fBroadcastTransactions!
     std::vector<uint256> ResendWalletTransactionsBefore(interfaces::Chain::Lock& locked_chain, int64_t nTime, CConnman* connman);
+    // VELES BEGIN
+    //! Drops the cached balance totals, lock free so it can be called from any wallet transaction change
+    void InvalidateBalanceCache() const { ++nBalanceCacheGeneration; }
+    // VELES END
     CAmount GetBalance(const isminefilter& filter=ISMINE_SPENDABLE, const int min_depth=0) const;
     CAmount GetUnconfirmedBalance() const;
     CAmount GetImmatureBalance() const;
@@ -1146,7 +1238,11 @@ public:
     bool CreateTransaction(interfaces::Chain::Lock& locked_chain, const std::vector<CRecipient>& vecSend, CTransactionRef& tx, CReserveKey& reservekey, CAmount& nFeeRet, int& nChangePosInOut,
                            // Dash
                            //std::string& strFailReason, const CCoinControl& coin_control, bool sign = true);
-                           std::string& strFailReason, const CCoinControl& coin_control, bool sign = true, AvailableCoinsType nCoinType = ALL_COINS, bool fUseInstantSend = false);
+                           // VELES BEGIN
+                           //std::string& strFailReason, const CCoinControl& coin_control, bool sign = true, AvailableCoinsType nCoinType = ALL_COINS, bool fUseInstantSend = false);
+                           std::string& strFailReason, const CCoinControl& coin_control, bool sign = true, AvailableCoinsType nCoinType = ALL_COINS, bool fUseInstantSend = false,
+                           const std::vector<COutput>* pAvailableCoins = nullptr);
+                           // VELES END
                            //
     // Dash
     //bool CommitTransaction(CTransactionRef tx, mapValue_t mapValue, std::vector<std::pair<std::string, std::string>> orderForm, CReserveKey& reservekey, CConnman* connman, CValidationState& state);
@@ -1231,6 +1327,17 @@ public:
     bool IsChange(const CScript& script) const;
     CAmount GetChange(const CTxOut& txout) const;
     bool IsMine(const CTransaction& tx) const;
+    // VELES BEGIN
+    /** Whether a transaction without outputs of ours could still be added to or affect the wallet in a rescan */
+    bool IsRelevantToScan(const CTransaction& tx) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /** Number of keys, scripts and watch-only entries, it changes whenever IsMine() may answer differently */
+    size_t GetKeyStoreSize() const;
+    /**
+     * Scripts of our keys, P2SH/P2WSH scripts and watch-only scripts to match against block filters.
+     * Bare multisig outputs are not covered, rescans using block filters don't find them.
+     */
+    GCSFilter::ElementSet GetScanFilterElements() const;
+    // VELES END
     /** should probably be renamed to IsRelevantToMe */
     bool IsFromMe(const CTransaction& tx) const;
     CAmount GetDebit(const CTransaction& tx, const isminefilter& filter) const;
@@ -1484,6 +1591,11 @@ public:
     }
 };
 
+// VELES BEGIN
+/** Run an instance of the wallet rescan matching thread */
+void ThreadWalletScanCheck();
+// VELES END
+
 // Calculate the size of the transaction assuming all signatures are max size
 // Use DummySignatureCreator, which inserts 71 byte signatures everywhere.
 // NOTE: this requires that all inputs must be in mapWallet (eg the tx should
@@ -414,7 +414,18 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
             CHDChain chain;
             ssValue >> chain;
             pwallet->SetHDChain(chain, true);
-        } else if (strType == "flags") {
+        }
+        // VELES BEGIN
+        else if (strType == "psrounds")
+        {
+            COutPoint outpoint;
+            int nRounds;
+            ssKey >> outpoint;
+            ssValue >> nRounds;
+            pwallet->LoadOutpointPrivateSendRounds(outpoint, nRounds);
+        }
+        // VELES END
+        else if (strType == "flags") {
             uint64_t flags;
             ssValue >> flags;
             if (!pwallet->SetWalletFlags(flags, true)) {
@@ -680,11 +691,23 @@ void MaybeCompactWalletDB()
         if (dbh.nLastSeen != nUpdateCounter) {
             dbh.nLastSeen = nUpdateCounter;
             dbh.nLastWalletUpdate = GetTime();
-        }
-
-        if (dbh.nLastFlushed != nUpdateCounter && GetTime() - dbh.nLastWalletUpdate >= 2) {
+            // VELES BEGIN
+            if (dbh.nFirstUnflushedUpdate == 0)
+                dbh.nFirstUnflushedUpdate = dbh.nLastWalletUpdate;
+            // VELES END
+        }
+
+        //if (dbh.nLastFlushed != nUpdateCounter && GetTime() - dbh.nLastWalletUpdate >= 2) {
+        // VELES BEGIN
+        // Flush once the wallet is idle, or anyway when the oldest pending update gets too old
+        const int64_t nNow = GetTime();
+        const bool fIdle = nNow - dbh.nLastWalletUpdate >= gArgs.GetArg("-walletflushdelay", DEFAULT_WALLET_FLUSH_DELAY);
+        const bool fWindowElapsed = dbh.nFirstUnflushedUpdate != 0 && nNow - dbh.nFirstUnflushedUpdate >= gArgs.GetArg("-walletflushwindow", DEFAULT_WALLET_FLUSH_WINDOW);
+        if (dbh.nLastFlushed != nUpdateCounter && (fIdle || fWindowElapsed)) {
+        // VELES END
             if (BerkeleyBatch::PeriodicFlush(dbh)) {
                 dbh.nLastFlushed = nUpdateCounter;
+                dbh.nFirstUnflushedUpdate = 0; // VELES
             }
         }
     }
@@ -927,6 +950,18 @@ bool WalletBatch::WriteWalletFlags(const uint64_t flags)
     return WriteIC(std::string("flags"), flags);
 }
 
+// VELES BEGIN
+bool WalletBatch::WriteOutpointPrivateSendRounds(const COutPoint& outpoint, int nRounds)
+{
+    return WriteIC(std::make_pair(std::string("psrounds"), outpoint), nRounds);
+}
+
+bool WalletBatch::EraseOutpointPrivateSendRounds(const COutPoint& outpoint)
+{
+    return EraseIC(std::make_pair(std::string("psrounds"), outpoint));
+}
+// VELES END
+
 bool WalletBatch::TxnBegin()
 {
     return m_batch.TxnBegin();
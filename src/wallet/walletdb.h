@@ -33,6 +33,12 @@
  */
 
 static const bool DEFAULT_FLUSHWALLET = true;
+// VELES BEGIN
+//! Seconds the periodic flush waits for the wallet to be idle before writing the updates
+static const int64_t DEFAULT_WALLET_FLUSH_DELAY = 2;
+//! Seconds after which the pending updates are written even if the wallet keeps changing
+static const int64_t DEFAULT_WALLET_FLUSH_WINDOW = 30;
+// VELES END
 
 struct CBlockLocator;
 class CKeyPool;
@@ -237,6 +243,12 @@ public:
     bool WriteHDChain(const CHDChain& chain);
 
     bool WriteWalletFlags(const uint64_t flags);
+
+    // VELES BEGIN
+    bool WriteOutpointPrivateSendRounds(const COutPoint& outpoint, int nRounds);
+    bool EraseOutpointPrivateSendRounds(const COutPoint& outpoint);
+    // VELES END
+
     //! Begin a new transaction
     bool TxnBegin();
     //! Commit current transaction
@@ -252,6 +264,27 @@ private:
     WalletDatabase& m_database;
 };
 
+// VELES BEGIN
+/**
+ * While alive, the batches opened on the database don't flush on close and the
+ * periodic flush writes their updates within the -walletflushwindow, so a run of
+ * many small writes (a connected block, a rescan, a PrivateSend denomination run)
+ * doesn't checkpoint the database after each of them. Scopes can be nested.
+ */
+class WalletFlushDeferral
+{
+public:
+    explicit WalletFlushDeferral(WalletDatabase& database) : m_database(database) { ++m_database.nFlushDeferDepth; }
+    ~WalletFlushDeferral() { --m_database.nFlushDeferDepth; }
+
+    WalletFlushDeferral(const WalletFlushDeferral&) = delete;
+    WalletFlushDeferral& operator=(const WalletFlushDeferral&) = delete;
+
+private:
+    WalletDatabase& m_database;
+};
+// VELES END
+
 //! Compacts BDB state so that wallet.dat is self-contained (if there are changes)
 void MaybeCompactWalletDB();
 
@@ -21,3 +21,35 @@ bool CZMQAbstractNotifier::NotifyTransaction(const CTransaction &/*transaction*/
 {
     return true;
 }
+
+// VELES BEGIN
+bool CZMQAbstractNotifier::NotifyTransactionLock(const CTransaction &/*transaction*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyGovernanceObject(const uint256 &/*nHash*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyGovernanceVote(const uint256 &/*nHash*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyMasternodeListChanged(const COutPoint &/*outpoint*/, bool /*fRemoved*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyBlockConnected(const CBlock &/*block*/, const CBlockIndex */*pindex*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyBlockDisconnected(const CBlock &/*block*/, const CBlockIndex */*pindex*/)
+{
+    return true;
+}
+// VELES END
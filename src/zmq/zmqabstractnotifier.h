@@ -10,6 +10,21 @@
 class CBlockIndex;
 class CZMQAbstractNotifier;
 
+// VELES BEGIN
+/** Counters of the messages of a notifier, reported by getzmqnotifications */
+struct CZMQNotifierStats
+{
+    uint64_t nSent {0};
+    //! Messages dropped because the publishing queue was full or the send failed
+    uint64_t nDropped {0};
+    //! Messages waiting to be sent
+    uint64_t nQueued {0};
+    //! Milliseconds the last sent message waited to be sent
+    int64_t nLastLagMillis {0};
+    int64_t nMaxLagMillis {0};
+};
+// VELES END
+
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
 
 class CZMQAbstractNotifier
@@ -39,9 +54,20 @@ public:
 
     virtual bool Initialize(void *pcontext) = 0;
     virtual void Shutdown() = 0;
+    // VELES BEGIN
+    virtual CZMQNotifierStats GetStats() const { return CZMQNotifierStats(); }
+    // VELES END
 
     virtual bool NotifyBlock(const CBlockIndex *pindex);
     virtual bool NotifyTransaction(const CTransaction &transaction);
+    // VELES BEGIN
+    virtual bool NotifyTransactionLock(const CTransaction &transaction);
+    virtual bool NotifyGovernanceObject(const uint256 &nHash);
+    virtual bool NotifyGovernanceVote(const uint256 &nHash);
+    virtual bool NotifyMasternodeListChanged(const COutPoint &outpoint, bool fRemoved);
+    virtual bool NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex);
+    virtual bool NotifyBlockDisconnected(const CBlock &block, const CBlockIndex *pindex);
+    // VELES END
 
 protected:
     void *psocket;
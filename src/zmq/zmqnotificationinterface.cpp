@@ -48,6 +48,16 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
     factories["pubhashtx"] = CZMQAbstractNotifier::Create<CZMQPublishHashTransactionNotifier>;
     factories["pubrawblock"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockNotifier>;
     factories["pubrawtx"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionNotifier>;
+    // VELES BEGIN
+    factories["pubwork"] = CZMQAbstractNotifier::Create<CZMQPublishWorkNotifier>;
+    factories["pubhashtxlock"] = CZMQAbstractNotifier::Create<CZMQPublishHashTransactionLockNotifier>;
+    factories["pubrawtxlock"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionLockNotifier>;
+    factories["pubhashgovernanceobject"] = CZMQAbstractNotifier::Create<CZMQPublishHashGovernanceObjectNotifier>;
+    factories["pubhashgovernancevote"] = CZMQAbstractNotifier::Create<CZMQPublishHashGovernanceVoteNotifier>;
+    factories["pubmasternodelistchange"] = CZMQAbstractNotifier::Create<CZMQPublishMasternodeListChangeNotifier>;
+    factories["pubhashtxbatch"] = CZMQAbstractNotifier::Create<CZMQPublishHashTransactionBatchNotifier>;
+    factories["pubblockdelta"] = CZMQAbstractNotifier::Create<CZMQPublishBlockDeltaNotifier>;
+    // VELES END
 
     for (const auto& entry : factories)
     {
@@ -117,6 +127,10 @@ bool CZMQNotificationInterface::Initialize()
         return false;
     }
 
+    // VELES BEGIN
+    g_zmq_publish_queue.Start(std::max<int64_t>(1, gArgs.GetArg("-zmqqueuesize", DEFAULT_ZMQ_QUEUE_SIZE)));
+    // VELES END
+
     return true;
 }
 
@@ -126,6 +140,10 @@ void CZMQNotificationInterface::Shutdown()
     LogPrint(BCLog::ZMQ, "zmq: Shutdown notification interface\n");
     if (pcontext)
     {
+        // VELES BEGIN
+        // Publish what is left before the sockets close
+        g_zmq_publish_queue.Stop();
+        // VELES END
         for (std::list<CZMQAbstractNotifier*>::iterator i=notifiers.begin(); i!=notifiers.end(); ++i)
         {
             CZMQAbstractNotifier *notifier = *i;
@@ -185,6 +203,12 @@ void CZMQNotificationInterface::BlockConnected(const std::shared_ptr<const CBloc
         // Do a normal notify for each transaction added in the block
         TransactionAddedToMempool(ptx);
     }
+
+    // VELES BEGIN
+    TryForEachAndRemoveFailed([&pblock, pindexConnected](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyBlockConnected(*pblock, pindexConnected);
+    });
+    // VELES END
 }
 
 void CZMQNotificationInterface::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock)
@@ -193,6 +217,67 @@ void CZMQNotificationInterface::BlockDisconnected(const std::shared_ptr<const CB
         // Do a normal notify for each transaction removed in block disconnection
         TransactionAddedToMempool(ptx);
     }
+
+    // VELES BEGIN
+    const CBlockIndex* pindex;
+    {
+        LOCK(cs_main);
+        pindex = LookupBlockIndex(pblock->GetHash());
+    }
+    if (pindex) {
+        TryForEachAndRemoveFailed([&pblock, pindex](CZMQAbstractNotifier* notifier) {
+            return notifier->NotifyBlockDisconnected(*pblock, pindex);
+        });
+    }
+    // VELES END
 }
 
 CZMQNotificationInterface* g_zmq_notification_interface = nullptr;
+
+// VELES BEGIN
+template <typename Function>
+void CZMQNotificationInterface::TryForEachAndRemoveFailed(const Function& func)
+{
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    {
+        CZMQAbstractNotifier *notifier = *i;
+        if (func(notifier))
+        {
+            i++;
+        }
+        else
+        {
+            notifier->Shutdown();
+            i = notifiers.erase(i);
+        }
+    }
+}
+
+void CZMQNotificationInterface::NotifyTransactionLock(const CTransaction &tx)
+{
+    TryForEachAndRemoveFailed([&tx](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyTransactionLock(tx);
+    });
+}
+
+void CZMQNotificationInterface::NotifyGovernanceObject(const uint256 &nHash)
+{
+    TryForEachAndRemoveFailed([&nHash](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyGovernanceObject(nHash);
+    });
+}
+
+void CZMQNotificationInterface::NotifyGovernanceVote(const uint256 &nHash)
+{
+    TryForEachAndRemoveFailed([&nHash](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyGovernanceVote(nHash);
+    });
+}
+
+void CZMQNotificationInterface::NotifyMasternodeListChanged(const COutPoint &outpoint, bool fRemoved)
+{
+    TryForEachAndRemoveFailed([&outpoint, fRemoved](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyMasternodeListChanged(outpoint, fRemoved);
+    });
+}
+// VELES END
@@ -31,12 +31,24 @@ protected:
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected, const std::vector<CTransactionRef>& vtxConflicted) override;
     void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) override;
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+    // VELES BEGIN
+    void NotifyTransactionLock(const CTransaction &tx) override;
+    void NotifyGovernanceObject(const uint256 &nHash) override;
+    void NotifyGovernanceVote(const uint256 &nHash) override;
+    void NotifyMasternodeListChanged(const COutPoint &outpoint, bool fRemoved) override;
+    // VELES END
 
 private:
     CZMQNotificationInterface();
 
     void *pcontext;
     std::list<CZMQAbstractNotifier*> notifiers;
+
+    // VELES BEGIN
+    // Calls func on every notifier, the ones that fail are shut down and removed
+    template <typename Function>
+    void TryForEachAndRemoveFailed(const Function& func);
+    // VELES END
 };
 
 extern CZMQNotificationInterface* g_zmq_notification_interface;
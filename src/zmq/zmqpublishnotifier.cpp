@@ -9,6 +9,17 @@
 #include <validation.h>
 #include <util/system.h>
 #include <rpc/server.h>
+// VELES BEGIN
+#include <blockdelta.h>
+#include <consensus/merkle.h>
+#include <key_io.h>
+#include <miner.h>
+#include <util/moneystr.h>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+// VELES END
 
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
@@ -16,6 +27,18 @@ static const char *MSG_HASHBLOCK = "hashblock";
 static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
+// VELES BEGIN
+static const char *MSG_WORK      = "work";
+static const char *MSG_HASHTXLOCK = "hashtxlock";
+static const char *MSG_RAWTXLOCK  = "rawtxlock";
+static const char *MSG_HASHGOVERNANCEOBJECT = "hashgovernanceobject";
+static const char *MSG_HASHGOVERNANCEVOTE   = "hashgovernancevote";
+static const char *MSG_MASTERNODELISTCHANGE = "masternodelistchange";
+static const char *MSG_HASHTXBATCH = "hashtxbatch";
+static const char *MSG_BLOCKDELTA = "blockdelta";
+
+CZMQPublishQueue g_zmq_publish_queue;
+// VELES END
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -60,6 +83,141 @@ static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
     return 0;
 }
 
+// VELES BEGIN
+void CZMQPublishQueue::Start(size_t nMaxSizeIn)
+{
+    assert(!thread.joinable());
+    {
+        LOCK(cs);
+        nMaxSize = nMaxSizeIn;
+        fStop = false;
+    }
+    thread = std::thread(&TraceThread<std::function<void()>>, "zmqpub", std::bind(&CZMQPublishQueue::ThreadPublish, this));
+}
+
+void CZMQPublishQueue::Stop()
+{
+    if (!thread.joinable())
+        return;
+    {
+        LOCK(cs);
+        fStop = true;
+    }
+    cond.notify_all();
+    thread.join();
+}
+
+void CZMQPublishQueue::Enqueue(CZMQAbstractPublishNotifier* notifier, const char* command, std::vector<unsigned char>&& data)
+{
+    NotifierState& state = mapStates[notifier];
+    const uint32_t nSequence = state.nSequence++;
+    if (deqMessages.size() >= nMaxSize) {
+        state.stats.nDropped++;
+        return;
+    }
+    deqMessages.push_back(Message{notifier, command, std::move(data), nSequence, GetTimeMillis()});
+    state.stats.nQueued++;
+    cond.notify_all();
+}
+
+void CZMQPublishQueue::Push(CZMQAbstractPublishNotifier* notifier, const char* command, const void* data, size_t size)
+{
+    const unsigned char* begin = static_cast<const unsigned char*>(data);
+    LOCK(cs);
+    Enqueue(notifier, command, std::vector<unsigned char>(begin, begin + size));
+}
+
+void CZMQPublishQueue::PushBatch(CZMQAbstractPublishNotifier* notifier, const char* command, const void* data, size_t size, int64_t nIntervalMillis, size_t nMaxBatchSize)
+{
+    const unsigned char* begin = static_cast<const unsigned char*>(data);
+    LOCK(cs);
+    auto it = mapBatches.find(notifier);
+    if (it == mapBatches.end()) {
+        it = mapBatches.emplace(notifier, Batch{command, {}, GetTimeMillis() + nIntervalMillis}).first;
+        // The thread may be waiting without a deadline
+        cond.notify_all();
+    }
+    it->second.data.insert(it->second.data.end(), begin, begin + size);
+    if (it->second.data.size() >= nMaxBatchSize) {
+        Enqueue(notifier, it->second.command, std::move(it->second.data));
+        mapBatches.erase(it);
+    }
+}
+
+void CZMQPublishQueue::Remove(const CZMQAbstractPublishNotifier* notifier)
+{
+    WAIT_LOCK(cs, lock);
+    deqMessages.erase(std::remove_if(deqMessages.begin(), deqMessages.end(),
+        [notifier](const Message& message) { return message.notifier == notifier; }), deqMessages.end());
+    mapBatches.erase(const_cast<CZMQAbstractPublishNotifier*>(notifier));
+    mapStates.erase(notifier);
+    cond.wait(lock, [this, notifier]() { return pnotifierSending != notifier; });
+}
+
+CZMQNotifierStats CZMQPublishQueue::GetStats(const CZMQAbstractPublishNotifier* notifier)
+{
+    LOCK(cs);
+    auto it = mapStates.find(notifier);
+    return it == mapStates.end() ? CZMQNotifierStats() : it->second.stats;
+}
+
+void CZMQPublishQueue::ThreadPublish()
+{
+    WAIT_LOCK(cs, lock);
+    while (true) {
+        // Queue the batches that are due, all of them when stopping
+        const int64_t nNow = GetTimeMillis();
+        int64_t nNextDue = std::numeric_limits<int64_t>::max();
+        for (auto it = mapBatches.begin(); it != mapBatches.end(); ) {
+            if (fStop || it->second.nTimeDue <= nNow) {
+                Enqueue(it->first, it->second.command, std::move(it->second.data));
+                it = mapBatches.erase(it);
+            } else {
+                nNextDue = std::min(nNextDue, it->second.nTimeDue);
+                ++it;
+            }
+        }
+
+        if (deqMessages.empty()) {
+            if (fStop)
+                break;
+            if (nNextDue == std::numeric_limits<int64_t>::max())
+                cond.wait(lock);
+            else
+                cond.wait_for(lock, std::chrono::milliseconds(nNextDue - nNow));
+            continue;
+        }
+
+        Message message = std::move(deqMessages.front());
+        deqMessages.pop_front();
+        pnotifierSending = message.notifier;
+        void* psocket = message.notifier->psocket;
+        lock.unlock();
+
+        /* send three parts, command & data & a LE 4byte sequence number */
+        unsigned char msgseq[sizeof(uint32_t)];
+        WriteLE32(&msgseq[0], message.nSequence);
+        int rc = zmq_send_multipart(psocket, message.command, strlen(message.command), message.data.data(), message.data.size(), msgseq, (size_t)sizeof(uint32_t), nullptr);
+
+        lock.lock();
+        pnotifierSending = nullptr;
+        auto it = mapStates.find(message.notifier);
+        if (it != mapStates.end()) {
+            CZMQNotifierStats& stats = it->second.stats;
+            stats.nQueued--;
+            if (rc == -1) {
+                stats.nDropped++;
+            } else {
+                stats.nSent++;
+                stats.nLastLagMillis = GetTimeMillis() - message.nTimeQueued;
+                stats.nMaxLagMillis = std::max(stats.nMaxLagMillis, stats.nLastLagMillis);
+            }
+        }
+        cond.notify_all();
+    }
+}
+// VELES END
+
 bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 {
     assert(!psocket);
@@ -114,6 +272,8 @@ void CZMQAbstractPublishNotifier::Shutdown()
 {
     assert(psocket);
 
+    g_zmq_publish_queue.Remove(this); // VELES
+
     int count = mapPublishNotifiers.count(address);
 
     // remove this notifier from the list of publishers using this address
@@ -144,19 +304,38 @@ bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* d
 {
     assert(psocket);
 
-    /* send three parts, command & data & a LE 4byte sequence number */
-    unsigned char msgseq[sizeof(uint32_t)];
-    WriteLE32(&msgseq[0], nSequence);
-    int rc = zmq_send_multipart(psocket, command, strlen(command), data, size, msgseq, (size_t)sizeof(uint32_t), nullptr);
-    if (rc == -1)
-        return false;
+    // VELES BEGIN
+    g_zmq_publish_queue.Push(this, command, data, size);
+    return true;
+    // VELES END
+    ///* send three parts, command & data & a LE 4byte sequence number */
+    //unsigned char msgseq[sizeof(uint32_t)];
+    //WriteLE32(&msgseq[0], nSequence);
+    //int rc = zmq_send_multipart(psocket, command, strlen(command), data, size, msgseq, (size_t)sizeof(uint32_t), nullptr);
+    //if (rc == -1)
+    //    return false;
+    //
+    ///* increment memory only sequence number after sending */
+    //nSequence++;
+    //
+    //return true;
+}
 
-    /* increment memory only sequence number after sending */
-    nSequence++;
+// VELES BEGIN
+bool CZMQAbstractPublishNotifier::AddToBatch(const char *command, const void* data, size_t size, int64_t nIntervalMillis, size_t nMaxSize)
+{
+    assert(psocket);
 
+    g_zmq_publish_queue.PushBatch(this, command, data, size, nIntervalMillis, nMaxSize);
     return true;
 }
 
+CZMQNotifierStats CZMQAbstractPublishNotifier::GetStats() const
+{
+    return g_zmq_publish_queue.GetStats(this);
+}
+// VELES END
+
 bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
 {
     uint256 hash = pindex->GetBlockHash();
@@ -206,3 +385,204 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
     ss << transaction;
     return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
 }
+
+// VELES BEGIN
+bool CZMQPublishBlockDeltaNotifier::SendDelta(const CBlock &block, const CBlockIndex *pindex, bool fConnected)
+{
+    CBlockDelta delta;
+    if (!GetBlockDelta(block, pindex, fConnected, delta)) {
+        // Pruned already, there is nothing to publish
+        LogPrint(BCLog::ZMQ, "zmq: Can't read the undo data of block %s\n", pindex->GetBlockHash().GetHex());
+        return true;
+    }
+
+    LogPrint(BCLog::ZMQ, "zmq: Publish blockdelta %s %s\n", pindex->GetBlockHash().GetHex(), fConnected ? "connected" : "disconnected");
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << delta;
+    return SendMessage(MSG_BLOCKDELTA, &(*ss.begin()), ss.size());
+}
+
+bool CZMQPublishBlockDeltaNotifier::NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex)
+{
+    return SendDelta(block, pindex, true);
+}
+
+bool CZMQPublishBlockDeltaNotifier::NotifyBlockDisconnected(const CBlock &block, const CBlockIndex *pindex)
+{
+    return SendDelta(block, pindex, false);
+}
+
+bool CZMQPublishHashTransactionBatchNotifier::Initialize(void *pcontext)
+{
+    nBatchInterval = std::max<int64_t>(1, gArgs.GetArg("-zmqpubhashtxbatchinterval", DEFAULT_ZMQ_HASHTX_BATCH_INTERVAL));
+    return CZMQAbstractPublishNotifier::Initialize(pcontext);
+}
+
+bool CZMQPublishHashTransactionBatchNotifier::NotifyTransaction(const CTransaction &transaction)
+{
+    uint256 hash = transaction.GetHash();
+    char data[32];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = hash.begin()[i];
+    return AddToBatch(MSG_HASHTXBATCH, data, 32, nBatchInterval, 32 * ZMQ_HASHTX_BATCH_MAX);
+}
+
+bool CZMQPublishHashTransactionLockNotifier::NotifyTransactionLock(const CTransaction &transaction)
+{
+    uint256 hash = transaction.GetHash();
+    LogPrint(BCLog::ZMQ, "zmq: Publish hashtxlock %s\n", hash.GetHex());
+    char data[32];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = hash.begin()[i];
+    return SendMessage(MSG_HASHTXLOCK, data, 32);
+}
+
+bool CZMQPublishRawTransactionLockNotifier::NotifyTransactionLock(const CTransaction &transaction)
+{
+    uint256 hash = transaction.GetHash();
+    LogPrint(BCLog::ZMQ, "zmq: Publish rawtxlock %s\n", hash.GetHex());
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+    ss << transaction;
+    return SendMessage(MSG_RAWTXLOCK, &(*ss.begin()), ss.size());
+}
+
+bool CZMQPublishHashGovernanceObjectNotifier::NotifyGovernanceObject(const uint256 &nHash)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish hashgovernanceobject %s\n", nHash.GetHex());
+    char data[32];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = nHash.begin()[i];
+    return SendMessage(MSG_HASHGOVERNANCEOBJECT, data, 32);
+}
+
+bool CZMQPublishHashGovernanceVoteNotifier::NotifyGovernanceVote(const uint256 &nHash)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish hashgovernancevote %s\n", nHash.GetHex());
+    char data[32];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = nHash.begin()[i];
+    return SendMessage(MSG_HASHGOVERNANCEVOTE, data, 32);
+}
+
+bool CZMQPublishMasternodeListChangeNotifier::NotifyMasternodeListChanged(const COutPoint &outpoint, bool fRemoved)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish masternodelistchange %s %s\n", outpoint.ToStringShort(), fRemoved ? "removed" : "added");
+    // collateral txid like hashtx, LE32 output index, 1 when added or 0 when removed
+    unsigned char data[37];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = outpoint.hash.begin()[i];
+    WriteLE32(&data[32], outpoint.n);
+    data[36] = fRemoved ? 0 : 1;
+    return SendMessage(MSG_MASTERNODELISTCHANGE, data, sizeof(data));
+}
+
+bool CZMQPublishWorkNotifier::Initialize(void *pcontext)
+{
+    CTxDestination destination = DecodeDestination(gArgs.GetArg("-zmqpubworkaddress", ""));
+    if (!IsValidDestination(destination)) {
+        LogPrintf("zmq: -zmqpubwork requires a valid -zmqpubworkaddress to pay the coinbase to\n");
+        return false;
+    }
+    scriptPayout = GetScriptForDestination(destination);
+
+    if (gArgs.IsArgSet("-zmqpubworkfeedelta") && !ParseMoney(gArgs.GetArg("-zmqpubworkfeedelta", ""), nFeeDelta)) {
+        LogPrintf("zmq: Invalid amount for -zmqpubworkfeedelta=<amount>: '%s'\n", gArgs.GetArg("-zmqpubworkfeedelta", ""));
+        return false;
+    }
+
+    return CZMQAbstractPublishNotifier::Initialize(pcontext);
+}
+
+bool CZMQPublishWorkNotifier::SendWork(const CBlockTemplate& blocktemplate, int32_t nAlgo, int nHeight)
+{
+    const CBlock& block = blocktemplate.block;
+
+    // Reserve the extranonce at the end of the coinbase scriptSig, the parts around it are sent as is
+    CMutableTransaction coinbaseTx(*block.vtx[0]);
+    coinbaseTx.vin[0].scriptSig << std::vector<unsigned char>(ZMQ_WORK_EXTRANONCE_SIZE, 0);
+    CDataStream ssTx(SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS);
+    ssTx << coinbaseTx;
+
+    const CScript& scriptSig = coinbaseTx.vin[0].scriptSig;
+    const size_t nScriptSigEnd = 4 + GetSizeOfCompactSize(1) + 36 + GetSizeOfCompactSize(scriptSig.size()) + scriptSig.size();
+    const std::vector<unsigned char> vCoinbase1(ssTx.begin(), ssTx.begin() + nScriptSigEnd - ZMQ_WORK_EXTRANONCE_SIZE);
+    const std::vector<unsigned char> vCoinbase2(ssTx.begin() + nScriptSigEnd, ssTx.end());
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << nAlgo;
+    ss << (int32_t)nHeight;
+    ss << block.nVersion << block.hashPrevBlock << block.nBits << block.nTime;
+    ss << block.vtx[0]->GetValueOut();
+    ss << vCoinbase1 << vCoinbase2;
+    ss << BlockCoinbaseMerkleBranch(block);
+
+    LogPrint(BCLog::ZMQ, "zmq: Publish work %s %s\n", GetAlgoName(nAlgo), block.hashPrevBlock.GetHex());
+    return SendMessage(MSG_WORK, &(*ss.begin()), ss.size());
+}
+
+bool CZMQPublishWorkNotifier::PublishWork(const CBlockTemplate& selection)
+{
+    int nHeight;
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindexPrev = LookupBlockIndex(selection.block.hashPrevBlock);
+        if (!pindexPrev)
+            return true;
+        nHeight = pindexPrev->nHeight + 1;
+    }
+    nLastFees = -selection.vTxFees[0];
+
+    for (int32_t nAlgo : {ALGO_SHA256D, ALGO_SCRYPT, ALGO_LYRA2Z, ALGO_X11, ALGO_X16R, ALGO_NIST5}) {
+        std::unique_ptr<CBlockTemplate> pblocktemplate;
+        try {
+            pblocktemplate = BlockAssembler(Params()).CreateNewBlock(selection, scriptPayout, nAlgo);
+        } catch (const std::runtime_error& e) {
+            LogPrint(BCLog::ZMQ, "zmq: Unable to create %s work: %s\n", GetAlgoName(nAlgo), e.what());
+            continue;
+        }
+        // The tip moved on, the next block notification publishes fresh work
+        if (!pblocktemplate)
+            break;
+        if (!SendWork(*pblocktemplate, nAlgo, nHeight))
+            return false;
+    }
+    return true;
+}
+
+bool CZMQPublishWorkNotifier::NotifyBlock(const CBlockIndex *pindex)
+{
+    nLastFeeCheck = GetTime();
+
+    std::unique_ptr<CBlockTemplate> pselection;
+    try {
+        pselection = BlockAssembler(Params()).CreateNewBlock(scriptPayout, ALGO_SHA256D, &g_block_selection);
+    } catch (const std::runtime_error& e) {
+        LogPrint(BCLog::ZMQ, "zmq: Unable to create work: %s\n", e.what());
+        return true;
+    }
+    if (!pselection)
+        return true;
+
+    return PublishWork(*pselection);
+}
+
+bool CZMQPublishWorkNotifier::NotifyTransaction(const CTransaction &transaction)
+{
+    // Even updating the template on every transaction is too expensive, check the fees now and then
+    if (IsInitialBlockDownload() || GetTime() - nLastFeeCheck < ZMQ_WORK_FEE_CHECK_INTERVAL)
+        return true;
+    nLastFeeCheck = GetTime();
+
+    std::unique_ptr<CBlockTemplate> pselection;
+    try {
+        pselection = BlockAssembler(Params()).CreateNewBlock(scriptPayout, ALGO_SHA256D, &g_block_selection);
+    } catch (const std::runtime_error& e) {
+        LogPrint(BCLog::ZMQ, "zmq: Unable to create work: %s\n", e.what());
+        return true;
+    }
+    if (!pselection || -pselection->vTxFees[0] - nLastFees < nFeeDelta)
+        return true;
+
+    return PublishWork(*pselection);
+}
+// VELES END
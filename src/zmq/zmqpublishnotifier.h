@@ -7,12 +7,39 @@
 
 #include <zmq/zmqabstractnotifier.h>
 
+// VELES BEGIN
+#include <amount.h>
+#include <script/script.h>
+#include <sync.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <thread>
+#include <vector>
+// VELES END
+
 class CBlockIndex;
+// VELES BEGIN
+struct CBlockTemplate;
+class CZMQPublishQueue;
+
+/** Default number of messages waiting to be published before new ones are dropped */
+static const unsigned int DEFAULT_ZMQ_QUEUE_SIZE = 10000;
+/** Default milliseconds the hashes of a hashtxbatch message are collected for */
+static const int64_t DEFAULT_ZMQ_HASHTX_BATCH_INTERVAL = 1000;
+/** Maximum number of hashes in one hashtxbatch message */
+static const size_t ZMQ_HASHTX_BATCH_MAX = 4096;
+// VELES END
 
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
 {
+// VELES BEGIN
+    friend class CZMQPublishQueue;
+// VELES END
 private:
-    uint32_t nSequence {0U}; //!< upcounting per message sequence number
+    //uint32_t nSequence {0U}; //!< upcounting per message sequence number
+    // VELES: the sequence numbers are kept by the publishing queue
 
 public:
 
@@ -22,12 +49,80 @@ public:
           * data
           * message sequence number
     */
+    // VELES: only queues the message for the publishing thread, a message
+    // dropped because the queue is full still takes its sequence number
     bool SendMessage(const char *command, const void* data, size_t size);
+    // VELES BEGIN
+    /* add data to the message sent once nIntervalMillis passed since its
+       first data was added, or once it holds nMaxSize bytes */
+    bool AddToBatch(const char *command, const void* data, size_t size, int64_t nIntervalMillis, size_t nMaxSize);
+    CZMQNotifierStats GetStats() const override;
+    // VELES END
 
     bool Initialize(void *pcontext) override;
     void Shutdown() override;
 };
 
+// VELES BEGIN
+/**
+ * Sends the messages of the publish notifiers on a thread of its own, so
+ * slow subscribers never hold up the validation interface callbacks. The
+ * queue is bounded, the messages that don't fit are dropped and counted.
+ */
+class CZMQPublishQueue
+{
+private:
+    struct Message
+    {
+        CZMQAbstractPublishNotifier* notifier;
+        const char* command;
+        std::vector<unsigned char> data;
+        uint32_t nSequence;
+        int64_t nTimeQueued;
+    };
+
+    struct Batch
+    {
+        const char* command;
+        std::vector<unsigned char> data;
+        int64_t nTimeDue;
+    };
+
+    struct NotifierState
+    {
+        uint32_t nSequence {0U}; //!< upcounting per message sequence number
+        CZMQNotifierStats stats;
+    };
+
+    Mutex cs;
+    std::condition_variable cond;
+    std::deque<Message> deqMessages GUARDED_BY(cs);
+    std::map<CZMQAbstractPublishNotifier*, Batch> mapBatches GUARDED_BY(cs);
+    std::map<const CZMQAbstractPublishNotifier*, NotifierState> mapStates GUARDED_BY(cs);
+    //! Notifier of the message being sent, with cs released
+    const CZMQAbstractPublishNotifier* pnotifierSending GUARDED_BY(cs) {nullptr};
+    size_t nMaxSize GUARDED_BY(cs) {DEFAULT_ZMQ_QUEUE_SIZE};
+    bool fStop GUARDED_BY(cs) {false};
+    std::thread thread;
+
+    void Enqueue(CZMQAbstractPublishNotifier* notifier, const char* command, std::vector<unsigned char>&& data) EXCLUSIVE_LOCKS_REQUIRED(cs);
+    void ThreadPublish();
+
+public:
+    void Start(size_t nMaxSizeIn);
+    /** Send the queued messages and the batches being collected, then stop */
+    void Stop();
+
+    void Push(CZMQAbstractPublishNotifier* notifier, const char* command, const void* data, size_t size);
+    void PushBatch(CZMQAbstractPublishNotifier* notifier, const char* command, const void* data, size_t size, int64_t nIntervalMillis, size_t nMaxSize);
+    /** Forget the messages of notifier, once this returns none of them is being sent */
+    void Remove(const CZMQAbstractPublishNotifier* notifier);
+    CZMQNotifierStats GetStats(const CZMQAbstractPublishNotifier* notifier);
+};
+
+extern CZMQPublishQueue g_zmq_publish_queue;
+// VELES END
+
 class CZMQPublishHashBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
@@ -52,4 +147,88 @@ public:
     bool NotifyTransaction(const CTransaction &transaction) override;
 };
 
+// VELES BEGIN
+class CZMQPublishBlockDeltaNotifier : public CZMQAbstractPublishNotifier
+{
+private:
+    bool SendDelta(const CBlock &block, const CBlockIndex *pindex, bool fConnected);
+
+public:
+    bool NotifyBlockConnected(const CBlock &block, const CBlockIndex *pindex) override;
+    bool NotifyBlockDisconnected(const CBlock &block, const CBlockIndex *pindex) override;
+};
+
+class CZMQPublishHashTransactionBatchNotifier : public CZMQAbstractPublishNotifier
+{
+private:
+    int64_t nBatchInterval {DEFAULT_ZMQ_HASHTX_BATCH_INTERVAL};
+
+public:
+    bool Initialize(void *pcontext) override;
+    bool NotifyTransaction(const CTransaction &transaction) override;
+};
+// VELES END
+
+// VELES BEGIN
+class CZMQPublishHashTransactionLockNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyTransactionLock(const CTransaction &transaction) override;
+};
+
+class CZMQPublishRawTransactionLockNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyTransactionLock(const CTransaction &transaction) override;
+};
+
+class CZMQPublishHashGovernanceObjectNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyGovernanceObject(const uint256 &nHash) override;
+};
+
+class CZMQPublishHashGovernanceVoteNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyGovernanceVote(const uint256 &nHash) override;
+};
+
+class CZMQPublishMasternodeListChangeNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyMasternodeListChanged(const COutPoint &outpoint, bool fRemoved) override;
+};
+
+/** Default fee increase of the best template that triggers new work for all algos */
+static const CAmount DEFAULT_ZMQ_WORK_FEE_DELTA = COIN / 1000;
+/** Seconds between two template rebuilds triggered by new transactions */
+static const int64_t ZMQ_WORK_FEE_CHECK_INTERVAL = 5;
+/** Number of bytes reserved for the extranonce between the coinbase parts */
+static const unsigned int ZMQ_WORK_EXTRANONCE_SIZE = 8;
+
+/**
+ * Publishes compact stratum style work for every algo whenever the tip
+ * changes, or when the fees of the best template grew by the configured
+ * delta. All the algos share one selection of mempool transactions.
+ */
+class CZMQPublishWorkNotifier : public CZMQAbstractPublishNotifier
+{
+private:
+    CScript scriptPayout;
+    CAmount nFeeDelta {DEFAULT_ZMQ_WORK_FEE_DELTA};
+    //! Fees of the transactions in the last published work, -1 before the first one
+    CAmount nLastFees {-1};
+    int64_t nLastFeeCheck {0};
+
+    bool PublishWork(const CBlockTemplate& selection);
+    bool SendWork(const CBlockTemplate& blocktemplate, int32_t nAlgo, int nHeight);
+
+public:
+    bool Initialize(void *pcontext) override;
+    bool NotifyBlock(const CBlockIndex *pindex) override;
+    bool NotifyTransaction(const CTransaction &transaction) override;
+};
+// VELES END
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
@@ -25,7 +25,12 @@ UniValue getzmqnotifications(const JSONRPCRequest& request)
             "  {                        (json object)\n"
             "    \"type\": \"pubhashtx\",   (string) Type of notification\n"
             "    \"address\": \"...\",      (string) Address of the publisher\n"
-            "    \"hwm\": n                 (numeric) Outbound message high water mark\n"
+            "    \"hwm\": n,                (numeric) Outbound message high water mark\n"
+            "    \"sent\": n,               (numeric) Messages sent\n"
+            "    \"dropped\": n,            (numeric) Messages dropped because the queue was full or the send failed\n"
+            "    \"queued\": n,             (numeric) Messages waiting to be sent\n"
+            "    \"lag_ms\": n,             (numeric) Milliseconds the last sent message waited to be sent\n"
+            "    \"max_lag_ms\": n          (numeric) Longest wait of a sent message\n"
             "  },\n"
             "  ...\n"
             "]\n"
@@ -44,6 +49,14 @@ UniValue getzmqnotifications(const JSONRPCRequest& request)
             obj.pushKV("type", n->GetType());
             obj.pushKV("address", n->GetAddress());
             obj.pushKV("hwm", n->GetOutboundMessageHighWaterMark());
+            // VELES BEGIN
+            const CZMQNotifierStats stats = n->GetStats();
+            obj.pushKV("sent", stats.nSent);
+            obj.pushKV("dropped", stats.nDropped);
+            obj.pushKV("queued", stats.nQueued);
+            obj.pushKV("lag_ms", stats.nLastLagMillis);
+            obj.pushKV("max_lag_ms", stats.nMaxLagMillis);
+            // VELES END
             result.push_back(obj);
         }
     }
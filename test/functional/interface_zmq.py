@@ -12,6 +12,7 @@ from test_framework.util import (
     assert_equal,
     bytes_to_hex_str,
     hash256,
+    wait_until,
 )
 from io import BytesIO
 
@@ -121,12 +122,19 @@ class ZMQTest (BitcoinTestFramework):
 
 
         self.log.info("Test the getzmqnotifications RPC")
-        assert_equal(self.nodes[0].getzmqnotifications(), [
+        # The counters are updated right after the send
+        wait_until(lambda: all(n["queued"] == 0 for n in self.nodes[0].getzmqnotifications()), timeout=10)
+        notifications = self.nodes[0].getzmqnotifications()
+        assert_equal([{k: n[k] for k in ["type", "address", "hwm"]} for n in notifications], [
             {"type": "pubhashblock", "address": ADDRESS, "hwm": 1000},
             {"type": "pubhashtx", "address": ADDRESS, "hwm": 1000},
             {"type": "pubrawblock", "address": ADDRESS, "hwm": 1000},
             {"type": "pubrawtx", "address": ADDRESS, "hwm": 1000},
         ])
+        # Every message received above was sent, none dropped
+        for n, sub in zip(notifications, [self.hashblock, self.hashtx, self.rawblock, self.rawtx]):
+            assert_equal(n["sent"], sub.sequence)
+            assert_equal(n["dropped"], 0)
 
         assert_equal(self.nodes[1].getzmqnotifications(), [])
 
@@ -176,6 +176,7 @@ BASE_SCRIPTS = [
     'feature_minchainwork.py',
     'rpc_getblockstats.py',
     'wallet_create_tx.py',
+    'wallet_sendpayouts.py',
     'p2p_fingerprint.py',
     'feature_uacomment.py',
     'wallet_coinbase_category.py',
@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The Veles Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test the sendpayouts RPC.
+
+Pay a list of addresses in several transactions and check the payouts,
+the number of transactions and the errors on invalid lists."""
+
+from decimal import Decimal
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    assert_raises_rpc_error,
+)
+
+
+class SendPayoutsTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 2
+
+    def skip_test_if_missing_module(self):
+        self.skip_if_no_wallet()
+
+    def run_test(self):
+        self.nodes[0].generate(110)
+        self.sync_all()
+
+        self.log.info('Pay 25 addresses, 10 per transaction')
+        addresses = [self.nodes[1].getnewaddress() for _ in range(25)]
+        payouts = "# address,amount\n"
+        payouts += "\n".join("%s, %s" % (address, Decimal('0.1') * (i + 1)) for i, address in enumerate(addresses))
+        result = self.nodes[0].sendpayouts(payouts, {"outputs_per_tx": 10, "comment": "payouts"})
+        assert_equal(len(result['txids']), 3)
+        assert result['fee'] > 0
+        for txid in result['txids']:
+            assert_equal(self.nodes[0].gettransaction(txid)['comment'], "payouts")
+        # The transactions spend different coins
+        inputs = []
+        for txid in result['txids']:
+            tx = self.nodes[0].decoderawtransaction(self.nodes[0].gettransaction(txid)['hex'])
+            inputs += [(vin['txid'], vin['vout']) for vin in tx['vin']]
+        assert_equal(len(inputs), len(set(inputs)))
+
+        self.sync_all()
+        self.nodes[0].generate(1)
+        self.sync_all()
+        for i, address in enumerate(addresses):
+            assert_equal(self.nodes[1].getreceivedbyaddress(address), Decimal('0.1') * (i + 1))
+
+        self.log.info('Subtract the fee from the payouts')
+        address = self.nodes[1].getnewaddress()
+        result = self.nodes[0].sendpayouts("%s,1" % address, {"subtract_fee": True})
+        self.sync_all()
+        self.nodes[0].generate(1)
+        self.sync_all()
+        assert_equal(self.nodes[1].getreceivedbyaddress(address), 1 - result['fee'])
+
+        self.log.info('Reject invalid payout lists')
+        assert_raises_rpc_error(-8, "No payouts", self.nodes[0].sendpayouts, "\n# nothing\n")
+        assert_raises_rpc_error(-8, "expected address,amount", self.nodes[0].sendpayouts, address)
+        assert_raises_rpc_error(-5, "Invalid Veles address on line 2", self.nodes[0].sendpayouts, "%s,1\nnotanaddress,1" % address)
+        assert_raises_rpc_error(-8, "duplicated address on line 2", self.nodes[0].sendpayouts, "%s,1\n%s,2" % (address, address))
+        assert_raises_rpc_error(-3, "Invalid amount on line 1", self.nodes[0].sendpayouts, "%s,-1" % address)
+        assert_raises_rpc_error(-8, "Invalid outputs_per_tx", self.nodes[0].sendpayouts, "%s,1" % address, {"outputs_per_tx": 0})
+        assert_raises_rpc_error(-6, "Wallet has insufficient funds", self.nodes[0].sendpayouts, "%s,100000000" % address)
+
+
+if __name__ == '__main__':
+    SendPayoutsTest().main()